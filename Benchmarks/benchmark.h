@@ -0,0 +1,521 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// benchmark.h
+// A small harness for timing DSP code one DSPVector at a time.
+//
+// Each benchmark is a function that makes some DSPVectors of output per call. The runner
+// calls it until its timing settles, finds how many calls take about kRepetitionSeconds, then
+// times that many calls several times and reports the median, in nanoseconds per DSPVector and
+// per sample and in cycles per sample.
+//
+// Control benchmarks, for Symbols, Paths, Trees, Values and serialization, do some number of
+// operations per call instead and report nanoseconds and cycles per operation. runThreaded()
+// runs one on several threads at once, to measure contention. Benchmarks that time threads
+// themselves, like the producer and consumer of a queue, add their results with addTimings()
+// and addLatencies().
+//
+// The spread of the repetitions, half their interquartile range over the median, is kept with
+// each result as a measure of its noise. --csv and --json print the results with the SIMD back
+// end, vector sizes and compiler, and --compare diffs two such files: see benchmarkCompare.cpp.
+//
+// Cycles are estimated from the time and a clock rate. On x86 the rate of the time stamp counter
+// is used, which is the nominal rate of the processor; pass --ghz to give the real rate when
+// turbo or power saving change it, or on other processors.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "MLClock.h"
+#include "MLDSPOps.h"
+#include "MLDSPDispatch.h"
+
+namespace ml
+{
+namespace benchmark
+{
+// keep the compiler from removing the computation of x.
+template <class T>
+inline void doNotOptimize(const T& x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : : "r"(&x) : "memory");
+#else
+  static volatile char sink;
+  sink = *reinterpret_cast<const volatile char*>(&x);
+#endif
+}
+
+inline const char* getSIMDBackEndName()
+{
+#if defined(ML_SSE_TO_NEON)
+  return "NEON";
+#elif defined(ML_USE_AVX) && defined(__AVX2__)
+  return "AVX2";
+#else
+  return "SSE2";
+#endif
+}
+
+inline const char* getCompilerName()
+{
+#if defined(__clang__)
+  return "clang " __clang_version__;
+#elif defined(__GNUC__)
+  return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+  return "msvc";
+#else
+  return "unknown";
+#endif
+}
+
+inline double nowInSeconds()
+{
+  using namespace std::chrono;
+  return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+// pin the calling thread to one core. Returns false where this can't be done, as on macOS,
+// which only has affinity hints.
+inline bool pinThreadToCore(int core)
+{
+#if defined(__linux__)
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(core, &cpus);
+  return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+#else
+  (void)core;
+  return false;
+#endif
+}
+
+enum class Unit
+{
+  kVector,
+  kOperation
+};
+
+inline const char* getUnitName(Unit unit) { return (unit == Unit::kVector) ? "vector" : "op"; }
+
+struct Result
+{
+  std::string name;
+  Unit unit;
+
+  // nanoseconds per DSPVector or per operation.
+  double ns;
+
+  // zero for operations.
+  double nsPerSample;
+
+  // cycles per sample or per operation.
+  double cycles;
+
+  // half the interquartile range of the repetitions over their median.
+  double spread;
+};
+
+// the build a set of results was made with, as key and value pairs.
+using BuildInfo = std::vector<std::pair<std::string, std::string>>;
+
+// the results in a file written with --csv or --json.
+struct ResultFile
+{
+  BuildInfo info;
+  std::vector<Result> results;
+};
+
+// read a file written with --csv or --json, returning false if it can't be read.
+bool readResultFile(const std::string& path, ResultFile& file);
+
+// print the changes from the results in basePath to those in newPath. A change is only
+// reported if it is larger than thresholdPercent and than the noise of the two results. Returns
+// the number of benchmarks that got slower, or -1 if a file can't be read.
+int compareResultFiles(const std::string& basePath, const std::string& newPath,
+                       double thresholdPercent);
+
+class Runner
+{
+ public:
+  static constexpr double kWarmupSeconds{0.02};
+  static constexpr double kRepetitionSeconds{0.01};
+
+  static constexpr double kDefaultThresholdPercent{5.};
+
+  // options: --filter <text> runs only the benchmarks with text in their names, --reps <n> sets
+  // the number of timed repetitions, --ghz <rate> sets the clock rate for cycles, --csv prints
+  // comma separated values and --json prints a JSON object when finish() is called.
+  // --compare <base> <new> compares two result files instead of running benchmarks, with
+  // --threshold <percent> as the smallest change to report. --cores <a> <b> sets the cores
+  // that pairs of threads, like producers and consumers, are pinned to.
+  Runner(int argc, char** argv)
+  {
+    for (int i = 1; i < argc; ++i)
+    {
+      const bool hasValue = (i + 1 < argc);
+      if (!std::strcmp(argv[i], "--filter") && hasValue)
+      {
+        filter_ = argv[++i];
+      }
+      else if (!std::strcmp(argv[i], "--reps") && hasValue)
+      {
+        repetitions_ = std::max(1, std::atoi(argv[++i]));
+      }
+      else if (!std::strcmp(argv[i], "--ghz") && hasValue)
+      {
+        cyclesPerNs_ = std::atof(argv[++i]);
+      }
+      else if (!std::strcmp(argv[i], "--csv"))
+      {
+        csv_ = true;
+      }
+      else if (!std::strcmp(argv[i], "--json"))
+      {
+        json_ = true;
+      }
+      else if (!std::strcmp(argv[i], "--compare") && (i + 2 < argc))
+      {
+        basePath_ = argv[++i];
+        newPath_ = argv[++i];
+      }
+      else if (!std::strcmp(argv[i], "--threshold") && hasValue)
+      {
+        thresholdPercent_ = std::atof(argv[++i]);
+      }
+      else if (!std::strcmp(argv[i], "--cores") && (i + 2 < argc))
+      {
+        cores_[0] = std::atoi(argv[++i]);
+        cores_[1] = std::atoi(argv[++i]);
+      }
+    }
+#if ML_TICKS_TSC
+    if (cyclesPerNs_ <= 0.) cyclesPerNs_ = TickClock::getTicksPerSecond() * 1e-9;
+#endif
+  }
+
+  bool isComparing() const { return !basePath_.empty(); }
+  const std::string& getBasePath() const { return basePath_; }
+  const std::string& getNewPath() const { return newPath_; }
+  double getThresholdPercent() const { return thresholdPercent_; }
+  int getRepetitions() const { return repetitions_; }
+
+  // the core for the first or second thread of a pair.
+  int getCore(int i) const { return cores_[i & 1]; }
+
+  // true if the benchmark with the given name should run.
+  bool matches(const std::string& name) const
+  {
+    return filter_.empty() || (name.find(filter_) != std::string::npos);
+  }
+
+  BuildInfo getBuildInfo() const
+  {
+    std::ostringstream ghz;
+    ghz << cyclesPerNs_;
+    return {{"back_end", getSIMDBackEndName()},
+            {"dispatch", getSIMDLevelName(detectSIMDLevel())},
+            {"dsp_vector_size", std::to_string(kFloatsPerDSPVector)},
+            {"simd_vector_size", std::to_string(kFloatsPerSIMDVector)},
+            {"compiler", getCompilerName()},
+            {"ghz", ghz.str()}};
+  }
+
+  void printHeader(const char* description)
+  {
+    if (json_) return;
+    if (csv_)
+    {
+      for (const auto& item : getBuildInfo())
+      {
+        std::cout << "# " << item.first << ": " << item.second << "\n";
+      }
+      std::cout << "name,unit,ns,ns_per_sample,cycles,spread\n";
+      return;
+    }
+    std::cout << description << "\n";
+    std::cout << getCompilerName() << "\n";
+    std::cout << "DSPVector size " << kFloatsPerDSPVector << ", SIMD vector size "
+              << kFloatsPerSIMDVector << ", ";
+    if (cyclesPerNs_ > 0.)
+    {
+      std::cout << "cycles at " << cyclesPerNs_ << " GHz\n\n";
+    }
+    else
+    {
+      std::cout << "no clock rate for cycles: use --ghz\n\n";
+    }
+    std::cout << std::left << std::setw(kNameWidth) << "benchmark" << std::right << std::setw(12)
+              << "ns/vector" << std::setw(12) << "ns/sample" << std::setw(14) << "cycles/sample"
+              << "\n";
+  }
+
+  // print a section title. Sections of control benchmarks repeat the column headings, which
+  // are then per operation.
+  void printSection(const char* title, Unit unit = Unit::kVector)
+  {
+    if (csv_ || json_) return;
+    std::cout << "\n" << title << "\n";
+    if (unit == Unit::kOperation)
+    {
+      std::cout << std::left << std::setw(kNameWidth) << "" << std::right << std::setw(12)
+                << "ns/op" << std::setw(12) << "" << std::setw(14) << "cycles/op"
+                << "\n";
+    }
+  }
+
+  // time fn, which makes vectorsPerCall DSPVectors of output each call and returns any value
+  // computed from them.
+  template <class Fn>
+  void run(const std::string& name, Fn&& fn, int vectorsPerCall = 1)
+  {
+    if (!matches(name)) return;
+    const Timing t = timeCalls(fn);
+    const double ns = t.median / vectorsPerCall;
+    addResult({name, Unit::kVector, ns, ns / kFloatsPerDSPVector, 0., t.spread});
+  }
+
+  // time fn, which does opsPerCall operations each call and returns any value computed by them.
+  template <class Fn>
+  void runOps(const std::string& name, Fn&& fn, int opsPerCall = 1)
+  {
+    if (!matches(name)) return;
+    const Timing t = timeCalls(fn);
+    addResult({name, Unit::kOperation, t.median / opsPerCall, 0., 0., t.spread});
+  }
+
+  // time fn(threadIndex) running on nThreads threads at once. Each call does opsPerCall
+  // operations. The time reported is the wall clock time per operation on each thread, so with
+  // no contention it stays the same as nThreads grows.
+  template <class Fn>
+  void runThreaded(const std::string& name, int nThreads, Fn&& fn, int opsPerCall = 1)
+  {
+    if (!matches(name)) return;
+
+    // size the repetitions on one thread.
+    const size_t calls = getCallsPerRepetition([&]() { return fn(0); });
+
+    std::vector<double> nsPerCall;
+    for (int r = 0; r < repetitions_; ++r)
+    {
+      std::atomic<int> ready{0};
+      std::atomic<bool> go{false};
+      std::vector<std::thread> threads;
+      for (int t = 0; t < nThreads; ++t)
+      {
+        threads.emplace_back([&, t]() {
+          ready.fetch_add(1);
+          while (!go.load(std::memory_order_acquire))
+          {
+          }
+          for (size_t i = 0; i < calls; ++i)
+          {
+            doNotOptimize(fn(t));
+          }
+        });
+      }
+      while (ready.load() < nThreads)
+      {
+      }
+      const double t0 = nowInSeconds();
+      go.store(true, std::memory_order_release);
+      for (auto& thread : threads)
+      {
+        thread.join();
+      }
+      nsPerCall.push_back((nowInSeconds() - t0) * 1e9 / calls);
+    }
+    const Timing t = getTiming(nsPerCall);
+    addResult({name, Unit::kOperation, t.median / opsPerCall, 0., 0., t.spread});
+  }
+
+  // add a result timed by the benchmark itself, from the nanoseconds per operation of each
+  // repetition.
+  void addTimings(const std::string& name, std::vector<double> nsPerOp)
+  {
+    if (!matches(name) || nsPerOp.empty()) return;
+    const Timing t = getTiming(nsPerOp);
+    addResult({name, Unit::kOperation, t.median, 0., 0., t.spread});
+  }
+
+  // add the 50th, 99th and 99.9th percentiles of some latencies in nanoseconds, as the results
+  // name p50, name p99 and name p999.
+  void addLatencies(const std::string& name, std::vector<double> ns)
+  {
+    if (!matches(name) || ns.empty()) return;
+    std::sort(ns.begin(), ns.end());
+    auto percentile = [&](double p) { return ns[std::min(size_t(p * ns.size()), ns.size() - 1)]; };
+    addResult({name + " p50", Unit::kOperation, percentile(0.5), 0., 0., 0.});
+    addResult({name + " p99", Unit::kOperation, percentile(0.99), 0., 0., 0.});
+    addResult({name + " p999", Unit::kOperation, percentile(0.999), 0., 0., 0.});
+  }
+
+  // print the results as JSON, if --json was given.
+  void finish()
+  {
+    if (!json_) return;
+    std::cout << "{\n  \"info\": {";
+    const char* separator = "\n";
+    for (const auto& item : getBuildInfo())
+    {
+      std::cout << separator << "    " << quote(item.first) << ": " << quote(item.second);
+      separator = ",\n";
+    }
+    std::cout << "\n  },\n  \"results\": [";
+    separator = "\n";
+    for (const auto& r : results_)
+    {
+      std::cout << separator << "    {\"name\": " << quote(r.name) << ", \"unit\": "
+                << quote(getUnitName(r.unit)) << ", \"ns\": " << r.ns
+                << ", \"ns_per_sample\": " << r.nsPerSample << ", \"cycles\": " << r.cycles
+                << ", \"spread\": " << r.spread << "}";
+      separator = ",\n";
+    }
+    std::cout << "\n  ]\n}\n";
+  }
+
+  const std::vector<Result>& getResults() const { return results_; }
+
+ private:
+  static constexpr int kNameWidth{44};
+
+  struct Timing
+  {
+    double median;
+    double spread;
+  };
+
+  static Timing getTiming(std::vector<double>& nsPerCall)
+  {
+    std::sort(nsPerCall.begin(), nsPerCall.end());
+    const size_t n = nsPerCall.size();
+    const double median = nsPerCall[n / 2];
+    const double iqr = nsPerCall[(n * 3) / 4] - nsPerCall[n / 4];
+    return {median, (median > 0.) ? (iqr * 0.5 / median) : 0.};
+  }
+
+  static std::string quote(const std::string& text)
+  {
+    std::string r("\"");
+    for (char c : text)
+    {
+      if (c == '"' || c == '\\') r += '\\';
+      r += c;
+    }
+    return r + "\"";
+  }
+
+  // warm up caches, branch predictors and the clock rate, and return the number of calls to fn
+  // that take about kRepetitionSeconds.
+  template <class Fn>
+  size_t getCallsPerRepetition(Fn&& fn)
+  {
+    double start = nowInSeconds();
+    size_t warmupCalls{0};
+    while (nowInSeconds() - start < kWarmupSeconds)
+    {
+      doNotOptimize(fn());
+      ++warmupCalls;
+    }
+    const double secondsPerCall = kWarmupSeconds / std::max(warmupCalls, size_t(1));
+    return std::max(size_t(1), size_t(kRepetitionSeconds / secondsPerCall));
+  }
+
+  // return the median time of one call to fn in nanoseconds, and its spread.
+  template <class Fn>
+  Timing timeCalls(Fn&& fn)
+  {
+    const size_t calls = getCallsPerRepetition(fn);
+    std::vector<double> nsPerCall;
+    for (int r = 0; r < repetitions_; ++r)
+    {
+      const double t0 = nowInSeconds();
+      for (size_t i = 0; i < calls; ++i)
+      {
+        doNotOptimize(fn());
+      }
+      nsPerCall.push_back((nowInSeconds() - t0) * 1e9 / calls);
+    }
+    return getTiming(nsPerCall);
+  }
+
+  void addResult(Result r)
+  {
+    r.cycles = ((r.unit == Unit::kVector) ? r.nsPerSample : r.ns) * cyclesPerNs_;
+    if (!json_) print(r);
+    results_.push_back(r);
+  }
+
+  void print(const Result& r) const
+  {
+    const bool perOp = (r.unit == Unit::kOperation);
+    if (csv_)
+    {
+      std::cout << r.name << "," << getUnitName(r.unit) << "," << r.ns << "," << r.nsPerSample
+                << "," << r.cycles << "," << r.spread << "\n";
+      return;
+    }
+    std::cout << std::left << std::setw(kNameWidth) << r.name << std::right << std::fixed
+              << std::setprecision(2) << std::setw(12) << r.ns << std::setw(12)
+              << std::setprecision(3);
+    if (perOp)
+    {
+      std::cout << "-";
+    }
+    else
+    {
+      std::cout << r.nsPerSample;
+    }
+    std::cout << std::setw(14);
+    if (cyclesPerNs_ > 0.)
+    {
+      std::cout << r.cycles;
+    }
+    else
+    {
+      std::cout << "-";
+    }
+    std::cout << std::defaultfloat << "\n";
+  }
+
+  std::string filter_;
+  int repetitions_{15};
+  double cyclesPerNs_{0.};
+  bool csv_{false};
+  bool json_{false};
+  std::string basePath_;
+  std::string newPath_;
+  double thresholdPercent_{kDefaultThresholdPercent};
+  int cores_[2]{0, 1};
+  std::vector<Result> results_;
+};
+
+// run the benchmarks in each file.
+void runOpsBenchmarks(Runner& runner);
+void runFiltersBenchmarks(Runner& runner);
+void runGensBenchmarks(Runner& runner);
+void runResamplersBenchmarks(Runner& runner);
+void runControlBenchmarks(Runner& runner);
+void runQueuesBenchmarks(Runner& runner);
+
+}  // namespace benchmark
+}  // namespace ml
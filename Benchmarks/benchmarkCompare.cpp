@@ -0,0 +1,213 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// benchmarkCompare.cpp
+// reading result files and comparing two of them.
+//
+// The noise of a result is its spread, half the interquartile range of its repetitions over
+// the median. A change is reported as faster or slower only when it is larger than the
+// threshold and than kNoiseFactor times the sum of the spreads of the two results, so that
+// benchmarks that are noisy on a machine need larger changes to count.
+
+#include <fstream>
+#include <map>
+
+#include "benchmark.h"
+#include "cJSON.h"
+
+namespace ml
+{
+namespace benchmark
+{
+constexpr double kNoiseFactor{3.};
+
+static Unit getUnitFromName(const std::string& name)
+{
+  return (name == "op") ? Unit::kOperation : Unit::kVector;
+}
+
+static std::vector<std::string> splitCSVLine(const std::string& line)
+{
+  std::vector<std::string> fields;
+  std::istringstream in(line);
+  std::string field;
+  while (std::getline(in, field, ','))
+  {
+    fields.push_back(field);
+  }
+  return fields;
+}
+
+static bool readCSV(std::istream& in, ResultFile& file)
+{
+  std::string line;
+  bool readHeader{false};
+  while (std::getline(in, line))
+  {
+    if (line.empty()) continue;
+    if (line[0] == '#')
+    {
+      const size_t colon = line.find(": ");
+      if (colon != std::string::npos)
+      {
+        file.info.emplace_back(line.substr(2, colon - 2), line.substr(colon + 2));
+      }
+      continue;
+    }
+    if (!readHeader)
+    {
+      readHeader = true;
+      continue;
+    }
+    const auto fields = splitCSVLine(line);
+    if (fields.size() < 6) return false;
+    file.results.push_back({fields[0], getUnitFromName(fields[1]), std::atof(fields[2].c_str()),
+                            std::atof(fields[3].c_str()), std::atof(fields[4].c_str()),
+                            std::atof(fields[5].c_str())});
+  }
+  return readHeader;
+}
+
+static double getNumber(cJSON* object, const char* key)
+{
+  cJSON* item = cJSON_GetObjectItem(object, key);
+  return (item && item->type == cJSON_Number) ? item->valuedouble : 0.;
+}
+
+static std::string getString(cJSON* object, const char* key)
+{
+  cJSON* item = cJSON_GetObjectItem(object, key);
+  return (item && item->type == cJSON_String) ? item->valuestring : "";
+}
+
+static bool readJSON(const std::string& text, ResultFile& file)
+{
+  cJSON* root = cJSON_Parse(text.c_str());
+  if (!root) return false;
+  if (cJSON* info = cJSON_GetObjectItem(root, "info"))
+  {
+    for (cJSON* item = info->child; item; item = item->next)
+    {
+      if (item->type == cJSON_String) file.info.emplace_back(item->string, item->valuestring);
+    }
+  }
+  cJSON* results = cJSON_GetObjectItem(root, "results");
+  if (results)
+  {
+    for (cJSON* r = results->child; r; r = r->next)
+    {
+      file.results.push_back({getString(r, "name"), getUnitFromName(getString(r, "unit")),
+                              getNumber(r, "ns"), getNumber(r, "ns_per_sample"),
+                              getNumber(r, "cycles"), getNumber(r, "spread")});
+    }
+  }
+  cJSON_Delete(root);
+  return results != nullptr;
+}
+
+bool readResultFile(const std::string& path, ResultFile& file)
+{
+  std::ifstream in(path);
+  if (!in) return false;
+  std::stringstream buffer;
+  buffer << in.rdbuf();
+  const std::string text = buffer.str();
+
+  const size_t start = text.find_first_not_of(" \t\r\n");
+  if (start == std::string::npos) return false;
+  if (text[start] == '{') return readJSON(text, file);
+  std::istringstream lines(text);
+  return readCSV(lines, file);
+}
+
+int compareResultFiles(const std::string& basePath, const std::string& newPath,
+                       double thresholdPercent)
+{
+  ResultFile base, next;
+  if (!readResultFile(basePath, base))
+  {
+    std::cout << "couldn't read results from " << basePath << "\n";
+    return -1;
+  }
+  if (!readResultFile(newPath, next))
+  {
+    std::cout << "couldn't read results from " << newPath << "\n";
+    return -1;
+  }
+
+  // differences in the builds make the comparison less meaningful, so print them first.
+  std::map<std::string, std::string> baseInfo(base.info.begin(), base.info.end());
+  for (const auto& item : next.info)
+  {
+    auto it = baseInfo.find(item.first);
+    if ((it != baseInfo.end()) && (it->second != item.second))
+    {
+      std::cout << "note: " << item.first << " was " << it->second << ", is " << item.second
+                << "\n";
+    }
+  }
+
+  std::map<std::string, const Result*> baseResults;
+  for (const auto& r : base.results)
+  {
+    baseResults[r.name] = &r;
+  }
+
+  constexpr int kNameWidth{44};
+  std::cout << std::left << std::setw(kNameWidth) << "benchmark" << std::right << std::setw(12)
+            << "base ns" << std::setw(12) << "new ns" << std::setw(10) << "change" << std::setw(10)
+            << "noise"
+            << "\n";
+
+  int faster{0}, slower{0}, unchanged{0};
+  for (const auto& r : next.results)
+  {
+    auto it = baseResults.find(r.name);
+    if (it == baseResults.end())
+    {
+      std::cout << std::left << std::setw(kNameWidth) << r.name << "  new\n";
+      continue;
+    }
+    const Result& b = *it->second;
+    baseResults.erase(it);
+    if (b.ns <= 0.) continue;
+
+    const double changePercent = (r.ns / b.ns - 1.) * 100.;
+    const double noisePercent = kNoiseFactor * (b.spread + r.spread) * 100.;
+    const double limit = std::max(thresholdPercent, noisePercent);
+    const char* verdict = "";
+    if (changePercent > limit)
+    {
+      verdict = "  slower";
+      ++slower;
+    }
+    else if (changePercent < -limit)
+    {
+      verdict = "  faster";
+      ++faster;
+    }
+    else
+    {
+      ++unchanged;
+    }
+
+    std::cout << std::left << std::setw(kNameWidth) << r.name << std::right << std::fixed
+              << std::setprecision(2) << std::setw(12) << b.ns << std::setw(12) << r.ns
+              << std::showpos << std::setprecision(1) << std::setw(9) << changePercent << "%"
+              << std::noshowpos << std::setw(9) << noisePercent << "%" << verdict
+              << std::defaultfloat << "\n";
+  }
+  for (const auto& item : baseResults)
+  {
+    std::cout << std::left << std::setw(kNameWidth) << item.first << "  removed\n";
+  }
+
+  std::cout << "\n"
+            << slower << " slower, " << faster << " faster, " << unchanged
+            << " within the threshold of " << thresholdPercent << "% or the noise\n";
+  return slower;
+}
+
+}  // namespace benchmark
+}  // namespace ml
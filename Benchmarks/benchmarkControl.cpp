@@ -0,0 +1,209 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// benchmarkControl.cpp
+// the control side: making Symbols and Paths, Tree lookups, copying Values and serializing
+// Value trees. These report times per operation. Trees are made like presets, of 1k to 100k
+// parameters in modules of 64.
+
+#include "benchmark.h"
+#include "MLPath.h"
+#include "MLSerialization.h"
+#include "MLSymbol.h"
+#include "MLTree.h"
+#include "MLValue.h"
+
+namespace ml
+{
+namespace benchmark
+{
+constexpr int kParamsPerModule{64};
+constexpr int kLookupsPerCall{1024};
+constexpr int kMaxThreads{8};
+
+static std::string getParamText(int i)
+{
+  return "preset/module" + std::to_string(i / kParamsPerModule) + "/param" +
+         std::to_string(i % kParamsPerModule);
+}
+
+static std::string getSizeName(int nodes)
+{
+  return (nodes >= 1000) ? std::to_string(nodes / 1000) + "k" : std::to_string(nodes);
+}
+
+static Tree<Value> makePresetTree(const std::vector<Path>& paths)
+{
+  Tree<Value> t;
+  for (size_t i = 0; i < paths.size(); ++i)
+  {
+    // mostly floats, with some text and small arrays as in real presets.
+    if (i % 16 == 0)
+    {
+      t[paths[i]] = Value("a text parameter");
+    }
+    else if (i % 16 == 1)
+    {
+      t[paths[i]] = Value{0.1f, 0.2f, 0.3f, 0.4f};
+    }
+    else
+    {
+      t[paths[i]] = Value(i * 0.001f);
+    }
+  }
+  return t;
+}
+
+static void runSymbols(Runner& runner)
+{
+  // existing symbols, as when code makes Symbols from the same text over and over.
+  std::vector<std::string> texts;
+  for (int i = 0; i < kLookupsPerCall; ++i)
+  {
+    texts.push_back("param" + std::to_string(i));
+    Symbol registered(texts.back().c_str());
+  }
+  auto existing = [&]() {
+    uint64_t sum{0};
+    for (const auto& text : texts)
+    {
+      sum += Symbol(text.c_str(), text.size()).getHash();
+    }
+    return sum;
+  };
+  runner.runOps("control/Symbol existing", existing, kLookupsPerCall);
+
+  // new symbols, each of which is added to the table.
+  size_t newCount{0};
+  runner.runOps("control/Symbol new", [&]() {
+    const std::string text = "new" + std::to_string(newCount++);
+    return Symbol(text.c_str(), text.size()).getHash();
+  });
+
+  // the same, on several threads at once. Each thread makes symbols of its own text, so the
+  // threads only contend on the table.
+  std::vector<size_t> counts(kMaxThreads * 16);
+  for (int threads = 1; threads <= kMaxThreads; threads *= 2)
+  {
+    const std::string suffix =
+        " " + std::to_string(threads) + ((threads > 1) ? " threads" : " thread");
+    runner.runThreaded("control/Symbol existing" + suffix, threads,
+                       [&](int) { return existing(); }, kLookupsPerCall);
+    runner.runThreaded("control/Symbol new" + suffix, threads, [&](int t) {
+      const std::string text = "new" + std::to_string(t) + "_" + std::to_string(counts[t * 16]++);
+      return Symbol(text.c_str(), text.size()).getHash();
+    });
+  }
+}
+
+static void runPaths(Runner& runner)
+{
+  const char* text = "preset/module12/param34";
+  const TextFragment fragment(text);
+  runner.runOps("control/runtimePath from char*", [&]() { return runtimePath(text); });
+  runner.runOps("control/runtimePath from TextFragment", [&]() { return runtimePath(fragment); });
+  const Path path = runtimePath(text);
+  runner.runOps("control/Path toText", [&]() { return path.toText(); });
+}
+
+static void runTrees(Runner& runner, int nodes)
+{
+  const std::string size = " " + getSizeName(nodes);
+  std::vector<Path> paths;
+  for (int i = 0; i < nodes; ++i)
+  {
+    paths.push_back(runtimePath(getParamText(i).c_str()));
+  }
+
+  runner.runOps("control/Tree build" + size, [&]() { return makePresetTree(paths); }, nodes);
+
+  // look up paths in a scattered order, as a UI or a host does.
+  const Tree<Value> tree = makePresetTree(paths);
+  std::vector<Path> lookups;
+  for (int i = 0; i < kLookupsPerCall; ++i)
+  {
+    lookups.push_back(paths[(i * 7919) % nodes]);
+  }
+  runner.runOps(
+      "control/Tree lookup" + size,
+      [&]() {
+        float sum{0.f};
+        for (const auto& p : lookups)
+        {
+          sum += tree[p].getFloatValue();
+        }
+        return sum;
+      },
+      kLookupsPerCall);
+  runner.runOps("control/Tree copy" + size, [&]() { return Tree<Value>(tree); }, nodes);
+}
+
+static void runValues(Runner& runner)
+{
+  std::vector<uint8_t> blobData(1024, 1);
+  const Value floatValue(0.5f);
+  const Value textValue("a text value that is too long for any small buffer");
+  const Value arrayValue{std::vector<float>(16, 0.5f)};
+  const Value blobValue(blobData.data(), blobData.size());
+  runner.runOps("control/Value copy float", [&]() { return Value(floatValue); });
+  runner.runOps("control/Value copy text", [&]() { return Value(textValue); });
+  runner.runOps("control/Value copy 16 floats", [&]() { return Value(arrayValue); });
+  runner.runOps("control/Value copy 1k blob", [&]() { return Value(blobValue); });
+}
+
+static void runSerialization(Runner& runner, int nodes)
+{
+  const std::string size = " " + getSizeName(nodes);
+  std::vector<Path> paths;
+  for (int i = 0; i < nodes; ++i)
+  {
+    paths.push_back(runtimePath(getParamText(i).c_str()));
+  }
+  const Tree<Value> tree = makePresetTree(paths);
+
+  // times per node.
+  std::vector<uint8_t> buffer;
+  runner.runOps(
+      "control/valueTreeToBinary" + size,
+      [&]() {
+        valueTreeToBinary(tree, buffer);
+        return buffer.size();
+      },
+      nodes);
+  const auto binary = valueTreeToBinary(tree);
+  runner.runOps("control/binaryToValueTree" + size, [&]() { return binaryToValueTree(binary); },
+                nodes);
+
+  runner.runOps("control/valueTreeToLargeBinary" + size,
+                [&]() { return valueTreeToLargeBinary(tree); }, nodes);
+  const auto largeBinary = valueTreeToLargeBinary(tree);
+  runner.runOps("control/binaryToValueTree large" + size,
+                [&]() { return binaryToValueTree(largeBinary); }, nodes);
+
+  runner.runOps("control/valueTreeToJSONText" + size,
+                [&]() { return valueTreeToJSONText(tree); }, nodes);
+  const TextFragment json = valueTreeToJSONText(tree);
+  runner.runOps("control/JSONTextToValueTree" + size,
+                [&]() { return JSONTextToValueTree(json); }, nodes);
+}
+
+void runControlBenchmarks(Runner& runner)
+{
+  runner.printSection("control", Unit::kOperation);
+
+  runSymbols(runner);
+  runPaths(runner);
+  runValues(runner);
+  for (int nodes : {1000, 10000, 100000})
+  {
+    runTrees(runner, nodes);
+  }
+  for (int nodes : {1000, 10000, 100000})
+  {
+    runSerialization(runner, nodes);
+  }
+}
+
+}  // namespace benchmark
+}  // namespace ml
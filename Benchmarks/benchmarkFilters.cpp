@@ -0,0 +1,209 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// benchmarkFilters.cpp
+// the filters, envelopes and delays in MLDSPFilters.h. The half band filters and the up and
+// downsamplers are in benchmarkResamplers.cpp.
+
+#include "benchmark.h"
+#include "mldsp.h"
+
+namespace ml
+{
+namespace benchmark
+{
+constexpr float kOmega{0.05f};
+constexpr float kQ{0.7f};
+constexpr float kGain{2.f};
+
+template <size_t VOICES>
+static void runSVFBank(Runner& runner, const DSPVector& x)
+{
+  SVFBank<VOICES> bank;
+  for (size_t v = 0; v < VOICES; ++v)
+  {
+    bank.setCoeffs(v, SVFBank<VOICES>::lopassCoeffs(kOmega * (v + 1) / VOICES, kQ));
+  }
+  const DSPVectorArray<VOICES> vx = repeatRows<VOICES>(x);
+  doNotOptimize(vx);
+  runner.run("filters/SVFBank<" + std::to_string(VOICES) + ">", [&]() { return bank(vx); },
+             VOICES);
+}
+
+template <class STORAGE>
+static void runDelays(Runner& runner, const char* storageName, const DSPVector& x,
+                      const DSPVector& modulatedDelay)
+{
+  const std::string suffix = std::string(" ") + storageName;
+
+  BasicIntegerDelay<STORAGE> intDelay(997);
+  runner.run("filters/IntegerDelay" + suffix, [&]() { return intDelay(x); });
+
+  BasicIntegerDelay<STORAGE> intDelayMod;
+  intDelayMod.setMaxDelayInSamples(2000.f);
+  runner.run("filters/IntegerDelay modulated" + suffix,
+             [&]() { return intDelayMod(x, modulatedDelay); });
+
+  BasicFractionalDelay<STORAGE> fracDelay(997.5f);
+  runner.run("filters/FractionalDelay" + suffix, [&]() { return fracDelay(x); });
+
+  BasicFractionalDelay<STORAGE> fracDelayMod;
+  fracDelayMod.setMaxDelayInSamples(2000.f);
+  runner.run("filters/FractionalDelay modulated" + suffix,
+             [&]() { return fracDelayMod(x, modulatedDelay); });
+
+  FDN<4, STORAGE> fdn;
+  fdn.setDelaysInSamples({{67, 73, 91, 103}});
+  fdn.setFilterCutoffs({{0.1f, 0.2f, 0.3f, 0.4f}});
+  fdn.mFeedbackGains = {{0.5f, 0.5f, 0.5f, 0.5f}};
+  runner.run("filters/FDN<4>" + suffix, [&]() { return fdn(x); });
+
+  MatrixFDN<8, 2, STORAGE> matrixFDN;
+  matrixFDN.setDelaysInSamples({{67, 73, 91, 103, 127, 151, 173, 199}});
+  matrixFDN.setFilterCutoffs({{0.1f, 0.15f, 0.2f, 0.25f, 0.3f, 0.35f, 0.4f, 0.45f}});
+  std::array<float, 8> gains;
+  gains.fill(0.9f);
+  matrixFDN.setFeedbackGains(gains);
+  runner.run("filters/MatrixFDN<8> Householder" + suffix, [&]() { return matrixFDN(x); });
+  matrixFDN.template setMatrixType<FDNMatrixType::kHadamard>();
+  runner.run("filters/MatrixFDN<8> Hadamard" + suffix, [&]() { return matrixFDN(x); });
+}
+
+void runFiltersBenchmarks(Runner& runner)
+{
+  runner.printSection("filters");
+
+  NoiseGen noise;
+  const DSPVector x = noise();
+  const DSPVector omegas = DSPVector(kOmega) + x * DSPVector(0.01f);
+  const DSPVector qs(kQ);
+  const DSPVector modulatedDelay = DSPVector(500.f) + x * DSPVector(10.f);
+  doNotOptimize(x);
+  doNotOptimize(omegas);
+  doNotOptimize(modulatedDelay);
+
+  Lopass lopass;
+  lopass.coeffs = Lopass::makeCoeffs(kOmega, kQ);
+  runner.run("filters/Lopass", [&]() { return lopass(x); });
+  runner.run("filters/Lopass modulated", [&]() { return lopass(x, omegas, qs); });
+
+  Hipass hipass;
+  hipass.coeffs = Hipass::makeCoeffs(kOmega, kQ);
+  runner.run("filters/Hipass", [&]() { return hipass(x); });
+
+  Bandpass bandpass;
+  bandpass.coeffs = Bandpass::makeCoeffs(kOmega, kQ);
+  runner.run("filters/Bandpass", [&]() { return bandpass(x); });
+
+  LoShelf loShelf;
+  loShelf.coeffs = LoShelf::makeCoeffs({kOmega, kQ, kGain});
+  runner.run("filters/LoShelf", [&]() { return loShelf(x); });
+  const auto loShelfRamp = LoShelf::vcoeffs({kOmega, kQ, kGain}, {kOmega * 2, kQ, kGain});
+  runner.run("filters/LoShelf interpolated", [&]() { return loShelf(x, loShelfRamp); });
+
+  HiShelf hiShelf;
+  hiShelf.coeffs = HiShelf::makeCoeffs({kOmega, kQ, kGain});
+  runner.run("filters/HiShelf", [&]() { return hiShelf(x); });
+  const auto hiShelfRamp = HiShelf::vcoeffs({kOmega, kQ, kGain}, {kOmega * 2, kQ, kGain});
+  runner.run("filters/HiShelf interpolated", [&]() { return hiShelf(x, hiShelfRamp); });
+
+  Bell bell;
+  bell.coeffs = Bell::makeCoeffs(kOmega, kQ, kGain);
+  runner.run("filters/Bell", [&]() { return bell(x); });
+
+  runSVFBank<4>(runner, x);
+  runSVFBank<16>(runner, x);
+
+  BlockSVF blockSVF;
+  blockSVF.jumpCoeffs(SVFBank<1>::lopassCoeffs(kOmega, kQ));
+  runner.run("filters/BlockSVF", [&]() { return blockSVF(x); });
+  const auto svfCoeffs1 = SVFBank<1>::lopassCoeffs(kOmega, kQ);
+  const auto svfCoeffs2 = SVFBank<1>::lopassCoeffs(kOmega * 2, kQ);
+  bool flip{false};
+  runner.run("filters/BlockSVF interpolated", [&]() {
+    flip = !flip;
+    blockSVF.setCoeffs(flip ? svfCoeffs1 : svfCoeffs2);
+    return blockSVF(x);
+  });
+
+  OnePole onePole;
+  onePole.coeffs = OnePole::makeCoeffs(kOmega);
+  runner.run("filters/OnePole", [&]() { return onePole(x); });
+
+  DCBlocker dcBlocker;
+  runner.run("filters/DCBlocker", [&]() { return dcBlocker(x); });
+
+  Differentiator differentiator;
+  runner.run("filters/Differentiator", [&]() { return differentiator(x); });
+
+  Integrator integrator;
+  runner.run("filters/Integrator", [&]() { return integrator(x); });
+
+  Peak peak;
+  peak.coeffs = Peak::makeCoeffs(kOmega);
+  runner.run("filters/Peak", [&]() { return peak(x); });
+
+  RMS rms;
+  rms.coeffs = RMS::makeCoeffs(kOmega);
+  runner.run("filters/RMS", [&]() { return rms(x); });
+
+  Allpass1 allpass1(Allpass1::makeCoeffs(1.2f));
+  runner.run("filters/Allpass1", [&]() { return allpass1(x); });
+
+  // envelopes, with a gate that turns on and off every few vectors.
+  const float kSr{48000.f};
+  const auto adsrCoeffs = ADSR::calcCoeffs(0.001f, 0.01f, 0.5f, 0.01f, kSr);
+  int gateCount{0};
+  auto nextGate = [&]() { return DSPVector(((gateCount++ >> 3) & 1) ? 1.f : 0.f); };
+  ADSR adsr;
+  adsr.coeffs = adsrCoeffs;
+  runner.run("filters/ADSR", [&]() { return adsr(nextGate()); });
+
+  constexpr int kVoices{16};
+  ADSRBank<kVoices> adsrBank;
+  adsrBank.setCoeffs(adsrCoeffs);
+  runner.run(
+      "filters/ADSRBank<16>",
+      [&]() { return adsrBank(repeatRows<kVoices>(nextGate())); }, kVoices);
+
+  // delays
+  runDelays<float>(runner, "float", x, modulatedDelay);
+  runDelays<Float16>(runner, "Float16", x, modulatedDelay);
+  runDelays<BFloat16>(runner, "BFloat16", x, modulatedDelay);
+
+  PitchbendableDelay pitchbendableDelay;
+  pitchbendableDelay.setMaxDelayInSamples(2000.f);
+  runner.run("filters/PitchbendableDelay", [&]() { return pitchbendableDelay(x, modulatedDelay); });
+
+  Allpass<IntegerDelay> allpass;
+  allpass.setMaxDelayInSamples(2000.f);
+  allpass.setDelayInSamples(997.f);
+  allpass.mGain = 0.6f;
+  runner.run("filters/Allpass<IntegerDelay>", [&]() { return allpass(x); });
+
+  constexpr int kTaps{4};
+  MultiTapDelay multiTap(2000.f);
+  DSPVectorArray<kTaps> tapDelays;
+  for (int t = 0; t < kTaps; ++t)
+  {
+    tapDelays.row(t) = modulatedDelay * DSPVector(t + 1.f);
+  }
+  doNotOptimize(tapDelays);
+  runner.run("filters/MultiTapDelay 4 taps linear", [&]() {
+    multiTap.write(x);
+    return multiTap.readLinear(tapDelays);
+  });
+  runner.run("filters/MultiTapDelay 4 taps cubic", [&]() {
+    multiTap.write(x);
+    return multiTap.readCubic(tapDelays);
+  });
+
+  TempoLock tempoLock;
+  PhasorGen phasor;
+  const DSPVector phasorFreq(0.001f);
+  runner.run("filters/TempoLock", [&]() { return tempoLock(phasor(phasorFreq), 2.f, 1.f / kSr); });
+}
+
+}  // namespace benchmark
+}  // namespace ml
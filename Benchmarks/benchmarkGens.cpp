@@ -0,0 +1,141 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// benchmarkGens.cpp
+// the generators in MLDSPGens.h.
+
+#include "benchmark.h"
+#include "mldsp.h"
+
+namespace ml
+{
+namespace benchmark
+{
+void runGensBenchmarks(Runner& runner)
+{
+  runner.printSection("generators");
+
+  const DSPVector freq(440.f / 48000.f);
+  const DSPVector width(0.3f);
+  doNotOptimize(freq);
+  doNotOptimize(width);
+
+  TickGen ticks;
+  runner.run("gens/TickGen", [&]() { return ticks(freq); });
+
+  ImpulseGen impulses;
+  runner.run("gens/ImpulseGen", [&]() { return impulses(freq); });
+
+  NoiseGen noise;
+  runner.run("gens/NoiseGen", [&]() { return noise(); });
+
+  FastNoiseGen fastNoise;
+  runner.run("gens/FastNoiseGen", [&]() { return fastNoise(); });
+
+  TestSineGen testSine;
+  runner.run("gens/TestSineGen", [&]() { return testSine(freq); });
+
+  PhasorGen phasor;
+  runner.run("gens/PhasorGen", [&]() { return phasor(freq); });
+
+  OneShotGen oneShot;
+  int oneShotCount{0};
+  runner.run("gens/OneShotGen", [&]() {
+    if ((oneShotCount++ & 63) == 0) oneShot.trigger();
+    return oneShot(freq);
+  });
+
+  SineGen sine;
+  runner.run("gens/SineGen", [&]() { return sine(freq); });
+
+  PulseGen pulse;
+  runner.run("gens/PulseGen", [&]() { return pulse(freq, width); });
+
+  SawGen saw;
+  runner.run("gens/SawGen", [&]() { return saw(freq); });
+
+  // a two frame wavetable, sweeping between a saw and a square.
+  std::vector<float> frames(Wavetable::kSize * 2);
+  for (int n = 0; n < Wavetable::kSize; ++n)
+  {
+    float phase = n / float(Wavetable::kSize);
+    frames[n] = 2.f * phase - 1.f;
+    frames[Wavetable::kSize + n] = (phase < 0.5f) ? 1.f : -1.f;
+  }
+  Wavetable table(frames.data(), 2);
+  const DSPVector position(0.25f);
+  doNotOptimize(position);
+
+  WavetableGen wavetableGen(&table);
+  runner.run("gens/WavetableGen", [&]() { return wavetableGen(freq, position); });
+
+  constexpr int kVoices{16};
+  WavetableBank<kVoices> wavetableBank(&table);
+  DSPVectorArray<kVoices> freqs, positions;
+  for (int v = 0; v < kVoices; ++v)
+  {
+    freqs.row(v) = freq * DSPVector(1.f + v * 0.1f);
+    positions.row(v) = DSPVector(v / float(kVoices));
+  }
+  doNotOptimize(freqs);
+  doNotOptimize(positions);
+  runner.run(
+      "gens/WavetableBank<16>", [&]() { return wavetableBank(freqs, positions); }, kVoices);
+
+  constexpr int kPartials{64};
+  AdditiveBank<kPartials> additive;
+  std::array<float, kPartials> partialFreqs, partialAmps;
+  for (int p = 0; p < kPartials; ++p)
+  {
+    partialFreqs[p] = freq[0] * (p + 1);
+    partialAmps[p] = 1.f / (p + 1);
+  }
+  doNotOptimize(partialFreqs);
+  doNotOptimize(partialAmps);
+
+  // the output is one DSPVector, so report the time per partial as well.
+  runner.run("gens/AdditiveBank<64>",
+             [&]() { return additive(partialFreqs.data(), partialAmps.data()); });
+  runner.run(
+      "gens/AdditiveBank<64> per partial",
+      [&]() { return additive(partialFreqs.data(), partialAmps.data()); }, kPartials);
+
+  // control signal generators, with a target that changes every few vectors.
+  int targetCount{0};
+  auto nextTarget = [&]() { return ((targetCount++ >> 2) & 1) ? 1.f : 0.f; };
+
+  Interpolator1 interpolator;
+  runner.run("gens/Interpolator1", [&]() { return interpolator(nextTarget()); });
+
+  LinearGlide glide;
+  glide.setGlideTimeInSamples(kFloatsPerDSPVector * 2);
+  runner.run("gens/LinearGlide", [&]() { return glide(nextTarget()); });
+
+  SampleAccurateLinearGlide sampleGlide;
+  sampleGlide.setGlideTimeInSamples(100.f);
+  runner.run("gens/SampleAccurateLinearGlide", [&]() {
+    DSPVector y;
+    const float target = nextTarget();
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      y[n] = sampleGlide.nextSample(target);
+    }
+    return y;
+  });
+
+  constexpr int kGlides{16};
+  GlideBank<kGlides> glideBank;
+  glideBank.setGlideTimeInSamples(kFloatsPerDSPVector * 2);
+  std::array<float, kGlides> targets;
+  runner.run(
+      "gens/GlideBank<16>",
+      [&]() {
+        targets.fill(nextTarget());
+        return glideBank(targets.data());
+      },
+      kGlides);
+}
+
+}  // namespace benchmark
+}  // namespace ml
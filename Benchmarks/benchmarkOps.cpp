@@ -0,0 +1,114 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// benchmarkOps.cpp
+// math on DSPVectors: MLDSPOps.h, the MLDSPMathTiers.h tiers and the dispatched kernels.
+
+#include "benchmark.h"
+#include "mldsp.h"
+
+namespace ml
+{
+namespace benchmark
+{
+template <class Math>
+static void runTier(Runner& runner, const char* tierName, const DSPVector& phases,
+                    const DSPVector& positives, const DSPVector& signals)
+{
+  std::string prefix = std::string("ops/") + tierName + "::";
+  runner.run(prefix + "sin", [&]() { return Math::sin(phases); });
+  runner.run(prefix + "cos", [&]() { return Math::cos(phases); });
+  runner.run(prefix + "exp", [&]() { return Math::exp(signals); });
+  runner.run(prefix + "log", [&]() { return Math::log(positives); });
+  runner.run(prefix + "exp2", [&]() { return Math::exp2(signals); });
+  runner.run(prefix + "log2", [&]() { return Math::log2(positives); });
+  runner.run(prefix + "tanh", [&]() { return Math::tanh(signals); });
+}
+
+static void runKernels(Runner& runner, const DSPKernels& k, const float* px1, const float* px2,
+                       const float* pPositives, const float* pMix, float* py)
+{
+  std::string prefix = std::string("ops/kernels ") + getSIMDLevelName(k.level) + " ";
+  const size_t n = kFloatsPerDSPVector;
+  auto unary = [&](const char* name, DSPKernels::UnaryFn fn, const float* px) {
+    runner.run(prefix + name, [&]() {
+      fn(px, py, n);
+      return py[0];
+    });
+  };
+  unary("sin", k.sin, px1);
+  unary("cos", k.cos, px1);
+  unary("exp", k.exp, px1);
+  unary("log", k.log, pPositives);
+  unary("sqrt", k.sqrt, pPositives);
+  unary("tanhApprox", k.tanhApprox, px1);
+  runner.run(prefix + "lerp", [&]() {
+    k.lerp(px1, px2, pMix, py, n);
+    return py[0];
+  });
+  runner.run(prefix + "sum", [&]() { return k.sum(px1, n); });
+  runner.run(prefix + "max", [&]() { return k.max(px1, n); });
+}
+
+void runOpsBenchmarks(Runner& runner)
+{
+  runner.printSection("DSPVector math");
+
+  // inputs in the ranges the functions are usually used for.
+  NoiseGen noise;
+  const DSPVector signals = noise();
+  const DSPVector signals2 = noise();
+  const DSPVector phases = signals * DSPVector(kPi);
+  const DSPVector positives = abs(signals) + DSPVector(0.01f);
+  const DSPVector mix = abs(signals2);
+  doNotOptimize(signals);
+  doNotOptimize(signals2);
+  doNotOptimize(phases);
+  doNotOptimize(positives);
+  doNotOptimize(mix);
+
+  runner.run("ops/add", [&]() { return signals + signals2; });
+  runner.run("ops/multiply", [&]() { return signals * signals2; });
+  runner.run("ops/divide", [&]() { return signals / positives; });
+  runner.run("ops/sqrt", [&]() { return sqrt(positives); });
+  runner.run("ops/sin", [&]() { return sin(phases); });
+  runner.run("ops/sinApprox", [&]() { return sinApprox(phases); });
+  runner.run("ops/cos", [&]() { return cos(phases); });
+  runner.run("ops/exp", [&]() { return exp(signals); });
+  runner.run("ops/expApprox", [&]() { return expApprox(signals); });
+  runner.run("ops/exp2", [&]() { return exp2(signals); });
+  runner.run("ops/log", [&]() { return log(positives); });
+  runner.run("ops/logApprox", [&]() { return logApprox(positives); });
+  runner.run("ops/pow", [&]() { return pow(positives, signals2); });
+  runner.run("ops/powApprox", [&]() { return powApprox(positives, signals2); });
+  runner.run("ops/tanhApprox", [&]() { return tanhApprox(signals); });
+  runner.run("ops/lerp", [&]() { return lerp(signals, signals2, mix); });
+  runner.run("ops/clamp", [&]() { return clamp(signals, DSPVector(-0.5f), DSPVector(0.5f)); });
+  runner.run("ops/fractionalPart", [&]() { return fractionalPart(phases); });
+
+  // 16 rows at once, as for a bank of voices.
+  const DSPVectorArray<16> signals16 = repeatRows<16>(signals);
+  doNotOptimize(signals16);
+  runner.run("ops/exp 16 rows", [&]() { return exp(signals16); }, 16);
+  runner.run("ops/tanhApprox 16 rows", [&]() { return tanhApprox(signals16); }, 16);
+
+  runTier<PreciseMath>(runner, "PreciseMath", phases, positives, signals);
+  runTier<ApproxMath>(runner, "ApproxMath", phases, positives, signals);
+  runTier<FastMath>(runner, "FastMath", phases, positives, signals);
+
+  // the runtime dispatched kernels, at each level this machine has.
+  DSPVector out;
+  runKernels(runner, getDSPKernels(SIMDLevel::kBaseline), signals.getConstBuffer(),
+             signals2.getConstBuffer(), positives.getConstBuffer(), mix.getConstBuffer(),
+             out.getBuffer());
+  if (detectSIMDLevel() != SIMDLevel::kBaseline)
+  {
+    runKernels(runner, getDSPKernels(SIMDLevel::kAVX2), signals.getConstBuffer(),
+               signals2.getConstBuffer(), positives.getConstBuffer(), mix.getConstBuffer(),
+               out.getBuffer());
+  }
+}
+
+}  // namespace benchmark
+}  // namespace ml
@@ -0,0 +1,200 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// benchmarkQueues.cpp
+// passing data between threads through a Queue, an MPMCQueue and a DSPBuffer, with one producer
+// and one consumer thread, pinned to the cores set by --cores (0 and 1 by default) on Linux.
+//
+// Transfer benchmarks send items as fast as the producer can, spinning while the queue is full
+// and the consumer while it is empty, and report the time per item: the inverse of the items
+// per second. Latency benchmarks send one item every few microseconds, so that the queue is
+// nearly always empty, and report percentiles of the time from just before each push to just
+// after its pop, read from the TickClock on both threads. Items are ints, Events, Messages and
+// blocks of one DSPVector of floats. With only one core, the threads would take turns instead
+// of running at once, so nothing is measured.
+
+#include <array>
+
+#include "benchmark.h"
+#include "MLDSPBuffer.h"
+#include "MLEvent.h"
+#include "MLMessage.h"
+#include "MLQueue.h"
+
+namespace ml
+{
+namespace benchmark
+{
+constexpr size_t kQueueSize{1024};
+constexpr size_t kTransferItems{1 << 16};
+constexpr size_t kLatencyItems{1 << 14};
+constexpr double kLatencyIntervalSeconds{2e-6};
+
+using FloatBlock = std::array<float, kFloatsPerDSPVector>;
+
+// a DSPBuffer with the push() and pop() of a queue, for one FloatBlock at a time.
+class DSPBufferChannel
+{
+ public:
+  explicit DSPBufferChannel(size_t size) { buffer_.resize(int(size * kFloatsPerDSPVector)); }
+
+  bool push(const FloatBlock& x)
+  {
+    if (buffer_.getWriteAvailable() < x.size()) return false;
+    buffer_.write(x.data(), x.size());
+    return true;
+  }
+
+  bool pop(FloatBlock& x)
+  {
+    if (buffer_.getReadAvailable() < x.size()) return false;
+    buffer_.read(x.data(), x.size());
+    return true;
+  }
+
+ private:
+  DSPBuffer buffer_;
+};
+
+// run the producer and the consumer on their own pinned threads, starting them together.
+template <class ProducerFn, class ConsumerFn>
+static void runPair(Runner& runner, ProducerFn producer, ConsumerFn consumer)
+{
+  std::atomic<int> ready{0};
+  std::atomic<bool> go{false};
+  auto start = [&](int core) {
+    pinThreadToCore(runner.getCore(core));
+    ready++;
+    while (!go.load(std::memory_order_acquire))
+    {
+    }
+  };
+  std::thread consumerThread([&]() {
+    start(1);
+    consumer();
+  });
+  std::thread producerThread([&]() {
+    start(0);
+    producer();
+  });
+  while (ready.load() < 2)
+  {
+  }
+  go.store(true, std::memory_order_release);
+  producerThread.join();
+  consumerThread.join();
+}
+
+template <class Channel, class T>
+static void runTransfer(Runner& runner, const std::string& name, const T& item)
+{
+  if (!runner.matches(name)) return;
+  std::vector<double> nsPerItem;
+  for (int r = 0; r < runner.getRepetitions(); ++r)
+  {
+    Channel c(kQueueSize);
+    T received{};
+    const double t0 = nowInSeconds();
+    runPair(
+        runner,
+        [&]() {
+          for (size_t i = 0; i < kTransferItems;)
+          {
+            if (c.push(item)) ++i;
+          }
+        },
+        [&]() {
+          for (size_t i = 0; i < kTransferItems;)
+          {
+            if (c.pop(received)) ++i;
+          }
+        });
+    nsPerItem.push_back((nowInSeconds() - t0) * 1e9 / kTransferItems);
+    doNotOptimize(received);
+  }
+  runner.addTimings(name, nsPerItem);
+}
+
+template <class Channel, class T>
+static void runLatency(Runner& runner, const std::string& name, const T& item)
+{
+  if (!runner.matches(name + " p50")) return;
+  Channel c(kQueueSize);
+  std::vector<uint64_t> sent(kLatencyItems), received(kLatencyItems);
+  const uint64_t interval = uint64_t(kLatencyIntervalSeconds * TickClock::getTicksPerSecond());
+  T x{};
+  runPair(
+      runner,
+      [&]() {
+        uint64_t next = TickClock::now();
+        for (size_t i = 0; i < kLatencyItems; ++i)
+        {
+          next += interval;
+          while (TickClock::now() < next)
+          {
+          }
+          sent[i] = TickClock::now();
+          while (!c.push(item))
+          {
+          }
+        }
+      },
+      [&]() {
+        for (size_t i = 0; i < kLatencyItems; ++i)
+        {
+          while (!c.pop(x))
+          {
+          }
+          received[i] = TickClock::now();
+        }
+      });
+  doNotOptimize(x);
+
+  std::vector<double> ns(kLatencyItems);
+  for (size_t i = 0; i < kLatencyItems; ++i)
+  {
+    ns[i] = TickClock::secondsBetween(sent[i], received[i]) * 1e9;
+  }
+  runner.addLatencies(name, ns);
+}
+
+template <class Channel, class T>
+static void runQueue(Runner& runner, const std::string& name, const T& item)
+{
+  runTransfer<Channel>(runner, "queues/" + name + " transfer", item);
+  runLatency<Channel>(runner, "queues/" + name + " latency", item);
+}
+
+void runQueuesBenchmarks(Runner& runner)
+{
+  runner.printSection("queues, in ns per item", Unit::kOperation);
+  if (std::thread::hardware_concurrency() < 2)
+  {
+    std::cout << "skipped: the queue benchmarks need two cores.\n";
+    return;
+  }
+
+  Event event;
+  event.type = kNoteOn;
+  event.value1 = 60.f;
+  event.value2 = 0.8f;
+  const Message message("voice/note/on", Value{60.f, 0.8f});
+  FloatBlock block;
+  block.fill(0.5f);
+
+  runQueue<Queue<int>>(runner, "Queue<int>", 1);
+  runQueue<Queue<Event>>(runner, "Queue<Event>", event);
+  runQueue<Queue<Message>>(runner, "Queue<Message>", message);
+  runQueue<Queue<FloatBlock>>(runner, "Queue<block>", block);
+
+  runQueue<MPMCQueue<int>>(runner, "MPMCQueue<int>", 1);
+  runQueue<MPMCQueue<Event>>(runner, "MPMCQueue<Event>", event);
+  runQueue<MPMCQueue<Message>>(runner, "MPMCQueue<Message>", message);
+  runQueue<MPMCQueue<FloatBlock>>(runner, "MPMCQueue<block>", block);
+
+  runQueue<DSPBufferChannel>(runner, "DSPBuffer block", block);
+}
+
+}  // namespace benchmark
+}  // namespace ml
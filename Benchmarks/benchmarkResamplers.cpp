@@ -0,0 +1,141 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// benchmarkResamplers.cpp
+// the Resampler of MLDSPResampler.h, and the half band filters with the up and downsamplers
+// made from them in MLDSPFilters.h. Times are per DSPVector of output for the Resampler, and
+// per DSPVector of input at the lower rate for the others.
+
+#include "benchmark.h"
+#include "mldsp.h"
+
+namespace ml
+{
+namespace benchmark
+{
+static const char* getQualityName(Resampler::Quality q)
+{
+  switch (q)
+  {
+    case Resampler::Quality::kLow:
+      return "low";
+    case Resampler::Quality::kMedium:
+      return "medium";
+    case Resampler::Quality::kHigh:
+      return "high";
+    default:
+      return "best";
+  }
+}
+
+void runResamplersBenchmarks(Runner& runner)
+{
+  runner.printSection("resamplers");
+
+  NoiseGen noise;
+  const DSPVector x = noise();
+  const DSPVector x2 = noise();
+  doNotOptimize(x);
+  doNotOptimize(x2);
+
+  // enough input for the highest ratio.
+  constexpr float kMaxRatio{2.f};
+  std::vector<float> input(kFloatsPerDSPVector * 4);
+  for (size_t i = 0; i < input.size(); ++i)
+  {
+    input[i] = x[i % kFloatsPerDSPVector];
+  }
+
+  for (auto q : {Resampler::Quality::kLow, Resampler::Quality::kMedium, Resampler::Quality::kHigh,
+                 Resampler::Quality::kBest})
+  {
+    for (double ratio : {0.5, 1.1, 2.0})
+    {
+      Resampler resampler(q, kMaxRatio);
+      std::string name = std::string("resample/Resampler ") + getQualityName(q) + " ratio " +
+                         std::to_string(ratio).substr(0, 3);
+      runner.run(name, [&]() { return resampler(input.data(), ratio); });
+    }
+  }
+
+  HalfBandFilter halfBand;
+  runner.run("resample/HalfBandFilter up 2x", [&]() {
+    return halfBand.upsampleFirstHalf(x) + halfBand.upsampleSecondHalf(x);
+  });
+  runner.run("resample/HalfBandFilter down 2x", [&]() { return halfBand.downsample(x, x2); });
+
+  for (int octaves : {1, 2, 3})
+  {
+    const std::string factor = std::to_string(1 << octaves) + "x";
+
+    Upsampler upsampler(octaves);
+    runner.run("resample/Upsampler " + factor, [&]() {
+      upsampler.write(x);
+      DSPVector sum;
+      for (int i = 0; i < (1 << octaves); ++i)
+      {
+        sum += upsampler.read();
+      }
+      return sum;
+    });
+
+    // write enough vectors at the high rate to make one at the low rate.
+    Downsampler downsampler(octaves);
+    runner.run("resample/Downsampler " + factor, [&]() {
+      for (int i = 0; i < (1 << octaves); ++i)
+      {
+        downsampler.write(x);
+      }
+      return downsampler.read();
+    });
+  }
+
+  constexpr int kRows{8};
+  const DSPVectorArray<kRows> xs = repeatRows<kRows>(x);
+  doNotOptimize(xs);
+  for (bool cheap : {false, true})
+  {
+    const std::string name = std::string("resample/HalfBandFilterBank<8> ") +
+                             (cheap ? "cheap " : "");
+    HalfBandFilterBank<kRows> bank(cheap);
+    DSPVectorArray<kRows> y1, y2;
+    runner.run(
+        name + "up 2x",
+        [&]() {
+          bank.upsample(xs, y1, y2);
+          return y1 + y2;
+        },
+        kRows);
+    runner.run(name + "down 2x", [&]() { return bank.downsample(xs, xs); }, kRows);
+  }
+
+  UpsamplerBank<kRows> upsamplerBank(2);
+  runner.run(
+      "resample/UpsamplerBank<8> 4x",
+      [&]() {
+        upsamplerBank.write(xs);
+        DSPVectorArray<kRows> sum;
+        for (int i = 0; i < 4; ++i)
+        {
+          sum += upsamplerBank.read();
+        }
+        return sum;
+      },
+      kRows);
+
+  DownsamplerBank<kRows> downsamplerBank(2);
+  runner.run(
+      "resample/DownsamplerBank<8> 4x",
+      [&]() {
+        for (int i = 0; i < 4; ++i)
+        {
+          downsamplerBank.write(xs);
+        }
+        return downsamplerBank.read();
+      },
+      kRows);
+}
+
+}  // namespace benchmark
+}  // namespace ml
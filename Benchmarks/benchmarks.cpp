@@ -0,0 +1,41 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// benchmarks.cpp
+// Run all the benchmarks. The SIMD back end is chosen when compiling: build with ML_USE_AVX
+// and AVX2 enabled, or for ARM, to measure the others. The runtime dispatched kernels are
+// measured at every level the machine supports.
+//
+// With --compare <base> <new>, compare two files of results instead, for example from before
+// and after a change, and return 1 if any benchmark got slower.
+
+#include "benchmark.h"
+
+using namespace ml;
+using namespace ml::benchmark;
+
+int main(int argc, char** argv)
+{
+  Runner runner(argc, argv);
+  if (runner.isComparing())
+  {
+    const int slower = compareResultFiles(runner.getBasePath(), runner.getNewPath(),
+                                          runner.getThresholdPercent());
+    return (slower != 0) ? 1 : 0;
+  }
+
+  std::string description = std::string("madronalib benchmarks, ") + getSIMDBackEndName() +
+                            " back end, " + getSIMDLevelName(detectSIMDLevel()) +
+                            " runtime dispatch";
+  runner.printHeader(description.c_str());
+
+  runOpsBenchmarks(runner);
+  runFiltersBenchmarks(runner);
+  runGensBenchmarks(runner);
+  runResamplersBenchmarks(runner);
+  runControlBenchmarks(runner);
+  runQueuesBenchmarks(runner);
+  runner.finish();
+  return 0;
+}
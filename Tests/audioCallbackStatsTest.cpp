@@ -0,0 +1,70 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// a unit test made using the Catch framework in catch.hpp / tests.cpp.
+
+#include <thread>
+
+#include "catch.hpp"
+#include "MLAudioCallbackStats.h"
+
+using namespace ml;
+
+TEST_CASE("madronalib/core/audio-callback-stats", "[stats]")
+{
+  AudioCallbackStats stats;
+  constexpr double kPeriod{0.001};
+
+  // loads of 10%, 55% and 120% of the period, the last with an xrun.
+  stats.record(0.0001, kPeriod, false);
+  stats.record(0.00055, kPeriod, false);
+  stats.record(0.0012, kPeriod, true);
+
+  auto s = stats.getSnapshot();
+  REQUIRE(s.callbacks == 3);
+  REQUIRE(s.xruns == 1);
+  REQUIRE(s.deadlineMisses == 1);
+  REQUIRE(s.histogram[2] == 1);
+  REQUIRE(s.histogram[11] == 1);
+  REQUIRE(s.histogram[AudioCallbackStats::kLoadBins] == 1);
+  REQUIRE(fabs(s.maxLoad - 1.2f) < 1e-4f);
+  REQUIRE(fabs(s.meanLoad - 0.6166667f) < 1e-4f);
+  REQUIRE(fabs(s.lastLoad - 1.2f) < 1e-4f);
+
+  // a reset takes effect at the next record.
+  stats.reset();
+  stats.record(0.0005, kPeriod, false);
+  s = stats.getSnapshot();
+  REQUIRE(s.callbacks == 1);
+  REQUIRE(s.xruns == 0);
+  REQUIRE(s.histogram[10] == 1);
+
+  // read while another thread records.
+  stats.reset();
+  constexpr int kCallbacks{100000};
+  std::thread audio(
+      [&]()
+      {
+        for (int i = 0; i < kCallbacks; ++i)
+        {
+          stats.record(kPeriod * (i % 10) / 10., kPeriod, (i % 1000) == 0);
+        }
+      });
+  uint64_t lastCount{0};
+  bool monotonic{true};
+  for (int i = 0; i < 1000; ++i)
+  {
+    uint64_t count = stats.getSnapshot().callbacks;
+    monotonic &= (count >= lastCount);
+    lastCount = count;
+  }
+  audio.join();
+  REQUIRE(monotonic);
+  s = stats.getSnapshot();
+  REQUIRE(s.callbacks == kCallbacks);
+  REQUIRE(s.xruns == kCallbacks / 1000);
+  uint64_t total{0};
+  for (auto h : s.histogram) total += h;
+  REQUIRE(total == kCallbacks);
+}
@@ -0,0 +1,120 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// a unit test made using the Catch framework in catch.hpp / tests.cpp.
+
+#include "catch.hpp"
+#include "MLAudioEngine.h"
+
+using namespace ml;
+
+namespace audioEngineTest
+{
+// write the input plus a constant, given by the state, to each output.
+void processOffset(AudioContext* ctx, void* state)
+{
+  float offset = *static_cast<float*>(state);
+  for (size_t c = 0; c < ctx->outputs.size(); ++c)
+  {
+    DSPVector x = (c < ctx->inputs.size()) ? ctx->inputs[c] : DSPVector();
+    ctx->outputs[c] = x + DSPVector(offset);
+  }
+}
+}  // namespace audioEngineTest
+
+using namespace audioEngineTest;
+
+TEST_CASE("madronalib/core/audio-engine/processes", "[audio-engine][threads]")
+{
+  AudioEngineConfig config;
+  config.workerThreads = 2;
+  config.firstWorkerCore = -1;
+  config.device.realtimeThread = false;
+  constexpr int kRate{48000};
+  AudioEngine engine(2, 4, kRate, config);
+  REQUIRE(engine.getNumWorkers() == 2);
+
+  // three stereo processes: two on outputs 0-1, with one of them reading the inputs, and one
+  // on outputs 2-3, hanging off the end of the device.
+  AudioContext ctxA(2, 2, kRate), ctxB(0, 2, kRate), ctxC(0, 3, kRate);
+  float offsetA{1.f}, offsetB{10.f}, offsetC{100.f};
+  engine.addProcess(&ctxA, processOffset, &offsetA, 0, 0);
+  engine.addProcess(&ctxB, processOffset, &offsetB, 0, 0);
+  engine.addProcess(&ctxC, processOffset, &offsetC, 0, 2);
+  REQUIRE(engine.getNumProcesses() == 3);
+
+  constexpr int kFrames{256};
+  std::vector<float> in0(kFrames, 0.5f), in1(kFrames, -0.5f);
+  std::vector<std::vector<float>> out(4, std::vector<float>(kFrames));
+  const float* inputs[2]{in0.data(), in1.data()};
+  float* outputs[4]{out[0].data(), out[1].data(), out[2].data(), out[3].data()};
+
+  for (int block = 0; block < 20; ++block)
+  {
+    engine.process(inputs, outputs, kFrames);
+  }
+  REQUIRE(out[0][kFrames - 1] == 11.5f);
+  REQUIRE(out[1][0] == 10.5f);
+  REQUIRE(out[2][7] == 100.f);
+  REQUIRE(out[3][kFrames - 1] == 100.f);
+}
+
+TEST_CASE("madronalib/core/audio-engine/drift", "[audio-engine]")
+{
+  // a writer at 48000 Hz in blocks of 128 and a reader 200 ppm faster in blocks of 96.
+  constexpr double kWriteRate{48000.};
+  constexpr double kReadRate{48000. * 1.0002};
+  constexpr size_t kWriteFrames{128}, kReadFrames{96};
+  constexpr size_t kTarget{512};
+
+  DriftCompensatedBuffer buf;
+  buf.resize(1, 256, kTarget);
+
+  std::vector<float> src(kWriteFrames), dest(kReadFrames);
+  const float* srcPtrs[1]{src.data()};
+  float* destPtrs[1]{dest.data()};
+
+  // a slow sine, so that interpolated output should stay smooth.
+  double writePhase{0.}, nextWrite{0.}, nextRead{0.};
+  float prev{0.f}, maxStep{0.f};
+  size_t maxFill{0}, minFill{kTarget * 4};
+  constexpr double kSeconds{120.};
+  while (nextWrite < kSeconds)
+  {
+    if (nextWrite <= nextRead)
+    {
+      for (auto& x : src)
+      {
+        x = float(sin(writePhase));
+        writePhase += 0.01;
+      }
+      buf.write(srcPtrs, kWriteFrames);
+      nextWrite += kWriteFrames / kWriteRate;
+    }
+    else
+    {
+      buf.read(destPtrs, kReadFrames);
+      if (nextRead > kSeconds / 2)
+      {
+        maxFill = std::max(maxFill, buf.getFramesAvailable());
+        minFill = std::min(minFill, buf.getFramesAvailable());
+        for (auto y : dest)
+        {
+          maxStep = std::max(maxStep, fabsf(y - prev));
+          prev = y;
+        }
+      }
+      prev = dest.back();
+      nextRead += kReadFrames / kReadRate;
+    }
+  }
+
+  // the ratio settles near the rate difference, and the fill stays near the target.
+  REQUIRE(fabs(buf.getRatio() - kWriteRate / kReadRate) < 0.00005);
+  REQUIRE(buf.getOverflowCount() == 0);
+  REQUIRE(buf.getUnderflowCount() == 0);
+  REQUIRE(minFill > kTarget / 2);
+  REQUIRE(maxFill < kTarget * 2);
+  REQUIRE(maxStep < 0.011f);
+}
@@ -0,0 +1,386 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// a unit test made using the Catch framework in catch.hpp / tests.cpp.
+
+#include "catch.hpp"
+#include "madronalib.h"
+#include "MLClapAdapter.h"
+#include "MLSynth.h"
+
+using namespace ml;
+
+namespace clapAdapterTest
+{
+// multiplies its input by the gain parameter, and records the gate of the first voice.
+class GainProcessor : public SignalProcessor
+{
+ public:
+  GainProcessor()
+  {
+    ParameterDescriptionList pdl;
+    pdl.push_back(std::make_unique<ParameterDescription>(WithValues{
+        {"name", "gain"}, {"range", {0, 2}}, {"plaindefault", 1.0}}));
+    buildParams(pdl);
+    setDefaultParams();
+    publishParams();
+    updateParamSnapshot();
+  }
+
+  void processVector(const DSPVectorDynamic& inputs, DSPVectorDynamic& outputs,
+                     void* stateData) override
+  {
+    auto* context = static_cast<AudioContext*>(stateData);
+    outputs[0] = inputs[0] * getRealFloatParam(size_t(0));
+    gate = context->getInputVoice(0).outputs.constRow(kGate)[kFloatsPerDSPVector - 1];
+  }
+
+  float gate{0};
+};
+
+// a clap_input_events list over a vector of events of any type.
+struct EventList
+{
+  std::vector<const clap_event_header_t*> headers;
+  clap_input_events_t list{this, size, get};
+
+  static uint32_t size(const clap_input_events_t* l)
+  {
+    return uint32_t(static_cast<const EventList*>(l->ctx)->headers.size());
+  }
+  static const clap_event_header_t* get(const clap_input_events_t* l, uint32_t i)
+  {
+    return static_cast<const EventList*>(l->ctx)->headers[i];
+  }
+};
+
+clap_event_param_value_t paramEvent(uint32_t time, clap_id id, double value)
+{
+  clap_event_param_value_t e{};
+  e.header = {sizeof(e), time, CLAP_CORE_EVENT_SPACE_ID, CLAP_EVENT_PARAM_VALUE, 0};
+  e.param_id = id;
+  e.note_id = e.port_index = e.channel = e.key = -1;
+  e.value = value;
+  return e;
+}
+
+clap_event_note_t noteEvent(uint32_t time, uint16_t type, int16_t key)
+{
+  clap_event_note_t e{};
+  e.header = {sizeof(e), time, CLAP_CORE_EVENT_SPACE_ID, type, 0};
+  e.note_id = -1;
+  e.key = key;
+  e.velocity = 1.0;
+  return e;
+}
+}  // namespace clapAdapterTest
+
+using namespace clapAdapterTest;
+
+TEST_CASE("madronalib/core/clap/process", "[clap]")
+{
+  constexpr uint32_t kFrames{kFloatsPerDSPVector * 4};
+  GainProcessor proc;
+  ClapProcessAdapter adapter(proc, 1, 1);
+  REQUIRE(adapter.getNormalizedParam(0) == Approx(0.5f));
+
+  clap_process_t process{};
+  REQUIRE(adapter.process(&process) == CLAP_PROCESS_ERROR);
+  adapter.activate(48000, kFrames);
+  adapter.getContext()->setInputPolyphony(1);
+
+  std::vector<float> in(kFrames, 1.f), out(kFrames, 0.f);
+  float* inPtr = in.data();
+  float* outPtr = out.data();
+  clap_audio_buffer_t inPort{&inPtr, nullptr, 1, 0, 0};
+  clap_audio_buffer_t outPort{&outPtr, nullptr, 1, 0, 0};
+
+  // the gain changes to 0.5 in the third vector, and a note starts.
+  auto p = paramEvent(kFloatsPerDSPVector * 2 + 10, 0, 0.25);
+  auto n = noteEvent(3, CLAP_EVENT_NOTE_ON, 60);
+  EventList events;
+  events.headers = {&n.header, &p.header};
+
+  process.frames_count = kFrames;
+  process.audio_inputs = &inPort;
+  process.audio_outputs = &outPort;
+  process.audio_inputs_count = 1;
+  process.audio_outputs_count = 1;
+  process.in_events = &events.list;
+  REQUIRE(adapter.process(&process) == CLAP_PROCESS_CONTINUE);
+
+  // the change lands on the vector that contains it.
+  REQUIRE(out[0] == 1.f);
+  REQUIRE(out[kFloatsPerDSPVector * 2 - 1] == 1.f);
+  REQUIRE(out[kFloatsPerDSPVector * 2] == 0.5f);
+  REQUIRE(out[kFrames - 1] == 0.5f);
+  REQUIRE(adapter.getNormalizedParam(0) == 0.25f);
+  REQUIRE(proc.gate == 1.f);
+
+  // flush() applies parameter changes without processing.
+  auto p2 = paramEvent(0, 0, 0.5);
+  events.headers = {&p2.header};
+  adapter.flush(&events.list);
+  REQUIRE(adapter.getNormalizedParam(0) == 0.5f);
+  events.headers.clear();
+  adapter.process(&process);
+  REQUIRE(out[0] == 1.f);
+}
+
+namespace clapAdapterTest
+{
+// a host whose thread pool runs the tasks on the calling thread.
+ClapProcessAdapter* gAdapter{nullptr};
+int gHostJobs{0};
+
+bool requestExec(const clap_host_t*, uint32_t numTasks)
+{
+  gHostJobs++;
+  for (uint32_t i = 0; i < numTasks; ++i)
+  {
+    gAdapter->execHostTask(i);
+  }
+  return true;
+}
+
+const clap_host_thread_pool_t kHostThreadPool{requestExec};
+
+const void* getExtension(const clap_host_t*, const char* id)
+{
+  return (std::string(id) == CLAP_EXT_THREAD_POOL) ? &kHostThreadPool : nullptr;
+}
+
+// renders every vector with a job on the host pool.
+class HostPoolProcessor : public SignalProcessor
+{
+ public:
+  void processVector(const DSPVectorDynamic&, DSPVectorDynamic& outputs, void*) override
+  {
+    bool ran = pool.run(pool.context, 4, addTask, this);
+    outputs[0] = DSPVector(ran ? float(sum) : -1.f);
+    sum = 0;
+  }
+  static void addTask(void* context, size_t i)
+  {
+    static_cast<HostPoolProcessor*>(context)->sum += int(i);
+  }
+
+  HostTaskPool pool;
+  int sum{0};
+};
+}  // namespace clapAdapterTest
+
+TEST_CASE("madronalib/core/clap/thread_pool", "[clap]")
+{
+  HostPoolProcessor proc;
+  ClapProcessAdapter adapter(proc, 0, 1);
+  gAdapter = &adapter;
+  REQUIRE(!adapter.getHostTaskPool());
+
+  clap_host_t host{};
+  host.get_extension = getExtension;
+  adapter.setHost(&host);
+  REQUIRE(adapter.hasHostThreadPool());
+  proc.pool = adapter.getHostTaskPool();
+  REQUIRE(proc.pool);
+
+  // jobs are refused outside of process().
+  REQUIRE(!proc.pool.run(proc.pool.context, 4, HostPoolProcessor::addTask, &proc));
+
+  adapter.activate(48000, kFloatsPerDSPVector * 2);
+  std::vector<float> out(kFloatsPerDSPVector * 2);
+  float* outPtr = out.data();
+  clap_audio_buffer_t outPort{&outPtr, nullptr, 1, 0, 0};
+  clap_process_t process{};
+  process.frames_count = kFloatsPerDSPVector * 2;
+  process.audio_outputs = &outPort;
+  process.audio_outputs_count = 1;
+  REQUIRE(adapter.process(&process) == CLAP_PROCESS_CONTINUE);
+  REQUIRE(gHostJobs == 2);
+  REQUIRE(out[0] == 6.f);
+  REQUIRE(out[kFloatsPerDSPVector * 2 - 1] == 6.f);
+}
+
+namespace clapAdapterTest
+{
+// each voice outputs its modulated cutoff parameter, scaled by its voice number.
+class ModSynth : public Synth
+{
+ public:
+  ModSynth() : Synth(2)
+  {
+    ParameterDescriptionList pdl;
+    pdl.push_back(std::make_unique<ParameterDescription>(WithValues{
+        {"name", "cutoff"}, {"range", {0, 1}}, {"plaindefault", 0.5}}));
+    buildParams(pdl);
+    setDefaultParams();
+    publishParams();
+    enableVoiceModulation();
+  }
+
+  void processVoice(int v, const EventsToSignals::Voice&, const DSPVectorDynamic&,
+                    DSPVectorDynamic& outputs, AudioContext*) override
+  {
+    outputs[0] += getVoiceParamVector(0, v) * DSPVector(v ? 10.f : 1.f);
+  }
+};
+
+clap_event_param_mod_t modEvent(uint32_t time, clap_id id, int16_t key, double amount)
+{
+  clap_event_param_mod_t e{};
+  e.header = {sizeof(e), time, CLAP_CORE_EVENT_SPACE_ID, CLAP_EVENT_PARAM_MOD, 0};
+  e.param_id = id;
+  e.note_id = e.port_index = e.channel = -1;
+  e.key = key;
+  e.amount = amount;
+  return e;
+}
+}  // namespace clapAdapterTest
+
+TEST_CASE("madronalib/core/clap/voice_modulation", "[clap]")
+{
+  ModSynth synth;
+  ClapProcessAdapter adapter(synth, 0, 1);
+  adapter.setVoiceModulation(&synth.getVoiceModulation());
+  adapter.activate(48000, kFloatsPerDSPVector * 2);
+  adapter.getContext()->setInputPolyphony(2);
+
+  std::vector<float> out(kFloatsPerDSPVector * 2);
+  float* outPtr = out.data();
+  clap_audio_buffer_t outPort{&outPtr, nullptr, 1, 0, 0};
+  clap_process_t process{};
+  process.frames_count = kFloatsPerDSPVector * 2;
+  process.audio_outputs = &outPort;
+  process.audio_outputs_count = 1;
+  EventList events;
+  process.in_events = &events.list;
+
+  // two notes, then a modulation of the second note's voice in the second vector.
+  auto n1 = noteEvent(0, CLAP_EVENT_NOTE_ON, 60);
+  auto n2 = noteEvent(1, CLAP_EVENT_NOTE_ON, 64);
+  auto m = modEvent(kFloatsPerDSPVector + 5, 0, 64, 0.25);
+  events.headers = {&n1.header, &n2.header, &m.header};
+  adapter.process(&process);
+  REQUIRE(out[0] == Approx(0.5f * 11));
+  REQUIRE(out[kFloatsPerDSPVector] == Approx(0.5f + 0.75f * 10));
+
+  // the offset follows changes to the base value, and a mod with no key reaches all voices.
+  auto p = paramEvent(0, 0, 0.25);
+  auto all = modEvent(kFloatsPerDSPVector, 0, -1, 0.5);
+  events.headers = {&p.header, &all.header};
+  adapter.process(&process);
+  REQUIRE(out[0] == Approx(0.25f + 0.5f * 10));
+  REQUIRE(out[kFloatsPerDSPVector] == Approx(0.75f * 11));
+}
+
+namespace clapAdapterTest
+{
+// outputs its input times the gain parameter, plus the gate of the first voice and the beat.
+class RecordedProcessor : public SignalProcessor
+{
+ public:
+  RecordedProcessor()
+  {
+    ParameterDescriptionList pdl;
+    pdl.push_back(std::make_unique<ParameterDescription>(WithValues{
+        {"name", "gain"}, {"range", {0, 2}}, {"plaindefault", 1.0}}));
+    buildParams(pdl);
+    setDefaultParams();
+    publishParams();
+  }
+
+  void processVector(const DSPVectorDynamic& inputs, DSPVectorDynamic& outputs,
+                     void* stateData) override
+  {
+    auto* context = static_cast<AudioContext*>(stateData);
+    outputs[0] = inputs[0] * getRealFloatParam(size_t(0)) +
+                 context->getInputVoice(0).outputs.constRow(kGate) +
+                 context->getBeatPhase() * DSPVector(0.01f);
+  }
+};
+}  // namespace clapAdapterTest
+
+TEST_CASE("madronalib/core/clap/record", "[clap]")
+{
+  constexpr uint32_t kMaxFrames{512};
+  const char* path = "clapAdapterTest.mlpr";
+  const std::vector<uint32_t> blockSizes{100, 37, 256, 64, 300, 128, 5, 512};
+
+  RecordedProcessor proc;
+  ClapProcessAdapter adapter(proc, 1, 1);
+  adapter.activate(48000, kMaxFrames);
+  adapter.getContext()->setInputPolyphony(1);
+  ProcessRecorder recorder(1, 1, 48000, kMaxFrames, true);
+  REQUIRE(recorder.start(path, 1));
+  adapter.setRecorder(&recorder);
+
+  std::vector<float> in(kMaxFrames), live;
+  std::vector<float> out(kMaxFrames);
+  float* inPtr = in.data();
+  float* outPtr = out.data();
+  clap_audio_buffer_t inPort{&inPtr, nullptr, 1, 0, 0};
+  clap_audio_buffer_t outPort{&outPtr, nullptr, 1, 0, 0};
+  clap_event_transport_t transport{};
+  transport.flags = CLAP_TRANSPORT_HAS_BEATS_TIMELINE | CLAP_TRANSPORT_HAS_TEMPO |
+                    CLAP_TRANSPORT_IS_PLAYING;
+  transport.tempo = 120.;
+  clap_process_t process{};
+  process.audio_inputs = &inPort;
+  process.audio_outputs = &outPort;
+  process.audio_inputs_count = 1;
+  process.audio_outputs_count = 1;
+  process.transport = &transport;
+  EventList events;
+  process.in_events = &events.list;
+
+  // ragged blocks of noise, with notes and parameter changes at odd times.
+  RandomScalarSource noise;
+  double beats{0.};
+  for (size_t b = 0; b < blockSizes.size(); ++b)
+  {
+    const uint32_t frames = blockSizes[b];
+    for (uint32_t i = 0; i < frames; ++i)
+    {
+      in[i] = noise.getFloat();
+    }
+    auto p = paramEvent(frames / 2, 0, 0.1 * double(b));
+    auto n = noteEvent(frames / 3, (b & 1) ? CLAP_EVENT_NOTE_OFF : CLAP_EVENT_NOTE_ON, 60);
+    events.headers = {&n.header, &p.header};
+    transport.song_pos_beats = clap_beattime(std::llround(beats * CLAP_BEATTIME_FACTOR));
+    beats += frames * 2. / 48000.;
+    process.frames_count = frames;
+    adapter.process(&process);
+    live.insert(live.end(), out.begin(), out.begin() + frames);
+  }
+  adapter.setRecorder(nullptr);
+  recorder.stop();
+  REQUIRE(recorder.getRecordedBlocks() == blockSizes.size());
+  REQUIRE(recorder.getDroppedBlocks() == 0);
+
+  // a new processor replays the session bit for bit.
+  ProcessReplayer replayer;
+  REQUIRE(replayer.open(path));
+  REQUIRE(replayer.getNumBlocks() == blockSizes.size());
+  REQUIRE(replayer.getTotalFrames() == live.size());
+  REQUIRE(replayer.hasInputAudio());
+
+  RecordedProcessor replayProc;
+  AudioContext context(replayer.getNumInputs(), replayer.getNumOutputs(),
+                       int(replayer.getSampleRate()));
+  context.setInputPolyphony(1);
+  std::vector<float> replayed(replayer.getTotalFrames());
+  float* replayedPtr = replayed.data();
+  REQUIRE(replayer.replay(replayProc, context, &replayedPtr));
+  REQUIRE(replayed == live);
+  std::remove(path);
+
+  // a full queue drops whole blocks.
+  ProcessRecorder small(1, 1, 48000, kMaxFrames, true, 1024);
+  const float* inputs[1]{in.data()};
+  small.recordParam(0, 0, 1.f);
+  small.recordBlock(inputs, 300);
+  small.recordBlock(inputs, 300);
+  REQUIRE(small.getRecordedBlocks() == 1);
+  REQUIRE(small.getDroppedBlocks() == 1);
+}
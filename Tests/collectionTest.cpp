@@ -6,6 +6,7 @@
 
 #include "catch.hpp"
 #include "MLCollection.h"
+#include "MLParallelForEach.h"
 
 using namespace ml;
 
@@ -137,3 +138,132 @@ TEST_CASE("madronalib/core/collection", "[collection]")
 
 }
 
+
+TEST_CASE("madronalib/core/collection/indexed", "[collection]")
+{
+  CollectionRoot< CollectableInt > ints;
+  ints.enableIndex();
+  REQUIRE(ints.isIndexed());
+
+  ints.add_unique< CollectableInt >("a", 3);
+  ints.add_unique< CollectableInt >("j", 4);
+  ints.add_unique< FancyCollectableInt >("a/b/c/d", 5);
+  ints.add_unique< CollectableInt >("a/b/c/f", 6);
+  ints.add_unique< CollectableInt >("k", 7);
+  ints.add_unique_with_collection< CollectableIntWithCollection >("a/b/c", 42);
+
+  REQUIRE(ints["a/b/c/d"]->value == 5);
+  REQUIRE(ints.find("a/b/c")->value == 42);
+  REQUIRE(!ints["a/b/xxx"]);
+  REQUIRE(!ints.find("a/b"));
+
+  int total{0};
+  forEach< CollectableInt >(ints, [&](const CollectableInt& i){ total += i.value; });
+  REQUIRE(total == 67);
+
+  int rootTotal{0};
+  forEachChild< CollectableInt >(ints, [&](const CollectableInt& i){ rootTotal += i.value; });
+  REQUIRE(rootTotal == 14);
+
+  // the object at the root of a subcollection is not in it.
+  auto subInts = getSubCollection(ints, "a");
+  REQUIRE(subInts.isIndexed());
+  int totala{0};
+  forEach< CollectableInt >(subInts, [&](const CollectableInt& i){ totala += i.value; });
+  REQUIRE(totala == 53);
+  int totalb{0};
+  forEach< CollectableInt >(inSubCollection(ints, "a"), [&](const CollectableInt& i){ totalb += i.value; });
+  REQUIRE(totala == totalb);
+
+  REQUIRE(!subInts["a"]);
+  REQUIRE(!subInts["b"]);
+  REQUIRE(subInts["b/c/d"]->value == 5);
+
+  // the subcollection made by add_unique_with_collection shares the index.
+  auto withCollection = dynamic_cast< CollectableIntWithCollection* >(ints.find("a/b/c").get());
+  REQUIRE(withCollection);
+  int totalc{0};
+  forEachChild< CollectableInt >(withCollection->_subCollection, [&](const CollectableInt& i){ totalc += i.value; });
+  REQUIRE(totalc == 11);
+
+  // objects added after a subcollection is made are seen by all.
+  subInts.add_unique< FancyCollectableInt >("b/the/new/guy", 99);
+  REQUIRE(ints["a/b/the/new/guy"]->value == 99);
+  REQUIRE(subInts.find("b/the/new/guy")->value == 99);
+  totala = 0;
+  forEach< CollectableInt >(subInts, [&](const CollectableInt& i){ totala += i.value; });
+  REQUIRE(totala == 53 + 99);
+  REQUIRE(ints.size() == 7);
+
+  // paths are relative to each collection.
+  std::vector< Path > paths;
+  Path currentPath;
+  forEach< CollectableInt >(subInts, [&](const CollectableInt& i){ paths.push_back(currentPath); }, &currentPath);
+  REQUIRE(paths.size() == 4);
+  REQUIRE(std::find(paths.begin(), paths.end(), Path("b/the/new/guy")) != paths.end());
+  REQUIRE(std::find(paths.begin(), paths.end(), Path("b/c")) != paths.end());
+
+  // the same objects in the same order as without the index.
+  CollectionRoot< CollectableInt > plain;
+  for (const auto& p : {"a", "j", "a/b/c/d", "a/b/c/f", "k", "a/b/c", "a/b/the/new/guy"})
+  {
+    plain.add_unique< CollectableInt >(p, ints[p]->value);
+  }
+  std::vector< int > indexedValues, plainValues;
+  forEach< CollectableInt >(ints, [&](const CollectableInt& i){ indexedValues.push_back(i.value); });
+  forEach< CollectableInt >(plain, [&](const CollectableInt& i){ plainValues.push_back(i.value); });
+  REQUIRE(indexedValues == plainValues);
+
+  ints.clear();
+  REQUIRE(!ints["a"]);
+  REQUIRE(!ints.size());
+  total = 0;
+  forEach< CollectableInt >(ints, [&](const CollectableInt& i){ total += i.value; });
+  REQUIRE(!total);
+}
+
+TEST_CASE("madronalib/core/collection/parallel", "[collection][threads]")
+{
+  WorkerPool pool(3);
+  constexpr int kObjects{1000};
+  for (bool indexed : {false, true})
+  {
+    CollectionRoot< CollectableInt > ints;
+    if (indexed) ints.enableIndex();
+    for (int i = 0; i < kObjects; ++i)
+    {
+      ints.add_unique< CollectableInt >(runtimePath(("group" + std::to_string(i % 7) + "/int" + std::to_string(i)).c_str()), i);
+    }
+
+    // each object is visited once, whatever the chunk size.
+    for (size_t chunkSize : {0, 1, 13, 5000})
+    {
+      parallelForEach< CollectableInt >(ints, pool, [](CollectableInt& i){ i.value += 1; }, chunkSize);
+    }
+    std::atomic< int > total{0};
+    parallelForEach< CollectableInt >(ints, pool, [&](CollectableInt& i){ total += i.value; });
+    REQUIRE(total == kObjects * (kObjects - 1) / 2 + kObjects * 4);
+
+    // a subcollection.
+    std::atomic< int > count{0};
+    auto group3 = getSubCollection(ints, "group3");
+    parallelForEach< CollectableInt >(group3, pool, [&](CollectableInt&){ count++; });
+    REQUIRE(count == 143);
+  }
+
+  Tree< float > tree;
+  for (int i = 0; i < kObjects; ++i)
+  {
+    tree[runtimePath(("a/b" + std::to_string(i)).c_str())] = float(i + 1);
+  }
+  std::vector< std::atomic< int > > seen(kObjects);
+  parallelVisitValues(tree, pool, [&](const Path& p, const float& v){
+    if (tree[p] == v) seen[int(v) - 1]++;
+  });
+  bool allSeenOnce{true};
+  for (auto& s : seen)
+  {
+    allSeenOnce &= (s.load() == 1);
+  }
+  REQUIRE(allSeenOnce);
+}
@@ -9,6 +9,12 @@
 #include "MLDSPBuffer.h"
 #include "MLDSPUtils.h"
 #include "MLDSPFunctional.h"
+#include "MLDSPFilters.h"
+#include "MLDSPLargeBuffer.h"
+#include "MLAudioThreadCheck.h"
+#include "MLMemoryUtils.h"
+#include "MLSignalProcessBuffer.h"
+#include "MLThreadTopology.h"
 
 using namespace ml;
 
@@ -183,10 +189,157 @@ TEST_CASE("madronalib/core/dspbuffer/overlap", "[dspbuffer][overlap]")
   REQUIRE(outputVec == outputVec2);
 }
 
+TEST_CASE("madronalib/core/dspbuffer/overlap-ops", "[dspbuffer][overlap]")
+{
+  // odd sizes so that the SIMD loops have scalar tails, and the writes wrap.
+  constexpr size_t kSamples = 77;
+  constexpr size_t kOverlap = 29;
+  constexpr size_t kHop = kSamples - kOverlap;
+  constexpr float kGain = 0.75f;
+
+  std::vector<float> src(kSamples), window(kSamples);
+  for (size_t i = 0; i < kSamples; ++i)
+  {
+    src[i] = 1.f + i * 0.01f;
+    window[i] = (i + 1.f) / kSamples;
+  }
+
+  DSPBuffer plain, scaled, windowed;
+  plain.resize(256);
+  scaled.resize(256);
+  windowed.resize(256);
+
+  for (int n = 0; n < 20; ++n)
+  {
+    plain.writeWithOverlapAdd(src.data(), kSamples, kOverlap);
+    scaled.writeWithOverlapAdd(src.data(), kGain, kSamples, kOverlap);
+    windowed.writeWindowedWithOverlapAdd(src.data(), window.data(), kSamples, kOverlap, kGain);
+
+    // after startup, each hop is the sum of the end of the last write and the start of this one.
+    std::vector<float> a(kHop), b(kHop), c(kHop);
+    REQUIRE(plain.read(a.data(), kHop) == kHop);
+    REQUIRE(scaled.read(b.data(), kHop) == kHop);
+    REQUIRE(windowed.read(c.data(), kHop) == kHop);
+    if (n == 0) continue;
+
+    bool ok{true};
+    for (size_t i = 0; i < kHop; ++i)
+    {
+      float expected = src[i];
+      float expectedWindowed = src[i] * window[i];
+      if (i < kOverlap)
+      {
+        expected += src[i + kHop];
+        expectedWindowed += src[i + kHop] * window[i + kHop];
+      }
+      ok &= (fabs(a[i] - expected) < 1e-5f);
+      ok &= (fabs(b[i] - expected * kGain) < 1e-5f);
+      ok &= (fabs(c[i] - expectedWindowed * kGain) < 1e-5f);
+    }
+    REQUIRE(ok);
+  }
+}
+
+TEST_CASE("madronalib/core/dspbuffer/overlap-add-function", "[dspbuffer][overlap]")
+{
+  constexpr int kFrameVectors = 4;
+  OverlapAddFunction<kFrameVectors, 4> ola;
+  using Frame = OverlapAddFunction<kFrameVectors, 4>::frameType;
+  auto identity = [](const Frame& x) { return x; };
+
+  // with an unchanged frame, the overlapped windows should sum to a delay.
+  std::vector<DSPVector> inputs;
+  float maxDiff{0.f};
+  for (int n = 0; n < 16; ++n)
+  {
+    inputs.push_back(columnIndex() + DSPVector(float(n * kFloatsPerDSPVector)));
+    DSPVector y = ola(inputs.back(), identity);
+    if (n >= kFrameVectors - 1)
+    {
+      maxDiff = std::max(maxDiff, max(abs(y - inputs[n - (kFrameVectors - 1)])));
+    }
+  }
+  REQUIRE(maxDiff < 1e-3f);
+}
+
+namespace
+{
+// run a sine at the given bin through a SpectralFunction and return the largest output
+// difference from the input, delayed by the latency and scaled by gain. The first two frames
+// are skipped, because the start of the sine has energy at all bins.
+template <int FRAME_VECTORS, int DIVISIONS, class Fn>
+float spectralError(float bin, Fn fn, float gain)
+{
+  SpectralFunction<FRAME_VECTORS, DIVISIONS> stft;
+  constexpr size_t kFrameSize = FRAME_VECTORS * kFloatsPerDSPVector;
+  auto input = [&](int n)
+  {
+    DSPVector t = columnIndex() + DSPVector(float(n * kFloatsPerDSPVector));
+    return sin(t * DSPVector(kTwoPi * bin / kFrameSize));
+  };
+  float maxDiff{0.f};
+  for (int n = 0; n < FRAME_VECTORS * 8; ++n)
+  {
+    DSPVector y = stft(input(n), fn);
+    if (n < FRAME_VECTORS * 2) continue;
+    DSPVector expected = input(n - (FRAME_VECTORS - 1)) * DSPVector(gain);
+    maxDiff = std::max(maxDiff, max(abs(y - expected)));
+  }
+  return maxDiff;
+}
+}  // namespace
+
+TEST_CASE("madronalib/core/dspbuffer/spectral-function", "[dspbuffer][overlap]")
+{
+  constexpr int kFrameVectors = 8;
+  using Spectrum = SpectralFunction<kFrameVectors, 4>::Spectrum;
+  auto identity = [](auto&) {};
+
+  // bins of the frame's spectrum, 256 with 64-sample vectors.
+  constexpr size_t kBins{kFrameVectors * kFloatsPerDSPVector / 2};
+
+  // an unchanged spectrum should give a delay, for any number of divisions.
+  REQUIRE(spectralError<kFrameVectors, 2>(7.3f, identity, 1.f) < 1e-4f);
+  REQUIRE(spectralError<kFrameVectors, 4>(7.3f, identity, 1.f) < 1e-4f);
+  REQUIRE(spectralError<kFrameVectors, 8>(7.3f, identity, 1.f) < 1e-4f);
+
+  // a brick-wall lowpass at a quarter of the bins should keep a sine at a sixteenth and remove
+  // one at a half.
+  auto lowpass = [](Spectrum& s)
+  {
+    for (size_t k = kBins / 4; k < s.real.size(); ++k)
+    {
+      s.real[k] = s.imag[k] = 0.f;
+    }
+  };
+  REQUIRE(spectralError<kFrameVectors, 4>(float(kBins / 16), lowpass, 1.f) < 1e-4f);
+  REQUIRE(spectralError<kFrameVectors, 4>(float(kBins / 2), lowpass, 0.f) < 1e-4f);
+
+  // the spectrum of a sine should have its peak at the sine's bin, and scaling it should
+  // scale the output.
+  size_t peak{0};
+  auto findPeak = [&](Spectrum& s)
+  {
+    for (size_t k = 0; k < s.real.size(); ++k)
+    {
+      float m = s.real[k] * s.real[k] + s.imag[k] * s.imag[k];
+      float p = s.real[peak] * s.real[peak] + s.imag[peak] * s.imag[peak];
+      if (m > p) peak = k;
+    }
+    for (size_t k = 0; k < s.real.size(); ++k)
+    {
+      s.real[k] *= 0.5f;
+      s.imag[k] *= 0.5f;
+    }
+  };
+  REQUIRE(spectralError<kFrameVectors, 4>(float(kBins / 8), findPeak, 0.5f) < 1e-4f);
+  REQUIRE(peak == kBins / 8);
+}
+
 TEST_CASE("madronalib/core/dspbuffer/vectors", "[dspbuffer][vectors]")
 {
   DSPBuffer buf;
-  buf.resize(256);
+  buf.resize(kFloatsPerDSPVector * 4);
 
   constexpr size_t kRows = 3;
   DSPVectorArray<kRows> inputVec, outputVec;
@@ -235,10 +388,123 @@ TEST_CASE("madronalib/core/dspbuffer/peek", "[dspbuffer][peek]")
   floatVec.resize(200);
   buf.peekMostRecent(floatVec.data(), 20);
 
-  REQUIRE(floatVec[0] == 109);
+  REQUIRE(floatVec[0] == 2 * kFloatsPerDSPVector - 19);
   REQUIRE(floatVec[19] == 128);
 }
 
+TEST_CASE("madronalib/core/dspbuffer/mirrored", "[dspbuffer][mirrored]")
+{
+  // a mirrored buffer is at least one page, and falls back to unmirrored where unsupported.
+  DSPBuffer buf;
+  size_t size = buf.resize(100, true);
+  REQUIRE(size >= 128);
+  REQUIRE((size & (size - 1)) == 0);
+#if ML_LINUX || ML_MAC
+  REQUIRE(buf.isMirrored());
+#endif
+  if (!buf.isMirrored()) return;
+
+  // write to near the end, then across the wrap point.
+  std::vector<float> input(size);
+  buf.write(input.data(), size - 10);
+  buf.discard(size - 10);
+  DSPVector v1(columnIndex());
+  buf.write(v1);
+
+  // the data can be read in place as one region.
+  REQUIRE(buf.getReadAvailable() == kFloatsPerDSPVector);
+  const float* pRead = buf.getReadPointer();
+  REQUIRE(std::equal(pRead, pRead + kFloatsPerDSPVector, v1.getConstBuffer()));
+  buf.discard(kFloatsPerDSPVector);
+
+  // and written in place.
+  float* pWrite = buf.getWritePointer();
+  std::copy(v1.getConstBuffer(), v1.getConstBuffer() + kFloatsPerDSPVector, pWrite);
+  buf.commitWrite(kFloatsPerDSPVector);
+  DSPVector v2 = buf.read();
+  REQUIRE(v2 == v1);
+
+  // copies are mirrored too.
+  buf.write(v1);
+  DSPBuffer copy(buf);
+  REQUIRE(copy.isMirrored());
+}
+
+void testMultiChannel(size_t channels)
+{
+  // interleaved frames where sample j of frame i is i * 100 + j. There are enough frames to
+  // read a whole DSPVector back.
+  constexpr size_t kFrames{std::max(size_t(150), size_t(kFloatsPerDSPVector))};
+  MultiChannelDSPBuffer buf;
+  REQUIRE(buf.resize(channels, kFrames + 50) == (kFrames > 150 ? 512 : 256));
+
+  std::vector<float> frames(kFrames * channels);
+  for (size_t i = 0; i < kFrames; ++i)
+  {
+    for (size_t j = 0; j < channels; ++j)
+    {
+      frames[i * channels + j] = i * 100.f + j;
+    }
+  }
+
+  // write twice so that the second write and read wrap.
+  std::vector<float> result(kFrames * channels);
+  for (int pass = 0; pass < 2; ++pass)
+  {
+    buf.writeInterleaved(frames.data(), kFrames);
+    REQUIRE(buf.getReadAvailable() == kFrames);
+    REQUIRE(buf.readInterleaved(result.data(), kFrames) == kFrames);
+    REQUIRE(result == frames);
+  }
+
+  // planar in, interleaved out, with a null input channel written as silence.
+  std::vector<std::vector<float>> planar(channels, std::vector<float>(kFrames));
+  std::vector<const float*> planarPtrs(channels);
+  for (size_t j = 0; j < channels; ++j)
+  {
+    for (size_t i = 0; i < kFrames; ++i)
+    {
+      planar[j][i] = frames[i * channels + j];
+    }
+    planarPtrs[j] = planar[j].data();
+  }
+  planarPtrs[0] = nullptr;
+  buf.writePlanar(planarPtrs.data(), kFrames);
+  buf.readInterleaved(result.data(), kFrames);
+  for (size_t i = 0; i < kFrames; ++i)
+  {
+    frames[i * channels] = 0.f;
+  }
+  REQUIRE(result == frames);
+
+  // vectors in, planar out.
+  DSPVectorDynamic vecs(channels);
+  for (size_t j = 0; j < channels; ++j)
+  {
+    vecs[j] = columnIndex() + DSPVector(j * 1000.f);
+  }
+  buf.write(vecs);
+  std::vector<float*> outPtrs(channels);
+  for (size_t j = 0; j < channels; ++j)
+  {
+    outPtrs[j] = planar[j].data();
+  }
+  REQUIRE(buf.readPlanar(outPtrs.data(), kFrames) == kFloatsPerDSPVector);
+  for (size_t j = 0; j < channels; ++j)
+  {
+    REQUIRE(DSPVector(planar[j].data()) == vecs[j]);
+  }
+  REQUIRE(!buf.read(vecs));
+}
+
+TEST_CASE("madronalib/core/dspbuffer/multichannel", "[dspbuffer][multichannel]")
+{
+  for (size_t channels : {1, 2, 3, 4, 8, 12})
+  {
+    testMultiChannel(channels);
+  }
+}
+
 TEST_CASE("madronalib/core/dspbuffer/vector", "[dspbuffer][peek]")
 {
 
@@ -248,4 +514,291 @@ TEST_CASE("madronalib/core/dspbuffer/vector", "[dspbuffer][peek]")
   DSPVectorDynamic dv;
 }
 
+TEST_CASE("madronalib/core/dspbuffer/signal_process_buffer", "[dspbuffer]")
+{
+  constexpr int kFrames{512};
+  AudioContext ctx(2, 2, 48000);
+  SignalProcessBuffer spb(2, 2, kFrames);
+
+  // count the vectors processed and write a scaled copy of each input.
+  int vectorsProcessed{0};
+  auto processFn = [](AudioContext* c, void* state) {
+    ++*static_cast<int*>(state);
+    c->outputs[0] = c->inputs[0] * DSPVector(2.f);
+    c->outputs[1] = c->inputs[1] * DSPVector(-1.f);
+  };
+
+  std::vector<float> in0(kFrames), in1(kFrames), out0(kFrames), out1(kFrames);
+  for (int i = 0; i < kFrames; ++i)
+  {
+    in0[i] = i;
+    in1[i] = kFrames - i;
+  }
+  const float* ins[2]{in0.data(), in1.data()};
+  float* outs[2]{out0.data(), out1.data()};
+
+  // blocks that are whole DSPVectors are processed with no latency.
+  for (int frames : {kFrames, 2 * int(kFloatsPerDSPVector), int(kFloatsPerDSPVector)})
+  {
+    vectorsProcessed = 0;
+    std::fill(out0.begin(), out0.end(), 0.f);
+    spb.process(ins, outs, frames, &ctx, processFn, &vectorsProcessed);
+    REQUIRE(vectorsProcessed == frames / kFloatsPerDSPVector);
+    bool correct{true};
+    for (int i = 0; i < frames; ++i)
+    {
+      correct &= (out0[i] == in0[i] * 2.f) && (out1[i] == -in1[i]);
+    }
+    REQUIRE(correct);
+  }
+
+  // a missing input is processed as silence.
+  const float* insMissing[2]{in0.data(), nullptr};
+  spb.process(insMissing, outs, kFloatsPerDSPVector, &ctx, processFn, &vectorsProcessed);
+  REQUIRE(out1[0] == 0.f);
+  REQUIRE(out1[kFloatsPerDSPVector - 1] == 0.f);
+}
+
+TEST_CASE("madronalib/core/dspbuffer/scratch_arena", "[dspbuffer]")
+{
+  ScratchArena arena(4096);
+  REQUIRE(arena.getCapacity() == 4096);
+
+  // allocations are aligned and initialized.
+  auto* pc = arena.allocate<char>(3);
+  auto* pv = arena.allocate<DSPVectorArray<2>>();
+  REQUIRE(pc != nullptr);
+  REQUIRE(pv != nullptr);
+  REQUIRE(reinterpret_cast<uintptr_t>(pv) % alignof(DSPVectorArray<2>) == 0);
+  REQUIRE((*pv)[kFloatsPerDSPVector * 2 - 1] == 0.f);
+  REQUIRE(arena.getBytesUsed() >= sizeof(DSPVectorArray<2>) + 3);
+
+  // an allocation that doesn't fit returns nullptr and is counted.
+  REQUIRE(arena.allocate<float>(4096) == nullptr);
+  REQUIRE(arena.getOverflowCount() == 1);
+
+  // reset() frees everything, but the high water mark stays.
+  size_t used = arena.getBytesUsed();
+  arena.reset();
+  REQUIRE(arena.getBytesUsed() == 0);
+  REQUIRE(arena.getHighWaterMark() == used);
+  REQUIRE(arena.allocate<float>(1024) != nullptr);
+  REQUIRE(arena.getOverflowCount() == 1);
+
+  // the AudioContext resets its arena at the start of every vector.
+  constexpr int kFrames{256};
+  AudioContext ctx(0, 1, 48000);
+  SignalProcessBuffer spb(0, 1, kFrames);
+  auto processFn = [](AudioContext* c, void*) {
+    auto* pTemp = c->scratch.allocate<DSPVectorArray<8>>();
+    c->outputs[0] = pTemp ? DSPVector(c->scratch.getBytesUsed()) : DSPVector(0.f);
+  };
+  std::vector<float> out0(kFrames);
+  float* outs[1]{out0.data()};
+  spb.process(nullptr, outs, kFrames, &ctx, processFn, nullptr);
+  REQUIRE(out0[0] == float(sizeof(DSPVectorArray<8>)));
+  REQUIRE(out0[kFrames - 1] == float(sizeof(DSPVectorArray<8>)));
+  REQUIRE(ctx.scratch.getOverflowCount() == 0);
+}
+
+TEST_CASE("madronalib/core/dspbuffer/load_meter", "[dspbuffer]")
+{
+  // each vector takes about 1/4 of its duration, so the load of a block is about 0.25.
+  constexpr int kFrames{256};
+  constexpr double kSr{48000.};
+  AudioContext ctx(0, 1, int(kSr));
+  SignalProcessBuffer spb(0, 1, kFrames);
+  auto processFn = [](AudioContext* c, void*) {
+    const double seconds = 0.25 * kFloatsPerDSPVector / kSr;
+    const uint64_t end = TickClock::now() + TickClock::secondsToTicks(seconds);
+    while (int64_t(TickClock::now() - end) < 0)
+    {
+    }
+    c->outputs[0] = DSPVector(0.f);
+  };
+  std::vector<float> out0(kFrames);
+  float* outs[1]{out0.data()};
+  REQUIRE(ctx.loadMeter.getLoad() == 0.f);
+  for (int i = 0; i < 4; ++i)
+  {
+    spb.process(nullptr, outs, kFrames, &ctx, processFn, nullptr);
+  }
+  const auto& meter = ctx.loadMeter;
+  REQUIRE(meter.getLoad() > 0.2f);
+  REQUIRE(meter.getPeakLoad() >= meter.getLoad());
+
+  // the smoothed load rises toward the load over kSmoothingSeconds.
+  REQUIRE(meter.getSmoothedLoad() > 0.f);
+  REQUIRE(meter.getSmoothedLoad() < meter.getLoad());
+
+  // a reset peak is cleared at the end of the next block.
+  ctx.loadMeter.resetPeak();
+  auto quickFn = [](AudioContext* c, void*) { c->outputs[0] = DSPVector(0.f); };
+  spb.process(nullptr, outs, kFrames, &ctx, quickFn, nullptr);
+  REQUIRE(meter.getPeakLoad() < 0.2f);
+}
+
+TEST_CASE("madronalib/core/dspbuffer/audio_thread_check", "[dspbuffer]")
+{
+  // violations can be recorded directly, and are counted by call site.
+  clearAudioThreadViolations();
+  for (int i = 0; i < 3; ++i)
+  {
+    recordAudioThreadViolation(AudioThreadViolationKind::kLock, 0x1234);
+  }
+  auto v = getAudioThreadViolations();
+  REQUIRE(v.size() == 1);
+  REQUIRE(v[0].kind == AudioThreadViolationKind::kLock);
+  REQUIRE(v[0].callSite == 0x1234);
+  REQUIRE(v[0].count == 3);
+  clearAudioThreadViolations();
+  REQUIRE(getAudioThreadViolationCount() == 0);
+
+  // allocations in a process function are found only when checking.
+  constexpr int kFrames{256};
+  AudioContext ctx(0, 1, 48000);
+  SignalProcessBuffer spb(0, 1, kFrames);
+  std::vector<std::vector<float>> allocations;
+  auto processFn = []([[maybe_unused]] AudioContext* c, void* state) {
+    REQUIRE(isMarkedAudioThread() == kCheckingAudioThread);
+    static_cast<std::vector<std::vector<float>>*>(state)->emplace_back(kFloatsPerDSPVector);
+  };
+  std::vector<float> out0(kFrames);
+  float* outs[1]{out0.data()};
+  spb.process(nullptr, outs, kFrames, &ctx, processFn, &allocations);
+  REQUIRE(!isMarkedAudioThread());
+  REQUIRE((getAudioThreadViolationCount() > 0) == kCheckingAudioThread);
+  clearAudioThreadViolations();
+}
+
+TEST_CASE("madronalib/core/dspbuffer/sample_formats", "[dspbuffer]")
+{
+  // integers convert exactly at full scale and round trip, including the samples after the
+  // last whole SIMD vector.
+  constexpr size_t kN{kFloatsPerSIMDVector * 3 + 3};
+  std::vector<int16_t> i16(kN);
+  for (size_t i = 0; i < kN; ++i) i16[i] = int16_t(int(i * 1000) - 32768);
+  std::vector<float> f(kN);
+  convertToFloats(i16.data(), SampleFormat::kInt16, f.data(), kN);
+  REQUIRE(f[0] == -1.f);
+  REQUIRE(f[kN - 1] == (int(kN - 1) * 1000 - 32768) / 32768.f);
+  std::vector<int16_t> i16b(kN);
+  convertFromFloats(f.data(), SampleFormat::kInt16, i16b.data(), kN);
+  REQUIRE(i16 == i16b);
+
+  // floats out of range are clamped.
+  const std::vector<float> loud{-2.f, 2.f, 0.5f, -0.5f, 1.f};
+  std::vector<int32_t> i32(loud.size());
+  convertFromFloats(loud.data(), SampleFormat::kInt32, i32.data(), loud.size());
+  REQUIRE(i32[0] == INT32_MIN);
+  REQUIRE(i32[1] > INT32_MAX - 256);
+  REQUIRE(i32[2] == 1 << 30);
+
+  // 24 bit samples are packed in 3 bytes and sign extended.
+  std::vector<uint8_t> i24(loud.size() * 3);
+  convertFromFloats(loud.data(), SampleFormat::kInt24, i24.data(), loud.size());
+  std::vector<float> back(loud.size());
+  convertToFloats(i24.data(), SampleFormat::kInt24, back.data(), loud.size());
+  REQUIRE(back[0] == -1.f);
+  REQUIRE(back[1] == 8388607.f / 8388608.f);
+  REQUIRE(back[3] == -0.5f);
+
+  // dither is at most one LSB either way, and averages to zero.
+  TPDFDither dither;
+  std::vector<float> quiet(4096, 0.25f / 32768.f);
+  std::vector<int16_t> dithered(quiet.size());
+  convertFromFloats(quiet.data(), SampleFormat::kInt16, dithered.data(), quiet.size(), &dither);
+  int sum{0};
+  bool inRange{true};
+  for (auto x : dithered)
+  {
+    inRange &= (x >= -1) && (x <= 1);
+    sum += x;
+  }
+  REQUIRE(inRange);
+  REQUIRE(std::abs(sum / float(dithered.size()) - 0.25f) < 0.05f);
+
+  // a SignalProcessBuffer reads and writes interleaved integers.
+  constexpr int kFrames{100};
+  AudioContext ctx(2, 2, 48000);
+  SignalProcessBuffer spb(2, 2, 256);
+  spb.setExternalFormat(SampleFormat::kInt16, true, false);
+  auto swapFn = [](AudioContext* c, void*) {
+    c->outputs[0] = c->inputs[1];
+    c->outputs[1] = c->inputs[0];
+  };
+  std::vector<int16_t> in(kFrames * 2), out(kFrames * 2);
+  for (int i = 0; i < kFrames; ++i)
+  {
+    in[i * 2] = int16_t(i);
+    in[i * 2 + 1] = int16_t(-i);
+  }
+  spb.process(in.data(), out.data(), kFrames, &ctx, swapFn, nullptr);
+  spb.process(in.data(), out.data(), kFrames, &ctx, swapFn, nullptr);
+
+  // after the first ragged block the output is delayed by the buffer's latency.
+  const int latency = int(spb.getLatencyInSamples());
+  bool swapped{true};
+  for (int i = latency; i < kFrames; ++i)
+  {
+    swapped &= (out[i * 2] == -(i - latency)) && (out[i * 2 + 1] == i - latency);
+  }
+  REQUIRE(swapped);
+}
+
+TEST_CASE("madronalib/core/dspbuffer/large_buffer", "[dspbuffer]")
+{
+  // buffers under minBytes come from the heap, larger ones are mapped and zeroed.
+  constexpr size_t kLarge{size_t(1) << 20};
+  const int node = getCPUTopology().getNode(0);
+  for (HugePages h : {HugePages::kNone, HugePages::kTransparent, HugePages::kExplicit})
+  {
+    LargeBufferPolicy policy;
+    policy.hugePages = h;
+    policy.numaNode = node;
+    LargeBuffer<float> small(1024, 0.f, LargeBufferAllocator<float>(policy));
+    LargeBuffer<float> large(kLarge, 0.f, LargeBufferAllocator<float>(policy));
+    REQUIRE(!largeBuffer::isMapped(small.size() * sizeof(float), policy));
+    REQUIRE(largeBuffer::isMapped(large.size() * sizeof(float), policy));
+    REQUIRE(std::all_of(large.begin(), large.end(), [](float x) { return x == 0.f; }));
+#if ML_LINUX
+    if (h == HugePages::kTransparent)
+    {
+      REQUIRE(reinterpret_cast<uintptr_t>(large.data()) % largeBuffer::kHugePageSize == 0);
+    }
+#endif
+
+    // copies and growth keep the policy.
+    large[kLarge - 1] = 1.f;
+    LargeBuffer<float> copy(large);
+    REQUIRE(copy.get_allocator() == large.get_allocator());
+    REQUIRE(copy[kLarge - 1] == 1.f);
+    copy.resize(kLarge * 3);
+    REQUIRE(copy[kLarge - 1] == 1.f);
+    REQUIRE(copy[kLarge * 3 - 1] == 0.f);
+  }
+
+  // a buffer can be moved to another policy, which clears it.
+  LargeBuffer<float> buffer(kLarge / 4, 1.f);
+  LargeBufferPolicy mapAll;
+  mapAll.minBytes = 0;
+  setBufferPolicy(buffer, mapAll);
+  REQUIRE(buffer.size() == kLarge / 4);
+  REQUIRE(buffer.get_allocator().getPolicy() == mapAll);
+  REQUIRE(buffer[0] == 0.f);
+
+  // a delay with a mapped buffer sounds the same as one on the heap.
+  IntegerDelay heap(1000);
+  IntegerDelay mapped;
+  mapped.setBufferPolicy(mapAll);
+  mapped.setMaxDelayInSamples(1000.f);
+  mapped.setDelayInSamples(1000);
+  REQUIRE(mapped.getMaxDelayInSamples() == heap.getMaxDelayInSamples());
+  for (int i = 0; i < 20; ++i)
+  {
+    const DSPVector x(columnIndex() + DSPVector(float(i * kFloatsPerDSPVector)));
+    REQUIRE(mapped(x) == heap(x));
+  }
+}
+
 }  // namespace dspBufferTest
@@ -6,8 +6,18 @@
 
 #include "catch.hpp"
 #include "MLTestUtils.h"
+#include "MLDSPChain.h"
+#include "MLDSPConvolver.h"
+#include "MLDSPDynamics.h"
+#include "MLDSPFDTD.h"
 #include "MLDSPFilters.h"
+#include "MLDSPFunctional.h"
+#include "MLDSPGens.h"
+#include "MLDSPGrainPlayer.h"
+#include "MLDSPResampler.h"
 #include "MLDSPSample.h"
+#include "MLDSPSamplePlayer.h"
+#include "MLDSPWaveshaper.h"
 
 using namespace ml;
 
@@ -59,3 +69,1542 @@ TEST_CASE("madronalib/core/dsp_filters", "[dsp_filters]")
     DSPVector sineOut = downer.read();
   }
 }
+
+TEST_CASE("madronalib/core/dsp_filters/svf_bank", "[dsp_filters]")
+{
+  // use an odd number of voices to test a partly filled SIMD vector.
+  constexpr size_t kVoices{5};
+  SVFBank<kVoices> bank;
+  LoShelf loShelf;
+  HiShelf hiShelf;
+  Bell bell;
+  Lopass lopass;
+
+  const float omega{0.05f}, k{0.7f}, A{2.f};
+  bank.setCoeffs(0, SVFBank<kVoices>::loShelfCoeffs(omega, k, A));
+  bank.setCoeffs(1, SVFBank<kVoices>::hiShelfCoeffs(omega, k, A));
+  bank.setCoeffs(2, SVFBank<kVoices>::bellCoeffs(omega, k, A));
+  bank.setCoeffs(3, SVFBank<kVoices>::lopassCoeffs(omega, k));
+  bank.setCoeffs(4, SVFBank<kVoices>::bandpassCoeffs(omega, k));
+  loShelf.coeffs = LoShelf::makeCoeffs({omega, k, A});
+  hiShelf.coeffs = HiShelf::makeCoeffs({omega, k, A});
+  bell.coeffs = Bell::makeCoeffs(omega, k, A);
+  lopass.coeffs = Lopass::makeCoeffs(omega, k);
+
+  NoiseGen noise;
+  float maxDiff{0.f};
+  for (int i = 0; i < 10; ++i)
+  {
+    DSPVector x = noise();
+    DSPVectorArray<kVoices> y = bank(repeatRows<kVoices>(x));
+    maxDiff = std::max(maxDiff, max(abs(y.constRow(0) - loShelf(x))));
+    maxDiff = std::max(maxDiff, max(abs(y.constRow(1) - hiShelf(x))));
+    maxDiff = std::max(maxDiff, max(abs(y.constRow(2) - bell(x))));
+
+    // Lopass uses a different but equivalent formulation.
+    maxDiff = std::max(maxDiff, max(abs(y.constRow(3) - lopass(x))));
+  }
+  REQUIRE(maxDiff < 1e-4f);
+
+  bank.clear();
+  DSPVectorArray<kVoices> silence = bank(DSPVectorArray<kVoices>(0.f));
+  REQUIRE(silence == DSPVectorArray<kVoices>(0.f));
+}
+
+TEST_CASE("madronalib/core/dsp_filters/chain", "[dsp_filters]")
+{
+  const float omega{0.05f}, k{0.7f};
+  auto shaper = [](SIMDVectorFloat x) { return vecTanhApprox(x); };
+  auto gain = [](float x) { return x * 0.5f; };
+  auto spread = [](const DSPVector& x) { return repeatRows<3>(x); };
+
+  // a chain gives the same result as the same stages called one after another.
+  auto voice = chain(Lopass{}, shaper, gain, spread, Bank<Lopass, 3>{});
+  static_assert(decltype(voice)::kStages == 5, "chain: stages");
+  voice.get<0>().coeffs = Lopass::makeCoeffs(omega, k);
+  Lopass lopass;
+  lopass.coeffs = Lopass::makeCoeffs(omega, k);
+  std::array<Lopass, 3> lopasses;
+  for (int j = 0; j < 3; ++j)
+  {
+    voice.get<4>()[j].coeffs = Lopass::makeCoeffs(omega * (j + 1), k);
+    lopasses[j].coeffs = Lopass::makeCoeffs(omega * (j + 1), k);
+  }
+
+  NoiseGen noise;
+  float maxDiff{0.f};
+  for (int i = 0; i < 10; ++i)
+  {
+    DSPVector x = noise() * 4.f;
+    DSPVectorArray<3> y = voice(x);
+    DSPVector shaped = map(gain, mapSIMD(shaper, lopass(x)));
+    for (int j = 0; j < 3; ++j)
+    {
+      maxDiff = std::max(maxDiff, max(abs(y.constRow(j) - lopasses[j](shaped))));
+    }
+  }
+  REQUIRE(maxDiff < 1e-6f);
+
+  // a stage without state that takes one DSPVector is applied to each row.
+  auto rows = chain([](const DSPVector& x) { return x * 2.f; }, [](float x) { return x - 1.f; });
+  DSPVectorArray<2> r = rows(DSPVectorArray<2>(1.f));
+  REQUIRE(r == DSPVectorArray<2>(1.f));
+
+  // a chain can be a stage of another chain.
+  auto outer = chain(rows, [](float x) { return x + 1.f; });
+  DSPVectorArray<2> s = outer(DSPVectorArray<2>(1.f));
+  REQUIRE(s == DSPVectorArray<2>(2.f));
+}
+
+TEST_CASE("madronalib/core/dsp_filters/coeffs", "[dsp_filters]")
+{
+  // the tan prewarp approximation, scalar and SIMD.
+  float maxTanError{0.f};
+  DSPVector omegas;
+  for (int i = 0; i < 1000; ++i)
+  {
+    float omega = 0.0001f + 0.4898f * i / 1000.f;
+    maxTanError = std::max(maxTanError, fabsf(tanPiApprox(omega) / tanf(kPi * omega) - 1.f));
+  }
+  for (int n = 0; n < kFloatsPerDSPVector; ++n)
+  {
+    omegas[n] = 0.001f + 0.48f * n / kFloatsPerDSPVector;
+  }
+  DSPVector tans = tanPiApprox(omegas);
+  for (int n = 0; n < kFloatsPerDSPVector; ++n)
+  {
+    maxTanError = std::max(maxTanError, fabsf(tans[n] / tanf(kPi * omegas[n]) - 1.f));
+  }
+  REQUIRE(maxTanError < 1e-5f);
+
+  // the coefficients of a whole SVFBank at once match those made one voice at a time.
+  constexpr size_t kVoices{7};
+  using Bank = SVFBank<kVoices>;
+  std::array<float, kVoices> omega, k, A;
+  for (size_t v = 0; v < kVoices; ++v)
+  {
+    omega[v] = 0.002f + 0.07f * v;
+    k[v] = 0.2f + 0.2f * v;
+    A[v] = 0.5f + 0.25f * v;
+  }
+  NoiseGen noise;
+  DSPVectorArray<kVoices> x = repeatRows<kVoices>(noise());
+  float maxDiff{0.f};
+  for (auto type : {Bank::lopass, Bank::hipass, Bank::bandpass, Bank::bell, Bank::loShelf,
+                    Bank::hiShelf})
+  {
+    Bank batch, single;
+    batch.setAllCoeffs(type, omega, k, A);
+    for (size_t v = 0; v < kVoices; ++v)
+    {
+      Bank::Coeffs c;
+      switch (type)
+      {
+        case Bank::lopass: c = Bank::lopassCoeffs(omega[v], k[v]); break;
+        case Bank::hipass: c = Bank::hipassCoeffs(omega[v], k[v]); break;
+        case Bank::bandpass: c = Bank::bandpassCoeffs(omega[v], k[v]); break;
+        case Bank::bell: c = Bank::bellCoeffs(omega[v], k[v], A[v]); break;
+        case Bank::loShelf: c = Bank::loShelfCoeffs(omega[v], k[v], A[v]); break;
+        case Bank::hiShelf: c = Bank::hiShelfCoeffs(omega[v], k[v], A[v]); break;
+      }
+      single.setCoeffs(v, c);
+    }
+    DSPVectorArray<kVoices> diff = abs(batch(x) - single(x));
+    for (size_t v = 0; v < kVoices; ++v)
+    {
+      maxDiff = std::max(maxDiff, max(diff.constRow(v)));
+    }
+  }
+  REQUIRE(maxDiff < 1e-4f);
+
+  // Lopass coefficients made a vector at a time.
+  DSPVector ks(0.5f);
+  auto coeffsVec = Lopass::makeCoeffsVec(omegas, ks);
+  float maxCoeffDiff{0.f};
+  for (int n = 0; n < kFloatsPerDSPVector; ++n)
+  {
+    auto c = Lopass::makeCoeffs(omegas[n], 0.5f);
+    for (int i = 0; i < Lopass::nCoeffs; ++i)
+    {
+      maxCoeffDiff = std::max(maxCoeffDiff, fabsf(coeffsVec.constRow(i)[n] - c[i]));
+    }
+  }
+  REQUIRE(maxCoeffDiff < 1e-6f);
+
+  // nearby parameters share an entry in the cache.
+  CoeffsCache<Lopass::Coeffs> cache;
+  auto makeLopass = [](float w, float k) { return Lopass::makeCoeffs(w, k); };
+  auto c1 = cache.get(0.1f, 0.5f, makeLopass);
+  auto c2 = cache.get(0.10001f, 0.5f, makeLopass);
+  REQUIRE(c1 == c2);
+  REQUIRE(cache.getHits() == 1);
+  REQUIRE(cache.getMisses() == 1);
+  cache.get(0.2f, 0.5f, makeLopass);
+  REQUIRE(cache.getMisses() == 2);
+  auto exact = Lopass::makeCoeffs(0.1f, 0.5f);
+  REQUIRE(c1[Lopass::g0] == Approx(exact[Lopass::g0]).epsilon(0.01));
+}
+
+TEST_CASE("madronalib/core/dsp_filters/meter_bank", "[dsp_filters]")
+{
+  // an odd number of channels tests a partly filled SIMD vector.
+  constexpr size_t kChannels{5};
+  constexpr float kSr{48000.f};
+  MeterBank<kChannels> meters;
+  meters.setSampleRate(kSr);
+  meters.setRMSTime(0.05f);
+  meters.setInterval(4);
+  meters.setLoudnessEnabled(true);
+
+  // one second of a 997 Hz sine at full scale in channel 0 and half scale in channel 2.
+  const int kVectors = int(kSr) / kFloatsPerDSPVector;
+  int readings{0};
+  int t{0};
+  for (int v = 0; v < kVectors; ++v)
+  {
+    DSPVectorArray<kChannels> x(0.f);
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      float s = sinf(kTwoPi * 997.f * float(t++) / kSr);
+      x.row(0)[n] = s;
+      x.row(2)[n] = s * 0.5f;
+    }
+    readings += meters(x);
+  }
+  REQUIRE(readings == kVectors / 4);
+  REQUIRE(meters.getPeak(0) == Approx(1.f).epsilon(0.01));
+  REQUIRE(meters.getPeak(2) == Approx(0.5f).epsilon(0.01));
+  REQUIRE(meters.getRMS(0) == Approx(sqrtf(0.5f)).epsilon(0.01));
+  REQUIRE(meters.getPeak(1) == 0.f);
+
+  // a full scale sine at 1 kHz measures -3.01 LUFS. The short-term window is a
+  // third full after one second.
+  REQUIRE(meters.getMomentaryLoudness(0) == Approx(-3.01f).margin(0.05));
+  REQUIRE(meters.getMomentaryLoudness(2) == Approx(-9.03f).margin(0.05));
+  REQUIRE(meters.getShortTermLoudness(0) == Approx(-3.01f - 4.77f).margin(0.05));
+  REQUIRE(meters.getMomentaryLoudness(1) < -100.f);
+
+  meters.clear();
+  REQUIRE(meters.getRMS(0) == 0.f);
+  REQUIRE(meters.getMomentaryMeanSquare(0) == 0.f);
+}
+
+TEST_CASE("madronalib/core/dsp_filters/block_svf", "[dsp_filters]")
+{
+  typedef SVFBank<1> Ref;
+  Ref ref;
+  BlockSVF block;
+  NoiseGen noise;
+
+  // one sample of the recursion with any coefficients, for checking interpolation.
+  float ic1eq{0.f}, ic2eq{0.f};
+  auto tick = [&](const Ref::Coeffs& c, float v0) {
+    float v3 = v0 - ic2eq;
+    float v1 = c[Ref::a1] * ic1eq + c[Ref::a2] * v3;
+    float v2 = ic2eq + c[Ref::a2] * ic1eq + c[Ref::a3] * v3;
+    ic1eq = 2 * v1 - ic1eq;
+    ic2eq = 2 * v2 - ic2eq;
+    return c[Ref::m0] * v0 + c[Ref::m1] * v1 + c[Ref::m2] * v2;
+  };
+
+  // constant coefficients: block evaluation should match the recursion.
+  auto c1 = Ref::lopassCoeffs(0.02f, 0.2f);
+  ref.setCoeffs(0, c1);
+  block.jumpCoeffs(c1);
+  float maxDiff{0.f};
+  for (int i = 0; i < 20; ++i)
+  {
+    DSPVector x = noise();
+    for (int n = 0; n < kFloatsPerDSPVector; ++n) tick(c1, x[n]);
+    maxDiff = std::max(maxDiff, max(abs(ref(x) - block(x))));
+  }
+  REQUIRE(maxDiff < 1e-4f);
+
+  // changed coefficients move linearly to the new ones over one vector.
+  auto c2 = Ref::bellCoeffs(0.1f, 0.5f, 2.f);
+  block.setCoeffs(c2);
+  DSPVector x = noise();
+  DSPVector interpolated = block(x);
+  DSPVector expected;
+  for (int n = 0; n < kFloatsPerDSPVector; ++n)
+  {
+    Ref::Coeffs c;
+    float t = (n + 1.f) / kFloatsPerDSPVector;
+    for (int i = 0; i < Ref::nCoeffs; ++i) c[i] = c1[i] + (c2[i] - c1[i]) * t;
+    expected[n] = tick(c, x[n]);
+  }
+  REQUIRE(max(abs(interpolated - expected)) < 1e-4f);
+
+  ref.setCoeffs(0, c2);
+  maxDiff = 0.f;
+  for (int i = 0; i < 200; ++i)
+  {
+    DSPVector x = noise();
+    DSPVector yRef = ref(x);
+    DSPVector yBlock = block(x);
+
+    // after the transient from the coefficient change has decayed
+    if (i > 100) maxDiff = std::max(maxDiff, max(abs(yRef - yBlock)));
+  }
+  REQUIRE(maxDiff < 1e-4f);
+
+  // a Butterworth lowpass passes sines below its cutoff and stops those far above it.
+  auto gainAt = [&](float freq) {
+    BlockSVF lopass;
+    lopass.jumpCoeffs(Ref::lopassCoeffs(0.01f, sqrtf(2.f)));
+    constexpr int kVectors = 8192 / kFloatsPerDSPVector;
+    float peak{0.f};
+    for (int i = 0; i < kVectors; ++i)
+    {
+      DSPVector sine;
+      for (int n = 0; n < kFloatsPerDSPVector; ++n)
+      {
+        sine[n] = sinf(kTwoPi * freq * (i * kFloatsPerDSPVector + n));
+      }
+      DSPVector y = lopass(sine);
+      if (i >= kVectors / 2) peak = std::max(peak, max(abs(y)));
+    }
+    return peak;
+  };
+  REQUIRE(gainAt(0.001f) == Approx(1.f).margin(0.01f));
+  REQUIRE(gainAt(0.01f) == Approx(sqrtf(0.5f)).margin(0.02f));
+  REQUIRE(gainAt(0.2f) < 0.005f);
+}
+
+TEST_CASE("madronalib/core/dsp_filters/convolver", "[dsp_filters]")
+{
+  // an impulse response that is not a whole number of DSPVectors.
+  constexpr size_t kIRLength{300};
+  constexpr int kVectors{12};
+  std::vector<float> ir(kIRLength);
+  NoiseGen irNoise;
+  for (auto& f : ir) f = irNoise.getSample();
+
+  Convolver conv(1000);
+  conv.setImpulseResponse(ir);
+
+  NoiseGen inputNoise;
+  std::vector<float> input, output;
+  for (int v = 0; v < kVectors; ++v)
+  {
+    DSPVector x = inputNoise();
+    DSPVector y = conv(x);
+    input.insert(input.end(), x.getConstBuffer(), x.getConstBuffer() + kFloatsPerDSPVector);
+    output.insert(output.end(), y.getConstBuffer(), y.getConstBuffer() + kFloatsPerDSPVector);
+  }
+
+  // compare with direct convolution after the first vector, which fades in.
+  float maxDiff{0.f};
+  for (size_t n = kFloatsPerDSPVector; n < input.size(); ++n)
+  {
+    float direct{0.f};
+    for (size_t k = 0; k < kIRLength && k <= n; ++k)
+    {
+      direct += ir[k] * input[n - k];
+    }
+    maxDiff = std::max(maxDiff, fabsf(direct - output[n]));
+  }
+  REQUIRE(maxDiff < 1e-3f);
+
+  // a new response is picked up, faded in over one vector, then used exactly.
+  std::vector<float> impulse{0.f, 0.f, 1.f};
+  conv.setImpulseResponse(impulse);
+  conv(inputNoise());
+  DSPVector x = inputNoise();
+  DSPVector y = conv(x);
+  REQUIRE(fabsf(y[10] - x[8]) < 1e-5f);
+
+  // responses are truncated to the maximum length.
+  std::vector<float> tooLong(5000, 0.f);
+  conv.setImpulseResponse(tooLong);
+  conv(x);
+  REQUIRE(max(abs(conv(x))) < 1e-6f);
+}
+
+TEST_CASE("madronalib/core/dsp_filters/multitap_delay", "[dsp_filters]")
+{
+  constexpr int kMaxDelay{200};
+  MultiTapDelay mtd(kMaxDelay);
+  IntegerDelay intDelay(37);
+  NoiseGen noise;
+
+  std::vector<float> history;
+  float maxLinearDiff{0.f};
+  float maxCubicDiff{0.f};
+  for (int v = 0; v < 20; ++v)
+  {
+    DSPVector x = noise();
+    history.insert(history.end(), x.getConstBuffer(), x.getConstBuffer() + kFloatsPerDSPVector);
+    mtd.write(x);
+
+    // integer delays match IntegerDelay, for every interpolation type.
+    DSPVector yInt = intDelay(x);
+    DSPVector d37(37.f);
+    REQUIRE(mtd.readLinear(d37) == yInt);
+    REQUIRE(mtd.readCubic(d37) == yInt);
+
+    // three taps with modulated fractional delays, kept in range for any vector size.
+    constexpr float kSlope{64.f / kFloatsPerDSPVector};
+    DSPVectorArray<3> delays(
+        concatRows(DSPVector(1.5f) + columnIndex() * DSPVector(kSlope),
+                   DSPVector(100.25f) - columnIndex() * DSPVector(0.5f * kSlope),
+                   rangeClosed(2.f, kMaxDelay)));
+    DSPVectorArray<3> yLinear = mtd.readLinear(delays);
+    DSPVectorArray<3> yCubic = mtd.readCubic(delays);
+
+    if (history.size() < kMaxDelay + 2 + kFloatsPerDSPVector) continue;  // let the delay fill
+    for (int j = 0; j < 3; ++j)
+    {
+      for (int n = 0; n < kFloatsPerDSPVector; ++n)
+      {
+        size_t now = history.size() - kFloatsPerDSPVector + n;
+        float d = delays.constRow(j)[n];
+        int di = static_cast<int>(d);
+        float t = d - di;
+        float x0 = history[now - di], x1 = history[now - di - 1];
+        maxLinearDiff = std::max(maxLinearDiff, fabsf(yLinear.constRow(j)[n] - lerp(x0, x1, t)));
+
+        // cubic interpolation should match a Catmull-Rom spline through the four samples
+        // around the tap, from the one after x0 in time to the one before x1.
+        float p0 = history[now - di + 1], p3 = history[now - di - 2];
+        float catmullRom = 0.5f * (2.f * x0 + (x1 - p0) * t +
+                                   (2.f * p0 - 5.f * x0 + 4.f * x1 - p3) * t * t +
+                                   (-p0 + 3.f * x0 - 3.f * x1 + p3) * t * t * t);
+        maxCubicDiff = std::max(maxCubicDiff, fabsf(yCubic.constRow(j)[n] - catmullRom));
+      }
+    }
+  }
+  REQUIRE(maxLinearDiff < 1e-6f);
+  REQUIRE(maxCubicDiff < 1e-5f);
+}
+
+TEST_CASE("madronalib/core/dsp_filters/matrix_fdn", "[dsp_filters]")
+{
+  constexpr size_t kSize{8};
+  std::array<float, kSize> times{{67, 73, 91, 103, 127, 151, 173, 199}};
+  std::array<float, kSize> gains;
+  gains.fill(0.9f);
+
+  auto makeFDN = [&](MatrixFDN<kSize, 4>& f) {
+    f.setDelaysInSamples(times);
+    f.setFilterCutoffs({{0.1f, 0.15f, 0.2f, 0.25f, 0.3f, 0.35f, 0.4f, 0.45f}});
+    f.setFeedbackGains(gains);
+  };
+
+  // Sylvester's construction of the normalized Hadamard matrix.
+  std::array<float, kSize * kSize> hadamard;
+  std::array<float, kSize * kSize> householder;
+  for (size_t i = 0; i < kSize; ++i)
+  {
+    for (size_t j = 0; j < kSize; ++j)
+    {
+      int parity{0};
+      for (size_t b = i & j; b; b &= b - 1) parity ^= 1;
+      hadamard[i * kSize + j] = (parity ? -1.f : 1.f) / sqrtf(kSize);
+      householder[i * kSize + j] = (i == j ? 1.f : 0.f) - 2.f / kSize;
+    }
+  }
+
+  // the fast matrices should match the same matrices applied directly.
+  using SetType = void (*)(MatrixFDN<kSize, 4>&);
+  std::pair<SetType, std::array<float, kSize * kSize>*> cases[] = {
+      {[](MatrixFDN<kSize, 4>& f) { f.setMatrixType<FDNMatrixType::kHadamard>(); }, &hadamard},
+      {[](MatrixFDN<kSize, 4>& f) { f.setMatrixType<FDNMatrixType::kHouseholder>(); },
+       &householder}};
+  for (auto& c : cases)
+  {
+    MatrixFDN<kSize, 4> fast, direct;
+    makeFDN(fast);
+    makeFDN(direct);
+    c.first(fast);
+    direct.setMatrix(*c.second);
+
+    DSPVector impulse;
+    impulse[0] = 1.f;
+    float maxDiff{0.f}, firstEnergy{0.f}, lastEnergy{0.f};
+    for (int v = 0; v < 100; ++v)
+    {
+      DSPVector x = (v == 0) ? impulse : DSPVector();
+      DSPVectorArray<4> a = fast(x);
+      DSPVectorArray<4> b = direct(x);
+      float e{0.f};
+      for (int j = 0; j < 4; ++j)
+      {
+        maxDiff = std::max(maxDiff, max(abs(a.constRow(j) - b.constRow(j))));
+        e += sum(a.constRow(j) * a.constRow(j));
+      }
+      if (v < 10) firstEnergy += e;
+      if (v >= 90) lastEnergy += e;
+    }
+    REQUIRE(maxDiff < 1e-5f);
+    REQUIRE(firstEnergy > 0.f);
+    REQUIRE(lastEnergy < firstEnergy);
+  }
+
+  // setting the delay times of an FDN allocates its lines.
+  FDN<4> fdn;
+  fdn.setDelaysInSamples({{67, 73, 91, 103}});
+  fdn.mFeedbackGains = {{0.5f, 0.5f, 0.5f, 0.5f}};
+  DSPVector impulse;
+  impulse[0] = 1.f;
+  float energy{0.f};
+  for (int v = 0; v < 10; ++v)
+  {
+    DSPVectorArray<2> y = fdn((v == 0) ? impulse : DSPVector());
+    energy += sum(y.constRow(0) * y.constRow(0));
+  }
+  REQUIRE(energy > 0.f);
+  REQUIRE(energy < 10.f);
+}
+
+TEST_CASE("madronalib/core/dsp_filters/half_precision_delays", "[dsp_filters]")
+{
+  // every half precision value converts to float and back, except NaNs which stay NaNs.
+  bool ok{true};
+  for (uint32_t b = 0; b < 0x10000; ++b)
+  {
+    Float16 h{uint16_t(b)};
+    float f = float16ToFloat(h);
+    ok &= std::isnan(f) ? ((b & 0x7C00) == 0x7C00) : (floatToFloat16(f).bits == b);
+  }
+  REQUIRE(ok);
+
+  // rounding at the ends of the range.
+  REQUIRE(floatToFloat16(1.f).bits == 0x3C00);
+  REQUIRE(floatToFloat16(65504.f).bits == 0x7BFF);
+  REQUIRE(floatToFloat16(65520.f).bits == 0x7C00);
+  REQUIRE(floatToFloat16(-1e-8f).bits == 0x8000);
+  REQUIRE(floatToFloat16(6e-8f).bits == 0x0001);
+  REQUIRE(floatToBFloat16(1.f).bits == 0x3F80);
+  REQUIRE(bFloat16ToFloat(floatToBFloat16(-3.f)) == -3.f);
+  REQUIRE(std::isnan(bFloat16ToFloat(floatToBFloat16(std::nanf("")))));
+
+  // buffer conversions match the scalar ones.
+  NoiseGen noise;
+  DSPVector x = noise() * DSPVector(100.f);
+  std::array<Float16, kFloatsPerDSPVector + 3> halves;
+  SampleStorage<Float16>::fromFloats(x.getConstBuffer(), halves.data(), halves.size() - 3);
+  DSPVector y;
+  SampleStorage<Float16>::toFloats(halves.data(), y.getBuffer(), kFloatsPerDSPVector);
+  for (int n = 0; n < kFloatsPerDSPVector; ++n)
+  {
+    ok &= (halves[n].bits == floatToFloat16(x[n]).bits);
+    ok &= (y[n] == float16ToFloat(halves[n]));
+  }
+  REQUIRE(ok);
+
+  // delays storing half precision samples delay them rounded.
+  IntegerDelay delay(75);
+  BasicIntegerDelay<Float16> delay16(75);
+  BasicIntegerDelay<BFloat16> delayB16(75);
+  for (int v = 0; v < 8; ++v)
+  {
+    DSPVector in = noise();
+    DSPVector y32 = delay(in);
+    DSPVector y16 = delay16(in);
+    DSPVector yB16 = delayB16(in);
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      ok &= (y16[n] == float16ToFloat(floatToFloat16(y32[n])));
+      ok &= (yB16[n] == bFloat16ToFloat(floatToBFloat16(y32[n])));
+    }
+    float s32 = delay.processSample(in[0]);
+    ok &= (delay16.processSample(in[0]) == float16ToFloat(floatToFloat16(s32)));
+    ok &= (delayB16.processSample(in[0]) == bFloat16ToFloat(floatToBFloat16(s32)));
+  }
+  REQUIRE(ok);
+
+  // a half precision FDN stays close to a float one.
+  constexpr size_t kSize{8};
+  std::array<float, kSize> times{{67, 73, 91, 103, 127, 151, 173, 199}};
+  std::array<float, kSize> gains;
+  gains.fill(0.9f);
+  MatrixFDN<kSize, 2> fdn;
+  MatrixFDN<kSize, 2, Float16> fdn16;
+  fdn.setDelaysInSamples(times);
+  fdn16.setDelaysInSamples(times);
+  fdn.setFeedbackGains(gains);
+  fdn16.setFeedbackGains(gains);
+  float maxDiff{0.f};
+  for (int v = 0; v < 50; ++v)
+  {
+    DSPVector in = (v == 0) ? noise() : DSPVector();
+    DSPVectorArray<2> a = fdn(in);
+    DSPVectorArray<2> b = fdn16(in);
+    maxDiff = std::max(maxDiff, max(abs(a.constRow(0) - b.constRow(0))));
+  }
+  REQUIRE(maxDiff < 1e-2f);
+}
+
+TEST_CASE("madronalib/core/dsp_filters/adsr_bank", "[dsp_filters]")
+{
+  constexpr int kVoices{kFloatsPerSIMDVector * 2};
+  constexpr float kSr{48000.f};
+  ADSRBank<kVoices> bank;
+  std::array<ADSR, kVoices> envs;
+  for (int v = 0; v < kVoices; ++v)
+  {
+    auto c = ADSR::calcCoeffs(0.001f * (v + 1), 0.002f * (v + 1), 0.1f * v, 0.003f, kSr);
+    bank.setCoeffs(v, c);
+    envs[v].coeffs = c;
+  }
+
+  // gates of different lengths and amps starting at different times. The last group of voices
+  // stays idle.
+  float maxDiff{0.f};
+  for (int i = 0; i < 40; ++i)
+  {
+    DSPVectorArray<kVoices> gates;
+    for (int v = 0; v < kVoices - kFloatsPerSIMDVector; ++v)
+    {
+      for (int n = 0; n < kFloatsPerDSPVector; ++n)
+      {
+        int t = i * kFloatsPerDSPVector + n;
+        bool on = (t >= v * 37) && (t < v * 37 + 600 + v * 100);
+        gates.row(v)[n] = on ? 0.5f + 0.05f * v : 0.f;
+      }
+    }
+
+    auto y = bank(gates);
+    for (int v = 0; v < kVoices; ++v)
+    {
+      DSPVector yv = envs[v](gates.constRow(v));
+      for (int n = 0; n < kFloatsPerDSPVector; ++n)
+      {
+        maxDiff = std::max(maxDiff, fabsf(y.constRow(v)[n] - yv[n]));
+      }
+    }
+  }
+  REQUIRE(maxDiff < 1e-5f);
+}
+
+TEST_CASE("madronalib/core/dsp_filters/resampler", "[dsp_filters]")
+{
+  // a sine at a fixed frequency in cycles per input sample.
+  constexpr double kFreq{0.05};
+  auto input = [&](double t) { return float(sin(kTwoPi * kFreq * t)); };
+
+  for (double ratio : {44100. / 48000., 48000. / 44100., 0.25, 2.5})
+  {
+    Resampler r(Resampler::Quality::kHigh, float(std::max(ratio, 1.)));
+    double latency = r.getLatency();
+    size_t inputRead{0};
+    float maxDiff{0.f};
+    std::vector<float> in(r.getMaxInput());
+    for (int v = 0; v < 50; ++v)
+    {
+      size_t nIn = r.getInputNeeded(ratio);
+      REQUIRE(nIn <= r.getMaxInput());
+      for (size_t i = 0; i < nIn; ++i)
+      {
+        in[i] = input(double(inputRead + i));
+      }
+      inputRead += nIn;
+      DSPVector y = r(in.data(), ratio);
+
+      // after the start, compare with the input at the output times.
+      if (v * kFloatsPerDSPVector < 256) continue;
+      for (int n = 0; n < kFloatsPerDSPVector; ++n)
+      {
+        double t = (v * kFloatsPerDSPVector + n) * ratio - latency;
+        maxDiff = std::max(maxDiff, fabsf(y[n] - input(t)));
+      }
+    }
+    REQUIRE(maxDiff < 2e-3f);
+    REQUIRE(fabs(inputRead - 50 * kFloatsPerDSPVector * ratio) < r.getMaxInput());
+  }
+
+  // resamplers with the same quality and cutoff share a kernel.
+  Resampler a, b;
+  REQUIRE(&a.getKernel() == &b.getKernel());
+
+  // downsampling by 2 removes what would alias.
+  Resampler down(Resampler::Quality::kHigh, 2.f);
+  std::vector<float> in(down.getMaxInput());
+  size_t inputRead{0};
+  float maxOut{0.f};
+  for (int v = 0; v < 50; ++v)
+  {
+    size_t nIn = down.getInputNeeded(2.);
+    for (size_t i = 0; i < nIn; ++i)
+    {
+      in[i] = float(sin(kTwoPi * 0.4 * double(inputRead + i)));
+    }
+    inputRead += nIn;
+    DSPVector y = down(in.data(), 2.);
+    if (v >= 4) maxOut = std::max(maxOut, max(abs(y)));
+  }
+  REQUIRE(maxOut < 0.01f);
+}
+
+TEST_CASE("madronalib/core/dsp_filters/sample_player", "[dsp_filters]")
+{
+  // a stereo ramp, with the right channel negated.
+  constexpr size_t kFrames{1000};
+  Sample ramp;
+  float* p = resize(ramp, kFrames, 2);
+  for (size_t i = 0; i < kFrames; ++i)
+  {
+    p[i * 2] = float(i);
+    p[i * 2 + 1] = -float(i);
+  }
+
+  // linear and cubic interpolation are exact on a ramp. A third output repeats the first.
+  using Player = SamplePlayer<3>;
+  for (auto interp : {Player::Interpolation::kLinear, Player::Interpolation::kCubic})
+  {
+    Player player(interp);
+    player.setSample(&ramp);
+    player.setPosition(10.);
+    DSPVector inc(columnIndex() * (1.f / 64.f) + DSPVector(0.25f));
+    auto y = player(inc);
+    double t{10.};
+    float maxDiff{0.f};
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      maxDiff = std::max(maxDiff, fabsf(y.row(0)[n] - float(t)));
+      maxDiff = std::max(maxDiff, fabsf(y.row(1)[n] + float(t)));
+      maxDiff = std::max(maxDiff, fabsf(y.row(2)[n] - float(t)));
+      t += inc[n];
+    }
+    REQUIRE(maxDiff < 1e-4f);
+    REQUIRE(fabs(player.getPosition() - t) < 1e-9);
+  }
+
+  // sinc interpolation of a slow sine.
+  constexpr double kFreq{0.03};
+  Sample sine;
+  float* ps = resize(sine, kFrames, 1);
+  for (size_t i = 0; i < kFrames; ++i)
+  {
+    ps[i] = float(sin(kTwoPi * kFreq * i));
+  }
+  SamplePlayer<1> sincPlayer(SamplePlayer<1>::Interpolation::kSinc);
+  sincPlayer.setSample(&sine);
+  sincPlayer.setPosition(100.);
+  DSPVector y = sincPlayer(DSPVector(0.7f)).row(0);
+  float maxDiff{0.f};
+  for (int n = 0; n < kFloatsPerDSPVector; ++n)
+  {
+    maxDiff = std::max(maxDiff, fabsf(y[n] - float(sin(kTwoPi * kFreq * (100. + 0.7 * n)))));
+  }
+  REQUIRE(maxDiff < 2e-3f);
+
+  // a loop without and with a crossfade.
+  SamplePlayer<1> looper(SamplePlayer<1>::Interpolation::kLinear);
+  looper.setSample(&ramp);
+  looper.setLoop(100, 200);
+  constexpr int kHalf = kFloatsPerDSPVector / 2;
+  looper.setPosition(200. - kHalf);
+  y = looper(DSPVector(1.f)).row(0);
+  REQUIRE(y[kHalf - 1] == 199.f);
+  REQUIRE(y[kHalf] == 100.f);
+
+  looper.setLoop(100, 200, 20);
+  looper.setPosition(170.);
+  y = looper(DSPVector(1.f)).row(0);
+  bool ok{true};
+  for (int n = 0; n < kFloatsPerDSPVector; ++n)
+  {
+    float pos = float(170 + n);
+    while (pos >= 200.f) pos -= 100.f;
+    float w = clamp((pos - 180.f) / 20.f, 0.f, 1.f);
+    ok &= fabsf(y[n] - (pos - 100.f * w)) < 1e-4f;
+  }
+  REQUIRE(ok);
+  REQUIRE(looper.isPlaying());
+
+  // without a loop, the output is silent after the end.
+  looper.clearLoop();
+  looper.setPosition(kFrames - 10.);
+  y = looper(DSPVector(1.f)).row(0);
+  REQUIRE(y[9] == float(kFrames - 1));
+  REQUIRE(y[10] == 0.f);
+  REQUIRE(!looper.isPlaying());
+}
+
+TEST_CASE("madronalib/core/dsp_filters/half_band_bank", "[dsp_filters]")
+{
+  // each row of a bank should match its own HalfBandFilter, with and without padded lanes.
+  auto testBank = [&](auto rowsConstant) {
+    constexpr int kRows = decltype(rowsConstant)::value;
+    HalfBandFilterBank<kRows> upBank, downBank;
+    std::array<HalfBandFilter, kRows> ups, downs;
+    DownsamplerBank<kRows> downsamplerBank(2);
+    std::vector<Downsampler> downsamplers(kRows, Downsampler(2));
+    UpsamplerBank<kRows> upsamplerBank(2);
+    std::vector<Upsampler> upsamplers(kRows, Upsampler(2));
+
+    float maxDiff{0.f};
+    auto compare = [&](const DSPVector& a, const DSPVector& b) {
+      maxDiff = std::max(maxDiff, max(abs(a - b)));
+    };
+
+    FastNoiseGen noise;
+    for (int i = 0; i < 8; ++i)
+    {
+      DSPVectorArray<kRows> x;
+      for (int j = 0; j < kRows; ++j)
+      {
+        x.row(j) = noise();
+      }
+
+      DSPVectorArray<kRows> y1, y2;
+      upBank.upsample(x, y1, y2);
+      DSPVectorArray<kRows> z = downBank.downsample(y1, y2);
+      bool bankReady = downsamplerBank.write(x);
+      upsamplerBank.write(x);
+
+      for (int j = 0; j < kRows; ++j)
+      {
+        DSPVector u1 = ups[j].upsampleFirstHalf(x.constRow(j));
+        DSPVector u2 = ups[j].upsampleSecondHalf(x.constRow(j));
+        compare(y1.constRow(j), u1);
+        compare(y2.constRow(j), u2);
+        compare(z.constRow(j), downs[j].downsample(u1, u2));
+
+        REQUIRE(downsamplers[j].write(x.constRow(j)) == bankReady);
+        if (bankReady) compare(downsamplerBank.read().constRow(j), downsamplers[j].read());
+
+        upsamplers[j].write(x.constRow(j));
+      }
+      for (int k = 0; k < 4; ++k)
+      {
+        const DSPVectorArray<kRows>& up = upsamplerBank.read();
+        for (int j = 0; j < kRows; ++j)
+        {
+          compare(up.constRow(j), upsamplers[j].read());
+        }
+      }
+    }
+    REQUIRE(maxDiff < 1e-6f);
+  };
+
+  testBank(std::integral_constant<int, 3>());
+  testBank(std::integral_constant<int, kFloatsPerSIMDVector * 2>());
+}
+
+TEST_CASE("madronalib/core/dsp_filters/oversample", "[dsp_filters]")
+{
+  // pass a low sine through each factor, and compare with the input delayed by the latency.
+  auto testFactor = [&](auto oversampler, int factor) {
+    constexpr float kFreq{0.005f};
+    int calls{0};
+    auto passthru = [&](const DSPVectorArray<2>& x) {
+      calls++;
+      return x;
+    };
+
+    float maxDiff{0.f};
+    float latency = oversampler.getLatency();
+    for (int v = 0; v < 20; ++v)
+    {
+      DSPVectorArray<2> x;
+      for (int n = 0; n < kFloatsPerDSPVector; ++n)
+      {
+        x.row(0)[n] = sinf(kTwoPi * kFreq * (v * kFloatsPerDSPVector + n));
+        x.row(1)[n] = -x.row(0)[n];
+      }
+      DSPVectorArray<2> y = oversampler(passthru, x);
+      if (v < 4) continue;
+      for (int n = 0; n < kFloatsPerDSPVector; ++n)
+      {
+        float expected = sinf(kTwoPi * kFreq * (v * kFloatsPerDSPVector + n - latency));
+        maxDiff = std::max(maxDiff, fabsf(y.row(0)[n] - expected));
+        maxDiff = std::max(maxDiff, fabsf(y.row(1)[n] + expected));
+      }
+    }
+    REQUIRE(calls == 20 * factor);
+    REQUIRE(maxDiff < 0.01f);
+    return latency;
+  };
+
+  float latency2 = testFactor(Oversample<2, 2>(), 2);
+  float latency8 = testFactor(Oversample<8, 2>(), 8);
+  float latency8Cheap = testFactor(Oversample<8, 2>(2), 8);
+  testFactor(Oversample<16, 2>(3), 16);
+
+  // the first octave dominates the latency, and cheaper filters have less.
+  REQUIRE(latency2 == Approx(2.f * HalfBandFilter::groupDelay() / 2.f));
+  REQUIRE(latency8 > latency2);
+  REQUIRE(latency8 < latency2 * 2.f);
+  REQUIRE(latency8Cheap < latency8);
+}
+
+TEST_CASE("madronalib/core/dsp_filters/control_rate", "[dsp_filters]")
+{
+  // frames that rise by 1 each period make a straight line at the audio rate.
+  auto testLine = [&](ControlRate<2>::Interpolation interp) {
+    constexpr int kPeriod{2};
+    constexpr float kPeriodSamples{kPeriod * kFloatsPerDSPVector};
+    ControlRate<2> control;
+    control.setPeriodInVectors(kPeriod);
+    control.setInterpolation(interp);
+    const float latency = float(control.getLatencyInSamples()) - kPeriodSamples;
+
+    int calls{0};
+    float maxDiff{0.f};
+    for (int v = 0; v < 20; ++v)
+    {
+      DSPVectorArray<2> y = control([&]() {
+        calls++;
+        return std::array<float, 2>{float(calls), -float(calls)};
+      });
+      if (v < kPeriod * 2) continue;
+      for (int n = 0; n < kFloatsPerDSPVector; ++n)
+      {
+        float expected = (v * kFloatsPerDSPVector + n + 1 - latency) / kPeriodSamples;
+        maxDiff = std::max(maxDiff, fabsf(y.row(0)[n] - expected));
+        maxDiff = std::max(maxDiff, fabsf(y.row(1)[n] + expected));
+      }
+    }
+    REQUIRE(calls == 20 / kPeriod);
+    REQUIRE(maxDiff < 1e-4f);
+  };
+  testLine(ControlRate<2>::Interpolation::kLinear);
+  testLine(ControlRate<2>::Interpolation::kSmooth);
+
+  // an ADSRBank run once every 4 vectors, with coefficients for the control rate, follows the
+  // same bank at the audio rate. Since the bank runs a period ahead, it has one period less
+  // latency than the frames above.
+  constexpr int kVoices{kFloatsPerSIMDVector};
+  constexpr int kPeriod{4};
+  constexpr float kSr{48000.f};
+  ADSRBank<kVoices> audioEnvs, controlEnvs;
+  audioEnvs.setCoeffs(ADSR::calcCoeffs(0.1f, 0.2f, 0.5f, 0.2f, kSr));
+  controlEnvs.setCoeffs(ADSR::calcCoeffs(0.1f, 0.2f, 0.5f, 0.2f, kSr / kPeriod));
+  ControlRate<kVoices> control;
+  control.setPeriodInVectors(kPeriod);
+
+  float maxDiff{0.f};
+  const int latencyVectors = control.getLatencyInSamples() / kFloatsPerDSPVector - kPeriod;
+  std::vector<DSPVectorArray<kVoices>> audioOut;
+  // times in vectors for 64-sample vectors, scaled to keep the same times in samples.
+  auto vectors = [](int n) { return n * 64 / kFloatsPerDSPVector; };
+  for (int v = 0; v < vectors(800); ++v)
+  {
+    // a gate for about 0.5 seconds.
+    DSPVectorArray<kVoices> gates((v >= vectors(40)) && (v < vectors(400)) ? 1.f : 0.f);
+    audioOut.push_back(audioEnvs(gates));
+    DSPVectorArray<kVoices> y = control([&]() { return controlEnvs(gates); });
+    if (v < latencyVectors) continue;
+    const DSPVectorArray<kVoices>& expected = audioOut[v - latencyVectors];
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      maxDiff = std::max(maxDiff, fabsf(y.row(0)[n] - expected.constRow(0)[n]));
+    }
+    if (v == vectors(300)) REQUIRE(y.row(kVoices - 1)[0] == Approx(0.5f).margin(0.001f));
+  }
+  REQUIRE(maxDiff < 0.05f);
+}
+
+TEST_CASE("madronalib/core/dsp_filters/fdtd", "[dsp_filters]")
+{
+  // an odd size, so that some cells are left over after whole SIMD vectors.
+  constexpr int kWidth{37}, kHeight{20};
+  FDTDSurface surface(kWidth, kHeight, 7);
+  FDTDSurface reversed(kWidth, kHeight, 7);
+  REQUIRE(surface.getNumStrips() == 3);
+  auto c = surface.getCoeffs(0.01f, 48000.f, 2.f, 3.f);
+
+  // a scalar model with the same stencil, with a border of zeros around each grid.
+  constexpr int kStride{kWidth + 2};
+  std::vector<float> u0((kHeight + 2) * kStride), u1(u0), u2(u0);
+  auto at = [&](std::vector<float>& u, int x, int y) -> float&
+  { return u[(y + 1) * kStride + x + 1]; };
+
+  float maxDiff{0.f};
+  bool sameOrder{true};
+  for (int t = 0; t < 40; ++t)
+  {
+    if (t < 3)
+    {
+      surface.excite(5 + t, 9, 1.f);
+      reversed.excite(5 + t, 9, 1.f);
+      at(u1, 5 + t, 9) += 1.f;
+    }
+
+    surface.step(c);
+
+    // strips can be computed in any order.
+    reversed.beginStep(c);
+    for (int s = reversed.getNumStrips() - 1; s >= 0; --s)
+    {
+      FDTDSurface::stepStrip(&reversed, size_t(s));
+    }
+    reversed.endStep();
+
+    for (int y = 0; y < kHeight; ++y)
+    {
+      for (int x = 0; x < kWidth; ++x)
+      {
+        float f = c.kc * at(u1, x, y);
+        f += c.ke * (at(u1, x - 1, y) + at(u1, x + 1, y) + at(u1, x, y - 1) + at(u1, x, y + 1));
+        f += c.kk * (at(u1, x - 1, y - 1) + at(u1, x + 1, y - 1) + at(u1, x - 1, y + 1) +
+                     at(u1, x + 1, y + 1));
+        f += c.kc2 * at(u2, x, y);
+        f += c.ke2 * (at(u2, x - 1, y) + at(u2, x + 1, y) + at(u2, x, y - 1) + at(u2, x, y + 1));
+        at(u0, x, y) = f;
+      }
+    }
+    std::swap(u2, u1);
+    std::swap(u1, u0);
+
+    for (int y = 0; y < kHeight; ++y)
+    {
+      for (int x = 0; x < kWidth; ++x)
+      {
+        maxDiff = std::max(maxDiff, fabsf(surface.get(x, y) - at(u1, x, y)));
+        sameOrder &= (reversed.get(x, y) == surface.get(x, y));
+      }
+    }
+  }
+  REQUIRE(maxDiff < 1e-5f);
+  REQUIRE(sameOrder);
+  REQUIRE(surface.get(6, 9) != 0.f);
+}
+
+TEST_CASE("madronalib/core/dsp_filters/short_feedback_loop", "[dsp_filters]")
+{
+  // a comb with a loop of 10 samples, shorter than a DSPVector. The impulse comes after the
+  // warmup of the pitchbendable delay.
+  constexpr int kLoop{10};
+  constexpr int kStart{20};
+  FeedbackDelayFunction comb;
+  comb.setMaxDelayInSamples(64.f);
+  comb.feedbackGain = 0.5f;
+  auto identity = [](float x) { return x; };
+
+  // the impulse is at sample kStart of the whole output, in whichever vector holds it.
+  constexpr int kVectors{192 / kFloatsPerDSPVector};
+  std::vector<float> output;
+  for (int v = 0; v < kVectors; ++v)
+  {
+    DSPVector x;
+    if (v == kStart / kFloatsPerDSPVector) x[kStart % kFloatsPerDSPVector] = 1.f;
+    DSPVector y = comb.processSamples(x, identity, DSPVector(float(kLoop)));
+    output.insert(output.end(), y.getConstBuffer(), y.getConstBuffer() + kFloatsPerDSPVector);
+  }
+
+  float maxDiff{0.f};
+  for (int n = 0; n < int(output.size()); ++n)
+  {
+    int k = (n - kStart) / kLoop;
+    bool echo = (n >= kStart) && ((n - kStart) % kLoop == 0);
+    float expected = echo ? powf(0.5f, float(k)) : 0.f;
+    maxDiff = std::max(maxDiff, fabsf(output[n] - expected));
+  }
+  REQUIRE(maxDiff < 1e-6f);
+
+  // the per-sample delay matches the vector one.
+  PitchbendableDelay a, b;
+  a.setMaxDelayInSamples(64.f);
+  b.setMaxDelayInSamples(64.f);
+  DSPVector x = columnIndex();
+  DSPVector delay = DSPVector(3.5f) + columnIndex() * DSPVector(0.1f);
+  DSPVector ya = a(x, delay);
+  DSPVector yb;
+  for (int n = 0; n < kFloatsPerDSPVector; ++n)
+  {
+    yb[n] = b.processSample(x[n], delay[n], n);
+  }
+  REQUIRE(max(abs(ya - yb)) < 1e-6f);
+}
+
+TEST_CASE("madronalib/core/dsp_filters/modal_bank", "[dsp_filters]")
+{
+  // one mode's impulse response is gain * r^n * sin((n + 1) w).
+  {
+    constexpr float kOmega{0.01f}, kT60{500.f}, kGain{0.5f};
+    ModalBank bank(1);
+    bank.setMode(0, kOmega, kT60, kGain);
+    DSPVector impulse;
+    impulse[0] = 1.f;
+    float maxDiff{0.f};
+    const double r = exp(-log(1000.) / kT60);
+    for (int v = 0; v < 4; ++v)
+    {
+      DSPVector y = bank(v == 0 ? impulse : DSPVector());
+      for (int i = 0; i < kFloatsPerDSPVector; ++i)
+      {
+        int n = v * kFloatsPerDSPVector + i;
+        double expected = kGain * pow(r, n) * sin((n + 1) * kTwoPi * kOmega);
+        maxDiff = std::max(maxDiff, float(fabs(y[i] - expected)));
+      }
+    }
+    REQUIRE(maxDiff < 1e-4f);
+  }
+
+  // a bank of more than 256 modes, set in one batch, should match the sum of the modes run
+  // one at a time.
+  constexpr size_t kModes{300};
+  std::vector<float> omega(kModes), t60(kModes), gain(kModes);
+  for (size_t i = 0; i < kModes; ++i)
+  {
+    omega[i] = 0.001f + 0.4f * i / kModes;
+    t60[i] = 200.f + 10.f * i;
+    gain[i] = 1.f / (1 + i);
+  }
+  ModalBank bank(kModes);
+  bank.setModes(omega.data(), t60.data(), gain.data(), kModes);
+  REQUIRE(bank.getNumModes() == kModes);
+
+  std::vector<ModalBank> singles(kModes);
+  for (size_t i = 0; i < kModes; ++i)
+  {
+    singles[i].setNumModes(1);
+    singles[i].setMode(0, omega[i], t60[i], gain[i]);
+  }
+
+  RandomScalarSource noise;
+  float maxDiff{0.f};
+  for (int v = 0; v < 4; ++v)
+  {
+    DSPVector x;
+    for (int i = 0; i < kFloatsPerDSPVector; ++i)
+    {
+      x[i] = noise.getFloat();
+    }
+    DSPVector y = bank(x);
+    DSPVector sum;
+    for (auto& s : singles)
+    {
+      sum += s(x);
+    }
+    maxDiff = std::max(maxDiff, max(abs(y - sum)));
+  }
+  REQUIRE(maxDiff < 1e-3f);
+
+  // with all the gains set to zero and the state cleared, the bank should be silent.
+  std::fill(gain.begin(), gain.end(), 0.f);
+  bank.setModes(omega.data(), t60.data(), gain.data(), kModes);
+  bank.clear();
+  REQUIRE(bank(DSPVector(1.f)) == DSPVector(0.f));
+}
+
+TEST_CASE("madronalib/core/dsp_filters/grain_player", "[dsp_filters]")
+{
+  constexpr size_t kFrames{1000};
+  Sample ramp;
+  float* p = resize(ramp, kFrames, 1);
+  for (size_t i = 0; i < kFrames; ++i)
+  {
+    p[i] = float(i);
+  }
+  const Projection flat([](float) { return 1.f; });
+
+  // with a flat window, linear and cubic reads of a ramp are exact, forwards and backwards.
+  // The grain starts at its offset in the first vector and ends after its length.
+  for (bool cubic : {false, true})
+  {
+    for (float rate : {0.5f, -0.75f})
+    {
+      GrainPlayer<1> player(16, cubic);
+      player.setSample(&ramp);
+      player.setWindow(flat);
+      constexpr int kOffset{5};
+      constexpr float kLength{kFloatsPerDSPVector * 3 / 2 + 4};
+      REQUIRE(player.trigger({500.25, rate, kLength, 1.f, 0.f}, kOffset));
+      float maxDiff{0.f};
+      for (int v = 0; v < 3; ++v)
+      {
+        DSPVector y = player().row(0);
+        for (int i = 0; i < kFloatsPerDSPVector; ++i)
+        {
+          int age = v * int(kFloatsPerDSPVector) + i - kOffset;
+          bool inGrain = (age >= 0) && (age < kLength);
+          float expected = inGrain ? 500.25f + rate * age : 0.f;
+          maxDiff = std::max(maxDiff, fabsf(y[i] - expected));
+        }
+      }
+      REQUIRE(maxDiff < 1e-3f);
+      REQUIRE(player.getActiveGrains() == 0);
+    }
+  }
+
+  // the window multiplies the grain, and reads outside the sample are silent.
+  {
+    GrainPlayer<1> player(16, false);
+    player.setSample(&ramp);
+    player.trigger({-10., 1.f, 64.f, 1.f, 0.f});
+    DSPVector y = player().row(0);
+    float maxDiff{0.f};
+    for (int i = 0; i < kFloatsPerDSPVector; ++i)
+    {
+      float w = dspwindows::raisedCosine(i / 64.f);
+      float expected = (i >= 10) ? (i - 10) * w : 0.f;
+      maxDiff = std::max(maxDiff, fabsf(y[i] - expected));
+    }
+    REQUIRE(maxDiff < 1e-3f);
+  }
+
+  // a panned stereo grain.
+  {
+    GrainPlayer<2> player(16, false);
+    player.setSample(&ramp);
+    player.setWindow(flat);
+    player.trigger({100., 0.f, 64.f, 1.f, -1.f});
+    auto y = player();
+    REQUIRE(y.constRow(0) == DSPVector(100.f));
+    REQUIRE(max(abs(y.constRow(1))) < 1e-4f);
+  }
+
+  // a cloud starts grains at its density, up to the size of the pool.
+  {
+    GrainPlayer<1> player(8);
+    player.setSample(&ramp);
+    GrainPlayer<1>::Cloud cloud;
+    cloud.density = 8.f / kFloatsPerDSPVector;
+    cloud.grain = {500., 1.f, 64.f, 1.f, 0.f};
+    cloud.positionJitter = 100.f;
+    player.setCloud(cloud);
+    player();
+    REQUIRE(player.getActiveGrains() == 8);
+    REQUIRE(player.getDroppedGrains() == 0);
+
+    // longer grains overlap more than the pool holds.
+    cloud.grain.length = 1000.f;
+    player.setCloud(cloud);
+    player();
+    player();
+    REQUIRE(player.getActiveGrains() == 8);
+    REQUIRE(player.getDroppedGrains() > 0);
+
+    // a high load lowers the limit, and it recovers when the load is low.
+    player.updateLoad(1.f);
+    REQUIRE(player.getGrainLimit() == 7);
+    REQUIRE(!player.trigger(cloud.grain));
+    for (int i = 0; i < 4; ++i)
+    {
+      player.updateLoad(0.1f);
+    }
+    REQUIRE(player.getGrainLimit() == player.getMaxGrains());
+  }
+}
+
+TEST_CASE("madronalib/core/dsp_filters/waveshaper", "[dsp_filters]")
+{
+  const Projection tanhShape([](float x) { return tanhf(x); });
+
+  // the table matches the shape, and inputs outside the domain are clamped.
+  {
+    Waveshaper<1> shaper(tanhShape, {-3.f, 3.f});
+    DSPVector x = columnIndex() * DSPVector(8.f / kFloatsPerDSPVector) - DSPVector(4.f);
+    DSPVector y = shaper(x);
+    float maxDiff{0.f};
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      maxDiff = std::max(maxDiff, fabsf(y[n] - tanhf(clamp(x[n], -3.f, 3.f))));
+    }
+    REQUIRE(maxDiff < 1e-4f);
+    REQUIRE(shaper.getLatency() == 0.f);
+  }
+
+  // with ADAA, a slow input gives the shape of the input delayed by half a sample.
+  {
+    Waveshaper<1> shaper(tanhShape, {-3.f, 3.f}, true);
+    REQUIRE(shaper.getLatency() == 0.5f);
+    auto input = [](int n) { return 2.f * sinf(kTwoPi * 0.002f * n); };
+    float maxDiff{0.f};
+    for (int v = 0; v < 4; ++v)
+    {
+      DSPVector x;
+      for (int i = 0; i < kFloatsPerDSPVector; ++i)
+      {
+        x[i] = input(v * int(kFloatsPerDSPVector) + i);
+      }
+      DSPVector y = shaper(x);
+      for (int i = (v == 0); i < kFloatsPerDSPVector; ++i)
+      {
+        int n = v * int(kFloatsPerDSPVector) + i;
+        float expected = tanhf(0.5f * (input(n) + input(n - 1)));
+        maxDiff = std::max(maxDiff, fabsf(y[i] - expected));
+      }
+    }
+    REQUIRE(maxDiff < 1e-3f);
+  }
+
+  // a hard clipper driven by a sine at bin 427 of 4096 has its 7th harmonic alias at bin 1107.
+  // ADAA and oversampling should both lower it.
+  const Projection clipShape([](float x) { return clamp(x, -1.f, 1.f); });
+  constexpr int kSize{4096};
+  constexpr int kWarmupVectors{8};
+  auto aliasLevel = [&](auto&& shaper) {
+    std::vector<float> out;
+    for (int v = 0; v < kWarmupVectors + kSize / int(kFloatsPerDSPVector); ++v)
+    {
+      DSPVector x;
+      for (int i = 0; i < kFloatsPerDSPVector; ++i)
+      {
+        x[i] = 2.f * sinf(kTwoPi * 427.f * (v * int(kFloatsPerDSPVector) + i) / kSize);
+      }
+      DSPVector y = shaper(x);
+      if (v < kWarmupVectors) continue;
+      out.insert(out.end(), y.getConstBuffer(), y.getConstBuffer() + kFloatsPerDSPVector);
+    }
+    double re{0.}, im{0.};
+    for (int n = 0; n < kSize; ++n)
+    {
+      re += out[n] * cos(kTwoPi * 1107. * n / kSize);
+      im += out[n] * sin(kTwoPi * 1107. * n / kSize);
+    }
+    return sqrt(re * re + im * im) * 2. / kSize;
+  };
+  double plain = aliasLevel(Waveshaper<1>(clipShape, {-4.f, 4.f}));
+  double adaa = aliasLevel(Waveshaper<1>(clipShape, {-4.f, 4.f}, true));
+  double oversampled = aliasLevel(Waveshaper<4>(clipShape, {-4.f, 4.f}));
+  REQUIRE(plain > 1e-3);
+  REQUIRE(adaa < plain * 0.5);
+  REQUIRE(oversampled < plain * 0.1);
+}
+
+TEST_CASE("madronalib/core/dsp_filters/diffuser_bank", "[dsp_filters]")
+{
+  constexpr int kRows{kFloatsPerSIMDVector + 2};
+  auto impulse = [](int v) {
+    DSPVectorArray<kRows> x;
+    if (v == 0)
+    {
+      for (int j = 0; j < kRows; ++j)
+      {
+        x.row(j)[0] = 1.f;
+      }
+    }
+    return x;
+  };
+
+  // one stage with the same delay on every row matches Allpass.
+  {
+    DiffuserBank<kRows> bank;
+    bank.resize(1, 200);
+    bank.setDelayInSamples(0, 150.f);
+    bank.setGain(0, 0.6f);
+    Allpass<IntegerDelay> ap;
+    ap.setMaxDelayInSamples(200.f);
+    ap.setDelayInSamples(150.f);
+    ap.mGain = 0.6f;
+    float maxDiff{0.f};
+    for (int v = 0; v < 20; ++v)
+    {
+      auto y = bank(impulse(v));
+      DSPVector ya = ap(impulse(v).constRow(0));
+      for (int j = 0; j < kRows; ++j)
+      {
+        maxDiff = std::max(maxDiff, max(abs(y.constRow(j) - ya)));
+      }
+    }
+    REQUIRE(maxDiff < 1e-6f);
+  }
+
+  // chains with nested stages and different delays on each row are still allpass: all the
+  // energy of an impulse comes out.
+  DiffuserBank<kRows> bank;
+  bank.resize(5, 400);
+  const float delays[5]{31.f, 113.f, 7.f, 241.f, 59.f};
+  for (int s = 0; s < 5; ++s)
+  {
+    for (int j = 0; j < kRows; ++j)
+    {
+      bank.setDelayInSamples(s, j, delays[s] + 3.f * j);
+    }
+    bank.setGain(s, 0.5f);
+  }
+  bank.setNested(2, true);
+  std::vector<double> energy(kRows, 0.);
+  std::vector<DSPVectorArray<kRows>> unmodulated;
+  for (int v = 0; v < 400; ++v)
+  {
+    auto y = bank(impulse(v));
+    unmodulated.push_back(y);
+    for (int j = 0; j < kRows; ++j)
+    {
+      energy[j] += sum(y.constRow(j) * y.constRow(j));
+    }
+  }
+  for (int j = 0; j < kRows; ++j)
+  {
+    REQUIRE(std::fabs(energy[j] - 1.0) < 1e-3);
+  }
+
+  // the rows differ within the first 64 samples.
+  bool rowsDiffer{false};
+  for (int v = 0; v < 64 / kFloatsPerDSPVector; ++v)
+  {
+    rowsDiffer |= !(unmodulated[v].constRow(0) == unmodulated[v].constRow(1));
+  }
+  REQUIRE(rowsDiffer);
+
+  // clearing restarts the same response.
+  bank.clear();
+  REQUIRE(bank(impulse(0)) == unmodulated[0]);
+
+  // modulated stages stay stable and change the response.
+  bank.clear();
+  bank.setModulation(3, 8.f, 0.5f / 48000.f);
+  float peak{0.f};
+  bool changed{false};
+  for (int v = 0; v < 400; ++v)
+  {
+    auto y = bank(impulse(v));
+    changed |= !(y == unmodulated[v]);
+    for (int j = 0; j < kRows; ++j)
+    {
+      peak = std::max(peak, max(abs(y.constRow(j))));
+    }
+  }
+  REQUIRE(peak < 2.f);
+  REQUIRE(changed);
+}
+
+TEST_CASE("madronalib/core/dsp_filters/dynamics", "[dsp_filters]")
+{
+  // SlidingMax matches the maximum of each window.
+  RandomScalarSource r;
+  std::vector<float> signal(kFloatsPerDSPVector * 40);
+  for (auto& x : signal)
+  {
+    x = std::fabs(r.getFloat());
+  }
+  for (int w : {1, 5, 64, 100, 300})
+  {
+    SlidingMax sm(w);
+    int errors{0};
+    for (int v = 0; v < 40; ++v)
+    {
+      DSPVector x(signal.data() + v * kFloatsPerDSPVector);
+      DSPVector y = sm(x);
+      for (int n = 0; n < kFloatsPerDSPVector; ++n)
+      {
+        const int t = v * kFloatsPerDSPVector + n;
+        float expected{0.f};
+        for (int k = std::max(0, t - w + 1); k <= t; ++k)
+        {
+          expected = std::max(expected, signal[k]);
+        }
+        errors += (y[n] != expected);
+      }
+    }
+    REQUIRE(errors == 0);
+  }
+
+  // the limiter keeps linked peaks under the ceiling, and delays quiet signals unchanged.
+  constexpr int kLookahead{48};
+  LookaheadLimiter<2> limiter;
+  limiter.setSampleRate(48000.f);
+  limiter.setLookaheadInSamples(kLookahead);
+  limiter.setCeiling(0.5f);
+  limiter.setReleaseTimeInSeconds(0.01f);
+  REQUIRE(limiter.getLatencyInSamples() == kLookahead);
+  float peak{0.f};
+  for (int v = 0; v < 100; ++v)
+  {
+    DSPVectorArray<2> x;
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      x.row(0)[n] = r.getFloat() * ((v % 7 == 3) ? 4.f : 1.f);
+      x.row(1)[n] = r.getFloat() * 0.3f;
+    }
+    auto y = limiter(x);
+    peak = std::max({peak, max(abs(y.constRow(0))), max(abs(y.constRow(1)))});
+  }
+  REQUIRE(peak <= 0.5f * 1.00001f);
+  REQUIRE(peak > 0.4f);
+
+  LookaheadLimiter<1> quiet;
+  quiet.setLookaheadInSamples(kLookahead);
+  DSPVectorArray<1> q(columnIndex() * DSPVector(0.01f));
+  std::vector<float> qy;
+  while (qy.size() < size_t(kLookahead + kFloatsPerDSPVector))
+  {
+    auto y = quiet(q);
+    qy.insert(qy.end(), y.constRow(0).getConstBuffer(),
+              y.constRow(0).getConstBuffer() + kFloatsPerDSPVector);
+  }
+  bool delayed{true};
+  for (int n = 0; n < kFloatsPerDSPVector; ++n)
+  {
+    delayed &= (qy[kLookahead + n] == q.constRow(0)[n]);
+  }
+  REQUIRE(delayed);
+
+  // the compressor reduces a steady 0 dB signal by (1 - 1 / ratio) of its level over the
+  // threshold.
+  LookaheadCompressor<1> comp;
+  comp.setSampleRate(48000.f);
+  comp.setLookaheadInSamples(32);
+  comp.setThresholdInDb(-12.f);
+  comp.setRatio(4.f);
+  comp.setAttackTimeInSeconds(0.001f);
+  comp.setReleaseTimeInSeconds(0.05f);
+
+  // long enough to settle after the release, at any vector size.
+  constexpr int kSettleVectors{12800 / kFloatsPerDSPVector};
+  for (int v = 0; v < kSettleVectors; ++v)
+  {
+    comp(DSPVectorArray<1>(1.f));
+  }
+  REQUIRE(std::fabs(comp.getGainReductionInDb() + 9.f) < 0.01f);
+  auto cy = comp(DSPVectorArray<1>(1.f));
+  REQUIRE(std::fabs(cy.constRow(0)[0] - std::pow(10.f, -9.f / 20.f)) < 1e-3f);
+
+  // with a soft knee, a signal at the threshold is reduced by a little.
+  comp.setKneeInDb(6.f);
+  for (int v = 0; v < kSettleVectors; ++v)
+  {
+    comp(DSPVectorArray<1>(std::pow(10.f, -12.f / 20.f)));
+  }
+  REQUIRE(comp.getGainReductionInDb() < -0.1f);
+  REQUIRE(comp.getGainReductionInDb() > -1.f);
+}
+
+TEST_CASE("madronalib/core/dsp_filters/uniform", "[dsp_filters]")
+{
+  REQUIRE(isUniform(DSPVector(0.f)));
+  REQUIRE(isUniform(DSPVector(0.25f)));
+  REQUIRE(!isUniform(columnIndex()));
+  DSPVector nearly(1.f);
+  nearly[kFloatsPerDSPVector - 1] = 1.0001f;
+  REQUIRE(!isUniform(nearly));
+
+  // a lopass with uniform parameters makes its coefficients once, matching stored coefficients.
+  const float omega{0.01f}, k{0.5f};
+  Lopass modulated, fixed;
+  fixed.coeffs = Lopass::makeCoeffs(omega, k);
+  NoiseGen noise;
+  bool match{true};
+  for (int i = 0; i < 10; ++i)
+  {
+    const DSPVector x = noise();
+    match &= (modulated(x, DSPVector(omega), DSPVector(k)) == fixed(x));
+  }
+  REQUIRE(match);
+  REQUIRE(modulated.coeffsParams == Lopass::Params{omega, k});
+
+  // with a ramp, the coefficients are made for each sample, and come out close.
+  Lopass ramped, fresh;
+  fresh.coeffs = Lopass::makeCoeffs(omega, k);
+  DSPVector omegaRamp = DSPVector(omega) + columnIndex() * DSPVector(1e-7f);
+  const DSPVector x = noise();
+  const DSPVector y1 = ramped(x, omegaRamp, DSPVector(k));
+  const DSPVector y2 = fresh(x);
+  REQUIRE(max(abs(y1 - y2)) < 1e-3f);
+
+  // a fractional delay with a uniform delay time matches the per-sample path.
+  FractionalDelay uniformDelay, perSample;
+  uniformDelay.setMaxDelayInSamples(100.f);
+  perSample.setMaxDelayInSamples(100.f);
+  match = true;
+  for (int i = 0; i < 10; ++i)
+  {
+    const DSPVector in = noise();
+    const float d = (i < 5) ? 20.3f : 41.7f;
+    DSPVector expected;
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      perSample.setDelayInSamples(d);
+      expected[n] = perSample.processSample(in[n]);
+    }
+    match &= (uniformDelay(in, DSPVector(d)) == expected);
+  }
+  REQUIRE(match);
+}
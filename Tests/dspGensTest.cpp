@@ -45,3 +45,344 @@ TEST_CASE("madronalib/core/dsp_gens", "[dsp_gens]")
 
   
 }
+
+TEST_CASE("madronalib/core/dsp_gens/noise", "[dsp_gens]")
+{
+  FastNoiseGen n1, n2, n3;
+  n1.setSeed(1234);
+  n2.setSeed(1234);
+  n3.setSeed(5678);
+
+  float total{0.f};
+  constexpr int kTestVectors{1000};
+  for (int i = 0; i < kTestVectors; ++i)
+  {
+    DSPVector a = n1();
+    DSPVector b = n2();
+    DSPVector c = n3();
+
+    // same seed gives same sequence, different seed a different one
+    REQUIRE(a == b);
+    REQUIRE(!(a == c));
+
+    // output is in [-1, 1)
+    REQUIRE(max(a) < 1.f);
+    REQUIRE(min(a) >= -1.f);
+    total += sum(a);
+  }
+
+  // mean should be close to 0
+  REQUIRE(fabs(total / (kTestVectors * kFloatsPerDSPVector)) < 0.01f);
+
+  // reset restarts the sequence
+  n1.reset();
+  n2.setSeed(0);
+  REQUIRE(n1() == n2());
+}
+
+TEST_CASE("madronalib/core/dsp_gens/wavetable", "[dsp_gens]")
+{
+  constexpr int kSize = Wavetable::kSize;
+  constexpr int kHarmonics{1000};
+
+  // two frames: a band-limited saw, and its inverse.
+  std::vector<float> frames(kSize * 2);
+  for (int n = 0; n < kSize; ++n)
+  {
+    float x{0.f};
+    for (int k = 1; k <= kHarmonics; ++k)
+    {
+      x += sinf(kTwoPi * k * n / kSize) / k;
+    }
+    frames[n] = x;
+    frames[kSize + n] = -x;
+  }
+  Wavetable table(frames.data(), 2);
+  REQUIRE(table.getFrames() == 2);
+
+  // each level should hold only the harmonics below half its size.
+  for (int level : {0, 4, Wavetable::kLevels - 1})
+  {
+    const int size = Wavetable::getLevelSize(level);
+    const int harmonics = std::min(size / 2 - 1, kHarmonics);
+    const float* p = table.getFrame(level, 0);
+    float maxDiff{0.f};
+    for (int n = 0; n < size; ++n)
+    {
+      float x{0.f};
+      for (int k = 1; k <= harmonics; ++k)
+      {
+        x += sinf(kTwoPi * k * n / size) / k;
+      }
+      maxDiff = std::max(maxDiff, fabsf(p[n] - x));
+    }
+    REQUIRE(maxDiff < 1e-3f);
+    REQUIRE(p[size] == p[0]);
+  }
+
+  // the level chosen for a frequency doesn't alias.
+  for (float f : {0.0001f, 0.001f, 0.01f, 0.1f, 0.25f, 0.49f})
+  {
+    int level = Wavetable::getLevel(f);
+    REQUIRE((Wavetable::getLevelSize(level) / 2 - 1) * f < 0.5f);
+  }
+
+  // halfway between the frames, they cancel.
+  WavetableGen osc(&table);
+  REQUIRE(max(abs(osc(DSPVector(0.01f), DSPVector(0.5f)))) < 1e-5f);
+
+  // a bank of voices in SIMD lanes matches the same voices one at a time.
+  constexpr int kVoices = kFloatsPerSIMDVector * 2;
+  WavetableBank<kVoices> bank(&table);
+  Bank<WavetableGen, kVoices> gens;
+  for (int v = 0; v < kVoices; ++v)
+  {
+    gens[v].setTable(&table);
+  }
+  DSPVectorArray<kVoices> freqs, positions;
+  for (int v = 0; v < kVoices; ++v)
+  {
+    freqs.row(v) = DSPVector(0.0003f * (1 << v));
+    positions.row(v) = DSPVector(v / float(kVoices - 1));
+  }
+  float maxDiff{0.f};
+  for (int i = 0; i < 10; ++i)
+  {
+    auto diff = abs(bank(freqs, positions) - gens(freqs, positions));
+    for (int v = 0; v < kVoices; ++v)
+    {
+      maxDiff = std::max(maxDiff, max(diff.constRow(v)));
+    }
+  }
+  REQUIRE(maxDiff < 1e-5f);
+}
+
+TEST_CASE("madronalib/core/dsp_gens/additive", "[dsp_gens]")
+{
+  constexpr int kPartials{64};
+  AdditiveBank<kPartials> bank;
+  std::array<float, kPartials> freqs{}, amps{};
+
+  // two partials, one above Nyquist that should be silent.
+  freqs[3] = 0.01f;
+  amps[3] = 0.5f;
+  freqs[40] = 0.03f;
+  amps[40] = 0.25f;
+  freqs[63] = 0.6f;
+  amps[63] = 1.f;
+
+  // skip the first DSPVector, where the amplitudes ramp up.
+  bank(freqs.data(), amps.data());
+  float maxDiff{0.f};
+  constexpr int kVectors{1000};
+  for (int i = 1; i < kVectors; ++i)
+  {
+    DSPVector y = bank(freqs.data(), amps.data());
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      double t = i * kFloatsPerDSPVector + n + 1;
+      double x = 0.5 * sin(kTwoPi * 0.01 * t) + 0.25 * sin(kTwoPi * 0.03 * t);
+      maxDiff = std::max(maxDiff, fabsf(y[n] - float(x)));
+    }
+  }
+  REQUIRE(maxDiff < 1e-3f);
+
+  // silence all the partials: after ramping down the output is 0.
+  amps.fill(0.f);
+  bank(freqs.data(), amps.data());
+  REQUIRE(bank(freqs.data(), amps.data()) == DSPVector(0.f));
+}
+
+TEST_CASE("madronalib/core/dsp_gens/glide-bank", "[dsp_gens]")
+{
+  constexpr int kGlides{kFloatsPerSIMDVector * 2 + 1};
+  constexpr float kGlideSamples{kFloatsPerDSPVector * 4};
+  GlideBank<kGlides> bank;
+  bank.setGlideTimeInSamples(kGlideSamples);
+
+  std::array<LinearGlide, kGlides> glides;
+  for (auto& g : glides)
+  {
+    g.setGlideTimeInSamples(kGlideSamples);
+  }
+
+  // glide i to i + 1, then change some targets partway.
+  std::array<float, kGlides> targets;
+  for (int i = 0; i < kGlides; ++i)
+  {
+    targets[i] = i + 1.f;
+  }
+  float maxDiff{0.f};
+  for (int v = 0; v < 12; ++v)
+  {
+    if (v == 2) targets[kGlides - 1] = -1.f;
+    if (v == 6) targets[0] = 0.5f;
+    const DSPVectorArray<kGlides>& y = bank(targets.data());
+    for (int i = 0; i < kGlides; ++i)
+    {
+      DSPVector yi = glides[i](targets[i]);
+      maxDiff = std::max(maxDiff, max(abs(y.constRow(i) - yi)));
+    }
+  }
+  REQUIRE(maxDiff < 1e-5f);
+
+  // finished glides land exactly on their targets.
+  for (int i = 0; i < kGlides; ++i)
+  {
+    REQUIRE(!bank.isGliding(i));
+  }
+  REQUIRE(bank(targets.data()).constRow(1) == DSPVector(2.f));
+
+  // a new value is output immediately.
+  bank.setValue(1, 7.f);
+  targets[1] = 7.f;
+  REQUIRE(bank(targets.data()).constRow(1) == DSPVector(7.f));
+}
+
+TEST_CASE("madronalib/core/dsp_gens/lfo-bank", "[dsp_gens]")
+{
+  LFOBank<5> lfos;
+  lfos.setShape(0, LFOShape::kSaw);
+  lfos.setSyncedRate(0, 0.25f);
+  lfos.setShape(1, LFOShape::kSquare);
+  lfos.setSyncedRate(1, 1.f);
+  lfos.setPhaseOffset(1, 0.5f);
+  lfos.setShape(2, LFOShape::kSine);
+  lfos.setFreeRate(2, 0.001f);
+  lfos.setShape(3, LFOShape::kSampleAndHold);
+  lfos.setSyncedRate(3, 1.f);
+  lfos.setShape(4, LFOShape::kSmoothRandom);
+  lfos.setSyncedRate(4, 2.f);
+
+  // run for a few bars at 200 samples per quarter note.
+  const double quartersPerSample = 1. / 200.;
+  auto frac = [](double x) { return x - std::floor(x); };
+  float sawDiff{0.f}, squareDiff{0.f}, sineDiff{0.f}, maxStep{0.f};
+  int holdChanges{0}, quarterWraps{0};
+  float prevHold = 0.f, prevSmooth = 0.f;
+  const int kVectors{60};
+  for (int v = 0; v < kVectors; ++v)
+  {
+    DSPVector beatPhase;
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      beatPhase[n] = float(frac((v * kFloatsPerDSPVector + n) * quartersPerSample));
+    }
+    const DSPVectorArray<5>& y = lfos(beatPhase);
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      const int t = v * kFloatsPerDSPVector + n;
+      const double q = t * quartersPerSample;
+      sawDiff = std::max(sawDiff, std::fabs(y.constRow(0)[n] - float(2. * frac(q * 0.25) - 1.)));
+      float square = frac(q + 0.5) < 0.5 ? 1.f : -1.f;
+      if (std::fabs(frac(q + 0.5) - 0.5) > 1e-3 && frac(q) > 1e-3)
+      {
+        squareDiff = std::max(squareDiff, std::fabs(y.constRow(1)[n] - square));
+      }
+      float sine = float(std::sin(kTwoPi * (t + 1) * 0.001));
+      sineDiff = std::max(sineDiff, std::fabs(y.constRow(2)[n] - sine));
+
+      // the held value changes only at the start of each quarter note.
+      if (t > 0)
+      {
+        bool wrapped = frac(q) < quartersPerSample / 2;
+        quarterWraps += wrapped;
+        holdChanges += (y.constRow(3)[n] != prevHold);
+        if (!wrapped) REQUIRE(y.constRow(3)[n] == prevHold);
+        maxStep = std::max(maxStep, std::fabs(y.constRow(4)[n] - prevSmooth));
+      }
+      prevHold = y.constRow(3)[n];
+      prevSmooth = y.constRow(4)[n];
+    }
+  }
+  REQUIRE(sawDiff < 1e-3f);
+  REQUIRE(squareDiff == 0.f);
+  REQUIRE(sineDiff < 1e-3f);
+  REQUIRE(quarterWraps > 0);
+  REQUIRE(holdChanges == quarterWraps);
+  REQUIRE(maxStep < 0.05f);
+
+  // stopped, the synced LFOs keep going at the last tempo.
+  float lastSaw = lfos(DSPVector(-1.f)).constRow(0)[0];
+  const float expectedSaw =
+      float(2. * frac((kVectors * kFloatsPerDSPVector) * quartersPerSample * 0.25) - 1.);
+  REQUIRE(std::fabs(lastSaw - expectedSaw) < 1e-3f);
+
+  // started again, they restart in sync with the beat.
+  REQUIRE(lfos(DSPVector(0.f)).constRow(0)[0] == -1.f);
+}
+
+TEST_CASE("madronalib/core/dsp_gens/random-bank", "[dsp_gens]")
+{
+  constexpr int kStreams{kFloatsPerSIMDVector * 4 + 3};
+  RandomBank<kStreams> a, b;
+  a.setSeed(7);
+  b.setSeed(7);
+
+  // each stream's sequence doesn't depend on how many other streams are drawn with it.
+  std::vector<float> first, firstFew;
+  for (int j = 0; j < 20; ++j)
+  {
+    first.push_back(a.uniform()[2]);
+    firstFew.push_back(b.uniform(3)[2]);
+  }
+  REQUIRE(first == firstFew);
+
+  // and streams that were not drawn start from the beginning.
+  RandomBank<kStreams> fresh;
+  fresh.setSeed(7);
+  REQUIRE(b.uniform()[kStreams - 1] == fresh.uniform()[kStreams - 1]);
+
+  // a different seed makes different sequences.
+  RandomBank<kStreams> c;
+  c.setSeed(8);
+  REQUIRE(c.uniform()[0] != RandomBank<kStreams>().uniform()[0]);
+
+  // the statistics of the uniform and gaussian values.
+  a.clear();
+  double uSum{0}, uMin{1}, uMax{-1}, gSum{0}, gSquares{0};
+  const int kDraws{2000};
+  for (int j = 0; j < kDraws; ++j)
+  {
+    const auto& u = a.uniform();
+    const auto& g = a.gaussian();
+    for (int i = 0; i < kStreams; ++i)
+    {
+      uSum += u[i];
+      uMin = std::min(uMin, double(u[i]));
+      uMax = std::max(uMax, double(u[i]));
+      gSum += g[i];
+      gSquares += g[i] * g[i];
+    }
+  }
+  const double n = double(kDraws) * kStreams;
+  REQUIRE(std::fabs(uSum / n) < 0.01);
+  REQUIRE(uMin >= -1.0);
+  REQUIRE(uMax < 1.0);
+  REQUIRE(std::fabs(gSum / n) < 0.01);
+  REQUIRE(std::fabs(gSquares / n - 1.0) < 0.02);
+
+  // smooth streams stay in range and change gradually.
+  for (int i = 0; i < kStreams; ++i)
+  {
+    a.setSmoothRate(i, 0.0002f * (i + 1));
+  }
+  float maxStep{0.f}, maxAbs{0.f};
+  std::vector<float> previous(kStreams, 0.f);
+  for (int v = 0; v < 100; ++v)
+  {
+    const auto& y = a.smooth();
+    for (int i = 0; i < kStreams; ++i)
+    {
+      for (int j = 0; j < kFloatsPerDSPVector; ++j)
+      {
+        float x = y.constRow(i)[j];
+        if (v + j > 0) maxStep = std::max(maxStep, std::fabs(x - previous[i]));
+        maxAbs = std::max(maxAbs, std::fabs(x));
+        previous[i] = x;
+      }
+    }
+  }
+  REQUIRE(maxAbs <= 1.f);
+  REQUIRE(maxStep < 0.05f);
+}
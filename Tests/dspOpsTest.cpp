@@ -7,10 +7,18 @@
 #include "catch.hpp"
 #include "MLTestUtils.h"
 #include "MLDSPOps.h"
+#include "MLDSPExpressions.h"
 #include "MLDSPFunctional.h"
+#include "MLDSPMathTiers.h"
 #include "MLDSPUtils.h"
 #include "MLDSPRouting.h"
 #include "MLDSPGens.h"
+#include "MLDSPCompiledProjection.h"
+#include "MLDSPDenormals.h"
+#include "MLDSPOpsDouble.h"
+#include "MLDSPProjectionTable.h"
+#include "MLDSPScale.h"
+#include "MLQueue.h"
 
 #include <iostream>
 #include <iomanip> // Required for setprecision
@@ -189,6 +197,21 @@ TEST_CASE("madronalib/core/dsp_ops", "[dsp_ops]")
 
     REQUIRE(c == d);
     REQUIRE(d == e);
+    REQUIRE(b == DSPVectorArray<rows>(4.f));
+    REQUIRE(f.constRow(1) == DSPVector(2.f));
+
+    // map SIMDVectorFloat -> SIMDVectorFloat
+    auto g = mapSIMD([](SIMDVectorFloat v) { return vecAdd(v, v); }, a);
+    REQUIRE(g == c);
+
+    // map int -> float over a DSPVectorArrayInt
+    DSPVectorArrayInt<rows> ai(3);
+    auto h = map([](int x) { return x * 0.5f; }, ai);
+    REQUIRE(h == DSPVectorArray<rows>(1.5f));
+
+    // a std::function still works
+    std::function<float(float)> fn = [](float x) { return x * 2.f; };
+    REQUIRE(map(fn, a) == c);
   }
 
   SECTION("row operations")
@@ -337,6 +360,113 @@ TEST_CASE("madronalib/core/projections", "[projections]")
   }
 }
 
+TEST_CASE("madronalib/core/projections/compiled", "[projections]")
+{
+  Interval unit{0, 1};
+  Interval range{0.001f, 10.f};
+  Interval lin{-2.f, 3.f};
+  float offset{-0.5f};
+
+  // compiled projections, the composed Projections they replace, and the domains to test over
+  struct ProjectionCase
+  {
+    CompiledProjection compiled;
+    Projection composed;
+    Interval domain;
+  };
+  Interval logDomain{range.x1 + offset, range.x2 + offset};
+  std::vector<ProjectionCase> cases{
+      {compiledProjections::linear(unit, lin), projections::linear(unit, lin), unit},
+      {compiledProjections::linear(lin, unit), projections::linear(lin, unit), lin},
+      {compiledProjections::constant(4.f), projections::constant(4.f), unit},
+      {compiledProjections::unityToLogParam(range, offset),
+       compose(projections::add(offset),
+               projections::intervalMap(unit, range, projections::log(range))),
+       unit},
+      {compiledProjections::logParamToUnity(range, offset),
+       compose(projections::intervalMap(range, unit, projections::exp(range)),
+               projections::add(-offset)),
+       logDomain},
+      {compiledProjections::bisquaredLinear(unit, lin),
+       compose(projections::bisquared, projections::linear(unit, lin)), unit},
+      {compiledProjections::linearInvBisquared(lin, unit),
+       compose(projections::linear(lin, unit), projections::invBisquared), lin}};
+
+  for (auto& t : cases)
+  {
+    const CompiledProjection& c = t.compiled;
+    Projection p = c.toProjection();
+    auto toDomain = projections::linear({0.f, kFloatsPerDSPVector - 1.f}, t.domain);
+    DSPVector x;
+    for (int i = 0; i < kFloatsPerDSPVector; ++i)
+    {
+      x[i] = toDomain((float)i);
+    }
+
+    DSPVector y = c(x);
+    for (int i = 0; i < kFloatsPerDSPVector; ++i)
+    {
+      float expected = t.composed(x[i]);
+      float tolerance = 1.0e-5f * std::max(1.f, fabsf(expected));
+      REQUIRE(nearlyEqual(c(x[i]), expected, tolerance));
+      REQUIRE(nearlyEqual(y[i], expected, tolerance));
+      REQUIRE(p(x[i]) == c(x[i]));
+    }
+  }
+
+  // the log pair are inverses
+  auto toLog = compiledProjections::unityToLogParam(range, offset);
+  auto fromLog = compiledProjections::logParamToUnity(range, offset);
+  for (int i = 0; i <= 10; ++i)
+  {
+    REQUIRE(nearlyEqual(fromLog(toLog(i / 10.f)), i / 10.f));
+  }
+}
+
+TEST_CASE("madronalib/core/projections/table", "[projections]")
+{
+  Interval range{0.001f, 10.f};
+  const Projection logRange = projections::unityToLogParam(range);
+  const Projection curve = compose(projections::bell, projections::smoothstep);
+
+  for (auto interp : {ProjectionTable::Interpolation::kLinear,
+                      ProjectionTable::Interpolation::kHermite})
+  {
+    for (const Projection* p : {&logRange, &curve, &projections::bell})
+    {
+      ProjectionTable table(*p, {0.f, 1.f}, 512, interp);
+      REQUIRE(table.size() == 512);
+
+      // the table meets its measured error at points between the ones it measured,
+      // with a little slack for the float math.
+      DSPVector x([](int i) { return i * 0.01531f; });
+      DSPVector y = table(x);
+      float bound = table.getMaxError() * 1.01f + 1.0e-6f;
+      for (int i = 0; i < kFloatsPerDSPVector; ++i)
+      {
+        float expected = (*p)(std::min(x[i], 1.f));
+        REQUIRE(fabsf(y[i] - expected) <= bound);
+        REQUIRE(nearlyEqual(y[i], table(x[i])));
+      }
+    }
+  }
+
+  // Hermite interpolation needs a smaller table than linear for the same error.
+  float maxError{1.0e-4f};
+  auto linearTable = ProjectionTable::withMaxError(curve, {0.f, 1.f}, maxError);
+  auto hermiteTable = ProjectionTable::withMaxError(curve, {0.f, 1.f}, maxError,
+                                                    ProjectionTable::Interpolation::kHermite);
+  REQUIRE(linearTable.getMaxError() <= maxError);
+  REQUIRE(hermiteTable.getMaxError() <= maxError);
+  REQUIRE(hermiteTable.size() < linearTable.size());
+
+  // inputs are clamped to the domain, and the ends are exact.
+  ProjectionTable squares(projections::squared, {-1.f, 2.f}, 64);
+  REQUIRE(squares(-5.f) == 1.f);
+  REQUIRE(squares(2.f) == 4.f);
+  REQUIRE(squares(DSPVector(7.f)) == DSPVector(4.f));
+}
+
 TEST_CASE("madronalib/core/tanh", "[tanh]")
 {
   DSPVector v1 ([](int i) -> float { return (i) / static_cast<float>(kFloatsPerDSPVector - 1); });
@@ -392,3 +522,649 @@ TEST_CASE("madronalib/core/vec-math", "[vec-math]")
   //std::cout << "v2: " << v2 << "\n";
 
 }
+
+TEST_CASE("madronalib/core/dispatch", "[dispatch]")
+{
+  // kernels for the detected CPU should match the baseline kernels.
+  const DSPKernels& base = getDSPKernels(SIMDLevel::kBaseline);
+  const DSPKernels& best = getDSPKernels();
+
+  constexpr size_t n = kFloatsPerDSPVector * 2;
+  DSPVectorArray<2> x(concatRows(rangeClosed(-kPi, kPi), rangeClosed(0.01f, 10.f)));
+  DSPVectorArray<2> y(repeatRows<2>(rangeOpen(-1.f, 1.f)));
+  DSPVectorArray<2> ya, yb;
+
+  std::vector<std::pair<DSPKernels::UnaryFn, DSPKernels::UnaryFn> > unaryKernels{
+      {base.sin, best.sin}, {base.cos, best.cos},   {base.log, best.log},
+      {base.exp, best.exp}, {base.sqrt, best.sqrt}, {base.tanhApprox, best.tanhApprox}};
+
+  for (auto& k : unaryKernels)
+  {
+    k.first(x.getConstBuffer(), ya.getBuffer(), n);
+    k.second(x.getConstBuffer(), yb.getBuffer(), n);
+    for (size_t i = 0; i < n; ++i)
+    {
+      float a = ya.getConstBuffer()[i];
+      float b = yb.getConstBuffer()[i];
+      bool bothNaN = std::isnan(a) && std::isnan(b);
+      REQUIRE((bothNaN || (fabsf(a - b) <= 1e-6f * std::max(1.f, fabsf(a)))));
+    }
+  }
+
+  base.lerp(x.getConstBuffer(), y.getConstBuffer(), y.getConstBuffer(), ya.getBuffer(), n);
+  best.lerp(x.getConstBuffer(), y.getConstBuffer(), y.getConstBuffer(), yb.getBuffer(), n);
+  REQUIRE(max(abs(ya.constRow(0) - yb.constRow(0))) < 1e-6f);
+
+  REQUIRE(fabsf(base.sum(x.getConstBuffer(), n) - best.sum(x.getConstBuffer(), n)) < 1e-3f);
+  REQUIRE(base.max(x.getConstBuffer(), n) == best.max(x.getConstBuffer(), n));
+  REQUIRE(base.min(x.getConstBuffer(), n) == best.min(x.getConstBuffer(), n));
+
+  // the max of all-negative inputs is negative.
+  DSPVectorArray<2> negative(repeatRows<2>(rangeClosed(-10.f, -1.f)));
+  REQUIRE(base.max(negative.getConstBuffer(), n) == -1.f);
+  REQUIRE(best.max(negative.getConstBuffer(), n) == -1.f);
+  REQUIRE(max(negative.constRow(0)) == -1.f);
+}
+
+TEST_CASE("madronalib/core/lazy", "[lazy]")
+{
+  DSPVector a(rangeClosed(-1, 1)), b(columnIndex()), c(2.f), d(rangeOpen(0, 1)), e(0.5f);
+
+  // lazy expressions should give the same results as eager ones.
+  DSPVector eager = a * b + c * d - e;
+  DSPVector fused = lazy(a) * b + lazy(c) * d - e;
+  REQUIRE(fused == eager);
+
+  DSPVector withScalars = 2.f * lazy(a) / 4.f - lazy(b);
+  REQUIRE(withScalars == (a * DSPVector(2.f) / DSPVector(4.f) - b));
+
+  DSPVector clipped = expr::min(expr::max(lazy(a), -0.5f), 0.5f);
+  REQUIRE(clipped == clamp(a, DSPVector(-0.5f), DSPVector(0.5f)));
+
+  DSPVectorArray<2> a2(repeatRows<2>(a));
+  DSPVectorArray<2> fused2 = lazy(a2) * a2 + 1.f;
+  REQUIRE(fused2 == (a2 * a2 + DSPVectorArray<2>(1.f)));
+}
+
+template <size_t ROWS>
+bool storeFramesMatches(size_t frames)
+{
+  DSPVectorArray<ROWS> x;
+  for (size_t j = 0; j < ROWS; ++j)
+  {
+    x.row(j) = columnIndex() + DSPVector(j * 1000.f);
+  }
+  std::vector<float> frameData(frames * ROWS + 1, -1.f);
+  storeFrames(x, frameData.data(), frames);
+  for (size_t i = 0; i < frames; ++i)
+  {
+    for (size_t j = 0; j < ROWS; ++j)
+    {
+      if (frameData[i * ROWS + j] != x.constRow(j)[i]) return false;
+    }
+  }
+
+  // nothing past the last frame is written.
+  return frameData[frames * ROWS] == -1.f;
+}
+
+TEST_CASE("madronalib/core/store-frames", "[dsp_ops]")
+{
+  for (size_t frames : {size_t(0), size_t(3), size_t(kFloatsPerDSPVector / 2 + 1),
+                        size_t(kFloatsPerDSPVector)})
+  {
+    REQUIRE(storeFramesMatches<1>(frames));
+    REQUIRE(storeFramesMatches<2>(frames));
+    REQUIRE(storeFramesMatches<3>(frames));
+    REQUIRE(storeFramesMatches<4>(frames));
+    REQUIRE(storeFramesMatches<8>(frames));
+  }
+}
+
+template <size_t ROWS>
+bool laneInterleavedMatches()
+{
+  constexpr size_t kLanes = kFloatsPerSIMDVector;
+  DSPVectorArray<ROWS> x;
+  for (size_t j = 0; j < ROWS; ++j)
+  {
+    x.row(j) = columnIndex() + DSPVector(j * 1000.f);
+  }
+  LaneInterleaved<ROWS> lanes(x);
+  for (size_t g = 0; g < LaneInterleaved<ROWS>::kGroups; ++g)
+  {
+    const float* pGroup = lanes.getConstGroup(g);
+    for (size_t n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      for (size_t j = 0; j < kLanes; ++j)
+      {
+        const size_t row = g * kLanes + j;
+        const float expected = (row < ROWS) ? x.constRow(row)[n] : 0.f;
+        if (pGroup[n * kLanes + j] != expected) return false;
+      }
+    }
+  }
+  return lanes.toRows() == x;
+}
+
+TEST_CASE("madronalib/core/lane-interleaved", "[dsp_ops]")
+{
+  // vecTranspose swaps elements across a square of SIMD vectors.
+  constexpr size_t kLanes = kFloatsPerSIMDVector;
+  SIMDVectorFloat v[kLanes];
+  for (size_t i = 0; i < kLanes; ++i)
+  {
+    SIMDVectorFloatUnion u;
+    for (size_t j = 0; j < kLanes; ++j) u.f[j] = float(i * kLanes + j);
+    v[i] = u.v;
+  }
+  vecTranspose(v);
+  bool transposed = true;
+  for (size_t i = 0; i < kLanes; ++i)
+  {
+    SIMDVectorFloatUnion u{v[i]};
+    for (size_t j = 0; j < kLanes; ++j) transposed &= (u.f[j] == float(j * kLanes + i));
+  }
+  REQUIRE(transposed);
+
+  REQUIRE(laneInterleavedMatches<1>());
+  REQUIRE(laneInterleavedMatches<3>());
+  REQUIRE(laneInterleavedMatches<4>());
+  REQUIRE(laneInterleavedMatches<8>());
+  REQUIRE(laneInterleavedMatches<9>());
+}
+
+TEST_CASE("madronalib/core/scale-table", "[dsp_ops]")
+{
+  // the table matches the Scale it was made from, for scalar and vector notes.
+  Scale scale;
+  ScaleTable table(scale);
+  REQUIRE(table.noteToLogPitch(69.f) == 0.f);
+  REQUIRE(fabsf(table.noteToLogPitch(81.f) - 1.f) < 1e-6f);
+
+  DSPVector notes = columnIndex() * DSPVector(1.9f) + DSPVector(-3.3f);
+  DSPVector pitches = table.noteToLogPitch(notes);
+  float maxDiff{0.f};
+  for (int n = 0; n < kFloatsPerDSPVector; ++n)
+  {
+    maxDiff = std::max(maxDiff, fabsf(pitches[n] - scale.noteToLogPitch(notes[n])));
+    maxDiff = std::max(maxDiff, fabsf(table.noteToLogPitch(notes[n]) - pitches[n]));
+  }
+  REQUIRE(maxDiff < 1e-5f);
+
+  notes[0] = std::numeric_limits<float>::quiet_NaN();
+  notes[1] = 1000.f;
+  pitches = table.noteToLogPitch(notes);
+  REQUIRE(pitches[0] == 0.f);
+  REQUIRE(pitches[1] == scale.noteToLogPitch(float(kMLNumNotes - 1)));
+
+  // retune through a triple buffer, as a voice on another thread would.
+  TripleBuffer<ScaleTable> tuning;
+  Scale fiveEqual;
+  fiveEqual.loadScaleFromString("5-ET\n5\n240.\n480.\n720.\n960.\n1200.\n");
+  tuning.getWriteBuffer().set(fiveEqual);
+  tuning.publish();
+  REQUIRE(tuning.update());
+  const ScaleTable& retuned = tuning.getReadBuffer();
+  REQUIRE(fabsf(retuned.noteToLogPitch(71.f) - fiveEqual.noteToLogPitch(71.f)) < 1e-6f);
+  REQUIRE(fabsf(retuned.noteToLogPitch(71.f) - table.noteToLogPitch(71.f)) > 0.1f);
+}
+
+TEST_CASE("madronalib/core/mix-matrix", "[dsp_ops]")
+{
+  constexpr size_t kIn{8}, kOut{6};
+  DSPVectorArray<kIn> x;
+  for (size_t i = 0; i < kIn; ++i)
+  {
+    x.row(int(i)) = sin(columnIndex() * DSPVector(0.1f * (i + 1)));
+  }
+
+  // compare with the sums worked out one gain at a time.
+  MixMatrix<kIn, kOut> m;
+  auto check = [&]()
+  {
+    DSPVectorArray<kOut> y = m(x);
+    float maxDiff{0.f};
+    for (size_t j = 0; j < kOut; ++j)
+    {
+      DSPVector expected;
+      for (size_t i = 0; i < kIn; ++i)
+      {
+        expected += x.constRow(int(i)) * DSPVector(m.getGain(i, j));
+      }
+      maxDiff = std::max(maxDiff, max(abs(y.constRow(int(j)) - expected)));
+    }
+    return maxDiff;
+  };
+
+  m.setGainImmediately(0, 5, 0.5f);
+  m.setGainImmediately(7, 2, -1.f);
+  REQUIRE(!m.isDense());
+  REQUIRE(m.getActiveGains() == 2);
+  REQUIRE(check() < 1e-6f);
+
+  for (size_t i = 0; i < kIn; ++i)
+  {
+    for (size_t j = 0; j < kOut; ++j)
+    {
+      m.setGainImmediately(i, j, 0.1f * float(i) - 0.05f * float(j));
+    }
+  }
+  REQUIRE(m.isDense());
+  REQUIRE(check() < 1e-5f);
+
+  // a gain glides to its new value over whole vectors, ramping across each one.
+  MixMatrix<1, 1> g;
+  g.setGlideTimeInSamples(4 * kFloatsPerDSPVector);
+  g.setGain(0, 0, 1.f);
+  DSPVectorArray<1> ones(1.f);
+  for (int v = 0; v < 4; ++v)
+  {
+    DSPVector y = g(ones);
+    REQUIRE(fabsf(y[kFloatsPerDSPVector - 1] - (v + 1) / 4.f) < 1e-6f);
+    REQUIRE(fabsf(y[0] - (v * kFloatsPerDSPVector + 1) / (4.f * kFloatsPerDSPVector)) < 1e-6f);
+  }
+  REQUIRE(g(ones) == DSPVector(1.f));
+
+  // zero gains are dropped from the list once their glide ends.
+  g.setGain(0, 0, 0.f);
+  for (int v = 0; v < 4; ++v) g(ones);
+  REQUIRE(g.getActiveGains() == 0);
+  REQUIRE(g(ones) == DSPVector(0.f));
+}
+
+namespace mathTiersTest
+{
+// the documented maximum errors of a tier.
+struct Bounds
+{
+  float trig, exp, log, tanh;
+};
+
+enum class ErrorType
+{
+  kAbsolute,
+  kRelative,
+  kLog
+};
+
+// the maximum error of fn over points evenly spaced in [lo, hi], against the double ref.
+template <class Fn, class RefFn>
+double maxError(Fn fn, RefFn ref, double lo, double hi, ErrorType type)
+{
+  constexpr int kVectors{512};
+  constexpr double kPoints = kVectors * kFloatsPerDSPVector - 1;
+  double maxErr{0.};
+  for (int v = 0; v < kVectors; ++v)
+  {
+    DSPVector x;
+    for (int i = 0; i < kFloatsPerDSPVector; ++i)
+    {
+      x[i] = float(lo + (hi - lo) * (v * kFloatsPerDSPVector + i) / kPoints);
+    }
+    DSPVector y = fn(x);
+    for (int i = 0; i < kFloatsPerDSPVector; ++i)
+    {
+      double r = ref(double(x[i]));
+      double err = fabs(y[i] - r);
+      if (type == ErrorType::kRelative) err /= fabs(r);
+      if (type == ErrorType::kLog) err /= std::max(1.0, fabs(r));
+      maxErr = std::max(maxErr, err);
+    }
+  }
+  return maxErr;
+}
+
+template <class Math>
+void testTier(Bounds b)
+{
+  using Vec = DSPVector;
+  auto abs = ErrorType::kAbsolute, rel = ErrorType::kRelative, lg = ErrorType::kLog;
+  double s = maxError([](Vec x) { return Math::sin(x); }, [](double x) { return std::sin(x); },
+                      -1000., 1000., abs);
+  double c = maxError([](Vec x) { return Math::cos(x); }, [](double x) { return std::cos(x); },
+                      -1000., 1000., abs);
+  double e = maxError([](Vec x) { return Math::exp(x); }, [](double x) { return std::exp(x); },
+                      -80., 80., rel);
+  double e2 = maxError([](Vec x) { return Math::exp2(x); },
+                       [](double x) { return std::exp2(x); }, -120., 120., rel);
+  double l = maxError([](Vec x) { return Math::log(x); }, [](double x) { return std::log(x); },
+                      1e-6, 1e4, lg);
+  double l2 = maxError([](Vec x) { return Math::log2(x); },
+                       [](double x) { return std::log2(x); }, 1e-6, 1e4, lg);
+  double t = maxError([](Vec x) { return Math::tanh(x); }, [](double x) { return std::tanh(x); },
+                      -20., 20., abs);
+
+  // pow's relative error is about that of exp plus y times the absolute error of log.
+  double p = maxError([](Vec x) { return Math::pow(x, Vec(2.5f)); },
+                      [](double x) { return std::pow(x, 2.5); }, 0.1, 10., rel);
+
+  REQUIRE(s < b.trig);
+  REQUIRE(c < b.trig);
+  REQUIRE(e < b.exp);
+  REQUIRE(e2 < b.exp);
+  REQUIRE(l < b.log);
+  REQUIRE(l2 < b.log);
+  REQUIRE(t < b.tanh);
+  REQUIRE(p < b.exp + 3.f * b.log);
+
+  // the SIMD kernels match the DSPVector functions.
+  DSPVector x(rangeClosed(-2.f, 2.f));
+  float y[kFloatsPerSIMDVector];
+  vecStoreUnaligned(y, Math::vecSin(vecLoadUnaligned(x.getConstBuffer())));
+  REQUIRE(y[1] == Math::sin(x)[1]);
+
+  // log of numbers <= 0 is NaN, and exp of large negative numbers is 0.
+  REQUIRE(std::isnan(Math::log(DSPVector(-1.f))[0]));
+  REQUIRE(Math::exp(DSPVector(-200.f))[0] < 1e-37f);
+  REQUIRE(Math::tanh(DSPVector(50.f))[0] == Approx(1.f).margin(b.tanh));
+}
+}  // namespace mathTiersTest
+
+TEST_CASE("madronalib/core/math-tiers", "[dsp_ops]")
+{
+  using namespace mathTiersTest;
+
+  SECTION("precision")
+  {
+    testTier<PreciseMath>({1e-7f, 1e-7f, 2e-7f, 2e-7f});
+    testTier<ApproxMath>({7e-6f, 1.5e-5f, 2e-5f, 5e-6f});
+    testTier<FastMath>({1e-3f, 1.2e-4f, 1e-3f, 7e-4f});
+  }
+
+  SECTION("time")
+  {
+    // time each tier. The times are not compared, since they depend on the build.
+    DSPVector a(rangeClosed(-kPi, kPi));
+    DSPVector b(rangeClosed(0.01f, 10.f));
+    auto timeTier = [&](auto math)
+    {
+      using Math = decltype(math);
+      double sinNs = timeIterations<DSPVector>([&]() { return Math::sin(a); }).ns;
+      double expNs = timeIterations<DSPVector>([&]() { return Math::exp(a); }).ns;
+      double logNs = timeIterations<DSPVector>([&]() { return Math::log(b); }).ns;
+      double tanhNs = timeIterations<DSPVector>([&]() { return Math::tanh(a); }).ns;
+      return sinNs + expNs + logNs + tanhNs;
+    };
+    REQUIRE(timeTier(PreciseMath{}) > 0.);
+    REQUIRE(timeTier(ApproxMath{}) > 0.);
+    REQUIRE(timeTier(FastMath{}) > 0.);
+  }
+}
+
+namespace
+{
+constexpr double sineTableFn(size_t i)
+{
+  return const_math::sin(i * 2. * const_math::kPiDouble / 1024.);
+}
+constexpr auto kSineTable = makeTable<1024>(sineTableFn);
+constexpr auto kExpTable = makeSampledTable<65>(const_math::exp, -8., 8.);
+constexpr auto kBlackman = makeWindowTable<17>(dspwindows::blackmanFn);
+
+static_assert(const_math::sqrt(16.) == 4., "const_math::sqrt");
+static_assert(kSineTable[256] == 1.f, "makeTable");
+}  // namespace
+
+TEST_CASE("madronalib/core/const-math", "[dsp_ops]")
+{
+  // the constexpr math functions match cmath to near double precision.
+  for (int i = -1000; i <= 1000; ++i)
+  {
+    const double x = i * 0.0173;
+    REQUIRE(const_math::sin(x) == Approx(std::sin(x)).margin(1e-13));
+    REQUIRE(const_math::cos(x) == Approx(std::cos(x)).margin(1e-13));
+    REQUIRE(const_math::exp(x) == Approx(std::exp(x)).epsilon(1e-13));
+    REQUIRE(const_math::atan(x) == Approx(std::atan(x)).margin(1e-15));
+    REQUIRE(const_math::tanh(x) == Approx(std::tanh(x)).margin(1e-15));
+    const double y = std::abs(x) + 1e-3;
+    REQUIRE(const_math::log(y) == Approx(std::log(y)).margin(1e-14));
+    REQUIRE(const_math::sqrt(y) == Approx(std::sqrt(y)).epsilon(1e-15));
+  }
+
+  // tables made at compile time match the same tables made at run time.
+  for (size_t i = 0; i < kSineTable.size(); ++i)
+  {
+    REQUIRE(kSineTable[i] == Approx(sinf(i * kTwoPi / 1024.f)).margin(1e-6));
+  }
+  REQUIRE(kExpTable.front() == Approx(expf(-8.f)));
+  REQUIRE(kExpTable[32] == 1.f);
+  REQUIRE(kExpTable.back() == Approx(expf(8.f)));
+
+  std::array<float, 17> window;
+  makeWindow(window.data(), window.size(), dspwindows::blackman);
+  for (size_t i = 0; i < window.size(); ++i)
+  {
+    REQUIRE(kBlackman[i] == Approx(window[i]).margin(1e-6));
+  }
+
+  // a constexpr DSPVector can be made from a table function.
+  ConstDSPVector ramp{[](int i) { return static_cast<float>(const_math::sqrt(i)); }};
+  REQUIRE(ramp[9] == 3.f);
+
+  // the windowed sinc is normalized and symmetric.
+  constexpr auto sinc = makeWindowedSincTable<17>(0.25);
+  float sum{0.f};
+  for (auto x : sinc) sum += x;
+  REQUIRE(sum == Approx(1.f));
+  REQUIRE(sinc[3] == sinc[13]);
+}
+
+TEST_CASE("madronalib/core/denormals", "[dsp_ops]")
+{
+  // denormals are counted from their bits, whether or not they are being flushed.
+  DSPVectorArray<2> x(1.f);
+  x.row(0)[3] = std::numeric_limits<float>::denorm_min();
+  x.row(1)[5] = -1e-40f;
+  x.row(1)[6] = 0.f;
+  x.row(1)[7] = std::numeric_limits<float>::min();
+  REQUIRE(countDenormals(x) == 2);
+  {
+    UsingFlushDenormalsToZero flush;
+    REQUIRE(countDenormals(x) == 2);
+  }
+
+  // a guard restores the setting it found.
+  if (kFlushDenormalsBits)
+  {
+    bool wasFlushing = isFlushingDenormalsToZero();
+    {
+      UsingFlushDenormalsToZero flush;
+      REQUIRE(isFlushingDenormalsToZero());
+      UsingFlushDenormalsToZero noChange(false);
+      REQUIRE(isFlushingDenormalsToZero());
+    }
+    REQUIRE(isFlushingDenormalsToZero() == wasFlushing);
+  }
+
+  // probes only count in builds with ML_COUNT_DENORMALS.
+  DenormalProbe probe;
+  probe.check(x);
+  probe.check(DSPVector(1.f));
+#ifdef ML_COUNT_DENORMALS
+  REQUIRE(probe.getVectorCount() == 2);
+  REQUIRE(probe.getVectorsWithDenormals() == 1);
+  REQUIRE(probe.getDenormalCount() == 2);
+#else
+  REQUIRE(probe.getVectorCount() == 0);
+#endif
+  probe.clear();
+  REQUIRE(probe.getDenormalCount() == 0);
+}
+
+TEST_CASE("madronalib/core/double-vectors", "[dsp_ops]")
+{
+  // floats convert to doubles and back exactly.
+  DSPVectorArray<2> x = concatRows(columnIndex() * DSPVector(0.1f), DSPVector(-3.3f));
+  DSPVectorArrayD<2> xd = toDouble(x);
+  REQUIRE(toFloat(xd) == x);
+  REQUIRE(xd[kFloatsPerDSPVector + 1] == double(-3.3f));
+
+  // arithmetic matches scalar doubles.
+  DSPVectorD a = columnIndexD() + 0.25;
+  DSPVectorD b = multiplyAdd(a, a, DSPVectorD(1.0)) / a - sqrt(a) + max(a, DSPVectorD(2.0));
+  bool ok{true};
+  for (int n = 0; n < kFloatsPerDSPVector; ++n)
+  {
+    double an = n + 0.25;
+    ok &= (b[n] == (an * an + 1.0) / an - std::sqrt(an) + std::max(an, 2.0));
+  }
+  REQUIRE(ok);
+
+  // phases wrap to [0, 1), also below zero.
+  DSPVectorD p = wrapPhase(columnIndexD() * 0.75 - 20.125);
+  for (int n = 0; n < kFloatsPerDSPVector; ++n)
+  {
+    double pn = n * 0.75 - 20.125;
+    ok &= (p[n] == pn - std::floor(pn));
+  }
+  REQUIRE(ok);
+  REQUIRE(wrapPhase(DSPVectorD(-1.0))[0] == 0.0);
+  REQUIRE(wrapPhase(DSPVectorD(1e300))[0] == 0.0);
+
+  // a very slow phasor made a vector at a time stays on time, while a float one does not move.
+  const double increment = 1e-8;
+  DSPVectorD phaseD;
+  double phase0{0.5};
+  float floatPhase{0.5f};
+  for (int v = 0; v < 1000; ++v)
+  {
+    phaseD = wrapPhase(multiplyAdd(columnIndexD() + 1.0, DSPVectorD(increment), DSPVectorD(phase0)));
+    phase0 = phaseD[kFloatsPerDSPVector - 1];
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      floatPhase += float(increment);
+    }
+  }
+  const double expected = 0.5 + 1000 * kFloatsPerDSPVector * increment;
+  REQUIRE(std::abs(phase0 - expected) < 1e-12);
+  REQUIRE(std::abs(floatPhase - expected) > 1e-4);
+}
+
+TEST_CASE("madronalib/core/dsp-vector-dynamic", "[dsp_ops]")
+{
+  auto isAligned = [](const DSPVector& v) {
+    return (reinterpret_cast<uintptr_t>(v.getConstBuffer()) % alignof(DSPVector)) == 0;
+  };
+
+  // vectors are aligned for any size.
+  for (size_t rows : {1, 2, 3, 5, 8})
+  {
+    DSPVectorDynamic d(rows);
+    REQUIRE(d.size() == rows);
+    REQUIRE(isAligned(d[0]));
+    REQUIRE(isAligned(d[int(rows) - 1]));
+  }
+
+  // resizing within the reserved capacity keeps the memory, and new rows are zeroed.
+  DSPVectorDynamic d(2, 8);
+  REQUIRE(d.capacity() == 8);
+  d[0] = DSPVector(1.f);
+  d[1] = DSPVector(2.f);
+  const float* p0 = d[0].getConstBuffer();
+  d.resize(1);
+  d.resize(8);
+  REQUIRE(d[0].getConstBuffer() == p0);
+  REQUIRE(d[0] == DSPVector(1.f));
+  REQUIRE(d[1] == DSPVector(0.f));
+
+  // copying into a DSPVectorDynamic with room keeps its memory too.
+  DSPVectorDynamic small(3);
+  small[2] = DSPVector(3.f);
+  d = small;
+  REQUIRE(d.size() == 3);
+  REQUIRE(d[0].getConstBuffer() == p0);
+  REQUIRE(d[2] == DSPVector(3.f));
+
+  // growing past the capacity keeps the rows.
+  d.resize(20);
+  REQUIRE(d.capacity() == 20);
+  REQUIRE(isAligned(d[0]));
+  REQUIRE(d[2] == DSPVector(3.f));
+  REQUIRE(d[19] == DSPVector(0.f));
+
+  // copies and moves in a std::vector.
+  std::vector<DSPVectorDynamic> buses;
+  for (int i = 0; i < 10; ++i)
+  {
+    buses.emplace_back(2);
+    buses.back()[1] = DSPVector(float(i));
+  }
+  DSPVectorDynamic copy(buses[7]);
+  REQUIRE(copy[1] == DSPVector(7.f));
+  REQUIRE(buses[9][1] == DSPVector(9.f));
+  DSPVectorDynamic moved(std::move(buses[9]));
+  REQUIRE(moved[1] == DSPVector(9.f));
+}
+
+TEST_CASE("madronalib/core/bus-ops", "[dsp_ops]")
+{
+  constexpr size_t kChannels{70};
+  DSPVectorDynamic bus(kChannels);
+  std::vector<float> gains(kChannels), pans(kChannels);
+  for (size_t c = 0; c < kChannels; ++c)
+  {
+    bus[int(c)] = columnIndex() * DSPVector(0.01f) + DSPVector(float(c));
+    gains[c] = 0.5f + c * 0.01f;
+    pans[c] = -1.f + 2.f * c / (kChannels - 1);
+  }
+
+  auto near = [](const DSPVector& a, const DSPVector& b) { return max(abs(a - b)) < 1e-3f; };
+
+  // mixdowns match sums of the channels made with DSPVector operators.
+  DSPVector mono;
+  for (size_t c = 0; c < kChannels; ++c) mono += bus[int(c)] * DSPVector(gains[c]);
+  REQUIRE(near(mixToMono(bus, gains.data()), mono));
+
+  std::vector<StereoGains> panGains(kChannels);
+  makePanGains(pans.data(), kChannels, PanLaw::kConstantPower, panGains.data(), gains.data());
+  DSPVectorArray<2> stereo;
+  for (size_t c = 0; c < kChannels; ++c)
+  {
+    stereo.row(0) += bus[int(c)] * DSPVector(panGains[c].left);
+    stereo.row(1) += bus[int(c)] * DSPVector(panGains[c].right);
+  }
+  DSPVectorArray<2> mixed = mixToStereo(bus, panGains.data());
+  REQUIRE(near(mixed.constRow(0), stereo.constRow(0)));
+  REQUIRE(near(mixed.constRow(1), stereo.constRow(1)));
+
+  // pan laws at the center and the edges.
+  REQUIRE(getPanGains(0.f, PanLaw::kLinear).left == Approx(0.5f));
+  REQUIRE(getPanGains(0.f, PanLaw::kConstantPower).right == Approx(std::sqrt(0.5f)));
+  const float minus4_5dB = std::pow(10.f, -4.5f / 20.f);
+  REQUIRE(getPanGains(0.f, PanLaw::kCompromise).left == Approx(minus4_5dB).epsilon(0.01));
+  REQUIRE(getPanGains(-1.f, PanLaw::kConstantPower).right == Approx(0.f).margin(1e-6));
+  REQUIRE(getPanGains(1.f, PanLaw::kCompromise).right == Approx(1.f));
+
+  // gains, with and without ramps.
+  DSPVectorDynamic scaled(bus);
+  scaleChannels(scaled, gains.data());
+  REQUIRE(near(scaled[69], bus[69] * DSPVector(gains[69])));
+  std::vector<float> ones(kChannels, 1.f);
+  scaled = bus;
+  scaleChannels(scaled, ones.data(), gains.data());
+  const int last = kFloatsPerDSPVector - 1;
+  REQUIRE(scaled[3][last] == Approx(bus[3][last] * gains[3]));
+  REQUIRE(scaled[3][0] == Approx(bus[3][0] * (1.f + (gains[3] - 1.f) / kFloatsPerDSPVector)));
+
+  // accumulating and copying between DSPVectorDynamic and DSPVectorArray.
+  DSPVectorArray<4> sub;
+  copyChannels(bus, sub, 10);
+  REQUIRE(sub.constRow(0) == bus[10]);
+  REQUIRE(sub.constRow(3) == bus[13]);
+  const DSPVector before = scaled[1];
+  accumulateChannels(sub, scaled, gains.data());
+  REQUIRE(near(scaled[1], before + bus[11] * DSPVector(gains[1])));
+  DSPVectorDynamic sum(2);
+  accumulateChannels(bus, sum);
+  accumulateChannels(bus, sum, gains.data());
+  REQUIRE(near(sum[1], bus[1] * DSPVector(1.f + gains[1])));
+
+  // copies are cut short at the end of either bus.
+  DSPVectorDynamic tail(4);
+  copyChannels(bus, tail, 68, 1);
+  REQUIRE(tail[0] == DSPVector(0.f));
+  REQUIRE(tail[1] == bus[68]);
+  REQUIRE(tail[2] == bus[69]);
+  REQUIRE(tail[3] == DSPVector(0.f));
+}
@@ -0,0 +1,98 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// a unit test made using the Catch framework in catch.hpp / tests.cpp.
+
+#include <chrono>
+#include <thread>
+
+#include "catch.hpp"
+#include "MLDSPProfiler.h"
+
+using namespace ml;
+
+static void spinFor(double seconds)
+{
+  const uint64_t end = TickClock::now() + TickClock::secondsToTicks(seconds);
+  while (int64_t(TickClock::now() - end) < 0)
+  {
+  }
+}
+
+TEST_CASE("madronalib/core/dsp-profiler", "[profiler]")
+{
+  DSPProfiler profiler;
+  const auto outer = profiler.addSection(runtimePath("voices"));
+  const auto inner = profiler.addSection(runtimePath("voices/osc"));
+  REQUIRE(profiler.addSection(runtimePath("voices")) == outer);
+  REQUIRE(profiler.getNumSections() == 2);
+
+  auto runVector = [&]() {
+    {
+      ML_PROFILE_SCOPE(&profiler, outer);
+      spinFor(0.0002);
+      for (int i = 0; i < 2; ++i)
+      {
+        ML_PROFILE_SCOPE(&profiler, inner);
+        spinFor(0.0002);
+      }
+    }
+    profiler.endVector();
+  };
+
+  // nothing is recorded until profiling is enabled, and then only from the next vector.
+  runVector();
+  profiler.setEnabled(true);
+  runVector();
+  profiler.collect();
+  REQUIRE(profiler.getStats(outer).calls == 0);
+
+  constexpr int kVectors{10};
+  for (int v = 0; v < kVectors; ++v)
+  {
+    runVector();
+  }
+  profiler.collect();
+
+  const auto& outerStats = profiler.getStats(outer);
+  const auto& innerStats = profiler.getStats(inner);
+  REQUIRE(outerStats.vectors == kVectors);
+  REQUIRE(outerStats.calls == kVectors);
+  REQUIRE(innerStats.calls == kVectors * 2);
+
+  // the outer section's total includes the inner one, and its self time doesn't.
+  REQUIRE(outerStats.totalSeconds > innerStats.totalSeconds);
+  REQUIRE(outerStats.selfSeconds < outerStats.totalSeconds - innerStats.totalSeconds * 0.99);
+  REQUIRE(innerStats.selfSeconds == innerStats.totalSeconds);
+  REQUIRE(outerStats.totalSeconds >= kVectors * 0.0006 * 0.9);
+  REQUIRE(outerStats.maxSecondsPerVector >= outerStats.totalSeconds / kVectors);
+
+  // messages for each section that ran.
+  const double sr = 48000.;
+  auto messages = profiler.getStatsMessages(runtimePath("profile"), sr);
+  REQUIRE(messages.size() == 8);
+  bool foundCalls{false};
+  for (const auto& m : messages)
+  {
+    if (m.address == runtimePath("profile/voices/osc/calls_per_vector"))
+    {
+      REQUIRE(m.value.getFloatValue() == 2.f);
+      foundCalls = true;
+    }
+  }
+  REQUIRE(foundCalls);
+  REQUIRE(outerStats.getMeanLoad(sr) > innerStats.getMeanLoad(sr));
+
+  // disabling takes effect at the next vector, and scopes with no profiler do nothing.
+  profiler.setEnabled(false);
+  profiler.clearStats();
+  runVector();
+  runVector();
+  {
+    ML_PROFILE_SCOPE(nullptr, outer);
+  }
+  profiler.collect();
+  REQUIRE(profiler.getStats(outer).calls == 1);
+  REQUIRE(profiler.getDroppedRecords() == 0);
+}
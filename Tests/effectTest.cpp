@@ -0,0 +1,83 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// a unit test made using the Catch framework in catch.hpp / tests.cpp.
+
+#include "catch.hpp"
+#include "madronalib.h"
+#include "MLEffect.h"
+
+using namespace ml;
+
+namespace effectTest
+{
+// a one-pole feedback echo, whose tail decays by half each vector.
+class DecayEffect : public Effect
+{
+ public:
+  void processEffect(const DSPVectorDynamic& inputs, DSPVectorDynamic& outputs, void*) override
+  {
+    state_ = state_ * 0.5f + inputs[0];
+    outputs[0] = state_;
+    processed++;
+  }
+  void onSleep() override { state_ = DSPVector(0.f); }
+
+  int processed{0};
+
+ private:
+  DSPVector state_{0.f};
+};
+
+int vectorsUntilSleep(DecayEffect& fx, DSPVectorDynamic& in, DSPVectorDynamic& out)
+{
+  in[0] = DSPVector(1.f);
+  fx.processVector(in, out, nullptr);
+  in[0] = DSPVector(0.f);
+  int n = 0;
+  while (!fx.isAsleep() && (n < 1000))
+  {
+    fx.processVector(in, out, nullptr);
+    n++;
+  }
+  return n;
+}
+}  // namespace effectTest
+
+using namespace effectTest;
+
+TEST_CASE("madronalib/core/effect/sleep", "[effect]")
+{
+  DSPVectorDynamic in(1), out(1);
+  DecayEffect fx;
+  fx.setSampleRate(kFloatsPerDSPVector * 100);
+
+  // without sleep, the effect always runs.
+  REQUIRE(vectorsUntilSleep(fx, in, out) == 1000);
+
+  // a measured tail lasts until the output decays below the threshold, then
+  // for kMeasuredTailHoldSeconds, here 5 vectors.
+  fx.setSleepWhenSilent(true);
+  int measured = vectorsUntilSleep(fx, in, out);
+  REQUIRE(measured > 17);
+  REQUIRE(measured < 25);
+
+  // asleep, the effect outputs zeros without processing.
+  out[0] = DSPVector(1.f);
+  int processed = fx.processed;
+  fx.processVector(in, out, nullptr);
+  REQUIRE(fx.processed == processed);
+  REQUIRE(out[0] == DSPVector(0.f));
+
+  // a declared tail of 0.1 seconds is 10 vectors.
+  fx.setTailInSeconds(0.1f);
+  REQUIRE(vectorsUntilSleep(fx, in, out) == 11);
+
+  // any input wakes the effect.
+  in[0] = DSPVector(0.f);
+  in[0][5] = 0.01f;
+  fx.processVector(in, out, nullptr);
+  REQUIRE(!fx.isAsleep());
+  REQUIRE(out[0][5] == 0.01f);
+}
@@ -0,0 +1,560 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// a unit test made using the Catch framework in catch.hpp / tests.cpp.
+
+#include "catch.hpp"
+#include "MLAudioContext.h"
+#include "MLEventScheduler.h"
+#include "MLEventsToSignals.h"
+#include "MLMIDI.h"
+#include "MLSynth.h"
+
+using namespace ml;
+
+namespace eventsToSignalsTest
+{
+Event makeEvent(int type, int time, float value1)
+{
+  Event e;
+  e.type = static_cast<uint8_t>(type);
+  e.time = time;
+  e.value1 = value1;
+  return e;
+}
+
+bool isSortedByTime(const std::vector<Event>& events)
+{
+  for (size_t i = 1; i < events.size(); ++i)
+  {
+    const Event& a = events[i - 1];
+    const Event& b = events[i];
+    if ((b.time < a.time) || ((b.time == a.time) && (b.type < a.type))) return false;
+  }
+  return true;
+}
+
+// each voice outputs a level that is 1 while its gate is on, then halves every vector.
+class DecaySynth : public Synth
+{
+ public:
+  DecaySynth() : Synth(3) {}
+  void processVoice(int v, const EventsToSignals::Voice& voice, const DSPVectorDynamic&,
+                    DSPVectorDynamic& outputs, AudioContext*) override
+  {
+    bool gate = voice.outputs.constRow(kGate)[kFloatsPerDSPVector - 1] > 0.f;
+    levels[v] = gate ? 1.f : levels[v] * 0.5f;
+    outputs[0] += DSPVector(levels[v]);
+    renders[v]++;
+  }
+  std::array<float, 3> levels{};
+  std::array<int, 3> renders{};
+};
+}  // namespace eventsToSignalsTest
+
+using namespace eventsToSignalsTest;
+
+TEST_CASE("madronalib/core/events/ingestion", "[events]")
+{
+  EventsToSignals e2s;
+  REQUIRE(e2s.getEventCapacity() == EventsToSignals::kMaxEventsPerProcessBuffer);
+
+  // unsorted events in bulk, with an off before an on at the same time.
+  std::vector<Event> block;
+  for (int i = 0; i < 50; ++i)
+  {
+    block.push_back(makeEvent(kController, (i * 37) % 100, (float)i));
+  }
+  block.push_back(makeEvent(kNoteOff, 20, 0.f));
+  block.push_back(makeEvent(kNoteOn, 20, 1.f));
+  e2s.addEvents(block.data(), block.size());
+  REQUIRE(e2s.getEvents().size() == block.size());
+  REQUIRE(isSortedByTime(e2s.getEvents()));
+
+  // events at the same time and of the same type keep their order.
+  std::vector<Event> sameTime{makeEvent(kController, 5, 1.f), makeEvent(kController, 5, 2.f),
+                              makeEvent(kController, 5, 3.f)};
+  e2s.clearEvents();
+  e2s.addEvents(sameTime.data(), 2);
+  e2s.addEvent(sameTime[2]);
+  e2s.addEvents(block.data(), block.size());
+  const auto& events = e2s.getEvents();
+  REQUIRE(isSortedByTime(events));
+  std::vector<float> order;
+  for (const auto& ev : events)
+  {
+    if ((ev.time == 5) && (ev.type == kController)) order.push_back(ev.value1);
+  }
+  REQUIRE(order.size() == 3);
+  REQUIRE(order[0] == 1.f);
+  REQUIRE(order[1] == 2.f);
+  REQUIRE(order[2] == 3.f);
+
+  // sorted blocks are merged with earlier events.
+  std::vector<Event> sorted{makeEvent(kController, 0, 0.f), makeEvent(kController, 99, 0.f)};
+  e2s.addEvents(sorted.data(), sorted.size(), true);
+  REQUIRE(isSortedByTime(e2s.getEvents()));
+  REQUIRE(e2s.getEvents().front().time == 0);
+
+  // events past the capacity are dropped and counted, without reallocating.
+  e2s.clear();
+  const Event* pBuffer = e2s.getEvents().data();
+  std::vector<Event> tooMany(EventsToSignals::kMaxEventsPerProcessBuffer + 10,
+                             makeEvent(kController, 1, 0.f));
+  e2s.addEvents(tooMany.data(), tooMany.size(), true);
+  e2s.addEvent(makeEvent(kController, 0, 0.f));
+  REQUIRE(e2s.getEvents().size() == EventsToSignals::kMaxEventsPerProcessBuffer);
+  REQUIRE(e2s.getDroppedEventCount() == 11);
+  REQUIRE(e2s.getEvents().data() == pBuffer);
+
+  e2s.setEventCapacity(1024);
+  e2s.clear();
+  e2s.addEvents(tooMany.data(), tooMany.size());
+  REQUIRE(e2s.getEvents().size() == tooMany.size());
+  REQUIRE(e2s.getDroppedEventCount() == 0);
+}
+
+TEST_CASE("madronalib/core/events/voice-glides", "[events]")
+{
+  EventsToSignals e2s;
+  e2s.setSampleRate(48000);
+  e2s.setPolyphony(4);
+
+  // a controller change glides linearly to the new value in every voice.
+  Event cc = makeEvent(kController, 0, 1.f);
+  cc.sourceIdx = 73;
+  e2s.addEvent(cc);
+
+  int glideVectors = static_cast<int>(48000 * EventsToSignals::kGlideTimeSeconds) /
+                     kFloatsPerDSPVector;
+  float prev{0.f};
+  bool rising{true};
+  for (int n = 0; n < glideVectors; ++n)
+  {
+    e2s.processVector(n * kFloatsPerDSPVector);
+    e2s.clearEvents();
+    for (int v = 0; v < 4; ++v)
+    {
+      const DSPVector& x = e2s.getVoice(v).outputs.constRow(kX);
+      rising &= (x[0] > prev) && (x[kFloatsPerDSPVector - 1] > x[0]);
+    }
+    prev = e2s.getVoice(0).outputs.constRow(kX)[kFloatsPerDSPVector - 1];
+  }
+  REQUIRE(rising);
+  REQUIRE(prev == 1.f);
+  e2s.processVector(0);
+  REQUIRE(e2s.getVoice(3).outputs.constRow(kX) == DSPVector(1.f));
+
+  // clear() resets the glides.
+  e2s.clear();
+  e2s.addEvent(makeEvent(kNull, 0, 0.f));
+  e2s.processVector(0);
+  REQUIRE(e2s.getVoice(0).outputs.constRow(kX) == DSPVector(0.f));
+}
+
+namespace eventsToSignalsTest
+{
+Event makeNote(int type, int key, float velocity = 1.f)
+{
+  Event e = makeEvent(type, 0, static_cast<float>(key));
+  e.sourceIdx = static_cast<uint16_t>(key);
+  e.value2 = velocity;
+  return e;
+}
+
+// the index of the voice playing a key, or -1.
+int findVoicePlaying(const EventsToSignals& e2s, int key)
+{
+  for (int v = 0; v < e2s.getPolyphony(); ++v)
+  {
+    const auto& voice = e2s.getVoice(v);
+    if (voice.creatorKeyIdx_ == key) return v;
+  }
+  return -1;
+}
+}  // namespace eventsToSignalsTest
+
+TEST_CASE("madronalib/core/events/voice-allocation", "[events]")
+{
+  EventsToSignals e2s;
+  e2s.setSampleRate(48000);
+  constexpr int kVoices = 100;
+  REQUIRE(e2s.setPolyphony(kVoices) == kVoices);
+  REQUIRE(e2s.setPolyphony(1000) == EventsToSignals::kMaxVoices);
+  e2s.setPolyphony(kVoices);
+
+  // every voice gets used before any is stolen.
+  for (int k = 1; k <= kVoices; ++k)
+  {
+    e2s.addEvent(makeNote(kNoteOn, k));
+    e2s.processVector(0);
+    e2s.clearEvents();
+    REQUIRE(e2s.getNewestVoice() == k - 1);
+  }
+  for (int v = 0; v < kVoices; ++v)
+  {
+    REQUIRE(e2s.getVoice(v).outputs.constRow(kGate)[kFloatsPerDSPVector - 1] == 1.f);
+  }
+
+  // with all voices playing, the oldest note is stolen.
+  e2s.addEvent(makeNote(kNoteOn, 110));
+  e2s.processVector(0);
+  e2s.clearEvents();
+  REQUIRE(e2s.getNewestVoice() == 0);
+  REQUIRE(findVoicePlaying(e2s, 1) == -1);
+
+  // a new note gets the voice released longest ago.
+  for (int k : {50, 20, 90})
+  {
+    e2s.addEvent(makeNote(kNoteOff, k, 0.f));
+  }
+  e2s.processVector(0);
+  e2s.clearEvents();
+  for (int expected : {49, 19, 89})
+  {
+    e2s.addEvent(makeNote(kNoteOn, 111 + expected / 10));
+    e2s.processVector(0);
+    e2s.clearEvents();
+    REQUIRE(e2s.getNewestVoice() == expected);
+  }
+}
+
+TEST_CASE("madronalib/core/events/voice-sleep", "[events]")
+{
+  EventsToSignals e2s;
+  e2s.setSampleRate(48000);
+  e2s.setPolyphony(64);
+  e2s.setVoiceSleepTimeInSeconds(0.1f);
+  int sleepVectors = static_cast<int>(0.2f * 48000 / kFloatsPerDSPVector);
+
+  auto runVectors = [&](int n)
+  {
+    for (int i = 0; i < n; ++i)
+    {
+      e2s.processVector(0);
+      e2s.clearEvents();
+    }
+  };
+
+  // voices that never play go to sleep.
+  e2s.addEvent(makeNote(kNoteOn, 60));
+  runVectors(sleepVectors);
+  REQUIRE(!e2s.isVoiceAsleep(0));
+  for (int v = 1; v < 64; ++v)
+  {
+    REQUIRE(e2s.isVoiceAsleep(v));
+  }
+
+  // a released voice sleeps after its signals settle, holding its outputs.
+  e2s.addEvent(makeNote(kNoteOff, 60, 0.f));
+  runVectors(1);
+  REQUIRE(!e2s.isVoiceAsleep(0));
+  runVectors(sleepVectors);
+  REQUIRE(e2s.isVoiceAsleep(0));
+  DSPVector heldPitch = e2s.getVoice(0).outputs.constRow(kPitch);
+  REQUIRE(heldPitch == DSPVector(60.f));
+
+  // controller changes while asleep are picked up without gliding when the voice wakes.
+  Event cc = makeEvent(kController, 0, 0.5f);
+  cc.sourceIdx = 73;
+  e2s.addEvent(cc);
+  runVectors(1);
+  REQUIRE(e2s.getVoice(0).outputs.constRow(kX) == DSPVector(0.f));
+  REQUIRE(e2s.getVoice(0).outputs.constRow(kPitch) == heldPitch);
+
+  constexpr int kOnTime = kFloatsPerDSPVector / 4;
+  Event on = makeNote(kNoteOn, 62);
+  on.time = kOnTime;
+  e2s.addEvent(on);
+  runVectors(1);
+  int v = e2s.getNewestVoice();
+  REQUIRE(!e2s.isVoiceAsleep(v));
+  const auto& gate = e2s.getVoice(v).outputs.constRow(kGate);
+  REQUIRE(gate[kOnTime - 1] == 0.f);
+  REQUIRE(gate[kOnTime] == 1.f);
+  REQUIRE(e2s.getVoice(v).outputs.constRow(kX) == DSPVector(0.5f));
+
+  // turning sleep off wakes all the voices.
+  e2s.setVoiceSleepTimeInSeconds(-1.f);
+  for (int w = 0; w < 64; ++w)
+  {
+    REQUIRE(!e2s.isVoiceAsleep(w));
+  }
+}
+
+TEST_CASE("madronalib/core/events/spans", "[events]")
+{
+  AudioContext context(0, 2, 48000);
+  context.setInputPolyphony(4);
+
+  auto getSpans = [&]()
+  {
+    std::vector<int> starts;
+    for (size_t i = 0; i < context.getNumSpans(); ++i)
+    {
+      auto span = context.getSpan(i);
+      REQUIRE(span.start < span.end);
+      starts.push_back(span.start);
+    }
+    REQUIRE(context.getSpan(context.getNumSpans() - 1).end == kFloatsPerDSPVector);
+    return starts;
+  };
+
+  std::vector<Event> events{makeNote(kNoteOn, 60), makeNote(kNoteOn, 62), makeNote(kNoteOn, 64),
+                            makeNote(kNoteOff, 60, 0.f), makeNote(kNoteOn, 67)};
+  // times in the first four vectors.
+  constexpr int k = kFloatsPerDSPVector;
+  std::vector<int> times{k / 4, k / 4, k / 2, k + 5, 3 * k + 8};
+  for (size_t i = 0; i < events.size(); ++i)
+  {
+    events[i].time = times[i];
+  }
+
+  // without splitting, there is one span.
+  context.addInputEvents(events.data(), events.size());
+  context.processVector(0);
+  REQUIRE(getSpans() == std::vector<int>{0});
+
+  // with splitting, spans start at each event time within the vector.
+  context.setSplitAtEvents(true);
+  context.processVector(0);
+  REQUIRE(getSpans() == (std::vector<int>{0, k / 4, k / 2}));
+  context.processVector(k);
+  REQUIRE(getSpans() == (std::vector<int>{0, 5}));
+  context.processVector(2 * k);
+  REQUIRE(getSpans() == std::vector<int>{0});
+
+  // the note starts at the beginning of its span.
+  context.processVector(3 * k);
+  const auto& gate = context.getInputVoice(context.getNewestInputVoice()).outputs.constRow(kGate);
+  auto span = context.getSpan(1);
+  REQUIRE(span.start == 8);
+  REQUIRE(gate[span.start - 1] == 0.f);
+  REQUIRE(gate[span.start] == 1.f);
+
+  context.setSplitAtEvents(false);
+  context.processVector(0);
+  REQUIRE(getSpans() == std::vector<int>{0});
+}
+
+TEST_CASE("madronalib/core/events/coalescing", "[events]")
+{
+  // two MPE streams with many updates per vector, and notes starting and ending between them.
+  std::vector<Event> events;
+  for (int t = 0; t < 4 * kFloatsPerDSPVector; t += 4)
+  {
+    for (int chan : {2, 3})
+    {
+      Event bend = makeEvent(kPitchBend, t, (t % 32) / 32.f);
+      bend.channel = chan;
+      Event ccY = makeEvent(kController, t + 1, (t % 48) / 48.f);
+      ccY.channel = chan;
+      ccY.sourceIdx = 74;
+      Event pressure = makeEvent(kChannelPressure, t + 2, (t % 20) / 20.f);
+      pressure.channel = chan;
+      events.insert(events.end(), {bend, ccY, pressure});
+    }
+  }
+  for (int t : {10, 100, 150})
+  {
+    Event on = makeNote(kNoteOn, 60 + t % 7);
+    on.time = t;
+    on.channel = (t == 100) ? 3 : 2;
+    Event off = on;
+    off.type = kNoteOff;
+    off.time = t + 33;
+    events.insert(events.end(), {on, off});
+  }
+
+  auto run = [&](bool coalesce)
+  {
+    EventsToSignals e2s;
+    e2s.setSampleRate(48000);
+    e2s.setProtocol("MPE");
+    e2s.setPolyphony(4);
+    e2s.setCoalesceEvents(coalesce);
+    e2s.setEventCapacity(events.size());
+    e2s.addEvents(events.data(), events.size());
+
+    std::vector<float> out;
+    for (int n = 0; n < 8; ++n)
+    {
+      e2s.processVector(n * kFloatsPerDSPVector);
+      for (int v = -1; v < 4; ++v)
+      {
+        for (int row : {kPitch, kGate, kY, kZ})
+        {
+          const DSPVector& sig = e2s.getVoice(v).outputs.constRow(row);
+          out.insert(out.end(), sig.getConstBuffer(), sig.getConstBuffer() + kFloatsPerDSPVector);
+        }
+      }
+    }
+    return std::make_pair(out, e2s.getCoalescedEventCount());
+  };
+
+  auto plain = run(false);
+  auto coalesced = run(true);
+  REQUIRE(plain.second == 0);
+  REQUIRE(coalesced.second > events.size() / 2);
+  REQUIRE(coalesced.first == plain.first);
+}
+
+TEST_CASE("madronalib/core/events/midi-packets", "[events]")
+{
+  auto makePacket = [](MIDIClock::time_point t, std::initializer_list<uint8_t> bytes)
+  {
+    MIDIPacket p;
+    p.time = t;
+    p.size = static_cast<uint8_t>(bytes.size());
+    std::copy(bytes.begin(), bytes.end(), p.bytes.begin());
+    return p;
+  };
+
+  // raw bytes convert like MIDIMessages.
+  MIDIMessage noteOn{0x92, 60, 127};
+  Event e = MIDIBytesToEvent(noteOn.data(), noteOn.size());
+  REQUIRE(e.type == kNoteOn);
+  REQUIRE(e.channel == 3);
+  REQUIRE(e.sourceIdx == 60);
+  REQUIRE(e.value1 == 1.f);
+  REQUIRE(MIDIMessageToEvent(noteOn).type == kNoteOn);
+
+  uint8_t bendCenter[3]{0xE0, 0x00, 0x40};
+  REQUIRE(MIDIBytesToEvent(bendCenter, 3).value1 == 0.f);
+  uint8_t bendUp[3]{0xE0, 0x7f, 0x7f};
+  REQUIRE(MIDIBytesToEvent(bendUp, 3).value1 > 0.49f);
+
+  uint8_t noStatus[2]{0x40, 0x40};
+  REQUIRE(MIDIBytesToEvent(noStatus, 2).type == kNull);
+
+  // packets get sample offsets from their times.
+  AudioContext context(0, 2, 48000);
+  const auto& processTime = context.getTimeInfo();
+  auto start = MIDIClock::now();
+  auto ms = [&](double t)
+  { return start + std::chrono::duration_cast<MIDIClock::duration>(
+                       std::chrono::duration<double, std::milli>(t)); };
+  std::vector<MIDIPacket> packets{
+      makePacket(ms(-1.), {0x90, 60, 100}),  makePacket(ms(1.), {0xB0, 74, 64}),
+      makePacket(ms(1.5), {0xF8}),           makePacket(ms(2.), {0xD0, 100}),
+      makePacket(ms(100.), {0x80, 60, 0}),
+  };
+  constexpr int kBufferSize{256};
+  std::vector<Event> events(packets.size());
+  size_t n = MIDIPacketsToEvents(packets.data(), packets.size(), start, processTime, kBufferSize,
+                                 events.data());
+
+  // the timing clock message makes no event.
+  REQUIRE(n == 4);
+  REQUIRE(events[0].type == kNoteOn);
+  REQUIRE(events[0].time == 0);
+  REQUIRE(events[1].type == kController);
+  REQUIRE(std::abs(events[1].time - 48) <= 1);
+  REQUIRE(events[2].type == kChannelPressure);
+  REQUIRE(std::abs(events[2].time - 96) <= 1);
+  REQUIRE(events[3].type == kNoteOff);
+  REQUIRE(events[3].time == kBufferSize - 1);
+}
+
+TEST_CASE("madronalib/core/events/scheduler", "[events]")
+{
+  AudioContext context(0, 2, 48000);
+  context.setInputPolyphony(1);
+  const auto& processTime = context.getTimeInfo();
+  const double startSeconds{1000.};
+  auto ms = [&](double t) { return doubleToTime(startSeconds + t / 1000.); };
+
+  EventScheduler scheduler(16);
+  scheduler.schedule(ms(10.), makeEvent(kNoteOff, 0, 0.f));
+  scheduler.schedule(ms(2.), makeEvent(kController, 0, 2.f));
+  scheduler.schedule(ms(1.), makeEvent(kNoteOn, 0, 1.f));
+  scheduler.schedule(ms(2.), makeEvent(kController, 0, 3.f));
+  scheduler.schedule(ms(-1.), makeEvent(kNotePressure, 0, 0.f));
+  scheduler.schedule(EventScheduler::kImmediately, makeEvent(kProgramChange, 0, 0.f));
+
+  // the first buffer starts the mapping of samples to times.
+  constexpr int kBufferSize{256};
+  std::vector<Event> events(8);
+  size_t n = scheduler.readEvents(ms(0.), processTime, kBufferSize, events.data(), events.size());
+  REQUIRE(n == 5);
+  REQUIRE(events[0].type == kProgramChange);
+  REQUIRE(events[0].time == 0);
+  REQUIRE(events[1].type == kNotePressure);
+  REQUIRE(events[1].time == 0);
+  REQUIRE(scheduler.getLateEventCount() == 1);
+  REQUIRE(events[2].type == kNoteOn);
+  REQUIRE(std::abs(events[2].time - 48) <= 1);
+
+  // events at the same time stay in the order they were scheduled.
+  REQUIRE(events[3].value1 == 2.f);
+  REQUIRE(events[4].value1 == 3.f);
+  REQUIRE(std::abs(events[4].time - 96) <= 1);
+
+  // a late callback hardly moves the next buffer.
+  for (int i = 0; i < kBufferSize / kFloatsPerDSPVector; ++i)
+  {
+    context.processVector(0);
+  }
+  const double bufferMs = kBufferSize * 1000. / 48000.;
+  n = scheduler.readEvents(ms(bufferMs + 0.5), processTime, kBufferSize, events.data(),
+                           events.size());
+  REQUIRE(n == 1);
+  REQUIRE(events[0].type == kNoteOff);
+  REQUIRE(std::abs(events[0].time - (480 - kBufferSize)) <= 1);
+
+  // events added to the context arrive in its event buffer.
+  scheduler.schedule(EventScheduler::kImmediately, makeNote(kNoteOn, 60));
+  scheduler.addEventsToContext(ms(2. * bufferMs), context, kBufferSize);
+  context.processVector(0);
+  const auto& gate = context.getInputVoice(context.getNewestInputVoice()).outputs.constRow(kGate);
+  REQUIRE(gate[kFloatsPerDSPVector - 1] > 0.f);
+  context.clearInputEvents();
+}
+
+TEST_CASE("madronalib/core/events/voice-culling", "[events]")
+{
+  AudioContext ctx(0, 1, 48000);
+  ctx.setInputPolyphony(3);
+  DecaySynth synth;
+  synth.setVoiceCulling(1.0e-4f, 7.5f * kFloatsPerDSPVector / 48000.f);
+  DSPVectorDynamic inputs, outputs(1);
+  auto process = [&](int vectors) {
+    for (int i = 0; i < vectors; ++i)
+    {
+      ctx.processVector(0);
+      synth.processVector(inputs, outputs, &ctx);
+      ctx.clearInputEvents();
+    }
+  };
+
+  ctx.addInputEvent(makeNote(kNoteOn, 60));
+  ctx.addInputEvent(makeNote(kNoteOn, 62));
+  process(1);
+  REQUIRE(ctx.getInputVoice(0).creatorKeyIdx_ == 60);
+  REQUIRE(ctx.getInputVoice(1).creatorKeyIdx_ == 62);
+
+  // after release, the voice decays below the threshold in 14 vectors, then
+  // is culled after being quiet for more than 7.5 vectors, or 8 vectors.
+  ctx.addInputEvent(makeNote(kNoteOff, 60, 0.f));
+  process(20);
+  REQUIRE(!synth.isVoiceCulled(0));
+  process(1);
+  REQUIRE(synth.isVoiceCulled(0));
+  int renders = synth.renders[0];
+  process(10);
+  REQUIRE(synth.renders[0] == renders);
+  REQUIRE(!synth.isVoiceCulled(1));
+
+  // the silent voice that was never played is culled too.
+  REQUIRE(synth.isVoiceCulled(2));
+  REQUIRE(synth.getActiveVoiceCount() == 1);
+
+  // the voice culled most recently is reused first.
+  ctx.addInputEvent(makeNote(kNoteOn, 64));
+  process(1);
+  REQUIRE(ctx.getInputVoice(0).creatorKeyIdx_ == 64);
+  REQUIRE(!synth.isVoiceCulled(0));
+  REQUIRE(synth.renders[0] == renders + 1);
+  REQUIRE(synth.levels[0] == 1.f);
+}
@@ -0,0 +1,107 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// a unit test made using the Catch framework in catch.hpp / tests.cpp.
+
+#include "catch.hpp"
+#include "MLMemoryReport.h"
+#include "MLProcessorGraph.h"
+
+using namespace ml;
+
+namespace
+{
+class DelayProcessor : public SignalProcessor
+{
+ public:
+  explicit DelayProcessor(float maxDelay) { delay_.setMaxDelayInSamples(maxDelay); }
+
+  void processVector(const DSPVectorDynamic& inputs, DSPVectorDynamic& outputs, void*) override
+  {
+    outputs[0] = delay_(inputs[0]);
+  }
+
+  void reportMemory(MemoryReport& r) const override
+  {
+    r.add("delay", delay_.getMemoryBytes(), delay_.getRequestedMemoryBytes());
+    SignalProcessor::reportMemory(r);
+  }
+
+ private:
+  IntegerDelay delay_;
+};
+}  // namespace
+
+TEST_CASE("madronalib/core/memory-report", "[memory_report]")
+{
+  // delay buffers are rounded up to a power of two.
+  IntegerDelay delay;
+  delay.setMaxDelayInSamples(1000.f);
+  const size_t requested = (1000 + kFloatsPerDSPVector) * sizeof(float);
+  REQUIRE(delay.getRequestedMemoryBytes() == requested);
+  const size_t rounded = (1000 + kFloatsPerDSPVector > 1024) ? 2048 : 1024;
+  REQUIRE(delay.getMemoryBytes() == rounded * sizeof(float));
+
+  DSPBuffer buffer;
+  buffer.resize(3000);
+  REQUIRE(buffer.getRequestedMemoryBytes() == 3000 * sizeof(float));
+  REQUIRE(buffer.getMemoryBytes() >= 4096 * sizeof(float));
+
+  // entries at the same path are summed, and totals roll up by prefix.
+  MemoryReport r;
+  for (const char* voice : {"voices/voice0/delay", "voices/voice1/delay"})
+  {
+    r.add(runtimePath(voice), delay.getMemoryBytes(), delay.getRequestedMemoryBytes());
+  }
+  r.add(runtimePath("voices/voice1/delay"), 100);
+  r.add(runtimePath("buffer"), buffer.getMemoryBytes(), buffer.getRequestedMemoryBytes());
+  REQUIRE(r.getNumEntries() == 3);
+  REQUIRE(r.getTotal(runtimePath("voices/voice0")).bytes == delay.getMemoryBytes());
+  REQUIRE(r.getTotal(runtimePath("voices/voice1")).bytes == delay.getMemoryBytes() + 100);
+
+  const auto voices = r.getTotal(runtimePath("voices"));
+  REQUIRE(voices.requestedBytes == 2 * requested + 100);
+  REQUIRE(voices.getSlackBytes() == 2 * (delay.getMemoryBytes() - requested));
+  REQUIRE(r.getTotal().bytes == voices.bytes + buffer.getMemoryBytes());
+
+  // bytes and slack_bytes for each entry and the total.
+  auto messages = r.getMessages(runtimePath("memory"));
+  REQUIRE(messages.size() == 8);
+  REQUIRE(messages.back().address == runtimePath("memory/slack_bytes"));
+
+  // Trees grow with their nodes.
+  Tree<int> tree;
+  const size_t emptyBytes = tree.getMemoryBytes();
+  tree[runtimePath("a/b/c")] = 1;
+  tree[runtimePath("a/b/d")] = 2;
+  REQUIRE(tree.getMemoryBytes() > emptyBytes);
+
+  MemoryReport symbols;
+  symbols.add(runtimePath("symbols"), theSymbolTable());
+  REQUIRE(symbols.getTotal().bytes > 0);
+}
+
+TEST_CASE("madronalib/core/memory-report/processor_graph", "[memory_report]")
+{
+  DelayProcessor p1(1000.f), p2(5000.f);
+  ProcessorGraph g;
+  auto in = g.addBus(1);
+  auto mid = g.addBus(1);
+  auto out = g.addBus(1);
+  g.addProcessor(&p1, in, mid);
+  g.addProcessor(&p2, mid, out);
+  REQUIRE(g.compile());
+
+  MemoryReport r;
+  g.reportMemory(r);
+
+  // each processor's report is under its node ID.
+  MemoryReport r1, r2;
+  p1.reportMemory(r1);
+  p2.reportMemory(r2);
+  REQUIRE(r.getTotal(runtimePath("processors/0")).bytes == r1.getTotal().bytes);
+  REQUIRE(r.getTotal(runtimePath("processors/1/delay")).bytes == 8192 * sizeof(float));
+  REQUIRE(r.getTotal(runtimePath("processors")).bytes == r1.getTotal().bytes + r2.getTotal().bytes);
+  REQUIRE(r.getTotal(runtimePath("buses")).bytes >= 3 * sizeof(DSPVector));
+}
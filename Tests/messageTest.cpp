@@ -95,3 +95,224 @@ TEST_CASE("madronalib/core/message", "[message]")
   */
 
 }
+
+struct CountingActor : public Actor
+{
+  CountingActor(ActorQueueType t) : Actor(t) {}
+  ~CountingActor() { stop(); }
+  void onMessage(Message m) override
+  {
+    sum += m.value.getIntValue();
+    count++;
+  }
+  std::atomic<int> sum{0};
+  std::atomic<int> count{0};
+};
+
+TEST_CASE("madronalib/core/message/actor", "[message][threads]")
+{
+  constexpr int kSenders{3};
+  constexpr int kMessagesPerSender{1000};
+  CountingActor actor(ActorQueueType::kMultipleProducers);
+  actor.resizeQueue(4096);
+  actor.startMessageDriven();
+  REQUIRE(actor.isMessageDriven());
+
+  // a single message should be handled long before a Timer tick.
+  actor.enqueueMessage(Message("test", 1));
+  auto start = steady_clock::now();
+  while (actor.count < 1 && steady_clock::now() - start < milliseconds(1000))
+  {
+    std::this_thread::yield();
+  }
+  REQUIRE(actor.count == 1);
+
+  // messages from several threads are all handled.
+  std::vector<std::thread> senders;
+  for (int s = 0; s < kSenders; ++s)
+  {
+    senders.emplace_back([&actor]() {
+      for (int i = 0; i < kMessagesPerSender; ++i)
+      {
+        actor.enqueueMessage(Message("test", 1));
+        if ((i & 63) == 0) std::this_thread::sleep_for(microseconds(100));
+      }
+    });
+  }
+  for (auto& t : senders) t.join();
+
+  start = steady_clock::now();
+  const int expected = 1 + kSenders * kMessagesPerSender;
+  while (actor.count < expected && steady_clock::now() - start < milliseconds(2000))
+  {
+    std::this_thread::sleep_for(milliseconds(1));
+  }
+  actor.stop();
+  REQUIRE(!actor.isMessageDriven());
+  REQUIRE(actor.count == expected);
+  REQUIRE(actor.sum == expected);
+}
+
+TEST_CASE("madronalib/core/message/actorRef", "[message]")
+{
+  ActorRef ref;
+  {
+    CountingActor actor(ActorQueueType::kMultipleProducers);
+    registerActor("counter", &actor);
+    ref = getActorRef("counter");
+    REQUIRE(ref.isValid());
+    REQUIRE(sendMessageToActor(ref, Message("test", 2)));
+    REQUIRE(sendMessageToActor(ref, Message("test", 3)));
+    actor.handleMessagesInQueue();
+    REQUIRE(actor.sum == 5);
+
+    // after removal the ref sends nothing, even to a new Actor with the same name.
+    removeActor(&actor);
+    REQUIRE(!ref.isValid());
+    CountingActor actor2(ActorQueueType::kMultipleProducers);
+    registerActor("counter", &actor2);
+    REQUIRE(!sendMessageToActor(ref, Message("test", 1)));
+    REQUIRE(getActorRef("counter").isValid());
+    removeActor(&actor2);
+  }
+  REQUIRE(!sendMessageToActor(ref, Message("test", 1)));
+  REQUIRE(!getActorRef("nobody").isValid());
+}
+
+TEST_CASE("madronalib/core/message/compact", "[message]")
+{
+  // round trips keep the address, value and flags.
+  std::vector<Message> messages{
+      Message("a/b", 1.5f, kMsgFromUI),
+      Message("a/b/c/d/e/f", 7),
+      Message("text", "short"),
+      Message("text", "a text that is too long to store inline"),
+      Message("array", Value{1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f, 8.f}),
+      Message("none")};
+  for (const auto& m : messages)
+  {
+    CompactMessage c(m);
+    REQUIRE(c);
+    Message r = c.takeMessage();
+    REQUIRE(r.address == m.address);
+    REQUIRE(r.value == m.value);
+    REQUIRE(r.flags == m.flags);
+  }
+  REQUIRE(!CompactMessage(Message()));
+
+  // each address is stored once.
+  const Path* p1 = theMessagePathTable().intern(Path("a/b"));
+  const Path* p2 = theMessagePathTable().intern(runtimePath("a/b"));
+  REQUIRE(p1 == p2);
+  REQUIRE(*p1 == Path("a/b"));
+
+  REQUIRE(sizeof(CompactMessage) * 2 < sizeof(Message));
+
+  // big values are moved through the queue, not copied.
+  Queue<CompactMessage> q(4);
+  Value big{1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f, 8.f, 9.f, 10.f, 11.f, 12.f, 13.f, 14.f, 15.f, 16.f};
+  REQUIRE(!big.isStoredLocally());
+  const float* pData = big.getFloatArrayPtr();
+  REQUIRE(q.push(CompactMessage(Message("big", std::move(big)))));
+  CompactMessage c;
+  REQUIRE(q.pop(c));
+  REQUIRE(c.takeMessage().value.getFloatArrayPtr() == pData);
+}
+
+struct OrderingActor : public Actor
+{
+  OrderingActor() : Actor(ActorQueueType::kSingleProducer) { resizeQueue(1024); }
+  ~OrderingActor() { stop(); }
+  void onMessage(Message m) override
+  {
+    int v = m.value.getIntValue();
+    if (v != last + 1) inOrder = false;
+    last = v;
+    count++;
+  }
+  int last{0};
+  bool inOrder{true};
+  std::atomic<int> count{0};
+};
+
+TEST_CASE("madronalib/core/message/executor", "[message][threads]")
+{
+  constexpr int kActors{100};
+  constexpr int kMessagesPerActor{200};
+  ActorExecutor executor(3);
+  REQUIRE(executor.getNumThreads() == 3);
+
+  std::vector<std::unique_ptr<OrderingActor> > actors;
+  for (int i = 0; i < kActors; ++i)
+  {
+    actors.push_back(std::make_unique<OrderingActor>());
+    actors.back()->startOnExecutor(executor);
+    REQUIRE(actors.back()->isOnExecutor());
+  }
+  REQUIRE(executor.getNumActors() == kActors);
+
+  // interleave the messages to the Actors, which all get handled in order.
+  for (int m = 1; m <= kMessagesPerActor; ++m)
+  {
+    for (auto& a : actors)
+    {
+      a->enqueueMessage(Message("test", m));
+    }
+  }
+  auto allDone = [&]() {
+    for (auto& a : actors)
+    {
+      if (a->count < kMessagesPerActor) return false;
+    }
+    return true;
+  };
+  auto start = steady_clock::now();
+  while (!allDone() && steady_clock::now() - start < milliseconds(5000))
+  {
+    std::this_thread::sleep_for(milliseconds(1));
+  }
+  REQUIRE(allDone());
+  for (auto& a : actors)
+  {
+    REQUIRE(a->inOrder);
+  }
+
+  // stopped Actors leave the executor.
+  for (auto& a : actors)
+  {
+    a->stop();
+    REQUIRE(!a->isOnExecutor());
+  }
+  REQUIRE(executor.getNumActors() == 0);
+}
+
+TEST_CASE("madronalib/core/message/executor-restart", "[message][threads]")
+{
+  // an Actor stopped and started again while messages are sent to it still gets all of them.
+  constexpr int kMessages{20000};
+  ActorExecutor executor(2);
+  OrderingActor a;
+  a.resizeQueue(kMessages);
+  a.startOnExecutor(executor);
+
+  std::thread sender([&]() {
+    for (int m = 1; m <= kMessages; ++m)
+    {
+      a.enqueueMessage(Message("test", m));
+    }
+  });
+  for (int i = 0; i < 200; ++i)
+  {
+    a.stop();
+    a.startOnExecutor(executor);
+  }
+  sender.join();
+
+  auto start = steady_clock::now();
+  while ((a.count < kMessages) && steady_clock::now() - start < milliseconds(5000))
+  {
+    std::this_thread::sleep_for(milliseconds(1));
+  }
+  REQUIRE(a.count == kMessages);
+  REQUIRE(a.inOrder);
+}
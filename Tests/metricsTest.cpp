@@ -0,0 +1,149 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// a unit test made using the Catch framework in catch.hpp / tests.cpp.
+
+#include <thread>
+
+#include "catch.hpp"
+#include "MLMetrics.h"
+#include "MLQueue.h"
+
+using namespace ml;
+
+namespace
+{
+float findValue(const MessageList& messages, Path p)
+{
+  for (const auto& m : messages)
+  {
+    if (m.address == p) return m.value.getFloatValue();
+  }
+  return -1.f;
+}
+
+struct CollectingActor : public Actor
+{
+  CollectingActor() : Actor(ActorQueueType::kMultipleProducers) { resizeQueue(256); }
+  ~CollectingActor() { stop(); }
+  void onMessage(Message m) override
+  {
+    if (m.address == Path("metrics/voices/notes")) notes = m.value.getFloatValue();
+  }
+  std::atomic<float> notes{0.f};
+};
+}  // namespace
+
+TEST_CASE("madronalib/core/metrics", "[metrics]")
+{
+  Metrics metrics;
+  MetricCounter* notes = metrics.getCounter("voices/notes");
+  MetricGauge* level = metrics.getGauge("output/level");
+  MetricHistogram* load = metrics.getHistogram("audio/load", 0.f, 1.f, 4);
+
+  // looking up a Path again gives the same metric, and a Path of another kind gives nothing.
+  REQUIRE(metrics.getCounter("voices/notes") == notes);
+  REQUIRE(metrics.getGauge("voices/notes") == nullptr);
+  REQUIRE(metrics.getNumMetrics() == 3);
+
+  // counters can be written from many threads at once.
+  std::vector<std::thread> writers;
+  for (int t = 0; t < 4; ++t)
+  {
+    writers.emplace_back(
+        [&]()
+        {
+          for (int i = 0; i < 1000; ++i)
+          {
+            notes->add();
+            load->record(0.3f);
+          }
+        });
+  }
+  for (auto& w : writers) w.join();
+  REQUIRE(notes->get() == 4000);
+
+  level->set(0.5f);
+  load->record(-1.f);
+  load->record(0.8f);
+  load->record(2.f);
+  REQUIRE(load->getBinCount(0) == 1);
+  REQUIRE(load->getBinCount(1) == 4000);
+  REQUIRE(load->getBinCount(3) == 2);
+  REQUIRE(load->getCount() == 4003);
+
+  // sources are read when the snapshot is made.
+  Queue<int> queue(16);
+  queue.push(1);
+  queue.push(2);
+  metrics.addQueueDepth("queues/events", queue);
+  AudioCallbackStats stats;
+  stats.record(0.0005, 0.001, true);
+  metrics.addCallbackStats("audio", stats);
+
+  MessageList messages = metrics.getMessages("metrics");
+  REQUIRE(findValue(messages, "metrics/voices/notes") == 4000.f);
+  REQUIRE(findValue(messages, "metrics/output/level") == 0.5f);
+  REQUIRE(findValue(messages, "metrics/audio/load/count") == 4003.f);
+  REQUIRE(findValue(messages, "metrics/queues/events") == 2.f);
+  REQUIRE(findValue(messages, "metrics/audio/xruns") == 1.f);
+  REQUIRE(findValue(messages, "metrics/audio/mean_load") == Approx(0.5f));
+  for (const auto& m : messages)
+  {
+    if (m.address == Path("metrics/audio/load/bins"))
+    {
+      REQUIRE(m.value.getFloatArraySize() == 4);
+    }
+  }
+
+  metrics.removeSources("queues");
+  REQUIRE(findValue(metrics.getMessages(), "queues/events") == -1.f);
+
+  metrics.reset();
+  REQUIRE(notes->get() == 0);
+  REQUIRE(load->getCount() == 0);
+  REQUIRE(level->get() == 0.5f);
+}
+
+TEST_CASE("madronalib/core/metrics/reporter", "[metrics]")
+{
+  SharedResourcePointer<Timers> timers;
+  timers->start();
+
+  Metrics metrics;
+  metrics.getCounter("voices/notes")->add(3);
+
+  // keep the registry alive while the Actor is registered.
+  SharedResourcePointer<ActorRegistry> registry;
+  CollectingActor collector;
+  registerActor("collector", &collector);
+  collector.startMessageDriven();
+
+  size_t published{0};
+  MetricsReporter reporter(metrics);
+  reporter.setAddressPrefix("metrics");
+  reporter.setDestination("collector");
+  reporter.setPublishFn([&](const MessageList& m) { published = m.size(); });
+  reporter.startReporting(milliseconds(10));
+
+  auto start = std::chrono::steady_clock::now();
+  while ((reporter.getReportCount() < 2) &&
+         (std::chrono::steady_clock::now() - start < milliseconds(2000)))
+  {
+    std::this_thread::sleep_for(milliseconds(5));
+  }
+  reporter.stopReporting();
+  REQUIRE(reporter.getReportCount() >= 2);
+  REQUIRE(published == 1);
+
+  start = std::chrono::steady_clock::now();
+  while ((collector.notes != 3.f) &&
+         (std::chrono::steady_clock::now() - start < milliseconds(2000)))
+  {
+    std::this_thread::sleep_for(milliseconds(5));
+  }
+  REQUIRE(collector.notes == 3.f);
+
+  removeActor(&collector);
+}
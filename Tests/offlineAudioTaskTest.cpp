@@ -0,0 +1,231 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// a unit test made using the Catch framework in catch.hpp / tests.cpp.
+
+#include <cstdio>
+
+#include "catch.hpp"
+#include "MLBatchRenderer.h"
+#include "MLOfflineAudioTask.h"
+
+using namespace ml;
+
+namespace offlineAudioTaskTest
+{
+// double each input.
+void processGain(AudioContext* ctx, void*)
+{
+  for (size_t c = 0; c < ctx->outputs.size(); ++c)
+  {
+    ctx->outputs[c] = ctx->inputs[c] * 2.f;
+  }
+}
+
+// output the gate of the first voice.
+void processGate(AudioContext* ctx, void*)
+{
+  ctx->outputs[0] = ctx->getInputVoice(0).outputs.constRow(kGate);
+}
+
+// note whether denormals are flushed while processing.
+void processFlushCheck(AudioContext*, void* state)
+{
+  *static_cast<bool*>(state) = isFlushingDenormalsToZero();
+}
+
+// outputs the gate of the first voice times the gain parameter.
+class GainProcessor : public SignalProcessor
+{
+ public:
+  GainProcessor()
+  {
+    ParameterDescriptionList pdl;
+    pdl.push_back(std::make_unique<ParameterDescription>(
+        WithValues{{"name", "gain"}, {"range", {0, 1}}, {"plaindefault", 1.0}}));
+    buildParams(pdl);
+    setDefaultParams();
+  }
+
+  void processVector(const DSPVectorDynamic&, DSPVectorDynamic& outputs, void* stateData) override
+  {
+    auto* context = static_cast<AudioContext*>(stateData);
+    outputs[0] = context->getInputVoice(0).outputs.constRow(kGate) * getRealFloatParam(size_t(0));
+  }
+};
+}  // namespace offlineAudioTaskTest
+
+using namespace offlineAudioTaskTest;
+
+TEST_CASE("madronalib/core/offline/memory", "[offline]")
+{
+  constexpr size_t kFrames = 3000;
+  std::vector<float> left(kFrames), right(kFrames);
+  for (size_t i = 0; i < kFrames; ++i)
+  {
+    left[i] = i / float(kFrames);
+    right[i] = -left[i];
+  }
+  const float* inputs[2]{left.data(), right.data()};
+
+  AudioContext ctx(2, 2, 48000);
+  OfflineAudioTask task(&ctx, processGain, nullptr, 300);
+  task.setInput(inputs, 2, kFrames);
+
+  // render in ragged chunks, past the end of the input.
+  std::vector<float> outL(kFrames + 200), outR(kFrames + 200);
+  size_t done{0};
+  for (size_t n : {1, 99, 700, 64, 1536, 800})
+  {
+    float* outputs[2]{outL.data() + done, outR.data() + done};
+    task.render(outputs, n);
+    done += n;
+  }
+  REQUIRE(task.getFramesRendered() == done);
+
+  bool ok{true};
+  for (size_t i = 0; i < done; ++i)
+  {
+    float expected = (i < kFrames) ? left[i] * 2.f : 0.f;
+    ok &= (outL[i] == expected) && (outR[i] == -expected);
+  }
+  REQUIRE(ok);
+}
+
+TEST_CASE("madronalib/core/offline/denormals", "[offline]")
+{
+  if (!kFlushDenormalsBits || !kFlushDenormalsAutomatically) return;
+
+  // denormals are flushed during the render, and the caller's setting is restored after it.
+  bool flushing{false};
+  AudioContext ctx(0, 1, 48000);
+  OfflineAudioTask task(&ctx, processFlushCheck, &flushing);
+  std::vector<float> out(kFloatsPerDSPVector);
+  float* outputs[1]{out.data()};
+  bool wasFlushing = isFlushingDenormalsToZero();
+  task.render(outputs, kFloatsPerDSPVector);
+  REQUIRE(flushing);
+  REQUIRE(isFlushingDenormalsToZero() == wasFlushing);
+}
+
+TEST_CASE("madronalib/core/offline/events", "[offline]")
+{
+  AudioContext ctx(0, 1, 48000);
+  ctx.setInputPolyphony(1);
+  OfflineAudioTask task(&ctx, processGate, nullptr);
+
+  constexpr uint64_t kNoteFrame{1000};
+  Event on;
+  on.type = kNoteOn;
+  on.value1 = 60.f;
+  on.value2 = 1.f;
+  task.addEvent(on, kNoteFrame);
+
+  std::vector<float> out(2048);
+  float* outputs[1]{out.data()};
+  task.render(outputs, 700);
+  outputs[0] += 700;
+  task.render(outputs, out.size() - 700);
+
+  REQUIRE(out[kNoteFrame - 1] == 0.f);
+  REQUIRE(out[kNoteFrame] == 1.f);
+}
+
+TEST_CASE("madronalib/core/offline/wav", "[offline]")
+{
+  constexpr size_t kFrames = 1000;
+  std::vector<float> left(kFrames), right(kFrames);
+  for (size_t i = 0; i < kFrames; ++i)
+  {
+    left[i] = 0.25f * sinf(i * 0.1f);
+    right[i] = 0.125f * cosf(i * 0.07f);
+  }
+  const float* inputs[2]{left.data(), right.data()};
+  const char* path = "offlineAudioTaskTest.wav";
+
+  for (auto format : {OfflineAudioTask::FileFormat::kFloat32, OfflineAudioTask::FileFormat::kInt16,
+                      OfflineAudioTask::FileFormat::kInt24})
+  {
+    // render doubled input to a file.
+    AudioContext ctx(2, 2, 44100);
+    OfflineAudioTask writer(&ctx, processGain, nullptr);
+    writer.setInput(inputs, 2, kFrames);
+    REQUIRE(writer.renderToWavFile(path, kFrames, format));
+
+    // read it back in and double it again.
+    OfflineAudioTask reader(&ctx, processGain, nullptr);
+    REQUIRE(reader.setInputFromWavFile(path));
+    REQUIRE(reader.getInputFrames() == kFrames);
+    REQUIRE(reader.getInputFileSampleRate() == 44100);
+
+    std::vector<float> outL(kFrames), outR(kFrames);
+    float* outputs[2]{outL.data(), outR.data()};
+    reader.render(outputs, kFrames);
+
+    float tolerance = (format == OfflineAudioTask::FileFormat::kInt16) ? 4.f / 32767.f : 1e-5f;
+    float maxDiff{0.f};
+    for (size_t i = 0; i < kFrames; ++i)
+    {
+      maxDiff = std::max(maxDiff, fabsf(outL[i] - left[i] * 4.f));
+      maxDiff = std::max(maxDiff, fabsf(outR[i] - right[i] * 4.f));
+    }
+    REQUIRE(maxDiff < tolerance);
+  }
+  std::remove(path);
+}
+
+TEST_CASE("madronalib/core/offline/batch", "[offline]")
+{
+  BatchRenderConfig config;
+  config.frames = 4096;
+  config.nOutputs = 1;
+  config.polyphony = 1;
+  config.threads = 1;
+
+  Event on;
+  on.type = kNoteOn;
+  on.value1 = 60.f;
+  on.value2 = 1.f;
+  std::vector<BatchRenderer::ScriptEvent> script{{1000, on}};
+
+  // eight presets with four different gains.
+  std::vector<Tree<Value>> presets(8);
+  for (size_t i = 0; i < presets.size(); ++i)
+  {
+    presets[i].add("gain", Value(float(i % 4) / 4.f));
+  }
+  auto factory = []() { return std::make_unique<GainProcessor>(); };
+
+  BatchRenderer serial(factory, config);
+  serial.setScript(script);
+  auto expected = serial.render(presets);
+  REQUIRE(expected.size() == presets.size());
+
+  // the same presets give the same hashes, and different ones differ.
+  for (size_t i = 0; i < presets.size(); ++i)
+  {
+    REQUIRE(expected[i].ok);
+    REQUIRE(expected[i].hash == expected[i % 4].hash);
+    if (i > 0 && i < 4) REQUIRE(expected[i].hash != expected[i - 1].hash);
+  }
+
+  // rendering in parallel doesn't change the results.
+  config.threads = 4;
+  BatchRenderer parallel(factory, config);
+  parallel.setScript(script);
+  auto results = parallel.render(presets);
+  for (size_t i = 0; i < presets.size(); ++i)
+  {
+    REQUIRE(results[i].hash == expected[i].hash);
+  }
+
+  // renders written to files hash the same.
+  config.outputDirectory = ".";
+  BatchRenderer writer(factory, config);
+  writer.setScript(script);
+  auto written = writer.render({presets[1]});
+  REQUIRE(written[0].ok);
+  REQUIRE(written[0].hash == expected[1].hash);
+  std::remove("./00000.wav");
+}
@@ -7,6 +7,11 @@
 #include "catch.hpp"
 #include "madronalib.h"
 #include "MLTestUtils.h"
+#include "MLSignalProcessor.h"
+#include "MLSmoothingBank.h"
+#include "MLVoiceModulation.h"
+
+#include <thread>
 
 using namespace ml;
 
@@ -79,3 +84,463 @@ TEST_CASE("madronalib/core/parameters", "[parameters]")
     }
   }
 }
+
+TEST_CASE("madronalib/core/parameters/compiled", "[parameters]")
+{
+  ParameterTree params;
+  ParameterDescriptionList pdl;
+  readParameterDescriptions(pdl);
+  pdl.push_back( std::make_unique< ParameterDescription >(WithValues{
+    { "name", "list-param" },
+    { "units", "list" },
+    { "listitems", "4/8/16/32" },
+    { "use_list_values_as_int", true },
+    { "integer_values", true }
+  } ) );
+  buildParameterTree(pdl, params);
+
+  std::vector< Path > paramNames;
+  for(auto& pd : pdl)
+  {
+    paramNames.push_back(runtimePath(pd->getTextProperty("name")));
+  }
+  paramNames.push_back("no-such-param");
+  params.compileParameters(paramNames);
+  REQUIRE(params.getNumCompiledParameters() == paramNames.size());
+
+  // conversions by ID match conversions by name
+  for(size_t id = 0; id < paramNames.size(); ++id)
+  {
+    Path pname = paramNames[id];
+    int nSteps{10};
+    for(int i=0; i<=nSteps; ++i)
+    {
+      float fNorm = i/float(nSteps);
+      float fReal = params.convertNormalizedToRealFloatValue(pname, fNorm);
+      REQUIRE(params.convertNormalizedToRealFloatValue(id, fNorm) == fReal);
+      REQUIRE(params.convertRealToNormalizedFloatValue(id, fReal) ==
+              params.convertRealToNormalizedFloatValue(pname, fReal));
+      REQUIRE(params.convertNormalizedToRealValue(id, Value(fNorm)) ==
+              params.convertNormalizedToRealValue(pname, Value(fNorm)));
+    }
+  }
+
+  // DSPVector conversions match the float conversions
+  DSPVector norm([](int i) { return i / (kFloatsPerDSPVector - 1.f); });
+  for(size_t id = 0; id + 1 < pdl.size(); ++id)
+  {
+    DSPVector real = params.convertNormalizedToReal(id, norm);
+    DSPVector norm2 = params.convertRealToNormalized(id, real);
+    for(int i = 0; i < kFloatsPerDSPVector; ++i)
+    {
+      float expected = params.convertNormalizedToRealFloatValue(id, norm[i]);
+      REQUIRE(testUtils::nearlyEqual(real[i], expected, 1.0e-5f * std::max(1.f, expected)));
+      REQUIRE(testUtils::nearlyEqual(norm2[i], norm[i], 1.0e-5f));
+    }
+  }
+
+  size_t listID = pdl.size() - 1;
+  REQUIRE(params.getCompiledParameter(listID).listValues.size() == 4);
+  REQUIRE(params.convertNormalizedToRealFloatValue(listID, 1.0f) == 32.f);
+  REQUIRE(params.convertNormalizedToRealValue(listID, Value(0.4f)).getType() == Value::kInt);
+  REQUIRE(params.convertRealToNormalizedFloatValue(listID, 8.f) == Approx(1.f / 3.f));
+  REQUIRE(params.convertRealToNormalizedFloatValue(listID, 7.f) == 0.f);
+  REQUIRE(params.convertNormalizedToRealFloatValue(paramNames.size() - 1, 0.5f) == 0.f);
+}
+
+TEST_CASE("madronalib/core/parameters/store", "[parameters]")
+{
+  constexpr size_t kParams{64};
+  ParameterStore store(kParams);
+  REQUIRE(!store.update());
+  REQUIRE(store.get(0) == 0.f);
+
+  // nothing is visible until published
+  store.set(3, 1.5f);
+  REQUIRE(!store.update());
+  store.publish();
+  REQUIRE(store.get(3) == 0.f);
+  REQUIRE(store.update());
+  REQUIRE(store.get(3) == 1.5f);
+  REQUIRE(!store.update());
+  REQUIRE(store.get(3) == 1.5f);
+
+  // publish all values equal on one thread, while reading on another. Every snapshot read
+  // should have all its values equal, and the values should never go backwards.
+  store.resize(kParams);
+  constexpr int kPublishes{20000};
+  std::atomic<bool> done{false};
+  bool consistent{true};
+  bool ordered{true};
+  float lastSeen{0.f};
+  std::thread reader([&]() {
+    bool finished{false};
+    while (!finished)
+    {
+      // after done is set, one more update takes the last publish.
+      finished = done.load(std::memory_order_acquire);
+      store.update();
+      const float* vals = store.getValues();
+      for (size_t i = 1; i < kParams; ++i)
+      {
+        consistent &= (vals[i] == vals[0]);
+      }
+      ordered &= (vals[0] >= lastSeen);
+      lastSeen = vals[0];
+    }
+  });
+  for (int n = 1; n <= kPublishes; ++n)
+  {
+    for (size_t i = 0; i < kParams; ++i)
+    {
+      store.set(i, (float)n);
+    }
+    store.publish();
+  }
+  done.store(true, std::memory_order_release);
+  reader.join();
+
+  REQUIRE(consistent);
+  REQUIRE(ordered);
+  REQUIRE(lastSeen == (float)kPublishes);
+}
+
+namespace parametersTest
+{
+class ParamsProcessor : public SignalProcessor
+{
+ public:
+  ParamsProcessor()
+  {
+    ParameterDescriptionList pdl;
+    readParameterDescriptions(pdl);
+    buildParams(pdl);
+    setDefaultParams();
+  }
+  size_t getID(Path pname) { return paramIDsByName_[pname]; }
+};
+}  // namespace parametersTest
+
+TEST_CASE("madronalib/core/parameters/processor", "[parameters]")
+{
+  parametersTest::ParamsProcessor proc;
+  size_t logID = proc.getID("log-param");
+  REQUIRE(logID == 1);
+
+  // defaults are published with the first publish
+  proc.publishParams();
+  proc.updateParamSnapshot();
+  REQUIRE(proc.getRealFloatParam(logID) == Approx(0.05f));
+
+  // setting by name or by ID stages the real value
+  proc.setParamFromNormalizedValue(Path("linear-param"), 0.25f);
+  proc.setParamFromRealValue(logID, 0.5f);
+  REQUIRE(proc.getRealFloatParam(logID) == Approx(0.05f));
+  proc.publishParams();
+  REQUIRE(proc.updateParamSnapshot());
+  REQUIRE(proc.getRealFloatParam(size_t(0)) == 0.25f);
+  REQUIRE(proc.getRealFloatParam(logID) == 0.5f);
+  REQUIRE(proc.getRealFloatParam(Path("log-param")) == 0.5f);
+
+  // the getters are const, and an ID picks the ID overload.
+  const auto& constProc = proc;
+  REQUIRE(constProc.getRealFloatParam(size_t(0)) == 0.25f);
+  REQUIRE(constProc.getRealFloatParam(0) == 0.25f);
+  REQUIRE(constProc.getRealFloatParam(Path("log-param")) == 0.5f);
+}
+
+namespace parametersTest
+{
+// many parameters of each kind, to fill several chunks of the batch conversion.
+class PresetProcessor : public SignalProcessor
+{
+ public:
+  static constexpr size_t kParams{150};
+  PresetProcessor()
+  {
+    ParameterDescriptionList pdl;
+    for (size_t i = 0; i < kParams; ++i)
+    {
+      const std::string name = "p" + std::to_string(i);
+      const Path pname = runtimePath(name.c_str());
+      auto pd = std::make_unique<ParameterDescription>(WithValues{{"name", name.c_str()}});
+      switch (i % 4)
+      {
+        case 0:
+          pd->setProperty("range", Value{-1.f, float(i)});
+          break;
+        case 1:
+          pd->setProperty("range", Value{20.f, 20000.f});
+          pd->setProperty("log", true);
+          break;
+        case 2:
+          pd->setProperty("range", Value{-2.f, 2.f});
+          pd->setProperty("bisquare", true);
+          break;
+        case 3:
+          pd->setProperty("units", "list");
+          pd->setProperty("listitems", "4/8/16/32");
+          pd->setProperty("use_list_values_as_int", true);
+          pd->setProperty("integer_values", true);
+          break;
+      }
+      pdl.push_back(std::move(pd));
+    }
+    buildParams(pdl);
+    setDefaultParams();
+    publishParams();
+    updateParamSnapshot();
+  }
+  ParameterTree& getParams() { return params_; }
+};
+}  // namespace parametersTest
+
+TEST_CASE("madronalib/core/parameters/apply", "[parameters]")
+{
+  using parametersTest::PresetProcessor;
+  PresetProcessor proc;
+  ParameterTree& params = proc.getParams();
+  constexpr size_t n{PresetProcessor::kParams};
+
+  // the batch conversion matches conversion by ID.
+  std::vector<float> norm(n), real(n);
+  for (size_t id = 0; id < n; ++id)
+  {
+    norm[id] = float((id * 37) % 101) / 100.f;
+  }
+  params.convertNormalizedToRealFloatValues(norm.data(), real.data());
+  for (size_t id = 0; id < n; ++id)
+  {
+    float expected = params.convertNormalizedToRealFloatValue(id, norm[id]);
+    REQUIRE(testUtils::nearlyEqual(real[id], expected, 1.0e-5f * std::max(1.f, fabsf(expected))));
+  }
+
+  // applying a preset changes the tree, and publishes all the values at once.
+  std::vector<size_t> changed;
+  const float before = proc.getRealFloatParam(size_t(5));
+  const size_t nChanged = proc.applyNormalizedParams(norm.data(), &changed);
+  REQUIRE(nChanged == changed.size());
+  REQUIRE(nChanged > n / 2);
+  for (size_t id : {size_t(0), size_t(5), size_t(66), size_t(147)})
+  {
+    const Path pname = runtimePath(("p" + std::to_string(id)).c_str());
+    REQUIRE(params.getNormalizedFloatValueAtPath(pname) == norm[id]);
+    REQUIRE(params.getRealFloatValueAtPath(pname) == Approx(real[id]));
+  }
+  REQUIRE(proc.getRealFloatParam(size_t(5)) == before);
+  REQUIRE(proc.updateParamSnapshot());
+  bool allPublished{true};
+  for (size_t id = 0; id < n; ++id)
+  {
+    allPublished &= (proc.getRealFloatParam(id) == real[id]);
+  }
+  REQUIRE(allPublished);
+  REQUIRE(params.getRealValues()["p3"].getType() == Value::kInt);
+
+  // applying it again changes nothing, and a NaN leaves a parameter as it is.
+  REQUIRE(proc.applyNormalizedParams(norm.data()) == 0);
+  REQUIRE(!proc.updateParamSnapshot());
+  norm[4] = 0.5f;
+  norm[8] = std::nanf("");
+  changed.clear();
+  REQUIRE(proc.applyNormalizedParams(norm.data(), &changed) == 1);
+  REQUIRE(changed == std::vector<size_t>{4});
+
+  // from a tree of values by name, with other values set one at a time.
+  Tree<Value> preset;
+  preset["p1"] = 1.f;
+  preset["p2"] = 0.75f;
+  preset["p4"] = 0.5f;
+  preset["comment"] = "bright";
+  changed.clear();
+  REQUIRE(proc.applyNormalizedParams(preset, &changed) == 2);
+  REQUIRE(changed == std::vector<size_t>{1, 2});
+  REQUIRE(proc.updateParamSnapshot());
+  REQUIRE(proc.getRealFloatParam(size_t(1)) == Approx(20000.f));
+  REQUIRE(params.getNormalizedValues()["comment"] == Value("bright"));
+}
+
+TEST_CASE("madronalib/core/parameters/ramps", "[parameters]")
+{
+  parametersTest::ParamsProcessor proc;
+  size_t linearID = proc.getID("linear-param");
+  size_t logID = proc.getID("log-param");
+  proc.setParamFromNormalizedValue(linearID, 0.f);
+  proc.publishParams();
+  proc.updateParamSnapshot();
+
+  // two events ramp from the snapshot value to each in turn, then hold. The times are 9 and 19
+  // with 64-sample vectors.
+  constexpr int kT1{kFloatsPerDSPVector / 8 + 1};
+  constexpr int kT2{kT1 * 2 + 1};
+  proc.addParamEvent(linearID, kT1, 0.5f);
+  proc.addParamEvent(linearID, kT2, 1.f);
+  proc.addParamEvent(logID, 0, 1.f);
+  proc.setParamFromAudioThread(linearID, 1.f);
+  proc.setParamFromAudioThread(logID, 1.f);
+  proc.publishParams();
+  proc.updateParamSnapshot();
+  proc.updateParamRamps();
+
+  DSPVector ramp = proc.getRealParamRamp(linearID);
+  constexpr int kMid{kT1 + (kT1 + 1) / 2};
+  REQUIRE(ramp[0] == Approx(0.5f / (kT1 + 1)));
+  REQUIRE(ramp[kT1] == 0.5f);
+  REQUIRE(ramp[kMid] == Approx(0.5f + 0.5f * (kMid - kT1) / (kT2 - kT1)));
+  REQUIRE(ramp[kT2] == 1.f);
+  REQUIRE(ramp[kFloatsPerDSPVector - 1] == 1.f);
+
+  // the projection is applied to each sample.
+  DSPVector logRamp = proc.getRealParamRamp(logID);
+  REQUIRE(logRamp[0] == Approx(1.f));
+  REQUIRE(logRamp[kFloatsPerDSPVector - 1] == Approx(1.f));
+
+  // with no events in the next vector, the ramps hold the snapshot values.
+  proc.updateParamRamps();
+  REQUIRE(proc.getRealParamRamp(linearID) == DSPVector(1.f));
+  REQUIRE(proc.getRealParamRamp(size_t(2)) == DSPVector(proc.getRealFloatParam(size_t(2))));
+
+  // integer and list parameters step at each event.
+  ParameterTree params;
+  ParameterDescriptionList pdl;
+  pdl.push_back(std::make_unique<ParameterDescription>(
+      WithValues{{"name", "list-param"},
+                 {"units", "list"},
+                 {"listitems", "4/8/16/32"},
+                 {"use_list_values_as_int", true},
+                 {"integer_values", true}}));
+  buildParameterTree(pdl, params);
+  params.compileParameters({Path("list-param")});
+  ParameterRamps ramps;
+  ramps.resize(params, 1);
+  ramps.setNormalizedValue(0, 0.f);
+  ramps.addEvent(0, 10, 1.f);
+  ramps.process();
+  DSPVector listRamp = ramps.getRamp(0);
+  REQUIRE(listRamp[9] == 4.f);
+  REQUIRE(listRamp[10] == 32.f);
+  REQUIRE(ramps.getValue(0) == 32.f);
+}
+
+TEST_CASE("madronalib/core/parameters/voice_modulation", "[parameters]")
+{
+  ParameterTree params;
+  ParameterDescriptionList pdl;
+  readParameterDescriptions(pdl);
+  buildParameterTree(pdl, params);
+  std::vector< Path > paramNames;
+  for(auto& pd : pdl)
+  {
+    paramNames.push_back(runtimePath(pd->getTextProperty("name")));
+  }
+  params.compileParameters(paramNames);
+
+  constexpr size_t kVoices{4};
+  VoiceModulation mod;
+  mod.resize(paramNames.size(), kVoices);
+  std::vector< float > base{0.5f, 0.05f, 2.f};
+
+  // unmodulated parameters read their base values.
+  mod.update(params, base.data());
+  REQUIRE(!mod.isModulated(0));
+  REQUIRE(mod.getModulatedValue(0, 2, base.data()) == 0.5f);
+
+  // offsets are added to the normalized base value, then projected.
+  mod.setOffset(0, 1, 0.25f);
+  mod.setOffset(1, 2, 0.25f);
+  mod.update(params, base.data());
+  REQUIRE(mod.isModulated(0));
+  REQUIRE(mod.getModulatedValue(0, 0, base.data()) == 0.5f);
+  REQUIRE(mod.getModulatedValue(0, 1, base.data()) == 0.75f);
+  float logNorm = params.convertRealToNormalizedFloatValue(size_t(1), 0.05f);
+  REQUIRE(mod.getModulatedValue(1, 2, base.data()) ==
+          params.convertNormalizedToRealFloatValue(size_t(1), logNorm + 0.25f));
+
+  // sums are clamped to the parameter's range.
+  mod.setOffsetForAllVoices(0, 0.75f);
+  mod.update(params, base.data());
+  REQUIRE(mod.getModulatedValue(0, 3, base.data()) == 1.f);
+
+  // changes to the base value are followed.
+  base[0] = 0.f;
+  mod.update(params, base.data());
+  REQUIRE(mod.getModulatedValue(0, 3, base.data()) == 0.75f);
+
+  // clearing all its offsets stops tracking a parameter.
+  mod.setOffsetForAllVoices(0, 0.f);
+  mod.update(params, base.data());
+  REQUIRE(!mod.isModulated(0));
+  mod.clearVoice(2);
+  mod.update(params, base.data());
+  REQUIRE(!mod.isModulated(1));
+  REQUIRE(mod.getModulatedValue(1, 2, base.data()) == 0.05f);
+}
+
+TEST_CASE("madronalib/core/parameters/smoothing", "[parameters]")
+{
+  // a size that is not a whole number of SIMD vectors
+  constexpr size_t kParams{7};
+  SmoothingBank bank(kParams);
+  bank.setGlideTimeInSamples(kFloatsPerDSPVector * 4);
+  bank.setGlideTimeInSamples(2, kFloatsPerDSPVector * 8);
+
+  LinearGlide glide;
+  glide.setGlideTimeInSamples(kFloatsPerDSPVector * 4);
+  glide(0.f);
+
+  // the ramps match a LinearGlide to the same target.
+  bank.setTarget(1, 1.f);
+  bank.setTarget(2, -2.f);
+  bool rampsMatch{true};
+  for (int v = 0; v < 6; ++v)
+  {
+    bank.process();
+    DSPVector expected = glide(1.f);
+    DSPVector ramp = bank.getRamp(1);
+    for (int i = 0; i < kFloatsPerDSPVector; ++i)
+    {
+      rampsMatch &= testUtils::nearlyEqual(ramp[i], expected[i]);
+    }
+    rampsMatch &= (ramp[kFloatsPerDSPVector - 1] == bank.getValue(1));
+  }
+  REQUIRE(rampsMatch);
+  REQUIRE(bank.getValue(1) == 1.f);
+  REQUIRE(!bank.isGliding(1));
+
+  // the slower glide lands exactly on its target.
+  REQUIRE(bank.isGliding(2));
+  REQUIRE(bank.getValue(2) == Approx(-2.f * 6 / 8));
+  bank.process();
+  bank.process();
+  REQUIRE(bank.getValue(2) == -2.f);
+  REQUIRE(bank.getValue(0) == 0.f);
+
+  // a changed target restarts the glide from the current value.
+  bank.setTarget(1, 0.f);
+  bank.process();
+  REQUIRE(bank.getValue(1) == Approx(0.75f));
+
+  // setValue jumps immediately.
+  bank.setValue(1, 5.f);
+  bank.process();
+  REQUIRE(bank.getValue(1) == 5.f);
+  REQUIRE(bank.getRamp(1) == DSPVector(5.f));
+
+  // targets from a ParameterStore
+  ParameterStore store(kParams);
+  for (size_t i = 0; i < kParams; ++i)
+  {
+    store.set(i, (float)i);
+  }
+  store.publish();
+  store.update();
+  bank.setTargets(store);
+  for (int v = 0; v < 8; ++v)
+  {
+    bank.process();
+  }
+  for (size_t i = 0; i < kParams; ++i)
+  {
+    REQUIRE(bank.getValue(i) == (float)i);
+  }
+}
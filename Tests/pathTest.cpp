@@ -95,3 +95,53 @@ TEST_CASE("madronalib/core/path/init-list", "[path]")
   REQUIRE(sum.getSize() == 12);
 }
 
+
+TEST_CASE("madronalib/core/path/storage", "[path]")
+{
+  // short paths are inline.
+  REQUIRE(sizeof(Path) <= 48);
+
+  Path shortPath("a/b/c/d");
+  Path longPath("a/b/c/d/e/f/g/h");
+  REQUIRE(shortPath.getSize() == 4);
+  REQUIRE(longPath.getSize() == 8);
+  REQUIRE(longPath.beginsWith(shortPath));
+  REQUIRE(last(longPath) == Symbol("h"));
+  REQUIRE(butLast(longPath) == Path("a/b/c/d/e/f/g"));
+  REQUIRE(tail(longPath).getSize() == 7);
+  REQUIRE(Path(shortPath, Path("e/f/g/h")) == longPath);
+
+  // copies share the elements until one is changed.
+  Path copy = longPath;
+  REQUIRE(copy == longPath);
+  copy.setElement(7, Symbol("x"));
+  REQUIRE(copy == Path("a/b/c/d/e/f/g/x"));
+  REQUIRE(longPath == Path("a/b/c/d/e/f/g/h"));
+  copy = longPath;
+  copy.addElement(Symbol("i"));
+  REQUIRE(copy.getSize() == 9);
+  REQUIRE(longPath.getSize() == 8);
+
+  // growing past the inline elements.
+  Path grown = shortPath;
+  grown.addElement(Symbol("e"));
+  REQUIRE(grown == Path("a/b/c/d/e"));
+  REQUIRE(shortPath == Path("a/b/c/d"));
+
+  Path moved = std::move(grown);
+  REQUIRE(moved == Path("a/b/c/d/e"));
+  grown = moved;
+  REQUIRE(grown == moved);
+
+  // the maximum depth.
+  Path deep;
+  for (int i = 0; i < kPathMaxSymbols + 2; ++i) deep.addElement(Symbol("z"));
+  REQUIRE(deep.getSize() == kPathMaxSymbols);
+
+  // TextPaths work the same way.
+  TextPath longText("one/two/three/four/five/six");
+  TextPath textCopy = longText;
+  textCopy.setElement(0, TextFragment("uno"));
+  REQUIRE(longText.toText() == "one/two/three/four/five/six");
+  REQUIRE(textCopy.toText() == "uno/two/three/four/five/six");
+}
@@ -0,0 +1,224 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// a unit test made using the Catch framework in catch.hpp / tests.cpp.
+
+#include <chrono>
+#include <thread>
+
+#include "catch.hpp"
+#include "madronalib.h"
+#include "MLPitchOnsetAnalyzer.h"
+
+using namespace ml;
+
+namespace pitchOnsetAnalyzerTest
+{
+constexpr float kSr{48000.f};
+
+// write vectors of a signal made by f(t) to channel 1 of a signal, with silence in channel 0.
+template <typename F>
+void writeSignal(SignalProcessor::PublishedSignal& signal, int vectors, int& t, F f)
+{
+  for (int v = 0; v < vectors; ++v)
+  {
+    DSPVectorArray<2> x(0.f);
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      x.row(1)[n] = f(t++);
+    }
+    signal.writeQuick(x, kFloatsPerDSPVector, 0);
+  }
+}
+}  // namespace pitchOnsetAnalyzerTest
+
+using namespace pitchOnsetAnalyzerTest;
+
+TEST_CASE("madronalib/core/pitch_onset/pitch", "[pitch_onset]")
+{
+  PitchDetector detector(2048, kSr);
+  REQUIRE(detector.getFrameSize() == 2048);
+  std::vector<float> frame(2048);
+
+  // a sine, and a sawtooth with strong harmonics, at frequencies between the integer periods.
+  for (float freq : {82.41f, 220.f, 440.f, 1234.5f})
+  {
+    for (size_t i = 0; i < frame.size(); ++i)
+    {
+      frame[i] = 0.5f * sinf(kTwoPi * freq * float(i) / kSr);
+    }
+    PitchEstimate e = detector(frame.data());
+    REQUIRE(e.frequency == Approx(freq).epsilon(0.002f));
+    REQUIRE(e.clarity > 0.95f);
+
+    for (size_t i = 0; i < frame.size(); ++i)
+    {
+      const float phase = freq * float(i) / kSr;
+      frame[i] = 0.5f * (phase - floorf(phase)) - 0.25f;
+    }
+    e = detector(frame.data());
+    REQUIRE(e.frequency == Approx(freq).epsilon(0.005f));
+  }
+
+  // silence and noise have no pitch.
+  std::fill(frame.begin(), frame.end(), 0.f);
+  REQUIRE(detector(frame.data()).frequency == 0.f);
+  NoiseGen noise;
+  for (size_t i = 0; i < frame.size(); ++i)
+  {
+    if (!(i % kFloatsPerDSPVector))
+    {
+      const DSPVector v = noise();
+      std::copy(v.getConstBuffer(), v.getConstBuffer() + kFloatsPerDSPVector, &frame[i]);
+    }
+  }
+  const PitchEstimate e = detector(frame.data());
+  REQUIRE(e.clarity < 0.8f);
+}
+
+TEST_CASE("madronalib/core/pitch_onset/onsets", "[pitch_onset]")
+{
+  OnsetDetector detector(1024);
+  std::vector<float> frame(1024, 0.f);
+  NoiseGen noise;
+  DSPVector burst;
+
+  // silence, then a burst of noise entering the frames over a few hops of 256 samples.
+  std::vector<float> signal(1024 * 12, 0.f);
+  for (size_t i = 4096; i < signal.size(); ++i)
+  {
+    if (!(i % kFloatsPerDSPVector)) burst = noise();
+    signal[i] = 0.5f * burst[i % kFloatsPerDSPVector];
+  }
+
+  std::vector<size_t> onsets;
+  for (size_t start = 0; start + 1024 <= signal.size(); start += 256)
+  {
+    if (detector(&signal[start]) > 0.f) onsets.push_back(start - 256);
+  }
+
+  // one onset, at the first frame containing the whole step in level.
+  REQUIRE(onsets.size() == 1);
+  REQUIRE(onsets[0] + 1024 > 4096);
+  REQUIRE(onsets[0] <= 4096);
+}
+
+TEST_CASE("madronalib/core/pitch_onset/analyzer", "[pitch_onset]")
+{
+  SignalProcessor::PublishedSignal signal(32768, 1, 2, 0);
+  PitchOnsetAnalyzerConfig config;
+  config.frameSize = 2048;
+  config.hopSize = 512;
+  config.channel = 1;
+  PitchOnsetAnalyzer analyzer(signal, kSr, config);
+
+  // silence, then a 330 Hz tone.
+  int t{0};
+  writeSignal(signal, 4096 / kFloatsPerDSPVector, t, [](int) { return 0.f; });
+  writeSignal(signal, 8192 / kFloatsPerDSPVector, t,
+              [](int i) { return 0.5f * sinf(kTwoPi * 330.f * float(i) / kSr); });
+
+  // the analyses are limited to the budget, without losing frames.
+  REQUIRE(analyzer.analyze(5) == 5);
+  REQUIRE(analyzer.analyze() == 19);
+  REQUIRE(signal.getAvailableFrames() == 0);
+
+  int pitches{0}, onsets{0};
+  Message m;
+  while (analyzer.popMessage(m))
+  {
+    const auto v = m.value.getFloatArray<3>();
+    if (m.address == Path("pitch"))
+    {
+      pitches++;
+      REQUIRE(v[0] == Approx(330.f).epsilon(0.002f));
+      REQUIRE(v[1] > 0.9f);
+
+      // pitches are only found in frames that are full of the tone.
+      REQUIRE(v[2] * kSr >= 4096.f + 2048.f - 1.f);
+    }
+    else if (m.address == Path("onset"))
+    {
+      onsets++;
+      REQUIRE(v[1] * kSr > 4096.f - 2048.f);
+      REQUIRE(v[1] * kSr <= 4096.f + 2048.f);
+    }
+  }
+  REQUIRE(pitches >= 10);
+  REQUIRE(onsets == 1);
+  REQUIRE(analyzer.getDroppedMessages() == 0);
+
+  // with a limit on the backlog, old frames are skipped but still counted in the times.
+  config.maxBacklogFrames = 2048;
+  PitchOnsetAnalyzer skipping(signal, kSr, config);
+  writeSignal(signal, 8192 / kFloatsPerDSPVector, t,
+              [](int i) { return 0.5f * sinf(kTwoPi * 330.f * float(i) / kSr); });
+  REQUIRE(skipping.analyze() == 4);
+  REQUIRE(skipping.getSkippedFrames() == 8192 - 2048);
+  float lastTime{0.f};
+  while (skipping.popMessage(m))
+  {
+    if (m.address == Path("pitch")) lastTime = m.value.getFloatArray<3>()[2];
+  }
+  REQUIRE(lastTime * kSr == Approx(8192.f));
+}
+
+TEST_CASE("madronalib/core/pitch_onset/thread", "[pitch_onset]")
+{
+  // two analyzers share a budget of analyses per interval.
+  constexpr size_t kAnalyzers{2};
+  std::vector<std::unique_ptr<SignalProcessor::PublishedSignal>> signals;
+  std::vector<std::unique_ptr<PitchOnsetAnalyzer>> analyzers;
+  PitchOnsetAnalyzerConfig config;
+  config.frameSize = 1024;
+  config.hopSize = 256;
+  config.channel = 1;
+  AnalysisThread thread(3);
+  for (size_t i = 0; i < kAnalyzers; ++i)
+  {
+    signals.push_back(std::make_unique<SignalProcessor::PublishedSignal>(8192, 1, 2, 0));
+    analyzers.push_back(std::make_unique<PitchOnsetAnalyzer>(*signals[i], kSr, config));
+    thread.add(analyzers[i].get());
+  }
+
+  int t0{0}, t1{0};
+  writeSignal(*signals[0], 2048 / kFloatsPerDSPVector, t0,
+              [](int i) { return 0.5f * sinf(kTwoPi * 200.f * float(i) / kSr); });
+  writeSignal(*signals[1], 2048 / kFloatsPerDSPVector, t1,
+              [](int i) { return 0.5f * sinf(kTwoPi * 400.f * float(i) / kSr); });
+
+  // each run takes turns between the analyzers, and stops when the budget is spent.
+  REQUIRE(thread.runOnce() == 3);
+  REQUIRE(thread.runOnce() == 3);
+  REQUIRE(thread.runOnce() == 3);
+  REQUIRE(thread.runOnce() == 3);
+  REQUIRE(thread.runOnce() == 3);
+  REQUIRE(thread.runOnce() == 1);
+  REQUIRE(thread.runOnce() == 0);
+
+  // on the thread, results arrive as the signals are written.
+  thread.start(1);
+  writeSignal(*signals[0], 2048 / kFloatsPerDSPVector, t0,
+              [](int i) { return 0.5f * sinf(kTwoPi * 200.f * float(i) / kSr); });
+  writeSignal(*signals[1], 2048 / kFloatsPerDSPVector, t1,
+              [](int i) { return 0.5f * sinf(kTwoPi * 400.f * float(i) / kSr); });
+  const float expected[kAnalyzers]{200.f, 400.f};
+  for (size_t i = 0; i < kAnalyzers; ++i)
+  {
+    Message m;
+    std::array<float, 3> last{};
+    for (int tries = 0; tries < 2000; ++tries)
+    {
+      while (analyzers[i]->popMessage(m))
+      {
+        if (m.address == Path("pitch")) last = m.value.getFloatArray<3>();
+      }
+      if (last[2] * kSr >= 4096.f - 1.f) break;
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    REQUIRE(last[2] * kSr == Approx(4096.f));
+    REQUIRE(last[0] == Approx(expected[i]).epsilon(0.002f));
+  }
+  thread.stop();
+}
@@ -0,0 +1,182 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// a unit test made using the Catch framework in catch.hpp / tests.cpp.
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+#include "catch.hpp"
+#include "MLPresetBank.h"
+#include "MLSerialization.h"
+
+using namespace ml;
+
+namespace presetBankTest
+{
+constexpr size_t kPresets{64};
+const char* kCategories[]{"bass", "keys", "lead", "pad"};
+
+Tree<Value> makePreset(size_t i)
+{
+  Tree<Value> t;
+  t["osc/freq"] = float(i);
+  t["osc/level"] = 1.f / (i + 1);
+  t["filter/cutoff"] = 1000.f + i;
+  t["meta/category"] = kCategories[i % 4];
+  t["meta/author"] = (i < kPresets / 2) ? "rj" : "sk";
+  t["meta/rating"] = float(i % 5);
+  t[runtimePath(("unique/p" + std::to_string(i)).c_str())] = 1.f;
+  return t;
+}
+
+std::string getFileName(size_t i) { return "presetBankTest" + std::to_string(i) + ".preset"; }
+
+// write presets as JSON and binary in turn.
+void writeFile(const std::string& name, const Tree<Value>& t, bool json)
+{
+  std::ofstream out(name, std::ios::binary);
+  if (json)
+  {
+    out << "\n  " << valueTreeToJSONText(t).getText();
+  }
+  else
+  {
+    std::vector<uint8_t> bytes;
+    valueTreeToBinary(t, bytes);
+    out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+  }
+}
+
+TEST_CASE("madronalib/core/preset_bank", "[preset_bank][threads]")
+{
+  std::vector<std::string> paths;
+  for (size_t i = 0; i < kPresets; ++i)
+  {
+    paths.push_back(getFileName(i));
+    writeFile(paths.back(), makePreset(i), i & 1);
+  }
+
+  // a missing file and one that isn't a preset.
+  paths.push_back("presetBankTestMissing.preset");
+  paths.push_back("presetBankTestGarbage.preset");
+  {
+    std::ofstream out(paths.back(), std::ios::binary);
+    out << "not a preset";
+  }
+
+  WorkerPool pool(3);
+  PresetBank bank;
+  REQUIRE(bank.load(paths, pool) == kPresets);
+  REQUIRE(bank.size() == kPresets + 2);
+
+  bool problem = false;
+  for (size_t i = 0; i < kPresets; ++i)
+  {
+    if (!bank.isLoaded(i) || (bank.getPath(i) != paths[i])) problem = true;
+    if (bank.getPreset(i) != makePreset(i)) problem = true;
+  }
+  REQUIRE(!problem);
+  REQUIRE(!bank.isLoaded(kPresets));
+  REQUIRE(!bank.isLoaded(kPresets + 1));
+
+  // the index has the text metadata, in order.
+  std::vector<TextFragment> categories{"bass", "keys", "lead", "pad"};
+  REQUIRE(bank.getMetadataValues(Path("category")) == categories);
+  REQUIRE(bank.getMetadataValues(Path("rating")).empty());
+  auto pads = bank.findPresets(Path("category"), "pad");
+  REQUIRE(pads.size() == kPresets / 4);
+  for (size_t j = 0; j < pads.size(); ++j)
+  {
+    if (pads[j] != 4 * j + 3) problem = true;
+  }
+  REQUIRE(!problem);
+  REQUIRE(bank.findPresets(Path("author"), "sk").front() == kPresets / 2);
+  REQUIRE(bank.findPresets(Path("author"), "nobody").empty());
+
+  // loading again replaces the bank.
+  REQUIRE(bank.load({paths[0]}, pool) == 1);
+  REQUIRE(bank.findPresets(Path("category"), "pad").empty());
+
+  for (const auto& p : paths)
+  {
+    std::remove(p.c_str());
+  }
+}
+
+TEST_CASE("madronalib/core/preset_bank/bundle", "[preset_bank]")
+{
+  // names that sort differently from the order of the files.
+  std::vector<std::string> paths;
+  std::vector<std::string> names{"Zap", "Bass 1", "Mellow", "Acid", "Pad Wide", "Keys"};
+  for (size_t i = 0; i < names.size(); ++i)
+  {
+    paths.push_back("./" + names[i] + ".preset");
+    writeFile(paths.back(), makePreset(i), i & 1);
+  }
+  paths.push_back("./presetBankTestMissing.preset");
+  WorkerPool pool(2);
+  PresetBank bank;
+  REQUIRE(bank.load(paths, pool) == names.size());
+
+  const char* kBundlePath = "presetBankTest.bundle";
+  REQUIRE(PresetBundle::write(kBundlePath, bank));
+  PresetBundle bundle;
+  REQUIRE(bundle.open(kBundlePath));
+  REQUIRE(bundle.size() == names.size());
+
+  // the names are sorted, and each finds its preset.
+  bool problem = false;
+  for (size_t i = 1; i < bundle.size(); ++i)
+  {
+    if (!(bundle.getName(i - 1) < bundle.getName(i))) problem = true;
+  }
+  for (size_t i = 0; i < names.size(); ++i)
+  {
+    size_t j = bundle.find(names[i]);
+    if ((j == PresetBundle::kNotFound) || (bundle.getName(j) != names[i])) problem = true;
+    if ((j != PresetBundle::kNotFound) && (bundle.loadPreset(j) != makePreset(i))) problem = true;
+  }
+  REQUIRE(!problem);
+  REQUIRE(bundle.find("Missing") == PresetBundle::kNotFound);
+  REQUIRE(bundle.find("presetBankTestMissing") == PresetBundle::kNotFound);
+
+  // the tags are the text metadata.
+  REQUIRE(bundle.getNumTags() == 4 + 1);
+  size_t bass = bundle.findTag("category/bass");
+  REQUIRE(bass != PresetBundle::kNotFound);
+  REQUIRE(bundle.findTag("rating/1") == PresetBundle::kNotFound);
+  auto basses = bundle.findPresetsWithTag(bass);
+  REQUIRE(basses.size() == 2);
+  REQUIRE(bundle.getName(basses[0]) == "Pad Wide");
+  REQUIRE(bundle.getName(basses[1]) == "Zap");
+  std::vector<std::string_view> tags{"author/rj", "category/lead"};
+  REQUIRE(bundle.getTags(bundle.find("Mellow")) == tags);
+
+  // a preset can be read in place.
+  BinaryTreeView view = bundle.viewPreset(bundle.find("Acid"));
+  REQUIRE(view.isValid());
+  REQUIRE(view.getValueFromHash(HashPath("osc/freq")) == Value(3.f));
+
+  // a truncated bundle is not opened.
+  {
+    std::ifstream in(kBundlePath, std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::ofstream out(kBundlePath, std::ios::binary);
+    out.write(bytes.data(), bytes.size() - 8);
+  }
+  PresetBundle truncated;
+  REQUIRE(!truncated.open(kBundlePath));
+  REQUIRE(truncated.size() == 0);
+
+  bundle.close();
+  for (const auto& p : paths)
+  {
+    std::remove(p.c_str());
+  }
+  std::remove(kBundlePath);
+}
+
+}  // namespace presetBankTest
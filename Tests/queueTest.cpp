@@ -120,4 +120,205 @@ TEST_CASE("madronalib/core/queue/available", "[queue][available]")
   REQUIRE(testQueue.elementsAvailable() == testQueue.size() - 1);
 }
 
+TEST_CASE("madronalib/core/queue/batch", "[queue][batch]")
+{
+  Queue<int> q(15);
+  REQUIRE(q.size() == 16);
+
+  std::vector<int> src(20), dest(20);
+  for (int i = 0; i < 20; ++i) src[i] = i;
+
+  // only size() - 1 items fit.
+  REQUIRE(q.pushN(src.data(), 20) == 15);
+  REQUIRE(q.elementsAvailable() == 15);
+  REQUIRE(q.popN(dest.data(), 10) == 10);
+  REQUIRE(dest[9] == 9);
+
+  // push and pop across the end of the buffer.
+  REQUIRE(q.pushN(src.data(), 8) == 8);
+  REQUIRE(q.popN(dest.data(), 20) == 13);
+  REQUIRE(dest[4] == 14);
+  REQUIRE(dest[5] == 0);
+  REQUIRE(dest[12] == 7);
+  REQUIRE(q.wasEmpty());
+
+  // single and batch operations can be mixed.
+  q.push(100);
+  q.pushN(src.data(), 2);
+  REQUIRE(q.pop() == 100);
+  REQUIRE(q.popN(dest.data(), 2) == 2);
+  REQUIRE(dest[1] == 1);
+  REQUIRE(q.popN(dest.data(), 2) == 0);
+
+  // the padded indices don't over-align queues allocated with plain new.
+  REQUIRE(alignof(Queue<int>) <= alignof(std::max_align_t));
+  REQUIRE(alignof(MPMCQueue<int>) <= alignof(std::max_align_t));
+}
+
+TEST_CASE("madronalib/core/queue/mpmc", "[queue][threads]")
+{
+  constexpr int kProducers{4};
+  constexpr int kConsumers{3};
+  constexpr int kItemsPerProducer{20000};
+  MPMCQueue<int> q(64);
+  REQUIRE(q.size() == 64);
+  REQUIRE(q.wasEmpty());
+
+  std::atomic<long long> receivedSum{0};
+  std::atomic<int> receivedCount{0};
+  std::vector<std::thread> threads;
+  for (int p = 0; p < kProducers; ++p)
+  {
+    threads.emplace_back([&q, p]() {
+      for (int i = 1; i <= kItemsPerProducer; ++i)
+      {
+        while (!q.push(i * kProducers + p)) std::this_thread::yield();
+      }
+    });
+  }
+  for (int c = 0; c < kConsumers; ++c)
+  {
+    threads.emplace_back([&]() {
+      int item;
+      while (receivedCount.load() < kProducers * kItemsPerProducer)
+      {
+        if (q.pop(item))
+        {
+          receivedSum += item;
+          receivedCount++;
+        }
+        else
+        {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (auto& t : threads) t.join();
+
+  // every item pushed is popped exactly once.
+  long long expectedSum{0};
+  for (int p = 0; p < kProducers; ++p)
+  {
+    for (int i = 1; i <= kItemsPerProducer; ++i)
+    {
+      expectedSum += i * kProducers + p;
+    }
+  }
+  REQUIRE(receivedCount == kProducers * kItemsPerProducer);
+  REQUIRE(receivedSum == expectedSum);
+  REQUIRE(q.wasEmpty());
+
+  // unlike Queue, all of the cells can be filled.
+  for (int i = 0; i < 64; ++i) REQUIRE(q.push(i));
+  REQUIRE(!q.push(64));
+  REQUIRE(q.wasFull());
+  REQUIRE(q.pop() == 0);
+  REQUIRE(q.elementsAvailable() == 63);
+}
+
+TEST_CASE("madronalib/core/queue/triple-buffer", "[queue][threads]")
+{
+  // each published value is an array filled with one number, so torn reads would show.
+  TripleBuffer<std::array<int, 64> > t;
+  REQUIRE(!t.update());
+  REQUIRE(alignof(TripleBuffer<float>) <= alignof(std::max_align_t));
+
+  t.getWriteBuffer().fill(1);
+  t.publish();
+  t.getWriteBuffer().fill(2);
+  t.publish();
+  REQUIRE(t.update());
+  REQUIRE(t.getReadBuffer()[0] == 2);
+  REQUIRE(!t.update());
+
+  constexpr int kValues{100000};
+  std::atomic<bool> done{false};
+  std::thread writer([&]() {
+    for (int i = 3; i <= kValues; ++i)
+    {
+      t.getWriteBuffer().fill(i);
+      t.publish();
+    }
+    done = true;
+  });
+
+  // values can be skipped, but must never go backwards or be mixed.
+  int last{2};
+  bool ok{true};
+  while (!done || t.update())
+  {
+    if (t.update())
+    {
+      const auto& b = t.getReadBuffer();
+      ok &= (b[0] >= last) && std::all_of(b.begin(), b.end(), [&](int x) { return x == b[0]; });
+      last = b[0];
+    }
+  }
+  writer.join();
+  t.update();
+  REQUIRE(ok);
+  REQUIRE(t.getReadBuffer()[0] == kValues);
+}
+
+TEST_CASE("madronalib/core/queue/coalescing", "[queue][threads]")
+{
+  CoalescingQueue q;
+  const size_t level = q.addSlot("meters/level");
+  const size_t peaks = q.addSlot("meters/peaks", 2);
+  for (int i = 0; i < 100; ++i)
+  {
+    q.addSlot(Path("voices", textUtils::naturalNumberToText(i)));
+  }
+  REQUIRE(q.getSlotID("meters/peaks") == peaks);
+  REQUIRE(q.getSlotID("nothing") == CoalescingQueue::kNoSlot);
+
+  // many writes to a slot are drained once, with the newest value, in order of ID.
+  for (int i = 0; i < 10; ++i) q.set(level, float(i));
+  const float p[2]{0.5f, 0.25f};
+  q.set(peaks, p);
+  q.set(q.getSlotID("voices/99"), 99.f);
+  REQUIRE(q.hasChanges());
+  MessageList messages;
+  REQUIRE(q.drain(messages) == 3);
+  REQUIRE(messages[0].address == Path("meters/level"));
+  REQUIRE(messages[0].value == Value(9.f));
+  REQUIRE(messages[1].value.getFloatArraySize() == 2);
+  REQUIRE(messages[1].value.getFloatArrayPtr()[1] == 0.25f);
+  REQUIRE(messages[2].address == Path("voices/99"));
+  REQUIRE(q.getCoalescedCount() == 9);
+  REQUIRE(!q.hasChanges());
+  REQUIRE(q.drain(messages) == 0);
+
+  // a reader on another thread always ends with the newest values, and never sees one go back.
+  constexpr int kWrites{100000};
+  std::atomic<bool> done{false};
+  std::thread writer([&]() {
+    for (int i = 1; i <= kWrites; ++i)
+    {
+      q.set(level, float(i));
+      q.set(size_t(2 + i % 100), float(i));
+    }
+    done = true;
+  });
+  float last{0.f};
+  bool ok{true};
+  auto check = [&](size_t id, const float* x, size_t) {
+    if (id == level)
+    {
+      ok &= (x[0] >= last);
+      last = x[0];
+    }
+  };
+  while (!done)
+  {
+    q.drain(check);
+  }
+  writer.join();
+  q.drain(check);
+  REQUIRE(ok);
+  REQUIRE(last == float(kWrites));
+  REQUIRE(q.get(q.getSlotID("voices/0")) == float(kWrites));
+}
+
 }  // namespace queueTest
@@ -0,0 +1,112 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// a unit test made using the Catch framework in catch.hpp / tests.cpp.
+
+#include <thread>
+
+#include "catch.hpp"
+#include "MLRCU.h"
+
+using namespace ml;
+
+namespace rcuTest
+{
+// counts the live instances.
+std::atomic<int> gLive{0};
+
+struct Table
+{
+  explicit Table(int v) : version(v) { gLive++; }
+  ~Table()
+  {
+    version = -1;
+    gLive--;
+  }
+  int version;
+};
+}  // namespace rcuTest
+
+using namespace rcuTest;
+
+TEST_CASE("madronalib/core/rcu", "[rcu]")
+{
+  {
+    EpochDomain domain;
+    size_t reader = domain.addReader();
+    REQUIRE(reader != EpochDomain::kNoReader);
+    RCUPointer<Table> table(domain, std::make_unique<Table>(0));
+
+    // a version read in a block stays alive until the block ends.
+    {
+      EpochDomain::ReadScope scope(domain, reader);
+      const Table* t = table.acquire();
+      table.publish(std::make_unique<Table>(1));
+      REQUIRE(table.acquire()->version == 1);
+      REQUIRE(domain.reclaim() == 0);
+      REQUIRE(t->version == 0);
+    }
+    REQUIRE(domain.reclaim() == 1);
+    REQUIRE(gLive == 1);
+
+    // readers that start after a publish don't hold up the old version.
+    table.publish(std::make_unique<Table>(2));
+    {
+      EpochDomain::ReadScope scope(domain, reader);
+      REQUIRE(domain.reclaim() == 1);
+      table.publish(std::make_unique<Table>(3));
+      REQUIRE(domain.getRetiredCount() == 1);
+    }
+    REQUIRE(domain.reclaim() == 1);
+
+    // removed readers don't hold anything up, and the domain frees what is left.
+    size_t other = domain.addReader();
+    domain.enter(other);
+    table.publish(std::make_unique<Table>(4));
+    REQUIRE(domain.reclaim() == 0);
+    domain.removeReader(other);
+    REQUIRE(domain.reclaim() == 1);
+    table.publish(std::make_unique<Table>(5));
+  }
+  REQUIRE(gLive == 0);
+
+  // a reader thread sees only live, ever newer versions while a writer publishes.
+  {
+    EpochDomain domain;
+    domain.start(1);
+    RCUPointer<Table> table(domain, std::make_unique<Table>(0));
+    std::atomic<bool> done{false};
+    bool problem{false};
+    std::thread audio(
+        [&]()
+        {
+          size_t reader = domain.addReader();
+          int last{0};
+          while (!done)
+          {
+            EpochDomain::ReadScope scope(domain, reader);
+            const Table* t = table.acquire();
+            for (int i = 0; i < 100; ++i)
+            {
+              if (t->version < last) problem = true;
+            }
+            last = t->version;
+          }
+          domain.removeReader(reader);
+        });
+
+    for (int v = 1; v <= 2000; ++v)
+    {
+      table.publish(std::make_unique<Table>(v));
+    }
+    done = true;
+    audio.join();
+    domain.stop();
+    domain.reclaim();
+    REQUIRE(!problem);
+    REQUIRE(domain.getRetiredCount() == 0);
+    REQUIRE(gLive == 1);
+  }
+  REQUIRE(gLive == 0);
+}
@@ -0,0 +1,155 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// a unit test made using the Catch framework in catch.hpp / tests.cpp.
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <future>
+
+#include "catch.hpp"
+#include "MLOfflineAudioTask.h"
+#include "MLResourceLoader.h"
+
+using namespace ml;
+
+namespace resourceLoaderTest
+{
+constexpr size_t kFrames{8820};
+constexpr float kFrequency{441.f};
+const char* kPath = "resourceLoaderTest.wav";
+
+float sine(size_t i, double sampleRate)
+{
+  return 0.5f * std::sin(kTwoPi * kFrequency * float(i / sampleRate));
+}
+
+void processCopy(AudioContext* ctx, void*)
+{
+  for (size_t c = 0; c < ctx->outputs.size(); ++c)
+  {
+    ctx->outputs[c] = ctx->inputs[c];
+  }
+}
+
+// write a stereo float file at 44100Hz, with a sine on the left and its inverse on the right.
+bool writeTestFile()
+{
+  std::vector<float> left(kFrames), right(kFrames);
+  for (size_t i = 0; i < kFrames; ++i)
+  {
+    left[i] = sine(i, 44100.);
+    right[i] = -left[i];
+  }
+  const float* inputs[2]{left.data(), right.data()};
+  AudioContext ctx(2, 2, 44100);
+  OfflineAudioTask task(&ctx, processCopy, nullptr);
+  task.setInput(inputs, 2, kFrames);
+  return task.renderToWavFile(kPath, kFrames);
+}
+
+TEST_CASE("madronalib/core/resource_loader/priority", "[resource_loader][threads]")
+{
+  ResourceLoader loader(1);
+
+  // hold the one worker until all the requests are made.
+  std::promise<void> started, release;
+  std::shared_future<void> released = release.get_future().share();
+  loader.request(
+      [&started, released]()
+      {
+        started.set_value();
+        released.wait();
+      });
+  started.get_future().wait();
+
+  std::vector<int> order;
+  auto job = [&order](int n) { return [&order, n]() { order.push_back(n); }; };
+  loader.request(job(1), ResourceLoader::kLowPriority);
+  loader.request(job(2), ResourceLoader::kNormalPriority);
+  uint64_t cancelled = loader.request(job(3), ResourceLoader::kLowPriority);
+  loader.request(job(4), ResourceLoader::kHighPriority);
+  loader.request(job(5), ResourceLoader::kNormalPriority);
+  REQUIRE(loader.cancel(cancelled));
+  REQUIRE(loader.getNumWaiting() == 4);
+
+  release.set_value();
+  loader.waitUntilIdle();
+  REQUIRE(order == std::vector<int>{4, 2, 5, 1});
+
+  // jobs that have run can't be cancelled.
+  REQUIRE(!loader.cancel(cancelled));
+  REQUIRE(loader.getNumWaiting() == 0);
+}
+
+TEST_CASE("madronalib/core/resource_loader/samples", "[resource_loader][threads]")
+{
+  REQUIRE(writeTestFile());
+
+  // reading at the file's rate gives the file's frames.
+  Sample original;
+  REQUIRE(ResourceLoader::readWavFile(kPath, original));
+  REQUIRE(original.channels == 2);
+  REQUIRE(original.sampleRate == 44100);
+  REQUIRE(getFrames(original) == kFrames);
+  REQUIRE(original[2 * 100] == sine(100, 44100.));
+
+  SamplePool pool;
+  ResourceLoader loader(2);
+  std::atomic<int> loaded{0};
+  std::atomic<int> failed{0};
+  auto done = [&](SamplePool::SamplePtr s) { s ? loaded++ : failed++; };
+  loader.requestSample(pool, kPath, 48000., done);
+  loader.requestSample(pool, kPath, 48000., done);
+  loader.requestSample(pool, "nonexistent.wav", 48000., done);
+  loader.waitUntilIdle();
+  REQUIRE(loaded == 2);
+  REQUIRE(failed == 1);
+
+  // both requests for 48kHz share one sample, which is the same sine at the new rate.
+  auto s = pool.find(ResourceLoader::getSampleKey(kPath, 48000.));
+  REQUIRE(s);
+  REQUIRE(pool.getNumSamples() == 1);
+  REQUIRE(s->sampleRate == 48000);
+  REQUIRE(getFrames(*s) == size_t(kFrames * 48000 / 44100));
+
+  // away from the ends, where the resampler sees the silence outside the file.
+  float maxError{0.f};
+  for (size_t i = 200; i < getFrames(*s) - 200; ++i)
+  {
+    maxError = std::max(maxError, std::abs((*s)[2 * i] - sine(i, 48000.)));
+    maxError = std::max(maxError, std::abs((*s)[2 * i + 1] + sine(i, 48000.)));
+  }
+  REQUIRE(maxError < 1e-3f);
+
+  remove(kPath);
+}
+
+TEST_CASE("madronalib/core/resource_loader/publish", "[resource_loader][threads]")
+{
+  EpochDomain domain;
+  RCUPointer<std::vector<float> > table(domain, std::make_unique<std::vector<float> >(1, 0.f));
+  size_t reader = domain.addReader();
+
+  ResourceLoader loader;
+  std::atomic<int> published{0};
+  loader.requestPublish<std::vector<float> >(
+      []() { return std::make_unique<std::vector<float> >(256, 1.f); }, table,
+      [&](bool ok) { published += ok; });
+
+  // a load that fails leaves the current version in place.
+  loader.requestPublish<std::vector<float> >([]() { return nullptr; }, table,
+                                             [&](bool ok) { published += ok; });
+  loader.waitUntilIdle();
+  REQUIRE(published == 1);
+  {
+    EpochDomain::ReadScope scope(domain, reader);
+    REQUIRE(table.acquire()->size() == 256);
+  }
+  REQUIRE(domain.reclaim() == 1);
+  domain.removeReader(reader);
+}
+
+}  // namespace resourceLoaderTest
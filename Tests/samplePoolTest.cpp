@@ -0,0 +1,99 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// a unit test made using the Catch framework in catch.hpp / tests.cpp.
+
+#include "catch.hpp"
+#include "MLSamplePool.h"
+#include "MLSharedResource.h"
+
+using namespace ml;
+
+namespace samplePoolTest
+{
+constexpr size_t kFrames{1000};
+constexpr size_t kBytes{kFrames * sizeof(float)};
+
+Sample makeSample(float value)
+{
+  Sample s;
+  s.sampleRate = 48000;
+  resize(s, kFrames, 1);
+  std::fill(s.sampleData.begin(), s.sampleData.end(), value);
+  return s;
+}
+}  // namespace samplePoolTest
+
+using namespace samplePoolTest;
+
+TEST_CASE("madronalib/core/sample_pool/share", "[sample_pool]")
+{
+  // two users of the shared pool see the same samples.
+  SharedResourcePointer<SamplePool> pool1;
+  SharedResourcePointer<SamplePool> pool2;
+  REQUIRE(&pool1.get() == &pool2.get());
+
+  int loads{0};
+  auto loader = [&](Sample& s)
+  {
+    loads++;
+    s = makeSample(0.5f);
+    return true;
+  };
+  auto a = pool1->load("piano/c4.wav", loader);
+  auto b = pool2->load("piano/c4.wav", loader);
+  REQUIRE(loads == 1);
+  REQUIRE(a == b);
+  REQUIRE((*a)[kFrames - 1] == 0.5f);
+
+  // identical contents under another key are stored once.
+  auto c = pool2->add("copy of c4.wav", makeSample(0.5f));
+  REQUIRE(c == a);
+  REQUIRE(pool1->getNumSamples() == 1);
+  REQUIRE(pool1->getMemoryUsed() == kBytes);
+
+  // failed loads store nothing.
+  REQUIRE(!pool1->load("missing.wav", [](Sample&) { return false; }));
+  REQUIRE(!pool1->find("missing.wav"));
+
+  a.reset();
+  b.reset();
+  c.reset();
+  pool1->clear();
+  REQUIRE(pool1->getNumSamples() == 0);
+  REQUIRE(pool1->getMemoryUsed() == 0);
+}
+
+TEST_CASE("madronalib/core/sample_pool/evict", "[sample_pool]")
+{
+  SamplePool pool;
+  pool.setMemoryBudget(2 * kBytes);
+
+  auto held = pool.add("held", makeSample(1.f));
+  pool.add("a", makeSample(2.f));
+  pool.add("b", makeSample(3.f));
+
+  // over budget, the least recently used sample not in use is evicted.
+  REQUIRE(pool.getNumSamples() == 2);
+  REQUIRE(pool.find("held") == held);
+  REQUIRE(!pool.find("a"));
+  REQUIRE(pool.find("b"));
+
+  // finding a sample makes it the most recently used.
+  held.reset();
+  pool.find("held");
+  pool.add("c", makeSample(4.f));
+  REQUIRE(pool.find("held"));
+  REQUIRE(!pool.find("b"));
+  REQUIRE(pool.getMemoryUsed() == 2 * kBytes);
+
+  // replacing the sample under a key keeps the old one valid for its holders.
+  auto old = pool.find("c");
+  pool.add("c", makeSample(5.f));
+  REQUIRE((*old)[0] == 4.f);
+  REQUIRE((*pool.find("c"))[0] == 5.f);
+  old.reset();
+  pool.trim();
+  REQUIRE(pool.getMemoryUsed() <= 2 * kBytes);
+}
@@ -0,0 +1,153 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// a unit test made using the Catch framework in catch.hpp / tests.cpp.
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#include "catch.hpp"
+#include "MLOfflineAudioTask.h"
+#include "MLSampleStream.h"
+
+using namespace ml;
+
+namespace sampleStreamTest
+{
+constexpr size_t kFrames{10000};
+constexpr size_t kHeadFrames{1500};
+const char* kPath = "sampleStreamTest.wav";
+
+float leftValue(size_t i) { return i / 16384.f; }
+float rightValue(size_t i) { return -leftValue(i); }
+
+void processCopy(AudioContext* ctx, void*)
+{
+  for (size_t c = 0; c < ctx->outputs.size(); ++c)
+  {
+    ctx->outputs[c] = ctx->inputs[c];
+  }
+}
+
+// write a stereo float file with a ramp on each channel.
+bool writeTestFile()
+{
+  std::vector<float> left(kFrames), right(kFrames);
+  for (size_t i = 0; i < kFrames; ++i)
+  {
+    left[i] = leftValue(i);
+    right[i] = rightValue(i);
+  }
+  const float* inputs[2]{left.data(), right.data()};
+  AudioContext ctx(2, 2, 48000);
+  OfflineAudioTask task(&ctx, processCopy, nullptr);
+  task.setInput(inputs, 2, kFrames);
+  return task.renderToWavFile(kPath, kFrames);
+}
+
+// read frames of a voice and check them against the file from frame start. Returns the number
+// of frames read.
+size_t readAndCheck(SampleStreamer& s, size_t voice, size_t start, size_t frames, bool& ok)
+{
+  std::vector<float> left(frames), right(frames);
+  float* outputs[2]{left.data(), right.data()};
+  size_t n = s.readVoice(voice, outputs, frames);
+  for (size_t i = 0; i < frames; ++i)
+  {
+    bool inSample = i < n;
+    ok &= (left[i] == (inSample ? leftValue(start + i) : 0.f));
+    ok &= (right[i] == (inSample ? rightValue(start + i) : 0.f));
+  }
+  return n;
+}
+}  // namespace sampleStreamTest
+
+using namespace sampleStreamTest;
+
+TEST_CASE("madronalib/core/sample_stream/read", "[sample_stream]")
+{
+  REQUIRE(writeTestFile());
+
+  StreamingSample sample;
+  REQUIRE(sample.open(kPath, kHeadFrames));
+  REQUIRE(sample.getChannels() == 2);
+  REQUIRE(sample.getFrames() == kFrames);
+  REQUIRE(sample.getHeadFrames() == kHeadFrames);
+  REQUIRE(sample.getHead()[2 * 100 + 1] == rightValue(100));
+
+  SampleStreamer streamer(2, 2, 4 * SampleStreamer::kChunkFrames);
+
+  // play one voice from the start and one from after the head, prefetching between reads.
+  streamer.startVoice(0, &sample);
+  streamer.startVoice(1, &sample, 3000);
+  bool ok{true};
+  size_t read0{0}, read1{0};
+  for (int i = 0; i < 200; ++i)
+  {
+    streamer.prefetch();
+    read0 += readAndCheck(streamer, 0, read0, 64, ok);
+    read1 += readAndCheck(streamer, 1, 3000 + read1, 64, ok);
+  }
+  REQUIRE(ok);
+  REQUIRE(read0 == kFrames);
+  REQUIRE(read1 == kFrames - 3000);
+  REQUIRE(!streamer.isVoicePlaying(0));
+  REQUIRE(streamer.getUnderrunCount() == 0);
+
+  // without prefetching, playback stops at the end of the head until the data arrive.
+  streamer.startVoice(0, &sample);
+  REQUIRE(readAndCheck(streamer, 0, 0, 2000, ok) == kHeadFrames);
+  REQUIRE(streamer.getUnderrunCount() == 1);
+  streamer.prefetch();
+  REQUIRE(readAndCheck(streamer, 0, kHeadFrames, 500, ok) == 500);
+  REQUIRE(ok);
+
+  // restarting drops what was prefetched for the previous start.
+  streamer.prefetch();
+  streamer.startVoice(0, &sample, 5000);
+  streamer.prefetch();
+  REQUIRE(readAndCheck(streamer, 0, 5000, 3000, ok) == 3000);
+  REQUIRE(ok);
+
+  streamer.stopVoice(0);
+  REQUIRE(!streamer.isVoicePlaying(0));
+  REQUIRE(readAndCheck(streamer, 0, 0, 64, ok) == 0);
+  REQUIRE(ok);
+
+  std::remove(kPath);
+}
+
+TEST_CASE("madronalib/core/sample_stream/thread", "[sample_stream]")
+{
+  REQUIRE(writeTestFile());
+
+  StreamingSample sample;
+  REQUIRE(sample.open(kPath, kHeadFrames));
+
+  SampleStreamer streamer(4, 2);
+  streamer.start(1);
+  for (size_t v = 0; v < 4; ++v)
+  {
+    streamer.startVoice(v, &sample, v * 1000);
+  }
+
+  // read while the prefetch thread runs. Reads that run out of frames are checked for
+  // silence and retried.
+  bool ok{true};
+  std::vector<size_t> read(4, 0);
+  for (int i = 0; (i < 10000) && streamer.isVoicePlaying(3); ++i)
+  {
+    for (size_t v = 0; v < 4; ++v)
+    {
+      read[v] += readAndCheck(streamer, v, v * 1000 + read[v], 64, ok);
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+  streamer.stop();
+
+  REQUIRE(ok);
+  REQUIRE(read[3] == kFrames - 3000);
+  std::remove(kPath);
+}
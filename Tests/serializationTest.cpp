@@ -4,6 +4,8 @@
 
 // a unit test made using the Catch framework in catch.hpp / tests.cpp.
 
+#include <sstream>
+
 #include "catch.hpp"
 #include "madronalib.h"
 
@@ -78,6 +80,20 @@ TEST_CASE("madronalib/core/serialization", "[serialization]")
   auto b2 = valueTreeToBinary(vv);
   REQUIRE(b == b2);
 
+  // reusing a buffer, and writing to caller memory
+  std::vector<uint8_t> buffer;
+  valueTreeToBinary(vv, buffer);
+  REQUIRE(buffer == b);
+  auto capacity = buffer.capacity();
+  valueTreeToBinary(v, buffer);
+  REQUIRE(buffer == b);
+  REQUIRE(buffer.capacity() == capacity);
+  REQUIRE(getBinarySize(v) == b.size());
+  std::vector<uint8_t> dest(b.size() + 10);
+  REQUIRE(writeValueTreeToBinary(v, dest.data(), dest.size()) == b.size());
+  REQUIRE(std::equal(b.begin(), b.end(), dest.begin()));
+  REQUIRE(writeValueTreeToBinary(v, dest.data(), b.size() - 1) == 0);
+
   // create some JSON directly using our minimal API
   auto j5 = JSONHolder();
   j5.addNumber("foo", 23.0);
@@ -90,6 +106,344 @@ TEST_CASE("madronalib/core/serialization", "[serialization]")
   REQUIRE(JSONToValueTree(j6).size() == 0);
 }
 
+TEST_CASE("madronalib/core/serialization/binary_view", "[serialization]")
+{
+  Tree<Value> v;
+  v["osc/freq"] = 440.f;
+  v["osc/wave"] = "saw";
+  v["env/a"] = 0.01f;
+  v["env/r"] = 0.5f;
+  std::vector<uint8_t> someData{1, 3, 5, 7, 9};
+  v["blob"] = Value(someData.data(), someData.size());
+  auto b = valueTreeToBinary(v);
+
+  // read values without making a tree or registering any symbols.
+  theSymbolTable().clear();
+  BinaryTreeView view(b);
+  REQUIRE(view.isValid());
+  REQUIRE(view.size() == v.size());
+  REQUIRE(view.getValueFromHash(HashPath("osc/freq")) == Value(440.f));
+  REQUIRE(view.getValueFromHash(HashPath("osc/nothing")) == Value());
+  REQUIRE(view.find(HashPath("env/r"))->getPathText() == "env/r");
+  REQUIRE(theSymbolTable().getSize() == 0);
+
+  // every entry matches the tree.
+  size_t count = 0;
+  bool problem = false;
+  for (const auto& entry : view)
+  {
+    if (v[entry.getPath()] != entry.getValue()) problem = true;
+    count++;
+  }
+  REQUIRE(!problem);
+  REQUIRE(count == v.size());
+  REQUIRE(view["blob"] == v["blob"]);
+  REQUIRE(view["osc/wave"].getTextValue() == TextFragment("saw"));
+
+  // truncated or garbage data gives an empty view.
+  BinaryTreeView truncated(b.data(), b.size() - 1);
+  REQUIRE(!truncated.isValid());
+  REQUIRE(truncated.begin() == truncated.end());
+  std::vector<uint8_t> garbage(64, 0x55);
+  REQUIRE(!BinaryTreeView(garbage).isValid());
+  REQUIRE(BinaryTreeView(nullptr, 0)["osc/freq"] == Value());
+}
+
+TEST_CASE("madronalib/core/serialization/large_binary", "[serialization]")
+{
+  Tree<Value> v;
+  v["osc/freq"] = 440.f;
+  v["osc/name"] = "a name long enough not to fit in the local storage of a TextFragment";
+  v["table"] = Value(std::vector<float>(3000, 0.25f));
+  std::vector<uint8_t> bigData(1 << 20);
+  for (size_t i = 0; i < bigData.size(); ++i)
+  {
+    bigData[i] = static_cast<uint8_t>(i * 7);
+  }
+  v["samples/big"] = Value(bigData.data(), bigData.size());
+
+  // to a buffer and back
+  auto b = valueTreeToLargeBinary(v);
+  REQUIRE(b.size() == getLargeBinarySize(v));
+  REQUIRE(b.size() % kLargeBinaryAlignment == 0);
+  REQUIRE(largeBinaryToValueTree(b.data(), b.size()) == v);
+  REQUIRE(binaryToValueTree(b) == v);
+
+  // through a stream and back
+  std::stringstream stream;
+  REQUIRE(writeValueTreeToLargeBinary(v, stream));
+  REQUIRE(stream.str().size() == b.size());
+  REQUIRE(readLargeBinaryToValueTree(stream) == v);
+
+  // truncated data gives an empty tree.
+  REQUIRE(largeBinaryToValueTree(b.data(), b.size() - 1).size() == 0);
+  std::stringstream truncated(std::string(b.begin(), b.begin() + b.size() / 2));
+  REQUIRE(readLargeBinaryToValueTree(truncated).size() == 0);
+
+  // sizes larger than the input are rejected before anything is allocated.
+  auto setWord = [](std::vector<uint8_t>& data, size_t offset, uint64_t word) {
+    memcpy(data.data() + offset, &word, sizeof(word));
+  };
+  uint64_t firstPathBytes;
+  memcpy(&firstPathBytes, b.data() + 40, sizeof(firstPathBytes));
+  size_t firstValueHeader = 48 + ((firstPathBytes + 15) & ~uint64_t(15));
+  auto hugeValue = b;
+  setWord(hugeValue, firstValueHeader + 8, 0xF0000000);
+  REQUIRE(largeBinaryToValueTree(hugeValue.data(), hugeValue.size()).size() == 0);
+  std::stringstream hugeValueStream(std::string(hugeValue.begin(), hugeValue.end()));
+  REQUIRE(readLargeBinaryToValueTree(hugeValueStream).size() == 0);
+  auto manyElements = b;
+  setWord(manyElements, 16, uint64_t(1) << 40);
+  REQUIRE(largeBinaryToValueTree(manyElements.data(), manyElements.size()).size() == 0);
+
+  // the small format still works, and is not mistaken for the large one.
+  REQUIRE(binaryToValueTree(valueTreeToBinary(v)) == v);
+}
+
+TEST_CASE("madronalib/core/serialization/delta", "[serialization]")
+{
+  Tree<Value> before;
+  before["osc/freq"] = 440.f;
+  before["osc/wave"] = "saw";
+  before["filter/cutoff"] = 1000.f;
+  before["table"] = Value(std::vector<float>(1000, 0.5f));
+
+  // one edited parameter makes a delta much smaller than the tree.
+  Tree<Value> after = before;
+  after["osc/freq"] = 220.f;
+  auto changes = diffValueTrees(before, after);
+  REQUIRE(changes.size() == 1);
+  REQUIRE(changes[0].name == Path("osc/freq"));
+  REQUIRE(changes[0].oldValue == Value(440.f));
+  REQUIRE(changes[0].newValue == Value(220.f));
+  auto delta = getBinaryDelta(before, after);
+  REQUIRE(delta.size() * 20 < valueTreeToBinary(after).size());
+  REQUIRE(diffValueTrees(after, after).empty());
+
+  // added and removed values
+  after["filter/cutoff"] = Value();
+  after["filter/q"] = 0.7f;
+  after["table"] = Value(std::vector<float>(1000, 0.25f));
+  delta = getBinaryDelta(before, after);
+
+  Tree<Value> t = before;
+  REQUIRE(applyBinaryDelta(t, delta.data(), delta.size()));
+  REQUIRE(t == after);
+  REQUIRE(revertBinaryDelta(t, delta.data(), delta.size()));
+  REQUIRE(t == before);
+
+  // the same with ValueChanges
+  changes = diffValueTrees(before, after);
+  applyValueChanges(t, changes);
+  REQUIRE(t == after);
+  revertValueChanges(t, changes);
+  REQUIRE(t == before);
+
+  // gesture flags survive the binary form.
+  std::vector<ValueChange> gesture{ValueChange(Path("osc/freq"), 1.f, 0.f, true, false)};
+  auto gestureBinary = valueChangesToBinary(gesture);
+  std::vector<ValueChange> decoded;
+  REQUIRE(binaryToValueChanges(gestureBinary.data(), gestureBinary.size(), decoded));
+  REQUIRE(decoded.size() == 1);
+  REQUIRE(decoded[0].startGesture);
+  REQUIRE(!decoded[0].endGesture);
+  REQUIRE(decoded[0].oldValue == Value(0.f));
+
+  // without old values, a delta can be applied but not reverted.
+  auto newOnly = getBinaryDelta(before, after, false);
+  REQUIRE(newOnly.size() < delta.size());
+  t = before;
+  REQUIRE(applyBinaryDelta(t, newOnly.data(), newOnly.size()));
+  REQUIRE(t == after);
+  REQUIRE(!revertBinaryDelta(t, newOnly.data(), newOnly.size()));
+  REQUIRE(t == after);
+
+  // bad data changes nothing.
+  REQUIRE(!applyBinaryDelta(t, delta.data(), delta.size() - 1));
+  std::vector<uint8_t> garbage(64, 0x55);
+  REQUIRE(!applyBinaryDelta(t, garbage.data(), garbage.size()));
+  REQUIRE(!binaryToValueChanges(nullptr, 0, decoded));
+  REQUIRE(decoded.empty());
+  REQUIRE(t == after);
+}
+
+TEST_CASE("madronalib/core/serialization/compression", "[serialization]")
+{
+  // blocks of various sizes and kinds
+  std::vector<std::vector<uint8_t>> inputs;
+  inputs.push_back({});
+  inputs.push_back({1, 2, 3});
+  inputs.push_back(std::vector<uint8_t>(100000, 7));
+  std::vector<uint8_t> noise(5000), text;
+  uint32_t seed = 1;
+  for (auto& b : noise)
+  {
+    seed = seed * 1664525 + 1013904223;
+    b = static_cast<uint8_t>(seed >> 24);
+  }
+  inputs.push_back(noise);
+  for (int i = 0; i < 1000; ++i)
+  {
+    const char* word = (i % 3) ? "osc/freq " : "filter/cutoff ";
+    text.insert(text.end(), word, word + strlen(word));
+  }
+  inputs.push_back(text);
+
+  for (const auto& in : inputs)
+  {
+    std::vector<uint8_t> block(getMaxCompressedBlockSize(in.size()));
+    size_t n = compressBlock(in.data(), in.size(), block.data(), block.size());
+    REQUIRE(n > 0);
+    std::vector<uint8_t> out(in.size());
+    REQUIRE(decompressBlock(block.data(), n, out.data(), out.size()));
+    REQUIRE(out == in);
+    if (in.size() > 0)
+    {
+      REQUIRE(!decompressBlock(block.data(), n, out.data(), out.size() - 1));
+    }
+  }
+  REQUIRE(compressBlock(text.data(), text.size(), nullptr, 0) == 0);
+
+  // a smooth float array, in several chunks
+  std::vector<float> wave(100000);
+  for (size_t i = 0; i < wave.size(); ++i)
+  {
+    wave[i] = std::floor(std::sin(i * 0.001f) * 1000.f) / 1024.f;
+  }
+  auto waveBytes = reinterpret_cast<const uint8_t*>(wave.data());
+  size_t waveSize = wave.size() * sizeof(float);
+  auto c = compressData(waveBytes, waveSize);
+  REQUIRE(c.size() * 2 < waveSize);
+  REQUIRE(isCompressedData(c.data(), c.size()));
+  REQUIRE(getDecompressedSize(c.data(), c.size()) == waveSize);
+  std::vector<uint8_t> out;
+  REQUIRE(decompressData(c.data(), c.size(), out));
+  REQUIRE(out.size() == waveSize);
+  REQUIRE(memcmp(out.data(), waveBytes, waveSize) == 0);
+
+  // decode a range across a chunk boundary
+  std::vector<uint8_t> part(1000);
+  size_t offset = kDefaultCompressionChunkBytes - 500;
+  REQUIRE(decompressRange(c.data(), c.size(), offset, part.size(), part.data()));
+  REQUIRE(memcmp(part.data(), waveBytes + offset, part.size()) == 0);
+  REQUIRE(!decompressRange(c.data(), c.size(), waveSize - 10, 20, part.data()));
+
+  // incompressible data is stored.
+  c = compressData(noise.data(), noise.size());
+  REQUIRE(c.size() < noise.size() + 64);
+  REQUIRE(decompressData(c.data(), c.size(), out));
+  REQUIRE(out == noise);
+
+  // bad data
+  REQUIRE(!isCompressedData(noise.data(), noise.size()));
+  REQUIRE(!decompressData(c.data(), c.size() - 1, out));
+  REQUIRE(out.empty());
+  c = compressData(text.data(), text.size());
+  c.back() ^= 0xFF;
+  REQUIRE((!decompressData(c.data(), c.size(), out) || (out != text)));
+
+  // a header can't claim more data than its chunks could decode to.
+  auto setOriginalBytes = [](std::vector<uint8_t>& data, uint64_t n) {
+    memcpy(data.data() + 8, &n, sizeof(n));
+  };
+  std::vector<uint8_t> zeros(4096);
+  c = compressData(zeros.data(), zeros.size(), size_t(1) << 30);
+  REQUIRE(decompressData(c.data(), c.size(), out));
+  setOriginalBytes(c, uint64_t(1) << 30);
+  REQUIRE(getDecompressedSize(c.data(), c.size()) == 0);
+  REQUIRE(!decompressData(c.data(), c.size(), out));
+  c = compressData(noise.data(), 100, size_t(1) << 30);
+  setOriginalBytes(c, 101);
+  REQUIRE(!isCompressedData(c.data(), c.size()));
+  const uint32_t hugeChunk{0xFFFFFFFF};
+  memcpy(c.data() + 4, &hugeChunk, sizeof(hugeChunk));
+  setOriginalBytes(c, 100);
+  REQUIRE(!isCompressedData(c.data(), c.size()));
+
+  // Value trees
+  Tree<Value> v;
+  v["osc/freq"] = 440.f;
+  v["osc/wave"] = "saw";
+  v["table"] = Value(wave);
+  auto compressed = valueTreeToCompressedBinary(v);
+  REQUIRE(compressed.size() * 2 < valueTreeToBinary(v).size());
+  REQUIRE(binaryToValueTree(compressed) == v);
+  auto large = valueTreeToLargeBinary(v);
+  REQUIRE(binaryToValueTree(compressData(large.data(), large.size())) == v);
+}
+
+TEST_CASE("madronalib/core/serialization/json_stream", "[serialization]")
+{
+  Tree<Value> v;
+  v["a"] = 0.4f;
+  v["a/b/c"] = "hello again";
+  v["quote"] = "say \"hi\"\n\ttab \\ slash";
+  v["floatarr"] = Value(std::array<float, 5>{1.2f, 3.4f, 5.5f, 23.4f, -0.000000001f});
+  v["big/array"] = Value(std::vector<float>(1000, 0.125f));
+  v["q"] = 0.3;
+  v["i"] = 12;
+  std::vector<uint8_t> someData{1, 3, 5, 7, 9};
+  v["blobtest"] = Value(someData.data(), someData.size());
+
+  // the streamed text reads back the same as the cJSON version.
+  TextFragment text = valueTreeToJSONText(v);
+  auto fromStream = JSONTextToValueTree(text);
+  REQUIRE(fromStream == JSONToValueTree(valueTreeToJSON(v)));
+  REQUIRE(fromStream == JSONToValueTree(textToJSON(text)));
+  REQUIRE(fromStream["quote"] == v["quote"]);
+  REQUIRE(fromStream["i"].getFloatValue() == 12.f);
+
+  // text from cJSON, with whitespace and nested objects.
+  REQUIRE(JSONTextToValueTree(JSONToText(valueTreeToJSON(v))) == fromStream);
+  const char* nested = R"({ "osc": { "freq": 440, "wave": "saw", "on": true, "x": null },
+                           "env": {"times": [0.1, 2e-1, -3E+1]}, "u": "caf\u00e9 \ud83d\ude00" })";
+  auto n = JSONTextToValueTree(nested, strlen(nested));
+  REQUIRE(n.size() == 4);
+  REQUIRE(n["osc/freq"] == Value(440.f));
+  REQUIRE(n["osc/wave"] == Value("saw"));
+  REQUIRE(n["env/times"] == Value{0.1f, 0.2f, -30.f});
+  REQUIRE(n["u"] == Value("caf\xC3\xA9 \xF0\x9F\x98\x80"));
+
+  // through streams
+  std::stringstream stream;
+  writeValueTreeToJSON(v, stream);
+  REQUIRE(stream.str() == std::string(text.getText()));
+  REQUIRE(readValueTreeFromJSON(stream) == fromStream);
+
+  // text longer than the parser's stream buffer, so that numbers, strings and escapes
+  // are split across refills.
+  Tree<Value> longTree;
+  for (int i = 0; i < 4000; ++i)
+  {
+    Path key("keys", textUtils::naturalNumberToText(i));
+    longTree[key] = (i & 1) ? Value(i * -1.2345e-3f) : Value("\"quoted\" caf\xC3\xA9");
+  }
+  longTree["array"] = Value(std::vector<float>(20000, 0.1875f));
+  std::stringstream longStream;
+  writeValueTreeToJSON(longTree, longStream);
+  REQUIRE(longStream.str().size() > 3 * 65536);
+  REQUIRE(readValueTreeFromJSON(longStream) == JSONTextToValueTree(valueTreeToJSONText(longTree)));
+  std::stringstream truncated(longStream.str().substr(0, longStream.str().size() - 1));
+  REQUIRE(readValueTreeFromJSON(truncated).size() == 0);
+
+  // numbers of any length, including long mantissas with exponents.
+  const std::string digits(63, '1');
+  for (const std::string& num : {digits + "e+1", "-" + digits + ".5E-70", std::string(300, '2')})
+  {
+    const std::string json = "{\"a\":" + num + "}";
+    auto t = JSONTextToValueTree(json.c_str(), json.size());
+    REQUIRE(t.size() == 1);
+    REQUIRE(t["a"].getFloatValue() == static_cast<float>(strtod(num.c_str(), nullptr)));
+  }
+
+  // malformed text gives an empty tree.
+  const char* bad[] = {"", "{", "{\"a\":}", "{\"a\":1,}", "[1, 2]", "{\"a\":1} x", "{\"a\":\"\\q\"}"};
+  for (auto b : bad)
+  {
+    REQUIRE(JSONTextToValueTree(b, strlen(b)).size() == 0);
+  }
+}
+
 TEST_CASE("madronalib/core/value_serialization", "[serialization][values]")
 {
   SECTION("round-trip float")
@@ -0,0 +1,151 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// a unit test made using the Catch framework in catch.hpp / tests.cpp.
+
+#include <chrono>
+#include <thread>
+
+#include "catch.hpp"
+#include "madronalib.h"
+#include "MLSpectrumAnalyzer.h"
+
+using namespace ml;
+
+namespace spectrumAnalyzerTest
+{
+constexpr float kSr{48000.f};
+
+// write vectors of a sine to channel 1 of a signal, with silence in channel 0.
+void writeSine(SignalProcessor::PublishedSignal& signal, float freq, float amp, int vectors,
+               int& t)
+{
+  for (int v = 0; v < vectors; ++v)
+  {
+    DSPVectorArray<2> x(0.f);
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      x.row(1)[n] = amp * sinf(kTwoPi * freq * float(t++) / kSr);
+    }
+    signal.writeQuick(x, kFloatsPerDSPVector, 0);
+  }
+}
+
+// a processor with two scope signals, which computes each only while it is written.
+class ScopeProcessor : public SignalProcessor
+{
+ public:
+  ScopeProcessor()
+  {
+    pScopeA = publishSignal("scope/a", 1024, 1, 1, 0);
+    pScopeB = publishSignal("scope/b", 1024, 1, 1, 0);
+  }
+
+  void processVector(const DSPVectorDynamic&, DSPVectorDynamic&, void*) override
+  {
+    for (auto* p : {pScopeA, pScopeB})
+    {
+      if (!isPublishedSignalActive(p)) continue;
+      computed++;
+      storePublishedSignal(p, DSPVectorArray<1>(1.f), kFloatsPerDSPVector, 0);
+    }
+    storePublishedSignal("scope/b", DSPVectorArray<1>(2.f), kFloatsPerDSPVector, 0);
+    storePublishedSignal("scope/missing", DSPVectorArray<1>(3.f), kFloatsPerDSPVector, 0);
+  }
+
+  PublishedSignal* pScopeA;
+  PublishedSignal* pScopeB;
+  int computed{0};
+};
+}  // namespace spectrumAnalyzerTest
+
+using namespace spectrumAnalyzerTest;
+
+TEST_CASE("madronalib/core/spectrum_analyzer", "[spectrum_analyzer]")
+{
+  SignalProcessor::PublishedSignal signal(8192, 1, 2, 0);
+  SpectrumAnalyzerConfig config;
+  config.fftSize = 1024;
+  config.hopSize = 256;
+  config.channel = 1;
+  SpectrumAnalyzer analyzer(signal, kSr, config);
+  REQUIRE(analyzer.getNumBins() == 513);
+  REQUIRE(analyzer.getBinFrequency(64) == 3000.f);
+
+  // a half-scale sine at the center of bin 64.
+  int t{0};
+  writeSine(signal, 3000.f, 0.5f, 4096 / kFloatsPerDSPVector, t);
+  REQUIRE(analyzer.analyze() == 16);
+  REQUIRE(signal.getAvailableFrames() == 0);
+  REQUIRE(analyzer.updateSpectrum());
+  REQUIRE(!analyzer.updateSpectrum());
+  const auto& spectrum = analyzer.getSpectrum();
+  REQUIRE(spectrum[64] == Approx(-6.02f).margin(0.1f));
+  REQUIRE(spectrum[60] < -60.f);
+  REQUIRE(spectrum[200] < -60.f);
+
+  // decimated by an octave, the same sine is at bin 128.
+  config.decimationOctaves = 1;
+  SpectrumAnalyzer decimated(signal, kSr, config);
+  REQUIRE(decimated.getBinFrequency(128) == 3000.f);
+  writeSine(signal, 3000.f, 0.5f, 8192 / kFloatsPerDSPVector, t);
+  REQUIRE(decimated.analyze() == 16);
+  REQUIRE(decimated.updateSpectrum());
+  REQUIRE(decimated.getSpectrum()[128] == Approx(-6.02f).margin(0.2f));
+
+  // the analyzer thread reads the signal on its own.
+  analyzer.start(1);
+  writeSine(signal, 3000.f, 0.5f, 2048 / kFloatsPerDSPVector, t);
+  bool updated{false};
+  for (int i = 0; (i < 1000) && !updated; ++i)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    updated = analyzer.updateSpectrum();
+  }
+  analyzer.stop();
+  REQUIRE(updated);
+  REQUIRE(analyzer.getSpectrum()[64] == Approx(-6.02f).margin(0.1f));
+}
+
+TEST_CASE("madronalib/core/spectrum_analyzer/subscribers", "[spectrum_analyzer]")
+{
+  ScopeProcessor proc;
+  DSPVectorDynamic inputs, outputs;
+
+  // with no subscribers, nothing is computed or written.
+  proc.processVector(inputs, outputs, nullptr);
+  REQUIRE(proc.computed == 0);
+  REQUIRE(proc.pScopeB->getAvailableFrames() == 0);
+
+  // only the watched signal is written, by pointer and by name.
+  proc.pScopeB->subscribe();
+  proc.pScopeB->subscribe();
+  proc.processVector(inputs, outputs, nullptr);
+  REQUIRE(proc.computed == 1);
+  REQUIRE(proc.pScopeA->getAvailableFrames() == 0);
+  REQUIRE(proc.pScopeB->getAvailableFrames() == 2 * kFloatsPerDSPVector);
+
+  // the signal is written until its last subscriber leaves.
+  proc.pScopeB->unsubscribe();
+  proc.processVector(inputs, outputs, nullptr);
+  REQUIRE(proc.computed == 2);
+  proc.pScopeB->unsubscribe();
+  proc.processVector(inputs, outputs, nullptr);
+  REQUIRE(proc.computed == 2);
+  REQUIRE(!proc.pScopeB->hasSubscribers());
+
+  // a new subscriber doesn't see the frames from before.
+  proc.pScopeB->subscribe();
+  REQUIRE(proc.pScopeB->getAvailableFrames() == 0);
+  proc.pScopeB->unsubscribe();
+
+  // all signals are written while they are all active.
+  proc.setPublishedSignalsActive(true);
+  proc.processVector(inputs, outputs, nullptr);
+  REQUIRE(proc.computed == 4);
+  REQUIRE(proc.pScopeA->getAvailableFrames() == kFloatsPerDSPVector);
+
+  // storing by a name that was not published adds nothing to the tree.
+  REQUIRE(!proc.getPublishedSignals().getNode("scope/missing"));
+}
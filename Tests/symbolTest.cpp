@@ -27,11 +27,36 @@ TEST_CASE("madronalib/core/symbol/hash", "[symbol]")
   // runtime
   const char* str1("hello");
   const char* str2(u8"محمد بن سعيد");
-  auto b1 = fnv1aRuntime(str1);
-  auto b2 = fnv1aRuntime(str2);
+  auto b1 = textHashRuntime(str1);
+  auto b2 = textHashRuntime(str2);
   
   REQUIRE(a1 == b1);
   REQUIRE(a2 == b2);
+
+  REQUIRE(fnv1aSubstring(str1, strlen(str1)) == fnv1aRuntime(str1));
+  REQUIRE(fnv1aSubstring(str2, strlen(str2)) == fnv1aRuntime(str2));
+
+  // every length around the 4, 8 and 16 byte steps, and the high bytes.
+  constexpr char kLong[]{"abcdefghijklmnopqrstuvwxyz0123456789/\xE5\xB0\x8F\xE6\x9E\x97\xff"};
+  constexpr uint64_t kLongHash = textHash(kLong, sizeof(kLong) - 1);
+  REQUIRE(kLongHash == textHashRuntime(kLong));
+  std::vector<uint64_t> hashes;
+  for (size_t n = 0; n < sizeof(kLong); ++n)
+  {
+    hashes.push_back(textHashRuntime(kLong, n));
+  }
+  REQUIRE(hashes[0] == textHash("", 0));
+  REQUIRE(hashes[3] == hash("abc"));
+  REQUIRE(hashes[8] == hash("abcdefgh"));
+  REQUIRE(hashes[17] == hash("abcdefghijklmnopq"));
+  REQUIRE(hashes[33] == hash("abcdefghijklmnopqrstuvwxyz0123456"));
+  std::sort(hashes.begin(), hashes.end());
+  REQUIRE(std::unique(hashes.begin(), hashes.end()) == hashes.end());
+
+  // 0 is reserved for empty table entries and null Symbols.
+  static_assert(ml::detail::nonzeroHash(0) == 1);
+  static_assert(ml::detail::nonzeroHash(kLongHash) == kLongHash);
+  REQUIRE(hashes[0] != 0);
 }
 
 TEST_CASE("madronalib/core/symbol/simple", "[symbol][simple]")
@@ -95,9 +120,168 @@ TEST_CASE("madronalib/core/symbol/threads", "[symbol][threads]")
   REQUIRE(theSymbolTable().getSize() == nSymbolsPerThread);
 }
 
+TEST_CASE("madronalib/core/symbol/concurrent_lookup", "[symbol][threads]")
+{
+  // readers look up existing symbols while writers add new ones, which makes
+  // the shards grow underneath the readers.
+  constexpr int kExisting{200};
+  std::vector<Symbol> existing;
+  std::vector<std::string> existingText;
+  for (int i = 0; i < kExisting; ++i)
+  {
+    existingText.push_back("existing" + std::to_string(i));
+    existing.push_back(Symbol(existingText.back().c_str()));
+  }
+
+  std::atomic<bool> writing{true};
+  std::atomic<int> errors{0};
+  std::vector<std::thread> readers;
+  for (int r = 0; r < 4; ++r)
+  {
+    readers.emplace_back([&]() {
+      while (writing)
+      {
+        for (int i = 0; i < kExisting; ++i)
+        {
+          if (existing[i].toString() != existingText[i]) errors++;
+          if (Symbol(existingText[i].c_str()) != existing[i]) errors++;
+        }
+      }
+    });
+  }
+  std::vector<std::thread> writers;
+  for (int w = 0; w < 4; ++w)
+  {
+    writers.emplace_back(threadTest, TextFragment('a' + w), 2000);
+  }
+  for (auto& t : writers) t.join();
+  writing = false;
+  for (auto& t : readers) t.join();
+  REQUIRE(errors == 0);
+}
+
+TEST_CASE("madronalib/core/symbol/arena", "[symbol]")
+{
+  SymbolTable table;
+  uint64_t first = table.registerSymbol("first", 5);
+  const char* firstText = table.getTextForHash(first).getText();
+
+  // fill the table well past its first arena blocks and tables.
+  std::string longText(100000, 'x');
+  uint64_t longHash = table.registerSymbol(longText.data(), longText.size());
+  for (int i = 0; i < 20000; ++i)
+  {
+    std::string s = "arena_test_symbol_" + std::to_string(i);
+    table.registerSymbol(s.data(), s.size());
+  }
+
+  // texts don't move as the table grows.
+  REQUIRE(table.getTextForHash(first).getText() == firstText);
+  REQUIRE(table.getTextViewForHash(first) == "first");
+  REQUIRE(table.getTextViewForHash(longHash) == longText);
+  REQUIRE(table.getTextViewForHash(longHash).data() == table.getTextForHash(longHash).getText());
+  REQUIRE(table.getTextViewForHash(12345) == "?");
+
+  auto stats = table.getMemoryStats();
+  REQUIRE(stats.symbols == 20002);
+  REQUIRE(stats.symbols == table.getSize());
+  REQUIRE(stats.textBytes > longText.size());
+  REQUIRE(stats.arenaBytesUsed > stats.textBytes);
+  REQUIRE(stats.arenaBytesReserved >= stats.arenaBytesUsed);
+  REQUIRE(stats.arenaBlocks < stats.symbols / 50);
+  REQUIRE(stats.tableBytes > 0);
+
+  table.clear();
+  stats = table.getMemoryStats();
+  REQUIRE(stats.symbols == 0);
+  REQUIRE(stats.arenaBytesReserved == 0);
+  REQUIRE(table.getTextViewForHash(first) == "?");
+}
+
+TEST_CASE("madronalib/core/symbol/scope", "[symbol]")
+{
+  Symbol permanent("scope_test_permanent");
+  const size_t globalSize = theSymbolTable().getSize();
+  uint64_t tempHash, innerHash;
+  {
+    SymbolScope scope;
+    REQUIRE(SymbolScope::current() == &scope);
+
+    // new symbols go to the scope. Existing ones stay global.
+    Symbol temp("scope_test_temporary");
+    Symbol again("scope_test_permanent");
+    tempHash = temp.getHash();
+    REQUIRE(again == permanent);
+    REQUIRE(temp.getTextView() == "scope_test_temporary");
+    REQUIRE(scope.getSize() == 1);
+    REQUIRE(theSymbolTable().getSize() == globalSize);
+
+    for (int i = 0; i < 1000; ++i)
+    {
+      Symbol s(("scope_test_" + std::to_string(i)).c_str());
+    }
+    REQUIRE(scope.getSize() == 1001);
+    REQUIRE(scope.getMemoryStats().arenaBytesReserved > 0);
+
+    // an inner scope finds the outer scope's symbols, and keeps its own.
+    {
+      SymbolScope inner;
+      REQUIRE(Symbol("scope_test_temporary") == temp);
+      Symbol s("scope_test_inner");
+      innerHash = s.getHash();
+      REQUIRE(inner.getSize() == 1);
+      REQUIRE(s.getTextView() == "scope_test_inner");
+      REQUIRE(temp.getTextView() == "scope_test_temporary");
+    }
+    REQUIRE(SymbolScope::current() == &scope);
+    REQUIRE(Symbol(innerHash).getTextView() == "?");
+    REQUIRE(scope.getSize() == 1001);
+  }
+
+  // after the scope, its symbols are gone from all tables.
+  REQUIRE(SymbolScope::current() == nullptr);
+  REQUIRE(theSymbolTable().getSize() == globalSize);
+  REQUIRE(Symbol(tempHash).getTextView() == "?");
+  REQUIRE(permanent.getTextView() == "scope_test_permanent");
+
+  // other threads register globally.
+  SymbolScope scope;
+  std::thread t([]() { Symbol s("scope_test_other_thread"); });
+  t.join();
+  REQUIRE(scope.getSize() == 0);
+  REQUIRE(theSymbolTable().getSize() == globalSize + 1);
+}
 
 const char letters[24] = "abcdefghjklmnopqrstuvw";
 
+ML_STATIC_PATH(kStaticTestPath, "static_test/segment/path");
+
+TEST_CASE("madronalib/core/symbol/static", "[symbol]")
+{
+  // compile-time path symbols have text without being registered at runtime.
+  // other tests clear the table, so reload them first.
+  theSymbolTable().clear();
+  REQUIRE(theSymbolTable().getSize() == 0);
+  theSymbolTable().reloadStaticSymbols();
+  REQUIRE(kStaticTestPath.size_ == 3);
+  REQUIRE(Symbol(kStaticTestPath.elements_[0]).getTextView() == "static_test");
+  REQUIRE(Symbol(kStaticTestPath.elements_[2]).getTextView() == "path");
+
+  // a new table loads all the static texts.
+  SymbolTable table;
+  REQUIRE(table.hasUnregisteredStaticSymbols());
+  table.registerStaticSymbols();
+  REQUIRE(!table.hasUnregisteredStaticSymbols());
+  REQUIRE(table.getTextViewForHash(kStaticTestPath.elements_[1]) == "segment");
+
+  // bulk insert, with duplicates.
+  std::vector<std::string_view> texts{"bulk_a", "bulk_b", "bulk_a", "segment"};
+  size_t sizeBefore = table.getSize();
+  table.registerSymbols(texts);
+  REQUIRE(table.getSize() == sizeBefore + 2);
+  REQUIRE(table.getTextViewForHash(hash("bulk_b")) == "bulk_b");
+}
+
 TEST_CASE("madronalib/core/symbol/maps", "[symbol]")
 {
   const int kMapSize = 100;
@@ -4,6 +4,8 @@
 
 // a unit test made using the Catch framework in catch.hpp / tests.cpp.
 
+#include <thread>
+
 #include "catch.hpp"
 #include "madronalib.h"
 #include "MLTestUtils.h"
@@ -46,3 +48,474 @@ TEST_CASE("madronalib/core/text", "[text]")
   REQUIRE(textUtils::stripExtension(footxt) == "foo");
   REQUIRE(textUtils::getExtension(footxt) == "txt");
 }
+
+TEST_CASE("madronalib/core/text/shared", "[text]")
+{
+  const std::string longText(200, 'x');
+  const std::string shortText(kShortFragmentSizeInChars - 1, 'y');
+
+  // copies of long text share it, and keep it after the original is gone.
+  auto a = std::make_unique<TextFragment>(longText.c_str());
+  TextFragment b(*a);
+  TextFragment c;
+  c = b;
+  REQUIRE(b.getText() == a->getText());
+  REQUIRE(c.getText() == a->getText());
+  a.reset();
+  REQUIRE(b == TextFragment(longText.c_str()));
+  REQUIRE(c.lengthInBytes() == 200);
+
+  // short text is copied into each fragment.
+  TextFragment d(shortText.c_str());
+  TextFragment e(d);
+  REQUIRE(e.getText() != d.getText());
+  REQUIRE(e == d);
+
+  // assigning short text over shared text, and moving it.
+  c = e;
+  REQUIRE(c == d);
+  TextFragment f(std::move(b));
+  REQUIRE(f.getText()[199] == 'x');
+  REQUIRE(b.lengthInBytes() == 0);
+  f = f;
+  REQUIRE(f.lengthInBytes() == 200);
+
+  // copies of a long Symbol's text, which the SymbolTable owns, get text of their own.
+  Symbol s(runtimePath(longText.c_str()).getElement(0));
+  TextFragment g(s.getTextFragment());
+  REQUIRE(g.getText() != s.getUTF8Ptr());
+  REQUIRE(g == TextFragment(longText.c_str()));
+
+  // copying and destroying on many threads at once.
+  std::vector<std::thread> threads;
+  std::atomic<bool> ok{true};
+  for (int t = 0; t < 4; ++t)
+  {
+    threads.emplace_back(
+        [&]()
+        {
+          for (int i = 0; i < 10000; ++i)
+          {
+            TextFragment h(f);
+            std::vector<TextFragment> v(4, h);
+            if (v.back().getText() != f.getText()) ok = false;
+          }
+        });
+  }
+  for (auto& t : threads)
+  {
+    t.join();
+  }
+  REQUIRE(ok);
+  REQUIRE(f == TextFragment(longText.c_str()));
+}
+
+TEST_CASE("madronalib/core/text/iterator", "[text]")
+{
+  const char* kobayashi("\xE5\xB0\x8F\xE6\x9E\x97\x20\xE5\xB0\x8A");
+
+  // iterators are plain values.
+  TextFragment k(kobayashi);
+  auto it = k.begin();
+  auto it2 = it;
+  ++it2;
+  it = it2;
+  REQUIRE(it == it2);
+  REQUIRE(*it == 0x6797);
+  REQUIRE(it.getPosition() == k.getText() + 3);
+
+  std::vector<CodePoint> expected{0x5c0f, 0x6797, 0x20, 0x5c0a};
+  REQUIRE(textToCodePoints(k) == expected);
+  REQUIRE(k.lengthInCodePoints() == 4);
+
+  // ASCII prefixes of every length around the 16-byte scan width.
+  for (int n = 0; n < 40; ++n)
+  {
+    std::string ascii(n, 'x');
+    if (n) ascii[n / 2] = '.';
+    TextFragment a(ascii.c_str());
+    TextFragment mixed(ascii.c_str(), kobayashi, "/b.c");
+    REQUIRE(countASCIIPrefix(a.getText(), a.lengthInBytes()) == n);
+    REQUIRE(countASCIIPrefix(mixed.getText(), mixed.lengthInBytes()) == n);
+    REQUIRE(a.lengthInCodePoints() == n);
+    REQUIRE(mixed.lengthInCodePoints() == n + 8);
+
+    int dot = n ? n / 2 : -1;
+    REQUIRE(textUtils::findFirst(a, '.') == dot);
+    REQUIRE(textUtils::findLast(a, '.') == dot);
+    REQUIRE(textUtils::findFirst(mixed, '.') == (n ? dot : 6));
+    REQUIRE(textUtils::findLast(mixed, '.') == n + 6);
+    REQUIRE(textUtils::findFirst(mixed, 0x6797) == n + 1);
+    REQUIRE(textUtils::findLast(mixed, '/') == n + 4);
+
+    REQUIRE(textUtils::subText(mixed, n, n + 4) == TextFragment(kobayashi));
+    REQUIRE(textUtils::subText(mixed, 0, n) == a);
+  }
+}
+
+TEST_CASE("madronalib/core/text/views", "[text]")
+{
+  const char* kobayashi("\xE5\xB0\x8F\xE6\x9E\x97\x20\xE5\xB0\x8A");
+  std::vector<TextFragment> inputs{"", "a", "/", "a/", "////a/b", "a/b/c/////",
+                                   "hello/world/get//segments",
+                                   TextFragment("///hello/", kobayashi, "/segments")};
+
+  // the splitter finds the same pieces as split().
+  for (const auto& t : inputs)
+  {
+    auto pieces = textUtils::split(t, '/');
+    textUtils::TextSplitter splitter(t, '/');
+    REQUIRE(splitter.countPieces() == pieces.size());
+    size_t i = 0;
+    for (TextView v : splitter)
+    {
+      REQUIRE(v == pieces[i]);
+      REQUIRE(splitter.getPiece(i) == v);
+      i++;
+    }
+    REQUIRE(!splitter.getPiece(i));
+    REQUIRE(textUtils::join(pieces, '/').lengthInBytes() <= t.lengthInBytes());
+  }
+
+  // a multibyte delimiter.
+  TextFragment k(kobayashi);
+  auto kPieces = textUtils::split(k, 0x6797);
+  REQUIRE(kPieces.size() == 2);
+  REQUIRE(kPieces[0] == TextFragment(CodePoint(0x5c0f)));
+  REQUIRE(textUtils::join(kPieces, 0x6797) == k);
+
+  TextFragment abc(textUtils::join({"a", "bc", "", "d"}));
+  REQUIRE(abc == "abcd");
+  REQUIRE(textUtils::join({"a", "bc", "d"}, ',') == "a,bc,d");
+  REQUIRE(!textUtils::join({}, ','));
+
+  // views into the original text.
+  TextFragment padded("  \t hello ", kobayashi, " \n");
+  TextView stripped = textUtils::stripWhitespaceAtEndsView(padded);
+  REQUIRE(stripped.getText() == padded.getText() + 4);
+  REQUIRE(TextFragment(stripped) == TextFragment("hello ", kobayashi));
+  REQUIRE(textUtils::stripWhitespaceAtEnds(padded) == TextFragment(stripped));
+  REQUIRE(!textUtils::stripWhitespaceAtEndsView(" \t "));
+
+  TextView sub = textUtils::subTextView(padded, 5, 11);
+  REQUIRE(sub.getText() == padded.getText() + 5);
+  REQUIRE(sub.lengthInCodePoints() == 6);
+  REQUIRE(TextFragment(sub) == TextFragment("ello ", TextFragment(CodePoint(0x5c0f))));
+  REQUIRE(textUtils::subTextView(padded, 12, 100).lengthInCodePoints() == 4);
+  REQUIRE(!textUtils::subTextView(padded, 100, 200));
+}
+
+TEST_CASE("madronalib/core/text/numbers", "[text]")
+{
+  char buf[textUtils::kMaxNumberChars];
+  auto toText = [&](float f) { return TextFragment(buf, textUtils::floatNumberToChars(f, buf)); };
+
+  for (size_t i : {size_t(0), size_t(7), size_t(10), size_t(99), size_t(100), size_t(12345678),
+                   std::numeric_limits<size_t>::max()})
+  {
+    TextFragment t(buf, textUtils::naturalNumberToChars(i, buf));
+    REQUIRE(t == TextFragment(std::to_string(i).c_str()));
+    size_t j = 0;
+    REQUIRE(textUtils::charsToNaturalNumber(t.getText(), t.lengthInBytes(), j) ==
+            t.lengthInBytes());
+    REQUIRE(i == j);
+  }
+
+  // shortest text.
+  REQUIRE(toText(0.1f) == "0.1");
+  REQUIRE(toText(-0.5f) == "-0.5");
+  REQUIRE(toText(12345.f) == "12345");
+  REQUIRE(toText(1e38f) == "1e+38");
+  REQUIRE(toText(std::numeric_limits<float>::infinity()) == "inf");
+
+  // every float reads back exactly, for a good sample of bit patterns.
+  int errors{0};
+  uint32_t bits = 1;
+  for (int i = 0; i < 100000; ++i)
+  {
+    bits = bits * 1664525u + 1013904223u;
+    float f;
+    memcpy(&f, &bits, 4);
+    if (std::isnan(f)) continue;
+    size_t n = textUtils::floatNumberToChars(f, buf);
+    float g{0};
+    if (textUtils::charsToFloatNumber(buf, n, g) != n) errors++;
+    if (memcmp(&f, &g, 4)) errors++;
+  }
+  REQUIRE(!errors);
+
+  // reading stops at the end of the number.
+  float f{0};
+  REQUIRE(textUtils::charsToFloatNumber("1.5abc", 6, f) == 3);
+  REQUIRE(f == 1.5f);
+  REQUIRE(textUtils::charsToFloatNumber("2e", 2, f) == 1);
+  REQUIRE(f == 2.f);
+  REQUIRE(textUtils::charsToFloatNumber("abc", 3, f) == 0);
+  REQUIRE(textUtils::charsToFloatNumber("-inf", 4, f) == 4);
+  REQUIRE(f == -std::numeric_limits<float>::infinity());
+  REQUIRE(textUtils::charsToFloatNumber("1e60", 4, f) == 4);
+  REQUIRE(std::isinf(f));
+  REQUIRE(textUtils::textToFloatNumber("-2.25e-3") == -2.25e-3f);
+  REQUIRE(textUtils::textToFloatNumber("") == 0.f);
+
+  // formatNumber matches printf.
+  for (float v : {0.f, 1.f, -1.f, 0.5f, -12.345f, 99.999f, 440.f, 1234.5678f, -0.0001f})
+  {
+    for (int digits = 1; digits < 6; ++digits)
+    {
+      for (int precision = 0; precision < 4; ++precision)
+      {
+        for (bool doSign : {false, true})
+        {
+          int m = (precision > 0) ? std::max(digits, precision + 1) : digits;
+          int d = ceil(log10f(fabs(v) + 1.));
+          int p = std::max((d + precision > m) ? m - d : precision, 0);
+          char expected[16];
+          snprintf(expected, 16, doSign ? "%-+0*.*f" : "%-0*.*f", m, p, v);
+          REQUIRE(textUtils::formatNumber(v, digits, precision, doSign) == expected);
+          char dB[16];
+          snprintf(dB, 16, doSign ? "%-+0*.*fdB" : "%-0*.*fdB", m, p, v);
+          REQUIRE(textUtils::formatNumber(v, digits, precision, doSign, "db") == dB);
+        }
+      }
+    }
+  }
+  REQUIRE(textUtils::formatNumber(0.75f, 3, 1, false, "ratio") == "3/4");
+  REQUIRE(textUtils::formatNumber(440.f, 4, 1, false, "pitch1") == "440.0\nA4");
+  REQUIRE(textUtils::formatNumber(261.63f, 4, 1, false, "pitch2") == "261.6\nC3");
+  char small[4];
+  REQUIRE(textUtils::formatNumber(small, 4, 123.456f, 6, 2, false) == 3);
+  REQUIRE(TextFragment(small) == "123");
+}
+
+TEST_CASE("madronalib/core/text/collation", "[text]")
+{
+  const char* kobayashi("\xE5\xB0\x8F\xE6\x9E\x97\x20\xE5\xB0\x8A");
+  std::vector<TextFragment> texts{"",      "a",       "A",      "b",    "B",    "ab",    "aB",
+                                  "Ab",    "abc",     "abd",    "z",    "Z",    "zz",    "0",
+                                  "9 lives", "_",     " ",      "a b",  "\xC3\xA9t\xC3\xA9",
+                                  "\xC3\x89t\xC3\xA9", kobayashi, "\xE6\x9E\x97", "a\xE6\x9E\x97"};
+
+  // keys compare in the same order as collate().
+  std::vector<textUtils::CollationKey> keys;
+  for (const auto& t : texts)
+  {
+    keys.push_back(textUtils::makeCollationKey(t));
+    REQUIRE(keys.back().size() <= textUtils::getMaxCollationKeySize(t.lengthInBytes()));
+  }
+  for (size_t i = 0; i < texts.size(); ++i)
+  {
+    REQUIRE(!textUtils::collate(texts[i], texts[i]));
+    for (size_t j = 0; j < texts.size(); ++j)
+    {
+      REQUIRE(textUtils::collate(texts[i], texts[j]) == (keys[i] < keys[j]));
+    }
+  }
+
+  REQUIRE(textUtils::collate("a", "B"));
+  REQUIRE(textUtils::collate("a", "A"));
+  REQUIRE(textUtils::collate("A", "b"));
+  REQUIRE(textUtils::collate("ab", "abc"));
+  REQUIRE(textUtils::collate("z", kobayashi));
+  REQUIRE(!textUtils::collate("", ""));
+
+  // sorting by key gives the same list as sorting with the Collator.
+  auto byCollator = texts;
+  std::sort(byCollator.begin(), byCollator.end(), textUtils::Collator());
+  std::vector<size_t> order(texts.size());
+  for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return keys[a] < keys[b]; });
+  for (size_t i = 0; i < order.size(); ++i)
+  {
+    REQUIRE(texts[order[i]] == byCollator[i]);
+  }
+}
+
+TEST_CASE("madronalib/core/text/base64", "[text]")
+{
+  REQUIRE(textUtils::base64Encode(std::vector<uint8_t>{}) == "");
+  REQUIRE(textUtils::base64Encode(std::vector<uint8_t>{'f'}) == "Zg==");
+  REQUIRE(textUtils::base64Encode(std::vector<uint8_t>{'f', 'o'}) == "Zm8=");
+  REQUIRE(textUtils::base64Encode(std::vector<uint8_t>{'f', 'o', 'o'}) == "Zm9v");
+  REQUIRE(textUtils::base64Decode("Zm9vYg==") == std::vector<uint8_t>{'f', 'o', 'o', 'b'});
+
+  // round trips of all lengths through the SIMD blocks and the scalar tails
+  std::vector<uint8_t> data;
+  uint32_t seed = 1;
+  for (size_t n = 0; n < 200; ++n)
+  {
+    auto text = textUtils::base64Encode(data);
+    REQUIRE(text.lengthInBytes() == textUtils::getBase64EncodedSize(n));
+    REQUIRE(textUtils::base64Decode(text) == data);
+
+    seed = seed * 1664525 + 1013904223;
+    data.push_back(static_cast<uint8_t>(seed >> 24));
+  }
+
+  // compare the SIMD encoder to a scalar reference.
+  const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::vector<uint8_t> all(256 * 3);
+  for (size_t i = 0; i < all.size(); ++i) all[i] = static_cast<uint8_t>(i * 85 + i / 3);
+  std::vector<char> encoded(textUtils::getBase64EncodedSize(all.size()));
+  REQUIRE(textUtils::base64Encode(all.data(), all.size(), encoded.data()) == encoded.size());
+  for (size_t i = 0; i < all.size(); i += 3)
+  {
+    uint32_t v = (all[i] << 16) | (all[i + 1] << 8) | all[i + 2];
+    const char* c = encoded.data() + i / 3 * 4;
+    REQUIRE(c[0] == alphabet[(v >> 18) & 63]);
+    REQUIRE(c[1] == alphabet[(v >> 12) & 63]);
+    REQUIRE(c[2] == alphabet[(v >> 6) & 63]);
+    REQUIRE(c[3] == alphabet[v & 63]);
+  }
+
+  // decoding stops at the first char outside the alphabet, wherever it is.
+  std::vector<uint8_t> decoded(textUtils::getBase64MaxDecodedSize(encoded.size()));
+  for (int c = 0; c < 256; ++c)
+  {
+    if (strchr(alphabet, c) && c) continue;
+    for (size_t pos : {size_t(0), size_t(5), size_t(37), size_t(500)})
+    {
+      std::vector<char> bad(encoded);
+      bad[pos] = static_cast<char>(c);
+      size_t n = textUtils::base64Decode(bad.data(), bad.size(), decoded.data());
+      REQUIRE(n == pos * 3 / 4);
+      REQUIRE(std::equal(decoded.begin(), decoded.begin() + n, all.begin()));
+    }
+  }
+  REQUIRE(textUtils::base64Decode(encoded.data(), encoded.size(), decoded.data()) == all.size());
+  REQUIRE(decoded == all);
+}
+
+TEST_CASE("madronalib/core/text/utf8", "[text]")
+{
+  auto valid = [](const char* s) { return textUtils::validateUTF8(s, strlen(s)); };
+  REQUIRE(valid(""));
+  REQUIRE(valid("hello"));
+  REQUIRE(valid("\xc2\xa9 caf\xc3\xa9 \xe6\x97\xa5\xe6\x9c\xac \xf0\x9f\x98\x80"));
+  REQUIRE(valid("\xed\x9f\xbf\xee\x80\x80\xf4\x8f\xbf\xbf"));
+
+  // stray continuations, overlong encodings, surrogates, past 0x10FFFF and truncations.
+  for (const char* bad : {"\x80", "a\xbf", "\xc0\xaf", "\xc1\xbf", "\xe0\x9f\xbf",
+                          "\xf0\x8f\xbf\xbf", "\xed\xa0\x80", "\xed\xbf\xbf",
+                          "\xf4\x90\x80\x80", "\xf5\x80\x80\x80", "\xff", "\xc3",
+                          "\xe6\x97", "\xf0\x9f\x98", "\xc3" "a", "\xe6\x97\xa5\xa5"})
+  {
+    REQUIRE(!valid(bad));
+  }
+
+  // long text, with each error placed in every position of the SIMD blocks and the tail.
+  std::string text;
+  const char* words[]{"abc ", "\xc3\xa9t\xc3\xa9 ", "\xe6\x97\xa5\xe6\x9c\xac ",
+                      "\xf0\x9f\x98\x80 "};
+  const size_t pointsPerWord[]{4, 4, 3, 2};
+  size_t points{0};
+  for (int i = 0; i < 40; ++i)
+  {
+    text += words[i * 7 % 4];
+    points += pointsPerWord[i * 7 % 4];
+  }
+  REQUIRE(textUtils::validateUTF8(text.data(), text.size()));
+  REQUIRE(TextFragment(text.c_str()).lengthInCodePoints() == points);
+  const std::string ascii(48, 'a');
+  for (const char* seq : {"\xc3\xa9", "\xe6\x97\xa5", "\xf0\x9f\x98\x80", "\xc0\xaf",
+                          "\xed\xa0\x80", "\xf4\x90\x80\x80", "\xe6\x97", "\x80"})
+  {
+    const bool expected = valid(seq);
+    for (size_t pos = 0; pos + strlen(seq) <= ascii.size(); ++pos)
+    {
+      std::string t(ascii);
+      t.replace(pos, strlen(seq), seq);
+      REQUIRE(textUtils::validateUTF8(t.data(), t.size()) == expected);
+    }
+  }
+
+  // a truncated sequence at the very end.
+  std::string cut(text + "\xf0\x9f\x98");
+  REQUIRE(!textUtils::validateUTF8(cut.data(), cut.size()));
+
+  // counting code points in text longer than the 255 blocks counted at a time.
+  std::string longText;
+  for (int i = 0; i < 1000; ++i) longText += "\xc3\xa9\xe6\x97\xa5";
+  REQUIRE(TextFragment(longText.c_str()).lengthInCodePoints() == 2000);
+  REQUIRE(textUtils::bestScriptForTextFragment("plain text \xc3\xa9") == "latin");
+  REQUIRE(textUtils::bestScriptForTextFragment("plain text \xe6\x97\xa5") == "cjk");
+}
+
+TEST_CASE("madronalib/core/text/aes", "[text]")
+{
+  auto fromHex = [](const char* hex) {
+    std::vector<uint8_t> r;
+    for (const char* p = hex; p[0] && p[1]; p += 2)
+    {
+      r.push_back(static_cast<uint8_t>(std::stoi(std::string(p, 2), nullptr, 16)));
+    }
+    return r;
+  };
+
+  // NIST SP 800-38A, F.2.5 CBC-AES256.Encrypt. The iv is 32 bytes for the vector API.
+  auto key = fromHex("603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4");
+  auto iv = fromHex("000102030405060708090a0b0c0d0e0f000102030405060708090a0b0c0d0e0f");
+  auto plain = fromHex(
+      "6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+      "30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710");
+  auto expected = fromHex(
+      "f58c4c04d6e5f1ba779eabfb5f7bfbd69cfc4e967edb808d679f777bc6702c7d"
+      "39f23369a9d9bacfa530e26304231461b2eb05e2c39be9fcda6c19078c6a9d1b");
+
+  std::vector<uint8_t> data(5000);
+  for (size_t i = 0; i < data.size(); ++i) data[i] = static_cast<uint8_t>(i * 13 + (i >> 8));
+
+  std::vector<std::vector<uint8_t>> results;
+  for (bool hardware : {false, true})
+  {
+    textUtils::setUseAESHardware(hardware);
+
+    auto c = textUtils::AES256CBCEncode(plain, key, iv);
+    REQUIRE(c.size() == plain.size() + 16);
+    REQUIRE(std::equal(expected.begin(), expected.end(), c.begin()));
+    REQUIRE(textUtils::AES256CBCDecode(c, key, iv) == plain);
+
+    // all sizes of input around the block size
+    for (size_t n = 1; n < 40; ++n)
+    {
+      std::vector<uint8_t> in(data.begin(), data.begin() + n);
+      auto e = textUtils::AES256CBCEncode(in, key, iv);
+      REQUIRE(e.size() == (n / 16 + 1) * 16);
+      REQUIRE(textUtils::AES256CBCDecode(e, key, iv) == in);
+    }
+
+    // streams in uneven pieces give the same results as the vector API.
+    auto whole = textUtils::AES256CBCEncode(data, key, iv);
+    for (size_t piece : {size_t(1), size_t(7), size_t(16), size_t(100), size_t(4096)})
+    {
+      std::vector<uint8_t> encoded(data.size() + 32), decoded(data.size() + 32);
+      textUtils::AES256CBCStream enc(textUtils::AES256CBCStream::kEncode, key.data(), iv.data());
+      size_t n = 0;
+      for (size_t i = 0; i < data.size(); i += piece)
+      {
+        n += enc.update(data.data() + i, std::min(piece, data.size() - i), encoded.data() + n);
+      }
+      n += enc.finish(encoded.data() + n);
+      encoded.resize(n);
+      REQUIRE(encoded == whole);
+
+      textUtils::AES256CBCStream dec(textUtils::AES256CBCStream::kDecode, key.data(), iv.data());
+      n = 0;
+      for (size_t i = 0; i < encoded.size(); i += piece)
+      {
+        n += dec.update(encoded.data() + i, std::min(piece, encoded.size() - i),
+                        decoded.data() + n);
+      }
+      n += dec.finish(decoded.data() + n);
+      decoded.resize(n);
+      REQUIRE(decoded == data);
+    }
+    results.push_back(whole);
+  }
+  REQUIRE(results[0] == results[1]);
+  textUtils::setUseAESHardware(true);
+
+  // bad arguments
+  REQUIRE(textUtils::AES256CBCEncode(std::vector<uint8_t>(), key, iv).empty());
+  REQUIRE(textUtils::AES256CBCDecode(std::vector<uint8_t>(5), key, iv).empty());
+}
@@ -96,3 +96,114 @@ TEST_CASE("madronalib/core/timer/basic", "[timer][basic]")
   system("pause");
 #endif
 }
+
+TEST_CASE("madronalib/core/timer/wheel", "[timer][wheel]")
+{
+  // drive the wheel by hand with a 100 microsecond resolution.
+  auto t0 = TimerWheel::Clock::now();
+  const auto res = microseconds(100);
+  TimerWheel wheel(res, t0);
+  auto at = [&](int ticks) { return t0 + res * ticks; };
+
+  int onceCount{0}, nCount{0}, periodicCount{0}, cancelledCount{0}, longCount{0};
+  wheel.callOnce([&]() { onceCount++; }, microseconds(250));
+  wheel.callNTimes([&]() { nCount++; }, microseconds(1000), 3);
+  auto periodic = wheel.callPeriodically([&]() { periodicCount++; }, microseconds(100));
+  auto cancelled = wheel.callOnce([&]() { cancelledCount++; }, microseconds(500));
+
+  // long enough to cascade down from the third level.
+  auto longTimer = wheel.callOnce([&]() { longCount++; }, res * 70000);
+  REQUIRE(wheel.getActiveCount() == 5);
+
+  // delays are rounded up to whole ticks.
+  wheel.advanceTo(at(2));
+  REQUIRE(onceCount == 0);
+  wheel.advanceTo(at(3));
+  REQUIRE(onceCount == 1);
+  REQUIRE(periodicCount == 3);
+
+  REQUIRE(wheel.cancel(cancelled));
+  REQUIRE(!wheel.cancel(cancelled));
+  REQUIRE(!wheel.isActive(cancelled));
+
+  wheel.advanceTo(at(100));
+  REQUIRE(nCount == 3);
+  REQUIRE(cancelledCount == 0);
+  REQUIRE(periodicCount == 100);
+  REQUIRE(wheel.cancel(periodic));
+  wheel.advanceTo(at(200));
+  REQUIRE(periodicCount == 100);
+
+  REQUIRE(wheel.isActive(longTimer));
+  wheel.advanceTo(at(69999));
+  REQUIRE(longCount == 0);
+  wheel.advanceTo(at(70000));
+  REQUIRE(longCount == 1);
+  REQUIRE(wheel.getActiveCount() == 0);
+
+  // callbacks can schedule and cancel timers.
+  int chainCount{0};
+  std::function<void()> chain = [&]() {
+    if (++chainCount < 10) wheel.callOnce(chain, res);
+  };
+  wheel.callOnce(chain, res);
+  TimerWheel::TimerID selfCancelling;
+  selfCancelling = wheel.callPeriodically([&]() { wheel.cancel(selfCancelling); }, res);
+  wheel.advanceTo(at(70100));
+  REQUIRE(chainCount == 10);
+  REQUIRE(wheel.getActiveCount() == 0);
+
+  // a callback can cancel a timer that expires on the same tick, which then doesn't run.
+  int pairCount{0};
+  TimerWheel::TimerID first, second;
+  first = wheel.callOnce([&]() { pairCount++; REQUIRE(wheel.cancel(second)); }, res);
+  second = wheel.callOnce([&]() { pairCount++; REQUIRE(wheel.cancel(first)); }, res);
+  wheel.advanceTo(at(70101));
+  REQUIRE(pairCount == 1);
+  REQUIRE(wheel.getActiveCount() == 0);
+
+  // many timers, expiring in order on a running wheel.
+  TimerWheel running(microseconds(500));
+  std::atomic<int> runningCount{0};
+  for (int i = 0; i < 1000; ++i)
+  {
+    running.callOnce([&]() { runningCount++; }, microseconds(500 * (i % 20 + 1)));
+  }
+  running.start();
+  auto start = steady_clock::now();
+  while (runningCount < 1000 && steady_clock::now() - start < milliseconds(2000))
+  {
+    std::this_thread::sleep_for(milliseconds(1));
+  }
+  running.stop();
+  REQUIRE(runningCount == 1000);
+}
+
+TEST_CASE("madronalib/core/timer/ticks", "[timer][ticks]")
+{
+  REQUIRE(TickClock::getTicksPerSecond() > 1e6);
+
+  // ticks are monotonic.
+  uint64_t prev = TickClock::now();
+  bool monotonic{true};
+  for (int i = 0; i < 100000; ++i)
+  {
+    uint64_t t = TickClock::now();
+    monotonic &= (t >= prev);
+    prev = t;
+  }
+  REQUIRE(monotonic);
+
+  // and agree with steady_clock over a sleep, allowing for a busy test machine.
+  auto steadyStart = std::chrono::steady_clock::now();
+  uint64_t tickStart = TickClock::now();
+  std::this_thread::sleep_for(std::chrono::milliseconds(longSleepMs));
+  uint64_t tickEnd = TickClock::now();
+  std::chrono::duration<double> steadyElapsed = std::chrono::steady_clock::now() - steadyStart;
+  double tickElapsed = TickClock::secondsBetween(tickStart, tickEnd);
+  REQUIRE(fabs(tickElapsed - steadyElapsed.count()) < 0.005);
+  REQUIRE(TickClock::secondsBetween(tickEnd, tickStart) < 0.);
+  uint64_t roundTrip = TickClock::secondsToTicks(TickClock::ticksToSeconds(1000000));
+  REQUIRE(roundTrip >= 999999);
+  REQUIRE(roundTrip <= 1000001);
+}
@@ -0,0 +1,89 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// a unit test made using the Catch framework in catch.hpp / tests.cpp.
+
+#include <thread>
+
+#include "catch.hpp"
+#include "madronalib.h"
+#include "MLTrashQueue.h"
+
+using namespace ml;
+
+namespace trashQueueTest
+{
+// counts the live instances.
+std::atomic<int> gLive{0};
+
+struct Counted
+{
+  Counted() { gLive++; }
+  ~Counted() { gLive--; }
+};
+}  // namespace trashQueueTest
+
+using namespace trashQueueTest;
+
+TEST_CASE("madronalib/core/trash_queue", "[trash_queue]")
+{
+  TrashQueue trash(4);
+
+  // a Value with a heap payload.
+  Value blob(std::vector<float>(1000, 1.f));
+  REQUIRE(trash.dispose(std::move(blob)));
+
+  // a Sample, and a shared sample held nowhere else.
+  Sample sample;
+  resize(sample, 1000);
+  REQUIRE(trash.dispose(std::move(sample)));
+  REQUIRE(getSize(sample) == 0);
+  auto pooled = std::make_shared<const Sample>(Sample{1, 48000, LargeBuffer<float>(1000)});
+  std::weak_ptr<const Sample> watcher = pooled;
+  REQUIRE(trash.dispose(std::move(pooled)));
+  REQUIRE(!watcher.expired());
+
+  // a unique_ptr to anything.
+  auto counted = std::make_unique<Counted>();
+  REQUIRE(trash.dispose(std::move(counted)));
+  REQUIRE(gLive == 1);
+
+  // a full queue gives the object back.
+  auto extra = std::make_unique<Counted>();
+  REQUIRE(!trash.dispose(std::move(extra)));
+  REQUIRE(extra);
+  REQUIRE(trash.getOverflowCount() == 1);
+
+  REQUIRE(trash.emptyTrash() == 4);
+  REQUIRE(watcher.expired());
+  REQUIRE(gLive == 1);
+  extra.reset();
+
+  // any number of threads can dispose while the housekeeping thread empties the trash.
+  {
+    TrashQueue shared(256);
+    shared.start(1);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+      threads.emplace_back(
+          [&]()
+          {
+            for (int i = 0; i < 1000; ++i)
+            {
+              auto p = std::make_unique<Counted>();
+              while (!shared.dispose(std::move(p)))
+              {
+                std::this_thread::yield();
+              }
+            }
+          });
+    }
+    for (auto& t : threads)
+    {
+      t.join();
+    }
+  }
+  REQUIRE(gLive == 0);
+}
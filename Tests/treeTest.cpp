@@ -365,6 +365,400 @@ TEST_CASE("madronalib/core/tree", "[tree]")
   REQUIRE(floatTree["pink"] == 1.f);
 }
 
+TEST_CASE("madronalib/core/tree/frozen", "[tree]")
+{
+  Tree<int> tree;
+  auto words = ml::textUtils::makeVectorOfNonsenseSymbols(20);
+  std::vector<Path> paths;
+  for (int i = 0; i < 400; ++i)
+  {
+    Path p{runtimePath(words[i % 7].getUTF8Ptr()), runtimePath(words[(i / 7) % 11].getUTF8Ptr()),
+           runtimePath(words[i % 20].getUTF8Ptr())};
+    tree[p] = i + 1;
+    paths.push_back(p);
+  }
+
+  FrozenTree<int> frozen(tree);
+  REQUIRE(frozen.size() == tree.size());
+
+  bool problem = false;
+  for (const auto& p : paths)
+  {
+    if (frozen[p] != tree[p]) problem = true;
+  }
+  REQUIRE(!problem);
+
+  // intermediate nodes exist, but have no values.
+  Path parent = butLast(paths[0]);
+  REQUIRE(frozen.hasNode(parent));
+  REQUIRE(frozen[parent] == 0);
+  REQUIRE(!frozen.hasNode(Path{"not/in/tree"}));
+  REQUIRE(frozen[Path{"not/in/tree"}] == 0);
+
+  // compile-time paths
+  Tree<float> params;
+  params["osc/freq"] = 440.f;
+  params["osc/level"] = 0.5f;
+  FrozenTree<float> frozenParams(params);
+  REQUIRE(frozenParams.getValueFromHash(HashPath("osc/freq")) == 440.f);
+  REQUIRE(frozenParams.getValueFromHash(HashPath("osc/level")) == 0.5f);
+  REQUIRE(frozenParams.getValueFromHash(HashPath("osc/nothing")) == 0.f);
+  REQUIRE(frozenParams.getNumNodes() == 4);
+
+  // other key types
+  TextTree<int> textTree;
+  textTree[TextPath("a/b")] = 1;
+  textTree[TextPath("a/c")] = 2;
+  FrozenTree<int, TextFragment, textUtils::Collator> frozenText(textTree);
+  REQUIRE(frozenText[TextPath("a/c")] == 2);
+  REQUIRE(frozenText[TextPath("a/d")] == 0);
+
+  FrozenTree<int> empty;
+  REQUIRE(empty[paths[0]] == 0);
+}
+
+TEST_CASE("madronalib/core/tree/numeric", "[tree]")
+{
+  Tree<Value> tree;
+  for (int t = 0; t < 8; ++t)
+  {
+    for (int s = 0; s < 64; ++s)
+    {
+      std::string step = "seq/track" + std::to_string(t) + "/step" + std::to_string(s);
+      Path p = runtimePath(step.c_str());
+      tree[Path(p, "pitch")] = t * 64 + s;
+      tree[Path(p, "level")] = s / 64.f;
+    }
+  }
+  tree["name"] = "sequence";
+  NumericTree<> numeric(tree);
+  REQUIRE(numeric.size() == tree.size() - 1);
+  REQUIRE(numeric.getNumSkipped() == 1);
+
+  // found by path, then read and written by index.
+  uint32_t i = numeric.findIndex(Path("seq/track3/step10/pitch"));
+  REQUIRE(i != NumericTree<>::kNoIndex);
+  REQUIRE(numeric.isInt(i));
+  REQUIRE(numeric.getInt(i) == 3 * 64 + 10);
+  REQUIRE(numeric[Path("seq/track3/step10/level")] == Value(10 / 64.f));
+  numeric.setFloat(i, 2.5f);
+  REQUIRE(numeric[Path("seq/track3/step10/pitch")] == Value(2.5f));
+  REQUIRE(numeric.getInt(i) == 2);
+  numeric.setInt(i, 3 * 64 + 10);
+
+  // intermediate nodes exist, but have no values.
+  REQUIRE(numeric.findIndex(Path("seq/track3")) != NumericTree<>::kNoIndex);
+  REQUIRE(!numeric.hasValue(numeric.findIndex(Path("seq/track3"))));
+  REQUIRE(numeric.findIndex(Path("seq/track9")) == NumericTree<>::kNoIndex);
+  REQUIRE(numeric[Path("seq/track9")] == Value());
+  REQUIRE(!numeric.setFloat(Path("seq/track9"), 1.f));
+
+  // back to a Tree with the same numbers.
+  Tree<Value> numbers = tree;
+  numbers["name"] = Value();
+  Tree<Value> back = numeric.toTree();
+  REQUIRE(back.size() == numeric.size());
+  bool same{true};
+  for (auto it = numbers.begin(); it != numbers.end(); ++it)
+  {
+    same &= (back[it.getCurrentPath()] == *it);
+  }
+  REQUIRE(same);
+  REQUIRE(NumericTree<>(numbers) == numeric);
+
+  // a small fraction of the memory.
+  REQUIRE(numeric.getMemoryBytes() * 5 < tree.getMemoryBytes());
+
+  // trees of bare numbers
+  Tree<float> floats;
+  floats["a/b"] = 1.f;
+  NumericTree<> fromFloats(floats);
+  REQUIRE(fromFloats.getFloat(fromFloats.findIndex(Path("a/b"))) == 1.f);
+  REQUIRE(NumericTree<>().findIndex(Path("a")) == NumericTree<>::kNoIndex);
+}
+
+TEST_CASE("madronalib/core/tree/persistent", "[tree]")
+{
+  Tree<int> tree;
+  tree["a/b/c"] = 1;
+  tree["a/b/d"] = 2;
+  tree["e/f"] = 3;
+  PersistentTree<int> v1(tree);
+  REQUIRE(v1.size() == 3);
+  REQUIRE(v1[Path("a/b/d")] == 2);
+  REQUIRE(v1.hasNode(Path("a/b")));
+  REQUIRE(v1[Path("a/b")] == 0);
+  REQUIRE(v1.toTree() == tree);
+
+  // a change copies the nodes on its path, and shares the rest.
+  PersistentTree<int> v2 = v1.set(Path("a/b/c"), 10);
+  REQUIRE(v1[Path("a/b/c")] == 1);
+  REQUIRE(v2[Path("a/b/c")] == 10);
+  REQUIRE(v2.size() == 3);
+  REQUIRE(v2.getNode(Path("e")) == v1.getNode(Path("e")));
+  REQUIRE(v2.getNode(Path("a/b/d")) == v1.getNode(Path("a/b/d")));
+  REQUIRE(v2.getNode(Path("a/b")) != v1.getNode(Path("a/b")));
+  REQUIRE(v1 != v2);
+
+  // new nodes keep their siblings sorted.
+  PersistentTree<int> v3 = v2.set(Path("a/a"), 4).set(Path("a/z/y"), 5);
+  REQUIRE(v3.size() == 5);
+  std::vector<Path> visited;
+  v3.visitValues([&](const Path& p, int) { visited.push_back(p); });
+  Tree<int> expected = v2.toTree();
+  expected["a/a"] = 4;
+  expected["a/z/y"] = 5;
+  REQUIRE(v3.toTree() == expected);
+  REQUIRE(visited.size() == 5);
+
+  // copies are the same version. Setting a value back makes an equal, different version.
+  PersistentTree<int> copy = v3;
+  REQUIRE(copy.isSameVersion(v3));
+  PersistentTree<int> v4 = v3.set(Path("a/a"), 0);
+  REQUIRE(v4.size() == 4);
+  REQUIRE(v4.set(Path("a/a"), 4) == v3);
+  REQUIRE(!v4.set(Path("a/a"), 4).isSameVersion(v3));
+
+  // readers keep their versions alive.
+  PersistentTree<int> reader;
+  {
+    PersistentTree<int> temp = v1.set(Path("g"), 6);
+    reader = temp;
+  }
+  REQUIRE(reader[Path("g")] == 6);
+  PersistentTree<int> empty;
+  REQUIRE(empty[Path("a")] == 0);
+  REQUIRE(empty.set(Path("a"), 1)[Path("a")] == 1);
+
+  // other key types
+  PersistentTree<int, TextFragment, textUtils::Collator> text;
+  text = text.set(TextPath("b/c"), 2).set(TextPath("a"), 1);
+  REQUIRE(text[TextPath("b/c")] == 2);
+  REQUIRE(text.size() == 2);
+}
+
+TEST_CASE("madronalib/core/tree/flat", "[tree]")
+{
+  using FlatTree = Tree<int, Symbol, std::less<Symbol>, TreeFlatStorage>;
+  Tree<int> mapTree;
+  FlatTree flatTree;
+  auto words = ml::textUtils::makeVectorOfNonsenseSymbols(20);
+  std::vector<Path> paths;
+  for (int i = 0; i < 400; ++i)
+  {
+    Path p{runtimePath(words[(i * 7) % 20].getUTF8Ptr()), runtimePath(words[i % 13].getUTF8Ptr()),
+           runtimePath(words[(i / 3) % 17].getUTF8Ptr())};
+    mapTree[p] = i + 1;
+    flatTree[p] = i + 1;
+    paths.push_back(p);
+  }
+  REQUIRE(flatTree.size() == mapTree.size());
+
+  // same values, visited in the same order.
+  bool problem = false;
+  auto itA = mapTree.begin();
+  auto itB = flatTree.begin();
+  for (; (itA != mapTree.end()) && (itB != flatTree.end()); ++itA, ++itB)
+  {
+    if (itA.getCurrentPath() != itB.getCurrentPath()) problem = true;
+    if (*itA != *itB) problem = true;
+  }
+  REQUIRE(!problem);
+  REQUIRE(itA == mapTree.end());
+  REQUIRE(itB == flatTree.end());
+
+  // visitValues() goes in the same order as iteration.
+  std::vector<Path> visited;
+  mapTree.visitValues([&](const Path& p, int) { visited.push_back(p); });
+  REQUIRE(visited.size() == mapTree.size());
+  size_t i = 0;
+  for (auto it = mapTree.begin(); it != mapTree.end(); ++it)
+  {
+    if (it.getCurrentPath() != visited[i++]) problem = true;
+  }
+  REQUIRE(!problem);
+
+  for (const auto& p : paths)
+  {
+    if (flatTree[p] != mapTree[p]) problem = true;
+  }
+  REQUIRE(!problem);
+
+  // the rest of the Tree API
+  const FlatTree& constTree(flatTree);
+  REQUIRE(constTree[Path{"not/in/tree"}] == 0);
+  REQUIRE(constTree.getValueFromHash(HashPath("nothing/here")) == 0);
+  REQUIRE(constTree.getNode(butLast(paths[0])) != nullptr);
+
+  FlatTree copy = flatTree;
+  REQUIRE(copy == flatTree);
+  copy[paths[5]] = -1;
+  REQUIRE(copy != flatTree);
+
+  FrozenTree<int> frozen(flatTree);
+  REQUIRE(frozen[paths[7]] == flatTree[paths[7]]);
+
+  flatTree.clear();
+  REQUIRE(flatTree.size() == 0);
+  REQUIRE(flatTree.begin() == flatTree.end());
+}
+
+TEST_CASE("madronalib/core/tree/hashindex", "[tree]")
+{
+  auto words = ml::textUtils::makeVectorOfNonsenseSymbols(20);
+  auto test = [&](auto& tree) {
+    // some runtime paths around the ones looked up.
+    for (int i = 0; i < 200; ++i)
+    {
+      tree[Path{runtimePath(words[i % 20].getUTF8Ptr()), runtimePath(words[i % 7].getUTF8Ptr())}] =
+          i + 1;
+    }
+    tree["osc1/freq"] = 440.f;
+    tree["osc1/level"] = 0.5f;
+    tree.enableHashIndex();
+    REQUIRE(tree.hasHashIndex());
+    REQUIRE(tree.getValueFromHash(HashPath("osc1/freq")) == 440.f);
+    REQUIRE(tree.getValueFromHash(HashPath("osc1/level")) == 0.5f);
+    REQUIRE(tree.getValueFromHash(HashPath("osc1")) == 0.f);
+    REQUIRE(tree.getValueFromHash(HashPath("osc1/nothing")) == 0.f);
+    REQUIRE(tree.getValueFromHash(HashPath("osc1/freq/deeper")) == 0.f);
+
+    // adding and changing values after the index is made.
+    tree["osc2/freq"] = 220.f;
+    tree.add(Path{"osc1/level"}, 0.25f);
+    tree["osc1"] = 1.f;
+    REQUIRE(tree.getValueFromHash(HashPath("osc2/freq")) == 220.f);
+    REQUIRE(tree.getValueFromHash(HashPath("osc1/level")) == 0.25f);
+    REQUIRE(tree.getValueFromHash(HashPath("osc1")) == 1.f);
+    REQUIRE(tree.getValueFromHash(HashPath("osc1/freq")) == 440.f);
+
+    // nodes added through subtrees are found by walking.
+    tree.getMutableNode(Path{"osc2"})->add(Path{"pan"}, -1.f);
+    REQUIRE(tree.getValueFromHash(HashPath("osc2/pan")) == -1.f);
+
+    // copies have their own index.
+    auto copy = tree;
+    REQUIRE(copy.hasHashIndex());
+    copy["osc2/freq"] = 110.f;
+    REQUIRE(copy.getValueFromHash(HashPath("osc2/freq")) == 110.f);
+    REQUIRE(tree.getValueFromHash(HashPath("osc2/freq")) == 220.f);
+
+    tree.clear();
+    REQUIRE(tree.getValueFromHash(HashPath("osc1/freq")) == 0.f);
+    tree["osc1/freq"] = 880.f;
+    REQUIRE(tree.getValueFromHash(HashPath("osc1/freq")) == 880.f);
+
+    tree.disableHashIndex();
+    REQUIRE(!tree.hasHashIndex());
+    REQUIRE(tree.getValueFromHash(HashPath("osc1/freq")) == 880.f);
+  };
+
+  Tree<float> mapTree;
+  test(mapTree);
+  Tree<float, Symbol, std::less<Symbol>, TreeFlatStorage> flatTree;
+  test(flatTree);
+}
+
+TEST_CASE("madronalib/core/tree/combine", "[tree]")
+{
+  auto words = ml::textUtils::makeVectorOfNonsenseSymbols(20);
+  auto word = [&](int i) { return runtimePath(words[i].getUTF8Ptr()); };
+  auto test = [&](auto defaults, auto overlay) {
+    for (int i = 0; i < 300; ++i)
+    {
+      defaults[Path{word(i % 20), word(i % 11)}] = i + 1;
+    }
+    for (int i = 0; i < 100; ++i)
+    {
+      overlay[Path{word((i * 3) % 20), word(i % 13), word(i % 5)}] = -i - 1;
+      overlay[Path{word(i % 20), word(i % 11)}] = 1000 + i;
+    }
+
+    defaults["osc1/freq"] = 1;
+    overlay["osc1/freq"] = 2;
+    overlay["osc9/new/deep"] = 3;
+
+    // a node with no value below, which is not copied.
+    overlay["empty/leaf"] = 0;
+
+    // the same as adding each value of the overlay in turn.
+    auto expected = defaults;
+    for (auto it = overlay.begin(); it != overlay.end(); ++it)
+    {
+      expected.add(it.getCurrentPath(), *it);
+    }
+    auto combined = defaults;
+    combined.enableHashIndex();
+    combined.combine(overlay);
+    REQUIRE(combined == expected);
+    REQUIRE(combined.size() == expected.size());
+    REQUIRE(combined.getNode(Path{"empty"}) == nullptr);
+
+    // the index finds the new and changed values.
+    REQUIRE(combined.getValueFromHash(HashPath("osc1/freq")) == 2);
+    REQUIRE(combined.getValueFromHash(HashPath("osc9/new/deep")) == 3);
+
+    // combining with itself changes nothing.
+    combined.combine(combined);
+    REQUIRE(combined == expected);
+  };
+
+  test(Tree<int>(), Tree<int>());
+  using FlatTree = Tree<int, Symbol, std::less<Symbol>, TreeFlatStorage>;
+  test(FlatTree(), FlatTree());
+}
+
+TEST_CASE("madronalib/core/tree/walk", "[tree]")
+{
+  Tree<int> tree;
+  tree["a/b"] = 1;
+  tree["a/c/d"] = 2;
+  tree["e"] = 3;
+  tree["f/g/h/i/j/k/l"] = 4;
+  Path longest("m/n/o/p/q/r/s/t/u/v/w/x/y/z/zz");
+  REQUIRE(longest.getSize() == kPathMaxSymbols);
+  tree[longest] = 5;
+
+  // the path kept by the iterator is the path of each value.
+  std::vector<Path> paths;
+  for (auto it = tree.begin(); it != tree.end(); ++it)
+  {
+    const Path& p = it.getCurrentPath();
+    if (tree[p] != *it) paths.clear();
+    paths.push_back(p);
+  }
+  REQUIRE(paths.size() == 5);
+  std::vector<Path> visited;
+  tree.visitValues([&](const Path& p, int) { visited.push_back(p); });
+  REQUIRE(paths == visited);
+
+  // enter and leave are called for every node in turn, with or without values, with the path
+  // to the node.
+  std::vector<Path> stack;
+  std::vector<Path> walked;
+  size_t nodes{0}, maxDepth{0};
+  bool problem{false};
+  tree.walk(
+      [&](const Path& p, const Tree<int>& node)
+      {
+        if (butLast(p) != (stack.empty() ? Path() : stack.back())) problem = true;
+        if (node.hasValue()) walked.push_back(p);
+        stack.push_back(p);
+        maxDepth = std::max(maxDepth, stack.size());
+        nodes++;
+      },
+      [&](const Path& p, const Tree<int>&)
+      {
+        if (p != stack.back()) problem = true;
+        stack.pop_back();
+      });
+  REQUIRE(!problem);
+  REQUIRE(stack.empty());
+  REQUIRE(nodes == 4 + 1 + 7 + 15);
+  REQUIRE(maxDepth == size_t(kPathMaxSymbols));
+  REQUIRE(walked == paths);
+}
+
 TEST_CASE("madronalib/core/textutils", "[textutils]")
 {
   NoiseGen n;
@@ -4,6 +4,8 @@
 
 // a unit test made using the Catch framework in catch.hpp / tests.cpp.
 
+#include <thread>
+
 #include "catch.hpp"
 #include "madronalib.h"
 
@@ -52,6 +54,10 @@ TEST_CASE("madronalib/core/values/core", "[values]")
   
   Value floatArrayVal {27.5, 55., 110., 220., 440., 880., 1760.};
   REQUIRE(floatArrayVal.getType() == Value::kFloatArray);
+
+  Value floatPtrVal(smallVec.data(), smallVec.size());
+  REQUIRE(floatPtrVal == v1);
+  REQUIRE(floatPtrVal.isStoredLocally());
   
   // order of types
   Value t1;
@@ -313,6 +319,94 @@ TEST_CASE("madronalib/core/values/edge_cases", "[values]")
   }
 }
 
+TEST_CASE("madronalib/core/values/shared", "[values]")
+{
+  std::vector<float> big(256, 1.5f);
+
+  SECTION("copies share large data")
+  {
+    Value a(big);
+    REQUIRE(!a.isShared());
+    Value b(a);
+    REQUIRE(a.isShared());
+    REQUIRE(b.isShared());
+    REQUIRE(a.data() == b.data());
+    REQUIRE(a == b);
+
+    Value c;
+    c = a;
+    REQUIRE(c.data() == a.data());
+    b = Value(3);
+    c = Value(4);
+    REQUIRE(!a.isShared());
+  }
+
+  SECTION("small data is not shared")
+  {
+    Value a({1.f, 2.f});
+    Value b(a);
+    REQUIRE(!a.isShared());
+    REQUIRE(a.data() != b.data());
+  }
+
+  SECTION("writing copies shared data")
+  {
+    Value a(big);
+    Value b(a);
+    b.getFloatArrayPtr()[0] = 9.f;
+    REQUIRE(a.data() != b.data());
+    REQUIRE(!a.isShared());
+    REQUIRE(a.getFloatVector() == big);
+    REQUIRE(b.getFloatArrayPtr()[0] == 9.f);
+
+    // reading through a const Value doesn't copy.
+    Value c(a);
+    const Value& cc = c;
+    REQUIRE(cc.getFloatArrayPtr()[0] == 1.5f);
+    REQUIRE(c.data() == a.data());
+  }
+
+  SECTION("assigning to unshared data of the same size copies in place")
+  {
+    Value a(big);
+    const uint8_t* p = a.data();
+    Value b(std::vector<float>(256, 2.f));
+    a = b;
+    REQUIRE(a.data() == p);
+    REQUIRE(!b.isShared());
+    REQUIRE(a == b);
+  }
+
+  SECTION("assigning to shared data does not change the other copies")
+  {
+    Value a(big);
+    Value b(a);
+    b = Value(std::vector<float>(256, 2.f));
+    REQUIRE(a.getFloatVector() == big);
+    REQUIRE(b.getFloatArrayPtr()[0] == 2.f);
+  }
+
+  SECTION("copies on many threads")
+  {
+    Value a(big);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+      threads.emplace_back([&a]() {
+        for (int i = 0; i < 10000; ++i)
+        {
+          Value b(a);
+          Value c;
+          c = b;
+        }
+      });
+    }
+    for (auto& t : threads) t.join();
+    REQUIRE(!a.isShared());
+    REQUIRE(a.getFloatVector()[255] == 1.5f);
+  }
+}
+
 TEST_CASE("madronalib/core/values/with_values", "[values]")
 {
   SECTION("type conversions")
@@ -0,0 +1,627 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// a unit test made using the Catch framework in catch.hpp / tests.cpp.
+
+#include <thread>
+
+#include "catch.hpp"
+#include "MLProcessorGraph.h"
+#include "MLSharedWorkerService.h"
+#include "MLSignalBuses.h"
+#include "MLSynth.h"
+#include "MLThreadTopology.h"
+#include "MLWorkerPool.h"
+
+using namespace ml;
+
+namespace workerPoolTest
+{
+void countTask(void* context, size_t task)
+{
+  auto* counts = static_cast<std::vector<std::atomic<int> >*>(context);
+  (*counts)[task].fetch_add(1);
+}
+
+struct FlushCheck
+{
+  std::thread::id caller;
+  std::atomic<bool> ok{true};
+};
+
+// tasks run by the workers should see denormals flushed to zero.
+void flushCheckTask(void* context, size_t)
+{
+  auto* check = static_cast<FlushCheck*>(context);
+  if (std::this_thread::get_id() != check->caller)
+  {
+    check->ok = check->ok && isFlushingDenormalsToZero();
+  }
+}
+
+TEST_CASE("madronalib/core/worker_pool", "[worker_pool][threads]")
+{
+  constexpr size_t kTasks{37};
+  WorkerPool pool(3);
+  REQUIRE(pool.getNumWorkers() == 3);
+
+  // every task should run exactly once per job.
+  std::vector<std::atomic<int> > counts(kTasks);
+  constexpr int kJobs{1000};
+  for (int j = 0; j < kJobs; ++j)
+  {
+    pool.run(kTasks, countTask, &counts);
+  }
+  bool allRanOnce{true};
+  for (auto& c : counts)
+  {
+    allRanOnce &= (c.load() == kJobs);
+  }
+  REQUIRE(allRanOnce);
+
+  // a deadline already past is reported, but the job still completes.
+  for (auto& c : counts) c = 0;
+  REQUIRE(!pool.run(kTasks, countTask, &counts, WorkerPool::Clock::now()));
+  REQUIRE(counts[kTasks - 1].load() == 1);
+
+  if (kFlushDenormalsBits && kFlushDenormalsAutomatically)
+  {
+    FlushCheck check;
+    check.caller = std::this_thread::get_id();
+    for (int j = 0; j < 100; ++j)
+    {
+      pool.run(kTasks, flushCheckTask, &check);
+    }
+    REQUIRE(check.ok);
+  }
+}
+
+// each voice adds a sine at its own frequency to both outputs.
+class TestSynth : public Synth
+{
+ public:
+  TestSynth() : Synth(16) {}
+
+  void processVoice(int v, const EventsToSignals::Voice&, const DSPVectorDynamic&,
+                    DSPVectorDynamic& outputs, AudioContext*) override
+  {
+    DSPVector y = sines_[v](DSPVector(0.001f * (v + 1)));
+    outputs[0] += y;
+    outputs[1] += y * DSPVector(0.5f);
+  }
+
+ private:
+  std::array<SineGen, 16> sines_;
+};
+
+TEST_CASE("madronalib/core/worker_pool/synth", "[worker_pool][threads]")
+{
+  AudioContext ctx(0, 2, 48000);
+  DSPVectorDynamic inputs, serialOut(2), parallelOut(2);
+  TestSynth serialSynth, parallelSynth;
+  parallelSynth.setVoiceThreads(3);
+  REQUIRE(parallelSynth.getVoiceThreads() == 3);
+
+  // parallel rendering should match serial rendering exactly.
+  bool match{true};
+  for (int i = 0; i < 100; ++i)
+  {
+    serialSynth.processVector(inputs, serialOut, &ctx);
+    parallelSynth.processVector(inputs, parallelOut, &ctx);
+    match &= (serialOut[0] == parallelOut[0]) && (serialOut[1] == parallelOut[1]);
+  }
+  REQUIRE(match);
+  REQUIRE(parallelSynth.getActiveVoiceCount() == 16);
+
+  // both synths record the cost of each voice in the context.
+  for (size_t v = 0; v < 16; ++v)
+  {
+    REQUIRE(ctx.loadMeter.getVoiceLoad(v) > 0.f);
+  }
+  REQUIRE(ctx.loadMeter.getVoiceLoad(16) == 0.f);
+}
+
+// processors for graph tests
+class AddProcessor : public SignalProcessor
+{
+ public:
+  AddProcessor(float gain, float offset) : gain_(gain), offset_(offset) {}
+  void processVector(const DSPVectorDynamic& inputs, DSPVectorDynamic& outputs,
+                     void*) override
+  {
+    for (int c = 0; c < outputs.size(); ++c)
+    {
+      outputs[c] = inputs[c] * DSPVector(gain_) + DSPVector(offset_);
+    }
+    runs++;
+  }
+  std::atomic<int> runs{0};
+
+ private:
+  float gain_, offset_;
+};
+
+TEST_CASE("madronalib/core/worker_pool/processor_graph", "[worker_pool][threads]")
+{
+  for (size_t threads : {0, 3})
+  {
+    ProcessorGraph g(threads);
+    REQUIRE(g.getNumThreads() == threads);
+    auto in = g.addBus(2);
+    auto b1 = g.addBus(2);
+    auto b2 = g.addBus(2);
+
+    // a two-stage chain: (x * 2) + 1
+    AddProcessor times2(2.f, 0.f), plus1(1.f, 1.f);
+    g.addProcessor(&plus1, b1, b2);
+    g.addProcessor(&times2, in, b1);
+
+    // an integrator, counting vectors through a feedback bus.
+    auto count = g.addBus(2);
+    auto countFeedback = g.addFeedbackBus(count);
+    AddProcessor counter(1.f, 1.f);
+    g.addProcessor(&counter, countFeedback, count);
+
+    // many independent branches.
+    std::vector<std::unique_ptr<AddProcessor>> branches;
+    std::vector<ProcessorGraph::BusID> branchBuses;
+    for (int i = 0; i < 40; ++i)
+    {
+      branches.push_back(std::make_unique<AddProcessor>(float(i), 0.f));
+      branchBuses.push_back(g.addBus(2));
+      g.addProcessor(branches.back().get(), in, branchBuses.back());
+    }
+
+    REQUIRE(g.compile());
+    REQUIRE(g.getOrder().size() == 43);
+
+    g.getBus(in)[0] = DSPVector(3.f);
+    g.getBus(in)[1] = DSPVector(-1.f);
+    constexpr int kVectors{200};
+    for (int v = 0; v < kVectors; ++v)
+    {
+      g.process();
+    }
+    REQUIRE(g.getBus(b2)[0] == DSPVector(7.f));
+    REQUIRE(g.getBus(b2)[1] == DSPVector(-1.f));
+    REQUIRE(g.getBus(count)[0] == DSPVector(float(kVectors)));
+    REQUIRE(g.getBus(branchBuses[39])[0] == DSPVector(3.f * 39));
+    bool allRanOnce{true};
+    for (auto& b : branches)
+    {
+      allRanOnce &= (b->runs == kVectors);
+    }
+    REQUIRE(allRanOnce);
+  }
+
+  // cycles without a feedback bus are rejected.
+  ProcessorGraph g;
+  auto b1 = g.addBus(1);
+  auto b2 = g.addBus(1);
+  AddProcessor p1(1.f, 0.f), p2(1.f, 0.f);
+  g.addProcessor(&p1, b1, b2);
+  g.addProcessor(&p2, b2, b1);
+  REQUIRE(!g.compile());
+
+  // so are two writers to one bus.
+  ProcessorGraph g2;
+  auto c1 = g2.addBus(1);
+  auto c2 = g2.addBus(1);
+  g2.addProcessor(&p1, c1, c2);
+  g2.addProcessor(&p2, c1, c2);
+  REQUIRE(!g2.compile());
+}
+
+// a host pool that runs each job on the calling thread, as a host may when its threads are
+// busy, or refuses it. Starting threads for each job would miss the Synth's deadline with
+// small vectors and send it into its serial fallback.
+struct FakeHostPool
+{
+  bool accept{true};
+  int jobs{0};
+
+  static bool run(void* poolContext, size_t nTasks, WorkerPool::TaskFn fn, void* taskContext)
+  {
+    auto* pool = static_cast<FakeHostPool*>(poolContext);
+    if (!pool->accept) return false;
+    pool->jobs++;
+    for (size_t i = 0; i < nTasks; ++i)
+    {
+      fn(taskContext, i);
+    }
+    return true;
+  }
+  HostTaskPool get() { return HostTaskPool{run, this, 4}; }
+};
+
+TEST_CASE("madronalib/core/worker_pool/host_pool", "[worker_pool][threads]")
+{
+  FakeHostPool host;
+  AudioContext ctx(0, 2, 48000);
+  DSPVectorDynamic inputs, serialOut(2), hostOut(2);
+  TestSynth serialSynth, hostSynth;
+  hostSynth.setHostTaskPool(host.get());
+  REQUIRE(hostSynth.hasHostTaskPool());
+
+  // voices rendered by the host match serial rendering, and a
+  // refused job is rendered on the audio thread.
+  bool match{true};
+  for (int i = 0; i < 20; ++i)
+  {
+    host.accept = (i < 10);
+    serialSynth.processVector(inputs, serialOut, &ctx);
+    hostSynth.processVector(inputs, hostOut, &ctx);
+    match &= (serialOut[0] == hostOut[0]) && (serialOut[1] == hostOut[1]);
+  }
+  REQUIRE(match);
+  REQUIRE(host.jobs == 10);
+
+  // a graph runs on the host pool, with its own threads or serially as fallbacks.
+  for (size_t threads : {0, 2})
+  {
+    ProcessorGraph g(threads);
+    g.setHostTaskPool(host.get());
+    auto in = g.addBus(1);
+    auto b1 = g.addBus(1);
+    auto b2 = g.addBus(1);
+    AddProcessor times2(2.f, 0.f), plus1(1.f, 1.f);
+    g.addProcessor(&times2, in, b1);
+    g.addProcessor(&plus1, b1, b2);
+    REQUIRE(g.compile());
+    g.getBus(in)[0] = DSPVector(3.f);
+
+    host.jobs = 0;
+    for (int v = 0; v < 10; ++v)
+    {
+      host.accept = (v & 1);
+      g.getBus(b2)[0] = DSPVector(0.f);
+      g.process();
+      REQUIRE(g.getBus(b2)[0] == DSPVector(7.f));
+    }
+    REQUIRE(host.jobs == 5);
+    REQUIRE(plus1.runs == 10);
+  }
+}
+
+// delays its input, and declares the delay as its latency.
+class DelayProcessor : public SignalProcessor
+{
+ public:
+  explicit DelayProcessor(size_t samples)
+  {
+    delay_.setMaxDelayInSamples(64.f);
+    setDelay(samples);
+  }
+  void setDelay(size_t samples)
+  {
+    delay_.setDelayInSamples(int(samples));
+    setLatencyInSamples(samples);
+  }
+  void processVector(const DSPVectorDynamic& inputs, DSPVectorDynamic& outputs,
+                     void*) override
+  {
+    outputs[0] = delay_(inputs[0]);
+  }
+
+ private:
+  IntegerDelay delay_;
+};
+
+TEST_CASE("madronalib/core/worker_pool/latency", "[worker_pool][threads]")
+{
+  for (size_t threads : {0, 2})
+  {
+    ProcessorGraph g(threads);
+    auto in = g.addBus(1);
+    auto mid = g.addBus(1);
+    auto slow = g.addBus(1);
+    auto fast = g.addBus(1);
+
+    // two delays in series on one branch, a plain copy on the other.
+    DelayProcessor d1(4), d2(6);
+    AddProcessor copy(1.f, 0.f);
+    g.addProcessor(&d1, in, mid);
+    g.addProcessor(&d2, mid, slow);
+    g.addProcessor(&copy, in, fast);
+    g.alignBuses({slow, fast});
+    REQUIRE(g.compile());
+    REQUIRE(g.getBusLatency(slow) == 10);
+    REQUIRE(g.getBusLatency(fast) == 0);
+    REQUIRE(g.getCompensation(slow) == 0);
+    REQUIRE(g.getCompensation(fast) == 10);
+
+    // an impulse arrives on both branches at once.
+    g.getBus(in)[0] = DSPVector(0.f);
+    g.getBus(in)[0][0] = 1.f;
+    g.process();
+    REQUIRE(g.getBus(slow)[0][10] == 1.f);
+    REQUIRE(g.getBus(fast)[0][10] == 1.f);
+    REQUIRE(g.getBus(fast)[0][0] == 0.f);
+
+    // a change in latency is picked up by the next process().
+    d2.setDelay(16);
+    g.getBus(in)[0] = DSPVector(0.f);
+    g.process();
+    REQUIRE(g.getBusLatency(slow) == 20);
+    REQUIRE(g.getCompensation(fast) == 20);
+  }
+}
+
+// a topology of nPackages packages, each with coresPerPackage physical cores of two SMT
+// threads sharing one L3, with L2 shared by pairs of cores. The SMT siblings are numbered after
+// all the first threads, as on Linux.
+CPUTopology makeTestTopology(int nPackages, int coresPerPackage)
+{
+  CPUTopology t;
+  const int nCores = nPackages * coresPerPackage;
+  for (int id = 0; id < nCores * 2; ++id)
+  {
+    CPUCore c;
+    c.id = id;
+    const int core = id % nCores;
+    c.package = core / coresPerPackage;
+    c.physicalCore = core;
+    c.l2Domain = core / 2 * 2;
+    c.l3Domain = c.package * coresPerPackage;
+    t.cores.push_back(c);
+  }
+  return t;
+}
+
+TEST_CASE("madronalib/core/worker_pool/topology", "[worker_pool][threads]")
+{
+  REQUIRE(parseCPUList("0-3,8,10-11") == std::vector<int>{0, 1, 2, 3, 8, 10, 11});
+  REQUIRE(parseCPUList("").empty());
+
+  // two sockets: real-time threads stay on one socket, one per physical core, avoiding core 0.
+  CPUTopology servers = makeTestTopology(2, 8);
+  REQUIRE(servers.getNumPhysicalCores() == 16);
+  REQUIRE(servers.getNumPackages() == 2);
+  ThreadPlacement p = planThreadPlacement(servers, 6);
+  REQUIRE(p.audioCore == 1);
+  REQUIRE(p.workerCores == std::vector<int>{2, 3, 4, 5, 6, 7});
+
+  // with too many workers for one socket, the other is used, then core 0.
+  p = planThreadPlacement(servers, 15);
+  REQUIRE(p.workerCores.size() == 15);
+  REQUIRE(p.workerCores[6] == 8);
+  REQUIRE(p.workerCores.back() == 0);
+
+  // control threads get the cores not used by real-time threads or their siblings.
+  p = planThreadPlacement(servers, 3);
+  for (int id : p.controlCores)
+  {
+    REQUIRE(id != p.audioCore);
+    REQUIRE(std::find(p.workerCores.begin(), p.workerCores.end(), id) == p.workerCores.end());
+    REQUIRE(id != p.audioCore + 16);
+  }
+  REQUIRE(p.controlCores.size() == 32 - 8);
+
+  // hybrid: real-time threads go on performance cores only, control threads on the rest.
+  CPUTopology hybrid = makeTestTopology(1, 8);
+  for (auto& c : hybrid.cores)
+  {
+    c.efficiency = (c.physicalCore >= 4);
+  }
+  REQUIRE(hybrid.isHybrid());
+  p = planThreadPlacement(hybrid, 7);
+  REQUIRE(p.audioCore == 1);
+  REQUIRE(p.workerCores == std::vector<int>{2, 3, 0});
+  REQUIRE(p.controlCores == std::vector<int>{4, 5, 6, 7, 12, 13, 14, 15});
+
+  // one core: nothing to spare, so control threads share it.
+  CPUTopology one;
+  one.cores.push_back(CPUCore{});
+  p = planThreadPlacement(one, 2);
+  REQUIRE(p.audioCore == 0);
+  REQUIRE(p.workerCores.empty());
+  REQUIRE(p.controlCores == std::vector<int>{0});
+
+  // this machine
+  CPUTopology local = getCPUTopology();
+  REQUIRE(!local.cores.empty());
+  REQUIRE(local.getNumNodes() >= 1);
+  REQUIRE(local.getNode(local.cores.front().id) >= 0);
+  REQUIRE(local.getNode(-1) == -1);
+  p = planThreadPlacement(local, 1);
+  REQUIRE(p.audioCore >= 0);
+  REQUIRE(!p.controlCores.empty());
+}
+
+TEST_CASE("madronalib/core/worker_pool/signal_buses", "[worker_pool]")
+{
+  // an oscillator, a filter reading it and a mixer reading both.
+  enum Clients
+  {
+    kOsc,
+    kFilter,
+    kMixer
+  };
+  SignalBuses buses;
+  buses.addInput("in", 1);
+  auto oscIn = buses.declareInput(kOsc, "in", 1);
+  auto oscOut = buses.declareOutput(kOsc, "osc/out", 2);
+  auto filterIn = buses.declareInput(kFilter, "osc/out", 2);
+  auto filterOut = buses.declareOutput(kFilter, "filter/out", 2);
+  auto mixerIn1 = buses.declareInput(kMixer, "osc/out", 2);
+  auto mixerIn2 = buses.declareInput(kMixer, "filter/out", 2);
+  auto mixerOut = buses.declareOutput(kMixer, "mix", 2);
+  REQUIRE(buses.getInput(oscIn) == nullptr);
+
+  REQUIRE(buses.resolve());
+  REQUIRE(buses.getNumBuses() == 4);
+  REQUIRE(buses.getArenaSize() == 7);
+  REQUIRE(buses.getNumChannels("osc/out") == 2);
+  REQUIRE(buses.getBus("nowhere") == nullptr);
+
+  // ports on the same bus share its memory, and the channels of a bus follow each other.
+  REQUIRE(buses.getInput(oscIn) == buses.getBus("in"));
+  REQUIRE(buses.getInput(filterIn) == buses.getOutput(oscOut));
+  REQUIRE(buses.getInput(mixerIn1) == buses.getOutput(oscOut));
+  REQUIRE(buses.getInput(mixerIn2) == buses.getOutput(filterOut));
+  buses.getOutput(oscOut)[1] = DSPVector(3.f);
+  REQUIRE(buses.getBus("osc/out")[1] == DSPVector(3.f));
+  REQUIRE(buses.getOutput(mixerOut) != buses.getOutput(filterOut));
+  buses.clear();
+  REQUIRE(buses.getBus("osc/out")[1] == DSPVector(0.f));
+
+  using Dependency = std::pair<SignalBuses::ClientID, SignalBuses::ClientID>;
+  std::vector<Dependency> expected{{kOsc, kFilter}, {kOsc, kMixer}, {kFilter, kMixer}};
+  REQUIRE(buses.getDependencies() == expected);
+
+  // a bus with two writers.
+  buses.declareOutput(kMixer, "filter/out", 2);
+  REQUIRE(!buses.resolve());
+
+  // a bus that is never written, and one with different numbers of channels.
+  SignalBuses unwritten;
+  unwritten.declareInput(kOsc, "in", 1);
+  REQUIRE(!unwritten.resolve());
+  SignalBuses mismatched;
+  mismatched.declareOutput(kOsc, "out", 2);
+  mismatched.declareInput(kFilter, "out", 1);
+  REQUIRE(!mismatched.resolve());
+}
+
+// a job whose first task waits for a flag, and whose other tasks record their order.
+struct OrderJob
+{
+  std::atomic<bool>* go;
+  std::atomic<int>* started;
+  std::vector<int>* order;
+  int id;
+};
+
+void orderTask(void* context, size_t task)
+{
+  auto* job = static_cast<OrderJob*>(context);
+  if (task == 0)
+  {
+    job->started->fetch_add(1);
+    while (!job->go->load()) std::this_thread::yield();
+  }
+  else
+  {
+    job->order->push_back(job->id);
+  }
+}
+
+TEST_CASE("madronalib/core/worker_pool/shared_service", "[worker_pool][threads]")
+{
+  // pointers made anywhere in the process share one service.
+  {
+    SharedResourcePointer<SharedWorkerService> a, b;
+    REQUIRE(&a.get() == &b.get());
+    REQUIRE(a.getReferenceCount() == 2);
+    REQUIRE(a->getNumWorkers() >= 1);
+  }
+
+  // many threads run jobs at once, and every task runs exactly once.
+  constexpr size_t kTasks{37};
+  constexpr int kCallers{6};
+  constexpr int kJobs{300};
+  SharedWorkerService service(3);
+  std::vector<std::vector<std::atomic<int> > > counts(kCallers);
+  std::vector<std::thread> callers;
+  for (int c = 0; c < kCallers; ++c)
+  {
+    counts[c] = std::vector<std::atomic<int> >(kTasks);
+    callers.emplace_back([&, c]() {
+      for (int j = 0; j < kJobs; ++j)
+      {
+        const auto deadline = SharedWorkerService::Clock::now() + std::chrono::milliseconds(c);
+        service.run(kTasks, countTask, &counts[c], deadline);
+      }
+    });
+  }
+  for (auto& t : callers) t.join();
+  bool allRanOnce{true};
+  for (auto& callerCounts : counts)
+  {
+    for (auto& n : callerCounts) allRanOnce &= (n.load() == kJobs);
+  }
+  REQUIRE(allRanOnce);
+  REQUIRE(service.getOverflowJobs() == 0);
+  REQUIRE(!service.run(kTasks, countTask, &counts[0], SharedWorkerService::Clock::now()));
+
+  // the worker takes tasks from the job with the earliest deadline first. One job keeps the
+  // worker and its caller busy while two more jobs wait, each with its caller in a first task.
+  SharedWorkerService single(1);
+  std::atomic<bool> goBusy{false}, goOthers{false};
+  std::atomic<int> busyStarted{0}, othersStarted{0};
+  std::vector<int> order;
+  const auto now = SharedWorkerService::Clock::now();
+  OrderJob busy{&goBusy, &busyStarted, &order, 0};
+  std::thread busyCaller([&]() {
+    single.run(2, [](void* context, size_t) { orderTask(context, 0); }, &busy, now);
+  });
+  while (busyStarted < 2) std::this_thread::yield();
+
+  OrderJob late{&goOthers, &othersStarted, &order, 1}, early{&goOthers, &othersStarted, &order, 2};
+  std::thread lateCaller([&]() { single.run(2, orderTask, &late, now + std::chrono::hours(2)); });
+  std::thread earlyCaller([&]() { single.run(2, orderTask, &early, now + std::chrono::hours(1)); });
+  while (othersStarted < 2) std::this_thread::yield();
+  goBusy = true;
+  busyCaller.join();
+  while (order.size() < 2) std::this_thread::yield();
+  goOthers = true;
+  lateCaller.join();
+  earlyCaller.join();
+  REQUIRE(order == std::vector<int>{2, 1});
+}
+
+TEST_CASE("madronalib/core/worker_pool/shared_service_clients", "[worker_pool][threads]")
+{
+  // synths in two instances render on the shared workers, matching serial rendering.
+  AudioContext ctx1(0, 2, 48000), ctx2(0, 2, 48000), serialCtx(0, 2, 48000);
+  TestSynth serialSynth, synth1, synth2;
+  synth1.setSharedVoiceWorkers(true);
+  synth2.setSharedVoiceWorkers(true);
+  REQUIRE(synth1.hasSharedVoiceWorkers());
+  DSPVectorDynamic inputs, serialOut(2), out1(2), out2(2);
+  std::vector<DSPVector> expected;
+  for (int i = 0; i < 100; ++i)
+  {
+    serialSynth.processVector(inputs, serialOut, &serialCtx);
+    expected.push_back(serialOut[0]);
+  }
+  std::atomic<bool> match1{true};
+  std::thread other([&]() {
+    for (int i = 0; i < 100; ++i)
+    {
+      synth1.processVector(inputs, out1, &ctx1);
+      if (!(out1[0] == expected[i])) match1 = false;
+    }
+  });
+  bool match2{true};
+  for (int i = 0; i < 100; ++i)
+  {
+    synth2.processVector(inputs, out2, &ctx2);
+    match2 &= (out2[0] == expected[i]);
+  }
+  other.join();
+  REQUIRE(match1);
+  REQUIRE(match2);
+
+  // a graph runs on the shared workers.
+  ProcessorGraph g;
+  g.setSharedWorkers(true, 48000.);
+  REQUIRE(g.hasSharedWorkers());
+  auto in = g.addBus(1);
+  auto b1 = g.addBus(1);
+  auto b2 = g.addBus(1);
+  AddProcessor times2(2.f, 0.f), plus1(1.f, 1.f);
+  g.addProcessor(&times2, in, b1);
+  g.addProcessor(&plus1, b1, b2);
+  REQUIRE(g.compile());
+  g.getBus(in)[0] = DSPVector(3.f);
+  for (int v = 0; v < 10; ++v)
+  {
+    g.process();
+  }
+  REQUIRE(g.getBus(b2)[0] == DSPVector(7.f));
+  REQUIRE(plus1.runs == 10);
+}
+
+}  // namespace workerPoolTest
@@ -10,22 +10,36 @@
 #include "MLTree.h"
 #include "MLActor.h"
 #include "MLAudioTask.h"
+#include "MLAudioThreadCheck.h"
 #include "MLClock.h"
+#include "MLCoalescingQueue.h"
+#include "MLCompression.h"
+#include "MLDSPProfiler.h"
 #include "MLEventsToSignals.h"
 #include "MLMemoryUtils.h"
+#include "MLMemoryReport.h"
+#include "MLMetrics.h"
 #include "MLMIDI.h"
+#include "MLParameterRamps.h"
+#include "MLParameterStore.h"
 #include "MLParameters.h"
+#include "MLParallelForEach.h"
 #include "MLPath.h"
 #include "MLPlatform.h"
 #include "MLPropertyTree.h"
 #include "MLQueue.h"
+#include "MLSamplePool.h"
+#include "MLSampleStream.h"
 #include "MLSerialization.h"
 #include "MLSharedResource.h"
+#include "MLSignalBuses.h"
+#include "MLSmoothingBank.h"
 #include "MLSymbol.h"
 #include "MLText.h"
 #include "MLTestUtils.h"
 #include "MLTextUtils.h"
 #include "MLTimer.h"
+#include "MLTimerWheel.h"
 
 
 
@@ -5,13 +5,29 @@
 #pragma once
 
 #include "MLDSPOps.h"
+#include "MLDSPOpsDouble.h"
+#include "MLDSPSampleStorage.h"
+#include "MLDSPSampleFormats.h"
+#include "MLDSPExpressions.h"
+#include "MLDSPMathTiers.h"
 #include "MLDSPFilters.h"
+#include "MLDSPConvolver.h"
+#include "MLDSPFDTD.h"
 #include "MLDSPGens.h"
+#include "MLDSPGrainPlayer.h"
 #include "MLDSPBuffer.h"
+#include "MLDSPDenormals.h"
 #include "MLDSPFunctional.h"
+#include "MLDSPChain.h"
 #include "MLDSPUtils.h"
 #include "MLDSPProjections.h"
+#include "MLDSPCompiledProjection.h"
+#include "MLDSPProjectionTable.h"
+#include "MLDSPResampler.h"
 #include "MLDSPRouting.h"
 #include "MLDSPSample.h"
+#include "MLDSPSamplePlayer.h"
+#include "MLDSPWaveshaper.h"
+#include "MLDSPDynamics.h"
 #include "MLDSPScale.h"
 
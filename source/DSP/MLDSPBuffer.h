@@ -6,6 +6,10 @@
 // audio. Some nice implementation details are borrowed from Portaudio's
 // pa_ringbuffer by Phil Burk and others. C++11 atomics are used to implement
 // the lockfree algorithm.
+//
+// In mirrored mode, the buffer's memory is mapped twice in a row with
+// MirroredMemory, so that every read and write is one contiguous region and
+// readers can use the data in place with getReadPointer().
 
 #pragma once
 
@@ -13,6 +17,7 @@
 #include <atomic>
 #include <vector>
 
+#include "MLDSPMirroredMemory.h"
 #include "MLDSPOps.h"
 
 namespace ml
@@ -21,8 +26,10 @@ class DSPBuffer
 {
  private:
   std::vector<float> data_;
+  MirroredMemory mirror_;
   float *dataBuffer_{nullptr};
   size_t size_{0};
+  size_t requestedSize_{0};
   size_t dataMask_{0};
   size_t distanceMask_{0};
 
@@ -36,14 +43,88 @@ class DSPBuffer
     size_t size2;
   };
 
-  inline void addSamples(const float *pSrcStart, const float *pSrcEnd, float *pDest)
+  // pDest[i] += pSrc[i] for n samples. Neither pointer needs to be aligned.
+  static inline void addSamples(const float *pSrc, float *pDest, size_t n)
   {
-    for (const float *p = pSrcStart; p < pSrcEnd; ++p)
+    size_t i = 0;
+    for (; i + kFloatsPerSIMDVector <= n; i += kFloatsPerSIMDVector)
     {
-      *pDest++ += *p;
+      vecStoreUnaligned(pDest + i,
+                        vecAdd(vecLoadUnaligned(pDest + i), vecLoadUnaligned(pSrc + i)));
+    }
+    for (; i < n; ++i)
+    {
+      pDest[i] += pSrc[i];
+    }
+  }
+
+  // pDest[i] += pSrc[i] * gain for n samples.
+  static inline void addScaledSamples(const float *pSrc, float gain, float *pDest, size_t n)
+  {
+    const SIMDVectorFloat vGain = vecSet1(gain);
+    size_t i = 0;
+    for (; i + kFloatsPerSIMDVector <= n; i += kFloatsPerSIMDVector)
+    {
+      vecStoreUnaligned(pDest + i, vecAdd(vecLoadUnaligned(pDest + i),
+                                          vecMul(vecLoadUnaligned(pSrc + i), vGain)));
+    }
+    for (; i < n; ++i)
+    {
+      pDest[i] += pSrc[i] * gain;
+    }
+  }
+
+  // pDest[i] += pSrc[i] * pWindow[i] * gain for n samples.
+  static inline void addWindowedSamples(const float *pSrc, const float *pWindow, float gain,
+                                        float *pDest, size_t n)
+  {
+    const SIMDVectorFloat vGain = vecSet1(gain);
+    size_t i = 0;
+    for (; i + kFloatsPerSIMDVector <= n; i += kFloatsPerSIMDVector)
+    {
+      SIMDVectorFloat w = vecMul(vecLoadUnaligned(pWindow + i), vGain);
+      vecStoreUnaligned(pDest + i, vecAdd(vecLoadUnaligned(pDest + i),
+                                          vecMul(vecLoadUnaligned(pSrc + i), w)));
+    }
+    for (; i < n; ++i)
+    {
+      pDest[i] += pSrc[i] * pWindow[i] * gain;
     }
   }
 
+  // apply addFn(srcOffset, pDest, n) to the one or two regions of samples starting at the
+  // write index, then clear (samples - overlap) samples after them for the next add and
+  // advance the write index by (samples - overlap). Partial windows are never written.
+  template <typename AddFn>
+  void overlapAddRegions(size_t samples, size_t overlap, AddFn addFn)
+  {
+    if (overlap > samples) return;
+    if (getWriteAvailable() < samples * 2 - overlap) return;
+
+    size_t currentWriteIndex = writeIndex_.load(std::memory_order_acquire);
+
+    DataRegions dr = getDataRegions(currentWriteIndex, samples);
+    addFn(size_t(0), dr.p1, dr.size1);
+    if (dr.p2)
+    {
+      addFn(dr.size1, dr.p2, dr.size2);
+    }
+
+    // clear samples for next overlapped add
+    currentWriteIndex = advanceDistanceIndex(currentWriteIndex, samples);
+    size_t samplesToClear = samples - overlap;
+    dr = getDataRegions(currentWriteIndex, samplesToClear);
+
+    std::fill(dr.p1, dr.p1 + dr.size1, 0.f);
+    if (dr.p2)
+    {
+      std::fill(dr.p2, dr.p2 + dr.size2, 0.f);
+    }
+
+    currentWriteIndex = rewindDistanceIndex(currentWriteIndex, overlap);
+    writeIndex_.store(currentWriteIndex, std::memory_order_release);
+  }
+
   inline size_t advanceDistanceIndex(size_t start, size_t samples)
   {
     return (start + samples) & distanceMask_;
@@ -57,7 +138,7 @@ class DSPBuffer
   inline DataRegions getDataRegions(size_t currentIdx, size_t elems) const
   {
     size_t startIdx = currentIdx & dataMask_;
-    if (startIdx + elems > size_)
+    if ((startIdx + elems > size_) && !mirror_.data())
     {
       size_t firstHalf = size_ - startIdx;
       size_t secondHalf = elems - firstHalf;
@@ -75,6 +156,15 @@ class DSPBuffer
 
   DSPBuffer(const DSPBuffer &b)
   {
+    if (b.isMirrored())
+    {
+      if (resize(b.size_, true))
+      {
+        std::copy(b.dataBuffer_, b.dataBuffer_ + size_, dataBuffer_);
+      }
+      return;
+    }
+
     size_ = b.size_;
 
     try
@@ -100,25 +190,44 @@ class DSPBuffer
   }
 
   // resize the buffer, allocating 2^n samples sufficient to contain the
-  // requested length.
-  size_t resize(int sizeInSamples)
+  // requested length. If mirrored is true, the size is also made a whole
+  // number of pages, and if the memory can't be mirrored on this system, the
+  // buffer is made unmirrored.
+  size_t resize(int sizeInSamples, bool mirrored = false)
   {
     readIndex_ = writeIndex_ = 0;
 
     int sizeBits = (int)ml::bitsToContain(sizeInSamples);
     size_ = std::max((1 << sizeBits), (int)kFloatsPerDSPVector);
+    requestedSize_ = size_t(std::max(sizeInSamples, 0));
 
-    try
+    mirror_.release();
+    if (mirrored)
     {
-      data_.resize(size_);
+      // page sizes are powers of two, so this stays a power of two.
+      size_ = std::max(size_, MirroredMemory::getPageSize() / sizeof(float));
+      if (mirror_.allocate(size_ * sizeof(float)))
+      {
+        std::vector<float>().swap(data_);
+        dataBuffer_ = static_cast<float *>(mirror_.data());
+        std::fill(dataBuffer_, dataBuffer_ + size_, 0.f);
+      }
     }
-    catch (const std::bad_alloc &)
+
+    if (!mirror_.data())
     {
-      size_ = dataMask_ = distanceMask_ = 0;
-      return 0;
+      try
+      {
+        data_.resize(size_);
+      }
+      catch (const std::bad_alloc &)
+      {
+        size_ = requestedSize_ = dataMask_ = distanceMask_ = 0;
+        return 0;
+      }
+      dataBuffer_ = data_.data();
     }
 
-    dataBuffer_ = data_.data();
     dataMask_ = size_ - 1;
 
     // The distance mask idea is based on code from PortAudio's ringbuffer by
@@ -132,6 +241,32 @@ class DSPBuffer
     return size_;
   }
 
+  bool isMirrored() const { return mirror_.data() != nullptr; }
+
+  // in mirrored mode, return a pointer to the next getReadAvailable() samples, which can be read
+  // in place before calling discard(). Returns nullptr in unmirrored mode.
+  const float *getReadPointer() const
+  {
+    if (!isMirrored()) return nullptr;
+    return dataBuffer_ + (readIndex_.load(std::memory_order_acquire) & dataMask_);
+  }
+
+  // in mirrored mode, return a pointer to space for getWriteAvailable() samples, which can be
+  // written in place before calling commitWrite(). Returns nullptr in unmirrored mode.
+  float *getWritePointer()
+  {
+    if (!isMirrored()) return nullptr;
+    return dataBuffer_ + (writeIndex_.load(std::memory_order_relaxed) & dataMask_);
+  }
+
+  // advance the write index past samples written in place, up to getWriteAvailable().
+  void commitWrite(size_t samples)
+  {
+    samples = std::min(samples, getWriteAvailable());
+    const auto currentWriteIndex = writeIndex_.load(std::memory_order_relaxed);
+    writeIndex_.store(advanceDistanceIndex(currentWriteIndex, samples), std::memory_order_release);
+  }
+
   // return the number of samples available for reading.
   size_t getReadAvailable() const
   {
@@ -143,6 +278,10 @@ class DSPBuffer
   // return the samples of free space available for writing.
   size_t getWriteAvailable() const { return size_ - getReadAvailable(); }
 
+  // the memory used for samples, and the part of it that resize() was asked for.
+  size_t getMemoryBytes() const { return data_.capacity() * sizeof(float) + mirror_.size(); }
+  size_t getRequestedMemoryBytes() const { return requestedSize_ * sizeof(float); }
+
   // write n samples to the buffer, advancing the write index.
   void write(const float *pSrc, size_t samples)
   {
@@ -287,37 +426,25 @@ class DSPBuffer
   // add n samples to the buffer and advance the write index by (samples - overlap)
   void writeWithOverlapAdd(const float *pSrc, size_t samples, size_t overlap)
   {
-    size_t available = getWriteAvailable();
-
-    size_t samplesRequired = samples * 2 - overlap;
-
-    // don't write partial windows.
-    if (available < samplesRequired) return;
-
-    size_t currentWriteIndex = writeIndex_.load(std::memory_order_acquire);
-
-    // add samples to data in buffer
-    DataRegions dr = getDataRegions(currentWriteIndex, samples);
-    addSamples(pSrc, pSrc + dr.size1, dr.p1);
-    if (dr.p2)
-    {
-      addSamples(pSrc + dr.size1, pSrc + dr.size1 + dr.size2, dr.p2);
-    }
-
-    // clear samples for next overlapped add
-    currentWriteIndex = advanceDistanceIndex(currentWriteIndex, samples);
-    size_t samplesToClear = samples - overlap;
-    dr = getDataRegions(currentWriteIndex, samplesToClear);
-
-    std::fill(dr.p1, dr.p1 + dr.size1, 0.f);
-    if (dr.p2)
-    {
-      std::fill(dr.p2, dr.p2 + dr.size2, 0.f);
-    }
+    overlapAddRegions(samples, overlap, [&](size_t offset, float *pDest, size_t n)
+                      { addSamples(pSrc + offset, pDest, n); });
+  }
 
-    currentWriteIndex = rewindDistanceIndex(currentWriteIndex, overlap);
+  // add n samples multiplied by gain to the buffer and advance the write index by
+  // (samples - overlap).
+  void writeWithOverlapAdd(const float *pSrc, float gain, size_t samples, size_t overlap)
+  {
+    overlapAddRegions(samples, overlap, [&](size_t offset, float *pDest, size_t n)
+                      { addScaledSamples(pSrc + offset, gain, pDest, n); });
+  }
 
-    writeIndex_.store(currentWriteIndex, std::memory_order_release);
+  // add n samples multiplied by the n samples of the window and by gain to the buffer and
+  // advance the write index by (samples - overlap).
+  void writeWindowedWithOverlapAdd(const float *pSrc, const float *pWindow, size_t samples,
+                                   size_t overlap, float gain = 1.f)
+  {
+    overlapAddRegions(samples, overlap, [&](size_t offset, float *pDest, size_t n)
+                      { addWindowedSamples(pSrc + offset, pWindow + offset, gain, pDest, n); });
   }
 
   // read n samples from buffer then rewind read point by overlap.
@@ -383,4 +510,247 @@ class DSPBuffer
   }
 };
 
+// MultiChannelDSPBuffer is a single producer, single consumer, lock-free ring
+// buffer for a number of channels of audio that are always read and written
+// together. The channels share one pair of indices, and can be written and read
+// either planar, with one pointer per channel, or interleaved, in which case
+// they are converted with SIMD kernels for common channel counts.
+
+class MultiChannelDSPBuffer
+{
+ private:
+  // the samples for each channel are stored contiguously, one channel after another.
+  std::vector<float> data_;
+  size_t channels_{0};
+  size_t size_{0};
+  size_t requestedSize_{0};
+  size_t dataMask_{0};
+  size_t distanceMask_{0};
+
+  // channel pointers for each side, so that neither allocates.
+  std::vector<float *> writePtrs_;
+  std::vector<const float *> readPtrs_;
+
+  // indices in frames, constrained to size * 2 as in DSPBuffer.
+  std::atomic<size_t> writeIndex_{0};
+  std::atomic<size_t> readIndex_{0};
+
+  float *channelPtr(size_t c) { return data_.data() + c * size_; }
+
+  // call fn(start, frames, done) for each of the one or two regions of the given frames
+  // starting at index, where done is the number of frames in the regions before.
+  template <typename F>
+  inline void forEachRegion(size_t index, size_t frames, F fn) const
+  {
+    size_t start = index & dataMask_;
+    size_t first = std::min(frames, size_ - start);
+    fn(start, first, size_t(0));
+    if (first < frames)
+    {
+      fn(size_t(0), frames - first, first);
+    }
+  }
+
+  inline void advanceWriteIndex(size_t currentWriteIndex, size_t frames, bool full)
+  {
+    size_t newWriteIndex = (currentWriteIndex + frames) & distanceMask_;
+    writeIndex_.store(newWriteIndex, std::memory_order_release);
+    if (full)
+    {
+      // oldest data was clobbered by write. set read index to indicate we are full
+      readIndex_.store((newWriteIndex - size_) & distanceMask_, std::memory_order_release);
+    }
+  }
+
+  inline void advanceReadIndex(size_t currentReadIndex, size_t frames)
+  {
+    readIndex_.store((currentReadIndex + frames) & distanceMask_, std::memory_order_release);
+  }
+
+ public:
+  MultiChannelDSPBuffer() = default;
+  ~MultiChannelDSPBuffer() = default;
+
+  // resize the buffer, allocating 2^n frames sufficient to contain the requested length for
+  // each channel. Returns the number of frames.
+  size_t resize(size_t channels, int sizeInFrames)
+  {
+    readIndex_ = writeIndex_ = 0;
+
+    int sizeBits = (int)ml::bitsToContain(sizeInFrames);
+    size_ = std::max((1 << sizeBits), (int)kFloatsPerDSPVector);
+    requestedSize_ = size_t(std::max(sizeInFrames, 0));
+    channels_ = channels;
+
+    try
+    {
+      data_.assign(size_ * channels_, 0.f);
+      writePtrs_.resize(channels_);
+      readPtrs_.resize(channels_);
+    }
+    catch (const std::bad_alloc &)
+    {
+      size_ = requestedSize_ = channels_ = dataMask_ = distanceMask_ = 0;
+      return 0;
+    }
+
+    dataMask_ = size_ - 1;
+    distanceMask_ = size_ * 2 - 1;
+    return size_;
+  }
+
+  void clear()
+  {
+    const auto currentWriteIndex = writeIndex_.load(std::memory_order_acquire);
+    readIndex_.store(currentWriteIndex, std::memory_order_release);
+  }
+
+  size_t getNumChannels() const { return channels_; }
+
+  // the buffer's storage, for locking it into memory.
+  float *getStorage() { return data_.data(); }
+  size_t getStorageSize() const { return data_.size(); }
+
+  // the memory used for samples, and the part of it that resize() was asked for.
+  size_t getMemoryBytes() const { return data_.capacity() * sizeof(float); }
+  size_t getRequestedMemoryBytes() const { return requestedSize_ * channels_ * sizeof(float); }
+
+  // return the number of frames available for reading.
+  size_t getReadAvailable() const
+  {
+    size_t a = readIndex_.load(std::memory_order_acquire);
+    size_t b = writeIndex_.load(std::memory_order_relaxed);
+    return (b - a) & distanceMask_;
+  }
+
+  // return the frames of free space available for writing.
+  size_t getWriteAvailable() const { return size_ - getReadAvailable(); }
+
+  // write frames from a pointer for each channel. Null pointers write silence.
+  void writePlanar(const float *const *pSrc, size_t frames)
+  {
+    frames = std::min(frames, size_);
+    bool full = (getWriteAvailable() < frames);
+    const auto currentWriteIndex = writeIndex_.load(std::memory_order_acquire);
+    forEachRegion(currentWriteIndex, frames, [&](size_t start, size_t n, size_t done) {
+      for (size_t c = 0; c < channels_; ++c)
+      {
+        float *pDest = channelPtr(c) + start;
+        if (pSrc[c])
+        {
+          std::copy(pSrc[c] + done, pSrc[c] + done + n, pDest);
+        }
+        else
+        {
+          std::fill(pDest, pDest + n, 0.f);
+        }
+      }
+    });
+    advanceWriteIndex(currentWriteIndex, frames, full);
+  }
+
+  // read frames to a pointer for each channel. Channels with null pointers are skipped.
+  // Returns the number of frames read.
+  size_t readPlanar(float *const *pDest, size_t frames)
+  {
+    frames = std::min(frames, getReadAvailable());
+    const auto currentReadIndex = readIndex_.load(std::memory_order_acquire);
+    forEachRegion(currentReadIndex, frames, [&](size_t start, size_t n, size_t done) {
+      for (size_t c = 0; c < channels_; ++c)
+      {
+        if (pDest[c])
+        {
+          const float *pSrc = channelPtr(c) + start;
+          std::copy(pSrc, pSrc + n, pDest[c] + done);
+        }
+      }
+    });
+    advanceReadIndex(currentReadIndex, frames);
+    return frames;
+  }
+
+  // write interleaved frames, with a sample for each channel.
+  void writeInterleaved(const float *pSrc, size_t frames)
+  {
+    frames = std::min(frames, size_);
+    bool full = (getWriteAvailable() < frames);
+    const auto currentWriteIndex = writeIndex_.load(std::memory_order_acquire);
+    forEachRegion(currentWriteIndex, frames, [&](size_t start, size_t n, size_t done) {
+      for (size_t c = 0; c < channels_; ++c)
+      {
+        writePtrs_[c] = channelPtr(c) + start;
+      }
+      deinterleave(pSrc + done * channels_, writePtrs_.data(), channels_, n);
+    });
+    advanceWriteIndex(currentWriteIndex, frames, full);
+  }
+
+  // read interleaved frames, with a sample for each channel. Returns the number of frames read.
+  size_t readInterleaved(float *pDest, size_t frames)
+  {
+    frames = std::min(frames, getReadAvailable());
+    const auto currentReadIndex = readIndex_.load(std::memory_order_acquire);
+    forEachRegion(currentReadIndex, frames, [&](size_t start, size_t n, size_t done) {
+      for (size_t c = 0; c < channels_; ++c)
+      {
+        readPtrs_[c] = channelPtr(c) + start;
+      }
+      interleave(readPtrs_.data(), pDest + done * channels_, channels_, n);
+    });
+    advanceReadIndex(currentReadIndex, frames);
+    return frames;
+  }
+
+  // write one DSPVector for each channel. Channels past the end of the input are silent.
+  void write(const DSPVectorDynamic &srcVecs)
+  {
+    constexpr size_t frames = kFloatsPerDSPVector;
+    bool full = (getWriteAvailable() < frames);
+    const auto currentWriteIndex = writeIndex_.load(std::memory_order_acquire);
+    forEachRegion(currentWriteIndex, frames, [&](size_t start, size_t n, size_t done) {
+      for (size_t c = 0; c < channels_; ++c)
+      {
+        float *pDest = channelPtr(c) + start;
+        if (c < srcVecs.size())
+        {
+          const float *pSrc = srcVecs[c].getConstBuffer() + done;
+          std::copy(pSrc, pSrc + n, pDest);
+        }
+        else
+        {
+          std::fill(pDest, pDest + n, 0.f);
+        }
+      }
+    });
+    advanceWriteIndex(currentWriteIndex, frames, full);
+  }
+
+  // read one DSPVector for each channel. If a whole vector is not available, the vectors are
+  // cleared and false is returned.
+  bool read(DSPVectorDynamic &destVecs)
+  {
+    constexpr size_t frames = kFloatsPerDSPVector;
+    const size_t nVecs = std::min(destVecs.size(), channels_);
+    if (getReadAvailable() < frames)
+    {
+      for (size_t c = 0; c < destVecs.size(); ++c)
+      {
+        destVecs[c] = DSPVector();
+      }
+      return false;
+    }
+
+    const auto currentReadIndex = readIndex_.load(std::memory_order_acquire);
+    forEachRegion(currentReadIndex, frames, [&](size_t start, size_t n, size_t done) {
+      for (size_t c = 0; c < nVecs; ++c)
+      {
+        const float *pSrc = channelPtr(c) + start;
+        std::copy(pSrc, pSrc + n, destVecs[c].getBuffer() + done);
+      }
+    });
+    advanceReadIndex(currentReadIndex, frames);
+    return true;
+  }
+};
+
 }  // namespace ml
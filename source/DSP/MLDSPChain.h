@@ -0,0 +1,215 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// MLDSPChain.h
+// Static composition of DSP processors.
+//
+// chain() makes a Chain of processors and functions, called stages, that applies them in
+// order to a DSPVectorArray:
+//
+//   auto voice = chain(Lopass{}, [](SIMDVectorFloat x) { return vecTanhApprox(x); });
+//   voice.get<0>().coeffs = Lopass::makeCoeffs(0.1f, 0.5f);
+//   DSPVector y = voice(x);
+//
+// The stages are stored in the Chain by value and their types are all part of the Chain's
+// type, so the compiler sees the whole pipeline and can inline it into one function. Each
+// stage is recognized by what it can be called with, in this order:
+//   (DSPVectorArray<ROWS>)->(DSPVectorArray<N>): applied to the whole signal. The stage can
+//     change the number of rows, and the rows of each stage are checked at compile time.
+//   (DSPVector)->(DSPVector): applied to each row in place. Because one object is used for
+//     every row, it must have no state, like a lambda without captures. For a processor with
+//     state, Bank<Processor, ROWS> from MLDSPFunctional.h holds one processor for each row.
+//     Rows are read and written through row() and constRow(), whose views are marked
+//     may_alias, so this is safe with strict aliasing.
+//   (SIMDVectorFloat)->(SIMDVectorFloat) or (float)->(float): applied to each element.
+// Element stages next to each other are fused: each SIMD vector of the signal is loaded once,
+// goes through all of them in registers and is stored back in place, so a run of element
+// stages makes one pass over memory however long it is.
+
+#pragma once
+
+#include <array>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "MLDSPFunctional.h"
+#include "MLDSPOps.h"
+
+namespace ml
+{
+namespace chainStages
+{
+enum class Kind
+{
+  kArray,
+  kRow,
+  kSIMD,
+  kFloat,
+  kNone
+};
+
+template <class Stage, size_t ROWS>
+constexpr Kind kindOf()
+{
+  if constexpr (std::is_invocable_v<Stage&, const DSPVectorArray<ROWS>&>)
+    return Kind::kArray;
+  else if constexpr (std::is_invocable_v<Stage&, const DSPVector&>)
+    return Kind::kRow;
+  else if constexpr (std::is_invocable_r_v<SIMDVectorFloat, Stage&, SIMDVectorFloat>)
+    return Kind::kSIMD;
+  else if constexpr (std::is_invocable_r_v<float, Stage&, float>)
+    return Kind::kFloat;
+  else
+    return Kind::kNone;
+}
+
+template <class Stage, size_t ROWS>
+constexpr bool isElementStage()
+{
+  constexpr Kind k = kindOf<Stage, ROWS>();
+  return (k == Kind::kSIMD) || (k == Kind::kFloat);
+}
+
+// the index after the run of element stages starting at I.
+template <size_t ROWS, size_t I, class Tuple>
+constexpr size_t elementRunEnd()
+{
+  if constexpr (I == std::tuple_size_v<Tuple>)
+    return I;
+  else if constexpr (isElementStage<std::tuple_element_t<I, Tuple>, ROWS>())
+    return elementRunEnd<ROWS, I + 1, Tuple>();
+  else
+    return I;
+}
+
+template <class T>
+struct IsDSPVectorArray : std::false_type
+{
+};
+
+template <size_t ROWS>
+struct IsDSPVectorArray<DSPVectorArray<ROWS> > : std::true_type
+{
+};
+}  // namespace chainStages
+
+template <class... Stages>
+class Chain
+{
+  using StageTuple = std::tuple<Stages...>;
+  StageTuple stages_;
+
+  // apply the element stages from I up to END to one SIMD vector.
+  template <size_t ROWS, size_t I, size_t END>
+  inline SIMDVectorFloat applyElementStages(SIMDVectorFloat v)
+  {
+    if constexpr (I == END)
+    {
+      return v;
+    }
+    else
+    {
+      using Stage = std::tuple_element_t<I, StageTuple>;
+      auto& stage = std::get<I>(stages_);
+      if constexpr (chainStages::kindOf<Stage, ROWS>() == chainStages::Kind::kSIMD)
+      {
+        v = stage(v);
+      }
+      else
+      {
+        alignas(kBytesPerSIMDVector) float lanes[kFloatsPerSIMDVector];
+        vecStore(lanes, v);
+        for (int i = 0; i < kFloatsPerSIMDVector; ++i)
+        {
+          lanes[i] = stage(lanes[i]);
+        }
+        v = vecLoad(lanes);
+      }
+      return applyElementStages<ROWS, I + 1, END>(v);
+    }
+  }
+
+  // apply the stages from I to the end to x, which element and row stages change in place.
+  template <size_t I, size_t ROWS>
+  inline auto run(DSPVectorArray<ROWS>& x)
+  {
+    if constexpr (I == sizeof...(Stages))
+    {
+      return x;
+    }
+    else
+    {
+      using Stage = std::tuple_element_t<I, StageTuple>;
+      constexpr chainStages::Kind kind = chainStages::kindOf<Stage, ROWS>();
+      static_assert(kind != chainStages::Kind::kNone,
+                    "chain: a stage can't be called with the output of the stage before it");
+      auto& stage = std::get<I>(stages_);
+
+      if constexpr (kind == chainStages::Kind::kArray)
+      {
+        auto y = stage(x);
+        static_assert(chainStages::IsDSPVectorArray<decltype(y)>::value,
+                      "chain: a stage must return a DSPVectorArray");
+        return run<I + 1>(y);
+      }
+      else if constexpr (kind == chainStages::Kind::kRow)
+      {
+        static_assert(std::is_empty_v<Stage>,
+                      "chain: a stage applied to each row must have no state. Use Bank.");
+        for (int j = 0; j < ROWS; ++j)
+        {
+          x.row(j) = DSPVector(stage(x.constRow(j)));
+        }
+        return run<I + 1>(x);
+      }
+      else
+      {
+        constexpr size_t kEnd = chainStages::elementRunEnd<ROWS, I, StageTuple>();
+        float* px = x.getBuffer();
+        for (int n = 0; n < kSIMDVectorsPerDSPVector * ROWS; ++n)
+        {
+          vecStore(px, applyElementStages<ROWS, I, kEnd>(vecLoad(px)));
+          px += kFloatsPerSIMDVector;
+        }
+        return run<kEnd>(x);
+      }
+    }
+  }
+
+ public:
+  static constexpr size_t kStages{sizeof...(Stages)};
+
+  Chain() = default;
+  explicit Chain(Stages... stages) : stages_(std::move(stages)...) {}
+
+  // the Ith stage, to set parameters or read state.
+  template <size_t I>
+  auto& get()
+  {
+    return std::get<I>(stages_);
+  }
+
+  template <size_t I>
+  const auto& get() const
+  {
+    return std::get<I>(stages_);
+  }
+
+  // process one vector of the signal x through all the stages.
+  template <size_t ROWS>
+  inline auto operator()(DSPVectorArray<ROWS> x)
+  {
+    return run<0>(x);
+  }
+};
+
+// make a Chain from stages, which are copied or moved into it.
+template <class... Stages>
+inline Chain<std::decay_t<Stages>...> chain(Stages&&... stages)
+{
+  return Chain<std::decay_t<Stages>...>(std::forward<Stages>(stages)...);
+}
+
+}  // namespace ml
@@ -0,0 +1,164 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// CompiledProjection: a projection from a closed set of curve types, stored as
+// plain data.
+//
+// A Projection is a std::function, and composed Projections nest lambdas, so
+// each evaluation makes one or more indirect calls. A CompiledProjection is
+//
+//   y = outScale * shape(inScale * x + inOffset) + outOffset
+//
+// with the shape chosen from a small set by a switch. That covers the linear,
+// log and bisquare projections made for parameters. It can be evaluated on a
+// single float or on a whole DSPVector with SIMD, and it can be copied into a
+// Projection where one is needed.
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#include "MLDSPOps.h"
+#include "MLDSPProjections.h"
+
+namespace ml
+{
+struct CompiledProjection
+{
+  enum class Shape : uint8_t
+  {
+    kIdentity,
+    kExp,
+    kLog,
+    kBisquare,
+    kInvBisquare
+  };
+
+  Shape shape{Shape::kIdentity};
+  float inScale{1.f};
+  float inOffset{0.f};
+  float outScale{1.f};
+  float outOffset{0.f};
+
+  float operator()(float x) const
+  {
+    float u = inScale * x + inOffset;
+    float s;
+    switch (shape)
+    {
+      case Shape::kIdentity:
+      default:
+        s = u;
+        break;
+      case Shape::kExp:
+        s = expf(u);
+        break;
+      case Shape::kLog:
+        s = logf(u);
+        break;
+      case Shape::kBisquare:
+        s = fabsf(u) * u;
+        break;
+      case Shape::kInvBisquare:
+        s = sqrtf(fabsf(u)) * ml::sign(u);
+        break;
+    }
+    return outScale * s + outOffset;
+  }
+
+  DSPVector operator()(const DSPVector& x) const
+  {
+    DSPVector u = x * DSPVector(inScale) + DSPVector(inOffset);
+    DSPVector s;
+    switch (shape)
+    {
+      case Shape::kIdentity:
+      default:
+        s = u;
+        break;
+      case Shape::kExp:
+        s = exp(u);
+        break;
+      case Shape::kLog:
+        s = log(u);
+        break;
+      case Shape::kBisquare:
+        s = abs(u) * u;
+        break;
+      case Shape::kInvBisquare:
+        s = sqrt(abs(u)) * sign(u);
+        break;
+    }
+    return s * DSPVector(outScale) + DSPVector(outOffset);
+  }
+
+  Projection toProjection() const
+  {
+    CompiledProjection c = *this;
+    return [c](float x) { return c(x); };
+  }
+};
+
+namespace compiledProjections
+{
+inline CompiledProjection constant(float k)
+{
+  return CompiledProjection{CompiledProjection::Shape::kIdentity, 0.f, 0.f, 0.f, k};
+}
+
+// linear projection mapping an interval to another interval, as projections::linear.
+inline CompiledProjection linear(Interval a, Interval b)
+{
+  if (a.x1 - a.x2 == 0.f) return constant(b.x1);
+  float m = (b.x2 - b.x1) / (a.x2 - a.x1);
+  return CompiledProjection{CompiledProjection::Shape::kIdentity, m, b.x1 - m * a.x1, 1.f, 0.f};
+}
+
+// [0, 1] to a log parameter on the range, plus an offset. The same as
+// add(offset) composed with intervalMap({0, 1}, range, projections::log(range)).
+inline CompiledProjection unityToLogParam(Interval range, float offset = 0.f)
+{
+  float a = range.x1;
+  float b = range.x2;
+  if (b - a == 0.f) return constant(a + offset);
+  if (a == 0.f) return constant(offset);
+
+  // a * (b/a)^x + offset
+  return CompiledProjection{CompiledProjection::Shape::kExp, logf(b / a), 0.f, a, offset};
+}
+
+// the inverse of unityToLogParam.
+inline CompiledProjection logParamToUnity(Interval range, float offset = 0.f)
+{
+  float a = range.x1;
+  float b = range.x2;
+  if (b - a == 0.f) return constant(a);
+  if (a == 0.f) return constant(0.f);
+
+  // log((x - offset) / a) / log(b / a)
+  return CompiledProjection{CompiledProjection::Shape::kLog, 1.f / a, -offset / a,
+                            1.f / logf(b / a), 0.f};
+}
+
+// bisquared composed with linear(a, b).
+inline CompiledProjection bisquaredLinear(Interval a, Interval b)
+{
+  if (a.x1 - a.x2 == 0.f) return constant(fabsf(b.x1) * b.x1);
+  CompiledProjection c = linear(a, b);
+  c.shape = CompiledProjection::Shape::kBisquare;
+  return c;
+}
+
+// linear(a, b) composed with invBisquared: the inverse of bisquaredLinear(b, a).
+inline CompiledProjection linearInvBisquared(Interval a, Interval b)
+{
+  if (a.x1 - a.x2 == 0.f) return constant(b.x1);
+  CompiledProjection lin = linear(a, b);
+  return CompiledProjection{CompiledProjection::Shape::kInvBisquare, 1.f, 0.f, lin.inScale,
+                            lin.inOffset};
+}
+
+}  // namespace compiledProjections
+}  // namespace ml
@@ -0,0 +1,213 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// MLDSPConvolver.h
+// Uniformly partitioned FFT convolution for long impulse responses.
+//
+// The impulse response is split into partitions of kFloatsPerDSPVector
+// samples. Each call to operator() takes one DSPVector of input, does one FFT
+// and one inverse FFT of size 2 * kFloatsPerDSPVector, and returns the
+// corresponding DSPVector of output, so the convolver adds no delay beyond
+// the DSPVector it is processing.
+//
+// All memory is allocated in the constructor and in setImpulseResponse(), following a
+// LargeBufferPolicy for the input history and the partitions of each response.
+// setImpulseResponse() may be called from a background thread while the audio
+// thread is running operator(): the new response is handed over without locks
+// and crossfaded in over one DSPVector.
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "ffft/FFTRealFixLen.h"
+#include "MLDSPLargeBuffer.h"
+#include "MLDSPOps.h"
+
+namespace ml
+{
+class Convolver
+{
+  static constexpr int kFFTBits = kFloatsPerDSPVectorBits + 1;
+  static constexpr size_t kFFTSize = 1 << kFFTBits;
+  static constexpr size_t kHalfFFTSize = kFFTSize / 2;
+  using FFT = ffft::FFTRealFixLen<kFFTBits>;
+
+  // the spectra of each partition of an impulse response.
+  struct Kernel
+  {
+    size_t partitions{0};
+    LargeBuffer<float> spectra;
+    const float* getPartition(size_t p) const { return spectra.data() + p * kFFTSize; }
+  };
+
+ public:
+  // allocate for impulse responses of up to maxLength samples.
+  explicit Convolver(size_t maxLength, const LargeBufferPolicy& policy = LargeBufferPolicy())
+      : maxPartitions_(
+            std::max(size_t(1), (maxLength + kFloatsPerDSPVector - 1) / kFloatsPerDSPVector)),
+        policy_(policy),
+        inputSpectra_(maxPartitions_ * kFFTSize, 0.f, LargeBufferAllocator<float>(policy)),
+        fft_(std::make_unique<FFT>())
+  {
+    current_ = new Kernel;
+    clear();
+  }
+
+  ~Convolver()
+  {
+    delete current_;
+    delete previous_;
+    delete pending_.exchange(nullptr);
+    delete retired_.exchange(nullptr);
+  }
+
+  Convolver(const Convolver&) = delete;
+  Convolver& operator=(const Convolver&) = delete;
+
+  size_t getMaxLength() const { return maxPartitions_ * kFloatsPerDSPVector; }
+
+  // Make the spectra for a new impulse response and hand them to the audio
+  // thread. Responses longer than getMaxLength() are truncated. Not real-time
+  // safe: this allocates, and frees any response the audio thread is done with.
+  void setImpulseResponse(const float* pIR, size_t length)
+  {
+    delete retired_.exchange(nullptr);
+
+    length = std::min(length, getMaxLength());
+    auto k = std::make_unique<Kernel>();
+    k->partitions = (length + kFloatsPerDSPVector - 1) / kFloatsPerDSPVector;
+    k->spectra = LargeBuffer<float>(k->partitions * kFFTSize, 0.f,
+                                    LargeBufferAllocator<float>(policy_));
+
+    FFT fft;
+    std::vector<float> padded(kFFTSize);
+    const float scale = 1.f / kFFTSize;
+    for (size_t p = 0; p < k->partitions; ++p)
+    {
+      // zero-padded partition, scaled to normalize the inverse FFT.
+      std::fill(padded.begin(), padded.end(), 0.f);
+      size_t start = p * kFloatsPerDSPVector;
+      size_t end = std::min(start + kFloatsPerDSPVector, length);
+      for (size_t i = start; i < end; ++i)
+      {
+        padded[i - start] = pIR[i] * scale;
+      }
+      fft.do_fft(k->spectra.data() + p * kFFTSize, padded.data());
+    }
+
+    // if the audio thread has not picked up an earlier response, free it.
+    delete pending_.exchange(k.release());
+  }
+
+  void setImpulseResponse(const std::vector<float>& ir)
+  {
+    setImpulseResponse(ir.data(), ir.size());
+  }
+
+  // clear the input history. Audio thread only.
+  void clear()
+  {
+    std::fill(inputSpectra_.begin(), inputSpectra_.end(), 0.f);
+    std::fill(timeBuffer_, timeBuffer_ + kFFTSize, 0.f);
+    fdlIndex_ = 0;
+  }
+
+  DSPVector operator()(const DSPVector x)
+  {
+    // take a new response if one is waiting and the last old one has been freed.
+    if (!previous_ && !retired_.load(std::memory_order_acquire))
+    {
+      if (Kernel* k = pending_.exchange(nullptr, std::memory_order_acq_rel))
+      {
+        previous_ = current_;
+        current_ = k;
+      }
+    }
+
+    // slide the input window and transform [previous input, current input].
+    std::copy(timeBuffer_ + kFloatsPerDSPVector, timeBuffer_ + kFFTSize, timeBuffer_);
+    std::copy(x.getConstBuffer(), x.getConstBuffer() + kFloatsPerDSPVector,
+              timeBuffer_ + kFloatsPerDSPVector);
+    fdlIndex_ = (fdlIndex_ == 0) ? maxPartitions_ - 1 : fdlIndex_ - 1;
+    fft_->do_fft(inputSpectra(fdlIndex_), timeBuffer_);
+
+    DSPVector y = convolve(*current_);
+    if (previous_)
+    {
+      DSPVector yPrev = convolve(*previous_);
+      DSPVector fadeIn = interpolateDSPVectorLinear(0.f, 1.f);
+      y = lerp(yPrev, y, fadeIn);
+      retired_.store(previous_, std::memory_order_release);
+      previous_ = nullptr;
+    }
+    return y;
+  }
+
+ private:
+  float* inputSpectra(size_t i) { return inputSpectra_.data() + i * kFFTSize; }
+
+  // multiply-accumulate the input spectra with the kernel's partitions, then
+  // keep the second half of the inverse transform (overlap-save).
+  DSPVector convolve(const Kernel& k)
+  {
+    std::fill(accum_, accum_ + kFFTSize, 0.f);
+    size_t fdl = fdlIndex_;
+    for (size_t p = 0; p < k.partitions; ++p)
+    {
+      complexMultiplyAccumulate(accum_, inputSpectra(fdl), k.getPartition(p));
+      fdl = (fdl + 1 == maxPartitions_) ? 0 : fdl + 1;
+    }
+    float result[kFFTSize];
+    fft_->do_ifft(accum_, result);
+
+    DSPVector y;
+    std::copy(result + kFloatsPerDSPVector, result + kFFTSize, y.getBuffer());
+    return y;
+  }
+
+  // ffft stores real parts in [0, N/2] and negated imaginary parts of bins
+  // 1 to N/2 - 1 in [N/2 + 1, N - 1]. Since conj(a)conj(b) = conj(ab), the
+  // usual complex product works on the stored values.
+  static void complexMultiplyAccumulate(float* py, const float* pa, const float* pb)
+  {
+    py[0] += pa[0] * pb[0];
+    py[kHalfFFTSize] += pa[kHalfFFTSize] * pb[kHalfFFTSize];
+
+    const float* ar = pa + 1;
+    const float* ai = pa + kHalfFFTSize + 1;
+    const float* br = pb + 1;
+    const float* bi = pb + kHalfFFTSize + 1;
+    float* yr = py + 1;
+    float* yi = py + kHalfFFTSize + 1;
+    for (size_t i = 0; i < kHalfFFTSize - 1; ++i)
+    {
+      yr[i] += ar[i] * br[i] - ai[i] * bi[i];
+      yi[i] += ar[i] * bi[i] + ai[i] * br[i];
+    }
+  }
+
+  const size_t maxPartitions_;
+  const LargeBufferPolicy policy_;
+
+  // frequency-domain delay line: spectra of the most recent input windows.
+  LargeBuffer<float> inputSpectra_;
+  size_t fdlIndex_{0};
+
+  std::unique_ptr<FFT> fft_;
+  float timeBuffer_[kFFTSize];
+  float accum_[kFFTSize];
+
+  // owned by the audio thread
+  Kernel* current_{nullptr};
+  Kernel* previous_{nullptr};
+
+  // handoffs between the audio thread and the thread setting responses
+  std::atomic<Kernel*> pending_{nullptr};
+  std::atomic<Kernel*> retired_{nullptr};
+};
+
+}  // namespace ml
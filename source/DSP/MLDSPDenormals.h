@@ -0,0 +1,142 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// MLDSPDenormals.h
+// Control of denormal math, and probes that count denormals to find where they come from.
+//
+// Denormal numbers make many processors take far longer than normal numbers, so IIR filters and
+// feedback loops can spike the CPU as they decay. Flushing denormals to zero avoids this. The
+// threads that madronalib runs DSP on do it automatically: the AudioTask callback, WorkerPool
+// workers, OfflineAudioTask renders and the Timers thread. Other threads can use a
+// UsingFlushDenormalsToZero guard.
+//
+// To find the processors making denormals, define ML_COUNT_DENORMALS. Then DenormalProbes
+// placed on the outputs of processors count the denormals they see, and the automatic flushing
+// is turned off so that the denormals show up where they would without it. In other builds,
+// probes do nothing.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+#include "MLDSPOps.h"
+
+namespace ml
+{
+#ifdef ML_COUNT_DENORMALS
+constexpr bool kFlushDenormalsAutomatically{false};
+#else
+constexpr bool kFlushDenormalsAutomatically{true};
+#endif
+
+// the bits of the floating point control register that flush denormals to zero: DAZ (denormals
+// are zero) and FZ (flush to zero) in the Intel MXCSR register, and FZ in the ARM64 FPCR.
+// WebAssembly has no such control, even when it is compiled through the SSE headers.
+#if defined(__SSE__) && !defined(ML_SSE_TO_WASM)
+constexpr uint64_t kFlushDenormalsBits{0x8040};
+inline uint64_t getFloatingPointControl() { return _mm_getcsr(); }
+inline void setFloatingPointControl(uint64_t c) { _mm_setcsr(uint32_t(c)); }
+#elif defined(__aarch64__)
+constexpr uint64_t kFlushDenormalsBits{1ULL << 24};
+inline uint64_t getFloatingPointControl()
+{
+  uint64_t c = 0;
+  asm volatile("MRS %0, FPCR " : "=r"(c));
+  return c;
+}
+inline void setFloatingPointControl(uint64_t c) { asm volatile("MSR FPCR, %0 " : : "r"(c)); }
+#else
+constexpr uint64_t kFlushDenormalsBits{0};
+inline uint64_t getFloatingPointControl() { return 0; }
+inline void setFloatingPointControl(uint64_t) {}
+#endif
+
+inline bool isFlushingDenormalsToZero()
+{
+  return kFlushDenormalsBits &&
+         ((getFloatingPointControl() & kFlushDenormalsBits) == kFlushDenormalsBits);
+}
+
+// flush denormals to zero on the calling thread from now on, for threads that only run DSP.
+inline void setCurrentThreadFlushDenormalsToZero()
+{
+  setFloatingPointControl(getFloatingPointControl() | kFlushDenormalsBits);
+}
+
+// UsingFlushDenormalsToZero: turn off denormal math so that (for example) IIR filters don't
+// consume many more CPU cycles when they decay, until the guard goes out of scope. If flush is
+// false, the guard does nothing.
+struct UsingFlushDenormalsToZero
+{
+  uint64_t MXCRState;
+
+  explicit UsingFlushDenormalsToZero(bool flush = true) : MXCRState(getFloatingPointControl())
+  {
+    if (flush) setFloatingPointControl(MXCRState | kFlushDenormalsBits);
+  }
+
+  // restore the old setting
+  ~UsingFlushDenormalsToZero() { setFloatingPointControl(MXCRState); }
+};
+
+// count the denormal numbers in x. The bits are checked directly, because comparisons treat
+// denormals as zero when denormals are flushed.
+template <size_t ROWS>
+inline int countDenormals(const DSPVectorArray<ROWS>& x)
+{
+  const float* px = x.getConstBuffer();
+  int count{0};
+  for (size_t i = 0; i < kFloatsPerDSPVector * ROWS; ++i)
+  {
+    uint32_t bits;
+    std::memcpy(&bits, px + i, sizeof(bits));
+    count += ((bits & 0x7F800000) == 0) && ((bits & 0x007FFFFF) != 0);
+  }
+  return count;
+}
+
+// DenormalProbe: counts the denormals in the outputs of a processor. The audio thread calls
+// check() with each output; any thread can read the counts. Probes only count when
+// ML_COUNT_DENORMALS is defined, and otherwise check() compiles to nothing.
+class DenormalProbe
+{
+ public:
+  template <size_t ROWS>
+  void check([[maybe_unused]] const DSPVectorArray<ROWS>& y)
+  {
+#ifdef ML_COUNT_DENORMALS
+    int n = countDenormals(y);
+    vectors_.fetch_add(1, std::memory_order_relaxed);
+    if (n)
+    {
+      denormals_.fetch_add(uint64_t(n), std::memory_order_relaxed);
+      vectorsWithDenormals_.fetch_add(1, std::memory_order_relaxed);
+    }
+#endif
+  }
+
+  // the numbers of vectors checked, of those with any denormals, and of denormals in them.
+  uint64_t getVectorCount() const { return vectors_.load(std::memory_order_relaxed); }
+  uint64_t getVectorsWithDenormals() const
+  {
+    return vectorsWithDenormals_.load(std::memory_order_relaxed);
+  }
+  uint64_t getDenormalCount() const { return denormals_.load(std::memory_order_relaxed); }
+
+  void clear()
+  {
+    vectors_.store(0, std::memory_order_relaxed);
+    vectorsWithDenormals_.store(0, std::memory_order_relaxed);
+    denormals_.store(0, std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<uint64_t> vectors_{0};
+  std::atomic<uint64_t> vectorsWithDenormals_{0};
+  std::atomic<uint64_t> denormals_{0};
+};
+
+}  // namespace ml
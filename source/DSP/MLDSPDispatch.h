@@ -0,0 +1,470 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// MLDSPDispatch.h
+// Runtime selection of SIMD math kernels based on the host CPU.
+//
+// A binary compiled for the SSE2 baseline can still use AVX2 on machines that
+// have it. Each kernel processes a buffer of floats whose size is a multiple of
+// kFloatsPerDSPVector. The table of kernels is chosen once, at first use, from
+// the features reported by cpuid. When ML_USE_RUNTIME_DISPATCH is defined,
+// the corresponding DSPVector functions in MLDSPOps.h call through this table.
+
+#pragma once
+
+#include <cfloat>
+#include <cstddef>
+#include <cstdint>
+
+#include "MLDSPMath.h"
+
+#if (defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)) && \
+    !defined(ML_SSE_TO_NEON)
+#define ML_DISPATCH_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define ML_TARGET_AVX2
+#else
+#include <cpuid.h>
+#define ML_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace ml
+{
+enum class SIMDLevel
+{
+  kBaseline,  // whatever the binary was compiled for: SSE2, NEON or AVX2
+  kAVX2,
+  kAVX512
+};
+
+inline const char* getSIMDLevelName(SIMDLevel level)
+{
+  switch (level)
+  {
+    case SIMDLevel::kAVX2:
+      return "AVX2";
+    case SIMDLevel::kAVX512:
+      return "AVX-512";
+    default:
+      return "baseline";
+  }
+}
+
+// ----------------------------------------------------------------
+// CPU feature detection
+
+#if ML_DISPATCH_X86
+
+namespace dispatch
+{
+inline void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t r[4])
+{
+#ifdef _MSC_VER
+  int regs[4];
+  __cpuidex(regs, leaf, subleaf);
+  for (int i = 0; i < 4; ++i) r[i] = static_cast<uint32_t>(regs[i]);
+#else
+  __cpuid_count(leaf, subleaf, r[0], r[1], r[2], r[3]);
+#endif
+}
+
+// read the OS-enabled register state, XCR0.
+inline uint64_t xgetbv0()
+{
+#ifdef _MSC_VER
+  return _xgetbv(0);
+#else
+  uint32_t lo, hi;
+  __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+  return (static_cast<uint64_t>(hi) << 32) | lo;
+#endif
+}
+}  // namespace dispatch
+
+inline SIMDLevel detectSIMDLevel()
+{
+  uint32_t r[4];
+  dispatch::cpuid(0, 0, r);
+  uint32_t maxLeaf = r[0];
+  if (maxLeaf < 7) return SIMDLevel::kBaseline;
+
+  dispatch::cpuid(1, 0, r);
+  bool osxsave = r[2] & (1u << 27);
+  bool avx = r[2] & (1u << 28);
+  if (!(osxsave && avx)) return SIMDLevel::kBaseline;
+
+  // the OS must save the ymm registers (and zmm / opmask for AVX-512)
+  uint64_t xcr0 = dispatch::xgetbv0();
+  if ((xcr0 & 0x6) != 0x6) return SIMDLevel::kBaseline;
+
+  dispatch::cpuid(7, 0, r);
+  bool avx2 = r[1] & (1u << 5);
+  bool avx512f = r[1] & (1u << 16);
+  if (!avx2) return SIMDLevel::kBaseline;
+  if (avx512f && ((xcr0 & 0xE6) == 0xE6)) return SIMDLevel::kAVX512;
+  return SIMDLevel::kAVX2;
+}
+
+#else
+
+inline SIMDLevel detectSIMDLevel() { return SIMDLevel::kBaseline; }
+
+#endif
+
+// ----------------------------------------------------------------
+// kernel table
+
+struct DSPKernels
+{
+  using UnaryFn = void (*)(const float* px, float* py, size_t n);
+  using TernaryFn = void (*)(const float* px1, const float* px2, const float* px3, float* py,
+                             size_t n);
+  using ReduceFn = float (*)(const float* px, size_t n);
+
+  SIMDLevel level;
+  UnaryFn sin;
+  UnaryFn cos;
+  UnaryFn log;
+  UnaryFn exp;
+  UnaryFn sqrt;
+  UnaryFn tanhApprox;
+  TernaryFn lerp;
+  ReduceFn sum;
+  ReduceFn max;
+  ReduceFn min;
+};
+
+// ----------------------------------------------------------------
+// baseline kernels, using the SIMD primitives this binary was compiled with.
+
+namespace baseline
+{
+#define DEFINE_BASELINE_KERNEL1(opName, opComputation) \
+  inline void opName(const float* px, float* py, size_t n) \
+  {                                                    \
+    for (size_t i = 0; i < n; i += kFloatsPerSIMDVector) \
+    {                                                  \
+      SIMDVectorFloat x = vecLoad(px + i);             \
+      vecStore(py + i, (opComputation));               \
+    }                                                  \
+  }
+
+DEFINE_BASELINE_KERNEL1(sin, vecSin(x));
+DEFINE_BASELINE_KERNEL1(cos, vecCos(x));
+DEFINE_BASELINE_KERNEL1(log, vecLog(x));
+DEFINE_BASELINE_KERNEL1(exp, vecExp(x));
+DEFINE_BASELINE_KERNEL1(sqrt, vecSqrt(x));
+DEFINE_BASELINE_KERNEL1(tanhApprox, vecTanhApprox(x));
+
+#undef DEFINE_BASELINE_KERNEL1
+
+inline void lerp(const float* px1, const float* px2, const float* px3, float* py, size_t n)
+{
+  for (size_t i = 0; i < n; i += kFloatsPerSIMDVector)
+  {
+    SIMDVectorFloat x1 = vecLoad(px1 + i);
+    SIMDVectorFloat x2 = vecLoad(px2 + i);
+    SIMDVectorFloat x3 = vecLoad(px3 + i);
+    vecStore(py + i, vecAdd(x1, vecMul(x3, vecSub(x2, x1))));
+  }
+}
+
+inline float sum(const float* px, size_t n)
+{
+  float sum = 0;
+  for (size_t i = 0; i < n; i += kFloatsPerSIMDVector)
+  {
+    sum += vecSumH(vecLoad(px + i));
+  }
+  return sum;
+}
+
+inline float max(const float* px, size_t n)
+{
+  float fmax = -FLT_MAX;
+  for (size_t i = 0; i < n; i += kFloatsPerSIMDVector)
+  {
+    float m = vecMaxH(vecLoad(px + i));
+    fmax = (m > fmax) ? m : fmax;
+  }
+  return fmax;
+}
+
+inline float min(const float* px, size_t n)
+{
+  float fmin = FLT_MAX;
+  for (size_t i = 0; i < n; i += kFloatsPerSIMDVector)
+  {
+    float m = vecMinH(vecLoad(px + i));
+    fmin = (m < fmin) ? m : fmin;
+  }
+  return fmin;
+}
+}  // namespace baseline
+
+inline const DSPKernels& getBaselineDSPKernels()
+{
+  static const DSPKernels k{SIMDLevel::kBaseline, baseline::sin,  baseline::cos,
+                            baseline::log,        baseline::exp,  baseline::sqrt,
+                            baseline::tanhApprox, baseline::lerp, baseline::sum,
+                            baseline::max,        baseline::min};
+  return k;
+}
+
+// ----------------------------------------------------------------
+// AVX2 kernels. These are compiled with the avx2 target attribute so that they
+// can be present in a binary built for the SSE2 baseline. They must only be
+// called after detectSIMDLevel() has reported AVX2 support.
+
+#if ML_DISPATCH_X86
+
+namespace avx2
+{
+// cephes-derived log, exp, sin and cos as in MLDSPMathSSE.h, 8 floats wide.
+
+ML_TARGET_AVX2 inline __m256 log8(__m256 x)
+{
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 half = _mm256_set1_ps(0.5f);
+  __m256 invalidMask = _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_LE_OS);
+
+  // cut off denormalized stuff
+  x = _mm256_max_ps(x, _mm256_castsi256_ps(_mm256_set1_epi32(0x00800000)));
+  __m256i emm0 = _mm256_srli_epi32(_mm256_castps_si256(x), 23);
+
+  // keep only the fractional part
+  x = _mm256_and_ps(x, _mm256_castsi256_ps(_mm256_set1_epi32(~0x7f800000)));
+  x = _mm256_or_ps(x, half);
+
+  emm0 = _mm256_sub_epi32(emm0, _mm256_set1_epi32(0x7f));
+  __m256 e = _mm256_add_ps(_mm256_cvtepi32_ps(emm0), one);
+
+  __m256 mask = _mm256_cmp_ps(x, _mm256_set1_ps(0.707106781186547524f), _CMP_LT_OS);
+  __m256 tmp = _mm256_and_ps(x, mask);
+  x = _mm256_sub_ps(x, one);
+  e = _mm256_sub_ps(e, _mm256_and_ps(one, mask));
+  x = _mm256_add_ps(x, tmp);
+
+  __m256 z = _mm256_mul_ps(x, x);
+  __m256 y = _mm256_set1_ps(7.0376836292E-2f);
+  y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(-1.1514610310E-1f));
+  y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(1.1676998740E-1f));
+  y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(-1.2420140846E-1f));
+  y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(+1.4249322787E-1f));
+  y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(-1.6668057665E-1f));
+  y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(+2.0000714765E-1f));
+  y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(-2.4999993993E-1f));
+  y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(+3.3333331174E-1f));
+  y = _mm256_mul_ps(_mm256_mul_ps(y, x), z);
+
+  y = _mm256_add_ps(y, _mm256_mul_ps(e, _mm256_set1_ps(-2.12194440e-4f)));
+  y = _mm256_sub_ps(y, _mm256_mul_ps(z, half));
+
+  x = _mm256_add_ps(x, y);
+  x = _mm256_add_ps(x, _mm256_mul_ps(e, _mm256_set1_ps(0.693359375f)));
+  return _mm256_or_ps(x, invalidMask);  // negative arg will be NAN
+}
+
+ML_TARGET_AVX2 inline __m256 exp8(__m256 x)
+{
+  const __m256 one = _mm256_set1_ps(1.0f);
+  x = _mm256_min_ps(x, _mm256_set1_ps(88.3762626647949f));
+  x = _mm256_max_ps(x, _mm256_set1_ps(-88.3762626647949f));
+
+  // express exp(x) as exp(g + n*log(2))
+  __m256 fx = _mm256_mul_ps(x, _mm256_set1_ps(1.44269504088896341f));
+  fx = _mm256_floor_ps(_mm256_add_ps(fx, _mm256_set1_ps(0.5f)));
+
+  x = _mm256_sub_ps(x, _mm256_mul_ps(fx, _mm256_set1_ps(0.693359375f)));
+  x = _mm256_sub_ps(x, _mm256_mul_ps(fx, _mm256_set1_ps(-2.12194440e-4f)));
+  __m256 z = _mm256_mul_ps(x, x);
+
+  __m256 y = _mm256_set1_ps(1.9875691500E-4f);
+  y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(1.3981999507E-3f));
+  y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(8.3334519073E-3f));
+  y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(4.1665795894E-2f));
+  y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(1.6666665459E-1f));
+  y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(5.0000001201E-1f));
+  y = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(y, z), x), one);
+
+  // build 2^n
+  __m256i emm0 = _mm256_cvttps_epi32(fx);
+  emm0 = _mm256_slli_epi32(_mm256_add_epi32(emm0, _mm256_set1_epi32(0x7f)), 23);
+  return _mm256_mul_ps(y, _mm256_castsi256_ps(emm0));
+}
+
+// shared body of sin and cos.
+template <bool kCosine>
+ML_TARGET_AVX2 inline __m256 sinOrCos8(__m256 x)
+{
+  const __m256 signMask = _mm256_castsi256_ps(_mm256_set1_epi32((int)0x80000000));
+  __m256 signBit = _mm256_and_ps(x, signMask);
+
+  // take the absolute value and scale by 4/Pi
+  x = _mm256_andnot_ps(signMask, x);
+  __m256 y = _mm256_mul_ps(x, _mm256_set1_ps(1.27323954473516f));
+
+  // j=(j+1) & (~1) (see the cephes sources)
+  __m256i emm2 = _mm256_cvttps_epi32(y);
+  emm2 = _mm256_add_epi32(emm2, _mm256_set1_epi32(1));
+  emm2 = _mm256_and_si256(emm2, _mm256_set1_epi32(~1));
+  y = _mm256_cvtepi32_ps(emm2);
+
+  __m256i emm0;
+  if (kCosine)
+  {
+    emm2 = _mm256_sub_epi32(emm2, _mm256_set1_epi32(2));
+    emm0 = _mm256_andnot_si256(emm2, _mm256_set1_epi32(4));
+    signBit = _mm256_castsi256_ps(_mm256_slli_epi32(emm0, 29));
+  }
+  else
+  {
+    emm0 = _mm256_and_si256(emm2, _mm256_set1_epi32(4));
+    signBit = _mm256_xor_ps(signBit, _mm256_castsi256_ps(_mm256_slli_epi32(emm0, 29)));
+  }
+
+  // get the polynomial selection mask
+  emm2 = _mm256_and_si256(emm2, _mm256_set1_epi32(2));
+  __m256 polyMask = _mm256_castsi256_ps(_mm256_cmpeq_epi32(emm2, _mm256_setzero_si256()));
+
+  // extended precision modular arithmetic
+  x = _mm256_add_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(-0.78515625f)));
+  x = _mm256_add_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(-2.4187564849853515625e-4f)));
+  x = _mm256_add_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(-3.77489497744594108e-8f)));
+
+  // cosine polynomial (0 <= x <= Pi/4)
+  __m256 z = _mm256_mul_ps(x, x);
+  y = _mm256_set1_ps(2.443315711809948E-005f);
+  y = _mm256_add_ps(_mm256_mul_ps(y, z), _mm256_set1_ps(-1.388731625493765E-003f));
+  y = _mm256_add_ps(_mm256_mul_ps(y, z), _mm256_set1_ps(4.166664568298827E-002f));
+  y = _mm256_mul_ps(_mm256_mul_ps(y, z), z);
+  y = _mm256_sub_ps(y, _mm256_mul_ps(z, _mm256_set1_ps(0.5f)));
+  y = _mm256_add_ps(y, _mm256_set1_ps(1.0f));
+
+  // sine polynomial (Pi/4 <= x <= 0)
+  __m256 y2 = _mm256_set1_ps(-1.9515295891E-4f);
+  y2 = _mm256_add_ps(_mm256_mul_ps(y2, z), _mm256_set1_ps(8.3321608736E-3f));
+  y2 = _mm256_add_ps(_mm256_mul_ps(y2, z), _mm256_set1_ps(-1.6666654611E-1f));
+  y2 = _mm256_mul_ps(_mm256_mul_ps(y2, z), x);
+  y2 = _mm256_add_ps(y2, x);
+
+  // select the correct result and update the sign
+  y = _mm256_add_ps(_mm256_andnot_ps(polyMask, y), _mm256_and_ps(polyMask, y2));
+  return _mm256_xor_ps(y, signBit);
+}
+
+ML_TARGET_AVX2 inline __m256 tanhApprox8(__m256 x)
+{
+  const __m256 k9 = _mm256_set1_ps(9.0f);
+  const __m256 k27 = _mm256_set1_ps(27.0f);
+  __m256 x2 = _mm256_mul_ps(x, x);
+  __m256 denom = _mm256_add_ps(k27, _mm256_mul_ps(k9, x2));
+  return _mm256_mul_ps(x, _mm256_div_ps(_mm256_add_ps(k27, x2), denom));
+}
+
+#define DEFINE_AVX2_KERNEL1(opName, opComputation)              \
+  ML_TARGET_AVX2 inline void opName(const float* px, float* py, size_t n) \
+  {                                                             \
+    for (size_t i = 0; i < n; i += 8)                           \
+    {                                                           \
+      __m256 x = _mm256_loadu_ps(px + i);                       \
+      _mm256_storeu_ps(py + i, (opComputation));                \
+    }                                                           \
+  }
+
+DEFINE_AVX2_KERNEL1(sin, sinOrCos8<false>(x));
+DEFINE_AVX2_KERNEL1(cos, sinOrCos8<true>(x));
+DEFINE_AVX2_KERNEL1(log, log8(x));
+DEFINE_AVX2_KERNEL1(exp, exp8(x));
+DEFINE_AVX2_KERNEL1(sqrt, _mm256_sqrt_ps(x));
+DEFINE_AVX2_KERNEL1(tanhApprox, tanhApprox8(x));
+
+#undef DEFINE_AVX2_KERNEL1
+
+ML_TARGET_AVX2 inline void lerp(const float* px1, const float* px2, const float* px3, float* py,
+                                size_t n)
+{
+  for (size_t i = 0; i < n; i += 8)
+  {
+    __m256 x1 = _mm256_loadu_ps(px1 + i);
+    __m256 x2 = _mm256_loadu_ps(px2 + i);
+    __m256 x3 = _mm256_loadu_ps(px3 + i);
+    _mm256_storeu_ps(py + i, _mm256_add_ps(x1, _mm256_mul_ps(x3, _mm256_sub_ps(x2, x1))));
+  }
+}
+
+ML_TARGET_AVX2 inline float horizontalSum8(__m256 v)
+{
+  __m128 t = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  t = _mm_add_ps(t, _mm_movehl_ps(t, t));
+  t = _mm_add_ss(t, _mm_shuffle_ps(t, t, 1));
+  return _mm_cvtss_f32(t);
+}
+
+ML_TARGET_AVX2 inline float sum(const float* px, size_t n)
+{
+  __m256 acc = _mm256_setzero_ps();
+  for (size_t i = 0; i < n; i += 8)
+  {
+    acc = _mm256_add_ps(acc, _mm256_loadu_ps(px + i));
+  }
+  return horizontalSum8(acc);
+}
+
+ML_TARGET_AVX2 inline float max(const float* px, size_t n)
+{
+  __m256 acc = _mm256_set1_ps(-FLT_MAX);
+  for (size_t i = 0; i < n; i += 8)
+  {
+    acc = _mm256_max_ps(acc, _mm256_loadu_ps(px + i));
+  }
+  __m128 t = _mm_max_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+  t = _mm_max_ps(t, _mm_movehl_ps(t, t));
+  t = _mm_max_ss(t, _mm_shuffle_ps(t, t, 1));
+  return _mm_cvtss_f32(t);
+}
+
+ML_TARGET_AVX2 inline float min(const float* px, size_t n)
+{
+  __m256 acc = _mm256_set1_ps(FLT_MAX);
+  for (size_t i = 0; i < n; i += 8)
+  {
+    acc = _mm256_min_ps(acc, _mm256_loadu_ps(px + i));
+  }
+  __m128 t = _mm_min_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+  t = _mm_min_ps(t, _mm_movehl_ps(t, t));
+  t = _mm_min_ss(t, _mm_shuffle_ps(t, t, 1));
+  return _mm_cvtss_f32(t);
+}
+}  // namespace avx2
+
+#endif  // ML_DISPATCH_X86
+
+// Return the kernel table for the given level, or the best available lower one.
+// There are no AVX-512 specific kernels yet, so AVX-512 machines use AVX2.
+inline const DSPKernels& getDSPKernels(SIMDLevel level)
+{
+#if ML_DISPATCH_X86
+  if (level != SIMDLevel::kBaseline)
+  {
+    static const DSPKernels k{SIMDLevel::kAVX2, avx2::sin,  avx2::cos,        avx2::log,
+                              avx2::exp,        avx2::sqrt, avx2::tanhApprox, avx2::lerp,
+                              avx2::sum,        avx2::max,  avx2::min};
+    return k;
+  }
+#endif
+  return getBaselineDSPKernels();
+}
+
+// The kernels for this machine, detected once on first use.
+inline const DSPKernels& getDSPKernels()
+{
+  static const DSPKernels& k = getDSPKernels(detectSIMDLevel());
+  return k;
+}
+
+}  // namespace ml
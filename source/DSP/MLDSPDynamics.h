@@ -0,0 +1,354 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// Dynamics processors with lookahead, for CHANNELS channels with linked detection: the level
+// of all the channels together is their largest absolute value, and the same gain is applied
+// to each, so that the stereo image doesn't move.
+//
+// SlidingMax finds the maximum of a signal over the last W samples with the van Herk /
+// Gil-Werman algorithm. The signal is split into blocks of W samples, and the maximum over any
+// window is the larger of the suffix maximum of the block it starts in and the prefix maximum
+// of the block it ends in. This costs about three comparisons per sample for any W, where
+// scanning the window would cost W. The prefix and suffix scans go sample by sample, and the
+// final comparison is made for the whole DSPVector with SIMD.
+//
+// LookaheadLimiter keeps the peaks of its outputs at or below a ceiling. The gain needed for
+// each sample is held over the lookahead window with a SlidingMax, then smoothed by a moving
+// average over the same window, so that it ramps down in time for each peak of the delayed
+// signal. It then recovers at the release time.
+//
+// LookaheadCompressor applies a gain computed in dB from a threshold, ratio and soft knee to
+// the peak level over the lookahead window, smoothed with attack and release times.
+//
+// Both delay their outputs by the lookahead. Processors using them should report this with
+// SignalProcessor::setLatencyInSamples(getLatencyInSamples()). Setting the lookahead allocates
+// and is not real-time safe.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+#include "MLDSPFilters.h"
+#include "MLDSPOps.h"
+
+namespace ml
+{
+class SlidingMax
+{
+  int window_{1};
+  int blockPos_{0};
+  uint32_t writeIndex_{0};
+  uint32_t mask_{0};
+  std::vector<float> x_;
+  std::vector<float> prefix_;
+  std::vector<float> suffix_;
+
+ public:
+  SlidingMax() { setWindowInSamples(1); }
+  explicit SlidingMax(int w) { setWindowInSamples(w); }
+
+  // the maximum is taken over the current sample and the w - 1 before it.
+  void setWindowInSamples(int w)
+  {
+    window_ = std::max(w, 1);
+    const size_t size = size_t(1) << bitsToContain(window_ * 2);
+    mask_ = uint32_t(size - 1);
+    x_.resize(size);
+    prefix_.resize(size);
+    suffix_.resize(size);
+    clear();
+  }
+
+  int getWindowInSamples() const { return window_; }
+
+  void clear()
+  {
+    std::fill(x_.begin(), x_.end(), 0.f);
+    std::fill(prefix_.begin(), prefix_.end(), 0.f);
+    std::fill(suffix_.begin(), suffix_.end(), 0.f);
+    blockPos_ = 0;
+    writeIndex_ = 0;
+  }
+
+  // the sliding maximum of a signal. Before the first W samples, the signal is 0.
+  DSPVector operator()(const DSPVector& vx)
+  {
+    DSPVector vPrefix, vSuffix;
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      const uint32_t i = (writeIndex_ + n) & mask_;
+      const float x = vx[n];
+      x_[i] = x;
+      prefix_[i] = (blockPos_ == 0) ? x : std::max(prefix_[(i - 1) & mask_], x);
+
+      // when a block is complete, make its suffix maxima.
+      if (++blockPos_ == window_)
+      {
+        float m = x;
+        for (int k = 0; k < window_; ++k)
+        {
+          const uint32_t j = (i - k) & mask_;
+          m = std::max(m, x_[j]);
+          suffix_[j] = m;
+        }
+        blockPos_ = 0;
+      }
+      vPrefix[n] = prefix_[i];
+      vSuffix[n] = suffix_[(i - window_ + 1) & mask_];
+    }
+    writeIndex_ = (writeIndex_ + kFloatsPerDSPVector) & mask_;
+    return max(vPrefix, vSuffix);
+  }
+};
+
+namespace dynamics
+{
+// the largest absolute value of the channels at each sample.
+template <size_t CHANNELS>
+DSPVector linkedPeak(const DSPVectorArray<CHANNELS>& x)
+{
+  DSPVector y = abs(x.constRow(0));
+  for (int c = 1; c < CHANNELS; ++c)
+  {
+    y = max(y, abs(x.constRow(c)));
+  }
+  return y;
+}
+
+// the coefficient of a one-pole smoother with the given time constant.
+inline float timeCoeff(float seconds, float sampleRate)
+{
+  return (seconds > 0.f) ? std::exp(-1.f / (seconds * sampleRate)) : 0.f;
+}
+}  // namespace dynamics
+
+template <int CHANNELS>
+class LookaheadLimiter
+{
+  int lookahead_{0};
+  float ceiling_{1.f};
+  float sampleRate_{48000.f};
+  float releaseTime_{0.1f};
+  float releaseCoeff_{0.f};
+
+  SlidingMax peak_;
+  std::array<IntegerDelay, CHANNELS> delays_;
+
+  // the moving average of the held gains.
+  std::vector<float> held_;
+  uint32_t heldIndex_{0};
+  double heldSum_{0.};
+
+  float gain_{1.f};
+
+ public:
+  LookaheadLimiter()
+  {
+    setLookaheadInSamples(0);
+    setReleaseTimeInSeconds(releaseTime_);
+  }
+
+  void setSampleRate(float sr)
+  {
+    sampleRate_ = sr;
+    releaseCoeff_ = dynamics::timeCoeff(releaseTime_, sampleRate_);
+  }
+
+  void setLookaheadInSamples(int samples)
+  {
+    lookahead_ = std::max(samples, 0);
+    peak_.setWindowInSamples(lookahead_ + 1);
+    for (auto& d : delays_)
+    {
+      d.setMaxDelayInSamples(float(lookahead_));
+      d.setDelayInSamples(lookahead_);
+    }
+    held_.resize(lookahead_ + 1);
+    clear();
+  }
+
+  int getLatencyInSamples() const { return lookahead_; }
+
+  // the highest absolute value of the output.
+  void setCeiling(float c) { ceiling_ = c; }
+
+  void setReleaseTimeInSeconds(float t)
+  {
+    releaseTime_ = t;
+    releaseCoeff_ = dynamics::timeCoeff(releaseTime_, sampleRate_);
+  }
+
+  // the gain at the end of the last DSPVector.
+  float getGain() const { return gain_; }
+
+  void clear()
+  {
+    peak_.clear();
+    for (auto& d : delays_)
+    {
+      d.clear();
+    }
+    std::fill(held_.begin(), held_.end(), 1.f);
+    heldIndex_ = 0;
+    heldSum_ = double(held_.size());
+    gain_ = 1.f;
+  }
+
+  DSPVectorArray<CHANNELS> operator()(const DSPVectorArray<CHANNELS>& vx)
+  {
+    // the lowest gain needed over the window.
+    const DSPVector vPeak = peak_(dynamics::linkedPeak(vx));
+    const DSPVector vHeld =
+        min(DSPVector(1.f), DSPVector(ceiling_) / max(vPeak, DSPVector(1e-20f)));
+
+    // average, then release.
+    DSPVector vGain;
+    const size_t length = held_.size();
+    const double scale = 1.0 / length;
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      heldSum_ += vHeld[n] - held_[heldIndex_];
+      held_[heldIndex_] = vHeld[n];
+      if (++heldIndex_ == length) heldIndex_ = 0;
+      const float target = float(heldSum_ * scale);
+      gain_ = (target < gain_) ? target : target + releaseCoeff_ * (gain_ - target);
+      vGain[n] = gain_;
+    }
+
+    DSPVectorArray<CHANNELS> vy;
+    for (int c = 0; c < CHANNELS; ++c)
+    {
+      vy.row(c) = delays_[c](vx.constRow(c)) * vGain;
+    }
+    return vy;
+  }
+};
+
+template <int CHANNELS>
+class LookaheadCompressor
+{
+  int lookahead_{0};
+  float sampleRate_{48000.f};
+  float threshold_{0.f};
+  float ratio_{1.f};
+  float knee_{0.f};
+  float makeup_{0.f};
+  float attackTime_{0.005f};
+  float releaseTime_{0.1f};
+  float attackCoeff_{0.f};
+  float releaseCoeff_{0.f};
+
+  SlidingMax peak_;
+  std::array<IntegerDelay, CHANNELS> delays_;
+
+  // the smoothed gain reduction in dB, 0 or negative.
+  float reduction_{0.f};
+
+  void updateCoeffs()
+  {
+    attackCoeff_ = dynamics::timeCoeff(attackTime_, sampleRate_);
+    releaseCoeff_ = dynamics::timeCoeff(releaseTime_, sampleRate_);
+  }
+
+ public:
+  LookaheadCompressor()
+  {
+    setLookaheadInSamples(0);
+    updateCoeffs();
+  }
+
+  void setSampleRate(float sr)
+  {
+    sampleRate_ = sr;
+    updateCoeffs();
+  }
+
+  void setLookaheadInSamples(int samples)
+  {
+    lookahead_ = std::max(samples, 0);
+    peak_.setWindowInSamples(lookahead_ + 1);
+    for (auto& d : delays_)
+    {
+      d.setMaxDelayInSamples(float(lookahead_));
+      d.setDelayInSamples(lookahead_);
+    }
+    clear();
+  }
+
+  int getLatencyInSamples() const { return lookahead_; }
+
+  void setThresholdInDb(float t) { threshold_ = t; }
+  void setRatio(float r) { ratio_ = std::max(r, 1.f); }
+  void setKneeInDb(float k) { knee_ = std::max(k, 0.f); }
+  void setMakeupGainInDb(float g) { makeup_ = g; }
+
+  void setAttackTimeInSeconds(float t)
+  {
+    attackTime_ = t;
+    updateCoeffs();
+  }
+
+  void setReleaseTimeInSeconds(float t)
+  {
+    releaseTime_ = t;
+    updateCoeffs();
+  }
+
+  // the gain reduction in dB at the end of the last DSPVector, 0 or negative.
+  float getGainReductionInDb() const { return reduction_; }
+
+  void clear()
+  {
+    peak_.clear();
+    for (auto& d : delays_)
+    {
+      d.clear();
+    }
+    reduction_ = 0.f;
+  }
+
+  DSPVectorArray<CHANNELS> operator()(const DSPVectorArray<CHANNELS>& vx)
+  {
+    constexpr float kAmpToDb{8.6858896f};
+    constexpr float kDbToLog{0.11512925f};
+
+    // the gain computer, with a quadratic soft knee.
+    const DSPVector vPeak = peak_(dynamics::linkedPeak(vx));
+    const DSPVector vLevel = log(max(vPeak, DSPVector(1e-10f))) * DSPVector(kAmpToDb);
+    const DSPVector vOver = vLevel - DSPVector(threshold_);
+    const DSPVector vSlope(1.f / ratio_ - 1.f);
+    const DSPVector vHalfKnee(knee_ * 0.5f);
+    DSPVector vBelow(0.f);
+    if (knee_ > 0.f)
+    {
+      const DSPVector vIn = vOver + vHalfKnee;
+      const DSPVector vKnee = vSlope * vIn * vIn / DSPVector(2.f * knee_);
+      vBelow = select(vKnee, vBelow, greaterThan(vIn, DSPVector(0.f)));
+    }
+    const DSPVector vReduction = select(vSlope * vOver, vBelow, greaterThan(vOver, vHalfKnee));
+
+    // attack toward more reduction, release toward less.
+    DSPVector vSmoothed;
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      const float target = vReduction[n];
+      const float c = (target < reduction_) ? attackCoeff_ : releaseCoeff_;
+      reduction_ = target + c * (reduction_ - target);
+      vSmoothed[n] = reduction_;
+    }
+    const DSPVector vGain = exp((vSmoothed + DSPVector(makeup_)) * DSPVector(kDbToLog));
+
+    DSPVectorArray<CHANNELS> vy;
+    for (int c = 0; c < CHANNELS; ++c)
+    {
+      vy.row(c) = delays_[c](vx.constRow(c)) * vGain;
+    }
+    return vy;
+  }
+};
+
+}  // namespace ml
@@ -0,0 +1,169 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// MLDSPExpressions.h
+// Opt-in lazy evaluation of DSPVectorArray arithmetic.
+//
+// The operators on DSPVectorArray in MLDSPOps.h evaluate eagerly, making one
+// pass over memory and one temporary for every operation. Wrapping an operand
+// with lazy() instead builds an expression that is evaluated in a single loop
+// when it is assigned to a DSPVectorArray:
+//
+//   DSPVector y = lazy(a) * b + lazy(c) * d - e;
+//
+// Any operation with a lazy operand is also lazy. Expressions hold references
+// to their operands, so they should not be stored (for example with auto)
+// beyond the statement that creates them.
+
+#pragma once
+
+#include "MLDSPOps.h"
+
+namespace ml
+{
+namespace expr
+{
+// a value of 0 for kRows means that the expression is a scalar that can be
+// broadcast to any number of rows.
+template <size_t R1, size_t R2>
+struct CombinedRows
+{
+  static_assert((R1 == R2) || (R1 == 0) || (R2 == 0),
+                "lazy expression operands must have the same number of rows");
+  static constexpr size_t value = R1 ? R1 : R2;
+};
+
+// base class for all expression nodes, used to recognize lazy operands.
+template <class Derived>
+struct Expr
+{
+  const Derived& derived() const { return static_cast<const Derived&>(*this); }
+};
+
+template <size_t ROWS>
+struct Terminal : public Expr<Terminal<ROWS> >
+{
+  static constexpr size_t kRows = ROWS;
+  const float* px;
+
+  explicit Terminal(const DSPVectorArray<ROWS>& v) : px(v.getConstBuffer()) {}
+  SIMDVectorFloat load(size_t n) const { return vecLoad(px + n * kFloatsPerSIMDVector); }
+};
+
+struct Scalar : public Expr<Scalar>
+{
+  static constexpr size_t kRows = 0;
+  SIMDVectorFloat v;
+
+  explicit Scalar(float f) : v(vecSet1(f)) {}
+  SIMDVectorFloat load(size_t) const { return v; }
+};
+
+struct AddOp
+{
+  static SIMDVectorFloat apply(SIMDVectorFloat a, SIMDVectorFloat b) { return vecAdd(a, b); }
+};
+struct SubOp
+{
+  static SIMDVectorFloat apply(SIMDVectorFloat a, SIMDVectorFloat b) { return vecSub(a, b); }
+};
+struct MulOp
+{
+  static SIMDVectorFloat apply(SIMDVectorFloat a, SIMDVectorFloat b) { return vecMul(a, b); }
+};
+struct DivOp
+{
+  static SIMDVectorFloat apply(SIMDVectorFloat a, SIMDVectorFloat b) { return vecDiv(a, b); }
+};
+struct MinOp
+{
+  static SIMDVectorFloat apply(SIMDVectorFloat a, SIMDVectorFloat b) { return vecMin(a, b); }
+};
+struct MaxOp
+{
+  static SIMDVectorFloat apply(SIMDVectorFloat a, SIMDVectorFloat b) { return vecMax(a, b); }
+};
+
+template <class Op, class L, class R>
+struct Binary;
+
+// evaluate an expression into a DSPVectorArray in one pass.
+template <class E>
+inline DSPVectorArray<E::kRows> eval(const Expr<E>& e)
+{
+  static_assert(E::kRows > 0, "can't evaluate a scalar expression");
+  const E& ex = e.derived();
+  DSPVectorArray<E::kRows> vy;
+  float* py1 = vy.getBuffer();
+  for (size_t n = 0; n < kSIMDVectorsPerDSPVector * E::kRows; ++n)
+  {
+    vecStore(py1, ex.load(n));
+    py1 += kFloatsPerSIMDVector;
+  }
+  return vy;
+}
+
+template <class Op, class L, class R>
+struct Binary : public Expr<Binary<Op, L, R> >
+{
+  static constexpr size_t kRows = CombinedRows<L::kRows, R::kRows>::value;
+  L l;
+  R r;
+
+  Binary(const L& lArg, const R& rArg) : l(lArg), r(rArg) {}
+  SIMDVectorFloat load(size_t n) const { return Op::apply(l.load(n), r.load(n)); }
+
+  // allows assignment and construction of DSPVectorArrays from expressions.
+  operator DSPVectorArray<kRows>() const { return eval(*this); }
+};
+
+// convert any operand to an expression node.
+template <class E>
+inline const E& toExpr(const Expr<E>& e)
+{
+  return e.derived();
+}
+template <size_t ROWS>
+inline Terminal<ROWS> toExpr(const DSPVectorArray<ROWS>& v)
+{
+  return Terminal<ROWS>(v);
+}
+inline Scalar toExpr(float f) { return Scalar(f); }
+
+template <class T>
+using ExprType = typename std::decay<decltype(toExpr(std::declval<const T&>()))>::type;
+
+// operators are defined when at least one operand is already lazy.
+template <class T>
+using IsLazy = std::is_base_of<Expr<T>, T>;
+
+template <class A, class B>
+using EnableIfLazy = typename std::enable_if<IsLazy<A>::value || IsLazy<B>::value>::type;
+
+#define DEFINE_LAZY_OP(opName, opStruct)                                       \
+  template <class A, class B, class = EnableIfLazy<A, B> >                     \
+  inline Binary<opStruct, ExprType<A>, ExprType<B> > opName(const A& a, const B& b) \
+  {                                                                            \
+    return Binary<opStruct, ExprType<A>, ExprType<B> >(toExpr(a), toExpr(b));  \
+  }
+
+DEFINE_LAZY_OP(operator+, AddOp);
+DEFINE_LAZY_OP(operator-, SubOp);
+DEFINE_LAZY_OP(operator*, MulOp);
+DEFINE_LAZY_OP(operator/, DivOp);
+DEFINE_LAZY_OP(min, MinOp);
+DEFINE_LAZY_OP(max, MaxOp);
+
+#undef DEFINE_LAZY_OP
+
+}  // namespace expr
+
+// make a lazy operand from a DSPVectorArray.
+template <size_t ROWS>
+inline expr::Terminal<ROWS> lazy(const DSPVectorArray<ROWS>& v)
+{
+  return expr::Terminal<ROWS>(v);
+}
+
+}  // namespace ml
@@ -0,0 +1,213 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// MLDSPFDTD.h
+// A finite difference time domain model of a vibrating membrane or plate.
+//
+// The surface is a grid of displacements with fixed edges. Each step makes the next grid from
+// the last two with a 3x3 stencil: a center, edge and corner weight for the last grid, and a
+// center and edge weight for the one before, which give frequency dependent damping.
+//
+// Each row is computed kFloatsPerSIMDVector cells at a time, in blocks of columns so that the
+// rows being read stay in cache on wide grids. The rows are divided into strips that can be
+// computed in parallel: every strip reads only the two previous grids, which no strip writes,
+// so the rows at the edges of each strip are shared directly with no copying. To run the
+// strips on a WorkerPool:
+//
+//   surface.beginStep(coeffs);
+//   pool.run(surface.getNumStrips(), FDTDSurface::stepStrip, &surface);
+//   surface.endStep();
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "MLDSPOps.h"
+
+namespace ml
+{
+class FDTDSurface
+{
+ public:
+  struct Coeffs
+  {
+    float kc{0.f}, ke{0.f}, kk{0.f};
+    float kc2{0.f}, ke2{0.f};
+  };
+
+  // columns computed together before moving to the next row.
+  static constexpr int kBlockColumns{128};
+
+  // make a surface of width x height cells, in rowsPerStrip rows per strip.
+  FDTDSurface(int width, int height, int rowsPerStrip = 16)
+      : width_(std::max(width, 1)),
+        height_(std::max(height, 1)),
+        stride_(width_ + 2),
+        rowsPerStrip_(std::max(rowsPerStrip, 1)),
+        data_(size_t(3) * stride_ * (height_ + 2), 0.f)
+  {
+    const size_t gridSize = size_t(stride_) * (height_ + 2);
+    for (int g = 0; g < 3; ++g)
+    {
+      grids_[g] = data_.data() + g * gridSize;
+    }
+  }
+
+  int getWidth() const { return width_; }
+  int getHeight() const { return height_; }
+  int getNumStrips() const { return (height_ + rowsPerStrip_ - 1) / rowsPerStrip_; }
+
+  // get coefficients for a fundamental frequency in cycles per sample, with frequency
+  // independent damping s0 and frequency dependent damping s1. The model is stable up to
+  // frequencies where waves travel one cell per step, and blows up above them.
+  Coeffs getCoeffs(float freq, float sampleRate, float s0 = 1.f, float s1 = 1.f) const
+  {
+    const float isr = 1.f / sampleRate;
+    const float size = std::sqrt(float(width_ * width_ + height_ * height_));
+    const float t = 0.6f * size * freq;
+
+    // equal energy: 4kk + 4ke + kc = 2.
+    Coeffs c;
+    c.kk = t * t * (1.f / 6.f);
+    c.ke = t * t * (2.f / 3.f);
+    c.kc = 2.f - 4.f * (c.kk + c.ke);
+
+    // adjust for frequency dependent damping, then scale everything by the independent damping.
+    const float ks1 = s1 * t * isr;
+    c.ke += ks1;
+    c.kc -= 4.f * ks1;
+    c.ke2 = -ks1;
+    c.kc2 = s0 * isr + 4.f * ks1 - 1.f;
+
+    const float sk = 1.f / (1.f + isr * s0);
+    c.kc *= sk;
+    c.ke *= sk;
+    c.kk *= sk;
+    c.kc2 *= sk;
+    c.ke2 *= sk;
+    return c;
+  }
+
+  // add to the displacement of a cell of the latest grid, which the next step reads.
+  void excite(int x, int y, float v) { cell(grids_[kLast], x, y) += v; }
+
+  // the displacement of a cell after the latest step.
+  float get(int x, int y) const { return cell(grids_[kLast], x, y); }
+
+  void clear() { std::fill(data_.begin(), data_.end(), 0.f); }
+
+  // compute the next grid.
+  void step(const Coeffs& c)
+  {
+    beginStep(c);
+    for (int s = 0; s < getNumStrips(); ++s)
+    {
+      stepStrip(this, size_t(s));
+    }
+    endStep();
+  }
+
+  // compute the next grid in parts that can run on different threads: set the coefficients,
+  // compute every strip, then make the new grid the latest.
+  void beginStep(const Coeffs& c) { coeffs_ = c; }
+
+  static void stepStrip(void* context, size_t strip)
+  {
+    auto* s = static_cast<FDTDSurface*>(context);
+    const int begin = int(strip) * s->rowsPerStrip_;
+    s->stepRows(begin, std::min(begin + s->rowsPerStrip_, s->height_));
+  }
+
+  void endStep()
+  {
+    float* oldest = grids_[kBeforeLast];
+    grids_[kBeforeLast] = grids_[kLast];
+    grids_[kLast] = grids_[kNext];
+    grids_[kNext] = oldest;
+  }
+
+ private:
+  enum
+  {
+    kNext,
+    kLast,
+    kBeforeLast
+  };
+
+  float& cell(float* grid, int x, int y) const { return grid[(y + 1) * stride_ + x + 1]; }
+  float cell(const float* grid, int x, int y) const { return grid[(y + 1) * stride_ + x + 1]; }
+
+  void stepRows(int rowBegin, int rowEnd)
+  {
+    for (int x0 = 0; x0 < width_; x0 += kBlockColumns)
+    {
+      const int x1 = std::min(x0 + kBlockColumns, width_);
+      for (int y = rowBegin; y < rowEnd; ++y)
+      {
+        stepRow(y, x0, x1);
+      }
+    }
+  }
+
+  // compute cells [x0, x1) of row y.
+  void stepRow(int y, int x0, int x1)
+  {
+    const Coeffs& c = coeffs_;
+    const float* u1 = &cell(grids_[kLast], x0, y);
+    const float* u2 = &cell(grids_[kBeforeLast], x0, y);
+    float* pOut = &cell(grids_[kNext], x0, y);
+    const float* u1Up = u1 - stride_;
+    const float* u1Down = u1 + stride_;
+    const float* u2Up = u2 - stride_;
+    const float* u2Down = u2 + stride_;
+
+    const SIMDVectorFloat kc = vecSet1(c.kc), ke = vecSet1(c.ke), kk = vecSet1(c.kk);
+    const SIMDVectorFloat kc2 = vecSet1(c.kc2), ke2 = vecSet1(c.ke2);
+    const int n = x1 - x0;
+    int i = 0;
+    for (; i + kFloatsPerSIMDVector <= n; i += kFloatsPerSIMDVector)
+    {
+      SIMDVectorFloat edges =
+          vecAdd(vecAdd(vecLoadUnaligned(u1 + i - 1), vecLoadUnaligned(u1 + i + 1)),
+                 vecAdd(vecLoadUnaligned(u1Up + i), vecLoadUnaligned(u1Down + i)));
+      SIMDVectorFloat corners =
+          vecAdd(vecAdd(vecLoadUnaligned(u1Up + i - 1), vecLoadUnaligned(u1Up + i + 1)),
+                 vecAdd(vecLoadUnaligned(u1Down + i - 1), vecLoadUnaligned(u1Down + i + 1)));
+      SIMDVectorFloat edges2 =
+          vecAdd(vecAdd(vecLoadUnaligned(u2 + i - 1), vecLoadUnaligned(u2 + i + 1)),
+                 vecAdd(vecLoadUnaligned(u2Up + i), vecLoadUnaligned(u2Down + i)));
+      SIMDVectorFloat f = vecMul(kc, vecLoadUnaligned(u1 + i));
+      f = vecAdd(f, vecMul(ke, edges));
+      f = vecAdd(f, vecMul(kk, corners));
+      f = vecAdd(f, vecMul(kc2, vecLoadUnaligned(u2 + i)));
+      f = vecAdd(f, vecMul(ke2, edges2));
+      vecStoreUnaligned(pOut + i, f);
+    }
+
+    // cells left over after the last whole SIMD vector.
+    for (; i < n; ++i)
+    {
+      float f = c.kc * u1[i];
+      f += c.ke * (u1[i - 1] + u1[i + 1] + u1Up[i] + u1Down[i]);
+      f += c.kk * (u1Up[i - 1] + u1Up[i + 1] + u1Down[i - 1] + u1Down[i + 1]);
+      f += c.kc2 * u2[i];
+      f += c.ke2 * (u2[i - 1] + u2[i + 1] + u2Up[i] + u2Down[i]);
+      pOut[i] = f;
+    }
+  }
+
+  int width_;
+  int height_;
+
+  // each grid has a row and column of fixed zeros around it.
+  int stride_;
+  int rowsPerStrip_;
+  std::vector<float> data_;
+  float* grids_[3];
+  Coeffs coeffs_;
+};
+
+}  // namespace ml
@@ -18,9 +18,14 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cstring>
 #include <vector>
 
+#include "MLDSPLargeBuffer.h"
 #include "MLDSPOps.h"
+#include "MLDSPSampleStorage.h"
 #include "MLDSPScalarMath.h"
 #include <cmath>
 
@@ -43,6 +48,120 @@ DSPVectorArray<COEFFS_SIZE> interpolateCoeffsLinear(const std::array<float, COEF
   return vy;
 }
 
+// tan(pi * omega) for omega in [0, 0.5), as used to prewarp the cutoffs of
+// filters. A rational approximation is used up to omega = 0.25, and above that
+// the reciprocal of the approximation at 0.5 - omega. The relative error is
+// below 3e-6.
+inline float tanPiApprox(float omega)
+{
+  const bool upper = omega > 0.25f;
+  const float x = kPi * (upper ? 0.5f - omega : omega);
+  const float x2 = x * x;
+  const float t = x * (105.f - 10.f * x2) / (105.f + x2 * (x2 - 45.f));
+  return upper ? 1.f / t : t;
+}
+
+inline SIMDVectorFloat vecTanPiApprox(SIMDVectorFloat omega)
+{
+  const SIMDVectorFloat kQuarter = vecSet1(0.25f);
+  SIMDVectorFloat upper = vecGreaterThan(omega, kQuarter);
+  SIMDVectorFloat x = vecMul(vecSet1(kPi), vecSelect(vecSub(vecSet1(0.5f), omega), omega, upper));
+  SIMDVectorFloat x2 = vecMul(x, x);
+  SIMDVectorFloat num = vecMul(x, vecSub(vecSet1(105.f), vecMul(vecSet1(10.f), x2)));
+  SIMDVectorFloat den = vecAdd(vecSet1(105.f), vecMul(x2, vecSub(x2, vecSet1(45.f))));
+  return vecSelect(vecDiv(den, num), vecDiv(num, den), upper);
+}
+
+DEFINE_OP1(tanPiApprox, vecTanPiApprox(x));
+
+// CoeffsCache: remembers the coefficients made for recently used parameters,
+// for filters whose parameters change often but repeat, like those of voices
+// playing notes. Up to three parameters, such as omega, k and A, are quantized
+// by rounding off the low bits of their mantissas, so that nearby values share
+// an entry. The coefficients are always made from the quantized values, so the
+// results don't depend on what is in the cache. The cache is direct mapped
+// with SIZE entries, and a miss replaces whatever was in its slot.
+//
+// Usage:
+//   CoeffsCache<Bell::Coeffs> cache;
+//   bell.coeffs = cache.get(omega, k, A, [](float w, float k, float A) {
+//     return Bell::makeCoeffs(w, k, A); });
+
+template <typename Coeffs, size_t SIZE = 512>
+class CoeffsCache
+{
+  static_assert((SIZE & (SIZE - 1)) == 0, "CoeffsCache size must be a power of two.");
+
+ public:
+  // keeping 8 bits of the mantissa makes steps of at most 0.4%, or about 0.07
+  // semitone in frequency.
+  explicit CoeffsCache(int mantissaBits = 8)
+  {
+    const int dropBits = std::clamp(23 - mantissaBits, 1, 23);
+    roundingBit_ = 1u << (dropBits - 1);
+    keepMask_ = ~((1u << dropBits) - 1u);
+  }
+
+  template <typename MakeFn>
+  Coeffs get(float p0, float p1, float p2, MakeFn makeFn)
+  {
+    const uint32_t q0 = quantize(p0), q1 = quantize(p1), q2 = quantize(p2);
+    const uint32_t h = (q0 * 0x9E3779B1u) ^ (q1 * 0x85EBCA77u) ^ (q2 * 0xC2B2AE3Du);
+    Entry& e = entries_[(h ^ (h >> 16)) & (SIZE - 1)];
+    if (e.valid && (e.q0 == q0) && (e.q1 == q1) && (e.q2 == q2))
+    {
+      hits_++;
+      return e.coeffs;
+    }
+    misses_++;
+    e = Entry{q0, q1, q2, true, makeFn(toFloat(q0), toFloat(q1), toFloat(q2))};
+    return e.coeffs;
+  }
+
+  template <typename MakeFn>
+  Coeffs get(float p0, float p1, MakeFn makeFn)
+  {
+    return get(p0, p1, 0.f, [&](float a, float b, float) { return makeFn(a, b); });
+  }
+
+  void clear()
+  {
+    for (auto& e : entries_) e.valid = false;
+    hits_ = misses_ = 0;
+  }
+
+  size_t getHits() const { return hits_; }
+  size_t getMisses() const { return misses_; }
+
+ private:
+  struct Entry
+  {
+    uint32_t q0{0}, q1{0}, q2{0};
+    bool valid{false};
+    Coeffs coeffs{};
+  };
+
+  uint32_t quantize(float x) const
+  {
+    uint32_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    return (bits + roundingBit_) & keepMask_;
+  }
+
+  static float toFloat(uint32_t bits)
+  {
+    float x;
+    std::memcpy(&x, &bits, sizeof(x));
+    return x;
+  }
+
+  uint32_t roundingBit_;
+  uint32_t keepMask_;
+  size_t hits_{0};
+  size_t misses_{0};
+  std::array<Entry, SIZE> entries_{};
+};
+
 
 // --------------------------------------------------------------------------------
 // utility filters implemented as SVF variations
@@ -62,6 +181,9 @@ struct Lopass
   Coeffs coeffs{};
   State state{};
 
+  // the parameters of coeffs when they were last made from uniform signals.
+  Params coeffsParams{-1.f, -1.f};
+
   inline void clear() { state.fill(0.f); }
 
   // template<typename T> T lopassCalc(T x)
@@ -88,20 +210,17 @@ struct Lopass
   static CoeffsVec makeCoeffsVec(DSPVector omega, DSPVector k)
   {
     CoeffsVec vy;
-    // TODO SIMD
     omega = min(omega, DSPVector(0.5f));
     k = max(k, DSPVector(0.01f));
 
-    for (int n = 0; n < kFloatsPerDSPVector; ++n)
-    {
-      float piOmega = kPi * omega[n];
-      float s1 = sinf(piOmega);
-      float s2 = sinf(2.0f * piOmega);
-      float nrm = 1.0f / (2.f + k[n] * s2);
-      vy.row(g0)[n] = s2 * nrm;
-      vy.row(g1)[n] = (-2.f * s1 * s1 - k[n] * s2) * nrm;
-      vy.row(g2)[n] = (2.0f * s1 * s1) * nrm;
-    }
+    DSPVector piOmega = omega * DSPVector(kPi);
+    DSPVector s1 = sin(piOmega);
+    DSPVector s2 = sin(piOmega * DSPVector(2.f));
+    DSPVector nrm = DSPVector(1.f) / (DSPVector(2.f) + k * s2);
+    DSPVector s1Squared2 = DSPVector(2.f) * s1 * s1;
+    vy.row(g0) = s2 * nrm;
+    vy.row(g1) = (DSPVector(0.f) - s1Squared2 - k * s2) * nrm;
+    vy.row(g2) = s1Squared2 * nrm;
     return vy;
   }
 
@@ -124,9 +243,22 @@ struct Lopass
   }
 
   // filter the input vector vx with the coefficients generated from parameters omega and k.
+  // When omega and k are uniform over the vector, the coefficients are made once and kept in
+  // coeffs, and are only made again when the parameters change.
   // TODO const DSPVectorArray< nCoeffs >
   DSPVector operator()(const DSPVector vx, const DSPVector omega, const DSPVector k)
   {
+    if (isUniform(omega) && isUniform(k))
+    {
+      const Params p{std::min(omega[0], 0.5f), std::max(k[0], 0.01f)};
+      if (p != coeffsParams)
+      {
+        coeffs = makeCoeffs(p[0], p[1]);
+        coeffsParams = p;
+      }
+      return operator()(vx);
+    }
+
     DSPVector vy;
     auto vc = makeCoeffsVec(omega, k);
     for (int n = 0; n < kFloatsPerDSPVector; ++n)
@@ -433,6 +565,552 @@ class Bell
   }
 };
 
+// SVFBank: a bank of ROWS independent state variable filters, one per row of
+// the input. The filters are stored as structures of arrays and run across
+// SIMD lanes, kFloatsPerSIMDVector voices at a time. Each voice can have its
+// own type and coefficients, using the general form of Andrew Simper's SVF:
+// y = m0 * v0 + m1 * v1 + m2 * v2.
+
+template <size_t ROWS>
+class SVFBank
+{
+ public:
+  enum coeffNames
+  {
+    a1,
+    a2,
+    a3,
+    m0,
+    m1,
+    m2,
+    nCoeffs
+  };
+  typedef std::array<float, nCoeffs> Coeffs;
+
+  // coefficients for each filter type from omega, k and, for the peaking and
+  // shelving filters, a gain A.
+  static Coeffs lopassCoeffs(float omega, float k)
+  {
+    return makeCoeffs(tanf(kPi * omega), k, 0, 0, 1);
+  }
+
+  static Coeffs hipassCoeffs(float omega, float k)
+  {
+    return makeCoeffs(tanf(kPi * omega), k, 1, -k, -1);
+  }
+
+  static Coeffs bandpassCoeffs(float omega, float k)
+  {
+    return makeCoeffs(tanf(kPi * omega), k, 0, 1, 0);
+  }
+
+  static Coeffs bellCoeffs(float omega, float k, float A)
+  {
+    float kc = k / A;
+    return makeCoeffs(tanf(kPi * omega), kc, 1, kc * (A * A - 1.f), 0);
+  }
+
+  static Coeffs loShelfCoeffs(float omega, float k, float A)
+  {
+    return makeCoeffs(tanf(kPi * omega) / sqrtf(A), k, 1, k * (A - 1.f), A * A - 1.f);
+  }
+
+  static Coeffs hiShelfCoeffs(float omega, float k, float A)
+  {
+    return makeCoeffs(tanf(kPi * omega) * sqrtf(A), k, A * A, k * (1.f - A) * A, 1.f - A * A);
+  }
+
+  void setCoeffs(size_t voice, const Coeffs& c)
+  {
+    for (int i = 0; i < nCoeffs; ++i)
+    {
+      coeffs_[i][voice] = c[i];
+    }
+  }
+
+  enum filterTypes
+  {
+    lopass,
+    hipass,
+    bandpass,
+    bell,
+    loShelf,
+    hiShelf
+  };
+
+  // set the coefficients of all the filters to one type at once, from an omega,
+  // k and A for each voice. This runs across SIMD lanes like the filters, with
+  // tanPiApprox() for the prewarp, so it is much cheaper than setCoeffs() for
+  // each voice when the parameters are modulated. A is only used by bell and
+  // shelving filters.
+  void setAllCoeffs(filterTypes type, const std::array<float, ROWS>& omega,
+                    const std::array<float, ROWS>& k, const std::array<float, ROWS>& A)
+  {
+    std::array<float, kPaddedRows> pOmega{}, pK{}, pA;
+    pA.fill(1.f);
+    std::copy(omega.begin(), omega.end(), pOmega.begin());
+    std::copy(k.begin(), k.end(), pK.begin());
+    std::copy(A.begin(), A.end(), pA.begin());
+
+    const SIMDVectorFloat zero = vecZeros();
+    const SIMDVectorFloat one = vecSet1(1.f);
+    for (size_t firstVoice = 0; firstVoice < kPaddedRows; firstVoice += kLanes)
+    {
+      SIMDVectorFloat vOmega = vecMin(vecLoadUnaligned(&pOmega[firstVoice]), vecSet1(0.499f));
+      SIMDVectorFloat g = vecTanPiApprox(vOmega);
+      SIMDVectorFloat vk = vecLoadUnaligned(&pK[firstVoice]);
+      SIMDVectorFloat vA = vecLoadUnaligned(&pA[firstVoice]);
+      SIMDVectorFloat vA2 = vecMul(vA, vA);
+      SIMDVectorFloat mix0{zero}, mix1{zero}, mix2{zero};
+      switch (type)
+      {
+        case lopass:
+          mix2 = one;
+          break;
+        case hipass:
+          mix0 = one;
+          mix1 = vecSub(zero, vk);
+          mix2 = vecSub(zero, one);
+          break;
+        case bandpass:
+          mix1 = one;
+          break;
+        case bell:
+          vk = vecDiv(vk, vA);
+          mix0 = one;
+          mix1 = vecMul(vk, vecSub(vA2, one));
+          break;
+        case loShelf:
+          g = vecDiv(g, vecSqrt(vA));
+          mix0 = one;
+          mix1 = vecMul(vk, vecSub(vA, one));
+          mix2 = vecSub(vA2, one);
+          break;
+        case hiShelf:
+          g = vecMul(g, vecSqrt(vA));
+          mix0 = vA2;
+          mix1 = vecMul(vecMul(vk, vecSub(one, vA)), vA);
+          mix2 = vecSub(one, vA2);
+          break;
+      }
+      SIMDVectorFloat va1 = vecDiv(one, vecAdd(one, vecMul(g, vecAdd(g, vk))));
+      SIMDVectorFloat va2 = vecMul(g, va1);
+      vecStoreUnaligned(&coeffs_[a1][firstVoice], va1);
+      vecStoreUnaligned(&coeffs_[a2][firstVoice], va2);
+      vecStoreUnaligned(&coeffs_[a3][firstVoice], vecMul(g, va2));
+      vecStoreUnaligned(&coeffs_[m0][firstVoice], mix0);
+      vecStoreUnaligned(&coeffs_[m1][firstVoice], mix1);
+      vecStoreUnaligned(&coeffs_[m2][firstVoice], mix2);
+    }
+
+    // keep the unused lanes silent.
+    for (auto& c : coeffs_)
+    {
+      std::fill(c.begin() + ROWS, c.end(), 0.f);
+    }
+  }
+
+  void clear()
+  {
+    ic1eq_.fill(0.f);
+    ic2eq_.fill(0.f);
+  }
+
+  DSPVectorArray<ROWS> operator()(const DSPVectorArray<ROWS>& vx)
+  {
+    // one voice per lane, filtered in place.
+    LaneInterleaved<ROWS> lanes(vx);
+
+    for (size_t group = 0; group < kGroups; ++group)
+    {
+      const size_t firstVoice = group * kLanes;
+
+      SIMDVectorFloat va1 = vecLoadUnaligned(&coeffs_[a1][firstVoice]);
+      SIMDVectorFloat va2 = vecLoadUnaligned(&coeffs_[a2][firstVoice]);
+      SIMDVectorFloat va3 = vecLoadUnaligned(&coeffs_[a3][firstVoice]);
+      SIMDVectorFloat vm0 = vecLoadUnaligned(&coeffs_[m0][firstVoice]);
+      SIMDVectorFloat vm1 = vecLoadUnaligned(&coeffs_[m1][firstVoice]);
+      SIMDVectorFloat vm2 = vecLoadUnaligned(&coeffs_[m2][firstVoice]);
+      SIMDVectorFloat ic1 = vecLoadUnaligned(&ic1eq_[firstVoice]);
+      SIMDVectorFloat ic2 = vecLoadUnaligned(&ic2eq_[firstVoice]);
+
+      float* pSample = lanes.getGroup(group);
+      for (int n = 0; n < kFloatsPerDSPVector; ++n)
+      {
+        SIMDVectorFloat v0 = vecLoad(pSample);
+        SIMDVectorFloat v3 = vecSub(v0, ic2);
+        SIMDVectorFloat v1 = vecAdd(vecMul(va1, ic1), vecMul(va2, v3));
+        SIMDVectorFloat v2 = vecAdd(ic2, vecAdd(vecMul(va2, ic1), vecMul(va3, v3)));
+        ic1 = vecSub(vecAdd(v1, v1), ic1);
+        ic2 = vecSub(vecAdd(v2, v2), ic2);
+        vecStore(pSample, vecAdd(vecMul(vm0, v0), vecAdd(vecMul(vm1, v1), vecMul(vm2, v2))));
+        pSample += kLanes;
+      }
+
+      vecStoreUnaligned(&ic1eq_[firstVoice], ic1);
+      vecStoreUnaligned(&ic2eq_[firstVoice], ic2);
+    }
+    return lanes.toRows();
+  }
+
+ private:
+  static constexpr size_t kLanes = kFloatsPerSIMDVector;
+  static constexpr size_t kGroups = (ROWS + kLanes - 1) / kLanes;
+  static constexpr size_t kPaddedRows = kGroups * kLanes;
+
+  static Coeffs makeCoeffs(float g, float k, float mix0, float mix1, float mix2)
+  {
+    Coeffs r;
+    r[a1] = 1.f / (1.f + g * (g + k));
+    r[a2] = g * r[a1];
+    r[a3] = g * r[a2];
+    r[m0] = mix0;
+    r[m1] = mix1;
+    r[m2] = mix2;
+    return r;
+  }
+
+  // unused lanes in the last group have zero coefficients and output zero.
+  std::array<std::array<float, kPaddedRows>, nCoeffs> coeffs_{};
+  std::array<float, kPaddedRows> ic1eq_{};
+  std::array<float, kPaddedRows> ic2eq_{};
+};
+
+// BlockSVF: a single state variable filter using the general coefficients of
+// SVFBank. While the coefficients are constant, it is evaluated with a
+// look-ahead state space formulation, kFloatsPerSIMDVector samples at a time,
+// which shortens the serial dependency chain of the recursion by that factor.
+// When new coefficients are set, they are interpolated linearly over the next
+// DSPVector so that modulated cutoffs don't make zipper noise.
+
+class BlockSVF
+{
+ public:
+  typedef SVFBank<1>::Coeffs Coeffs;
+
+  // set new coefficients, to be reached by the end of the next DSPVector.
+  void setCoeffs(const Coeffs& c)
+  {
+    if (c != target_)
+    {
+      target_ = c;
+      interpolating_ = true;
+    }
+  }
+
+  // set new coefficients without interpolating.
+  void jumpCoeffs(const Coeffs& c)
+  {
+    coeffs_ = target_ = c;
+    interpolating_ = false;
+    makeBlockMatrices();
+  }
+
+  void clear()
+  {
+    ic1eq_ = 0.f;
+    ic2eq_ = 0.f;
+  }
+
+  DSPVector operator()(const DSPVector vx)
+  {
+    return interpolating_ ? processInterpolated(vx) : processBlock(vx);
+  }
+
+ private:
+  enum coeffNames
+  {
+    a1 = SVFBank<1>::a1,
+    a2 = SVFBank<1>::a2,
+    a3 = SVFBank<1>::a3,
+    m0 = SVFBank<1>::m0,
+    m1 = SVFBank<1>::m1,
+    m2 = SVFBank<1>::m2,
+    nCoeffs = SVFBank<1>::nCoeffs
+  };
+  static constexpr int kLanes = kFloatsPerSIMDVector;
+
+  // per-sample recursion with the coefficients moving linearly from
+  // their current values to the target.
+  DSPVector processInterpolated(const DSPVector vx)
+  {
+    DSPVector vy;
+    Coeffs c = coeffs_;
+    Coeffs dc;
+    for (int i = 0; i < nCoeffs; ++i)
+    {
+      dc[i] = (target_[i] - coeffs_[i]) / kFloatsPerDSPVector;
+    }
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      for (int i = 0; i < nCoeffs; ++i)
+      {
+        c[i] += dc[i];
+      }
+      float v0 = vx[n];
+      float v3 = v0 - ic2eq_;
+      float v1 = c[a1] * ic1eq_ + c[a2] * v3;
+      float v2 = ic2eq_ + c[a2] * ic1eq_ + c[a3] * v3;
+      ic1eq_ = 2 * v1 - ic1eq_;
+      ic2eq_ = 2 * v2 - ic2eq_;
+      vy[n] = c[m0] * v0 + c[m1] * v1 + c[m2] * v2;
+    }
+    coeffs_ = target_;
+    interpolating_ = false;
+    makeBlockMatrices();
+    return vy;
+  }
+
+  // with state s = (ic1eq, ic2eq), each sample is s' = As + Bx, y = Cs + Dx.
+  // a block of kLanes outputs is a linear function of s and the block's inputs.
+  DSPVector processBlock(const DSPVector vx)
+  {
+    DSPVector vy;
+    const float* px = vx.getConstBuffer();
+    float* py = vy.getBuffer();
+
+    const SIMDVectorFloat vcs0 = vecLoadUnaligned(cs0_.data());
+    const SIMDVectorFloat vcs1 = vecLoadUnaligned(cs1_.data());
+    const SIMDVectorFloat vp0 = vecLoadUnaligned(p0_.data());
+    const SIMDVectorFloat vp1 = vecLoadUnaligned(p1_.data());
+
+    for (int n = 0; n < kSIMDVectorsPerDSPVector; ++n)
+    {
+      SIMDVectorFloat y = vecAdd(vecMul(vcs0, vecSet1(ic1eq_)), vecMul(vcs1, vecSet1(ic2eq_)));
+      for (int j = 0; j < kLanes; ++j)
+      {
+        y = vecAdd(y, vecMul(vecLoadUnaligned(h_[j].data()), vecSet1(px[j])));
+      }
+      vecStore(py, y);
+
+      SIMDVectorFloat x = vecLoad(px);
+      float s0 = aL_[0] * ic1eq_ + aL_[1] * ic2eq_ + vecSumH(vecMul(vp0, x));
+      float s1 = aL_[2] * ic1eq_ + aL_[3] * ic2eq_ + vecSumH(vecMul(vp1, x));
+      ic1eq_ = s0;
+      ic2eq_ = s1;
+
+      px += kLanes;
+      py += kLanes;
+    }
+    return vy;
+  }
+
+  void makeBlockMatrices()
+  {
+    const Coeffs& c = coeffs_;
+    const float A00 = 2.f * c[a1] - 1.f, A01 = -2.f * c[a2];
+    const float A10 = 2.f * c[a2], A11 = 1.f - 2.f * c[a3];
+    const float B0 = 2.f * c[a2], B1 = 2.f * c[a3];
+    const float D = c[m0] + c[m1] * c[a2] + c[m2] * c[a3];
+
+    // C A^i, and the impulse response h[0] = D, h[i + 1] = C A^i B
+    std::array<float, kLanes> h;
+    h[0] = D;
+    float r0 = c[m1] * c[a1] + c[m2] * c[a2];
+    float r1 = -c[m1] * c[a2] + c[m2] * (1.f - c[a3]);
+    for (int i = 0; i < kLanes; ++i)
+    {
+      cs0_[i] = r0;
+      cs1_[i] = r1;
+      if (i + 1 < kLanes) h[i + 1] = r0 * B0 + r1 * B1;
+      float t0 = r0 * A00 + r1 * A10;
+      float t1 = r0 * A01 + r1 * A11;
+      r0 = t0;
+      r1 = t1;
+    }
+
+    // h_[j] holds the response at each output lane to the input at lane j.
+    for (int j = 0; j < kLanes; ++j)
+    {
+      for (int i = 0; i < kLanes; ++i)
+      {
+        h_[j][i] = (i >= j) ? h[i - j] : 0.f;
+      }
+    }
+
+    // state update: contribution of input j is A^(kLanes - 1 - j) B
+    float q0 = B0, q1 = B1;
+    for (int k = 0; k < kLanes; ++k)
+    {
+      p0_[kLanes - 1 - k] = q0;
+      p1_[kLanes - 1 - k] = q1;
+      float t0 = A00 * q0 + A01 * q1;
+      float t1 = A10 * q0 + A11 * q1;
+      q0 = t0;
+      q1 = t1;
+    }
+
+    // A^kLanes
+    float m00 = 1.f, m01 = 0.f, m10 = 0.f, m11 = 1.f;
+    for (int k = 0; k < kLanes; ++k)
+    {
+      float t00 = A00 * m00 + A01 * m10, t01 = A00 * m01 + A01 * m11;
+      float t10 = A10 * m00 + A11 * m10, t11 = A10 * m01 + A11 * m11;
+      m00 = t00;
+      m01 = t01;
+      m10 = t10;
+      m11 = t11;
+    }
+    aL_ = {m00, m01, m10, m11};
+  }
+
+  Coeffs coeffs_{};
+  Coeffs target_{};
+  bool interpolating_{false};
+  float ic1eq_{0};
+  float ic2eq_{0};
+
+  std::array<float, kLanes> cs0_{};
+  std::array<float, kLanes> cs1_{};
+  std::array<float, kLanes> p0_{};
+  std::array<float, kLanes> p1_{};
+  std::array<std::array<float, kLanes>, kLanes> h_{};
+  std::array<float, 4> aL_{};
+};
+
+// ModalBank: a bank of two-pole resonators (modes) all driven by the same input,
+// with their outputs summed. Each mode has a frequency, a decay time and a gain,
+// stored as structures of arrays like SVFBank so that kFloatsPerSIMDVector modes
+// run at once across SIMD lanes. The modes are summed lane by lane as they run,
+// and across the lanes only once per sample, so each group of lanes costs a few
+// SIMD operations per sample however many modes there are.
+//
+// Setting a mode marks its group of lanes, and the coefficients of all the marked
+// groups are recomputed with SIMD math at the start of the next operator().
+// setNumModes() allocates, so it should not be called on the audio thread.
+
+class ModalBank
+{
+ public:
+  ModalBank() = default;
+  explicit ModalBank(size_t modes) { setNumModes(modes); }
+
+  // set the number of modes, all starting silent.
+  void setNumModes(size_t modes)
+  {
+    modes_ = modes;
+    groups_ = (modes + kLanes - 1) / kLanes;
+    const size_t padded = groups_ * kLanes;
+    for (auto* v : {&omega_, &t60_, &gain_, &a_, &b1_, &b2_, &y1_, &y2_})
+    {
+      v->assign(padded, 0.f);
+    }
+    dirty_.assign(groups_, true);
+    anyDirty_ = true;
+  }
+
+  size_t getNumModes() const { return modes_; }
+
+  // set a mode from its frequency in cycles per sample, its time to decay by 60dB in
+  // samples and its gain, which is the starting amplitude of its impulse response.
+  void setMode(size_t i, float omega, float t60, float gain)
+  {
+    if (i >= modes_) return;
+    omega_[i] = omega;
+    t60_[i] = t60;
+    gain_[i] = gain;
+    dirty_[i / kLanes] = true;
+    anyDirty_ = true;
+  }
+
+  // set the first n modes from arrays of the same parameters.
+  void setModes(const float* omega, const float* t60, const float* gain, size_t n)
+  {
+    n = std::min(n, modes_);
+    std::copy(omega, omega + n, omega_.begin());
+    std::copy(t60, t60 + n, t60_.begin());
+    std::copy(gain, gain + n, gain_.begin());
+    std::fill(dirty_.begin(), dirty_.begin() + (n + kLanes - 1) / kLanes, true);
+    anyDirty_ = true;
+  }
+
+  void clear()
+  {
+    std::fill(y1_.begin(), y1_.end(), 0.f);
+    std::fill(y2_.begin(), y2_.end(), 0.f);
+  }
+
+  DSPVector operator()(const DSPVector vx)
+  {
+    if (anyDirty_) updateCoeffs();
+
+    // each input sample across the lanes, and the sums of the modes by lane. Sample n is at
+    // [n * kLanes].
+    float* pIn = input_.getBuffer();
+    float* pSum = sums_.getBuffer();
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      vecStore(pIn + n * kLanes, vecSet1(vx[n]));
+      vecStore(pSum + n * kLanes, vecZeros());
+    }
+
+    for (size_t first = 0; first < groups_ * kLanes; first += kLanes)
+    {
+      const SIMDVectorFloat va = vecLoadUnaligned(&a_[first]);
+      const SIMDVectorFloat vb1 = vecLoadUnaligned(&b1_[first]);
+      const SIMDVectorFloat vb2 = vecLoadUnaligned(&b2_[first]);
+      SIMDVectorFloat y1 = vecLoadUnaligned(&y1_[first]);
+      SIMDVectorFloat y2 = vecLoadUnaligned(&y2_[first]);
+      for (int n = 0; n < kFloatsPerDSPVector; ++n)
+      {
+        SIMDVectorFloat y = vecAdd(vecMul(va, vecLoad(pIn + n * kLanes)),
+                                   vecAdd(vecMul(vb1, y1), vecMul(vb2, y2)));
+        y2 = y1;
+        y1 = y;
+        vecStore(pSum + n * kLanes, vecAdd(vecLoad(pSum + n * kLanes), y));
+      }
+      vecStoreUnaligned(&y1_[first], y1);
+      vecStoreUnaligned(&y2_[first], y2);
+    }
+
+    DSPVector vy;
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      vy[n] = vecSumH(vecLoad(pSum + n * kLanes));
+    }
+    return vy;
+  }
+
+ private:
+  static constexpr size_t kLanes = kFloatsPerSIMDVector;
+
+  // y[n] = a x[n] + b1 y[n - 1] + b2 y[n - 2], with poles at r e^(+-i w). Scaling the input by
+  // sin(w) makes the impulse response gain r^n sin((n + 1) w).
+  void updateCoeffs()
+  {
+    const SIMDVectorFloat vLog1000 = vecSet1(6.9077553f);
+    const SIMDVectorFloat vMinT60 = vecSet1(1e-3f);
+    for (size_t g = 0; g < groups_; ++g)
+    {
+      if (!dirty_[g]) continue;
+      const size_t first = g * kLanes;
+      SIMDVectorFloat omega = vecLoadUnaligned(&omega_[first]);
+      SIMDVectorFloat w = vecMul(vecSet1(kTwoPi), vecClamp(omega, vecZeros(), vecSet1(0.5f)));
+      SIMDVectorFloat t60 = vecMax(vecLoadUnaligned(&t60_[first]), vMinT60);
+      SIMDVectorFloat r = vecExp(vecDiv(vecSub(vecZeros(), vLog1000), t60));
+      vecStoreUnaligned(&a_[first], vecMul(vecLoadUnaligned(&gain_[first]), vecSin(w)));
+      vecStoreUnaligned(&b1_[first], vecMul(vecAdd(r, r), vecCos(w)));
+      vecStoreUnaligned(&b2_[first], vecSub(vecZeros(), vecMul(r, r)));
+      dirty_[g] = false;
+    }
+    anyDirty_ = false;
+  }
+
+  size_t modes_{0};
+  size_t groups_{0};
+
+  // parameters and coefficients of each mode, padded to a whole number of groups. The
+  // padding has zero gain and stays silent.
+  std::vector<float> omega_, t60_, gain_;
+  std::vector<float> a_, b1_, b2_;
+  std::vector<float> y1_, y2_;
+  std::vector<bool> dirty_;
+  bool anyDirty_{false};
+
+  DSPVectorArray<kLanes> input_;
+  DSPVectorArray<kLanes> sums_;
+};
+
 // A one pole filter. see https://ccrma.stanford.edu/~jos/fp/One_Pole.html
 
 struct OnePole
@@ -644,9 +1322,268 @@ class RMS
   }
 };
 
-// ADSR envelope triggered and scaled by a single gate + amp signal.
+// MeterBank: peak, RMS and optional loudness meters for ROWS channels, run
+// across SIMD lanes kFloatsPerSIMDVector channels at a time like SVFBank.
+// Readings are made once per interval of whole DSPVectors, so that displays
+// can be fed at a decimated rate: the peak is the largest absolute value over
+// the interval, and the RMS is that of a one-pole average at its end.
+//
+// With loudness on, each channel is K-weighted as in ITU-R BS.1770 and its
+// mean square is taken over blocks of 100 ms, rounded to whole DSPVectors. The
+// momentary and short-term loudness are the means of the last 4 and 30 blocks
+// in LUFS, updated at the end of each block. Each channel is measured as its
+// own program. The loudness of a group of channels is loudnessFromMeanSquare()
+// of the sum of their mean squares.
+//
+// setSampleRate() must be called before use. Nothing here allocates.
 
-struct ADSR
+template <size_t ROWS>
+class MeterBank
+{
+ public:
+  static constexpr size_t kMomentaryBlocks = 4;
+  static constexpr size_t kShortTermBlocks = 30;
+
+  static float loudnessFromMeanSquare(float ms)
+  {
+    return -0.691f + 10.f * log10f(std::max(ms, 1e-12f));
+  }
+
+  void setSampleRate(float sr)
+  {
+    sampleRate_ = sr;
+    blockVectors_ = std::max(1, int(0.1f * sr / kFloatsPerDSPVector + 0.5f));
+    setRMSTime(rmsTime_);
+    makeKWeightingCoeffs(sr);
+    clear();
+  }
+
+  // the time constant of the RMS average.
+  void setRMSTime(float seconds)
+  {
+    rmsTime_ = seconds;
+    float x = expf(-1.f / (seconds * sampleRate_));
+    rmsA0_ = 1.f - x;
+    rmsB1_ = x;
+  }
+
+  // the number of DSPVectors between peak and RMS readings.
+  void setInterval(size_t vectors) { interval_ = std::max(size_t(1), vectors); }
+
+  void setLoudnessEnabled(bool b)
+  {
+    if (b != loudness_) clear();
+    loudness_ = b;
+  }
+
+  void clear()
+  {
+    peakSum_.fill(0.f);
+    rmsState_.fill(0.f);
+    for (auto& s : kState_) s.fill(0.f);
+    blockSum_.fill(0.f);
+    for (auto& b : blocks_) b.fill(0.f);
+    peak_.fill(0.f);
+    rms_.fill(0.f);
+    momentary_.fill(0.f);
+    shortTerm_.fill(0.f);
+    intervalCount_ = 0;
+    blockCount_ = 0;
+    blockIndex_ = 0;
+  }
+
+  // meter one DSPVector of each channel. Returns true if new peak and RMS
+  // readings are ready.
+  bool operator()(const DSPVectorArray<ROWS>& vx)
+  {
+    // one channel per lane. Unused lanes are zero.
+    LaneInterleaved<ROWS> lanes(vx);
+
+    for (size_t group = 0; group < kGroups; ++group)
+    {
+      const size_t firstRow = group * kLanes;
+      const float* pBuf = lanes.getConstGroup(group);
+
+      const SIMDVectorFloat a0 = vecSet1(rmsA0_);
+      const SIMDVectorFloat b1 = vecSet1(rmsB1_);
+      SIMDVectorFloat peak = vecLoadUnaligned(&peakSum_[firstRow]);
+      SIMDVectorFloat rms = vecLoadUnaligned(&rmsState_[firstRow]);
+      const float* pSample = pBuf;
+      for (int n = 0; n < kFloatsPerDSPVector; ++n)
+      {
+        SIMDVectorFloat x = vecLoad(pSample);
+        peak = vecMax(peak, vecAbs(x));
+        rms = vecAdd(vecMul(a0, vecMul(x, x)), vecMul(b1, rms));
+        pSample += kLanes;
+      }
+      vecStoreUnaligned(&peakSum_[firstRow], peak);
+      vecStoreUnaligned(&rmsState_[firstRow], rms);
+
+      if (loudness_) kWeightGroup(pBuf, firstRow);
+    }
+
+    if (loudness_ && (++blockCount_ == blockVectors_)) endBlock();
+
+    if (++intervalCount_ < interval_) return false;
+    intervalCount_ = 0;
+    for (size_t i = 0; i < ROWS; ++i)
+    {
+      peak_[i] = peakSum_[i];
+      rms_[i] = sqrtf(rmsState_[i]);
+    }
+    peakSum_.fill(0.f);
+    return true;
+  }
+
+  float getPeak(size_t row) const { return peak_[row]; }
+  float getRMS(size_t row) const { return rms_[row]; }
+
+  // the K-weighted mean squares of the windows, and their loudness in LUFS.
+  float getMomentaryMeanSquare(size_t row) const { return momentary_[row]; }
+  float getShortTermMeanSquare(size_t row) const { return shortTerm_[row]; }
+  float getMomentaryLoudness(size_t row) const { return loudnessFromMeanSquare(momentary_[row]); }
+  float getShortTermLoudness(size_t row) const { return loudnessFromMeanSquare(shortTerm_[row]); }
+
+ private:
+  static constexpr size_t kLanes = kFloatsPerSIMDVector;
+  static constexpr size_t kGroups = (ROWS + kLanes - 1) / kLanes;
+  static constexpr size_t kPaddedRows = kGroups * kLanes;
+  typedef std::array<float, kPaddedRows> Row;
+
+  enum kWeightingCoeffNames
+  {
+    shelfB0,
+    shelfB1,
+    shelfB2,
+    shelfA1,
+    shelfA2,
+    hipassA1,
+    hipassA2,
+    nKCoeffs
+  };
+
+  // the BS.1770 pre-filter, a high shelf, and RLB filter, a high pass, as
+  // biquads designed for the sample rate.
+  void makeKWeightingCoeffs(float sr)
+  {
+    double K = std::tan(kPi * 1681.974450955533 / sr);
+    double Q = 0.7071752369554196;
+    double Vh = std::pow(10.0, 3.999843853973347 / 20.0);
+    double Vb = std::pow(Vh, 0.4996667741545416);
+    double a0 = 1.0 + K / Q + K * K;
+    kCoeffs_[shelfB0] = float((Vh + Vb * K / Q + K * K) / a0);
+    kCoeffs_[shelfB1] = float(2.0 * (K * K - Vh) / a0);
+    kCoeffs_[shelfB2] = float((Vh - Vb * K / Q + K * K) / a0);
+    kCoeffs_[shelfA1] = float(2.0 * (K * K - 1.0) / a0);
+    kCoeffs_[shelfA2] = float((1.0 - K / Q + K * K) / a0);
+
+    K = std::tan(kPi * 38.13547087602444 / sr);
+    Q = 0.5003270373238773;
+    a0 = 1.0 + K / Q + K * K;
+    kCoeffs_[hipassA1] = float(2.0 * (K * K - 1.0) / a0);
+    kCoeffs_[hipassA2] = float((1.0 - K / Q + K * K) / a0);
+  }
+
+  // filter one group of interleaved channels in transposed direct form II, and
+  // add the squares of the results to the block sums.
+  void kWeightGroup(const float* pBuf, size_t firstRow)
+  {
+    const SIMDVectorFloat sb0 = vecSet1(kCoeffs_[shelfB0]);
+    const SIMDVectorFloat sb1 = vecSet1(kCoeffs_[shelfB1]);
+    const SIMDVectorFloat sb2 = vecSet1(kCoeffs_[shelfB2]);
+    const SIMDVectorFloat sa1 = vecSet1(kCoeffs_[shelfA1]);
+    const SIMDVectorFloat sa2 = vecSet1(kCoeffs_[shelfA2]);
+    const SIMDVectorFloat ha1 = vecSet1(kCoeffs_[hipassA1]);
+    const SIMDVectorFloat ha2 = vecSet1(kCoeffs_[hipassA2]);
+    const SIMDVectorFloat two = vecSet1(2.f);
+
+    SIMDVectorFloat s1 = vecLoadUnaligned(&kState_[0][firstRow]);
+    SIMDVectorFloat s2 = vecLoadUnaligned(&kState_[1][firstRow]);
+    SIMDVectorFloat h1 = vecLoadUnaligned(&kState_[2][firstRow]);
+    SIMDVectorFloat h2 = vecLoadUnaligned(&kState_[3][firstRow]);
+    SIMDVectorFloat sum = vecLoadUnaligned(&blockSum_[firstRow]);
+    const float* pSample = pBuf;
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      SIMDVectorFloat x = vecLoad(pSample);
+      SIMDVectorFloat y = vecAdd(vecMul(sb0, x), s1);
+      s1 = vecAdd(vecSub(vecMul(sb1, x), vecMul(sa1, y)), s2);
+      s2 = vecSub(vecMul(sb2, x), vecMul(sa2, y));
+
+      // the high pass has the numerator 1, -2, 1.
+      SIMDVectorFloat z = vecAdd(y, h1);
+      h1 = vecSub(vecSub(h2, vecMul(two, y)), vecMul(ha1, z));
+      h2 = vecSub(y, vecMul(ha2, z));
+      sum = vecAdd(sum, vecMul(z, z));
+      pSample += kLanes;
+    }
+    vecStoreUnaligned(&kState_[0][firstRow], s1);
+    vecStoreUnaligned(&kState_[1][firstRow], s2);
+    vecStoreUnaligned(&kState_[2][firstRow], h1);
+    vecStoreUnaligned(&kState_[3][firstRow], h2);
+    vecStoreUnaligned(&blockSum_[firstRow], sum);
+  }
+
+  // store the mean square of the finished block, and average the windows.
+  void endBlock()
+  {
+    const float blockScale = 1.f / float(blockVectors_ * kFloatsPerDSPVector);
+    Row& block = blocks_[blockIndex_];
+    for (size_t i = 0; i < ROWS; ++i)
+    {
+      block[i] = blockSum_[i] * blockScale;
+    }
+    blockSum_.fill(0.f);
+
+    momentary_.fill(0.f);
+    shortTerm_.fill(0.f);
+    for (size_t b = 0; b < kShortTermBlocks; ++b)
+    {
+      const Row& past = blocks_[(blockIndex_ + kShortTermBlocks - b) % kShortTermBlocks];
+      for (size_t i = 0; i < ROWS; ++i)
+      {
+        if (b < kMomentaryBlocks) momentary_[i] += past[i];
+        shortTerm_[i] += past[i];
+      }
+    }
+    for (size_t i = 0; i < ROWS; ++i)
+    {
+      momentary_[i] *= 1.f / kMomentaryBlocks;
+      shortTerm_[i] *= 1.f / kShortTermBlocks;
+    }
+    blockIndex_ = (blockIndex_ + 1) % kShortTermBlocks;
+    blockCount_ = 0;
+  }
+
+  float sampleRate_{48000.f};
+  float rmsTime_{0.3f};
+  float rmsA0_{1.f};
+  float rmsB1_{0.f};
+  size_t interval_{1};
+  size_t intervalCount_{0};
+  bool loudness_{false};
+  int blockVectors_{1};
+  int blockCount_{0};
+  size_t blockIndex_{0};
+  std::array<float, nKCoeffs> kCoeffs_{};
+
+  // running state by channel, with two biquad states each for the K-weighting.
+  Row peakSum_{};
+  Row rmsState_{};
+  std::array<Row, 4> kState_{};
+  Row blockSum_{};
+  std::array<Row, kShortTermBlocks> blocks_{};
+
+  // readings by channel.
+  Row peak_{};
+  Row rms_{};
+  Row momentary_{};
+  Row shortTerm_{};
+};
+
+// ADSR envelope triggered and scaled by a single gate + amp signal.
+
+struct ADSR
 {
   static constexpr float bias = 0.1f;
   static constexpr float minSegmentTime = 0.0002f;
@@ -788,23 +1725,189 @@ struct ADSR
   }
 };
 
-// IntegerDelay delays a signal a whole number of samples.
+// ADSRBank runs VOICES ADSR envelopes together, with the state of each voice in one lane of a
+// SIMD vector. Each voice has its own coefficients. The segment logic of ADSR is done for all
+// lanes at once with comparison masks and vecSelect instead of branches. The input and output
+// have a gate + amp signal and an envelope for voice i on row i. Groups of voices that are off
+// with no gate for a whole DSPVector are skipped.
+
+template <int VOICES>
+class ADSRBank
+{
+  static_assert(VOICES % kFloatsPerSIMDVector == 0,
+                "ADSRBank: VOICES must be a multiple of the SIMD vector size.");
+  static constexpr int kGroups{VOICES / kFloatsPerSIMDVector};
+
+  struct State
+  {
+    SIMDVectorFloat y, y1, x1, threshold, target, k, amp, segment;
+  };
+
+  std::array<State, kGroups> state_;
+  alignas(kBytesPerSIMDVector) std::array<float, VOICES> ka_{};
+  alignas(kBytesPerSIMDVector) std::array<float, VOICES> kd_{};
+  alignas(kBytesPerSIMDVector) std::array<float, VOICES> s_{};
+  alignas(kBytesPerSIMDVector) std::array<float, VOICES> kr_{};
+
+ public:
+  ADSRBank() { clear(); }
+
+  void setCoeffs(int voice, ADSR::Coeffs c)
+  {
+    ka_[voice] = c.ka;
+    kd_[voice] = c.kd;
+    s_[voice] = c.s;
+    kr_[voice] = c.kr;
+  }
+
+  void setCoeffs(ADSR::Coeffs c)
+  {
+    for (int v = 0; v < VOICES; ++v)
+    {
+      setCoeffs(v, c);
+    }
+  }
+
+  void clear()
+  {
+    for (auto& s : state_)
+    {
+      s.y = s.y1 = s.x1 = s.threshold = s.target = s.k = s.amp = vecZeros();
+      s.segment = vecSet1(float(ADSR::off));
+    }
+  }
+
+  DSPVectorArray<VOICES> operator()(const DSPVectorArray<VOICES>& vx)
+  {
+    DSPVectorArray<VOICES> frames;
+    storeFrames(vx, frames.getBuffer(), kFloatsPerDSPVector);
+    float* pFrames = frames.getBuffer();
+
+    for (int g = 0; g < kGroups; ++g)
+    {
+      const int lane = g * kFloatsPerSIMDVector;
+      if (isIdle(g, vx))
+      {
+        for (int n = 0; n < kFloatsPerDSPVector; ++n)
+        {
+          vecStore(pFrames + n * VOICES + lane, vecZeros());
+        }
+        continue;
+      }
+
+      const SIMDVectorFloat ka = vecLoad(ka_.data() + lane);
+      const SIMDVectorFloat kd = vecLoad(kd_.data() + lane);
+      const SIMDVectorFloat s = vecLoad(s_.data() + lane);
+      const SIMDVectorFloat kr = vecLoad(kr_.data() + lane);
+      const SIMDVectorFloat zeros = vecZeros();
+      const SIMDVectorFloat ones = vecSet1(1.f);
+      const SIMDVectorFloat vOff = vecSet1(float(ADSR::off));
+      const SIMDVectorFloat vBias = vecSet1(ADSR::bias);
+
+      State st = state_[g];
+      for (int n = 0; n < kFloatsPerDSPVector; ++n)
+      {
+        float* px = pFrames + n * VOICES + lane;
+        SIMDVectorFloat x = vecLoad(px);
+
+        // as in ADSR, an off envelope with no gate does nothing, not even keep its input.
+        SIMDVectorFloat xZero = vecEqual(x, zeros);
+        SIMDVectorFloat skip = vecAnd(vecEqual(st.segment, vOff), xZero);
+
+        // crossing the threshold advances to the next segment.
+        SIMDVectorFloat above = vecGreaterThan(st.y, st.threshold);
+        SIMDVectorFloat crossed = vecSelect(vecLessThanOrEqual(st.y, st.threshold), above,
+                                            vecGreaterThan(st.y1, st.threshold));
+        SIMDVectorFloat advance = vecAnd(crossed, vecLessThan(st.segment, vOff));
+        st.segment = vecAdd(st.segment, vecAnd(advance, ones));
+
+        // gate triggers start the attack or release.
+        SIMDVectorFloat trigOn = vecAnd(vecEqual(st.x1, zeros), vecGreaterThan(x, zeros));
+        SIMDVectorFloat trigOff = vecAnd(vecGreaterThan(st.x1, zeros), xZero);
+        trigOff = vecSelect(zeros, trigOff, skip);
+        st.segment = vecSelect(zeros, st.segment, trigOn);
+        st.amp = vecSelect(x, st.amp, trigOn);
+        st.segment = vecSelect(vecSet1(float(ADSR::R)), st.segment, trigOff);
+        SIMDVectorFloat recalc = vecOr(advance, vecOr(trigOn, trigOff));
+
+        // start, end and coefficient of each lane's segment.
+        SIMDVectorFloat isA = vecEqual(st.segment, vecSet1(float(ADSR::A)));
+        SIMDVectorFloat isD = vecEqual(st.segment, vecSet1(float(ADSR::D)));
+        SIMDVectorFloat isS = vecEqual(st.segment, vecSet1(float(ADSR::S)));
+        SIMDVectorFloat isR = vecEqual(st.segment, vecSet1(float(ADSR::R)));
+        SIMDVectorFloat isOff = vecEqual(st.segment, vOff);
+        SIMDVectorFloat start = vecSelect(ones, vecSelect(s, zeros, vecOr(isS, isR)), isD);
+        SIMDVectorFloat end = vecSelect(ones, vecSelect(s, zeros, vecOr(isD, isS)), isA);
+        SIMDVectorFloat k = vecSelect(ka, vecSelect(kd, vecAnd(kr, isR), isD), isA);
+
+        st.threshold = vecSelect(end, st.threshold, recalc);
+        st.target = vecSelect(vecAdd(end, vecMul(vecSub(end, start), vBias)), st.target, recalc);
+        st.k = vecSelect(k, st.k, recalc);
+        SIMDVectorFloat hold = vecAnd(recalc, vecOr(isS, isOff));
+        st.y = vecSelect(end, st.y, hold);
+        st.y1 = vecSelect(end, st.y1, hold);
+
+        st.x1 = vecSelect(st.x1, x, skip);
+        st.y1 = st.y;
+        st.y = vecAdd(st.y, vecMul(st.k, vecSub(st.target, st.y)));
+        vecStore(px, vecSelect(zeros, vecMul(st.y, st.amp), skip));
+      }
+      state_[g] = st;
+    }
+
+    DSPVectorArray<VOICES> out;
+    std::array<float*, VOICES> rows;
+    for (int v = 0; v < VOICES; ++v)
+    {
+      rows[v] = out.getBuffer() + v * kFloatsPerDSPVector;
+    }
+    deinterleave(frames.getConstBuffer(), rows.data(), VOICES, kFloatsPerDSPVector);
+    return out;
+  }
+
+ private:
+  // all the voices in the group are off, and their gates are 0 for the whole DSPVector.
+  bool isIdle(int g, const DSPVectorArray<VOICES>& vx) const
+  {
+    alignas(kBytesPerSIMDVector) float segments[kFloatsPerSIMDVector];
+    vecStore(segments, state_[g].segment);
+    for (int j = 0; j < kFloatsPerSIMDVector; ++j)
+    {
+      const int v = g * kFloatsPerSIMDVector + j;
+      if (segments[j] != float(ADSR::off)) return false;
+      const float* px = vx.getConstBuffer() + v * kFloatsPerDSPVector;
+      if (std::any_of(px, px + kFloatsPerDSPVector, [](float f) { return f != 0.f; }))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+// IntegerDelay delays a signal a whole number of samples. BasicIntegerDelay<STORAGE> stores the
+// delayed samples as STORAGE, which can be Float16 or BFloat16 to halve the memory used. Long
+// delays are stored in a LargeBuffer, which can be placed with setBufferPolicy().
 
-class IntegerDelay
+template <class STORAGE>
+class BasicIntegerDelay
 {
-  std::vector<float> mBuffer;
+  using Storage = SampleStorage<STORAGE>;
+
+  LargeBuffer<STORAGE> mBuffer;
   int mIntDelayInSamples{0};
   uintptr_t mWriteIndex{0};
   uintptr_t mLengthMask{0};
+  size_t mRequestedSize{0};
 
  public:
-  IntegerDelay() = default;
-  IntegerDelay(int d)
+  BasicIntegerDelay() = default;
+  BasicIntegerDelay(int d)
   {
     setMaxDelayInSamples(static_cast<float>(d));
     setDelayInSamples(d);
   }
-  ~IntegerDelay() = default;
+  ~BasicIntegerDelay() = default;
 
   // for efficiency, no bounds checking is done. Because mLengthMask is used to
   // constrain all reads, bad values here may make bad sounds (buffer wraps) but
@@ -818,10 +1921,29 @@ class IntegerDelay
     mBuffer.resize(newSize);
     mLengthMask = newSize - 1;
     mWriteIndex = 0;
+    mRequestedSize = std::max(dMax, 0) + kFloatsPerDSPVector;
     clear();
   }
 
-  inline void clear() { std::fill(mBuffer.begin(), mBuffer.end(), 0.f); }
+  // the longest delay the buffer holds, which may be more than the maximum set.
+  int getMaxDelayInSamples() const
+  {
+    return mBuffer.empty() ? 0 : static_cast<int>(mBuffer.size()) - kFloatsPerDSPVector;
+  }
+
+  // the memory used by the buffer, and the part of it needed for the maximum delay set. The
+  // rest comes from rounding the size up to a power of two.
+  size_t getMemoryBytes() const { return mBuffer.capacity() * sizeof(STORAGE); }
+  size_t getRequestedMemoryBytes() const { return mRequestedSize * sizeof(STORAGE); }
+
+  inline void clear() { std::fill(mBuffer.begin(), mBuffer.end(), Storage::fromFloat(0.f)); }
+
+  // allocate the buffer, now and when it is resized, following the policy. This clears it.
+  void setBufferPolicy(const LargeBufferPolicy& policy)
+  {
+    ml::setBufferPolicy(mBuffer, policy);
+    clear();
+  }
 
   inline DSPVector operator()(const DSPVector vx)
   {
@@ -830,7 +1952,7 @@ class IntegerDelay
     if (writeEnd <= mLengthMask + 1)
     {
       const float* srcStart = vx.getConstBuffer();
-      std::copy(srcStart, srcStart + kFloatsPerDSPVector, mBuffer.data() + mWriteIndex);
+      Storage::fromFloats(srcStart, mBuffer.data() + mWriteIndex, kFloatsPerDSPVector);
     }
     else
     {
@@ -838,26 +1960,26 @@ class IntegerDelay
       const float* srcStart = vx.getConstBuffer();
       const float* srcSplice = srcStart + kFloatsPerDSPVector - excess;
       const float* srcEnd = srcStart + kFloatsPerDSPVector;
-      std::copy(srcStart, srcSplice, mBuffer.data() + mWriteIndex);
-      std::copy(srcSplice, srcEnd, mBuffer.data());
+      Storage::fromFloats(srcStart, mBuffer.data() + mWriteIndex, srcSplice - srcStart);
+      Storage::fromFloats(srcSplice, mBuffer.data(), srcEnd - srcSplice);
     }
 
     // read
     DSPVector vy;
     uintptr_t readStart = (mWriteIndex - mIntDelayInSamples) & mLengthMask;
     uintptr_t readEnd = readStart + kFloatsPerDSPVector;
-    float* srcBuf = mBuffer.data();
+    const STORAGE* srcBuf = mBuffer.data();
     if (readEnd <= mLengthMask + 1)
     {
-      std::copy(srcBuf + readStart, srcBuf + readEnd, vy.getBuffer());
+      Storage::toFloats(srcBuf + readStart, vy.getBuffer(), kFloatsPerDSPVector);
     }
     else
     {
       uintptr_t excess = readEnd - mLengthMask - 1;
       uintptr_t readSplice = readStart + kFloatsPerDSPVector - excess;
       float* pDest = vy.getBuffer();
-      std::copy(srcBuf + readStart, srcBuf + readSplice, pDest);
-      std::copy(srcBuf, srcBuf + excess, pDest + (kFloatsPerDSPVector - excess));
+      Storage::toFloats(srcBuf + readStart, pDest, readSplice - readStart);
+      Storage::toFloats(srcBuf, pDest + (kFloatsPerDSPVector - excess), excess);
     }
 
     // update index
@@ -873,13 +1995,13 @@ class IntegerDelay
     for (int n = 0; n < kFloatsPerDSPVector; ++n)
     {
       // write
-      mBuffer[mWriteIndex] = x[n];
+      mBuffer[mWriteIndex] = Storage::fromFloat(x[n]);
 
       // read
       mIntDelayInSamples = static_cast<int>(delay[n]);
       uintptr_t readIndex = (mWriteIndex - mIntDelayInSamples) & mLengthMask;
 
-      y[n] = mBuffer[readIndex];
+      y[n] = Storage::toFloat(mBuffer[readIndex]);
       mWriteIndex++;
       mWriteIndex &= mLengthMask;
     }
@@ -892,11 +2014,11 @@ class IntegerDelay
     // write
     // note that, for performance, there is no bounds checking. If you crash
     // here, you probably didn't allocate enough delay memory.
-    mBuffer[mWriteIndex] = x;
+    mBuffer[mWriteIndex] = Storage::fromFloat(x);
 
     // read
     uintptr_t readIndex = (mWriteIndex - mIntDelayInSamples) & mLengthMask;
-    float y = mBuffer[readIndex];
+    float y = Storage::toFloat(mBuffer[readIndex]);
 
     // update index
     mWriteIndex++;
@@ -905,6 +2027,8 @@ class IntegerDelay
   }
 };
 
+using IntegerDelay = BasicIntegerDelay<float>;
+
 // First order allpass section with a single sample of delay.
 
 class Allpass1
@@ -958,22 +2082,23 @@ class Allpass1
 // Combining the integer delay and first order allpass section
 // gives us an allpass-interpolated fractional delay. In general, modulating the
 // delay time will change the allpass coefficient, producing clicks in the
-// output.
+// output. BasicFractionalDelay<STORAGE> stores its samples as STORAGE, like BasicIntegerDelay.
 
-class FractionalDelay
+template <class STORAGE>
+class BasicFractionalDelay
 {
-  IntegerDelay mIntegerDelay;
+  BasicIntegerDelay<STORAGE> mIntegerDelay;
   Allpass1 mAllpassSection{0.f};
   float mDelayInSamples{};
 
  public:
-  FractionalDelay() = default;
-  FractionalDelay(float d)
+  BasicFractionalDelay() = default;
+  BasicFractionalDelay(float d)
   {
     setMaxDelayInSamples(d);
     setDelayInSamples(d);
   }
-  ~FractionalDelay() = default;
+  ~BasicFractionalDelay() = default;
 
   inline void clear()
   {
@@ -1000,13 +2125,25 @@ class FractionalDelay
 
   inline void setMaxDelayInSamples(float d) { mIntegerDelay.setMaxDelayInSamples(floorf(d)); }
 
+  void setBufferPolicy(const LargeBufferPolicy& policy) { mIntegerDelay.setBufferPolicy(policy); }
+
+  size_t getMemoryBytes() const { return mIntegerDelay.getMemoryBytes(); }
+  size_t getRequestedMemoryBytes() const { return mIntegerDelay.getRequestedMemoryBytes(); }
+
   // return the input signal, delayed by the constant delay time
   // mDelayInSamples.
   inline DSPVector operator()(const DSPVector vx) { return mAllpassSection(mIntegerDelay(vx)); }
 
-  // return the input signal, delayed by the varying delay time vDelayInSamples.
+  // return the input signal, delayed by the varying delay time vDelayInSamples. A uniform
+  // delay time is set once for the vector.
   inline DSPVector operator()(const DSPVector vx, const DSPVector vDelayInSamples)
   {
+    if (isUniform(vDelayInSamples))
+    {
+      if (vDelayInSamples[0] != mDelayInSamples) setDelayInSamples(vDelayInSamples[0]);
+      return operator()(vx);
+    }
+
     DSPVector vy;
     for (int n = 0; n < kFloatsPerDSPVector; ++n)
     {
@@ -1016,6 +2153,12 @@ class FractionalDelay
     return vy;
   }
 
+  // return the input sample, delayed by the constant delay time mDelayInSamples.
+  inline float processSample(float x)
+  {
+    return mAllpassSection.processSample(mIntegerDelay.processSample(x));
+  }
+
   // return the input signal, delayed by the varying delay time vDelayInSamples,
   // but only allow changes to the delay time when vChangeTicks is nonzero.
   inline DSPVector operator()(const DSPVector vx, const DSPVector vDelayInSamples,
@@ -1035,6 +2178,8 @@ class FractionalDelay
   }
 };
 
+using FractionalDelay = BasicFractionalDelay<float>;
+
 // Crossfading two allpass-interpolated delays allows modulating the delay
 // time without clicks. See "A Lossless, Click-free, Pitchbend-able Delay Line
 // Loop Interpolation Scheme", Van Duyne, Jaffe, Scandalis, Stilson, ICMC 1997.
@@ -1042,8 +2187,8 @@ class FractionalDelay
 namespace PitchbendableDelayConsts
 {
 // period in samples of allpass fade cycle. must be a power of 2 less than or
-// equal to kFloatsPerDSPVector. 32 sounds good.
-constexpr int kFadePeriod{32};
+// equal to kFloatsPerDSPVector. 32 sounds good, where vectors are long enough.
+constexpr int kFadePeriod{std::min(32, int(kFloatsPerDSPVector))};
 constexpr int fadeRamp(int n) { return n % kFadePeriod; }
 constexpr int ticks1(int n) { return fadeRamp(n) == kFadePeriod / 2; }
 constexpr int ticks2(int n) { return fadeRamp(n) == 0; }
@@ -1081,6 +2226,12 @@ class PitchbendableDelay
     mDelay2.setMaxDelayInSamples(d);
   }
 
+  size_t getMemoryBytes() const { return mDelay1.getMemoryBytes() + mDelay2.getMemoryBytes(); }
+  size_t getRequestedMemoryBytes() const
+  {
+    return mDelay1.getRequestedMemoryBytes() + mDelay2.getRequestedMemoryBytes();
+  }
+
   inline void clear()
   {
     mDelay1.clear();
@@ -1095,6 +2246,160 @@ class PitchbendableDelay
     return lerp(mDelay1(vInput, vDelayInSamples, kvDelay1Changes),
                 mDelay2(vInput, vDelayInSamples, kvDelay2Changes), kvFade);
   }
+
+  // process one sample at index n of a DSPVector, for feedback loops shorter than a DSPVector.
+  // Called for each n in turn, this gives the same output as operator().
+  inline float processSample(float x, float delayInSamples, int n)
+  {
+    using namespace PitchbendableDelayConsts;
+
+    if (kvDelay1Changes[n]) mDelay1.setDelayInSamples(delayInSamples);
+    if (kvDelay2Changes[n]) mDelay2.setDelayInSamples(delayInSamples);
+    return lerp(mDelay1.processSample(x), mDelay2.processSample(x), kvFade[n]);
+  }
+};
+
+// MultiTapDelay: a delay line with any number of time-varying read taps that
+// share one write pointer. Taps are interpolated kFloatsPerSIMDVector samples
+// at a time using gathered loads, with linear or cubic (Hermite) interpolation.
+// Unlike FractionalDelay, the interpolation has no state, so the delay times
+// can be modulated freely.
+//
+// Each DSPVector, call write() once with the input, then read any number of
+// taps. A delay of 0 reads the sample just written at the same index.
+
+class MultiTapDelay
+{
+  LargeBuffer<float> mBuffer;
+  uintptr_t mWriteIndex{0};
+  uintptr_t mLengthMask{0};
+  uintptr_t mReadBase{0};
+  size_t mRequestedSize{0};
+
+  // read one row of taps with the delay times in pDelay.
+  template <bool kCubic>
+  inline void readRow(const float* pDelay, float* pDest) const
+  {
+    const float* pBuf = mBuffer.data();
+    const SIMDVectorInt vMask = vecSetInt1(static_cast<uint32_t>(mLengthMask));
+    const SIMDVectorInt vOne = vecSetInt1(1);
+    SIMDVectorIntUnion lanes;
+    for (int j = 0; j < kIntsPerSIMDVector; ++j)
+    {
+      lanes.i[j] = static_cast<uint32_t>(mReadBase + j);
+    }
+    SIMDVectorInt vPos = lanes.v;
+    const SIMDVectorInt vStep = vecSetInt1(kFloatsPerSIMDVector);
+
+    for (int n = 0; n < kSIMDVectorsPerDSPVector; ++n)
+    {
+      SIMDVectorFloat d = vecLoad(pDelay);
+      SIMDVectorInt di = vecFloatToIntTruncate(d);
+      SIMDVectorFloat t = vecSub(d, vecIntToFloat(di));
+      SIMDVectorInt i0 = vecAndInt(vecSubInt(vPos, di), vMask);
+      SIMDVectorInt i1 = vecAndInt(vecSubInt(i0, vOne), vMask);
+      SIMDVectorFloat x0 = vecGather(pBuf, i0);
+      SIMDVectorFloat x1 = vecGather(pBuf, i1);
+      SIMDVectorFloat y;
+
+      if (kCubic)
+      {
+        // xm1 is the sample after x0 in time, x2 the one before x1.
+        SIMDVectorFloat xm1 = vecGather(pBuf, vecAndInt(vecAddInt(i0, vOne), vMask));
+        SIMDVectorFloat x2 = vecGather(pBuf, vecAndInt(vecSubInt(i1, vOne), vMask));
+        const SIMDVectorFloat kHalf = vecSet1(0.5f);
+        SIMDVectorFloat c1 = vecMul(kHalf, vecSub(x1, xm1));
+        SIMDVectorFloat c2 = vecSub(vecAdd(xm1, vecAdd(x1, x1)),
+                                    vecAdd(vecMul(vecSet1(2.5f), x0), vecMul(kHalf, x2)));
+        SIMDVectorFloat c3 = vecAdd(vecMul(kHalf, vecSub(x2, xm1)),
+                                    vecMul(vecSet1(1.5f), vecSub(x0, x1)));
+        y = vecAdd(vecMul(vecAdd(vecMul(vecAdd(vecMul(c3, t), c2), t), c1), t), x0);
+      }
+      else
+      {
+        y = vecAdd(x0, vecMul(t, vecSub(x1, x0)));
+      }
+
+      vecStore(pDest, y);
+      vPos = vecAddInt(vPos, vStep);
+      pDelay += kFloatsPerSIMDVector;
+      pDest += kFloatsPerSIMDVector;
+    }
+  }
+
+ public:
+  MultiTapDelay() = default;
+  MultiTapDelay(float d) { setMaxDelayInSamples(d); }
+  ~MultiTapDelay() = default;
+
+  // allocate for delays up to d samples. cubic interpolation reads one sample
+  // further back, which is included.
+  void setMaxDelayInSamples(float d)
+  {
+    int dMax = static_cast<int>(floorf(d)) + 2;
+    int newSize = 1 << bitsToContain(dMax + kFloatsPerDSPVector);
+    mBuffer.resize(newSize);
+    mLengthMask = newSize - 1;
+    mWriteIndex = 0;
+    mReadBase = 0;
+    mRequestedSize = std::max(dMax, 0) + kFloatsPerDSPVector;
+    clear();
+  }
+
+  // the memory used by the buffer, and the part of it needed for the maximum delay set.
+  size_t getMemoryBytes() const { return mBuffer.capacity() * sizeof(float); }
+  size_t getRequestedMemoryBytes() const { return mRequestedSize * sizeof(float); }
+
+  inline void clear() { std::fill(mBuffer.begin(), mBuffer.end(), 0.f); }
+
+  // allocate the buffer, now and when it is resized, following the policy. This clears it.
+  void setBufferPolicy(const LargeBufferPolicy& policy) { ml::setBufferPolicy(mBuffer, policy); }
+
+  inline void write(const DSPVector vx)
+  {
+    mReadBase = mWriteIndex;
+    uintptr_t writeEnd = mWriteIndex + kFloatsPerDSPVector;
+    const float* srcStart = vx.getConstBuffer();
+    if (writeEnd <= mLengthMask + 1)
+    {
+      std::copy(srcStart, srcStart + kFloatsPerDSPVector, mBuffer.data() + mWriteIndex);
+    }
+    else
+    {
+      uintptr_t excess = writeEnd - mLengthMask - 1;
+      const float* srcSplice = srcStart + kFloatsPerDSPVector - excess;
+      std::copy(srcStart, srcSplice, mBuffer.data() + mWriteIndex);
+      std::copy(srcSplice, srcStart + kFloatsPerDSPVector, mBuffer.data());
+    }
+    mWriteIndex = writeEnd & mLengthMask;
+  }
+
+  // read one tap per row of the delay times, with linear interpolation.
+  // as with IntegerDelay, delays are not bounds checked, but reads stay
+  // within the buffer.
+  template <size_t ROWS>
+  inline DSPVectorArray<ROWS> readLinear(const DSPVectorArray<ROWS>& vDelayInSamples) const
+  {
+    DSPVectorArray<ROWS> vy;
+    for (size_t j = 0; j < ROWS; ++j)
+    {
+      readRow<false>(vDelayInSamples.constRow(j).getConstBuffer(), vy.row(j).getBuffer());
+    }
+    return vy;
+  }
+
+  // read one tap per row of the delay times, with cubic Hermite interpolation.
+  // delay times should be at least 1 sample.
+  template <size_t ROWS>
+  inline DSPVectorArray<ROWS> readCubic(const DSPVectorArray<ROWS>& vDelayInSamples) const
+  {
+    DSPVectorArray<ROWS> vy;
+    for (size_t j = 0; j < ROWS; ++j)
+    {
+      readRow<true>(vDelayInSamples.constRow(j).getConstBuffer(), vy.row(j).getBuffer());
+    }
+    return vy;
+  }
 };
 
 // General purpose allpass filter with arbitrary delay length.
@@ -1118,6 +2423,9 @@ class Allpass
     mDelay.setMaxDelayInSamples(d - kFloatsPerDSPVector);
   }
 
+  size_t getMemoryBytes() const { return mDelay.getMemoryBytes(); }
+  size_t getRequestedMemoryBytes() const { return mDelay.getRequestedMemoryBytes(); }
+
   inline void clear()
   {
     mDelay.clear();
@@ -1146,78 +2454,309 @@ class Allpass
   }
 };
 
-// FDN
-// A general Feedback Delay Network with N delay lines connected in an NxN
-// matrix.
-// TODO DELAY_TYPE parameter for modulation?
+// DiffuserBank: chains of allpass stages for diffusing ROWS channels in a reverb, with one
+// channel in each lane of a SIMD vector like HalfBandFilterBank. Each stage has a delay time
+// for each channel, so the channels can be decorrelated, and a gain shared by the channels.
+//
+// The delay memory of all the stages is one contiguous buffer, with the channels of each
+// sample next to each other. A stage can be nested in the stage before it, so that it runs
+// inside that stage's delay loop as in Gardner's nested allpass, and a stage's delay can be
+// modulated by a sine LFO, with the phase spread across the channels, for a less metallic
+// sound. Modulated delays are read with linear interpolation. Unlike Allpass, delays can be as
+// short as one sample.
+//
+// resize() allocates and is not real-time safe.
 
-template <int SIZE>
-class FDN
+template <int ROWS>
+class DiffuserBank
 {
-  std::array<IntegerDelay, SIZE> mDelays;
-  std::array<OnePole, SIZE> mFilters;
-  std::array<DSPVector, SIZE> mDelayInputVectors{{{DSPVector(0.f)}}};
+  static constexpr int kGroups{(ROWS + kFloatsPerSIMDVector - 1) / kFloatsPerSIMDVector};
+  static constexpr int kPadded{kGroups * kFloatsPerSIMDVector};
 
- public:
-  // feedback gains array is public—just copy values to set.
-  std::array<float, SIZE> mFeedbackGains{{0}};
+  int stages_{0};
+  int length_{0};
+  uint32_t lengthMask_{0};
+  uint32_t writeIndex_{0};
+  int maxDelay_{0};
+  std::vector<float> buffer_;
 
-  void setDelaysInSamples(std::array<float, SIZE> times)
+  // settings and LFO state for each stage, kPadded floats per stage.
+  std::vector<float> delays_;
+  std::vector<float> gains_;
+  std::vector<float> depths_;
+  std::vector<float> rates_;
+  std::vector<float> phases_;
+  std::vector<bool> nested_;
+  std::vector<bool> modulated_;
+
+  std::array<uint32_t, kFloatsPerSIMDVector> lanes_;
+  alignas(kBytesPerSIMDVector) std::array<float, kFloatsPerDSPVector * kPadded> frames_{};
+
+  // the start of the memory for group g of stage s.
+  int memoryStart(int s, int g) const
   {
-    for (int n = 0; n < SIZE; ++n)
-    {
-      // we have one DSPVector feedback latency, so compensate delay times for
-      // that.
-      int len = times[n] - kFloatsPerDSPVector;
-      len = max(1, len);
-      mDelays[n].setDelayInSamples(len);
-    }
+    return (s * kGroups + g) * length_ * kFloatsPerSIMDVector;
   }
 
-  void setFilterCutoffs(std::array<float, SIZE> omegas)
+  // the floats at sample t of each lane, in memory starting at p.
+  SIMDVectorFloat gather(const float* p, SIMDVectorInt t) const
   {
-    for (int n = 0; n < SIZE; ++n)
-    {
-      mFilters[n].coeffs = ml::OnePole::makeCoeffs(omegas[n]);
-    }
+    const SIMDVectorInt lanes =
+        VecF2I(vecLoadUnaligned(reinterpret_cast<const float*>(lanes_.data())));
+    return vecGather(p, vecAddInt(vecShiftLeftInt(t, kFloatsPerSIMDVectorBits), lanes));
   }
 
-  // stereo output function
-  // TODO generalize n-channel output function somehow
-  DSPVectorArray<2> operator()(const DSPVector x)
+  // read the delay of stage s for group g at the write index w.
+  SIMDVectorFloat readDelay(int s, int g, uint32_t w)
   {
-    // run delays, getting DSPVector for each delay
-    for (int n = 0; n < SIZE; ++n)
+    const int i = s * kPadded + g * kFloatsPerSIMDVector;
+    const float* pMemory = buffer_.data() + memoryStart(s, g);
+    const SIMDVectorInt mask = vecSet1Int(lengthMask_);
+    SIMDVectorFloat delay = vecLoadUnaligned(&delays_[i]);
+    if (!modulated_[s])
     {
-      mDelayInputVectors[n] = mDelays[n](mDelayInputVectors[n]);
+      SIMDVectorInt t = vecAndInt(vecSubInt(vecSet1Int(w), vecFloatToIntTruncate(delay)), mask);
+      return gather(pMemory, t);
     }
 
-    // get output sum
-    DSPVector sumR, sumL;
-    for (int n = 0; n < (SIZE & (~1)); ++n)
+    // step the LFO and make a sine from its phase p: sin(pi x) is about 4x(1 - |x|) for
+    // x = 2p - 1.
+    const SIMDVectorFloat ones = vecSet1(1.f);
+    SIMDVectorFloat phase = vecAdd(vecLoadUnaligned(&phases_[i]), vecLoadUnaligned(&rates_[i]));
+    phase = vecSub(phase, vecAnd(vecGreaterThanOrEqual(phase, ones), ones));
+    vecStoreUnaligned(&phases_[i], phase);
+    SIMDVectorFloat x = vecSub(vecAdd(phase, phase), ones);
+    SIMDVectorFloat lfo = vecMul(vecMul(vecSet1(4.f), x), vecSub(ones, vecAbs(x)));
+    delay = vecAdd(delay, vecMul(lfo, vecLoadUnaligned(&depths_[i])));
+    delay = vecMin(vecMax(delay, ones), vecSet1(float(maxDelay_)));
+
+    SIMDVectorInt whole = vecFloatToIntTruncate(delay);
+    SIMDVectorFloat frac = vecSub(delay, vecIntToFloat(whole));
+    SIMDVectorInt t0 = vecAndInt(vecSubInt(vecSet1Int(w), whole), mask);
+    SIMDVectorInt t1 = vecAndInt(vecSubInt(t0, vecSet1Int(1)), mask);
+    SIMDVectorFloat a = gather(pMemory, t0);
+    SIMDVectorFloat b = gather(pMemory, t1);
+    return vecAdd(a, vecMul(frac, vecSub(b, a)));
+  }
+
+  // run stage s and the stages nested in it for group g, advancing s past them.
+  SIMDVectorFloat runStage(int& s, int g, uint32_t w, SIMDVectorFloat x)
+  {
+    const int stage = s++;
+    SIMDVectorFloat d = readDelay(stage, g, w);
+    if ((s < stages_) && nested_[s])
     {
-      if (n & 1)
-      {
-        sumL += mDelayInputVectors[n];
-      }
-      else
-      {
-        sumR += mDelayInputVectors[n];
-      }
+      d = runStage(s, g, w, d);
     }
+    const SIMDVectorFloat gain =
+        vecLoadUnaligned(&gains_[stage * kPadded + g * kFloatsPerSIMDVector]);
+    SIMDVectorFloat v = vecAdd(x, vecMul(gain, d));
+    vecStoreUnaligned(buffer_.data() + memoryStart(stage, g) + w * kFloatsPerSIMDVector, v);
+    return vecSub(d, vecMul(gain, v));
+  }
 
-    // inputs = input gains*input sample + filters(M*delay outputs)
-    // The feedback matrix M is a unit-gain Householder matrix, which is just
-    // the identity matrix minus a constant k, where k = 2/size. Since
-    // multiplying this can be simplified so much, you just see a few operations
-    // here, not a general matrix multiply.
-
-    DSPVector sumOfDelays;
-    for (int n = 0; n < SIZE; ++n)
+ public:
+  DiffuserBank()
+  {
+    for (int j = 0; j < kFloatsPerSIMDVector; ++j)
     {
-      sumOfDelays += mDelayInputVectors[n];
+      lanes_[j] = uint32_t(j);
     }
-    sumOfDelays *= DSPVector(2.0f / SIZE);
+  }
+
+  // make the given number of stages with delays up to maxDelayInSamples.
+  void resize(int stages, int maxDelayInSamples)
+  {
+    stages_ = stages;
+    maxDelay_ = std::max(maxDelayInSamples, 1);
+    length_ = 1 << bitsToContain(maxDelay_ + 1);
+    lengthMask_ = uint32_t(length_ - 1);
+    buffer_.assign(size_t(stages_) * kGroups * length_ * kFloatsPerSIMDVector, 0.f);
+    const size_t n = size_t(stages_) * kPadded;
+    delays_.assign(n, 1.f);
+    gains_.assign(n, 0.f);
+    depths_.assign(n, 0.f);
+    rates_.assign(n, 0.f);
+    phases_.assign(n, 0.f);
+    nested_.assign(stages_, false);
+    modulated_.assign(stages_, false);
+    writeIndex_ = 0;
+  }
+
+  int getNumStages() const { return stages_; }
+
+  // set the delay of one channel of a stage, from 1 to the maximum delay.
+  void setDelayInSamples(int stage, int row, float d)
+  {
+    delays_[stage * kPadded + row] = std::clamp(d, 1.f, float(maxDelay_));
+  }
+
+  void setDelayInSamples(int stage, float d)
+  {
+    for (int j = 0; j < ROWS; ++j)
+    {
+      setDelayInSamples(stage, j, d);
+    }
+  }
+
+  void setGain(int stage, float g)
+  {
+    std::fill(gains_.begin() + stage * kPadded, gains_.begin() + (stage + 1) * kPadded, g);
+  }
+
+  // run the stage inside the delay loop of the stage before it. Stage 0 can't be nested.
+  void setNested(int stage, bool nested) { nested_[stage] = nested && (stage > 0); }
+
+  // modulate the delays of a stage by up to depthInSamples at a rate in cycles per sample.
+  // Depth 0 turns the modulation off.
+  void setModulation(int stage, float depthInSamples, float cyclesPerSample)
+  {
+    modulated_[stage] = (depthInSamples > 0.f);
+    for (int j = 0; j < kPadded; ++j)
+    {
+      const int i = stage * kPadded + j;
+      depths_[i] = depthInSamples;
+      rates_[i] = cyclesPerSample;
+      phases_[i] = float(j % ROWS) / ROWS;
+    }
+  }
+
+  size_t getMemoryBytes() const { return buffer_.capacity() * sizeof(float); }
+
+  void clear()
+  {
+    std::fill(buffer_.begin(), buffer_.end(), 0.f);
+    writeIndex_ = 0;
+  }
+
+  // diffuse one DSPVector of each row.
+  DSPVectorArray<ROWS> operator()(const DSPVectorArray<ROWS>& vx)
+  {
+    if (!stages_) return vx;
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      for (int j = 0; j < ROWS; ++j)
+      {
+        frames_[n * kPadded + j] = vx.constRow(j)[n];
+      }
+    }
+
+    for (int g = 0; g < kGroups; ++g)
+    {
+      float* pFrames = frames_.data() + g * kFloatsPerSIMDVector;
+      uint32_t w = writeIndex_;
+      for (int n = 0; n < kFloatsPerDSPVector; ++n)
+      {
+        SIMDVectorFloat x = vecLoad(pFrames + n * kPadded);
+        for (int s = 0; s < stages_;)
+        {
+          x = runStage(s, g, w, x);
+        }
+        vecStore(pFrames + n * kPadded, x);
+        w = (w + 1) & lengthMask_;
+      }
+    }
+    writeIndex_ = (writeIndex_ + kFloatsPerDSPVector) & lengthMask_;
+
+    DSPVectorArray<ROWS> vy;
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      for (int j = 0; j < ROWS; ++j)
+      {
+        vy.row(j)[n] = frames_[n * kPadded + j];
+      }
+    }
+    return vy;
+  }
+};
+
+// FDN
+// A general Feedback Delay Network with N delay lines connected in an NxN
+// matrix. The delay lines store their samples as STORAGE.
+// TODO DELAY_TYPE parameter for modulation?
+
+template <int SIZE, class STORAGE = float>
+class FDN
+{
+  std::array<BasicIntegerDelay<STORAGE>, SIZE> mDelays;
+  std::array<OnePole, SIZE> mFilters;
+  std::array<DSPVector, SIZE> mDelayInputVectors{{{DSPVector(0.f)}}};
+
+ public:
+  // feedback gains array is public—just copy values to set.
+  std::array<float, SIZE> mFeedbackGains{{0}};
+
+  // set the loop time of each delay line. If a time is longer than its line, the line is
+  // reallocated and cleared.
+  void setDelaysInSamples(std::array<float, SIZE> times)
+  {
+    for (int n = 0; n < SIZE; ++n)
+    {
+      // we have one DSPVector feedback latency, so compensate delay times for
+      // that.
+      int len = times[n] - kFloatsPerDSPVector;
+      len = max(1, len);
+      if (len > mDelays[n].getMaxDelayInSamples())
+      {
+        mDelays[n].setMaxDelayInSamples(static_cast<float>(len));
+      }
+      mDelays[n].setDelayInSamples(len);
+    }
+  }
+
+  void setFilterCutoffs(std::array<float, SIZE> omegas)
+  {
+    for (int n = 0; n < SIZE; ++n)
+    {
+      mFilters[n].coeffs = ml::OnePole::makeCoeffs(omegas[n]);
+    }
+  }
+
+  // allocate the delay lines following the policy. This clears them.
+  void setBufferPolicy(const LargeBufferPolicy& policy)
+  {
+    for (auto& d : mDelays)
+    {
+      d.setBufferPolicy(policy);
+    }
+  }
+
+  // stereo output function
+  // TODO generalize n-channel output function somehow
+  DSPVectorArray<2> operator()(const DSPVector x)
+  {
+    // run delays, getting DSPVector for each delay
+    for (int n = 0; n < SIZE; ++n)
+    {
+      mDelayInputVectors[n] = mDelays[n](mDelayInputVectors[n]);
+    }
+
+    // get output sum
+    DSPVector sumR, sumL;
+    for (int n = 0; n < (SIZE & (~1)); ++n)
+    {
+      if (n & 1)
+      {
+        sumL += mDelayInputVectors[n];
+      }
+      else
+      {
+        sumR += mDelayInputVectors[n];
+      }
+    }
+
+    // inputs = input gains*input sample + filters(M*delay outputs)
+    // The feedback matrix M is a unit-gain Householder matrix, which is just
+    // the identity matrix minus a constant k, where k = 2/size. Since
+    // multiplying this can be simplified so much, you just see a few operations
+    // here, not a general matrix multiply.
+
+    DSPVector sumOfDelays;
+    for (int n = 0; n < SIZE; ++n)
+    {
+      sumOfDelays += mDelayInputVectors[n];
+    }
+    sumOfDelays *= DSPVector(2.0f / SIZE);
 
     for (int n = 0; n < SIZE; ++n)
     {
@@ -1230,6 +2769,274 @@ class FDN
   }
 };
 
+// MatrixFDN
+// A Feedback Delay Network with SIZE delay lines, OUTPUTS outputs and a
+// choice of feedback matrix. The delay lines are stored in one contiguous
+// buffer and their signals in DSPVectorArrays, so the feedback mix runs over
+// all the lines at once.
+//
+// Delay line n is summed into output (n % OUTPUTS). As with FDN, there is one
+// DSPVector of feedback latency, which setDelaysInSamples() compensates for.
+// The delay lines store their samples as STORAGE: Float16 or BFloat16 halve the
+// memory that a large network reads and writes.
+
+enum class FDNMatrixType
+{
+  kHouseholder,  // identity minus 2/SIZE: O(SIZE) operations
+  kHadamard,     // normalized Hadamard by fast Walsh transform, SIZE must be a power of 2
+  kCustom        // any SIZE x SIZE matrix set with setMatrix()
+};
+
+template <size_t SIZE, size_t OUTPUTS = 2, class STORAGE = float>
+class MatrixFDN
+{
+  static constexpr bool kSizeIsPowerOfTwo = (SIZE & (SIZE - 1)) == 0;
+  using Storage = SampleStorage<STORAGE>;
+
+  LargeBuffer<STORAGE> buffer_;
+  size_t lineLength_{0};
+  uintptr_t lengthMask_{0};
+  uintptr_t writeIndex_{0};
+  std::array<uintptr_t, SIZE> delays_{};
+
+  FDNMatrixType matrixType_{FDNMatrixType::kHouseholder};
+  std::array<float, SIZE * SIZE> matrix_{};
+
+  std::array<float, SIZE> a0_{};
+  std::array<float, SIZE> b1_{};
+  std::array<float, SIZE> y1_{};
+  std::array<float, SIZE> gains_{};
+
+  DSPVectorArray<SIZE> delayOutputs_;
+  DSPVectorArray<SIZE> delayInputs_;
+
+ public:
+  MatrixFDN()
+  {
+    for (size_t n = 0; n < SIZE; ++n)
+    {
+      setFilterCoeffs(n, OnePole::passthru());
+    }
+  }
+
+  // allocate each delay line for delays of up to d samples.
+  void setMaxDelayInSamples(float d)
+  {
+    int dMax = static_cast<int>(floorf(d));
+    lineLength_ = size_t(1) << bitsToContain(dMax + kFloatsPerDSPVector);
+    lengthMask_ = lineLength_ - 1;
+    buffer_.resize(lineLength_ * SIZE);
+    writeIndex_ = 0;
+    clear();
+  }
+
+  // set the loop time of each delay line. If a time is longer than the current
+  // maximum, the lines are reallocated and cleared.
+  void setDelaysInSamples(const std::array<float, SIZE>& times)
+  {
+    float maxTime = *std::max_element(times.begin(), times.end());
+    if (maxTime + kFloatsPerDSPVector > lengthMask_)
+    {
+      setMaxDelayInSamples(maxTime);
+    }
+    for (size_t n = 0; n < SIZE; ++n)
+    {
+      int len = static_cast<int>(times[n]) - kFloatsPerDSPVector;
+      delays_[n] = static_cast<uintptr_t>(std::max(1, len));
+    }
+  }
+
+  void setFilterCutoffs(const std::array<float, SIZE>& omegas)
+  {
+    for (size_t n = 0; n < SIZE; ++n)
+    {
+      setFilterCoeffs(n, OnePole::makeCoeffs(omegas[n]));
+    }
+  }
+
+  void setFilterCoeffs(size_t line, OnePole::Coeffs c)
+  {
+    a0_[line] = c.a0;
+    b1_[line] = c.b1;
+  }
+
+  void setFeedbackGains(const std::array<float, SIZE>& gains) { gains_ = gains; }
+
+  // the matrix type is a template argument so that kHadamard with a SIZE that is not a power of 2
+  // fails to compile.
+  template <FDNMatrixType TYPE>
+  void setMatrixType()
+  {
+    static_assert((TYPE != FDNMatrixType::kHadamard) || kSizeIsPowerOfTwo,
+                  "MatrixFDN: kHadamard needs a SIZE that is a power of 2");
+    matrixType_ = TYPE;
+  }
+
+  // set a row-major SIZE x SIZE feedback matrix and select it. For the
+  // network to be stable with unity feedback gains, it should be orthogonal.
+  void setMatrix(const std::array<float, SIZE * SIZE>& m)
+  {
+    matrix_ = m;
+    matrixType_ = FDNMatrixType::kCustom;
+  }
+
+  // allocate the delay lines, now and when they are resized, following the policy. This clears
+  // them.
+  void setBufferPolicy(const LargeBufferPolicy& policy)
+  {
+    ml::setBufferPolicy(buffer_, policy);
+    clear();
+  }
+
+  void clear()
+  {
+    std::fill(buffer_.begin(), buffer_.end(), Storage::fromFloat(0.f));
+    y1_.fill(0.f);
+    delayOutputs_ = DSPVectorArray<SIZE>();
+    delayInputs_ = DSPVectorArray<SIZE>();
+  }
+
+  DSPVectorArray<OUTPUTS> operator()(const DSPVector x)
+  {
+    if (buffer_.empty()) return DSPVectorArray<OUTPUTS>();
+
+    // write each line's input and read its output.
+    for (size_t n = 0; n < SIZE; ++n)
+    {
+      STORAGE* pLine = buffer_.data() + n * lineLength_;
+      copyIntoLine(pLine, writeIndex_, delayInputs_.constRow(n).getConstBuffer());
+      copyFromLine(pLine, (writeIndex_ - delays_[n]) & lengthMask_,
+                   delayOutputs_.row(n).getBuffer());
+    }
+    writeIndex_ = (writeIndex_ + kFloatsPerDSPVector) & lengthMask_;
+
+    DSPVectorArray<OUTPUTS> y;
+    for (size_t n = 0; n < SIZE; ++n)
+    {
+      y.row(n % OUTPUTS) += delayOutputs_.constRow(n);
+    }
+
+    mixFeedback();
+
+    // filter, apply gains and add the input.
+    const float* px = x.getConstBuffer();
+    float* pIn = delayInputs_.getBuffer();
+    for (size_t n = 0; n < SIZE; ++n)
+    {
+      const float a0 = a0_[n] * gains_[n];
+      const float b1 = b1_[n];
+      float y1 = y1_[n];
+      for (int i = 0; i < kFloatsPerDSPVector; ++i)
+      {
+        y1 = a0 * pIn[i] + b1 * y1;
+        pIn[i] = y1 + px[i];
+      }
+      y1_[n] = y1;
+      pIn += kFloatsPerDSPVector;
+    }
+    return y;
+  }
+
+ private:
+  void copyIntoLine(STORAGE* pLine, uintptr_t start, const float* pSrc)
+  {
+    uintptr_t end = start + kFloatsPerDSPVector;
+    if (end <= lineLength_)
+    {
+      Storage::fromFloats(pSrc, pLine + start, kFloatsPerDSPVector);
+    }
+    else
+    {
+      uintptr_t split = lineLength_ - start;
+      Storage::fromFloats(pSrc, pLine + start, split);
+      Storage::fromFloats(pSrc + split, pLine, kFloatsPerDSPVector - split);
+    }
+  }
+
+  void copyFromLine(const STORAGE* pLine, uintptr_t start, float* pDest)
+  {
+    uintptr_t end = start + kFloatsPerDSPVector;
+    if (end <= lineLength_)
+    {
+      Storage::toFloats(pLine + start, pDest, kFloatsPerDSPVector);
+    }
+    else
+    {
+      uintptr_t split = lineLength_ - start;
+      Storage::toFloats(pLine + start, pDest, split);
+      Storage::toFloats(pLine, pDest + split, kFloatsPerDSPVector - split);
+    }
+  }
+
+  // delayInputs_ = M * delayOutputs_, where each row is one line's signal.
+  void mixFeedback()
+  {
+    constexpr size_t kV = kSIMDVectorsPerDSPVector;
+    const float* px = delayOutputs_.getConstBuffer();
+    float* py = delayInputs_.getBuffer();
+
+    if (kSizeIsPowerOfTwo && (matrixType_ == FDNMatrixType::kHadamard))
+    {
+      // in-place fast Walsh-Hadamard transform across rows.
+      delayInputs_ = delayOutputs_;
+      for (size_t h = 1; h < SIZE; h *= 2)
+      {
+        for (size_t i = 0; i < SIZE; i += h * 2)
+        {
+          for (size_t j = i; j < i + h; ++j)
+          {
+            float* pa = py + j * kFloatsPerDSPVector;
+            float* pb = pa + h * kFloatsPerDSPVector;
+            for (size_t k = 0; k < kV; ++k)
+            {
+              SIMDVectorFloat a = vecLoad(pa);
+              SIMDVectorFloat b = vecLoad(pb);
+              vecStore(pa, vecAdd(a, b));
+              vecStore(pb, vecSub(a, b));
+              pa += kFloatsPerSIMDVector;
+              pb += kFloatsPerSIMDVector;
+            }
+          }
+        }
+      }
+      delayInputs_ *= DSPVectorArray<SIZE>(1.f / sqrtf(static_cast<float>(SIZE)));
+    }
+    else if (matrixType_ == FDNMatrixType::kCustom)
+    {
+      for (size_t i = 0; i < SIZE; ++i)
+      {
+        float* pyRow = py + i * kFloatsPerDSPVector;
+        std::fill(pyRow, pyRow + kFloatsPerDSPVector, 0.f);
+        for (size_t j = 0; j < SIZE; ++j)
+        {
+          const float m = matrix_[i * SIZE + j];
+          if (m == 0.f) continue;
+          const SIMDVectorFloat vm = vecSet1(m);
+          const float* pxRow = px + j * kFloatsPerDSPVector;
+          float* pyk = pyRow;
+          for (size_t k = 0; k < kV; ++k)
+          {
+            vecStore(pyk, vecAdd(vecLoad(pyk), vecMul(vm, vecLoad(pxRow))));
+            pxRow += kFloatsPerSIMDVector;
+            pyk += kFloatsPerSIMDVector;
+          }
+        }
+      }
+    }
+    else
+    {
+      // Householder: subtract 2/SIZE times the sum of all lines from each.
+      DSPVector sum;
+      for (size_t n = 0; n < SIZE; ++n)
+      {
+        sum += delayOutputs_.constRow(n);
+      }
+      sum *= DSPVector(2.0f / SIZE);
+      delayInputs_ = delayOutputs_ - repeatRows<SIZE>(sum);
+    }
+  }
+};
+
 // Half Band Filter
 // Polyphase allpass filter used to upsample or downsample a signal by 2x.
 // Structure due to fred harris, A. G. Constantinides and Valenzuela.
@@ -1237,6 +3044,28 @@ class FDN
 class HalfBandFilter
 {
  public:
+  // order=4, rejection=70dB, transition band=0.1.
+  static constexpr float kA0{0.07986642623635751f};
+  static constexpr float kA1{0.5453536510711322f};
+  static constexpr float kB0{0.28382934487410993f};
+  static constexpr float kB1{0.8344118914807379f};
+
+  // a cheaper filter with one allpass in each path: order=2, rejection=36dB, transition band=0.1.
+  static constexpr float kCheapA0{0.23647102099689224f};
+  static constexpr float kCheapB0{0.7145421497126001f};
+
+  // the group delay at low frequencies, in samples at the 2x rate, of both filters. With the
+  // two paths interleaved it is the mean of their delays, each doubled, plus half a sample.
+  static constexpr float allpassDelay(float a) { return (1.f - a) / (1.f + a); }
+  static constexpr float groupDelay()
+  {
+    return allpassDelay(kA0) + allpassDelay(kA1) + allpassDelay(kB0) + allpassDelay(kB1) + 0.5f;
+  }
+  static constexpr float cheapGroupDelay()
+  {
+    return allpassDelay(kCheapA0) + allpassDelay(kCheapB0) + 0.5f;
+  }
+
   inline DSPVector upsampleFirstHalf(const DSPVector vx)
   {
     DSPVector vy;
@@ -1295,16 +3124,13 @@ class HalfBandFilter
   }
 
  private:
-  // order=4, rejection=70dB, transition band=0.1.
-  Allpass1 apa0{0.07986642623635751f}, apa1{0.5453536510711322f}, apb0{0.28382934487410993f},
-      apb1{0.8344118914807379f};
+  Allpass1 apa0{kA0}, apa1{kA1}, apb0{kB0}, apb1{kB1};
   float b1{0};
 };
 
 // Downsampler
-// a cascade of half band filters, one for each octave.
-// TODO this is complicated. replace with single-channel version then use Bank<Downsampler> for
-// multiple channels?
+// a cascade of half band filters, one for each octave. For several channels
+// or voices, DownsamplerBank runs them in SIMD lanes.
 class Downsampler
 {
   std::vector<HalfBandFilter> _filters;
@@ -1464,6 +3290,340 @@ struct Upsampler
   }
 };
 
+// HalfBandFilterBank: HalfBandFilters for ROWS channels or voices, with one channel in each
+// lane of a SIMD vector so that each allpass stage runs kFloatsPerSIMDVector channels at once.
+// Inputs and outputs have channel i on row i, which is transposed to and from frame major
+// order around the filters. The output of each row is the same as a HalfBandFilter's, or a
+// bank can be made with the cheaper filter that has one allpass in each path.
+
+template <int ROWS>
+class HalfBandFilterBank
+{
+  static constexpr int kGroups{(ROWS + kFloatsPerSIMDVector - 1) / kFloatsPerSIMDVector};
+  static constexpr int kPadded{kGroups * kFloatsPerSIMDVector};
+
+  struct AllpassState
+  {
+    SIMDVectorFloat x1, y1;
+  };
+
+  struct Group
+  {
+    AllpassState a0, a1, b0, b1;
+    SIMDVectorFloat bOut1;
+  };
+
+  static SIMDVectorFloat allpass(AllpassState& s, SIMDVectorFloat x, float c)
+  {
+    SIMDVectorFloat y = vecAdd(s.x1, vecMul(vecSub(x, s.y1), vecSet1(c)));
+    s.x1 = x;
+    s.y1 = y;
+    return y;
+  }
+
+  template <bool kCheap>
+  static SIMDVectorFloat pathA(Group& g, SIMDVectorFloat x)
+  {
+    if (kCheap) return allpass(g.a0, x, HalfBandFilter::kCheapA0);
+    return allpass(g.a1, allpass(g.a0, x, HalfBandFilter::kA0), HalfBandFilter::kA1);
+  }
+
+  template <bool kCheap>
+  static SIMDVectorFloat pathB(Group& g, SIMDVectorFloat x)
+  {
+    if (kCheap) return allpass(g.b0, x, HalfBandFilter::kCheapB0);
+    return allpass(g.b1, allpass(g.b0, x, HalfBandFilter::kB0), HalfBandFilter::kB1);
+  }
+
+  template <bool kCheap>
+  void upsampleFrames()
+  {
+    for (int g = 0; g < kGroups; ++g)
+    {
+      const float* px = in_.data() + g * kFloatsPerSIMDVector;
+      float* py = out_.data() + g * kFloatsPerSIMDVector;
+      for (int n = 0; n < kFloatsPerDSPVector; ++n)
+      {
+        SIMDVectorFloat x = vecLoad(px + n * kPadded);
+        vecStore(py + (2 * n) * kPadded, pathA<kCheap>(groups_[g], x));
+        vecStore(py + (2 * n + 1) * kPadded, pathB<kCheap>(groups_[g], x));
+      }
+    }
+  }
+
+  template <bool kCheap>
+  void downsampleFrames()
+  {
+    const SIMDVectorFloat vHalf = vecSet1(0.5f);
+    for (int g = 0; g < kGroups; ++g)
+    {
+      Group& grp = groups_[g];
+      const float* px = in_.data() + g * kFloatsPerSIMDVector;
+      float* py = out_.data() + g * kFloatsPerSIMDVector;
+      for (int n = 0; n < kFloatsPerDSPVector; ++n)
+      {
+        SIMDVectorFloat a0 = pathA<kCheap>(grp, vecLoad(px + (2 * n) * kPadded));
+        SIMDVectorFloat b0 = pathB<kCheap>(grp, vecLoad(px + (2 * n + 1) * kPadded));
+        vecStore(py + n * kPadded, vecMul(vecAdd(a0, grp.bOut1), vHalf));
+        grp.bOut1 = b0;
+      }
+    }
+  }
+
+  // store the rows of x as frames of kPadded floats, starting at pDest.
+  static void toFrames(const DSPVectorArray<ROWS>& x, float* pDest)
+  {
+    if constexpr (kPadded == ROWS)
+    {
+      storeFrames(x, pDest, kFloatsPerDSPVector);
+    }
+    else
+    {
+      for (int n = 0; n < kFloatsPerDSPVector; ++n)
+      {
+        for (int j = 0; j < ROWS; ++j)
+        {
+          pDest[n * kPadded + j] = x.constRow(j)[n];
+        }
+      }
+    }
+  }
+
+  // load kFloatsPerDSPVector frames of kPadded floats from pSrc into the rows of y.
+  static void fromFrames(const float* pSrc, DSPVectorArray<ROWS>& y)
+  {
+    if constexpr (kPadded == ROWS)
+    {
+      std::array<float*, ROWS> rows;
+      for (int j = 0; j < ROWS; ++j)
+      {
+        rows[j] = y.getBuffer() + j * kFloatsPerDSPVector;
+      }
+      deinterleave(pSrc, rows.data(), ROWS, kFloatsPerDSPVector);
+    }
+    else
+    {
+      for (int n = 0; n < kFloatsPerDSPVector; ++n)
+      {
+        for (int j = 0; j < ROWS; ++j)
+        {
+          y.row(j)[n] = pSrc[n * kPadded + j];
+        }
+      }
+    }
+  }
+
+  std::array<Group, kGroups> groups_;
+  bool cheap_{false};
+  alignas(kBytesPerSIMDVector) std::array<float, kFloatsPerDSPVector * 2 * kPadded> in_{};
+  alignas(kBytesPerSIMDVector) std::array<float, kFloatsPerDSPVector * 2 * kPadded> out_{};
+
+ public:
+  explicit HalfBandFilterBank(bool cheap = false) : cheap_(cheap) { clear(); }
+
+  void setCheap(bool cheap) { cheap_ = cheap; }
+  bool isCheap() const { return cheap_; }
+
+  // the group delay at low frequencies in samples at the 2x rate.
+  float getGroupDelay() const
+  {
+    return cheap_ ? HalfBandFilter::cheapGroupDelay() : HalfBandFilter::groupDelay();
+  }
+
+  // upsample one DSPVector of each row to two, the first and second halves at 2x.
+  void upsample(const DSPVectorArray<ROWS>& vx, DSPVectorArray<ROWS>& vy1,
+                DSPVectorArray<ROWS>& vy2)
+  {
+    toFrames(vx, in_.data());
+    if (cheap_)
+    {
+      upsampleFrames<true>();
+    }
+    else
+    {
+      upsampleFrames<false>();
+    }
+    fromFrames(out_.data(), vy1);
+    fromFrames(out_.data() + kFloatsPerDSPVector * kPadded, vy2);
+  }
+
+  // downsample two DSPVectors of each row at 2x to one.
+  DSPVectorArray<ROWS> downsample(const DSPVectorArray<ROWS>& vx1,
+                                  const DSPVectorArray<ROWS>& vx2)
+  {
+    toFrames(vx1, in_.data());
+    toFrames(vx2, in_.data() + kFloatsPerDSPVector * kPadded);
+    if (cheap_)
+    {
+      downsampleFrames<true>();
+    }
+    else
+    {
+      downsampleFrames<false>();
+    }
+    DSPVectorArray<ROWS> vy;
+    fromFrames(out_.data(), vy);
+    return vy;
+  }
+
+  void clear()
+  {
+    for (auto& g : groups_)
+    {
+      for (auto* s : {&g.a0, &g.a1, &g.b0, &g.b1})
+      {
+        s->x1 = s->y1 = vecZeros();
+      }
+      g.bOut1 = vecZeros();
+    }
+  }
+};
+
+// DownsamplerBank: a Downsampler for ROWS channels, using a HalfBandFilterBank for each octave.
+// The first cheapOctaves octaves, at the highest rates, can use the cheaper filters.
+template <int ROWS>
+class DownsamplerBank
+{
+  std::vector<HalfBandFilterBank<ROWS>> filters_;
+  std::vector<DSPVectorArray<ROWS>> buffers_;
+  int octaves_;
+  uint32_t counter_{0};
+
+ public:
+  explicit DownsamplerBank(int octavesDown, int cheapOctaves = 0) : octaves_(octavesDown)
+  {
+    // one pair of buffers for each octave plus one output buffer.
+    for (int h = 0; h < octaves_; ++h)
+    {
+      filters_.emplace_back(h < cheapOctaves);
+    }
+    buffers_.resize(2 * octaves_ + 1);
+    clear();
+  }
+
+  // the group delay at low frequencies in samples at the output rate.
+  float getGroupDelay() const
+  {
+    float d{0.f};
+    for (int h = 0; h < octaves_; ++h)
+    {
+      d += filters_[h].getGroupDelay() * float(1 << h);
+    }
+    return d / float(1 << octaves_);
+  }
+
+  // write a vector of samples to the filter chain, run filters, and return
+  // true if there is a new vector of output to read (every 2^octaves writes)
+  bool write(const DSPVectorArray<ROWS>& v)
+  {
+    if (!octaves_)
+    {
+      buffers_[0] = v;
+      return true;
+    }
+
+    buffers_[counter_ & 1] = v;
+
+    // each octave is run if its bit and all lesser bits of the counter are 1.
+    uint32_t mask = 1;
+    for (int h = 0; h < octaves_; ++h)
+    {
+      if (!(counter_ & mask)) break;
+      mask <<= 1;
+      bool b1 = counter_ & mask;
+      buffers_[h * 2 + 2 + b1] = filters_[h].downsample(buffers_[h * 2], buffers_[h * 2 + 1]);
+    }
+
+    uint32_t counterMask = (1 << octaves_) - 1;
+    counter_ = (counter_ + 1) & counterMask;
+    return (counter_ == 0);
+  }
+
+  const DSPVectorArray<ROWS>& read() const { return buffers_.back(); }
+
+  void clear()
+  {
+    for (auto& f : filters_)
+    {
+      f.clear();
+    }
+    for (auto& b : buffers_)
+    {
+      b = DSPVectorArray<ROWS>(0.f);
+    }
+    counter_ = 0;
+  }
+};
+
+// UpsamplerBank: an Upsampler for ROWS channels, using a HalfBandFilterBank for each octave.
+// The last cheapOctaves octaves, at the highest rates, can use the cheaper filters.
+template <int ROWS>
+class UpsamplerBank
+{
+  std::vector<HalfBandFilterBank<ROWS>> filters_;
+  std::vector<DSPVectorArray<ROWS>> buffers_;
+  int octaves_;
+  int readIdx_{0};
+
+ public:
+  explicit UpsamplerBank(int octavesUp, int cheapOctaves = 0) : octaves_(octavesUp)
+  {
+    for (int j = 0; j < octaves_; ++j)
+    {
+      filters_.emplace_back(j >= octaves_ - cheapOctaves);
+    }
+    buffers_.resize(size_t(1) << octaves_);
+    clear();
+  }
+
+  // the group delay at low frequencies in samples at the input rate.
+  float getGroupDelay() const
+  {
+    float d{0.f};
+    for (int j = 0; j < octaves_; ++j)
+    {
+      d += filters_[j].getGroupDelay() / float(2 << j);
+    }
+    return d;
+  }
+
+  void write(const DSPVectorArray<ROWS>& x)
+  {
+    const int numBuffers = static_cast<int>(buffers_.size());
+    buffers_[numBuffers - 1] = x;
+
+    // for each octave, upsample blocks to twice as many, in place, ending at the buffers' end.
+    for (int j = 0; j < octaves_; ++j)
+    {
+      int sourceBufs = 1 << j;
+      int srcStart = numBuffers - sourceBufs;
+      int destStart = numBuffers - (sourceBufs << 1);
+      for (int i = 0; i < sourceBufs; ++i)
+      {
+        DSPVectorArray<ROWS> src = buffers_[srcStart + i];
+        filters_[j].upsample(src, buffers_[destStart + i * 2], buffers_[destStart + i * 2 + 1]);
+      }
+    }
+    readIdx_ = 0;
+  }
+
+  // after a write, 1 << octaves reads are available.
+  const DSPVectorArray<ROWS>& read() { return buffers_[readIdx_++]; }
+
+  void clear()
+  {
+    for (auto& f : filters_)
+    {
+      f.clear();
+    }
+    for (auto& b : buffers_)
+    {
+      b = DSPVectorArray<ROWS>(0.f);
+    }
+    readIdx_ = 0;
+  }
+};
+
 // From an input clock phasor and an output/input frequency ratio,
 // produce an output clock at the given ratio that is phase-synched with the input.
 //
@@ -8,93 +8,96 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <functional>
+#include <memory>
+#include <type_traits>
 
+#include "ffft/FFTRealFixLen.h"
 #include "MLDSPFilters.h"
+#include "MLDSPUtils.h"
 
 namespace ml
 {
 // ----------------------------------------------------------------
 // basic higher-order functions
 
-// Evaluate a function (void)->(float), store at each element of the
-// DSPVectorArray and return the result. x is a dummy argument just used to
-// infer the vector size.
-template <size_t ROWS>
-inline DSPVectorArray<ROWS> map(std::function<float()> f, const DSPVectorArray<ROWS> x)
+// map() applies a function to a DSPVectorArray x and returns the result. The function is
+// a template parameter, so that a lambda can be inlined into the loop rather than called
+// through a std::function for each sample. The kind of function is chosen by what it can be
+// called with, in this order:
+//   (void)->(float): evaluated at each element. x is just used to infer the size.
+//   (DSPVector, int row)->(DSPVector): applied to each row along with its index.
+//   (DSPVector)->(DSPVector): applied to each row.
+//   (float)->(float): applied to each element.
+template <size_t ROWS, class Fn>
+inline DSPVectorArray<ROWS> map(Fn&& f, const DSPVectorArray<ROWS>& x)
 {
   DSPVectorArray<ROWS> y;
-  for (int n = 0; n < kFloatsPerDSPVector * ROWS; ++n)
+  if constexpr (std::is_invocable_v<Fn&>)
   {
-    y[n] = f();
+    float* py = y.getBuffer();
+    for (int n = 0; n < kFloatsPerDSPVector * ROWS; ++n)
+    {
+      py[n] = f();
+    }
   }
-  return y;
-}
-
-// Apply a function (float)->(float) to each element of the DSPVectorArray x and
-// return the result.
-template <size_t ROWS>
-inline DSPVectorArray<ROWS> map(std::function<float(float)> f, const DSPVectorArray<ROWS> x)
-{
-  DSPVectorArray<ROWS> y;
-  for (int n = 0; n < kFloatsPerDSPVector * ROWS; ++n)
+  else if constexpr (std::is_invocable_v<Fn&, const DSPVector&, int>)
   {
-    y[n] = f(x[n]);
+    for (int j = 0; j < ROWS; ++j)
+    {
+      y.row(j) = DSPVector(f(x.constRow(j), j));
+    }
   }
-  return y;
-}
-
-// Apply a function (int)->(float) to each element of the DSPVectorArrayInt x
-// and return the result.
-template <size_t ROWS>
-inline DSPVectorArray<ROWS> map(std::function<float(int)> f, const DSPVectorArrayInt<ROWS> x)
-{
-  DSPVectorArray<ROWS> y;
-  for (int n = 0; n < kFloatsPerDSPVector * ROWS; ++n)
+  else if constexpr (std::is_invocable_v<Fn&, const DSPVector&>)
   {
-    y[n] = f(x[n]);
+    for (int j = 0; j < ROWS; ++j)
+    {
+      y.row(j) = DSPVector(f(x.constRow(j)));
+    }
   }
-  return y;
-}
-
-// Apply a function (DSPVector)->(DSPVector) to each row of the DSPVectorArray x
-// and return the result.
-template <size_t ROWS>
-inline DSPVectorArray<ROWS> map(std::function<DSPVector(const DSPVector)> f,
-                                const DSPVectorArray<ROWS> x)
-{
-  DSPVectorArray<ROWS> y;
-  for (int j = 0; j < ROWS; ++j)
+  else
   {
-    y.row(j) = f(x.constRow(j));
+    static_assert(std::is_invocable_v<Fn&, float>, "map: no matching function type");
+    const float* px = x.getConstBuffer();
+    float* py = y.getBuffer();
+    for (int n = 0; n < kFloatsPerDSPVector * ROWS; ++n)
+    {
+      py[n] = f(px[n]);
+    }
   }
   return y;
 }
 
-// Apply a function (DSPVector, int row)->(DSPVector) to each row of the
-// DSPVectorArray x and return the result.
-template <size_t ROWS>
-inline DSPVectorArray<ROWS> map(std::function<DSPVector(const DSPVector, int)> f,
-                                const DSPVectorArray<ROWS> x)
+// Apply a function (int)->(float) to each element of the DSPVectorArrayInt x
+// and return the result.
+template <size_t ROWS, class Fn>
+inline DSPVectorArray<ROWS> map(Fn&& f, const DSPVectorArrayInt<ROWS>& x)
 {
   DSPVectorArray<ROWS> y;
-  for (int j = 0; j < ROWS; ++j)
+  float* py = y.getBuffer();
+  for (int n = 0; n < kFloatsPerDSPVector * ROWS; ++n)
   {
-    y.row(j) = f(x.constRow(j), j);
+    py[n] = f(x[n]);
   }
   return y;
 }
 
-// Apply a function (DSPVector, int row)->(DSPVector) to each row of the
-// DSPVectorArray x and return the result.
-template <size_t ROWS>
-inline DSPVectorArray<ROWS> map(std::function<DSPVector(const DSPVector, const DSPVector)> f,
-                                const DSPVectorArray<ROWS> x)
+// Apply a function (SIMDVectorFloat)->(SIMDVectorFloat) to each SIMD vector of
+// the DSPVectorArray x and return the result. This lets custom waveshapers and
+// curves be written with the vec* SIMD functions.
+template <size_t ROWS, class Fn>
+inline DSPVectorArray<ROWS> mapSIMD(Fn&& f, const DSPVectorArray<ROWS>& x)
 {
   DSPVectorArray<ROWS> y;
-  for (int j = 0; j < ROWS; ++j)
+  const float* px = x.getConstBuffer();
+  float* py = y.getBuffer();
+  for (int n = 0; n < kSIMDVectorsPerDSPVector * ROWS; ++n)
   {
-    y.row(j) = f(x.constRow(j), j);
+    vecStore(py, f(vecLoad(px)));
+    px += kFloatsPerSIMDVector;
+    py += kFloatsPerSIMDVector;
   }
   return y;
 }
@@ -222,30 +225,252 @@ class Downsample2xFunction
   bool mPhase{false};
 };
 
-// OverlapAddFunction TODO
-/*
-template<int LENGTH, int DIVISIONS, int IN_ROWS, int OUT_ROWS>
+// Oversample is a function object that given a process function f, upsamples
+// each row of the input x by FACTOR, applies f to each of the FACTOR
+// DSPVectorArrays at the higher rate, downsamples and returns the result.
+// The resampling is done by cascades of half band filters with the rows in
+// SIMD lanes. The octaves at the highest rates, where the transition bands
+// fall far above the signal, can use cheaper filters. getLatency() reports
+// the total group delay of both cascades at low frequencies, in samples at
+// the base rate.
+
+template <int FACTOR, int ROWS>
+class Oversample
+{
+  static_assert((FACTOR == 2) || (FACTOR == 4) || (FACTOR == 8) || (FACTOR == 16),
+                "Oversample: FACTOR must be 2, 4, 8 or 16.");
+  static constexpr int kOctaves{(FACTOR == 2) ? 1 : (FACTOR == 4) ? 2 : (FACTOR == 8) ? 3 : 4};
+
+  using arrayType = DSPVectorArray<ROWS>;
+  using ProcessFn = std::function<arrayType(const arrayType&)>;
+
+ public:
+  // use cheaper filters for the given number of octaves at the highest rates.
+  explicit Oversample(int cheapOctaves = 0)
+      : mUpper(kOctaves, cheapOctaves), mDowner(kOctaves, cheapOctaves)
+  {
+  }
+
+  inline arrayType operator()(ProcessFn fn, const arrayType& vx)
+  {
+    mUpper.write(vx);
+    for (int i = 0; i < FACTOR; ++i)
+    {
+      mDowner.write(fn(mUpper.read()));
+    }
+    return mDowner.read();
+  }
+
+  float getLatency() const { return mUpper.getGroupDelay() + mDowner.getGroupDelay(); }
+
+  void clear()
+  {
+    mUpper.clear();
+    mDowner.clear();
+  }
+
+ private:
+  UpsamplerBank<ROWS> mUpper;
+  DownsamplerBank<ROWS> mDowner;
+};
+
+// OverlapAddFunction
+// Runs a function on overlapping frames of the input and overlap-adds its output.
+// Each frame is FRAME_VECTORS DSPVectors long, and a new frame starts every
+// FRAME_VECTORS / DIVISIONS DSPVectors. The function gets each input frame as it is, so it
+// can apply its own analysis window. Its output frame is multiplied by the window and by
+// a gain that makes the overlapped windows sum to one. The output is delayed from the
+// input by FRAME_VECTORS - 1 DSPVectors.
+
+template <int FRAME_VECTORS, int DIVISIONS>
 class OverlapAddFunction
 {
-        typedef std::function<DSPVectorArray<OUT_ROWS>(const
-DSPVectorArray<IN_ROWS>)> ProcessFn;
+  static_assert(FRAME_VECTORS % DIVISIONS == 0, "frames must start on DSPVector boundaries");
+  static constexpr size_t kFrameSize = FRAME_VECTORS * kFloatsPerDSPVector;
+  static constexpr size_t kHopSize = kFrameSize / DIVISIONS;
+  static constexpr size_t kOverlap = kFrameSize - kHopSize;
 
-public:
-        inline DSPVectorArray<OUT_ROWS> operator()(ProcessFn fn, const
-DSPVectorArray<IN_ROWS> vx)
-        {
-        }
+ public:
+  using frameType = DSPVectorArray<FRAME_VECTORS>;
+  using ProcessFn = std::function<frameType(const frameType&)>;
+
+  OverlapAddFunction(Projection windowShape = dspwindows::raisedCosine)
+  {
+    // a periodic window, so that windows spaced by the hop size sum to a constant.
+    auto domainToUnity = projections::linear({0.f, float(kFrameSize)}, {0.f, 1.f});
+    mapIndices(mWindow.getBuffer(), kFrameSize, compose(windowShape, domainToUnity));
+    float windowSum{0.f};
+    for (int j = 0; j < FRAME_VECTORS; ++j)
+    {
+      windowSum += sum(mWindow.constRow(j));
+    }
+    mGain = (windowSum > 0.f) ? kHopSize / windowSum : 0.f;
+
+    mInputBuffer.resize(kFrameSize * 2);
+    mOutputBuffer.resize(kFrameSize * 2);
+
+    // start with a partial frame of silence so that the first frame is complete after one hop.
+    mInputBuffer.write(mFrame.getConstBuffer(), kOverlap);
+  }
+
+  inline DSPVector operator()(const DSPVector vx, ProcessFn fn)
+  {
+    mInputBuffer.write(vx);
+    if (mInputBuffer.getReadAvailable() >= kFrameSize)
+    {
+      mInputBuffer.readWithOverlap(mFrame.getBuffer(), kFrameSize, kOverlap);
+      frameType y = fn(mFrame);
+      mOutputBuffer.writeWindowedWithOverlapAdd(y.getConstBuffer(), mWindow.getConstBuffer(),
+                                                kFrameSize, kOverlap, mGain);
+    }
+    return mOutputBuffer.read();
+  }
 
-private:
-        //Matrix mHistory;
-        const DSPVector& mWindow;
+ private:
+  DSPBuffer mInputBuffer;
+  DSPBuffer mOutputBuffer;
+  frameType mWindow;
+  frameType mFrame;
+  float mGain{1.f};
+};
+
+// SpectralFunction
+// Runs a function on the short-time spectrum of the input and resynthesizes the output by
+// windowed overlap-add. Each frame is FRAME_VECTORS DSPVectors long, which must be a power
+// of two, and a new frame starts every FRAME_VECTORS / DIVISIONS DSPVectors. Each frame is
+// multiplied by the analysis window and transformed, and the function is given its Spectrum
+// to change in place. The inverse transform is multiplied by a synthesis window made so
+// that an unchanged spectrum gives back the input, delayed by FRAME_VECTORS - 1 DSPVectors.
+// All memory is allocated in the constructor.
+
+template <int FRAME_VECTORS, int DIVISIONS>
+class SpectralFunction
+{
+  static_assert(FRAME_VECTORS % DIVISIONS == 0, "frames must start on DSPVector boundaries");
+  static_assert((FRAME_VECTORS & (FRAME_VECTORS - 1)) == 0, "frame size must be a power of two");
+  static constexpr size_t kFrameSize = FRAME_VECTORS * kFloatsPerDSPVector;
+  static constexpr size_t kHopSize = kFrameSize / DIVISIONS;
+  static constexpr size_t kOverlap = kFrameSize - kHopSize;
+
+  static constexpr int getBits(size_t n) { return (n > 1) ? 1 + getBits(n / 2) : 0; }
+  using FFT = ffft::FFTRealFixLen<getBits(kFrameSize)>;
+
+ public:
+  using frameType = DSPVectorArray<FRAME_VECTORS>;
+  static constexpr size_t kBins = kFrameSize / 2 + 1;
+
+  // the bins of a frame from 0 to kFrameSize / 2, with the usual sign convention
+  // X[k] = sum(x[n] e^(-2 pi i k n / N)). The imaginary parts of the first and last bins are
+  // always zero on input and ignored on output.
+  struct Spectrum
+  {
+    std::array<float, kBins> real;
+    std::array<float, kBins> imag;
+  };
+
+  SpectralFunction(Projection windowShape = dspwindows::raisedCosine)
+      : mFFT(std::make_unique<FFT>())
+  {
+    auto domainToUnity = projections::linear({0.f, float(kFrameSize)}, {0.f, 1.f});
+    mapIndices(mAnalysisWindow.getBuffer(), kFrameSize, compose(windowShape, domainToUnity));
+
+    // divide by the sum of the squared windows overlapping each sample, and by the frame
+    // size to scale the inverse transform, so that any window overlapping itself everywhere
+    // reconstructs exactly.
+    const float* pw = mAnalysisWindow.getConstBuffer();
+    float* ps = mSynthesisWindow.getBuffer();
+    for (size_t n = 0; n < kFrameSize; ++n)
+    {
+      float sumOfSquares{0.f};
+      for (size_t m = n % kHopSize; m < kFrameSize; m += kHopSize)
+      {
+        sumOfSquares += pw[m] * pw[m];
+      }
+      ps[n] = (sumOfSquares > 0.f) ? pw[n] / (sumOfSquares * kFrameSize) : 0.f;
+    }
+
+    mInputBuffer.resize(kFrameSize * 2);
+    mOutputBuffer.resize(kFrameSize * 2);
+
+    // start with a partial frame of silence so that the first frame is complete after one hop.
+    mInputBuffer.write(mFrame.getConstBuffer(), kOverlap);
+  }
+
+  template <class Fn>
+  inline DSPVector operator()(const DSPVector vx, Fn&& fn)
+  {
+    mInputBuffer.write(vx);
+    if (mInputBuffer.getReadAvailable() >= kFrameSize)
+    {
+      mInputBuffer.readWithOverlap(mFrame.getBuffer(), kFrameSize, kOverlap);
+      float* px = mFrame.getBuffer();
+      const float* pw = mAnalysisWindow.getConstBuffer();
+      for (size_t n = 0; n < kFrameSize; n += kFloatsPerSIMDVector)
+      {
+        vecStore(px + n, vecMul(vecLoad(px + n), vecLoad(pw + n)));
+      }
+
+      mFFT->do_fft(mTransform.data(), px);
+      unpack();
+      fn(mSpectrum);
+      pack();
+      mFFT->do_ifft(mTransform.data(), px);
+
+      mOutputBuffer.writeWindowedWithOverlapAdd(px, mSynthesisWindow.getConstBuffer(), kFrameSize,
+                                                kOverlap);
+    }
+    return mOutputBuffer.read();
+  }
+
+ private:
+  // ffft stores real parts of bins [0, N/2] at [0, N/2] and negated imaginary parts of bins
+  // [1, N/2 - 1] at [N/2 + 1, N - 1].
+  void unpack()
+  {
+    constexpr size_t kHalf = kFrameSize / 2;
+    auto& y = mSpectrum;
+    y.imag[0] = y.imag[kHalf] = 0.f;
+    for (size_t k = 0; k <= kHalf; ++k)
+    {
+      y.real[k] = mTransform[k];
+    }
+    for (size_t k = 1; k < kHalf; ++k)
+    {
+      y.imag[k] = -mTransform[kHalf + k];
+    }
+  }
+
+  void pack()
+  {
+    constexpr size_t kHalf = kFrameSize / 2;
+    const auto& y = mSpectrum;
+    for (size_t k = 0; k <= kHalf; ++k)
+    {
+      mTransform[k] = y.real[k];
+    }
+    for (size_t k = 1; k < kHalf; ++k)
+    {
+      mTransform[kHalf + k] = -y.imag[k];
+    }
+  }
+
+  std::unique_ptr<FFT> mFFT;
+  std::array<float, kFrameSize> mTransform;
+  Spectrum mSpectrum;
+  DSPBuffer mInputBuffer;
+  DSPBuffer mOutputBuffer;
+  frameType mAnalysisWindow;
+  frameType mSynthesisWindow;
+  frameType mFrame;
 };
-*/
 
 // FeedbackDelayFunction
 // Wraps a function in a pitchbendable delay with feedback per row.
 // Since the feedback adds the output of the function to its input, the function
-// must input and output the same number of rows.
+// must input and output the same number of rows. With a function of DSPVectors,
+// the delay time around the loop must be at least kFloatsPerDSPVector. For
+// shorter loops like high-pitched combs and plucked strings, processSamples()
+// takes a function of single samples and runs the loop one sample at a time.
 
 // template<int ROWS>
 class FeedbackDelayFunction
@@ -271,9 +496,52 @@ class FeedbackDelayFunction
     return vFnOutput;
   }
 
+  // Run a function (float)->(float) in the loop one sample at a time. The delay
+  // time around the loop can be as short as 2 samples.
+  template <class Fn>
+  inline DSPVectorArray<ROWS> processSamples(const DSPVectorArray<ROWS> vx, Fn&& fn,
+                                             const DSPVector vDelayTime)
+  {
+    DSPVectorArray<ROWS> vy;
+    for (int j = 0; j < ROWS; ++j)
+    {
+      const float* px = vx.constRow(j).getConstBuffer();
+      float* py = vy.row(j).getBuffer();
+      for (int n = 0; n < kFloatsPerDSPVector; ++n)
+      {
+        py[n] = fn(px[n] + y1[j] * feedbackGain);
+        y1[j] = mDelays[j].processSample(py[n], vDelayTime[n] - 1.f, n);
+      }
+    }
+    return vy;
+  }
+
+  inline void setMaxDelayInSamples(float d)
+  {
+    for (auto& delay : mDelays)
+    {
+      delay.setMaxDelayInSamples(d);
+    }
+  }
+
+  size_t getMemoryBytes() const
+  {
+    size_t sum{0};
+    for (const auto& delay : mDelays) sum += delay.getMemoryBytes();
+    return sum;
+  }
+
+  size_t getRequestedMemoryBytes() const
+  {
+    size_t sum{0};
+    for (const auto& delay : mDelays) sum += delay.getRequestedMemoryBytes();
+    return sum;
+  }
+
  private:
   std::array<PitchbendableDelay, ROWS> mDelays;
   DSPVectorArray<ROWS> vy1;
+  std::array<float, ROWS> y1{};
 };
 
 // FeedbackDelayFunctionWithTap
@@ -359,4 +627,117 @@ class Bank
   T& operator[](size_t n) { return _processors[n]; }
 };
 
+// ControlRate runs a function of control signals once every period DSPVectors and
+// interpolates its outputs back to the audio rate, so that modulation that doesn't need the
+// full rate costs only a fraction of it. Each run, the function returns either one frame of
+// ROWS control values, as a std::array<float, ROWS>, or a DSPVectorArray<ROWS>, of which the
+// last column is used. The second form runs an existing bank as it is: called once per period,
+// a bank like ADSRBank or LFOBank advances one DSPVector of its own time per call, so its
+// coefficients and free-running rates should be set for a sample rate of the audio rate / period.
+//
+// With linear interpolation, each value is reached at the end of the period in which it was
+// made. Smooth interpolation makes a Catmull-Rom spline through the frames, which has a
+// continuous slope but reaches each value one period later. getLatencyInSamples() reports this
+// for frames made from the present. A bank run a DSPVector of its time per call computes the
+// value at the end of the period ahead, which makes up for one period of the latency.
+
+template <int ROWS>
+class ControlRate
+{
+ public:
+  enum class Interpolation
+  {
+    kLinear,
+    kSmooth
+  };
+
+  ControlRate() { clear(); }
+
+  // run the function once every period DSPVectors. Also restarts the period.
+  void setPeriodInVectors(int p)
+  {
+    period_ = std::max(p, 1);
+    position_ = 0;
+  }
+
+  int getPeriodInVectors() const { return period_; }
+
+  void setInterpolation(Interpolation i) { interpolation_ = i; }
+
+  int getLatencyInSamples() const
+  {
+    const int latency = period_ * kFloatsPerDSPVector;
+    return (interpolation_ == Interpolation::kSmooth) ? latency * 2 : latency;
+  }
+
+  // set all the held frames to a value, as if it had been the output forever.
+  void clear(float value = 0.f)
+  {
+    for (auto& f : frames_)
+    {
+      f.fill(value);
+    }
+    position_ = 0;
+  }
+
+  template <class Fn>
+  inline DSPVectorArray<ROWS> operator()(Fn&& fn)
+  {
+    if (position_ == 0)
+    {
+      // the frames, oldest first.
+      std::rotate(frames_.begin(), frames_.begin() + 1, frames_.end());
+      using Result = std::decay_t<decltype(fn())>;
+      if constexpr (std::is_same_v<Result, DSPVectorArray<ROWS>>)
+      {
+        const DSPVectorArray<ROWS> y = fn();
+        for (int j = 0; j < ROWS; ++j)
+        {
+          frames_[3][j] = y.constRow(j)[kFloatsPerDSPVector - 1];
+        }
+      }
+      else
+      {
+        frames_[3] = fn();
+      }
+    }
+
+    // the position of each sample in the period, from just after 0 to 1.
+    const float periodSamples = float(period_ * kFloatsPerDSPVector);
+    const DSPVector t =
+        (columnIndex() + DSPVector(float(position_ * kFloatsPerDSPVector + 1))) /
+        DSPVector(periodSamples);
+    if (++position_ == period_) position_ = 0;
+
+    DSPVectorArray<ROWS> y;
+    if (interpolation_ == Interpolation::kLinear)
+    {
+      for (int j = 0; j < ROWS; ++j)
+      {
+        const float y0 = frames_[2][j];
+        y.row(j) = DSPVector(y0) + DSPVector(frames_[3][j] - y0) * t;
+      }
+    }
+    else
+    {
+      for (int j = 0; j < ROWS; ++j)
+      {
+        const float p0 = frames_[0][j], p1 = frames_[1][j];
+        const float p2 = frames_[2][j], p3 = frames_[3][j];
+        const DSPVector c1(0.5f * (p2 - p0));
+        const DSPVector c2(p0 - 2.5f * p1 + 2.f * p2 - 0.5f * p3);
+        const DSPVector c3(0.5f * (p3 - p0) + 1.5f * (p1 - p2));
+        y.row(j) = DSPVector(p1) + t * (c1 + t * (c2 + t * c3));
+      }
+    }
+    return y;
+  }
+
+ private:
+  std::array<std::array<float, ROWS>, 4> frames_;
+  int period_{1};
+  int position_{0};
+  Interpolation interpolation_{Interpolation::kLinear};
+};
+
 }  // namespace ml
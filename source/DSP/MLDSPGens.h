@@ -14,6 +14,11 @@
 
 #pragma once
 
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "ffft/FFTRealFixLen.h"
 #include "MLDSPFunctional.h"
 #include "MLDSPOps.h"
 #include "MLDSPUtils.h"
@@ -46,6 +51,25 @@ class TickGen
   }
 };
 
+// a windowed sinc of odd size N at the frequency omega in cycles per sample, normalized to a
+// sum of 1, made at compile time.
+template <size_t N>
+constexpr std::array<float, N> makeWindowedSincTable(double omega)
+{
+  static_assert(N % 2 == 1, "makeWindowedSincTable: N must be odd");
+  constexpr auto window = makeWindowTable<N>(dspwindows::blackmanFn);
+  std::array<double, N> sinc{};
+  double sum{0.};
+  for (size_t i = 0; i < N; ++i)
+  {
+    const double x = static_cast<double>(i) - (N - 1) / 2;
+    const double pi_x = 2. * const_math::kPiDouble * omega * x;
+    sinc[i] = ((x == 0.) ? 1. : const_math::sin(pi_x) / pi_x) * window[i];
+    sum += sinc[i];
+  }
+  return makeTable<N>([&](size_t i) { return sinc[i] / sum; });
+}
+
 // generate an antialiased impulse, repeating at a frequency given by the input.
 // limitations to fix:
 //     frequency can't be higher than sr / table size.
@@ -54,28 +78,13 @@ class ImpulseGen
 {
   // pick odd table size to get sample-centered sinc and window
   static constexpr int kTableSize{17};
-  DSPVector _table;
-  static_assert(kTableSize < kFloatsPerDSPVector,
-                "ImpulseGen: table size must be < the DSP vector size.");
+  static constexpr std::array<float, kTableSize> _table{makeWindowedSincTable<kTableSize>(0.25)};
 
   int _outputCounter{0};
   float _omega{0.f};
 
  public:
-  ImpulseGen()
-  {
-    // make windowed sinc table
-    DSPVector windowVec;
-    makeWindow(windowVec.getBuffer(), kTableSize, dspwindows::blackman);
-    const float omega = 0.25f;
-    auto sincFn{[&](int i)
-                {
-                  float pi_x = ml::kTwoPi * omega * i;
-                  return (i == 0) ? 1.f : sinf(pi_x) / pi_x;
-                }};
-    DSPVector sincVec = map(sincFn, columnIndexInt() - DSPVectorInt((kTableSize - 1) / 2));
-    _table = normalize(sincVec * windowVec);
-  }
+  ImpulseGen() = default;
   ~ImpulseGen() {}
 
   inline DSPVector operator()(const DSPVector cyclesPerSample)
@@ -147,6 +156,57 @@ class NoiseGen
   uint32_t mSeed = 0;
 };
 
+// generate a random number from -1 to 1 every sample, like NoiseGen, but
+// using independent xorshift generators in each SIMD lane so that a whole
+// DSPVector is made without a scalar loop. The sequence is not the same as
+// NoiseGen's, but is deterministic given the seed.
+class FastNoiseGen
+{
+ public:
+  FastNoiseGen() { setSeed(0); }
+  ~FastNoiseGen() {}
+
+  // seed each lane from an LCG stepped from x. xorshift states must be nonzero.
+  inline void setSeed(uint32_t x)
+  {
+    SIMDVectorIntUnion u;
+    for (int i = 0; i < kIntsPerSIMDVector; ++i)
+    {
+      x = x * 0x0019660D + 0x3C6EF35F;
+      u.i[i] = x ? x : 1;
+    }
+    mState = u.v;
+  }
+
+  inline DSPVector operator()()
+  {
+    DSPVector y;
+    float* py1 = y.getBuffer();
+    const SIMDVectorInt kExponent = vecSet1Int(0x3F800000);
+    const SIMDVectorFloat kTwo = vecSet1(2.f);
+    const SIMDVectorFloat kThree = vecSet1(3.f);
+    SIMDVectorInt x = mState;
+    for (int n = 0; n < kSIMDVectorsPerDSPVector; ++n)
+    {
+      x = vecXorInt(x, vecShiftLeftInt(x, 13));
+      x = vecXorInt(x, vecShiftRightInt(x, 17));
+      x = vecXorInt(x, vecShiftLeftInt(x, 5));
+
+      // put 23 random bits in the mantissa to make a float in [1, 2)
+      SIMDVectorFloat f = VecI2F(vecOrInt(vecShiftRightInt(x, 9), kExponent));
+      vecStore(py1, vecSub(vecMul(f, kTwo), kThree));
+      py1 += kFloatsPerSIMDVector;
+    }
+    mState = x;
+    return y;
+  }
+
+  void reset() { setSeed(0); }
+
+ private:
+  SIMDVectorInt mState;
+};
+
 // super slow + accurate sine generator for testing
 class TestSineGen
 {
@@ -401,6 +461,364 @@ class SawGen
   DSPVector operator()(const DSPVector freq) { return phasorToSaw(_phasor(freq), freq); }
 };
 
+// ----------------------------------------------------------------
+// Wavetable
+
+// Wavetable: a set of single-cycle frames, with band-limited mip levels made when the table is
+// loaded. Level L has kSize >> L samples per frame and keeps only the harmonics below half
+// that, so that reading it at any frequency up to 1 / (kSize >> L) cycles per sample does not
+// alias. Making a table allocates and does FFTs, so should be done off the audio thread.
+
+class Wavetable
+{
+ public:
+  static constexpr int kSizeBits{11};
+  static constexpr int kSize{1 << kSizeBits};
+
+  // the last level has four samples per frame, enough for the fundamental alone.
+  static constexpr int kLevels{kSizeBits - 1};
+
+  Wavetable() : Wavetable(nullptr, 1) {}
+
+  // make a table from frames of frameSize samples each, stored one after another. Frames of
+  // other sizes than kSize are resampled by linear interpolation.
+  Wavetable(const float* pFrames, size_t frames, size_t frameSize = kSize)
+      : frames_(std::max(frames, size_t(1)))
+  {
+    size_t total{0};
+    for (int level = 0; level < kLevels; ++level)
+    {
+      levelStart_[level] = total;
+      total += frames_ * (getLevelSize(level) + 1);
+    }
+    data_.resize(total);
+    if (!pFrames || !frames || !frameSize) return;
+
+    using FFT = ffft::FFTRealFixLen<kSizeBits>;
+    auto fft = std::make_unique<FFT>();
+    std::vector<float> x(kSize), spectrum(kSize), bandLimited(kSize);
+    for (size_t frame = 0; frame < frames_; ++frame)
+    {
+      const float* pSrc = pFrames + frame * frameSize;
+      for (int n = 0; n < kSize; ++n)
+      {
+        float u = n * float(frameSize) / kSize;
+        size_t i = size_t(u);
+        float a = pSrc[i];
+        float b = pSrc[(i + 1) % frameSize];
+        x[n] = a + (u - i) * (b - a);
+      }
+      fft->do_fft(spectrum.data(), x.data());
+
+      // ffft stores real parts of bins [0, N/2] at [0, N/2] and imaginary parts of bins
+      // [1, N/2 - 1] at [N/2 + 1, N - 1]. Going down a level, clear the bins that no longer fit.
+      int maxBin = kSize / 2;
+      for (int level = 0; level < kLevels; ++level)
+      {
+        const int levelSize = getLevelSize(level);
+        const int step = kSize / levelSize;
+        for (; maxBin >= levelSize / 2; --maxBin)
+        {
+          spectrum[maxBin] = 0.f;
+          if (maxBin < kSize / 2) spectrum[kSize / 2 + maxBin] = 0.f;
+        }
+        fft->do_ifft(spectrum.data(), bandLimited.data());
+
+        // the band-limited frame can be decimated without aliasing. A guard point after the
+        // end repeats the start, for interpolating.
+        float* pDest = data_.data() + levelStart_[level] + frame * (levelSize + 1);
+        for (int n = 0; n < levelSize; ++n)
+        {
+          pDest[n] = bandLimited[n * step] * (1.f / kSize);
+        }
+        pDest[levelSize] = pDest[0];
+      }
+    }
+  }
+
+  size_t getFrames() const { return frames_; }
+  static int getLevelSize(int level) { return kSize >> level; }
+
+  // the samples of one frame at one level, followed by the guard point.
+  const float* getFrame(int level, size_t frame) const
+  {
+    return data_.data() + levelStart_[level] + frame * (getLevelSize(level) + 1);
+  }
+
+  // the first level that does not alias at the given frequency in cycles per sample.
+  static int getLevel(float cyclesPerSample)
+  {
+    int level{0};
+    float x = fabsf(cyclesPerSample) * kSize;
+    while ((x > 1.f) && (level < kLevels - 1))
+    {
+      x *= 0.5f;
+      level++;
+    }
+    return level;
+  }
+
+  // read at phases on [0, 1) and frame positions on [0, 1] from levels given per lane by their
+  // size and start index, interpolating linearly between samples and between frames.
+  SIMDVectorFloat read(SIMDVectorFloat phase, SIMDVectorFloat position, SIMDVectorFloat size,
+                       SIMDVectorFloat start) const
+  {
+    const float* t = data_.data();
+    const SIMDVectorFloat vOne = vecSet1(1.f);
+    const SIMDVectorFloat vLastFrame = vecSet1(float(frames_ - 1));
+    const SIMDVectorInt vOneInt = vecSetInt1(1);
+
+    SIMDVectorFloat u = vecMul(phase, size);
+    SIMDVectorInt iu = vecFloatToIntTruncate(u);
+    SIMDVectorFloat fu = vecSub(u, vecIntToFloat(iu));
+
+    SIMDVectorFloat v = vecMul(vecClamp(position, vecZeros(), vOne), vLastFrame);
+    SIMDVectorFloat frame0 = vecIntToFloat(vecFloatToIntTruncate(v));
+    SIMDVectorFloat fv = vecSub(v, frame0);
+    SIMDVectorFloat frame1 = vecMin(vecAdd(frame0, vOne), vLastFrame);
+
+    SIMDVectorFloat stride = vecAdd(size, vOne);
+    SIMDVectorInt i0 = vecAddInt(vecFloatToIntTruncate(vecAdd(start, vecMul(frame0, stride))), iu);
+    SIMDVectorInt i1 = vecAddInt(vecFloatToIntTruncate(vecAdd(start, vecMul(frame1, stride))), iu);
+
+    SIMDVectorFloat a0 = vecGather(t, i0);
+    SIMDVectorFloat a1 = vecGather(t, vecAddInt(i0, vOneInt));
+    SIMDVectorFloat b0 = vecGather(t, i1);
+    SIMDVectorFloat b1 = vecGather(t, vecAddInt(i1, vOneInt));
+    SIMDVectorFloat a = vecAdd(a0, vecMul(fu, vecSub(a1, a0)));
+    SIMDVectorFloat b = vecAdd(b0, vecMul(fu, vecSub(b1, b0)));
+    return vecAdd(a, vecMul(fv, vecSub(b, a)));
+  }
+
+  float getLevelStart(int level) const { return float(levelStart_[level]); }
+
+  // the phase of a 32-bit accumulator as a float on [0, 1). Only the top 24 bits are used, so
+  // that the result is exact and never rounds up to 1.
+  static SIMDVectorFloat phaseToFloat(SIMDVectorInt omega32)
+  {
+    return vecMul(vecIntToFloat(vecShiftRightInt(omega32, 8)), vecSet1(1.f / (1 << 24)));
+  }
+
+ private:
+  size_t frames_{1};
+  std::array<size_t, kLevels> levelStart_{};
+  std::vector<float> data_;
+};
+
+// WavetableGen plays a Wavetable. It takes the frequency in cycles per sample and the position
+// between the first and last frames on [0, 1]. The mip level is chosen once per DSPVector from
+// the highest frequency in it. The table is not owned and must outlive the generator.
+class WavetableGen
+{
+  const Wavetable* table_{nullptr};
+  uint32_t omega32_{0};
+
+ public:
+  static constexpr float stepsPerCycle{static_cast<float>(const_math::pow(2., 32))};
+
+  WavetableGen() = default;
+  explicit WavetableGen(const Wavetable* table) : table_(table) {}
+
+  void setTable(const Wavetable* table) { table_ = table; }
+  void clear(uint32_t omega = 0) { omega32_ = omega; }
+
+  DSPVector operator()(const DSPVector cyclesPerSample, const DSPVector position = DSPVector(0.f))
+  {
+    // accumulate 32-bit phase with wrap as in PhasorGen
+    DSPVectorInt intStepsPerSampleV = roundFloatToInt(cyclesPerSample * DSPVector(stepsPerCycle));
+    DSPVectorInt omega32V;
+    for (int n = 0; n < kIntsPerDSPVector; ++n)
+    {
+      omega32_ += intStepsPerSampleV[n];
+      omega32V[n] = omega32_;
+    }
+
+    DSPVector y;
+    if (!table_) return y;
+
+    const int level = Wavetable::getLevel(max(abs(cyclesPerSample)));
+    const SIMDVectorFloat vSize = vecSet1(float(Wavetable::getLevelSize(level)));
+    const SIMDVectorFloat vStart = vecSet1(table_->getLevelStart(level));
+    const float* pOmega = omega32V.getConstBuffer();
+    const float* pPosition = position.getConstBuffer();
+    float* py = y.getBuffer();
+    for (int n = 0; n < kSIMDVectorsPerDSPVector; ++n)
+    {
+      SIMDVectorFloat phase = Wavetable::phaseToFloat(VecF2I(vecLoad(pOmega)));
+      vecStore(py, table_->read(phase, vecLoad(pPosition), vSize, vStart));
+      pOmega += kFloatsPerSIMDVector;
+      pPosition += kFloatsPerSIMDVector;
+      py += kFloatsPerSIMDVector;
+    }
+    return y;
+  }
+};
+
+// WavetableBank plays VOICES oscillators from one Wavetable, with the phases of the voices in
+// the lanes of SIMD vectors so that kFloatsPerSIMDVector voices are run by each instruction.
+// The inputs and output have one row per voice, as in Bank<WavetableGen, VOICES>, and are
+// transposed to and from frame major order around the oscillators.
+template <int VOICES>
+class WavetableBank
+{
+  static_assert(VOICES % kFloatsPerSIMDVector == 0,
+                "WavetableBank: VOICES must be a multiple of the SIMD vector size.");
+  static constexpr int kGroups{VOICES / kFloatsPerSIMDVector};
+
+  const Wavetable* table_{nullptr};
+  std::array<SIMDVectorInt, kGroups> omega32_;
+
+ public:
+  WavetableBank() { clear(); }
+  explicit WavetableBank(const Wavetable* table) : table_(table) { clear(); }
+
+  void setTable(const Wavetable* table) { table_ = table; }
+  void clear()
+  {
+    for (auto& omega : omega32_) omega = vecSetInt1(0);
+  }
+
+  DSPVectorArray<VOICES> operator()(const DSPVectorArray<VOICES>& cyclesPerSample,
+                                    const DSPVectorArray<VOICES>& position)
+  {
+    DSPVectorArray<VOICES> y;
+    DSPVectorArray<VOICES> steps, positions;
+    storeFrames(cyclesPerSample * DSPVectorArray<VOICES>(WavetableGen::stepsPerCycle),
+                steps.getBuffer(), kFloatsPerDSPVector);
+    storeFrames(position, positions.getBuffer(), kFloatsPerDSPVector);
+
+    // each voice reads the level for its highest frequency in this DSPVector.
+    alignas(kBytesPerSIMDVector) std::array<float, VOICES> sizes, starts;
+    for (int v = 0; v < VOICES; ++v)
+    {
+      const int level = Wavetable::getLevel(max(abs(cyclesPerSample.constRow(v))));
+      sizes[v] = float(Wavetable::getLevelSize(level));
+      starts[v] = table_ ? table_->getLevelStart(level) : 0.f;
+    }
+
+    const float* pSteps = steps.getBuffer();
+    const float* pPositions = positions.getBuffer();
+    float* pFrames = y.getBuffer();
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      for (int g = 0; g < kGroups; ++g)
+      {
+        SIMDVectorInt& omega = omega32_[g];
+        omega = vecAddInt(omega, vecFloatToIntRound(vecLoad(pSteps)));
+        if (table_)
+        {
+          const size_t lane = g * kFloatsPerSIMDVector;
+          SIMDVectorFloat yv =
+              table_->read(Wavetable::phaseToFloat(omega), vecLoad(pPositions),
+                           vecLoad(sizes.data() + lane), vecLoad(starts.data() + lane));
+          vecStore(pFrames, yv);
+        }
+        pSteps += kFloatsPerSIMDVector;
+        pPositions += kFloatsPerSIMDVector;
+        pFrames += kFloatsPerSIMDVector;
+      }
+    }
+    if (!table_) return DSPVectorArray<VOICES>();
+
+    // the output was made frame major in place: put each voice back on its own row.
+    DSPVectorArray<VOICES> out;
+    std::array<float*, VOICES> rows;
+    for (int v = 0; v < VOICES; ++v)
+    {
+      rows[v] = out.getBuffer() + v * kFloatsPerDSPVector;
+    }
+    deinterleave(y.getConstBuffer(), rows.data(), VOICES, kFloatsPerDSPVector);
+    return out;
+  }
+};
+
+// AdditiveBank sums PARTIALS sine partials into one DSPVector. Each partial is a rotating
+// complex phasor in one lane of a SIMD vector, so kFloatsPerSIMDVector partials are advanced
+// by each instruction with no calls to sin or cos. The rotations are made once per DSPVector
+// and the phasors are renormalized after each one, so the amplitudes do not drift.
+//
+// The frequencies in cycles per sample and the amplitudes of the partials are given each
+// DSPVector as arrays of PARTIALS floats. Amplitudes ramp linearly to their new values over
+// the DSPVector. Partials at or above the Nyquist frequency are silenced, and groups of
+// kFloatsPerSIMDVector partials that are silent for a whole DSPVector are skipped.
+template <int PARTIALS>
+class AdditiveBank
+{
+  static_assert(PARTIALS % kFloatsPerSIMDVector == 0,
+                "AdditiveBank: PARTIALS must be a multiple of the SIMD vector size.");
+  static constexpr int kGroups{PARTIALS / kFloatsPerSIMDVector};
+
+  std::array<SIMDVectorFloat, kGroups> re_;
+  std::array<SIMDVectorFloat, kGroups> im_;
+  std::array<SIMDVectorFloat, kGroups> amp_;
+
+ public:
+  AdditiveBank() { clear(); }
+
+  // start all partials at phase 0 and amplitude 0.
+  void clear()
+  {
+    for (int g = 0; g < kGroups; ++g)
+    {
+      re_[g] = vecSet1(1.f);
+      im_[g] = vecZeros();
+      amp_[g] = vecZeros();
+    }
+  }
+
+  DSPVector operator()(const float* pFrequencies, const float* pAmplitudes)
+  {
+    // one sum per sample, with a partial sum in each lane.
+    std::array<SIMDVectorFloat, kFloatsPerDSPVector> sums;
+    sums.fill(vecZeros());
+
+    const SIMDVectorFloat vNyquist = vecSet1(0.5f);
+    const SIMDVectorFloat vRampStep = vecSet1(1.f / kFloatsPerDSPVector);
+    const SIMDVectorFloat vThreeHalves = vecSet1(1.5f);
+    const SIMDVectorFloat vHalf = vecSet1(0.5f);
+
+    for (int g = 0; g < kGroups; ++g)
+    {
+      SIMDVectorFloat f = vecLoadUnaligned(pFrequencies + g * kFloatsPerSIMDVector);
+      SIMDVectorFloat a1 = vecLoadUnaligned(pAmplitudes + g * kFloatsPerSIMDVector);
+      a1 = vecAnd(a1, vecLessThan(vecAbs(f), vNyquist));
+      SIMDVectorFloat a0 = amp_[g];
+      amp_[g] = a1;
+
+      if (vecMaxH(vecMax(vecAbs(a0), vecAbs(a1))) == 0.f) continue;
+
+      SIMDVectorFloat s, c;
+      vecSinCos(vecMul(f, vecSet1(kTwoPi)), &s, &c);
+
+      SIMDVectorFloat re = re_[g];
+      SIMDVectorFloat im = im_[g];
+      SIMDVectorFloat a = a0;
+      SIMDVectorFloat da = vecMul(vecSub(a1, a0), vRampStep);
+      for (int n = 0; n < kFloatsPerDSPVector; ++n)
+      {
+        SIMDVectorFloat re1 = vecSub(vecMul(re, c), vecMul(im, s));
+        im = vecAdd(vecMul(re, s), vecMul(im, c));
+        re = re1;
+        a = vecAdd(a, da);
+        sums[n] = vecAdd(sums[n], vecMul(a, im));
+      }
+
+      // scale the phasor back to unit length, with one Newton step toward 1 / sqrt(r).
+      SIMDVectorFloat r = vecAdd(vecMul(re, re), vecMul(im, im));
+      SIMDVectorFloat k = vecSub(vThreeHalves, vecMul(vHalf, r));
+      re_[g] = vecMul(re, k);
+      im_[g] = vecMul(im, k);
+    }
+
+    DSPVector y;
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      y[n] = vecSumH(sums[n]);
+    }
+    return y;
+  }
+};
+
 // ----------------------------------------------------------------
 // Interpolator1
 
@@ -538,6 +956,8 @@ class SampleAccurateLinearGlide
     mSamplesRemaining = 0;
   }
 
+  bool isGliding() const { return mSamplesRemaining >= 0; }
+
   float nextSample(float f)
   {
     // set target value if different from current value.
@@ -589,4 +1009,580 @@ class SampleAccurateLinearGlide
   }
 };
 
+// GlideBank: N LinearGlides in parallel arrays, updated together with SIMD once per DSPVector.
+// When a target changes, its glide starts from the current value and reaches the target after
+// the glide time, rounded to whole DSPVectors, as in SmoothingBank. The output has the
+// sample-accurate ramp of glide i on row i.
+//
+// The output is kept between calls and only the rows of glides that moved are rewritten, so
+// idle glides cost only their part of one SIMD comparison per DSPVector.
+template <int N>
+class GlideBank
+{
+  static constexpr int kPadded{(N + kFloatsPerSIMDVector - 1) / kFloatsPerSIMDVector *
+                               kFloatsPerSIMDVector};
+
+  std::array<float, kPadded> current_;
+  std::array<float, kPadded> glideTarget_;
+  std::array<float, kPadded> step_;
+  std::array<float, kPadded> remaining_;
+  std::array<float, kPadded> vectorsPerGlide_;
+  std::array<float, kPadded> dyPerVector_;
+
+  // 1 where the row of the output is not yet constant at the current value.
+  std::array<float, kPadded> stale_;
+  DSPVectorArray<N> output_;
+
+ public:
+  GlideBank()
+  {
+    vectorsPerGlide_.fill(1.f);
+    dyPerVector_.fill(1.f);
+    clear();
+  }
+
+  void setGlideTimeInSamples(int i, float t)
+  {
+    float vectors = std::max(1.f, std::floor(t / kFloatsPerDSPVector));
+    vectorsPerGlide_[i] = vectors;
+    dyPerVector_[i] = 1.f / vectors;
+  }
+
+  void setGlideTimeInSamples(float t)
+  {
+    for (int i = 0; i < N; ++i)
+    {
+      setGlideTimeInSamples(i, t);
+    }
+  }
+
+  // set the value immediately, without gliding. It is output from the next DSPVector, where
+  // any different target starts a glide from it.
+  void setValue(int i, float f)
+  {
+    current_[i] = glideTarget_[i] = f;
+    step_[i] = remaining_[i] = 0.f;
+    stale_[i] = 1.f;
+  }
+
+  float getValue(int i) const { return current_[i]; }
+  bool isGliding(int i) const { return remaining_[i] > 0.f; }
+
+  // glide toward an array of N targets, returning the glides for one DSPVector.
+  const DSPVectorArray<N>& operator()(const float* pTargets)
+  {
+    const SIMDVectorFloat zeros = vecZeros();
+    const SIMDVectorFloat ones = vecSet1(1.f);
+    for (int i = 0; i < kPadded; i += kFloatsPerSIMDVector)
+    {
+      // the padding after N targets is never read.
+      SIMDVectorFloat target;
+      if (i + kFloatsPerSIMDVector <= N)
+      {
+        target = vecLoadUnaligned(pTargets + i);
+      }
+      else
+      {
+        alignas(kBytesPerSIMDVector) float t[kFloatsPerSIMDVector]{};
+        std::copy(pTargets + i, pTargets + N, t);
+        target = vecLoad(t);
+      }
+
+      SIMDVectorFloat changed = vecNotEqual(target, vecLoadUnaligned(&glideTarget_[i]));
+      SIMDVectorFloat remaining = vecLoadUnaligned(&remaining_[i]);
+      SIMDVectorFloat stale = vecLoadUnaligned(&stale_[i]);
+
+      // skip groups with no glides to start, continue or finish writing.
+      SIMDVectorFloat busy = vecMax(vecAnd(changed, ones), vecMax(remaining, stale));
+      if (vecMaxH(busy) == 0.f) continue;
+
+      SIMDVectorFloat previous = vecLoadUnaligned(&current_[i]);
+      SIMDVectorFloat step = vecLoadUnaligned(&step_[i]);
+
+      // start new glides where the target has changed.
+      SIMDVectorFloat dy = vecLoadUnaligned(&dyPerVector_[i]);
+      SIMDVectorFloat newStep = vecMul(vecSub(target, previous), dy);
+      step = vecSelect(newStep, step, changed);
+      remaining = vecSelect(vecLoadUnaligned(&vectorsPerGlide_[i]), remaining, changed);
+
+      // step, and land exactly on the target at the end.
+      SIMDVectorFloat current = vecAdd(previous, step);
+      remaining = vecMax(vecSub(remaining, ones), zeros);
+      SIMDVectorFloat done = vecLessThanOrEqual(remaining, zeros);
+      current = vecSelect(target, current, done);
+      step = vecSelect(zeros, step, done);
+
+      // rows that moved get a ramp and must be made constant after they stop.
+      SIMDVectorFloat moved = vecAnd(vecNotEqual(current, previous), ones);
+      SIMDVectorFloat write = vecMax(moved, stale);
+
+      vecStoreUnaligned(&current_[i], current);
+      vecStoreUnaligned(&glideTarget_[i], target);
+      vecStoreUnaligned(&step_[i], step);
+      vecStoreUnaligned(&remaining_[i], remaining);
+      vecStoreUnaligned(&stale_[i], moved);
+
+      alignas(kBytesPerSIMDVector) float writeLanes[kFloatsPerSIMDVector];
+      alignas(kBytesPerSIMDVector) float startLanes[kFloatsPerSIMDVector];
+      vecStore(writeLanes, write);
+      vecStore(startLanes, previous);
+      for (int j = 0; j < kFloatsPerSIMDVector && i + j < N; ++j)
+      {
+        if (writeLanes[j] != 0.f)
+        {
+          float start = startLanes[j];
+          float end = current_[i + j];
+          output_.row(i + j) = DSPVector(start) + kUnityRampVec * DSPVector(end - start);
+        }
+      }
+    }
+    return output_;
+  }
+
+  void clear()
+  {
+    current_.fill(0.f);
+    glideTarget_.fill(0.f);
+    step_.fill(0.f);
+    remaining_.fill(0.f);
+    stale_.fill(0.f);
+    output_ = DSPVectorArray<N>(0.f);
+  }
+};
+
+// LFOBank: N low-frequency oscillators for modulation, sharing one beat phase.
+//
+// Each LFO is synced at a ratio of cycles per quarter note, or free-running at a frequency in
+// cycles per sample, and has a phase offset in cycles and a shape. The settings and state are
+// kept in arrays by LFO. Each call takes the quarter-note phasor of the current vector, as from
+// AudioContext::getBeatPhase(), and counts its wraps, so that synced LFOs slower than one cycle
+// per quarter note stay locked to the bars. The phase of each LFO is then made for the whole
+// vector at once with SIMD, and shaped into row i of the output.
+//
+// While the transport is stopped, and the beat phase is negative, synced LFOs keep running at
+// the last tempo. When it starts again, they restart in sync with the beat. Random LFOs get a
+// new value at the start of each cycle, held or smoothly approached over the cycle. LFOs must
+// be slower than one cycle per DSPVector.
+
+enum class LFOShape
+{
+  kSine,
+  kTriangle,
+  kSaw,
+  kSquare,
+  kSampleAndHold,
+  kSmoothRandom
+};
+
+template <int N>
+class LFOBank
+{
+  std::array<LFOShape, N> shape_;
+  std::array<bool, N> synced_;
+  std::array<float, N> rate_;
+  std::array<float, N> offset_;
+
+  // the phase of each free-running LFO at the end of the last vector, and of each LFO at its
+  // last sample.
+  std::array<float, N> freePhase_;
+  std::array<float, N> lastPhase_;
+
+  // random LFOs go from value0_ to value1_ over their current cycle.
+  std::array<float, N> value0_;
+  std::array<float, N> value1_;
+  std::array<RandomScalarSource, N> randoms_;
+
+  // the whole quarter notes since the transport started, the phase at the last sample of the
+  // last vector, or -1 if stopped, and the tempo in quarter notes per sample.
+  double quarters_{0.};
+  float lastBeat_{-1.f};
+  float lastBeatPosition_{0.f};
+  float quartersPerSample_{0.f};
+
+  DSPVectorArray<N> output_;
+
+ public:
+  LFOBank()
+  {
+    shape_.fill(LFOShape::kSine);
+    synced_.fill(true);
+    rate_.fill(1.f);
+    offset_.fill(0.f);
+    clear();
+  }
+
+  void setShape(int i, LFOShape s) { shape_[i] = s; }
+
+  // run LFO i at a ratio of cycles per quarter note.
+  void setSyncedRate(int i, float cyclesPerQuarterNote)
+  {
+    synced_[i] = true;
+    rate_[i] = cyclesPerQuarterNote;
+  }
+
+  // run LFO i freely at a frequency in cycles per sample.
+  void setFreeRate(int i, float cyclesPerSample)
+  {
+    synced_[i] = false;
+    rate_[i] = cyclesPerSample;
+  }
+
+  // set the phase offset in cycles, from 0 to 1.
+  void setPhaseOffset(int i, float cycles) { offset_[i] = cycles; }
+
+  // make the LFOs for one DSPVector from the beat phase.
+  const DSPVectorArray<N>& operator()(const DSPVector& beatPhase)
+  {
+    const DSPVector beats = advanceBeats(beatPhase);
+    const DSPVector samples = columnIndex() + DSPVector(1.f);
+    const double wholeQuarters = quarters_;
+    for (int i = 0; i < N; ++i)
+    {
+      DSPVector phase;
+      if (synced_[i])
+      {
+        // the whole quarters are applied in double precision, once per vector.
+        double q = wholeQuarters * rate_[i];
+        float start = float(q - std::floor(q)) + offset_[i];
+        phase = fractionalPart(DSPVector(start) + beats * DSPVector(rate_[i]));
+      }
+      else
+      {
+        phase = fractionalPart(DSPVector(freePhase_[i] + offset_[i]) + samples * rate_[i]);
+        float next = freePhase_[i] + rate_[i] * kFloatsPerDSPVector;
+        freePhase_[i] = next - std::floor(next);
+      }
+      output_.row(i) = shape(i, phase);
+      lastPhase_[i] = phase[kFloatsPerDSPVector - 1];
+    }
+    if (lastBeatPosition_ >= 1.f)
+    {
+      quarters_ += 1.;
+      lastBeatPosition_ -= 1.f;
+    }
+    return output_;
+  }
+
+  void clear()
+  {
+    freePhase_.fill(0.f);
+    lastPhase_.fill(0.f);
+    for (int i = 0; i < N; ++i)
+    {
+      randoms_[i].seed_ = uint32_t(i) * 0x9E3779B9u + 1u;
+      value0_[i] = randoms_[i].getFloat();
+      value1_[i] = randoms_[i].getFloat();
+    }
+    quarters_ = 0.;
+    lastBeat_ = -1.f;
+    lastBeatPosition_ = 0.f;
+    quartersPerSample_ = 0.f;
+    output_ = DSPVectorArray<N>(0.f);
+  }
+
+ private:
+  // the beat position of each sample in quarter notes from quarters_, from 0 to 2.
+  DSPVector advanceBeats(const DSPVector& beatPhase)
+  {
+    const float first = beatPhase[0];
+    DSPVector beats;
+    if (first >= 0.f)
+    {
+      if (lastBeat_ < 0.f)
+      {
+        quarters_ = 0.;
+      }
+      else if (first < lastBeat_)
+      {
+        quarters_ += 1.;
+      }
+
+      // a wrap within the vector leaves the later samples below the first.
+      beats = beatPhase + select(DSPVector(1.f), DSPVector(0.f),
+                                 lessThan(beatPhase, DSPVector(first)));
+      quartersPerSample_ =
+          (beats[kFloatsPerDSPVector - 1] - first) / float(kFloatsPerDSPVector - 1);
+      lastBeat_ = beatPhase[kFloatsPerDSPVector - 1];
+    }
+    else
+    {
+      // keep going at the last tempo.
+      beats = DSPVector(lastBeatPosition_) +
+              (columnIndex() + DSPVector(1.f)) * DSPVector(quartersPerSample_);
+      lastBeat_ = -1.f;
+    }
+    lastBeatPosition_ = beats[kFloatsPerDSPVector - 1];
+    return beats;
+  }
+
+  DSPVector shape(int i, const DSPVector& phase)
+  {
+    switch (shape_[i])
+    {
+      case LFOShape::kSine:
+      default:
+        return sin(phase * DSPVector(kTwoPi));
+      case LFOShape::kTriangle:
+        return DSPVector(1.f) - DSPVector(4.f) * abs(fractionalPart(phase + DSPVector(0.25f)) -
+                                                     DSPVector(0.5f));
+      case LFOShape::kSaw:
+        return phase * DSPVector(2.f) - DSPVector(1.f);
+      case LFOShape::kSquare:
+        return select(DSPVector(1.f), DSPVector(-1.f), lessThan(phase, DSPVector(0.5f)));
+      case LFOShape::kSampleAndHold:
+      case LFOShape::kSmoothRandom:
+        return random(i, phase);
+    }
+  }
+
+  // the index of the sample where a new cycle starts, or kFloatsPerDSPVector if none does.
+  int findWrap(int i, const DSPVector& phase) const
+  {
+    const float first = phase[0];
+    if (first < lastPhase_[i]) return 0;
+    float below = sum(select(DSPVector(1.f), DSPVector(0.f), lessThan(phase, DSPVector(first))));
+    return kFloatsPerDSPVector - int(below);
+  }
+
+  DSPVector random(int i, const DSPVector& phase)
+  {
+    const int wrap = findWrap(i, phase);
+    float a = value0_[i];
+    float b = value1_[i];
+    float c = b;
+    if (wrap < kFloatsPerDSPVector)
+    {
+      c = randoms_[i].getFloat();
+      value0_[i] = b;
+      value1_[i] = c;
+    }
+    const auto after = greaterThanOrEqual(columnIndex(), DSPVector(float(wrap)));
+    if (shape_[i] == LFOShape::kSampleAndHold)
+    {
+      return select(DSPVector(c), DSPVector(b), after);
+    }
+
+    // a smoothstep from each value to the next over a cycle.
+    const DSPVector from = select(DSPVector(b), DSPVector(a), after);
+    const DSPVector to = select(DSPVector(c), DSPVector(b), after);
+    const DSPVector s = phase * phase * (DSPVector(3.f) - DSPVector(2.f) * phase);
+    return from + (to - from) * s;
+  }
+};
+
+// RandomBank: N independent streams of random numbers, made together with SIMD.
+//
+// Each value is a hash of the seed, the stream's index and the number of values the stream has
+// made before, using the counter-based Threefry-2x32 generator of Salmon et al. with 13 rounds,
+// which needs only integer adds, rotates and xors. So a stream makes the same sequence for a
+// seed however many other streams are drawn with it, and each voice of a synth can keep its own.
+//
+// uniform() and gaussian() make one new value for each of the first n streams. smooth() makes
+// one DSPVector for each stream of random values on [-1, 1], reached one after another with a
+// smoothstep curve at the stream's own rate. The smooth rates must be slower than one cycle
+// per DSPVector.
+template <int N>
+class RandomBank
+{
+  static constexpr int kPadded{(N + kFloatsPerSIMDVector - 1) / kFloatsPerSIMDVector *
+                               kFloatsPerSIMDVector};
+
+  // keys separating the streams drawn by uniform() and gaussian() from the smooth streams.
+  static constexpr uint32_t kDrawKey{0};
+  static constexpr uint32_t kSmoothKey{1};
+
+  uint32_t seed_{0};
+  std::array<uint32_t, kPadded> indices_;
+  std::array<uint32_t, kPadded> counters_;
+  std::array<float, kPadded> uniform_;
+  std::array<float, kPadded> gaussian_;
+
+  // the rate of each smooth stream in cycles per sample, its phase and its number of cycles.
+  std::array<float, kPadded> smoothRate_;
+  std::array<float, kPadded> smoothPhase_;
+  std::array<uint32_t, kPadded> smoothCycles_;
+  std::array<std::array<float, kPadded>, 3> smoothValues_;
+  DSPVectorArray<N> smoothOutput_;
+
+ public:
+  RandomBank()
+  {
+    for (int i = 0; i < kPadded; ++i)
+    {
+      indices_[i] = uint32_t(i);
+    }
+    smoothRate_.fill(0.f);
+    clear();
+  }
+
+  // set the seed, restarting all the streams.
+  void setSeed(uint32_t seed)
+  {
+    seed_ = seed;
+    clear();
+  }
+
+  void setSmoothRate(int i, float cyclesPerSample) { smoothRate_[i] = cyclesPerSample; }
+
+  // uniform random values on [-1, 1), one for each of the first n streams.
+  const std::array<float, kPadded>& uniform(int n = N)
+  {
+    for (int i = 0; i < n; i += kFloatsPerSIMDVector)
+    {
+      SIMDVectorInt x0, x1;
+      draw(i, x0, x1);
+      vecStoreUnaligned(&uniform_[i], toUniform(x0));
+    }
+    restoreCounters(n);
+    return uniform_;
+  }
+
+  // normally distributed random values with mean 0 and variance 1, by the Box-Muller method.
+  const std::array<float, kPadded>& gaussian(int n = N)
+  {
+    const SIMDVectorFloat ones = vecSet1(1.f);
+    const SIMDVectorFloat twoPi = vecSet1(kTwoPi);
+    for (int i = 0; i < n; i += kFloatsPerSIMDVector)
+    {
+      SIMDVectorInt x0, x1;
+      draw(i, x0, x1);
+
+      // u1 is on (0, 1] and u2 on [0, 1).
+      SIMDVectorFloat u1 = vecSub(vecSet1(2.f), toOneToTwo(x0));
+      SIMDVectorFloat u2 = vecSub(toOneToTwo(x1), ones);
+      SIMDVectorFloat r = vecSqrt(vecMul(vecSet1(-2.f), vecLog(u1)));
+      vecStoreUnaligned(&gaussian_[i], vecMul(r, vecCos(vecMul(twoPi, u2))));
+    }
+    restoreCounters(n);
+    return gaussian_;
+  }
+
+  // the smooth random streams for one DSPVector.
+  const DSPVectorArray<N>& smooth()
+  {
+    // the values at the start of each stream's cycle and of the next two.
+    for (int k = 0; k < 3; ++k)
+    {
+      for (int i = 0; i < kPadded; i += kFloatsPerSIMDVector)
+      {
+        SIMDVectorInt x0 = vecAddInt(loadInt(&smoothCycles_[i]), vecSet1Int(k));
+        SIMDVectorInt x1 = loadInt(&indices_[i]);
+        threefry(x0, x1, seed_, kSmoothKey);
+        vecStoreUnaligned(&smoothValues_[k][i], toUniform(x0));
+      }
+    }
+
+    const DSPVector samples = columnIndex() + DSPVector(1.f);
+    for (int i = 0; i < N; ++i)
+    {
+      const DSPVector phase = DSPVector(smoothPhase_[i]) + samples * DSPVector(smoothRate_[i]);
+      const auto wrapped = greaterThanOrEqual(phase, DSPVector(1.f));
+      const DSPVector p = select(phase - DSPVector(1.f), phase, wrapped);
+      const DSPVector v0(smoothValues_[0][i]), v1(smoothValues_[1][i]), v2(smoothValues_[2][i]);
+      const DSPVector from = select(v1, v0, wrapped);
+      const DSPVector to = select(v2, v1, wrapped);
+      const DSPVector s = p * p * (DSPVector(3.f) - DSPVector(2.f) * p);
+      smoothOutput_.row(i) = from + (to - from) * s;
+
+      float next = phase[kFloatsPerDSPVector - 1];
+      if (next >= 1.f)
+      {
+        next -= 1.f;
+        smoothCycles_[i]++;
+      }
+      smoothPhase_[i] = next;
+    }
+    return smoothOutput_;
+  }
+
+  // restart all the streams from the beginning of their sequences.
+  void clear()
+  {
+    counters_.fill(0);
+    uniform_.fill(0.f);
+    gaussian_.fill(0.f);
+    smoothPhase_.fill(0.f);
+    smoothCycles_.fill(0);
+    smoothOutput_ = DSPVectorArray<N>(0.f);
+  }
+
+ private:
+  static SIMDVectorInt loadInt(const uint32_t* p)
+  {
+    return VecF2I(vecLoadUnaligned(reinterpret_cast<const float*>(p)));
+  }
+
+  static void storeInt(uint32_t* p, SIMDVectorInt x)
+  {
+    vecStoreUnaligned(reinterpret_cast<float*>(p), VecI2F(x));
+  }
+
+  // hash the counters of a group of streams, then advance them.
+  void draw(int i, SIMDVectorInt& x0, SIMDVectorInt& x1)
+  {
+    SIMDVectorInt counters = loadInt(&counters_[i]);
+    x0 = counters;
+    x1 = loadInt(&indices_[i]);
+    threefry(x0, x1, seed_, kDrawKey);
+    storeInt(&counters_[i], vecAddInt(counters, vecSet1Int(1)));
+  }
+
+  // undo the advance of the streams after n in the last group drawn.
+  void restoreCounters(int n)
+  {
+    const int end = (n + kFloatsPerSIMDVector - 1) / kFloatsPerSIMDVector * kFloatsPerSIMDVector;
+    for (int i = n; i < end; ++i)
+    {
+      counters_[i]--;
+    }
+  }
+
+  // floats on [1, 2) from the high bits.
+  static SIMDVectorFloat toOneToTwo(SIMDVectorInt x)
+  {
+    return VecI2F(vecOrInt(vecShiftRightInt(x, 9), vecSet1Int(0x3F800000)));
+  }
+
+  static SIMDVectorFloat toUniform(SIMDVectorInt x)
+  {
+    return vecSub(vecMul(toOneToTwo(x), vecSet1(2.f)), vecSet1(3.f));
+  }
+
+  template <int R>
+  static void mix(SIMDVectorInt& x0, SIMDVectorInt& x1)
+  {
+    x0 = vecAddInt(x0, x1);
+    x1 = vecOrInt(vecShiftLeftInt(x1, R), vecShiftRightInt(x1, 32 - R));
+    x1 = vecXorInt(x1, x0);
+  }
+
+  static void inject(SIMDVectorInt& x0, SIMDVectorInt& x1, const uint32_t* ks, uint32_t s)
+  {
+    x0 = vecAddInt(x0, vecSet1Int(ks[s % 3]));
+    x1 = vecAddInt(x1, vecSet1Int(ks[(s + 1) % 3] + s));
+  }
+
+  static void threefry(SIMDVectorInt& x0, SIMDVectorInt& x1, uint32_t k0, uint32_t k1)
+  {
+    const uint32_t ks[3]{k0, k1, 0x1BD11BDA ^ k0 ^ k1};
+    inject(x0, x1, ks, 0);
+    mix<13>(x0, x1);
+    mix<15>(x0, x1);
+    mix<26>(x0, x1);
+    mix<6>(x0, x1);
+    inject(x0, x1, ks, 1);
+    mix<17>(x0, x1);
+    mix<29>(x0, x1);
+    mix<16>(x0, x1);
+    mix<24>(x0, x1);
+    inject(x0, x1, ks, 2);
+    mix<13>(x0, x1);
+    mix<15>(x0, x1);
+    mix<26>(x0, x1);
+    mix<6>(x0, x1);
+    inject(x0, x1, ks, 3);
+    mix<17>(x0, x1);
+  }
+};
+
 }  // namespace ml
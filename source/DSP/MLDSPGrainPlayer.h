@@ -0,0 +1,346 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// MLDSPGrainPlayer.h
+// Granular playback of a Sample.
+//
+// A GrainPlayer plays any number of short windowed grains of a Sample at once, each with its own
+// start position, rate, length, gain and, for two outputs, pan, and sums them to CHANNELS
+// outputs. Grains come from a pool of fixed capacity allocated in the constructor. They can be
+// started by trigger(), for instance in response to events, or by a cloud that starts grains at
+// a given density with random jitter. Both run on the audio thread, without locks or
+// allocation.
+//
+// Each active grain is rendered kFloatsPerSIMDVector samples at a time: the positions in the
+// sample, the window and the masks for the start and end of the grain are computed across SIMD
+// lanes, and the frames around each position are read with gathered loads and interpolated
+// linearly or with a cubic (Hermite) curve. Output channels past those of the sample repeat
+// them, as for SamplePlayer.
+//
+// To keep the cost of a dense cloud bounded, updateLoad() can be given the DSP load once per
+// vector, for example from AudioContext::LoadMeter. While the load is above the limit, the
+// number of grains that can start is lowered, and it recovers slowly once the load is below.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+#include "MLDSPOps.h"
+#include "MLDSPSample.h"
+#include "MLDSPScalarMath.h"
+#include "MLDSPUtils.h"
+
+namespace ml
+{
+template <size_t CHANNELS = 1>
+class GrainPlayer
+{
+ public:
+  static constexpr size_t kDefaultMaxGrains{256};
+  static constexpr int kWindowSize{1024};
+
+  struct Grain
+  {
+    // the first frame read in the sample.
+    double position{0.};
+
+    // frames to advance for each output sample. Negative rates play backwards.
+    float rate{1.f};
+
+    // the duration of the grain in output samples.
+    float length{1024.f};
+
+    float gain{1.f};
+
+    // from -1 (left) to 1 (right), with constant power. Used only with two outputs.
+    float pan{0.f};
+  };
+
+  // grains started automatically, at density grains per sample. Each grain is a copy of grain
+  // with its position, rate and pan moved by up to the jitter amounts in either direction.
+  struct Cloud
+  {
+    float density{0.f};
+    Grain grain;
+    float positionJitter{0.f};
+    float rateJitter{0.f};
+    float panJitter{0.f};
+  };
+
+  explicit GrainPlayer(size_t maxGrains = kDefaultMaxGrains, bool cubic = true)
+      : cubic_(cubic), grains_(std::max(maxGrains, size_t(1))), grainLimit_(grains_.size())
+  {
+    setWindow(dspwindows::raisedCosine);
+  }
+
+  // play grains from the sample, which must stay valid while it is played. Any grains playing
+  // are stopped.
+  void setSample(const Sample* pSample)
+  {
+    sample_ = usable(pSample) ? pSample : nullptr;
+    frames_ = sample_ ? getFrames(*sample_) : 0;
+    stride_ = sample_ ? int32_t(sample_->channels) : 1;
+    for (size_t c = 0; c < CHANNELS; ++c)
+    {
+      channelOffset_[c] = int32_t(c % size_t(stride_));
+    }
+    clear();
+  }
+
+  // set the shape of the grain window, a function on [0, 1].
+  void setWindow(Projection shape)
+  {
+    for (int i = 0; i <= kWindowSize; ++i)
+    {
+      window_[i] = shape(float(i) / kWindowSize);
+    }
+  }
+
+  void setCloud(const Cloud& cloud) { cloud_ = cloud; }
+
+  // start a grain at the given sample offset into the next output vector. Returns false if the
+  // grain could not start because there are already as many grains as the limit.
+  bool trigger(const Grain& g, int offset = 0)
+  {
+    if ((activeGrains_ >= grainLimit_) || !(g.length >= 1.f))
+    {
+      droppedGrains_++;
+      return false;
+    }
+    ActiveGrain& a = grains_[activeGrains_++];
+    double first = std::floor(g.position);
+    a.base = int32_t(first);
+    a.frac = float(g.position - first);
+    a.rate = g.rate;
+    a.length = g.length;
+    a.age = -std::clamp(offset, 0, int(kFloatsPerDSPVector) - 1);
+    if constexpr (CHANNELS == 2)
+    {
+      float theta = (std::clamp(g.pan, -1.f, 1.f) + 1.f) * kPi * 0.25f;
+      a.gains = {g.gain * cosf(theta), g.gain * sinf(theta)};
+    }
+    else
+    {
+      a.gains.fill(g.gain);
+    }
+    return true;
+  }
+
+  // stop all the grains.
+  void clear() { activeGrains_ = 0; }
+
+  size_t getMaxGrains() const { return grains_.size(); }
+  size_t getActiveGrains() const { return activeGrains_; }
+  size_t getGrainLimit() const { return grainLimit_; }
+
+  // the number of grains that could not start since the player was made.
+  size_t getDroppedGrains() const { return droppedGrains_; }
+
+  // the load above which fewer grains are allowed to start, as a ratio of real time.
+  void setLoadLimit(float load) { loadLimit_ = load; }
+
+  // adjust the grain limit for the current DSP load. Call once per vector, if at all.
+  void updateLoad(float load)
+  {
+    if (load > loadLimit_)
+    {
+      grainLimit_ = std::max(activeGrains_ - activeGrains_ / 8, size_t(1));
+    }
+    else if (load < loadLimit_ * 0.9f)
+    {
+      grainLimit_ = std::min(grainLimit_ + 1 + grainLimit_ / 64, grains_.size());
+    }
+  }
+
+  DSPVectorArray<CHANNELS> operator()()
+  {
+    DSPVectorArray<CHANNELS> y;
+    if (cloud_.density > 0.f) scheduleCloud();
+    if (!sample_) return y;
+
+    for (size_t i = 0; i < activeGrains_;)
+    {
+      ActiveGrain& g = grains_[i];
+      if (cubic_)
+      {
+        renderGrain<true>(g, y);
+      }
+      else
+      {
+        renderGrain<false>(g, y);
+      }
+
+      // a finished grain is replaced by the last active one.
+      g.age += kFloatsPerDSPVector;
+      if (g.age >= g.length)
+      {
+        g = grains_[--activeGrains_];
+      }
+      else
+      {
+        ++i;
+      }
+    }
+    return y;
+  }
+
+ private:
+  struct ActiveGrain
+  {
+    // the starting position, as a whole frame and a fraction.
+    int32_t base;
+    float frac;
+    float rate;
+    float length;
+
+    // the age in samples at the start of the next vector, negative before the grain starts.
+    int32_t age;
+    std::array<float, CHANNELS> gains;
+  };
+
+  void scheduleCloud()
+  {
+    const Cloud& c = cloud_;
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      cloudPhase_ += c.density;
+      while (cloudPhase_ >= 1.f)
+      {
+        cloudPhase_ -= 1.f;
+        Grain g = c.grain;
+        g.position += c.positionJitter * random_.getFloat();
+        g.rate += c.rateJitter * random_.getFloat();
+        g.pan += c.panJitter * random_.getFloat();
+        trigger(g, n);
+      }
+    }
+  }
+
+  template <bool kCubic>
+  void renderGrain(const ActiveGrain& g, DSPVectorArray<CHANNELS>& y)
+  {
+    const SIMDVectorFloat vZeroF = vecZeros();
+    const SIMDVectorInt vZero = vecSetInt1(0);
+    const SIMDVectorInt vOne = vecSetInt1(1);
+    const SIMDVectorInt vLastFrame = vecSetInt1(uint32_t(int32_t(frames_) - 1));
+    const SIMDVectorInt vLastWindow = vecSetInt1(uint32_t(kWindowSize - 1));
+    const SIMDVectorInt vBase = vecSetInt1(uint32_t(g.base));
+    const SIMDVectorFloat vLength = vecSet1(g.length);
+    const SIMDVectorFloat vWindowScale = vecSet1(kWindowSize / g.length);
+    const SIMDVectorFloat vRate = vecSet1(g.rate);
+    const SIMDVectorFloat vFrac = vecSet1(g.frac);
+    const SIMDVectorFloat vStart = vecSet1(float(g.base));
+    const SIMDVectorFloat vFrames = vecSet1(float(frames_));
+
+    // the index of each lane, for making the ages of its samples.
+    SIMDVectorFloatUnion lanes;
+    for (int j = 0; j < kFloatsPerSIMDVector; ++j)
+    {
+      lanes.f[j] = float(j);
+    }
+
+    // stride times a vector of frame indices, without an integer multiply.
+    auto toElements = [&](SIMDVectorInt frame) {
+      SIMDVectorInt e = frame;
+      for (int32_t s = 1; s < stride_; ++s)
+      {
+        e = vecAddInt(e, frame);
+      }
+      return e;
+    };
+
+    // floor of a vector, as ints.
+    auto floorInt = [](SIMDVectorFloat x) {
+      SIMDVectorInt i = vecFloatToIntTruncate(x);
+      SIMDVectorFloat below = vecGreaterThan(vecIntToFloat(i), x);
+      return vecAddInt(i, VecF2I(below));
+    };
+
+    for (int k = 0; k < kSIMDVectorsPerDSPVector; ++k)
+    {
+      const int first = k * kFloatsPerSIMDVector;
+      if (g.age + first >= g.length) break;
+      if (g.age + first + kFloatsPerSIMDVector <= 0) continue;
+
+      SIMDVectorFloat vAge = vecAdd(vecSet1(float(g.age + first)), lanes.v);
+
+      // the window, zero before the start and after the end of the grain.
+      SIMDVectorFloat u = vecMul(vAge, vWindowScale);
+      SIMDVectorInt wi = vecMinInt(vecMaxInt(floorInt(u), vZero), vLastWindow);
+      SIMDVectorFloat wt = vecSub(u, vecIntToFloat(wi));
+      SIMDVectorFloat w0 = vecGather(window_.data(), wi);
+      SIMDVectorFloat w1 = vecGather(window_.data(), vecAddInt(wi, vOne));
+      SIMDVectorFloat w = vecAdd(w0, vecMul(wt, vecSub(w1, w0)));
+      SIMDVectorFloat inGrain =
+          vecAnd(vecGreaterThanOrEqual(vAge, vZeroF), vecLessThan(vAge, vLength));
+
+      // the positions, silent outside the sample.
+      SIMDVectorFloat offset = vecAdd(vFrac, vecMul(vAge, vRate));
+      SIMDVectorInt fi = floorInt(offset);
+      SIMDVectorFloat t = vecSub(offset, vecIntToFloat(fi));
+      SIMDVectorInt frame = vecAddInt(vBase, fi);
+      SIMDVectorFloat p = vecAdd(vStart, offset);
+      SIMDVectorFloat inSample =
+          vecAnd(vecGreaterThanOrEqual(p, vZeroF), vecLessThan(p, vFrames));
+      w = vecAnd(w, vecAnd(inGrain, inSample));
+
+      auto tap = [&](SIMDVectorInt f, const float* pData) {
+        return vecGather(pData, toElements(vecMinInt(vecMaxInt(f, vZero), vLastFrame)));
+      };
+
+      for (size_t c = 0; c < CHANNELS; ++c)
+      {
+        const float* pData = sample_->sampleData.data() + channelOffset_[c];
+        SIMDVectorFloat x0 = tap(frame, pData);
+        SIMDVectorFloat x1 = tap(vecAddInt(frame, vOne), pData);
+        SIMDVectorFloat r;
+        if (kCubic)
+        {
+          SIMDVectorFloat xm1 = tap(vecSubInt(frame, vOne), pData);
+          SIMDVectorFloat x2 = tap(vecAddInt(frame, vecSetInt1(2)), pData);
+          const SIMDVectorFloat kHalf = vecSet1(0.5f);
+          SIMDVectorFloat c1 = vecMul(kHalf, vecSub(x1, xm1));
+          SIMDVectorFloat c2 = vecSub(vecAdd(xm1, vecAdd(x1, x1)),
+                                      vecAdd(vecMul(vecSet1(2.5f), x0), vecMul(kHalf, x2)));
+          SIMDVectorFloat c3 = vecAdd(vecMul(kHalf, vecSub(x2, xm1)),
+                                      vecMul(vecSet1(1.5f), vecSub(x0, x1)));
+          r = vecAdd(vecMul(vecAdd(vecMul(vecAdd(vecMul(c3, t), c2), t), c1), t), x0);
+        }
+        else
+        {
+          r = vecAdd(x0, vecMul(t, vecSub(x1, x0)));
+        }
+
+        float* py = y.row(c).getBuffer() + first;
+        SIMDVectorFloat gain = vecMul(w, vecSet1(g.gains[c]));
+        vecStore(py, vecAdd(vecLoad(py), vecMul(r, gain)));
+      }
+    }
+  }
+
+  bool cubic_;
+  const Sample* sample_{nullptr};
+  size_t frames_{0};
+  int32_t stride_{1};
+  std::array<int32_t, CHANNELS> channelOffset_{};
+
+  // the window, with a guard point at the end for interpolating.
+  std::array<float, kWindowSize + 1> window_{};
+
+  // the pool. The first activeGrains_ are playing.
+  std::vector<ActiveGrain> grains_;
+  size_t activeGrains_{0};
+  size_t grainLimit_;
+  size_t droppedGrains_{0};
+  float loadLimit_{0.8f};
+
+  Cloud cloud_;
+  float cloudPhase_{0.f};
+  RandomScalarSource random_;
+};
+
+}  // namespace ml
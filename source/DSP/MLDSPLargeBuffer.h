@@ -0,0 +1,288 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// LargeBuffer: a std::vector for long delay lines, FDN memories, convolution partitions and
+// sample data, with an allocator that maps its memory directly from the system.
+//
+// Random reads into buffers of many megabytes miss the TLB often with ordinary pages, and on
+// machines with more than one socket they can go to the memory of the other socket. A
+// LargeBufferPolicy can ask for the memory to be backed by huge pages, to be placed on the
+// NUMA node of the worker thread that processes it, and to be prefaulted when it is
+// allocated, so that the first access from the audio thread is never a page fault.
+//
+// - Transparent huge pages are asked for with madvise() on Linux, for a range aligned to
+//   2MB. The system may still use small pages.
+// - Explicit huge pages come from the hugetlbfs pool on Linux and need large page privileges
+//   on Windows. If none are available, the buffer is mapped as with transparent huge pages.
+// - The node is a preference: if it has no free memory, pages come from another one. The node
+//   of a core is in CPUTopology. NUMA placement is supported on Linux and Windows.
+//
+// Buffers smaller than minBytes come from the heap, as with std::allocator. Allocation is not
+// real-time safe: like resizing any vector, resize LargeBuffers at setup.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include "MLMemoryUtils.h"
+#include "MLPlatform.h"
+
+#if ML_WINDOWS
+#include <windows.h>
+#elif ML_MAC || ML_IOS
+#include <sys/mman.h>
+#include <unistd.h>
+#elif ML_LINUX
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace ml
+{
+enum class HugePages
+{
+  kNone,
+  kTransparent,
+  kExplicit
+};
+
+struct LargeBufferPolicy
+{
+  HugePages hugePages{HugePages::kTransparent};
+
+  // the NUMA node to place the memory on, or -1 for the node of the thread first touching it.
+  int numaNode{-1};
+
+  // touch each page when the buffer is allocated.
+  bool prefault{true};
+
+  // smaller buffers come from the heap.
+  size_t minBytes{size_t(1) << 20};
+
+  bool operator==(const LargeBufferPolicy& b) const
+  {
+    return (hugePages == b.hugePages) && (numaNode == b.numaNode) && (prefault == b.prefault) &&
+           (minBytes == b.minBytes);
+  }
+  bool operator!=(const LargeBufferPolicy& b) const { return !(*this == b); }
+};
+
+namespace largeBuffer
+{
+constexpr size_t kHugePageSize{size_t(1) << 21};
+
+#if ML_WINDOWS || ML_MAC || ML_IOS || ML_LINUX
+constexpr bool kCanMap{true};
+#else
+constexpr bool kCanMap{false};
+#endif
+
+inline size_t roundUp(size_t bytes, size_t multiple)
+{
+  return (bytes + multiple - 1) / multiple * multiple;
+}
+
+inline size_t getPageSize()
+{
+#if ML_MAC || ML_IOS || ML_LINUX
+  return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#else
+  return 4096;
+#endif
+}
+
+// true if a buffer of this size is mapped rather than taken from the heap.
+inline bool isMapped(size_t bytes, const LargeBufferPolicy& policy)
+{
+  return kCanMap && bytes && (bytes >= policy.minBytes);
+}
+
+// the length of the mapping made for a buffer. Explicit huge pages are mapped in whole pages.
+inline size_t getMappedLength(size_t bytes, const LargeBufferPolicy& policy)
+{
+  return roundUp(bytes, (policy.hugePages == HugePages::kExplicit) ? kHugePageSize : getPageSize());
+}
+
+#if ML_LINUX
+// prefer the node for the pages of a range not yet touched.
+inline void bindToNode(void* p, size_t length, int node)
+{
+#if defined(SYS_mbind)
+  constexpr int kPreferred{1};
+  constexpr int kMaxNodes{1024};
+  constexpr int kBitsPerLong = int(sizeof(unsigned long) * 8);
+  if ((node < 0) || (node >= kMaxNodes)) return;
+  unsigned long mask[kMaxNodes / kBitsPerLong]{};
+  mask[node / kBitsPerLong] = 1UL << (node % kBitsPerLong);
+  syscall(SYS_mbind, p, length, kPreferred, mask, kMaxNodes, 0);
+#endif
+}
+
+// map a range aligned to a huge page, so that it can be backed by transparent huge pages.
+inline void* mapAligned(size_t length)
+{
+  const int prot = PROT_READ | PROT_WRITE;
+  void* r = mmap(nullptr, length + kHugePageSize, prot, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (r == MAP_FAILED) return nullptr;
+
+  // unmap the ends outside of the aligned range.
+  char* c = static_cast<char*>(r);
+  const uintptr_t u = reinterpret_cast<uintptr_t>(c);
+  char* start = c + (roundUp(u, kHugePageSize) - u);
+  const size_t head = size_t(start - c);
+  if (head) munmap(c, head);
+  munmap(start + length, kHugePageSize - head);
+#if defined(MADV_HUGEPAGE)
+  madvise(start, length, MADV_HUGEPAGE);
+#endif
+  return start;
+}
+#endif
+
+// map memory for a buffer of bytes following the policy. Returns nullptr on failure.
+inline void* map(size_t bytes, const LargeBufferPolicy& policy)
+{
+  const size_t length = getMappedLength(bytes, policy);
+  void* p{nullptr};
+
+#if ML_WINDOWS
+  const DWORD node = (policy.numaNode >= 0) ? DWORD(policy.numaNode) : NUMA_NO_PREFERRED_NODE;
+  const size_t largePage = GetLargePageMinimum();
+  if ((policy.hugePages == HugePages::kExplicit) && largePage)
+  {
+    p = VirtualAllocExNuma(GetCurrentProcess(), nullptr, roundUp(bytes, largePage),
+                           MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE, node);
+  }
+  if (!p)
+  {
+    p = VirtualAllocExNuma(GetCurrentProcess(), nullptr, length, MEM_RESERVE | MEM_COMMIT,
+                           PAGE_READWRITE, node);
+  }
+
+#elif ML_LINUX
+  const int prot = PROT_READ | PROT_WRITE;
+#if defined(MAP_HUGETLB)
+  if (policy.hugePages == HugePages::kExplicit)
+  {
+#if defined(MAP_HUGE_SHIFT)
+    const int kHuge2MB = 21 << MAP_HUGE_SHIFT;
+#else
+    const int kHuge2MB = 0;
+#endif
+    p = mmap(nullptr, length, prot, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | kHuge2MB, -1, 0);
+    if (p == MAP_FAILED) p = nullptr;
+  }
+#endif
+  if (!p)
+  {
+    if (policy.hugePages == HugePages::kNone)
+    {
+      p = mmap(nullptr, length, prot, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (p == MAP_FAILED) p = nullptr;
+    }
+    else
+    {
+      p = mapAligned(length);
+    }
+  }
+  if (p && (policy.numaNode >= 0)) bindToNode(p, length, policy.numaNode);
+
+#elif ML_MAC || ML_IOS
+  p = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED) p = nullptr;
+#endif
+
+  if (p && policy.prefault) ml::prefault(p, length);
+  return p;
+}
+
+inline void unmap(void* p, size_t bytes, const LargeBufferPolicy& policy)
+{
+  if (!p) return;
+#if ML_WINDOWS
+  VirtualFree(p, 0, MEM_RELEASE);
+#elif ML_MAC || ML_IOS || ML_LINUX
+  munmap(p, getMappedLength(bytes, policy));
+#endif
+}
+}  // namespace largeBuffer
+
+template <class T>
+class LargeBufferAllocator
+{
+ public:
+  using value_type = T;
+  using propagate_on_container_copy_assignment = std::true_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+
+  LargeBufferAllocator() = default;
+  explicit LargeBufferAllocator(const LargeBufferPolicy& policy) : policy_(policy) {}
+  template <class U>
+  LargeBufferAllocator(const LargeBufferAllocator<U>& other) : policy_(other.getPolicy())
+  {
+  }
+
+  const LargeBufferPolicy& getPolicy() const { return policy_; }
+
+  T* allocate(size_t n)
+  {
+    if (n > std::numeric_limits<size_t>::max() / sizeof(T)) throw std::bad_alloc();
+    const size_t bytes = n * sizeof(T);
+    if (!largeBuffer::isMapped(bytes, policy_)) return std::allocator<T>().allocate(n);
+    void* p = largeBuffer::map(bytes, policy_);
+    if (!p) throw std::bad_alloc();
+    return static_cast<T*>(p);
+  }
+
+  void deallocate(T* p, size_t n)
+  {
+    const size_t bytes = n * sizeof(T);
+    if (!largeBuffer::isMapped(bytes, policy_))
+    {
+      std::allocator<T>().deallocate(p, n);
+    }
+    else
+    {
+      largeBuffer::unmap(p, bytes, policy_);
+    }
+  }
+
+ private:
+  LargeBufferPolicy policy_;
+};
+
+template <class T, class U>
+bool operator==(const LargeBufferAllocator<T>& a, const LargeBufferAllocator<U>& b)
+{
+  return a.getPolicy() == b.getPolicy();
+}
+
+template <class T, class U>
+bool operator!=(const LargeBufferAllocator<T>& a, const LargeBufferAllocator<U>& b)
+{
+  return !(a == b);
+}
+
+template <class T>
+using LargeBuffer = std::vector<T, LargeBufferAllocator<T>>;
+
+// replace a buffer with one of the same size allocated following the policy. The contents are
+// value-initialized.
+template <class T>
+void setBufferPolicy(LargeBuffer<T>& buffer, const LargeBufferPolicy& policy)
+{
+  if (buffer.get_allocator().getPolicy() == policy) return;
+  LargeBuffer<T> b(buffer.size(), T(), LargeBufferAllocator<T>(policy));
+  buffer.swap(b);
+}
+
+}  // namespace ml
@@ -4,16 +4,21 @@
 
 #pragma once
 
-// Here is the DSP vector size, an important constant.
-constexpr size_t kFloatsPerDSPVectorBits = 6;
+// Here is the DSP vector size, an important constant. It is 64 unless ML_DSP_VECTOR_BITS is
+// defined for the whole build: smaller vectors give less latency in live processing, and larger
+// ones more throughput in offline rendering.
+#ifndef ML_DSP_VECTOR_BITS
+#define ML_DSP_VECTOR_BITS 6
+#endif
+constexpr size_t kFloatsPerDSPVectorBits = ML_DSP_VECTOR_BITS;
 constexpr size_t kFloatsPerDSPVector = 1 << kFloatsPerDSPVectorBits;
-static_assert((kFloatsPerDSPVectorBits <= 8),
-              "We count on kFloatsPerDSPVectorBits to be 8 or less.");
+static_assert((kFloatsPerDSPVectorBits >= 4) && (kFloatsPerDSPVectorBits <= 8),
+              "We count on kFloatsPerDSPVectorBits to be from 4 to 8.");
 
 // Load definitions for low-level SIMD math.
 // These must define SIMDVectorFloat, SIMDVectorInt, their sizes, and a bunch of
-// operations on them. We are currently only using 4-element vectors on both SSE
-// and NEON.
+// operations on them. SSE, NEON and WebAssembly SIMD128 use 4-element vectors. Defining
+// ML_USE_AVX when compiling for AVX2 selects 8-element vectors instead.
 
 #if (defined __ARM_NEON) || (defined __ARM_NEON__)
 
@@ -22,6 +27,19 @@ static_assert((kFloatsPerDSPVectorBits <= 8),
 #define ML_SSE_TO_NEON
 #include "MLDSPMathNEON.h"
 
+#elif defined __wasm_simd128__
+
+// WebAssembly SIMD128
+
+#define ML_SSE_TO_WASM
+#include "MLDSPMathWASM.h"
+
+#elif (defined ML_USE_AVX) && (defined __AVX2__)
+
+// AVX2
+
+#include "MLDSPMathAVX.h"
+
 #else
 
 // SSE2
@@ -0,0 +1,1077 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// MLDSPMathAVX.h
+// AVX2 implementations of madronalib SIMD primitives. This header is selected
+// by MLDSPMath.h when ML_USE_AVX is defined and the compiler targets AVX2.
+// It provides the same interface as MLDSPMathSSE.h with 8 floats per SIMD
+// vector, so a DSPVector is processed in 8 SIMD operations instead of 16.
+
+// cephes-derived approximate math functions adapted from code by Julien
+// Pommier, licensed as follows:
+/*
+ Copyright (C) 2007  Julien Pommier
+
+ This software is provided 'as-is', without any express or implied
+ warranty.  In no event will the authors be held liable for any damages
+ arising from the use of this software.
+
+ Permission is granted to anyone to use this software for any purpose,
+ including commercial applications, and to alter it and redistribute it
+ freely, subject to the following restrictions:
+
+ 1. The origin of this software must not be misrepresented; you must not
+ claim that you wrote the original software. If you use this software
+ in a product, an acknowledgment in the product documentation would be
+ appreciated but is not required.
+ 2. Altered source versions must be plainly marked as such, and must not be
+ misrepresented as being the original software.
+ 3. This notice may not be removed or altered from any source distribution.
+
+ (this is the zlib license)
+ */
+
+#include "MLPlatform.h"
+
+#include <immintrin.h>
+
+#include <float.h>
+
+#pragma once
+
+#ifdef _MSC_VER /* visual c++ */
+#define ALIGN32_BEG __declspec(align(32))
+#define ALIGN32_END
+#else /* gcc or icc */
+#define ALIGN32_BEG
+#define ALIGN32_END __attribute__((aligned(32)))
+#endif
+
+// AVX types
+typedef __m256 SIMDVectorFloat;
+typedef __m256i SIMDVectorInt;
+
+// AVX casts
+#define VecF2I _mm256_castps_si256
+#define VecI2F _mm256_castsi256_ps
+
+constexpr int kFloatsPerSIMDVectorBits = 3;
+constexpr int kFloatsPerSIMDVector = 1 << kFloatsPerSIMDVectorBits;
+constexpr int kSIMDVectorsPerDSPVector = kFloatsPerDSPVector / kFloatsPerSIMDVector;
+constexpr int kBytesPerSIMDVector = kFloatsPerSIMDVector * sizeof(float);
+constexpr int kSIMDVectorMask = ~(kBytesPerSIMDVector - 1);
+
+constexpr int kIntsPerSIMDVectorBits = 3;
+constexpr int kIntsPerSIMDVector = 1 << kIntsPerSIMDVectorBits;
+
+inline bool isSIMDAligned(float* p)
+{
+  uintptr_t pM = (uintptr_t)p;
+  return ((pM & kSIMDVectorMask) == 0);
+}
+
+// primitive AVX operations
+#define vecAdd _mm256_add_ps
+#define vecSub _mm256_sub_ps
+#define vecMul _mm256_mul_ps
+#define vecDiv _mm256_div_ps
+#define vecRecipApprox _mm256_rcp_ps
+#define vecDivApprox(x1, x2) (_mm256_mul_ps(x1, _mm256_rcp_ps(x2)))
+#define vecMin _mm256_min_ps
+#define vecMax _mm256_max_ps
+#define vecSqrt _mm256_sqrt_ps
+#define vecRSqrt _mm256_rsqrt_ps
+#define vecSqrtApprox(x) (vecMul(x, vecRSqrt(x)))
+#define vecAbs(x) (_mm256_andnot_ps(_mm256_set1_ps(-0.0f), x))
+
+// AVX comparisons take the predicate as an argument. The predicates are chosen
+// to match the SSE compare instructions, including their handling of NaNs.
+inline SIMDVectorFloat vecEqual(SIMDVectorFloat a, SIMDVectorFloat b)
+{
+  return _mm256_cmp_ps(a, b, _CMP_EQ_OQ);
+}
+
+inline SIMDVectorFloat vecNotEqual(SIMDVectorFloat a, SIMDVectorFloat b)
+{
+  return _mm256_cmp_ps(a, b, _CMP_NEQ_UQ);
+}
+
+inline SIMDVectorFloat vecGreaterThan(SIMDVectorFloat a, SIMDVectorFloat b)
+{
+  return _mm256_cmp_ps(a, b, _CMP_GT_OS);
+}
+
+inline SIMDVectorFloat vecGreaterThanOrEqual(SIMDVectorFloat a, SIMDVectorFloat b)
+{
+  return _mm256_cmp_ps(a, b, _CMP_GE_OS);
+}
+
+inline SIMDVectorFloat vecLessThan(SIMDVectorFloat a, SIMDVectorFloat b)
+{
+  return _mm256_cmp_ps(a, b, _CMP_LT_OS);
+}
+
+inline SIMDVectorFloat vecLessThanOrEqual(SIMDVectorFloat a, SIMDVectorFloat b)
+{
+  return _mm256_cmp_ps(a, b, _CMP_LE_OS);
+}
+
+#define vecSign(x)                                                         \
+  (_mm256_and_ps(                                                          \
+      _mm256_or_ps(_mm256_and_ps(_mm256_set1_ps(-0.0f), x), _mm256_set1_ps(1.0f)), \
+      vecNotEqual(_mm256_set1_ps(-0.0f), x)))
+
+#define vecSignBit(x) (_mm256_or_ps(_mm256_and_ps(_mm256_set1_ps(-0.0f), x), _mm256_set1_ps(1.0f)))
+#define vecClamp(x1, x2, x3) _mm256_min_ps(_mm256_max_ps(x1, x2), x3)
+#define vecWithin(x1, x2, x3) _mm256_and_ps(vecGreaterThanOrEqual(x1, x2), vecLessThan(x1, x3))
+
+#define vecSet1 _mm256_set1_ps
+
+// DSPVectors are only guaranteed 16-byte alignment, for example when allocated
+// on the heap without aligned new. So we use the unaligned forms throughout,
+// which are as fast as the aligned ones on AVX hardware when the data is aligned.
+#define vecStore _mm256_storeu_ps
+#define vecLoad _mm256_loadu_ps
+
+#define vecStoreUnaligned _mm256_storeu_ps
+#define vecLoadUnaligned _mm256_loadu_ps
+
+#define vecAnd _mm256_and_ps
+#define vecOr _mm256_or_ps
+
+#define vecZeros _mm256_setzero_ps
+#define vecOnes VecI2F(_mm256_set1_epi32(-1))
+
+#define vecFloatToIntRound _mm256_cvtps_epi32
+#define vecFloatToIntTruncate _mm256_cvttps_epi32
+#define vecIntToFloat _mm256_cvtepi32_ps
+
+// _mm256_cvtepi32_ps approximation for unsigned int data
+// this loses a bit of precision
+inline SIMDVectorFloat vecUnsignedIntToFloat(SIMDVectorInt v)
+{
+  __m256i v_hi = _mm256_srli_epi32(v, 1);
+  __m256 v_hi_flt = _mm256_cvtepi32_ps(v_hi);
+  return _mm256_add_ps(v_hi_flt, v_hi_flt);
+}
+
+#define vecAddInt _mm256_add_epi32
+#define vecSubInt _mm256_sub_epi32
+#define vecSet1Int _mm256_set1_epi32
+#define vecAndInt _mm256_and_si256
+#define vecOrInt _mm256_or_si256
+#define vecXorInt _mm256_xor_si256
+#define vecShiftLeftInt _mm256_slli_epi32
+#define vecShiftRightInt _mm256_srli_epi32
+
+typedef union
+{
+  SIMDVectorFloat v;
+  float f[8];
+} SIMDVectorFloatUnion;
+
+typedef union
+{
+  SIMDVectorInt v;
+  uint32_t i[8];
+} SIMDVectorIntUnion;
+
+inline SIMDVectorInt vecSetInt1(uint32_t a) { return _mm256_set1_epi32(a); }
+
+// load the floats at p[idx[0]], p[idx[1]], ...
+inline SIMDVectorFloat vecGather(const float* p, SIMDVectorInt idx)
+{
+  return _mm256_i32gather_ps(p, idx, 4);
+}
+
+inline std::ostream& operator<<(std::ostream& out, SIMDVectorFloat v)
+{
+  SIMDVectorFloatUnion u;
+  u.v = v;
+  out << "[";
+  for (int i = 0; i < kFloatsPerSIMDVector; ++i)
+  {
+    out << u.f[i];
+    if (i < kFloatsPerSIMDVector - 1) out << ", ";
+  }
+  out << "]";
+  return out;
+}
+
+inline std::ostream& operator<<(std::ostream& out, SIMDVectorInt v)
+{
+  SIMDVectorIntUnion u;
+  u.v = v;
+  out << "[";
+  for (int i = 0; i < kIntsPerSIMDVector; ++i)
+  {
+    out << u.i[i];
+    if (i < kIntsPerSIMDVector - 1) out << ", ";
+  }
+  out << "]";
+  return out;
+}
+
+// ----------------------------------------------------------------
+#pragma mark select
+
+inline SIMDVectorFloat vecSelect(SIMDVectorFloat a, SIMDVectorFloat b, SIMDVectorInt conditionMask)
+{
+  return _mm256_blendv_ps(b, a, VecI2F(conditionMask));
+}
+
+inline SIMDVectorFloat vecSelect(SIMDVectorFloat a, SIMDVectorFloat b,
+                                 SIMDVectorFloat conditionMask)
+{
+  return _mm256_blendv_ps(b, a, conditionMask);
+}
+
+inline SIMDVectorInt vecSelect(SIMDVectorInt a, SIMDVectorInt b, SIMDVectorInt conditionMask)
+{
+  return _mm256_or_si256(_mm256_and_si256(conditionMask, a),
+                         _mm256_andnot_si256(conditionMask, b));
+}
+
+// signed minimum and maximum.
+inline SIMDVectorInt vecMinInt(SIMDVectorInt a, SIMDVectorInt b) { return _mm256_min_epi32(a, b); }
+inline SIMDVectorInt vecMaxInt(SIMDVectorInt a, SIMDVectorInt b) { return _mm256_max_epi32(a, b); }
+
+// ----------------------------------------------------------------
+// horizontal operations returning float
+
+inline float vecSumH(SIMDVectorFloat v)
+{
+  __m128 vlow = _mm256_castps256_ps128(v);
+  __m128 vhigh = _mm256_extractf128_ps(v, 1);
+  __m128 tmp0 = _mm_add_ps(vlow, vhigh);
+  __m128 tmp1 = _mm_add_ps(tmp0, _mm_movehl_ps(tmp0, tmp0));
+  __m128 tmp2 = _mm_add_ss(tmp1, _mm_shuffle_ps(tmp1, tmp1, 1));
+  return _mm_cvtss_f32(tmp2);
+}
+
+inline float vecMaxH(SIMDVectorFloat v)
+{
+  __m128 vlow = _mm256_castps256_ps128(v);
+  __m128 vhigh = _mm256_extractf128_ps(v, 1);
+  __m128 tmp0 = _mm_max_ps(vlow, vhigh);
+  __m128 tmp1 = _mm_max_ps(tmp0, _mm_movehl_ps(tmp0, tmp0));
+  __m128 tmp2 = _mm_max_ss(tmp1, _mm_shuffle_ps(tmp1, tmp1, 1));
+  return _mm_cvtss_f32(tmp2);
+}
+
+inline float vecMinH(SIMDVectorFloat v)
+{
+  __m128 vlow = _mm256_castps256_ps128(v);
+  __m128 vhigh = _mm256_extractf128_ps(v, 1);
+  __m128 tmp0 = _mm_min_ps(vlow, vhigh);
+  __m128 tmp1 = _mm_min_ps(tmp0, _mm_movehl_ps(tmp0, tmp0));
+  __m128 tmp2 = _mm_min_ss(tmp1, _mm_shuffle_ps(tmp1, tmp1, 1));
+  return _mm_cvtss_f32(tmp2);
+}
+
+// ----------------------------------------------------------------
+// double precision vectors, for state that float would lose precision in. A float vector
+// converts to and from two double vectors, holding its low and high halves.
+
+typedef __m256d SIMDVectorDouble;
+constexpr int kDoublesPerSIMDVector = kFloatsPerSIMDVector / 2;
+
+#define vecAddD _mm256_add_pd
+#define vecSubD _mm256_sub_pd
+#define vecMulD _mm256_mul_pd
+#define vecDivD _mm256_div_pd
+#define vecMinD _mm256_min_pd
+#define vecMaxD _mm256_max_pd
+#define vecSqrtD _mm256_sqrt_pd
+#define vecSet1D _mm256_set1_pd
+#define vecZerosD _mm256_setzero_pd
+#define vecStoreD _mm256_store_pd
+#define vecLoadD _mm256_load_pd
+#define vecStoreUnalignedD _mm256_storeu_pd
+#define vecLoadUnalignedD _mm256_loadu_pd
+#define vecFloorD _mm256_floor_pd
+
+inline void vecFloatToDouble(SIMDVectorFloat x, SIMDVectorDouble& lo, SIMDVectorDouble& hi)
+{
+  lo = _mm256_cvtps_pd(_mm256_castps256_ps128(x));
+  hi = _mm256_cvtps_pd(_mm256_extractf128_ps(x, 1));
+}
+
+inline SIMDVectorFloat vecDoubleToFloat(SIMDVectorDouble lo, SIMDVectorDouble hi)
+{
+  return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(lo)), _mm256_cvtpd_ps(hi),
+                              1);
+}
+
+/* declare some AVX constants */
+#define _PS_CONST(Name, Val) \
+  static const ALIGN32_BEG float _ps_##Name[8] ALIGN32_END = {Val, Val, Val, Val, Val, Val, Val, Val}
+#define _PI32_CONST(Name, Val) \
+  static const ALIGN32_BEG int _pi32_##Name[8] ALIGN32_END = {Val, Val, Val, Val, Val, Val, Val, Val}
+#define _PS_CONST_TYPE(Name, Type, Val) \
+  static const ALIGN32_BEG Type _ps_##Name[8] ALIGN32_END = {Val, Val, Val, Val, Val, Val, Val, Val}
+
+_PS_CONST(1, 1.0f);
+_PS_CONST(0p5, 0.5f);
+
+/* the smallest non denormalized float number */
+_PS_CONST_TYPE(min_norm_pos, int, 0x00800000);
+_PS_CONST_TYPE(mant_mask, int, 0x7f800000);
+_PS_CONST_TYPE(inv_mant_mask, int, ~0x7f800000);
+
+_PS_CONST_TYPE(sign_mask, int, (int)0x80000000);
+_PS_CONST_TYPE(inv_sign_mask, int, ~0x80000000);
+
+_PI32_CONST(1, 1);
+_PI32_CONST(inv1, ~1);
+_PI32_CONST(2, 2);
+_PI32_CONST(4, 4);
+_PI32_CONST(0x7f, 0x7f);
+
+_PS_CONST(cephes_SQRTHF, 0.707106781186547524f);
+_PS_CONST(cephes_log_p0, 7.0376836292E-2f);
+_PS_CONST(cephes_log_p1, -1.1514610310E-1f);
+_PS_CONST(cephes_log_p2, 1.1676998740E-1f);
+_PS_CONST(cephes_log_p3, -1.2420140846E-1f);
+_PS_CONST(cephes_log_p4, +1.4249322787E-1f);
+_PS_CONST(cephes_log_p5, -1.6668057665E-1f);
+_PS_CONST(cephes_log_p6, +2.0000714765E-1f);
+_PS_CONST(cephes_log_p7, -2.4999993993E-1f);
+_PS_CONST(cephes_log_p8, +3.3333331174E-1f);
+_PS_CONST(cephes_log_q1, -2.12194440e-4f);
+_PS_CONST(cephes_log_q2, 0.693359375f);
+
+/* natural logarithm computed for 8 simultaneous float
+ return NaN for x <= 0
+ */
+inline SIMDVectorFloat vecLog(SIMDVectorFloat x)
+{
+  SIMDVectorInt emm0;
+  SIMDVectorFloat one = *(SIMDVectorFloat*)_ps_1;
+  SIMDVectorFloat invalid_mask = vecLessThanOrEqual(x, _mm256_setzero_ps());
+
+  x = _mm256_max_ps(x, *(SIMDVectorFloat*)_ps_min_norm_pos); /* cut off denormalized stuff */
+
+  emm0 = _mm256_srli_epi32(VecF2I(x), 23);
+
+  /* keep only the fractional part */
+  x = _mm256_and_ps(x, *(SIMDVectorFloat*)_ps_inv_mant_mask);
+  x = _mm256_or_ps(x, *(SIMDVectorFloat*)_ps_0p5);
+
+  emm0 = _mm256_sub_epi32(emm0, *(SIMDVectorInt*)_pi32_0x7f);
+  SIMDVectorFloat e = _mm256_cvtepi32_ps(emm0);
+
+  e = _mm256_add_ps(e, one);
+
+  /* part2:
+   if( x < SQRTHF ) {
+   e -= 1;
+   x = x + x - 1.0;
+   } else { x = x - 1.0; }
+   */
+  SIMDVectorFloat mask = vecLessThan(x, *(SIMDVectorFloat*)_ps_cephes_SQRTHF);
+  SIMDVectorFloat tmp = _mm256_and_ps(x, mask);
+  x = _mm256_sub_ps(x, one);
+  e = _mm256_sub_ps(e, _mm256_and_ps(one, mask));
+  x = _mm256_add_ps(x, tmp);
+
+  SIMDVectorFloat z = _mm256_mul_ps(x, x);
+
+  SIMDVectorFloat y = *(SIMDVectorFloat*)_ps_cephes_log_p0;
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps_cephes_log_p1);
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps_cephes_log_p2);
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps_cephes_log_p3);
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps_cephes_log_p4);
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps_cephes_log_p5);
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps_cephes_log_p6);
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps_cephes_log_p7);
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps_cephes_log_p8);
+  y = _mm256_mul_ps(y, x);
+
+  y = _mm256_mul_ps(y, z);
+
+  tmp = _mm256_mul_ps(e, *(SIMDVectorFloat*)_ps_cephes_log_q1);
+  y = _mm256_add_ps(y, tmp);
+
+  tmp = _mm256_mul_ps(z, *(SIMDVectorFloat*)_ps_0p5);
+  y = _mm256_sub_ps(y, tmp);
+
+  tmp = _mm256_mul_ps(e, *(SIMDVectorFloat*)_ps_cephes_log_q2);
+  x = _mm256_add_ps(x, y);
+  x = _mm256_add_ps(x, tmp);
+  x = _mm256_or_ps(x, invalid_mask);  // negative arg will be NAN
+  return x;
+}
+
+_PS_CONST(exp_hi, 88.3762626647949f);
+_PS_CONST(exp_lo, -88.3762626647949f);
+
+_PS_CONST(cephes_LOG2EF, 1.44269504088896341f);
+_PS_CONST(cephes_exp_C1, 0.693359375f);
+_PS_CONST(cephes_exp_C2, -2.12194440e-4f);
+
+_PS_CONST(cephes_exp_p0, 1.9875691500E-4f);
+_PS_CONST(cephes_exp_p1, 1.3981999507E-3f);
+_PS_CONST(cephes_exp_p2, 8.3334519073E-3f);
+_PS_CONST(cephes_exp_p3, 4.1665795894E-2f);
+_PS_CONST(cephes_exp_p4, 1.6666665459E-1f);
+_PS_CONST(cephes_exp_p5, 5.0000001201E-1f);
+
+inline SIMDVectorFloat vecExp(SIMDVectorFloat x)
+{
+  SIMDVectorFloat tmp = _mm256_setzero_ps(), fx;
+  SIMDVectorInt emm0;
+  SIMDVectorFloat one = *(SIMDVectorFloat*)_ps_1;
+
+  x = _mm256_min_ps(x, *(SIMDVectorFloat*)_ps_exp_hi);
+  x = _mm256_max_ps(x, *(SIMDVectorFloat*)_ps_exp_lo);
+
+  /* express exp(x) as exp(g + n*log(2)) */
+  fx = _mm256_mul_ps(x, *(SIMDVectorFloat*)_ps_cephes_LOG2EF);
+  fx = _mm256_add_ps(fx, *(SIMDVectorFloat*)_ps_0p5);
+
+  /* how to perform a floorf with AVX: just below */
+  emm0 = _mm256_cvttps_epi32(fx);
+  tmp = _mm256_cvtepi32_ps(emm0);
+
+  /* if greater, substract 1 */
+  SIMDVectorFloat mask = vecGreaterThan(tmp, fx);
+  mask = _mm256_and_ps(mask, one);
+  fx = _mm256_sub_ps(tmp, mask);
+
+  tmp = _mm256_mul_ps(fx, *(SIMDVectorFloat*)_ps_cephes_exp_C1);
+  SIMDVectorFloat z = _mm256_mul_ps(fx, *(SIMDVectorFloat*)_ps_cephes_exp_C2);
+  x = _mm256_sub_ps(x, tmp);
+  x = _mm256_sub_ps(x, z);
+  z = _mm256_mul_ps(x, x);
+
+  SIMDVectorFloat y = *(SIMDVectorFloat*)_ps_cephes_exp_p0;
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps_cephes_exp_p1);
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps_cephes_exp_p2);
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps_cephes_exp_p3);
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps_cephes_exp_p4);
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps_cephes_exp_p5);
+  y = _mm256_mul_ps(y, z);
+  y = _mm256_add_ps(y, x);
+  y = _mm256_add_ps(y, one);
+
+  /* build 2^n */
+  emm0 = _mm256_cvttps_epi32(fx);
+  emm0 = _mm256_add_epi32(emm0, *(SIMDVectorInt*)_pi32_0x7f);
+  emm0 = _mm256_slli_epi32(emm0, 23);
+  SIMDVectorFloat pow2n = VecI2F(emm0);
+
+  y = _mm256_mul_ps(y, pow2n);
+  return y;
+}
+
+_PS_CONST(minus_cephes_DP1, -0.78515625f);
+_PS_CONST(minus_cephes_DP2, -2.4187564849853515625e-4f);
+_PS_CONST(minus_cephes_DP3, -3.77489497744594108e-8f);
+_PS_CONST(sincof_p0, -1.9515295891E-4f);
+_PS_CONST(sincof_p1, 8.3321608736E-3f);
+_PS_CONST(sincof_p2, -1.6666654611E-1f);
+_PS_CONST(coscof_p0, 2.443315711809948E-005f);
+_PS_CONST(coscof_p1, -1.388731625493765E-003f);
+_PS_CONST(coscof_p2, 4.166664568298827E-002f);
+_PS_CONST(cephes_FOPI, 1.27323954473516f);  // 4 / M_PI
+
+/*
+ Julien Pommier:
+ The code is the exact rewriting of the cephes sinf function.
+ Precision is excellent as long as x < 8192 (I did not bother to
+ take into account the special handling they have for greater values
+ -- it does not return garbage for arguments over 8192, though, but
+ the extra precision is missing).
+
+ Note that it is such that sinf((float)M_PI) = 8.74e-8, which is the
+ surprising but correct result.
+
+ Performance is also surprisingly good, 1.33 times faster than the
+ macos vsinf SSE2 function, and 1.5 times faster than the
+ __vrs4_sinf of amd's ACML (which is only available in 64 bits). Not
+ too bad for an SSE1 function (with no special tuning) !
+ However the latter libraries probably have a much better handling of NaN,
+ Inf, denormalized and other special arguments..
+
+ On my core 1 duo, the execution of this function takes approximately 95 cycles.
+
+ From what I have observed on the experiments with Intel AMath lib, switching to
+ an SSE2 version would improve the perf by only 10%.
+
+ Since it is based on SSE intrinsics, it has to be compiled at -O2 to
+ deliver full speed.
+ */
+inline SIMDVectorFloat vecSin(SIMDVectorFloat x)
+{
+  SIMDVectorFloat xmm1, xmm2 = _mm256_setzero_ps(), xmm3, sign_bit, y;
+  SIMDVectorInt emm0, emm2;
+
+  sign_bit = x;
+  /* take the absolute value */
+  x = _mm256_and_ps(x, *(SIMDVectorFloat*)_ps_inv_sign_mask);
+  /* extract the sign bit (upper one) */
+  sign_bit = _mm256_and_ps(sign_bit, *(SIMDVectorFloat*)_ps_sign_mask);
+
+  /* scale by 4/Pi */
+  y = _mm256_mul_ps(x, *(SIMDVectorFloat*)_ps_cephes_FOPI);
+
+  /* store the integer part of y in mm0 */
+  emm2 = _mm256_cvttps_epi32(y);
+  /* j=(j+1) & (~1) (see the cephes sources) */
+  emm2 = _mm256_add_epi32(emm2, *(SIMDVectorInt*)_pi32_1);
+  emm2 = _mm256_and_si256(emm2, *(SIMDVectorInt*)_pi32_inv1);
+  y = _mm256_cvtepi32_ps(emm2);
+
+  /* get the swap sign flag */
+  emm0 = _mm256_and_si256(emm2, *(SIMDVectorInt*)_pi32_4);
+  emm0 = _mm256_slli_epi32(emm0, 29);
+  /* get the polynom selection mask
+   there is one polynom for 0 <= x <= Pi/4
+   and another one for Pi/4<x<=Pi/2
+   Both branches will be computed.
+   */
+  emm2 = _mm256_and_si256(emm2, *(SIMDVectorInt*)_pi32_2);
+  emm2 = _mm256_cmpeq_epi32(emm2, _mm256_setzero_si256());
+
+  SIMDVectorFloat swap_sign_bit = VecI2F(emm0);
+  SIMDVectorFloat poly_mask = VecI2F(emm2);
+  sign_bit = _mm256_xor_ps(sign_bit, swap_sign_bit);
+
+  /* The magic pass: "Extended precision modular arithmetic"
+   x = ((x - y * DP1) - y * DP2) - y * DP3; */
+  xmm1 = *(SIMDVectorFloat*)_ps_minus_cephes_DP1;
+  xmm2 = *(SIMDVectorFloat*)_ps_minus_cephes_DP2;
+  xmm3 = *(SIMDVectorFloat*)_ps_minus_cephes_DP3;
+  xmm1 = _mm256_mul_ps(y, xmm1);
+  xmm2 = _mm256_mul_ps(y, xmm2);
+  xmm3 = _mm256_mul_ps(y, xmm3);
+  x = _mm256_add_ps(x, xmm1);
+  x = _mm256_add_ps(x, xmm2);
+  x = _mm256_add_ps(x, xmm3);
+
+  /* Evaluate the first polynom  (0 <= x <= Pi/4) */
+  y = *(SIMDVectorFloat*)_ps_coscof_p0;
+  SIMDVectorFloat z = _mm256_mul_ps(x, x);
+
+  y = _mm256_mul_ps(y, z);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps_coscof_p1);
+  y = _mm256_mul_ps(y, z);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps_coscof_p2);
+  y = _mm256_mul_ps(y, z);
+  y = _mm256_mul_ps(y, z);
+  SIMDVectorFloat tmp = _mm256_mul_ps(z, *(SIMDVectorFloat*)_ps_0p5);
+  y = _mm256_sub_ps(y, tmp);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps_1);
+
+  /* Evaluate the second polynom  (Pi/4 <= x <= 0) */
+  SIMDVectorFloat y2 = *(SIMDVectorFloat*)_ps_sincof_p0;
+  y2 = _mm256_mul_ps(y2, z);
+  y2 = _mm256_add_ps(y2, *(SIMDVectorFloat*)_ps_sincof_p1);
+  y2 = _mm256_mul_ps(y2, z);
+  y2 = _mm256_add_ps(y2, *(SIMDVectorFloat*)_ps_sincof_p2);
+  y2 = _mm256_mul_ps(y2, z);
+  y2 = _mm256_mul_ps(y2, x);
+  y2 = _mm256_add_ps(y2, x);
+
+  /* select the correct result from the two polynoms */
+  xmm3 = poly_mask;
+  y2 = _mm256_and_ps(xmm3, y2);  //, xmm3);
+  y = _mm256_andnot_ps(xmm3, y);
+  y = _mm256_add_ps(y, y2);
+  /* update the sign */
+  y = _mm256_xor_ps(y, sign_bit);
+  return y;
+}
+
+/* almost the same as sin_ps */
+inline SIMDVectorFloat vecCos(SIMDVectorFloat x)
+{
+  SIMDVectorFloat xmm1, xmm2 = _mm256_setzero_ps(), xmm3, y;
+  SIMDVectorInt emm0, emm2;
+
+  /* take the absolute value */
+  x = _mm256_and_ps(x, *(SIMDVectorFloat*)_ps_inv_sign_mask);
+
+  /* scale by 4/Pi */
+  y = _mm256_mul_ps(x, *(SIMDVectorFloat*)_ps_cephes_FOPI);
+
+  /* store the integer part of y in mm0 */
+  emm2 = _mm256_cvttps_epi32(y);
+  /* j=(j+1) & (~1) (see the cephes sources) */
+  emm2 = _mm256_add_epi32(emm2, *(SIMDVectorInt*)_pi32_1);
+  emm2 = _mm256_and_si256(emm2, *(SIMDVectorInt*)_pi32_inv1);
+  y = _mm256_cvtepi32_ps(emm2);
+  emm2 = _mm256_sub_epi32(emm2, *(SIMDVectorInt*)_pi32_2);
+
+  /* get the swap sign flag */
+  emm0 = _mm256_andnot_si256(emm2, *(SIMDVectorInt*)_pi32_4);
+  emm0 = _mm256_slli_epi32(emm0, 29);
+  /* get the polynom selection mask */
+  emm2 = _mm256_and_si256(emm2, *(SIMDVectorInt*)_pi32_2);
+  emm2 = _mm256_cmpeq_epi32(emm2, _mm256_setzero_si256());
+
+  SIMDVectorFloat sign_bit = VecI2F(emm0);
+  SIMDVectorFloat poly_mask = VecI2F(emm2);
+
+  /* The magic pass: "Extended precision modular arithmetic"
+   x = ((x - y * DP1) - y * DP2) - y * DP3; */
+  xmm1 = *(SIMDVectorFloat*)_ps_minus_cephes_DP1;
+  xmm2 = *(SIMDVectorFloat*)_ps_minus_cephes_DP2;
+  xmm3 = *(SIMDVectorFloat*)_ps_minus_cephes_DP3;
+  xmm1 = _mm256_mul_ps(y, xmm1);
+  xmm2 = _mm256_mul_ps(y, xmm2);
+  xmm3 = _mm256_mul_ps(y, xmm3);
+  x = _mm256_add_ps(x, xmm1);
+  x = _mm256_add_ps(x, xmm2);
+  x = _mm256_add_ps(x, xmm3);
+
+  /* Evaluate the first polynom  (0 <= x <= Pi/4) */
+  y = *(SIMDVectorFloat*)_ps_coscof_p0;
+  SIMDVectorFloat z = _mm256_mul_ps(x, x);
+
+  y = _mm256_mul_ps(y, z);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps_coscof_p1);
+  y = _mm256_mul_ps(y, z);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps_coscof_p2);
+  y = _mm256_mul_ps(y, z);
+  y = _mm256_mul_ps(y, z);
+  SIMDVectorFloat tmp = _mm256_mul_ps(z, *(SIMDVectorFloat*)_ps_0p5);
+  y = _mm256_sub_ps(y, tmp);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps_1);
+
+  /* Evaluate the second polynom  (Pi/4 <= x <= 0) */
+  SIMDVectorFloat y2 = *(SIMDVectorFloat*)_ps_sincof_p0;
+  y2 = _mm256_mul_ps(y2, z);
+  y2 = _mm256_add_ps(y2, *(SIMDVectorFloat*)_ps_sincof_p1);
+  y2 = _mm256_mul_ps(y2, z);
+  y2 = _mm256_add_ps(y2, *(SIMDVectorFloat*)_ps_sincof_p2);
+  y2 = _mm256_mul_ps(y2, z);
+  y2 = _mm256_mul_ps(y2, x);
+  y2 = _mm256_add_ps(y2, x);
+
+  /* select the correct result from the two polynoms */
+  xmm3 = poly_mask;
+  y2 = _mm256_and_ps(xmm3, y2);  //, xmm3);
+  y = _mm256_andnot_ps(xmm3, y);
+  y = _mm256_add_ps(y, y2);
+  /* update the sign */
+  y = _mm256_xor_ps(y, sign_bit);
+
+  return y;
+}
+
+/* since sin_ps and cos_ps are almost identical, sincos_ps could replace both of
+ them.. it is almost as fast, and gives you a free cosine with your sine */
+inline void vecSinCos(SIMDVectorFloat x, SIMDVectorFloat* s, SIMDVectorFloat* c)
+{
+  SIMDVectorFloat xmm1, xmm2, xmm3 = _mm256_setzero_ps(), sign_bit_sin, y;
+  SIMDVectorInt emm0, emm2, emm4;
+
+  sign_bit_sin = x;
+  /* take the absolute value */
+  x = _mm256_and_ps(x, *(SIMDVectorFloat*)_ps_inv_sign_mask);
+  /* extract the sign bit (upper one) */
+  sign_bit_sin = _mm256_and_ps(sign_bit_sin, *(SIMDVectorFloat*)_ps_sign_mask);
+
+  /* scale by 4/Pi */
+  y = _mm256_mul_ps(x, *(SIMDVectorFloat*)_ps_cephes_FOPI);
+
+  /* store the integer part of y in emm2 */
+  emm2 = _mm256_cvttps_epi32(y);
+
+  /* j=(j+1) & (~1) (see the cephes sources) */
+  emm2 = _mm256_add_epi32(emm2, *(SIMDVectorInt*)_pi32_1);
+  emm2 = _mm256_and_si256(emm2, *(SIMDVectorInt*)_pi32_inv1);
+  y = _mm256_cvtepi32_ps(emm2);
+
+  emm4 = emm2;
+
+  /* get the swap sign flag for the sine */
+  emm0 = _mm256_and_si256(emm2, *(SIMDVectorInt*)_pi32_4);
+  emm0 = _mm256_slli_epi32(emm0, 29);
+  SIMDVectorFloat swap_sign_bit_sin = VecI2F(emm0);
+
+  /* get the polynom selection mask for the sine*/
+  emm2 = _mm256_and_si256(emm2, *(SIMDVectorInt*)_pi32_2);
+  emm2 = _mm256_cmpeq_epi32(emm2, _mm256_setzero_si256());
+  SIMDVectorFloat poly_mask = VecI2F(emm2);
+
+  /* The magic pass: "Extended precision modular arithmetic"
+   x = ((x - y * DP1) - y * DP2) - y * DP3; */
+  xmm1 = *(SIMDVectorFloat*)_ps_minus_cephes_DP1;
+  xmm2 = *(SIMDVectorFloat*)_ps_minus_cephes_DP2;
+  xmm3 = *(SIMDVectorFloat*)_ps_minus_cephes_DP3;
+  xmm1 = _mm256_mul_ps(y, xmm1);
+  xmm2 = _mm256_mul_ps(y, xmm2);
+  xmm3 = _mm256_mul_ps(y, xmm3);
+  x = _mm256_add_ps(x, xmm1);
+  x = _mm256_add_ps(x, xmm2);
+  x = _mm256_add_ps(x, xmm3);
+
+  emm4 = _mm256_sub_epi32(emm4, *(SIMDVectorInt*)_pi32_2);
+  emm4 = _mm256_andnot_si256(emm4, *(SIMDVectorInt*)_pi32_4);
+  emm4 = _mm256_slli_epi32(emm4, 29);
+  SIMDVectorFloat sign_bit_cos = VecI2F(emm4);
+
+  sign_bit_sin = _mm256_xor_ps(sign_bit_sin, swap_sign_bit_sin);
+
+  /* Evaluate the first polynom  (0 <= x <= Pi/4) */
+  SIMDVectorFloat z = _mm256_mul_ps(x, x);
+  y = *(SIMDVectorFloat*)_ps_coscof_p0;
+
+  y = _mm256_mul_ps(y, z);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps_coscof_p1);
+  y = _mm256_mul_ps(y, z);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps_coscof_p2);
+  y = _mm256_mul_ps(y, z);
+  y = _mm256_mul_ps(y, z);
+  SIMDVectorFloat tmp = _mm256_mul_ps(z, *(SIMDVectorFloat*)_ps_0p5);
+  y = _mm256_sub_ps(y, tmp);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps_1);
+
+  /* Evaluate the second polynom  (Pi/4 <= x <= 0) */
+  SIMDVectorFloat y2 = *(SIMDVectorFloat*)_ps_sincof_p0;
+  y2 = _mm256_mul_ps(y2, z);
+  y2 = _mm256_add_ps(y2, *(SIMDVectorFloat*)_ps_sincof_p1);
+  y2 = _mm256_mul_ps(y2, z);
+  y2 = _mm256_add_ps(y2, *(SIMDVectorFloat*)_ps_sincof_p2);
+  y2 = _mm256_mul_ps(y2, z);
+  y2 = _mm256_mul_ps(y2, x);
+  y2 = _mm256_add_ps(y2, x);
+
+  /* select the correct result from the two polynoms */
+  xmm3 = poly_mask;
+  SIMDVectorFloat ysin2 = _mm256_and_ps(xmm3, y2);
+  SIMDVectorFloat ysin1 = _mm256_andnot_ps(xmm3, y);
+  y2 = _mm256_sub_ps(y2, ysin2);
+  y = _mm256_sub_ps(y, ysin1);
+
+  xmm1 = _mm256_add_ps(ysin1, ysin2);
+  xmm2 = _mm256_add_ps(y, y2);
+
+  /* update the sign */
+  *s = _mm256_xor_ps(xmm1, sign_bit_sin);
+  *c = _mm256_xor_ps(xmm2, sign_bit_cos);
+}
+
+#define STATIC_SIMD_CONST(name, val) \
+  static constexpr SIMDVectorFloat name = {val, val, val, val, val, val, val, val};
+
+// fast polynomial approximations
+// from scalar code by Jacques-Henri Jourdan <jourgun@gmail.com>
+// sin and cos valid from -pi to pi
+// exp and log polynomials generated using Sollya http://sollya.gforge.inria.fr/
+// exp Generated in Sollya with:
+// > f=remez(1-x*exp(-(x-1)*log(2)),
+// [|1,(x-1)*(x-2), (x-1)*(x-2)*x, (x-1)*(x-2)*x*x|],
+// [1,2], exp(-(x-1)*log(2)));
+// > plot(exp((x-1)*log(2))/(f+x)-1, [1,2]);
+// > f+x;
+//
+// log Generated in Sollya using :
+// f = remez(log(x)-(x-1)*log(2),
+// [|1,(x-1)*(x-2), (x-1)*(x-2)*x, (x-1)*(x-2)*x*x,
+// (x-1)*(x-2)*x*x*x|], [1,2], 1, 1e-8);
+// > plot(f+(x-1)*log(2)-log(x), [1,2]);
+// > f+(x-1)*log(2)
+
+STATIC_SIMD_CONST(kSinC1Vec, 0.99997937679290771484375f);
+STATIC_SIMD_CONST(kSinC2Vec, -0.166624367237091064453125f);
+STATIC_SIMD_CONST(kSinC3Vec, 8.30897875130176544189453125e-3f);
+STATIC_SIMD_CONST(kSinC4Vec, -1.92649182281456887722015380859375e-4f);
+STATIC_SIMD_CONST(kSinC5Vec, 2.147840177713078446686267852783203125e-6f);
+
+inline SIMDVectorFloat vecSinApprox(SIMDVectorFloat x)
+{
+  SIMDVectorFloat x2 = _mm256_mul_ps(x, x);
+  return _mm256_mul_ps(
+      x, _mm256_add_ps(
+             kSinC1Vec,
+             _mm256_mul_ps(
+                 x2,
+                 _mm256_add_ps(
+                     kSinC2Vec,
+                     _mm256_mul_ps(
+                         x2, _mm256_add_ps(kSinC3Vec,
+                                        _mm256_mul_ps(x2, _mm256_add_ps(kSinC4Vec,
+                                                                  _mm256_mul_ps(x2, kSinC5Vec)))))))));
+}
+
+STATIC_SIMD_CONST(kCosC1Vec, 0.999959766864776611328125f);
+STATIC_SIMD_CONST(kCosC2Vec, -0.4997930824756622314453125f);
+STATIC_SIMD_CONST(kCosC3Vec, 4.1496001183986663818359375e-2f);
+STATIC_SIMD_CONST(kCosC4Vec, -1.33926304988563060760498046875e-3f);
+STATIC_SIMD_CONST(kCosC5Vec, 1.8791708498611114919185638427734375e-5f);
+
+inline SIMDVectorFloat vecCosApprox(SIMDVectorFloat x)
+{
+  SIMDVectorFloat x2 = _mm256_mul_ps(x, x);
+  return _mm256_add_ps(
+      kCosC1Vec,
+      _mm256_mul_ps(
+          x2,
+          _mm256_add_ps(
+              kCosC2Vec,
+              _mm256_mul_ps(x2, _mm256_add_ps(kCosC3Vec,
+                                        _mm256_mul_ps(x2, _mm256_add_ps(kCosC4Vec,
+                                                                  _mm256_mul_ps(x2, kCosC5Vec))))))));
+}
+STATIC_SIMD_CONST(kExpC1Vec, 2139095040.f);
+STATIC_SIMD_CONST(kExpC2Vec, 12102203.1615614f);
+STATIC_SIMD_CONST(kExpC3Vec, 1065353216.f);
+STATIC_SIMD_CONST(kExpC4Vec, 0.510397365625862338668154f);
+STATIC_SIMD_CONST(kExpC5Vec, 0.310670891004095530771135f);
+STATIC_SIMD_CONST(kExpC6Vec, 0.168143436463395944830000f);
+STATIC_SIMD_CONST(kExpC7Vec, -2.88093587581985443087955e-3f);
+STATIC_SIMD_CONST(kExpC8Vec, 1.3671023382430374383648148e-2f);
+
+inline SIMDVectorFloat vecExpApprox(SIMDVectorFloat x)
+{
+  const SIMDVectorFloat kZeroVec = _mm256_setzero_ps();
+
+  SIMDVectorFloat val2, val3, val4;
+  SIMDVectorInt val4i;
+
+  val2 = _mm256_add_ps(_mm256_mul_ps(x, kExpC2Vec), kExpC3Vec);
+  val3 = _mm256_min_ps(val2, kExpC1Vec);
+  val4 = _mm256_max_ps(val3, kZeroVec);
+  val4i = _mm256_cvttps_epi32(val4);
+
+  SIMDVectorFloat xu = _mm256_and_ps(VecI2F(val4i), VecI2F(_mm256_set1_epi32(0x7F800000)));
+  SIMDVectorFloat b = _mm256_or_ps(_mm256_and_ps(VecI2F(val4i), VecI2F(_mm256_set1_epi32(0x7FFFFF))),
+                                VecI2F(_mm256_set1_epi32(0x3F800000)));
+
+  return _mm256_mul_ps(
+      xu,
+      (_mm256_add_ps(
+          kExpC4Vec,
+          _mm256_mul_ps(
+              b, _mm256_add_ps(
+                     kExpC5Vec,
+                     _mm256_mul_ps(
+                         b, _mm256_add_ps(kExpC6Vec,
+                                       _mm256_mul_ps(b, _mm256_add_ps(kExpC7Vec,
+                                                                _mm256_mul_ps(b, kExpC8Vec))))))))));
+}
+
+STATIC_SIMD_CONST(kLogC1Vec, -89.970756366f);
+STATIC_SIMD_CONST(kLogC2Vec, 3.529304993f);
+STATIC_SIMD_CONST(kLogC3Vec, -2.461222105f);
+STATIC_SIMD_CONST(kLogC4Vec, 1.130626167f);
+STATIC_SIMD_CONST(kLogC5Vec, -0.288739945f);
+STATIC_SIMD_CONST(kLogC6Vec, 3.110401639e-2f);
+STATIC_SIMD_CONST(kLogC7Vec, 0.69314718055995f);
+
+inline SIMDVectorFloat vecLogApprox(SIMDVectorFloat val)
+{
+  SIMDVectorInt vZero = _mm256_setzero_si256();
+  SIMDVectorInt valAsInt = VecF2I(val);
+  SIMDVectorInt expi = _mm256_srli_epi32(valAsInt, 23);
+  SIMDVectorFloat addcst =
+      vecSelect(kLogC1Vec, _mm256_set1_ps(FLT_MIN), VecF2I(vecGreaterThan(val, VecI2F(vZero))));
+  SIMDVectorInt valAsIntMasked =
+      VecF2I(_mm256_or_ps(_mm256_and_ps(VecI2F(valAsInt), VecI2F(_mm256_set1_epi32(0x7FFFFF))),
+                       VecI2F(_mm256_set1_epi32(0x3F800000))));
+  SIMDVectorFloat x = VecI2F(valAsIntMasked);
+
+  SIMDVectorFloat poly = _mm256_mul_ps(
+      x, _mm256_add_ps(
+             kLogC2Vec,
+             _mm256_mul_ps(
+                 x, _mm256_add_ps(
+                        kLogC3Vec,
+                        _mm256_mul_ps(
+                            x, _mm256_add_ps(kLogC4Vec,
+                                          _mm256_mul_ps(x, _mm256_add_ps(kLogC5Vec,
+                                                                   _mm256_mul_ps(x, kLogC6Vec)))))))));
+
+  SIMDVectorFloat addCstResult = _mm256_add_ps(addcst, _mm256_mul_ps(kLogC7Vec, _mm256_cvtepi32_ps(expi)));
+  return _mm256_add_ps(poly, addCstResult);
+}
+
+// rough cubic tanh approx, valid in [-4, 4]
+
+STATIC_SIMD_CONST(k9Vec, 9.0f);
+STATIC_SIMD_CONST(k27Vec, 27.0f);
+
+inline SIMDVectorFloat vecTanhApprox(SIMDVectorFloat x)
+{
+  SIMDVectorFloat x2 = _mm256_mul_ps(x, x);
+  SIMDVectorFloat denom = _mm256_add_ps(k27Vec, _mm256_mul_ps(k9Vec, x2));
+  SIMDVectorFloat frac = _mm256_div_ps(_mm256_add_ps(k27Vec, x2), (denom));
+  
+  // try me!
+//  SIMDVectorFloat frac = _mm256_mul_ps(_mm256_add_ps(k27Vec, x2), _mm256_rcp_ps(denom));
+
+  return _mm256_mul_ps(x, frac);
+}
+
+// conversions
+
+inline SIMDVectorFloat vecIntPart(SIMDVectorFloat val)
+{
+  SIMDVectorInt vi = _mm256_cvttps_epi32(val);  // convert with truncate
+  return (_mm256_cvtepi32_ps(vi));
+}
+
+inline SIMDVectorFloat vecFracPart(SIMDVectorFloat val)
+{
+  SIMDVectorInt vi = _mm256_cvttps_epi32(val);  // convert with truncate
+  SIMDVectorFloat intPart = _mm256_cvtepi32_ps(vi);
+  return _mm256_sub_ps(val, intPart);
+}
+// shuffles
+
+// Given vectors [ ?, ?, ?, ?, ?, ?, ?, 7 ], [ 8, 9, 10, 11, 12, 13, 14, 15 ]
+// Returns [ 7, 8, 9, 10, 11, 12, 13, 14 ]
+inline SIMDVectorFloat vecShuffleRight(SIMDVectorFloat v1, SIMDVectorFloat v2)
+{
+  // [ v1 high half, v2 low half ]
+  __m256i mid = VecF2I(_mm256_permute2f128_ps(v1, v2, 0x21));
+  return VecI2F(_mm256_alignr_epi8(VecF2I(v2), mid, 12));
+}
+
+// Given vectors [ 0, 1, 2, 3, 4, 5, 6, 7 ], [ 8, ?, ?, ?, ?, ?, ?, ? ]
+// Returns [ 1, 2, 3, 4, 5, 6, 7, 8 ]
+inline SIMDVectorFloat vecShuffleLeft(SIMDVectorFloat v1, SIMDVectorFloat v2)
+{
+  // [ v1 high half, v2 low half ]
+  __m256i mid = VecF2I(_mm256_permute2f128_ps(v1, v2, 0x21));
+  return VecI2F(_mm256_alignr_epi8(mid, VecF2I(v1), 4));
+}
+
+// interleave two vectors into dest: [ a0, b0, a1, b1, ... ]
+inline void vecStoreInterleaved2(float* dest, SIMDVectorFloat a, SIMDVectorFloat b)
+{
+  // unpack works within each 128-bit lane, so the lanes are put back in order after.
+  SIMDVectorFloat lo = _mm256_unpacklo_ps(a, b);
+  SIMDVectorFloat hi = _mm256_unpackhi_ps(a, b);
+  _mm256_storeu_ps(dest, _mm256_permute2f128_ps(lo, hi, 0x20));
+  _mm256_storeu_ps(dest + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+}
+
+// transpose four vectors, storing [ an, bn, cn, dn ] at dest + n * stride.
+inline void vecStoreTransposed4(float* dest, size_t stride, SIMDVectorFloat a, SIMDVectorFloat b,
+                                SIMDVectorFloat c, SIMDVectorFloat d)
+{
+  // transpose within each 128-bit lane: the low lanes hold elements 0-3, the high lanes 4-7.
+  SIMDVectorFloat t0 = _mm256_unpacklo_ps(a, b);
+  SIMDVectorFloat t1 = _mm256_unpacklo_ps(c, d);
+  SIMDVectorFloat t2 = _mm256_unpackhi_ps(a, b);
+  SIMDVectorFloat t3 = _mm256_unpackhi_ps(c, d);
+  SIMDVectorFloat r[4]{_mm256_shuffle_ps(t0, t1, 0x44), _mm256_shuffle_ps(t0, t1, 0xEE),
+                       _mm256_shuffle_ps(t2, t3, 0x44), _mm256_shuffle_ps(t2, t3, 0xEE)};
+  for (int n = 0; n < 4; ++n)
+  {
+    _mm_storeu_ps(dest + stride * n, _mm256_castps256_ps128(r[n]));
+    _mm_storeu_ps(dest + stride * (n + 4), _mm256_extractf128_ps(r[n], 1));
+  }
+}
+
+// the inverse of vecStoreInterleaved2: load [ a0, b0, a1, b1, ... ] from src into a and b.
+inline void vecLoadDeinterleaved2(const float* src, SIMDVectorFloat& a, SIMDVectorFloat& b)
+{
+  // shuffle within each 128-bit lane, then put the 64-bit pairs in order.
+  SIMDVectorFloat x = _mm256_loadu_ps(src);
+  SIMDVectorFloat y = _mm256_loadu_ps(src + 8);
+  SIMDVectorFloat evens = _mm256_shuffle_ps(x, y, 0x88);
+  SIMDVectorFloat odds = _mm256_shuffle_ps(x, y, 0xDD);
+  a = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(evens), 0xD8));
+  b = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(odds), 0xD8));
+}
+
+// the inverse of vecStoreTransposed4: load four floats from src + n * stride into element n
+// of a, b, c and d.
+inline void vecLoadTransposed4(const float* src, size_t stride, SIMDVectorFloat& a,
+                               SIMDVectorFloat& b, SIMDVectorFloat& c, SIMDVectorFloat& d)
+{
+  // frames n and n + 4 go in the low and high lanes, then each lane is transposed.
+  SIMDVectorFloat r[4];
+  for (int n = 0; n < 4; ++n)
+  {
+    r[n] = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(src + stride * n)),
+                                _mm_loadu_ps(src + stride * (n + 4)), 1);
+  }
+  SIMDVectorFloat t0 = _mm256_unpacklo_ps(r[0], r[1]);
+  SIMDVectorFloat t1 = _mm256_unpacklo_ps(r[2], r[3]);
+  SIMDVectorFloat t2 = _mm256_unpackhi_ps(r[0], r[1]);
+  SIMDVectorFloat t3 = _mm256_unpackhi_ps(r[2], r[3]);
+  a = _mm256_shuffle_ps(t0, t1, 0x44);
+  b = _mm256_shuffle_ps(t0, t1, 0xEE);
+  c = _mm256_shuffle_ps(t2, t3, 0x44);
+  d = _mm256_shuffle_ps(t2, t3, 0xEE);
+}
+
+// transpose the square of vectors v[0..7] in place: element j of v[i] goes to element i of
+// v[j].
+inline void vecTranspose(SIMDVectorFloat* v)
+{
+  // 4x4 transposes within each 128-bit lane, then the off-diagonal lane pairs are swapped.
+  SIMDVectorFloat t[8], s[8];
+  for (int i = 0; i < 8; i += 2)
+  {
+    t[i] = _mm256_unpacklo_ps(v[i], v[i + 1]);
+    t[i + 1] = _mm256_unpackhi_ps(v[i], v[i + 1]);
+  }
+  for (int i = 0; i < 8; i += 4)
+  {
+    s[i] = _mm256_shuffle_ps(t[i], t[i + 2], 0x44);
+    s[i + 1] = _mm256_shuffle_ps(t[i], t[i + 2], 0xEE);
+    s[i + 2] = _mm256_shuffle_ps(t[i + 1], t[i + 3], 0x44);
+    s[i + 3] = _mm256_shuffle_ps(t[i + 1], t[i + 3], 0xEE);
+  }
+  for (int i = 0; i < 4; ++i)
+  {
+    v[i] = _mm256_permute2f128_ps(s[i], s[i + 4], 0x20);
+    v[i + 4] = _mm256_permute2f128_ps(s[i], s[i + 4], 0x31);
+  }
+}
+
+// define infix operators for MSVC.
+#ifdef WIN32
+
+inline SIMDVectorFloat operator*(const SIMDVectorFloat& a, const SIMDVectorFloat& b)
+{
+  return vecMul(a, b);
+}
+
+inline SIMDVectorFloat operator+(const SIMDVectorFloat& a, const SIMDVectorFloat& b)
+{
+  return vecAdd(a, b);
+}
+
+inline SIMDVectorFloat operator-(const SIMDVectorFloat& a, const SIMDVectorFloat& b)
+{
+  return vecSub(a, b);
+}
+
+inline SIMDVectorFloat operator/(const SIMDVectorFloat& a, const SIMDVectorFloat& b)
+{
+  return vecDiv(a, b);
+}
+
+inline SIMDVectorInt operator|(const SIMDVectorInt& a, const SIMDVectorInt& b)
+{
+  return _mm256_or_si256(a, b);
+}
+inline SIMDVectorInt operator&(const SIMDVectorInt& a, const SIMDVectorInt& b)
+{
+  return _mm256_and_si256(a, b);
+}
+
+#endif
@@ -2,8 +2,148 @@
 // Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
 // Distributed under the MIT license: http://madrona-labs.mit-license.org/
 
+// MLDSPMathNEON.h
+// NEON implementations of madronalib SIMD primitives.
+//
+// The SSE implementations in MLDSPMathSSE.h are compiled for NEON through sse2neon, which maps
+// most SSE intrinsics to a single NEON instruction. The primitives here are the exceptions,
+// where an SSE idiom becomes a longer sequence, a trip through memory or a read of the
+// floating point control register. MLDSPMathSSE.h calls these native versions instead when
+// ML_SSE_TO_NEON is defined. The AArch64 instructions for rounding and horizontal operations
+// are used where available, with ARMv7 fallbacks.
+
+#pragma once
+
 #include <arm_neon.h>
 
 #include "sse2neon.h"
 
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define ML_NEON_A64
+#endif
+
+// sse2neon keeps integer vectors as int64x2_t. These reinterpret them as 32-bit lanes.
+inline int32x4_t neonInt(__m128i v) { return vreinterpretq_s32_s64(v); }
+inline __m128i neonInt(int32x4_t v) { return vreinterpretq_s64_s32(v); }
+
+// select
+
+inline __m128 neonSelect(__m128 a, __m128 b, __m128i mask)
+{
+  return vbslq_f32(vreinterpretq_u32_s64(mask), a, b);
+}
+
+inline __m128 neonSelect(__m128 a, __m128 b, __m128 mask)
+{
+  return vbslq_f32(vreinterpretq_u32_f32(mask), a, b);
+}
+
+inline __m128i neonSelect(__m128i a, __m128i b, __m128i mask)
+{
+  return vbslq_s64(vreinterpretq_u64_s64(mask), a, b);
+}
+
+inline __m128i neonMinInt(__m128i a, __m128i b)
+{
+  return neonInt(vminq_s32(neonInt(a), neonInt(b)));
+}
+
+inline __m128i neonMaxInt(__m128i a, __m128i b)
+{
+  return neonInt(vmaxq_s32(neonInt(a), neonInt(b)));
+}
+
+// gather with lane loads, without going through memory.
+inline __m128 neonGather(const float* p, __m128i idx)
+{
+  const int32x4_t i = neonInt(idx);
+  float32x4_t r = vld1q_dup_f32(p + vgetq_lane_s32(i, 0));
+  r = vld1q_lane_f32(p + vgetq_lane_s32(i, 1), r, 1);
+  r = vld1q_lane_f32(p + vgetq_lane_s32(i, 2), r, 2);
+  return vld1q_lane_f32(p + vgetq_lane_s32(i, 3), r, 3);
+}
+
+// horizontal operations
+
+inline float neonSumH(__m128 v)
+{
+#ifdef ML_NEON_A64
+  return vaddvq_f32(v);
+#else
+  float32x2_t s = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+  return vget_lane_f32(vpadd_f32(s, s), 0);
+#endif
+}
+
+inline float neonMaxH(__m128 v)
+{
+#ifdef ML_NEON_A64
+  return vmaxvq_f32(v);
+#else
+  float32x2_t s = vmax_f32(vget_low_f32(v), vget_high_f32(v));
+  return vget_lane_f32(vpmax_f32(s, s), 0);
+#endif
+}
+
+inline float neonMinH(__m128 v)
+{
+#ifdef ML_NEON_A64
+  return vminvq_f32(v);
+#else
+  float32x2_t s = vmin_f32(vget_low_f32(v), vget_high_f32(v));
+  return vget_lane_f32(vpmin_f32(s, s), 0);
+#endif
+}
+
+// rounding. The conversions to int assume the default round to nearest mode, which sse2neon
+// would otherwise read from the control register on each call.
+
+inline __m128 neonFloor(__m128 x)
+{
+#ifdef ML_NEON_A64
+  return vrndmq_f32(x);
+#else
+  float32x4_t t = vcvtq_f32_s32(vcvtq_s32_f32(x));
+  uint32x4_t greater = vcgtq_f32(t, x);
+  uint32x4_t one = vreinterpretq_u32_f32(vdupq_n_f32(1.f));
+  return vsubq_f32(t, vreinterpretq_f32_u32(vandq_u32(greater, one)));
+#endif
+}
+
+inline __m128 neonTruncate(__m128 x)
+{
+#ifdef ML_NEON_A64
+  return vrndq_f32(x);
+#else
+  return vcvtq_f32_s32(vcvtq_s32_f32(x));
+#endif
+}
+
+inline __m128i neonFloatToIntRound(__m128 x)
+{
+#ifdef ML_NEON_A64
+  return neonInt(vcvtnq_s32_f32(x));
+#else
+  return _mm_cvtps_epi32(x);
+#endif
+}
+
+// shuffles and interleaving
+
+inline __m128 neonShuffleRight(__m128 v1, __m128 v2) { return vextq_f32(v1, v2, 3); }
+inline __m128 neonShuffleLeft(__m128 v1, __m128 v2) { return vextq_f32(v1, v2, 1); }
+
+inline void neonStoreInterleaved2(float* dest, __m128 a, __m128 b)
+{
+  float32x4x2_t ab{{a, b}};
+  vst2q_f32(dest, ab);
+}
+
+inline void neonLoadDeinterleaved2(const float* src, __m128& a, __m128& b)
+{
+  float32x4x2_t ab = vld2q_f32(src);
+  a = ab.val[0];
+  b = ab.val[1];
+}
+
 #include "MLDSPMathSSE.h"
@@ -31,7 +31,7 @@
 
 #include "MLPlatform.h"
 
-#ifndef ML_SSE_TO_NEON
+#if !defined(ML_SSE_TO_NEON) && !defined(ML_SSE_TO_WASM)
 #include <emmintrin.h>
 #endif
 
@@ -117,8 +117,16 @@ inline bool isSIMDAligned(float* p)
 #define vecShiftLeft _mm_slli_si128
 #define vecShiftRight _mm_srli_si128
 
+#if defined(ML_SSE_TO_NEON)
+#define vecFloatToIntRound neonFloatToIntRound
+#define vecFloatToIntTruncate _mm_cvttps_epi32
+#elif defined(ML_SSE_TO_WASM)
+#define vecFloatToIntRound wasmFloatToIntRound
+#define vecFloatToIntTruncate wasmFloatToIntTruncate
+#else
 #define vecFloatToIntRound _mm_cvtps_epi32
 #define vecFloatToIntTruncate _mm_cvttps_epi32
+#endif
 #define vecIntToFloat _mm_cvtepi32_ps
 
 // _mm_cvtepi32_ps approximation for unsigned int data
@@ -133,6 +141,11 @@ inline SIMDVectorFloat vecUnsignedIntToFloat(SIMDVectorInt v)
 #define vecAddInt _mm_add_epi32
 #define vecSubInt _mm_sub_epi32
 #define vecSet1Int _mm_set1_epi32
+#define vecAndInt _mm_and_si128
+#define vecOrInt _mm_or_si128
+#define vecXorInt _mm_xor_si128
+#define vecShiftLeftInt _mm_slli_epi32
+#define vecShiftRightInt _mm_srli_epi32
 
 typedef union
 {
@@ -153,6 +166,21 @@ inline SIMDVectorInt vecSetInt4(uint32_t a, uint32_t b, uint32_t c, uint32_t d)
   return _mm_set_epi32(d, c, b, a);
 }
 
+// load the floats at p[idx[0]], p[idx[1]], ... There is no gather instruction
+// in SSE2 so this is done with scalar loads.
+inline SIMDVectorFloat vecGather(const float* p, SIMDVectorInt idx)
+{
+#if defined(ML_SSE_TO_NEON)
+  return neonGather(p, idx);
+#elif defined(ML_SSE_TO_WASM)
+  return wasmGather(p, idx);
+#else
+  SIMDVectorIntUnion u;
+  u.v = idx;
+  return _mm_setr_ps(p[u.i[0]], p[u.i[1]], p[u.i[2]], p[u.i[3]]);
+#endif
+}
+
 static const int XI = 0xFFFFFFFF;
 static const float X = *(reinterpret_cast<const float*>(&XI));
 
@@ -214,6 +242,50 @@ inline std::ostream& operator<<(std::ostream& out, SIMDVectorInt v)
 // ----------------------------------------------------------------
 #pragma mark select
 
+#if defined(ML_SSE_TO_NEON)
+
+inline SIMDVectorFloat vecSelect(SIMDVectorFloat a, SIMDVectorFloat b, SIMDVectorInt conditionMask)
+{
+  return neonSelect(a, b, conditionMask);
+}
+
+inline SIMDVectorFloat vecSelect(SIMDVectorFloat a, SIMDVectorFloat b,
+                                 SIMDVectorFloat conditionMask)
+{
+  return neonSelect(a, b, conditionMask);
+}
+
+inline SIMDVectorInt vecSelect(SIMDVectorInt a, SIMDVectorInt b, SIMDVectorInt conditionMask)
+{
+  return neonSelect(a, b, conditionMask);
+}
+
+inline SIMDVectorInt vecMinInt(SIMDVectorInt a, SIMDVectorInt b) { return neonMinInt(a, b); }
+inline SIMDVectorInt vecMaxInt(SIMDVectorInt a, SIMDVectorInt b) { return neonMaxInt(a, b); }
+
+#elif defined(ML_SSE_TO_WASM)
+
+inline SIMDVectorFloat vecSelect(SIMDVectorFloat a, SIMDVectorFloat b, SIMDVectorInt conditionMask)
+{
+  return wasmSelect(a, b, conditionMask);
+}
+
+inline SIMDVectorFloat vecSelect(SIMDVectorFloat a, SIMDVectorFloat b,
+                                 SIMDVectorFloat conditionMask)
+{
+  return wasmSelect(a, b, conditionMask);
+}
+
+inline SIMDVectorInt vecSelect(SIMDVectorInt a, SIMDVectorInt b, SIMDVectorInt conditionMask)
+{
+  return wasmSelect(a, b, conditionMask);
+}
+
+inline SIMDVectorInt vecMinInt(SIMDVectorInt a, SIMDVectorInt b) { return wasmMinInt(a, b); }
+inline SIMDVectorInt vecMaxInt(SIMDVectorInt a, SIMDVectorInt b) { return wasmMaxInt(a, b); }
+
+#else
+
 inline SIMDVectorFloat vecSelect(SIMDVectorFloat a, SIMDVectorFloat b, SIMDVectorInt conditionMask)
 {
   __m128i ones = _mm_set1_epi32(-1);
@@ -236,9 +308,31 @@ inline SIMDVectorInt vecSelect(SIMDVectorInt a, SIMDVectorInt b, SIMDVectorInt c
                       _mm_and_si128(_mm_xor_si128(conditionMask, ones), b));
 }
 
+// signed minimum and maximum. SSE2 has no instructions for these, so they are made from a
+// comparison.
+inline SIMDVectorInt vecMinInt(SIMDVectorInt a, SIMDVectorInt b)
+{
+  return vecSelect(b, a, _mm_cmpgt_epi32(a, b));
+}
+
+inline SIMDVectorInt vecMaxInt(SIMDVectorInt a, SIMDVectorInt b)
+{
+  return vecSelect(a, b, _mm_cmpgt_epi32(a, b));
+}
+
+#endif
+
 // ----------------------------------------------------------------
 // horizontal operations returning float
 
+#ifdef ML_SSE_TO_NEON
+
+inline float vecSumH(SIMDVectorFloat v) { return neonSumH(v); }
+inline float vecMaxH(SIMDVectorFloat v) { return neonMaxH(v); }
+inline float vecMinH(SIMDVectorFloat v) { return neonMinH(v); }
+
+#else
+
 inline float vecSumH(SIMDVectorFloat v)
 {
   SIMDVectorFloat tmp0 = _mm_add_ps(v, _mm_movehl_ps(v, v));
@@ -260,6 +354,53 @@ inline float vecMinH(SIMDVectorFloat v)
   return _mm_cvtss_f32(tmp1);
 }
 
+#endif
+
+// ----------------------------------------------------------------
+// double precision vectors, for state that float would lose precision in. A float vector
+// converts to and from two double vectors, holding its low and high halves.
+
+typedef __m128d SIMDVectorDouble;
+constexpr int kDoublesPerSIMDVector = kFloatsPerSIMDVector / 2;
+
+#define vecAddD _mm_add_pd
+#define vecSubD _mm_sub_pd
+#define vecMulD _mm_mul_pd
+#define vecDivD _mm_div_pd
+#define vecMinD _mm_min_pd
+#define vecMaxD _mm_max_pd
+#define vecSqrtD _mm_sqrt_pd
+#define vecSet1D _mm_set1_pd
+#define vecZerosD _mm_setzero_pd
+#define vecStoreD _mm_store_pd
+#define vecLoadD _mm_load_pd
+#define vecStoreUnalignedD _mm_storeu_pd
+#define vecLoadUnalignedD _mm_loadu_pd
+
+// SSE2 has no floor for doubles. Adding and subtracting 2^52 rounds values below it to
+// integers, then results that rounded up are corrected.
+inline SIMDVectorDouble vecFloorD(SIMDVectorDouble x)
+{
+  const __m128d kSign = _mm_set1_pd(-0.0);
+  const __m128d kBig = _mm_set1_pd(4503599627370496.0);
+  __m128d ax = _mm_andnot_pd(kSign, x);
+  __m128d r = _mm_or_pd(_mm_sub_pd(_mm_add_pd(ax, kBig), kBig), _mm_and_pd(kSign, x));
+  __m128d big = _mm_cmpge_pd(ax, kBig);
+  r = _mm_or_pd(_mm_and_pd(big, x), _mm_andnot_pd(big, r));
+  return _mm_sub_pd(r, _mm_and_pd(_mm_cmpgt_pd(r, x), _mm_set1_pd(1.0)));
+}
+
+inline void vecFloatToDouble(SIMDVectorFloat x, SIMDVectorDouble& lo, SIMDVectorDouble& hi)
+{
+  lo = _mm_cvtps_pd(x);
+  hi = _mm_cvtps_pd(_mm_movehl_ps(x, x));
+}
+
+inline SIMDVectorFloat vecDoubleToFloat(SIMDVectorDouble lo, SIMDVectorDouble hi)
+{
+  return _mm_movelh_ps(_mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi));
+}
+
 /* declare some SSE constants -- why can't I figure a better way to do that? */
 #define _PS_CONST(Name, Val) \
   static const ALIGN16_BEG float _ps_##Name[4] ALIGN16_END = {Val, Val, Val, Val}
@@ -395,6 +536,11 @@ inline SIMDVectorFloat vecExp(SIMDVectorFloat x)
   fx = _mm_mul_ps(x, *(SIMDVectorFloat*)_ps_cephes_LOG2EF);
   fx = _mm_add_ps(fx, *(SIMDVectorFloat*)_ps_0p5);
 
+#if defined(ML_SSE_TO_NEON)
+  fx = neonFloor(fx);
+#elif defined(ML_SSE_TO_WASM)
+  fx = wasmFloor(fx);
+#else
   /* how to perform a floorf with SSE: just below */
   emm0 = _mm_cvttps_epi32(fx);
   tmp = _mm_cvtepi32_ps(emm0);
@@ -403,6 +549,7 @@ inline SIMDVectorFloat vecExp(SIMDVectorFloat x)
   SIMDVectorFloat mask = _mm_cmpgt_ps(tmp, fx);
   mask = _mm_and_ps(mask, one);
   fx = _mm_sub_ps(tmp, mask);
+#endif
 
   tmp = _mm_mul_ps(fx, *(SIMDVectorFloat*)_ps_cephes_exp_C1);
   SIMDVectorFloat z = _mm_mul_ps(fx, *(SIMDVectorFloat*)_ps_cephes_exp_C2);
@@ -426,7 +573,7 @@ inline SIMDVectorFloat vecExp(SIMDVectorFloat x)
   y = _mm_add_ps(y, one);
 
   /* build 2^n */
-  emm0 = _mm_cvttps_epi32(fx);
+  emm0 = vecFloatToIntTruncate(fx);
   emm0 = _mm_add_epi32(emm0, *(SIMDVectorInt*)_pi32_0x7f);
   emm0 = _mm_slli_epi32(emm0, 23);
   SIMDVectorFloat pow2n = VecI2F(emm0);
@@ -487,7 +634,7 @@ inline SIMDVectorFloat vecSin(SIMDVectorFloat x)
   y = _mm_mul_ps(x, *(SIMDVectorFloat*)_ps_cephes_FOPI);
 
   /* store the integer part of y in mm0 */
-  emm2 = _mm_cvttps_epi32(y);
+  emm2 = vecFloatToIntTruncate(y);
   /* j=(j+1) & (~1) (see the cephes sources) */
   emm2 = _mm_add_epi32(emm2, *(SIMDVectorInt*)_pi32_1);
   emm2 = _mm_and_si128(emm2, *(SIMDVectorInt*)_pi32_inv1);
@@ -567,7 +714,7 @@ inline SIMDVectorFloat vecCos(SIMDVectorFloat x)
   y = _mm_mul_ps(x, *(SIMDVectorFloat*)_ps_cephes_FOPI);
 
   /* store the integer part of y in mm0 */
-  emm2 = _mm_cvttps_epi32(y);
+  emm2 = vecFloatToIntTruncate(y);
   /* j=(j+1) & (~1) (see the cephes sources) */
   emm2 = _mm_add_epi32(emm2, *(SIMDVectorInt*)_pi32_1);
   emm2 = _mm_and_si128(emm2, *(SIMDVectorInt*)_pi32_inv1);
@@ -648,7 +795,7 @@ inline void vecSinCos(SIMDVectorFloat x, SIMDVectorFloat* s, SIMDVectorFloat* c)
   y = _mm_mul_ps(x, *(SIMDVectorFloat*)_ps_cephes_FOPI);
 
   /* store the integer part of y in emm2 */
-  emm2 = _mm_cvttps_epi32(y);
+  emm2 = vecFloatToIntTruncate(y);
 
   /* j=(j+1) & (~1) (see the cephes sources) */
   emm2 = _mm_add_epi32(emm2, *(SIMDVectorInt*)_pi32_1);
@@ -726,6 +873,7 @@ inline void vecSinCos(SIMDVectorFloat x, SIMDVectorFloat* s, SIMDVectorFloat* c)
 }
 
 #define STATIC_M128_CONST(name, val) static constexpr __m128 name = {val, val, val, val};
+#define STATIC_SIMD_CONST STATIC_M128_CONST
 
 // fast polynomial approximations
 // from scalar code by Jacques-Henri Jourdan <jourgun@gmail.com>
@@ -805,7 +953,7 @@ inline SIMDVectorFloat vecExpApprox(SIMDVectorFloat x)
   val2 = _mm_add_ps(_mm_mul_ps(x, kExpC2Vec), kExpC3Vec);
   val3 = _mm_min_ps(val2, kExpC1Vec);
   val4 = _mm_max_ps(val3, kZeroVec);
-  val4i = _mm_cvttps_epi32(val4);
+  val4i = vecFloatToIntTruncate(val4);
 
   SIMDVectorFloat xu = _mm_and_ps(VecI2F(val4i), VecI2F(_mm_set1_epi32(0x7F800000)));
   SIMDVectorFloat b = _mm_or_ps(_mm_and_ps(VecI2F(val4i), VecI2F(_mm_set1_epi32(0x7FFFFF))),
@@ -880,16 +1028,17 @@ inline SIMDVectorFloat vecTanhApprox(SIMDVectorFloat x)
 
 inline SIMDVectorFloat vecIntPart(SIMDVectorFloat val)
 {
+#if defined(ML_SSE_TO_NEON)
+  return neonTruncate(val);
+#elif defined(ML_SSE_TO_WASM)
+  return wasmTruncate(val);
+#else
   SIMDVectorInt vi = _mm_cvttps_epi32(val);  // convert with truncate
   return (_mm_cvtepi32_ps(vi));
+#endif
 }
 
-inline SIMDVectorFloat vecFracPart(SIMDVectorFloat val)
-{
-  SIMDVectorInt vi = _mm_cvttps_epi32(val);  // convert with truncate
-  SIMDVectorFloat intPart = _mm_cvtepi32_ps(vi);
-  return _mm_sub_ps(val, intPart);
-}
+inline SIMDVectorFloat vecFracPart(SIMDVectorFloat val) { return _mm_sub_ps(val, vecIntPart(val)); }
 
 // shuffles
 
@@ -897,16 +1046,75 @@ inline SIMDVectorFloat vecFracPart(SIMDVectorFloat val)
 // Returns [ 3, 4, 5, 6 ]
 inline SIMDVectorFloat vecShuffleRight(SIMDVectorFloat v1, SIMDVectorFloat v2)
 {
+#ifdef ML_SSE_TO_NEON
+  return neonShuffleRight(v1, v2);
+#else
   return _mm_shuffle_ps(_mm_shuffle_ps(v2, v1, SHUFFLE(3, 3, 0, 0)), v2, SHUFFLE(2, 1, 0, 3));
+#endif
 }
 
 // Given vectors [ 0, 1, 2, 3 ], [ 4, ?, ?, ? ]
 // Returns [ 1, 2, 3, 4 ]
 inline SIMDVectorFloat vecShuffleLeft(SIMDVectorFloat v1, SIMDVectorFloat v2)
 {
+#ifdef ML_SSE_TO_NEON
+  return neonShuffleLeft(v1, v2);
+#else
   return _mm_shuffle_ps(v1, _mm_shuffle_ps(v1, v2, SHUFFLE(0, 0, 3, 3)), SHUFFLE(3, 0, 2, 1));
+#endif
 }
 
+// interleave two vectors into dest: [ a0, b0, a1, b1, ... ]
+inline void vecStoreInterleaved2(float* dest, SIMDVectorFloat a, SIMDVectorFloat b)
+{
+#ifdef ML_SSE_TO_NEON
+  neonStoreInterleaved2(dest, a, b);
+#else
+  _mm_storeu_ps(dest, _mm_unpacklo_ps(a, b));
+  _mm_storeu_ps(dest + 4, _mm_unpackhi_ps(a, b));
+#endif
+}
+
+// transpose four vectors, storing [ an, bn, cn, dn ] at dest + n * stride.
+inline void vecStoreTransposed4(float* dest, size_t stride, SIMDVectorFloat a, SIMDVectorFloat b,
+                                SIMDVectorFloat c, SIMDVectorFloat d)
+{
+  _MM_TRANSPOSE4_PS(a, b, c, d);
+  _mm_storeu_ps(dest, a);
+  _mm_storeu_ps(dest + stride, b);
+  _mm_storeu_ps(dest + stride * 2, c);
+  _mm_storeu_ps(dest + stride * 3, d);
+}
+
+// the inverse of vecStoreInterleaved2: load [ a0, b0, a1, b1, ... ] from src into a and b.
+inline void vecLoadDeinterleaved2(const float* src, SIMDVectorFloat& a, SIMDVectorFloat& b)
+{
+#ifdef ML_SSE_TO_NEON
+  neonLoadDeinterleaved2(src, a, b);
+#else
+  SIMDVectorFloat x = _mm_loadu_ps(src);
+  SIMDVectorFloat y = _mm_loadu_ps(src + 4);
+  a = _mm_shuffle_ps(x, y, SHUFFLE(2, 0, 2, 0));
+  b = _mm_shuffle_ps(x, y, SHUFFLE(3, 1, 3, 1));
+#endif
+}
+
+// the inverse of vecStoreTransposed4: load four floats from src + n * stride into element n
+// of a, b, c and d.
+inline void vecLoadTransposed4(const float* src, size_t stride, SIMDVectorFloat& a,
+                               SIMDVectorFloat& b, SIMDVectorFloat& c, SIMDVectorFloat& d)
+{
+  a = _mm_loadu_ps(src);
+  b = _mm_loadu_ps(src + stride);
+  c = _mm_loadu_ps(src + stride * 2);
+  d = _mm_loadu_ps(src + stride * 3);
+  _MM_TRANSPOSE4_PS(a, b, c, d);
+}
+
+// transpose the square of vectors v[0..3] in place: element j of v[i] goes to element i of
+// v[j].
+inline void vecTranspose(SIMDVectorFloat* v) { _MM_TRANSPOSE4_PS(v[0], v[1], v[2], v[3]); }
+
 // define infix operators for native SSE / MSVC.
 #ifndef ML_SSE_TO_NEON
 #ifdef WIN32
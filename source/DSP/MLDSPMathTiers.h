@@ -0,0 +1,242 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// MLDSPMathTiers.h
+// Transcendental functions at three levels of precision, chosen with a policy type.
+//
+// PreciseMath, ApproxMath and FastMath each have the same static functions sin, cos, exp, log,
+// exp2, log2, tanh and pow of DSPVectorArrays, and vecSin, vecCos, ... of SIMDVectorFloats. A
+// processor written with the policy as a template parameter can use cheap math for modulation
+// and accurate math for audio:
+//
+//   template <class Math = PreciseMath>
+//   class Chorus { ... DSPVector lfo = Math::sin(phase); ... };
+//
+// Maximum errors measured against double precision math. Errors are absolute for sin, cos and
+// tanh, relative for exp and exp2, and for log and log2 absolute up to a result of magnitude 1
+// and relative above:
+//
+//   tier          sin, cos   exp, exp2   log, log2   tanh
+//   PreciseMath   1e-7       1e-7        2e-7        2e-7
+//   ApproxMath    7e-6       1.5e-5      2e-5        5e-6
+//   FastMath      1e-3       1.2e-4      1e-3        7e-4
+//
+// sin and cos are accurate for |x| < 8192 in PreciseMath and for |x| < 1000 in the other tiers,
+// where the argument is wrapped into [-pi, pi] first. exp and exp2 of large arguments are
+// clamped; FastMath returns 0 below 2^-126. log and log2 of x <= 0 are NaN. pow(x, y) is
+// exp(y * log(x)), so its error grows with the size of y * log(x).
+
+#pragma once
+
+#include "MLDSPOps.h"
+
+namespace ml
+{
+namespace mathTiers
+{
+// x - 2 pi n for the nearest integer n, which is in [-pi, pi].
+inline SIMDVectorFloat vecWrapPhase(SIMDVectorFloat x)
+{
+  // 2 pi in two parts, the first of which times n is exact.
+  const SIMDVectorFloat kTwoPiA = vecSet1(6.28125f);
+  const SIMDVectorFloat kTwoPiB = vecSet1(1.9353071795864769e-3f);
+  SIMDVectorFloat n = vecIntToFloat(vecFloatToIntRound(vecMul(x, vecSet1(1.f / kTwoPi))));
+  return vecSub(vecSub(x, vecMul(n, kTwoPiA)), vecMul(n, kTwoPiB));
+}
+
+// x + pi / 2 for x in [-pi, pi], wrapped back into [-pi, pi], so that its sin is cos(x).
+inline SIMDVectorFloat vecCosToSinPhase(SIMDVectorFloat x)
+{
+  SIMDVectorFloat c = vecAdd(x, vecSet1(kPi * 0.5f));
+  return vecSelect(vecSub(c, vecSet1(kTwoPi)), c, vecGreaterThan(c, vecSet1(kPi)));
+}
+
+// 1 - 2 / (e^2x + 1), given e^2x.
+inline SIMDVectorFloat vecTanhFromExp(SIMDVectorFloat e2x)
+{
+  const SIMDVectorFloat kOne = vecSet1(1.f);
+  return vecSub(kOne, vecDiv(vecSet1(2.f), vecAdd(e2x, kOne)));
+}
+
+struct PreciseKernels
+{
+  static SIMDVectorFloat vecSin(SIMDVectorFloat x) { return ::vecSin(x); }
+  static SIMDVectorFloat vecCos(SIMDVectorFloat x) { return ::vecCos(x); }
+  static SIMDVectorFloat vecExp(SIMDVectorFloat x) { return ::vecExp(x); }
+  static SIMDVectorFloat vecLog(SIMDVectorFloat x) { return ::vecLog(x); }
+  static SIMDVectorFloat vecExp2(SIMDVectorFloat x)
+  {
+    // put the integer part in the exponent exactly, so the error does not grow with x.
+    x = vecClamp(x, vecSet1(-126.f), vecSet1(127.f));
+    SIMDVectorInt n = vecFloatToIntRound(x);
+    SIMDVectorFloat f = vecSub(x, vecIntToFloat(n));
+    SIMDVectorFloat scale = VecI2F(vecShiftLeftInt(vecAddInt(n, vecSetInt1(127)), 23));
+    return vecMul(::vecExp(vecMul(f, kLogTwoVec)), scale);
+  }
+  static SIMDVectorFloat vecLog2(SIMDVectorFloat x) { return vecMul(::vecLog(x), kLogTwoRVec); }
+  static SIMDVectorFloat vecTanh(SIMDVectorFloat x)
+  {
+    return vecTanhFromExp(::vecExp(vecAdd(x, x)));
+  }
+};
+
+struct ApproxKernels
+{
+  static SIMDVectorFloat vecSin(SIMDVectorFloat x) { return vecSinApprox(vecWrapPhase(x)); }
+  static SIMDVectorFloat vecCos(SIMDVectorFloat x)
+  {
+    // the cos polynomial has more error than the sin one.
+    return vecSinApprox(vecCosToSinPhase(vecWrapPhase(x)));
+  }
+  static SIMDVectorFloat vecExp(SIMDVectorFloat x) { return vecExpApprox(x); }
+  static SIMDVectorFloat vecLog(SIMDVectorFloat x)
+  {
+    // vecLogApprox returns numbers for x <= 0, so mark them as NaN like the other tiers.
+    return vecOr(vecLogApprox(x), vecLessThanOrEqual(x, vecSet1(0.f)));
+  }
+  static SIMDVectorFloat vecExp2(SIMDVectorFloat x) { return vecExpApprox(vecMul(x, kLogTwoVec)); }
+  static SIMDVectorFloat vecLog2(SIMDVectorFloat x) { return vecMul(vecLog(x), kLogTwoRVec); }
+  static SIMDVectorFloat vecTanh(SIMDVectorFloat x)
+  {
+    return vecTanhFromExp(vecExpApprox(vecAdd(x, x)));
+  }
+};
+
+struct FastKernels
+{
+  // a parabola for each half cycle, with a second parabola fitted to its error.
+  static SIMDVectorFloat vecSinInRange(SIMDVectorFloat x)
+  {
+    const SIMDVectorFloat kB = vecSet1(4.f / kPi);
+    const SIMDVectorFloat kC = vecSet1(-4.f / (kPi * kPi));
+    const SIMDVectorFloat kP = vecSet1(0.224008f);
+    SIMDVectorFloat y = vecMul(x, vecAdd(kB, vecMul(kC, vecAbs(x))));
+    return vecMul(y, vecAdd(vecSet1(1.f - 0.224008f), vecMul(kP, vecAbs(y))));
+  }
+
+  static SIMDVectorFloat vecSin(SIMDVectorFloat x) { return vecSinInRange(vecWrapPhase(x)); }
+  static SIMDVectorFloat vecCos(SIMDVectorFloat x)
+  {
+    return vecSinInRange(vecCosToSinPhase(vecWrapPhase(x)));
+  }
+
+  // 2^x, from the integer part in the exponent bits and a cubic for the fractional part that
+  // is exact at 0 and 1, so the result is continuous.
+  static SIMDVectorFloat vecExp2(SIMDVectorFloat x)
+  {
+    const SIMDVectorFloat kOne = vecSet1(1.f);
+    SIMDVectorFloat u = vecAdd(vecClamp(x, vecSet1(-126.f), vecSet1(127.99f)), vecSet1(127.f));
+    SIMDVectorInt i = vecFloatToIntTruncate(u);
+    SIMDVectorFloat f = vecSub(u, vecIntToFloat(i));
+    SIMDVectorFloat g = vecMul(vecMul(f, vecSub(kOne, f)),
+                               vecAdd(vecSet1(0.3046f), vecMul(vecSet1(0.0782f), f)));
+    SIMDVectorFloat p = vecSub(vecAdd(kOne, f), g);
+    SIMDVectorFloat y = vecMul(p, VecI2F(vecShiftLeftInt(i, 23)));
+    return vecSelect(vecSet1(0.f), y, vecLessThan(x, vecSet1(-126.f)));
+  }
+
+  // log2(x), from the exponent bits and a cubic for the mantissa that is exact at 1 and 2.
+  static SIMDVectorFloat vecLog2(SIMDVectorFloat x)
+  {
+    const SIMDVectorFloat kOne = vecSet1(1.f);
+    SIMDVectorInt bits = VecF2I(x);
+    SIMDVectorFloat e = vecIntToFloat(vecSubInt(vecShiftRightInt(bits, 23), vecSetInt1(127)));
+    SIMDVectorFloat m =
+        VecI2F(vecOrInt(vecAndInt(bits, vecSetInt1(0x7FFFFF)), vecSetInt1(0x3F800000)));
+    SIMDVectorFloat m1 = vecSub(m, kOne);
+    SIMDVectorFloat g = vecMul(vecSub(vecSet1(2.f), m),
+                               vecAdd(vecSet1(0.4228f), vecMul(vecSet1(-0.1592f), m1)));
+    SIMDVectorFloat y = vecAdd(e, vecMul(m1, vecAdd(kOne, g)));
+    return vecOr(y, vecLessThanOrEqual(x, vecSet1(0.f)));
+  }
+
+  static SIMDVectorFloat vecExp(SIMDVectorFloat x) { return vecExp2(vecMul(x, kLogTwoRVec)); }
+  static SIMDVectorFloat vecLog(SIMDVectorFloat x) { return vecMul(vecLog2(x), kLogTwoVec); }
+  static SIMDVectorFloat vecTanh(SIMDVectorFloat x)
+  {
+    const SIMDVectorFloat kOne = vecSet1(1.f);
+    SIMDVectorFloat e2x = vecExp2(vecMul(x, vecSet1(2.f * 1.4426950408889634f)));
+    return vecSub(kOne, vecMul(vecSet1(2.f), vecRecipApprox(vecAdd(e2x, kOne))));
+  }
+};
+
+// the DSPVectorArray functions of a tier, made from its SIMD kernels.
+template <class Kernels>
+struct MathTier : Kernels
+{
+  template <size_t ROWS, class Fn>
+  static DSPVectorArray<ROWS> map(const DSPVectorArray<ROWS>& vx, Fn fn)
+  {
+    DSPVectorArray<ROWS> vy;
+    const float* px = vx.getConstBuffer();
+    float* py = vy.getBuffer();
+    for (int n = 0; n < kSIMDVectorsPerDSPVector * ROWS; ++n)
+    {
+      vecStore(py, fn(vecLoad(px)));
+      px += kFloatsPerSIMDVector;
+      py += kFloatsPerSIMDVector;
+    }
+    return vy;
+  }
+
+  template <size_t ROWS>
+  static DSPVectorArray<ROWS> sin(const DSPVectorArray<ROWS>& x)
+  {
+    return map(x, [](SIMDVectorFloat v) { return Kernels::vecSin(v); });
+  }
+  template <size_t ROWS>
+  static DSPVectorArray<ROWS> cos(const DSPVectorArray<ROWS>& x)
+  {
+    return map(x, [](SIMDVectorFloat v) { return Kernels::vecCos(v); });
+  }
+  template <size_t ROWS>
+  static DSPVectorArray<ROWS> exp(const DSPVectorArray<ROWS>& x)
+  {
+    return map(x, [](SIMDVectorFloat v) { return Kernels::vecExp(v); });
+  }
+  template <size_t ROWS>
+  static DSPVectorArray<ROWS> log(const DSPVectorArray<ROWS>& x)
+  {
+    return map(x, [](SIMDVectorFloat v) { return Kernels::vecLog(v); });
+  }
+  template <size_t ROWS>
+  static DSPVectorArray<ROWS> exp2(const DSPVectorArray<ROWS>& x)
+  {
+    return map(x, [](SIMDVectorFloat v) { return Kernels::vecExp2(v); });
+  }
+  template <size_t ROWS>
+  static DSPVectorArray<ROWS> log2(const DSPVectorArray<ROWS>& x)
+  {
+    return map(x, [](SIMDVectorFloat v) { return Kernels::vecLog2(v); });
+  }
+  template <size_t ROWS>
+  static DSPVectorArray<ROWS> tanh(const DSPVectorArray<ROWS>& x)
+  {
+    return map(x, [](SIMDVectorFloat v) { return Kernels::vecTanh(v); });
+  }
+
+  template <size_t ROWS>
+  static DSPVectorArray<ROWS> pow(const DSPVectorArray<ROWS>& x, const DSPVectorArray<ROWS>& y)
+  {
+    DSPVectorArray<ROWS> vz;
+    const float* px = x.getConstBuffer();
+    const float* py = y.getConstBuffer();
+    float* pz = vz.getBuffer();
+    for (int n = 0; n < kSIMDVectorsPerDSPVector * ROWS; ++n)
+    {
+      vecStore(pz, Kernels::vecExp(vecMul(vecLoad(py), Kernels::vecLog(vecLoad(px)))));
+      px += kFloatsPerSIMDVector;
+      py += kFloatsPerSIMDVector;
+      pz += kFloatsPerSIMDVector;
+    }
+    return vz;
+  }
+};
+}  // namespace mathTiers
+
+using PreciseMath = mathTiers::MathTier<mathTiers::PreciseKernels>;
+using ApproxMath = mathTiers::MathTier<mathTiers::ApproxKernels>;
+using FastMath = mathTiers::MathTier<mathTiers::FastKernels>;
+
+}  // namespace ml
@@ -0,0 +1,79 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// MLDSPMathWASM.h
+// WebAssembly SIMD128 implementations of madronalib SIMD primitives.
+//
+// Emscripten provides the SSE headers on top of wasm_simd128.h, so the SSE implementations in
+// MLDSPMathSSE.h compile for WebAssembly much as they do for NEON. Build with -msimd128 -msse2.
+// Most SSE intrinsics become a single SIMD128 instruction. The primitives here are the
+// exceptions: conversions to int, which SSE defines by the rounding mode and by its out of
+// range result and Emscripten has to emulate, and select, integer min/max, floor and gather,
+// which SIMD128 can do directly. MLDSPMathSSE.h calls these native versions instead when
+// ML_SSE_TO_WASM is defined.
+
+#pragma once
+
+#include <wasm_simd128.h>
+
+#if !defined(__SSE2__)
+#error "MLDSPMathWASM.h: compile with -msimd128 -msse2."
+#endif
+
+#include <emmintrin.h>
+
+// select
+
+inline __m128 wasmSelect(__m128 a, __m128 b, __m128i mask)
+{
+  return (__m128)wasm_v128_bitselect((v128_t)a, (v128_t)b, (v128_t)mask);
+}
+
+inline __m128 wasmSelect(__m128 a, __m128 b, __m128 mask)
+{
+  return (__m128)wasm_v128_bitselect((v128_t)a, (v128_t)b, (v128_t)mask);
+}
+
+inline __m128i wasmSelect(__m128i a, __m128i b, __m128i mask)
+{
+  return (__m128i)wasm_v128_bitselect((v128_t)a, (v128_t)b, (v128_t)mask);
+}
+
+inline __m128i wasmMinInt(__m128i a, __m128i b)
+{
+  return (__m128i)wasm_i32x4_min((v128_t)a, (v128_t)b);
+}
+
+inline __m128i wasmMaxInt(__m128i a, __m128i b)
+{
+  return (__m128i)wasm_i32x4_max((v128_t)a, (v128_t)b);
+}
+
+// gather with lane loads, without going through memory.
+inline __m128 wasmGather(const float* p, __m128i idx)
+{
+  const v128_t i = (v128_t)idx;
+  v128_t r = wasm_v128_load32_splat(p + wasm_i32x4_extract_lane(i, 0));
+  r = wasm_v128_load32_lane(p + wasm_i32x4_extract_lane(i, 1), r, 1);
+  r = wasm_v128_load32_lane(p + wasm_i32x4_extract_lane(i, 2), r, 2);
+  return (__m128)wasm_v128_load32_lane(p + wasm_i32x4_extract_lane(i, 3), r, 3);
+}
+
+// rounding. The conversions to int saturate out of range values, where SSE returns 0x80000000.
+
+inline __m128 wasmFloor(__m128 x) { return (__m128)wasm_f32x4_floor((v128_t)x); }
+
+inline __m128 wasmTruncate(__m128 x) { return (__m128)wasm_f32x4_trunc((v128_t)x); }
+
+inline __m128i wasmFloatToIntTruncate(__m128 x)
+{
+  return (__m128i)wasm_i32x4_trunc_sat_f32x4((v128_t)x);
+}
+
+inline __m128i wasmFloatToIntRound(__m128 x)
+{
+  return (__m128i)wasm_i32x4_trunc_sat_f32x4(wasm_f32x4_nearest((v128_t)x));
+}
+
+#include "MLDSPMathSSE.h"
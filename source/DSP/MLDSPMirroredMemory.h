@@ -0,0 +1,216 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// MirroredMemory maps the same physical memory twice, into two adjacent ranges
+// of virtual memory. Writing past the end of the first range writes to its
+// start, so a ring buffer built on it never has to split a read or write at the
+// wrap point. The size must be a multiple of the page size.
+//
+// This uses memfd and mmap on Linux, vm_remap on macOS and iOS, and
+// VirtualAlloc2 / MapViewOfFile3 on Windows 10 and later. Where none of these
+// is available, allocate() returns false.
+//
+// On Windows, VirtualAlloc2 and MapViewOfFile3 are looked up in kernelbase.dll
+// when first needed, so no link to onecore.lib is needed and programs still
+// load on older versions of Windows.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "MLPlatform.h"
+
+#if ML_WINDOWS
+#include <windows.h>
+#elif ML_MAC || ML_IOS
+#include <mach/mach.h>
+#include <unistd.h>
+#elif ML_LINUX
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace ml
+{
+class MirroredMemory
+{
+ public:
+  MirroredMemory() = default;
+  ~MirroredMemory() { release(); }
+
+  MirroredMemory(const MirroredMemory&) = delete;
+  MirroredMemory& operator=(const MirroredMemory&) = delete;
+
+  static size_t getPageSize()
+  {
+#if ML_WINDOWS
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+
+    // views must be aligned to the allocation granularity, which is larger than a page.
+    return info.dwAllocationGranularity;
+#elif ML_MAC || ML_IOS || ML_LINUX
+    return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#else
+    return 4096;
+#endif
+  }
+
+#if ML_WINDOWS && defined(NTDDI_WIN10_RS4) && (NTDDI_VERSION >= NTDDI_WIN10_RS4)
+ private:
+  using VirtualAlloc2Fn = PVOID(WINAPI*)(HANDLE, PVOID, SIZE_T, ULONG, ULONG,
+                                         MEM_EXTENDED_PARAMETER*, ULONG);
+  using MapViewOfFile3Fn = PVOID(WINAPI*)(HANDLE, HANDLE, PVOID, ULONG64, SIZE_T, ULONG, ULONG,
+                                          MEM_EXTENDED_PARAMETER*, ULONG);
+
+  struct PlaceholderApi
+  {
+    VirtualAlloc2Fn virtualAlloc2{nullptr};
+    MapViewOfFile3Fn mapViewOfFile3{nullptr};
+  };
+
+  static const PlaceholderApi& getPlaceholderApi()
+  {
+    static const PlaceholderApi api = []() {
+      PlaceholderApi a;
+      if (HMODULE m = GetModuleHandleW(L"kernelbase.dll"))
+      {
+        a.virtualAlloc2 = reinterpret_cast<VirtualAlloc2Fn>(
+            reinterpret_cast<void*>(GetProcAddress(m, "VirtualAlloc2")));
+        a.mapViewOfFile3 = reinterpret_cast<MapViewOfFile3Fn>(
+            reinterpret_cast<void*>(GetProcAddress(m, "MapViewOfFile3")));
+      }
+      return a;
+    }();
+    return api;
+  }
+
+ public:
+#endif
+
+  // map size bytes twice. Returns true on success.
+  bool allocate(size_t size)
+  {
+    release();
+    if ((size == 0) || (size % getPageSize())) return false;
+
+#if ML_WINDOWS && defined(NTDDI_WIN10_RS4) && (NTDDI_VERSION >= NTDDI_WIN10_RS4)
+    const PlaceholderApi& api = getPlaceholderApi();
+    if (!api.virtualAlloc2 || !api.mapViewOfFile3) return false;
+
+    // reserve a placeholder for both views, then split it in two.
+    char* p = static_cast<char*>(api.virtualAlloc2(nullptr, nullptr, size * 2,
+                                                   MEM_RESERVE | MEM_RESERVE_PLACEHOLDER,
+                                                   PAGE_NOACCESS, nullptr, 0));
+    if (!p) return false;
+    if (!VirtualFree(p, size, MEM_RELEASE | MEM_PRESERVE_PLACEHOLDER))
+    {
+      VirtualFree(p, 0, MEM_RELEASE);
+      return false;
+    }
+
+    HANDLE section = CreateFileMapping(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                       static_cast<DWORD>(uint64_t(size) >> 32),
+                                       static_cast<DWORD>(size), nullptr);
+    void* view1{nullptr};
+    void* view2{nullptr};
+    if (section)
+    {
+      view1 = api.mapViewOfFile3(section, nullptr, p, 0, size, MEM_REPLACE_PLACEHOLDER,
+                                 PAGE_READWRITE, nullptr, 0);
+      view2 = api.mapViewOfFile3(section, nullptr, p + size, 0, size, MEM_REPLACE_PLACEHOLDER,
+                                 PAGE_READWRITE, nullptr, 0);
+      CloseHandle(section);
+    }
+    if (!view1 || !view2)
+    {
+      // turn each view back into a placeholder, then free both placeholders.
+      const HANDLE process = GetCurrentProcess();
+      if (view1) UnmapViewOfFile2(process, view1, MEM_PRESERVE_PLACEHOLDER);
+      if (view2) UnmapViewOfFile2(process, view2, MEM_PRESERVE_PLACEHOLDER);
+      VirtualFree(p, 0, MEM_RELEASE);
+      VirtualFree(p + size, 0, MEM_RELEASE);
+      return false;
+    }
+    data_ = p;
+
+#elif ML_MAC || ML_IOS
+    vm_address_t p;
+    if (vm_allocate(mach_task_self(), &p, size * 2, VM_FLAGS_ANYWHERE) != KERN_SUCCESS)
+    {
+      return false;
+    }
+
+    // replace the second half with a mapping of the first.
+    vm_deallocate(mach_task_self(), p + size, size);
+    vm_address_t mirror = p + size;
+    vm_prot_t cur, max;
+    if ((vm_remap(mach_task_self(), &mirror, size, 0, VM_FLAGS_FIXED, mach_task_self(), p, 0,
+                  &cur, &max, VM_INHERIT_DEFAULT) != KERN_SUCCESS) ||
+        (mirror != p + size))
+    {
+      vm_deallocate(mach_task_self(), p, size);
+      return false;
+    }
+    data_ = reinterpret_cast<char*>(p);
+
+#elif ML_LINUX
+    int fd = memfd_create("ml_mirrored_memory", MFD_CLOEXEC);
+    if (fd < 0) return false;
+    if (ftruncate(fd, size) != 0)
+    {
+      ::close(fd);
+      return false;
+    }
+
+    // reserve the whole range, then map the file into each half.
+    void* p = mmap(nullptr, size * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    bool ok = (p != MAP_FAILED);
+    if (ok)
+    {
+      char* c = static_cast<char*>(p);
+      const int prot = PROT_READ | PROT_WRITE;
+      const int flags = MAP_SHARED | MAP_FIXED;
+      ok = (mmap(c, size, prot, flags, fd, 0) != MAP_FAILED) &&
+           (mmap(c + size, size, prot, flags, fd, 0) != MAP_FAILED);
+      if (!ok) munmap(p, size * 2);
+    }
+    ::close(fd);
+    if (!ok) return false;
+    data_ = static_cast<char*>(p);
+
+#else
+    return false;
+#endif
+
+    size_ = size;
+    return true;
+  }
+
+  void release()
+  {
+    if (!data_) return;
+#if ML_WINDOWS && defined(NTDDI_WIN10_RS4) && (NTDDI_VERSION >= NTDDI_WIN10_RS4)
+    UnmapViewOfFile(data_);
+    UnmapViewOfFile(data_ + size_);
+#elif ML_MAC || ML_IOS
+    vm_deallocate(mach_task_self(), reinterpret_cast<vm_address_t>(data_), size_ * 2);
+#elif ML_LINUX
+    munmap(data_, size_ * 2);
+#endif
+    data_ = nullptr;
+    size_ = 0;
+  }
+
+  // the start of the first mapping. The same memory appears again at data() + size().
+  void* data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  char* data_{nullptr};
+  size_t size_{0};
+};
+
+}  // namespace ml
@@ -32,9 +32,11 @@
 #include <functional>
 #include <iostream>
 #include <iterator>
+#include <memory>
 #include <type_traits>
 #include <vector>
 
+#include "MLDSPDispatch.h"
 #include "MLDSPMath.h"
 #include "MLDSPScalarMath.h"
 
@@ -54,10 +56,50 @@ constexpr auto make_array(Function f)
   return make_array_helper(f, ml_make_index_sequence<N>{});
 }
 
+// makeTable: an array of N values fn(i) for i = 0 to N - 1. When used to initialize a
+// constexpr variable, the table is made by the compiler and stored in read-only data, so it
+// costs nothing at startup or per instance. Unlike make_array this fills the array in a loop,
+// so N can be large, up to the compiler's limit on constexpr evaluation steps. Use the
+// functions in ml::const_math to compute values at compile time.
+template <size_t N, class T = float, class Function>
+constexpr std::array<T, N> makeTable(Function fn)
+{
+  std::array<T, N> t{};
+  for (size_t i = 0; i < N; ++i)
+  {
+    t[i] = static_cast<T>(fn(i));
+  }
+  return t;
+}
+
+// makeSampledTable: an array of N values fn(x) for x spread evenly over [x1, x2], including
+// the ends.
+template <size_t N, class T = float, class Function>
+constexpr std::array<T, N> makeSampledTable(Function fn, double x1, double x2)
+{
+  static_assert(N > 1, "makeSampledTable: N must be at least 2");
+  std::array<T, N> t{};
+  for (size_t i = 0; i < N; ++i)
+  {
+    t[i] = static_cast<T>(fn(x1 + (x2 - x1) * static_cast<double>(i) / (N - 1)));
+  }
+  return t;
+}
+
 #if (_WIN32 && (!_WIN64))
 #define MANUAL_ALIGN_DSPVECTOR
 #endif
 
+// row() and constRow() view a row of a DSPVectorArray<ROWS> as a DSPVectorArray<1>, and
+// DSPVectorArrayInt likewise. Under strict aliasing, GCC and Clang would assume that accesses
+// through the two types can't touch the same memory, and could reorder or drop them. may_alias
+// tells them that these types can alias any other.
+#if defined(__GNUC__) || defined(__clang__)
+#define ML_DSPVECTOR_MAY_ALIAS __attribute__((__may_alias__))
+#else
+#define ML_DSPVECTOR_MAY_ALIAS
+#endif
+
 // ----------------------------------------------------------------
 // alignment definitions
 
@@ -105,7 +147,7 @@ make templates that create Banks with vertical output (<COLS, ROWS> ? ) using 4x
 namespace ml
 {
 template <size_t ROWS>
-class DSPVectorArray
+class ML_DSPVECTOR_MAY_ALIAS DSPVectorArray
 {
   // union def'n
 #ifdef MANUAL_ALIGN_DSPVECTOR
@@ -388,7 +430,7 @@ typedef DSPVectorArray<1> DSPVector;
 constexpr size_t kIntsPerDSPVector = kFloatsPerDSPVector;
 
 template <size_t ROWS>
-class DSPVectorArrayInt
+class ML_DSPVECTOR_MAY_ALIAS DSPVectorArrayInt
 {
 #ifdef MANUAL_ALIGN_DSPVECTOR
   union Data
@@ -525,6 +567,10 @@ typedef DSPVectorArrayInt<1> DSPVectorInt;
 
 // ----------------------------------------------------------------
 // DSPVectorDynamic: for holding a number of DSPVectors only known at runtime.
+//
+// The vectors are kept in memory aligned for SIMD on every platform, without relying on aligned
+// new. Capacity reserved at setup is kept, so that resizing within it or copying from a
+// DSPVectorDynamic that fits never allocates, and buses can be reconfigured on the audio thread.
 
 class DSPVectorDynamic final
 {
@@ -532,14 +578,96 @@ class DSPVectorDynamic final
   DSPVectorDynamic() = default;
   ~DSPVectorDynamic() = default;
 
-  explicit DSPVectorDynamic(size_t rows) { data_.resize(rows); }
-  void resize(size_t rows) { data_.resize(rows); }
-  size_t size() const { return data_.size(); }
+  explicit DSPVectorDynamic(size_t rows) { resize(rows); }
+  DSPVectorDynamic(size_t rows, size_t capacity)
+  {
+    reserve(capacity);
+    resize(rows);
+  }
+
+  DSPVectorDynamic(const DSPVectorDynamic& b) : DSPVectorDynamic(b.size_, b.capacity_)
+  {
+    std::copy(b.data_, b.data_ + b.size_, data_);
+  }
+
+  DSPVectorDynamic(DSPVectorDynamic&& b) noexcept { swap(b); }
+
+  // copying allocates only if b does not fit in the capacity of this.
+  DSPVectorDynamic& operator=(const DSPVectorDynamic& b)
+  {
+    if (this != &b)
+    {
+      reserve(b.size_);
+      std::copy(b.data_, b.data_ + b.size_, data_);
+      size_ = b.size_;
+    }
+    return *this;
+  }
+
+  DSPVectorDynamic& operator=(DSPVectorDynamic&& b) noexcept
+  {
+    swap(b);
+    return *this;
+  }
+
+  // make room for at least the given number of rows, keeping the current ones. This allocates
+  // if the capacity grows, so should be done at setup.
+  void reserve(size_t capacity)
+  {
+    if (capacity <= capacity_) return;
+    std::unique_ptr<unsigned char[]> memory(
+        new unsigned char[capacity * sizeof(DSPVector) + kAlignment - 1]);
+    uintptr_t p = reinterpret_cast<uintptr_t>(memory.get());
+    p = (p + kAlignment - 1) & ~uintptr_t(kAlignment - 1);
+    DSPVector* data = reinterpret_cast<DSPVector*>(p);
+    for (size_t j = 0; j < capacity; ++j)
+    {
+      new (data + j) DSPVector(j < size_ ? data_[j] : DSPVector());
+    }
+    memory_ = std::move(memory);
+    data_ = data;
+    capacity_ = capacity;
+  }
+
+  // resize to the given number of rows. New rows are zeroed. This only allocates if the rows
+  // don't fit in the capacity.
+  void resize(size_t rows)
+  {
+    reserve(rows);
+    for (size_t j = size_; j < rows; ++j)
+    {
+      data_[j] = DSPVector();
+    }
+    size_ = rows;
+  }
+
+  size_t size() const { return size_; }
+  size_t capacity() const { return capacity_; }
+
+  // the memory reserved for the vectors, including the padding for alignment.
+  size_t getMemoryBytes() const
+  {
+    return capacity_ ? capacity_ * sizeof(DSPVector) + kAlignment - 1 : 0;
+  }
+
   DSPVector& operator[](int j) { return data_[j]; }
   const DSPVector& operator[](int j) const { return data_[j]; }
 
  private:
-  std::vector<DSPVector> data_;
+  static constexpr size_t kAlignment{alignof(DSPVector) > 32 ? alignof(DSPVector) : 32};
+
+  void swap(DSPVectorDynamic& b) noexcept
+  {
+    std::swap(memory_, b.memory_);
+    std::swap(data_, b.data_);
+    std::swap(size_, b.size_);
+    std::swap(capacity_, b.capacity_);
+  }
+
+  std::unique_ptr<unsigned char[]> memory_;
+  DSPVector* data_{nullptr};
+  size_t size_{0};
+  size_t capacity_{0};
 };
 
 // ----------------------------------------------------------------
@@ -587,6 +715,215 @@ inline void storeAligned(const DSPVectorArray<ROWS>& vecSrc, float* pDest)
   }
 }
 
+// store the first n frames of the array in frame major order: sample i of row j goes to
+// pDest[i * ROWS + j]. Common row counts are transposed as SIMD vectors.
+template <size_t ROWS>
+inline void storeFrames(const DSPVectorArray<ROWS>& vecSrc, float* pDest, size_t frames)
+{
+  const float* px = vecSrc.getConstBuffer();
+  size_t i = 0;
+  if constexpr (ROWS == 1)
+  {
+    std::copy(px, px + frames, pDest);
+    return;
+  }
+  else if constexpr (ROWS == 2)
+  {
+    for (; i + kFloatsPerSIMDVector <= frames; i += kFloatsPerSIMDVector)
+    {
+      vecStoreInterleaved2(pDest + i * 2, vecLoad(px + i), vecLoad(px + kFloatsPerDSPVector + i));
+    }
+  }
+  else if constexpr (ROWS % 4 == 0)
+  {
+    for (; i + kFloatsPerSIMDVector <= frames; i += kFloatsPerSIMDVector)
+    {
+      for (size_t j = 0; j < ROWS; j += 4)
+      {
+        const float* pRow = px + j * kFloatsPerDSPVector + i;
+        vecStoreTransposed4(pDest + i * ROWS + j, ROWS, vecLoad(pRow),
+                            vecLoad(pRow + kFloatsPerDSPVector),
+                            vecLoad(pRow + kFloatsPerDSPVector * 2),
+                            vecLoad(pRow + kFloatsPerDSPVector * 3));
+      }
+    }
+  }
+
+  // any other row counts, and the frames after the last whole SIMD vector.
+  for (; i < frames; ++i)
+  {
+    for (size_t j = 0; j < ROWS; ++j)
+    {
+      pDest[i * ROWS + j] = px[j * kFloatsPerDSPVector + i];
+    }
+  }
+}
+
+// interleave frames from separate channel buffers: sample i of channel j goes to
+// pDest[i * channels + j]. 2 channels and multiples of 4 channels are done as SIMD vectors.
+inline void interleave(const float* const* pSrc, float* pDest, size_t channels, size_t frames)
+{
+  size_t i = 0;
+  if (channels == 1)
+  {
+    std::copy(pSrc[0], pSrc[0] + frames, pDest);
+    return;
+  }
+  else if (channels == 2)
+  {
+    for (; i + kFloatsPerSIMDVector <= frames; i += kFloatsPerSIMDVector)
+    {
+      vecStoreInterleaved2(pDest + i * 2, vecLoadUnaligned(pSrc[0] + i),
+                           vecLoadUnaligned(pSrc[1] + i));
+    }
+  }
+  else if (channels % 4 == 0)
+  {
+    for (; i + kFloatsPerSIMDVector <= frames; i += kFloatsPerSIMDVector)
+    {
+      for (size_t j = 0; j < channels; j += 4)
+      {
+        vecStoreTransposed4(pDest + i * channels + j, channels, vecLoadUnaligned(pSrc[j] + i),
+                            vecLoadUnaligned(pSrc[j + 1] + i), vecLoadUnaligned(pSrc[j + 2] + i),
+                            vecLoadUnaligned(pSrc[j + 3] + i));
+      }
+    }
+  }
+
+  for (; i < frames; ++i)
+  {
+    for (size_t j = 0; j < channels; ++j)
+    {
+      pDest[i * channels + j] = pSrc[j][i];
+    }
+  }
+}
+
+// the inverse of interleave(): sample j of frame i goes to pDest[j][i].
+inline void deinterleave(const float* pSrc, float* const* pDest, size_t channels, size_t frames)
+{
+  size_t i = 0;
+  if (channels == 1)
+  {
+    std::copy(pSrc, pSrc + frames, pDest[0]);
+    return;
+  }
+  else if (channels == 2)
+  {
+    for (; i + kFloatsPerSIMDVector <= frames; i += kFloatsPerSIMDVector)
+    {
+      SIMDVectorFloat a, b;
+      vecLoadDeinterleaved2(pSrc + i * 2, a, b);
+      vecStoreUnaligned(pDest[0] + i, a);
+      vecStoreUnaligned(pDest[1] + i, b);
+    }
+  }
+  else if (channels % 4 == 0)
+  {
+    for (; i + kFloatsPerSIMDVector <= frames; i += kFloatsPerSIMDVector)
+    {
+      for (size_t j = 0; j < channels; j += 4)
+      {
+        SIMDVectorFloat a, b, c, d;
+        vecLoadTransposed4(pSrc + i * channels + j, channels, a, b, c, d);
+        vecStoreUnaligned(pDest[j] + i, a);
+        vecStoreUnaligned(pDest[j + 1] + i, b);
+        vecStoreUnaligned(pDest[j + 2] + i, c);
+        vecStoreUnaligned(pDest[j + 3] + i, d);
+      }
+    }
+  }
+
+  for (; i < frames; ++i)
+  {
+    for (size_t j = 0; j < channels; ++j)
+    {
+      pDest[j][i] = pSrc[i * channels + j];
+    }
+  }
+}
+
+// LaneInterleaved: the rows of a DSPVectorArray in groups of kFloatsPerSIMDVector, with each
+// group interleaved so that sample n of the group is one SIMD vector holding a row in each
+// lane. This is the layout for running a recursive filter or envelope on one voice per lane.
+// Lanes past the last row are zero. The conversions transpose square blocks of SIMD vectors.
+template <size_t ROWS>
+class LaneInterleaved
+{
+ public:
+  static constexpr size_t kLanes{kFloatsPerSIMDVector};
+  static constexpr size_t kGroups{(ROWS + kLanes - 1) / kLanes};
+
+  LaneInterleaved() = default;
+  explicit LaneInterleaved(const DSPVectorArray<ROWS>& x) { load(x); }
+
+  // the group of rows [g * kLanes, g * kLanes + kLanes), with sample n of row g * kLanes + j
+  // at index n * kLanes + j.
+  float* getGroup(size_t g) { return data_.getBuffer() + g * kLanes * kFloatsPerDSPVector; }
+  const float* getConstGroup(size_t g) const
+  {
+    return data_.getConstBuffer() + g * kLanes * kFloatsPerDSPVector;
+  }
+
+  void load(const DSPVectorArray<ROWS>& x)
+  {
+    const float* px = x.getConstBuffer();
+    for (size_t g = 0; g < kGroups; ++g)
+    {
+      const size_t rows = groupRows(g);
+      float* pGroup = getGroup(g);
+      SIMDVectorFloat v[kLanes];
+      for (size_t i = 0; i < kFloatsPerDSPVector; i += kLanes)
+      {
+        for (size_t j = 0; j < kLanes; ++j)
+        {
+          v[j] = (j < rows) ? vecLoad(px + (g * kLanes + j) * kFloatsPerDSPVector + i) : vecZeros();
+        }
+        vecTranspose(v);
+        for (size_t j = 0; j < kLanes; ++j)
+        {
+          vecStore(pGroup + (i + j) * kLanes, v[j]);
+        }
+      }
+    }
+  }
+
+  void store(DSPVectorArray<ROWS>& y) const
+  {
+    float* py = y.getBuffer();
+    for (size_t g = 0; g < kGroups; ++g)
+    {
+      const size_t rows = groupRows(g);
+      const float* pGroup = getConstGroup(g);
+      SIMDVectorFloat v[kLanes];
+      for (size_t i = 0; i < kFloatsPerDSPVector; i += kLanes)
+      {
+        for (size_t j = 0; j < kLanes; ++j)
+        {
+          v[j] = vecLoad(pGroup + (i + j) * kLanes);
+        }
+        vecTranspose(v);
+        for (size_t j = 0; j < rows; ++j)
+        {
+          vecStore(py + (g * kLanes + j) * kFloatsPerDSPVector + i, v[j]);
+        }
+      }
+    }
+  }
+
+  DSPVectorArray<ROWS> toRows() const
+  {
+    DSPVectorArray<ROWS> y;
+    store(y);
+    return y;
+  }
+
+ private:
+  static constexpr size_t groupRows(size_t g) { return std::min(kLanes, ROWS - g * kLanes); }
+
+  DSPVectorArray<kGroups * kLanes> data_;
+};
+
 // ----------------------------------------------------------------
 // unary vector operators (float) -> float
 
@@ -607,8 +944,22 @@ inline void storeAligned(const DSPVectorArray<ROWS>& vecSrc, float* pDest)
     return vy;                                                         \
   }
 
+// unary operators that call a kernel chosen at runtime for the host CPU.
+#define DEFINE_OP1_DISPATCH(opName)                                                      \
+  template <size_t ROWS>                                                                 \
+  inline DSPVectorArray<ROWS>(opName)(const DSPVectorArray<ROWS>& vx1)                   \
+  {                                                                                      \
+    DSPVectorArray<ROWS> vy;                                                             \
+    getDSPKernels().opName(vx1.getConstBuffer(), vy.getBuffer(), kFloatsPerDSPVector * ROWS); \
+    return vy;                                                                           \
+  }
+
 DEFINE_OP1(recipApprox, (vecRecipApprox(x)));
+#ifdef ML_USE_RUNTIME_DISPATCH
+DEFINE_OP1_DISPATCH(sqrt);
+#else
 DEFINE_OP1(sqrt, (vecSqrt(x)));
+#endif
 DEFINE_OP1(sqrtApprox, vecSqrtApprox(x));
 DEFINE_OP1(abs, vecAbs(x));
 
@@ -619,14 +970,21 @@ DEFINE_OP1(sign, vecSign(x));
 DEFINE_OP1(signBit, vecSignBit(x));
 
 // trig, log and exp, using accurate cephes-derived library
+#ifdef ML_USE_RUNTIME_DISPATCH
+DEFINE_OP1_DISPATCH(sin);
+DEFINE_OP1_DISPATCH(cos);
+DEFINE_OP1_DISPATCH(log);
+DEFINE_OP1_DISPATCH(exp);
+#else
 DEFINE_OP1(sin, (vecSin(x)));
 DEFINE_OP1(cos, (vecCos(x)));
 DEFINE_OP1(log, (vecLog(x)));
 DEFINE_OP1(exp, (vecExp(x)));
+#endif
 
 // lazy log2 and exp2 from natural log / exp
-STATIC_M128_CONST(kLogTwoVec, 0.69314718055994529f);
-STATIC_M128_CONST(kLogTwoRVec, 1.4426950408889634f);
+STATIC_SIMD_CONST(kLogTwoVec, 0.69314718055994529f);
+STATIC_SIMD_CONST(kLogTwoRVec, 1.4426950408889634f);
 DEFINE_OP1(log2, (vecMul(vecLog(x), kLogTwoRVec)));
 DEFINE_OP1(exp2, (vecExp(vecMul(kLogTwoVec, x))));
 
@@ -641,7 +999,11 @@ DEFINE_OP1(log2Approx, (vecMul(vecLogApprox(x), kLogTwoRVec)));
 DEFINE_OP1(exp2Approx, (vecExpApprox(vecMul(kLogTwoVec, x))));
 
 // cubic tanh approx
+#ifdef ML_USE_RUNTIME_DISPATCH
+DEFINE_OP1_DISPATCH(tanhApprox);
+#else
 DEFINE_OP1(tanhApprox, (vecTanhApprox(x)));
+#endif
 
 // ----------------------------------------------------------------
 // binary vector operators (float, float) -> float
@@ -771,7 +1133,19 @@ DEFINE_OP2_INT32(addInt32, (vecAddInt(x1, x2)));
     return vy;                                                         \
   }
 
+#ifdef ML_USE_RUNTIME_DISPATCH
+template <size_t ROWS>
+inline DSPVectorArray<ROWS> lerp(const DSPVectorArray<ROWS>& vx1, const DSPVectorArray<ROWS>& vx2,
+                                 const DSPVectorArray<ROWS>& vx3)
+{
+  DSPVectorArray<ROWS> vy;
+  getDSPKernels().lerp(vx1.getConstBuffer(), vx2.getConstBuffer(), vx3.getConstBuffer(),
+                       vy.getBuffer(), kFloatsPerDSPVector * ROWS);
+  return vy;
+}
+#else
 DEFINE_OP3(lerp, vecAdd(x1, (vecMul(x3, vecSub(x2, x1)))));       // x = lerp(a, b, mix)
+#endif
 DEFINE_OP3(inverseLerp, vecDiv(vecSub(x3, x1), vecSub(x2, x1)));  // mix = inverseLerp(a, b, x)
 
 DEFINE_OP3(clamp, vecClamp(x1, x2, x3));    // clamp(x, minBound, maxBound)
@@ -1022,6 +1396,31 @@ inline DSPVector interpolateDSPVectorLinear(float start, float end)
 // ----------------------------------------------------------------
 // single-vector horizontal operators returning float
 
+#ifdef ML_USE_RUNTIME_DISPATCH
+
+inline float sum(const DSPVector& x)
+{
+  return getDSPKernels().sum(x.getConstBuffer(), kFloatsPerDSPVector);
+}
+
+inline float mean(const DSPVector& x)
+{
+  constexpr float kGain = 1.0f / kFloatsPerDSPVector;
+  return sum(x) * kGain;
+}
+
+inline float max(const DSPVector& x)
+{
+  return getDSPKernels().max(x.getConstBuffer(), kFloatsPerDSPVector);
+}
+
+inline float min(const DSPVector& x)
+{
+  return getDSPKernels().min(x.getConstBuffer(), kFloatsPerDSPVector);
+}
+
+#else
+
 inline float sum(const DSPVector& x)
 {
   const float* px1 = x.getConstBuffer();
@@ -1043,7 +1442,7 @@ inline float mean(const DSPVector& x)
 inline float max(const DSPVector& x)
 {
   const float* px1 = x.getConstBuffer();
-  float fmax = FLT_MIN;
+  float fmax = -FLT_MAX;
   for (int n = 0; n < kSIMDVectorsPerDSPVector; ++n)
   {
     fmax = ml::max(fmax, vecMaxH(vecLoad(px1)));
@@ -1064,6 +1463,26 @@ inline float min(const DSPVector& x)
   return fmin;
 }
 
+#endif  // ML_USE_RUNTIME_DISPATCH
+
+// true if every sample of x has the same value, as for unmodulated parameters, idle controls
+// and silence. This costs about as much as one add of two DSPVectors, so code making
+// coefficients from signals can check it and take a scalar path for the vector.
+inline bool isUniform(const DSPVector& x)
+{
+  const float* px1 = x.getConstBuffer();
+  SIMDVectorFloat vMax = vecLoad(px1);
+  SIMDVectorFloat vMin = vMax;
+  for (int n = 1; n < kSIMDVectorsPerDSPVector; ++n)
+  {
+    px1 += kFloatsPerSIMDVector;
+    const SIMDVectorFloat v = vecLoad(px1);
+    vMax = vecMax(vMax, v);
+    vMin = vecMin(vMin, v);
+  }
+  return vecMaxH(vMax) == vecMinH(vMin);
+}
+
 // ----------------------------------------------------------------
 // normalize
 
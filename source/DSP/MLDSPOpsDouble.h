@@ -0,0 +1,274 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// MLDSPOpsDouble.h
+// DSPVectorArrayD: DSPVectorArrays of doubles, for state that loses too much precision in float,
+// like the phase of a very slow phasor or the state of a low frequency filter. The math is done
+// kDoublesPerSIMDVector doubles at a time, so that such state can stay vectorized.
+//
+// Each row holds kFloatsPerDSPVector doubles, the same as a DSPVector has floats, so that
+// signals convert to and from float row for row:
+//
+//   DSPVectorD phase = wrapPhase(multiplyAdd(columnIndexD(), DSPVectorD(increment), phase0));
+//   DSPVector y = toFloat(phase);
+
+#pragma once
+
+#include <cmath>
+
+#include "MLDSPOps.h"
+
+namespace ml
+{
+constexpr int kDoubleSIMDVectorsPerDSPVector = kFloatsPerDSPVector / kDoublesPerSIMDVector;
+
+template <size_t ROWS>
+class DSPVectorArrayD
+{
+  union Data
+  {
+    SIMDVectorDouble _align[kDoubleSIMDVectorsPerDSPVector * ROWS];  // unused except to align
+    double asDouble[kFloatsPerDSPVector * ROWS];
+
+    Data() {}
+  };
+
+  Data data_;
+
+ public:
+  inline double* getBuffer() { return data_.asDouble; }
+  inline const double* getConstBuffer() const { return data_.asDouble; }
+
+  // default constructor: zeroes the data.
+  DSPVectorArrayD() { operator=(0.); }
+
+  // conversion constructors, from a double and from a float DSPVectorArray.
+  DSPVectorArrayD(double k) { operator=(k); }
+  explicit DSPVectorArrayD(const DSPVectorArray<ROWS>& x)
+  {
+    const float* px = x.getConstBuffer();
+    double* py = getBuffer();
+    for (int n = 0; n < kSIMDVectorsPerDSPVector * ROWS; ++n)
+    {
+      SIMDVectorDouble lo, hi;
+      vecFloatToDouble(vecLoad(px), lo, hi);
+      vecStoreD(py, lo);
+      vecStoreD(py + kDoublesPerSIMDVector, hi);
+      px += kFloatsPerSIMDVector;
+      py += kFloatsPerSIMDVector;
+    }
+  }
+
+  inline double& operator[](size_t i) { return getBuffer()[i]; }
+  inline double operator[](size_t i) const { return getConstBuffer()[i]; }
+
+  // = double: set each element to the value k.
+  inline DSPVectorArrayD operator=(double k)
+  {
+    const SIMDVectorDouble vk = vecSet1D(k);
+    double* py = getBuffer();
+    for (int n = 0; n < kDoubleSIMDVectorsPerDSPVector * ROWS; ++n)
+    {
+      vecStoreD(py, vk);
+      py += kDoublesPerSIMDVector;
+    }
+    return *this;
+  }
+
+  DSPVectorArrayD(const DSPVectorArrayD& x1) noexcept = default;
+  DSPVectorArrayD& operator=(const DSPVectorArrayD& x1) noexcept = default;
+
+  // equality by value
+  bool operator==(const DSPVectorArrayD& x1) const
+  {
+    const double* px1 = x1.getConstBuffer();
+    const double* py1 = getConstBuffer();
+    for (int n = 0; n < kFloatsPerDSPVector * ROWS; ++n)
+    {
+      if (py1[n] != px1[n]) return false;
+    }
+    return true;
+  }
+
+  // return a reference to a row of this DSPVectorArrayD.
+  inline DSPVectorArrayD<1>& row(int j)
+  {
+    double* py1 = getBuffer() + kFloatsPerDSPVector * j;
+    return *reinterpret_cast<DSPVectorArrayD<1>*>(py1);
+  }
+
+  // return a const reference to a row of this DSPVectorArrayD.
+  inline const DSPVectorArrayD<1>& constRow(int j) const
+  {
+    const double* py1 = getConstBuffer() + kFloatsPerDSPVector * j;
+    return *reinterpret_cast<const DSPVectorArrayD<1>*>(py1);
+  }
+
+  // apply a SIMD operation on doubles to each element of x1, or of x1 and x2.
+  template <class Op>
+  static inline DSPVectorArrayD map(const DSPVectorArrayD& x1, Op op)
+  {
+    DSPVectorArrayD vy;
+    const double* px1 = x1.getConstBuffer();
+    double* py = vy.getBuffer();
+    for (int n = 0; n < kDoubleSIMDVectorsPerDSPVector * ROWS; ++n)
+    {
+      vecStoreD(py, op(vecLoadD(px1)));
+      px1 += kDoublesPerSIMDVector;
+      py += kDoublesPerSIMDVector;
+    }
+    return vy;
+  }
+
+  template <class Op>
+  static inline DSPVectorArrayD map(const DSPVectorArrayD& x1, const DSPVectorArrayD& x2, Op op)
+  {
+    DSPVectorArrayD vy;
+    const double* px1 = x1.getConstBuffer();
+    const double* px2 = x2.getConstBuffer();
+    double* py = vy.getBuffer();
+    for (int n = 0; n < kDoubleSIMDVectorsPerDSPVector * ROWS; ++n)
+    {
+      vecStoreD(py, op(vecLoadD(px1), vecLoadD(px2)));
+      px1 += kDoublesPerSIMDVector;
+      px2 += kDoublesPerSIMDVector;
+      py += kDoublesPerSIMDVector;
+    }
+    return vy;
+  }
+
+  inline DSPVectorArrayD& operator+=(const DSPVectorArrayD& x1)
+  {
+    *this = *this + x1;
+    return *this;
+  }
+  inline DSPVectorArrayD& operator-=(const DSPVectorArrayD& x1)
+  {
+    *this = *this - x1;
+    return *this;
+  }
+  inline DSPVectorArrayD& operator*=(const DSPVectorArrayD& x1)
+  {
+    *this = *this * x1;
+    return *this;
+  }
+  inline DSPVectorArrayD& operator/=(const DSPVectorArrayD& x1)
+  {
+    *this = *this / x1;
+    return *this;
+  }
+
+  friend inline DSPVectorArrayD operator+(const DSPVectorArrayD& x1, const DSPVectorArrayD& x2)
+  {
+    return map(x1, x2, [](SIMDVectorDouble a, SIMDVectorDouble b) { return vecAddD(a, b); });
+  }
+  friend inline DSPVectorArrayD operator-(const DSPVectorArrayD& x1)
+  {
+    return map(x1, [](SIMDVectorDouble a) { return vecSubD(vecZerosD(), a); });
+  }
+  friend inline DSPVectorArrayD operator-(const DSPVectorArrayD& x1, const DSPVectorArrayD& x2)
+  {
+    return map(x1, x2, [](SIMDVectorDouble a, SIMDVectorDouble b) { return vecSubD(a, b); });
+  }
+  friend inline DSPVectorArrayD operator*(const DSPVectorArrayD& x1, const DSPVectorArrayD& x2)
+  {
+    return map(x1, x2, [](SIMDVectorDouble a, SIMDVectorDouble b) { return vecMulD(a, b); });
+  }
+  friend inline DSPVectorArrayD operator/(const DSPVectorArrayD& x1, const DSPVectorArrayD& x2)
+  {
+    return map(x1, x2, [](SIMDVectorDouble a, SIMDVectorDouble b) { return vecDivD(a, b); });
+  }
+};  // class DSPVectorArrayD
+
+typedef DSPVectorArrayD<1> DSPVectorD;
+
+// ----------------------------------------------------------------
+// conversions
+
+template <size_t ROWS>
+inline DSPVectorArrayD<ROWS> toDouble(const DSPVectorArray<ROWS>& x)
+{
+  return DSPVectorArrayD<ROWS>(x);
+}
+
+// round each element to the nearest float.
+template <size_t ROWS>
+inline DSPVectorArray<ROWS> toFloat(const DSPVectorArrayD<ROWS>& x)
+{
+  DSPVectorArray<ROWS> vy;
+  const double* px = x.getConstBuffer();
+  float* py = vy.getBuffer();
+  for (int n = 0; n < kSIMDVectorsPerDSPVector * ROWS; ++n)
+  {
+    vecStore(py, vecDoubleToFloat(vecLoadD(px), vecLoadD(px + kDoublesPerSIMDVector)));
+    px += kFloatsPerSIMDVector;
+    py += kFloatsPerSIMDVector;
+  }
+  return vy;
+}
+
+// ----------------------------------------------------------------
+// operations
+
+template <size_t ROWS>
+inline DSPVectorArrayD<ROWS> min(const DSPVectorArrayD<ROWS>& x1, const DSPVectorArrayD<ROWS>& x2)
+{
+  return DSPVectorArrayD<ROWS>::map(
+      x1, x2, [](SIMDVectorDouble a, SIMDVectorDouble b) { return vecMinD(a, b); });
+}
+
+template <size_t ROWS>
+inline DSPVectorArrayD<ROWS> max(const DSPVectorArrayD<ROWS>& x1, const DSPVectorArrayD<ROWS>& x2)
+{
+  return DSPVectorArrayD<ROWS>::map(
+      x1, x2, [](SIMDVectorDouble a, SIMDVectorDouble b) { return vecMaxD(a, b); });
+}
+
+template <size_t ROWS>
+inline DSPVectorArrayD<ROWS> sqrt(const DSPVectorArrayD<ROWS>& x1)
+{
+  return DSPVectorArrayD<ROWS>::map(x1, [](SIMDVectorDouble a) { return vecSqrtD(a); });
+}
+
+// x - floor(x), which wraps a phase in cycles to [0, 1). Unlike fractionalPart() for floats,
+// the result is never negative.
+template <size_t ROWS>
+inline DSPVectorArrayD<ROWS> wrapPhase(const DSPVectorArrayD<ROWS>& x1)
+{
+  return DSPVectorArrayD<ROWS>::map(x1,
+                                    [](SIMDVectorDouble a) { return vecSubD(a, vecFloorD(a)); });
+}
+
+// x1 * x2 + x3.
+template <size_t ROWS>
+inline DSPVectorArrayD<ROWS> multiplyAdd(const DSPVectorArrayD<ROWS>& x1,
+                                         const DSPVectorArrayD<ROWS>& x2,
+                                         const DSPVectorArrayD<ROWS>& x3)
+{
+  return x1 * x2 + x3;
+}
+
+// the elements 0, 1, 2 ... of a row, as doubles.
+inline DSPVectorD columnIndexD()
+{
+  DSPVectorD vy;
+  for (int n = 0; n < kFloatsPerDSPVector; ++n)
+  {
+    vy[n] = n;
+  }
+  return vy;
+}
+
+inline std::ostream& operator<<(std::ostream& out, const DSPVectorD& x)
+{
+  out << "[";
+  for (int n = 0; n < kFloatsPerDSPVector; ++n)
+  {
+    out << x[n] << ((n < kFloatsPerDSPVector - 1) ? " " : "");
+  }
+  out << "]";
+  return out;
+}
+
+}  // namespace ml
@@ -0,0 +1,213 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// ProjectionTable: any Projection sampled into a table at setup, then
+// evaluated on DSPVectors by interpolating the table with SIMD.
+//
+// This is for projections that are expensive to compute, like bell, log and
+// exp ranges, or user curves built with compose(), when many values need to
+// be mapped each vector. Inputs are clamped to the domain of the table.
+// Interpolation is linear or cubic (Hermite), using gathered loads as in
+// MultiTapDelay.
+//
+// When the table is made, the interpolated values are compared with the
+// projection at several points in each segment, and the largest difference is
+// kept as getMaxError(). withMaxError() makes the smallest power-of-two size
+// table that meets a given error.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "MLDSPOps.h"
+#include "MLDSPProjections.h"
+
+namespace ml
+{
+class ProjectionTable
+{
+ public:
+  enum class Interpolation
+  {
+    kLinear,
+    kHermite
+  };
+
+  static constexpr size_t kDefaultSize{256};
+  static constexpr size_t kMaxSize{1 << 16};
+
+  ProjectionTable() = default;
+
+  // sample the projection at size points spread evenly over the domain, including the ends.
+  ProjectionTable(const Projection& p, Interval domain = {0.f, 1.f}, size_t size = kDefaultSize,
+                  Interpolation interp = Interpolation::kLinear)
+      : domain_(domain), interp_(interp)
+  {
+    float* t = allocate(size);
+    for (int i = 0; i <= lastIndex_; ++i)
+    {
+      t[i] = p(domain.x1 + i / scale_);
+    }
+    extrapolateEnds();
+    measureError(p);
+  }
+
+  // make a table from size values already sampled at points spread evenly over the domain,
+  // including the ends. getMaxError() is zero, since there is no projection to compare with.
+  ProjectionTable(const float* values, size_t size, Interval domain,
+                  Interpolation interp = Interpolation::kLinear)
+      : domain_(domain), interp_(interp)
+  {
+    float* t = allocate(size);
+    std::copy(values, values + lastIndex_ + 1, t);
+    extrapolateEnds();
+  }
+
+  // the smallest power-of-two sized table, up to kMaxSize, with error no more than maxError.
+  static ProjectionTable withMaxError(const Projection& p, Interval domain, float maxError,
+                                      Interpolation interp = Interpolation::kLinear)
+  {
+    size_t size = 16;
+    ProjectionTable table(p, domain, size, interp);
+    while ((table.getMaxError() > maxError) && (size < kMaxSize))
+    {
+      size *= 2;
+      table = ProjectionTable(p, domain, size, interp);
+    }
+    return table;
+  }
+
+  size_t size() const { return lastIndex_ + 1; }
+  Interval getDomain() const { return domain_; }
+  float getMaxError() const { return maxError_; }
+
+  float operator()(float x) const
+  {
+    // written so that NaN goes to 0, as in the SIMD code.
+    float u = (x - domain_.x1) * scale_;
+    u = (u > 0.f) ? std::min(u, static_cast<float>(lastIndex_)) : 0.f;
+    int i = static_cast<int>(u);
+    float f = u - i;
+    const float* t = table_.data() + 1 + i;
+    if (interp_ == Interpolation::kHermite)
+    {
+      return hermite(t[-1], t[0], t[1], t[2], f);
+    }
+    return t[0] + f * (t[1] - t[0]);
+  }
+
+  DSPVector operator()(const DSPVector& x) const
+  {
+    DSPVector y;
+    if (interp_ == Interpolation::kHermite)
+    {
+      process<true>(x.getConstBuffer(), y.getBuffer());
+    }
+    else
+    {
+      process<false>(x.getConstBuffer(), y.getBuffer());
+    }
+    return y;
+  }
+
+ private:
+  static float hermite(float xm1, float x0, float x1, float x2, float f)
+  {
+    float c1 = 0.5f * (x1 - xm1);
+    float c2 = xm1 - 2.5f * x0 + 2.f * x1 - 0.5f * x2;
+    float c3 = 0.5f * (x2 - xm1) + 1.5f * (x0 - x1);
+    return ((c3 * f + c2) * f + c1) * f + x0;
+  }
+
+  template <bool kCubic>
+  void process(const float* px, float* py) const
+  {
+    // gather from the start of the padded table, so that indices are never negative.
+    const float* t = table_.data();
+    const SIMDVectorFloat vOffset = vecSet1(domain_.x1);
+    const SIMDVectorFloat vScale = vecSet1(scale_);
+    const SIMDVectorFloat vZero = vecZeros();
+    const SIMDVectorFloat vMax = vecSet1(static_cast<float>(lastIndex_));
+    const SIMDVectorInt vOne = vecSetInt1(1);
+
+    for (int n = 0; n < kSIMDVectorsPerDSPVector; ++n)
+    {
+      SIMDVectorFloat u = vecClamp(vecMul(vecSub(vecLoad(px), vOffset), vScale), vZero, vMax);
+      SIMDVectorInt iu = vecFloatToIntTruncate(u);
+      SIMDVectorFloat f = vecSub(u, vecIntToFloat(iu));
+      SIMDVectorInt i0 = vecAddInt(iu, vOne);
+      SIMDVectorInt i1 = vecAddInt(i0, vOne);
+      SIMDVectorFloat x0 = vecGather(t, i0);
+      SIMDVectorFloat x1 = vecGather(t, i1);
+      SIMDVectorFloat y;
+
+      if (kCubic)
+      {
+        SIMDVectorFloat xm1 = vecGather(t, iu);
+        SIMDVectorFloat x2 = vecGather(t, vecAddInt(i1, vOne));
+        const SIMDVectorFloat kHalf = vecSet1(0.5f);
+        SIMDVectorFloat c1 = vecMul(kHalf, vecSub(x1, xm1));
+        SIMDVectorFloat c2 = vecSub(vecAdd(xm1, vecAdd(x1, x1)),
+                                    vecAdd(vecMul(vecSet1(2.5f), x0), vecMul(kHalf, x2)));
+        SIMDVectorFloat c3 = vecAdd(vecMul(kHalf, vecSub(x2, xm1)),
+                                    vecMul(vecSet1(1.5f), vecSub(x0, x1)));
+        y = vecAdd(vecMul(vecAdd(vecMul(vecAdd(vecMul(c3, f), c2), f), c1), f), x0);
+      }
+      else
+      {
+        y = vecAdd(x0, vecMul(f, vecSub(x1, x0)));
+      }
+
+      vecStore(py, y);
+      px += kFloatsPerSIMDVector;
+      py += kFloatsPerSIMDVector;
+    }
+  }
+
+  // size the table for size points and return a pointer to the first.
+  float* allocate(size_t size)
+  {
+    size = std::max(size, size_t(2));
+    lastIndex_ = static_cast<int>(size - 1);
+    scale_ = lastIndex_ / (domain_.x2 - domain_.x1);
+    table_.assign(size + 3, 0.f);
+    return table_.data() + 1;
+  }
+
+  // one extra point before and two after, extrapolated linearly, so every
+  // segment has four neighbors for Hermite interpolation.
+  void extrapolateEnds()
+  {
+    float* t = table_.data() + 1;
+    t[-1] = 2.f * t[0] - t[1];
+    t[lastIndex_ + 1] = 2.f * t[lastIndex_] - t[lastIndex_ - 1];
+    t[lastIndex_ + 2] = 2.f * t[lastIndex_ + 1] - t[lastIndex_];
+  }
+
+  // compare with the projection at points inside each segment.
+  void measureError(const Projection& p)
+  {
+    constexpr int kPointsPerSegment{8};
+    maxError_ = 0.f;
+    for (int i = 0; i < lastIndex_; ++i)
+    {
+      for (int j = 1; j < kPointsPerSegment; ++j)
+      {
+        float x = domain_.x1 + (i + j / static_cast<float>(kPointsPerSegment)) / scale_;
+        maxError_ = std::max(maxError_, fabsf((*this)(x) - p(x)));
+      }
+    }
+  }
+
+  Interval domain_{0.f, 1.f};
+  Interpolation interp_{Interpolation::kLinear};
+  int lastIndex_{1};
+  float scale_{1.f};
+  float maxError_{0.f};
+  std::vector<float> table_ = std::vector<float>(5, 0.f);
+};
+
+}  // namespace ml
@@ -0,0 +1,227 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// MLDSPResampler.h
+// Polyphase windowed-sinc resampling at any ratio.
+//
+// A Resampler makes one DSPVector of output per call, reading as many input
+// samples as the ratio requires, so it can be driven by the output clock of
+// an audio callback for sample playback, varispeed or fixed rate conversion.
+// The ratio is in input samples per output sample and can change each call.
+//
+// The filter is a Kaiser windowed sinc sampled at kPhases fractional
+// positions, with linear interpolation between positions. The tables are
+// made once for each quality and cutoff and shared between all the
+// Resamplers that use them. Getting a table allocates the first time, so
+// Resamplers should be made outside the audio thread.
+
+#pragma once
+
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "MLDSPOps.h"
+
+namespace ml
+{
+class ResamplerKernel
+{
+ public:
+  enum class Quality
+  {
+    kLow,
+    kMedium,
+    kHigh,
+    kBest
+  };
+
+  // fractional positions between input samples that have their own row of coefficients.
+  static constexpr int kPhases{256};
+
+  // get the shared kernel for a quality and a cutoff relative to the input Nyquist frequency.
+  // Lower cutoffs, for downsampling, use proportionally more taps to keep the same quality.
+  static std::shared_ptr<const ResamplerKernel> get(Quality q, float cutoff = 1.f)
+  {
+    static std::mutex m;
+    static std::vector<std::shared_ptr<const ResamplerKernel>> kernels;
+
+    std::lock_guard<std::mutex> lock(m);
+    for (auto& k : kernels)
+    {
+      if ((k->quality_ == q) && (k->cutoff_ == cutoff)) return k;
+    }
+    kernels.emplace_back(new ResamplerKernel(q, cutoff));
+    return kernels.back();
+  }
+
+  // the number of taps, a multiple of the SIMD vector size.
+  int getTaps() const { return taps_; }
+
+  // the coefficients for fractional position p / kPhases, and the change to those for
+  // position (p + 1) / kPhases.
+  const float* getRow(int p) const { return rows_.data() + p * taps_; }
+  const float* getDelta(int p) const { return deltas_.data() + p * taps_; }
+
+ private:
+  ResamplerKernel(Quality q, float cutoff) : quality_(q), cutoff_(cutoff)
+  {
+    // taps at full cutoff and Kaiser beta for each quality.
+    constexpr int kQualityTaps[4]{8, 16, 32, 64};
+    constexpr float kQualityBeta[4]{5.f, 7.f, 9.f, 11.f};
+    const int qi = static_cast<int>(q);
+
+    cutoff = clamp(cutoff, 0.01f, 1.f);
+    int taps = static_cast<int>(std::ceil(kQualityTaps[qi] / cutoff));
+    taps_ = (taps + kFloatsPerSIMDVector - 1) / kFloatsPerSIMDVector * kFloatsPerSIMDVector;
+
+    // leave room for the transition band below the cutoff.
+    const double fc = cutoff * (1. - 2. / kQualityTaps[qi]);
+    const double beta = kQualityBeta[qi];
+    const double halfWidth = taps_ / 2.;
+    const double i0Beta = besselI0(beta);
+
+    // coefficient j at fractional position f multiplies the input j - (taps / 2 - 1) samples
+    // from the one before the output time.
+    std::vector<float> h((kPhases + 1) * taps_);
+    for (int p = 0; p <= kPhases; ++p)
+    {
+      const double f = p / double(kPhases);
+      for (int j = 0; j < taps_; ++j)
+      {
+        const double x = f + halfWidth - 1. - j;
+        const double w = x / halfWidth;
+        const double window =
+            (fabs(w) < 1.) ? besselI0(beta * std::sqrt(1. - w * w)) / i0Beta : 0.;
+        const double px = kPi * fc * x;
+        const double sinc = (fabs(px) < 1e-9) ? 1. : std::sin(px) / px;
+        h[p * taps_ + j] = static_cast<float>(fc * sinc * window);
+      }
+    }
+
+    rows_.resize(kPhases * taps_);
+    deltas_.resize(kPhases * taps_);
+    for (int i = 0; i < kPhases * taps_; ++i)
+    {
+      rows_[i] = h[i];
+      deltas_[i] = h[i + taps_] - h[i];
+    }
+  }
+
+  static double besselI0(double x)
+  {
+    double sum{1.}, term{1.};
+    for (int k = 1; k < 50; ++k)
+    {
+      term *= (x / (2. * k)) * (x / (2. * k));
+      sum += term;
+      if (term < sum * 1e-12) break;
+    }
+    return sum;
+  }
+
+  Quality quality_;
+  float cutoff_;
+  int taps_{0};
+  std::vector<float> rows_;
+  std::vector<float> deltas_;
+};
+
+class Resampler
+{
+ public:
+  using Quality = ResamplerKernel::Quality;
+
+  // make a resampler for ratios of input to output samples up to maxRatio. Ratios above 1
+  // downsample, and a maxRatio above 1 lowers the cutoff to remove what would alias.
+  explicit Resampler(Quality q = Quality::kHigh, float maxRatio = 1.f)
+      : kernel_(ResamplerKernel::get(q, 1.f / std::max(maxRatio, 1.f))),
+        maxRatio_(std::max(maxRatio, 1.f / 256.f)),
+        taps_(kernel_->getTaps()),
+        buffer_(taps_ + getMaxInput())
+  {
+    clear();
+  }
+
+  // the delay from input to output, in input samples: output n after a clear() is the input
+  // at time n * ratio - getLatency().
+  float getLatency() const { return taps_ / 2.f; }
+
+  // the most input samples one call can read.
+  size_t getMaxInput() const
+  {
+    return static_cast<size_t>(std::ceil(kFloatsPerDSPVector * maxRatio_)) + 1;
+  }
+
+  const ResamplerKernel& getKernel() const { return *kernel_; }
+
+  // the number of input samples the next call will read at the given ratio.
+  size_t getInputNeeded(double ratio) const
+  {
+    ratio = clampRatio(ratio);
+    double last = position_ + (kFloatsPerDSPVector - 1) * ratio;
+    return static_cast<size_t>(std::floor(last)) + 1 - taps_ / 2;
+  }
+
+  // read getInputNeeded(ratio) samples from pInput and make the next DSPVector of output.
+  DSPVector operator()(const float* pInput, double ratio)
+  {
+    ratio = clampRatio(ratio);
+    const size_t nIn = getInputNeeded(ratio);
+    std::copy(pInput, pInput + nIn, buffer_.data() + taps_);
+
+    DSPVector y;
+    const float* x = buffer_.data();
+    const int firstTapOffset = taps_ / 2 - 1;
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      double t = position_ + n * ratio;
+      double it = std::floor(t);
+      float u = static_cast<float>((t - it) * ResamplerKernel::kPhases);
+      int p = std::min(static_cast<int>(u), ResamplerKernel::kPhases - 1);
+      SIMDVectorFloat vFrac = vecSet1(u - p);
+
+      const float* px = x + static_cast<int>(it) - firstTapOffset;
+      const float* pRow = kernel_->getRow(p);
+      const float* pDelta = kernel_->getDelta(p);
+      SIMDVectorFloat sum = vecZeros();
+      for (int j = 0; j < taps_; j += kFloatsPerSIMDVector)
+      {
+        SIMDVectorFloat row = vecLoadUnaligned(pRow + j);
+        SIMDVectorFloat c = vecAdd(row, vecMul(vFrac, vecLoadUnaligned(pDelta + j)));
+        sum = vecAdd(sum, vecMul(c, vecLoadUnaligned(px + j)));
+      }
+      y[n] = vecSumH(sum);
+    }
+
+    // keep the last taps samples and move the position back by the input read.
+    std::copy(buffer_.data() + nIn, buffer_.data() + nIn + taps_, buffer_.data());
+    position_ += kFloatsPerDSPVector * ratio - nIn;
+    return y;
+  }
+
+  // clear the input history. The first output is at the earliest time that needs no input
+  // before the history.
+  void clear()
+  {
+    std::fill(buffer_.begin(), buffer_.end(), 0.f);
+    position_ = taps_ / 2;
+  }
+
+ private:
+  double clampRatio(double ratio) const { return clamp(ratio, 1. / 256., double(maxRatio_)); }
+
+  std::shared_ptr<const ResamplerKernel> kernel_;
+  float maxRatio_;
+  int taps_;
+
+  // the last taps input samples, then the input for the current call.
+  std::vector<float> buffer_;
+
+  // the time of the next output within the buffer, in input samples.
+  double position_{0.};
+};
+
+}  // namespace ml
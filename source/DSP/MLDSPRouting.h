@@ -18,14 +18,18 @@
 #define snprintf _snprintf
 #endif
 
+#include <algorithm>
 #include <array>
+#include <cmath>
 #include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <iostream>
 #include <iterator>
 #include <type_traits>
 
 #include "MLDSPMath.h"
+#include "MLDSPOps.h"
 #include "MLDSPScalarMath.h"
 
 namespace ml
@@ -233,6 +237,410 @@ void demultiplexLinear(DSPVector selector, DSPVectorArray<ROWS> input,
   }
 }
 
+// MixMatrix: mix IN input rows into OUT output rows through a matrix of gains. Each output is
+// the sum of the inputs times their gains, and gains glide linearly to new values over whole
+// DSPVectors, with a sample-accurate ramp across each vector.
+//
+// The gains that are not zero are kept in a list that is remade when they change. When the
+// list is short the matrix is sparse and only its entries are mixed. Otherwise all the gains
+// are mixed with outputs blocked kOutputBlock at a time, so that each input vector loaded is
+// used for several outputs.
+
+template <size_t IN, size_t OUT>
+class MixMatrix
+{
+ public:
+  static constexpr size_t kOutputBlock{4};
+
+  MixMatrix() = default;
+
+  // glides take t samples, rounded down to whole DSPVectors with a minimum of one.
+  void setGlideTimeInSamples(float t)
+  {
+    vectorsPerGlide_ = std::max(1, int(std::floor(t / kFloatsPerDSPVector)));
+  }
+
+  // glide the gain from input i to output j to g, starting at the next call.
+  void setGain(size_t i, size_t j, float g)
+  {
+    const size_t k = i * OUT + j;
+    if (g == target_[k]) return;
+    target_[k] = g;
+    step_[k] = (g - gain_[k]) / vectorsPerGlide_;
+    remaining_[k] = vectorsPerGlide_;
+    listsChanged_ = true;
+  }
+
+  // set the gain from input i to output j to g without gliding.
+  void setGainImmediately(size_t i, size_t j, float g)
+  {
+    const size_t k = i * OUT + j;
+    gain_[k] = target_[k] = g;
+    step_[k] = 0.f;
+    remaining_[k] = 0;
+    listsChanged_ = true;
+  }
+
+  // the gain the entry is at or gliding to.
+  float getGain(size_t i, size_t j) const { return target_[i * OUT + j]; }
+
+  // the number of gains mixed in the next call. A sparse matrix mixes only these.
+  size_t getActiveGains()
+  {
+    updateLists();
+    return activeCount_;
+  }
+
+  bool isDense()
+  {
+    updateLists();
+    return dense_;
+  }
+
+  // set all the gains to zero.
+  void clear()
+  {
+    gain_.fill(0.f);
+    target_.fill(0.f);
+    step_.fill(0.f);
+    remaining_.fill(0);
+    listsChanged_ = true;
+  }
+
+  DSPVectorArray<OUT> operator()(const DSPVectorArray<IN>& x)
+  {
+    updateLists();
+
+    DSPVectorArray<OUT> y;
+    if (dense_)
+    {
+      mixDense(x, y);
+    }
+    else
+    {
+      for (size_t n = 0; n < activeCount_; ++n)
+      {
+        const size_t k = active_[n];
+        const DSPVector& xi = x.constRow(int(k / OUT));
+        y.row(int(k % OUT)) += xi * DSPVector(gain_[k]);
+      }
+    }
+
+    // add the ramp of each gliding gain, and move it on by one vector.
+    if (glideCount_)
+    {
+      const DSPVector ramp =
+          (columnIndex() + DSPVector(1.f)) * DSPVector(1.f / kFloatsPerDSPVector);
+      for (size_t n = 0; n < glideCount_; ++n)
+      {
+        const size_t k = gliding_[n];
+        const DSPVector& xi = x.constRow(int(k / OUT));
+        y.row(int(k % OUT)) += xi * ramp * DSPVector(step_[k]);
+
+        if (--remaining_[k] > 0)
+        {
+          gain_[k] += step_[k];
+        }
+        else
+        {
+          gain_[k] = target_[k];
+          step_[k] = 0.f;
+          listsChanged_ = true;
+        }
+      }
+    }
+    return y;
+  }
+
+ private:
+  static constexpr size_t kSize{IN * OUT};
+
+  // remake the lists of gains to mix and gains gliding, and choose the sparse or dense mix.
+  void updateLists()
+  {
+    if (!listsChanged_) return;
+    activeCount_ = glideCount_ = 0;
+    for (size_t k = 0; k < kSize; ++k)
+    {
+      if (remaining_[k] > 0) gliding_[glideCount_++] = k;
+      if (gain_[k] != 0.f || remaining_[k] > 0) active_[activeCount_++] = k;
+    }
+    dense_ = (activeCount_ * 4 > kSize);
+    listsChanged_ = false;
+  }
+
+  void mixDense(const DSPVectorArray<IN>& x, DSPVectorArray<OUT>& y) const
+  {
+    size_t j0 = 0;
+    for (; j0 + kOutputBlock <= OUT; j0 += kOutputBlock)
+    {
+      float* py[kOutputBlock];
+      for (size_t b = 0; b < kOutputBlock; ++b)
+      {
+        py[b] = y.row(int(j0 + b)).getBuffer();
+      }
+      for (size_t i = 0; i < IN; ++i)
+      {
+        SIMDVectorFloat g[kOutputBlock];
+        for (size_t b = 0; b < kOutputBlock; ++b)
+        {
+          g[b] = vecSet1(gain_[i * OUT + j0 + b]);
+        }
+        const float* px = x.constRow(int(i)).getConstBuffer();
+        for (int n = 0; n < kFloatsPerDSPVector; n += kFloatsPerSIMDVector)
+        {
+          SIMDVectorFloat xv = vecLoad(px + n);
+          for (size_t b = 0; b < kOutputBlock; ++b)
+          {
+            vecStore(py[b] + n, vecAdd(vecLoad(py[b] + n), vecMul(g[b], xv)));
+          }
+        }
+      }
+    }
+
+    // outputs left over after the blocks.
+    for (; j0 < OUT; ++j0)
+    {
+      for (size_t i = 0; i < IN; ++i)
+      {
+        y.row(int(j0)) += x.constRow(int(i)) * DSPVector(gain_[i * OUT + j0]);
+      }
+    }
+  }
+
+  // gains at the start of the next vector, the values they glide to, and the change per vector.
+  std::array<float, kSize> gain_{};
+  std::array<float, kSize> target_{};
+  std::array<float, kSize> step_{};
+  std::array<int, kSize> remaining_{};
+  int vectorsPerGlide_{1};
+
+  std::array<size_t, kSize> active_{};
+  std::array<size_t, kSize> gliding_{};
+  size_t activeCount_{0};
+  size_t glideCount_{0};
+  bool dense_{false};
+  bool listsChanged_{false};
+};
+
+// ----------------------------------------------------------------
+// bus operations: gains, pans, mixdowns, accumulation and copies over any number of channels,
+// for DSPVectorDynamic and DSPVectorArray alike. Each channel is one row. Gains are given as
+// one float per channel, so a whole bus is processed in one call without temporaries.
+//
+// Mixdowns go through the signal in tiles of kBusTileSIMDVectors SIMD vectors: the sums for a
+// tile are kept in registers while every channel is added to them, so each input is read once
+// and each output written once however many channels there are.
+
+constexpr int kBusTileSIMDVectors{4};
+constexpr int kFloatsPerBusTile{kBusTileSIMDVectors * kFloatsPerSIMDVector};
+static_assert(kFloatsPerDSPVector % kFloatsPerBusTile == 0,
+              "bus tiles must divide a DSPVector evenly");
+
+namespace busChannels
+{
+inline size_t count(const DSPVectorDynamic& x) { return x.size(); }
+inline float* row(DSPVectorDynamic& x, size_t c) { return x[int(c)].getBuffer(); }
+inline const float* row(const DSPVectorDynamic& x, size_t c)
+{
+  return x[int(c)].getConstBuffer();
+}
+
+template <size_t ROWS>
+constexpr size_t count(const DSPVectorArray<ROWS>&)
+{
+  return ROWS;
+}
+
+template <size_t ROWS>
+inline float* row(DSPVectorArray<ROWS>& x, size_t c)
+{
+  return x.row(int(c)).getBuffer();
+}
+
+template <size_t ROWS>
+inline const float* row(const DSPVectorArray<ROWS>& x, size_t c)
+{
+  return x.constRow(int(c)).getConstBuffer();
+}
+}  // namespace busChannels
+
+enum class PanLaw
+{
+  kLinear,         // -6 dB at the center: the left and right gains sum to 1.
+  kConstantPower,  // -3 dB at the center: the left and right powers sum to 1.
+  kCompromise      // -4.5 dB at the center, halfway between the two.
+};
+
+struct StereoGains
+{
+  float left{0.f};
+  float right{0.f};
+};
+
+// the gains of a pan from -1 (left) to 1 (right).
+inline StereoGains getPanGains(float pan, PanLaw law)
+{
+  const float p = (std::clamp(pan, -1.f, 1.f) + 1.f) * 0.5f;
+  const float theta = p * kPi * 0.5f;
+  switch (law)
+  {
+    case PanLaw::kLinear:
+      return {1.f - p, p};
+    case PanLaw::kConstantPower:
+      return {std::cos(theta), std::sin(theta)};
+    case PanLaw::kCompromise:
+    default:
+      return {std::sqrt((1.f - p) * std::cos(theta)), std::sqrt(p * std::sin(theta))};
+  }
+}
+
+// make the StereoGains for n channels from their pans and, if given, their levels. This does a
+// little trigonometry for each channel, so should be done when the pans change rather than for
+// every vector.
+inline void makePanGains(const float* pans, size_t n, PanLaw law, StereoGains* gains,
+                         const float* levels = nullptr)
+{
+  for (size_t c = 0; c < n; ++c)
+  {
+    StereoGains g = getPanGains(pans[c], law);
+    const float level = levels ? levels[c] : 1.f;
+    gains[c] = {g.left * level, g.right * level};
+  }
+}
+
+// multiply each channel of x by its gain.
+template <class T>
+inline void scaleChannels(T& x, const float* gains)
+{
+  for (size_t c = 0; c < busChannels::count(x); ++c)
+  {
+    const SIMDVectorFloat g = vecSet1(gains[c]);
+    float* px = busChannels::row(x, c);
+    for (int n = 0; n < kFloatsPerDSPVector; n += kFloatsPerSIMDVector)
+    {
+      vecStore(px + n, vecMul(g, vecLoad(px + n)));
+    }
+  }
+}
+
+// multiply each channel of x by a gain that moves linearly from its start gain to its end gain
+// over the vector, reaching the end gain at the last sample.
+template <class T>
+inline void scaleChannels(T& x, const float* startGains, const float* endGains)
+{
+  const DSPVector ramp = (columnIndex() + DSPVector(1.f)) * DSPVector(1.f / kFloatsPerDSPVector);
+  const float* pr = ramp.getConstBuffer();
+  for (size_t c = 0; c < busChannels::count(x); ++c)
+  {
+    const SIMDVectorFloat g0 = vecSet1(startGains[c]);
+    const SIMDVectorFloat dg = vecSet1(endGains[c] - startGains[c]);
+    float* px = busChannels::row(x, c);
+    for (int n = 0; n < kFloatsPerDSPVector; n += kFloatsPerSIMDVector)
+    {
+      const SIMDVectorFloat g = vecAdd(g0, vecMul(dg, vecLoad(pr + n)));
+      vecStore(px + n, vecMul(g, vecLoad(px + n)));
+    }
+  }
+}
+
+// add each channel of src, times its gain if gains are given, to the same channel of dest. The
+// channels that both have are used.
+template <class TSrc, class TDest>
+inline void accumulateChannels(const TSrc& src, TDest& dest, const float* gains = nullptr)
+{
+  const size_t channels = std::min(busChannels::count(src), busChannels::count(dest));
+  for (size_t c = 0; c < channels; ++c)
+  {
+    const SIMDVectorFloat g = vecSet1(gains ? gains[c] : 1.f);
+    const float* px = busChannels::row(src, c);
+    float* py = busChannels::row(dest, c);
+    for (int n = 0; n < kFloatsPerDSPVector; n += kFloatsPerSIMDVector)
+    {
+      vecStore(py + n, vecAdd(vecLoad(py + n), vecMul(g, vecLoad(px + n))));
+    }
+  }
+}
+
+// copy n channels of src, starting at srcStart, to dest starting at destStart. The copy is cut
+// short at the end of either.
+template <class TSrc, class TDest>
+inline void copyChannels(const TSrc& src, TDest& dest, size_t srcStart = 0, size_t destStart = 0,
+                         size_t n = SIZE_MAX)
+{
+  const size_t srcChannels = busChannels::count(src);
+  const size_t destChannels = busChannels::count(dest);
+  if (srcStart >= srcChannels || destStart >= destChannels) return;
+  n = std::min({n, srcChannels - srcStart, destChannels - destStart});
+  for (size_t c = 0; c < n; ++c)
+  {
+    const float* px = busChannels::row(src, srcStart + c);
+    std::copy(px, px + kFloatsPerDSPVector, busChannels::row(dest, destStart + c));
+  }
+}
+
+// the sum of all the channels of x, each times its gain if gains are given.
+template <class T>
+inline DSPVector mixToMono(const T& x, const float* gains = nullptr)
+{
+  DSPVector y;
+  float* py = y.getBuffer();
+  const size_t channels = busChannels::count(x);
+  for (int n = 0; n < kFloatsPerDSPVector; n += kFloatsPerBusTile)
+  {
+    SIMDVectorFloat sum[kBusTileSIMDVectors];
+    for (int v = 0; v < kBusTileSIMDVectors; ++v) sum[v] = vecSet1(0.f);
+    for (size_t c = 0; c < channels; ++c)
+    {
+      const SIMDVectorFloat g = vecSet1(gains ? gains[c] : 1.f);
+      const float* px = busChannels::row(x, c) + n;
+      for (int v = 0; v < kBusTileSIMDVectors; ++v)
+      {
+        sum[v] = vecAdd(sum[v], vecMul(g, vecLoad(px + v * kFloatsPerSIMDVector)));
+      }
+    }
+    for (int v = 0; v < kBusTileSIMDVectors; ++v)
+    {
+      vecStore(py + n + v * kFloatsPerSIMDVector, sum[v]);
+    }
+  }
+  return y;
+}
+
+// the sum of all the channels of x into two rows, left and right, each channel with its
+// StereoGains, as made by makePanGains().
+template <class T>
+inline DSPVectorArray<2> mixToStereo(const T& x, const StereoGains* gains)
+{
+  DSPVectorArray<2> y;
+  float* pl = y.row(0).getBuffer();
+  float* pr = y.row(1).getBuffer();
+  const size_t channels = busChannels::count(x);
+  for (int n = 0; n < kFloatsPerDSPVector; n += kFloatsPerBusTile)
+  {
+    SIMDVectorFloat left[kBusTileSIMDVectors], right[kBusTileSIMDVectors];
+    for (int v = 0; v < kBusTileSIMDVectors; ++v) left[v] = right[v] = vecSet1(0.f);
+    for (size_t c = 0; c < channels; ++c)
+    {
+      const SIMDVectorFloat gl = vecSet1(gains[c].left);
+      const SIMDVectorFloat gr = vecSet1(gains[c].right);
+      const float* px = busChannels::row(x, c) + n;
+      for (int v = 0; v < kBusTileSIMDVectors; ++v)
+      {
+        const SIMDVectorFloat xv = vecLoad(px + v * kFloatsPerSIMDVector);
+        left[v] = vecAdd(left[v], vecMul(gl, xv));
+        right[v] = vecAdd(right[v], vecMul(gr, xv));
+      }
+    }
+    for (int v = 0; v < kBusTileSIMDVectors; ++v)
+    {
+      vecStore(pl + n + v * kFloatsPerSIMDVector, left[v]);
+      vecStore(pr + n + v * kFloatsPerSIMDVector, right[v]);
+    }
+  }
+  return y;
+}
+
 // should multiplex be on multiple inputs, rows of one input, different flavors for both??
 
 // demultiplex(outputSelector, signalInput ) -> DSPVectorArray<inputs> ;
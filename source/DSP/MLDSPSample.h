@@ -9,6 +9,8 @@
 #include <algorithm>
 #include <vector>
 
+#include "MLDSPLargeBuffer.h"
+
 namespace ml
 {
 
@@ -16,7 +18,7 @@ struct Sample
 {
   size_t channels{0};
   size_t sampleRate{0};
-  std::vector<float> sampleData;
+  LargeBuffer<float> sampleData;
 
   float operator[](size_t i) const { return sampleData[i]; }
   float& operator[](size_t i) { return sampleData[i]; }
@@ -24,6 +26,8 @@ struct Sample
 
 inline size_t getSize(const Sample& s) { return s.sampleData.size(); }
 
+inline size_t getMemoryBytes(const Sample& s) { return s.sampleData.capacity() * sizeof(float); }
+
 inline size_t getFrames(const Sample& s)
 {
   if (s.channels == 0) return 0;
@@ -86,4 +90,11 @@ inline void normalize(Sample& x)
 
 inline void clear(Sample& x) { x.sampleData.clear(); }
 
+// allocate the sample data, now and when it is resized, following the policy. Any data is
+// cleared.
+inline void setBufferPolicy(Sample& x, const LargeBufferPolicy& policy)
+{
+  setBufferPolicy(x.sampleData, policy);
+}
+
 }  // namespace ml
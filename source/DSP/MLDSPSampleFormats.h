@@ -0,0 +1,320 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// MLDSPSampleFormats.h
+// Conversions between floats and the sample formats of audio devices: 16, 24 and 32 bit
+// integers and 32 bit floats, in native byte order, planar or interleaved.
+//
+// Integers are scaled so that full scale is 1: -32768 is -1.0 and 32767 is 1.0 - 1/32768.
+// Floats going out are clamped to the integer range. 24 bit samples are packed in 3 bytes. Each
+// SIMD vector of samples is widened or unpacked to 32 bit integer lanes, then converted and
+// scaled as one SIMD vector.
+//
+// TPDFDither makes triangular noise of up to one LSB either way, added before rounding to an
+// integer so that the rounding error doesn't depend on the signal. It uses an xorshift
+// generator in each SIMD lane.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "MLDSPOps.h"
+
+namespace ml
+{
+enum class SampleFormat
+{
+  kFloat32,
+  kInt16,
+  kInt24,
+  kInt32
+};
+
+constexpr size_t getBytesPerSample(SampleFormat f)
+{
+  return (f == SampleFormat::kInt16) ? 2 : (f == SampleFormat::kInt24) ? 3 : 4;
+}
+
+class TPDFDither
+{
+ public:
+  explicit TPDFDither(uint32_t seed = 1) { setSeed(seed); }
+
+  void setSeed(uint32_t seed)
+  {
+    alignas(kBytesPerSIMDVector) uint32_t lanes[kFloatsPerSIMDVector];
+    uint32_t x = seed ? seed : 1;
+    for (int i = 0; i < kFloatsPerSIMDVector; ++i)
+    {
+      x = x * 1664525u + 1013904223u;
+      lanes[i] = x ? x : 1;
+    }
+    std::memcpy(&state_, lanes, sizeof(state_));
+  }
+
+  // the next SIMD vector of noise, from -1 to 1 LSB. Each lane's 32 bits are split into two
+  // uniform 16 bit values, whose difference has a triangular distribution.
+  inline SIMDVectorFloat next()
+  {
+    state_ = vecXorInt(state_, vecShiftLeftInt(state_, 13));
+    state_ = vecXorInt(state_, vecShiftRightInt(state_, 17));
+    state_ = vecXorInt(state_, vecShiftLeftInt(state_, 5));
+    const SIMDVectorFloat a = vecIntToFloat(vecAndInt(state_, vecSet1Int(0xFFFF)));
+    const SIMDVectorFloat b = vecIntToFloat(vecShiftRightInt(state_, 16));
+    return vecMul(vecSub(a, b), vecSet1(1.f / 65536.f));
+  }
+
+ private:
+  SIMDVectorInt state_;
+};
+
+namespace sampleFormats
+{
+template <SampleFormat F>
+constexpr float kFullScale = (F == SampleFormat::kInt16)   ? 32768.f
+                             : (F == SampleFormat::kInt24) ? 8388608.f
+                                                           : 2147483648.f;
+
+// the largest float that rounds to an integer in range. For 32 bits, float's precision makes
+// this 128 below the largest integer.
+template <SampleFormat F>
+constexpr float kMaxSample = (F == SampleFormat::kInt32) ? 2147483520.f : kFullScale<F> - 1.f;
+
+template <SampleFormat F>
+inline int32_t loadSample(const uint8_t* p)
+{
+  if constexpr (F == SampleFormat::kInt16)
+  {
+    int16_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+  }
+  else if constexpr (F == SampleFormat::kInt24)
+  {
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    return int32_t((uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8)) >> 8;
+#else
+    return int32_t((uint32_t(p[2]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[0]) << 8)) >> 8;
+#endif
+  }
+  else
+  {
+    int32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+  }
+}
+
+template <SampleFormat F>
+inline void storeSample(uint8_t* p, int32_t x)
+{
+  if constexpr (F == SampleFormat::kInt16)
+  {
+    const int16_t v = int16_t(x);
+    std::memcpy(p, &v, sizeof(v));
+  }
+  else if constexpr (F == SampleFormat::kInt24)
+  {
+    const uint32_t u = uint32_t(x);
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    p[0] = uint8_t(u >> 16);
+    p[1] = uint8_t(u >> 8);
+    p[2] = uint8_t(u);
+#else
+    p[0] = uint8_t(u);
+    p[1] = uint8_t(u >> 8);
+    p[2] = uint8_t(u >> 16);
+#endif
+  }
+  else
+  {
+    std::memcpy(p, &x, sizeof(x));
+  }
+}
+
+// convert one SIMD vector of samples to floats.
+template <SampleFormat F>
+inline SIMDVectorFloat loadVector(const uint8_t* pSrc)
+{
+  alignas(kBytesPerSIMDVector) int32_t lanes[kFloatsPerSIMDVector];
+  if constexpr (F == SampleFormat::kInt32)
+  {
+    std::memcpy(lanes, pSrc, sizeof(lanes));
+  }
+  else
+  {
+    for (int k = 0; k < kFloatsPerSIMDVector; ++k)
+    {
+      lanes[k] = loadSample<F>(pSrc + k * getBytesPerSample(F));
+    }
+  }
+  SIMDVectorInt v;
+  std::memcpy(&v, lanes, sizeof(v));
+  return vecMul(vecIntToFloat(v), vecSet1(1.f / kFullScale<F>));
+}
+
+// convert one SIMD vector of floats to samples, storing the first n.
+template <SampleFormat F>
+inline void storeVector(SIMDVectorFloat x, uint8_t* pDest, TPDFDither* dither,
+                        int n = kFloatsPerSIMDVector)
+{
+  x = vecMul(x, vecSet1(kFullScale<F>));
+  if (dither) x = vecAdd(x, dither->next());
+  x = vecClamp(x, vecSet1(-kFullScale<F>), vecSet1(kMaxSample<F>));
+
+  alignas(kBytesPerSIMDVector) int32_t lanes[kFloatsPerSIMDVector];
+  const SIMDVectorInt v = vecFloatToIntRound(x);
+  std::memcpy(lanes, &v, sizeof(lanes));
+  if constexpr (F == SampleFormat::kInt32)
+  {
+    std::memcpy(pDest, lanes, n * sizeof(int32_t));
+  }
+  else
+  {
+    for (int k = 0; k < n; ++k)
+    {
+      storeSample<F>(pDest + k * getBytesPerSample(F), lanes[k]);
+    }
+  }
+}
+
+template <SampleFormat F>
+inline void toFloats(const uint8_t* pSrc, float* pDest, size_t n)
+{
+  constexpr size_t kBytes = getBytesPerSample(F);
+  size_t i = 0;
+  for (; i + kFloatsPerSIMDVector <= n; i += kFloatsPerSIMDVector)
+  {
+    vecStoreUnaligned(pDest + i, loadVector<F>(pSrc + i * kBytes));
+  }
+
+  // the samples after the last whole SIMD vector.
+  if (i < n)
+  {
+    uint8_t tail[kFloatsPerSIMDVector * kBytes]{};
+    std::copy(pSrc + i * kBytes, pSrc + n * kBytes, tail);
+    alignas(kBytesPerSIMDVector) float y[kFloatsPerSIMDVector];
+    vecStore(y, loadVector<F>(tail));
+    std::copy(y, y + (n - i), pDest + i);
+  }
+}
+
+template <SampleFormat F>
+inline void fromFloats(const float* pSrc, uint8_t* pDest, size_t n, TPDFDither* dither)
+{
+  constexpr size_t kBytes = getBytesPerSample(F);
+  size_t i = 0;
+  for (; i + kFloatsPerSIMDVector <= n; i += kFloatsPerSIMDVector)
+  {
+    storeVector<F>(vecLoadUnaligned(pSrc + i), pDest + i * kBytes, dither);
+  }
+  if (i < n)
+  {
+    alignas(kBytesPerSIMDVector) float x[kFloatsPerSIMDVector]{};
+    std::copy(pSrc + i, pSrc + n, x);
+    storeVector<F>(vecLoad(x), pDest + i * kBytes, dither, int(n - i));
+  }
+}
+}  // namespace sampleFormats
+
+// convert n samples in the given format to floats.
+inline void convertToFloats(const void* pSrc, SampleFormat format, float* pDest, size_t n)
+{
+  const uint8_t* p = static_cast<const uint8_t*>(pSrc);
+  switch (format)
+  {
+    case SampleFormat::kFloat32:
+      std::memcpy(pDest, pSrc, n * sizeof(float));
+      break;
+    case SampleFormat::kInt16:
+      sampleFormats::toFloats<SampleFormat::kInt16>(p, pDest, n);
+      break;
+    case SampleFormat::kInt24:
+      sampleFormats::toFloats<SampleFormat::kInt24>(p, pDest, n);
+      break;
+    case SampleFormat::kInt32:
+      sampleFormats::toFloats<SampleFormat::kInt32>(p, pDest, n);
+      break;
+  }
+}
+
+// convert n floats to samples in the given format. If a dither is given, integer samples are
+// dithered.
+inline void convertFromFloats(const float* pSrc, SampleFormat format, void* pDest, size_t n,
+                              TPDFDither* dither = nullptr)
+{
+  uint8_t* p = static_cast<uint8_t*>(pDest);
+  switch (format)
+  {
+    case SampleFormat::kFloat32:
+      std::memcpy(pDest, pSrc, n * sizeof(float));
+      break;
+    case SampleFormat::kInt16:
+      sampleFormats::fromFloats<SampleFormat::kInt16>(pSrc, p, n, dither);
+      break;
+    case SampleFormat::kInt24:
+      sampleFormats::fromFloats<SampleFormat::kInt24>(pSrc, p, n, dither);
+      break;
+    case SampleFormat::kInt32:
+      sampleFormats::fromFloats<SampleFormat::kInt32>(pSrc, p, n, dither);
+      break;
+  }
+}
+
+// convert frames of samples to separate float buffers for each channel. If interleaved, the
+// samples of each frame are together, otherwise each channel's frames follow the last
+// channel's. Interleaved integers are converted to floats in scratch, which must have room for
+// channels * frames floats, and then deinterleaved.
+inline void convertToPlanarFloats(const void* pSrc, SampleFormat format, bool interleaved,
+                                  float* const* pDest, size_t channels, size_t frames,
+                                  float* scratch)
+{
+  const uint8_t* p = static_cast<const uint8_t*>(pSrc);
+  if (!interleaved)
+  {
+    for (size_t c = 0; c < channels; ++c)
+    {
+      convertToFloats(p + c * frames * getBytesPerSample(format), format, pDest[c], frames);
+    }
+  }
+  else if (format == SampleFormat::kFloat32)
+  {
+    deinterleave(static_cast<const float*>(pSrc), pDest, channels, frames);
+  }
+  else
+  {
+    convertToFloats(pSrc, format, scratch, channels * frames);
+    deinterleave(scratch, pDest, channels, frames);
+  }
+}
+
+// the inverse of convertToPlanarFloats(), with dither for integers if a dither is given.
+inline void convertFromPlanarFloats(const float* const* pSrc, SampleFormat format,
+                                    bool interleaved, void* pDest, size_t channels, size_t frames,
+                                    float* scratch, TPDFDither* dither = nullptr)
+{
+  uint8_t* p = static_cast<uint8_t*>(pDest);
+  if (!interleaved)
+  {
+    for (size_t c = 0; c < channels; ++c)
+    {
+      convertFromFloats(pSrc[c], format, p + c * frames * getBytesPerSample(format), frames,
+                        dither);
+    }
+  }
+  else if (format == SampleFormat::kFloat32)
+  {
+    interleave(pSrc, static_cast<float*>(pDest), channels, frames);
+  }
+  else
+  {
+    interleave(pSrc, scratch, channels, frames);
+    convertFromFloats(scratch, format, pDest, channels * frames, dither);
+  }
+}
+
+}  // namespace ml
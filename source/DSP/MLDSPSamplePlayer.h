@@ -0,0 +1,269 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// MLDSPSamplePlayer.h
+// Play a Sample at a rate that can change every sample.
+//
+// Each call takes a DSPVector of increments, the frames to advance after each output, and makes
+// a DSPVector for each of CHANNELS output channels. The positions are worked out one sample at
+// a time, then the frames around them are read with gathered loads and interpolated
+// kFloatsPerSIMDVector outputs at a time. Every channel of an interleaved sample is read the
+// same way, with its own offset into the frames. Output channels past those of the sample
+// repeat them, so a mono sample plays on all the outputs.
+//
+// Interpolation is linear, cubic (Hermite) or windowed sinc using the polyphase tables of
+// ResamplerKernel. For interpolation the sample is extended past its ends by its first and last
+// frames, and outside the sample the output is silent.
+//
+// A loop plays forwards from its start to its end and back again, once the position reaches it.
+// With a crossfade, the frames before the end of the loop are mixed with those before its
+// start, and the loop start must be at least the crossfade length from the start of the sample.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <memory>
+
+#include "MLDSPOps.h"
+#include "MLDSPResampler.h"
+#include "MLDSPSample.h"
+
+namespace ml
+{
+template <size_t CHANNELS = 1>
+class SamplePlayer
+{
+ public:
+  enum class Interpolation
+  {
+    kLinear,
+    kCubic,
+    kSinc
+  };
+
+  // make a player using the given interpolation. For sinc interpolation the filter cutoff is
+  // lowered to remove aliasing at increments up to maxIncrement.
+  explicit SamplePlayer(Interpolation interp = Interpolation::kCubic, float maxIncrement = 1.f)
+      : interpolation_(interp)
+  {
+    if (interp == Interpolation::kSinc)
+    {
+      kernel_ = ResamplerKernel::get(ResamplerKernel::Quality::kMedium,
+                                     1.f / std::max(maxIncrement, 1.f));
+    }
+  }
+
+  // play frames from the sample, which must stay valid while it is played. The position is
+  // moved to the start and any loop is cleared.
+  void setSample(const Sample* pSample)
+  {
+    sample_ = usable(pSample) ? pSample : nullptr;
+    frames_ = sample_ ? getFrames(*sample_) : 0;
+    stride_ = sample_ ? int32_t(sample_->channels) : 1;
+    for (size_t c = 0; c < CHANNELS; ++c)
+    {
+      channelOffset_[c] = int32_t(c % size_t(stride_));
+    }
+    clearLoop();
+    position_ = 0.;
+  }
+
+  // loop the frames [start, end) with a crossfade of the given length. The crossfade is
+  // shortened if needed to fit in the loop and before its start.
+  void setLoop(size_t start, size_t end, size_t crossfade = 0)
+  {
+    end = std::min(end, frames_);
+    if (end <= start)
+    {
+      clearLoop();
+      return;
+    }
+    loopStart_ = start;
+    loopEnd_ = end;
+    crossfade_ = std::min({crossfade, end - start, start});
+  }
+
+  void clearLoop() { loopStart_ = loopEnd_ = crossfade_ = 0; }
+  bool isLooping() const { return loopEnd_ > loopStart_; }
+
+  void setPosition(double frame) { position_ = frame; }
+  double getPosition() const { return position_; }
+
+  // true until a sample that is not looping has played past its end.
+  bool isPlaying() const
+  {
+    return sample_ && ((position_ < frames_) || (isLooping() && (position_ >= loopStart_)));
+  }
+
+  DSPVectorArray<CHANNELS> operator()(const DSPVector& increments)
+  {
+    DSPVectorArray<CHANNELS> y;
+    if (!sample_) return y;
+
+    // find each output's position. The frame is stored as an index into the interleaved data.
+    const double loopLength = double(loopEnd_ - loopStart_);
+    const double fadeStart = double(loopEnd_ - crossfade_);
+    const float fadeScale = crossfade_ ? 1.f / crossfade_ : 0.f;
+    bool fading{false};
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      double p = position_;
+      if (isLooping() && (p >= loopEnd_))
+      {
+        p = loopStart_ + std::fmod(p - loopStart_, loopLength);
+      }
+
+      // outside the sample the output is silent, so the frame only needs to stay in range.
+      double pc = clamp(p, -1., double(frames_));
+      double ip = std::floor(pc);
+      index_[n] = int32_t(ip) * stride_;
+      frac_[n] = float(pc - ip);
+      gain_[n] = ((p >= 0.) && (p < frames_)) ? 1.f : 0.f;
+      fade_[n] = (crossfade_ && (p >= fadeStart)) ? float((p - fadeStart) * fadeScale) : 0.f;
+      fading |= (fade_[n] > 0.f);
+      position_ = p + increments[n];
+    }
+
+    // crossfade reads are one loop length before the position.
+    const int32_t fadeOffset = -int32_t(loopEnd_ - loopStart_) * stride_;
+    for (size_t c = 0; c < CHANNELS; ++c)
+    {
+      const float* pData = sample_->sampleData.data() + channelOffset_[c];
+      float* pOut = y.row(c).getBuffer();
+      readRow(pData, 0, pOut);
+      if (fading)
+      {
+        DSPVector b;
+        readRow(pData, fadeOffset, b.getBuffer());
+        y.row(c) = lerp(y.row(c), b, fade_);
+      }
+      y.row(c) = y.row(c) * gain_;
+    }
+    return y;
+  }
+
+ private:
+  // read one channel at the positions, offset by a number of elements of the interleaved data.
+  void readRow(const float* pData, int32_t offset, float* pDest) const
+  {
+    switch (interpolation_)
+    {
+      case Interpolation::kLinear:
+        readPolynomial<false>(pData, offset, pDest);
+        break;
+      case Interpolation::kCubic:
+        readPolynomial<true>(pData, offset, pDest);
+        break;
+      case Interpolation::kSinc:
+        readSinc(pData, offset, pDest);
+        break;
+    }
+  }
+
+  template <bool kCubic>
+  void readPolynomial(const float* pData, int32_t offset, float* pDest) const
+  {
+    const SIMDVectorInt vStride = vecSetInt1(uint32_t(stride_));
+    const SIMDVectorInt vZero = vecSetInt1(0);
+    const SIMDVectorInt vLast = vecSetInt1(uint32_t((int32_t(frames_) - 1) * stride_));
+    const SIMDVectorInt vOffset = vecSetInt1(uint32_t(offset));
+    auto tap = [&](SIMDVectorInt i) {
+      return vecGather(pData, vecMinInt(vecMaxInt(i, vZero), vLast));
+    };
+
+    const float* pIndex = index_.getConstBuffer();
+    const float* pFrac = frac_.getConstBuffer();
+    for (int n = 0; n < kSIMDVectorsPerDSPVector; ++n)
+    {
+      SIMDVectorInt i0 = vecAddInt(VecF2I(vecLoad(pIndex)), vOffset);
+      SIMDVectorInt i1 = vecAddInt(i0, vStride);
+      SIMDVectorFloat t = vecLoad(pFrac);
+      SIMDVectorFloat x0 = tap(i0);
+      SIMDVectorFloat x1 = tap(i1);
+      SIMDVectorFloat r;
+
+      if (kCubic)
+      {
+        SIMDVectorFloat xm1 = tap(vecSubInt(i0, vStride));
+        SIMDVectorFloat x2 = tap(vecAddInt(i1, vStride));
+        const SIMDVectorFloat kHalf = vecSet1(0.5f);
+        SIMDVectorFloat c1 = vecMul(kHalf, vecSub(x1, xm1));
+        SIMDVectorFloat c2 = vecSub(vecAdd(xm1, vecAdd(x1, x1)),
+                                    vecAdd(vecMul(vecSet1(2.5f), x0), vecMul(kHalf, x2)));
+        SIMDVectorFloat c3 = vecAdd(vecMul(kHalf, vecSub(x2, xm1)),
+                                    vecMul(vecSet1(1.5f), vecSub(x0, x1)));
+        r = vecAdd(vecMul(vecAdd(vecMul(vecAdd(vecMul(c3, t), c2), t), c1), t), x0);
+      }
+      else
+      {
+        r = vecAdd(x0, vecMul(t, vecSub(x1, x0)));
+      }
+
+      vecStore(pDest, r);
+      pIndex += kFloatsPerSIMDVector;
+      pFrac += kFloatsPerSIMDVector;
+      pDest += kFloatsPerSIMDVector;
+    }
+  }
+
+  // each output is the sum of the kernel's taps for its fractional position times the frames
+  // around it, kFloatsPerSIMDVector taps at a time.
+  void readSinc(const float* pData, int32_t offset, float* pDest) const
+  {
+    const int taps = kernel_->getTaps();
+    const int32_t firstTap = -(taps / 2 - 1);
+    const SIMDVectorInt vZero = vecSetInt1(0);
+    const SIMDVectorInt vLast = vecSetInt1(uint32_t((int32_t(frames_) - 1) * stride_));
+    const SIMDVectorInt vStep = vecSetInt1(uint32_t(kFloatsPerSIMDVector * stride_));
+    SIMDVectorIntUnion lanes;
+    for (int j = 0; j < kIntsPerSIMDVector; ++j)
+    {
+      lanes.i[j] = uint32_t((firstTap + j) * stride_ + offset);
+    }
+
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      float u = frac_[n] * ResamplerKernel::kPhases;
+      int p = std::min(static_cast<int>(u), ResamplerKernel::kPhases - 1);
+      SIMDVectorFloat vFrac = vecSet1(u - p);
+      const float* pRow = kernel_->getRow(p);
+      const float* pDelta = kernel_->getDelta(p);
+
+      SIMDVectorInt vi = vecAddInt(vecSetInt1(uint32_t(index_[n])), lanes.v);
+      SIMDVectorFloat sum = vecZeros();
+      for (int j = 0; j < taps; j += kFloatsPerSIMDVector)
+      {
+        SIMDVectorFloat x = vecGather(pData, vecMinInt(vecMaxInt(vi, vZero), vLast));
+        SIMDVectorFloat row = vecLoadUnaligned(pRow + j);
+        SIMDVectorFloat k = vecAdd(row, vecMul(vFrac, vecLoadUnaligned(pDelta + j)));
+        sum = vecAdd(sum, vecMul(k, x));
+        vi = vecAddInt(vi, vStep);
+      }
+      pDest[n] = vecSumH(sum);
+    }
+  }
+
+  Interpolation interpolation_;
+  std::shared_ptr<const ResamplerKernel> kernel_;
+
+  const Sample* sample_{nullptr};
+  size_t frames_{0};
+  int32_t stride_{1};
+  std::array<int32_t, CHANNELS> channelOffset_{};
+
+  size_t loopStart_{0};
+  size_t loopEnd_{0};
+  size_t crossfade_{0};
+  double position_{0.};
+
+  // the per-sample positions of the current vector.
+  DSPVectorInt index_;
+  DSPVector frac_;
+  DSPVector gain_;
+  DSPVector fade_;
+};
+
+}  // namespace ml
@@ -0,0 +1,228 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// MLDSPSampleStorage.h
+// Types for storing samples in less memory than floats, and conversions to and from them.
+//
+// Float16 is IEEE half precision: 11 bits of precision, for about 66 dB of signal to noise, and
+// a range up to 65504. BFloat16 keeps the range of float with 8 bits of precision. Either halves
+// the memory and bandwidth used by long delay lines where the precision is acceptable.
+//
+// SampleStorage<T> converts buffers of samples to and from floats. For Float16 this uses the
+// F16C instructions when the build targets them (-mf16c, or -march with AVX2), and the
+// conversion instructions of ARM64. Otherwise it is done with integer math.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "MLDSPOps.h"
+
+#if defined(__F16C__) && !defined(ML_SSE_TO_NEON)
+#include <immintrin.h>
+#define ML_F16C 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define ML_NEON_FP16 1
+#endif
+
+namespace ml
+{
+struct Float16
+{
+  uint16_t bits{0};
+};
+
+struct BFloat16
+{
+  uint16_t bits{0};
+};
+
+// ----------------------------------------------------------------
+// scalar conversions, rounding to the nearest value.
+
+namespace sampleStorage
+{
+inline uint32_t floatBits(float f)
+{
+  uint32_t u;
+  std::memcpy(&u, &f, sizeof(u));
+  return u;
+}
+
+inline float bitsToFloat(uint32_t u)
+{
+  float f;
+  std::memcpy(&f, &u, sizeof(f));
+  return f;
+}
+}  // namespace sampleStorage
+
+// after "float_to_half_fast3_rtne" by Fabian Giesen. Values too large for half precision become
+// infinities, and NaNs stay NaNs.
+inline Float16 floatToFloat16(float f)
+{
+  using namespace sampleStorage;
+  constexpr uint32_t kInfinity = 255u << 23;
+  constexpr uint32_t kHalfMax = (127u + 16u) << 23;
+  constexpr uint32_t kDenormMagic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+
+  uint32_t u = floatBits(f);
+  const uint32_t sign = u & 0x80000000u;
+  u ^= sign;
+
+  uint32_t h;
+  if (u >= kHalfMax)
+  {
+    h = (u > kInfinity) ? 0x7E00u : 0x7C00u;
+  }
+  else if (u < (113u << 23))
+  {
+    // the result is a half denormal: let float addition do the rounding.
+    h = floatBits(bitsToFloat(u) + bitsToFloat(kDenormMagic)) - kDenormMagic;
+  }
+  else
+  {
+    const uint32_t mantissaOdd = (u >> 13) & 1u;
+    u += ((15u - 127u) << 23) + 0xFFFu + mantissaOdd;
+    h = u >> 13;
+  }
+  return Float16{uint16_t(h | (sign >> 16))};
+}
+
+inline float float16ToFloat(Float16 x)
+{
+  using namespace sampleStorage;
+  constexpr uint32_t kShiftedExp = 0x7C00u << 13;
+  const uint32_t h = x.bits;
+
+  uint32_t u = (h & 0x7FFFu) << 13;
+  const uint32_t exp = u & kShiftedExp;
+  u += (127u - 15u) << 23;
+  if (exp == kShiftedExp)
+  {
+    // infinity or NaN
+    u += (128u - 16u) << 23;
+  }
+  else if (exp == 0)
+  {
+    // zero or denormal: renormalize with float subtraction.
+    u = floatBits(bitsToFloat(u + (1u << 23)) - bitsToFloat(113u << 23));
+  }
+  return bitsToFloat(u | ((h & 0x8000u) << 16));
+}
+
+inline BFloat16 floatToBFloat16(float f)
+{
+  const uint32_t u = sampleStorage::floatBits(f);
+  if ((u & 0x7FFFFFFFu) > 0x7F800000u)
+  {
+    return BFloat16{uint16_t((u >> 16) | 0x40u)};
+  }
+  return BFloat16{uint16_t((u + 0x7FFFu + ((u >> 16) & 1u)) >> 16)};
+}
+
+inline float bFloat16ToFloat(BFloat16 x)
+{
+  return sampleStorage::bitsToFloat(uint32_t(x.bits) << 16);
+}
+
+// ----------------------------------------------------------------
+// SampleStorage<T>: conversions between floats and samples stored as T.
+
+template <class T>
+struct SampleStorage;
+
+template <>
+struct SampleStorage<float>
+{
+  static float fromFloat(float x) { return x; }
+  static float toFloat(float x) { return x; }
+  static void fromFloats(const float* pSrc, float* pDest, size_t n)
+  {
+    std::copy(pSrc, pSrc + n, pDest);
+  }
+  static void toFloats(const float* pSrc, float* pDest, size_t n)
+  {
+    std::copy(pSrc, pSrc + n, pDest);
+  }
+};
+
+template <>
+struct SampleStorage<Float16>
+{
+  static Float16 fromFloat(float x) { return floatToFloat16(x); }
+  static float toFloat(Float16 x) { return float16ToFloat(x); }
+
+  static void fromFloats(const float* pSrc, Float16* pDest, size_t n)
+  {
+    size_t i = 0;
+#if ML_F16C
+    for (; i + 4 <= n; i += 4)
+    {
+      __m128i h = _mm_cvtps_ph(_mm_loadu_ps(pSrc + i), _MM_FROUND_TO_NEAREST_INT);
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(pDest + i), h);
+    }
+#elif ML_NEON_FP16
+    for (; i + 4 <= n; i += 4)
+    {
+      float16x4_t h = vcvt_f16_f32(vld1q_f32(pSrc + i));
+      vst1_u16(reinterpret_cast<uint16_t*>(pDest + i), vreinterpret_u16_f16(h));
+    }
+#endif
+    for (; i < n; ++i)
+    {
+      pDest[i] = floatToFloat16(pSrc[i]);
+    }
+  }
+
+  static void toFloats(const Float16* pSrc, float* pDest, size_t n)
+  {
+    size_t i = 0;
+#if ML_F16C
+    for (; i + 4 <= n; i += 4)
+    {
+      __m128i h = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(pSrc + i));
+      _mm_storeu_ps(pDest + i, _mm_cvtph_ps(h));
+    }
+#elif ML_NEON_FP16
+    for (; i + 4 <= n; i += 4)
+    {
+      float16x4_t h = vreinterpret_f16_u16(vld1_u16(reinterpret_cast<const uint16_t*>(pSrc + i)));
+      vst1q_f32(pDest + i, vcvt_f32_f16(h));
+    }
+#endif
+    for (; i < n; ++i)
+    {
+      pDest[i] = float16ToFloat(pSrc[i]);
+    }
+  }
+};
+
+// BFloat16 conversions are integer shifts and adds, which compilers vectorize.
+template <>
+struct SampleStorage<BFloat16>
+{
+  static BFloat16 fromFloat(float x) { return floatToBFloat16(x); }
+  static float toFloat(BFloat16 x) { return bFloat16ToFloat(x); }
+  static void fromFloats(const float* pSrc, BFloat16* pDest, size_t n)
+  {
+    for (size_t i = 0; i < n; ++i)
+    {
+      pDest[i] = floatToBFloat16(pSrc[i]);
+    }
+  }
+  static void toFloats(const BFloat16* pSrc, float* pDest, size_t n)
+  {
+    for (size_t i = 0; i < n; ++i)
+    {
+      pDest[i] = bFloat16ToFloat(pSrc[i]);
+    }
+  }
+};
+
+}  // namespace ml
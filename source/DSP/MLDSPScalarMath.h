@@ -214,158 +214,183 @@ class RandomScalarSource
 
 namespace const_math
 {
-/*
- C++11 constexpr versions of cmath functions needed for the FFT.
- Copyright Paul Keir 2012-2016
- Distributed under the Boost Software License, Version 1.0.
- (See accompanying file license.txt or copy at http://boost.org/LICENSE_1_0.txt)
- */
+// constexpr versions of cmath functions, for making tables and constants at compile time.
+// Arguments are reduced to small ranges and series are summed until they converge, so results
+// are within a few units in the last place of the double precision cmath functions. They are
+// much slower than those, and are not meant for use at run time.
 
-constexpr double tol = 0.001;
+constexpr double kPiDouble{3.14159265358979323846};
+constexpr double kLn2Double{0.69314718055994530942};
+constexpr double kSqrt3Double{1.73205080756887729353};
 
 constexpr double abs(const double x) { return x < 0.0 ? -x : x; }
 
 constexpr double square(const double x) { return x * x; }
 
-constexpr double sqrt_helper(const double x, const double g)
-{
-  return abs(g - x / g) < tol ? g : sqrt_helper(x, (g + x / g) / 2.0);
-}
-
-constexpr double sqrt(const double x) { return sqrt_helper(x, 1.0); }
-
 constexpr double cube(const double x) { return x * x * x; }
 
-// Based on the triple-angle formula: sin 3x = 3 sin x - 4 sin ^3 x
-constexpr double sin_helper(const double x)
-{
-  return x < tol ? x : 3 * (sin_helper(x / 3.0)) - 4 * cube(sin_helper(x / 3.0));
-}
-
-constexpr double sin(const double x) { return sin_helper(x < 0 ? -x + kPi : x); }
-
-// sinh 3x = 3 sinh x + 4 sinh ^3 x
-constexpr double sinh_helper(const double x)
+constexpr double floor(const double x)
 {
-  return x < tol ? x : 3 * (sinh_helper(x / 3.0)) + 4 * cube(sinh_helper(x / 3.0));
+  const double t = static_cast<double>(static_cast<int64_t>(x));
+  return t > x ? t - 1.0 : t;
 }
 
-// sinh 3x = 3 sinh x + 4 sinh ^3 x
-constexpr double sinh(const double x) { return x < 0 ? -sinh_helper(-x) : sinh_helper(x); }
-
-constexpr double cos(const double x) { return sin(kPi * 0.5 - x); }
+constexpr double nearest(const double x) { return floor(x + 0.5); }
 
-constexpr double cosh(const double x) { return sqrt(1.0 + square(sinh(x))); }
+constexpr double fraction(const double x) { return x - nearest(x); }
 
-constexpr double pow(double base, int exponent)
+// Newton's method, starting above the root so that each step decreases until converged.
+constexpr double sqrt(const double x)
 {
-  return exponent < 0    ? 1.0 / pow(base, -exponent)
-         : exponent == 0 ? 1.
-         : exponent == 1 ? base
-                         : base * pow(base, exponent - 1);
+  if (x < 0.0) return std::numeric_limits<double>::quiet_NaN();
+  if (x == 0.0) return 0.0;
+  double g = x > 1.0 ? x : 1.0;
+  for (int i = 0; i < 2048; ++i)
+  {
+    const double next = 0.5 * (g + x / g);
+    if (next >= g) break;
+    g = next;
+  }
+  return g;
 }
 
-// atan formulae from http://mathonweb.com/algebra_e-book.htm
-// x - x^3/3 + x^5/5 - x^7/7+x^9/9  etc.
-constexpr double atan_poly_helper(const double res, const double num1, const double den1,
-                                  const double delta)
+constexpr double pow(double base, int exponent)
 {
-  return res < tol ? res
-                   : res + atan_poly_helper((num1 * delta) / (den1 + 2.) - num1 / den1,
-                                            num1 * delta * delta, den1 + 4., delta);
+  if (exponent < 0) return 1.0 / pow(base, -exponent);
+  double r{1.0};
+  for (; exponent > 0; exponent >>= 1)
+  {
+    if (exponent & 1) r *= base;
+    base *= base;
+  }
+  return r;
 }
 
-constexpr double atan_poly(const double x)
+// sum the Taylor series after reducing x to [-pi/2, pi/2].
+constexpr double sin(const double x)
 {
-  return x + atan_poly_helper(pow(x, 5) / 5. - pow(x, 3) / 3., pow(x, 7), 7., x * x);
+  double r = x - 2.0 * kPiDouble * nearest(x / (2.0 * kPiDouble));
+  if (r > kPiDouble * 0.5) r = kPiDouble - r;
+  if (r < -kPiDouble * 0.5) r = -kPiDouble - r;
+  double term{r}, sum{r};
+  for (int n = 1; n < 32; ++n)
+  {
+    term *= -r * r / ((2.0 * n) * (2.0 * n + 1.0));
+    if (sum + term == sum) break;
+    sum += term;
+  }
+  return sum;
 }
 
-// Define an M_PI_6? Define a root 3?
-constexpr double atan_identity(const double x)
-{
-  return x <= (2. - sqrt(3.)) ? atan_poly(x)
-                              : (kTwoPi / 3.) + atan_poly((sqrt(3.) * x - 1) / (sqrt(3.) + x));
-}
+constexpr double cos(const double x) { return sin(kPiDouble * 0.5 - x); }
 
-constexpr double atan_cmplmntry(const double x)
+// exp(x) = 2^n e^r, with |r| <= ln(2) / 2.
+constexpr double exp(const double x)
 {
-  return (x < 1) ? atan_identity(x) : kTwoPi - atan_identity(1 / x);
+  if (x > 709.8) return std::numeric_limits<double>::infinity();
+  if (x < -745.2) return 0.0;
+  const int n = static_cast<int>(nearest(x / kLn2Double));
+  const double r = x - n * kLn2Double;
+  double term{1.0}, sum{1.0};
+  for (int k = 1; k < 32; ++k)
+  {
+    term *= r / k;
+    if (sum + term == sum) break;
+    sum += term;
+  }
+  // scale in two steps so that 2^n itself does not overflow or underflow at the ends.
+  return sum * pow(2.0, n / 2) * pow(2.0, n - n / 2);
 }
 
-constexpr double atan(const double x) { return (x >= 0) ? atan_cmplmntry(x) : -atan_cmplmntry(-x); }
-
-constexpr double atan2(const double y, const double x)
+// log(x) = e ln(2) + log(m), with m on [sqrt(1/2), sqrt(2)], and
+// log(m) = 2 atanh((m - 1) / (m + 1)).
+constexpr double log(const double x)
 {
-  return x > 0             ? atan(y / x)
-         : y >= 0 && x < 0 ? atan(y / x) + kPi
-         : y < 0 && x < 0  ? atan(y / x) - kPi
-         : y > 0 && x == 0 ? kTwoPi
-         : y < 0 && x == 0 ? -kTwoPi
-                           : 0;  // 0 == undefined
+  if (x < 0.0) return std::numeric_limits<double>::quiet_NaN();
+  if (x == 0.0) return -std::numeric_limits<double>::infinity();
+  double m{x};
+  int e{0};
+  while (m >= 2.0)
+  {
+    m *= 0.5;
+    e++;
+  }
+  while (m < 1.0)
+  {
+    m *= 2.0;
+    e--;
+  }
+  if (m > 1.41421356237309504880)
+  {
+    m *= 0.5;
+    e++;
+  }
+  const double y = (m - 1.0) / (m + 1.0);
+  double term{y}, sum{y};
+  for (int k = 3; k < 64; k += 2)
+  {
+    term *= y * y;
+    const double next = sum + term / k;
+    if (next == sum) break;
+    sum = next;
+  }
+  return 2.0 * sum + e * kLn2Double;
 }
 
-constexpr double nearest(double x) { return (x - 0.5) > (int)x ? (int)(x + 0.5) : (int)x; }
+constexpr double pow(double base, double exponent) { return exp(exponent * log(base)); }
 
-constexpr double fraction(double x)
+constexpr double sinh(const double x)
 {
-  return (x - 0.5) > (int)x ? -(((double)(int)(x + 0.5)) - x) : x - ((double)(int)(x));
-}
-
-constexpr double exp_helper(const double r)
-{
-  return 1.0 + r + pow(r, 2) / 2.0 + pow(r, 3) / 6.0 + pow(r, 4) / 24.0 + pow(r, 5) / 120.0 +
-         pow(r, 6) / 720.0 + pow(r, 7) / 5040.0;
+  if (abs(x) < 0.5)
+  {
+    double term{x}, sum{x};
+    for (int n = 1; n < 16; ++n)
+    {
+      term *= x * x / ((2.0 * n) * (2.0 * n + 1.0));
+      if (sum + term == sum) break;
+      sum += term;
+    }
+    return sum;
+  }
+  return 0.5 * (exp(x) - exp(-x));
 }
 
-// exp(x) = e^n . e^r (where n is an integer, and -0.5 > r < 0.5
-// exp(r) = e^r = 1 + r + r^2/2 + r^3/6 + r^4/24 + r^5/120
-constexpr double exp(const double x) { return pow(kE, (int)nearest(x)) * exp_helper(fraction(x)); }
+constexpr double cosh(const double x) { return 0.5 * (exp(x) + exp(-x)); }
 
-constexpr double mantissa(const double x)
+constexpr double tanh(const double x)
 {
-  return x >= 10.0 ? mantissa(x * 0.1) : x < 1.0 ? mantissa(x * 10.0) : x;
+  if (x > 20.0) return 1.0;
+  if (x < -20.0) return -1.0;
+  return sinh(x) / cosh(x);
 }
 
-// log(m) = log(sqrt(m)^2) = 2 x log( sqrt(m) )
-// log(x) = log(m x 10^p) = 0.86858896 ln( sqrt(m) ) + p
-constexpr int exponent_helper(const double x, const int e)
+// atan(x) = pi/2 - atan(1/x), and atan(x) = pi/6 + atan((sqrt(3) x - 1) / (sqrt(3) + x)),
+// reduce x to below 2 - sqrt(3), where the series converges quickly.
+constexpr double atan(const double x)
 {
-  return x >= 10.0 ? exponent_helper(x * 0.1, e + 1)
-         : x < 1.0 ? exponent_helper(x * 10.0, e - 1)
-                   : e;
-}
-
-constexpr int exponent(const double x) { return exponent_helper(x, 0); }
-
-constexpr double log_helper2(const double y)
-{
-  return 2.0 * (y + pow(y, 3) / 3.0 + pow(y, 5) / 5.0 + pow(y, 7) / 7.0 + pow(y, 9) / 9.0 +
-                pow(y, 11) / 11.0);
-}
-
-// log in the range 1-sqrt(10)
-constexpr double log_helper(const double x) { return log_helper2((x - 1.0) / (x + 1.0)); }
-
-inline constexpr double bit_cast_to_double(uint64_t bits) {
-  union { uint64_t u; double d; } converter = {bits};
-  return converter.d;
+  if (x < 0.0) return -atan(-x);
+  if (x > 1.0) return kPiDouble * 0.5 - atan(1.0 / x);
+  if (x > 2.0 - kSqrt3Double)
+    return kPiDouble / 6.0 + atan((kSqrt3Double * x - 1.0) / (kSqrt3Double + x));
+  double term{x}, sum{x};
+  for (int k = 3; k < 64; k += 2)
+  {
+    term *= -x * x;
+    const double next = sum + term / k;
+    if (next == sum) break;
+    sum = next;
+  }
+  return sum;
 }
 
-// n.b. log 10 is 2.3025851
-// n.b. log m = log (sqrt(m)^2) = 2 * log sqrt(m)
-constexpr double log(const double x)
+constexpr double atan2(const double y, const double x)
 {
-  if (x == 0) {
-    // Create -infinity through bit pattern
-    constexpr uint64_t neg_inf_bits = 0xFFF0000000000000ULL;
-    return bit_cast_to_double(neg_inf_bits);
-  }
-  if (x < 0) {
-    // Create quiet NaN through bit pattern
-    constexpr uint64_t qnan_bits = 0x7FF8000000000000ULL;
-    return bit_cast_to_double(qnan_bits);
-  }
-  return 2.0 * log_helper(sqrt(mantissa(x))) + 2.3025851 * exponent(x);
+  return x > 0             ? atan(y / x)
+         : y >= 0 && x < 0 ? atan(y / x) + kPiDouble
+         : y < 0 && x < 0  ? atan(y / x) - kPiDouble
+         : y > 0 && x == 0 ? kPiDouble * 0.5
+         : y < 0 && x == 0 ? -kPiDouble * 0.5
+                           : 0;  // 0 == undefined
 }
 
 }  // namespace const_math
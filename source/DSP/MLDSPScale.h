@@ -15,6 +15,7 @@
 #include <cctype>
 #include <locale>
 
+#include "MLDSPOps.h"
 #include "MLDSPScalarMath.h"
 
 namespace ml
@@ -128,7 +129,7 @@ class Scale
     if (ml::isNaN(note)) return 0.f;
 
     float fn = ml::clamp(note, 0.f, (float)(kMLNumNotes - 1));
-    int i = (int)fn;
+    int i = std::min((int)fn, kMLNumNotes - 2);
     double intPart = (double)i;
     double fracPart = fn - intPart;
 
@@ -485,4 +486,74 @@ class Scale
   std::array<double, kMLNumNotes> pitches_;
 };
 
+// ScaleTable: a Scale compiled into a dense table of log pitches, for mapping many notes at
+// once. The table holds the pitch at kStepsPerNote fractions of each note, and pitches between
+// them are interpolated linearly, which matches Scale::noteToLogPitch() to well within a cent.
+//
+// A ScaleTable has a fixed size and doesn't allocate, so it can be copied into a
+// TripleBuffer<ScaleTable> to retune voices running on another thread: the writer sets and
+// publishes a table, and the audio thread takes the newest one with update() before each vector.
+
+class ScaleTable
+{
+ public:
+  static constexpr int kStepsPerNote{16};
+  static constexpr int kSize{(kMLNumNotes - 1) * kStepsPerNote + 1};
+
+  ScaleTable() : ScaleTable(Scale()) {}
+  explicit ScaleTable(const Scale& scale) { set(scale); }
+
+  void set(const Scale& scale)
+  {
+    for (int k = 0; k < kSize; ++k)
+    {
+      table_[k] = scale.noteToLogPitch(k / float(kStepsPerNote));
+    }
+
+    // a guard point, so that the highest note can be interpolated.
+    table_[kSize] = table_[kSize - 1];
+  }
+
+  // return the pitch of the given fractional note as log2(p/k), where k = 440Hz.
+  float noteToLogPitch(float note) const
+  {
+    if (ml::isNaN(note)) return 0.f;
+    float u = ml::clamp(note * kStepsPerNote, 0.f, float(kSize - 1));
+    int i = int(u);
+    return ml::lerp(table_[i], table_[i + 1], u - i);
+  }
+
+  // map a vector of notes to log pitches.
+  DSPVector noteToLogPitch(const DSPVector& notes) const
+  {
+    DSPVector y;
+    const float* px = notes.getConstBuffer();
+    float* py = y.getBuffer();
+    const float* pTable = table_.data();
+    const SIMDVectorFloat vSteps = vecSet1(float(kStepsPerNote));
+    const SIMDVectorFloat vZero = vecZeros();
+    const SIMDVectorFloat vMax = vecSet1(float(kSize - 1));
+    const SIMDVectorInt vOne = vecSetInt1(1);
+    for (int n = 0; n < kSIMDVectorsPerDSPVector; ++n)
+    {
+      SIMDVectorFloat x = vecLoad(px);
+      SIMDVectorFloat u = vecClamp(vecMul(x, vSteps), vZero, vMax);
+      SIMDVectorInt i = vecFloatToIntTruncate(u);
+      SIMDVectorFloat t = vecSub(u, vecIntToFloat(i));
+      SIMDVectorFloat a = vecGather(pTable, i);
+      SIMDVectorFloat b = vecGather(pTable, vecAddInt(i, vOne));
+      SIMDVectorFloat r = vecAdd(a, vecMul(t, vecSub(b, a)));
+
+      // NaN notes map to 0, as in Scale.
+      vecStore(py, vecAnd(r, vecEqual(x, x)));
+      px += kFloatsPerSIMDVector;
+      py += kFloatsPerSIMDVector;
+    }
+    return y;
+  }
+
+ private:
+  std::array<float, kSize + 1> table_;
+};
+
 }  // namespace ml
@@ -7,6 +7,7 @@
 #include <array>
 
 #include "MLDSPBuffer.h"
+#include "MLDSPDenormals.h"
 #include "MLDSPProjections.h"
 
 namespace ml
@@ -44,55 +45,24 @@ const Projection flatTop(
       return a0 - a1 * cosf(kTwoPi * x) + a2 * cosf(2.f * kTwoPi * x) -
              a3 * cosf(3.f * kTwoPi * x) + a4 * cosf(4.f * kTwoPi * x);
     });
-}  // namespace dspwindows
 
-// UsingFlushDenormalsToZero: turn off denormal math so that (for example) IIR filters don't consume
-// many more CPU cycles when they decay. Only needed for Intel processors.
-struct UsingFlushDenormalsToZero
+// constexpr versions of the cosine windows on [0, 1], for use with makeWindowTable().
+constexpr double kWindowTwoPi{2. * const_math::kPiDouble};
+constexpr double raisedCosineFn(double x) { return 0.5 - 0.5 * const_math::cos(kWindowTwoPi * x); }
+constexpr double hammingFn(double x) { return 0.54 - 0.46 * const_math::cos(kWindowTwoPi * x); }
+constexpr double blackmanFn(double x)
 {
-#if defined(__SSE__)
-  uint32_t MXCRState;
-
-  UsingFlushDenormalsToZero()
-  {
-    // Set the DAZ (denormals are zero) and FZ (flush to zero) in the Intel MXCSR register
-    MXCRState = _mm_getcsr();           // read the old MXCSR setting
-    int newMXCSR = MXCRState | 0x8040;  // set DAZ and FZ bits
-    _mm_setcsr(newMXCSR);               // write the new MXCSR setting to the MXCSR
-  }
-
-  ~UsingFlushDenormalsToZero()
-  {
-    // restore the old MXCSR setting
-    _mm_setcsr(MXCRState);
-  }
-
-#elif defined(__aarch64__)
-  uint64_t MXCRState = 0;
-
-  UsingFlushDenormalsToZero()
-  {
-    // read and store floating point control register (FPCR)
-    uint64_t FPCR_prev = 0;
-    asm volatile("MRS %0, FPCR " : "=r"(FPCR_prev));
-    MXCRState = FPCR_prev;
-
-    // set flush to zero bit and write FPCR
-    uint64_t FPCR = FPCR_prev | (1ULL << 24);
-    asm volatile("MSR FPCR, %0 " : : "r"(FPCR));
-  }
-
-  ~UsingFlushDenormalsToZero()
-  {
-    // restore the old MXCSR setting
-    asm volatile("MSR FPCR, %0 " : : "r"(MXCRState));
-  }
-
-#else
-  UsingFlushDenormalsToZero() = default;
-  ~UsingFlushDenormalsToZero() = default;
+  return 0.42 - 0.5 * const_math::cos(kWindowTwoPi * x) +
+         0.08 * const_math::cos(2. * kWindowTwoPi * x);
+}
+}  // namespace dspwindows
 
-#endif
-};
+// a window of N samples made at compile time, from a constexpr function on [0, 1] such as
+// dspwindows::blackmanFn. The samples are spread over the domain as in makeWindow().
+template <size_t N, class Function>
+constexpr std::array<float, N> makeWindowTable(Function windowShape)
+{
+  return makeSampledTable<N>(windowShape, 0., 1.);
+}
 
 }  // namespace ml
@@ -0,0 +1,159 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// Waveshaper: a memoryless transfer function for distortion, sampled into a
+// ProjectionTable at setup and evaluated on DSPVectors with SIMD linear or
+// cubic interpolation. Inputs are clamped to the domain of the table.
+//
+// Shaping makes harmonics that can alias. Two remedies are built in, and can
+// be used together:
+// - FACTOR > 1 runs the shaper at FACTOR times the sample rate in an
+//   Oversample, with the half band filter cascades.
+// - Antiderivative antialiasing (ADAA) uses a second table, of the integral F
+//   of the shape f, and outputs (F(x[n]) - F(x[n - 1])) / (x[n] - x[n - 1]),
+//   the average of f over the line between successive inputs. This is a
+//   lowpass on the harmonics that costs about as much as a second table read,
+//   and delays the output by half a sample. Where successive inputs are closer
+//   than kMinDifference, f at their midpoint is used instead.
+
+#pragma once
+
+#include <type_traits>
+#include <vector>
+
+#include "MLDSPFunctional.h"
+#include "MLDSPOps.h"
+#include "MLDSPProjectionTable.h"
+
+namespace ml
+{
+template <int FACTOR = 1>
+class Waveshaper
+{
+  static_assert((FACTOR == 1) || (FACTOR == 2) || (FACTOR == 4) || (FACTOR == 8) ||
+                    (FACTOR == 16),
+                "Waveshaper: FACTOR must be 1, 2, 4, 8 or 16.");
+
+ public:
+  using Interpolation = ProjectionTable::Interpolation;
+  static constexpr size_t kDefaultSize{1024};
+  static constexpr float kMinDifference{1e-3f};
+
+  // tabulate the shape over the domain. Not real-time safe.
+  explicit Waveshaper(const Projection& shape, Interval domain = {-1.f, 1.f},
+                      bool antiderivative = false, size_t size = kDefaultSize,
+                      Interpolation interp = Interpolation::kHermite)
+      : domain_(domain), shape_(shape, domain, size, interp), antiderivative_(antiderivative)
+  {
+    if (antiderivative_) makeIntegral(shape, size, interp);
+    clear();
+  }
+
+  DSPVector operator()(const DSPVector& x)
+  {
+    if constexpr (FACTOR == 1)
+    {
+      return process(x);
+    }
+    else
+    {
+      return oversample_([this](const DSPVectorArray<1>& v) { return process(v); }, x);
+    }
+  }
+
+  // the delay of the output at low frequencies, in samples at the base rate.
+  float getLatency() const
+  {
+    float latency = antiderivative_ ? 0.5f / FACTOR : 0.f;
+    if constexpr (FACTOR > 1) latency += oversample_.getLatency();
+    return latency;
+  }
+
+  void clear()
+  {
+    x1_ = clamp(0.f, domain_.x1, domain_.x2);
+    F1_ = antiderivative_ ? integral_(x1_) : 0.f;
+    if constexpr (FACTOR > 1) oversample_.clear();
+  }
+
+ private:
+  struct NoOversample
+  {
+  };
+
+  DSPVector process(const DSPVector& x)
+  {
+    return antiderivative_ ? processAntiderivative(x) : shape_(x);
+  }
+
+  // F is integrated from the start of the domain with Simpson's rule, a few steps per segment
+  // of the table.
+  void makeIntegral(const Projection& f, size_t size, Interpolation interp)
+  {
+    constexpr int kSteps{8};
+    size = std::max(size, size_t(2));
+    const double h = double(domain_.x2 - domain_.x1) / (size - 1);
+    std::vector<float> F(size);
+    double sum{0.};
+    for (size_t i = 1; i < size; ++i)
+    {
+      const double a = domain_.x1 + (i - 1) * h;
+      const double dx = h / kSteps;
+      for (int j = 0; j < kSteps; ++j)
+      {
+        const double x0 = a + j * dx;
+        sum += dx / 6. * (f(float(x0)) + 4. * f(float(x0 + dx / 2)) + f(float(x0 + dx)));
+      }
+      F[i] = float(sum);
+    }
+    integral_ = ProjectionTable(F.data(), size, domain_, interp);
+  }
+
+  DSPVector processAntiderivative(const DSPVector& x)
+  {
+    // the clamped inputs and their integrals, each with the last of the previous vector.
+    DSPVector xc = clamp(x, DSPVector(domain_.x1), DSPVector(domain_.x2));
+    DSPVector F = integral_(xc);
+    DSPVector xPrev, FPrev;
+    xPrev[0] = x1_;
+    FPrev[0] = F1_;
+    for (int n = 1; n < kFloatsPerDSPVector; ++n)
+    {
+      xPrev[n] = xc[n - 1];
+      FPrev[n] = F[n - 1];
+    }
+    x1_ = xc[kFloatsPerDSPVector - 1];
+    F1_ = F[kFloatsPerDSPVector - 1];
+    DSPVector mid = shape_((xc + xPrev) * DSPVector(0.5f));
+
+    DSPVector y;
+    const float* px = xc.getConstBuffer();
+    const float* pxp = xPrev.getConstBuffer();
+    const float* pF = F.getConstBuffer();
+    const float* pFp = FPrev.getConstBuffer();
+    const float* pMid = mid.getConstBuffer();
+    float* py = y.getBuffer();
+    const SIMDVectorFloat vMin = vecSet1(kMinDifference);
+    const SIMDVectorFloat vOne = vecSet1(1.f);
+    for (int n = 0; n < kFloatsPerDSPVector; n += kFloatsPerSIMDVector)
+    {
+      SIMDVectorFloat dx = vecSub(vecLoad(px + n), vecLoad(pxp + n));
+      SIMDVectorFloat apart = vecGreaterThan(vecAbs(dx), vMin);
+      SIMDVectorFloat dF = vecSub(vecLoad(pF + n), vecLoad(pFp + n));
+      SIMDVectorFloat average = vecDiv(dF, vecSelect(dx, vOne, apart));
+      vecStore(py + n, vecSelect(average, vecLoad(pMid + n), apart));
+    }
+    return y;
+  }
+
+  Interval domain_;
+  ProjectionTable shape_;
+  ProjectionTable integral_;
+  bool antiderivative_;
+  float x1_{0.f};
+  float F1_{0.f};
+  std::conditional_t<(FACTOR > 1), Oversample<FACTOR, 1>, NoOversample> oversample_;
+};
+
+}  // namespace ml
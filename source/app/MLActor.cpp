@@ -4,17 +4,71 @@
 
 #include "MLActor.h"
 
+#include <algorithm>
+
 using namespace ml;
 
-Actor* ActorRegistry::getActor(Path actorName) { return actors_[actorName]; }
+Actor* ActorRegistry::getActor(Path actorName)
+{
+  std::unique_lock<std::mutex> lock(listMutex_);
+  return actors_[actorName];
+}
 
-void ActorRegistry::doRegister(Path actorName, Actor* a) { actors_[actorName] = a; }
+ActorRef ActorRegistry::getActorRef(Path actorName)
+{
+  std::unique_lock<std::mutex> lock(listMutex_);
+  ActorRef ref;
+  Actor* a = actors_[actorName];
+  if (a && (a->registrySlot_ >= 0))
+  {
+    ref.slot_ = &slots_[a->registrySlot_];
+    ref.generation_ = ref.slot_->generation.load(std::memory_order_relaxed);
+  }
+  return ref;
+}
+
+void ActorRegistry::doRegister(Path actorName, Actor* a)
+{
+  std::unique_lock<std::mutex> lock(listMutex_);
+  actors_[actorName] = a;
+  if (!a || (a->registrySlot_ >= 0)) return;
+
+  // give the Actor a slot and start a new generation in it.
+  size_t i;
+  if (!freeSlots_.empty())
+  {
+    i = freeSlots_.back();
+    freeSlots_.pop_back();
+  }
+  else
+  {
+    i = slots_.size();
+    slots_.emplace_back();
+  }
+  slots_[i].actor.store(a, std::memory_order_release);
+  slots_[i].generation.fetch_add(1, std::memory_order_seq_cst);
+  a->registrySlot_ = int(i);
+}
 
 void ActorRegistry::doRemove(Actor* actorToRemove)
 {
   // get exclusive access to the Tree
   std::unique_lock<std::mutex> lock(listMutex_);
 
+  // invalidate ActorRefs, then wait for any sends through them that are in progress.
+  if (actorToRemove->registrySlot_ >= 0)
+  {
+    Slot& slot = slots_[actorToRemove->registrySlot_];
+    slot.generation.fetch_add(1, std::memory_order_seq_cst);
+    while (slot.senders.load(std::memory_order_seq_cst) > 0)
+    {
+      std::this_thread::yield();
+    }
+    slot.actor.store(nullptr, std::memory_order_relaxed);
+    freeSlots_.push_back(size_t(actorToRemove->registrySlot_));
+    actorToRemove->registrySlot_ = -1;
+  }
+
   // remove the Actor
   for (auto it = actors_.begin(); it != actors_.end(); ++it)
   {
@@ -28,3 +82,130 @@ void ActorRegistry::doRemove(Actor* actorToRemove)
 }
 
 void ActorRegistry::dump() { actors_.dump(); }
+
+// ----------------------------------------------------------------
+// ActorExecutor
+
+ActorExecutor::ActorExecutor(size_t nThreads)
+{
+  threads_.reserve(nThreads);
+  for (size_t i = 0; i < nThreads; ++i)
+  {
+    threads_.emplace_back([this]() { workerLoop(); });
+  }
+}
+
+ActorExecutor::~ActorExecutor()
+{
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    quit_ = true;
+
+    // detach any Actors that were not stopped.
+    for (Actor* a : actors_)
+    {
+      a->executor_.store(nullptr, std::memory_order_release);
+      a->scheduled_.store(nullptr, std::memory_order_release);
+    }
+  }
+  workCondition_.notify_all();
+  for (auto& t : threads_)
+  {
+    t.join();
+  }
+}
+
+size_t ActorExecutor::getNumActors()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  return actors_.size();
+}
+
+void ActorExecutor::add(Actor* a)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  actors_.push_back(a);
+  a->executor_.store(this, std::memory_order_release);
+
+  // handle any messages that arrived before we started.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if ((a->getMessagesAvailable() > 0) && a->markScheduled(this))
+  {
+    runnable_.push_back(a);
+    workCondition_.notify_one();
+  }
+}
+
+void ActorExecutor::remove(Actor* a)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (a->executor_.load(std::memory_order_relaxed) != this) return;
+  a->executor_.store(nullptr, std::memory_order_release);
+  actors_.erase(std::remove(actors_.begin(), actors_.end(), a), actors_.end());
+  runnable_.erase(std::remove(runnable_.begin(), runnable_.end(), a), runnable_.end());
+
+  // wait for a worker that is running the Actor to finish.
+  idleCondition_.wait(lock, [&]() { return !a->runningOnExecutor_; });
+  a->clearScheduled(this);
+}
+
+void ActorExecutor::schedule(Actor* a)
+{
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (a->executor_.load(std::memory_order_relaxed) == this)
+    {
+      runnable_.push_back(a);
+      workCondition_.notify_one();
+      return;
+    }
+
+    // the Actor was removed after the sender marked it runnable here. Mark it idle again, or it
+    // would never be scheduled after being added back.
+    a->clearScheduled(this);
+  }
+
+  // if the Actor was added to an executor meanwhile, add() may have seen our mark and left it.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  ActorExecutor* e = a->executor_.load(std::memory_order_acquire);
+  if (e && (a->getMessagesAvailable() > 0) && a->markScheduled(e))
+  {
+    e->schedule(a);
+  }
+}
+
+void ActorExecutor::workerLoop()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;)
+  {
+    workCondition_.wait(lock, [&]() { return quit_ || !runnable_.empty(); });
+    if (quit_) return;
+
+    Actor* a = runnable_.front();
+    runnable_.pop_front();
+
+    // an Actor removed and added back while a sender was scheduling it can be queued twice. The
+    // worker running it checks for more messages when it is done, so the second entry is dropped.
+    if (a->runningOnExecutor_) continue;
+    a->runningOnExecutor_ = true;
+    lock.unlock();
+
+    a->handleMessagesInQueue(kMessagesPerTurn);
+
+    lock.lock();
+    a->runningOnExecutor_ = false;
+    if (a->executor_.load(std::memory_order_relaxed) == this)
+    {
+      // go to the back of the queue if there is more to do. Otherwise the Actor is idle, unless a
+      // message arrived while we were checking, whose sender saw that it was still scheduled.
+      a->clearScheduled(this);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if ((a->getMessagesAvailable() > 0) && a->markScheduled(this))
+      {
+        runnable_.push_back(a);
+      }
+    }
+    idleCondition_.notify_all();
+  }
+}
@@ -4,6 +4,11 @@
 
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <limits>
+
 #include "MLMessage.h"
 #include "MLQueue.h"
 #include "MLTimer.h"
@@ -17,9 +22,25 @@ namespace ml
 {
 
 class Actor;
+class ActorRef;
 class ActorRegistry
 {
+  friend ActorRef;
+
+  // each registered Actor has a slot, which ActorRefs point to. The generation changes when
+  // the Actor is registered and when it is removed, so a ref made before the removal no longer
+  // matches. senders counts the ActorRefs sending to the Actor at the moment, which removal
+  // waits for. Slots are kept in a deque so that they don't move, and reused.
+  struct Slot
+  {
+    std::atomic<Actor*> actor{nullptr};
+    std::atomic<uint32_t> generation{0};
+    std::atomic<int> senders{0};
+  };
+
   Tree<Actor*> actors_;
+  std::deque<Slot> slots_;
+  std::vector<size_t> freeSlots_;
   std::mutex listMutex_;
 
  public:
@@ -27,30 +48,162 @@ class ActorRegistry
   ~ActorRegistry() = default;
 
   Actor* getActor(Path actorName);
+  ActorRef getActorRef(Path actorName);
   void doRegister(Path actorName, Actor* a);
   void doRemove(Actor* actorToRemove);
 
   void dump();
 };
 
+// ActorExecutor: runs the messages of many Actors on a small pool of threads.
+//
+// An Actor started with startOnExecutor() has no Timer or thread of its own. When a message is
+// sent to it and it is idle, it is marked runnable and put at the back of the executor's run
+// queue. A worker takes the Actor from the front, handles up to kMessagesPerTurn messages, and
+// puts it at the back again if more are waiting. So an Actor is only ever run by one worker at a
+// time, its messages are handled in order, and a busy Actor can't hold up the others.
+//
+// Sending a message to an idle Actor takes the executor's lock briefly, to put the Actor on the
+// run queue. Messages sent while it is already runnable don't lock. So real-time threads such as
+// the audio thread should not send messages to Actors on an executor.
+//
+// Actors must be stopped before the executor is destroyed. An Actor must not stop itself from
+// onMessage().
+class ActorExecutor final
+{
+ public:
+  static constexpr size_t kMessagesPerTurn{16};
+
+  explicit ActorExecutor(size_t nThreads = 2);
+  ~ActorExecutor();
+
+  ActorExecutor(const ActorExecutor&) = delete;
+  ActorExecutor& operator=(const ActorExecutor&) = delete;
+
+  size_t getNumThreads() const { return threads_.size(); }
+  size_t getNumActors();
+
+ private:
+  friend Actor;
+
+  void add(Actor* a);
+  void remove(Actor* a);
+  void schedule(Actor* a);
+  void workerLoop();
+
+  std::vector<std::thread> threads_;
+  std::vector<Actor*> actors_;
+  std::deque<Actor*> runnable_;
+  std::mutex mutex_;
+  std::condition_variable workCondition_;
+  std::condition_variable idleCondition_;
+  bool quit_{false};
+};
+
+// By default an Actor's queue has a single producer, so only one thread may
+// send it messages. Actors constructed with kMultipleProducers use an MPMC
+// queue instead, and can be sent messages from any number of threads.
+enum class ActorQueueType
+{
+  kSingleProducer,
+  kMultipleProducers
+};
+
 class Actor
 {
   friend ActorRegistry;
+  friend ActorExecutor;
+
+  // our slot in the ActorRegistry, or -1.
+  int registrySlot_{-1};
 
   static constexpr size_t kDefaultMessageQueueSize{128};
   static constexpr size_t kDefaultMessageInterval{1000 / 60};
+  static constexpr size_t kMessageBatchSize{16};
 
-  Queue<Message> messageQueue_{kDefaultMessageQueueSize};
+  // the queues store CompactMessages, which are much smaller than Messages.
+  Queue<CompactMessage> messageQueue_{kDefaultMessageQueueSize};
+  std::unique_ptr<MPMCQueue<CompactMessage> > mpmcQueue_;
   Timer queueTimer_;
 
+  // message-driven mode
+  static constexpr milliseconds kMaxMessageThreadSleep{1000};
+  std::thread messageThread_;
+  std::atomic<bool> messageThreadRunning_{false};
+  std::atomic<bool> messageThreadSleeping_{false};
+  std::mutex wakeMutex_;
+  std::condition_variable wakeCondition_;
+
+  // executor mode. scheduled_ is the executor the Actor is runnable on, or nullptr if it is idle.
+  // Only the thread that changes it from nullptr puts the Actor on that executor's run queue.
+  // runningOnExecutor_ is guarded by the executor's mutex.
+  std::atomic<ActorExecutor*> executor_{nullptr};
+  std::atomic<ActorExecutor*> scheduled_{nullptr};
+  bool runningOnExecutor_{false};
+
+  // mark the Actor runnable on e if it is idle, returning true if the caller must schedule it.
+  bool markScheduled(ActorExecutor* e)
+  {
+    ActorExecutor* idle{nullptr};
+    return scheduled_.compare_exchange_strong(idle, e, std::memory_order_acq_rel);
+  }
+
+  // mark the Actor idle if it is runnable on e.
+  void clearScheduled(ActorExecutor* e)
+  {
+    scheduled_.compare_exchange_strong(e, nullptr, std::memory_order_seq_cst);
+  }
+
+  void runMessageThread()
+  {
+    while (messageThreadRunning_.load(std::memory_order_acquire))
+    {
+      handleMessagesInQueue();
+
+      // sleep until a message arrives. Either we see the new message here or the
+      // sender sees that we are sleeping and wakes us, because of the fences.
+      std::unique_lock<std::mutex> lock(wakeMutex_);
+      messageThreadSleeping_.store(true, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if ((getMessagesAvailable() == 0) && messageThreadRunning_.load(std::memory_order_acquire))
+      {
+        wakeCondition_.wait_for(lock, kMaxMessageThreadSleep);
+      }
+      messageThreadSleeping_.store(false, std::memory_order_relaxed);
+    }
+  }
+
  protected:
-  size_t getMessagesAvailable() { return messageQueue_.elementsAvailable(); }
+  size_t getMessagesAvailable()
+  {
+    return mpmcQueue_ ? mpmcQueue_->elementsAvailable() : messageQueue_.elementsAvailable();
+  }
 
  public:
   Actor() = default;
-  virtual ~Actor() = default;
+  explicit Actor(ActorQueueType t)
+  {
+    if (t == ActorQueueType::kMultipleProducers)
+    {
+      messageQueue_.resize(0);
+      mpmcQueue_ = std::make_unique<MPMCQueue<CompactMessage> >(kDefaultMessageQueueSize);
+    }
+  }
+  // subclasses that use startMessageDriven() should call stop() in their
+  // destructors, so that onMessage() is not called during destruction.
+  virtual ~Actor() { stop(); }
 
-  void resizeQueue(size_t n) { messageQueue_.resize(n); }
+  void resizeQueue(size_t n)
+  {
+    if (mpmcQueue_)
+    {
+      mpmcQueue_->resize(n);
+    }
+    else
+    {
+      messageQueue_.resize(n);
+    }
+  }
 
   // Actors can override onFullQueue to specify what action to take when
   // the message queue is full.
@@ -73,16 +226,75 @@ class Actor
     queueTimer_.start([=]() { handleMessagesInQueue(); }, milliseconds(interval));
   }
 
-  void stop() { queueTimer_.stop(); }
+  // Start a private thread that handles each message as soon as it is
+  // enqueued, and sleeps while the queue is empty. This is an alternative to
+  // start(), which polls the queue on a Timer.
+  void startMessageDriven()
+  {
+    if (messageThreadRunning_.exchange(true)) return;
+    messageThread_ = std::thread([this]() { runMessageThread(); });
+  }
 
-  // enqueueMessage just pushes the message onto the queue.
+  // Handle messages on the threads of the executor, as soon as they are enqueued. This is an
+  // alternative to start() and startMessageDriven() for applications with many Actors.
+  void startOnExecutor(ActorExecutor& e)
+  {
+    if (executor_.load(std::memory_order_acquire)) return;
+    e.add(this);
+  }
+
+  void stop()
+  {
+    queueTimer_.stop();
+    if (ActorExecutor* e = executor_.load(std::memory_order_acquire))
+    {
+      e->remove(this);
+    }
+    if (messageThreadRunning_.exchange(false))
+    {
+      {
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+        wakeCondition_.notify_one();
+      }
+      messageThread_.join();
+    }
+  }
+
+  bool isMessageDriven() const { return messageThreadRunning_.load(std::memory_order_relaxed); }
+  bool isOnExecutor() const { return executor_.load(std::memory_order_relaxed) != nullptr; }
+
+  // enqueueMessage just pushes the message onto the queue. For an Actor on an executor, this may
+  // take the executor's lock: see ActorExecutor.
   void enqueueMessage(Message m)
   {
     // queue returns true unless full.
-    if (!(messageQueue_.push(m)))
+    CompactMessage c(std::move(m));
+    bool pushed = mpmcQueue_ ? mpmcQueue_->push(std::move(c)) : messageQueue_.push(std::move(c));
+    if (!pushed)
     {
       onFullQueue();
     }
+
+    // make the Actor runnable if it is on an executor and was idle.
+    if (ActorExecutor* e = executor_.load(std::memory_order_acquire))
+    {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (markScheduled(e))
+      {
+        e->schedule(this);
+      }
+    }
+
+    // wake the message thread if it is sleeping.
+    if (messageThreadRunning_.load(std::memory_order_relaxed))
+    {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (messageThreadSleeping_.load(std::memory_order_relaxed))
+      {
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+        wakeCondition_.notify_one();
+      }
+    }
   }
 
   void enqueueMessageList(const MessageList& ml)
@@ -94,15 +306,100 @@ class Actor
   }
 
   // handle all the messages in the queue immediately.
-  void handleMessagesInQueue()
+  void handleMessagesInQueue() { handleMessagesInQueue(std::numeric_limits<size_t>::max()); }
+
+  // handle up to maxMessages messages from the queue, returning the number handled.
+  size_t handleMessagesInQueue(size_t maxMessages)
+  {
+    size_t handled{0};
+    if (mpmcQueue_)
+    {
+      CompactMessage c;
+      while ((handled < maxMessages) && mpmcQueue_->pop(c) && c)
+      {
+        onMessage(c.takeMessage());
+        handled++;
+      }
+      return handled;
+    }
+
+    // drain the SPSC queue in batches.
+    CompactMessage batch[kMessageBatchSize];
+    while (size_t n = messageQueue_.popN(batch, std::min(kMessageBatchSize, maxMessages - handled)))
+    {
+      for (size_t i = 0; i < n; ++i)
+      {
+        if (batch[i]) onMessage(batch[i].takeMessage());
+      }
+      handled += n;
+    }
+    return handled;
+  }
+
+  void clearMessageQueue()
   {
-    while (Message m = messageQueue_.pop())
+    if (mpmcQueue_)
+    {
+      mpmcQueue_->clear();
+    }
+    else
     {
-      onMessage(m);
+      messageQueue_.clear();
     }
   }
+};
+
+// ActorRef: a handle for sending messages to a registered Actor without looking it up.
+//
+// getActorRef() finds the Actor by name once. Sending through the ref then goes straight to
+// the Actor's queue, with no lock. When the Actor is removed from the registry the ref becomes
+// invalid and sends nothing, even if a different Actor is later registered with the same name;
+// get a new ref to reach that one. removeActor() waits for sends through refs that are already
+// in progress, so an Actor can be destroyed safely once it has been removed.
+//
+// The Actor's queue type still decides how many threads may send to it at once.
+class ActorRef
+{
+  friend ActorRegistry;
 
-  void clearMessageQueue() { messageQueue_.clear(); }
+  SharedResourcePointer<ActorRegistry> registry_;
+  ActorRegistry::Slot* slot_{nullptr};
+  uint32_t generation_{0};
+
+ public:
+  ActorRef() = default;
+  ActorRef(const ActorRef& b) : slot_(b.slot_), generation_(b.generation_) {}
+  ActorRef& operator=(const ActorRef& b)
+  {
+    slot_ = b.slot_;
+    generation_ = b.generation_;
+    return *this;
+  }
+
+  // true if the Actor has not been removed since the ref was made.
+  bool isValid() const
+  {
+    return slot_ && (slot_->generation.load(std::memory_order_acquire) == generation_);
+  }
+  explicit operator bool() const { return isValid(); }
+
+  // send the message to the Actor if it is still registered. Returns false if not.
+  bool send(const Message& m) const
+  {
+    if (!slot_) return false;
+    bool sent{false};
+
+    // we announce ourselves before checking the generation, and removal changes the
+    // generation before checking for senders, so one of us sees the other.
+    slot_->senders.fetch_add(1, std::memory_order_seq_cst);
+    if (slot_->generation.load(std::memory_order_seq_cst) == generation_)
+    {
+      slot_->actor.load(std::memory_order_acquire)->enqueueMessage(m);
+      sent = true;
+    }
+    slot_->senders.fetch_sub(1, std::memory_order_release);
+    return sent;
+  }
 };
 
 inline void registerActor(Path actorName, Actor* actorToRegister)
@@ -137,4 +434,14 @@ inline void sendMessageToActor(Path actorName, Message m)
   }
 }
 
+// get a handle for sending to the named Actor, which is invalid if there is none. For senders
+// of many messages, this does the lookup of sendMessageToActor() once.
+inline ActorRef getActorRef(Path actorName)
+{
+  SharedResourcePointer<ActorRegistry> registry;
+  return registry->getActorRef(actorName);
+}
+
+inline bool sendMessageToActor(const ActorRef& actor, const Message& m) { return actor.send(m); }
+
 }  // namespace ml
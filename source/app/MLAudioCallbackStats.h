@@ -0,0 +1,126 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// AudioCallbackStats: lock-free timing statistics for an audio callback.
+//
+// The audio thread calls record() once per callback with the time spent processing, the
+// buffer period and whether the device reported an xrun. Any other thread can call
+// getSnapshot() at any time to read the counts, the load (processing time as a ratio of the
+// period) and a histogram of the loads. Only one thread may record.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace ml
+{
+class AudioCallbackStats
+{
+ public:
+  // the histogram has kLoadBins bins for loads in [0, 1), and a last bin for callbacks that
+  // took a whole period or more and so missed their deadline.
+  static constexpr int kLoadBins{20};
+  static constexpr int kHistogramSize{kLoadBins + 1};
+
+  struct Snapshot
+  {
+    uint64_t callbacks{0};
+    uint64_t xruns{0};
+    uint64_t deadlineMisses{0};
+    float lastLoad{0.f};
+    float maxLoad{0.f};
+    float meanLoad{0.f};
+    float maxSeconds{0.f};
+    std::array<uint64_t, kHistogramSize> histogram{};
+
+    // the least headroom seen, as a ratio of the period.
+    float getMinHeadroom() const { return 1.f - maxLoad; }
+  };
+
+  // record one callback. To be called only from the audio thread.
+  void record(double seconds, double periodSeconds, bool xrun)
+  {
+    if (resetRequested_.exchange(false, std::memory_order_acquire))
+    {
+      clearCounts();
+    }
+
+    float load = (periodSeconds > 0.) ? float(seconds / periodSeconds) : 0.f;
+    int bin = (load >= 1.f) ? kLoadBins : std::max(int(load * kLoadBins), 0);
+
+    increment(histogram_[bin]);
+    increment(callbacks_);
+    if (xrun) increment(xruns_);
+    if (load >= 1.f) increment(deadlineMisses_);
+
+    lastLoad_.store(load, std::memory_order_relaxed);
+    totalLoad_.store(totalLoad_.load(std::memory_order_relaxed) + load,
+                     std::memory_order_relaxed);
+    if (load > maxLoad_.load(std::memory_order_relaxed))
+    {
+      maxLoad_.store(load, std::memory_order_relaxed);
+    }
+    if (seconds > maxSeconds_.load(std::memory_order_relaxed))
+    {
+      maxSeconds_.store(float(seconds), std::memory_order_relaxed);
+    }
+  }
+
+  // read the statistics from any thread. The values are each current, but may be from either
+  // side of a callback that is recorded while reading.
+  Snapshot getSnapshot() const
+  {
+    Snapshot s;
+    s.callbacks = callbacks_.load(std::memory_order_relaxed);
+    s.xruns = xruns_.load(std::memory_order_relaxed);
+    s.deadlineMisses = deadlineMisses_.load(std::memory_order_relaxed);
+    s.lastLoad = lastLoad_.load(std::memory_order_relaxed);
+    s.maxLoad = maxLoad_.load(std::memory_order_relaxed);
+    s.maxSeconds = maxSeconds_.load(std::memory_order_relaxed);
+    double totalLoad = totalLoad_.load(std::memory_order_relaxed);
+    s.meanLoad = s.callbacks ? float(totalLoad / s.callbacks) : 0.f;
+    for (int i = 0; i < kHistogramSize; ++i)
+    {
+      s.histogram[i] = histogram_[i].load(std::memory_order_relaxed);
+    }
+    return s;
+  }
+
+  // ask the audio thread to clear the statistics before it records the next callback.
+  void reset() { resetRequested_.store(true, std::memory_order_release); }
+
+ private:
+  // only the audio thread writes, so a load and a store are enough.
+  static void increment(std::atomic<uint64_t>& x)
+  {
+    x.store(x.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  void clearCounts()
+  {
+    for (auto& h : histogram_) h.store(0, std::memory_order_relaxed);
+    callbacks_.store(0, std::memory_order_relaxed);
+    xruns_.store(0, std::memory_order_relaxed);
+    deadlineMisses_.store(0, std::memory_order_relaxed);
+    lastLoad_.store(0.f, std::memory_order_relaxed);
+    maxLoad_.store(0.f, std::memory_order_relaxed);
+    maxSeconds_.store(0.f, std::memory_order_relaxed);
+    totalLoad_.store(0., std::memory_order_relaxed);
+  }
+
+  std::array<std::atomic<uint64_t>, kHistogramSize> histogram_{};
+  std::atomic<uint64_t> callbacks_{0};
+  std::atomic<uint64_t> xruns_{0};
+  std::atomic<uint64_t> deadlineMisses_{0};
+  std::atomic<float> lastLoad_{0.f};
+  std::atomic<float> maxLoad_{0.f};
+  std::atomic<float> maxSeconds_{0.f};
+  std::atomic<double> totalLoad_{0.};
+  std::atomic<bool> resetRequested_{false};
+};
+
+}  // namespace ml
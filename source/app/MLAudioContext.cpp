@@ -7,6 +7,38 @@
 namespace ml
 {
 
+// AudioContext::LoadMeter
+
+void AudioContext::LoadMeter::setSampleRate(double sr)
+{
+  sampleRate_ = sr;
+  secondsPerTick_ = 1.0 / TickClock::getTicksPerSecond();
+  if (sr > 0.)
+  {
+    const double vectorSeconds = kFloatsPerDSPVector / sr;
+    voiceLoadPerTick_ = secondsPerTick_ / vectorSeconds;
+    voiceSmoothing_ = float(1.0 - std::exp(-vectorSeconds / kSmoothingSeconds));
+  }
+}
+
+void AudioContext::LoadMeter::endBlock(int frames)
+{
+  if ((frames <= 0) || (sampleRate_ <= 0.)) return;
+  const double blockSeconds = frames / sampleRate_;
+  const double seconds = (TickClock::now() - blockStartTicks_) * secondsPerTick_;
+  const float load = float(seconds / blockSeconds);
+
+  // a one pole filter with the time constant in seconds, whatever the block size.
+  const float a = float(1.0 - std::exp(-blockSeconds / kSmoothingSeconds));
+  const float y = smoothedLoad_.load(std::memory_order_relaxed);
+  smoothedLoad_.store(y + (load - y) * a, std::memory_order_relaxed);
+  load_.store(load, std::memory_order_relaxed);
+
+  float peak = peakLoad_.load(std::memory_order_relaxed);
+  if (peakResetRequested_.exchange(false, std::memory_order_acquire)) peak = 0.f;
+  peakLoad_.store(std::max(peak, load), std::memory_order_relaxed);
+}
+
 // AudioContext::ProcessTime
 
 // Set the time and bpm. The time refers to the start of the current processing block.
@@ -112,6 +144,7 @@ void AudioContext::setSampleRate(int r)
 {
   currentTime.sampleRate = r;
   eventsToSignals.setSampleRate(r);
+  loadMeter.setSampleRate(r);
 }
 
 void AudioContext::clear()
@@ -122,10 +155,42 @@ void AudioContext::clear()
 
 void AudioContext::processVector(int startOffset)
 {
+  scratch.reset();
+  if (splitAtEvents_)
+  {
+    findSpans(startOffset);
+  }
   currentTime.processVector(startOffset);
   eventsToSignals.processVector(startOffset);
 }
 
+void AudioContext::setSplitAtEvents(bool b)
+{
+  splitAtEvents_ = b;
+  numSpans_ = 1;
+  spanStarts_[0] = 0;
+  spanStarts_[1] = kFloatsPerDSPVector;
+}
+
+// divide the vector at the times of the queued events within it.
+void AudioContext::findSpans(int startOffset)
+{
+  int endOffset = startOffset + kFloatsPerDSPVector;
+  numSpans_ = 0;
+  spanStarts_[0] = 0;
+  for (const auto& e : eventsToSignals.getEvents())
+  {
+    // events are sorted by time.
+    if (e.time >= endOffset) break;
+    int t = e.time - startOffset;
+    if ((e.type != kNull) && (t > spanStarts_[numSpans_]))
+    {
+      spanStarts_[++numSpans_] = t;
+    }
+  }
+  spanStarts_[++numSpans_] = kFloatsPerDSPVector;
+}
+
 DSPVector AudioContext::getInputController(size_t n) const
 {
   return eventsToSignals.getController(n).output;
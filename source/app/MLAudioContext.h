@@ -4,9 +4,13 @@
 
 #pragma once
 
+#include "MLClock.h"
 #include "MLDSPOps.h"
 #include "MLEventsToSignals.h"
+#include "MLMemoryUtils.h"
 
+#include <array>
+#include <atomic>
 #include <cstdlib>
 #include <functional>
 
@@ -57,6 +61,61 @@ class AudioContext final
     double ppqPhase1_{0};
   };
 
+  // AudioContext::LoadMeter measures the DSP load: the time spent processing each block as a
+  // ratio of the block's duration at the sample rate. It also keeps the load of each voice of a
+  // Synth, per DSPVector. The audio thread writes and any thread can read, without locking.
+  // Smoothed values follow the measurements with a time constant of kSmoothingSeconds.
+  class LoadMeter
+  {
+   public:
+    static constexpr double kSmoothingSeconds{0.25};
+    static constexpr size_t kMaxVoices{EventsToSignals::kMaxVoices};
+
+    // not real-time safe: it may measure the TickClock the first time.
+    void setSampleRate(double sr);
+
+    // called by the audio thread around each block of processing.
+    void beginBlock() { blockStartTicks_ = TickClock::now(); }
+    void endBlock(int frames);
+
+    // record the ticks spent on voice v in one DSPVector. Each voice may be recorded from any
+    // one thread at a time, so voices rendered in parallel can record their own costs.
+    void recordVoice(size_t v, uint64_t ticks)
+    {
+      if (v >= kMaxVoices) return;
+      const float load = float(ticks * voiceLoadPerTick_);
+      const float y = voiceLoads_[v].load(std::memory_order_relaxed);
+      voiceLoads_[v].store(y + (load - y) * voiceSmoothing_, std::memory_order_relaxed);
+    }
+
+    // the load of the last block, its smoothed value and the highest since resetPeak().
+    float getLoad() const { return load_.load(std::memory_order_relaxed); }
+    float getSmoothedLoad() const { return smoothedLoad_.load(std::memory_order_relaxed); }
+    float getPeakLoad() const { return peakLoad_.load(std::memory_order_relaxed); }
+
+    // the smoothed load of voice v, as a ratio of the duration of a DSPVector.
+    float getVoiceLoad(size_t v) const
+    {
+      return (v < kMaxVoices) ? voiceLoads_[v].load(std::memory_order_relaxed) : 0.f;
+    }
+
+    // ask the audio thread to clear the peak at the end of the next block.
+    void resetPeak() { peakResetRequested_.store(true, std::memory_order_release); }
+
+   private:
+    double sampleRate_{0.};
+    double secondsPerTick_{0.};
+    double voiceLoadPerTick_{0.};
+    float voiceSmoothing_{1.f};
+    uint64_t blockStartTicks_{0};
+
+    std::atomic<float> load_{0.f};
+    std::atomic<float> smoothedLoad_{0.f};
+    std::atomic<float> peakLoad_{0.f};
+    std::atomic<bool> peakResetRequested_{false};
+    std::array<std::atomic<float>, kMaxVoices> voiceLoads_{};
+  };
+
   AudioContext(size_t nInputs, size_t nOutputs);
   AudioContext(size_t nInputs, size_t nOutputs, int rate);
   ~AudioContext() = default;
@@ -67,6 +126,21 @@ class AudioContext final
   // startOffset is the start frame of the vector in the host buffer.
   void processVector(int startOffset);
 
+  // sub-vector rendering. When splitting at events is on, processVector() divides each vector
+  // into spans at the sample offsets of the input events in it, so that processors can render
+  // the spans one at a time and start notes or other changes exactly where they happen. When it
+  // is off, there is always one span covering the whole vector and nothing is computed.
+  struct Span
+  {
+    int start;
+    int end;
+  };
+
+  void setSplitAtEvents(bool b);
+  bool getSplitAtEvents() const { return splitAtEvents_; }
+  size_t getNumSpans() const { return numSpans_; }
+  Span getSpan(size_t i) const { return {spanStarts_[i], spanStarts_[i + 1]}; }
+
   void setSampleRate(int r);
 
   void setInputPolyphony(int voices) { eventsToSignals.setPolyphony(voices); }
@@ -76,6 +150,10 @@ class AudioContext final
   DSPVector getBeatPhase() { return currentTime.quarterNotesPhase_; }
 
   void addInputEvent(const Event& e);
+  void addInputEvents(const Event* events, size_t n, bool alreadySorted = false)
+  {
+    eventsToSignals.addEvents(events, n, alreadySorted);
+  }
   void clearInputEvents() { eventsToSignals.clearEvents(); }
 
   void setInputPitchBend(float p) { eventsToSignals.setPitchBendInSemitones(p); }
@@ -88,6 +166,7 @@ class AudioContext final
   const EventsToSignals::Voice& getInputVoice(int n) { return eventsToSignals.getVoice(n); }
 
   int getNewestInputVoice() { return eventsToSignals.getNewestVoice(); }
+  void setInputVoiceInaudible(int n) { eventsToSignals.setVoiceInaudible(n); }
   DSPVector getInputController(size_t n) const;
 
   double getSampleRate() { return currentTime.sampleRate; }
@@ -97,9 +176,23 @@ class AudioContext final
   DSPVectorDynamic inputs;
   DSPVectorDynamic outputs;
 
+  // temporary memory for processors, reset by processVector() at the start of every vector.
+  // Set a larger capacity at setup if getOverflowCount() is ever nonzero.
+  static constexpr size_t kDefaultScratchBytes{64 * 1024};
+  ScratchArena scratch{kDefaultScratchBytes};
+
+  // the DSP load, measured by SignalProcessBuffer for each block and by Synth for each voice.
+  LoadMeter loadMeter;
+
  private:
+  void findSpans(int startOffset);
+
   ProcessTime currentTime;
   ml::EventsToSignals eventsToSignals;
+
+  bool splitAtEvents_{false};
+  size_t numSpans_{1};
+  std::array<int, kFloatsPerDSPVector + 1> spanStarts_{0, kFloatsPerDSPVector};
 };
 
 }  // namespace ml
@@ -0,0 +1,521 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLAudioEngine.h"
+
+#include <thread>
+
+#include "MLClock.h"
+#include "MLMemoryUtils.h"
+#include "MLRealtimeThread.h"
+#include "MLWorkerPool.h"
+#include "rtaudio/RtAudio.h"
+
+namespace ml
+{
+// DriftCompensatedBuffer
+
+namespace
+{
+// the reader's fill error is smoothed by this much per read before steering the ratio.
+constexpr double kErrorSmoothing{0.001};
+
+// proportional and integral gains, per read, from the fill error to the ratio.
+constexpr double kProportionalGain{0.001};
+constexpr double kIntegralGain{3e-7};
+}  // namespace
+
+void DriftCompensatedBuffer::resize(size_t channels, size_t maxFrames, size_t targetFrames)
+{
+  channels_ = channels;
+  maxFrames_ = maxFrames;
+  targetFrames_ = std::max(targetFrames, size_t(1));
+
+  // room for the target plus a write and a read at the fastest ratio, and some slack.
+  size_t maxRead = size_t(maxFrames * (1. + kMaxRatioDeviation)) + 2;
+  fifo_.resize(channels, int(targetFrames_ + maxFrames + maxRead * 2));
+
+  scratch_.assign(channels * maxRead, 0.f);
+  scratchPtrs_.resize(channels);
+  for (size_t c = 0; c < channels; ++c)
+  {
+    scratchPtrs_[c] = scratch_.data() + c * maxRead;
+  }
+  x0_.assign(channels, 0.f);
+  x1_.assign(channels, 0.f);
+  phase_ = smoothedError_ = integral_ = 0.;
+  ratio_ = 1.;
+  running_ = false;
+  ratioOut_ = 1.;
+  overflows_ = underflows_ = 0;
+}
+
+void DriftCompensatedBuffer::write(const float* const* pSrc, size_t frames)
+{
+  if (fifo_.getWriteAvailable() < frames)
+  {
+    overflows_.store(overflows_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return;
+  }
+  fifo_.writePlanar(pSrc, frames);
+}
+
+void DriftCompensatedBuffer::updateRatio(size_t available)
+{
+  double error = (double(available) - double(targetFrames_)) / targetFrames_;
+  smoothedError_ += kErrorSmoothing * (error - smoothedError_);
+  integral_ = clamp(integral_ + kIntegralGain * smoothedError_, -kMaxRatioDeviation,
+                    kMaxRatioDeviation);
+  ratio_ = clamp(1. + kProportionalGain * smoothedError_ + integral_, 1. - kMaxRatioDeviation,
+                 1. + kMaxRatioDeviation);
+  ratioOut_.store(ratio_, std::memory_order_relaxed);
+}
+
+void DriftCompensatedBuffer::read(float* const* pDest, size_t frames)
+{
+  frames = std::min(frames, maxFrames_);
+  auto silence = [&]() {
+    for (size_t c = 0; c < channels_; ++c)
+    {
+      std::fill(pDest[c], pDest[c] + frames, 0.f);
+    }
+  };
+
+  size_t available = fifo_.getReadAvailable();
+  if (!running_)
+  {
+    if (available < targetFrames_)
+    {
+      silence();
+      return;
+    }
+    running_ = true;
+    phase_ = 0.;
+    std::fill(x0_.begin(), x0_.end(), 0.f);
+    std::fill(x1_.begin(), x1_.end(), 0.f);
+  }
+
+  updateRatio(available);
+
+  // output j is at phase_ + j * ratio_ input frames after x0. The input frames after x1 are
+  // read into the scratch buffer.
+  size_t newFrames = size_t(phase_ + (frames - 1) * ratio_);
+  if (available < newFrames)
+  {
+    underflows_.store(underflows_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    running_ = false;
+    silence();
+    return;
+  }
+  fifo_.readPlanar(scratchPtrs_.data(), newFrames);
+
+  for (size_t c = 0; c < channels_; ++c)
+  {
+    const float* s = scratchPtrs_[c];
+    auto frame = [&](size_t k) { return (k == 0) ? x0_[c] : ((k == 1) ? x1_[c] : s[k - 2]); };
+    float* y = pDest[c];
+    double p = phase_;
+    for (size_t j = 0; j < frames; ++j)
+    {
+      size_t k = size_t(p);
+      float a = frame(k);
+      float b = frame(k + 1);
+      y[j] = a + (b - a) * float(p - k);
+      p += ratio_;
+    }
+    x0_[c] = frame(newFrames);
+    x1_[c] = frame(newFrames + 1);
+  }
+  phase_ += frames * ratio_ - newFrames;
+}
+
+// AudioEngine
+
+namespace
+{
+struct EngineProcess
+{
+  AudioContext* context;
+  SignalProcessFn fn;
+  void* state;
+  size_t firstInput;
+  size_t firstOutput;
+  std::unique_ptr<SignalProcessBuffer> buffer;
+
+  // pointers to this block's device inputs, and this process's own outputs.
+  std::vector<const float*> inputPtrs;
+  std::vector<float> outputData;
+  std::vector<float*> outputPtrs;
+};
+
+struct OutputDevice
+{
+  unsigned int deviceId;
+  size_t firstChannel;
+  size_t nChannels;
+  unsigned int bufferFrames;
+  std::unique_ptr<RtAudio> adac;
+  DriftCompensatedBuffer buffer;
+  std::vector<float*> outputPtrs;
+};
+}  // namespace
+
+struct AudioEngine::Impl
+{
+  size_t nInputs;
+  size_t nOutputs;
+  int sampleRate;
+  AudioEngineConfig config;
+  size_t maxFrames;
+
+  RtAudio adac;
+  std::unique_ptr<WorkerPool> pool;
+  std::vector<EngineProcess> processes;
+  std::vector<std::unique_ptr<OutputDevice>> outputDevices;
+
+  // the block being processed, for the worker tasks.
+  const float** blockInputs{nullptr};
+  int blockFrames{0};
+
+  // main device callback state.
+  std::vector<const float*> deviceInputs;
+  std::vector<float*> deviceOutputs;
+  std::vector<const float*> mixPtrs;
+  double periodSeconds{0.};
+  bool threadIsSetUp{false};
+  AudioCallbackStats stats;
+
+  static void setupWorker(void* context, size_t worker)
+  {
+    auto* impl = static_cast<Impl*>(context);
+    const auto& c = impl->config;
+    if (!c.workerCores.empty())
+    {
+      setCurrentThreadCore(c.workerCores[worker % c.workerCores.size()]);
+    }
+    else if (c.firstWorkerCore >= 0)
+    {
+      setCurrentThreadCore(c.firstWorkerCore + int(worker));
+    }
+    if (c.device.realtimeThread)
+    {
+      double period = double(c.device.bufferFrames) / impl->sampleRate;
+      setCurrentThreadRealtime(period, c.device.realtimePriority);
+    }
+  }
+
+  static void processTask(void* context, size_t i)
+  {
+    auto* impl = static_cast<Impl*>(context);
+    impl->runProcess(impl->processes[i]);
+  }
+
+  void runProcess(EngineProcess& p)
+  {
+    for (size_t c = 0; c < p.inputPtrs.size(); ++c)
+    {
+      size_t deviceChannel = p.firstInput + c;
+      p.inputPtrs[c] =
+          (blockInputs && (deviceChannel < nInputs)) ? blockInputs[deviceChannel] : nullptr;
+    }
+    p.buffer->process(p.inputPtrs.data(), p.outputPtrs.data(), blockFrames, p.context, p.fn,
+                      p.state);
+  }
+
+  void process(const float** inputs, float** outputs, int frames)
+  {
+    if ((frames <= 0) || (size_t(frames) > maxFrames)) return;
+
+    // run the processes, on the workers if there is more than one.
+    blockInputs = inputs;
+    blockFrames = frames;
+    if (pool && (processes.size() > 1))
+    {
+      pool->run(processes.size(), processTask, this);
+    }
+    else
+    {
+      for (auto& p : processes)
+      {
+        runProcess(p);
+      }
+    }
+
+    // mix the process outputs into the device outputs.
+    for (size_t c = 0; c < nOutputs; ++c)
+    {
+      if (outputs[c]) std::fill(outputs[c], outputs[c] + frames, 0.f);
+    }
+    for (auto& p : processes)
+    {
+      for (size_t c = 0; c < p.outputPtrs.size(); ++c)
+      {
+        size_t deviceChannel = p.firstOutput + c;
+        if ((deviceChannel >= nOutputs) || !outputs[deviceChannel]) continue;
+        float* pDest = outputs[deviceChannel];
+        const float* pSrc = p.outputPtrs[c];
+        for (int i = 0; i < frames; ++i)
+        {
+          pDest[i] += pSrc[i];
+        }
+      }
+    }
+
+    // send channels to the other output devices.
+    for (auto& d : outputDevices)
+    {
+      for (size_t c = 0; c < d->nChannels; ++c)
+      {
+        mixPtrs[c] = outputs[d->firstChannel + c];
+      }
+      d->buffer.write(mixPtrs.data(), frames);
+    }
+  }
+
+  static int mainCallback(void* outputBuffer, void* inputBuffer, unsigned int nBufferFrames,
+                          double /*streamTime*/, RtAudioStreamStatus status, void* callbackData)
+  {
+    auto* impl = static_cast<Impl*>(callbackData);
+    if (!impl->threadIsSetUp)
+    {
+      const auto& c = impl->config.device;
+      if (c.core >= 0) setCurrentThreadCore(c.core);
+      if (c.realtimeThread) setCurrentThreadRealtime(impl->periodSeconds, c.realtimePriority);
+      if (c.lockMemory) prefaultStack();
+      impl->threadIsSetUp = true;
+    }
+
+    const float* pInputBuffer = static_cast<const float*>(inputBuffer);
+    float* pOutputBuffer = static_cast<float*>(outputBuffer);
+    for (size_t i = 0; i < impl->nInputs; ++i)
+    {
+      impl->deviceInputs[i] = pInputBuffer ? pInputBuffer + i * nBufferFrames : nullptr;
+    }
+    for (size_t i = 0; i < impl->nOutputs; ++i)
+    {
+      impl->deviceOutputs[i] = pOutputBuffer + i * nBufferFrames;
+    }
+
+    uint64_t startTicks = TickClock::now();
+    impl->process(impl->deviceInputs.data(), impl->deviceOutputs.data(), int(nBufferFrames));
+    double elapsed = TickClock::secondsBetween(startTicks, TickClock::now());
+
+    double period = double(nBufferFrames) / impl->sampleRate;
+    impl->stats.record(elapsed, period, status != 0);
+    return 0;
+  }
+
+  static int outputDeviceCallback(void* outputBuffer, void* /*inputBuffer*/,
+                                  unsigned int nBufferFrames, double /*streamTime*/,
+                                  RtAudioStreamStatus /*status*/, void* callbackData)
+  {
+    auto* d = static_cast<OutputDevice*>(callbackData);
+    float* pOutputBuffer = static_cast<float*>(outputBuffer);
+    for (size_t c = 0; c < d->nChannels; ++c)
+    {
+      d->outputPtrs[c] = pOutputBuffer + c * nBufferFrames;
+    }
+    d->buffer.read(d->outputPtrs.data(), nBufferFrames);
+    return 0;
+  }
+};
+
+AudioEngine::AudioEngine(size_t nInputs, size_t nOutputs, int sampleRate,
+                         const AudioEngineConfig& config)
+    : pImpl(std::make_unique<Impl>())
+{
+  pImpl->nInputs = nInputs;
+  pImpl->nOutputs = nOutputs;
+  pImpl->sampleRate = sampleRate;
+  pImpl->config = config;
+  pImpl->maxFrames =
+      std::max(config.device.maxBlockSize, static_cast<int>(config.device.bufferFrames));
+  pImpl->deviceInputs.resize(nInputs);
+  pImpl->deviceOutputs.resize(nOutputs);
+  pImpl->mixPtrs.resize(nOutputs);
+
+  int nWorkers = config.workerThreads;
+  if (nWorkers < 0)
+  {
+    nWorkers = config.workerCores.empty()
+                   ? std::max(int(std::thread::hardware_concurrency()) - 1, 0)
+                   : int(config.workerCores.size());
+  }
+  if (nWorkers > 0)
+  {
+    pImpl->pool = std::make_unique<WorkerPool>(nWorkers, Impl::setupWorker, pImpl.get());
+  }
+}
+
+AudioEngine::~AudioEngine() { stop(); }
+
+size_t AudioEngine::addProcess(AudioContext* ctx, SignalProcessFn fn, void* state,
+                               size_t firstInput, size_t firstOutput)
+{
+  EngineProcess p;
+  p.context = ctx;
+  p.fn = fn;
+  p.state = state;
+  p.firstInput = firstInput;
+  p.firstOutput = firstOutput;
+
+  const size_t nIns = ctx->inputs.size();
+  const size_t nOuts = ctx->outputs.size();
+  const size_t maxFrames = pImpl->maxFrames;
+  p.buffer = std::make_unique<SignalProcessBuffer>(nIns, nOuts, maxFrames);
+  p.inputPtrs.resize(nIns);
+  p.outputData.resize(nOuts * maxFrames);
+  for (size_t c = 0; c < nOuts; ++c)
+  {
+    p.outputPtrs.push_back(p.outputData.data() + c * maxFrames);
+  }
+
+  pImpl->processes.push_back(std::move(p));
+  return pImpl->processes.size() - 1;
+}
+
+void AudioEngine::addOutputDevice(unsigned int deviceId, size_t firstChannel, size_t nChannels,
+                                  unsigned int bufferFrames)
+{
+  if (firstChannel + nChannels > pImpl->nOutputs) return;
+  auto d = std::make_unique<OutputDevice>();
+  d->deviceId = deviceId;
+  d->firstChannel = firstChannel;
+  d->nChannels = nChannels;
+  d->bufferFrames = bufferFrames ? bufferFrames : pImpl->config.device.bufferFrames;
+  d->outputPtrs.resize(nChannels);
+
+  // keep two of the larger of the two devices' buffers in reserve.
+  size_t maxFrames = std::max(pImpl->maxFrames, size_t(d->bufferFrames));
+  size_t target = 2 * std::max(d->bufferFrames, pImpl->config.device.bufferFrames);
+  d->buffer.resize(nChannels, maxFrames, target);
+  pImpl->outputDevices.push_back(std::move(d));
+}
+
+int AudioEngine::start()
+{
+  stop();
+  const AudioEngineConfig& config = pImpl->config;
+  const AudioTaskConfig& device = config.device;
+
+  RtAudio::StreamOptions options;
+  options.flags |= RTAUDIO_NONINTERLEAVED;
+  if (device.minimizeLatency) options.flags |= RTAUDIO_MINIMIZE_LATENCY;
+  if (device.hogDevice) options.flags |= RTAUDIO_HOG_DEVICE;
+  if (device.realtimeThread) options.flags |= RTAUDIO_SCHEDULE_REALTIME;
+  options.numberOfBuffers = device.numberOfBuffers;
+  if (device.realtimePriority > 0) options.priority = device.realtimePriority;
+
+  // open the main device.
+  RtAudio& adac = pImpl->adac;
+  RtAudio::StreamParameters iParams, oParams;
+  iParams.deviceId = device.inputDevice ? device.inputDevice : adac.getDefaultInputDevice();
+  iParams.nChannels = static_cast<unsigned int>(pImpl->nInputs);
+  oParams.deviceId = device.outputDevice ? device.outputDevice : adac.getDefaultOutputDevice();
+  oParams.nChannels = static_cast<unsigned int>(pImpl->nOutputs);
+  unsigned int bufferFrames = device.bufferFrames;
+  if (RTAUDIO_NO_ERROR != adac.openStream(&oParams, pImpl->nInputs ? &iParams : nullptr,
+                                          RTAUDIO_FLOAT32, pImpl->sampleRate, &bufferFrames,
+                                          &Impl::mainCallback, pImpl.get(), &options))
+  {
+    std::cout << adac.getErrorText() << std::endl;
+    return 0;
+  }
+  if (bufferFrames > pImpl->maxFrames)
+  {
+    std::cout << "[AudioEngine] device buffer of " << bufferFrames << " frames is too large\n";
+    adac.closeStream();
+    return 0;
+  }
+  pImpl->periodSeconds = double(bufferFrames) / pImpl->sampleRate;
+  pImpl->threadIsSetUp = false;
+
+  // calibrate the callback timer now, rather than on the audio thread.
+  TickClock::getTicksPerSecond();
+
+  if (device.lockMemory)
+  {
+    for (auto& p : pImpl->processes)
+    {
+      p.buffer->lockMemory();
+      lockAndPrefault(p.outputData.data(), p.outputData.size() * sizeof(float));
+      lockAndPrefault(p.context->scratch.getData(), p.context->scratch.getCapacity());
+    }
+  }
+
+  // open the other output devices, each with its own callback.
+  for (auto& d : pImpl->outputDevices)
+  {
+    d->adac = std::make_unique<RtAudio>();
+    RtAudio::StreamParameters params;
+    params.deviceId = d->deviceId;
+    params.nChannels = static_cast<unsigned int>(d->nChannels);
+    unsigned int frames = d->bufferFrames;
+    if ((RTAUDIO_NO_ERROR != d->adac->openStream(&params, nullptr, RTAUDIO_FLOAT32,
+                                                 pImpl->sampleRate, &frames,
+                                                 &Impl::outputDeviceCallback, d.get(), &options)) ||
+        (frames > d->bufferFrames))
+    {
+      std::cout << d->adac->getErrorText() << std::endl;
+      stop();
+      return 0;
+    }
+    size_t maxFrames = std::max(pImpl->maxFrames, size_t(frames));
+    d->buffer.resize(d->nChannels, maxFrames, 2 * std::max(frames, bufferFrames));
+  }
+
+  // start the other devices first, so that they are ready for the first main block.
+  for (auto& d : pImpl->outputDevices)
+  {
+    d->adac->startStream();
+  }
+  if (RTAUDIO_NO_ERROR != adac.startStream())
+  {
+    std::cout << adac.getErrorText() << std::endl;
+    stop();
+    return 0;
+  }
+  return 1;
+}
+
+void AudioEngine::stop()
+{
+  if (pImpl->adac.isStreamOpen())
+  {
+    if (pImpl->adac.isStreamRunning()) pImpl->adac.stopStream();
+    pImpl->adac.closeStream();
+  }
+  for (auto& d : pImpl->outputDevices)
+  {
+    if (d->adac && d->adac->isStreamOpen())
+    {
+      if (d->adac->isStreamRunning()) d->adac->stopStream();
+      d->adac->closeStream();
+    }
+    d->adac.reset();
+  }
+}
+
+void AudioEngine::process(const float** inputs, float** outputs, int frames)
+{
+  pImpl->process(inputs, outputs, frames);
+}
+
+size_t AudioEngine::getNumProcesses() const { return pImpl->processes.size(); }
+
+size_t AudioEngine::getNumWorkers() const
+{
+  return pImpl->pool ? pImpl->pool->getNumWorkers() : 0;
+}
+
+size_t AudioEngine::getNumOutputDevices() const { return pImpl->outputDevices.size(); }
+
+const DriftCompensatedBuffer& AudioEngine::getOutputDeviceBuffer(size_t i) const
+{
+  return pImpl->outputDevices[i]->buffer;
+}
+
+AudioCallbackStats& AudioEngine::getCallbackStats() { return pImpl->stats; }
+
+}  // namespace ml
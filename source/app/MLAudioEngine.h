@@ -0,0 +1,139 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// AudioEngine: run several audio processes on one device, and feed other output devices.
+//
+// Each process has its own AudioContext, function and state, like an AudioTask, and reads and
+// writes a range of the device's channels. In each callback of the main device the processes
+// run in parallel on one WorkerPool, whose threads can be pinned to cores and are scheduled for
+// real-time use. Their outputs are mixed into the device's output channels.
+//
+// Other output devices, such as monitors next to a main PA, are fed a range of the mixed output
+// channels through a DriftCompensatedBuffer that resamples slightly to follow their clocks.
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "MLAudioCallbackStats.h"
+#include "MLAudioContext.h"
+#include "MLAudioTask.h"
+#include "MLDSPBuffer.h"
+#include "MLSignalProcessBuffer.h"
+
+namespace ml
+{
+// DriftCompensatedBuffer: a single producer, single consumer buffer between two audio clocks
+// with slightly different rates. The reader resamples by linear interpolation at a ratio that
+// is steered to keep the buffer near its target fill level, so that it neither overflows nor
+// runs dry. Reading is silent until the buffer first fills to the target, and after it runs
+// dry until it fills again.
+
+class DriftCompensatedBuffer
+{
+ public:
+  // the largest ratio change from 1 the reader will make.
+  static constexpr double kMaxRatioDeviation{0.005};
+
+  // set up for the given channels, the largest number of frames in one write or read, and the
+  // fill level to keep, in frames.
+  void resize(size_t channels, size_t maxFrames, size_t targetFrames);
+
+  // write frames from a pointer for each channel. Frames that don't fit are dropped.
+  void write(const float* const* pSrc, size_t frames);
+
+  // read frames to a pointer for each channel.
+  void read(float* const* pDest, size_t frames);
+
+  // the number of frames read for each frame written, as last set by the reader.
+  double getRatio() const { return ratioOut_.load(std::memory_order_relaxed); }
+  size_t getFramesAvailable() const { return fifo_.getReadAvailable(); }
+  size_t getOverflowCount() const { return overflows_.load(std::memory_order_relaxed); }
+  size_t getUnderflowCount() const { return underflows_.load(std::memory_order_relaxed); }
+
+ private:
+  void updateRatio(size_t available);
+
+  MultiChannelDSPBuffer fifo_;
+  size_t channels_{0};
+  size_t maxFrames_{0};
+  size_t targetFrames_{0};
+
+  // reader state: the two input frames around the read position, and the position between.
+  std::vector<float> scratch_;
+  std::vector<float*> scratchPtrs_;
+  std::vector<float> x0_, x1_;
+  double phase_{0.};
+  double ratio_{1.};
+  double smoothedError_{0.};
+  double integral_{0.};
+  bool running_{false};
+
+  std::atomic<double> ratioOut_{1.};
+  std::atomic<size_t> overflows_{0};
+  std::atomic<size_t> underflows_{0};
+};
+
+struct AudioEngineConfig
+{
+  // the main device, which drives processing. Its sampleRate is not used: the engine's is.
+  AudioTaskConfig device;
+
+  // the number of worker threads in addition to the audio thread, or -1 for one for each core
+  // after the first.
+  int workerThreads{-1};
+
+  // pin worker i to core firstWorkerCore + i, or don't pin them if negative.
+  int firstWorkerCore{1};
+
+  // if not empty, pin worker i to workerCores[i] instead, as from planThreadPlacement(). With
+  // workerThreads of -1, there is then one worker for each of these cores.
+  std::vector<int> workerCores;
+};
+
+class AudioEngine
+{
+ public:
+  AudioEngine(size_t nInputs, size_t nOutputs, int sampleRate,
+              const AudioEngineConfig& config = AudioEngineConfig());
+  ~AudioEngine();
+
+  AudioEngine(const AudioEngine&) = delete;
+  AudioEngine& operator=(const AudioEngine&) = delete;
+
+  // add a process that reads device inputs from firstInput and mixes its outputs into device
+  // outputs from firstOutput. Channels past the end of the device are silent or dropped.
+  // Processes must be added before starting. Returns the index of the process.
+  size_t addProcess(AudioContext* ctx, SignalProcessFn fn, void* state, size_t firstInput = 0,
+                    size_t firstOutput = 0);
+
+  // send nChannels of the mixed outputs from firstChannel to another output device. A
+  // bufferFrames of 0 uses the main device's. Devices must be added before starting.
+  void addOutputDevice(unsigned int deviceId, size_t firstChannel, size_t nChannels,
+                       unsigned int bufferFrames = 0);
+
+  // open and start the main device and any other output devices. Returns 1 on success.
+  int start();
+  void stop();
+
+  // run all the processes for one block of device frames and feed the other output devices.
+  // This is what the main device callback does, and can also be called without a device.
+  void process(const float** inputs, float** outputs, int frames);
+
+  size_t getNumProcesses() const;
+  size_t getNumWorkers() const;
+  size_t getNumOutputDevices() const;
+  const DriftCompensatedBuffer& getOutputDeviceBuffer(size_t i) const;
+
+  // timing and xrun statistics for the main device callback.
+  AudioCallbackStats& getCallbackStats();
+
+ private:
+  struct Impl;
+  std::unique_ptr<Impl> pImpl;
+};
+
+}  // namespace ml
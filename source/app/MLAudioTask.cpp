@@ -5,6 +5,11 @@
 #include "MLPlatform.h"
 #include "MLAudioContext.h"
 #include "MLAudioTask.h"
+#include "MLSignalProcessor.h"
+#include "MLClock.h"
+#include "MLDSPDenormals.h"
+#include "MLMemoryUtils.h"
+#include "MLRealtimeThread.h"
 #include "MLSignalProcessBuffer.h"
 
 #include "rtaudio/RtAudio.h"
@@ -92,8 +97,6 @@ void waitForConsoleKeyPress()
 }
 #endif
 
-constexpr int kRtAudioCallbackFrames{512};
-
 struct AudioProcessData
 {
   // buffered processing
@@ -103,6 +106,19 @@ struct AudioProcessData
   AudioContext* processContext{nullptr};
   SignalProcessFn processFn{nullptr};
   void* processState{nullptr};
+
+  // callback thread setup, done on the first callback after each start.
+  bool realtimeThread{false};
+  int realtimePriority{0};
+  int core{-1};
+  bool lockMemory{false};
+  double periodSeconds{0.};
+  bool threadIsSetUp{false};
+
+  // true if the device buffers are not planar floats, and are converted by the buffer.
+  bool convertFormat{false};
+
+  AudioCallbackStats stats;
 };
 
 struct AudioTask::Impl
@@ -110,14 +126,34 @@ struct AudioTask::Impl
   // native audio task
   RtAudio adac;
 
+  AudioTaskConfig config;
+  unsigned int bufferFrames{0};
+
   AudioProcessData processData;
 
-  Impl(size_t nInputs, size_t nOutputs, size_t kMaxBlockSize)
+  Impl(size_t nInputs, size_t nOutputs, const AudioTaskConfig& c) : config(c)
   {
-    processData.buffer = std::make_unique<SignalProcessBuffer>(nInputs, nOutputs, kMaxBlockSize);
+    size_t maxFrames = std::max(config.maxBlockSize, static_cast<int>(config.bufferFrames));
+    processData.buffer = std::make_unique<SignalProcessBuffer>(nInputs, nOutputs, maxFrames);
   }
 };
 
+static RtAudioFormat getRtAudioFormat(SampleFormat f)
+{
+  switch (f)
+  {
+    case SampleFormat::kInt16:
+      return RTAUDIO_SINT16;
+    case SampleFormat::kInt24:
+      return RTAUDIO_SINT24;
+    case SampleFormat::kInt32:
+      return RTAUDIO_SINT32;
+    case SampleFormat::kFloat32:
+    default:
+      return RTAUDIO_FLOAT32;
+  }
+}
+
 // adapt the RtAudio process routine to a madronalib function operating on DSPBuffers.
 int RtAudioCallbackFn(void* outputBuffer, void* inputBuffer, unsigned int nBufferFrames,
                       double /*streamTime*/, RtAudioStreamStatus status, void* callbackData)
@@ -127,30 +163,61 @@ int RtAudioCallbackFn(void* outputBuffer, void* inputBuffer, unsigned int nBuffe
   // get process data from callback data
   auto pData = reinterpret_cast<AudioProcessData*>(callbackData);
 
-  if (status) std::cout << "Stream over/underflow detected." << std::endl;
+  // flush denormals during the callback, leaving the thread as it was for its owner.
+  UsingFlushDenormalsToZero flushDenormals(kFlushDenormalsAutomatically);
 
-  // make pointers to uninterlaced input and output frames for each channel.
-  const float* inputs[kMaxIOChannels];
-  float* outputs[kMaxIOChannels];
+  if (!pData->threadIsSetUp)
+  {
+    if (pData->core >= 0)
+    {
+      setCurrentThreadCore(pData->core);
+    }
+    if (pData->realtimeThread)
+    {
+      setCurrentThreadRealtime(pData->periodSeconds, pData->realtimePriority);
+    }
+    if (pData->lockMemory)
+    {
+      prefaultStack();
+    }
+    pData->threadIsSetUp = true;
+  }
 
-  // setup input and output pointers
-  const float* pInputBuffer = reinterpret_cast<const float*>(inputBuffer);
-  float* pOutputBuffer = reinterpret_cast<float*>(outputBuffer);
-  size_t nIns = std::min(kMaxIOChannels, pData->processContext->inputs.size());
-  size_t nOuts = std::min(kMaxIOChannels, pData->processContext->outputs.size());
-  for (int i = 0; i < nIns; ++i)
+  // Buffer the data to and from the outside world and run the process in DSPVector-sized chunks
+  // within the context.
+  uint64_t startTicks = TickClock::now();
+  if (pData->convertFormat)
   {
-    inputs[i] = pInputBuffer + i * nBufferFrames;
+    pData->buffer->process(inputBuffer, outputBuffer, nBufferFrames, pData->processContext,
+                           pData->processFn, pData->processState);
   }
-  for (int i = 0; i < nOuts; ++i)
+  else
   {
-    outputs[i] = pOutputBuffer + i * nBufferFrames;
+    // make pointers to uninterlaced input and output frames for each channel.
+    const float* inputs[kMaxIOChannels];
+    float* outputs[kMaxIOChannels];
+
+    // setup input and output pointers
+    const float* pInputBuffer = reinterpret_cast<const float*>(inputBuffer);
+    float* pOutputBuffer = reinterpret_cast<float*>(outputBuffer);
+    size_t nIns = std::min(kMaxIOChannels, pData->processContext->inputs.size());
+    size_t nOuts = std::min(kMaxIOChannels, pData->processContext->outputs.size());
+    for (int i = 0; i < nIns; ++i)
+    {
+      inputs[i] = pInputBuffer + i * nBufferFrames;
+    }
+    for (int i = 0; i < nOuts; ++i)
+    {
+      outputs[i] = pOutputBuffer + i * nBufferFrames;
+    }
+    pData->buffer->process(inputs, outputs, nBufferFrames, pData->processContext,
+                           pData->processFn, pData->processState);
   }
+  double elapsed = TickClock::secondsBetween(startTicks, TickClock::now());
 
-  // Buffer the data to and from the outside world and run the process in DSPVector-sized chunks
-  // within the context.
-  pData->buffer->process(inputs, outputs, nBufferFrames, pData->processContext, pData->processFn,
-                         pData->processState);
+  // status is nonzero if the device reported an input overflow or output underflow.
+  double period = nBufferFrames / pData->processContext->getSampleRate();
+  pData->stats.record(elapsed, period, status != 0);
   return 0;
 }
 
@@ -158,10 +225,11 @@ int RtAudioCallbackFn(void* outputBuffer, void* inputBuffer, unsigned int nBuffe
 // the DSP function. processFn points to a function that will be called by the SignalProcessBuffer.
 // state points to any persistent state that needs to be sent to the function.
 
-AudioTask::AudioTask(AudioContext* ctx, SignalProcessFn processFn, void* state)
+AudioTask::AudioTask(AudioContext* ctx, SignalProcessFn processFn, void* state,
+                     const AudioTaskConfig& config)
 {
   // make the world -> context buffers for each channel
-  pImpl = std::make_unique<Impl>(ctx->inputs.size(), ctx->outputs.size(), kMaxBlockSize);
+  pImpl = std::make_unique<Impl>(ctx->inputs.size(), ctx->outputs.size(), config);
 
   pImpl->processData.processContext = ctx;
   pImpl->processData.processFn = processFn;
@@ -191,26 +259,39 @@ int AudioTask::startAudio()
   // Let RtAudio print messages to stderr.
   pImpl->adac.showWarnings(true);
 
-  auto nInputs = pImpl->processData.processContext->inputs.size();
-  auto nOutputs = pImpl->processData.processContext->outputs.size();
-  int sampleRate = pImpl->processData.processContext->getSampleRate();
-  unsigned int bufferFrames = kRtAudioCallbackFrames;
+  const AudioTaskConfig& config = pImpl->config;
+  AudioContext* ctx = pImpl->processData.processContext;
+  auto nInputs = ctx->inputs.size();
+  auto nOutputs = ctx->outputs.size();
+  if ((config.sampleRate > 0) && (config.sampleRate != ctx->getSampleRate()))
+  {
+    ctx->setSampleRate(config.sampleRate);
+  }
+  int sampleRate = ctx->getSampleRate();
+  unsigned int bufferFrames = config.bufferFrames;
 
   // Set up RtAudio stream params
   RtAudio::StreamParameters iParams, oParams;
-  iParams.deviceId = pImpl->adac.getDefaultInputDevice();
+  iParams.deviceId = config.inputDevice ? config.inputDevice : pImpl->adac.getDefaultInputDevice();
   iParams.nChannels = static_cast<unsigned int>(nInputs);
   iParams.firstChannel = 0;
-  oParams.deviceId = pImpl->adac.getDefaultOutputDevice();
+  oParams.deviceId =
+      config.outputDevice ? config.outputDevice : pImpl->adac.getDefaultOutputDevice();
   oParams.nChannels = static_cast<unsigned int>(nOutputs);
   oParams.firstChannel = 0;
 
   RtAudio::StreamOptions options;
-  options.flags |= RTAUDIO_NONINTERLEAVED;
+  if (!config.interleaved) options.flags |= RTAUDIO_NONINTERLEAVED;
+  if (config.minimizeLatency) options.flags |= RTAUDIO_MINIMIZE_LATENCY;
+  if (config.hogDevice) options.flags |= RTAUDIO_HOG_DEVICE;
+  if (config.realtimeThread) options.flags |= RTAUDIO_SCHEDULE_REALTIME;
+  options.numberOfBuffers = config.numberOfBuffers;
+  if (config.realtimePriority > 0) options.priority = config.realtimePriority;
 
   auto pInputParams = (nInputs ? &iParams : nullptr);
 
-  if (RTAUDIO_NO_ERROR != pImpl->adac.openStream(&oParams, pInputParams, RTAUDIO_FLOAT32,
+  if (RTAUDIO_NO_ERROR != pImpl->adac.openStream(&oParams, pInputParams,
+                                                 getRtAudioFormat(config.sampleFormat),
                                                  sampleRate, &bufferFrames, &RtAudioCallbackFn,
                                                  &pImpl->processData, &options))
   {
@@ -218,6 +299,37 @@ int AudioTask::startAudio()
     return 0;
   }
 
+  // the device may have chosen a bigger buffer than we can process.
+  pImpl->bufferFrames = bufferFrames;
+  auto& processBuffer = pImpl->processData.buffer;
+  if (bufferFrames > processBuffer->getMaxFrames())
+  {
+    processBuffer = std::make_unique<SignalProcessBuffer>(nInputs, nOutputs, bufferFrames);
+  }
+  pImpl->processData.convertFormat =
+      config.interleaved || (config.sampleFormat != SampleFormat::kFloat32);
+  if (pImpl->processData.convertFormat)
+  {
+    processBuffer->setExternalFormat(config.sampleFormat, config.interleaved,
+                                     config.ditherOutput);
+  }
+
+  pImpl->processData.realtimeThread = config.realtimeThread;
+  pImpl->processData.realtimePriority = config.realtimePriority;
+  pImpl->processData.core = config.core;
+  pImpl->processData.lockMemory = config.lockMemory;
+  pImpl->processData.periodSeconds = double(bufferFrames) / sampleRate;
+  pImpl->processData.threadIsSetUp = false;
+  if (config.lockMemory)
+  {
+    processBuffer->lockMemory();
+    auto& scratch = pImpl->processData.processContext->scratch;
+    lockAndPrefault(scratch.getData(), scratch.getCapacity());
+  }
+
+  // calibrate the callback timer now, rather than on the audio thread.
+  TickClock::getTicksPerSecond();
+
   if (RTAUDIO_NO_ERROR != pImpl->adac.startStream())
   {
     std::cout << pImpl->adac.getErrorText() << std::endl;
@@ -255,6 +367,20 @@ int AudioTask::runConsoleApp()
   return 0;
 }
 
+const AudioTaskConfig& AudioTask::getConfig() const { return pImpl->config; }
+
+unsigned int AudioTask::getBufferFrames() const { return pImpl->bufferFrames; }
+
+size_t AudioTask::getLatencyInSamples(const SignalProcessor* processor) const
+{
+  size_t latency = pImpl->processData.buffer->getLatencyInSamples();
+  if (pImpl->adac.isStreamOpen()) latency += size_t(std::max(0L, pImpl->adac.getStreamLatency()));
+  if (processor) latency += processor->getLatencyInSamples();
+  return latency;
+}
+
+AudioCallbackStats& AudioTask::getCallbackStats() { return pImpl->processData.stats; }
+
 AudioTask::~AudioTask() = default;
 
 }  // namespace ml
@@ -2,10 +2,12 @@
 // Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
 // Distributed under the MIT license: http://madrona-labs.mit-license.org/
 
-// AudioTask: adaptor from RtAudio's main loop to madronalib vector processing
+// AudioTask: adaptor from RtAudio's main loop to madronalib vector processing. The callback
+// flushes denormals to zero while it runs.
 
 #pragma once
 
+#include "MLAudioCallbackStats.h"
 #include "MLSignalProcessBuffer.h"
 #include "MLSignalProcessor.h"
 #include "MLAudioContext.h"
@@ -14,18 +16,67 @@
 namespace ml
 {
 
+// AudioTaskConfig: settings for the audio device and the callback thread. The defaults are
+// safe for any device. For the lowest latency, use a small bufferFrames with
+// minimizeLatency, realtimeThread and lockMemory.
+
+struct AudioTaskConfig
+{
+  // frames per device callback. The device may choose a different size when the stream is
+  // opened. Smaller sizes give lower latency and use more CPU.
+  unsigned int bufferFrames{512};
+
+  // the maximum amount of input frames that can be proceesed at once. This determines the
+  // maximum signal vector size of the plugin host or enclosing app.
+  int maxBlockSize{4096};
+
+  // RtAudio device ids, or 0 to use the default devices.
+  unsigned int inputDevice{0};
+  unsigned int outputDevice{0};
+
+  // the sample rate to open the device at, or 0 to use the context's rate. If this differs
+  // from the context's rate, the context is set to this rate.
+  int sampleRate{0};
+
+  // RtAudio stream options. numberOfBuffers of 0 lets the device choose.
+  unsigned int numberOfBuffers{0};
+  bool minimizeLatency{false};
+  bool hogDevice{false};
+
+  // schedule the callback thread for real-time use: SCHED_FIFO on Linux, a time constraint
+  // policy on macOS and MMCSS "Pro Audio" on Windows. realtimePriority is the SCHED_FIFO
+  // priority, or 0 for a default near the top of the range.
+  bool realtimeThread{true};
+  int realtimePriority{0};
+
+  // pin the callback thread to this core, or leave it to the scheduler if negative. See
+  // planThreadPlacement() for choosing one.
+  int core{-1};
+
+  // lock the process buffers into memory, and touch them and the start of the callback
+  // thread's stack so that the first callbacks don't page fault.
+  bool lockMemory{true};
+
+  // the format of the device's buffers. Asking for the device's native format, such as
+  // interleaved kInt32 for many pro interfaces on Linux, lets RtAudio pass its buffers through
+  // without converting them. They are converted here with SIMD instead. Integer output is
+  // dithered if ditherOutput is set.
+  SampleFormat sampleFormat{SampleFormat::kFloat32};
+  bool interleaved{false};
+  bool ditherOutput{true};
+};
+
 // AudioTask: run an audio processing function in a context, with a state.
 // This is where any external audio I/O from a host or run loop is buffered into
 // kFloatsPerSignalVector-sized chunks.
 
+class SignalProcessor;
+
 class AudioTask
 {
-  // the maximum amount of input frames that can be proceesed at once. This determines the
-  // maximum signal vector size of the plugin host or enclosing app.
-  static constexpr int kMaxBlockSize{4096};
-
  public:
-  AudioTask(AudioContext* ctx, SignalProcessFn procFn, void* procState);
+  AudioTask(AudioContext* ctx, SignalProcessFn procFn, void* procState,
+            const AudioTaskConfig& config = AudioTaskConfig());
 
   ~AudioTask();
 
@@ -33,6 +84,18 @@ class AudioTask
   void stopAudio();
   int runConsoleApp();
 
+  const AudioTaskConfig& getConfig() const;
+
+  // the frames per callback chosen by the device, once audio is started.
+  unsigned int getBufferFrames() const;
+
+  // the total latency in frames from input to output, once audio is started: the device's
+  // stream latency, plus any added by buffering, plus the processor's declared latency.
+  size_t getLatencyInSamples(const SignalProcessor* processor = nullptr) const;
+
+  // timing and xrun statistics for the callback, which can be read from any thread.
+  AudioCallbackStats& getCallbackStats();
+
  private:
   struct Impl;
   std::unique_ptr<Impl> pImpl;
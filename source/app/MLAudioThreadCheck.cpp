@@ -0,0 +1,418 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLAudioThreadCheck.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+
+#include "MLPlatform.h"
+
+#if ML_MAC || ML_IOS || ML_LINUX
+#include <cxxabi.h>
+#include <dlfcn.h>
+#endif
+
+#ifdef ML_CHECK_AUDIO_THREAD
+#if defined(__GLIBC__)
+#include <pthread.h>
+#include <sched.h>
+#define ML_CHECK_AUDIO_THREAD_GLIBC 1
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define ML_CALL_SITE() reinterpret_cast<uintptr_t>(_ReturnAddress())
+#else
+#define ML_CALL_SITE() reinterpret_cast<uintptr_t>(__builtin_return_address(0))
+#endif
+#endif
+
+// the thread local mark must not need an allocation to be read, because it is read from inside
+// malloc: in a shared library the default TLS model can allocate on first use.
+#if defined(__GNUC__) && !defined(_WIN32)
+#define ML_INITIAL_EXEC_TLS __attribute__((tls_model("initial-exec")))
+#else
+#define ML_INITIAL_EXEC_TLS
+#endif
+
+namespace ml
+{
+namespace audioThreadCheck
+{
+static thread_local int gScopeDepth ML_INITIAL_EXEC_TLS{0};
+
+int& scopeDepth() { return gScopeDepth; }
+
+// a fixed size hash table of call sites, filled in without locks. Each key is a call site with
+// the kind in its low bits. Once the table is full, further call sites are only counted in
+// droppedCount.
+constexpr size_t kTableSize{1024};
+static std::atomic<uintptr_t> keys[kTableSize];
+static std::atomic<uint64_t> counts[kTableSize];
+static std::atomic<uint64_t> droppedCount{0};
+static std::atomic<uint64_t> totalCount{0};
+
+static uintptr_t makeKey(AudioThreadViolationKind kind, uintptr_t callSite)
+{
+  return (callSite << 2) | uintptr_t(kind);
+}
+}  // namespace audioThreadCheck
+
+void recordAudioThreadViolation(AudioThreadViolationKind kind, uintptr_t callSite)
+{
+  using namespace audioThreadCheck;
+  totalCount.fetch_add(1, std::memory_order_relaxed);
+
+  const uintptr_t key = makeKey(kind, callSite);
+  size_t i = (key * uintptr_t(0x9E3779B97F4A7C15ULL)) >> 7;
+  for (size_t probes = 0; probes < kTableSize; ++probes, ++i)
+  {
+    i &= kTableSize - 1;
+    uintptr_t k = keys[i].load(std::memory_order_relaxed);
+    if (k == 0)
+    {
+      // claim the empty slot, or find out who did.
+      if (keys[i].compare_exchange_strong(k, key, std::memory_order_relaxed))
+      {
+        k = key;
+      }
+    }
+    if (k == key)
+    {
+      counts[i].fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+  }
+  droppedCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::vector<AudioThreadViolation> getAudioThreadViolations()
+{
+  using namespace audioThreadCheck;
+  std::vector<AudioThreadViolation> v;
+  for (size_t i = 0; i < kTableSize; ++i)
+  {
+    const uintptr_t k = keys[i].load(std::memory_order_relaxed);
+    const uint64_t n = counts[i].load(std::memory_order_relaxed);
+    if (k && n)
+    {
+      v.push_back({AudioThreadViolationKind(k & 3), k >> 2, n});
+    }
+  }
+  std::sort(v.begin(), v.end(), [](const AudioThreadViolation& a, const AudioThreadViolation& b) {
+    return a.count > b.count;
+  });
+  return v;
+}
+
+uint64_t getAudioThreadViolationCount()
+{
+  return audioThreadCheck::totalCount.load(std::memory_order_relaxed);
+}
+
+void clearAudioThreadViolations()
+{
+  using namespace audioThreadCheck;
+  for (size_t i = 0; i < kTableSize; ++i)
+  {
+    counts[i].store(0, std::memory_order_relaxed);
+  }
+  droppedCount.store(0, std::memory_order_relaxed);
+  totalCount.store(0, std::memory_order_relaxed);
+}
+
+void printAudioThreadViolations(std::ostream& out)
+{
+  static const char* kKindNames[]{"allocate", "free", "lock"};
+  const auto violations = getAudioThreadViolations();
+  out << getAudioThreadViolationCount() << " audio thread violations at " << violations.size()
+      << " call sites\n";
+  for (const auto& v : violations)
+  {
+    out << std::setw(10) << v.count << "  " << std::setw(8) << kKindNames[int(v.kind)] << "  0x"
+        << std::hex << v.callSite << std::dec;
+#if ML_MAC || ML_IOS || ML_LINUX
+    Dl_info info;
+    if (dladdr(reinterpret_cast<void*>(v.callSite), &info))
+    {
+      if (info.dli_sname)
+      {
+        int status{0};
+        char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        out << "  " << ((status == 0) ? demangled : info.dli_sname);
+        std::free(demangled);
+      }
+      if (info.dli_fname)
+      {
+        // the offset into the module, for addr2line or atos.
+        const auto base = reinterpret_cast<uintptr_t>(info.dli_fbase);
+        out << "  (" << info.dli_fname << " +0x" << std::hex << (v.callSite - base) << std::dec
+            << ")";
+      }
+    }
+#endif
+    out << "\n";
+  }
+  const uint64_t dropped = audioThreadCheck::droppedCount.load(std::memory_order_relaxed);
+  if (dropped)
+  {
+    out << dropped << " more violations at call sites that didn't fit in the table\n";
+  }
+}
+
+}  // namespace ml
+
+// ----------------------------------------------------------------
+// interceptors
+
+#ifdef ML_CHECK_AUDIO_THREAD
+
+namespace
+{
+#if ML_CHECK_AUDIO_THREAD_GLIBC
+extern "C" void* __libc_malloc(size_t);
+extern "C" void* __libc_calloc(size_t, size_t);
+extern "C" void* __libc_realloc(void*, size_t);
+extern "C" void __libc_free(void*);
+
+inline void* rawMalloc(size_t n) { return __libc_malloc(n); }
+inline void rawFree(void* p) { __libc_free(p); }
+#else
+inline void* rawMalloc(size_t n) { return std::malloc(n); }
+inline void rawFree(void* p) { std::free(p); }
+#endif
+
+inline void noteAllocate(uintptr_t callSite)
+{
+  if (ml::audioThreadCheck::gScopeDepth > 0)
+  {
+    ml::recordAudioThreadViolation(ml::AudioThreadViolationKind::kAllocate, callSite);
+  }
+}
+
+inline void noteFree(void* p, uintptr_t callSite)
+{
+  if (p && (ml::audioThreadCheck::gScopeDepth > 0))
+  {
+    ml::recordAudioThreadViolation(ml::AudioThreadViolationKind::kFree, callSite);
+  }
+}
+
+// allocate like the default operator new: call the new handler until there is memory.
+void* newOrNull(size_t n)
+{
+  for (;;)
+  {
+    if (void* p = rawMalloc(n ? n : 1)) return p;
+    std::new_handler handler = std::get_new_handler();
+    if (!handler) return nullptr;
+    handler();
+  }
+}
+
+void* newOrThrow(size_t n)
+{
+  void* p = newOrNull(n);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+// aligned allocations keep the pointer from rawMalloc just before the aligned block.
+void* alignedNewOrNull(size_t n, std::align_val_t al)
+{
+  const size_t align = std::max(size_t(al), sizeof(void*));
+  void* p = newOrNull(n + align + sizeof(void*));
+  if (!p) return nullptr;
+  auto u = reinterpret_cast<uintptr_t>(p) + sizeof(void*);
+  u = (u + align - 1) & ~uintptr_t(align - 1);
+  reinterpret_cast<void**>(u)[-1] = p;
+  return reinterpret_cast<void*>(u);
+}
+
+void* alignedNewOrThrow(size_t n, std::align_val_t al)
+{
+  void* p = alignedNewOrNull(n, al);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void alignedFree(void* p)
+{
+  if (p) rawFree(static_cast<void**>(p)[-1]);
+}
+}  // namespace
+
+void* operator new(size_t n)
+{
+  noteAllocate(ML_CALL_SITE());
+  return newOrThrow(n);
+}
+void* operator new[](size_t n)
+{
+  noteAllocate(ML_CALL_SITE());
+  return newOrThrow(n);
+}
+void* operator new(size_t n, const std::nothrow_t&) noexcept
+{
+  noteAllocate(ML_CALL_SITE());
+  return newOrNull(n);
+}
+void* operator new[](size_t n, const std::nothrow_t&) noexcept
+{
+  noteAllocate(ML_CALL_SITE());
+  return newOrNull(n);
+}
+void* operator new(size_t n, std::align_val_t al)
+{
+  noteAllocate(ML_CALL_SITE());
+  return alignedNewOrThrow(n, al);
+}
+void* operator new[](size_t n, std::align_val_t al)
+{
+  noteAllocate(ML_CALL_SITE());
+  return alignedNewOrThrow(n, al);
+}
+void* operator new(size_t n, std::align_val_t al, const std::nothrow_t&) noexcept
+{
+  noteAllocate(ML_CALL_SITE());
+  return alignedNewOrNull(n, al);
+}
+void* operator new[](size_t n, std::align_val_t al, const std::nothrow_t&) noexcept
+{
+  noteAllocate(ML_CALL_SITE());
+  return alignedNewOrNull(n, al);
+}
+
+void operator delete(void* p) noexcept
+{
+  noteFree(p, ML_CALL_SITE());
+  rawFree(p);
+}
+void operator delete[](void* p) noexcept
+{
+  noteFree(p, ML_CALL_SITE());
+  rawFree(p);
+}
+void operator delete(void* p, size_t) noexcept
+{
+  noteFree(p, ML_CALL_SITE());
+  rawFree(p);
+}
+void operator delete[](void* p, size_t) noexcept
+{
+  noteFree(p, ML_CALL_SITE());
+  rawFree(p);
+}
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+  noteFree(p, ML_CALL_SITE());
+  rawFree(p);
+}
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+  noteFree(p, ML_CALL_SITE());
+  rawFree(p);
+}
+void operator delete(void* p, std::align_val_t) noexcept
+{
+  noteFree(p, ML_CALL_SITE());
+  alignedFree(p);
+}
+void operator delete[](void* p, std::align_val_t) noexcept
+{
+  noteFree(p, ML_CALL_SITE());
+  alignedFree(p);
+}
+void operator delete(void* p, size_t, std::align_val_t) noexcept
+{
+  noteFree(p, ML_CALL_SITE());
+  alignedFree(p);
+}
+void operator delete[](void* p, size_t, std::align_val_t) noexcept
+{
+  noteFree(p, ML_CALL_SITE());
+  alignedFree(p);
+}
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+  noteFree(p, ML_CALL_SITE());
+  alignedFree(p);
+}
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+  noteFree(p, ML_CALL_SITE());
+  alignedFree(p);
+}
+
+#if ML_CHECK_AUDIO_THREAD_GLIBC
+
+// with glibc, the C allocation functions and pthread_mutex_lock can be replaced by defining
+// them in the program.
+extern "C"
+{
+  void* malloc(size_t n)
+  {
+    noteAllocate(ML_CALL_SITE());
+    return __libc_malloc(n);
+  }
+
+  void* calloc(size_t count, size_t n)
+  {
+    noteAllocate(ML_CALL_SITE());
+    return __libc_calloc(count, n);
+  }
+
+  void* realloc(void* p, size_t n)
+  {
+    noteAllocate(ML_CALL_SITE());
+    return __libc_realloc(p, n);
+  }
+
+  void free(void* p)
+  {
+    noteFree(p, ML_CALL_SITE());
+    __libc_free(p);
+  }
+
+  using PthreadMutexLockFn = int (*)(pthread_mutex_t*);
+  static std::atomic<PthreadMutexLockFn> gRealMutexLock{nullptr};
+
+  // find the real pthread_mutex_lock before main() runs, so that this never happens on the
+  // audio thread.
+  __attribute__((constructor)) static void findRealMutexLock()
+  {
+    gRealMutexLock.store(
+        reinterpret_cast<PthreadMutexLockFn>(dlsym(RTLD_NEXT, "pthread_mutex_lock")),
+        std::memory_order_release);
+  }
+
+  int pthread_mutex_lock(pthread_mutex_t* m)
+  {
+    if (ml::audioThreadCheck::gScopeDepth > 0)
+    {
+      ml::recordAudioThreadViolation(ml::AudioThreadViolationKind::kLock, ML_CALL_SITE());
+    }
+    if (auto realLock = gRealMutexLock.load(std::memory_order_acquire))
+    {
+      return realLock(m);
+    }
+
+    // before the real function is found, spin on trylock.
+    int r;
+    while ((r = pthread_mutex_trylock(m)) == EBUSY)
+    {
+      sched_yield();
+    }
+    return r;
+  }
+}
+
+#endif  // ML_CHECK_AUDIO_THREAD_GLIBC
+
+#endif  // ML_CHECK_AUDIO_THREAD
@@ -0,0 +1,97 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// MLAudioThreadCheck.h
+// Finding heap allocations and locks on the audio thread.
+//
+// Allocating memory or taking a mutex in a callback can block the audio thread for an unbounded
+// time, and these are often hidden: a Symbol made from new text, a std::vector growing, a Tree
+// node added by operator[]. To find them, define ML_CHECK_AUDIO_THREAD (the CMake option of
+// the same name). Then code inside an AudioThreadScope is marked as being on the audio thread.
+// SignalProcessBuffer::process() makes one, so the AudioTask, AudioEngine and OfflineAudioTask
+// callbacks are all covered.
+//
+// While the mark is set, every operator new and delete is recorded with the address it was
+// called from. With glibc, so are malloc, calloc, realloc, free and pthread_mutex_lock, which
+// std::mutex uses. Recording takes no locks and allocates nothing, and code that isn't marked
+// only pays for reading a thread local flag, so the check can be left on in testing builds.
+// Any thread can read the results:
+//
+//   printAudioThreadViolations(std::cout);
+//
+// In other builds, scopes do nothing and there are never any violations.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace ml
+{
+#ifdef ML_CHECK_AUDIO_THREAD
+constexpr bool kCheckingAudioThread{true};
+#else
+constexpr bool kCheckingAudioThread{false};
+#endif
+
+enum class AudioThreadViolationKind
+{
+  kAllocate,
+  kFree,
+  kLock
+};
+
+struct AudioThreadViolation
+{
+  AudioThreadViolationKind kind;
+
+  // the address of the call to the allocation or lock function.
+  uintptr_t callSite;
+  uint64_t count;
+};
+
+namespace audioThreadCheck
+{
+// nonzero while the current thread is inside an AudioThreadScope.
+int& scopeDepth();
+}  // namespace audioThreadCheck
+
+// AudioThreadScope: marks the current thread as the audio thread while the scope lasts.
+// Scopes can be nested.
+struct AudioThreadScope
+{
+#ifdef ML_CHECK_AUDIO_THREAD
+  AudioThreadScope() { ++audioThreadCheck::scopeDepth(); }
+  ~AudioThreadScope() { --audioThreadCheck::scopeDepth(); }
+#else
+  AudioThreadScope() = default;
+#endif
+  AudioThreadScope(const AudioThreadScope&) = delete;
+  AudioThreadScope& operator=(const AudioThreadScope&) = delete;
+};
+
+// true if the current thread is inside an AudioThreadScope.
+inline bool isMarkedAudioThread()
+{
+  return kCheckingAudioThread && (audioThreadCheck::scopeDepth() > 0);
+}
+
+// record a violation at a call site. The interceptors call this, and code that blocks in ways
+// they can't see can call it directly.
+void recordAudioThreadViolation(AudioThreadViolationKind kind, uintptr_t callSite);
+
+// the violations recorded so far, one entry per kind and call site, most frequent first.
+std::vector<AudioThreadViolation> getAudioThreadViolations();
+
+// the total number of violations recorded.
+uint64_t getAudioThreadViolationCount();
+
+void clearAudioThreadViolations();
+
+// print the violations with the function and module of each call site where they can be found.
+void printAudioThreadViolations(std::ostream& out);
+
+}  // namespace ml
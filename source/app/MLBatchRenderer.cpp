@@ -0,0 +1,123 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLBatchRenderer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <thread>
+
+#include "MLRealtimeThread.h"
+#include "MLSerialization.h"
+
+namespace ml
+{
+namespace
+{
+void processVectorFn(AudioContext* context, void* state)
+{
+  auto* processor = static_cast<SignalProcessor*>(state);
+  processor->updateParamSnapshot();
+  processor->processVector(context->inputs, context->outputs, context);
+}
+}  // namespace
+
+BatchRenderer::BatchRenderer(ProcessorFactory factory, const BatchRenderConfig& config)
+    : factory_(std::move(factory)), config_(config)
+{
+}
+
+std::vector<BatchRenderResult> BatchRenderer::render(const std::vector<Tree<Value>>& presets)
+{
+  std::vector<BatchRenderResult> results(presets.size());
+  if (presets.empty()) return results;
+
+  size_t nThreads = config_.threads ? config_.threads
+                                    : std::max(size_t(std::thread::hardware_concurrency()), size_t(1));
+  nThreads = std::min(nThreads, presets.size());
+
+  // each result is written by the one worker that claimed its preset.
+  std::atomic<size_t> nextPreset{0};
+  auto work = [&](size_t worker)
+  {
+    if (config_.pinThreads) setCurrentThreadCore(int(worker));
+    for (size_t i = nextPreset++; i < presets.size(); i = nextPreset++)
+    {
+      results[i] = renderPreset(presets[i], i);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t t = 1; t < nThreads; ++t)
+  {
+    threads.emplace_back(work, t);
+  }
+  work(0);
+  for (auto& t : threads)
+  {
+    t.join();
+  }
+  return results;
+}
+
+BatchRenderResult BatchRenderer::renderPreset(const Tree<Value>& preset, size_t index) const
+{
+  std::unique_ptr<SignalProcessor> processor = factory_();
+  if (!processor) return BatchRenderResult{};
+  processor->setSampleRate(config_.sampleRate);
+  for (auto it = preset.begin(); it != preset.end(); ++it)
+  {
+    const Value& v = *it;
+    if (v.getType() == Value::kFloat)
+    {
+      processor->setParamFromNormalizedValue(it.getCurrentPath(), v.getFloatValue());
+    }
+  }
+  processor->publishParams();
+
+  AudioContext context(config_.nInputs, config_.nOutputs, int(config_.sampleRate));
+  if (config_.polyphony > 0) context.setInputPolyphony(config_.polyphony);
+  OfflineAudioTask task(&context, processVectorFn, processor.get(), config_.blockSize);
+  task.setHashOutput(true);
+  for (const auto& e : script_)
+  {
+    task.addEvent(e.event, e.frame);
+  }
+
+  BatchRenderResult result;
+  if (config_.outputDirectory.empty())
+  {
+    std::vector<float> output(config_.nOutputs * config_.frames);
+    std::vector<float*> outputPtrs;
+    for (size_t c = 0; c < config_.nOutputs; ++c)
+    {
+      outputPtrs.push_back(output.data() + c * config_.frames);
+    }
+    task.render(outputPtrs.data(), config_.frames);
+    result.ok = true;
+  }
+  else
+  {
+    char name[32];
+    snprintf(name, sizeof(name), "/%05zu.wav", index);
+    std::string path = config_.outputDirectory + name;
+    result.ok = task.renderToWavFile(path.c_str(), config_.frames, config_.format);
+  }
+  result.hash = task.getOutputHash();
+  return result;
+}
+
+Tree<Value> BatchRenderer::readPresetFile(const char* path)
+{
+  std::ifstream file(path, std::ios::binary);
+  if (!file) return Tree<Value>();
+  std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)),
+                             std::istreambuf_iterator<char>());
+  return bytesToValueTree(bytes.data(), bytes.size());
+}
+
+}  // namespace ml
@@ -0,0 +1,92 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// BatchRenderer: render many presets of a SignalProcessor through the same events, in parallel,
+// for checking a bank of sounds.
+//
+// Each preset is a Tree<Value> of normalized parameter values. The presets are claimed in turn
+// by worker threads, each pinned to its own core if asked. A worker renders a preset with a new
+// processor from the factory function and a new AudioContext and OfflineAudioTask, so the
+// workers share nothing but the claim counter, and the results don't depend on which worker
+// rendered which preset or in what order. Each render is hashed, and can also be written to a
+// WAV file.
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "MLOfflineAudioTask.h"
+#include "MLSignalProcessor.h"
+#include "MLTree.h"
+#include "MLValue.h"
+
+namespace ml
+{
+
+struct BatchRenderConfig
+{
+  double sampleRate{48000.};
+  size_t frames{48000};
+  size_t nInputs{0};
+  size_t nOutputs{2};
+
+  // voices for note events in the script, or 0 for none.
+  int polyphony{0};
+  int blockSize{OfflineAudioTask::kDefaultBlockSize};
+
+  // worker threads, or 0 for one per core.
+  size_t threads{0};
+  bool pinThreads{true};
+
+  // if not empty, each render is also written here as <preset index>.wav.
+  std::string outputDirectory;
+  OfflineAudioTask::FileFormat format{OfflineAudioTask::FileFormat::kFloat32};
+};
+
+struct BatchRenderResult
+{
+  // an FNV-1a hash of the output, as from OfflineAudioTask::getOutputHash().
+  uint64_t hash{0};
+
+  // false if the file could not be written.
+  bool ok{false};
+};
+
+class BatchRenderer
+{
+ public:
+  using ProcessorFactory = std::function<std::unique_ptr<SignalProcessor>()>;
+
+  struct ScriptEvent
+  {
+    uint64_t frame;
+    Event event;
+  };
+
+  // the factory is called on the worker threads, at the same time, so it must not change any
+  // shared state.
+  BatchRenderer(ProcessorFactory factory, const BatchRenderConfig& config);
+  ~BatchRenderer() = default;
+
+  // the events sent to each preset, at frames from the start of its render.
+  void setScript(const std::vector<ScriptEvent>& script) { script_ = script; }
+
+  // render each preset and return the results in the same order.
+  std::vector<BatchRenderResult> render(const std::vector<Tree<Value>>& presets);
+
+  // read a preset from a JSON or binary file. Returns an empty tree if the file can't be read.
+  static Tree<Value> readPresetFile(const char* path);
+
+ private:
+  BatchRenderResult renderPreset(const Tree<Value>& preset, size_t index) const;
+
+  ProcessorFactory factory_;
+  BatchRenderConfig config_;
+  std::vector<ScriptEvent> script_;
+};
+
+}  // namespace ml
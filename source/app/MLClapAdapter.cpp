@@ -0,0 +1,358 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLClapAdapter.h"
+
+#include <algorithm>
+#include <limits>
+#include <thread>
+
+#include "MLMIDI.h"
+
+namespace ml
+{
+
+ClapProcessAdapter::ClapProcessAdapter(SignalProcessor& processor, size_t nInputs,
+                                       size_t nOutputs)
+    : processor_(processor), nInputs_(nInputs), nOutputs_(nOutputs)
+{
+  inputs_.resize(nInputs_);
+  outputs_.resize(nOutputs_);
+  events_.resize(kMaxEventsPerBlock);
+  paramChanges_.resize(kMaxEventsPerBlock);
+  modChanges_.resize(kMaxEventsPerBlock);
+
+  nParams_ = processor_.getParameterTree().getNumCompiledParameters();
+  normalizedParams_ = std::make_unique<std::atomic<float>[]>(nParams_);
+  for (size_t id = 0; id < nParams_; ++id)
+  {
+    normalizedParams_[id].store(processor_.getNormalizedFloatParam(id), std::memory_order_relaxed);
+  }
+}
+
+void ClapProcessAdapter::activate(double sampleRate, uint32_t maxFrames)
+{
+  context_ = std::make_unique<AudioContext>(nInputs_, nOutputs_, int(sampleRate));
+  context_->setSampleRate(int(sampleRate));
+  processBuffer_ = std::make_unique<SignalProcessBuffer>(nInputs_, nOutputs_, maxFrames);
+  processor_.setSampleRate(sampleRate);
+  reportedLatency_ = getLatency();
+}
+
+void ClapProcessAdapter::deactivate()
+{
+  processBuffer_.reset();
+  context_.reset();
+}
+
+float ClapProcessAdapter::getNormalizedParam(size_t id) const
+{
+  return (id < nParams_) ? normalizedParams_[id].load(std::memory_order_relaxed) : 0.f;
+}
+
+clap_process_status ClapProcessAdapter::process(const clap_process_t* process)
+{
+  if (!context_ || !processBuffer_) return CLAP_PROCESS_ERROR;
+
+  // map the host's channels onto our inputs and outputs. Missing inputs are silent.
+  size_t c = 0;
+  for (uint32_t i = 0; i < process->audio_inputs_count; ++i)
+  {
+    const clap_audio_buffer_t& port = process->audio_inputs[i];
+    for (uint32_t j = 0; (j < port.channel_count) && (c < nInputs_); ++j)
+    {
+      inputs_[c++] = port.data32 ? port.data32[j] : nullptr;
+    }
+  }
+  std::fill(inputs_.begin() + c, inputs_.end(), nullptr);
+
+  c = 0;
+  for (uint32_t i = 0; i < process->audio_outputs_count; ++i)
+  {
+    const clap_audio_buffer_t& port = process->audio_outputs[i];
+    for (uint32_t j = 0; (j < port.channel_count) && (c < nOutputs_); ++j)
+    {
+      outputs_[c++] = port.data32 ? port.data32[j] : nullptr;
+    }
+  }
+  std::fill(outputs_.begin() + c, outputs_.end(), nullptr);
+
+  updateTime(process->transport);
+  readEvents(process->in_events);
+  context_->addInputEvents(events_.data(), nEvents_, true);
+  if (recorder_)
+  {
+    recorder_->recordEvents(events_.data(), nEvents_);
+    recordParamChanges(false);
+    recorder_->recordBlock(inputs_.data(), process->frames_count);
+  }
+
+  vectorEnd_ = 0;
+  nextParamChange_ = 0;
+  nextModChange_ = 0;
+  inProcess_ = true;
+  processBuffer_->process(inputs_.data(), outputs_.data(), int(process->frames_count),
+                          context_.get(), processVectorFn, this);
+  inProcess_ = false;
+
+  // changes after the last vector of a buffered block still apply.
+  applyParamChanges(std::numeric_limits<int>::max());
+  applyModChanges(std::numeric_limits<int>::max());
+
+  // a new latency is read by the host when it restarts the plugin.
+  processor_.takeLatencyChange();
+  uint32_t latency = getLatency();
+  if (latency != reportedLatency_)
+  {
+    reportedLatency_ = latency;
+    if (host_ && host_->request_restart) host_->request_restart(host_);
+  }
+  return CLAP_PROCESS_CONTINUE;
+}
+
+void ClapProcessAdapter::flush(const clap_input_events_t* events)
+{
+  readEvents(events);
+  if (recorder_) recordParamChanges(true);
+  nextParamChange_ = 0;
+  nextModChange_ = 0;
+  applyParamChanges(std::numeric_limits<int>::max());
+  applyModChanges(std::numeric_limits<int>::max());
+}
+
+void ClapProcessAdapter::setVoiceModulation(VoiceModulation* modulation)
+{
+  modulation_ = modulation;
+  voiceKeys_.assign(modulation ? modulation->getNumVoices() : 0, 0);
+}
+
+void ClapProcessAdapter::setHost(const clap_host_t* host)
+{
+  host_ = host;
+  hostThreadPool_ = nullptr;
+  if (host && host->get_extension)
+  {
+    hostThreadPool_ =
+        static_cast<const clap_host_thread_pool_t*>(host->get_extension(host, CLAP_EXT_THREAD_POOL));
+  }
+}
+
+uint32_t ClapProcessAdapter::getLatency() const
+{
+  size_t bufferLatency = processBuffer_ ? processBuffer_->getLatencyInSamples() : 0;
+  return uint32_t(processor_.getLatencyInSamples() + bufferLatency);
+}
+
+HostTaskPool ClapProcessAdapter::getHostTaskPool()
+{
+  if (!hasHostThreadPool()) return HostTaskPool{};
+
+  // CLAP doesn't say how many threads the host has, so assume all of them.
+  size_t nThreads = std::max(std::thread::hardware_concurrency(), 1u);
+  return HostTaskPool{runOnHost, this, nThreads};
+}
+
+void ClapProcessAdapter::execHostTask(uint32_t taskIndex)
+{
+  if (hostTaskFn_) hostTaskFn_(hostTaskContext_, taskIndex);
+}
+
+bool ClapProcessAdapter::runOnHost(void* poolContext, size_t nTasks, WorkerPool::TaskFn fn,
+                                   void* taskContext)
+{
+  auto* adapter = static_cast<ClapProcessAdapter*>(poolContext);
+  if (!adapter->inProcess_) return false;
+
+  adapter->hostTaskFn_ = fn;
+  adapter->hostTaskContext_ = taskContext;
+  bool done = adapter->hostThreadPool_->request_exec(adapter->host_, uint32_t(nTasks));
+  adapter->hostTaskFn_ = nullptr;
+  return done;
+}
+
+void ClapProcessAdapter::processVectorFn(AudioContext* context, void* state)
+{
+  auto* adapter = static_cast<ClapProcessAdapter*>(state);
+  // apply the changes up to the end of this vector.
+  adapter->vectorEnd_ += kFloatsPerDSPVector;
+  adapter->applyParamChanges(adapter->vectorEnd_);
+  adapter->applyModChanges(adapter->vectorEnd_);
+  adapter->processor_.updateParamSnapshot();
+  adapter->processor_.updateParamRamps();
+  adapter->processor_.processVector(context->inputs, context->outputs, context);
+}
+
+void ClapProcessAdapter::readEvents(const clap_input_events_t* events)
+{
+  nEvents_ = 0;
+  nParamChanges_ = 0;
+  nModChanges_ = 0;
+  if (!events) return;
+
+  const uint32_t n = events->size(events);
+  for (uint32_t i = 0; i < n; ++i)
+  {
+    const clap_event_header_t* header = events->get(events, i);
+    if (header->space_id != CLAP_CORE_EVENT_SPACE_ID) continue;
+
+    const int time = int(header->time);
+    if (header->type == CLAP_EVENT_PARAM_VALUE)
+    {
+      const auto* p = reinterpret_cast<const clap_event_param_value_t*>(header);
+      if (nParamChanges_ < paramChanges_.size())
+      {
+        paramChanges_[nParamChanges_++] = {time, p->param_id, float(p->value)};
+      }
+      else
+      {
+        droppedEvents_++;
+      }
+      continue;
+    }
+    if (header->type == CLAP_EVENT_PARAM_MOD)
+    {
+      const auto* m = reinterpret_cast<const clap_event_param_mod_t*>(header);
+      if (!modulation_) continue;
+      if (nModChanges_ < modChanges_.size())
+      {
+        modChanges_[nModChanges_++] = {time, m->param_id, m->key, float(m->amount)};
+      }
+      else
+      {
+        droppedEvents_++;
+      }
+      continue;
+    }
+
+    Event e;
+    switch (header->type)
+    {
+      case CLAP_EVENT_NOTE_ON:
+      case CLAP_EVENT_NOTE_OFF:
+      case CLAP_EVENT_NOTE_CHOKE:
+      {
+        const auto* note = reinterpret_cast<const clap_event_note_t*>(header);
+        if (note->key < 0) break;
+        e.type = (header->type == CLAP_EVENT_NOTE_ON) ? kNoteOn : kNoteOff;
+        e.channel = uint8_t(std::max(note->channel, int16_t(0)) + 1);
+        e.sourceIdx = uint16_t(note->key);
+        e.value1 = float(note->key);
+        e.value2 = float(note->velocity);
+        break;
+      }
+      case CLAP_EVENT_MIDI:
+      {
+        const auto* midi = reinterpret_cast<const clap_event_midi_t*>(header);
+        e = MIDIBytesToEvent(midi->data, 3);
+        break;
+      }
+      default:
+        break;
+    }
+    if (!e) continue;
+
+    e.time = time;
+    if (nEvents_ < events_.size())
+    {
+      events_[nEvents_++] = e;
+    }
+    else
+    {
+      droppedEvents_++;
+    }
+  }
+}
+
+void ClapProcessAdapter::applyParamChanges(int endTime)
+{
+  // changes applied before a vector also ramp to their values at their times in the vector.
+  const bool ramp = (endTime != std::numeric_limits<int>::max());
+  const int vectorStart = endTime - kFloatsPerDSPVector;
+  bool changed{false};
+  while ((nextParamChange_ < nParamChanges_) && (paramChanges_[nextParamChange_].time < endTime))
+  {
+    const ParamChange& change = paramChanges_[nextParamChange_++];
+    if (ramp && (change.id < nParams_))
+    {
+      processor_.addParamEvent(change.id, change.time - vectorStart, change.value);
+    }
+    applyParamChange(change);
+    changed = true;
+  }
+  if (changed) processor_.publishParams();
+}
+
+void ClapProcessAdapter::applyParamChange(const ParamChange& change)
+{
+  if (change.id >= nParams_) return;
+  normalizedParams_[change.id].store(change.value, std::memory_order_relaxed);
+  float real = processor_.getParameterTree().convertNormalizedToRealFloatValue(change.id,
+                                                                               change.value);
+  processor_.setParamFromAudioThread(change.id, real);
+}
+
+void ClapProcessAdapter::recordParamChanges(bool immediate)
+{
+  // changes applied outside of process() are replayed at the start of the next block, where
+  // the processor first sees them.
+  for (size_t i = 0; i < nParamChanges_; ++i)
+  {
+    const ParamChange& change = paramChanges_[i];
+    if (change.id >= nParams_) continue;
+    float real = processor_.getParameterTree().convertNormalizedToRealFloatValue(change.id,
+                                                                                 change.value);
+    recorder_->recordParam(immediate ? 0 : change.time, change.id, real);
+  }
+}
+
+void ClapProcessAdapter::applyModChanges(int endTime)
+{
+  if (!modulation_ || !context_) return;
+
+  // voices that started new notes since the last vector lose their old offsets.
+  const size_t nVoices = voiceKeys_.size();
+  for (size_t v = 0; v < nVoices; ++v)
+  {
+    size_t key = context_->getInputVoice(int(v)).creatorKeyIdx_;
+    if ((key != 0) && (key != voiceKeys_[v]))
+    {
+      modulation_->clearVoice(v);
+    }
+    voiceKeys_[v] = key;
+  }
+
+  while ((nextModChange_ < nModChanges_) && (modChanges_[nextModChange_].time < endTime))
+  {
+    const ModChange& m = modChanges_[nextModChange_++];
+    if (m.key < 0)
+    {
+      modulation_->setOffsetForAllVoices(m.id, m.amount);
+      continue;
+    }
+    for (size_t v = 0; v < nVoices; ++v)
+    {
+      if (voiceKeys_[v] == size_t(m.key))
+      {
+        modulation_->setOffset(m.id, v, m.amount);
+      }
+    }
+  }
+}
+
+void ClapProcessAdapter::updateTime(const clap_event_transport_t* transport)
+{
+  if (!transport) return;
+  const bool hasTime = (transport->flags & CLAP_TRANSPORT_HAS_BEATS_TIMELINE) &&
+                       (transport->flags & CLAP_TRANSPORT_HAS_TEMPO);
+  if (!hasTime) return;
+  const double ppqPos = double(transport->song_pos_beats) / double(CLAP_BEATTIME_FACTOR);
+  const bool isPlaying = transport->flags & CLAP_TRANSPORT_IS_PLAYING;
+  context_->updateTime(ppqPos, transport->tempo, isPlaying, context_->getSampleRate());
+  if (recorder_)
+  {
+    recorder_->recordTime(ppqPos, transport->tempo, isPlaying, context_->getSampleRate());
+  }
+}
+
+}  // namespace ml
@@ -0,0 +1,170 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// ClapProcessAdapter: runs a SignalProcessor from the process() call of a CLAP plugin.
+//
+// The CLAP audio buffers go straight to a SignalProcessBuffer. When the host's block is a whole
+// number of DSPVectors, as it is for most hosts, the buffering is bypassed and each vector is
+// copied once in and once out of the AudioContext. Only other block sizes are buffered.
+//
+// The host's events are converted in one pass, which relies on CLAP delivering them in time
+// order. Note and MIDI events are added to the AudioContext all at once, with their sample
+// offsets. Parameter events carry normalized values for the parameter with the same ID in the
+// processor, and are applied just before the DSPVector that contains their offset is processed.
+// They are also added as ramp events at their offsets, so processors can read sample-accurate
+// automation with SignalProcessor::getRealParamRamp().
+// With AudioContext::setSplitAtEvents(), processors can also split vectors at the note events.
+//
+// In CLAP all parameter changes reach the plugin through process() or flush(), so the adapter is
+// the only writer of the processor's parameter store and the processor's setters must not be
+// called while the plugin is active. The main thread can follow the values with
+// getNormalizedParam(). The adapter must be made after the processor's parameters are built.
+//
+// Parameter modulation events go to a VoiceModulation, if one is set, at the start of the
+// DSPVector that contains them. Events for a key go to the voices playing that key, and events
+// without a key to all voices. A voice's offsets are cleared when it starts a new note.
+//
+// If the host has the thread-pool extension, getHostTaskPool() lends its threads to a Synth or
+// ProcessorGraph. The plugin's clap_plugin_thread_pool::exec() must call execHostTask().
+//
+// getLatency() is the processor's latency plus any added by buffering, for the plugin's
+// clap_plugin_latency::get(). When it changes, process() asks the host to restart the plugin so
+// that it reads the new value.
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "MLAudioContext.h"
+#include "MLProcessRecorder.h"
+#include "MLSignalProcessBuffer.h"
+#include "MLSignalProcessor.h"
+#include "MLVoiceModulation.h"
+#include "MLWorkerPool.h"
+#include "clap.h"
+
+namespace ml
+{
+
+class ClapProcessAdapter final
+{
+ public:
+  static constexpr size_t kMaxEventsPerBlock{1024};
+
+  ClapProcessAdapter(SignalProcessor& processor, size_t nInputs, size_t nOutputs);
+  ~ClapProcessAdapter() = default;
+
+  // from clap_plugin::activate(). Allocates the buffers, so not real-time safe.
+  void activate(double sampleRate, uint32_t maxFrames);
+  void deactivate();
+
+  // from clap_plugin::process(). Real-time safe.
+  clap_process_status process(const clap_process_t* process);
+
+  // from clap_plugin_params::flush(): apply any parameter events without processing audio.
+  void flush(const clap_input_events_t* events);
+
+  // the latest normalized value of each parameter. Can be read from any thread.
+  float getNormalizedParam(size_t id) const;
+
+  AudioContext* getContext() { return context_.get(); }
+
+  // send modulation events to the given VoiceModulation, such as Synth::getVoiceModulation().
+  // Not real-time safe.
+  void setVoiceModulation(VoiceModulation* modulation);
+
+  // from clap_plugin::init(), with the host's interface.
+  void setHost(const clap_host_t* host);
+  bool hasHostThreadPool() const { return hostThreadPool_ && hostThreadPool_->request_exec; }
+
+  // from clap_plugin_latency::get(): the total latency in samples.
+  uint32_t getLatency() const;
+
+  // a pool that runs jobs on the host's threads during process(), or an empty pool if the host
+  // has none. Jobs from outside process() are refused.
+  HostTaskPool getHostTaskPool();
+
+  // from clap_plugin_thread_pool::exec(), on one of the host's threads.
+  void execHostTask(uint32_t taskIndex);
+
+  // events past kMaxEventsPerBlock in one block are dropped and counted.
+  size_t getDroppedEventCount() const { return droppedEvents_; }
+
+  // record the time, events, parameter changes and inputs of each block to a ProcessRecorder,
+  // or stop recording with nullptr. Modulation events are not recorded. Not real-time safe.
+  void setRecorder(ProcessRecorder* recorder) { recorder_ = recorder; }
+
+ private:
+  struct ParamChange
+  {
+    int time;
+    uint32_t id;
+    float value;
+  };
+
+  struct ModChange
+  {
+    int time;
+    uint32_t id;
+    int16_t key;
+    float amount;
+  };
+
+  static void processVectorFn(AudioContext* context, void* state);
+
+  // sort the host's events into note events and parameter changes.
+  void readEvents(const clap_input_events_t* events);
+
+  // apply the parameter changes before the given time.
+  void applyParamChanges(int endTime);
+  void applyParamChange(const ParamChange& change);
+  void applyModChanges(int endTime);
+
+  void updateTime(const clap_event_transport_t* transport);
+  void recordParamChanges(bool immediate);
+
+  static bool runOnHost(void* poolContext, size_t nTasks, WorkerPool::TaskFn fn, void* taskContext);
+
+  SignalProcessor& processor_;
+  size_t nInputs_;
+  size_t nOutputs_;
+
+  std::unique_ptr<AudioContext> context_;
+  std::unique_ptr<SignalProcessBuffer> processBuffer_;
+
+  // flattened channel pointers from all the host's audio ports.
+  std::vector<const float*> inputs_;
+  std::vector<float*> outputs_;
+
+  std::vector<Event> events_;
+  std::vector<ParamChange> paramChanges_;
+  std::vector<ModChange> modChanges_;
+  size_t nEvents_{0};
+  size_t nParamChanges_{0};
+  size_t nextParamChange_{0};
+  size_t nModChanges_{0};
+  size_t nextModChange_{0};
+  int vectorEnd_{0};
+  size_t droppedEvents_{0};
+  ProcessRecorder* recorder_{nullptr};
+
+  std::unique_ptr<std::atomic<float>[]> normalizedParams_;
+  size_t nParams_{0};
+
+  // the modulation target, and the key each voice was playing at the last vector.
+  VoiceModulation* modulation_{nullptr};
+  std::vector<size_t> voiceKeys_;
+
+  // the host's thread pool and the job running on it.
+  const clap_host_t* host_{nullptr};
+  const clap_host_thread_pool_t* hostThreadPool_{nullptr};
+  bool inProcess_{false};
+  uint32_t reportedLatency_{0};
+  WorkerPool::TaskFn hostTaskFn_{nullptr};
+  void* hostTaskContext_{nullptr};
+};
+
+}  // namespace ml
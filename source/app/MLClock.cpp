@@ -20,7 +20,7 @@ Time doubleToTime(double t)
 {
   static const double kLo32Scale = pow(2, 32);
   double floorT = floor(t);
-  uint64_t hi32 = (static_cast<uint64_t>(floorT) & 0xFFFFFFFF) << 32;
+  uint64_t hi32 = static_cast<uint64_t>(floorT) & 0xFFFFFFFF;
   double fractionalSecond = t - floorT;
   uint64_t lo32 = static_cast<uint32_t>(fractionalSecond * kLo32Scale);
   return ((hi32 << 32) | lo32);
@@ -90,4 +90,46 @@ void Clock::start() { running_ = true; }
 
 void Clock::advance(Time t) { offset_ += t; }
 
+// TickClock
+
+namespace
+{
+struct TickReference
+{
+  uint64_t ticks{TickClock::now()};
+  std::chrono::steady_clock::time_point time{std::chrono::steady_clock::now()};
+};
+
+const TickReference& getTickReference()
+{
+  static TickReference r;
+  return r;
+}
+
+// take the reference when the library is loaded, so that calibration rarely has to wait.
+[[maybe_unused]] const TickReference& kLoadReference = getTickReference();
+}  // namespace
+
+double TickClock::calibrate()
+{
+#if ML_TICKS_CNTVCT
+  uint64_t frequency;
+  asm volatile("mrs %0, cntfrq_el0" : "=r"(frequency));
+  return double(frequency);
+#elif ML_TICKS_TSC
+  constexpr auto kMinCalibrationTime = std::chrono::milliseconds(20);
+  const TickReference& ref = getTickReference();
+  std::chrono::steady_clock::time_point t;
+  uint64_t ticks;
+  do
+  {
+    t = std::chrono::steady_clock::now();
+    ticks = now();
+  } while (t - ref.time < kMinCalibrationTime);
+  return (ticks - ref.ticks) / std::chrono::duration<double>(t - ref.time).count();
+#else
+  return 1e9;
+#endif
+}
+
 }  // namespace ml
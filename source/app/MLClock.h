@@ -6,8 +6,19 @@
 
 #include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <iostream>
 
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define ML_TICKS_TSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define ML_TICKS_TSC 1
+#elif defined(__aarch64__) && !defined(_MSC_VER)
+#define ML_TICKS_CNTVCT 1
+#endif
+
 namespace ml
 {
 // times and durations are stored in OSC / NTP timestamp format.
@@ -57,4 +68,50 @@ class Clock
   bool running_;
 };
 
+// TickClock: a cheap monotonic timestamp for profiling and for timestamping events and
+// callbacks. now() reads the CPU's counter directly: the TSC on x86, which is constant-rate on
+// any CPU recent enough to run 64-bit code, or CNTVCT on ARM64. Elsewhere it falls back to
+// steady_clock. now() is safe to call from the audio thread.
+//
+// The counter rate is read from CNTFRQ on ARM64. On x86 it is measured against steady_clock over
+// the time since the library was loaded, waiting if that is less than 20ms on the first call to
+// getTicksPerSecond(). Call it once at startup to make sure that never happens on the audio
+// thread.
+
+class TickClock
+{
+ public:
+  static inline uint64_t now()
+  {
+#if ML_TICKS_TSC
+    return __rdtsc();
+#elif ML_TICKS_CNTVCT
+    uint64_t t;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(t));
+    return t;
+#else
+    auto t = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t).count();
+#endif
+  }
+
+  static double getTicksPerSecond()
+  {
+    static const double ticksPerSecond = calibrate();
+    return ticksPerSecond;
+  }
+
+  static double ticksToSeconds(uint64_t ticks) { return ticks / getTicksPerSecond(); }
+  static uint64_t secondsToTicks(double s) { return uint64_t(s * getTicksPerSecond()); }
+
+  // the seconds from start to end, which can be negative.
+  static double secondsBetween(uint64_t start, uint64_t end)
+  {
+    return double(int64_t(end - start)) / getTicksPerSecond();
+  }
+
+ private:
+  static double calibrate();
+};
+
 }  // namespace ml
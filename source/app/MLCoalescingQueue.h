@@ -0,0 +1,214 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// CoalescingQueue: the latest values of many things, passed from one writer thread to one
+// reader thread, such as meters and playheads from the audio thread to the UI.
+//
+// Each thing has a slot, made at setup with a Path and a number of floats. The writer sets
+// slots by their IDs without allocating or waiting, and each write marks its slot changed in a
+// bitset. The reader drains only the changed slots, each with its newest values. A slot written
+// many times between drains is read once, so unlike a Queue<Message> this never fills up, and
+// a slow reader just sees fewer, newer values.
+//
+// A slot of several floats may be drained while the writer is setting it, and have some old
+// values. It is then marked changed again, so the next drain has all the new ones.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "MLMessage.h"
+#include "MLPath.h"
+
+namespace ml
+{
+class CoalescingQueue final
+{
+ public:
+  static constexpr size_t kNoSlot{~size_t(0)};
+
+  CoalescingQueue() = default;
+  ~CoalescingQueue() = default;
+
+  CoalescingQueue(CoalescingQueue const&) = delete;
+  CoalescingQueue& operator=(CoalescingQueue const&) = delete;
+
+  // setup, which allocates and is not thread-safe
+
+  // add a slot of the given number of floats and return its ID. IDs count up from 0. This sets
+  // the values of all the slots to 0.
+  size_t addSlot(Path p, size_t floats = 1)
+  {
+    const size_t id = slots_.size();
+    slots_.push_back({p, numValues_, floats});
+    maxSlotSize_ = std::max(maxSlotSize_, floats);
+
+    // atomics can't be moved, so the values and bits are made again.
+    numValues_ += floats;
+    values_ = makeZeroed<float>(numValues_);
+    const size_t nWords = (slots_.size() + kBitsPerWord - 1) / kBitsPerWord;
+    if (nWords != changedWords_)
+    {
+      changed_ = makeZeroed<uint64_t>(nWords);
+      changedWords_ = nWords;
+    }
+    scratch_.resize(maxSlotSize_);
+    return id;
+  }
+
+  // the ID of the slot at a Path, or kNoSlot.
+  size_t getSlotID(Path p) const
+  {
+    for (size_t i = 0; i < slots_.size(); ++i)
+    {
+      if (slots_[i].path == p) return i;
+    }
+    return kNoSlot;
+  }
+
+  size_t getNumSlots() const { return slots_.size(); }
+  Path getPath(size_t id) const { return slots_[id].path; }
+  size_t getSlotSize(size_t id) const { return slots_[id].size; }
+
+  // writer
+
+  void set(size_t id, float x)
+  {
+    values_[slots_[id].offset].store(x, std::memory_order_relaxed);
+    markChanged(id);
+  }
+
+  // set all getSlotSize(id) floats of a slot.
+  void set(size_t id, const float* x)
+  {
+    const Slot& s = slots_[id];
+    for (size_t i = 0; i < s.size; ++i)
+    {
+      values_[s.offset + i].store(x[i], std::memory_order_relaxed);
+    }
+    markChanged(id);
+  }
+
+  // the number of writes so far, and how many of them were coalesced into later ones.
+  uint64_t getWriteCount() const { return writes_.load(std::memory_order_relaxed); }
+  uint64_t getCoalescedCount() const
+  {
+    const uint64_t writes = getWriteCount();
+    const uint64_t drained = drained_.load(std::memory_order_relaxed);
+    return (writes > drained) ? writes - drained : 0;
+  }
+
+  // reader
+
+  bool hasChanges() const
+  {
+    for (size_t w = 0; w < changedWords_; ++w)
+    {
+      if (changed_[w].load(std::memory_order_relaxed)) return true;
+    }
+    return false;
+  }
+
+  // call fn(id, values, size) for each slot changed since the last drain, in order of ID, and
+  // return the number of slots. values is valid only during the call.
+  template <typename Fn>
+  size_t drain(Fn&& fn)
+  {
+    size_t n{0};
+    for (size_t w = 0; w < changedWords_; ++w)
+    {
+      uint64_t bits = changed_[w].exchange(0, std::memory_order_acquire);
+      while (bits)
+      {
+        const size_t bit = countTrailingZeros(bits);
+        bits &= bits - 1;
+        const size_t id = w * kBitsPerWord + bit;
+        const Slot& s = slots_[id];
+        for (size_t i = 0; i < s.size; ++i)
+        {
+          scratch_[i] = values_[s.offset + i].load(std::memory_order_relaxed);
+        }
+        fn(id, static_cast<const float*>(scratch_.data()), s.size);
+        ++n;
+      }
+    }
+    drained_.store(drained_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    return n;
+  }
+
+  // drain the changed slots as Messages at their Paths, with a float for one-float slots and a
+  // float array for others.
+  size_t drain(MessageList& messages)
+  {
+    return drain(
+        [&](size_t id, const float* x, size_t size)
+        {
+          messages.push_back(
+              Message(slots_[id].path, (size == 1) ? Value(x[0]) : Value(x, size)));
+        });
+  }
+
+  // the newest value in a slot, changed or not.
+  float get(size_t id, size_t i = 0) const
+  {
+    return values_[slots_[id].offset + i].load(std::memory_order_relaxed);
+  }
+
+ private:
+  static constexpr size_t kBitsPerWord{64};
+
+  struct Slot
+  {
+    Path path;
+    size_t offset;
+    size_t size;
+  };
+
+  template <typename T>
+  static std::unique_ptr<std::atomic<T>[]> makeZeroed(size_t n)
+  {
+    std::unique_ptr<std::atomic<T>[]> p(new std::atomic<T>[n]);
+    for (size_t i = 0; i < n; ++i) p[i].store(T(0), std::memory_order_relaxed);
+    return p;
+  }
+
+  static size_t countTrailingZeros(uint64_t x)
+  {
+    size_t n{0};
+    while (!(x & 1))
+    {
+      x >>= 1;
+      ++n;
+    }
+    return n;
+  }
+
+  void markChanged(size_t id)
+  {
+    changed_[id / kBitsPerWord].fetch_or(uint64_t(1) << (id % kBitsPerWord),
+                                         std::memory_order_release);
+    writes_.store(writes_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  std::vector<Slot> slots_;
+  std::unique_ptr<std::atomic<float>[]> values_;
+  size_t numValues_{0};
+  std::unique_ptr<std::atomic<uint64_t>[]> changed_;
+  size_t changedWords_{0};
+  size_t maxSlotSize_{0};
+
+  // owned by the reader
+  std::vector<float> scratch_;
+
+  // each written by only one side, so read by the other without a lock.
+  std::atomic<uint64_t> writes_{0};
+  std::atomic<uint64_t> drained_{0};
+};
+
+}  // namespace ml
@@ -13,6 +13,148 @@
 namespace ml
 {
 
+// CollectionIndex: the index of an indexed CollectionRoot.
+//
+// It keeps pointers to all the objects in a dense array, in the depth-first order of the Tree
+// iterator, so that the objects under any node are a contiguous range of the array. A hash
+// table maps the hash of each node's whole path to the node and its range. Iterating a
+// Collection with an index is then a loop over an array, and looking up an object is usually
+// one probe.
+//
+// Changes made through a Collection mark the index stale, and the next lookup or iteration
+// rebuilds it, so a burst of additions costs one rebuild. Changes made directly to the Tree,
+// for example through inSubCollection(), are not seen until the next change through a
+// Collection. Like the Collection itself, the index is not thread-safe.
+
+template <typename T>
+class CollectionIndex
+{
+ public:
+  using ObjectPointerType = std::unique_ptr<T>;
+  using TreeType = Tree<ObjectPointerType>;
+
+  static constexpr uint64_t kRootPathHash{textHashConsts::k2};
+
+  struct Entry
+  {
+    uint64_t hash{0};
+
+    // null if two paths have the same hash. They are then found by walking the Tree.
+    const TreeType* node{nullptr};
+
+    // the objects under the node, not including its own.
+    uint32_t first{0};
+    uint32_t last{0};
+  };
+
+  explicit CollectionIndex(const TreeType& root) : root_(&root) {}
+
+  static uint64_t combinePathHash(uint64_t h, Symbol key)
+  {
+    h = detail::mix(h ^ textHashConsts::k0, key.getHash() ^ textHashConsts::k1);
+    return h ? h : 1;
+  }
+
+  static uint64_t getPathHash(uint64_t h, const Path& p)
+  {
+    for (Symbol key : p)
+    {
+      h = combinePathHash(h, key);
+    }
+    return h;
+  }
+
+  void invalidate() { valid_ = false; }
+
+  // rebuild the index if it is stale.
+  void update()
+  {
+    if (valid_) return;
+    objects_.clear();
+    paths_.clear();
+    depths_.clear();
+    table_.assign(64, Entry());
+    count_ = 0;
+    Path path;
+    addNode(*root_, path, kRootPathHash);
+    valid_ = true;
+  }
+
+  // return the entry for the node with the given path hash, or nullptr if there is none.
+  const Entry* find(uint64_t hash)
+  {
+    update();
+    const size_t mask = table_.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask)
+    {
+      if (table_[i].hash == hash) return &table_[i];
+      if (!table_[i].hash) return nullptr;
+    }
+  }
+
+  T* getObject(size_t i) const { return objects_[i]; }
+  const Path& getPath(size_t i) const { return paths_[i]; }
+  int getDepth(size_t i) const { return depths_[i]; }
+
+ private:
+  void insert(const Entry& entry)
+  {
+    if ((count_ + 1) * 2 > table_.size())
+    {
+      std::vector<Entry> old(table_.size() * 2);
+      old.swap(table_);
+      count_ = 0;
+      for (const auto& e : old)
+      {
+        if (e.hash) insert(e);
+      }
+    }
+    const size_t mask = table_.size() - 1;
+    for (size_t i = entry.hash & mask;; i = (i + 1) & mask)
+    {
+      Entry& e = table_[i];
+      if (!e.hash)
+      {
+        e = entry;
+        count_++;
+        return;
+      }
+      if (e.hash == entry.hash)
+      {
+        e.node = nullptr;
+        return;
+      }
+    }
+  }
+
+  void addNode(const TreeType& node, Path& path, uint64_t hash)
+  {
+    Entry entry{hash, &node, uint32_t(objects_.size()), 0};
+    const int depth = path.getSize();
+    node.forEachChildNode([&](Symbol key, const TreeType& child) {
+      Path childPath(path);
+      childPath.addElement(key);
+      if (child.hasValue())
+      {
+        objects_.push_back(child.getValue().get());
+        paths_.push_back(childPath);
+        depths_.push_back(depth);
+      }
+      addNode(child, childPath, combinePathHash(hash, key));
+    });
+    entry.last = uint32_t(objects_.size());
+    insert(entry);
+  }
+
+  const TreeType* root_;
+  bool valid_{false};
+  std::vector<T*> objects_;
+  std::vector<Path> paths_;
+  std::vector<int> depths_;
+  std::vector<Entry> table_;
+  size_t count_{0};
+};
+
 template <typename T>
 class Collection
 {
@@ -25,6 +167,32 @@ class Collection
  protected:
   TreeType* tree_{nullptr};
 
+  // for a Collection from an indexed CollectionRoot, the root's index and the path of this
+  // Collection from the root.
+  CollectionIndex<T>* index_{nullptr};
+  Path prefix_{};
+  uint64_t prefixHash_{CollectionIndex<T>::kRootPathHash};
+
+  Collection(TreeType& t, CollectionIndex<T>* index, Path prefix)
+      : tree_(&t),
+        index_(index),
+        prefix_(prefix),
+        prefixHash_(CollectionIndex<T>::getPathHash(CollectionIndex<T>::kRootPathHash, prefix))
+  {
+  }
+
+  // the index entry for the node at the path p from this Collection, or nullptr. Paths with
+  // the same hash make entries with no node, which are found by walking.
+  const typename CollectionIndex<T>::Entry* findInIndex(Path p) const
+  {
+    return index_->find(CollectionIndex<T>::getPathHash(prefixHash_, p));
+  }
+
+  void invalidateIndex()
+  {
+    if (index_) index_->invalidate();
+  }
+
  public:
   // The non-null constructor needs to be passed a reference to a Tree
   // that holds the actual collection. This allows a collection to refer
@@ -57,6 +225,10 @@ class Collection
     {
       return nullObjPtr_;
     }
+    else if (index_)
+    {
+      return find(p);
+    }
     else
     {
       return tree_->operator[](p);
@@ -73,7 +245,16 @@ class Collection
       return nullObjPtr_;
     }
 
-    const TreeType* n = tree_->getNode(p);
+    const TreeType* n{nullptr};
+    const typename CollectionIndex<T>::Entry* e = index_ ? findInIndex(p) : nullptr;
+    if (e && e->node)
+    {
+      n = e->node;
+    }
+    else if (!index_ || e)
+    {
+      n = tree_->getNode(p);
+    }
     if (n && n->hasValue())
     {
       return n->getValue();
@@ -89,6 +270,7 @@ class Collection
   {
     if (!tree_) return;
     tree_->add(p, std::move(newVal));
+    invalidateIndex();
   }
 
   // create a new object in the collection at the given path, constructed with the remaining
@@ -98,6 +280,7 @@ class Collection
   {
     if (!tree_) return;
     tree_->add(p, std::move(std::make_unique<TT>(Fargs...)));
+    invalidateIndex();
   }
 
   // like add_unique but also passes the new object an initial argument: the Collection
@@ -109,11 +292,13 @@ class Collection
     tree_->add(p, ObjectPointerType());
     auto sc = getSubCollection(p);
     tree_->operator[](p) = std::move(std::make_unique<TT>(sc, Fargs...));
+    invalidateIndex();
   }
 
   // return the Collection under the given node. Note that this does not
   // include the given node as a member, just as whole Collection does
-  // not include a "/" or null-named node.
+  // not include a "/" or null-named node. Subcollections of an indexed Collection share its
+  // index, and stay valid as objects are added.
   inline Collection getSubCollection(Path addr)
   {
     if (!tree_) return Collection<T>();
@@ -122,6 +307,7 @@ class Collection
     if (subTree)
     {
       // return a new Collection referring to the given subTree.
+      if (index_) return Collection<T>(*subTree, index_, Path(prefix_, addr));
       return Collection<T>(*subTree);
     }
     else
@@ -157,6 +343,18 @@ class Collection
   void forEach(CALLABLE f, Path* currentPathPtr = nullptr)
   {
     if (!tree_) return;
+    if (const auto* e = index_ ? findInIndex(Path()) : nullptr)
+    {
+      for (uint32_t i = e->first; i < e->last; ++i)
+      {
+        if (currentPathPtr)
+        {
+          *currentPathPtr = getPathFromPrefix(index_->getPath(i));
+        }
+        f(*index_->getObject(i));
+      }
+      return;
+    }
     for (auto it = tree_->begin(); it != tree_->end(); ++it)
     {
       if (currentPathPtr)
@@ -175,6 +373,20 @@ class Collection
   void forEachChild(CALLABLE f, Path* currentPathPtr = nullptr)
   {
     if (!tree_) return;
+    if (const auto* e = index_ ? findInIndex(Path()) : nullptr)
+    {
+      const int depth = prefix_.getSize();
+      for (uint32_t i = e->first; i < e->last; ++i)
+      {
+        if (index_->getDepth(i) != depth) continue;
+        if (currentPathPtr)
+        {
+          *currentPathPtr = getPathFromPrefix(index_->getPath(i));
+        }
+        f(*index_->getObject(i));
+      }
+      return;
+    }
     // Tree currently offers only depth-first iterators so
     // we have to iterate the entire tree even though we only want children
     // of the root node.
@@ -204,6 +416,20 @@ class Collection
   }
 
   inline size_t size() const { return tree_ ? tree_->size() : 0; }
+
+  bool isIndexed() const { return index_ != nullptr; }
+
+ private:
+  // the part of a path from the root that is under this Collection.
+  Path getPathFromPrefix(const Path& p) const
+  {
+    Path r;
+    for (int i = prefix_.getSize(); i < p.getSize(); ++i)
+    {
+      r.addElement(p.getElement(i));
+    }
+    return r;
+  }
 };
 
 // CollectionRoot: a handy subclass to combine a Collection with its Tree
@@ -211,13 +437,27 @@ template <typename T>
 class CollectionRoot : public Collection<T>
 {
   typename Collection<T>::TreeType localTree_;
+  std::unique_ptr<CollectionIndex<T>> localIndex_;
 
  public:
   // return collection referring to our internal tree
   CollectionRoot() : Collection<T>(localTree_) {};
   ~CollectionRoot() = default;
 
-  inline void clear() { localTree_.clear(); }
+  // keep a CollectionIndex, for linear iteration and hashed lookups in large collections.
+  // Subcollections made after this share the index.
+  void enableIndex()
+  {
+    if (localIndex_) return;
+    localIndex_ = std::make_unique<CollectionIndex<T>>(localTree_);
+    this->index_ = localIndex_.get();
+  }
+
+  inline void clear()
+  {
+    localTree_.clear();
+    this->invalidateIndex();
+  }
 };
 
 template <typename T>
@@ -0,0 +1,400 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLCompression.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace ml
+{
+// LZ4 blocks
+
+// limits from the LZ4 block format.
+constexpr size_t kMinMatch{4};
+constexpr size_t kLastLiterals{5};
+constexpr size_t kMatchStartLimit{12};
+constexpr size_t kMaxOffset{65535};
+
+constexpr int kHashBits{14};
+
+static uint32_t read32(const uint8_t* p)
+{
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static uint32_t hashWord(uint32_t v) { return (v * 2654435761u) >> (32 - kHashBits); }
+
+// write the rest of a length as 255s and a final byte.
+static bool writeLength(uint8_t*& op, const uint8_t* end, size_t len)
+{
+  for (; len >= 255; len -= 255)
+  {
+    if (op == end) return false;
+    *op++ = 255;
+  }
+  if (op == end) return false;
+  *op++ = static_cast<uint8_t>(len);
+  return true;
+}
+
+// write literals followed by a match. The last sequence has no match and matchLen is 0.
+static bool writeSequence(uint8_t*& op, const uint8_t* end, const uint8_t* literals, size_t litLen,
+                          size_t offset, size_t matchLen)
+{
+  if (op == end) return false;
+  uint8_t* token = op++;
+  size_t litCode = std::min(litLen, size_t(15));
+  *token = static_cast<uint8_t>(litCode << 4);
+  if ((litCode == 15) && !writeLength(op, end, litLen - 15)) return false;
+  if (static_cast<size_t>(end - op) < litLen) return false;
+  if (litLen) memcpy(op, literals, litLen);
+  op += litLen;
+  if (matchLen == 0) return true;
+
+  if (end - op < 2) return false;
+  *op++ = static_cast<uint8_t>(offset & 0xFF);
+  *op++ = static_cast<uint8_t>(offset >> 8);
+  size_t matchCode = std::min(matchLen - kMinMatch, size_t(15));
+  *token |= static_cast<uint8_t>(matchCode);
+  if ((matchCode == 15) && !writeLength(op, end, matchLen - kMinMatch - 15)) return false;
+  return true;
+}
+
+size_t getMaxCompressedBlockSize(size_t size) { return size + size / 255 + 16; }
+
+size_t compressBlock(const uint8_t* src, size_t srcSize, uint8_t* dest, size_t destCapacity)
+{
+  if (!dest || (!src && srcSize)) return 0;
+  uint8_t* op = dest;
+  const uint8_t* end = dest + destCapacity;
+  size_t anchor = 0;
+
+  if (srcSize > kMatchStartLimit)
+  {
+    // greedy matching with a table of the last position + 1 of each hashed word.
+    std::vector<uint32_t> table(size_t(1) << kHashBits, 0);
+    const size_t matchStartEnd = srcSize - kMatchStartLimit;
+    const size_t matchEnd = srcSize - kLastLiterals;
+    size_t ip = 0;
+    while (ip < matchStartEnd)
+    {
+      uint32_t word = read32(src + ip);
+      uint32_t& entry = table[hashWord(word)];
+      size_t ref = entry;
+      entry = static_cast<uint32_t>(ip + 1);
+      if (ref && (ip - (ref - 1) <= kMaxOffset) && (read32(src + ref - 1) == word))
+      {
+        ref -= 1;
+        size_t len = kMinMatch;
+        while ((ip + len < matchEnd) && (src[ref + len] == src[ip + len])) len++;
+        if (!writeSequence(op, end, src + anchor, ip - anchor, ip - ref, len)) return 0;
+        ip += len;
+        anchor = ip;
+      }
+      else
+      {
+        ip++;
+      }
+    }
+  }
+  if (!writeSequence(op, end, src + anchor, srcSize - anchor, 0, 0)) return 0;
+  return op - dest;
+}
+
+bool decompressBlock(const uint8_t* src, size_t srcSize, uint8_t* dest, size_t destSize)
+{
+  if (!src || !srcSize || (!dest && destSize)) return false;
+  const uint8_t* ip = src;
+  const uint8_t* ipEnd = src + srcSize;
+  uint8_t* op = dest;
+  const uint8_t* opEnd = dest + destSize;
+
+  auto readLength = [&](size_t& len) {
+    uint8_t b;
+    do
+    {
+      if (ip == ipEnd) return false;
+      b = *ip++;
+      len += b;
+    } while (b == 255);
+    return true;
+  };
+
+  while (true)
+  {
+    if (ip == ipEnd) return false;
+    uint8_t token = *ip++;
+
+    size_t litLen = token >> 4;
+    if ((litLen == 15) && !readLength(litLen)) return false;
+    if ((static_cast<size_t>(ipEnd - ip) < litLen) || (static_cast<size_t>(opEnd - op) < litLen))
+    {
+      return false;
+    }
+    if (litLen) memcpy(op, ip, litLen);
+    ip += litLen;
+    op += litLen;
+
+    // the last sequence ends after its literals.
+    if (ip == ipEnd) break;
+
+    if (ipEnd - ip < 2) return false;
+    size_t offset = ip[0] | (ip[1] << 8);
+    ip += 2;
+    if ((offset == 0) || (offset > static_cast<size_t>(op - dest))) return false;
+
+    size_t matchLen = token & 15;
+    if ((matchLen == 15) && !readLength(matchLen)) return false;
+    matchLen += kMinMatch;
+    if (static_cast<size_t>(opEnd - op) < matchLen) return false;
+
+    // matches may overlap their output.
+    const uint8_t* match = op - offset;
+    if (offset >= matchLen)
+    {
+      memcpy(op, match, matchLen);
+    }
+    else
+    {
+      for (size_t i = 0; i < matchLen; ++i) op[i] = match[i];
+    }
+    op += matchLen;
+  }
+  return op == opEnd;
+}
+
+// Chunked container
+
+// "MLZ1" in memory order
+constexpr uint32_t kCompressedTag{0x315A4C4D};
+constexpr size_t kMaxCompressionChunkBytes{1 << 30};
+
+// each byte of an LZ4 block decodes to at most 255 bytes.
+constexpr uint64_t kMaxLZ4Expansion{255};
+
+struct CompressedHeader
+{
+  uint32_t tag;
+  uint32_t chunkBytes;
+  uint64_t originalBytes;
+  uint64_t chunks;
+};
+
+enum ChunkCodec : uint32_t
+{
+  kChunkStored,
+  kChunkLZ4,
+  kChunkShuffledLZ4,
+  kNumChunkCodecs
+};
+
+struct CompressedChunkEntry
+{
+  uint32_t storedBytes;
+  uint32_t codec;
+};
+
+// move byte i of each 4-byte word to plane i. Bytes after the last whole word are copied.
+static void shuffleWords(const uint8_t* src, uint8_t* dest, size_t size)
+{
+  size_t words = size / 4;
+  for (size_t i = 0; i < words; ++i)
+  {
+    for (size_t b = 0; b < 4; ++b) dest[b * words + i] = src[i * 4 + b];
+  }
+  memcpy(dest + words * 4, src + words * 4, size - words * 4);
+}
+
+static void unshuffleWords(const uint8_t* src, uint8_t* dest, size_t size)
+{
+  size_t words = size / 4;
+  for (size_t i = 0; i < words; ++i)
+  {
+    for (size_t b = 0; b < 4; ++b) dest[i * 4 + b] = src[b * words + i];
+  }
+  memcpy(dest + words * 4, src + words * 4, size - words * 4);
+}
+
+std::vector<uint8_t> compressData(const uint8_t* data, size_t size, size_t chunkBytes)
+{
+  if (!data) size = 0;
+  chunkBytes = std::clamp(chunkBytes, size_t(1), kMaxCompressionChunkBytes);
+  size_t chunks = (size + chunkBytes - 1) / chunkBytes;
+  size_t tableBytes = chunks * sizeof(CompressedChunkEntry);
+
+  std::vector<uint8_t> result(sizeof(CompressedHeader) + tableBytes);
+  CompressedHeader header{kCompressedTag, static_cast<uint32_t>(chunkBytes), size, chunks};
+  memcpy(result.data(), &header, sizeof(CompressedHeader));
+
+  size_t maxBytes = getMaxCompressedBlockSize(std::min(chunkBytes, size));
+  std::vector<uint8_t> plain(maxBytes), shuffled(maxBytes);
+  std::vector<uint8_t> shuffleInput(std::min(chunkBytes, size));
+  for (size_t c = 0; c < chunks; ++c)
+  {
+    const uint8_t* src = data + c * chunkBytes;
+    size_t srcBytes = std::min(chunkBytes, size - c * chunkBytes);
+
+    // keep the smallest of the encodings.
+    CompressedChunkEntry entry{static_cast<uint32_t>(srcBytes), kChunkStored};
+    const uint8_t* stored = src;
+    size_t plainBytes = compressBlock(src, srcBytes, plain.data(), plain.size());
+    if (plainBytes && (plainBytes < entry.storedBytes))
+    {
+      entry = CompressedChunkEntry{static_cast<uint32_t>(plainBytes), kChunkLZ4};
+      stored = plain.data();
+    }
+    if (srcBytes >= 8)
+    {
+      shuffleWords(src, shuffleInput.data(), srcBytes);
+      size_t shuffledBytes = compressBlock(shuffleInput.data(), srcBytes, shuffled.data(),
+                                           shuffled.size());
+      if (shuffledBytes && (shuffledBytes < entry.storedBytes))
+      {
+        entry = CompressedChunkEntry{static_cast<uint32_t>(shuffledBytes), kChunkShuffledLZ4};
+        stored = shuffled.data();
+      }
+    }
+
+    memcpy(result.data() + sizeof(CompressedHeader) + c * sizeof(CompressedChunkEntry), &entry,
+           sizeof(CompressedChunkEntry));
+    result.insert(result.end(), stored, stored + entry.storedBytes);
+  }
+  return result;
+}
+
+// read and check the header and chunk table.
+static bool readCompressedHeader(const uint8_t* data, size_t size, CompressedHeader& header)
+{
+  if (!data || (size < sizeof(CompressedHeader))) return false;
+  memcpy(&header, data, sizeof(CompressedHeader));
+  if ((header.tag != kCompressedTag) || (header.chunkBytes == 0) ||
+      (header.chunkBytes > kMaxCompressionChunkBytes))
+  {
+    return false;
+  }
+
+  uint64_t expectedChunks =
+      header.originalBytes / header.chunkBytes + ((header.originalBytes % header.chunkBytes) != 0);
+  if (header.chunks != expectedChunks) return false;
+  size_t available = size - sizeof(CompressedHeader);
+  if (header.chunks > available / sizeof(CompressedChunkEntry)) return false;
+  available -= header.chunks * sizeof(CompressedChunkEntry);
+
+  const uint8_t* table = data + sizeof(CompressedHeader);
+  for (uint64_t c = 0; c < header.chunks; ++c)
+  {
+    CompressedChunkEntry entry;
+    memcpy(&entry, table + c * sizeof(CompressedChunkEntry), sizeof(CompressedChunkEntry));
+    if ((entry.codec >= kNumChunkCodecs) || (entry.storedBytes > available)) return false;
+    available -= entry.storedBytes;
+
+    // each chunk must be able to decode to its size, so that an untrusted header can't make
+    // the caller allocate much more than the input could ever fill.
+    uint64_t chunkStart = c * header.chunkBytes;
+    uint64_t chunkSize = std::min(uint64_t(header.chunkBytes), header.originalBytes - chunkStart);
+    uint64_t maxSize = entry.storedBytes;
+    if (entry.codec != kChunkStored) maxSize *= kMaxLZ4Expansion;
+    if (chunkSize > maxSize) return false;
+  }
+  return true;
+}
+
+// decode the chunk stored at src into dest.
+static bool decodeChunk(const CompressedChunkEntry& entry, const uint8_t* src, uint8_t* dest,
+                        size_t destBytes, std::vector<uint8_t>& scratch)
+{
+  switch (entry.codec)
+  {
+    case kChunkStored:
+      if (entry.storedBytes != destBytes) return false;
+      memcpy(dest, src, destBytes);
+      return true;
+    case kChunkLZ4:
+      return decompressBlock(src, entry.storedBytes, dest, destBytes);
+    case kChunkShuffledLZ4:
+      scratch.resize(destBytes);
+      if (!decompressBlock(src, entry.storedBytes, scratch.data(), destBytes)) return false;
+      unshuffleWords(scratch.data(), dest, destBytes);
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool isCompressedData(const uint8_t* data, size_t size)
+{
+  CompressedHeader header;
+  return readCompressedHeader(data, size, header);
+}
+
+size_t getDecompressedSize(const uint8_t* data, size_t size)
+{
+  CompressedHeader header;
+  return readCompressedHeader(data, size, header) ? header.originalBytes : 0;
+}
+
+bool decompressData(const uint8_t* data, size_t size, std::vector<uint8_t>& out)
+{
+  out.clear();
+  CompressedHeader header;
+  if (!readCompressedHeader(data, size, header)) return false;
+
+  std::vector<uint8_t> result(header.originalBytes);
+  if (!decompressRange(data, size, 0, header.originalBytes, result.data())) return false;
+  out = std::move(result);
+  return true;
+}
+
+bool decompressRange(const uint8_t* data, size_t size, size_t offset, size_t length,
+                     uint8_t* dest)
+{
+  CompressedHeader header;
+  if (!readCompressedHeader(data, size, header)) return false;
+  if ((offset > header.originalBytes) || (length > header.originalBytes - offset)) return false;
+  if (length == 0) return true;
+  if (!dest) return false;
+
+  const size_t chunkBytes = header.chunkBytes;
+  const size_t firstChunk = offset / chunkBytes;
+  const size_t lastChunk = (offset + length - 1) / chunkBytes;
+  const uint8_t* table = data + sizeof(CompressedHeader);
+  const uint8_t* src = table + header.chunks * sizeof(CompressedChunkEntry);
+
+  std::vector<uint8_t> chunk, scratch;
+  for (size_t c = 0; c <= lastChunk; ++c)
+  {
+    CompressedChunkEntry entry;
+    memcpy(&entry, table + c * sizeof(CompressedChunkEntry), sizeof(CompressedChunkEntry));
+    if (c >= firstChunk)
+    {
+      size_t chunkStart = c * chunkBytes;
+      size_t chunkSize = std::min(chunkBytes, size_t(header.originalBytes) - chunkStart);
+      size_t copyStart = std::max(offset, chunkStart);
+      size_t copyEnd = std::min(offset + length, chunkStart + chunkSize);
+
+      // whole chunks are decoded straight into dest.
+      if ((copyStart == chunkStart) && (copyEnd == chunkStart + chunkSize))
+      {
+        if (!decodeChunk(entry, src, dest + (chunkStart - offset), chunkSize, scratch))
+        {
+          return false;
+        }
+      }
+      else
+      {
+        chunk.resize(chunkSize);
+        if (!decodeChunk(entry, src, chunk.data(), chunkSize, scratch)) return false;
+        memcpy(dest + (copyStart - offset), chunk.data() + (copyStart - chunkStart),
+               copyEnd - copyStart);
+      }
+    }
+    src += entry.storedBytes;
+  }
+  return true;
+}
+
+}  // namespace ml
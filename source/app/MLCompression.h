@@ -0,0 +1,61 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// Lossless compression for binary state and blobs.
+//
+// Blocks are compressed with a small built-in LZ77 codec that writes the LZ4
+// block format, so no external library is needed. Compression is greedy and
+// fast rather than tight. Decompression checks all bounds, so bad data fails
+// instead of writing out of range.
+//
+// The container splits the data into chunks that are compressed separately.
+// A table of chunk sizes follows the header, so any range of the original
+// data can be decoded without decoding the chunks before it. Each chunk is
+// stored as plain LZ4, as LZ4 over the data shuffled into byte planes of
+// 4-byte words, which suits float arrays, or uncompressed, whichever is
+// smallest.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ml
+{
+// LZ4 blocks
+
+// the most bytes compressBlock() can write for size bytes of input.
+size_t getMaxCompressedBlockSize(size_t size);
+
+// Returns the number of bytes written, or 0 if destCapacity is too small.
+size_t compressBlock(const uint8_t* src, size_t srcSize, uint8_t* dest, size_t destCapacity);
+
+// Decode a block that decompresses to exactly destSize bytes. Returns false if
+// the data is not a valid block of that size.
+bool decompressBlock(const uint8_t* src, size_t srcSize, uint8_t* dest, size_t destSize);
+
+// Chunked container
+
+constexpr size_t kDefaultCompressionChunkBytes{1 << 16};
+
+std::vector<uint8_t> compressData(const uint8_t* data, size_t size,
+                                  size_t chunkBytes = kDefaultCompressionChunkBytes);
+
+// true if the data starts with a valid container header and chunk table.
+bool isCompressedData(const uint8_t* data, size_t size);
+
+// the size of the original data, or 0 if the container is not valid.
+size_t getDecompressedSize(const uint8_t* data, size_t size);
+
+// Returns false, leaving out empty, if the container is not valid.
+bool decompressData(const uint8_t* data, size_t size, std::vector<uint8_t>& out);
+
+// Decode bytes [offset, offset + length) of the original data into dest,
+// decoding only the chunks that hold them. Returns false if the container is
+// not valid or the range is outside the data.
+bool decompressRange(const uint8_t* data, size_t size, size_t offset, size_t length,
+                     uint8_t* dest);
+
+}  // namespace ml
@@ -0,0 +1,301 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// DSPProfiler: scoped timing of sections of DSP code, aggregated by Path.
+//
+// Sections are added before processing, each with a Path like "voices/voice3/osc" that names
+// its place in the processor. On the audio thread, ML_PROFILE_SCOPE() around a section of code
+// reads the TickClock at the start and end, and nested scopes are subtracted from their parents
+// to give each section's self time as well as its total. endVector(), called once per DSPVector,
+// sends a record for each section that ran to a lock-free queue. Another thread calls collect()
+// to drain the queue into statistics, which it can read directly or send on as Messages, for
+// example to an Actor.
+//
+// Only one thread may run scopes and call endVector(). While profiling is off each scope costs
+// one branch, and a scope with a null profiler does nothing, so the markers can stay in release
+// builds.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "MLClock.h"
+#include "MLDSPOps.h"
+#include "MLMessage.h"
+#include "MLPath.h"
+#include "MLQueue.h"
+
+namespace ml
+{
+class DSPProfiler
+{
+ public:
+  using SectionID = uint16_t;
+
+  // scopes with this ID do nothing.
+  static constexpr SectionID kNoSection{0xFFFF};
+
+  static constexpr size_t kMaxSections{1024};
+  static constexpr int kMaxDepth{32};
+
+  // records in the queue. Each vector makes one record for each section that ran and one more,
+  // so with a few dozen sections this holds some hundreds of vectors and collect() can run at
+  // timer rates.
+  static constexpr size_t kDefaultQueueRecords{16384};
+
+  struct Stats
+  {
+    // vectors seen by collect(), and the number of times the section ran in them.
+    uint64_t vectors{0};
+    uint64_t calls{0};
+
+    // total time including nested sections, and self time without them.
+    double totalSeconds{0.};
+    double selfSeconds{0.};
+
+    // the most total time in one vector.
+    double maxSecondsPerVector{0.};
+
+    // time as a ratio of the duration of each vector at the sample rate.
+    float getMeanLoad(double sampleRate) const { return getLoad(totalSeconds, sampleRate); }
+    float getSelfLoad(double sampleRate) const { return getLoad(selfSeconds, sampleRate); }
+    float getMaxLoad(double sampleRate) const
+    {
+      return float(maxSecondsPerVector * sampleRate / kFloatsPerDSPVector);
+    }
+
+   private:
+    float getLoad(double seconds, double sampleRate) const
+    {
+      return vectors ? float(seconds * sampleRate / (double(vectors) * kFloatsPerDSPVector))
+                     : 0.f;
+    }
+  };
+
+  explicit DSPProfiler(size_t queueRecords = kDefaultQueueRecords) : records_(queueRecords) {}
+
+  DSPProfiler(const DSPProfiler&) = delete;
+  DSPProfiler& operator=(const DSPProfiler&) = delete;
+
+  // add a section and return its ID, or the ID it already has. Not real-time safe: only to be
+  // called before processing starts.
+  SectionID addSection(Path name)
+  {
+    for (size_t i = 0; i < sections_.size(); ++i)
+    {
+      if (sections_[i].name == name) return SectionID(i);
+    }
+    if (sections_.size() >= kMaxSections) return kNoSection;
+    sections_.emplace_back();
+    sections_.back().name = name;
+    stats_.emplace_back();
+    return SectionID(sections_.size() - 1);
+  }
+
+  size_t getNumSections() const { return sections_.size(); }
+  Path getSectionName(SectionID id) const { return sections_[id].name; }
+
+  // turn profiling on or off from any thread. The change takes effect at the next endVector().
+  void setEnabled(bool b) { enabled_.store(b, std::memory_order_relaxed); }
+  bool isEnabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+  // the audio thread side.
+
+  inline void beginSection(SectionID id)
+  {
+    if (!active_) return;
+    if (depth_ < kMaxDepth)
+    {
+      stack_[depth_] = {(id < sections_.size()) ? id : kNoSection, TickClock::now(), 0};
+    }
+    depth_++;
+  }
+
+  inline void endSection()
+  {
+    if (!active_ || (depth_ == 0)) return;
+    depth_--;
+    if (depth_ >= kMaxDepth) return;
+    const Frame& f = stack_[depth_];
+    if (f.id == kNoSection) return;
+
+    const uint64_t elapsed = TickClock::now() - f.startTicks;
+    Section& s = sections_[f.id];
+    if (!s.calls) touched_[numTouched_++] = f.id;
+    s.calls++;
+    s.ticks += elapsed;
+    s.selfTicks += elapsed - std::min(elapsed, f.childTicks);
+    if (depth_ > 0) stack_[depth_ - 1].childTicks += elapsed;
+  }
+
+  // send the records for this vector to the queue. Called once per DSPVector on the audio
+  // thread, outside of any section.
+  void endVector()
+  {
+    if (active_ && (depth_ == 0))
+    {
+      // a marker, with the vector's sections following it.
+      pushRecord({kVectorMarker, 0, 0, 0});
+      for (size_t i = 0; i < numTouched_; ++i)
+      {
+        Section& s = sections_[touched_[i]];
+        pushRecord({touched_[i], s.calls, s.ticks, s.selfTicks});
+        s.calls = 0;
+        s.ticks = 0;
+        s.selfTicks = 0;
+      }
+      numTouched_ = 0;
+    }
+    if (depth_ == 0)
+    {
+      active_ = enabled_.load(std::memory_order_relaxed);
+    }
+  }
+
+  // the reading side.
+
+  // drain the queue into the statistics. Only one thread may collect.
+  void collect()
+  {
+    const double secondsPerTick = 1.0 / TickClock::getTicksPerSecond();
+    Record r;
+    while (records_.pop(r))
+    {
+      if (r.id == kVectorMarker)
+      {
+        vectorsCollected_++;
+        continue;
+      }
+      if (r.id >= stats_.size()) continue;
+      Stats& s = stats_[r.id];
+      s.calls += r.calls;
+      s.totalSeconds += r.ticks * secondsPerTick;
+      s.selfSeconds += r.selfTicks * secondsPerTick;
+      s.maxSecondsPerVector = std::max(s.maxSecondsPerVector, r.ticks * secondsPerTick);
+    }
+    for (auto& s : stats_)
+    {
+      s.vectors = vectorsCollected_;
+    }
+  }
+
+  const Stats& getStats(SectionID id) const { return stats_[id]; }
+
+  // clear the collected statistics. Called by the collecting thread.
+  void clearStats()
+  {
+    for (auto& s : stats_)
+    {
+      s = Stats();
+    }
+    vectorsCollected_ = 0;
+  }
+
+  // records that didn't fit in the queue since the start, because collect() wasn't called often
+  // enough.
+  uint64_t getDroppedRecords() const { return droppedRecords_.load(std::memory_order_relaxed); }
+
+  // the collected statistics as Messages, to send to an Actor or other receiver. Each section
+  // that has run makes messages at prefix/<section name>/ load, self_load, max_load and
+  // calls_per_vector.
+  MessageList getStatsMessages(Path prefix, double sampleRate) const
+  {
+    MessageList messages;
+    for (size_t i = 0; i < stats_.size(); ++i)
+    {
+      const Stats& s = stats_[i];
+      if (!s.calls || !s.vectors) continue;
+      const Path base(prefix, sections_[i].name);
+      messages.push_back(Message(Path(base, "load"), s.getMeanLoad(sampleRate)));
+      messages.push_back(Message(Path(base, "self_load"), s.getSelfLoad(sampleRate)));
+      messages.push_back(Message(Path(base, "max_load"), s.getMaxLoad(sampleRate)));
+      messages.push_back(
+          Message(Path(base, "calls_per_vector"), float(double(s.calls) / s.vectors)));
+    }
+    return messages;
+  }
+
+ private:
+  static constexpr SectionID kVectorMarker{0xFFFE};
+
+  struct Record
+  {
+    SectionID id{kNoSection};
+    uint32_t calls{0};
+    uint64_t ticks{0};
+    uint64_t selfTicks{0};
+  };
+
+  struct Section
+  {
+    Path name;
+    uint32_t calls{0};
+    uint64_t ticks{0};
+    uint64_t selfTicks{0};
+  };
+
+  struct Frame
+  {
+    SectionID id;
+    uint64_t startTicks;
+    uint64_t childTicks;
+  };
+
+  void pushRecord(const Record& r)
+  {
+    if (!records_.push(r))
+    {
+      droppedRecords_.store(droppedRecords_.load(std::memory_order_relaxed) + 1,
+                            std::memory_order_relaxed);
+    }
+  }
+
+  // audio thread state.
+  std::vector<Section> sections_;
+  Frame stack_[kMaxDepth]{};
+  int depth_{0};
+  SectionID touched_[kMaxSections]{};
+  size_t numTouched_{0};
+  bool active_{false};
+
+  std::atomic<bool> enabled_{false};
+  std::atomic<uint64_t> droppedRecords_{0};
+  Queue<Record> records_;
+
+  // collecting thread state.
+  std::vector<Stats> stats_;
+  uint64_t vectorsCollected_{0};
+};
+
+// times the enclosing block as a section of a DSPProfiler. The profiler may be null.
+class ProfileScope
+{
+ public:
+  ProfileScope(DSPProfiler* profiler, DSPProfiler::SectionID id) : profiler_(profiler)
+  {
+    if (profiler_) profiler_->beginSection(id);
+  }
+  ~ProfileScope()
+  {
+    if (profiler_) profiler_->endSection();
+  }
+
+  ProfileScope(const ProfileScope&) = delete;
+  ProfileScope& operator=(const ProfileScope&) = delete;
+
+ private:
+  DSPProfiler* profiler_;
+};
+
+#define ML_PROFILE_CONCAT_(a, b) a##b
+#define ML_PROFILE_CONCAT(a, b) ML_PROFILE_CONCAT_(a, b)
+
+// time the rest of the enclosing block as the section id of the DSPProfiler* profiler.
+#define ML_PROFILE_SCOPE(profiler, id) \
+  ml::ProfileScope ML_PROFILE_CONCAT(mlProfileScope_, __LINE__)(profiler, id)
+
+}  // namespace ml
@@ -13,18 +13,66 @@ namespace ml
 
 // Effect: Base class for audio effects
 // - Default implementation: multichannel passthrough
-// - Override processVector() for your processing
+// - Override processEffect() for your processing
 // - Infer number of i/o channels from DSPVectorDynamic sizes
+//
+// With setSleepWhenSilent(), the effect stops calling processEffect() once its
+// inputs have been silent for longer than its tail, and outputs zeros until an
+// input is not silent again. The tail is either declared with
+// setTailInSeconds(), or measured by waiting for the outputs to be silent.
+// Subclasses that override processVector() directly don't sleep.
 
 class Effect : public SignalProcessor {
 public:
+  // peak level below which a DSPVector is silent, about -100 dB.
+  static constexpr float kSilenceThreshold = 1.0e-5f;
+
+  // with a measured tail, the outputs must be silent for this long.
+  static constexpr float kMeasuredTailHoldSeconds = 0.05f;
+
   Effect() = default;
   virtual ~Effect() = default;
 
-  // Default implementation: multichannel passthrough
   void processVector(const DSPVectorDynamic& inputs,
                     DSPVectorDynamic& outputs,
                     void* stateData) override {
+    if (!sleepWhenSilent_) {
+      processEffect(inputs, outputs, stateData);
+      return;
+    }
+
+    const bool inputsSilent = isSilent(inputs);
+    if (!inputsSilent) {
+      silentFrames_ = 0;
+      asleep_ = false;
+    }
+    if (asleep_) {
+      for (int i = 0; i < outputs.size(); ++i) {
+        outputs[i] = DSPVector{0.f};
+      }
+      return;
+    }
+
+    processEffect(inputs, outputs, stateData);
+    if (!inputsSilent) return;
+
+    // measure the tail by counting silent frames of output, or of input when the
+    // tail is declared.
+    if (tailInSeconds_ < 0.f) {
+      silentFrames_ = isSilent(outputs) ? silentFrames_ + kFloatsPerDSPVector : 0;
+    } else {
+      silentFrames_ += kFloatsPerDSPVector;
+    }
+    if (silentFrames_ > getTailFrames()) {
+      asleep_ = true;
+      onSleep();
+    }
+  }
+
+  // Default implementation: multichannel passthrough
+  virtual void processEffect(const DSPVectorDynamic& inputs,
+                             DSPVectorDynamic& outputs,
+                             void* stateData) {
     int numInputs = inputs.size();
     int numOutputs = outputs.size();
 
@@ -39,6 +87,42 @@ public:
       outputs[i] = DSPVector{0.f};
     }
   }
+
+  // Off by default. Turning it off wakes the effect.
+  void setSleepWhenSilent(bool b) {
+    sleepWhenSilent_ = b;
+    asleep_ = false;
+    silentFrames_ = 0;
+  }
+
+  // A negative tail is measured from the outputs. This is the default.
+  void setTailInSeconds(float seconds) { tailInSeconds_ = seconds; }
+  float getTailInSeconds() const { return tailInSeconds_; }
+
+  bool isAsleep() const { return asleep_; }
+
+protected:
+  // called when the effect goes to sleep. Effects can clear their state here,
+  // so that leftovers below the silence threshold are not heard on waking.
+  virtual void onSleep() {}
+
+  static bool isSilent(const DSPVectorDynamic& signals) {
+    for (int i = 0; i < signals.size(); ++i) {
+      if (max(abs(signals[i])) >= kSilenceThreshold) return false;
+    }
+    return true;
+  }
+
+private:
+  size_t getTailFrames() const {
+    const float seconds = (tailInSeconds_ < 0.f) ? kMeasuredTailHoldSeconds : tailInSeconds_;
+    return static_cast<size_t>(seconds * getSampleRate());
+  }
+
+  bool sleepWhenSilent_ = false;
+  bool asleep_ = false;
+  float tailInSeconds_ = -1.f;
+  size_t silentFrames_ = 0;
 };
 
 } // namespace ml
@@ -0,0 +1,130 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLEventScheduler.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ml
+{
+namespace
+{
+constexpr double kTimeUnitsPerSecond{4294967296.};
+
+// the fraction of the difference between the clock and the mapped time of each buffer that
+// the mapping moves by.
+constexpr double kClockSmoothing{0.02};
+
+// a larger difference means the stream was interrupted, and the mapping starts again.
+constexpr double kMaxClockErrorInSeconds{0.1};
+
+// the seconds from a to b, which can be negative.
+double secondsBetween(Time a, Time b) { return double(int64_t(b - a)) / kTimeUnitsPerSecond; }
+
+Time addSeconds(Time t, double seconds) { return t + Time(int64_t(seconds * kTimeUnitsPerSecond)); }
+}  // namespace
+
+EventScheduler::EventScheduler(size_t capacity) : queue_(capacity)
+{
+  pending_.reserve(capacity);
+  contextEvents_.resize(EventsToSignals::kMaxEventsPerProcessBuffer);
+}
+
+bool EventScheduler::schedule(Time t, const Event& e)
+{
+  if (!queue_.push(TimedEvent{t, 0, e}))
+  {
+    droppedEvents_++;
+    return false;
+  }
+  return true;
+}
+
+Time EventScheduler::getBufferStartTime(Time now, uint64_t samples, double sampleRate)
+{
+  if (!anchored_ || (sampleRate != sampleRate_) || (samples < anchorSamples_))
+  {
+    anchored_ = true;
+    anchorTime_ = now;
+    anchorSamples_ = samples;
+    sampleRate_ = sampleRate;
+    return now;
+  }
+
+  Time mapped = addSeconds(anchorTime_, double(samples - anchorSamples_) / sampleRate);
+  double error = secondsBetween(mapped, now);
+  if (std::fabs(error) > kMaxClockErrorInSeconds)
+  {
+    anchorTime_ = now;
+    anchorSamples_ = samples;
+    return now;
+  }
+
+  anchorTime_ = addSeconds(anchorTime_, error * kClockSmoothing);
+  return addSeconds(mapped, error * kClockSmoothing);
+}
+
+size_t EventScheduler::readEvents(Time now, const AudioContext::ProcessTime& time,
+                                  int bufferSize, Event* events, size_t maxEvents)
+{
+  // move newly scheduled events to the heap.
+  TimedEvent t;
+  while (queue_.pop(t))
+  {
+    if (pending_.size() == pending_.capacity())
+    {
+      droppedEvents_++;
+      continue;
+    }
+    t.order = order_++;
+    pending_.push_back(t);
+    std::push_heap(pending_.begin(), pending_.end(), later);
+  }
+
+  const double sr = time.sampleRate;
+  if (sr <= 0.) return 0;
+  const Time bufferStart = getBufferStartTime(now, time.samplesSinceStart, sr);
+
+  size_t n{0};
+  while (!pending_.empty() && (n < maxEvents))
+  {
+    const TimedEvent& next = pending_.front();
+    double offset{0.};
+    if (next.time != kImmediately)
+    {
+      offset = std::floor(secondsBetween(bufferStart, next.time) * sr);
+      if (offset >= bufferSize) break;
+      if (offset < 0.)
+      {
+        lateEvents_++;
+        offset = 0.;
+      }
+    }
+
+    Event e = next.event;
+    e.time = static_cast<int>(offset);
+    events[n++] = e;
+    std::pop_heap(pending_.begin(), pending_.end(), later);
+    pending_.pop_back();
+  }
+  return n;
+}
+
+void EventScheduler::addEventsToContext(Time now, AudioContext& context, int bufferSize)
+{
+  size_t n = readEvents(now, context.getTimeInfo(), bufferSize, contextEvents_.data(),
+                        contextEvents_.size());
+  context.addInputEvents(contextEvents_.data(), n, true);
+}
+
+void EventScheduler::clear()
+{
+  TimedEvent t;
+  while (queue_.pop(t));
+  pending_.clear();
+  anchored_ = false;
+}
+
+}  // namespace ml
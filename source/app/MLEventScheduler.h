@@ -0,0 +1,99 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// EventScheduler: plays Events at given Times, to the sample.
+//
+// Any thread can schedule an Event at a Time on the Clock's timeline, such as the time tag of an
+// OSC bundle. Events go through a lock-free queue to the audio thread, which keeps the ones
+// still in the future in a heap ordered by time. At the start of each process buffer, the audio
+// thread calls readEvents() with the current time. This maps the buffer to a span of Times and
+// returns the Events due in it, each with its sample offset in the buffer.
+//
+// The mapping from samples to Times advances by exactly the samples processed, counted by the
+// ProcessTime, and follows the clock only slowly. So jitter in when the callbacks run does not
+// move the events. Events due before the buffer play at its start and are counted as late,
+// unless they were scheduled kImmediately.
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include "MLAudioContext.h"
+#include "MLClock.h"
+#include "MLEvent.h"
+#include "MLQueue.h"
+
+namespace ml
+{
+class EventScheduler final
+{
+ public:
+  static constexpr size_t kDefaultCapacity{1024};
+
+  // events scheduled at this Time play at the start of the next buffer. This is also the
+  // OSC time tag for "immediately".
+  static constexpr Time kImmediately{1};
+
+  // make a scheduler that can hold the given number of events, both in its queue and waiting
+  // for their times. Not real-time safe.
+  explicit EventScheduler(size_t capacity = kDefaultCapacity);
+  ~EventScheduler() = default;
+
+  EventScheduler(EventScheduler const&) = delete;
+  EventScheduler& operator=(EventScheduler const&) = delete;
+
+  // schedule an event at a time, from any thread. The event's own time is ignored. Returns
+  // false if the queue is full and the event was dropped.
+  bool schedule(Time t, const Event& e);
+
+  // on the audio thread: find the events due in the buffer of bufferSize samples starting now,
+  // at the sample rate of the ProcessTime. Up to maxEvents of them are written to events in
+  // time order, with their sample offsets, and the number written is returned. Any more are
+  // kept for the next buffer.
+  size_t readEvents(Time now, const AudioContext::ProcessTime& time, int bufferSize,
+                    Event* events, size_t maxEvents);
+
+  // on the audio thread: add the events due in the buffer to the context's input events.
+  void addEventsToContext(Time now, AudioContext& context, int bufferSize);
+
+  // on the audio thread: drop all the waiting events and start a new mapping of samples to
+  // Times at the next buffer.
+  void clear();
+
+  size_t getLateEventCount() const { return lateEvents_; }
+  size_t getDroppedEventCount() const { return droppedEvents_; }
+
+ private:
+  struct TimedEvent
+  {
+    Time time{0};
+    uint64_t order{0};
+    Event event;
+  };
+
+  // heap order: the soonest event, and of those the first scheduled, is at the front.
+  static bool later(const TimedEvent& a, const TimedEvent& b)
+  {
+    return (a.time != b.time) ? (a.time > b.time) : (a.order > b.order);
+  }
+
+  Time getBufferStartTime(Time now, uint64_t samples, double sampleRate);
+
+  MPMCQueue<TimedEvent> queue_;
+
+  // audio thread state.
+  std::vector<TimedEvent> pending_;
+  std::vector<Event> contextEvents_;
+  uint64_t order_{0};
+  bool anchored_{false};
+  Time anchorTime_{0};
+  uint64_t anchorSamples_{0};
+  double sampleRate_{0.};
+
+  std::atomic<size_t> lateEvents_{0};
+  std::atomic<size_t> droppedEvents_{0};
+};
+
+}  // namespace ml
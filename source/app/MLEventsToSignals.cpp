@@ -4,6 +4,7 @@
 
 #include "MLSymbol.h"
 #include "MLEventsToSignals.h"
+#include <algorithm>
 #include <cassert>
 
 namespace ml
@@ -61,7 +62,8 @@ void EventsToSignals::Voice::setDriftAmount(float d) { driftAmount = d; }
 // done when DSP is reset.
 void EventsToSignals::Voice::reset()
 {
-  driftSource.seed_ = voiceIndex * 232;
+  driftCounter = 0;
+  nextDriftTimeInSamples = 0;
 
   nextFrameToProcess = 0;
   eventAgeInSamples = 0;
@@ -76,12 +78,6 @@ void EventsToSignals::Voice::reset()
   currentZ = 0;
 
   creatorKeyIdx_ = 0;
-
-  pitchBendGlide.setValue(0.f);
-  modGlide.setValue(0.f);
-  xGlide.setValue(0.f);
-  yGlide.setValue(0.f);
-  zGlide.setValue(0.f);
 }
 
 // just reset the time.
@@ -101,29 +97,11 @@ void EventsToSignals::Voice::beginProcess()
       pitchGlide.setGlideTimeInSamples(pitchGlideTimeInSamples);
     }
 
-    pitchBendGlide.setGlideTimeInSamples(sr * kGlideTimeSeconds);
-    modGlide.setGlideTimeInSamples(sr * kGlideTimeSeconds);
-    xGlide.setGlideTimeInSamples(sr * kGlideTimeSeconds);
-    yGlide.setGlideTimeInSamples(sr * kGlideTimeSeconds);
-    zGlide.setGlideTimeInSamples(sr * kGlideTimeSeconds);
-
-    pitchDriftGlide.setGlideTimeInSamples(sr * kDriftTimeSeconds);
-
     recalcNeeded = false;
   }
 
   nextFrameToProcess = 0;
   driftCounter += kFloatsPerDSPVector;
-
-  int driftIntervalSamples = (int)(sr * kDriftTimeSeconds);
-  if (driftCounter >= nextDriftTimeInSamples)
-  {
-    float d = driftSource.getFloat();
-    float nextTimeMul = 1.0f + fabs(driftSource.getFloat());
-    currentDriftValue = d;
-    driftCounter = 0;
-    nextDriftTimeInSamples = (int)(sr * nextTimeMul * kDriftTimeSeconds);
-  }
 }
 
 void EventsToSignals::Voice::writeNoteEvent(const Event& e, int keyIdx, bool doGlide, bool doReset)
@@ -221,7 +199,7 @@ void EventsToSignals::Voice::writeNoteEvent(const Event& e, int keyIdx, bool doG
   }
 }
 
-void EventsToSignals::Voice::endProcess(float pitchBend)
+void EventsToSignals::Voice::endProcess()
 {
   for (int t = (int)nextFrameToProcess; t < kFloatsPerDSPVector; ++t)
   {
@@ -236,24 +214,10 @@ void EventsToSignals::Voice::endProcess(float pitchBend)
     outputs.row(kElapsedTime)[t] = samplesToSeconds(eventAgeInSamples, sr);
   }
 
-  // process glides, accurate to the DSP vector
-  auto bendGlide = pitchBendGlide(currentPitchBend);
-  auto driftSig = pitchDriftGlide(currentDriftValue);
-  outputs.row(kMod) = modGlide(currentMod);
-  outputs.row(kX) = xGlide(currentX);
-  outputs.row(kY) = yGlide(currentY);
-
   if (currentVelocity == 0.f)
   {
     currentZ = 0.f;
   }
-  outputs.row(kZ) = zGlide(currentZ);
-
-  // add pitch bend in semitones to pitch output
-  outputs.row(kPitch) += bendGlide * pitchBend * (1.f / 12);
-
-  // add drift to pitch output
-  outputs.row(kPitch) += driftSig * driftAmount * kDriftScale;
 }
 
 #pragma mark -
@@ -287,18 +251,9 @@ void EventsToSignals::SmoothedController::process()
 
 EventsToSignals::EventsToSignals()
 {
-  eventBuffer_.reserve(kMaxEventsPerProcessBuffer);
-
-  voices.resize(kMaxVoices + 1);
-  for (int i = 0; i < voices.size(); ++i)
-  {
-    voices[i].voiceIndex = i;
-    voices[i].reset();
-
-    // set vox output signal
-    voices[i].outputs.row(kVoice) = DSPVector((float)i - 1);
-  }
-
+  setEventCapacity(kMaxEventsPerProcessBuffer);
+  coalesceStamps_.resize(kCoalesceChannels * kCoalesceKeysPerChannel);
+  allocateVoices(0);
   controllers.resize(kNumControllers);
 }
 
@@ -317,27 +272,97 @@ void EventsToSignals::setSampleRate(double r)
   {
     c.setSampleRate(r);
   }
+
+  setVoiceGlideTimes();
+  setVoiceSleepTimeInSeconds(sleepTimeInSeconds_);
+}
+
+void EventsToSignals::setVoiceGlideTimes()
+{
+  for (int v = 0; v < voices.size(); ++v)
+  {
+    for (int g = 0; g < kNumVoiceGlides; ++g)
+    {
+      float glideTime = (g == kDriftGlide) ? kDriftTimeSeconds : kGlideTimeSeconds;
+      voiceGlides_.setGlideTimeInSamples(voiceGlideIndex(VoiceGlide(g), v), sr * glideTime);
+    }
+  }
+}
+
+// make storage for n voices plus the MPE main voice, keeping the existing voices.
+void EventsToSignals::allocateVoices(size_t n)
+{
+  size_t oldSize = voices.size();
+  size_t newSize = std::max(n, kMinVoiceStorage) + 1;
+  if (newSize == oldSize) return;
+
+  voices.resize(newSize);
+  voices.shrink_to_fit();
+  for (size_t i = oldSize; i < newSize; ++i)
+  {
+    Voice& v = voices[i];
+    v.voiceIndex = static_cast<int>(i);
+    v.setSampleRate(sr);
+    v.setPitchGlideInSeconds(pitchGlideInSeconds_);
+    v.setDriftAmount(driftAmount_);
+    v.reset();
+
+    // set vox output signal
+    v.outputs.row(kVoice) = DSPVector((float)i - 1);
+  }
+
+  voiceSlots_.resize(newSize);
+  voiceGlides_.resize(kNumVoiceGlides * newSize);
+  setVoiceGlideTimes();
+  resetVoiceLists();
 }
 
 size_t EventsToSignals::setPolyphony(size_t n)
 {
-  clear();
   polyphony_ = std::min(n, kMaxVoices);
+  allocateVoices(polyphony_);
+  clear();
   return polyphony_;
 }
 
-size_t EventsToSignals::getPolyphony() { return polyphony_; }
+void EventsToSignals::setVoiceSleepTimeInSeconds(float t)
+{
+  sleepTimeInSeconds_ = t;
+  sleepTimeInVectors_ = (t < 0.f) ? -1 : static_cast<int>(t * sr / kFloatsPerDSPVector);
+  if (sleepTimeInVectors_ < 0)
+  {
+    for (int v = 1; v < voiceSlots_.size(); ++v)
+    {
+      if (voiceSlots_[v].asleep) wakeVoice(v);
+    }
+  }
+}
+
+void EventsToSignals::setVoiceInaudible(int n)
+{
+  int v = n + 1;
+  if ((v < 1) || (v > static_cast<int>(polyphony_)) || voiceSlots_[v].active) return;
+  if (freeVoices_.head == v) return;
+  removeVoice(freeVoices_, v);
+  pushVoiceFront(freeVoices_, v);
+}
+
+size_t EventsToSignals::getPolyphony() const { return polyphony_; }
 
 void EventsToSignals::clear()
 {
   eventBuffer_.clear();
+  droppedEvents_ = 0;
+  coalescedEvents_ = 0;
 
-  for (auto& v : voices)
+  for (int v = 0; v < voices.size(); ++v)
   {
-    v.reset();
+    voices[v].reset();
+    resetVoiceGlides(v);
   }
+  driftRandoms_.clear();
 
-  lastFreeVoiceFound_ = 0;
+  resetVoiceLists();
 }
 
 void EventsToSignals::resetTimes()
@@ -348,8 +373,6 @@ void EventsToSignals::resetTimes()
   {
     v.resetTime();
   }
-
-  lastFreeVoiceFound_ = 0;
 }
 
 // sort by time for buffer insertion.
@@ -367,17 +390,92 @@ bool soonerThan(const Event& a, const Event& b)
   }
 }
 
+// stable merge sort of the events in [begin, end), using scratch space of the same size.
+static void sortEvents(Event* begin, Event* end, Event* scratch)
+{
+  size_t n = end - begin;
+  Event* src = begin;
+  Event* dest = scratch;
+  for (size_t width = 1; width < n; width *= 2)
+  {
+    for (size_t i = 0; i < n; i += 2 * width)
+    {
+      size_t mid = std::min(i + width, n);
+      size_t hi = std::min(i + 2 * width, n);
+      std::merge(src + i, src + mid, src + mid, src + hi, dest + i, soonerThan);
+    }
+    std::swap(src, dest);
+  }
+  if (src != begin)
+  {
+    std::copy(src, src + n, begin);
+  }
+}
+
 // events should usually arrive in order, but unfortunately not all hosts will ensure this.
 // so we need to insert events by time on arrival.
 void EventsToSignals::addEvent(const Event& e)
 {
   awake_ = true;
-  auto it = std::lower_bound(eventBuffer_.begin(), eventBuffer_.end(), e, soonerThan);
-  eventBuffer_.insert(it, e);
+  if (eventBuffer_.size() >= eventScratch_.size())
+  {
+    droppedEvents_++;
+    return;
+  }
+  if (eventBuffer_.empty() || !soonerThan(e, eventBuffer_.back()))
+  {
+    eventBuffer_.push_back(e);
+  }
+  else
+  {
+    auto it = std::upper_bound(eventBuffer_.begin(), eventBuffer_.end(), e, soonerThan);
+    eventBuffer_.insert(it, e);
+  }
+}
+
+void EventsToSignals::addEvents(const Event* events, size_t n, bool alreadySorted)
+{
+  if (n == 0) return;
+  awake_ = true;
+
+  size_t start = eventBuffer_.size();
+  size_t room = eventScratch_.size() - start;
+  if (n > room)
+  {
+    droppedEvents_ += n - room;
+    n = room;
+  }
+  eventBuffer_.insert(eventBuffer_.end(), events, events + n);
+
+  Event* pBuf = eventBuffer_.data();
+  Event* pEnd = pBuf + eventBuffer_.size();
+  Event* pNew = pBuf + start;
+  if (!alreadySorted && !std::is_sorted(pNew, pEnd, soonerThan))
+  {
+    sortEvents(pNew, pEnd, eventScratch_.data());
+  }
+
+  // merge with the events already in the buffer, unless the new ones all come after.
+  if ((start > 0) && (pNew < pEnd) && soonerThan(*pNew, pNew[-1]))
+  {
+    std::merge(pBuf, pNew, pNew, pEnd, eventScratch_.data(), soonerThan);
+    std::copy(eventScratch_.data(), eventScratch_.data() + eventBuffer_.size(), pBuf);
+  }
 }
 
 void EventsToSignals::clearEvents() { eventBuffer_.clear(); }
 
+void EventsToSignals::setEventCapacity(size_t n)
+{
+  eventBuffer_.reserve(n);
+  if (eventBuffer_.size() > n)
+  {
+    droppedEvents_ += eventBuffer_.size() - n;
+    eventBuffer_.resize(n);
+  }
+  eventScratch_.resize(n);
+}
+
 // assuming the buffer is in sorted order, process all the events within
 // the vector starting at startOffset.
 void EventsToSignals::processVector(int startTime)
@@ -389,10 +487,11 @@ void EventsToSignals::processVector(int startTime)
   if (sr == 0.f) return;
 
   // start processing each voice's vector of audio data
-  for (auto& v : voices)
+  for (int v = 0; v < polyphony_ + 1; ++v)
   {
-    v.beginProcess();
+    if (!voiceSlots_[v].asleep) voices[v].beginProcess();
   }
+  updateDrift();
 
   if (eventBuffer_.size() > 0)
   {
@@ -404,6 +503,10 @@ void EventsToSignals::processVector(int startTime)
   // process any events in the buffer that are within this vector,
   // sending changes to voices and controller smoothers
   int endTime = startTime + kFloatsPerDSPVector;
+  if (coalesceEvents_)
+  {
+    coalesceEvents(startTime, endTime);
+  }
   for (const auto& e : eventBuffer_)
   {
     if (within(e.time, startTime, endTime))
@@ -420,13 +523,11 @@ void EventsToSignals::processVector(int startTime)
 
   // end voice processing, making complete outgoing signals
   // MPE main voice (index 0) uses MIDI pitch bend setting
-  voices[0].endProcess(pitchBendRangeInSemitones_);
-  float voicesPitchBend =
-      (protocol_ == "MPE") ? mpePitchBendRangeInSemitones_ : pitchBendRangeInSemitones_;
-  for (int v = 1; v < polyphony_ + 1; ++v)
+  for (int v = 0; v < polyphony_ + 1; ++v)
   {
-    voices[v].endProcess(voicesPitchBend);
+    if (!voiceSlots_[v].asleep) voices[v].endProcess();
   }
+  processVoiceGlides();
 
   // make smoothed controller signals
   for (auto& c : controllers)
@@ -442,6 +543,7 @@ void EventsToSignals::processVector(int startTime)
     {
       for (int v = 1; v < polyphony_ + 1; ++v)
       {
+        if (voiceSlots_[v].asleep) continue;
         voices[v].outputs.row(kZ) += controllers[kChannelPressureControllerIdx].output;
       }
       break;
@@ -450,6 +552,7 @@ void EventsToSignals::processVector(int startTime)
     {
       for (int v = 1; v < polyphony_ + 1; ++v)
       {
+        if (voiceSlots_[v].asleep) continue;
         voices[v].outputs.row(kPitch) += voices[0].outputs.row(kPitch);
         voices[v].outputs.row(kX) += voices[0].outputs.row(kX);
         voices[v].outputs.row(kY) += voices[0].outputs.row(kY);
@@ -464,6 +567,8 @@ void EventsToSignals::processVector(int startTime)
     }
   }
 
+  updateSleepingVoices();
+
   testCounter += kFloatsPerDSPVector;
   const int samples = 48000;
   if (testCounter > samples)
@@ -486,6 +591,68 @@ size_t EventsToSignals::countHeldNotes()
   return heldNotes;
 }
 
+// return the key for the value an event sets, or -1 if the event does more than set a value.
+int EventsToSignals::getCoalesceKey(const Event& e)
+{
+  if (e.channel >= kCoalesceChannels) return -1;
+  int base = e.channel * kCoalesceKeysPerChannel;
+  switch (e.type)
+  {
+    case kController:
+    {
+      // all sound off and all notes off are actions.
+      if ((e.sourceIdx == 120) || (e.sourceIdx == 123)) return -1;
+      return base + std::min(int(e.sourceIdx), int(kNumControllers) - 1);
+    }
+    case kNotePressure:
+    {
+      if (e.sourceIdx >= kMaxPhysicalKeys) return -1;
+      return base + kNumControllers + e.sourceIdx;
+    }
+    case kPitchBend:
+      return base + kNumControllers + kMaxPhysicalKeys;
+    case kChannelPressure:
+      return base + kNumControllers + kMaxPhysicalKeys + 1;
+    default:
+      return -1;
+  }
+}
+
+// going backwards through the events in the vector, null out any event whose value is set
+// again later in the same run.
+void EventsToSignals::coalesceEvents(int startTime, int endTime)
+{
+  auto newRun = [&]()
+  {
+    if (++coalesceGeneration_ == 0)
+    {
+      std::fill(coalesceStamps_.begin(), coalesceStamps_.end(), 0);
+      coalesceGeneration_ = 1;
+    }
+  };
+
+  newRun();
+  for (auto it = eventBuffer_.rbegin(); it != eventBuffer_.rend(); ++it)
+  {
+    Event& e = *it;
+    if (e.type == kNull || !within(e.time, startTime, endTime)) continue;
+    int key = getCoalesceKey(e);
+    if (key < 0)
+    {
+      newRun();
+    }
+    else if (coalesceStamps_[key] == coalesceGeneration_)
+    {
+      e.type = kNull;
+      coalescedEvents_++;
+    }
+    else
+    {
+      coalesceStamps_[key] = coalesceGeneration_;
+    }
+  }
+}
+
 // process one incoming event by making the appropriate changes in state and change lists.
 void EventsToSignals::processEvent(const Event& eventParam)
 {
@@ -537,7 +704,7 @@ void EventsToSignals::processNoteOnEvent(const Event& e)
     // start after MPE main voice
     for (int v = 1; v < polyphony_ + 1; ++v)
     {
-      voices[v].writeNoteEvent(e, keyIdx, !firstNote, firstNote);
+      writeVoiceNote(v, e, keyIdx, !firstNote, firstNote);
     }
   }
   else
@@ -546,7 +713,7 @@ void EventsToSignals::processNoteOnEvent(const Event& e)
 
     if (v >= 1)
     {
-      voices[v].writeNoteEvent(e, keyIdx, true, true);
+      writeVoiceNote(v, e, keyIdx, true, true);
     }
     else
     {
@@ -557,7 +724,7 @@ void EventsToSignals::processNoteOnEvent(const Event& e)
       // are cut off. add more graceful stealing
       Event f = e;
       f.type = kNoteRetrig;
-      voices[v].writeNoteEvent(f, keyIdx, true, true);
+      writeVoiceNote(v, f, keyIdx, true, true);
     }
     newestVoice_ = v;
   }
@@ -582,7 +749,7 @@ void EventsToSignals::processNoteOffEvent(const Event& e)
     {
       for (int v = 1; v < polyphony_ + 1; ++v)
       {
-        voices[v].writeNoteEvent(e, 0, true, true);
+        writeVoiceNote(v, e, 0, true, true);
       }
     }
     else
@@ -615,7 +782,7 @@ void EventsToSignals::processNoteOffEvent(const Event& e)
         eventToSend.value1 = keyStates_[mostRecentHeldKey].pitch;
         for (int v = 1; v < polyphony_ + 1; ++v)
         {
-          voices[v].writeNoteEvent(eventToSend, mostRecentHeldKey, true, true);
+          writeVoiceNote(v, eventToSend, mostRecentHeldKey, true, true);
         }
       }
     }
@@ -626,12 +793,15 @@ void EventsToSignals::processNoteOffEvent(const Event& e)
     eventToSend.type = sustainPedalActive_ ? kNoteSustain : kNoteOff;
     if (!sustainPedalActive_)
     {
-      for (int v = 1; v < polyphony_ + 1; ++v)
+      // the voice may move to the free list, so get the next active voice first.
+      for (int v = activeVoices_.head; v;)
       {
+        int next = voiceSlots_[v].next;
         if (voices[v].creatorKeyIdx_ == keyIdx)
         {
-          voices[v].writeNoteEvent(eventToSend, keyIdx, true, true);
+          writeVoiceNote(v, eventToSend, keyIdx, true, true);
         }
+        v = next;
       }
     }
   }
@@ -660,7 +830,7 @@ void EventsToSignals::processChannelPressureEvent(const Event& event)
       else if (event.channel != 0)
       {
         // write any voice matching channel
-        for (int v = 1; v < polyphony_ + 1; ++v)
+        for (int v = activeVoices_.head; v; v = voiceSlots_[v].next)
         {
           if (voices[v].creatorKeyIdx_ == event.channel)
           {
@@ -681,7 +851,7 @@ void EventsToSignals::processNotePressureEvent(const Event& event)
     case (hash("MIDI")):
     {
       // write any voice matching key
-      for (int v = 1; v < polyphony_ + 1; ++v)
+      for (int v = activeVoices_.head; v; v = voiceSlots_[v].next)
       {
         if (voices[v].creatorKeyIdx_ == event.sourceIdx)
         {
@@ -720,7 +890,7 @@ void EventsToSignals::processPitchWheelEvent(const Event& event)
       else if (event.channel != 0)
       {
         // write any voice matching channel
-        for (int v = 1; v < polyphony_ + 1; ++v)
+        for (int v = activeVoices_.head; v; v = voiceSlots_[v].next)
         {
           if (voices[v].creatorKeyIdx_ == event.channel)
           {
@@ -757,11 +927,11 @@ void EventsToSignals::processControllerEvent(const Event& event)
     if (val == 0)
     {
       // all notes off
-      for (auto& v : voices)
+      for (int v = 0; v < polyphony_ + 1; ++v)
       {
         Event eventToSend = event;
         eventToSend.type = kNoteOff;
-        v.writeNoteEvent(eventToSend, 0, false, true);
+        writeVoiceNote(v, eventToSend, 0, false, true);
       }
     }
   }
@@ -803,7 +973,7 @@ void EventsToSignals::processControllerEvent(const Event& event)
         else
         {
           // modulate other voices matching event channel.
-          for (int v = 1; v < polyphony_ + 1; ++v)
+          for (int v = activeVoices_.head; v; v = voiceSlots_[v].next)
           {
             if (voices[v].creatorKeyIdx_ == event.channel)
             {
@@ -834,25 +1004,110 @@ void EventsToSignals::processSustainPedalEvent(const Event& event)
   if (!sustainPedalActive_)
   {
     // on release, clear any sustaining voices
-    for (int i = 1; i < polyphony_ + 1; ++i)
+    for (int v = activeVoices_.head; v;)
     {
-      Voice& v = voices[i];
-      if (keyStates_[v.creatorKeyIdx_].state == KeyState::kSustained)
+      int next = voiceSlots_[v].next;
+      if (keyStates_[voices[v].creatorKeyIdx_].state == KeyState::kSustained)
       {
         Event newEvent;
         newEvent.type = kNoteOff;
-        v.writeNoteEvent(newEvent, 0, true, true);
+        writeVoiceNote(v, newEvent, 0, true, true);
       }
+      v = next;
     }
   }
 }
 
+// the bend, mod, x, y and z glides go back to 0. Drift is left alone.
+void EventsToSignals::resetVoiceGlides(int voice)
+{
+  for (auto g : {kBendGlide, kModGlide, kXGlide, kYGlide, kZGlide})
+  {
+    voiceGlides_.setValue(voiceGlideIndex(g, voice), 0.f);
+  }
+}
+
+// pick new drift values and times for the awake voices whose drift times have passed. Each
+// voice has its own random stream, drawn for all the voices at once.
+void EventsToSignals::updateDrift()
+{
+  const int n = polyphony_ + 1;
+  bool anyDue{false};
+  for (int v = 0; v < n; ++v)
+  {
+    anyDue |= !voiceSlots_[v].asleep && voices[v].isDriftDue();
+  }
+  if (!anyDue) return;
+
+  const auto& values = driftRandoms_.uniform(n);
+  for (int v = 0; v < n; ++v)
+  {
+    if (!voiceSlots_[v].asleep && voices[v].isDriftDue())
+    {
+      voices[v].currentDriftValue = values[v];
+    }
+  }
+  const auto& times = driftRandoms_.uniform(n);
+  for (int v = 0; v < n; ++v)
+  {
+    Voice& voice = voices[v];
+    if (!voiceSlots_[v].asleep && voice.isDriftDue())
+    {
+      float nextTimeMul = 1.0f + fabs(times[v]);
+      voice.driftCounter = 0;
+      voice.nextDriftTimeInSamples = (int)(sr * nextTimeMul * kDriftTimeSeconds);
+    }
+  }
+}
+
+// glide the continuous signals of all voices at once, and add them to the voice outputs.
+void EventsToSignals::processVoiceGlides()
+{
+  size_t nVoices = polyphony_ + 1;
+  for (int v = 0; v < nVoices; ++v)
+  {
+    if (voiceSlots_[v].asleep) continue;
+    const Voice& voice = voices[v];
+    voiceGlides_.setTarget(voiceGlideIndex(kBendGlide, v), voice.currentPitchBend);
+    voiceGlides_.setTarget(voiceGlideIndex(kModGlide, v), voice.currentMod);
+    voiceGlides_.setTarget(voiceGlideIndex(kXGlide, v), voice.currentX);
+    voiceGlides_.setTarget(voiceGlideIndex(kYGlide, v), voice.currentY);
+    voiceGlides_.setTarget(voiceGlideIndex(kZGlide, v), voice.currentZ);
+    voiceGlides_.setTarget(voiceGlideIndex(kDriftGlide, v), voice.currentDriftValue);
+  }
+
+  voiceGlides_.process();
+
+  // MPE main voice (index 0) uses MIDI pitch bend setting
+  float voicesPitchBend =
+      (protocol_ == "MPE") ? mpePitchBendRangeInSemitones_ : pitchBendRangeInSemitones_;
+  for (int v = 0; v < nVoices; ++v)
+  {
+    if (voiceSlots_[v].asleep) continue;
+    Voice& voice = voices[v];
+    float pitchBend = (v == 0) ? pitchBendRangeInSemitones_ : voicesPitchBend;
+    voice.outputs.row(kMod) = voiceGlides_.getRamp(voiceGlideIndex(kModGlide, v));
+    voice.outputs.row(kX) = voiceGlides_.getRamp(voiceGlideIndex(kXGlide, v));
+    voice.outputs.row(kY) = voiceGlides_.getRamp(voiceGlideIndex(kYGlide, v));
+    voice.outputs.row(kZ) = voiceGlides_.getRamp(voiceGlideIndex(kZGlide, v));
+
+    // add pitch bend in semitones to pitch output
+    auto bendGlide = voiceGlides_.getRamp(voiceGlideIndex(kBendGlide, v));
+    voice.outputs.row(kPitch) += bendGlide * pitchBend * (1.f / 12);
+
+    // add drift to pitch output
+    auto driftSig = voiceGlides_.getRamp(voiceGlideIndex(kDriftGlide, v));
+    voice.outputs.row(kPitch) += driftSig * voice.driftAmount * kDriftScale;
+  }
+}
+
 void EventsToSignals::setPitchBendInSemitones(float f) { pitchBendRangeInSemitones_ = f; }
 
 void EventsToSignals::setMPEPitchBendInSemitones(float f) { mpePitchBendRangeInSemitones_ = f; }
 
 void EventsToSignals::setPitchGlideInSeconds(float f)
 {
+  pitchGlideInSeconds_ = f;
   for (auto& v : voices)
   {
     v.setPitchGlideInSeconds(f);
@@ -861,6 +1116,7 @@ void EventsToSignals::setPitchGlideInSeconds(float f)
 
 void EventsToSignals::setDriftAmount(float f)
 {
+  driftAmount_ = f;
   for (auto& v : voices)
   {
     v.driftAmount = f;
@@ -872,53 +1128,155 @@ void EventsToSignals::setUnison(bool b) { unison_ = b; }
 #pragma mark -
 
 // return index of free voice or -1 for none.
-// if a free voice is found, increments lastFreeVoiceFound_.
+// this is the voice that was released longest ago.
 //
-int EventsToSignals::findFreeVoice()
+int EventsToSignals::findFreeVoice() { return freeVoices_.head ? freeVoices_.head : -1; }
+
+int EventsToSignals::findVoiceToSteal(Event e)
 {
-  auto highestVoiceIdx = polyphony_ + 1;
-  int r = -1;
-  int t = lastFreeVoiceFound_;
-  for (int i = 1; i < polyphony_ + 1; ++i)
+  // steal the voice with the oldest note.
+  // Must always return a valid voice index.
+  return activeVoices_.head;
+}
+
+// add a voice to the end of a list.
+void EventsToSignals::pushVoice(VoiceList& list, int v)
+{
+  VoiceSlot& slot = voiceSlots_[v];
+  slot.prev = list.tail;
+  slot.next = 0;
+  if (list.tail)
+  {
+    voiceSlots_[list.tail].next = v;
+  }
+  else
   {
-    t++;
-    if (t >= highestVoiceIdx) t = 1;
+    list.head = v;
+  }
+  list.tail = v;
+}
 
-    if (voices[t].creatorKeyIdx_ == 0)
-    {
-      r = t;
-      lastFreeVoiceFound_ = t;
-      break;
-    }
+// add a voice to the start of a list.
+void EventsToSignals::pushVoiceFront(VoiceList& list, int v)
+{
+  VoiceSlot& slot = voiceSlots_[v];
+  slot.prev = 0;
+  slot.next = list.head;
+  if (list.head)
+  {
+    voiceSlots_[list.head].prev = v;
+  }
+  else
+  {
+    list.tail = v;
+  }
+  list.head = v;
+}
+
+void EventsToSignals::removeVoice(VoiceList& list, int v)
+{
+  VoiceSlot& slot = voiceSlots_[v];
+  if (slot.prev)
+  {
+    voiceSlots_[slot.prev].next = slot.next;
+  }
+  else
+  {
+    list.head = slot.next;
+  }
+  if (slot.next)
+  {
+    voiceSlots_[slot.next].prev = slot.prev;
+  }
+  else
+  {
+    list.tail = slot.prev;
   }
+  slot.prev = slot.next = 0;
+}
 
-  return r;
+// all voices free and awake, in index order.
+void EventsToSignals::resetVoiceLists()
+{
+  freeVoices_ = VoiceList{};
+  activeVoices_ = VoiceList{};
+  for (auto& slot : voiceSlots_)
+  {
+    slot = VoiceSlot{};
+  }
+  for (int v = 1; v < polyphony_ + 1; ++v)
+  {
+    pushVoice(freeVoices_, v);
+  }
 }
 
-int EventsToSignals::findVoiceToSteal(Event e)
+void EventsToSignals::writeVoiceNote(int v, const Event& e, int keyIdx, bool doGlide,
+                                     bool doReset)
+{
+  bool isNoteOn = (e.type == kNoteOn) || (e.type == kNoteRetrig);
+  VoiceSlot& slot = voiceSlots_[v];
+  if (slot.asleep)
+  {
+    // a sleeping voice is already off.
+    if (!isNoteOn) return;
+    wakeVoice(v);
+  }
+
+  voices[v].writeNoteEvent(e, keyIdx, doGlide, doReset);
+  slot.vectorsFree = 0;
+  if (v == 0) return;
+
+  // new notes go to the end of the active list, and released voices to the end of the free list.
+  bool active = (voices[v].creatorKeyIdx_ != 0);
+  if (isNoteOn || (active != slot.active))
+  {
+    removeVoice(getVoiceList(slot.active), v);
+    slot.active = active;
+    pushVoice(getVoiceList(active), v);
+  }
+}
+
+// start processing a sleeping voice in the middle of a vector. Its glides jump to the values
+// that were set while it was asleep.
+void EventsToSignals::wakeVoice(int v)
 {
-  // just steal the voice with the nearest note.
-  return findNearestVoice(e.sourceIdx);
+  voiceSlots_[v].asleep = false;
+  Voice& voice = voices[v];
+  voice.beginProcess();
+  voiceGlides_.setValue(voiceGlideIndex(kBendGlide, v), voice.currentPitchBend);
+  voiceGlides_.setValue(voiceGlideIndex(kModGlide, v), voice.currentMod);
+  voiceGlides_.setValue(voiceGlideIndex(kXGlide, v), voice.currentX);
+  voiceGlides_.setValue(voiceGlideIndex(kYGlide, v), voice.currentY);
+  voiceGlides_.setValue(voiceGlideIndex(kZGlide, v), voice.currentZ);
+  voiceGlides_.setValue(voiceGlideIndex(kDriftGlide, v), voice.currentDriftValue);
 }
 
-// return the index of the voice with the note nearest to the note n.
-// Must always return a valid voice index.
-int EventsToSignals::findNearestVoice(int note)
+// true if none of the voice's signals are changing. The drift always wanders, so it only
+// counts if it is added to the pitch.
+bool EventsToSignals::isVoiceSettled(int v) const
 {
-  int r = 0;
-  size_t minDist = 128;
+  const Voice& voice = voices[v];
+  if (voice.pitchGlide.isGliding()) return false;
+  for (auto g : {kBendGlide, kModGlide, kXGlide, kYGlide, kZGlide})
+  {
+    if (voiceGlides_.isGliding(voiceGlideIndex(g, v))) return false;
+  }
+  return (voice.driftAmount == 0.f) || !voiceGlides_.isGliding(voiceGlideIndex(kDriftGlide, v));
+}
 
-  for (int v = 1; v < polyphony_ + 1; ++v)
+// put voices to sleep that have been free for the sleep time and have settled.
+void EventsToSignals::updateSleepingVoices()
+{
+  if (sleepTimeInVectors_ < 0) return;
+  for (int v = freeVoices_.head; v; v = voiceSlots_[v].next)
   {
-    size_t vNote = voices[v].creatorKeyIdx_;
-    size_t noteDist = std::abs(note - static_cast<int>(vNote));
-    if (noteDist < minDist)
+    VoiceSlot& slot = voiceSlots_[v];
+    if (slot.asleep) continue;
+    if ((++slot.vectorsFree > sleepTimeInVectors_) && isVoiceSettled(v))
     {
-      minDist = noteDist;
-      r = v;
+      slot.asleep = true;
     }
   }
-  return r;
 }
 
 void EventsToSignals::dumpVoices()
@@ -7,6 +7,7 @@
 #include "mldsp.h"
 #include "MLSymbol.h"
 #include "MLEvent.h"
+#include "MLSmoothingBank.h"
 
 namespace ml
 {
@@ -44,7 +45,11 @@ struct KeyState
 class EventsToSignals final
 {
  public:
-  static constexpr size_t kMaxVoices{16};
+  static constexpr size_t kMaxVoices{256};
+
+  // storage is always made for at least this many voices, so that getVoice() can be called for
+  // these without setting the polyphony.
+  static constexpr size_t kMinVoiceStorage{16};
   static constexpr size_t kMaxEventsPerProcessBuffer{128};
   static constexpr size_t kMaxPhysicalKeys{128};
   static constexpr size_t kNumControllers{129};
@@ -60,8 +65,21 @@ class EventsToSignals final
 
   void setSampleRate(double r);
 
+  // set the number of voices, up to kMaxVoices, and clear all voices. Allocates storage for the
+  // voices if needed, so this is not realtime safe.
   size_t setPolyphony(size_t n);
-  size_t getPolyphony();
+  size_t getPolyphony() const;
+
+  // a voice goes to sleep after it has been free for this long and its signals have stopped
+  // changing. Sleeping voices are not processed and their outputs hold their last values,
+  // including elapsed time, until a note wakes them. Set this longer than the longest release
+  // of the synth. The default of -1 turns sleeping off.
+  void setVoiceSleepTimeInSeconds(float t);
+
+  // Called when a released voice can no longer be heard. The voice moves to the front of the
+  // free list, so that new notes take it before voices whose releases are still sounding. Does
+  // nothing if the voice is playing a note.
+  void setVoiceInaudible(int n);
 
   // clear all voices and queued events and reset state.
   void clear();
@@ -69,11 +87,33 @@ class EventsToSignals final
   // just reset time outputs
   void resetTimes();
 
-  // inserts an event to the buffer sorted by time.
+  // inserts an event to the buffer sorted by time. Events at the same time and of the same
+  // type stay in the order they were added.
   void addEvent(const Event& e);
 
+  // add n events, such as all the events for a host buffer, sorting once. If the host guarantees
+  // that the events are in time order, pass alreadySorted to skip the sort. Either way the events
+  // are merged with any already in the buffer. Nothing is allocated.
+  void addEvents(const Event* events, size_t n, bool alreadySorted = false);
+
   void clearEvents();
 
+  // set the number of events the buffer can hold. Events added past this are dropped and
+  // counted. Not realtime safe.
+  void setEventCapacity(size_t n);
+  size_t getEventCapacity() const { return eventScratch_.size(); }
+
+  const std::vector<Event>& getEvents() const { return eventBuffer_; }
+  size_t getDroppedEventCount() const { return droppedEvents_; }
+
+  // controller, pressure and pitch bend events only set values that are glided once per vector,
+  // so when several in one vector set the same value, only the last one matters. With coalescing
+  // on, the default, the earlier ones are changed to kNull events in the buffer and skipped.
+  // Note events and the all sound off / all notes off controllers separate runs of events that
+  // are coalesced, so every voice still gets the values it would have got.
+  void setCoalesceEvents(bool b) { coalesceEvents_ = b; }
+  size_t getCoalescedEventCount() const { return coalescedEvents_; }
+
   // process incoming events in buffer and generate output signals.
   // events in the queue in the time range [startOffset, startOffset + kFloatsPerDSPVector) will
   // be processed. it is assumed that all events in the queue are sorted by start time. Any
@@ -112,11 +152,14 @@ class EventsToSignals final
     // send to start processing a new buffer.
     void beginProcess();
 
+    bool isDriftDue() const { return driftCounter >= nextDriftTimeInSamples; }
+
     // send a note on, off update or sustain event to the voice.
     void writeNoteEvent(const Event& e, int keyIdx, bool doGlide, bool doReset);
 
-    // write all current info to the end of the current buffer, scaling pitch bend
-    void endProcess(float pitchBend);
+    // write the sample-accurate signals to the end of the current buffer. The signals glided
+    // at vector rate are written by EventsToSignals for all voices together.
+    void endProcess();
 
     // data
 
@@ -143,19 +186,12 @@ class EventsToSignals final
 
     // pitch glide
     SampleAccurateLinearGlide pitchGlide;
-    LinearGlide pitchBendGlide;
-    LinearGlide modGlide;
-    LinearGlide xGlide;
-    LinearGlide yGlide;
-    LinearGlide zGlide;
     float pitchGlideTimeInSeconds{0};
     int pitchGlideTimeInSamples{0};
     bool inhibitPitchGlide{0};
 
-    // drift generates a wandering signal on [0, 1] then is scaled and added to pitch
-    // TODO encapsulate this as DrunkenWalkGen
-    RandomScalarSource driftSource;
-    LinearGlide pitchDriftGlide;
+    // drift generates a wandering signal on [0, 1] then is scaled and added to pitch. The
+    // random values come from the voice's stream in EventsToSignals::driftRandoms_.
     int driftCounter{0};
     float currentDriftValue{0};
     float driftAmount{0};
@@ -183,6 +219,8 @@ class EventsToSignals final
   // Lifetime management is an issue though: don't hang onto this reference!
   const Voice& getVoice(int n) const { return voices[n + 1]; }
 
+  bool isVoiceAsleep(int n) const { return voiceSlots_[n + 1].asleep; }
+
   // get voice which had a note on event most recently, if any
   int getNewestVoice() const { return newestVoice_ - 1; }
 
@@ -201,7 +239,64 @@ class EventsToSignals final
   void processSustainPedalEvent(const Event& event);
   int findFreeVoice();
   int findVoiceToSteal(Event e);
-  int findNearestVoice(int note);
+
+  // coalescing keys: one for each value set by a controller, note pressure, pitch bend or
+  // channel pressure event on each MIDI channel.
+  static constexpr int kCoalesceChannels{17};
+  static constexpr int kCoalesceKeysPerChannel{kNumControllers + kMaxPhysicalKeys + 2};
+  static int getCoalesceKey(const Event& e);
+  void coalesceEvents(int startTime, int endTime);
+
+  // free and active voices are kept in doubly-linked lists of voice indices, threaded through
+  // voiceSlots_, so that finding a voice to play or steal takes constant time. The free list is
+  // in order of release and the active list in order of note on, so new notes get the voice
+  // released longest ago, and stealing takes the oldest note. The MPE main voice is in neither
+  // list, so index 0 marks the ends.
+  struct VoiceSlot
+  {
+    int prev{0};
+    int next{0};
+    bool active{false};
+    bool asleep{false};
+    uint32_t vectorsFree{0};
+  };
+
+  struct VoiceList
+  {
+    int head{0};
+    int tail{0};
+  };
+
+  VoiceList& getVoiceList(bool active) { return active ? activeVoices_ : freeVoices_; }
+  void pushVoice(VoiceList& list, int v);
+  void pushVoiceFront(VoiceList& list, int v);
+  void removeVoice(VoiceList& list, int v);
+  void resetVoiceLists();
+  void allocateVoices(size_t n);
+
+  // send a note event to a voice, waking it if needed and keeping the voice lists up to date.
+  void writeVoiceNote(int v, const Event& e, int keyIdx, bool doGlide, bool doReset);
+  void wakeVoice(int v);
+  bool isVoiceSettled(int v) const;
+  void updateSleepingVoices();
+
+  // the continuous voice signals that glide at vector rate. Each kind is stored for all the
+  // voices together in voiceGlides_, so that they all update with SIMD.
+  enum VoiceGlide
+  {
+    kBendGlide = 0,
+    kModGlide,
+    kXGlide,
+    kYGlide,
+    kZGlide,
+    kDriftGlide,
+    kNumVoiceGlides
+  };
+  size_t voiceGlideIndex(VoiceGlide g, int voice) const { return g * voices.size() + voice; }
+  void setVoiceGlideTimes();
+  void resetVoiceGlides(int voice);
+  void processVoiceGlides();
+  void updateDrift();
 
   // voices, containing signals for clients to read directly.
   // voices[0] is the "main voice" used for MPE.
@@ -210,6 +305,15 @@ class EventsToSignals final
   // output values for continuous controllers.
   std::vector<SmoothedController> controllers;
 
+  SmoothingBank voiceGlides_;
+
+  // one random stream for each voice's drift.
+  RandomBank<kMaxVoices + 1> driftRandoms_;
+
+  std::vector<VoiceSlot> voiceSlots_;
+  VoiceList freeVoices_;
+  VoiceList activeVoices_;
+
   Symbol protocol_{"MIDI"};
 
   // set a special modulation # to send out in each voice
@@ -217,9 +321,20 @@ class EventsToSignals final
 
   std::array<KeyState, kMaxPhysicalKeys> keyStates_;
   std::vector<Event> eventBuffer_;
+  std::vector<Event> eventScratch_;
+  size_t droppedEvents_{0};
+
+  // the generation at which each coalescing key was last set.
+  std::vector<uint32_t> coalesceStamps_;
+  uint32_t coalesceGeneration_{0};
+  size_t coalescedEvents_{0};
+  bool coalesceEvents_{true};
 
   size_t polyphony_{0};
-  int lastFreeVoiceFound_{-1};
+  float sleepTimeInSeconds_{-1.f};
+  int sleepTimeInVectors_{-1};
+  float pitchGlideInSeconds_{0.f};
+  float driftAmount_{0.f};
   int newestVoice_{-1};
   bool sustainPedalActive_{false};
   double sr{0};
@@ -0,0 +1,159 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// FlatMap: a sorted map stored in two contiguous vectors, one of keys and one
+// of values.
+//
+// Lookups are binary searches over the packed keys, and iteration walks both
+// vectors in order, so small maps are much friendlier to the cache than
+// std::map and cost two heap blocks instead of one per element. Inserting is
+// O(n), which is fine for the small maps this is meant for.
+//
+// The interface is the subset of std::map used by Tree. Iterators dereference
+// to a proxy with first and second members rather than to a std::pair. As
+// with std::vector, inserting an element invalidates iterators, pointers and
+// references to the other elements.
+
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace ml
+{
+template <class K, class T, class C = std::less<K>>
+class FlatMap
+{
+  std::vector<K> keys_;
+  std::vector<T> values_;
+  C comparator_{};
+
+  template <bool kConst>
+  class Iter
+  {
+    using MapPtr = typename std::conditional<kConst, const FlatMap*, FlatMap*>::type;
+    using ValueRef = typename std::conditional<kConst, const T&, T&>::type;
+
+    MapPtr map_{nullptr};
+    size_t index_{0};
+
+   public:
+    struct Reference
+    {
+      const K& first;
+      ValueRef second;
+      const Reference* operator->() const { return this; }
+    };
+
+    Iter() = default;
+    Iter(MapPtr m, size_t i) : map_(m), index_(i) {}
+
+    // iterator converts to const_iterator
+    template <bool kOtherConst, typename = typename std::enable_if<kConst && !kOtherConst>::type>
+    Iter(const Iter<kOtherConst>& b) : map_(b.map_), index_(b.index_)
+    {
+    }
+
+    Reference operator*() const { return Reference{map_->keys_[index_], map_->values_[index_]}; }
+    Reference operator->() const { return operator*(); }
+
+    Iter& operator++()
+    {
+      index_++;
+      return *this;
+    }
+
+    Iter operator++(int)
+    {
+      Iter r = *this;
+      index_++;
+      return r;
+    }
+
+    bool operator==(const Iter& b) const { return (map_ == b.map_) && (index_ == b.index_); }
+    bool operator!=(const Iter& b) const { return !(*this == b); }
+
+    friend class FlatMap;
+    friend class Iter<!kConst>;
+  };
+
+  size_t lowerBoundIndex(const K& key) const
+  {
+    return std::lower_bound(keys_.begin(), keys_.end(), key, comparator_) - keys_.begin();
+  }
+
+  bool matches(size_t i, const K& key) const
+  {
+    return (i < keys_.size()) && !comparator_(key, keys_[i]);
+  }
+
+ public:
+  using key_type = K;
+  using mapped_type = T;
+  using size_type = size_t;
+  using iterator = Iter<false>;
+  using const_iterator = Iter<true>;
+
+  iterator begin() { return iterator(this, 0); }
+  iterator end() { return iterator(this, keys_.size()); }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, keys_.size()); }
+
+  size_t size() const { return keys_.size(); }
+  bool empty() const { return keys_.empty(); }
+
+  void clear()
+  {
+    keys_.clear();
+    values_.clear();
+  }
+
+  void reserve(size_t n)
+  {
+    keys_.reserve(n);
+    values_.reserve(n);
+  }
+
+  iterator find(const K& key)
+  {
+    size_t i = lowerBoundIndex(key);
+    return matches(i, key) ? iterator(this, i) : end();
+  }
+
+  const_iterator find(const K& key) const
+  {
+    size_t i = lowerBoundIndex(key);
+    return matches(i, key) ? const_iterator(this, i) : end();
+  }
+
+  // the element with the key, inserted with T(args...) if not present.
+  template <class... Args>
+  std::pair<iterator, bool> emplace(const K& key, Args&&... args)
+  {
+    size_t i = lowerBoundIndex(key);
+    if (matches(i, key)) return {iterator(this, i), false};
+    values_.emplace(values_.begin() + i, std::forward<Args>(args)...);
+    keys_.insert(keys_.begin() + i, key);
+    return {iterator(this, i), true};
+  }
+
+  // as emplace(), but constant time apart from the move when the key belongs just before hint.
+  template <class... Args>
+  iterator emplace_hint(const_iterator hint, const K& key, Args&&... args)
+  {
+    size_t i = hint.index_;
+    bool fits = (i <= keys_.size()) && ((i == 0) || comparator_(keys_[i - 1], key)) &&
+                ((i == keys_.size()) || comparator_(key, keys_[i]));
+    if (!fits) return emplace(key, std::forward<Args>(args)...).first;
+    values_.emplace(values_.begin() + i, std::forward<Args>(args)...);
+    keys_.insert(keys_.begin() + i, key);
+    return iterator(this, i);
+  }
+
+  T& operator[](const K& key) { return (*emplace(key).first).second; }
+};
+
+}  // namespace ml
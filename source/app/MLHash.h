@@ -5,6 +5,10 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
 namespace ml
 {
 
@@ -47,12 +51,152 @@ inline uint64_t fnv1aRuntime(const char* str, size_t n)
 
 inline uint64_t fnv1aRuntime(const char* str) { return fnv1aRuntime(str, strlen(str)); }
 
+// hashing: 64-bit text hash for Symbols and Paths
+//
+// A multiply-mix hash in the style of wyhash, reading 8 bytes per step, with
+// far fewer collisions than FNV-1a. textHash() can run at compile time.
+// textHashRuntime() gives the same results bit for bit using unaligned loads.
+
+namespace textHashConsts
+{
+constexpr uint64_t k0{0xa0761d6478bd642full};
+constexpr uint64_t k1{0xe7037ed1a0b428dbull};
+constexpr uint64_t k2{0x8ebc6af09c88c6e3ull};
+}  // namespace textHashConsts
+
+namespace detail
+{
+// the 128-bit product of a and b, as low and high words.
+constexpr void multiply128(uint64_t a, uint64_t b, uint64_t& lo, uint64_t& hi)
+{
+#if defined(__SIZEOF_INT128__)
+  __uint128_t r = static_cast<__uint128_t>(a) * b;
+  lo = static_cast<uint64_t>(r);
+  hi = static_cast<uint64_t>(r >> 64);
+#else
+  uint64_t aLo = a & 0xffffffff, aHi = a >> 32;
+  uint64_t bLo = b & 0xffffffff, bHi = b >> 32;
+  uint64_t ll = aLo * bLo, lh = aLo * bHi, hl = aHi * bLo, hh = aHi * bHi;
+  uint64_t mid = (ll >> 32) + (lh & 0xffffffff) + (hl & 0xffffffff);
+  lo = (ll & 0xffffffff) | (mid << 32);
+  hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+#endif
+}
+
+constexpr uint64_t mix(uint64_t a, uint64_t b)
+{
+  uint64_t lo{0}, hi{0};
+  multiply128(a, b, lo, hi);
+  return lo ^ hi;
+}
+
+// little-endian reads, one byte at a time so that they can run at compile
+// time.
+constexpr uint64_t readConst8(const char* p)
+{
+  uint64_t r{0};
+  for (int i = 7; i >= 0; --i)
+  {
+    r = (r << 8) | static_cast<uint8_t>(p[i]);
+  }
+  return r;
+}
+
+constexpr uint64_t readConst4(const char* p)
+{
+  uint64_t r{0};
+  for (int i = 3; i >= 0; --i)
+  {
+    r = (r << 8) | static_cast<uint8_t>(p[i]);
+  }
+  return r;
+}
+
+inline uint64_t read8(const char* p)
+{
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+  return readConst8(p);
+#else
+  uint64_t r;
+  memcpy(&r, p, 8);
+  return r;
+#endif
+}
+
+inline uint64_t read4(const char* p)
+{
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+  return readConst4(p);
+#else
+  uint32_t r;
+  memcpy(&r, p, 4);
+  return r;
+#endif
+}
+
+// 0 marks an empty entry in SymbolTable and a null Symbol, so no text may hash to it.
+constexpr uint64_t nonzeroHash(uint64_t h) { return h ? h : 1; }
+
+// the body of the hash, shared by the compile-time and runtime versions.
+template <uint64_t (*R8)(const char*), uint64_t (*R4)(const char*)>
+constexpr uint64_t textHash(const char* p, size_t len)
+{
+  using namespace textHashConsts;
+  uint64_t seed = mix(k0, k1);
+  uint64_t a{0}, b{0};
+  if (len <= 16)
+  {
+    if (len >= 4)
+    {
+      // two overlapping 4-byte reads from each end.
+      size_t step = (len >> 3) << 2;
+      a = (R4(p) << 32) | R4(p + step);
+      b = (R4(p + len - 4) << 32) | R4(p + len - 4 - step);
+    }
+    else if (len > 0)
+    {
+      a = (uint64_t(static_cast<uint8_t>(p[0])) << 16) |
+          (uint64_t(static_cast<uint8_t>(p[len >> 1])) << 8) | static_cast<uint8_t>(p[len - 1]);
+    }
+  }
+  else
+  {
+    const char* q = p;
+    size_t i = len;
+    while (i > 16)
+    {
+      seed = mix(R8(q) ^ k1, R8(q + 8) ^ seed);
+      q += 16;
+      i -= 16;
+    }
+    // the last 16 bytes, which may overlap the ones before.
+    a = R8(p + len - 16);
+    b = R8(p + len - 8);
+  }
+  uint64_t lo{0}, hi{0};
+  multiply128(a ^ k1, b ^ seed, lo, hi);
+  return nonzeroHash(mix(lo ^ k0 ^ len, hi ^ k2));
+}
+}  // namespace detail
+
+constexpr uint64_t textHash(const char* s, size_t len)
+{
+  return detail::textHash<detail::readConst8, detail::readConst4>(s, len);
+}
+
+inline uint64_t textHashRuntime(const char* s, size_t len)
+{
+  return detail::textHash<detail::read8, detail::read4>(s, len);
+}
+
+inline uint64_t textHashRuntime(const char* s) { return textHashRuntime(s, strlen(s)); }
+
 // the main hashing function for string literals, used in for example case(hash("foo"))
 
 template <size_t N>
 constexpr uint64_t hash(const char (&sym)[N])
 {
-  return fnv1aSubstring(sym, N - 1);
+  return textHash(sym, N - 1);
 }
 
 }  // namespace ml
@@ -22,6 +22,27 @@ struct MIDIInput::Impl
   Timer inputTimer_;
   uint32_t midiPort_{0};
 
+  // for packet queue mode
+  Queue<MIDIPacket> packets_{0};
+  std::atomic<size_t> droppedPackets_{0};
+
+  // make the RtMidiIn and open the port.
+  bool open()
+  {
+    try
+    {
+      midiIn_ = std::make_unique<RtMidiIn>();
+      midiIn_->openPort(midiPort_);  // just use first port for now - TODO select ports
+    }
+    catch (RtMidiError& error)
+    {
+      error.printMessage();
+      midiIn_ = nullptr;
+      return false;
+    }
+    return true;
+  }
+
   // read any new messages from RtMidi and handle them with the handler function.
   void readNewMessages(const MIDIMessageHandler& handler)
   {
@@ -41,6 +62,20 @@ struct MIDIInput::Impl
       }
     } while (nBytes > 0);
   }
+
+  // called by RtMidi on its own thread as each message arrives.
+  static void queuePacket(double, std::vector<unsigned char>* message, void* userData)
+  {
+    auto* impl = static_cast<Impl*>(userData);
+    MIDIPacket p;
+    p.time = MIDIClock::now();
+    p.size = static_cast<uint8_t>(std::min(message->size(), p.bytes.size()));
+    std::copy(message->begin(), message->begin() + p.size, p.bytes.begin());
+    if ((p.size == 0) || (message->size() > p.bytes.size()) || !impl->packets_.push(p))
+    {
+      impl->droppedPackets_++;
+    }
+  }
 };
 
 MIDIInput::MIDIInput() : pImpl(std::make_unique<Impl>()) {}
@@ -49,49 +84,34 @@ MIDIInput::~MIDIInput() { stop(); }
 
 bool MIDIInput::start(MIDIMessageHandler handler)
 {
-  int OK{true};
-  try
-  {
-    pImpl->midiIn_ = std::make_unique<RtMidiIn>();
-  }
-  catch (RtMidiError& error)
-  {
-    error.printMessage();
-    OK = false;
-  }
-
-  if (OK)
-  {
-    try
-    {
-      pImpl->midiIn_->openPort(pImpl->midiPort_);  // just use first port for now - TODO select ports
-    }
-    catch (RtMidiError& error)
-    {
-      error.printMessage();
-      OK = false;
-    }
-  }
+  if (!pImpl->open()) return false;
 
   // Don't ignore sysex, timing, or active sensing messages.
   pImpl->midiIn_->ignoreTypes(false, false, false);
 
   // TODO this makes an OK demo but we need to do more work to get messages
-  // with accurate timestamps from MIDI to the audio thread
+  // with accurate timestamps from MIDI to the audio thread. See startPacketQueue().
   constexpr int kTimerInterval{1};
-  if (OK)
-  {
-    pImpl->inputTimer_.start([&]() { pImpl->readNewMessages(handler); },
-                            milliseconds(kTimerInterval));
-  }
-  else
-  {
-    pImpl->midiIn_ = nullptr;
-  }
+  pImpl->inputTimer_.start([this, handler]() { pImpl->readNewMessages(handler); },
+                           milliseconds(kTimerInterval));
+  return true;
+}
 
-  return OK;
+bool MIDIInput::startPacketQueue(size_t capacity)
+{
+  pImpl->packets_.resize(capacity);
+  pImpl->droppedPackets_ = 0;
+  if (!pImpl->open()) return false;
+
+  pImpl->midiIn_->ignoreTypes(true, true, true);
+  pImpl->midiIn_->setCallback(&Impl::queuePacket, pImpl.get());
+  return true;
 }
 
+size_t MIDIInput::readPackets(MIDIPacket* dest, size_t n) { return pImpl->packets_.popN(dest, n); }
+
+size_t MIDIInput::getDroppedPacketCount() const { return pImpl->droppedPackets_; }
+
 void MIDIInput::stop()
 {
   pImpl->inputTimer_.stop();
@@ -116,24 +136,36 @@ std::string MIDIInput::getPortName()
 
 // free functions
 
-int messageStatus(const MIDIMessage& m) { return (m[0] & 0x70) >> 4; }
-int messageChannel(const MIDIMessage& m) { return (m[0] & 0x0f) + 1; }
-int messageByte2(const MIDIMessage& m) { return m[1] & 0x7f; }
-int messageByte3(const MIDIMessage& m) { return m[2] & 0x7f; }
+int messageStatus(const uint8_t* m) { return (m[0] & 0x70) >> 4; }
+int messageChannel(const uint8_t* m) { return (m[0] & 0x0f) + 1; }
+int messageByte2(const uint8_t* m) { return m[1] & 0x7f; }
+int messageByte3(const uint8_t* m) { return m[2] & 0x7f; }
 float toValue(int messageData) { return messageData / 127.0f; }
-float messagePitchBendValue(const MIDIMessage& m)
+float messagePitchBendValue(const uint8_t* m)
 {
   constexpr int offset = 0x2000;
   constexpr float scale = 1.f / float(0x3FFF);
   int loByte = m[1] & 0x7f;
   int hiByte = m[2] & 0x7f;
-  int bothBytes = (hiByte << 7) & loByte;
+  int bothBytes = (hiByte << 7) | loByte;
   return float(bothBytes - offset) * scale;
 }
 
-Event MIDIMessageToEvent(const MIDIMessage& m)
+Event MIDIMessageToEvent(const MIDIMessage& m) { return MIDIBytesToEvent(m.data(), m.size()); }
+
+Event MIDIBytesToEvent(const uint8_t* bytes, size_t size)
 {
+  // missing data bytes read as 0.
+  uint8_t m[3]{0, 0, 0};
+  std::copy(bytes, bytes + std::min(size, size_t(3)), m);
+
   Event e;
+  if (!(m[0] & 0x80))
+  {
+    // not a status byte
+    return e;
+  }
+
   e.channel = messageChannel(m);
   int status = messageStatus(m);
   switch (status)
@@ -192,4 +224,24 @@ Event MIDIMessageToEvent(const MIDIMessage& m)
   }
   return e;
 }
+
+size_t MIDIPacketsToEvents(const MIDIPacket* packets, size_t n,
+                           MIDIClock::time_point bufferStartTime,
+                           const AudioContext::ProcessTime& time, int bufferSize, Event* events)
+{
+  size_t nEvents{0};
+  for (size_t i = 0; i < n; ++i)
+  {
+    const MIDIPacket& p = packets[i];
+    Event e = MIDIBytesToEvent(p.bytes.data(), p.size);
+    if (e.type == kNull) continue;
+
+    double seconds = std::chrono::duration<double>(p.time - bufferStartTime).count();
+    double offset = std::floor(seconds * time.sampleRate);
+    e.time = static_cast<int>(clamp(offset, 0., double(bufferSize - 1)));
+    events[nEvents++] = e;
+  }
+  return nEvents;
+}
+
 }  // namespace ml
@@ -4,7 +4,10 @@
 
 #pragma once
 
+#include "MLAudioContext.h"
 #include "MLEvent.h"
+#include <array>
+#include <chrono>
 #include <vector>
 #include <functional>
 
@@ -25,6 +28,16 @@ using MIDIMessage = std::vector<unsigned char>;
 
 using MIDIMessageHandler = std::function<void(const MIDIMessage&)>;
 
+using MIDIClock = std::chrono::steady_clock;
+
+// MIDIPacket: a MIDI message of up to three bytes and the time it arrived.
+struct MIDIPacket
+{
+  MIDIClock::time_point time;
+  uint8_t size{0};
+  std::array<uint8_t, 3> bytes{};
+};
+
 class MIDIInput
 {
  public:
@@ -36,6 +49,20 @@ class MIDIInput
 
   // start processing messages from the input with the given handler function.
   bool start(MIDIMessageHandler handler);
+
+  static constexpr size_t kDefaultPacketQueueSize{1024};
+
+  // start writing messages from the input into a queue of timestamped packets, to be read by
+  // one other thread, typically the audio thread, with readPackets(). Messages are stamped as
+  // they arrive from the driver, and nothing is allocated after starting. Sysex, timing and
+  // active sensing messages are ignored. Messages are dropped if the queue is full.
+  bool startPacketQueue(size_t capacity = kDefaultPacketQueueSize);
+
+  // read up to n queued packets into dest, returning the number read. Realtime safe.
+  size_t readPackets(MIDIPacket* dest, size_t n);
+
+  size_t getDroppedPacketCount() const;
+
   void stop();
 
   std::string getAPIDisplayName();
@@ -48,5 +75,17 @@ class MIDIInput
 
 // convert a MIDI message into an Event for use with EventsToSignals.
 Event MIDIMessageToEvent(const MIDIMessage& message);
+Event MIDIBytesToEvent(const uint8_t* bytes, size_t size);
+
+// convert packets to Events for one process buffer of bufferSize samples, writing them to
+// events and returning the number written. Each event's time is the sample offset of its
+// packet's time from bufferStartTime, at the sample rate of the ProcessTime, clamped to the
+// buffer. Packets that don't make Events are skipped. Packets arrive while the previous buffer
+// is processed, so to keep their spacing without jitter, pass the time at which the previous
+// buffer started: the events are then all one buffer late. The events can be given to
+// AudioContext::addInputEvents().
+size_t MIDIPacketsToEvents(const MIDIPacket* packets, size_t n,
+                           MIDIClock::time_point bufferStartTime,
+                           const AudioContext::ProcessTime& time, int bufferSize, Event* events);
 
 }  // namespace ml
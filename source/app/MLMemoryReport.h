@@ -0,0 +1,123 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// MemoryReport: the memory used by processors and containers, by Path.
+//
+// Objects that own memory report it with getMemoryBytes(). Those that allocate more than they
+// are asked for, like delay lines and DSPBuffers that round their sizes up to powers of two,
+// also have getRequestedMemoryBytes(), and the difference is reported as slack. A
+// SignalProcessor adds its objects to a report in reportMemory(), each under a Path that names
+// its place, like "voices/voice3/delay", and a ProcessorGraph adds each of its processors under
+// its own prefix. getTotal() rolls up the entries under any prefix, and getMessages() sends
+// them on, for example to an Actor.
+//
+// Making a report walks the objects and allocates, so it should be done off the audio thread
+// while the objects are not being resized.
+
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "MLMessage.h"
+#include "MLPath.h"
+#include "MLSymbol.h"
+
+namespace ml
+{
+class MemoryReport
+{
+ public:
+  struct Usage
+  {
+    size_t bytes{0};
+
+    // the bytes that were asked for. The rest of bytes is slack from rounding up.
+    size_t requestedBytes{0};
+
+    size_t getSlackBytes() const { return bytes - std::min(bytes, requestedBytes); }
+  };
+
+  // add memory at a Path. Entries with the same Path are summed.
+  void add(Path where, size_t bytes, size_t requestedBytes)
+  {
+    for (auto& e : entries_)
+    {
+      if (e.path == where)
+      {
+        e.usage.bytes += bytes;
+        e.usage.requestedBytes += requestedBytes;
+        return;
+      }
+    }
+    entries_.push_back({where, {bytes, requestedBytes}});
+  }
+
+  void add(Path where, size_t bytes) { add(where, bytes, bytes); }
+
+  // add all the entries of another report, under the prefix.
+  void add(Path prefix, const MemoryReport& r)
+  {
+    for (const auto& e : r.entries_)
+    {
+      add(Path(prefix, e.path), e.usage.bytes, e.usage.requestedBytes);
+    }
+  }
+
+  // the reserved and used memory of a SymbolTable, with its hash tables.
+  void add(Path where, SymbolTable& t)
+  {
+    const SymbolTable::MemoryStats stats = t.getMemoryStats();
+    add(where, stats.arenaBytesReserved + stats.tableBytes,
+        stats.arenaBytesUsed + stats.tableBytes);
+  }
+
+  size_t getNumEntries() const { return entries_.size(); }
+  Path getEntryPath(size_t i) const { return entries_[i].path; }
+  const Usage& getEntryUsage(size_t i) const { return entries_[i].usage; }
+
+  // the sum of the entries at or below the prefix. With no prefix, the sum of everything.
+  Usage getTotal(Path prefix = Path()) const
+  {
+    Usage total;
+    for (const auto& e : entries_)
+    {
+      if (!e.path.beginsWith(prefix)) continue;
+      total.bytes += e.usage.bytes;
+      total.requestedBytes += e.usage.requestedBytes;
+    }
+    return total;
+  }
+
+  void clear() { entries_.clear(); }
+
+  // the report as Messages: bytes and slack_bytes at prefix/<entry path>/ for each entry, and
+  // for the total at prefix/.
+  MessageList getMessages(Path prefix) const
+  {
+    MessageList messages;
+    auto addUsage = [&](Path base, const Usage& u)
+    {
+      messages.push_back(Message(Path(base, "bytes"), float(u.bytes)));
+      messages.push_back(Message(Path(base, "slack_bytes"), float(u.getSlackBytes())));
+    };
+    for (const auto& e : entries_)
+    {
+      addUsage(Path(prefix, e.path), e.usage);
+    }
+    addUsage(prefix, getTotal());
+    return messages;
+  }
+
+ private:
+  struct Entry
+  {
+    Path path;
+    Usage usage;
+  };
+
+  std::vector<Entry> entries_;
+};
+
+}  // namespace ml
@@ -6,12 +6,26 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+#include "MLPlatform.h"
+
+#if ML_MAC || ML_IOS || ML_LINUX
+#include <sys/mman.h>
+#endif
 
 namespace ml
 {
 
 // SmallStackBuffer - allocate some memory on the stack if we don't need much,
-// otherwise use the heap.
+// otherwise use the heap. Because of the heap fallback, don't use it on the audio thread: use
+// the ScratchArena of the AudioContext instead.
 
 template <class T, int MAX_STACK_ELEMS>
 class SmallStackBuffer
@@ -45,6 +59,110 @@ class SmallStackBuffer
   T localData_[MAX_STACK_ELEMS];
 };
 
+// ScratchArena: temporary memory for the audio thread. The memory is allocated once at setup,
+// then allocate() hands out aligned pieces of it by bumping a pointer, and reset() frees all of
+// them at once. The AudioContext has an arena that is reset at the start of every vector, so
+// processors can use it for temporary DSPVectorArrays and buffers:
+//
+//   auto* pTemp = context->scratch.allocate<DSPVectorArray<4>>();
+//   if (!pTemp) return;  // out of scratch: the arena needs a bigger capacity.
+//
+// An arena never falls back to the heap. When an allocation doesn't fit, allocate() returns
+// nullptr and the overflow count is incremented, so that other threads can see that the
+// capacity set at setup is too small.
+
+class ScratchArena
+{
+ public:
+  static constexpr size_t kAlignment{64};
+
+  ScratchArena() = default;
+  explicit ScratchArena(size_t capacityInBytes) { setCapacity(capacityInBytes); }
+  ScratchArena(const ScratchArena&) = delete;
+  ScratchArena& operator=(const ScratchArena&) = delete;
+
+  // allocate the memory and free any previous allocations. Not for the audio thread.
+  void setCapacity(size_t capacityInBytes)
+  {
+    capacity_ = (capacityInBytes + kAlignment - 1) & ~(kAlignment - 1);
+    storage_.reset(capacity_ ? new unsigned char[capacity_ + kAlignment] : nullptr);
+    auto p = reinterpret_cast<uintptr_t>(storage_.get());
+    base_ = reinterpret_cast<unsigned char*>((p + kAlignment - 1) & ~uintptr_t(kAlignment - 1));
+    used_ = 0;
+    highWater_.store(0, std::memory_order_relaxed);
+  }
+  size_t getCapacity() const { return capacity_; }
+
+  // the base of the memory, to lock it with lockAndPrefault().
+  void* getData() { return base_; }
+
+  // free everything allocated since the last reset.
+  void reset() { used_ = 0; }
+
+  // allocate bytes of memory with the given alignment, which must be a power of two no larger
+  // than kAlignment. The contents are not initialized. Returns nullptr if there is no room.
+  void* allocateBytes(size_t bytes, size_t alignment = kAlignment)
+  {
+    assert(alignment && alignment <= kAlignment && !(alignment & (alignment - 1)));
+    const size_t start = (used_ + alignment - 1) & ~(alignment - 1);
+    if (!base_ || (bytes > capacity_ - std::min(start, capacity_)))
+    {
+      overflows_.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    used_ = start + bytes;
+    if (used_ > highWater_.load(std::memory_order_relaxed))
+    {
+      highWater_.store(used_, std::memory_order_relaxed);
+    }
+    return base_ + start;
+  }
+
+  // allocate n objects of type T, value-initialized. T must be trivially destructible because
+  // reset() doesn't run destructors. Returns nullptr if there is no room.
+  template <class T>
+  T* allocate(size_t n = 1)
+  {
+    static_assert(std::is_trivially_destructible<T>::value,
+                  "ScratchArena: objects must be trivially destructible");
+    static_assert(alignof(T) <= kAlignment, "ScratchArena: alignment too large");
+    if (n > std::numeric_limits<size_t>::max() / sizeof(T))
+    {
+      overflows_.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    void* p = allocateBytes(sizeof(T) * n, alignof(T));
+    if (!p) return nullptr;
+    T* pT = static_cast<T*>(p);
+    for (size_t i = 0; i < n; ++i)
+    {
+      new (pT + i) T();
+    }
+    return pT;
+  }
+
+  // the bytes allocated since the last reset.
+  size_t getBytesUsed() const { return used_; }
+
+  // these can be read from any thread: the most bytes ever in use at once, and the number of
+  // allocations that didn't fit.
+  size_t getHighWaterMark() const { return highWater_.load(std::memory_order_relaxed); }
+  uint64_t getOverflowCount() const { return overflows_.load(std::memory_order_relaxed); }
+  void clearStats()
+  {
+    highWater_.store(used_, std::memory_order_relaxed);
+    overflows_.store(0, std::memory_order_relaxed);
+  }
+
+ private:
+  std::unique_ptr<unsigned char[]> storage_;
+  unsigned char* base_{nullptr};
+  size_t capacity_{0};
+  size_t used_{0};
+  std::atomic<size_t> highWater_{0};
+  std::atomic<uint64_t> overflows_{0};
+};
+
 inline int sizeToInt(size_t size)
 {
   assert(size <= static_cast<size_t>(std::numeric_limits<int>::max()) &&
@@ -52,4 +170,34 @@ inline int sizeToInt(size_t size)
   return static_cast<int>(size);
 }
 
+// touch each page of a range of memory so that it is mapped before it is first used. Reading
+// and writing back touches each page without changing it.
+inline void prefault(void* p, size_t bytes)
+{
+  if (!p || !bytes) return;
+  constexpr size_t kMinPageSize{4096};
+  volatile char* c = static_cast<volatile char*>(p);
+  for (size_t i = 0; i < bytes; i += kMinPageSize)
+  {
+    c[i] = c[i];
+  }
+  c[bytes - 1] = c[bytes - 1];
+}
+
+// lock a range of memory into RAM so that it can't be paged out, then prefault it. Returns true
+// if the range was locked. The range is touched in any case.
+inline bool lockAndPrefault(void* p, size_t bytes)
+{
+  if (!p || !bytes) return false;
+#if ML_WINDOWS
+  bool locked = VirtualLock(p, bytes);
+#elif ML_MAC || ML_IOS || ML_LINUX
+  bool locked = (mlock(p, bytes) == 0);
+#else
+  bool locked = false;
+#endif
+  prefault(p, bytes);
+  return locked;
+}
+
 }  // namespace ml
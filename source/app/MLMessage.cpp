@@ -0,0 +1,134 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLMessage.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#include "MLHash.h"
+
+namespace ml
+{
+
+// ----------------------------------------------------------------
+// MessagePathTable
+
+// combine the Symbol hashes with FNV-1a. 0 is reserved for empty entries.
+uint64_t MessagePathTable::hashPath(const Path& p)
+{
+  uint64_t h = fnvConsts::k1;
+  for (Symbol s : p)
+  {
+    h = (h ^ s.getHash()) * fnvConsts::k2;
+  }
+  return h ? h : 1;
+}
+
+// probe for hash without locking. returns nullptr if not found.
+const Path* MessagePathTable::find(const Table* t, uint64_t hash)
+{
+  if (!t) return nullptr;
+  for (size_t i = hash & t->mask;; i = (i + 1) & t->mask)
+  {
+    uint64_t h = t->entries[i].hash.load(std::memory_order_acquire);
+    if (h == hash) return t->entries[i].path.load(std::memory_order_acquire);
+    if (h == 0) return nullptr;
+  }
+}
+
+// add an entry. Called with the mutex locked.
+void MessagePathTable::insert(Table* t, uint64_t hash, const Path* p)
+{
+  size_t i = hash & t->mask;
+  while (t->entries[i].hash.load(std::memory_order_relaxed) != 0)
+  {
+    i = (i + 1) & t->mask;
+  }
+  t->entries[i].path.store(p, std::memory_order_release);
+  t->entries[i].hash.store(hash, std::memory_order_release);
+}
+
+const Path* MessagePathTable::intern(const Path& p)
+{
+  if (!p) return nullptr;
+  uint64_t hash = hashPath(p);
+  auto checkCollision = [&](const Path* existing) {
+    if (*existing != p) throw std::runtime_error("Path hash collision detected!");
+    return existing;
+  };
+
+  // fast path: the Path exists.
+  if (const Path* existing = find(table_.load(std::memory_order_acquire), hash))
+  {
+    return checkCollision(existing);
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  // another thread may have added it since we looked.
+  Table* t = table_.load(std::memory_order_relaxed);
+  if (const Path* existing = find(t, hash))
+  {
+    return checkCollision(existing);
+  }
+
+  // when the table would be more than half full, grow it. The old table stays valid for readers.
+  size_t count = paths_.size();
+  size_t capacity = t ? t->mask + 1 : 0;
+  if ((count + 1) * 2 > capacity)
+  {
+    auto newTable = std::make_unique<Table>(capacity ? capacity * 2 : kInitialCapacity);
+    if (t)
+    {
+      for (size_t i = 0; i <= t->mask; ++i)
+      {
+        uint64_t h = t->entries[i].hash.load(std::memory_order_relaxed);
+        if (h) insert(newTable.get(), h, t->entries[i].path.load(std::memory_order_relaxed));
+      }
+    }
+    t = newTable.get();
+    table_.store(t, std::memory_order_release);
+    tables_.push_back(std::move(newTable));
+  }
+
+  // a deque never moves its elements, so the pointer stays valid.
+  paths_.push_back(p);
+  const Path* interned = &paths_.back();
+  insert(t, hash, interned);
+  size_.fetch_add(1, std::memory_order_relaxed);
+  return interned;
+}
+
+// ----------------------------------------------------------------
+// CompactMessage
+
+CompactMessage::CompactMessage(Message&& m)
+    : address_(theMessagePathTable().intern(m.address)), flags_(m.flags)
+{
+  if (m.value.size() <= kInlineValueBytes)
+  {
+    valueType_ = static_cast<uint8_t>(m.value.getType());
+    valueBytes_ = static_cast<uint8_t>(m.value.size());
+    std::memcpy(inlineValue_, m.value.data(), valueBytes_);
+  }
+  else
+  {
+    bigValue_ = std::make_unique<Value>(std::move(m.value));
+  }
+}
+
+Message CompactMessage::takeMessage()
+{
+  Path address = address_ ? *address_ : Path();
+  if (bigValue_)
+  {
+    Message m(std::move(address), std::move(*bigValue_), flags_);
+    bigValue_.reset();
+    return m;
+  }
+  return Message(std::move(address), Value(valueType_, valueBytes_, inlineValue_), flags_);
+}
+
+}  // namespace ml
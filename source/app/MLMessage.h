@@ -4,6 +4,9 @@
 
 #pragma once
 
+#include <deque>
+#include <mutex>
+
 #include "MLCollection.h"
 #include "MLPath.h"
 #include "MLValue.h"
@@ -18,11 +21,102 @@ struct Message final
   Value value{};
   uint32_t flags{0};
 
-  Message(Path h = Path(), Value v = Value(), uint32_t f = 0) : address(h), value(v), flags(f) {}
+  Message(Path h = Path(), Value v = Value(), uint32_t f = 0)
+      : address(std::move(h)), value(std::move(v)), flags(f)
+  {
+  }
 
   explicit operator bool() const { return (address != Path()); }
 };
 
+// MessagePathTable: interns the addresses of queued messages.
+//
+// Each distinct Path gets one copy in the table, which stays valid for the life of the table, so
+// a pointer to it can stand in for the Path. Looking up a Path that is already in the table does
+// not lock. Only adding a new Path takes the mutex. Like the SymbolTable, the table only grows:
+// it is meant for the fixed set of addresses that an application sends messages to.
+
+class MessagePathTable
+{
+ public:
+  MessagePathTable() = default;
+  MessagePathTable(const MessagePathTable&) = delete;
+  MessagePathTable& operator=(const MessagePathTable&) = delete;
+
+  // return the interned copy of p, adding it if needed, or nullptr for the empty Path.
+  const Path* intern(const Path& p);
+
+  size_t getSize() const { return size_.load(std::memory_order_relaxed); }
+
+ private:
+  static constexpr size_t kInitialCapacity{256};
+
+  // a hash of 0 marks an empty entry. path is written before hash.
+  struct Entry
+  {
+    std::atomic<uint64_t> hash{0};
+    std::atomic<const Path*> path{nullptr};
+  };
+
+  struct Table
+  {
+    explicit Table(size_t capacity) : mask(capacity - 1), entries(new Entry[capacity]) {}
+    size_t mask;
+    std::unique_ptr<Entry[]> entries;
+  };
+
+  static uint64_t hashPath(const Path& p);
+  static const Path* find(const Table* t, uint64_t hash);
+  static void insert(Table* t, uint64_t hash, const Path* p);
+
+  // old tables are kept so that readers still probing them remain safe.
+  std::atomic<Table*> table_{nullptr};
+  std::vector<std::unique_ptr<Table> > tables_;
+  std::deque<Path> paths_;
+  std::atomic<size_t> size_{0};
+  std::mutex mutex_;
+};
+
+inline MessagePathTable& theMessagePathTable()
+{
+  static MessagePathTable t;
+  return t;
+}
+
+// CompactMessage: the form in which Actor queues store Messages.
+//
+// A Message is well over 100 bytes, most of it Path and Value storage that typical messages
+// don't use. A CompactMessage stores the address as a pointer into the MessagePathTable and
+// keeps values of up to kInlineValueBytes inline. Bigger values are moved to the heap behind a
+// pointer. CompactMessages can be moved but not copied, so queues of them move their elements.
+
+struct CompactMessage final
+{
+  static constexpr size_t kInlineValueBytes{16};
+
+  CompactMessage() = default;
+  explicit CompactMessage(Message&& m);
+  explicit CompactMessage(const Message& m) : CompactMessage(Message(m)) {}
+
+  CompactMessage(CompactMessage&&) noexcept = default;
+  CompactMessage& operator=(CompactMessage&&) noexcept = default;
+  CompactMessage(const CompactMessage&) = delete;
+  CompactMessage& operator=(const CompactMessage&) = delete;
+
+  // make the Message again, moving out any big value.
+  Message takeMessage();
+
+  explicit operator bool() const { return address_ != nullptr; }
+
+ private:
+  const Path* address_{nullptr};
+  std::unique_ptr<Value> bigValue_;
+  uint32_t flags_{0};
+  uint8_t valueType_{Value::kUndefined};
+  uint8_t valueBytes_{0};
+  alignas(sizeof(float)) uint8_t inlineValue_[kInlineValueBytes]{};
+};
+
 enum flags
 {
   kMsgSequenceStart = 1 << 0,
@@ -0,0 +1,250 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLMetrics.h"
+
+#include <algorithm>
+
+namespace ml
+{
+// ----------------------------------------------------------------
+// MetricHistogram
+
+MetricHistogram::MetricHistogram(float minValue, float maxValue, size_t bins)
+    : minValue_(minValue), bins_(std::max(bins, size_t(1)))
+{
+  float range = maxValue - minValue;
+  binsPerUnit_ = (range > 0.f) ? bins_.size() / range : 0.f;
+  for (auto& b : bins_) b.store(0, std::memory_order_relaxed);
+}
+
+void MetricHistogram::record(float x)
+{
+  float binFloat = (x - minValue_) * binsPerUnit_;
+  size_t bin{0};
+  if (binFloat >= bins_.size())
+  {
+    bin = bins_.size() - 1;
+  }
+  else if (binFloat > 0.f)
+  {
+    bin = size_t(binFloat);
+  }
+  bins_[bin].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+
+  // there is no fetch_add for atomic<double> before C++20.
+  double sum = sum_.load(std::memory_order_relaxed);
+  while (!sum_.compare_exchange_weak(sum, sum + x, std::memory_order_relaxed))
+  {
+  }
+}
+
+double MetricHistogram::getMean() const
+{
+  uint64_t n = getCount();
+  return n ? sum_.load(std::memory_order_relaxed) / n : 0.;
+}
+
+void MetricHistogram::reset()
+{
+  for (auto& b : bins_) b.store(0, std::memory_order_relaxed);
+  count_.store(0, std::memory_order_relaxed);
+  sum_.store(0., std::memory_order_relaxed);
+}
+
+// ----------------------------------------------------------------
+// Metrics
+
+Metrics::Entry* Metrics::find(Path p)
+{
+  for (auto& e : entries_)
+  {
+    if (e.path == p) return &e;
+  }
+  return nullptr;
+}
+
+MetricCounter* Metrics::getCounter(Path p)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (Entry* e = find(p))
+  {
+    return (e->kind == Kind::kCounter) ? &counters_[e->index] : nullptr;
+  }
+  entries_.push_back({p, Kind::kCounter, counters_.size()});
+  counters_.emplace_back();
+  return &counters_.back();
+}
+
+MetricGauge* Metrics::getGauge(Path p)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (Entry* e = find(p))
+  {
+    return (e->kind == Kind::kGauge) ? &gauges_[e->index] : nullptr;
+  }
+  entries_.push_back({p, Kind::kGauge, gauges_.size()});
+  gauges_.emplace_back();
+  return &gauges_.back();
+}
+
+MetricHistogram* Metrics::getHistogram(Path p, float minValue, float maxValue, size_t bins)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (Entry* e = find(p))
+  {
+    return (e->kind == Kind::kHistogram) ? histograms_[e->index].get() : nullptr;
+  }
+  entries_.push_back({p, Kind::kHistogram, histograms_.size()});
+  histograms_.push_back(std::make_unique<MetricHistogram>(minValue, maxValue, bins));
+  return histograms_.back().get();
+}
+
+void Metrics::addSource(Path prefix, SourceFn fn)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  sources_.push_back({prefix, std::move(fn)});
+}
+
+void Metrics::addGauge(Path p, std::function<float()> fn)
+{
+  addSource(p, [fn](Path prefix, MessageList& messages)
+            { messages.push_back(Message(prefix, fn())); });
+}
+
+void Metrics::addSymbolTable(Path p, const SymbolTable& t)
+{
+  addGauge(p, [&t]() { return float(t.getSize()); });
+}
+
+void Metrics::addCallbackStats(Path prefix, const AudioCallbackStats& stats)
+{
+  addSource(prefix,
+            [&stats](Path prefix, MessageList& messages)
+            {
+              const AudioCallbackStats::Snapshot s = stats.getSnapshot();
+              messages.push_back(Message(Path(prefix, "callbacks"), float(s.callbacks)));
+              messages.push_back(Message(Path(prefix, "xruns"), float(s.xruns)));
+              messages.push_back(
+                  Message(Path(prefix, "deadline_misses"), float(s.deadlineMisses)));
+              messages.push_back(Message(Path(prefix, "mean_load"), s.meanLoad));
+              messages.push_back(Message(Path(prefix, "max_load"), s.maxLoad));
+            });
+}
+
+void Metrics::removeSources(Path prefix)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  sources_.erase(std::remove_if(sources_.begin(), sources_.end(),
+                                [&](const Source& s) { return s.prefix.beginsWith(prefix); }),
+                 sources_.end());
+}
+
+size_t Metrics::getNumMetrics()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_.size();
+}
+
+MessageList Metrics::getMessages(Path prefix)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  MessageList messages;
+  for (const auto& e : entries_)
+  {
+    const Path p(prefix, e.path);
+    switch (e.kind)
+    {
+      case Kind::kCounter:
+        messages.push_back(Message(p, float(counters_[e.index].get())));
+        break;
+      case Kind::kGauge:
+        messages.push_back(Message(p, gauges_[e.index].get()));
+        break;
+      case Kind::kHistogram:
+      {
+        const MetricHistogram& h = *histograms_[e.index];
+        std::vector<float> bins(h.getNumBins());
+        for (size_t i = 0; i < bins.size(); ++i)
+        {
+          bins[i] = float(h.getBinCount(i));
+        }
+        messages.push_back(Message(Path(p, "count"), float(h.getCount())));
+        messages.push_back(Message(Path(p, "mean"), float(h.getMean())));
+        messages.push_back(Message(Path(p, "bins"), bins));
+        break;
+      }
+    }
+  }
+  for (const auto& s : sources_)
+  {
+    s.fn(Path(prefix, s.prefix), messages);
+  }
+  return messages;
+}
+
+void Metrics::reset()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& c : counters_) c.reset();
+  for (auto& h : histograms_) h->reset();
+}
+
+// ----------------------------------------------------------------
+// MetricsReporter
+
+MetricsReporter::MetricsReporter(Metrics& m)
+    : Actor(ActorQueueType::kMultipleProducers), metrics_(m)
+{
+}
+
+MetricsReporter::~MetricsReporter() { stopReporting(); }
+
+void MetricsReporter::startReporting(milliseconds interval)
+{
+  if (destination_ != Path())
+  {
+    destinationRef_ = getActorRef(destination_);
+  }
+  startMessageDriven();
+  reportTimer_.start([this]() { enqueueMessage(Message("report")); }, interval);
+}
+
+void MetricsReporter::stopReporting()
+{
+  reportTimer_.stop();
+  stop();
+}
+
+void MetricsReporter::report()
+{
+  MessageList messages = metrics_.getMessages(prefix_);
+  if (destinationRef_)
+  {
+    for (const auto& m : messages)
+    {
+      destinationRef_.send(m);
+    }
+  }
+  if (publishFn_)
+  {
+    publishFn_(messages);
+  }
+  reports_++;
+}
+
+void MetricsReporter::onMessage(Message m)
+{
+  if (m.address == Path("report"))
+  {
+    report();
+  }
+  else if (m.address == Path("reset"))
+  {
+    metrics_.reset();
+  }
+}
+
+}  // namespace ml
@@ -0,0 +1,205 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// Metrics: one registry, by Path, for the numbers that show how a running application is doing.
+//
+// A MetricCounter counts events, a MetricGauge holds the latest value of something and a
+// MetricHistogram counts values in bins. They are made and looked up by Path in a Metrics
+// registry, which allocates, so this should be done at setup. The returned pointers stay valid
+// for the life of the registry, and any thread, including the audio thread, can write to them
+// without locking or allocating.
+//
+// Values that already live somewhere else, like the depth of a Queue, the size of the
+// SymbolTable or the statistics of an audio callback, are added as sources instead. They are
+// read only when a snapshot is made. getMessages() makes a snapshot of everything as Messages,
+// each with the metric's Path under a prefix.
+//
+// A MetricsReporter is an Actor that makes a snapshot periodically and sends it to another
+// Actor or to a function, such as one that adds the Messages to an OSCBundleSender and flushes
+// it. For one registry per process, use a SharedResourcePointer<Metrics>.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "MLActor.h"
+#include "MLAudioCallbackStats.h"
+#include "MLMessage.h"
+#include "MLPath.h"
+#include "MLSymbol.h"
+#include "MLTimer.h"
+
+namespace ml
+{
+class MetricCounter
+{
+ public:
+  void add(uint64_t n = 1) { count_.fetch_add(n, std::memory_order_relaxed); }
+  uint64_t get() const { return count_.load(std::memory_order_relaxed); }
+  void reset() { count_.store(0, std::memory_order_relaxed); }
+
+ private:
+  std::atomic<uint64_t> count_{0};
+};
+
+class MetricGauge
+{
+ public:
+  void set(float x) { value_.store(x, std::memory_order_relaxed); }
+  float get() const { return value_.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<float> value_{0.f};
+};
+
+class MetricHistogram
+{
+ public:
+  // bins of equal width over [minValue, maxValue). Values outside are counted in the end bins.
+  MetricHistogram(float minValue, float maxValue, size_t bins);
+
+  void record(float x);
+
+  size_t getNumBins() const { return bins_.size(); }
+  uint64_t getBinCount(size_t i) const { return bins_[i].load(std::memory_order_relaxed); }
+  uint64_t getCount() const { return count_.load(std::memory_order_relaxed); }
+  double getMean() const;
+  void reset();
+
+ private:
+  float minValue_;
+  float binsPerUnit_;
+  std::vector<std::atomic<uint64_t> > bins_;
+  std::atomic<uint64_t> count_{0};
+  std::atomic<double> sum_{0.};
+};
+
+class Metrics
+{
+ public:
+  // a function that adds Messages for some values under the prefix to the list.
+  using SourceFn = std::function<void(Path prefix, MessageList& messages)>;
+
+  Metrics() = default;
+  ~Metrics() = default;
+
+  Metrics(Metrics const&) = delete;
+  Metrics& operator=(Metrics const&) = delete;
+
+  // get the metric at a Path, making it if needed. Returns nullptr if the Path is in use by
+  // a metric of another kind. Not real-time safe.
+  MetricCounter* getCounter(Path p);
+  MetricGauge* getGauge(Path p);
+  MetricHistogram* getHistogram(Path p, float minValue, float maxValue, size_t bins);
+
+  // add a source, called on the snapshot thread each time a snapshot is made.
+  void addSource(Path prefix, SourceFn fn);
+
+  // add a gauge whose value is read by a function when a snapshot is made.
+  void addGauge(Path p, std::function<float()> fn);
+
+  // add the elementsAvailable() of a Queue or MPMCQueue as a gauge.
+  template <class Q>
+  void addQueueDepth(Path p, const Q& q)
+  {
+    addGauge(p, [&q]() { return float(q.elementsAvailable()); });
+  }
+
+  // add the number of symbols in a SymbolTable as a gauge.
+  void addSymbolTable(Path p, const SymbolTable& t);
+
+  // add callbacks, xruns, deadline_misses, mean_load and max_load from the stats.
+  void addCallbackStats(Path prefix, const AudioCallbackStats& stats);
+
+  // remove the sources at or below the prefix. Metrics themselves are never removed, so that
+  // pointers to them stay valid.
+  void removeSources(Path prefix);
+
+  size_t getNumMetrics();
+
+  // a snapshot of all the metrics and sources, each at prefix/<its Path>. A histogram sends
+  // its count, mean and a float array of its bins, at count, mean and bins below its Path.
+  MessageList getMessages(Path prefix = Path());
+
+  // reset all the counters and histograms.
+  void reset();
+
+ private:
+  enum class Kind
+  {
+    kCounter,
+    kGauge,
+    kHistogram
+  };
+
+  struct Entry
+  {
+    Path path;
+    Kind kind;
+    size_t index;
+  };
+
+  struct Source
+  {
+    Path prefix;
+    SourceFn fn;
+  };
+
+  Entry* find(Path p);
+
+  std::mutex mutex_;
+  std::vector<Entry> entries_;
+  std::vector<Source> sources_;
+  std::deque<MetricCounter> counters_;
+  std::deque<MetricGauge> gauges_;
+  std::deque<std::unique_ptr<MetricHistogram> > histograms_;
+};
+
+// MetricsReporter: an Actor that sends snapshots of a Metrics registry at a fixed interval.
+// Sending it "report" makes a snapshot at once, and "reset" resets the metrics. Its Timer, like
+// any other, needs the application's Timers to be started.
+class MetricsReporter final : public Actor
+{
+ public:
+  using PublishFn = std::function<void(const MessageList&)>;
+
+  static constexpr milliseconds kDefaultInterval{1000};
+
+  explicit MetricsReporter(Metrics& m);
+  ~MetricsReporter();
+
+  // settings, to be made before startReporting(). Each snapshot is sent to the named Actor one
+  // Message at a time, so its queue should be big enough for all the metrics, and to the
+  // publish function as one MessageList.
+  void setAddressPrefix(Path p) { prefix_ = p; }
+  void setDestination(Path actorName) { destination_ = actorName; }
+  void setPublishFn(PublishFn fn) { publishFn_ = std::move(fn); }
+
+  void startReporting(milliseconds interval = kDefaultInterval);
+  void stopReporting();
+
+  // make a snapshot and send it now.
+  void report();
+
+  size_t getReportCount() const { return reports_; }
+
+  void onMessage(Message m) override;
+
+ private:
+  Metrics& metrics_;
+  Path prefix_{};
+  Path destination_{};
+  ActorRef destinationRef_{};
+  PublishFn publishFn_;
+  Timer reportTimer_;
+  std::atomic<size_t> reports_{0};
+};
+
+}  // namespace ml
@@ -0,0 +1,304 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLOfflineAudioTask.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "MLDSPDenormals.h"
+#include "MLWavFile.h"
+
+namespace ml
+{
+namespace
+{
+void putLE(std::vector<uint8_t>& v, uint32_t x, int bytes)
+{
+  for (int i = 0; i < bytes; ++i)
+  {
+    v.push_back(uint8_t(x >> (i * 8)));
+  }
+}
+
+void putTag(std::vector<uint8_t>& v, const char* tag) { v.insert(v.end(), tag, tag + 4); }
+
+int bytesPerSample(OfflineAudioTask::FileFormat format)
+{
+  switch (format)
+  {
+    case OfflineAudioTask::FileFormat::kInt16:
+      return 2;
+    case OfflineAudioTask::FileFormat::kInt24:
+      return 3;
+    case OfflineAudioTask::FileFormat::kFloat32:
+    default:
+      return 4;
+  }
+}
+
+// append one sample in the given format.
+void putSample(std::vector<uint8_t>& v, float f, OfflineAudioTask::FileFormat format)
+{
+  switch (format)
+  {
+    case OfflineAudioTask::FileFormat::kInt16:
+      putLE(v, uint32_t(int32_t(std::lround(clamp(f, -1.f, 1.f) * 32767.f))), 2);
+      break;
+    case OfflineAudioTask::FileFormat::kInt24:
+      putLE(v, uint32_t(int32_t(std::lround(clamp(f, -1.f, 1.f) * 8388607.f))), 3);
+      break;
+    case OfflineAudioTask::FileFormat::kFloat32:
+    default:
+    {
+      uint32_t x;
+      memcpy(&x, &f, 4);
+      putLE(v, x, 4);
+      break;
+    }
+  }
+}
+
+// add the bytes of frames of planar output to an FNV-1a hash, one frame at a time.
+void hashFrames(uint64_t& hash, const std::vector<float*>& channels, size_t start, size_t frames)
+{
+  for (size_t i = start; i < start + frames; ++i)
+  {
+    for (const float* pChannel : channels)
+    {
+      uint32_t x;
+      memcpy(&x, pChannel + i, 4);
+      for (int b = 0; b < 4; ++b)
+      {
+        hash = (hash ^ ((x >> (b * 8)) & 0xFF)) * fnvConsts::k2;
+      }
+    }
+  }
+}
+
+}  // namespace
+
+OfflineAudioTask::OfflineAudioTask(AudioContext* ctx, SignalProcessFn procFn, void* procState,
+                                   int blockSize)
+    : context_(ctx),
+      processFn_(procFn),
+      processState_(procState),
+      blockSize_((std::max(blockSize, 1) + kFloatsPerDSPVector - 1) / kFloatsPerDSPVector *
+                 kFloatsPerDSPVector),
+      buffer_(ctx->inputs.size(), ctx->outputs.size(), blockSize_)
+{
+  const size_t nInputs = ctx->inputs.size();
+  const size_t nOutputs = ctx->outputs.size();
+
+  inputBlock_.resize(nInputs * blockSize_);
+  outputBlock_.resize(nOutputs * blockSize_);
+  for (size_t c = 0; c < nInputs; ++c)
+  {
+    inputPtrs_.push_back(inputBlock_.data() + c * blockSize_);
+  }
+  for (size_t c = 0; c < nOutputs; ++c)
+  {
+    outputPtrs_.push_back(outputBlock_.data() + c * blockSize_);
+  }
+}
+
+void OfflineAudioTask::setInput(const float* const* channels, size_t nChannels, size_t frames)
+{
+  input_.assign(channels, channels + nChannels);
+  inputFrames_ = frames;
+}
+
+bool OfflineAudioTask::setInputFromWavFile(const char* path)
+{
+  std::ifstream file(path, std::ios::binary);
+  if (!file) return false;
+  std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)),
+                             std::istreambuf_iterator<char>());
+
+  WavFileInfo info;
+  if (!parseWavFile(bytes.data(), bytes.size(), info)) return false;
+
+  const size_t frames = info.frames;
+  const int channels = info.channels;
+  std::vector<float> interleaved(frames * channels);
+  readWavFrames(info, 0, frames, interleaved.data());
+  inputFileData_.resize(frames * channels);
+  for (size_t i = 0; i < frames; ++i)
+  {
+    for (int c = 0; c < channels; ++c)
+    {
+      inputFileData_[c * frames + i] = interleaved[i * channels + c];
+    }
+  }
+
+  std::vector<const float*> ptrs;
+  for (int c = 0; c < channels; ++c)
+  {
+    ptrs.push_back(inputFileData_.data() + c * frames);
+  }
+  setInput(ptrs.data(), ptrs.size(), frames);
+  inputFileSampleRate_ = info.sampleRate;
+  return true;
+}
+
+void OfflineAudioTask::addEvent(const Event& e, uint64_t frame)
+{
+  // keep the queue sorted by frame, with events at the same frame in the order added.
+  frame = std::max(frame, framesProcessed_);
+  auto it = std::upper_bound(events_.begin() + nextEvent_, events_.end(), frame,
+                             [](uint64_t f, const TimedEvent& te) { return f < te.frame; });
+  events_.insert(it, TimedEvent{frame, e});
+}
+
+void OfflineAudioTask::clearEvents()
+{
+  events_.clear();
+  nextEvent_ = 0;
+}
+
+void OfflineAudioTask::rewind()
+{
+  nextEvent_ = 0;
+  framesProcessed_ = 0;
+  framesRendered_ = 0;
+  outputBlockStart_ = outputBlockFrames_ = 0;
+  outputHash_ = fnvConsts::k1;
+}
+
+void OfflineAudioTask::processBlock()
+{
+  // copy the input for this block, padding with silence.
+  for (size_t c = 0; c < inputPtrs_.size(); ++c)
+  {
+    float* pDest = inputBlock_.data() + c * blockSize_;
+    size_t n{0};
+    if ((c < input_.size()) && input_[c] && (framesProcessed_ < inputFrames_))
+    {
+      n = std::min(blockSize_, size_t(inputFrames_ - framesProcessed_));
+      std::copy(input_[c] + framesProcessed_, input_[c] + framesProcessed_ + n, pDest);
+    }
+    std::fill(pDest + n, pDest + blockSize_, 0.f);
+  }
+
+  // send the events in this block, timed from its start.
+  const uint64_t blockEnd = framesProcessed_ + blockSize_;
+  for (; (nextEvent_ < events_.size()) && (events_[nextEvent_].frame < blockEnd); ++nextEvent_)
+  {
+    Event e = events_[nextEvent_].event;
+    e.time = int(events_[nextEvent_].frame - framesProcessed_);
+    context_->addInputEvent(e);
+  }
+
+  // whole blocks of DSPVectors always take the direct path through the buffer.
+  buffer_.process(inputPtrs_.data(), outputPtrs_.data(), int(blockSize_), context_, processFn_,
+                  processState_);
+
+  framesProcessed_ = blockEnd;
+  outputBlockStart_ = 0;
+  outputBlockFrames_ = blockSize_;
+}
+
+void OfflineAudioTask::render(float** outputs, size_t frames)
+{
+  UsingFlushDenormalsToZero flushDenormals(kFlushDenormalsAutomatically);
+  for (size_t done = 0; done < frames;)
+  {
+    if (outputBlockFrames_ == 0)
+    {
+      processBlock();
+    }
+
+    size_t n = std::min(outputBlockFrames_, frames - done);
+    for (size_t c = 0; c < outputPtrs_.size(); ++c)
+    {
+      if (outputs[c])
+      {
+        const float* pSrc = outputPtrs_[c] + outputBlockStart_;
+        std::copy(pSrc, pSrc + n, outputs[c] + done);
+      }
+    }
+    if (hashOutput_)
+    {
+      hashFrames(outputHash_, outputPtrs_, outputBlockStart_, n);
+    }
+    outputBlockStart_ += n;
+    outputBlockFrames_ -= n;
+    framesRendered_ += n;
+    done += n;
+  }
+}
+
+bool OfflineAudioTask::renderToWavFile(const char* path, size_t frames, FileFormat format)
+{
+  return renderToFile(path, frames, true, format);
+}
+
+bool OfflineAudioTask::renderToRawFile(const char* path, size_t frames)
+{
+  return renderToFile(path, frames, false, FileFormat::kFloat32);
+}
+
+bool OfflineAudioTask::renderToFile(const char* path, size_t frames, bool wav, FileFormat format)
+{
+  const size_t channels = outputPtrs_.size();
+  if (!channels) return false;
+
+  FILE* file = fopen(path, "wb");
+  if (!file) return false;
+
+  const uint32_t sampleBytes = bytesPerSample(format);
+  const uint32_t frameBytes = sampleBytes * uint32_t(channels);
+  std::vector<uint8_t> bytes;
+  if (wav)
+  {
+    const uint32_t dataBytes = uint32_t(frames * frameBytes);
+    const uint32_t sampleRate = uint32_t(context_->getSampleRate());
+    putTag(bytes, "RIFF");
+    putLE(bytes, 36 + dataBytes, 4);
+    putTag(bytes, "WAVE");
+    putTag(bytes, "fmt ");
+    putLE(bytes, 16, 4);
+    uint16_t formatCode =
+        (format == FileFormat::kFloat32) ? WavFileInfo::kFormatFloat : WavFileInfo::kFormatPCM;
+    putLE(bytes, formatCode, 2);
+    putLE(bytes, uint32_t(channels), 2);
+    putLE(bytes, sampleRate, 4);
+    putLE(bytes, sampleRate * frameBytes, 4);
+    putLE(bytes, frameBytes, 2);
+    putLE(bytes, sampleBytes * 8, 2);
+    putTag(bytes, "data");
+    putLE(bytes, dataBytes, 4);
+  }
+
+  // render one block at a time, then interleave and convert it.
+  std::vector<float> planar(channels * blockSize_);
+  std::vector<float*> planarPtrs(channels);
+  std::vector<float> interleaved(channels * blockSize_);
+  for (size_t c = 0; c < channels; ++c)
+  {
+    planarPtrs[c] = planar.data() + c * blockSize_;
+  }
+
+  bool ok{true};
+  for (size_t done = 0; ok && (done < frames);)
+  {
+    size_t n = std::min(blockSize_, frames - done);
+    render(planarPtrs.data(), n);
+    interleave(planarPtrs.data(), interleaved.data(), channels, n);
+    for (size_t i = 0; i < n * channels; ++i)
+    {
+      putSample(bytes, interleaved[i], format);
+    }
+    ok = (fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size());
+    bytes.clear();
+    done += n;
+  }
+
+  ok &= (fclose(file) == 0);
+  return ok;
+}
+
+}  // namespace ml
@@ -0,0 +1,122 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// OfflineAudioTask: run an audio processing function in a context as fast as the CPU allows,
+// without an audio device. This is the offline counterpart of AudioTask, for rendering
+// previews and test fixtures.
+//
+// Input comes from planar buffers in memory or from a WAV file, and output goes to memory,
+// a WAV file or a raw file. Events can be queued at any frame; each one is given to the
+// context in the block that contains its frame, with its time set to the offset in the block.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "MLAudioContext.h"
+#include "MLEvent.h"
+#include "MLHash.h"
+#include "MLSignalProcessBuffer.h"
+
+namespace ml
+{
+class OfflineAudioTask
+{
+ public:
+  enum class FileFormat
+  {
+    kFloat32,
+    kInt16,
+    kInt24
+  };
+
+  static constexpr int kDefaultBlockSize{512};
+
+  // the context is processed in blocks of blockSize frames, rounded up to a whole number of
+  // DSPVectors. Output is rendered a block ahead as needed, so any number of frames can be
+  // rendered at a time while events stay sample accurate.
+  OfflineAudioTask(AudioContext* ctx, SignalProcessFn procFn, void* procState,
+                   int blockSize = kDefaultBlockSize);
+  ~OfflineAudioTask() = default;
+
+  // use planar frames in memory as input. The memory must stay valid while rendering. Input
+  // past the end, and any channels beyond nChannels, are silent.
+  void setInput(const float* const* channels, size_t nChannels, size_t frames);
+
+  // read a WAV file into memory and use it as input. PCM 16, 24 and 32 bit and float 32 bit
+  // files can be read. The sample rate is not converted. Returns false if the file can't be read.
+  bool setInputFromWavFile(const char* path);
+
+  // queue an event to be sent at the given frame, counted from the start of rendering. Events
+  // at frames already processed are sent at the start of the next block.
+  void addEvent(const Event& e, uint64_t frame);
+  void clearEvents();
+
+  // render frames of output into planar buffers, one for each output of the context. Denormals
+  // are flushed to zero while rendering.
+  void render(float** outputs, size_t frames);
+
+  // render frames of output to a WAV file. Returns false if the file can't be written.
+  bool renderToWavFile(const char* path, size_t frames, FileFormat format = FileFormat::kFloat32);
+
+  // render frames of output to a headerless file of interleaved little-endian float32 frames.
+  bool renderToRawFile(const char* path, size_t frames);
+
+  // return to the start of the input and of the event times. The context and the state are
+  // unchanged.
+  void rewind();
+
+  // keep a 64-bit FNV-1a hash of the rendered output, frame by frame, for comparing renders.
+  // The hash does not depend on how the frames were split into render calls, and restarts
+  // at rewind().
+  void setHashOutput(bool b) { hashOutput_ = b; }
+  uint64_t getOutputHash() const { return outputHash_; }
+
+  uint64_t getFramesRendered() const { return framesRendered_; }
+  size_t getInputFrames() const { return inputFrames_; }
+  int getInputFileSampleRate() const { return inputFileSampleRate_; }
+
+ private:
+  struct TimedEvent
+  {
+    uint64_t frame;
+    Event event;
+  };
+
+  // process the next block of input and events into outputBlock_.
+  void processBlock();
+
+  bool renderToFile(const char* path, size_t frames, bool wav, FileFormat format);
+
+  AudioContext* context_;
+  SignalProcessFn processFn_;
+  void* processState_;
+  size_t blockSize_;
+  SignalProcessBuffer buffer_;
+
+  // input, as planar channel pointers and owned storage for input read from files.
+  std::vector<const float*> input_;
+  size_t inputFrames_{0};
+  std::vector<float> inputFileData_;
+  int inputFileSampleRate_{0};
+
+  // one block for each channel, and pointers to them.
+  std::vector<float> inputBlock_;
+  std::vector<const float*> inputPtrs_;
+  std::vector<float> outputBlock_;
+  std::vector<float*> outputPtrs_;
+  size_t outputBlockStart_{0};
+  size_t outputBlockFrames_{0};
+
+  std::vector<TimedEvent> events_;
+  size_t nextEvent_{0};
+  uint64_t framesProcessed_{0};
+  uint64_t framesRendered_{0};
+
+  bool hashOutput_{false};
+  uint64_t outputHash_{fnvConsts::k1};
+};
+
+}  // namespace ml
@@ -0,0 +1,116 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// parallelForEach: running a function on every object in a Collection or every value in a
+// Tree, on the threads of a WorkerPool.
+//
+// The objects are gathered into an array in the order of forEach(), which is a copy of the
+// dense array for an indexed Collection, and then cut into chunks. The calling thread and the
+// workers claim chunks one at a time from the pool's shared counter, so a thread that finishes
+// its chunks early takes more of the remaining ones and an uneven workload balances itself.
+// Chunks are large enough that claiming them costs little next to the work, and small enough
+// that each thread gets several.
+//
+// The callable is called at the same time on different threads, for different objects. It
+// must:
+// - be safe to call concurrently with itself. Any state it captures by reference and writes,
+//   such as counters or output containers, must be atomic, locked, or split per object.
+// - change only the object it is given, not the Collection or Tree: adding or removing
+//   objects while the loop is running is not allowed, and neither is calling parallelForEach()
+//   on the same pool from inside the callable.
+// - not throw. An exception on a worker thread ends the program.
+// No order of calls is guaranteed.
+//
+// Gathering the objects allocates, so this is for bulk work on the UI or other non-real-time
+// threads such as layouts and rendering thumbnails, not for the audio thread. Only one thread
+// at a time may use a given WorkerPool.
+
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "MLCollection.h"
+#include "MLTree.h"
+#include "MLWorkerPool.h"
+
+namespace ml
+{
+namespace detail
+{
+// chunks per thread when the chunk size is not given.
+constexpr size_t kParallelChunksPerThread{8};
+
+template <typename ITEM, typename CALLABLE>
+struct ParallelForEachJob
+{
+  const std::vector<ITEM>& items;
+  CALLABLE& f;
+  size_t chunkSize;
+
+  static void runChunk(void* context, size_t chunk)
+  {
+    auto& job = *static_cast<ParallelForEachJob*>(context);
+    const size_t first = chunk * job.chunkSize;
+    const size_t last = std::min(first + job.chunkSize, job.items.size());
+    for (size_t i = first; i < last; ++i)
+    {
+      job.call(job.items[i]);
+    }
+  }
+
+  template <typename T>
+  void call(T* object)
+  {
+    f(*object);
+  }
+
+  template <typename K, typename V>
+  void call(const std::pair<GenericPath<K>, const V*>& item)
+  {
+    f(item.first, *item.second);
+  }
+};
+
+template <typename ITEM, typename CALLABLE>
+inline void runParallelForEach(WorkerPool& pool, const std::vector<ITEM>& items, CALLABLE& f,
+                               size_t chunkSize)
+{
+  if (items.empty()) return;
+  if (chunkSize == 0)
+  {
+    const size_t threads = pool.getNumWorkers() + 1;
+    chunkSize = std::max<size_t>(1, items.size() / (threads * kParallelChunksPerThread));
+  }
+  const size_t nChunks = (items.size() + chunkSize - 1) / chunkSize;
+  ParallelForEachJob<ITEM, CALLABLE> job{items, f, chunkSize};
+  pool.run(nChunks, &ParallelForEachJob<ITEM, CALLABLE>::runChunk, &job);
+}
+}  // namespace detail
+
+// call f(T&) on each object in the Collection, on the threads of the pool. chunkSize is the
+// number of objects each thread claims at a time, or 0 to choose it from the size of the
+// Collection and the number of threads.
+template <typename T, typename CALLABLE>
+inline void parallelForEach(Collection<T>& coll, WorkerPool& pool, CALLABLE f,
+                            size_t chunkSize = 0)
+{
+  std::vector<T*> objects;
+  objects.reserve(coll.size());
+  coll.forEach([&](T& obj) { objects.push_back(&obj); });
+  detail::runParallelForEach(pool, objects, f, chunkSize);
+}
+
+// call f(path, const V&) on each value in the Tree, on the threads of the pool. The paths are
+// the same as those from Tree::visitValues().
+template <typename V, typename K, typename C, typename S, typename CALLABLE>
+inline void parallelVisitValues(const Tree<V, K, C, S>& tree, WorkerPool& pool, CALLABLE f,
+                                size_t chunkSize = 0)
+{
+  std::vector<std::pair<GenericPath<K>, const V*>> items;
+  tree.visitValues([&](const GenericPath<K>& p, const V& v) { items.emplace_back(p, &v); });
+  detail::runParallelForEach(pool, items, f, chunkSize);
+}
+
+}  // namespace ml
@@ -0,0 +1,189 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// ParameterRamps: sample-accurate parameter automation as DSPVectors of real values.
+//
+// An adapter adds the host's time-stamped parameter events for the next DSPVector, each with a
+// normalized value. Each event sets the value at its sample, and between events the value goes
+// in a straight line, starting from the value at the end of the previous vector. After a
+// parameter's last event in a vector its value holds. Integer and list parameters step at each
+// event instead.
+//
+// process() then projects the ramps to real values with the compiled parameters, one DSPVector
+// at a time, so there are no tree lookups per event. getRamp() makes a constant vector for the
+// parameters that have no events. A fixed number of parameters can ramp in one vector: events
+// for any others are applied at the end of the vector, without ramping.
+
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "MLDSPOps.h"
+#include "MLParameters.h"
+
+namespace ml
+{
+class ParameterRamps final
+{
+ public:
+  static constexpr size_t kDefaultMaxRampsPerVector{16};
+
+  ParameterRamps() = default;
+
+  // not realtime safe. Sizes the ramps for the compiled parameters, which must stay compiled
+  // while the ramps are used, and sets all the values to 0.
+  void resize(const ParameterTree& params, size_t maxRampsPerVector = kDefaultMaxRampsPerVector)
+  {
+    params_ = &params;
+    const size_t n = params.getNumCompiledParameters();
+    normValues_.assign(n, 0.f);
+    realValues_.assign(n, 0.f);
+    lastTimes_.assign(n, -1);
+    pendingSlots_.assign(n, kNoSlot);
+    readySlots_.assign(n, kNoSlot);
+    pendingIDs_.clear();
+    pendingIDs_.reserve(maxRampsPerVector);
+    readyIDs_.clear();
+    readyIDs_.reserve(maxRampsPerVector);
+    normRamps_.resize(maxRampsPerVector);
+    realRamps_.resize(maxRampsPerVector);
+    overflows_ = 0;
+  }
+
+  size_t size() const { return normValues_.size(); }
+
+  // set a value immediately, without ramping.
+  void setNormalizedValue(size_t id, float normValue)
+  {
+    normValues_[id] = normValue;
+    realValues_[id] = params_->convertNormalizedToRealFloatValue(id, normValue);
+  }
+
+  // add an event at a sample offset in the next vector. Events for each parameter must be added
+  // in time order, and earlier times are moved to the latest one.
+  void addEvent(size_t id, int time, float normValue)
+  {
+    if (id >= size()) return;
+    time = std::clamp(time, 0, int(kFloatsPerDSPVector) - 1);
+
+    size_t slot = pendingSlots_[id];
+    if (slot == kNoSlot)
+    {
+      if (pendingIDs_.size() == normRamps_.size())
+      {
+        setNormalizedValue(id, normValue);
+        overflows_++;
+        return;
+      }
+      slot = pendingIDs_.size();
+      pendingSlots_[id] = slot;
+      pendingIDs_.push_back(id);
+      lastTimes_[id] = -1;
+    }
+
+    // fill the samples after the last event up to this one.
+    float* pRamp = normRamps_[slot].getBuffer();
+    const int lastTime = lastTimes_[id];
+    time = std::max(time, lastTime);
+    const float y0 = normValues_[id];
+    if (isStepped(id))
+    {
+      std::fill(pRamp + lastTime + 1, pRamp + time, y0);
+    }
+    else if (time > lastTime)
+    {
+      const float dydt = (normValue - y0) / float(time - lastTime);
+      for (int i = lastTime + 1; i < time; ++i)
+      {
+        pRamp[i] = y0 + dydt * float(i - lastTime);
+      }
+    }
+    pRamp[time] = normValue;
+
+    normValues_[id] = normValue;
+    lastTimes_[id] = time;
+  }
+
+  // finish the ramps of the events added since the last call, for the next vector.
+  void process()
+  {
+    for (size_t id : readyIDs_) readySlots_[id] = kNoSlot;
+    readyIDs_.clear();
+
+    for (size_t slot = 0; slot < pendingIDs_.size(); ++slot)
+    {
+      const size_t id = pendingIDs_[slot];
+      float* pRamp = normRamps_[slot].getBuffer();
+      std::fill(pRamp + lastTimes_[id] + 1, pRamp + kFloatsPerDSPVector, normValues_[id]);
+
+      const CompiledParameter& c = params_->getCompiledParameter(id);
+      if (c.useListValuesAsInt)
+      {
+        for (int i = 0; i < kFloatsPerDSPVector; ++i)
+        {
+          realRamps_[slot][i] = params_->convertNormalizedToRealFloatValue(id, pRamp[i]);
+        }
+      }
+      else
+      {
+        realRamps_[slot] = params_->convertNormalizedToReal(id, normRamps_[slot]);
+      }
+      realValues_[id] = realRamps_[slot][kFloatsPerDSPVector - 1];
+
+      pendingSlots_[id] = kNoSlot;
+      readySlots_[id] = slot;
+      readyIDs_.push_back(id);
+    }
+    pendingIDs_.clear();
+  }
+
+  // true if the parameter has events for the next vector.
+  bool hasEvents(size_t id) const { return pendingSlots_[id] != kNoSlot; }
+
+  // true if the parameter has a ramp for the current vector.
+  bool isRamping(size_t id) const { return readySlots_[id] != kNoSlot; }
+
+  // the real values over the current vector.
+  DSPVector getRamp(size_t id) const
+  {
+    const size_t slot = readySlots_[id];
+    return (slot != kNoSlot) ? realRamps_[slot] : DSPVector(realValues_[id]);
+  }
+
+  // the values at the end of the current vector.
+  float getValue(size_t id) const { return realValues_[id]; }
+  float getNormalized(size_t id) const { return normValues_[id]; }
+
+  // the number of events applied without ramping because too many parameters had events.
+  size_t getOverflowCount() const { return overflows_; }
+
+ private:
+  static constexpr size_t kNoSlot{~size_t(0)};
+
+  bool isStepped(size_t id) const
+  {
+    const CompiledParameter& c = params_->getCompiledParameter(id);
+    return c.useListValuesAsInt || c.integerValues;
+  }
+
+  const ParameterTree* params_{nullptr};
+
+  // by parameter ID
+  std::vector<float> normValues_;
+  std::vector<float> realValues_;
+  std::vector<int> lastTimes_;
+  std::vector<size_t> pendingSlots_;
+  std::vector<size_t> readySlots_;
+
+  // by slot. Ramps being built for the next vector are pending, and ramps for the current
+  // vector are ready. The pending normalized ramps become the ready real ones in process().
+  std::vector<size_t> pendingIDs_;
+  std::vector<size_t> readyIDs_;
+  std::vector<DSPVector> normRamps_;
+  std::vector<DSPVector> realRamps_;
+  size_t overflows_{0};
+};
+
+}  // namespace ml
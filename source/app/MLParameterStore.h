@@ -0,0 +1,113 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// ParameterStore: float parameter values indexed by ID, passed from one writer
+// thread to one reader thread without locks.
+//
+// The writer sets values in a staging array, then publishes them all at once.
+// The reader takes the most recently published values with update(), and reads
+// them from its current snapshot until the next update(). Neither side ever
+// waits for the other, and the reader always sees the values from a single
+// publish.
+//
+// The values are kept in three buffers. The writer and reader each own one,
+// and the third holds the latest published values. publish() and update()
+// swap the owned buffer with the third one in a single atomic exchange.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ml
+{
+class ParameterStore final
+{
+ public:
+  ParameterStore() = default;
+  explicit ParameterStore(size_t n) { resize(n); }
+
+  ParameterStore(ParameterStore const&) = delete;
+  ParameterStore& operator=(ParameterStore const&) = delete;
+
+  // not thread-safe. Sets all the values to 0.
+  void resize(size_t n)
+  {
+    size_ = n;
+    staged_.assign(n, 0.f);
+    buffers_.assign(n * kBuffers, 0.f);
+    writeBuffer_ = 0;
+    readBuffer_ = 1;
+    latest_.store(2, std::memory_order_relaxed);
+    changed_ = false;
+  }
+
+  size_t size() const { return size_; }
+
+  // writer side
+
+  void set(size_t id, float val)
+  {
+    staged_[id] = val;
+    changed_ = true;
+  }
+
+  float getStaged(size_t id) const { return staged_[id]; }
+
+  // make the staged values visible to the reader. Does nothing if no values
+  // were set since the last publish.
+  void publish()
+  {
+    if (!changed_) return;
+    float* dest = buffer(writeBuffer_);
+    for (size_t i = 0; i < size_; ++i)
+    {
+      dest[i] = staged_[i];
+    }
+    uint32_t prev = latest_.exchange(writeBuffer_ | kFreshBit, std::memory_order_acq_rel);
+    writeBuffer_ = prev & kIndexMask;
+    changed_ = false;
+  }
+
+  // reader side
+
+  // take the latest published values, if any. Returns true if there
+  // were new values.
+  bool update()
+  {
+    if (!(latest_.load(std::memory_order_relaxed) & kFreshBit)) return false;
+    uint32_t prev = latest_.exchange(readBuffer_, std::memory_order_acq_rel);
+    readBuffer_ = prev & kIndexMask;
+    return true;
+  }
+
+  float get(size_t id) const { return buffers_[readBuffer_ * size_ + id]; }
+  const float* getValues() const { return buffers_.data() + readBuffer_ * size_; }
+
+ private:
+  static constexpr uint32_t kBuffers{3};
+  static constexpr uint32_t kIndexMask{3};
+  static constexpr uint32_t kFreshBit{4};
+
+  float* buffer(uint32_t i) { return buffers_.data() + i * size_; }
+
+  size_t size_{0};
+  std::vector<float> buffers_;
+
+  // owned by the writer
+  std::vector<float> staged_;
+  uint32_t writeBuffer_{0};
+  bool changed_{false};
+
+  // owned by the reader
+  uint32_t readBuffer_{1};
+
+  // the index of the buffer with the latest published values, plus
+  // kFreshBit if the reader has not taken them yet.
+  std::atomic<uint32_t> latest_{2};
+};
+
+}  // namespace ml
@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include "MLDSPCompiledProjection.h"
 #include "MLPropertyTree.h"
 
 namespace ml
@@ -19,12 +20,28 @@ struct ParameterProjection
   Projection realToNormalized{projections::unity};
 };
 
-// create a pair of functions that transform a parameter from normalized to real and back.
-// the two functions should be the inverses of each other.
+// the number of items in a list parameter.
+inline size_t getListItemCount(const ParameterDescription& p)
+{
+  if (!p.hasProperty("listitems")) return 0;
+  Text listText = p.getTextProperty("listitems");
+  return textUtils::TextSplitter(listText, '/').countPieces();
+}
+
+// A pair of CompiledProjections that transform a parameter from normalized to real and back.
+// These can be evaluated on whole DSPVectors.
+struct CompiledParameterProjection
+{
+  CompiledProjection normalizedToReal;
+  CompiledProjection realToNormalized;
+};
+
+// create the compiled projections for a parameter description.
+// the two projections should be the inverses of each other.
 //
-inline ParameterProjection createParameterProjection(const ParameterDescription& p)
+inline CompiledParameterProjection createCompiledParameterProjection(const ParameterDescription& p)
 {
-  ParameterProjection b;
+  CompiledParameterProjection b;
   Symbol units(p.getProperty("units").getTextValue());
   bool bLog = p.getBoolPropertyWithDefault("log", false);
   bool bisquare = p.getBoolPropertyWithDefault("bisquare", false);
@@ -36,19 +53,11 @@ inline ParameterProjection createParameterProjection(const ParameterDescription&
   // make ranges for list parameters
   if (units == "list")
   {
-    // get number of items
-    size_t nItems{0};
-    if (p.hasProperty("listitems"))
-    {
-      // read and count list items
-      auto listItems = textUtils::split(p.getTextProperty("listitems"), '/');
-      nItems = listItems.size();
-    }
-
+    size_t nItems = getListItemCount(p);
     if (nItems <= 1)
     {
-      b.normalizedToReal = projections::zero;
-      b.realToNormalized = projections::zero;
+      b.normalizedToReal = compiledProjections::constant(0.f);
+      b.realToNormalized = compiledProjections::constant(0.f);
     }
     else
     {
@@ -57,38 +66,88 @@ inline ParameterProjection createParameterProjection(const ParameterDescription&
       // itemsScale is 1, and everything below 0.5 should round to item 0, while 0.5 and above
       // rounds to item 1.
       float itemsScale = nItems - 1.f;
-      b.normalizedToReal = [=](float x) { return (x * itemsScale); };
-      b.realToNormalized = [=](float x) { return (x / itemsScale); };
+      b.normalizedToReal = compiledProjections::linear(normalRange, {0.f, itemsScale});
+      b.realToNormalized = compiledProjections::linear({0.f, itemsScale}, normalRange);
     }
   }
   else
   {
     if (bLog)
     {
-      b.normalizedToReal =
-          compose(projections::add(offset),
-                  projections::intervalMap(normalRange, plainRange, projections::log(plainRange)));
-
-      b.realToNormalized =
-          compose(projections::intervalMap(plainRange, normalRange, projections::exp(plainRange)),
-                  projections::add(-offset));
+      b.normalizedToReal = compiledProjections::unityToLogParam(plainRange, offset);
+      b.realToNormalized = compiledProjections::logParamToUnity(plainRange, offset);
     }
     else if (bisquare)
     {
-      b.normalizedToReal =
-          compose(projections::bisquared, projections::linear(normalRange, plainRange));
-      b.realToNormalized =
-          compose(projections::linear(plainRange, normalRange), projections::invBisquared);
+      b.normalizedToReal = compiledProjections::bisquaredLinear(normalRange, plainRange);
+      b.realToNormalized = compiledProjections::linearInvBisquared(plainRange, normalRange);
     }
     else
     {
-      b.normalizedToReal = projections::linear(normalRange, plainRange);
-      b.realToNormalized = projections::linear(plainRange, normalRange);
+      b.normalizedToReal = compiledProjections::linear(normalRange, plainRange);
+      b.realToNormalized = compiledProjections::linear(plainRange, normalRange);
     }
   }
   return b;
 }
 
+// create a pair of functions that transform a parameter from normalized to real and back.
+// the two functions should be the inverses of each other. Each is a single call to a
+// CompiledProjection.
+//
+inline ParameterProjection createParameterProjection(const ParameterDescription& p)
+{
+  CompiledParameterProjection c = createCompiledParameterProjection(p);
+  ParameterProjection b{c.normalizedToReal.toProjection(), c.realToNormalized.toProjection()};
+
+  // list items are found by truncating normalizedToReal(realToNormalized(i)), which lands on i
+  // more often with a division than with a multiply by the reciprocal.
+  Symbol units(p.getProperty("units").getTextValue());
+  size_t nItems = getListItemCount(p);
+  if ((units == "list") && (nItems > 1))
+  {
+    float itemsScale = nItems - 1.f;
+    b.realToNormalized = [=](float x) { return (x / itemsScale); };
+  }
+  return b;
+}
+
+// A parameter description compiled into what its value conversions need, so that converting by
+// ID does no tree lookups, text parsing or allocation.
+struct CompiledParameter
+{
+  ParameterProjection projection{projections::zero, projections::zero};
+  CompiledParameterProjection curves{compiledProjections::constant(0.f),
+                                     compiledProjections::constant(0.f)};
+
+  // the integer values of the list items, for use_list_values_as_int parameters.
+  std::vector<float> listValues;
+
+  bool exists{false};
+  bool useListValuesAsInt{false};
+  bool integerValues{false};
+};
+
+inline CompiledParameter compileParameter(const ParameterDescription& pdesc,
+                                          const ParameterProjection& proj)
+{
+  CompiledParameter c;
+  c.projection = proj;
+  c.curves = createCompiledParameterProjection(pdesc);
+  c.exists = true;
+  c.useListValuesAsInt = pdesc.getBoolPropertyWithDefault("use_list_values_as_int", false);
+  c.integerValues = pdesc.getBoolPropertyWithDefault("integer_values", false);
+  if (c.useListValuesAsInt)
+  {
+    Text listText = pdesc.getTextProperty("listitems");
+    for (TextView item : textUtils::TextSplitter(listText, '/'))
+    {
+      c.listValues.push_back((float)textUtils::textToNaturalNumber(item));
+    }
+  }
+  return c;
+}
+
 // An annotated Tree of parameters.
 class ParameterTree
 {
@@ -117,9 +176,10 @@ public:
     bool useListValues = pdesc->getBoolPropertyWithDefault("use_list_values_as_int", false);
     if (useListValues)
     {
-      auto listItems = textUtils::split(pdesc->getTextProperty("listitems"), '/');
+      Text listText = pdesc->getTextProperty("listitems");
       int itemIndex = (int)(projections[pname].normalizedToReal(newNormValue));
-      newRealValue = (float)textUtils::textToNaturalNumber(listItems[itemIndex]);
+      TextView item = textUtils::TextSplitter(listText, '/').getPiece(itemIndex);
+      newRealValue = (float)textUtils::textToNaturalNumber(item);
     }
     else
     {
@@ -138,17 +198,19 @@ public:
     bool useListValues = pdesc->getBoolPropertyWithDefault("use_list_values_as_int", false);
     if (useListValues)
     {
-      auto listItems = textUtils::split(pdesc->getTextProperty("listitems"), '/');
+      Text listText = pdesc->getTextProperty("listitems");
       
       // get item matching plain value
-      for (int i = 0; i < listItems.size(); ++i)
+      int i = 0;
+      for (TextView item : textUtils::TextSplitter(listText, '/'))
       {
-        size_t itemIdx = textUtils::textToNaturalNumber(listItems[i]);
+        size_t itemIdx = textUtils::textToNaturalNumber(item);
         if (newRealValue == itemIdx)
         {
           newNormValue = projections[pname].realToNormalized((float)i);
           break;
         }
+        i++;
       }
     }
     else
@@ -204,6 +266,151 @@ public:
     }
   }
 
+  // Compile the descriptions of the named parameters into an array indexed by ID, where the ID of
+  // each parameter is its index in namesByID. Names without descriptions get IDs that convert
+  // everything to 0. Changing the descriptions afterwards requires compiling again.
+  void compileParameters(const std::vector<Path>& namesByID)
+  {
+    compiled_.clear();
+    compiled_.resize(namesByID.size());
+    for (size_t i = 0; i < namesByID.size(); ++i)
+    {
+      const auto& pdesc = descriptions[namesByID[i]];
+      if (pdesc)
+      {
+        compiled_[i] = compileParameter(*pdesc, projections[namesByID[i]]);
+      }
+    }
+    compileBatch();
+  }
+
+  size_t getNumCompiledParameters() const { return compiled_.size(); }
+  const CompiledParameter& getCompiledParameter(size_t id) const { return compiled_[id]; }
+
+  // conversions by ID. The parameters must have been compiled.
+
+  float convertNormalizedToRealFloatValue(size_t id, float normValue) const
+  {
+    const CompiledParameter& c = compiled_[id];
+    if (!c.exists) return 0;
+
+    float realValue = c.projection.normalizedToReal(normValue);
+    if (c.useListValuesAsInt)
+    {
+      // out of range items read as 0, as with missing list items in the Path version.
+      int itemIndex = (int)realValue;
+      bool inRange = (itemIndex >= 0) && ((size_t)itemIndex < c.listValues.size());
+      return inRange ? c.listValues[itemIndex] : 0.f;
+    }
+    return realValue;
+  }
+
+  float convertRealToNormalizedFloatValue(size_t id, float realValue) const
+  {
+    const CompiledParameter& c = compiled_[id];
+    if (!c.exists) return 0;
+
+    if (c.useListValuesAsInt)
+    {
+      for (size_t i = 0; i < c.listValues.size(); ++i)
+      {
+        if (c.listValues[i] == realValue)
+        {
+          return c.projection.realToNormalized((float)i);
+        }
+      }
+      return 0;
+    }
+    return c.projection.realToNormalized(realValue);
+  }
+
+  // convert a DSPVector of values by ID with SIMD, as for audio rate automation. List items
+  // are not looked up, so the result for use_list_values_as_int parameters is the item index.
+  DSPVector convertNormalizedToReal(size_t id, const DSPVector& normValues) const
+  {
+    return compiled_[id].curves.normalizedToReal(normValues);
+  }
+
+  DSPVector convertRealToNormalized(size_t id, const DSPVector& realValues) const
+  {
+    return compiled_[id].curves.realToNormalized(realValues);
+  }
+
+  // convert the normalized values of all the compiled parameters at once, as for loading a
+  // preset. normValues and realValues each hold getNumCompiledParameters() values. The curves
+  // are evaluated with SIMD across parameters, kFloatsPerDSPVector at a time, then list items
+  // are looked up. A NaN normalized value converts to NaN.
+  void convertNormalizedToRealFloatValues(const float* normValues, float* realValues) const
+  {
+    const size_t n = compiled_.size();
+    for (size_t chunk = 0; chunk < batch_.shapesInChunk.size(); ++chunk)
+    {
+      const size_t start = chunk * kFloatsPerDSPVector;
+      const size_t count = std::min(n - start, size_t(kFloatsPerDSPVector));
+      DSPVector x;
+      std::copy(normValues + start, normValues + start + count, x.getBuffer());
+      std::fill(x.getBuffer() + count, x.getBuffer() + kFloatsPerDSPVector, 0.f);
+
+      // evaluate each shape that appears in the chunk, and select it for its parameters.
+      const DSPVector u = x * batch_.inScale[chunk] + batch_.inOffset[chunk];
+      const DSPVector& shapes = batch_.shape[chunk];
+      const uint32_t shapesInChunk = batch_.shapesInChunk[chunk];
+      auto has = [&](CompiledProjection::Shape s) { return shapesInChunk & (1u << int(s)); };
+      auto isShape = [&](CompiledProjection::Shape s) { return equal(shapes, DSPVector(float(s))); };
+      DSPVector y = u;
+      if (has(CompiledProjection::Shape::kExp))
+      {
+        y = select(exp(u), y, isShape(CompiledProjection::Shape::kExp));
+      }
+      if (has(CompiledProjection::Shape::kLog))
+      {
+        y = select(log(u), y, isShape(CompiledProjection::Shape::kLog));
+      }
+      if (has(CompiledProjection::Shape::kBisquare))
+      {
+        y = select(abs(u) * u, y, isShape(CompiledProjection::Shape::kBisquare));
+      }
+      if (has(CompiledProjection::Shape::kInvBisquare))
+      {
+        y = select(sqrt(abs(u)) * sign(u), y, isShape(CompiledProjection::Shape::kInvBisquare));
+      }
+      y = y * batch_.outScale[chunk] + batch_.outOffset[chunk];
+      std::copy(y.getConstBuffer(), y.getConstBuffer() + count, realValues + start);
+    }
+
+    for (size_t id : batch_.listIDs)
+    {
+      const CompiledParameter& c = compiled_[id];
+      if (realValues[id] != realValues[id]) continue;
+      int itemIndex = (int)realValues[id];
+      bool inRange = (itemIndex >= 0) && ((size_t)itemIndex < c.listValues.size());
+      realValues[id] = inRange ? c.listValues[itemIndex] : 0.f;
+    }
+  }
+
+  Value convertNormalizedToRealValue(size_t id, Value val) const
+  {
+    if (val.getType() != Value::kFloat) return val;
+    if (!compiled_[id].exists) return Value();
+
+    float fVal = convertNormalizedToRealFloatValue(id, val.getFloatValue());
+    return compiled_[id].integerValues ? Value(static_cast<int>(fVal)) : Value(fVal);
+  }
+
+  Value convertRealToNormalizedValue(size_t id, Value val) const
+  {
+    switch (val.getType())
+    {
+      case Value::kUndefined:
+        return Value();
+      case Value::kFloat:
+      case Value::kInt:
+        return Value(convertRealToNormalizedFloatValue(id, val.getFloatValue()));
+      default:
+        return val;
+    }
+  }
+
   // set a parameter's value without conversion. For params that don't have normalizable values.
   // both normal and real params are set for ease of getting all normalized + non-normalizable
   // values.
@@ -295,6 +502,46 @@ public:
   
 protected:
   Path watchParameter{};
+  std::vector<CompiledParameter> compiled_;
+
+  // the normalizedToReal curves of the compiled parameters as structures of arrays, one
+  // DSPVector of each term for every kFloatsPerDSPVector parameters.
+  struct CompiledBatch
+  {
+    std::vector<DSPVector> shape, inScale, inOffset, outScale, outOffset;
+
+    // a bit for each shape used by a chunk's parameters.
+    std::vector<uint32_t> shapesInChunk;
+
+    // the IDs of use_list_values_as_int parameters.
+    std::vector<size_t> listIDs;
+  };
+  CompiledBatch batch_;
+
+  void compileBatch()
+  {
+    const size_t chunks = (compiled_.size() + kFloatsPerDSPVector - 1) / kFloatsPerDSPVector;
+    batch_ = CompiledBatch();
+    batch_.shape.resize(chunks);
+    batch_.inScale.resize(chunks);
+    batch_.inOffset.resize(chunks);
+    batch_.outScale.resize(chunks);
+    batch_.outOffset.resize(chunks);
+    batch_.shapesInChunk.assign(chunks, 0);
+    for (size_t id = 0; id < compiled_.size(); ++id)
+    {
+      const size_t chunk = id / kFloatsPerDSPVector;
+      const int i = int(id % kFloatsPerDSPVector);
+      const CompiledProjection& p = compiled_[id].curves.normalizedToReal;
+      batch_.shape[chunk][i] = float(p.shape);
+      batch_.inScale[chunk][i] = p.inScale;
+      batch_.inOffset[chunk][i] = p.inOffset;
+      batch_.outScale[chunk][i] = p.outScale;
+      batch_.outOffset[chunk][i] = p.outOffset;
+      batch_.shapesInChunk[chunk] |= 1u << int(p.shape);
+      if (compiled_[id].useListValuesAsInt) batch_.listIDs.push_back(id);
+    }
+  }
   
 public:
 
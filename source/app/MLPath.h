@@ -21,8 +21,11 @@
 //
 // Paths are immutable after construction.
 //
-// The maximum path depth is fixed at compile time (kPathMaxSymbols = 15),
-// allowing stack allocation and use in real-time audio threads.
+// The maximum path depth is fixed at compile time (kPathMaxSymbols = 15).
+// Paths of up to kPathInlineSymbols (4) elements are stored inline, so
+// making and copying them never allocates, and a Path is 48 bytes. Longer
+// paths keep their elements in a shared block that copies refer to, and
+// that is copied only when a path sharing it is changed.
 //
 // GenericPath provides a common interface for all path types via template
 // specialization. Type-specific behavior (construction from strings, text
@@ -36,8 +39,11 @@
 
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <iostream>
+#include <utility>
 #include <vector>
 
 #include "MLHash.h"
@@ -48,6 +54,7 @@ namespace ml
 {
 
 const int kPathMaxSymbols = 15;
+const int kPathInlineSymbols = 4;
 
 // Type alias for hash-based paths
 using SymbolHash = uint64_t;
@@ -62,6 +69,47 @@ class GenericPath
   GenericPath(const char* str);
   GenericPath(const TextFragment& frag);
 
+  GenericPath(const GenericPath& b) : inline_(b.inline_), shared_(b.shared_), size_(b.size_)
+  {
+    if (shared_) shared_->refs.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  GenericPath(GenericPath&& b) noexcept
+      : inline_(std::move(b.inline_)), shared_(b.shared_), size_(b.size_)
+  {
+    b.shared_ = nullptr;
+    b.size_ = 0;
+  }
+
+  GenericPath& operator=(const GenericPath& b)
+  {
+    if (shared_ != b.shared_)
+    {
+      if (b.shared_) b.shared_->refs.fetch_add(1, std::memory_order_relaxed);
+      release();
+      shared_ = b.shared_;
+    }
+    inline_ = b.inline_;
+    size_ = b.size_;
+    return *this;
+  }
+
+  GenericPath& operator=(GenericPath&& b) noexcept
+  {
+    if (this != &b)
+    {
+      release();
+      inline_ = std::move(b.inline_);
+      shared_ = b.shared_;
+      size_ = b.size_;
+      b.shared_ = nullptr;
+      b.size_ = 0;
+    }
+    return *this;
+  }
+
+  ~GenericPath() { release(); }
+
   // Combining paths
   GenericPath(const GenericPath p1, const GenericPath p2)
   {
@@ -86,9 +134,10 @@ class GenericPath
   }
 
   // Comparison
-  bool operator==(const GenericPath b) const
+  bool operator==(const GenericPath& b) const
   {
     if (getSize() != b.getSize()) return false;
+    if (shared_ && (shared_ == b.shared_)) return true;
     for (int i = 0; i < getSize(); ++i)
     {
       if (getElement(i) != b.getElement(i)) return false;
@@ -96,28 +145,32 @@ class GenericPath
     return true;
   }
 
-  bool operator!=(const GenericPath b) const { return !(operator==(b)); }
+  bool operator!=(const GenericPath& b) const { return !(operator==(b)); }
   explicit operator bool() const { return size_ != 0; }
 
   // Accessors
   int getSize() const { return static_cast<int>(size_); }
-  K getElement(size_t n) const { return elements_[n]; }
+  K getElement(size_t n) const
+  {
+    if (shared_) return shared_->elements[n];
+    return (n < kPathInlineSymbols) ? inline_[n] : K();
+  }
 
   void setElement(size_t n, K elem)
   {
     if (n < kPathMaxSymbols)
     {
-      elements_[n] = elem;
+      getWritableElements(std::max(n + 1, size_t(size_)))[n] = std::move(elem);
       if (n >= size_) size_ = n + 1;
     }
   }
 
-  bool beginsWith(GenericPath<K> b) const
+  bool beginsWith(const GenericPath<K>& b) const
   {
     if (b.getSize() > getSize()) return false;
     for (int i = 0; i < b.getSize(); ++i)
     {
-      if (elements_[i] != b.elements_[i]) return false;
+      if (getElement(i) != b.getElement(i)) return false;
     }
     return true;
   }
@@ -169,14 +222,66 @@ class GenericPath
   {
     if (size_ < kPathMaxSymbols)
     {
-      elements_[size_++] = elem;
+      getWritableElements(size_ + 1)[size_] = std::move(elem);
+      size_++;
     }
   }
 
-protected:
-  std::array<K, kPathMaxSymbols> elements_{};
+  // remove the last element, if any. Paths sharing elements with this one are not changed.
+  void removeLastElement()
+  {
+    if (!size_) return;
+    size_--;
+    if (!shared_) inline_[size_] = K();
+  }
+
+ private:
+  struct SharedElements
+  {
+    std::atomic<uint32_t> refs{1};
+    std::array<K, kPathMaxSymbols> elements{};
+  };
+
+  void release()
+  {
+    if (shared_ && (shared_->refs.fetch_sub(1, std::memory_order_acq_rel) == 1))
+    {
+      delete shared_;
+    }
+    shared_ = nullptr;
+  }
+
+  // the elements, with room for newSize of them, and not shared with any
+  // other path.
+  K* getWritableElements(size_t newSize)
+  {
+    if (!shared_)
+    {
+      if (newSize <= kPathInlineSymbols) return inline_.data();
+
+      // move to a shared block.
+      auto block = new SharedElements;
+      for (size_t i = 0; i < size_; ++i)
+      {
+        block->elements[i] = std::move(inline_[i]);
+      }
+      inline_ = {};
+      shared_ = block;
+    }
+    else if (shared_->refs.load(std::memory_order_acquire) > 1)
+    {
+      // copy on write.
+      auto block = new SharedElements;
+      block->elements = shared_->elements;
+      release();
+      shared_ = block;
+    }
+    return shared_->elements.data();
+  }
+
+  std::array<K, kPathInlineSymbols> inline_{};
+  SharedElements* shared_{nullptr};
   unsigned char size_{0};
-  unsigned char copy_{0};
 };
 
 
@@ -295,7 +400,7 @@ inline GenericPath<K> lastN(GenericPath<K> p, size_t n)
 //
 // Paths constructed from string literals at compile time (constexpr) have
 // zero runtime initialization cost. The path segments are hashed at compile
-// time using FNV-1a. Symbol registration (for text lookup) happens separately,
+// time with textHash(). Symbol registration (for text lookup) happens separately,
 // typically when the Tree is populated or via runtimePath()/PathList.
 //
 // Path comparison is extremely fast, using hash comparison rather than string
@@ -303,7 +408,8 @@ inline GenericPath<K> lastN(GenericPath<K> p, size_t n)
 //
 // Path stores only hashes. To get the text representation, Symbols must be
 // registered in the SymbolTable. This happens automatically via runtimePath(),
-// PathList, or Tree operations.
+// PathList, or Tree operations. Compile-time paths declared with
+// ML_STATIC_PATH are registered in bulk at startup.
 //
 // Maximum path depth is 15 segments (kPathMaxSymbols).
 //
@@ -480,7 +586,7 @@ public:
 
         if (len > 0)
         {
-          elements_[size_++] = fnv1aSubstring(&str[start], len);
+          elements_[size_++] = textHash(&str[start], len);
         }
       }
     }
@@ -490,6 +596,13 @@ public:
   size_t size_{0};
 };
 
+// declare a constexpr HashPath, and register the text of its segments at
+// startup so that the Symbols in the path can be printed. Use at namespace
+// scope or inside a class, where name is not already used.
+#define ML_STATIC_PATH(name, str)        \
+  static constexpr ml::HashPath name{str}; \
+  static inline const ml::StaticSymbolText name##StaticText_{str, '/'}
+
 
 // Stream operators
 
@@ -0,0 +1,381 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLPitchOnsetAnalyzer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace ml
+{
+
+namespace
+{
+size_t nextPowerOfTwo(size_t n)
+{
+  size_t p = 1;
+  while (p < n) p <<= 1;
+  return p;
+}
+
+size_t frameSizeFor(size_t n) { return nextPowerOfTwo(std::max(n, size_t(64))); }
+
+// magnitudes are compressed as log(1 + kCompression * magnitude).
+constexpr float kCompression{100.f};
+
+// an onset must be this many times the average flux, so that steady noise doesn't make onsets.
+constexpr float kAverageRatio{1.5f};
+}  // namespace
+
+// ----------------------------------------------------------------
+// PitchDetector
+
+PitchDetector::PitchDetector(size_t frameSize, float sampleRate, float minFrequency,
+                             float maxFrequency, float threshold)
+    : size_(frameSizeFor(frameSize)),
+      sampleRate_(sampleRate),
+      threshold_(threshold),
+      fft_(long(frameSizeFor(frameSize)))
+{
+  // the difference is taken over a window of half the frame, at lags up to half the frame.
+  const size_t window = size_ / 2;
+  maxPeriod_ = std::clamp(size_t(sampleRate / std::max(minFrequency, 1.f)), size_t(3), window - 2);
+  minPeriod_ = std::clamp(size_t(sampleRate / std::max(maxFrequency, 1.f)), size_t(2),
+                          maxPeriod_ - 1);
+
+  input_.resize(size_);
+  frameSpectrum_.resize(size_);
+  windowSpectrum_.resize(size_);
+  correlation_.resize(size_);
+  difference_.resize(window);
+}
+
+PitchEstimate PitchDetector::operator()(const float* pFrame)
+{
+  const size_t n = size_;
+  const size_t half = n / 2;
+
+  // the correlation r(t) of the first half of the frame with the frame at lag t is the inverse
+  // transform of the spectrum of the frame times the conjugate spectrum of its first half.
+  fft_.do_fft(frameSpectrum_.data(), pFrame);
+  std::copy(pFrame, pFrame + half, input_.begin());
+  std::fill(input_.begin() + half, input_.end(), 0.f);
+  fft_.do_fft(windowSpectrum_.data(), input_.data());
+
+  float* a = frameSpectrum_.data();
+  float* b = windowSpectrum_.data();
+  a[0] *= b[0];
+  a[half] *= b[half];
+  for (size_t k = 1; k < half; ++k)
+  {
+    const float ar = a[k], ai = a[half + k];
+    const float br = b[k], bi = b[half + k];
+    a[k] = br * ar + bi * ai;
+    a[half + k] = br * ai - bi * ar;
+  }
+  fft_.do_ifft(a, correlation_.data());
+  const float scale = 1.f / float(n);
+
+  // the difference d(t) = e(0) + e(t) - 2r(t), where e(t) is the energy of the window at lag t,
+  // then the cumulative mean normalized difference.
+  double energy0{0.};
+  for (size_t j = 0; j < half; ++j)
+  {
+    energy0 += double(pFrame[j]) * pFrame[j];
+  }
+  if (energy0 < 1e-12) return PitchEstimate();
+
+  double energy = energy0;
+  double sum{0.};
+  difference_[0] = 1.f;
+  const size_t lastPeriod = std::min(maxPeriod_ + 1, half - 1);
+  for (size_t t = 1; t <= lastPeriod; ++t)
+  {
+    energy += double(pFrame[t + half - 1]) * pFrame[t + half - 1] -
+              double(pFrame[t - 1]) * pFrame[t - 1];
+    const double d = std::max(energy0 + energy - 2. * correlation_[t] * scale, 0.);
+    sum += d;
+    difference_[t] = (sum > 0.) ? float(d * t / sum) : 1.f;
+  }
+
+  // the first dip below the threshold, followed down to its minimum.
+  size_t period{0};
+  for (size_t t = minPeriod_; t <= maxPeriod_; ++t)
+  {
+    if (difference_[t] < threshold_)
+    {
+      while ((t + 1 <= maxPeriod_) && (difference_[t + 1] < difference_[t])) ++t;
+      period = t;
+      break;
+    }
+  }
+  if (!period)
+  {
+    const auto pMin = std::min_element(difference_.begin() + minPeriod_,
+                                       difference_.begin() + maxPeriod_ + 1);
+    return PitchEstimate{0.f, std::max(1.f - *pMin, 0.f)};
+  }
+
+  // refine the period with a parabola through the minimum and its neighbors.
+  const float d0 = difference_[period - 1];
+  const float d1 = difference_[period];
+  const float d2 = difference_[period + 1];
+  const float denom = d0 - 2.f * d1 + d2;
+  const float offset = (denom > 0.f) ? std::clamp(0.5f * (d0 - d2) / denom, -0.5f, 0.5f) : 0.f;
+  const float refined = float(period) + offset;
+  return PitchEstimate{sampleRate_ / refined, std::clamp(1.f - d1, 0.f, 1.f)};
+}
+
+// ----------------------------------------------------------------
+// OnsetDetector
+
+OnsetDetector::OnsetDetector(size_t frameSize, float threshold, size_t averageFrames)
+    : size_(frameSizeFor(frameSize)), threshold_(threshold), fft_(long(frameSizeFor(frameSize)))
+{
+  // a periodic Hann window, scaled so that a full-scale sine has a magnitude of 1.
+  window_.resize(size_);
+  float sum{0.f};
+  for (size_t i = 0; i < size_; ++i)
+  {
+    window_[i] = 0.5f - 0.5f * cosf(kTwoPi * float(i) / float(size_));
+    sum += window_[i];
+  }
+  for (auto& w : window_)
+  {
+    w *= 2.f / sum;
+  }
+
+  input_.resize(size_);
+  spectrum_.resize(size_);
+  logMagnitudes_.resize(size_ / 2 + 1);
+  history_.resize(std::max(averageFrames, size_t(1)));
+  clear();
+}
+
+void OnsetDetector::clear()
+{
+  std::fill(logMagnitudes_.begin(), logMagnitudes_.end(), 0.f);
+  std::fill(history_.begin(), history_.end(), 0.f);
+  std::fill(flux_, flux_ + 3, 0.f);
+  historyIndex_ = 0;
+  frames_ = 0;
+  sinceOnset_ = minInterval_;
+}
+
+float OnsetDetector::operator()(const float* pFrame)
+{
+  for (size_t i = 0; i < size_; ++i)
+  {
+    input_[i] = pFrame[i] * window_[i];
+  }
+  fft_.do_fft(spectrum_.data(), input_.data());
+
+  // the rise of the log magnitudes, summed over the bins.
+  const size_t half = size_ / 2;
+  float flux{0.f};
+  for (size_t k = 0; k <= half; ++k)
+  {
+    const float re = spectrum_[k];
+    const float im = ((k > 0) && (k < half)) ? spectrum_[half + k] : 0.f;
+    const float m = logf(1.f + kCompression * sqrtf(re * re + im * im));
+    flux += std::max(m - logMagnitudes_[k], 0.f);
+    logMagnitudes_[k] = m;
+  }
+
+  // the average of the fluxes before the previous one.
+  float mean{0.f};
+  for (float h : history_)
+  {
+    mean += h;
+  }
+  mean /= float(history_.size());
+
+  flux_[2] = flux_[1];
+  flux_[1] = flux_[0];
+  flux_[0] = flux;
+  frames_++;
+  sinceOnset_++;
+
+  // an onset is a peak of the flux, above the average of the fluxes before it.
+  float strength{0.f};
+  const float peak = flux_[1];
+  if ((frames_ > 2) && (peak > flux_[0]) && (peak >= flux_[2]) && (peak > kAverageRatio * mean + threshold_) &&
+      (sinceOnset_ > minInterval_))
+  {
+    strength = peak - mean;
+    sinceOnset_ = 1;
+  }
+
+  history_[historyIndex_] = flux_[1];
+  historyIndex_ = (historyIndex_ + 1) % history_.size();
+  return strength;
+}
+
+// ----------------------------------------------------------------
+// PitchOnsetAnalyzer
+
+PitchOnsetAnalyzer::PitchOnsetAnalyzer(SignalProcessor::PublishedSignal& signal, float sampleRate,
+                                       const PitchOnsetAnalyzerConfig& config)
+    : signal_(signal), sampleRate_(sampleRate), config_(config), messages_(config.queueSize)
+{
+  config_.frameSize = frameSizeFor(config_.frameSize);
+  config_.hopSize = std::max(config_.hopSize, size_t(1));
+  const size_t n = config_.frameSize;
+
+  if (config_.detectPitch)
+  {
+    pitch_ = std::make_unique<PitchDetector>(n, sampleRate_, config_.minFrequency,
+                                             config_.maxFrequency, config_.pitchThreshold);
+  }
+  if (config_.detectOnsets)
+  {
+    onsets_ = std::make_unique<OnsetDetector>(n, config_.onsetThreshold);
+  }
+
+  history_.assign(n, 0.f);
+  frame_.resize(n);
+  samplesToHop_ = config_.hopSize;
+
+  const size_t channels = std::max(signal_.getNumChannels(), size_t(1));
+  readBuffer_.resize(kFloatsPerDSPVector * channels);
+}
+
+void PitchOnsetAnalyzer::skipBacklog()
+{
+  const size_t channels = signal_.getNumChannels();
+  const size_t available = size_t(std::max(signal_.getAvailableFrames(), 0));
+  if (!config_.maxBacklogFrames || (available <= config_.maxBacklogFrames)) return;
+
+  // skipped frames still count toward the times of the results.
+  size_t toSkip = available - config_.maxBacklogFrames;
+  while (toSkip)
+  {
+    const size_t frames =
+        signal_.read(readBuffer_.data(), std::min(toSkip, size_t(kFloatsPerDSPVector))) /
+        channels;
+    if (!frames) break;
+    toSkip -= frames;
+    skippedFrames_ += frames;
+    samplesRead_ += frames;
+  }
+}
+
+size_t PitchOnsetAnalyzer::analyze(size_t maxAnalyses)
+{
+  const size_t channels = signal_.getNumChannels();
+  if (config_.channel >= channels) return 0;
+
+  skipBacklog();
+
+  // read no further than the next hop, so that no frames are lost when the budget runs out.
+  const size_t size = config_.frameSize;
+  size_t analyses{0};
+  while (analyses < maxAnalyses)
+  {
+    const size_t request = std::min(samplesToHop_, size_t(kFloatsPerDSPVector));
+    const size_t frames = signal_.read(readBuffer_.data(), request) / channels;
+    if (!frames) break;
+    for (size_t i = 0; i < frames; ++i)
+    {
+      history_[historyIndex_] = readBuffer_[i * channels + config_.channel];
+      historyIndex_ = (historyIndex_ + 1) & (size - 1);
+    }
+    samplesRead_ += frames;
+    samplesToHop_ -= frames;
+    if (samplesToHop_ == 0)
+    {
+      runDetectors();
+      samplesToHop_ = config_.hopSize;
+      analyses++;
+    }
+  }
+  return analyses;
+}
+
+void PitchOnsetAnalyzer::runDetectors()
+{
+  const size_t size = config_.frameSize;
+  for (size_t i = 0; i < size; ++i)
+  {
+    frame_[i] = history_[(historyIndex_ + i) & (size - 1)];
+  }
+  const float time = float(samplesRead_) / sampleRate_;
+
+  auto publish = [&](Message m) {
+    if (!messages_.push(std::move(m))) droppedMessages_++;
+  };
+
+  if (pitch_)
+  {
+    const PitchEstimate e = (*pitch_)(frame_.data());
+    if ((e.frequency > 0.f) && (e.clarity >= config_.minClarity))
+    {
+      publish(Message("pitch", Value{e.frequency, e.clarity, time}));
+    }
+  }
+
+  // an onset is found one hop after the frame it belongs to.
+  if (onsets_)
+  {
+    const float strength = (*onsets_)(frame_.data());
+    if (strength > 0.f)
+    {
+      const float onsetTime = float(samplesRead_ - config_.hopSize) / sampleRate_;
+      publish(Message("onset", Value{strength, onsetTime}));
+    }
+  }
+}
+
+// ----------------------------------------------------------------
+// AnalysisThread
+
+AnalysisThread::~AnalysisThread() { stop(); }
+
+void AnalysisThread::start(int intervalMs)
+{
+  if (thread_.joinable()) return;
+  stopRequested_ = false;
+  auto interval = std::chrono::milliseconds(std::max(intervalMs, 1));
+  thread_ = std::thread(
+      [this, interval]()
+      {
+        std::unique_lock<std::mutex> lock(threadMutex_);
+        while (!stopRequested_)
+        {
+          runOnce();
+          threadCondition_.wait_for(lock, interval, [this]() { return stopRequested_; });
+        }
+      });
+}
+
+void AnalysisThread::stop()
+{
+  if (!thread_.joinable()) return;
+  {
+    std::lock_guard<std::mutex> lock(threadMutex_);
+    stopRequested_ = true;
+  }
+  threadCondition_.notify_one();
+  thread_.join();
+}
+
+size_t AnalysisThread::runOnce()
+{
+  // one analysis at a time from each analyzer in turn, continuing from where the last interval
+  // stopped, until the budget is spent or none has a full hop waiting.
+  const size_t n = analyzers_.size();
+  size_t made{0};
+  size_t idle{0};
+  while ((made < budget_) && (idle < n))
+  {
+    const size_t r = analyzers_[next_]->analyze(1);
+    next_ = (next_ + 1) % n;
+    made += r;
+    idle = r ? 0 : idle + 1;
+  }
+  return made;
+}
+
+}  // namespace ml
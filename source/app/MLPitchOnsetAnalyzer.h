@@ -0,0 +1,219 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// Pitch and onset detection for tuners and audio-to-MIDI.
+//
+// PitchDetector estimates the pitch of a frame with the YIN method. Its difference function is
+// made from an autocorrelation computed with one FFT and its inverse, in O(N log N) instead of
+// the O(N^2) of summing each lag. OnsetDetector finds onsets from the spectral flux: the rise
+// of the log magnitude spectrum from one frame to the next, picked where it peaks above the
+// recent average. Both cost the same for every frame, so they can also be run inline.
+//
+// PitchOnsetAnalyzer runs the detectors on one channel of a PublishedSignal, every hopSize
+// frames, and pushes the results as Messages to a queue for the application to pop:
+// - "pitch" with the values {frequency in Hz, clarity from 0 to 1, time in seconds}, for
+//   frames with a pitch as clear as minClarity.
+// - "onset" with the values {strength, time in seconds}.
+// Times are those of the end of the analyzed frame, from the first frame read.
+//
+// AnalysisThread runs many analyzers on one background thread, sharing a budget of frames
+// analyzed per interval. Analyzers that fall behind more than maxBacklogFrames skip to the
+// newest frames, so that many detectors stay inside a fixed CPU budget and their results stay
+// current. As with SpectrumAnalyzer, an analyzer must be its signal's only reader, and the
+// signal must stream with one voice.
+
+#pragma once
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "MLMessage.h"
+#include "MLQueue.h"
+#include "MLSignalProcessor.h"
+#include "ffft/FFTReal.h"
+
+namespace ml
+{
+struct PitchEstimate
+{
+  // 0 if no pitch was found.
+  float frequency{0.f};
+
+  // 1 minus the normalized difference at the pitch period: 1 for a perfectly periodic frame.
+  float clarity{0.f};
+};
+
+class PitchDetector
+{
+ public:
+  // frameSize is rounded up to a power of two. Periods up to half the frame can be found.
+  PitchDetector(size_t frameSize, float sampleRate, float minFrequency = 50.f,
+                float maxFrequency = 2000.f, float threshold = 0.15f);
+
+  size_t getFrameSize() const { return size_; }
+
+  // estimate the pitch of frameSize samples.
+  PitchEstimate operator()(const float* pFrame);
+
+ private:
+  size_t size_;
+  float sampleRate_;
+  size_t minPeriod_;
+  size_t maxPeriod_;
+  float threshold_;
+
+  ffft::FFTReal<float> fft_;
+  std::vector<float> input_;
+  std::vector<float> frameSpectrum_;
+  std::vector<float> windowSpectrum_;
+  std::vector<float> correlation_;
+  std::vector<float> difference_;
+};
+
+class OnsetDetector
+{
+ public:
+  // frameSize is rounded up to a power of two. An onset is found where the flux, summed over
+  // the bins, peaks more than threshold above 1.5 times its average over averageFrames frames.
+  explicit OnsetDetector(size_t frameSize, float threshold = 1.f, size_t averageFrames = 8);
+
+  size_t getFrameSize() const { return size_; }
+
+  // take the next frame. Returns the strength of an onset at the previous frame, or 0 if there
+  // was none: a peak in the flux can only be seen one frame later.
+  float operator()(const float* pFrame);
+
+  // the flux of the last frame.
+  float getFlux() const { return flux_[0]; }
+
+  // don't find onsets less than this many frames apart.
+  void setMinInterval(size_t frames) { minInterval_ = frames; }
+
+  void clear();
+
+ private:
+  size_t size_;
+  float threshold_;
+  size_t minInterval_{1};
+  size_t sinceOnset_{0};
+
+  ffft::FFTReal<float> fft_;
+  std::vector<float> window_;
+  std::vector<float> input_;
+  std::vector<float> spectrum_;
+  std::vector<float> logMagnitudes_;
+
+  // the last three fluxes, newest first, and the history for the average.
+  float flux_[3]{};
+  std::vector<float> history_;
+  size_t historyIndex_{0};
+  size_t frames_{0};
+};
+
+struct PitchOnsetAnalyzerConfig
+{
+  // frames per analysis, a power of two, and frames between analyses.
+  size_t frameSize{2048};
+  size_t hopSize{512};
+
+  bool detectPitch{true};
+  float minFrequency{50.f};
+  float maxFrequency{2000.f};
+  float pitchThreshold{0.15f};
+  float minClarity{0.9f};
+
+  bool detectOnsets{true};
+  float onsetThreshold{1.f};
+
+  // the channel of the signal to analyze.
+  size_t channel{0};
+
+  // when more frames than this are waiting, skip the oldest. 0 never skips.
+  size_t maxBacklogFrames{0};
+
+  size_t queueSize{256};
+};
+
+class PitchOnsetAnalyzer
+{
+ public:
+  // the signal must outlive the analyzer. sampleRate is that of the frames in the signal.
+  PitchOnsetAnalyzer(SignalProcessor::PublishedSignal& signal, float sampleRate,
+                     const PitchOnsetAnalyzerConfig& config = PitchOnsetAnalyzerConfig());
+
+  PitchOnsetAnalyzer(const PitchOnsetAnalyzer&) = delete;
+  PitchOnsetAnalyzer& operator=(const PitchOnsetAnalyzer&) = delete;
+
+  // read frames from the signal and analyze them, making at most maxAnalyses analyses.
+  // Returns the number made.
+  size_t analyze(size_t maxAnalyses = ~size_t(0));
+
+  // for the application thread: pop the next result, returning false if there is none.
+  bool popMessage(Message& m) { return messages_.pop(m); }
+
+  const PitchOnsetAnalyzerConfig& getConfig() const { return config_; }
+
+  // the number of frames skipped to keep up, and of results dropped because the queue was full.
+  size_t getSkippedFrames() const { return skippedFrames_; }
+  size_t getDroppedMessages() const { return droppedMessages_; }
+
+ private:
+  void skipBacklog();
+  void runDetectors();
+
+  SignalProcessor::PublishedSignal& signal_;
+  float sampleRate_;
+  PitchOnsetAnalyzerConfig config_;
+
+  std::unique_ptr<PitchDetector> pitch_;
+  std::unique_ptr<OnsetDetector> onsets_;
+
+  // the last frameSize samples, as a ring, and the same unwrapped for the detectors.
+  std::vector<float> history_;
+  std::vector<float> frame_;
+  size_t historyIndex_{0};
+  size_t samplesToHop_{0};
+  size_t samplesRead_{0};
+
+  std::vector<float> readBuffer_;
+  Queue<Message> messages_;
+  size_t skippedFrames_{0};
+  size_t droppedMessages_{0};
+};
+
+class AnalysisThread
+{
+ public:
+  // each interval, the analyzers share a budget of analyses, taken one at a time in turn.
+  explicit AnalysisThread(size_t analysesPerInterval = 64) : budget_(analysesPerInterval) {}
+  ~AnalysisThread();
+
+  AnalysisThread(const AnalysisThread&) = delete;
+  AnalysisThread& operator=(const AnalysisThread&) = delete;
+
+  // add an analyzer, which must outlive the thread, while the thread is stopped.
+  void add(PitchOnsetAnalyzer* pAnalyzer) { analyzers_.push_back(pAnalyzer); }
+
+  void start(int intervalMs = 10);
+  void stop();
+
+  // share the budget among the analyzers once. This is what the thread does each interval.
+  // Returns the number of analyses made.
+  size_t runOnce();
+
+ private:
+  std::vector<PitchOnsetAnalyzer*> analyzers_;
+  size_t budget_;
+  size_t next_{0};
+
+  std::thread thread_;
+  std::mutex threadMutex_;
+  std::condition_variable threadCondition_;
+  bool stopRequested_{false};
+};
+
+}  // namespace ml
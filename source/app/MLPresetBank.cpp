@@ -0,0 +1,387 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLPresetBank.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace ml
+{
+namespace
+{
+constexpr char kBundleMagic[4]{'M', 'L', 'P', 'B'};
+constexpr uint32_t kBundleVersion{1};
+
+struct BundleSection
+{
+  uint64_t offset;
+  uint64_t size;
+};
+
+struct BundleHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t presetCount;
+  uint32_t tagCount;
+  BundleSection entries;
+  BundleSection tags;
+  BundleSection bits;
+  BundleSection text;
+  BundleSection data;
+};
+
+size_t alignTo8(size_t n) { return (n + 7) & ~size_t(7); }
+
+// whether [offset, offset + size) lies within [0, total).
+bool isInside(uint64_t offset, uint64_t size, uint64_t total)
+{
+  return (offset <= total) && (size <= total - offset);
+}
+
+// the file name of a path, without its directory or extension.
+std::string getPresetName(const std::string& path)
+{
+  size_t start = path.find_last_of("/\\");
+  start = (start == std::string::npos) ? 0 : start + 1;
+  size_t end = path.find_last_of('.');
+  if ((end == std::string::npos) || (end <= start)) end = path.size();
+  return path.substr(start, end - start);
+}
+}  // namespace
+
+size_t PresetBank::load(const std::vector<std::string>& paths, WorkerPool& pool)
+{
+  presets_.clear();
+  presets_.resize(paths.size());
+  for (size_t i = 0; i < paths.size(); ++i)
+  {
+    presets_[i].path = paths[i];
+  }
+
+  // each task writes only its own preset.
+  pool.run(presets_.size(), loadPreset, this);
+
+  buildIndex();
+  size_t loaded{0};
+  for (const auto& p : presets_)
+  {
+    loaded += p.loaded;
+  }
+  return loaded;
+}
+
+void PresetBank::loadPreset(void* context, size_t i)
+{
+  Preset& preset = static_cast<PresetBank*>(context)->presets_[i];
+  MappedFile file;
+  if (!file.open(preset.path.c_str())) return;
+  preset.tree = bytesToValueTree(file.data(), file.size());
+  preset.loaded = (preset.tree.begin() != preset.tree.end());
+}
+
+void PresetBank::buildIndex()
+{
+  index_.clear();
+  for (size_t i = 0; i < presets_.size(); ++i)
+  {
+    const Tree<Value>* metadata = presets_[i].tree.getNode(metadataPrefix_);
+    if (!metadata) continue;
+    metadata->visitValues(
+        [&](const Path& field, const Value& v)
+        {
+          if (v.getType() != Value::kText) return;
+          auto& presets = index_[field][v.getTextValue().getText()];
+          presets.push_back(uint32_t(i));
+        });
+  }
+}
+
+std::vector<TextFragment> PresetBank::getMetadataValues(Path field) const
+{
+  std::vector<TextFragment> values;
+  for (const auto& entry : index_[field])
+  {
+    values.emplace_back(entry.first.c_str());
+  }
+  return values;
+}
+
+std::vector<uint32_t> PresetBank::findPresets(Path field, const TextFragment& value) const
+{
+  const FieldIndex& fieldIndex = index_[field];
+  auto it = fieldIndex.find(value.getText());
+  return (it != fieldIndex.end()) ? it->second : std::vector<uint32_t>();
+}
+
+// PresetBundle
+
+bool PresetBundle::write(const char* path, const PresetBank& bank)
+{
+  struct Item
+  {
+    std::string name;
+    std::vector<uint8_t> data;
+    std::vector<std::string> tags;
+  };
+  std::vector<Item> items;
+  std::map<std::string, size_t> tagIndex;
+  for (size_t i = 0; i < bank.size(); ++i)
+  {
+    if (!bank.isLoaded(i)) continue;
+    Item item;
+    item.name = getPresetName(bank.getPath(i));
+    valueTreeToBinary(bank.getPreset(i), item.data);
+    if (const auto* metadata = bank.getPreset(i).getNode(bank.getMetadataPrefix()))
+    {
+      metadata->visitValues(
+          [&](const Path& field, const Value& v)
+          {
+            if (v.getType() != Value::kText) return;
+            std::string tag{field.toText().getText()};
+            tag += "/";
+            tag += v.getTextValue().getText();
+            tagIndex.emplace(tag, 0);
+            item.tags.push_back(tag);
+          });
+    }
+    items.push_back(std::move(item));
+  }
+  std::stable_sort(items.begin(), items.end(),
+                   [](const Item& a, const Item& b) { return a.name < b.name; });
+
+  // number the tags in sorted order, and gather the text.
+  std::string text;
+  std::vector<TextRef> tagRefs;
+  for (auto& t : tagIndex)
+  {
+    t.second = tagRefs.size();
+    tagRefs.push_back(TextRef{uint32_t(text.size()), uint32_t(t.first.size())});
+    text += t.first;
+  }
+  const size_t tagWords = (tagRefs.size() + 63) / 64;
+  std::vector<Entry> entries;
+  std::vector<uint64_t> bits(items.size() * tagWords);
+  uint64_t dataSize{0};
+  for (size_t i = 0; i < items.size(); ++i)
+  {
+    const Item& item = items[i];
+    entries.push_back(Entry{dataSize, item.data.size(),
+                            TextRef{uint32_t(text.size()), uint32_t(item.name.size())}});
+    text += item.name;
+    dataSize += alignTo8(item.data.size());
+    for (const auto& tag : item.tags)
+    {
+      size_t t = tagIndex[tag];
+      bits[i * tagWords + t / 64] |= uint64_t(1) << (t % 64);
+    }
+  }
+
+  BundleHeader header{};
+  memcpy(header.magic, kBundleMagic, sizeof(kBundleMagic));
+  header.version = kBundleVersion;
+  header.presetCount = uint32_t(items.size());
+  header.tagCount = uint32_t(tagRefs.size());
+  uint64_t offset = alignTo8(sizeof(BundleHeader));
+  auto place = [&](BundleSection& section, uint64_t size)
+  {
+    section = BundleSection{offset, size};
+    offset += alignTo8(size);
+  };
+  place(header.entries, entries.size() * sizeof(Entry));
+  place(header.tags, tagRefs.size() * sizeof(TextRef));
+  place(header.bits, bits.size() * sizeof(uint64_t));
+  place(header.text, text.size());
+  place(header.data, dataSize);
+
+  std::ofstream out(path, std::ios::binary);
+  if (!out) return false;
+  auto writePadded = [&](const void* p, size_t size)
+  {
+    static const char zeros[8]{};
+    out.write(static_cast<const char*>(p), size);
+    out.write(zeros, alignTo8(size) - size);
+  };
+  writePadded(&header, sizeof(header));
+  writePadded(entries.data(), entries.size() * sizeof(Entry));
+  writePadded(tagRefs.data(), tagRefs.size() * sizeof(TextRef));
+  writePadded(bits.data(), bits.size() * sizeof(uint64_t));
+  writePadded(text.data(), text.size());
+  for (const auto& item : items)
+  {
+    writePadded(item.data.data(), item.data.size());
+  }
+  return bool(out);
+}
+
+bool PresetBundle::open(const char* path)
+{
+  close();
+  if (!file_.open(path) || (file_.size() < sizeof(BundleHeader))) return false;
+  const uint8_t* data = file_.data();
+  const uint64_t size = file_.size();
+
+  BundleHeader header;
+  memcpy(&header, data, sizeof(header));
+  const uint64_t tagWords = (uint64_t(header.tagCount) + 63) / 64;
+  bool ok = !memcmp(header.magic, kBundleMagic, sizeof(kBundleMagic)) &&
+            (header.version == kBundleVersion) &&
+            (header.entries.size == uint64_t(header.presetCount) * sizeof(Entry)) &&
+            (header.tags.size == uint64_t(header.tagCount) * sizeof(TextRef)) &&
+            (header.bits.size == uint64_t(header.presetCount) * tagWords * sizeof(uint64_t));
+  for (const auto& section : {header.entries, header.tags, header.bits, header.text, header.data})
+  {
+    ok = ok && isInside(section.offset, section.size, size) && !(section.offset & 7);
+  }
+  if (!ok)
+  {
+    close();
+    return false;
+  }
+
+  nPresets_ = header.presetCount;
+  nTags_ = header.tagCount;
+  entries_ = data + header.entries.offset;
+  tags_ = data + header.tags.offset;
+  bits_ = data + header.bits.offset;
+  text_ = reinterpret_cast<const char*>(data + header.text.offset);
+  textSize_ = header.text.size;
+
+  // check every name and preset, so that the accessors can't read outside the file. Entry
+  // data offsets are from the start of the data.
+  for (size_t i = 0; ok && (i < nPresets_); ++i)
+  {
+    Entry e = getEntry(i);
+    ok = isInside(e.name.offset, e.name.length, textSize_) &&
+         isInside(e.dataOffset, e.dataSize, header.data.size);
+  }
+  for (size_t t = 0; ok && (t < nTags_); ++t)
+  {
+    TextRef ref;
+    memcpy(&ref, tags_ + t * sizeof(TextRef), sizeof(ref));
+    ok = isInside(ref.offset, ref.length, textSize_);
+  }
+  if (!ok)
+  {
+    close();
+    return false;
+  }
+  data_ = data + header.data.offset;
+  return true;
+}
+
+void PresetBundle::close()
+{
+  file_.close();
+  nPresets_ = nTags_ = textSize_ = 0;
+  entries_ = tags_ = bits_ = data_ = nullptr;
+  text_ = nullptr;
+}
+
+PresetBundle::Entry PresetBundle::getEntry(size_t i) const
+{
+  Entry e;
+  memcpy(&e, entries_ + i * sizeof(Entry), sizeof(e));
+  return e;
+}
+
+std::string_view PresetBundle::getText(const TextRef& ref) const
+{
+  return std::string_view(text_ + ref.offset, ref.length);
+}
+
+std::string_view PresetBundle::getName(size_t i) const
+{
+  return (i < nPresets_) ? getText(getEntry(i).name) : std::string_view();
+}
+
+size_t PresetBundle::find(std::string_view name) const
+{
+  size_t lo = 0, hi = nPresets_;
+  while (lo < hi)
+  {
+    size_t mid = lo + (hi - lo) / 2;
+    if (getName(mid) < name)
+    {
+      lo = mid + 1;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+  return ((lo < nPresets_) && (getName(lo) == name)) ? lo : kNotFound;
+}
+
+std::string_view PresetBundle::getTagName(size_t tag) const
+{
+  if (tag >= nTags_) return std::string_view();
+  TextRef ref;
+  memcpy(&ref, tags_ + tag * sizeof(TextRef), sizeof(ref));
+  return getText(ref);
+}
+
+size_t PresetBundle::findTag(std::string_view name) const
+{
+  size_t lo = 0, hi = nTags_;
+  while (lo < hi)
+  {
+    size_t mid = lo + (hi - lo) / 2;
+    if (getTagName(mid) < name)
+    {
+      lo = mid + 1;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+  return ((lo < nTags_) && (getTagName(lo) == name)) ? lo : kNotFound;
+}
+
+bool PresetBundle::hasTag(size_t i, size_t tag) const
+{
+  if ((i >= nPresets_) || (tag >= nTags_)) return false;
+  uint64_t word;
+  memcpy(&word, bits_ + (i * getTagWords() + tag / 64) * sizeof(uint64_t), sizeof(word));
+  return (word >> (tag % 64)) & 1;
+}
+
+std::vector<std::string_view> PresetBundle::getTags(size_t i) const
+{
+  std::vector<std::string_view> tags;
+  for (size_t t = 0; t < nTags_; ++t)
+  {
+    if (hasTag(i, t)) tags.push_back(getTagName(t));
+  }
+  return tags;
+}
+
+std::vector<size_t> PresetBundle::findPresetsWithTag(size_t tag) const
+{
+  std::vector<size_t> presets;
+  for (size_t i = 0; i < nPresets_; ++i)
+  {
+    if (hasTag(i, tag)) presets.push_back(i);
+  }
+  return presets;
+}
+
+Tree<Value> PresetBundle::loadPreset(size_t i) const
+{
+  if (i >= nPresets_) return Tree<Value>();
+  Entry e = getEntry(i);
+  return binaryToValueTree(data_ + e.dataOffset, e.dataSize);
+}
+
+BinaryTreeView PresetBundle::viewPreset(size_t i) const
+{
+  if (i >= nPresets_) return BinaryTreeView(nullptr, 0);
+  Entry e = getEntry(i);
+  return BinaryTreeView(data_ + e.dataOffset, e.dataSize);
+}
+
+}  // namespace ml
@@ -0,0 +1,164 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// PresetBank: a bank of presets read from many files at once, with an index of their metadata
+// for browsing.
+//
+// load() maps each file into memory and parses it into its own Tree<Value> on the threads of a
+// WorkerPool, one file per task, as JSON or binary as bytesToValueTree() finds. The presets
+// share nothing while parsing but the SymbolTable, which any number of threads can add to at
+// once. The metadata of each preset, the text values below a prefix path, is then merged into
+// an index from each metadata field and value to the presets that have it.
+//
+// PresetBundle: a whole bank in one file, for libraries too big to load at startup. The file
+// starts with an index: the preset names in sorted order, a table of tags and a bitset of the
+// tags of each preset, followed by the binary form of each preset from valueTreeToBinary().
+// Opening a bundle maps the file and checks the index, but reads no presets, so the time to
+// open one and the memory it uses don't grow with the number of presets. A preset is read only
+// when asked for, either into a Tree<Value> or through a BinaryTreeView of the mapped bytes.
+//
+// A bundle is written from a loaded PresetBank. Each preset is named after its file, without
+// the directory or extension. Its tags are its text metadata values, as "field/value", such as
+// "category/bass".
+//
+// The file is, in the byte order of the machine that wrote it, with each part aligned to 8:
+//   header:  "MLPB", version, presets, tags (uint32), then the offset and size (uint64) of
+//            the entries, tag table, tag bits, text and preset data
+//   entries: for each preset in name order, its data offset and size (uint64) and the offset
+//            and length (uint32) of its name in the text
+//   tags:    the offset and length (uint32) of each tag's name in the text, in sorted order
+//   bits:    for each preset, a bitset of its tags in (tags + 63) / 64 uint64s
+//   text:    the names of the presets and tags
+//   data:    the presets
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "MLPath.h"
+#include "MLSampleStream.h"
+#include "MLSerialization.h"
+#include "MLText.h"
+#include "MLTree.h"
+#include "MLValue.h"
+#include "MLWorkerPool.h"
+
+namespace ml
+{
+class PresetBank
+{
+ public:
+  explicit PresetBank(Path metadataPrefix = Path("meta")) : metadataPrefix_(metadataPrefix) {}
+  ~PresetBank() = default;
+
+  // replace the bank with the presets in the files, in the same order, and return the number
+  // read. A file that can't be read or parsed has an empty preset. Only one thread at a time
+  // may use the pool.
+  size_t load(const std::vector<std::string>& paths, WorkerPool& pool);
+
+  size_t size() const { return presets_.size(); }
+  Path getMetadataPrefix() const { return metadataPrefix_; }
+  const std::string& getPath(size_t i) const { return presets_[i].path; }
+  const Tree<Value>& getPreset(size_t i) const { return presets_[i].tree; }
+  bool isLoaded(size_t i) const { return presets_[i].loaded; }
+
+  // the different text values of a metadata field, such as "category" for the values at
+  // "meta/category", in sorted order.
+  std::vector<TextFragment> getMetadataValues(Path field) const;
+
+  // the indices of the presets with a metadata field set to the text value, in order.
+  std::vector<uint32_t> findPresets(Path field, const TextFragment& value) const;
+
+ private:
+  struct Preset
+  {
+    std::string path;
+    Tree<Value> tree;
+    bool loaded{false};
+  };
+
+  // from each text value of a field to the presets with it.
+  using FieldIndex = std::map<std::string, std::vector<uint32_t> >;
+
+  static void loadPreset(void* context, size_t i);
+  void buildIndex();
+
+  Path metadataPrefix_;
+  std::vector<Preset> presets_;
+  Tree<FieldIndex> index_;
+};
+
+class PresetBundle
+{
+ public:
+  static constexpr size_t kNotFound{~size_t(0)};
+
+  PresetBundle() = default;
+  ~PresetBundle() = default;
+
+  PresetBundle(const PresetBundle&) = delete;
+  PresetBundle& operator=(const PresetBundle&) = delete;
+
+  // write the loaded presets of the bank to a bundle file. Returns false if it can't be written.
+  static bool write(const char* path, const PresetBank& bank);
+
+  // map a bundle file. Returns false, leaving the bundle empty, if the file can't be read or
+  // is not a valid bundle.
+  bool open(const char* path);
+  void close();
+
+  size_t size() const { return nPresets_; }
+  std::string_view getName(size_t i) const;
+
+  // the index of the first preset with the name, or kNotFound. A binary search.
+  size_t find(std::string_view name) const;
+
+  size_t getNumTags() const { return nTags_; }
+  std::string_view getTagName(size_t tag) const;
+  size_t findTag(std::string_view name) const;
+  bool hasTag(size_t i, size_t tag) const;
+  std::vector<std::string_view> getTags(size_t i) const;
+
+  // the indices of the presets with the tag, in name order.
+  std::vector<size_t> findPresetsWithTag(size_t tag) const;
+
+  // read a preset into a tree, or view it in place. The view is valid until the bundle is
+  // closed.
+  Tree<Value> loadPreset(size_t i) const;
+  BinaryTreeView viewPreset(size_t i) const;
+
+ private:
+  struct TextRef
+  {
+    uint32_t offset;
+    uint32_t length;
+  };
+
+  struct Entry
+  {
+    uint64_t dataOffset;
+    uint64_t dataSize;
+    TextRef name;
+  };
+
+  Entry getEntry(size_t i) const;
+  std::string_view getText(const TextRef& ref) const;
+  size_t getTagWords() const { return (nTags_ + 63) / 64; }
+
+  MappedFile file_;
+  size_t nPresets_{0};
+  size_t nTags_{0};
+  const uint8_t* entries_{nullptr};
+  const uint8_t* tags_{nullptr};
+  const uint8_t* bits_{nullptr};
+  const uint8_t* data_{nullptr};
+  const char* text_{nullptr};
+  size_t textSize_{0};
+};
+
+}  // namespace ml
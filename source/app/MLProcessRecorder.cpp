@@ -0,0 +1,431 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLProcessRecorder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+
+#include "MLDSPDenormals.h"
+
+namespace ml
+{
+namespace
+{
+// the largest time, event or parameter record.
+constexpr size_t kMaxRecordBytes{1 + 8 + 8 + 1 + 8};
+constexpr size_t kBlockRecordBytes{1 + 4};
+constexpr size_t kHeaderBytes{4 + 4 + 4 + 4 + 8 + 4};
+
+// read a value from the log, returning false if it runs past the end.
+template <typename T>
+bool get(const uint8_t*& p, const uint8_t* end, T& value)
+{
+  if (size_t(end - p) < sizeof(T)) return false;
+  memcpy(&value, p, sizeof(T));
+  p += sizeof(T);
+  return true;
+}
+}  // namespace
+
+// ProcessRecorder
+
+ProcessRecorder::ProcessRecorder(size_t nInputs, size_t nOutputs, double sampleRate,
+                                 size_t maxFrames, bool recordInputAudio, size_t queueBytes)
+    : nInputs_(nInputs),
+      nOutputs_(nOutputs),
+      sampleRate_(sampleRate),
+      maxFrames_(maxFrames),
+      recordInputAudio_(recordInputAudio),
+      queue_(queueBytes)
+{
+  size_t blockBytes = kBlockRecordBytes;
+  if (recordInputAudio_) blockBytes += nInputs_ * maxFrames_ * sizeof(float);
+  staging_.resize(kMaxRecordsPerBlock * kMaxRecordBytes + blockBytes);
+  drainBuffer_.resize(64 * 1024);
+}
+
+ProcessRecorder::~ProcessRecorder() { stop(); }
+
+bool ProcessRecorder::start(const char* path, int intervalMs)
+{
+  if (file_) return false;
+  file_ = fopen(path, "wb");
+  if (!file_) return false;
+
+  std::vector<uint8_t> header(kHeaderBytes);
+  uint8_t* p = header.data();
+  auto write = [&](const auto& value)
+  {
+    memcpy(p, &value, sizeof(value));
+    p += sizeof(value);
+  };
+  write(processLog::kMagic);
+  write(processLog::kVersion);
+  write(uint32_t(nInputs_));
+  write(uint32_t(nOutputs_));
+  write(sampleRate_);
+  write(recordInputAudio_ ? processLog::kHasInputAudio : uint32_t(0));
+  fwrite(header.data(), 1, header.size(), file_);
+
+  stopRequested_ = false;
+  auto interval = std::chrono::milliseconds(std::max(intervalMs, 1));
+  thread_ = std::thread(
+      [this, interval]()
+      {
+        std::unique_lock<std::mutex> lock(threadMutex_);
+        while (!stopRequested_)
+        {
+          drain();
+          threadCondition_.wait_for(lock, interval, [this]() { return stopRequested_; });
+        }
+      });
+  return true;
+}
+
+void ProcessRecorder::stop()
+{
+  if (thread_.joinable())
+  {
+    {
+      std::lock_guard<std::mutex> lock(threadMutex_);
+      stopRequested_ = true;
+    }
+    threadCondition_.notify_one();
+    thread_.join();
+  }
+  if (file_)
+  {
+    drain();
+    fclose(file_);
+    file_ = nullptr;
+  }
+}
+
+size_t ProcessRecorder::drain()
+{
+  if (!file_) return 0;
+  size_t written{0};
+  while (size_t n = queue_.popN(drainBuffer_.data(), drainBuffer_.size()))
+  {
+    written += fwrite(drainBuffer_.data(), 1, n, file_);
+  }
+  fflush(file_);
+  return written;
+}
+
+template <typename T>
+void ProcessRecorder::put(const T& value)
+{
+  memcpy(staging_.data() + stagingBytes_, &value, sizeof(T));
+  stagingBytes_ += sizeof(T);
+}
+
+bool ProcessRecorder::reserve(size_t bytes)
+{
+  if (stagingBytes_ + bytes > staging_.size())
+  {
+    stagingOverflowed_ = true;
+  }
+  return !stagingOverflowed_;
+}
+
+void ProcessRecorder::recordTime(double ppqPos, double bpm, bool isPlaying, double sampleRate)
+{
+  if (!reserve(kMaxRecordBytes)) return;
+  put(processLog::kTime);
+  put(ppqPos);
+  put(bpm);
+  put(uint8_t(isPlaying));
+  put(sampleRate);
+}
+
+void ProcessRecorder::recordEvent(const Event& e)
+{
+  if (!reserve(kMaxRecordBytes)) return;
+  put(processLog::kEvent);
+  put(e.type);
+  put(e.channel);
+  put(e.sourceIdx);
+  put(int32_t(e.time));
+  put(e.value1);
+  put(e.value2);
+}
+
+void ProcessRecorder::recordEvents(const Event* events, size_t n)
+{
+  for (size_t i = 0; i < n; ++i)
+  {
+    recordEvent(events[i]);
+  }
+}
+
+void ProcessRecorder::recordParam(int time, uint32_t id, float value)
+{
+  if (!reserve(kMaxRecordBytes)) return;
+  put(processLog::kParam);
+  put(int32_t(time));
+  put(id);
+  put(value);
+}
+
+void ProcessRecorder::recordBlock(const float* const* inputs, size_t frames)
+{
+  bool ok = (frames <= maxFrames_) && reserve(kBlockRecordBytes);
+  if (ok)
+  {
+    put(processLog::kBlock);
+    put(uint32_t(frames));
+    if (recordInputAudio_)
+    {
+      // reserved by the constructor. Missing inputs are recorded as silence.
+      for (size_t c = 0; c < nInputs_; ++c)
+      {
+        uint8_t* pDest = staging_.data() + stagingBytes_;
+        const size_t bytes = frames * sizeof(float);
+        if (inputs && inputs[c])
+        {
+          memcpy(pDest, inputs[c], bytes);
+        }
+        else
+        {
+          memset(pDest, 0, bytes);
+        }
+        stagingBytes_ += bytes;
+      }
+    }
+
+    // queue the whole block or none of it.
+    const size_t free = queue_.size() - 1 - queue_.elementsAvailable();
+    ok = (stagingBytes_ <= free) && (queue_.pushN(staging_.data(), stagingBytes_) == stagingBytes_);
+  }
+
+  if (ok)
+  {
+    recordedBlocks_.fetch_add(1, std::memory_order_relaxed);
+  }
+  else
+  {
+    droppedBlocks_.fetch_add(1, std::memory_order_relaxed);
+  }
+  stagingBytes_ = 0;
+  stagingOverflowed_ = false;
+}
+
+// ProcessReplayer
+
+bool ProcessReplayer::open(const char* path)
+{
+  *this = ProcessReplayer();
+  std::ifstream file(path, std::ios::binary);
+  if (!file) return false;
+  std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)),
+                             std::istreambuf_iterator<char>());
+
+  const uint8_t* p = bytes.data();
+  const uint8_t* end = p + bytes.size();
+  char magic[4];
+  uint32_t version, nInputs, nOutputs, flags;
+  double sampleRate;
+  if (!(get(p, end, magic) && get(p, end, version) && get(p, end, nInputs) &&
+        get(p, end, nOutputs) && get(p, end, sampleRate) && get(p, end, flags)))
+  {
+    return false;
+  }
+  if (memcmp(magic, processLog::kMagic, 4) || (version != processLog::kVersion)) return false;
+  const bool hasInputAudio = flags & processLog::kHasInputAudio;
+
+  // check the records and count the blocks. A log cut off by a crash ends at the last
+  // complete block.
+  const size_t recordsStart = p - bytes.data();
+  size_t blocksEnd = recordsStart;
+  size_t nBlocks{0}, maxBlockFrames{0};
+  uint64_t totalFrames{0};
+  for (bool ok = true; ok && (p < end);)
+  {
+    uint8_t type{0};
+    get(p, end, type);
+    switch (type)
+    {
+      case processLog::kTime:
+        ok = (size_t(end - p) >= 8 + 8 + 1 + 8);
+        p += ok ? 8 + 8 + 1 + 8 : 0;
+        break;
+      case processLog::kEvent:
+        ok = (size_t(end - p) >= 1 + 1 + 2 + 4 + 4 + 4);
+        p += ok ? 1 + 1 + 2 + 4 + 4 + 4 : 0;
+        break;
+      case processLog::kParam:
+        ok = (size_t(end - p) >= 4 + 4 + 4);
+        p += ok ? 4 + 4 + 4 : 0;
+        break;
+      case processLog::kBlock:
+      {
+        uint32_t frames{0};
+        ok = get(p, end, frames);
+        const size_t audioBytes = hasInputAudio ? size_t(nInputs) * frames * sizeof(float) : 0;
+        ok = ok && (size_t(end - p) >= audioBytes);
+        if (ok)
+        {
+          p += audioBytes;
+          blocksEnd = p - bytes.data();
+          nBlocks++;
+          totalFrames += frames;
+          maxBlockFrames = std::max(maxBlockFrames, size_t(frames));
+        }
+        break;
+      }
+      default:
+        ok = false;
+        break;
+    }
+  }
+
+  bytes.resize(blocksEnd);
+  log_ = std::move(bytes);
+  recordsStart_ = recordsStart;
+  nInputs_ = nInputs;
+  nOutputs_ = nOutputs;
+  sampleRate_ = sampleRate;
+  hasInputAudio_ = hasInputAudio;
+  nBlocks_ = nBlocks;
+  totalFrames_ = totalFrames;
+  maxBlockFrames_ = maxBlockFrames;
+  return true;
+}
+
+bool ProcessReplayer::replay(SignalProcessor& processor, AudioContext& context, float** outputs)
+{
+  if (log_.empty()) return false;
+  if ((context.inputs.size() != nInputs_) || (context.outputs.size() != nOutputs_)) return false;
+
+  UsingFlushDenormalsToZero flushDenormals(kFlushDenormalsAutomatically);
+  SignalProcessBuffer buffer(nInputs_, nOutputs_, std::max(maxBlockFrames_, size_t(1)));
+
+  // inputs that weren't recorded are silent, and outputs that aren't wanted go to scratch.
+  std::vector<float> inputBlock(nInputs_ * maxBlockFrames_);
+  std::vector<const float*> inputPtrs(nInputs_, nullptr);
+  std::vector<float> scratchOutput(maxBlockFrames_);
+  std::vector<float*> outputPtrs(nOutputs_);
+
+  std::vector<Event> events;
+  processor_ = &processor;
+  paramChanges_.clear();
+  uint64_t done{0};
+
+  const uint8_t* p = log_.data() + recordsStart_;
+  const uint8_t* end = log_.data() + log_.size();
+  while (p < end)
+  {
+    uint8_t type{0};
+    get(p, end, type);
+    switch (type)
+    {
+      case processLog::kTime:
+      {
+        double ppqPos, bpm, sampleRate;
+        uint8_t isPlaying;
+        get(p, end, ppqPos);
+        get(p, end, bpm);
+        get(p, end, isPlaying);
+        get(p, end, sampleRate);
+        context.updateTime(ppqPos, bpm, isPlaying, sampleRate);
+        break;
+      }
+      case processLog::kEvent:
+      {
+        Event e;
+        int32_t time;
+        get(p, end, e.type);
+        get(p, end, e.channel);
+        get(p, end, e.sourceIdx);
+        get(p, end, time);
+        get(p, end, e.value1);
+        get(p, end, e.value2);
+        e.time = time;
+        events.push_back(e);
+        break;
+      }
+      case processLog::kParam:
+      {
+        ParamChange change;
+        int32_t time;
+        get(p, end, time);
+        get(p, end, change.id);
+        get(p, end, change.value);
+        change.time = time;
+        paramChanges_.push_back(change);
+        break;
+      }
+      case processLog::kBlock:
+      {
+        uint32_t frames;
+        get(p, end, frames);
+        if (hasInputAudio_)
+        {
+          for (size_t c = 0; c < nInputs_; ++c)
+          {
+            float* pDest = inputBlock.data() + c * maxBlockFrames_;
+            memcpy(pDest, p, frames * sizeof(float));
+            p += frames * sizeof(float);
+            inputPtrs[c] = pDest;
+          }
+        }
+        for (size_t c = 0; c < nOutputs_; ++c)
+        {
+          outputPtrs[c] = (outputs && outputs[c]) ? outputs[c] + done : scratchOutput.data();
+        }
+
+        context.addInputEvents(events.data(), events.size());
+        vectorEnd_ = 0;
+        nextParamChange_ = 0;
+        buffer.process(inputPtrs.data(), outputPtrs.data(), int(frames), &context,
+                       processVectorFn, this);
+
+        // changes after the last vector of a buffered block still apply.
+        applyParamChanges(std::numeric_limits<int>::max());
+        events.clear();
+        paramChanges_.clear();
+        done += frames;
+        break;
+      }
+      default:
+        break;
+    }
+  }
+  processor_ = nullptr;
+  return true;
+}
+
+void ProcessReplayer::processVectorFn(AudioContext* context, void* state)
+{
+  auto* replayer = static_cast<ProcessReplayer*>(state);
+  replayer->vectorEnd_ += kFloatsPerDSPVector;
+  replayer->applyParamChanges(replayer->vectorEnd_);
+  replayer->processor_->updateParamSnapshot();
+  replayer->processor_->processVector(context->inputs, context->outputs, context);
+}
+
+void ProcessReplayer::applyParamChanges(int endTime)
+{
+  const size_t nParams = processor_->getParameterTree().getNumCompiledParameters();
+  bool changed{false};
+  while ((nextParamChange_ < paramChanges_.size()) &&
+         (paramChanges_[nextParamChange_].time < endTime))
+  {
+    const ParamChange& change = paramChanges_[nextParamChange_++];
+    if (change.id < nParams)
+    {
+      processor_->setParamFromAudioThread(change.id, change.value);
+      changed = true;
+    }
+  }
+  if (changed) processor_->publishParams();
+}
+
+}  // namespace ml
@@ -0,0 +1,184 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// Capture and replay of everything that enters a SignalProcessor, for reproducing problems
+// from the field offline.
+//
+// A ProcessRecorder is given the inputs of each block on the audio thread: transport times,
+// input events, parameter changes and, optionally, input audio. It writes them as a compact
+// binary log to a lock-free queue without allocating, and a background thread drains the
+// queue to a file. Each block's records are queued all at once when the block is recorded. If
+// there is no room for them the whole block is dropped and counted.
+//
+// A ProcessReplayer reads a log and feeds it back through a SignalProcessBuffer, block by
+// block with the recorded sizes, applying each parameter change just before the DSPVector
+// that contains it as ClapProcessAdapter does. Given a new processor in the same state and an
+// AudioContext set up the same way, the replayed output matches the recorded session bit for
+// bit, so that a spike can be profiled or debugged at leisure.
+//
+// The log is a header followed by records, each a type byte and its fields, all in the byte
+// order of the machine that made it:
+//   header: "MLPR", version, inputs, outputs (uint32), sample rate (double), flags (uint32)
+//   time:   ppq position, bpm (double), playing (uint8), sample rate (double)
+//   event:  type, channel (uint8), source index (uint16), time (int32), values (float)
+//   param:  time (int32), ID (uint32), real value (float)
+//   block:  frames (uint32), then the planar input frames (float) if they are recorded
+// The records for a block come before its block record.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "MLAudioContext.h"
+#include "MLEvent.h"
+#include "MLQueue.h"
+#include "MLSignalProcessBuffer.h"
+#include "MLSignalProcessor.h"
+
+namespace ml
+{
+namespace processLog
+{
+constexpr char kMagic[4]{'M', 'L', 'P', 'R'};
+constexpr uint32_t kVersion{1};
+constexpr uint32_t kHasInputAudio{1};
+
+enum RecordType : uint8_t
+{
+  kTime = 1,
+  kEvent,
+  kParam,
+  kBlock
+};
+}  // namespace processLog
+
+class ProcessRecorder
+{
+ public:
+  // time, event and parameter records that can be made for one block.
+  static constexpr size_t kMaxRecordsPerBlock{4096};
+  static constexpr size_t kDefaultQueueBytes{4 * 1024 * 1024};
+
+  // make a recorder for blocks of up to maxFrames frames. The queue should hold a few
+  // intervals of the writer thread's worth of blocks.
+  ProcessRecorder(size_t nInputs, size_t nOutputs, double sampleRate, size_t maxFrames,
+                  bool recordInputAudio = false, size_t queueBytes = kDefaultQueueBytes);
+  ~ProcessRecorder();
+
+  ProcessRecorder(const ProcessRecorder&) = delete;
+  ProcessRecorder& operator=(const ProcessRecorder&) = delete;
+
+  // open the log file, write its header and start the writer thread, which drains the queue
+  // to the file every intervalMs milliseconds. Returns false if the file can't be opened.
+  bool start(const char* path, int intervalMs = 10);
+
+  // stop the writer thread, drain what is left in the queue and close the file.
+  void stop();
+
+  // write everything in the queue to the file. This is what the writer thread does, and can
+  // also be called from one other thread when it is not running. Returns the bytes written.
+  size_t drain();
+
+  // the record functions below are for the audio thread only, and are real-time safe. Times
+  // are frame offsets in the current block.
+
+  void recordTime(double ppqPos, double bpm, bool isPlaying, double sampleRate);
+  void recordEvent(const Event& e);
+  void recordEvents(const Event* events, size_t n);
+
+  // a real parameter value, as given to SignalProcessor::setParamFromAudioThread().
+  void recordParam(int time, uint32_t id, float value);
+
+  // end the block with its input frames, which may be null, and queue its records.
+  void recordBlock(const float* const* inputs, size_t frames);
+
+  size_t getRecordedBlocks() const { return recordedBlocks_.load(std::memory_order_relaxed); }
+  size_t getDroppedBlocks() const { return droppedBlocks_.load(std::memory_order_relaxed); }
+
+ private:
+  template <typename T>
+  void put(const T& value);
+  bool reserve(size_t bytes);
+
+  size_t nInputs_;
+  size_t nOutputs_;
+  double sampleRate_;
+  size_t maxFrames_;
+  bool recordInputAudio_;
+
+  // the records of the current block, and whether any didn't fit.
+  std::vector<uint8_t> staging_;
+  size_t stagingBytes_{0};
+  bool stagingOverflowed_{false};
+
+  Queue<uint8_t> queue_;
+  std::vector<uint8_t> drainBuffer_;
+  FILE* file_{nullptr};
+
+  std::thread thread_;
+  std::mutex threadMutex_;
+  std::condition_variable threadCondition_;
+  bool stopRequested_{false};
+
+  std::atomic<size_t> recordedBlocks_{0};
+  std::atomic<size_t> droppedBlocks_{0};
+};
+
+class ProcessReplayer
+{
+ public:
+  ProcessReplayer() = default;
+  ~ProcessReplayer() = default;
+
+  // read a log into memory. Returns false if it can't be read or is not a valid log.
+  bool open(const char* path);
+
+  size_t getNumInputs() const { return nInputs_; }
+  size_t getNumOutputs() const { return nOutputs_; }
+  double getSampleRate() const { return sampleRate_; }
+  bool hasInputAudio() const { return hasInputAudio_; }
+  size_t getNumBlocks() const { return nBlocks_; }
+  uint64_t getTotalFrames() const { return totalFrames_; }
+
+  // replay the whole log through the processor in the context, which must have the log's
+  // inputs and outputs. Output goes to a planar buffer of getTotalFrames() frames for each
+  // output, any of which may be null. Returns false if nothing was opened or the context
+  // doesn't match.
+  bool replay(SignalProcessor& processor, AudioContext& context, float** outputs);
+
+ private:
+  struct ParamChange
+  {
+    int time;
+    uint32_t id;
+    float value;
+  };
+
+  static void processVectorFn(AudioContext* context, void* state);
+  void applyParamChanges(int endTime);
+
+  std::vector<uint8_t> log_;
+  size_t recordsStart_{0};
+  size_t nInputs_{0};
+  size_t nOutputs_{0};
+  double sampleRate_{0.};
+  bool hasInputAudio_{false};
+  size_t nBlocks_{0};
+  uint64_t totalFrames_{0};
+  size_t maxBlockFrames_{0};
+
+  // the state of a replay.
+  SignalProcessor* processor_{nullptr};
+  std::vector<ParamChange> paramChanges_;
+  size_t nextParamChange_{0};
+  int vectorEnd_{0};
+};
+
+}  // namespace ml
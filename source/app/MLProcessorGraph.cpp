@@ -0,0 +1,417 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLProcessorGraph.h"
+
+#include <algorithm>
+
+namespace ml
+{
+// ----------------------------------------------------------------
+// WorkDeque
+
+void ProcessorGraph::WorkDeque::push(uint32_t x)
+{
+  int64_t b = bottom.load(std::memory_order_relaxed);
+  items[b].store(x, std::memory_order_relaxed);
+  bottom.store(b + 1, std::memory_order_release);
+}
+
+bool ProcessorGraph::WorkDeque::pop(uint32_t& x)
+{
+  int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+  bottom.store(b, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t t = top.load(std::memory_order_relaxed);
+  if (t > b)
+  {
+    // empty
+    bottom.store(b + 1, std::memory_order_relaxed);
+    return false;
+  }
+  x = items[b].load(std::memory_order_relaxed);
+  if (t == b)
+  {
+    // last item: race against thieves for it.
+    bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                           std::memory_order_relaxed);
+    bottom.store(b + 1, std::memory_order_relaxed);
+    return won;
+  }
+  return true;
+}
+
+bool ProcessorGraph::WorkDeque::steal(uint32_t& x)
+{
+  int64_t t = top.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t b = bottom.load(std::memory_order_acquire);
+  if (t >= b) return false;
+  x = items[t].load(std::memory_order_relaxed);
+  return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                     std::memory_order_relaxed);
+}
+
+// ----------------------------------------------------------------
+// ProcessorGraph
+
+ProcessorGraph::ProcessorGraph(size_t nThreads)
+{
+  if (nThreads > 0)
+  {
+    pool_ = std::make_unique<WorkerPool>(nThreads);
+  }
+}
+
+ProcessorGraph::~ProcessorGraph() {}
+
+ProcessorGraph::BusID ProcessorGraph::addBus(size_t channels)
+{
+  compiled_ = false;
+  buses_.emplace_back(channels);
+  feedbackSources_.push_back(kNoSource);
+  return buses_.size() - 1;
+}
+
+ProcessorGraph::BusID ProcessorGraph::addFeedbackBus(BusID source)
+{
+  BusID b = addBus(buses_[source].size());
+  feedbackSources_[b] = source;
+  return b;
+}
+
+ProcessorGraph::NodeID ProcessorGraph::addProcessor(SignalProcessor* processor, BusID input,
+                                                    BusID output)
+{
+  compiled_ = false;
+  nodes_.push_back(Node{processor, input, output, {}, 0});
+  return nodes_.size() - 1;
+}
+
+void ProcessorGraph::setHostTaskPool(HostTaskPool pool)
+{
+  compiled_ = false;
+  hostTaskPool_ = pool;
+}
+
+void ProcessorGraph::setSharedWorkers(bool b, double sampleRate, double deadlineFraction)
+{
+  compiled_ = false;
+  sharedWorkers_.reset();
+  sharedDeadline_ = WorkerPool::Clock::duration::max();
+  if (b)
+  {
+    sharedWorkers_ = std::make_unique<SharedResourcePointer<SharedWorkerService>>();
+    if (sampleRate > 0.)
+    {
+      sharedDeadline_ = std::chrono::duration_cast<WorkerPool::Clock::duration>(
+          std::chrono::duration<double>(kFloatsPerDSPVector * deadlineFraction / sampleRate));
+    }
+  }
+}
+
+void ProcessorGraph::alignBuses(const std::vector<BusID>& buses, size_t maxCompensation)
+{
+  compiled_ = false;
+  size_t group = groupMaxCompensation_.size();
+  groupMaxCompensation_.push_back(maxCompensation);
+  for (BusID b : buses)
+  {
+    alignedBuses_.push_back(AlignedBus{b, group, 0, {}});
+  }
+}
+
+void ProcessorGraph::reportMemory(MemoryReport& r) const
+{
+  for (const auto& bus : buses_)
+  {
+    r.add("buses", bus.getMemoryBytes());
+  }
+  for (const auto& aligned : alignedBuses_)
+  {
+    for (const auto& d : aligned.delays)
+    {
+      r.add("compensation", d.getMemoryBytes(), d.getRequestedMemoryBytes());
+    }
+  }
+  for (NodeID n = 0; n < nodes_.size(); ++n)
+  {
+    MemoryReport nodeReport;
+    nodes_[n].processor->reportMemory(nodeReport);
+    r.add(Path("processors", Path(textUtils::naturalNumberToText(n))), nodeReport);
+  }
+}
+
+size_t ProcessorGraph::getCompensation(BusID b) const
+{
+  for (const auto& a : alignedBuses_)
+  {
+    if (a.bus == b) return a.compensation;
+  }
+  return 0;
+}
+
+void ProcessorGraph::addDependency(NodeID before, NodeID after)
+{
+  compiled_ = false;
+  extraDependencies_.emplace_back(before, after);
+}
+
+bool ProcessorGraph::compile()
+{
+  compiled_ = false;
+  order_.clear();
+  const size_t nNodes = nodes_.size();
+
+  // find the writer of each bus.
+  std::vector<size_t> writers(buses_.size(), kNoSource);
+  for (NodeID n = 0; n < nNodes; ++n)
+  {
+    BusID out = nodes_[n].output;
+    if (feedbackSources_[out] != kNoSource) return false;
+    if (writers[out] != kNoSource) return false;
+    writers[out] = n;
+  }
+
+  // make edges from writers to readers.
+  for (auto& node : nodes_)
+  {
+    node.successors.clear();
+    node.numPredecessors = 0;
+  }
+  auto addEdge = [&](NodeID from, NodeID to) {
+    nodes_[from].successors.push_back(to);
+    nodes_[to].numPredecessors++;
+  };
+  for (NodeID n = 0; n < nNodes; ++n)
+  {
+    size_t writer = writers[nodes_[n].input];
+    if (writer != kNoSource)
+    {
+      addEdge(writer, n);
+    }
+  }
+  for (auto& d : extraDependencies_)
+  {
+    addEdge(d.first, d.second);
+  }
+
+  // Kahn's algorithm: if any nodes are left unsorted, they are in a cycle.
+  std::vector<size_t> inDegree(nNodes);
+  std::vector<NodeID> ready;
+  for (NodeID n = 0; n < nNodes; ++n)
+  {
+    inDegree[n] = nodes_[n].numPredecessors;
+    if (inDegree[n] == 0) ready.push_back(n);
+  }
+  while (!ready.empty())
+  {
+    NodeID n = ready.back();
+    ready.pop_back();
+    order_.push_back(n);
+    for (NodeID s : nodes_[n].successors)
+    {
+      if (--inDegree[s] == 0) ready.push_back(s);
+    }
+  }
+  if (order_.size() != nNodes)
+  {
+    order_.clear();
+    return false;
+  }
+
+  // allocate scheduling state, with a deque for each thread of either pool.
+  numDeques_ = std::max(getNumThreads() + 1, hostTaskPool_.numThreads);
+  if (sharedWorkers_) numDeques_ = std::max(numDeques_, (*sharedWorkers_)->getNumWorkers() + 1);
+  pending_ = std::make_unique<std::atomic<size_t>[]>(nNodes);
+  deques_ = std::make_unique<WorkDeque[]>(numDeques_);
+  for (size_t i = 0; i < numDeques_; ++i)
+  {
+    deques_[i].items = std::vector<std::atomic<uint32_t>>(nNodes);
+  }
+  // allocate the alignment delays.
+  for (auto& a : alignedBuses_)
+  {
+    a.delays.resize(buses_[a.bus].size());
+    for (auto& d : a.delays)
+    {
+      d.setMaxDelayInSamples(float(groupMaxCompensation_[a.group]));
+    }
+  }
+  busLatencies_.assign(buses_.size(), 0);
+  updateLatencies();
+
+  compiled_ = true;
+  return true;
+}
+
+// find the latency of each bus from the processors in dependency order, then
+// the delays that align each group of buses. Does not allocate.
+void ProcessorGraph::updateLatencies()
+{
+  std::fill(busLatencies_.begin(), busLatencies_.end(), 0);
+  for (NodeID n : order_)
+  {
+    const Node& node = nodes_[n];
+    busLatencies_[node.output] = busLatencies_[node.input] + node.processor->getLatencyInSamples();
+  }
+
+  for (size_t g = 0; g < groupMaxCompensation_.size(); ++g)
+  {
+    size_t latest = 0;
+    for (const auto& a : alignedBuses_)
+    {
+      if (a.group == g) latest = std::max(latest, busLatencies_[a.bus]);
+    }
+    for (auto& a : alignedBuses_)
+    {
+      if (a.group != g) continue;
+      a.compensation = std::min(latest - busLatencies_[a.bus], groupMaxCompensation_[g]);
+      for (auto& d : a.delays)
+      {
+        d.setDelayInSamples(int(a.compensation));
+      }
+    }
+  }
+}
+
+void ProcessorGraph::applyCompensation()
+{
+  // the delays run even at 0, so that their history is ready for latency changes.
+  for (auto& a : alignedBuses_)
+  {
+    DSPVectorDynamic& bus = buses_[a.bus];
+    for (size_t c = 0; c < a.delays.size(); ++c)
+    {
+      bus[c] = a.delays[c](bus[c]);
+    }
+  }
+}
+
+void ProcessorGraph::process(void* stateData)
+{
+  if (!compiled_) return;
+
+  // feedback buses get the previous vector of their sources.
+  for (BusID b = 0; b < buses_.size(); ++b)
+  {
+    BusID source = feedbackSources_[b];
+    if (source == kNoSource) continue;
+    for (size_t c = 0; c < buses_[b].size(); ++c)
+    {
+      buses_[b][c] = buses_[source][c];
+    }
+  }
+
+  // pick up latency changes. Each processor's flag is checked, so none is left set.
+  bool latencyChanged{false};
+  for (auto& node : nodes_)
+  {
+    latencyChanged |= node.processor->takeLatencyChange();
+  }
+  if (latencyChanged) updateLatencies();
+
+  stateData_ = stateData;
+  if (!pool_ && !sharedWorkers_ && !hostTaskPool_)
+  {
+    for (NodeID n : order_)
+    {
+      Node& node = nodes_[n];
+      node.processor->processVector(buses_[node.input], buses_[node.output], stateData_);
+    }
+    applyCompensation();
+    return;
+  }
+
+  // reset the schedule and deal the initially ready nodes to the deques.
+  const size_t nNodes = nodes_.size();
+  size_t nextDeque = 0;
+  for (size_t i = 0; i < numDeques_; ++i)
+  {
+    deques_[i].top.store(0, std::memory_order_relaxed);
+    deques_[i].bottom.store(0, std::memory_order_relaxed);
+  }
+  for (NodeID n = 0; n < nNodes; ++n)
+  {
+    pending_[n].store(nodes_[n].numPredecessors, std::memory_order_relaxed);
+    if (nodes_[n].numPredecessors == 0)
+    {
+      deques_[nextDeque].push(static_cast<uint32_t>(n));
+      nextDeque = (nextDeque + 1) % numDeques_;
+    }
+  }
+  completed_.store(0, std::memory_order_relaxed);
+
+  // one task per deque. If a worker is slow to start, the calling thread
+  // steals its work, and the task finds nothing left to do. Each task runs
+  // until all nodes are done, so any number of threads can run them.
+  if (hostTaskPool_ && hostTaskPool_.run(hostTaskPool_.context, numDeques_, workerTask, this))
+  {
+    // done on the host's threads.
+  }
+  else if (sharedWorkers_)
+  {
+    auto deadline = WorkerPool::Clock::time_point::max();
+    if (sharedDeadline_ != WorkerPool::Clock::duration::max())
+    {
+      deadline = WorkerPool::Clock::now() + sharedDeadline_;
+    }
+    (*sharedWorkers_)->run(numDeques_, workerTask, this, deadline);
+  }
+  else if (pool_)
+  {
+    pool_->run(numDeques_, workerTask, this);
+  }
+  else
+  {
+    runWorker(0);
+  }
+  applyCompensation();
+}
+
+void ProcessorGraph::workerTask(void* context, size_t worker)
+{
+  static_cast<ProcessorGraph*>(context)->runWorker(worker);
+}
+
+void ProcessorGraph::runWorker(size_t worker)
+{
+  const size_t nNodes = nodes_.size();
+  uint32_t n;
+  while (completed_.load(std::memory_order_acquire) < nNodes)
+  {
+    if (deques_[worker].pop(n))
+    {
+      runNode(n, worker);
+      continue;
+    }
+    bool stole = false;
+    for (size_t i = 1; i < numDeques_; ++i)
+    {
+      if (deques_[(worker + i) % numDeques_].steal(n))
+      {
+        runNode(n, worker);
+        stole = true;
+        break;
+      }
+    }
+    if (!stole) cpuRelax();
+  }
+}
+
+void ProcessorGraph::runNode(NodeID n, size_t worker)
+{
+  Node& node = nodes_[n];
+  node.processor->processVector(buses_[node.input], buses_[node.output], stateData_);
+  for (NodeID s : node.successors)
+  {
+    if (pending_[s].fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+      deques_[worker].push(static_cast<uint32_t>(s));
+    }
+  }
+  completed_.fetch_add(1, std::memory_order_release);
+}
+
+}  // namespace ml
@@ -0,0 +1,181 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// ProcessorGraph: runs a set of SignalProcessors connected by buses, in
+// dependency order, across a work-stealing pool of threads.
+//
+// Each processor reads one input bus and writes one output bus. A processor
+// that reads a bus depends on the processor that writes it. Buses that no
+// processor writes are graph inputs, filled by the client before process().
+// Extra ordering constraints can be added with addDependency().
+//
+// A feedback bus holds the previous vector of another bus, so reading it
+// creates no dependency. This allows cycles with one DSPVector of delay.
+//
+// Each bus has a latency: the sum of the latencies of the processors on the
+// longest path to it from the graph inputs. Buses that are read together, such
+// as the outputs of parallel branches, can be aligned with alignBuses(), which
+// delays the earlier ones to match the latest. Graph inputs and feedback buses
+// have no latency.
+//
+// With setHostTaskPool(), the processors run on threads borrowed from a host,
+// falling back to the graph's own threads if the host refuses a vector. With
+// setSharedWorkers(), they run on the SharedWorkerService that all instances
+// in the process share, instead of the graph's own threads.
+//
+// Setup is not real-time safe. After compile() succeeds, process() does not
+// allocate or lock. Processors that run in parallel share the stateData
+// pointer, so they must only read from it.
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "MLDSPFilters.h"
+#include "MLSharedResource.h"
+#include "MLSharedWorkerService.h"
+#include "MLSignalProcessor.h"
+#include "MLWorkerPool.h"
+
+namespace ml
+{
+class ProcessorGraph final
+{
+ public:
+  using BusID = size_t;
+  using NodeID = size_t;
+
+  static constexpr size_t kDefaultMaxCompensation = 4096;
+
+  // nThreads worker threads run along with the thread calling process().
+  explicit ProcessorGraph(size_t nThreads = 0);
+  ~ProcessorGraph();
+
+  ProcessorGraph(const ProcessorGraph&) = delete;
+  ProcessorGraph& operator=(const ProcessorGraph&) = delete;
+
+  BusID addBus(size_t channels);
+
+  // add a bus that holds the previous DSPVector of the source bus.
+  BusID addFeedbackBus(BusID source);
+
+  NodeID addProcessor(SignalProcessor* processor, BusID input, BusID output);
+
+  // make after wait for before, in addition to the dependencies from buses.
+  void addDependency(NodeID before, NodeID after);
+
+  // Build the schedule. Returns false if the connections have a cycle that
+  // does not go through a feedback bus, or if a bus has more than one writer
+  // or a processor writes a feedback bus. process() does nothing until
+  // compile() succeeds.
+  bool compile();
+
+  // Delay the given buses after each process() so that they all have the
+  // latency of the latest one, up to maxCompensation samples. The buses should
+  // only be read by the client, since processors and feedback buses reading
+  // them see the delayed signals on the next vector. Call compile() afterwards.
+  void alignBuses(const std::vector<BusID>& buses, size_t maxCompensation = kDefaultMaxCompensation);
+
+  // run all the processors for one DSPVector. Any changes in the latencies of
+  // the processors are applied first.
+  void process(void* stateData = nullptr);
+
+  // the latency of a bus before alignment, as of the last process() or compile().
+  size_t getBusLatency(BusID b) const { return busLatencies_[b]; }
+
+  // the delay added to an aligned bus, or 0 for other buses.
+  size_t getCompensation(BusID b) const;
+
+  DSPVectorDynamic& getBus(BusID b) { return buses_[b]; }
+  const DSPVectorDynamic& getBus(BusID b) const { return buses_[b]; }
+
+  size_t getNumThreads() const { return pool_ ? pool_->getNumWorkers() : 0; }
+
+  // run the processors on the host's threads when it accepts them. Call
+  // compile() afterwards.
+  void setHostTaskPool(HostTaskPool pool);
+
+  // run the processors on the workers shared by all instances in the process,
+  // each vector being one job due by the given fraction of a vector's duration
+  // at sampleRate, or with no deadline if sampleRate is 0. Call compile()
+  // afterwards.
+  void setSharedWorkers(bool b, double sampleRate = 0., double deadlineFraction = 0.75);
+  bool hasSharedWorkers() const { return sharedWorkers_ != nullptr; }
+
+  // the processors in a valid topological order, after compile().
+  const std::vector<NodeID>& getOrder() const { return order_; }
+
+  // add the memory of the buses and alignment delays to a report, and the report of each
+  // processor under "processors/<node ID>". Not real-time safe.
+  void reportMemory(MemoryReport& r) const;
+
+ private:
+  static constexpr size_t kNoSource = ~size_t(0);
+
+  // Chase-Lev deque. The owner pushes and pops at the bottom and other
+  // threads steal from the top. It holds every node at most once per vector,
+  // so it is reset each vector and never wraps.
+  struct WorkDeque
+  {
+    std::vector<std::atomic<uint32_t>> items;
+    std::atomic<int64_t> top{0};
+    std::atomic<int64_t> bottom{0};
+
+    void push(uint32_t x);
+    bool pop(uint32_t& x);
+    bool steal(uint32_t& x);
+  };
+
+  struct Node
+  {
+    SignalProcessor* processor;
+    BusID input;
+    BusID output;
+    std::vector<NodeID> successors;
+    size_t numPredecessors{0};
+  };
+
+  // buses aligned by a delay line on each channel.
+  struct AlignedBus
+  {
+    BusID bus;
+    size_t group;
+    size_t compensation{0};
+    std::vector<IntegerDelay> delays;
+  };
+
+  void updateLatencies();
+  void applyCompensation();
+
+  static void workerTask(void* context, size_t worker);
+  void runWorker(size_t worker);
+  void runNode(NodeID n, size_t worker);
+
+  std::unique_ptr<WorkerPool> pool_;
+  std::unique_ptr<SharedResourcePointer<SharedWorkerService>> sharedWorkers_;
+  WorkerPool::Clock::duration sharedDeadline_{WorkerPool::Clock::duration::max()};
+  HostTaskPool hostTaskPool_;
+  std::vector<DSPVectorDynamic> buses_;
+  std::vector<BusID> feedbackSources_;
+  std::vector<Node> nodes_;
+  std::vector<std::pair<NodeID, NodeID>> extraDependencies_;
+
+  std::vector<NodeID> order_;
+  bool compiled_{false};
+
+  std::vector<size_t> busLatencies_;
+  std::vector<AlignedBus> alignedBuses_;
+  std::vector<size_t> groupMaxCompensation_;
+
+  // per-vector scheduling state
+  std::unique_ptr<std::atomic<size_t>[]> pending_;
+  std::unique_ptr<WorkDeque[]> deques_;
+  size_t numDeques_{0};
+  std::atomic<size_t> completed_{0};
+  void* stateData_{nullptr};
+};
+
+}  // namespace ml
@@ -2,19 +2,28 @@
 // Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
 // Distributed under the MIT license: http://madrona-labs.mit-license.org/
 
-// A very simple SPSC Queue.
+// A very simple SPSC Queue, and a bounded MPMC Queue.
 // based on
 // https://kjellkod.wordpress.com/2012/11/28/c-debt-paid-in-full-wait-free-lock-free-queue/
 
 #pragma once
 
+#include <algorithm>
 #include <atomic>
 #include <cstddef>
+#include <cstdint>
 #include <iterator>
+#include <memory>
+#include <utility>
 #include <vector>
 
 namespace ml
 {
+// indices written by different threads are kept this far apart to avoid false sharing. They
+// are separated by padding rather than alignas(), so that the queues need no more than the
+// default alignment, and can be allocated with plain new where aligned new is turned off.
+constexpr size_t kQueueCacheLineSize{64};
+
 template <typename Element>
 class Queue final
 {
@@ -41,48 +50,84 @@ class Queue final
 
     data_.resize(powerOfTwoSize);
     sizeMask_ = powerOfTwoSize - 1;
-    clear();
+
+    // not thread-safe. reset the indices, which may be out of range of the new size.
+    writeIndex_.store(0, std::memory_order_relaxed);
+    readIndex_.store(0, std::memory_order_relaxed);
+    cachedReadIndex_ = 0;
+    cachedWriteIndex_ = 0;
   }
 
   size_t size() { return data_.size(); }
 
-  bool push(const Element& item)
-  {
-    const auto currentWriteIndex = writeIndex_.load(std::memory_order_relaxed);
-    const auto nextWriteIndex = increment(currentWriteIndex);
-    if (nextWriteIndex != readIndex_.load(std::memory_order_acquire))
-    {
-      data_[currentWriteIndex] = item;
-      writeIndex_.store(nextWriteIndex, std::memory_order_release);
-      return true;
-    }
-    return false;
-  }
+  // Each side keeps a copy of the other side's index, and only reloads it
+  // when the copy says the queue is full (for push) or empty (for pop).
+
+  bool push(const Element& item) { return pushItem(item); }
+  bool push(Element&& item) { return pushItem(std::move(item)); }
 
   bool pop(Element& item)
   {
     const auto currentReadIndex = readIndex_.load(std::memory_order_relaxed);
-    if (currentReadIndex == writeIndex_.load(std::memory_order_acquire))
+    if (currentReadIndex == cachedWriteIndex_)
     {
-      return false;  // empty queue
+      cachedWriteIndex_ = writeIndex_.load(std::memory_order_acquire);
+      if (currentReadIndex == cachedWriteIndex_)
+      {
+        return false;  // empty queue
+      }
     }
-    item = data_[currentReadIndex];
+    item = std::move(data_[currentReadIndex]);
     readIndex_.store(increment(currentReadIndex), std::memory_order_release);
     return true;
   }
 
   Element pop()
   {
-    const auto currentReadIndex = readIndex_.load(std::memory_order_relaxed);
-    if (currentReadIndex == writeIndex_.load(std::memory_order_acquire))
+    Element r;
+    if (!pop(r))
     {
       return Element();  // empty queue, return null object
     }
-    Element r = data_[currentReadIndex];
-    readIndex_.store(increment(currentReadIndex), std::memory_order_release);
     return r;
   }
 
+  // push up to n items, returning the number pushed.
+  size_t pushN(const Element* items, size_t n)
+  {
+    const auto currentWriteIndex = writeIndex_.load(std::memory_order_relaxed);
+    size_t free = (cachedReadIndex_ - currentWriteIndex - 1) & sizeMask_;
+    if (free < n)
+    {
+      cachedReadIndex_ = readIndex_.load(std::memory_order_acquire);
+      free = (cachedReadIndex_ - currentWriteIndex - 1) & sizeMask_;
+    }
+    const size_t count = std::min(n, free);
+    const size_t firstPart = std::min(count, data_.size() - currentWriteIndex);
+    std::copy(items, items + firstPart, data_.begin() + currentWriteIndex);
+    std::copy(items + firstPart, items + count, data_.begin());
+    writeIndex_.store((currentWriteIndex + count) & sizeMask_, std::memory_order_release);
+    return count;
+  }
+
+  // pop up to n items into dest, returning the number popped.
+  size_t popN(Element* dest, size_t n)
+  {
+    const auto currentReadIndex = readIndex_.load(std::memory_order_relaxed);
+    size_t available = (cachedWriteIndex_ - currentReadIndex) & sizeMask_;
+    if (available < n)
+    {
+      cachedWriteIndex_ = writeIndex_.load(std::memory_order_acquire);
+      available = (cachedWriteIndex_ - currentReadIndex) & sizeMask_;
+    }
+    const size_t count = std::min(n, available);
+    const size_t firstPart = std::min(count, data_.size() - currentReadIndex);
+    std::move(data_.begin() + currentReadIndex, data_.begin() + currentReadIndex + firstPart, dest);
+    std::move(data_.begin(), data_.begin() + (count - firstPart), dest + firstPart);
+    readIndex_.store((currentReadIndex + count) & sizeMask_, std::memory_order_release);
+    return count;
+  }
+
   void clear()
   {
     Element dummy;
@@ -115,9 +160,221 @@ class Queue final
  private:
   size_t increment(size_t idx) const { return (idx + 1) & sizeMask_; }
 
+  // push by copying or moving the item.
+  template <typename T>
+  bool pushItem(T&& item)
+  {
+    const auto currentWriteIndex = writeIndex_.load(std::memory_order_relaxed);
+    const auto nextWriteIndex = increment(currentWriteIndex);
+    if (nextWriteIndex == cachedReadIndex_)
+    {
+      cachedReadIndex_ = readIndex_.load(std::memory_order_acquire);
+      if (nextWriteIndex == cachedReadIndex_)
+      {
+        return false;  // full queue
+      }
+    }
+    data_[currentWriteIndex] = std::forward<T>(item);
+    writeIndex_.store(nextWriteIndex, std::memory_order_release);
+    return true;
+  }
+
   std::vector<Element> data_;
   size_t sizeMask_;
+  char padding0_[kQueueCacheLineSize];
+
+  // the writer's index and its copy of the reader's index
+  std::atomic<size_t> writeIndex_{0};
+  size_t cachedReadIndex_{0};
+  char padding1_[kQueueCacheLineSize];
+
+  // the reader's index and its copy of the writer's index
+  std::atomic<size_t> readIndex_{0};
+  size_t cachedWriteIndex_{0};
+  char padding2_[kQueueCacheLineSize];
+};
+
+// A bounded MPMC Queue, with the same interface as Queue except for peek().
+// Any number of threads can push and pop. Each cell holds a sequence number
+// that tells pushers and poppers whether it is free for their lap around the
+// ring, so a thread only has to win one compare-and-swap on an index.
+// based on
+// https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+
+template <typename Element>
+class MPMCQueue final
+{
+ public:
+  MPMCQueue(size_t size) { resize(size); }
+
+  ~MPMCQueue() {}
+
+  // not thread-safe: no other thread may use the queue during resize().
+  void resize(size_t capacity)
+  {
+    // unlike Queue, every cell can be used, so the size only needs to be a
+    // power of two >= capacity.
+    size_t powerOfTwoSize = 2;
+    while (powerOfTwoSize < capacity) powerOfTwoSize <<= 1;
+
+    cells_ = std::unique_ptr<Cell[]>(new Cell[powerOfTwoSize]);
+    size_ = powerOfTwoSize;
+    sizeMask_ = powerOfTwoSize - 1;
+    for (size_t i = 0; i < size_; ++i)
+    {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    writeIndex_.store(0, std::memory_order_relaxed);
+    readIndex_.store(0, std::memory_order_relaxed);
+  }
+
+  size_t size() { return size_; }
+
+  bool push(const Element& item) { return pushItem(item); }
+  bool push(Element&& item) { return pushItem(std::move(item)); }
+
+  bool pop(Element& item)
+  {
+    Cell* cell;
+    size_t pos = readIndex_.load(std::memory_order_relaxed);
+    for (;;)
+    {
+      cell = &cells_[pos & sizeMask_];
+      size_t seq = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+      if (diff == 0)
+      {
+        if (readIndex_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+      }
+      else if (diff < 0)
+      {
+        return false;  // empty queue
+      }
+      else
+      {
+        pos = readIndex_.load(std::memory_order_relaxed);
+      }
+    }
+    item = std::move(cell->data);
+    cell->sequence.store(pos + sizeMask_ + 1, std::memory_order_release);
+    return true;
+  }
+
+  Element pop()
+  {
+    Element r;
+    if (!pop(r))
+    {
+      return Element();  // empty queue, return null object
+    }
+    return r;
+  }
+
+  void clear()
+  {
+    Element dummy;
+    while (pop(dummy));
+  }
+
+  // with other threads pushing and popping, this is only a snapshot.
+  size_t elementsAvailable() const
+  {
+    size_t r = readIndex_.load(std::memory_order_acquire);
+    size_t w = writeIndex_.load(std::memory_order_acquire);
+    return (w > r) ? std::min(w - r, size_) : 0;
+  }
+
+  bool wasEmpty() const { return elementsAvailable() == 0; }
+
+  bool wasFull() const { return elementsAvailable() == size_; }
+
+ private:
+  struct Cell
+  {
+    std::atomic<size_t> sequence;
+    Element data;
+  };
+
+  template <typename T>
+  bool pushItem(T&& item)
+  {
+    Cell* cell;
+    size_t pos = writeIndex_.load(std::memory_order_relaxed);
+    for (;;)
+    {
+      cell = &cells_[pos & sizeMask_];
+      size_t seq = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+      if (diff == 0)
+      {
+        if (writeIndex_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+      }
+      else if (diff < 0)
+      {
+        return false;  // full queue
+      }
+      else
+      {
+        pos = writeIndex_.load(std::memory_order_relaxed);
+      }
+    }
+    cell->data = std::forward<T>(item);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  std::unique_ptr<Cell[]> cells_;
+  size_t size_{0};
+  size_t sizeMask_{0};
+
+  // keep the indices on separate cache lines.
+  char padding0_[kQueueCacheLineSize];
   std::atomic<size_t> writeIndex_{0};
+  char padding1_[kQueueCacheLineSize];
   std::atomic<size_t> readIndex_{0};
+  char padding2_[kQueueCacheLineSize];
+};
+
+// A wait-free triple buffer for passing the latest value of something from one writer thread to
+// one reader thread. The writer fills its buffer and publishes it, and the reader takes the most
+// recently published buffer. Neither side ever waits for the other, and values published between
+// reads are skipped.
+template <typename Element>
+class TripleBuffer final
+{
+ public:
+  TripleBuffer() = default;
+  explicit TripleBuffer(const Element& initial) : buffers_{initial, initial, initial} {}
+
+  // writer: get the buffer to fill, then publish it. After publishing, getWriteBuffer() returns
+  // a different buffer, holding an older value.
+  Element& getWriteBuffer() { return buffers_[writeIndex_]; }
+  void publish()
+  {
+    writeIndex_ = middle_.exchange(writeIndex_ | kNewBit, std::memory_order_acq_rel) & kIndexMask;
+  }
+
+  // reader: take the newest published buffer if there is one, returning true if so.
+  bool update()
+  {
+    if (!(middle_.load(std::memory_order_relaxed) & kNewBit)) return false;
+    readIndex_ = middle_.exchange(readIndex_, std::memory_order_acq_rel) & kIndexMask;
+    return true;
+  }
+  const Element& getReadBuffer() const { return buffers_[readIndex_]; }
+
+ private:
+  static constexpr uint8_t kIndexMask{3};
+  static constexpr uint8_t kNewBit{4};
+
+  Element buffers_[3];
+  char padding0_[kQueueCacheLineSize];
+  uint8_t writeIndex_{0};
+  char padding1_[kQueueCacheLineSize];
+  std::atomic<uint8_t> middle_{1};
+  char padding2_[kQueueCacheLineSize];
+  uint8_t readIndex_{2};
+  char padding3_[kQueueCacheLineSize];
 };
+
 };  // namespace ml
@@ -0,0 +1,118 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLRCU.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace ml
+{
+
+EpochDomain::EpochDomain()
+{
+  for (auto& r : readers_)
+  {
+    r.store(kUnused, std::memory_order_relaxed);
+  }
+}
+
+EpochDomain::~EpochDomain()
+{
+  stop();
+  for (const auto& r : retired_)
+  {
+    r.deleter(r.object);
+  }
+}
+
+size_t EpochDomain::addReader()
+{
+  for (size_t i = 0; i < kMaxReaders; ++i)
+  {
+    uint64_t expected = kUnused;
+    if (readers_[i].compare_exchange_strong(expected, kIdle)) return i;
+  }
+  return kNoReader;
+}
+
+void EpochDomain::removeReader(size_t reader)
+{
+  if (reader < kMaxReaders) readers_[reader].store(kUnused);
+}
+
+void EpochDomain::retire(void* object, void (*deleter)(void*))
+{
+  // the object was unpublished before the epoch advances, so readers that start in the new
+  // epoch can't see it.
+  std::lock_guard<std::mutex> lock(retiredMutex_);
+  const uint64_t epoch = ++epoch_;
+  retired_.push_back(Retired{object, deleter, epoch});
+}
+
+uint64_t EpochDomain::getOldestReaderEpoch() const
+{
+  uint64_t oldest = kIdle;
+  for (const auto& r : readers_)
+  {
+    const uint64_t e = r.load();
+    if (e < kUnused) oldest = std::min(oldest, e);
+  }
+  return oldest;
+}
+
+size_t EpochDomain::reclaim()
+{
+  // take the objects that are safe to free, and free them outside the lock.
+  std::vector<Retired> freeable;
+  {
+    std::lock_guard<std::mutex> lock(retiredMutex_);
+    const uint64_t oldest = getOldestReaderEpoch();
+    auto it = std::stable_partition(retired_.begin(), retired_.end(),
+                                    [oldest](const Retired& r) { return r.epoch > oldest; });
+    freeable.assign(it, retired_.end());
+    retired_.erase(it, retired_.end());
+  }
+  for (const auto& r : freeable)
+  {
+    r.deleter(r.object);
+  }
+  return freeable.size();
+}
+
+size_t EpochDomain::getRetiredCount()
+{
+  std::lock_guard<std::mutex> lock(retiredMutex_);
+  return retired_.size();
+}
+
+void EpochDomain::start(int intervalMs)
+{
+  if (thread_.joinable()) return;
+  stopRequested_ = false;
+  auto interval = std::chrono::milliseconds(std::max(intervalMs, 1));
+  thread_ = std::thread(
+      [this, interval]()
+      {
+        std::unique_lock<std::mutex> lock(threadMutex_);
+        while (!stopRequested_)
+        {
+          reclaim();
+          threadCondition_.wait_for(lock, interval, [this]() { return stopRequested_; });
+        }
+      });
+}
+
+void EpochDomain::stop()
+{
+  if (!thread_.joinable()) return;
+  {
+    std::lock_guard<std::mutex> lock(threadMutex_);
+    stopRequested_ = true;
+  }
+  threadCondition_.notify_one();
+  thread_.join();
+}
+
+}  // namespace ml
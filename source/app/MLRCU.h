@@ -0,0 +1,153 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// RCU-style publication of objects from UI threads to audio threads, with deferred reclamation.
+//
+// An RCUPointer<T> holds the current version of an object that the audio thread reads, like a
+// Scale, a wavetable or an impulse response. A UI thread publishes a new version by swapping
+// the pointer, which never waits for the reader. The old version is retired to an EpochDomain,
+// which frees it later, on its own thread, once no reader can still be using it.
+//
+// Each reader thread registers with the domain and wraps each block of processing in a
+// ReadScope, which marks the reader as active in the current epoch. Every publish advances
+// the epoch. An object retired in epoch E is freed once every reader is either outside a
+// block or has started one since E, so the audio thread neither locks nor frees anything.
+// Pointers read from an RCUPointer are valid until the end of the ReadScope they were read in.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ml
+{
+class EpochDomain
+{
+ public:
+  static constexpr size_t kMaxReaders{32};
+  static constexpr size_t kNoReader{~size_t(0)};
+
+  EpochDomain();
+
+  // frees everything still retired, so all readers must be finished with the domain.
+  ~EpochDomain();
+
+  EpochDomain(const EpochDomain&) = delete;
+  EpochDomain& operator=(const EpochDomain&) = delete;
+
+  // register a reader thread, returning its index, or kNoReader if there are already
+  // kMaxReaders. Readers can be added and removed from any thread.
+  size_t addReader();
+  void removeReader(size_t reader);
+
+  // for reader threads: mark the start and end of a block of reading. Real-time safe.
+  class ReadScope
+  {
+   public:
+    ReadScope(EpochDomain& domain, size_t reader) : domain_(domain), reader_(reader)
+    {
+      domain_.enter(reader_);
+    }
+    ~ReadScope() { domain_.exit(reader_); }
+
+    ReadScope(const ReadScope&) = delete;
+    ReadScope& operator=(const ReadScope&) = delete;
+
+   private:
+    EpochDomain& domain_;
+    size_t reader_;
+  };
+
+  void enter(size_t reader)
+  {
+    if (reader < kMaxReaders) readers_[reader].store(epoch_.load());
+  }
+  void exit(size_t reader)
+  {
+    if (reader < kMaxReaders) readers_[reader].store(kIdle, std::memory_order_release);
+  }
+
+  // for writer threads: hand an object that readers may still be using to the domain, which
+  // takes ownership and deletes it when they are done.
+  template <class T>
+  void retire(T* object)
+  {
+    if (object) retire(object, [](void* p) { delete static_cast<T*>(p); });
+  }
+  void retire(void* object, void (*deleter)(void*));
+
+  // start and stop the reclamation thread, which frees retired objects every intervalMs
+  // milliseconds.
+  void start(int intervalMs = 50);
+  void stop();
+
+  // free the retired objects that no reader can be using. This is what the reclamation thread
+  // does, and can also be called from any other thread. Returns the number freed.
+  size_t reclaim();
+
+  // the number of objects retired but not yet freed.
+  size_t getRetiredCount();
+
+ private:
+  static constexpr uint64_t kIdle{~uint64_t(0)};
+  static constexpr uint64_t kUnused{kIdle - 1};
+
+  struct Retired
+  {
+    void* object;
+    void (*deleter)(void*);
+    uint64_t epoch;
+  };
+
+  // the oldest epoch any active reader is in, or kIdle if none is active.
+  uint64_t getOldestReaderEpoch() const;
+
+  std::atomic<uint64_t> epoch_{0};
+  std::array<std::atomic<uint64_t>, kMaxReaders> readers_;
+
+  std::mutex retiredMutex_;
+  std::vector<Retired> retired_;
+
+  std::thread thread_;
+  std::mutex threadMutex_;
+  std::condition_variable threadCondition_;
+  bool stopRequested_{false};
+};
+
+// RCUPointer: the current version of an object, published by writer threads and read by
+// readers registered with the domain.
+
+template <class T>
+class RCUPointer
+{
+ public:
+  explicit RCUPointer(EpochDomain& domain, std::unique_ptr<T> initial = nullptr)
+      : domain_(domain), current_(initial.release())
+  {
+  }
+
+  // the current version can be freed at once, because no one can read it any more.
+  ~RCUPointer() { delete current_.load(); }
+
+  RCUPointer(const RCUPointer&) = delete;
+  RCUPointer& operator=(const RCUPointer&) = delete;
+
+  // for readers, in a ReadScope. The object stays valid until the end of the scope.
+  const T* acquire() const { return current_.load(); }
+
+  // for writers: make a new version current and retire the old one. Never waits for readers.
+  void publish(std::unique_ptr<T> next) { domain_.retire(current_.exchange(next.release())); }
+
+ private:
+  EpochDomain& domain_;
+  std::atomic<T*> current_;
+};
+
+}  // namespace ml
@@ -0,0 +1,127 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLRealtimeThread.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#include "MLPlatform.h"
+
+#if ML_MAC || ML_IOS
+#include <mach/mach.h>
+#include <mach/mach_time.h>
+#include <mach/thread_policy.h>
+#include <pthread.h>
+#elif ML_LINUX
+#include <pthread.h>
+#include <sched.h>
+#elif ML_WINDOWS
+#include <avrt.h>
+#pragma comment(lib, "avrt.lib")
+#endif
+
+namespace ml
+{
+bool setCurrentThreadRealtime([[maybe_unused]] double periodSeconds,
+                              [[maybe_unused]] int priority)
+{
+#if ML_MAC || ML_IOS
+  // ask for up to three quarters of each period, of which half must be computed uninterrupted.
+  mach_timebase_info_data_t timebase;
+  mach_timebase_info(&timebase);
+  double ticksPerSecond = 1e9 * timebase.denom / timebase.numer;
+  uint32_t periodTicks = static_cast<uint32_t>(periodSeconds * ticksPerSecond);
+
+  thread_time_constraint_policy_data_t policy;
+  policy.period = periodTicks;
+  policy.computation = periodTicks / 2;
+  policy.constraint = periodTicks / 4 * 3;
+  policy.preemptible = true;
+  return thread_policy_set(pthread_mach_thread_np(pthread_self()), THREAD_TIME_CONSTRAINT_POLICY,
+                           reinterpret_cast<thread_policy_t>(&policy),
+                           THREAD_TIME_CONSTRAINT_POLICY_COUNT) == KERN_SUCCESS;
+#elif ML_LINUX
+  // leave some room above for the system's own real-time threads.
+  sched_param param{};
+  int maxPriority = sched_get_priority_max(SCHED_FIFO);
+  param.sched_priority = (priority > 0) ? std::min(priority, maxPriority) : maxPriority - 10;
+  return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+#elif ML_WINDOWS
+  DWORD taskIndex{0};
+  HANDLE task = AvSetMmThreadCharacteristicsW(L"Pro Audio", &taskIndex);
+  if (!task) return false;
+  AvSetMmThreadPriority(task, AVRT_PRIORITY_CRITICAL);
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool setCurrentThreadCore(int core)
+{
+  if (core < 0) return false;
+#if ML_MAC || ML_IOS
+  // threads with the same tag share a cache, and threads with different tags avoid sharing.
+  thread_affinity_policy_data_t policy{core + 1};
+  return thread_policy_set(pthread_mach_thread_np(pthread_self()), THREAD_AFFINITY_POLICY,
+                           reinterpret_cast<thread_policy_t>(&policy),
+                           THREAD_AFFINITY_POLICY_COUNT) == KERN_SUCCESS;
+#elif ML_LINUX
+  if (core >= CPU_SETSIZE) return false;
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(core, &cpus);
+  return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+#elif ML_WINDOWS
+  if (core >= int(sizeof(DWORD_PTR) * 8)) return false;
+  return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << core) != 0;
+#else
+  return false;
+#endif
+}
+
+bool setCurrentThreadCores(const std::vector<int>& cores)
+{
+  if (cores.empty()) return false;
+#if ML_MAC || ML_IOS
+  // there are only affinity tags, so all the threads given these cores share the first's.
+  return setCurrentThreadCore(cores.front());
+#elif ML_LINUX
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  for (int core : cores)
+  {
+    if ((core < 0) || (core >= CPU_SETSIZE)) return false;
+    CPU_SET(core, &cpus);
+  }
+  return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+#elif ML_WINDOWS
+  DWORD_PTR mask{0};
+  for (int core : cores)
+  {
+    if ((core < 0) || (core >= int(sizeof(DWORD_PTR) * 8))) return false;
+    mask |= DWORD_PTR(1) << core;
+  }
+  return SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#else
+  return false;
+#endif
+}
+
+void prefaultStack()
+{
+  // write and read back each page through a volatile pointer, so that the compiler can't drop
+  // the array or the stores.
+  char stack[kStackPrefaultBytes];
+  volatile char* touch = stack;
+  char last{0};
+  for (size_t i = 0; i < kStackPrefaultBytes; i += 1024)
+  {
+    touch[i] = last;
+    last = touch[i];
+  }
+}
+
+}  // namespace ml
@@ -0,0 +1,35 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// Real-time thread setup for audio callbacks and the workers that help them. Each function
+// acts on the calling thread.
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace ml
+{
+// the amount of stack that prefaultStack() touches.
+constexpr size_t kStackPrefaultBytes{64 * 1024};
+
+// give the current thread real-time scheduling, for a task that runs once every periodSeconds:
+// SCHED_FIFO on Linux, a time constraint policy on macOS and iOS, and MMCSS "Pro Audio" on
+// Windows. periodSeconds is only used on macOS and iOS. priority is the SCHED_FIFO priority on
+// Linux, or 0 for a default near the top of the range. Returns true on success.
+bool setCurrentThreadRealtime(double periodSeconds, int priority = 0);
+
+// run the current thread only on the given core. On macOS this is an affinity hint that the
+// system may ignore. Returns true on success.
+bool setCurrentThreadCore(int core);
+
+// let the current thread run on any of the given cores, as for control threads. Returns true on
+// success.
+bool setCurrentThreadCores(const std::vector<int>& cores);
+
+// touch the stack below the caller, so that its pages are mapped before they are needed.
+void prefaultStack();
+
+}  // namespace ml
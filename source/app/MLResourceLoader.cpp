@@ -0,0 +1,196 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLResourceLoader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include "MLActor.h"
+#include "MLDSPResampler.h"
+#include "MLSampleStream.h"
+#include "MLWavFile.h"
+
+namespace ml
+{
+
+ResourceLoader::ResourceLoader(size_t threads)
+{
+  for (size_t i = 0; i < std::max(threads, size_t(1)); ++i)
+  {
+    threads_.emplace_back([this]() { runWorker(); });
+  }
+}
+
+ResourceLoader::~ResourceLoader()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopRequested_ = true;
+    waiting_.clear();
+  }
+  workAvailable_.notify_all();
+  for (auto& t : threads_)
+  {
+    t.join();
+  }
+}
+
+uint64_t ResourceLoader::request(Job job, int priority)
+{
+  uint64_t id;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    id = nextID_++;
+    waiting_.push_back(Request{id, priority, std::move(job)});
+  }
+  workAvailable_.notify_one();
+  return id;
+}
+
+bool ResourceLoader::cancel(uint64_t id)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = std::find_if(waiting_.begin(), waiting_.end(),
+                         [id](const Request& r) { return r.id == id; });
+  if (it == waiting_.end()) return false;
+  waiting_.erase(it);
+  if (waiting_.empty() && !running_) idle_.notify_all();
+  return true;
+}
+
+void ResourceLoader::waitUntilIdle()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_.wait(lock, [this]() { return waiting_.empty() && !running_; });
+}
+
+size_t ResourceLoader::getNumWaiting()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return waiting_.size();
+}
+
+void ResourceLoader::runWorker()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true)
+  {
+    workAvailable_.wait(lock, [this]() { return stopRequested_ || !waiting_.empty(); });
+    if (stopRequested_) return;
+
+    // the highest priority, then the oldest. IDs increase with each request.
+    auto next = std::min_element(waiting_.begin(), waiting_.end(),
+                                 [](const Request& a, const Request& b)
+                                 {
+                                   return (a.priority != b.priority) ? (a.priority > b.priority)
+                                                                     : (a.id < b.id);
+                                 });
+    Job job = std::move(next->job);
+    waiting_.erase(next);
+    running_++;
+
+    lock.unlock();
+    job();
+    job = nullptr;
+    lock.lock();
+
+    running_--;
+    if (waiting_.empty() && !running_) idle_.notify_all();
+  }
+}
+
+std::string ResourceLoader::getSampleKey(const std::string& path, double sampleRate)
+{
+  return path + "@" + std::to_string(std::lround(sampleRate));
+}
+
+uint64_t ResourceLoader::requestSample(SamplePool& pool, const std::string& path,
+                                       double sampleRate, SampleDoneFn done, int priority)
+{
+  return request(
+      [&pool, path, sampleRate, done = std::move(done)]()
+      {
+        auto sample = pool.load(getSampleKey(path, sampleRate), [&](Sample& s)
+                                { return readWavFile(path.c_str(), s, sampleRate); });
+        if (done) done(sample);
+      },
+      priority);
+}
+
+uint64_t ResourceLoader::requestSample(SamplePool& pool, const std::string& path,
+                                       double sampleRate, Path actorName, Path address,
+                                       int priority)
+{
+  const std::string key = getSampleKey(path, sampleRate);
+  return requestSample(
+      pool, path, sampleRate,
+      [actorName, address, key](SamplePool::SamplePtr sample)
+      { sendMessageToActor(actorName, Message(address, sample ? Value(key.c_str()) : Value())); },
+      priority);
+}
+
+bool ResourceLoader::readWavFile(const char* path, Sample& sample, double sampleRate)
+{
+  MappedFile file;
+  WavFileInfo info;
+  if (!file.open(path) || !parseWavFile(file.data(), file.size(), info)) return false;
+
+  const size_t channels = info.channels;
+  const size_t frames = info.frames;
+  sample.channels = channels;
+  sample.sampleRate = info.sampleRate;
+  sample.sampleData.resize(channels * frames);
+  readWavFrames(info, 0, frames, sample.sampleData.data());
+  if ((sampleRate <= 0.) || (std::lround(sampleRate) == info.sampleRate) || !frames) return true;
+
+  // resample each channel. The resampler's output lags its input by its latency, so to line
+  // the times up exactly the input starts with zeros that make the lag a whole number of
+  // output frames, which are skipped.
+  const long newRate = std::lround(sampleRate);
+  const long gcd = std::gcd(long(info.sampleRate), newRate);
+  const long inputPeriod = info.sampleRate / gcd;
+  const long outputPeriod = newRate / gcd;
+  const double ratio = double(inputPeriod) / double(outputPeriod);
+  const size_t newFrames = size_t(std::floor(double(frames) / ratio));
+  std::vector<float> resampled(channels * newFrames);
+  std::vector<float> input;
+  for (size_t c = 0; c < channels; ++c)
+  {
+    Resampler resampler(Resampler::Quality::kHigh, float(std::max(ratio, 1.)));
+    const long latency = long(resampler.getLatency());
+    const long periods = (latency + inputPeriod - 1) / inputPeriod;
+    const size_t leadIn = size_t(periods * inputPeriod - latency);
+    const size_t skip = size_t(periods * outputPeriod);
+
+    input.assign(leadIn + frames, 0.f);
+    for (size_t i = 0; i < frames; ++i)
+    {
+      input[leadIn + i] = sample.sampleData[i * channels + c];
+    }
+
+    size_t inputPos{0};
+    for (size_t out = 0; out < skip + newFrames; out += kFloatsPerDSPVector)
+    {
+      const size_t needed = resampler.getInputNeeded(ratio);
+      if (inputPos + needed > input.size()) input.resize(inputPos + needed, 0.f);
+      DSPVector y = resampler(input.data() + inputPos, ratio);
+      inputPos += needed;
+      for (size_t n = 0; n < kFloatsPerDSPVector; ++n)
+      {
+        const size_t frame = out + n;
+        if ((frame >= skip) && (frame < skip + newFrames))
+        {
+          resampled[(frame - skip) * channels + c] = y[n];
+        }
+      }
+    }
+  }
+  sample.sampleData.assign(resampled.begin(), resampled.end());
+  sample.sampleRate = size_t(newRate);
+  return true;
+}
+
+}  // namespace ml
@@ -0,0 +1,118 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// ResourceLoader: load samples, impulse responses, wavetables and the like on worker threads,
+// so that the main thread never waits for the disk.
+//
+// Requests are jobs with a priority. Worker threads run the highest priority jobs first, and
+// jobs of the same priority in the order they were requested. Jobs still waiting can be
+// cancelled. A job does its own file I/O, decoding and resampling, then hands the result on:
+// the helpers below store samples in a SamplePool and tell an Actor with a message, or publish
+// objects to the audio thread through an RCUPointer.
+//
+// readWavFile() decodes a WAV file into a Sample, converting its sample rate if asked.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MLPath.h"
+#include "MLRCU.h"
+#include "MLSamplePool.h"
+
+namespace ml
+{
+class ResourceLoader
+{
+ public:
+  using Job = std::function<void()>;
+  using SampleDoneFn = std::function<void(SamplePool::SamplePtr)>;
+
+  static constexpr int kLowPriority{-1};
+  static constexpr int kNormalPriority{0};
+  static constexpr int kHighPriority{1};
+
+  explicit ResourceLoader(size_t threads = 2);
+
+  // jobs still waiting are dropped. Running jobs are finished first.
+  ~ResourceLoader();
+
+  ResourceLoader(const ResourceLoader&) = delete;
+  ResourceLoader& operator=(const ResourceLoader&) = delete;
+
+  // queue a job, returning its ID. Can be called from any thread, including from jobs.
+  uint64_t request(Job job, int priority = kNormalPriority);
+
+  // drop a job that hasn't started, returning true if it was waiting.
+  bool cancel(uint64_t id);
+
+  // wait until no jobs are waiting or running.
+  void waitUntilIdle();
+
+  size_t getNumWaiting();
+
+  // load a WAV file at a sample rate into the pool, which must outlive the loader, unless it is
+  // there already. done() is called on a worker thread with the sample, or nullptr if the file
+  // can't be read.
+  uint64_t requestSample(SamplePool& pool, const std::string& path, double sampleRate,
+                         SampleDoneFn done, int priority = kNormalPriority);
+
+  // load a sample as above and send the named Actor a message to the address. Its value is the
+  // sample's key in the pool, for SamplePool::find(), or empty if the file can't be read.
+  uint64_t requestSample(SamplePool& pool, const std::string& path, double sampleRate,
+                         Path actorName, Path address, int priority = kNormalPriority);
+
+  // the key under which requestSample() stores a file at a sample rate.
+  static std::string getSampleKey(const std::string& path, double sampleRate);
+
+  // make an object with loadFn and publish it, if not null, to the RCUPointer, which must
+  // outlive the loader. done(), if given, is called afterwards with whether it was published.
+  template <class T>
+  uint64_t requestPublish(std::function<std::unique_ptr<T>()> loadFn, RCUPointer<T>& dest,
+                          std::function<void(bool)> done = nullptr,
+                          int priority = kNormalPriority)
+  {
+    return request(
+        [loadFn = std::move(loadFn), &dest, done = std::move(done)]()
+        {
+          std::unique_ptr<T> object = loadFn();
+          const bool loaded = (object != nullptr);
+          if (loaded) dest.publish(std::move(object));
+          if (done) done(loaded);
+        },
+        priority);
+  }
+
+  // decode a WAV file into a sample. If sampleRate is nonzero and not the file's sample rate,
+  // the sample is resampled to it. Returns false if the file can't be read.
+  static bool readWavFile(const char* path, Sample& sample, double sampleRate = 0.);
+
+ private:
+  struct Request
+  {
+    uint64_t id;
+    int priority;
+    Job job;
+  };
+
+  void runWorker();
+
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable workAvailable_;
+  std::condition_variable idle_;
+  std::vector<Request> waiting_;
+  uint64_t nextID_{1};
+  size_t running_{0};
+  bool stopRequested_{false};
+};
+
+}  // namespace ml
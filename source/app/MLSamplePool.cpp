@@ -0,0 +1,198 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLSamplePool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+#include "MLHash.h"
+
+namespace ml
+{
+SamplePool::SamplePtr SamplePool::find(const std::string& key)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = byKey_.find(key);
+  if (it == byKey_.end()) return nullptr;
+  entries_.splice(entries_.begin(), entries_, it->second);
+  return it->second->sample;
+}
+
+SamplePool::SamplePtr SamplePool::load(const std::string& key, const LoadFn& loadFn)
+{
+  if (auto s = find(key)) return s;
+
+  Sample sample;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ml::setBufferPolicy(sample, policy_);
+  }
+  if (!loadFn(sample)) return nullptr;
+
+  // if another thread stored the key while this one was loading, use what it stored.
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = byKey_.find(key);
+  if (it != byKey_.end())
+  {
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return it->second->sample;
+  }
+  return addLocked(key, std::move(sample));
+}
+
+SamplePool::SamplePtr SamplePool::add(const std::string& key, Sample&& sample)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return addLocked(key, std::move(sample));
+}
+
+void SamplePool::setBufferPolicy(const LargeBufferPolicy& policy)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  policy_ = policy;
+}
+
+void SamplePool::setMemoryBudget(size_t bytes)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  budget_ = bytes;
+  trimLocked(budget_);
+}
+
+size_t SamplePool::getMemoryBudget() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return budget_;
+}
+
+size_t SamplePool::getMemoryUsed() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return used_;
+}
+
+size_t SamplePool::getNumSamples() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_.size();
+}
+
+void SamplePool::trim()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  trimLocked(budget_);
+}
+
+void SamplePool::clear()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto it = entries_.begin(); it != entries_.end();)
+  {
+    auto e = it++;
+    if (e->sample.use_count() == 1) evictLocked(e);
+  }
+}
+
+uint64_t SamplePool::getContentHash(const Sample& s)
+{
+  const char* p = reinterpret_cast<const char*>(s.sampleData.data());
+  uint64_t h = textHashRuntime(p, s.sampleData.size() * sizeof(float));
+  return h ^ detail::mix(s.channels ^ textHashConsts::k1, s.sampleRate ^ textHashConsts::k2);
+}
+
+// compare the bits of the data, so that for example NaNs match themselves.
+bool SamplePool::sameContent(const Sample& a, const Sample& b)
+{
+  return (a.channels == b.channels) && (a.sampleRate == b.sampleRate) &&
+         (a.sampleData.size() == b.sampleData.size()) &&
+         !memcmp(a.sampleData.data(), b.sampleData.data(), a.sampleData.size() * sizeof(float));
+}
+
+SamplePool::SamplePtr SamplePool::addLocked(const std::string& key, Sample&& sample)
+{
+  auto keyIt = byKey_.find(key);
+  if ((keyIt != byKey_.end()) && sameContent(*keyIt->second->sample, sample))
+  {
+    entries_.splice(entries_.begin(), entries_, keyIt->second);
+    return keyIt->second->sample;
+  }
+  removeKeyLocked(key);
+
+  // share an identical sample if there is one.
+  const uint64_t h = getContentHash(sample);
+  auto range = byHash_.equal_range(h);
+  for (auto it = range.first; it != range.second; ++it)
+  {
+    if (sameContent(*it->second->sample, sample))
+    {
+      EntryList::iterator e = it->second;
+      e->keys.push_back(key);
+      byKey_[key] = e;
+      entries_.splice(entries_.begin(), entries_, e);
+      return e->sample;
+    }
+  }
+
+  const size_t bytes = sample.sampleData.size() * sizeof(float);
+  entries_.push_front(Entry{std::make_shared<const Sample>(std::move(sample)), h, bytes, {key}});
+  byKey_[key] = entries_.begin();
+  byHash_.emplace(h, entries_.begin());
+  used_ += bytes;
+
+  // hold the new sample while trimming so that it stays.
+  SamplePtr result = entries_.front().sample;
+  trimLocked(budget_);
+  return result;
+}
+
+void SamplePool::removeKeyLocked(const std::string& key)
+{
+  auto keyIt = byKey_.find(key);
+  if (keyIt == byKey_.end()) return;
+
+  // an entry left without keys stays until it is unused and evicted.
+  auto& keys = keyIt->second->keys;
+  keys.erase(std::remove(keys.begin(), keys.end(), key), keys.end());
+  byKey_.erase(keyIt);
+}
+
+void SamplePool::evictLocked(EntryList::iterator e)
+{
+  for (const auto& key : e->keys)
+  {
+    byKey_.erase(key);
+  }
+  auto range = byHash_.equal_range(e->hash);
+  for (auto it = range.first; it != range.second; ++it)
+  {
+    if (it->second == e)
+    {
+      byHash_.erase(it);
+      break;
+    }
+  }
+  used_ -= e->bytes;
+  entries_.erase(e);
+}
+
+void SamplePool::trimLocked(size_t budget)
+{
+  // the pool's own pointer is the only one to a sample that is not in use.
+  for (auto it = entries_.end(); (used_ > budget) && (it != entries_.begin());)
+  {
+    auto e = std::prev(it);
+    if (e->sample.use_count() == 1)
+    {
+      evictLocked(e);
+    }
+    else
+    {
+      it = e;
+    }
+  }
+}
+
+}  // namespace ml
@@ -0,0 +1,107 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// SamplePool: a cache of immutable Samples that can be shared by everything in a process that
+// uses the same sample data, such as several instances of one plugin.
+//
+// Samples are stored under keys, typically file paths, and handed out as shared pointers to
+// const Samples. Samples with identical contents are stored once, even under different keys.
+// When the memory used is over a budget, the least recently used samples that no one else holds
+// are evicted. Samples in use are never evicted.
+//
+// To share one pool with the rest of the process, use a SharedResourcePointer<SamplePool>.
+// All the functions are thread safe. They lock the pool, and so are not for the audio thread.
+// The audio thread can drop a SamplePtr without freeing the sample there by disposing of it
+// with a TrashQueue.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "MLDSPSample.h"
+
+namespace ml
+{
+class SamplePool
+{
+ public:
+  using SamplePtr = std::shared_ptr<const Sample>;
+  using LoadFn = std::function<bool(Sample&)>;
+
+  static constexpr size_t kDefaultMemoryBudget{size_t(1) << 30};
+
+  SamplePool() = default;
+  ~SamplePool() = default;
+
+  SamplePool(const SamplePool&) = delete;
+  SamplePool& operator=(const SamplePool&) = delete;
+
+  // get the sample stored under key, or nullptr if there is none.
+  SamplePtr find(const std::string& key);
+
+  // get the sample stored under key, or if there is none, make it with loadFn and store it.
+  // The pool is not locked while loading, so other threads can use it in the meantime. Returns
+  // nullptr if loadFn returns false.
+  SamplePtr load(const std::string& key, const LoadFn& loadFn);
+
+  // store a sample under key, replacing any sample stored under it before. If an identical
+  // sample is in the pool already, the sample is dropped and the one in the pool returned.
+  SamplePtr add(const std::string& key, Sample&& sample);
+
+  // set the number of bytes of sample data to keep, evicting unused samples to get under it.
+  void setMemoryBudget(size_t bytes);
+  size_t getMemoryBudget() const;
+
+  // the bytes of sample data stored, including samples in use, and the number of samples.
+  size_t getMemoryUsed() const;
+  size_t getNumSamples() const;
+
+  // evict unused samples, least recently used first, until the memory used is under budget.
+  void trim();
+
+  // evict all unused samples.
+  void clear();
+
+  // allocate the data of samples loaded from now on following the policy, for example to
+  // place it on the NUMA node of the threads playing it.
+  void setBufferPolicy(const LargeBufferPolicy& policy);
+
+ private:
+  struct Entry
+  {
+    SamplePtr sample;
+    uint64_t hash;
+    size_t bytes;
+    std::vector<std::string> keys;
+  };
+  using EntryList = std::list<Entry>;
+
+  static uint64_t getContentHash(const Sample& s);
+  static bool sameContent(const Sample& a, const Sample& b);
+
+  SamplePtr addLocked(const std::string& key, Sample&& sample);
+  void removeKeyLocked(const std::string& key);
+  void evictLocked(EntryList::iterator it);
+  void trimLocked(size_t budget);
+
+  mutable std::mutex mutex_;
+
+  // entries, most recently used first.
+  EntryList entries_;
+  std::unordered_map<std::string, EntryList::iterator> byKey_;
+  std::unordered_multimap<uint64_t, EntryList::iterator> byHash_;
+
+  size_t budget_{kDefaultMemoryBudget};
+  size_t used_{0};
+  LargeBufferPolicy policy_;
+};
+
+}  // namespace ml
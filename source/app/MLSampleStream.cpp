@@ -0,0 +1,363 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLSampleStream.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+
+#if ML_MAC || ML_IOS || ML_LINUX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ml
+{
+namespace
+{
+// generations are stored as floats in the ring buffers, so they are kept exact.
+constexpr uint32_t kGenerationMask{(1 << 24) - 1};
+}  // namespace
+
+// MappedFile
+
+bool MappedFile::open(const char* path)
+{
+  close();
+
+#if ML_WINDOWS
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file != INVALID_HANDLE_VALUE)
+  {
+    LARGE_INTEGER fileSize;
+    HANDLE mapping = nullptr;
+    if (GetFileSizeEx(file, &fileSize) && (fileSize.QuadPart > 0))
+    {
+      mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    }
+    void* p = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (p)
+    {
+      fileHandle_ = file;
+      mappingHandle_ = mapping;
+      data_ = static_cast<const uint8_t*>(p);
+      size_ = size_t(fileSize.QuadPart);
+      mapped_ = true;
+      return true;
+    }
+    if (mapping) CloseHandle(mapping);
+    CloseHandle(file);
+  }
+#elif ML_MAC || ML_IOS || ML_LINUX
+  int fd = ::open(path, O_RDONLY);
+  if (fd >= 0)
+  {
+    struct stat st;
+    void* p = MAP_FAILED;
+    if ((fstat(fd, &st) == 0) && (st.st_size > 0))
+    {
+      p = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+
+    // the mapping keeps the file open.
+    ::close(fd);
+    if (p != MAP_FAILED)
+    {
+      madvise(p, size_t(st.st_size), MADV_SEQUENTIAL);
+      data_ = static_cast<const uint8_t*>(p);
+      size_ = size_t(st.st_size);
+      mapped_ = true;
+      return true;
+    }
+  }
+#endif
+
+  // where the file can't be mapped, read it all in.
+  std::ifstream file(path, std::ios::binary);
+  if (!file) return false;
+  contents_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  if (contents_.empty()) return false;
+  data_ = contents_.data();
+  size_ = contents_.size();
+  return true;
+}
+
+void MappedFile::close()
+{
+  if (mapped_)
+  {
+#if ML_WINDOWS
+    UnmapViewOfFile(data_);
+    CloseHandle(mappingHandle_);
+    CloseHandle(fileHandle_);
+    fileHandle_ = mappingHandle_ = nullptr;
+#elif ML_MAC || ML_IOS || ML_LINUX
+    munmap(const_cast<uint8_t*>(data_), size_);
+#endif
+  }
+  std::vector<uint8_t>().swap(contents_);
+  data_ = nullptr;
+  size_ = 0;
+  mapped_ = false;
+}
+
+// StreamingSample
+
+bool StreamingSample::open(const char* path, size_t headFrames)
+{
+  close();
+  if (!file_.open(path)) return false;
+  if (!parseWavFile(file_.data(), file_.size(), info_))
+  {
+    close();
+    return false;
+  }
+
+  headFrames_ = std::min(headFrames, info_.frames);
+  head_.resize(headFrames_ * info_.channels);
+  readFrames(0, headFrames_, head_.data());
+  return true;
+}
+
+void StreamingSample::close()
+{
+  file_.close();
+  info_ = WavFileInfo();
+  headFrames_ = 0;
+  std::vector<float>().swap(head_);
+}
+
+void StreamingSample::readFrames(size_t start, size_t frames, float* pDest) const
+{
+  readWavFrames(info_, start, frames, pDest);
+}
+
+// SampleStreamer
+
+// the ring buffer of each voice holds whole chunks, each a generation number followed by
+// kChunkFrames interleaved frames of the sample. The generation changes each time the voice
+// starts, so the reader can recognize and drop chunks prefetched for what it played before.
+struct SampleStreamer::Voice
+{
+  DSPBuffer ring;
+
+  // the latest start, written by the audio thread.
+  std::atomic<uint32_t> requestGeneration{0};
+  std::atomic<const StreamingSample*> requestSample{nullptr};
+  std::atomic<size_t> requestFrame{0};
+
+  // prefetch thread state: the next frame to put in the ring.
+  uint32_t fillGeneration{0};
+  const StreamingSample* fillSample{nullptr};
+  size_t fillFrame{0};
+
+  // audio thread state: the next frame to play, and the chunk being played from.
+  uint32_t generation{0};
+  const StreamingSample* sample{nullptr};
+  size_t position{0};
+  std::vector<float> chunk;
+  size_t chunkPosition{0};
+  size_t chunkFrames{0};
+};
+
+SampleStreamer::SampleStreamer(size_t voices, size_t maxChannels, size_t bufferFrames)
+    : maxChannels_(std::max(maxChannels, size_t(1))),
+      chunkSize_(1 + kChunkFrames * maxChannels_),
+      prefetchChunk_(chunkSize_)
+{
+  const size_t chunks = std::max(bufferFrames / kChunkFrames, size_t(2));
+  for (size_t i = 0; i < voices; ++i)
+  {
+    voices_.emplace_back(new Voice);
+    voices_.back()->ring.resize(int(chunks * chunkSize_));
+    voices_.back()->chunk.resize(kChunkFrames * maxChannels_);
+  }
+}
+
+SampleStreamer::~SampleStreamer() { stop(); }
+
+void SampleStreamer::start(int intervalMs)
+{
+  if (thread_.joinable()) return;
+  stopRequested_ = false;
+  const auto interval = std::chrono::milliseconds(std::max(intervalMs, 1));
+  thread_ = std::thread(
+      [this, interval]()
+      {
+        std::unique_lock<std::mutex> lock(threadMutex_);
+        while (!stopRequested_)
+        {
+          lock.unlock();
+          prefetch();
+          lock.lock();
+          threadCondition_.wait_for(lock, interval, [this]() { return stopRequested_; });
+        }
+      });
+}
+
+void SampleStreamer::stop()
+{
+  if (!thread_.joinable()) return;
+  {
+    std::lock_guard<std::mutex> lock(threadMutex_);
+    stopRequested_ = true;
+  }
+  threadCondition_.notify_one();
+  thread_.join();
+}
+
+size_t SampleStreamer::prefetch()
+{
+  // take turns between the voices so that one long file doesn't keep the others waiting.
+  size_t chunks{0};
+  for (bool progress = true; progress;)
+  {
+    progress = false;
+    for (auto& v : voices_)
+    {
+      if (fillVoice(*v))
+      {
+        progress = true;
+        chunks++;
+      }
+    }
+  }
+  return chunks;
+}
+
+bool SampleStreamer::fillVoice(Voice& v)
+{
+  // a start that is read partly before and partly after it is written only tags chunks with
+  // the previous generation, which the reader drops.
+  const uint32_t g = v.requestGeneration.load(std::memory_order_acquire);
+  if (g != v.fillGeneration)
+  {
+    v.fillGeneration = g;
+    v.fillSample = v.requestSample.load(std::memory_order_relaxed);
+    v.fillFrame = v.requestFrame.load(std::memory_order_relaxed);
+  }
+
+  const StreamingSample* s = v.fillSample;
+  if (!s || (v.fillFrame >= s->getFrames())) return false;
+  if (v.ring.getWriteAvailable() < chunkSize_) return false;
+
+  const size_t frames = std::min(kChunkFrames, s->getFrames() - v.fillFrame);
+  const size_t samples = frames * s->getChannels();
+  prefetchChunk_[0] = float(g);
+  s->readFrames(v.fillFrame, frames, prefetchChunk_.data() + 1);
+  std::fill(prefetchChunk_.begin() + 1 + samples, prefetchChunk_.end(), 0.f);
+  v.ring.write(prefetchChunk_.data(), chunkSize_);
+  v.fillFrame += frames;
+  return true;
+}
+
+void SampleStreamer::startVoice(size_t voice, const StreamingSample* sample, size_t startFrame)
+{
+  Voice& v = *voices_[voice];
+  if (sample && !sample->isOpen()) sample = nullptr;
+
+  v.generation = (v.generation + 1) & kGenerationMask;
+  v.sample = sample;
+  v.position = sample ? std::min(startFrame, sample->getFrames()) : 0;
+  v.chunkPosition = v.chunkFrames = 0;
+
+  // drop what was prefetched before. At most one more chunk of it can arrive after this.
+  v.ring.discard(v.ring.getReadAvailable());
+
+  // the ring starts after the head, or at the start frame if that is later.
+  const size_t fillFrame = sample ? std::max(v.position, sample->getHeadFrames()) : 0;
+  v.requestSample.store(sample, std::memory_order_relaxed);
+  v.requestFrame.store(fillFrame, std::memory_order_relaxed);
+  v.requestGeneration.store(v.generation, std::memory_order_release);
+}
+
+void SampleStreamer::stopVoice(size_t voice) { startVoice(voice, nullptr); }
+
+bool SampleStreamer::nextChunk(Voice& v)
+{
+  while (v.ring.getReadAvailable() >= chunkSize_)
+  {
+    float tag{0.f};
+    v.ring.read(&tag, 1);
+    if (uint32_t(tag) == v.generation)
+    {
+      v.ring.read(v.chunk.data(), chunkSize_ - 1);
+      v.chunkPosition = 0;
+      v.chunkFrames = std::min(kChunkFrames, v.sample->getFrames() - v.position);
+      return true;
+    }
+    v.ring.discard(chunkSize_ - 1);
+  }
+  return false;
+}
+
+size_t SampleStreamer::readVoice(size_t voice, float* const* pDest, size_t frames)
+{
+  Voice& v = *voices_[voice];
+  const StreamingSample* s = v.sample;
+  const size_t sampleChannels = s ? size_t(s->getChannels()) : 0;
+  const size_t channels = std::min(sampleChannels, maxChannels_);
+
+  size_t done{0};
+  while (s && (done < frames) && (v.position < s->getFrames()))
+  {
+    const float* pSrc;
+    size_t n;
+    if (v.position < s->getHeadFrames())
+    {
+      pSrc = s->getHead() + v.position * sampleChannels;
+      n = std::min(frames - done, s->getHeadFrames() - v.position);
+    }
+    else
+    {
+      if ((v.chunkPosition == v.chunkFrames) && !nextChunk(v))
+      {
+        underruns_.store(underruns_.load(std::memory_order_relaxed) + 1,
+                         std::memory_order_relaxed);
+        break;
+      }
+      pSrc = v.chunk.data() + v.chunkPosition * sampleChannels;
+      n = std::min(frames - done, v.chunkFrames - v.chunkPosition);
+      v.chunkPosition += n;
+    }
+
+    for (size_t c = 0; c < channels; ++c)
+    {
+      float* pOut = pDest[c] + done;
+      for (size_t i = 0; i < n; ++i)
+      {
+        pOut[i] = pSrc[i * sampleChannels + c];
+      }
+    }
+    done += n;
+    v.position += n;
+  }
+
+  for (size_t c = 0; c < maxChannels_; ++c)
+  {
+    const size_t first = (c < channels) ? done : 0;
+    std::fill(pDest[c] + first, pDest[c] + frames, 0.f);
+  }
+  return done;
+}
+
+bool SampleStreamer::isVoicePlaying(size_t voice) const
+{
+  const Voice& v = *voices_[voice];
+  return v.sample && (v.position < v.sample->getFrames());
+}
+
+size_t SampleStreamer::getVoiceBufferedFrames(size_t voice) const
+{
+  const Voice& v = *voices_[voice];
+  return (v.ring.getReadAvailable() / chunkSize_) * kChunkFrames + v.chunkFrames -
+         v.chunkPosition;
+}
+
+}  // namespace ml
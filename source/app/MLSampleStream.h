@@ -0,0 +1,156 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// Disk streaming sample playback, for sample libraries too big to load into memory.
+//
+// A StreamingSample maps a WAV file into memory and converts only its first frames, the head,
+// to floats that stay resident. The rest of the file is paged in by the OS as it is read.
+//
+// A SampleStreamer plays StreamingSamples on a fixed number of voices. Each voice plays the
+// head straight from memory while a background prefetch thread reads the frames after it from
+// the mapped file into the voice's lock-free ring buffer, so the audio thread never waits for
+// the disk. If the prefetch thread falls behind, the voice is silent until the data arrive,
+// and the underrun is counted.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "MLDSPBuffer.h"
+#include "MLPlatform.h"
+#include "MLWavFile.h"
+
+namespace ml
+{
+// MappedFile: a read-only view of a whole file. The file is memory-mapped where the OS allows,
+// and read into memory otherwise.
+
+class MappedFile
+{
+ public:
+  MappedFile() = default;
+  ~MappedFile() { close(); }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  // map the file at path. Returns false if it can't be opened or is empty.
+  bool open(const char* path);
+  void close();
+
+  const uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  const uint8_t* data_{nullptr};
+  size_t size_{0};
+  bool mapped_{false};
+  std::vector<uint8_t> contents_;
+#if ML_WINDOWS
+  void* fileHandle_{nullptr};
+  void* mappingHandle_{nullptr};
+#endif
+};
+
+class StreamingSample
+{
+ public:
+  static constexpr size_t kDefaultHeadFrames{32768};
+
+  // open a WAV file and make its first headFrames frames resident. Returns false if the file
+  // can't be read.
+  bool open(const char* path, size_t headFrames = kDefaultHeadFrames);
+  void close();
+
+  bool isOpen() const { return file_.data() != nullptr; }
+  int getChannels() const { return info_.channels; }
+  int getSampleRate() const { return info_.sampleRate; }
+  size_t getFrames() const { return info_.frames; }
+  size_t getHeadFrames() const { return headFrames_; }
+
+  // the resident head, as interleaved frames.
+  const float* getHead() const { return head_.data(); }
+
+  // convert frames from the file to interleaved floats. This reads the mapped file, and so may
+  // wait for the disk: it is for the prefetch thread, not the audio thread.
+  void readFrames(size_t start, size_t frames, float* pDest) const;
+
+ private:
+  MappedFile file_;
+  WavFileInfo info_;
+  size_t headFrames_{0};
+  std::vector<float> head_;
+};
+
+class SampleStreamer
+{
+ public:
+  // the prefetch thread moves frames into the ring buffers in chunks of this many frames.
+  static constexpr size_t kChunkFrames{1024};
+
+  // make voices that can play samples of up to maxChannels channels, each with a ring buffer
+  // of at least bufferFrames frames.
+  SampleStreamer(size_t voices, size_t maxChannels, size_t bufferFrames = 16 * kChunkFrames);
+  ~SampleStreamer();
+
+  SampleStreamer(const SampleStreamer&) = delete;
+  SampleStreamer& operator=(const SampleStreamer&) = delete;
+
+  // start and stop the prefetch thread, which fills the buffers every intervalMs
+  // milliseconds. The buffers should hold a few intervals of frames.
+  void start(int intervalMs = 2);
+  void stop();
+
+  // fill the buffers of all the playing voices as far as they have room. This is what the
+  // prefetch thread does, and can also be called from one other thread when it is not running.
+  // Returns the number of chunks written.
+  size_t prefetch();
+
+  // the voice functions below are for the audio thread only.
+
+  // start playing a sample on a voice from startFrame, replacing anything it was playing.
+  // Starting within the head plays at once; starting after it waits for the prefetch. The
+  // sample must stay open until the streamer is stopped or destroyed.
+  void startVoice(size_t voice, const StreamingSample* sample, size_t startFrame = 0);
+  void stopVoice(size_t voice);
+
+  // read the next frames of a voice to a pointer for each of maxChannels channels. Channels
+  // the sample doesn't have, frames after its end and frames not yet prefetched are silent.
+  // Returns the number of frames read from the sample.
+  size_t readVoice(size_t voice, float* const* pDest, size_t frames);
+
+  bool isVoicePlaying(size_t voice) const;
+  size_t getVoiceBufferedFrames(size_t voice) const;
+
+  size_t getNumVoices() const { return voices_.size(); }
+
+  // the number of reads that ran out of prefetched frames.
+  size_t getUnderrunCount() const { return underruns_.load(std::memory_order_relaxed); }
+
+ private:
+  struct Voice;
+
+  bool fillVoice(Voice& v);
+  bool nextChunk(Voice& v);
+
+  size_t maxChannels_;
+  size_t chunkSize_;
+  std::vector<std::unique_ptr<Voice>> voices_;
+  std::vector<float> prefetchChunk_;
+
+  std::thread thread_;
+  std::mutex threadMutex_;
+  std::condition_variable threadCondition_;
+  bool stopRequested_{false};
+
+  std::atomic<size_t> underruns_{0};
+};
+
+}  // namespace ml
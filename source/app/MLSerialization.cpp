@@ -4,9 +4,15 @@
 
 // converters to/from binary and text formats for various objects.
 
+#include <algorithm>
+#include <cctype>
 #include <cmath>
+#include <clocale>
+#include <cstdio>
 #include <cstdlib>
 #include <iostream>
+#include <iterator>
+#include <limits>
 #include <list>
 #include <map>
 #include <numeric>
@@ -67,7 +73,7 @@ static_assert((2 << ValueBinaryHeader::kTypeBits) >= Value::kNumTypes);
 
 size_t getBinarySize(const Value& v) { return sizeof(ValueBinaryHeader) + v.size(); }
 
-std::vector<uint8_t> valueToBinary(Value v)
+std::vector<uint8_t> valueToBinary(const Value& v)
 {
   // allocate vector and setup pointer
   std::vector<uint8_t> result;
@@ -84,7 +90,7 @@ std::vector<uint8_t> valueToBinary(Value v)
   return result;
 }
 
-void writeValueToBinary(Value v, uint8_t*& writePtr)
+void writeValueToBinary(const Value& v, uint8_t*& writePtr)
 {
   // write header
   ValueBinaryHeader header{v.getType(), v.size()};
@@ -121,15 +127,6 @@ Value binaryToValue(const std::vector<uint8_t>& dataVec)
 
 // Paths
 
-template <class K>
-size_t getBinarySize(GenericPath<K> p)
-{
-  auto t = p.toText('/');
-  auto headerSize = sizeof(BinaryChunkHeader);
-  auto dataSize = t.lengthInBytes();
-  return headerSize + dataSize;
-}
-
 Path readPathFromBinary(const uint8_t*& readPtr)
 {
   Path r;
@@ -148,81 +145,87 @@ Path readPathFromBinary(const uint8_t*& readPtr)
   return r;
 }
 
-// write the binary representation of the Path and increment the destination pointer.
-template <class K>
-void writeBinaryRepresentation(const GenericPath<K>& p, uint8_t*& writePtr)
+// size of the path text, as made by toText(), without making the text.
+static size_t getPathTextBytes(const Path& p)
 {
-  auto t = p.toText('/');
-  auto headerSize = sizeof(BinaryChunkHeader);
-  auto dataSize = t.lengthInBytes();
-
-  // write header
-  BinaryChunkHeader header{kPathType, (unsigned int)dataSize};
-  memcpy(writePtr, &header, headerSize);
-  writePtr += headerSize;
+  size_t n = p.getSize();
+  size_t bytes = n ? n - 1 : 0;
+  for (size_t i = 0; i < n; ++i)
+  {
+    bytes += p.getElement(i).getTextFragment().lengthInBytes();
+  }
+  return bytes;
+}
 
-  // data
-  const uint8_t* textData = (uint8_t*)t.getText();
-  memcpy(writePtr, textData, dataSize);
-  writePtr += dataSize;
+// write the path as a chunk without making its text.
+static void writePathToBinary(const Path& p, uint8_t*& writePtr)
+{
+  BinaryChunkHeader header{kPathType, getPathTextBytes(p)};
+  memcpy(writePtr, &header, sizeof(BinaryChunkHeader));
+  writePtr += sizeof(BinaryChunkHeader);
+  for (int i = 0; i < p.getSize(); ++i)
+  {
+    if (i > 0) *writePtr++ = '/';
+    const TextFragment& segment = p.getElement(i).getTextFragment();
+    memcpy(writePtr, segment.getText(), segment.lengthInBytes());
+    writePtr += segment.lengthInBytes();
+  }
 }
 
 // Tree< Value >
 
-std::vector<unsigned char> valueTreeToBinary(const Tree<Value>& t)
+size_t getBinarySize(const Tree<Value>& t)
 {
-  std::vector<uint8_t> returnVector;
-  constexpr size_t headerSize = sizeof(BinaryGroupHeader);
+  size_t totalSize{sizeof(BinaryGroupHeader) * 2};
+  t.visitValues([&](const Path& p, const Value& v) {
+    totalSize += sizeof(BinaryChunkHeader) + getPathTextBytes(p) + getBinarySize(v);
+  });
+  return totalSize;
+}
 
-  // calculate size
-  size_t totalSize{sizeof(BinaryGroupHeader)};
-  for (auto it = t.begin(); it != t.end(); ++it)
-  {
-    totalSize += getBinarySize(it.getCurrentPath());
-    totalSize += getBinarySize(*it);
-  }
-  totalSize += headerSize * 2;
-  returnVector.resize(totalSize);
+size_t writeValueTreeToBinary(const Tree<Value>& t, uint8_t* dest, size_t destSize)
+{
+  constexpr size_t headerSize = sizeof(BinaryGroupHeader);
+  size_t totalSize = getBinarySize(t);
+  if (!dest || (destSize < totalSize)) return 0;
 
   // advance past two headers, which we will fill in later
-  uint8_t* writePtr = returnVector.data() + headerSize * 2;
-
-  // use iterator to serialize tree
+  uint8_t* writePtr = dest + headerSize * 2;
   size_t elements{0};
-  for (auto it = t.begin(); it != t.end(); ++it)
-  {
-    // add path
-    writeBinaryRepresentation(it.getCurrentPath(), writePtr);
-
-    // add value
-    writeValueToBinary((*it), writePtr);
-
+  t.visitValues([&](const Path& p, const Value& v) {
+    writePathToBinary(p, writePtr);
+    writeValueToBinary(v, writePtr);
     elements++;
-  }
+  });
 
-  // write version header
-  writePtr = returnVector.data();
-  BinaryGroupHeader* versionHeader{reinterpret_cast<BinaryGroupHeader*>(writePtr)};
-  *versionHeader = kBinaryGroupHeaderV2;
-  writePtr += headerSize;
+  // write version header and main header
+  BinaryGroupHeader mainHeader{elements, totalSize};
+  memcpy(dest, &kBinaryGroupHeaderV2, headerSize);
+  memcpy(dest + headerSize, &mainHeader, headerSize);
+  return totalSize;
+}
 
-  // write main header
-  BinaryGroupHeader* mainHeader{reinterpret_cast<BinaryGroupHeader*>(writePtr)};
-  mainHeader->elements = elements;
-  mainHeader->size = returnVector.size();
+void valueTreeToBinary(const Tree<Value>& t, std::vector<uint8_t>& buffer)
+{
+  buffer.resize(getBinarySize(t));
+  writeValueTreeToBinary(t, buffer.data(), buffer.size());
+}
 
+std::vector<unsigned char> valueTreeToBinary(const Tree<Value>& t)
+{
+  std::vector<uint8_t> returnVector;
+  valueTreeToBinary(t, returnVector);
   return returnVector;
 }
 
-Tree<Value> binaryToValueTreeNew(const std::vector<uint8_t>& binaryData)
+Tree<Value> binaryToValueTreeNew(const uint8_t* pData, size_t inputSize)
 {
   Tree<Value> outputTree;
-  const size_t inputSize = binaryData.size();
   constexpr size_t headerSize = sizeof(BinaryGroupHeader);
 
   if (inputSize > headerSize * 2)
   {
-    const uint8_t* readPtr = binaryData.data();
+    const uint8_t* readPtr = pData;
     readPtr += headerSize;
     auto mainHeader{reinterpret_cast<const BinaryGroupHeader*>(readPtr)};
     auto elements = mainHeader->elements;
@@ -241,6 +244,214 @@ Tree<Value> binaryToValueTreeNew(const std::vector<uint8_t>& binaryData)
   return outputTree;
 }
 
+// Large binary format
+
+// the first 16 bytes can't be mistaken for a BinaryGroupHeader in another format.
+constexpr uint64_t kLargeBinaryVersion{3};
+constexpr uint64_t kMaxLargeBinaryPathBytes{1 << 16};
+
+struct LargeBinaryHeader
+{
+  uint64_t zero{0};
+  uint64_t version{kLargeBinaryVersion};
+  uint64_t elements{0};
+  uint64_t size{0};
+};
+
+struct LargeChunkHeader
+{
+  uint32_t type{0};
+  uint32_t reserved{0};
+  uint64_t dataBytes{0};
+};
+
+static_assert(sizeof(LargeBinaryHeader) % kLargeBinaryAlignment == 0);
+static_assert(sizeof(LargeChunkHeader) % kLargeBinaryAlignment == 0);
+
+// lets the large binary reader fill in Values without copying.
+struct ValueStreamAccess
+{
+  static Value makeUninitialized(unsigned int type, unsigned int bytes)
+  {
+    return Value(type, bytes, nullptr);
+  }
+  static uint8_t* data(Value& v) { return v.dataPtr_; }
+};
+
+static size_t getLargeChunkSize(size_t dataBytes)
+{
+  size_t paddedBytes = (dataBytes + kLargeBinaryAlignment - 1) & ~(kLargeBinaryAlignment - 1);
+  return sizeof(LargeChunkHeader) + paddedBytes;
+}
+
+size_t getLargeBinarySize(const Tree<Value>& t)
+{
+  size_t totalSize{sizeof(LargeBinaryHeader)};
+  t.visitValues([&](const Path& p, const Value& v) {
+    totalSize += getLargeChunkSize(getPathTextBytes(p)) + getLargeChunkSize(v.size());
+  });
+  return totalSize;
+}
+
+// write the tree to write(const void*, size_t), which returns false on failure.
+template <class WriteFn>
+static bool writeLargeBinary(const Tree<Value>& t, WriteFn&& write)
+{
+  static const uint8_t kPadding[kLargeBinaryAlignment]{};
+
+  LargeBinaryHeader header;
+  header.size = sizeof(LargeBinaryHeader);
+  t.visitValues([&](const Path& p, const Value& v) {
+    header.elements++;
+    header.size += getLargeChunkSize(getPathTextBytes(p)) + getLargeChunkSize(v.size());
+  });
+  if (!write(&header, sizeof(LargeBinaryHeader))) return false;
+
+  bool ok{true};
+  auto writeChunkHeader = [&](uint32_t type, size_t dataBytes) {
+    LargeChunkHeader chunkHeader{type, 0, dataBytes};
+    ok = ok && write(&chunkHeader, sizeof(LargeChunkHeader));
+  };
+  auto writePadding = [&](size_t dataBytes) {
+    size_t padding = getLargeChunkSize(dataBytes) - sizeof(LargeChunkHeader) - dataBytes;
+    ok = ok && write(kPadding, padding);
+  };
+
+  t.visitValues([&](const Path& p, const Value& v) {
+    // path, written a segment at a time
+    size_t pathBytes = getPathTextBytes(p);
+    writeChunkHeader(kPathType, pathBytes);
+    for (int i = 0; i < p.getSize(); ++i)
+    {
+      const TextFragment& segment = p.getElement(i).getTextFragment();
+      if (i > 0) ok = ok && write("/", 1);
+      ok = ok && write(segment.getText(), segment.lengthInBytes());
+    }
+    writePadding(pathBytes);
+
+    // value
+    writeChunkHeader(v.getType(), v.size());
+    ok = ok && write(v.data(), v.size());
+    writePadding(v.size());
+  });
+  return ok;
+}
+
+// read a tree from read(void*, size_t), which returns false on failure. remaining() returns
+// the number of bytes left to read. Sizes in the input are checked against it before anything
+// is allocated, so a corrupt header can't make us ask for gigabytes of memory.
+template <class ReadFn, class RemainingFn>
+static Tree<Value> readLargeBinary(ReadFn&& read, RemainingFn&& remaining)
+{
+  uint8_t padding[kLargeBinaryAlignment];
+  auto skipPadding = [&](size_t dataBytes) {
+    return read(padding, getLargeChunkSize(dataBytes) - sizeof(LargeChunkHeader) - dataBytes);
+  };
+
+  LargeBinaryHeader header;
+  if (!read(&header, sizeof(LargeBinaryHeader))) return Tree<Value>();
+  if ((header.zero != 0) || (header.version != kLargeBinaryVersion)) return Tree<Value>();
+  if (header.elements > remaining() / (2 * sizeof(LargeChunkHeader))) return Tree<Value>();
+
+  Tree<Value> outputTree;
+  std::vector<char> pathText;
+  for (uint64_t i = 0; i < header.elements; ++i)
+  {
+    LargeChunkHeader pathHeader;
+    if (!read(&pathHeader, sizeof(LargeChunkHeader))) return Tree<Value>();
+    if ((pathHeader.type != kPathType) || (pathHeader.dataBytes > kMaxLargeBinaryPathBytes) ||
+        (pathHeader.dataBytes > remaining()))
+    {
+      return Tree<Value>();
+    }
+    pathText.resize(pathHeader.dataBytes);
+    if (!read(pathText.data(), pathText.size()) || !skipPadding(pathText.size()))
+    {
+      return Tree<Value>();
+    }
+
+    // read the data straight into the new Value.
+    LargeChunkHeader valueHeader;
+    if (!read(&valueHeader, sizeof(LargeChunkHeader))) return Tree<Value>();
+    if ((valueHeader.type >= Value::kNumTypes) ||
+        (valueHeader.dataBytes > std::numeric_limits<uint32_t>::max()) ||
+        (valueHeader.dataBytes > remaining()))
+    {
+      return Tree<Value>();
+    }
+    auto valueBytes = static_cast<unsigned int>(valueHeader.dataBytes);
+    Value v = ValueStreamAccess::makeUninitialized(valueHeader.type, valueBytes);
+    if (v.size() != valueBytes) return Tree<Value>();
+    if (!read(ValueStreamAccess::data(v), valueBytes) || !skipPadding(valueBytes))
+    {
+      return Tree<Value>();
+    }
+
+    outputTree[runtimePath(TextFragment(pathText.data(), pathText.size()))] = std::move(v);
+  }
+  return outputTree;
+}
+
+std::vector<uint8_t> valueTreeToLargeBinary(const Tree<Value>& t)
+{
+  std::vector<uint8_t> returnVector;
+  returnVector.reserve(getLargeBinarySize(t));
+  writeLargeBinary(t, [&](const void* src, size_t bytes) {
+    auto p = static_cast<const uint8_t*>(src);
+    returnVector.insert(returnVector.end(), p, p + bytes);
+    return true;
+  });
+  return returnVector;
+}
+
+Tree<Value> largeBinaryToValueTree(const uint8_t* data, size_t size)
+{
+  if (!data) return Tree<Value>();
+  size_t readIndex{0};
+  return readLargeBinary(
+      [&](void* dest, size_t bytes) {
+        if (size - readIndex < bytes) return false;
+        memcpy(dest, data + readIndex, bytes);
+        readIndex += bytes;
+        return true;
+      },
+      [&]() { return size - readIndex; });
+}
+
+bool writeValueTreeToLargeBinary(const Tree<Value>& t, std::ostream& out)
+{
+  return writeLargeBinary(t, [&](const void* src, size_t bytes) {
+    out.write(static_cast<const char*>(src), static_cast<std::streamsize>(bytes));
+    return static_cast<bool>(out);
+  });
+}
+
+Tree<Value> readLargeBinaryToValueTree(std::istream& in)
+{
+  // find the length of the rest of the stream.
+  auto start = in.tellg();
+  in.seekg(0, std::ios::end);
+  auto end = in.tellg();
+  in.seekg(start);
+  if ((start == std::istream::pos_type(-1)) || (end == std::istream::pos_type(-1)) || !in)
+  {
+    // the stream can't seek, so read all of it in order to check sizes against it.
+    in.clear();
+    std::vector<uint8_t> data{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+    return largeBinaryToValueTree(data.data(), data.size());
+  }
+
+  size_t bytesLeft = static_cast<size_t>(end - start);
+  return readLargeBinary(
+      [&](void* dest, size_t bytes) {
+        if (bytesLeft < bytes) return false;
+        in.read(static_cast<char*>(dest), static_cast<std::streamsize>(bytes));
+        bytesLeft -= bytes;
+        return static_cast<size_t>(in.gcount()) == bytes;
+      },
+      [&]() { return bytesLeft; });
+}
+
 // deprecated code maintained for now to read older binaries of patches etc.
 
 Path binaryToPathOld(const uint8_t* p)
@@ -304,16 +515,15 @@ Value binaryToValueOld(const uint8_t* p)
   return returnValue;
 }
 
-Tree<Value> binaryToValueTreeOld(const std::vector<uint8_t>& binaryData)
+Tree<Value> binaryToValueTreeOld(const uint8_t* pData, size_t inputBytes)
 {
   Tree<Value> outputTree;
-  const uint8_t* pData{binaryData.data()};
-  if (binaryData.size() > sizeof(BinaryGroupHeader))
+  if (inputBytes > sizeof(BinaryGroupHeader))
   {
     BinaryGroupHeader groupHeader{*reinterpret_cast<const BinaryGroupHeader*>(pData)};
     size_t elements = groupHeader.elements;
     size_t size = groupHeader.size;
-    if (binaryData.size() >= size)
+    if (inputBytes >= size)
     {
       size_t idx{sizeof(BinaryGroupHeader)};
       for (int i = 0; i < elements; ++i)
@@ -351,26 +561,374 @@ Tree<Value> binaryToValueTreeOld(const std::vector<uint8_t>& binaryData)
 }
 
 Tree<Value> binaryToValueTree(const std::vector<uint8_t>& binaryData)
+{
+  return binaryToValueTree(binaryData.data(), binaryData.size());
+}
+
+Tree<Value> binaryToValueTree(const uint8_t* pData, size_t inputBytes)
 {
   Tree<Value> outputTree;
-  const uint8_t* pData{binaryData.data()};
-  size_t inputBytes = binaryData.size();
+  if (isCompressedData(pData, inputBytes))
+  {
+    std::vector<uint8_t> decompressed;
+    if (!decompressData(pData, inputBytes, decompressed)) return outputTree;
+
+    // a compressed container inside another is not a valid tree.
+    if (isCompressedData(decompressed.data(), decompressed.size())) return outputTree;
+    return binaryToValueTree(decompressed);
+  }
+
+  if (inputBytes >= sizeof(LargeBinaryHeader))
+  {
+    LargeBinaryHeader largeHeader;
+    memcpy(&largeHeader, pData, sizeof(LargeBinaryHeader));
+    if ((largeHeader.zero == 0) && (largeHeader.version == kLargeBinaryVersion))
+    {
+      return largeBinaryToValueTree(pData, inputBytes);
+    }
+  }
 
   if (inputBytes > sizeof(BinaryGroupHeader))
   {
     BinaryGroupHeader groupHeader{*reinterpret_cast<const BinaryGroupHeader*>(pData)};
     if (groupHeader == kBinaryGroupHeaderV2)
     {
-      outputTree = binaryToValueTreeNew(binaryData);
+      outputTree = binaryToValueTreeNew(pData, inputBytes);
     }
     else
     {
-      outputTree = binaryToValueTreeOld(binaryData);
+      outputTree = binaryToValueTreeOld(pData, inputBytes);
     }
   }
   return outputTree;
 }
 
+// Compressed binary Value trees
+
+std::vector<uint8_t> valueTreeToCompressedBinary(const Tree<Value>& t, size_t chunkBytes)
+{
+  std::vector<uint8_t> binary;
+  valueTreeToBinary(t, binary);
+  return compressData(binary.data(), binary.size(), chunkBytes);
+}
+
+// Value tree deltas
+
+std::vector<ValueChange> diffValueTrees(const Tree<Value>& before, const Tree<Value>& after)
+{
+  std::vector<ValueChange> changes;
+  after.visitValues([&](const Path& p, const Value& v) {
+    const Value& oldValue = before[p];
+    if (oldValue != v) changes.emplace_back(p, v, oldValue);
+  });
+  before.visitValues([&](const Path& p, const Value& v) {
+    if (!after[p]) changes.emplace_back(p, Value(), v);
+  });
+  return changes;
+}
+
+void applyValueChanges(Tree<Value>& t, const std::vector<ValueChange>& changes)
+{
+  for (const auto& c : changes)
+  {
+    t[c.name] = c.newValue;
+  }
+}
+
+void revertValueChanges(Tree<Value>& t, const std::vector<ValueChange>& changes)
+{
+  for (auto it = changes.rbegin(); it != changes.rend(); ++it)
+  {
+    t[it->name] = it->oldValue;
+  }
+}
+
+// "MLD1" in memory order
+constexpr uint32_t kBinaryDeltaTag{0x31444C4D};
+
+struct BinaryDeltaHeader
+{
+  uint32_t tag;
+  uint32_t flags;
+  uint64_t changes;
+  uint64_t size;
+};
+
+constexpr uint32_t kDeltaHasOldValues{1};
+constexpr uint8_t kChangeStartGesture{1};
+constexpr uint8_t kChangeEndGesture{2};
+
+std::vector<uint8_t> valueChangesToBinary(const std::vector<ValueChange>& changes,
+                                          bool includeOldValues)
+{
+  size_t totalSize{sizeof(BinaryDeltaHeader)};
+  for (const auto& c : changes)
+  {
+    totalSize += sizeof(BinaryChunkHeader) + getPathTextBytes(c.name) + 1;
+    totalSize += getBinarySize(c.newValue);
+    if (includeOldValues) totalSize += getBinarySize(c.oldValue);
+  }
+
+  std::vector<uint8_t> result(totalSize);
+  BinaryDeltaHeader header{kBinaryDeltaTag, includeOldValues ? kDeltaHasOldValues : 0,
+                           changes.size(), totalSize};
+  memcpy(result.data(), &header, sizeof(BinaryDeltaHeader));
+
+  uint8_t* writePtr = result.data() + sizeof(BinaryDeltaHeader);
+  for (const auto& c : changes)
+  {
+    writePathToBinary(c.name, writePtr);
+    *writePtr++ = (c.startGesture ? kChangeStartGesture : 0) |
+                  (c.endGesture ? kChangeEndGesture : 0);
+    writeValueToBinary(c.newValue, writePtr);
+    if (includeOldValues) writeValueToBinary(c.oldValue, writePtr);
+  }
+  return result;
+}
+
+// read a Value written by writeValueToBinary(), if it fits before end.
+static bool readCheckedValue(const uint8_t*& p, const uint8_t* end, Value& v)
+{
+  if (static_cast<size_t>(end - p) < sizeof(ValueBinaryHeader)) return false;
+  ValueBinaryHeader header;
+  memcpy(&header, p, sizeof(ValueBinaryHeader));
+  if (static_cast<size_t>(end - p) - sizeof(ValueBinaryHeader) < header.size) return false;
+  v = readBinaryToValue(p);
+  return true;
+}
+
+static bool readBinaryDelta(const uint8_t* data, size_t size, std::vector<ValueChange>& changes,
+                            bool& hasOldValues)
+{
+  changes.clear();
+  if (!data || (size < sizeof(BinaryDeltaHeader))) return false;
+  BinaryDeltaHeader header;
+  memcpy(&header, data, sizeof(BinaryDeltaHeader));
+  if ((header.tag != kBinaryDeltaTag) || (header.size > size)) return false;
+  hasOldValues = header.flags & kDeltaHasOldValues;
+
+  const uint8_t* p = data + sizeof(BinaryDeltaHeader);
+  const uint8_t* end = data + header.size;
+  std::vector<ValueChange> result;
+  for (uint64_t i = 0; i < header.changes; ++i)
+  {
+    if (static_cast<size_t>(end - p) < sizeof(BinaryChunkHeader)) return false;
+    BinaryChunkHeader pathHeader{0, 0};
+    memcpy(&pathHeader, p, sizeof(BinaryChunkHeader));
+    if (pathHeader.type != kPathType) return false;
+    if (static_cast<size_t>(end - p) < sizeof(BinaryChunkHeader) + pathHeader.dataBytes + 1)
+    {
+      return false;
+    }
+
+    ValueChange c;
+    c.name = readPathFromBinary(p);
+    uint8_t flags = *p++;
+    c.startGesture = flags & kChangeStartGesture;
+    c.endGesture = flags & kChangeEndGesture;
+    if (!readCheckedValue(p, end, c.newValue)) return false;
+    if (hasOldValues && !readCheckedValue(p, end, c.oldValue)) return false;
+    result.push_back(std::move(c));
+  }
+  changes = std::move(result);
+  return true;
+}
+
+bool binaryToValueChanges(const uint8_t* data, size_t size, std::vector<ValueChange>& changes)
+{
+  bool hasOldValues;
+  return readBinaryDelta(data, size, changes, hasOldValues);
+}
+
+std::vector<uint8_t> getBinaryDelta(const Tree<Value>& before, const Tree<Value>& after,
+                                    bool includeOldValues)
+{
+  return valueChangesToBinary(diffValueTrees(before, after), includeOldValues);
+}
+
+bool applyBinaryDelta(Tree<Value>& t, const uint8_t* data, size_t size)
+{
+  std::vector<ValueChange> changes;
+  bool hasOldValues;
+  if (!readBinaryDelta(data, size, changes, hasOldValues)) return false;
+  applyValueChanges(t, changes);
+  return true;
+}
+
+bool revertBinaryDelta(Tree<Value>& t, const uint8_t* data, size_t size)
+{
+  std::vector<ValueChange> changes;
+  bool hasOldValues;
+  if (!readBinaryDelta(data, size, changes, hasOldValues) || !hasOldValues) return false;
+  revertValueChanges(t, changes);
+  return true;
+}
+
+// BinaryTreeView
+
+// read the entry at p, as written by valueTreeToBinary(). Returns the start of the
+// next entry, or nullptr if the entry is not a path and value that fit before end.
+static const uint8_t* readBinaryTreeEntry(const uint8_t* p, const uint8_t* end,
+                                          std::string_view& pathText, const uint8_t*& valueData)
+{
+  constexpr size_t chunkHeaderSize = sizeof(BinaryChunkHeader);
+  auto bytesLeft = [&]() { return static_cast<size_t>(end - p); };
+
+  if (bytesLeft() < chunkHeaderSize) return nullptr;
+  BinaryChunkHeader pathHeader{0, 0};
+  memcpy(&pathHeader, p, chunkHeaderSize);
+  if (pathHeader.type != kPathType) return nullptr;
+  p += chunkHeaderSize;
+
+  if (bytesLeft() < pathHeader.dataBytes) return nullptr;
+  pathText = std::string_view(reinterpret_cast<const char*>(p), pathHeader.dataBytes);
+  p += pathHeader.dataBytes;
+
+  if (bytesLeft() < sizeof(ValueBinaryHeader)) return nullptr;
+  ValueBinaryHeader valueHeader;
+  memcpy(&valueHeader, p, sizeof(ValueBinaryHeader));
+  valueData = p;
+  p += sizeof(ValueBinaryHeader);
+
+  if (bytesLeft() < valueHeader.size) return nullptr;
+  return p + valueHeader.size;
+}
+
+BinaryTreeView::BinaryTreeView(const uint8_t* data, size_t size)
+{
+  constexpr size_t headerSize = sizeof(BinaryGroupHeader);
+  if (!data || (size < headerSize * 2)) return;
+
+  BinaryGroupHeader versionHeader, mainHeader;
+  memcpy(&versionHeader, data, headerSize);
+  memcpy(&mainHeader, data + headerSize, headerSize);
+  if (!(versionHeader == kBinaryGroupHeaderV2)) return;
+  if ((mainHeader.size > size) || (mainHeader.size < headerSize * 2)) return;
+
+  // check that all the entries are in bounds, so that iterating is safe.
+  const uint8_t* p = data + headerSize * 2;
+  const uint8_t* end = data + mainHeader.size;
+  std::string_view pathText;
+  const uint8_t* valueData;
+  for (size_t i = 0; i < mainHeader.elements; ++i)
+  {
+    p = readBinaryTreeEntry(p, end, pathText, valueData);
+    if (!p) return;
+  }
+
+  firstEntry_ = data + headerSize * 2;
+  end_ = p;
+  elements_ = mainHeader.elements;
+  valid_ = true;
+}
+
+BinaryTreeView::const_iterator::const_iterator(const uint8_t* pos, const uint8_t* end)
+    : pos_(pos), end_(end)
+{
+  if (pos_ != end_)
+  {
+    next_ = readBinaryTreeEntry(pos_, end_, entry_.pathText_, entry_.valueData_);
+  }
+}
+
+BinaryTreeView::const_iterator& BinaryTreeView::const_iterator::operator++()
+{
+  pos_ = next_;
+  if (pos_ != end_)
+  {
+    next_ = readBinaryTreeEntry(pos_, end_, entry_.pathText_, entry_.valueData_);
+  }
+  return *this;
+}
+
+BinaryTreeView::const_iterator BinaryTreeView::begin() const
+{
+  return const_iterator(firstEntry_, end_);
+}
+
+BinaryTreeView::const_iterator BinaryTreeView::end() const { return const_iterator(end_, end_); }
+
+BinaryTreeView::const_iterator BinaryTreeView::find(const Path& p) const
+{
+  for (auto it = begin(); it != end(); ++it)
+  {
+    if (it->pathEquals(p)) return it;
+  }
+  return end();
+}
+
+BinaryTreeView::const_iterator BinaryTreeView::find(const HashPath& p) const
+{
+  for (auto it = begin(); it != end(); ++it)
+  {
+    if (it->pathEquals(p)) return it;
+  }
+  return end();
+}
+
+Value BinaryTreeView::operator[](const Path& p) const
+{
+  auto it = find(p);
+  return (it != end()) ? it->getValue() : Value();
+}
+
+Value BinaryTreeView::getValueFromHash(const HashPath& p) const
+{
+  auto it = find(p);
+  return (it != end()) ? it->getValue() : Value();
+}
+
+Path BinaryTreeView::Entry::getPath() const
+{
+  return runtimePath(TextFragment(pathText_.data(), pathText_.size()));
+}
+
+TextPath BinaryTreeView::Entry::getTextPath() const
+{
+  return runtimeTextPath(TextFragment(pathText_.data(), pathText_.size()).getText());
+}
+
+Value BinaryTreeView::Entry::getValue() const
+{
+  const uint8_t* readPtr = valueData_;
+  return readBinaryToValue(readPtr);
+}
+
+// hash each segment of the path text, as runtimePath() would, and compare.
+bool BinaryTreeView::Entry::pathEqualsHashes(const uint64_t* hashes, size_t n) const
+{
+  size_t segments = 0;
+  size_t start = 0;
+  while (start < pathText_.size())
+  {
+    size_t end = pathText_.find('/', start);
+    if (end == std::string_view::npos) end = pathText_.size();
+    if (end > start)
+    {
+      if (segments >= n) return false;
+      if (textHashRuntime(pathText_.data() + start, end - start) != hashes[segments]) return false;
+      segments++;
+    }
+    start = end + 1;
+  }
+  return segments == n;
+}
+
+bool BinaryTreeView::Entry::pathEquals(const Path& p) const
+{
+  std::array<uint64_t, kPathMaxSymbols> hashes;
+  for (int i = 0; i < p.getSize(); ++i)
+  {
+    hashes[i] = p.getElement(i).getHash();
+  }
+  return pathEqualsHashes(hashes.data(), p.getSize());
+}
+
+bool BinaryTreeView::Entry::pathEquals(const HashPath& p) const
+{
+  return pathEqualsHashes(p.elements_.data(), p.size_);
+}
+
 // JSONHolder
 
 struct JSONHolder::Impl
@@ -462,9 +1020,9 @@ JSONHolder valueTreeToJSON(const Tree<Value>& t)
 
   for (auto it = t.begin(); it != t.end(); ++it)
   {
-    auto p = it.getCurrentPath();
+    const auto& p = it.getCurrentPath();
     TextFragment pathAsText(p.toText());
-    Value v = (*it);
+    const Value& v = (*it);
 
     const char* keyStr = pathAsText.getText();
 
@@ -477,7 +1035,9 @@ JSONHolder valueTreeToJSON(const Tree<Value>& t)
         break;
       case Value::kFloatArray:
       {
-        auto a = cJSON_CreateFloatArray(v.getFloatArrayPtr(), sizeToInt(v.getFloatArraySize()));
+        // cJSON only reads the array.
+        auto a = cJSON_CreateFloatArray(const_cast<float*>(v.getFloatArrayPtr()),
+                                        sizeToInt(v.getFloatArraySize()));
         if (a)
         {
           cJSON_AddItemToObject(getData(root), keyStr, a);
@@ -602,4 +1162,547 @@ TextFragment JSONToText(const JSONHolder& root)
   return result;
 }
 
+// Streaming JSON
+
+// the decimal point of the current C locale, used by snprintf and strtod.
+static char getDecimalPoint()
+{
+  const lconv* lc = localeconv();
+  return (lc && lc->decimal_point && lc->decimal_point[0]) ? lc->decimal_point[0] : '.';
+}
+
+class JSONWriter
+{
+ public:
+  // if out is null, everything is kept in the buffer.
+  explicit JSONWriter(std::ostream* out) : out_(out) {}
+
+  void write(const Tree<Value>& t)
+  {
+    put('{');
+    bool first{true};
+    t.visitValues([&](const Path& p, const Value& v) {
+      if (v.getType() == Value::kUndefined) return;
+      if (!first) put(',');
+      first = false;
+      writeKey(p);
+      put(':');
+      writeValue(v);
+      flushIfFull();
+    });
+    put('}');
+    flush();
+  }
+
+  const std::string& getBuffer() const { return buffer_; }
+
+ private:
+  static constexpr size_t kFlushBytes{1 << 16};
+
+  void put(char c) { buffer_.push_back(c); }
+  void put(const char* p, size_t n) { buffer_.append(p, n); }
+
+  void flushIfFull()
+  {
+    if (buffer_.size() >= kFlushBytes) flush();
+  }
+
+  void flush()
+  {
+    if (out_)
+    {
+      out_->write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+      buffer_.clear();
+    }
+  }
+
+  void writeEscaped(const char* p, size_t n)
+  {
+    static const char* kHex = "0123456789abcdef";
+    for (size_t i = 0; i < n; ++i)
+    {
+      unsigned char c = static_cast<unsigned char>(p[i]);
+      switch (c)
+      {
+        case '"': put("\\\"", 2); break;
+        case '\\': put("\\\\", 2); break;
+        case '\b': put("\\b", 2); break;
+        case '\f': put("\\f", 2); break;
+        case '\n': put("\\n", 2); break;
+        case '\r': put("\\r", 2); break;
+        case '\t': put("\\t", 2); break;
+        default:
+          if (c < 0x20)
+          {
+            char u[6] = {'\\', 'u', '0', '0', kHex[c >> 4], kHex[c & 0xF]};
+            put(u, 6);
+          }
+          else
+          {
+            put(static_cast<char>(c));
+          }
+          break;
+      }
+    }
+  }
+
+  void writeKey(const Path& p)
+  {
+    put('"');
+    for (int i = 0; i < p.getSize(); ++i)
+    {
+      if (i > 0) put('/');
+      const TextFragment& segment = p.getElement(i).getTextFragment();
+      writeEscaped(segment.getText(), segment.lengthInBytes());
+    }
+    put('"');
+  }
+
+  void writeNumber(double d, const char* format)
+  {
+    if (!std::isfinite(d))
+    {
+      put("null", 4);
+      return;
+    }
+    char buf[32];
+    int n = snprintf(buf, sizeof(buf), format, d);
+    for (int i = 0; i < n; ++i)
+    {
+      if (buf[i] == decimalPoint_) buf[i] = '.';
+    }
+    put(buf, static_cast<size_t>(n));
+  }
+
+  void writeValue(const Value& v)
+  {
+    switch (v.getType())
+    {
+      case Value::kFloat:
+        writeNumber(v.getFloatValue(), "%.9g");
+        break;
+      case Value::kInt:
+        writeNumber(v.getIntValue(), "%.0f");
+        break;
+      case Value::kFloatArray:
+      {
+        const float* f = v.getFloatArrayPtr();
+        put('[');
+        for (size_t i = 0; i < v.getFloatArraySize(); ++i)
+        {
+          if (i > 0) put(',');
+          writeNumber(f[i], "%.9g");
+        }
+        put(']');
+        break;
+      }
+      case Value::kText:
+        put('"');
+        writeEscaped(reinterpret_cast<const char*>(v.data()), v.size());
+        put('"');
+        break;
+      case Value::kBlob:
+      {
+        std::vector<uint8_t> blobVec(v.data(), v.data() + v.size());
+        TextFragment blobText(kBlobHeader, textUtils::base64Encode(blobVec));
+        put('"');
+        put(blobText.getText(), blobText.lengthInBytes());
+        put('"');
+        break;
+      }
+      default:
+        put("null", 4);
+        break;
+    }
+  }
+
+  std::ostream* out_;
+  std::string buffer_;
+  char decimalPoint_{getDecimalPoint()};
+};
+
+// recursive descent parser that adds values to the tree as it goes. Reading
+// from a stream, it refills a fixed-size buffer whenever it runs out of text.
+class JSONParser
+{
+ public:
+  JSONParser(const char* text, size_t length, Tree<Value>& tree)
+      : p_(text), end_(text + length), tree_(tree)
+  {
+  }
+
+  JSONParser(std::istream& in, Tree<Value>& tree)
+      : in_(&in), streamBuffer_(kStreamBufferBytes), tree_(tree)
+  {
+    p_ = end_ = streamBuffer_.data();
+  }
+
+  // parse one object, and nothing but whitespace after it.
+  bool parse()
+  {
+    skipWhitespace();
+    if (!parseObject(Path(), 0)) return false;
+    skipWhitespace();
+    return atEnd();
+  }
+
+ private:
+  static constexpr int kMaxDepth{1000};
+  static constexpr size_t kStreamBufferBytes{1 << 16};
+
+  // true when no text is left. Reading from a stream, this refills the buffer first,
+  // which discards everything before p_.
+  bool atEnd()
+  {
+    if (p_ < end_) return false;
+    if (!in_) return true;
+    in_->read(streamBuffer_.data(), streamBuffer_.size());
+    p_ = streamBuffer_.data();
+    end_ = p_ + in_->gcount();
+    return p_ >= end_;
+  }
+  char peek() { return atEnd() ? 0 : *p_; }
+
+  void skipWhitespace()
+  {
+    while (!atEnd() && ((*p_ == ' ') || (*p_ == '\t') || (*p_ == '\n') || (*p_ == '\r'))) p_++;
+  }
+
+  bool expect(char c)
+  {
+    skipWhitespace();
+    if (peek() != c) return false;
+    p_++;
+    return true;
+  }
+
+  bool matchLiteral(const char* lit)
+  {
+    for (; *lit; ++lit)
+    {
+      if (peek() != *lit) return false;
+      p_++;
+    }
+    return true;
+  }
+
+  static int hexDigit(char c)
+  {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+  }
+
+  bool parseHex4(uint32_t& u)
+  {
+    u = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+      if (atEnd()) return false;
+      int d = hexDigit(*p_++);
+      if (d < 0) return false;
+      u = (u << 4) | static_cast<uint32_t>(d);
+    }
+    return true;
+  }
+
+  void appendUTF8(uint32_t c, std::string& out)
+  {
+    if (c < 0x80)
+    {
+      out.push_back(static_cast<char>(c));
+    }
+    else if (c < 0x800)
+    {
+      out.push_back(static_cast<char>(0xC0 | (c >> 6)));
+      out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    }
+    else if (c < 0x10000)
+    {
+      out.push_back(static_cast<char>(0xE0 | (c >> 12)));
+      out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+      out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    }
+    else
+    {
+      out.push_back(static_cast<char>(0xF0 | (c >> 18)));
+      out.push_back(static_cast<char>(0x80 | ((c >> 12) & 0x3F)));
+      out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+      out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    }
+  }
+
+  // parse a string after its opening quote into out.
+  bool parseString(std::string& out)
+  {
+    out.clear();
+    while (!atEnd())
+    {
+      char c = *p_++;
+      if (c == '"') return true;
+      if (static_cast<unsigned char>(c) < 0x20) return false;
+      if (c != '\\')
+      {
+        out.push_back(c);
+        continue;
+      }
+      if (atEnd()) return false;
+      switch (*p_++)
+      {
+        case '"': out.push_back('"'); break;
+        case '\\': out.push_back('\\'); break;
+        case '/': out.push_back('/'); break;
+        case 'b': out.push_back('\b'); break;
+        case 'f': out.push_back('\f'); break;
+        case 'n': out.push_back('\n'); break;
+        case 'r': out.push_back('\r'); break;
+        case 't': out.push_back('\t'); break;
+        case 'u':
+        {
+          uint32_t u;
+          if (!parseHex4(u)) return false;
+          if ((u >= 0xD800) && (u < 0xDC00))
+          {
+            // surrogate pair
+            uint32_t low;
+            if (!matchLiteral("\\u") || !parseHex4(low)) return false;
+            if ((low < 0xDC00) || (low >= 0xE000)) return false;
+            u = 0x10000 + ((u - 0xD800) << 10) + (low - 0xDC00);
+          }
+          appendUTF8(u, out);
+          break;
+        }
+        default:
+          return false;
+      }
+    }
+    return false;
+  }
+
+  bool parseNumber(float& f)
+  {
+    auto isDigit = [](char c) { return (c >= '0') && (c <= '9'); };
+
+    // copy each character for strtod, which needs a terminator and the locale's decimal
+    // point. A number may span two stream buffers, so we can't parse it in place.
+    auto take = [&]() {
+      number_.push_back((*p_ == '.') ? decimalPoint_ : *p_);
+      p_++;
+    };
+    auto digits = [&]() {
+      if (!isDigit(peek())) return false;
+      while (isDigit(peek())) take();
+      return true;
+    };
+
+    // copy the number, checking its syntax.
+    number_.clear();
+    if (peek() == '-') take();
+    if (!digits()) return false;
+    if (peek() == '.')
+    {
+      take();
+      if (!digits()) return false;
+    }
+    if ((peek() == 'e') || (peek() == 'E'))
+    {
+      take();
+      if ((peek() == '+') || (peek() == '-')) take();
+      if (!digits()) return false;
+    }
+    f = static_cast<float>(strtod(number_.c_str(), nullptr));
+    return true;
+  }
+
+  // parse and discard a value that we don't store.
+  bool skipValue(int depth)
+  {
+    if (depth > kMaxDepth) return false;
+    skipWhitespace();
+    switch (peek())
+    {
+      case '"':
+        p_++;
+        return parseString(scratch_);
+      case '{':
+      {
+        p_++;
+        if (expect('}')) return true;
+        do
+        {
+          if (!expect('"') || !parseString(scratch_) || !expect(':') || !skipValue(depth + 1))
+          {
+            return false;
+          }
+        } while (expect(','));
+        return expect('}');
+      }
+      case '[':
+      {
+        p_++;
+        if (expect(']')) return true;
+        do
+        {
+          if (!skipValue(depth + 1)) return false;
+        } while (expect(','));
+        return expect(']');
+      }
+      case 't':
+        return matchLiteral("true");
+      case 'f':
+        return matchLiteral("false");
+      case 'n':
+        return matchLiteral("null");
+      default:
+      {
+        float f;
+        return parseNumber(f);
+      }
+    }
+  }
+
+  // parse an array of numbers straight into a float vector. As with cJSON,
+  // elements that are not numbers become 0.
+  bool parseFloatArray(const Path& path, int depth)
+  {
+    floats_.clear();
+    if (!expect(']'))
+    {
+      do
+      {
+        skipWhitespace();
+        float f{0.f};
+        char c = peek();
+        if ((c == '-') || ((c >= '0') && (c <= '9')))
+        {
+          if (!parseNumber(f)) return false;
+        }
+        else if (!skipValue(depth + 1))
+        {
+          return false;
+        }
+        floats_.push_back(f);
+      } while (expect(','));
+      if (!expect(']')) return false;
+    }
+    tree_.add(path, Value(floats_));
+    return true;
+  }
+
+  bool parseValue(const Path& path, int depth)
+  {
+    skipWhitespace();
+    switch (peek())
+    {
+      case '{':
+        return parseObject(path, depth + 1);
+      case '[':
+        p_++;
+        return parseFloatArray(path, depth);
+      case '"':
+      {
+        p_++;
+        if (!parseString(scratch_)) return false;
+        TextFragment valueText(scratch_.data(), scratch_.size());
+        if (valueText.beginsWith(kBlobHeader))
+        {
+          // convert strings starting with the header into Blobs
+          TextFragment body(scratch_.data() + kBlobHeader.lengthInBytes(),
+                            scratch_.size() - kBlobHeader.lengthInBytes());
+          auto blobDataVec = textUtils::base64Decode(body);
+          tree_.add(path, Value(blobDataVec.data(), blobDataVec.size()));
+        }
+        else
+        {
+          tree_.add(path, Value(valueText));
+        }
+        return true;
+      }
+      case 't':
+      case 'f':
+      case 'n':
+        // booleans and nulls are not stored, as in JSONToValueTree().
+        return skipValue(depth);
+      default:
+      {
+        float f;
+        if (!parseNumber(f)) return false;
+        tree_.add(path, f);
+        return true;
+      }
+    }
+  }
+
+  bool parseObject(const Path& path, int depth)
+  {
+    if (depth > kMaxDepth) return false;
+    if (!expect('{')) return false;
+    if (expect('}')) return true;
+    do
+    {
+      if (!expect('"') || !parseString(scratch_) || !expect(':')) return false;
+      Path childPath(path, runtimePath(TextFragment(scratch_.data(), scratch_.size())));
+      if (!parseValue(childPath, depth)) return false;
+    } while (expect(','));
+    return expect('}');
+  }
+
+  std::istream* in_{nullptr};
+  std::vector<char> streamBuffer_;
+  const char* p_;
+  const char* end_;
+  Tree<Value>& tree_;
+  std::string scratch_;
+  std::string number_;
+  std::vector<float> floats_;
+  char decimalPoint_{getDecimalPoint()};
+};
+
+void writeValueTreeToJSON(const Tree<Value>& t, std::ostream& out)
+{
+  JSONWriter writer(&out);
+  writer.write(t);
+}
+
+TextFragment valueTreeToJSONText(const Tree<Value>& t)
+{
+  JSONWriter writer(nullptr);
+  writer.write(t);
+  return TextFragment(writer.getBuffer().data(), writer.getBuffer().size());
+}
+
+Tree<Value> JSONTextToValueTree(const char* text, size_t lengthInBytes)
+{
+  Tree<Value> r;
+  if (!text) return r;
+  JSONParser parser(text, lengthInBytes, r);
+  if (!parser.parse()) r.clear();
+  return r;
+}
+
+Tree<Value> JSONTextToValueTree(const TextFragment& t)
+{
+  return JSONTextToValueTree(t.getText(), t.lengthInBytes());
+}
+
+Tree<Value> readValueTreeFromJSON(std::istream& in)
+{
+  Tree<Value> r;
+  JSONParser parser(in, r);
+  if (!parser.parse()) r.clear();
+  return r;
+}
+
+Tree<Value> bytesToValueTree(const uint8_t* data, size_t size)
+{
+  const uint8_t* end = data + size;
+  const uint8_t* first = std::find_if(data, end, [](uint8_t c) { return !isspace(c); });
+  if ((first != end) && (*first == '{'))
+  {
+    return JSONTextToValueTree(reinterpret_cast<const char*>(data), size);
+  }
+  return binaryToValueTree(data, size);
+}
+
 }  // namespace ml
@@ -12,12 +12,15 @@
 #include <list>
 #include <map>
 #include <numeric>
+#include <string_view>
 
+#include "MLCompression.h"
 #include "MLSymbol.h"
 #include "MLText.h"
 #include "MLTextUtils.h"
 #include "MLTree.h"
 #include "MLValue.h"
+#include "MLValueChange.h"
 
 namespace ml
 {
@@ -30,13 +33,13 @@ static TextFragment kBlobHeader("!BLOB!");
 size_t getBinarySize(const Value& v);
 
 // Return the binary representation of the Value.
-std::vector<uint8_t> valueToBinary(Value v);
+std::vector<uint8_t> valueToBinary(const Value& v);
 
 // Return the Value represented by the vector of bytes.
 Value binaryToValue(const std::vector<uint8_t>& v);
 
 // Write the binary representation of the Value and increment the write pointer.
-void writeValueToBinary(Value v, uint8_t*& writePtr);
+void writeValueToBinary(const Value& v, uint8_t*& writePtr);
 
 // Read the binary representation of the Value and increment the read pointer.
 Value readBinaryToValue(const uint8_t*& readPtr);
@@ -50,7 +53,179 @@ Path binaryToPath(const std::vector<unsigned char>& p);
 // Value Trees
 
 std::vector<unsigned char> valueTreeToBinary(const Tree<Value>& t);
+
+// Return the size of the binary representation of the Value tree.
+size_t getBinarySize(const Tree<Value>& t);
+
+// Write the binary representation of the Value tree to the buffer, resizing it
+// to fit. Once a reused buffer has enough capacity, nothing is allocated.
+void valueTreeToBinary(const Tree<Value>& t, std::vector<uint8_t>& buffer);
+
+// Write the binary representation of the Value tree to dest without
+// allocating. Returns the number of bytes written, or 0 if destSize is
+// smaller than getBinarySize(t).
+size_t writeValueTreeToBinary(const Tree<Value>& t, uint8_t* dest, size_t destSize);
 Tree<Value> binaryToValueTree(const std::vector<unsigned char>& binaryData);
+Tree<Value> binaryToValueTree(const uint8_t* data, size_t size);
+
+// Large binary Value trees
+//
+// A second binary format for Value trees, with 64-bit chunk sizes so that big
+// blobs such as samples and wavetables don't have to be split up. Every chunk
+// header and payload starts on a kLargeBinaryAlignment boundary, so float data
+// can be used in place from mapped memory. The stream functions go chunk by
+// chunk, straight from or into the Values in the tree, so that the data is
+// never held in memory twice. binaryToValueTree() also reads this format.
+
+constexpr size_t kLargeBinaryAlignment{16};
+
+size_t getLargeBinarySize(const Tree<Value>& t);
+std::vector<uint8_t> valueTreeToLargeBinary(const Tree<Value>& t);
+Tree<Value> largeBinaryToValueTree(const uint8_t* data, size_t size);
+
+// Returns false if writing to the stream fails.
+bool writeValueTreeToLargeBinary(const Tree<Value>& t, std::ostream& out);
+
+// Returns an empty tree if reading fails or the data is not valid. A stream that can't seek
+// is read whole before parsing, so that sizes in the data can be checked against its length.
+Tree<Value> readLargeBinaryToValueTree(std::istream& in);
+
+// Compressed binary Value trees
+//
+// The output of valueTreeToBinary() in the chunked container from
+// MLCompression.h. binaryToValueTree() reads this, and also reads large
+// binary trees compressed with compressData().
+
+std::vector<uint8_t> valueTreeToCompressedBinary(const Tree<Value>& t,
+                                                 size_t chunkBytes = kDefaultCompressionChunkBytes);
+
+// Value tree deltas
+//
+// A delta is a list of ValueChanges that turns one Value tree into another.
+// Each change has the old value as well as the new one, so a delta can be
+// reverted for undo. Paths with no value in the new tree get an undefined new
+// value, which removes the value when the change is applied.
+//
+// In binary form, a delta is a header followed by a path, flags and values for
+// each change. Without old values, which a remote UI doesn't need, a delta can
+// be applied but not reverted.
+
+std::vector<ValueChange> diffValueTrees(const Tree<Value>& before, const Tree<Value>& after);
+
+void applyValueChanges(Tree<Value>& t, const std::vector<ValueChange>& changes);
+
+// undo the changes, in reverse order.
+void revertValueChanges(Tree<Value>& t, const std::vector<ValueChange>& changes);
+
+std::vector<uint8_t> valueChangesToBinary(const std::vector<ValueChange>& changes,
+                                          bool includeOldValues = true);
+
+// Returns false, leaving changes empty, if the data is not a valid delta.
+bool binaryToValueChanges(const uint8_t* data, size_t size, std::vector<ValueChange>& changes);
+
+// the binary delta from before to after.
+std::vector<uint8_t> getBinaryDelta(const Tree<Value>& before, const Tree<Value>& after,
+                                    bool includeOldValues = true);
+
+// Apply or revert a binary delta. Returns false, leaving t unchanged, if the
+// data is not a valid delta or is missing the old values needed to revert.
+bool applyBinaryDelta(Tree<Value>& t, const uint8_t* data, size_t size);
+bool revertBinaryDelta(Tree<Value>& t, const uint8_t* data, size_t size);
+
+// BinaryTreeView: read-only access to the binary form of a Value tree made by
+// valueTreeToBinary(), without deserializing it. The view works directly on
+// the bytes, which must outlive it and may be for example a mapped file.
+// Paths are compared by hashing their text, so no Symbols are registered, and
+// Values are only decoded when asked for.
+//
+// The constructor checks that every entry lies inside the data. If the data
+// is not a valid binary tree in the current format, the view is empty and
+// isValid() returns false. Lookups are linear in the number of entries.
+
+class BinaryTreeView
+{
+ public:
+  // one path and value in the data.
+  class Entry
+  {
+   public:
+    // the path text, such as "osc/freq".
+    std::string_view getPathText() const { return pathText_; }
+
+    // these register the path Symbols.
+    Path getPath() const;
+    TextPath getTextPath() const;
+
+    // decode the value, copying its data.
+    Value getValue() const;
+
+    // compare the path to a Path or HashPath without decoding the Path.
+    bool pathEquals(const Path& p) const;
+    bool pathEquals(const HashPath& p) const;
+
+   private:
+    friend class BinaryTreeView;
+    bool pathEqualsHashes(const uint64_t* hashes, size_t n) const;
+
+    std::string_view pathText_;
+    const uint8_t* valueData_{nullptr};
+  };
+
+  class const_iterator
+  {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Entry;
+    using difference_type = int;
+    using pointer = const Entry*;
+    using reference = const Entry&;
+
+    const Entry& operator*() const { return entry_; }
+    const Entry* operator->() const { return &entry_; }
+    const_iterator& operator++();
+    bool operator==(const const_iterator& b) const { return pos_ == b.pos_; }
+    bool operator!=(const const_iterator& b) const { return pos_ != b.pos_; }
+
+   private:
+    friend class BinaryTreeView;
+    const_iterator(const uint8_t* pos, const uint8_t* end);
+
+    // the start of the current entry, the start of the next, and the end of
+    // all the entries.
+    const uint8_t* pos_{nullptr};
+    const uint8_t* next_{nullptr};
+    const uint8_t* end_{nullptr};
+    Entry entry_;
+  };
+
+  BinaryTreeView(const uint8_t* data, size_t size);
+  explicit BinaryTreeView(const std::vector<uint8_t>& data)
+      : BinaryTreeView(data.data(), data.size())
+  {
+  }
+
+  bool isValid() const { return valid_; }
+
+  // the number of values in the tree.
+  size_t size() const { return elements_; }
+
+  const_iterator begin() const;
+  const_iterator end() const;
+
+  // the entry with the path, or end().
+  const_iterator find(const Path& p) const;
+  const_iterator find(const HashPath& p) const;
+
+  // the value at the path, or Value() if there is none.
+  Value operator[](const Path& p) const;
+  Value getValueFromHash(const HashPath& p) const;
+
+ private:
+  const uint8_t* firstEntry_{nullptr};
+  const uint8_t* end_{nullptr};
+  size_t elements_{0};
+  bool valid_{false};
+};
 
 // JSON
 // utility class to make the cJSON interface usable with RAII style.
@@ -80,6 +255,27 @@ class JSONHolder
   void addJSON(TextFragment key, JSONHolder& j);
 };
 
+// Streaming JSON
+//
+// These convert between Tree<Value> and JSON text directly, without making
+// a cJSON DOM. The output is the same flat object, with one key per path,
+// that JSONToText(valueTreeToJSON(t)) makes, written without whitespace.
+// Parsing accepts nested objects, as JSONToValueTree() does, and returns an
+// empty tree if the text is not valid JSON.
+
+void writeValueTreeToJSON(const Tree<Value>& t, std::ostream& out);
+TextFragment valueTreeToJSONText(const Tree<Value>& t);
+
+Tree<Value> JSONTextToValueTree(const char* text, size_t lengthInBytes);
+Tree<Value> JSONTextToValueTree(const TextFragment& t);
+
+// parse the stream as above, reading it a buffer at a time.
+Tree<Value> readValueTreeFromJSON(std::istream& in);
+
+// parse the contents of a file as JSON if they start with an object, or as any of the binary
+// formats otherwise.
+Tree<Value> bytesToValueTree(const uint8_t* data, size_t size);
+
 // return a JSON object representing the value tree.
 // The caller is responsible for freeing the JSONHolder object.
 JSONHolder valueTreeToJSON(const Tree<Value>& t);
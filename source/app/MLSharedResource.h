@@ -123,9 +123,22 @@ class SharedResourcePointer
   ~SharedResourcePointer()
   {
     auto& holder = getSharedObjectHolder();
-    SpinLockGuard holderGuard(&holder.static_flag);
 
-    if (--(holder.refCount) == 0) holder.sharedInstance = nullptr;
+    // fast path: we are not the last reference, so the object stays.
+    int count = holder.refCount.load(std::memory_order_relaxed);
+    while (count > 1)
+    {
+      if (holder.refCount.compare_exchange_weak(count, count - 1, std::memory_order_acq_rel))
+      {
+        return;
+      }
+    }
+
+    SpinLockGuard holderGuard(&holder.static_flag);
+    if (holder.refCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+      delete holder.sharedInstance.exchange(nullptr, std::memory_order_relaxed);
+    }
   }
 
   /** Returns the shared object. */
@@ -144,14 +157,20 @@ class SharedResourcePointer
 
   /** Returns the number of SharedResourcePointers that are currently holding
    * the shared object. */
-  int getReferenceCount() const noexcept { return getSharedObjectHolder().refCount; }
+  int getReferenceCount() const noexcept
+  {
+    return getSharedObjectHolder().refCount.load(std::memory_order_relaxed);
+  }
 
  private:
+  // The shared instance only changes while refCount is 0, so once a thread has counted itself
+  // in, it can read sharedInstance without locking. The spinlock is only needed to create and
+  // delete the instance.
   struct SharedObjectHolder
   {
     std::atomic_flag static_flag = ATOMIC_FLAG_INIT;
-    std::unique_ptr<SharedObjectType> sharedInstance;
-    int refCount;
+    std::atomic<SharedObjectType*> sharedInstance;
+    std::atomic<int> refCount;
   };
 
   static SharedObjectHolder& getSharedObjectHolder() noexcept
@@ -166,11 +185,29 @@ class SharedResourcePointer
   void initialise()
   {
     auto& holder = getSharedObjectHolder();
-    SpinLockGuard holderGuard(&holder.static_flag);
 
-    if (++(holder.refCount) == 1) holder.sharedInstance.reset(new SharedObjectType());
+    // fast path: the object exists, so add a reference to it.
+    int count = holder.refCount.load(std::memory_order_acquire);
+    while (count > 0)
+    {
+      if (holder.refCount.compare_exchange_weak(count, count + 1, std::memory_order_acquire))
+      {
+        sharedObject = holder.sharedInstance.load(std::memory_order_acquire);
+        return;
+      }
+    }
 
-    sharedObject = holder.sharedInstance.get();
+    SpinLockGuard holderGuard(&holder.static_flag);
+    if (holder.refCount.load(std::memory_order_relaxed) == 0)
+    {
+      holder.sharedInstance.store(new SharedObjectType(), std::memory_order_release);
+      holder.refCount.store(1, std::memory_order_release);
+    }
+    else
+    {
+      holder.refCount.fetch_add(1, std::memory_order_acquire);
+    }
+    sharedObject = holder.sharedInstance.load(std::memory_order_acquire);
   }
 
   // There's no need to assign to a SharedResourcePointer because every
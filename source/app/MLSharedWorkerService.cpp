@@ -0,0 +1,180 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLSharedWorkerService.h"
+
+#include <algorithm>
+
+#include "MLRealtimeThread.h"
+
+namespace ml
+{
+// the instances sharing the workers may run at different rates, so the workers are scheduled
+// with a nominal period of a few milliseconds.
+constexpr double kWorkerPeriodSeconds{0.002};
+
+constexpr uint64_t kTaskMask{0xFFFFFFFF};
+
+SharedWorkerService::SharedWorkerService()
+{
+  startWorkers(std::max(int(std::thread::hardware_concurrency()) - 1, 1));
+}
+
+SharedWorkerService::SharedWorkerService(size_t nWorkers) { startWorkers(nWorkers); }
+
+SharedWorkerService::~SharedWorkerService()
+{
+  quit_.store(true, std::memory_order_release);
+  wakeCondition_.notify_all();
+  for (auto& t : threads_)
+  {
+    t.join();
+  }
+}
+
+void SharedWorkerService::startWorkers(size_t nWorkers)
+{
+  threads_.reserve(nWorkers);
+  for (size_t i = 0; i < nWorkers; ++i)
+  {
+    threads_.emplace_back([this]() {
+      if (kFlushDenormalsAutomatically) setCurrentThreadFlushDenormalsToZero();
+      setCurrentThreadRealtime(kWorkerPeriodSeconds);
+      workerLoop();
+    });
+  }
+}
+
+bool SharedWorkerService::run(size_t nTasks, TaskFn fn, void* context, Clock::time_point deadline)
+{
+  if (nTasks == 0) return true;
+
+  // take a free slot, or run the job here if there is none.
+  size_t slot = 0;
+  for (; slot < kMaxJobs; ++slot)
+  {
+    bool expected{false};
+    if (!jobs_[slot].taken.load(std::memory_order_relaxed) &&
+        jobs_[slot].taken.compare_exchange_strong(expected, true, std::memory_order_acquire))
+    {
+      break;
+    }
+  }
+  if (slot == kMaxJobs)
+  {
+    overflowJobs_.fetch_add(1, std::memory_order_relaxed);
+    for (size_t i = 0; i < nTasks; ++i)
+    {
+      fn(context, i);
+    }
+    return Clock::now() <= deadline;
+  }
+
+  // close the slot to threads holding an old claim before changing the job, then publish the
+  // new generation.
+  Job& job = jobs_[slot];
+  job.generation = (job.generation + 1) & kTaskMask;
+  if (job.generation == 0) job.generation = 1;
+  const uint64_t generation = job.generation;
+  job.claim.store((generation << 32) | kTaskMask, std::memory_order_relaxed);
+  job.fn = fn;
+  job.context = context;
+  job.completed.store(0, std::memory_order_relaxed);
+  job.deadline.store(deadline.time_since_epoch().count(), std::memory_order_relaxed);
+  job.nTasks.store(nTasks, std::memory_order_release);
+  job.claim.store(generation << 32, std::memory_order_release);
+  activeJobs_.fetch_or(uint64_t(1) << slot, std::memory_order_release);
+  if (sleepers_.load(std::memory_order_relaxed) > 0)
+  {
+    wakeCondition_.notify_all();
+  }
+
+  // do our own tasks, then help with earlier jobs until the workers finish ours.
+  while (doTask(job, generation))
+  {
+  }
+  const Clock::rep due = deadline.time_since_epoch().count();
+  while (job.completed.load(std::memory_order_acquire) < nTasks)
+  {
+    if (!doEarliestTask(due - 1)) cpuRelax();
+  }
+
+  activeJobs_.fetch_and(~(uint64_t(1) << slot), std::memory_order_release);
+  job.taken.store(false, std::memory_order_release);
+  return Clock::now() <= deadline;
+}
+
+bool SharedWorkerService::doTask(Job& job, uint64_t generation)
+{
+  uint64_t c = job.claim.load(std::memory_order_acquire);
+  for (;;)
+  {
+    if ((c >> 32) != generation) return false;
+    const uint64_t task = c & kTaskMask;
+    if (task >= job.nTasks.load(std::memory_order_acquire)) return false;
+    if (job.claim.compare_exchange_weak(c, c + 1, std::memory_order_acq_rel))
+    {
+      job.fn(job.context, static_cast<size_t>(task));
+      job.completed.fetch_add(1, std::memory_order_release);
+      return true;
+    }
+  }
+}
+
+bool SharedWorkerService::doEarliestTask(Clock::rep latest)
+{
+  Job* pBest{nullptr};
+  uint64_t bestGeneration{0};
+  Clock::rep bestDeadline{latest};
+  uint64_t active = activeJobs_.load(std::memory_order_acquire);
+  for (size_t slot = 0; active; ++slot, active >>= 1)
+  {
+    if (!(active & 1)) continue;
+    Job& job = jobs_[slot];
+    const uint64_t c = job.claim.load(std::memory_order_acquire);
+    if ((c & kTaskMask) >= job.nTasks.load(std::memory_order_acquire)) continue;
+    const Clock::rep d = job.deadline.load(std::memory_order_relaxed);
+    if ((d > latest) || (pBest && (d >= bestDeadline))) continue;
+    pBest = &job;
+    bestGeneration = c >> 32;
+    bestDeadline = d;
+  }
+  return pBest && doTask(*pBest, bestGeneration);
+}
+
+void SharedWorkerService::workerLoop()
+{
+  const Clock::rep never = Clock::time_point::max().time_since_epoch().count();
+  int idleSpins{0};
+  while (!quit_.load(std::memory_order_acquire))
+  {
+    if (doEarliestTask(never))
+    {
+      idleSpins = 0;
+    }
+    else if (++idleSpins < kSpinsBeforeYield)
+    {
+      cpuRelax();
+    }
+    else if (idleSpins < kSpinsBeforeSleep)
+    {
+      std::this_thread::yield();
+    }
+    else
+    {
+      // callers notify without locking, so a wakeup may be missed and we rely on the timeout.
+      // The callers do their own tasks in the meantime.
+      std::unique_lock<std::mutex> lock(sleepMutex_);
+      sleepers_.fetch_add(1, std::memory_order_relaxed);
+      wakeCondition_.wait_for(lock, kSleepTimeout, [&]() {
+        return quit_.load(std::memory_order_acquire) ||
+               activeJobs_.load(std::memory_order_acquire);
+      });
+      sleepers_.fetch_sub(1, std::memory_order_relaxed);
+      idleSpins = 0;
+    }
+  }
+}
+
+}  // namespace ml
@@ -0,0 +1,114 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// SharedWorkerService: one pool of real-time worker threads for every plugin
+// instance in a process.
+//
+// When a host loads many instances of a plugin, a WorkerPool in each instance
+// would start far more threads than there are cores. Instead, each instance
+// holds a SharedResourcePointer<SharedWorkerService>, and all of them send
+// their jobs to the same workers, one fewer than the number of cores. The
+// service is made with the first pointer and its threads are joined when the
+// last one goes away.
+//
+// Any number of threads may call run() at once. Each job has a deadline, and
+// free workers take tasks from the job with the earliest deadline first. The
+// thread calling run() works on its own job too, and while it waits for the
+// last of its tasks it helps with jobs that are due before its own. Jobs are
+// held in a fixed number of slots; if all are taken, the job is run on the
+// calling thread. Nothing is allocated or locked after construction.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "MLWorkerPool.h"
+
+namespace ml
+{
+class SharedWorkerService final
+{
+ public:
+  using TaskFn = WorkerPool::TaskFn;
+  using Clock = WorkerPool::Clock;
+
+  // the number of jobs that can be running at once.
+  static constexpr size_t kMaxJobs{64};
+
+  // one worker for each core but one, which is left for the calling threads.
+  SharedWorkerService();
+
+  // a service with a given number of workers, for testing.
+  explicit SharedWorkerService(size_t nWorkers);
+
+  ~SharedWorkerService();
+
+  SharedWorkerService(const SharedWorkerService&) = delete;
+  SharedWorkerService& operator=(const SharedWorkerService&) = delete;
+
+  size_t getNumWorkers() const { return threads_.size(); }
+
+  // Run fn(context, i) for each i in [0, nTasks) and return when all tasks are
+  // done. Tasks of jobs with earlier deadlines are run first. Returns false if
+  // the tasks finished after the deadline.
+  bool run(size_t nTasks, TaskFn fn, void* context,
+           Clock::time_point deadline = Clock::time_point::max());
+
+  // the number of jobs run on the calling thread because all slots were taken.
+  size_t getOverflowJobs() const { return overflowJobs_.load(std::memory_order_relaxed); }
+
+ private:
+  static constexpr int kSpinsBeforeYield{2000};
+  static constexpr int kSpinsBeforeSleep{20000};
+  static constexpr std::chrono::milliseconds kSleepTimeout{1};
+
+  struct Job
+  {
+    // the slot is taken by a caller of run().
+    std::atomic<bool> taken{false};
+
+    // generation in the high 32 bits, next task to claim in the low 32 bits.
+    std::atomic<uint64_t> claim{0};
+    uint32_t generation{0};
+
+    // fn and context are only read by a thread that has claimed a task, during
+    // which run() can't return and change them.
+    TaskFn fn{nullptr};
+    void* context{nullptr};
+    std::atomic<size_t> nTasks{0};
+    std::atomic<size_t> completed{0};
+    std::atomic<Clock::rep> deadline{0};
+  };
+
+  void startWorkers(size_t nWorkers);
+  void workerLoop();
+
+  // run one task of the job with the earliest deadline that has tasks left,
+  // considering only jobs due no later than latest. Returns false if there was
+  // none.
+  bool doEarliestTask(Clock::rep latest);
+
+  // claim and run one task of a job. Returns false if it had none left.
+  bool doTask(Job& job, uint64_t generation);
+
+  std::vector<std::thread> threads_;
+  std::array<Job, kMaxJobs> jobs_;
+
+  // a bit for each slot with a running job.
+  std::atomic<uint64_t> activeJobs_{0};
+
+  std::atomic<size_t> overflowJobs_{0};
+  std::atomic<bool> quit_{false};
+  std::atomic<int> sleepers_{0};
+  std::mutex sleepMutex_;
+  std::condition_variable wakeCondition_;
+};
+
+}  // namespace ml
@@ -0,0 +1,112 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLSignalBuses.h"
+
+#include <algorithm>
+
+namespace ml
+{
+size_t SignalBuses::findOrAddBus(Path name, size_t channels)
+{
+  resolved_ = false;
+  size_t id = busIDsByName_[name];
+  if ((id < buses_.size()) && (buses_[id].name == name))
+  {
+    if (buses_[id].channels != channels) buses_[id].valid = false;
+    return id;
+  }
+  id = buses_.size();
+  busIDsByName_[name] = id;
+  Bus b;
+  b.name = name;
+  b.channels = channels;
+  buses_.push_back(b);
+  return id;
+}
+
+void SignalBuses::addInput(Path bus, size_t channels)
+{
+  Bus& b = buses_[findOrAddBus(bus, channels)];
+  if (b.isInput || (b.writer != kNoWriter)) b.valid = false;
+  b.isInput = true;
+}
+
+SignalBuses::PortID SignalBuses::declareOutput(ClientID client, Path bus, size_t channels)
+{
+  const size_t id = findOrAddBus(bus, channels);
+  Bus& b = buses_[id];
+  if (b.isInput || (b.writer != kNoWriter)) b.valid = false;
+  b.writer = client;
+  ports_.push_back(Port{client, id, true});
+  return ports_.size() - 1;
+}
+
+SignalBuses::PortID SignalBuses::declareInput(ClientID client, Path bus, size_t channels)
+{
+  const size_t id = findOrAddBus(bus, channels);
+  ports_.push_back(Port{client, id, false});
+  return ports_.size() - 1;
+}
+
+bool SignalBuses::resolve()
+{
+  resolved_ = false;
+  dependencies_.clear();
+  for (auto& p : ports_)
+  {
+    p.pVector = nullptr;
+  }
+
+  size_t total{0};
+  for (auto& b : buses_)
+  {
+    if (!b.valid || (!b.isInput && (b.writer == kNoWriter))) return false;
+    b.start = total;
+    total += b.channels;
+  }
+  arena_.resize(total);
+
+  for (auto& p : ports_)
+  {
+    const Bus& b = buses_[p.bus];
+    p.pVector = &arena_[int(b.start)];
+    if (!p.isOutput && !b.isInput && (b.writer != p.client))
+    {
+      dependencies_.emplace_back(b.writer, p.client);
+    }
+  }
+  std::sort(dependencies_.begin(), dependencies_.end());
+  dependencies_.erase(std::unique(dependencies_.begin(), dependencies_.end()),
+                      dependencies_.end());
+  resolved_ = true;
+  return true;
+}
+
+DSPVector* SignalBuses::getBus(Path name)
+{
+  if (!resolved_) return nullptr;
+  const size_t id = static_cast<const Tree<size_t>&>(busIDsByName_)[name];
+  if ((id < buses_.size()) && (buses_[id].name == name))
+  {
+    return &arena_[int(buses_[id].start)];
+  }
+  return nullptr;
+}
+
+size_t SignalBuses::getNumChannels(Path name) const
+{
+  const size_t id = busIDsByName_[name];
+  return ((id < buses_.size()) && (buses_[id].name == name)) ? buses_[id].channels : 0;
+}
+
+void SignalBuses::clear()
+{
+  for (size_t i = 0; i < arena_.size(); ++i)
+  {
+    arena_[int(i)] = DSPVector();
+  }
+}
+
+}  // namespace ml
@@ -0,0 +1,105 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// SignalBuses: named signal buses between processors, resolved once at setup.
+//
+// During setup, each processor declares the buses it writes and reads by Path, along with the
+// number of channels. Buses that no processor writes are inputs from outside, which must be
+// added with addInput(). resolve() then gives every bus its place in one contiguous arena of
+// DSPVectors, and every declared port a direct pointer to the first channel of its bus, so that
+// processing needs no lookups by name.
+//
+// A reader of a bus depends on its writer. getDependencies() returns these as pairs of client
+// IDs, which can be passed to ProcessorGraph::addDependency() when the clients are its nodes.
+//
+// Declaring and resolving are not real-time safe. After resolve() succeeds, the pointers stay
+// valid until the next declaration.
+
+#pragma once
+
+#include <utility>
+#include <vector>
+
+#include "MLDSPOps.h"
+#include "MLPath.h"
+#include "MLTree.h"
+
+namespace ml
+{
+class SignalBuses final
+{
+ public:
+  using ClientID = size_t;
+  using PortID = size_t;
+
+  // add a bus with channels filled from outside the processors.
+  void addInput(Path bus, size_t channels);
+
+  // declare that the client writes the bus. Each bus has only one writer.
+  PortID declareOutput(ClientID client, Path bus, size_t channels);
+
+  // declare that the client reads the bus.
+  PortID declareInput(ClientID client, Path bus, size_t channels);
+
+  // Lay out the buses and point the ports at them. Returns false if a bus has more than one
+  // writer, is read but never written, or is declared with different numbers of channels. The
+  // ports point to nothing until resolve() succeeds.
+  bool resolve();
+
+  bool isResolved() const { return resolved_; }
+
+  // the first channel of a port's bus. The other channels follow it.
+  DSPVector* getOutput(PortID p) const { return ports_[p].pVector; }
+  const DSPVector* getInput(PortID p) const { return ports_[p].pVector; }
+
+  // the first channel of the named bus, or nullptr if there is none. Not for the audio thread.
+  DSPVector* getBus(Path bus);
+
+  size_t getNumBuses() const { return buses_.size(); }
+  size_t getNumChannels(Path bus) const;
+
+  // the number of DSPVectors in the arena.
+  size_t getArenaSize() const { return arena_.size(); }
+
+  // pairs of (writer, reader) clients for each bus, without duplicates, after resolve().
+  const std::vector<std::pair<ClientID, ClientID>>& getDependencies() const
+  {
+    return dependencies_;
+  }
+
+  // set all the buses to 0.
+  void clear();
+
+ private:
+  static constexpr ClientID kNoWriter = ~size_t(0);
+
+  struct Bus
+  {
+    Path name;
+    size_t channels{0};
+    size_t start{0};
+    ClientID writer{kNoWriter};
+    bool isInput{false};
+    bool valid{true};
+  };
+
+  struct Port
+  {
+    ClientID client;
+    size_t bus;
+    bool isOutput;
+    DSPVector* pVector{nullptr};
+  };
+
+  size_t findOrAddBus(Path bus, size_t channels);
+
+  std::vector<Bus> buses_;
+  std::vector<Port> ports_;
+  Tree<size_t> busIDsByName_;
+  DSPVectorDynamic arena_;
+  std::vector<std::pair<ClientID, ClientID>> dependencies_;
+  bool resolved_{false};
+};
+
+}  // namespace ml
@@ -2,8 +2,10 @@
 // Created by Randy Jones on 2/27/25.
 //
 
+#include "MLAudioThreadCheck.h"
 #include "MLDSPBuffer.h"
 #include "MLDSPOps.h"
+#include "MLMemoryUtils.h"
 #include "MLSignalProcessBuffer.h"
 
 using namespace ml;
@@ -14,54 +16,73 @@ namespace ml
 // DSPVector-sized chunks.
 
 SignalProcessBuffer::SignalProcessBuffer(size_t inputs, size_t outputs, size_t maxFrames)
-    : maxFrames_(maxFrames)
+    : maxFrames_(maxFrames), nInputs_(inputs), nOutputs_(outputs)
 {
-  inputBuffers_.resize(inputs);
-  for (int i = 0; i < inputs; ++i)
+  inputBuffer_.resize(inputs, (int)maxFrames_);
+  outputBuffer_.resize(outputs, (int)maxFrames_);
+}
+
+SignalProcessBuffer::~SignalProcessBuffer() {}
+
+bool SignalProcessBuffer::lockMemory()
+{
+  bool locked{true};
+  for (auto* b : {&inputBuffer_, &outputBuffer_})
   {
-    inputBuffers_[i].resize((int)maxFrames_);
+    if (b->getStorageSize() > 0)
+    {
+      locked &= lockAndPrefault(b->getStorage(), b->getStorageSize() * sizeof(float));
+    }
   }
-
-  outputBuffers_.resize(outputs);
-  for (int i = 0; i < outputs; ++i)
+  for (auto* v : {&inputFrames_, &outputFrames_, &interleaveScratch_})
   {
-    outputBuffers_[i].resize((int)maxFrames_);
+    if (!v->empty())
+    {
+      locked &= lockAndPrefault(v->data(), v->size() * sizeof(float));
+    }
   }
+  return locked;
 }
 
-SignalProcessBuffer::~SignalProcessBuffer() {}
-
 // Buffer the external context and provide an internal context for the process function.
 // Then run the process function in the internal context, updating its state.
 void SignalProcessBuffer::process(const float** externalInputs, float** externalOutputs,
                                   int externalFrames, AudioContext* context,
                                   SignalProcessFn processFn, void* state)
 {
-  size_t nInputs = inputBuffers_.size();
-  size_t nOutputs = outputBuffers_.size();
-  if (nOutputs < 1) return;
+  // with ML_CHECK_AUDIO_THREAD, find allocations and locks made while processing.
+  [[maybe_unused]] AudioThreadScope audioThreadScope;
+
+  if (nOutputs_ < 1) return;
   if (!externalOutputs) return;
   if (externalFrames > (int)maxFrames_) return;
 
-  // write vectors from external inputs (if any) to inputBuffers
-  for (int c = 0; c < nInputs; c++)
+  context->loadMeter.beginBlock();
+
+  // if the external block is a whole number of DSPVectors and no frames from
+  // earlier ragged blocks are buffered, bypass the buffers.
+  if ((externalFrames % kFloatsPerDSPVector == 0) && buffersAreEmpty())
   {
-    if (externalInputs[c])
-    {
-      inputBuffers_[c].write(externalInputs[c], externalFrames);
-    }
+    processDirect(externalInputs, externalOutputs, externalFrames, context, processFn, state);
+    context->clearInputEvents();
+    context->loadMeter.endBlock(externalFrames);
+    return;
+  }
+
+  hasBuffered_ = true;
+
+  // write frames from external inputs (if any) to the input buffer. Missing inputs are silent.
+  if ((nInputs_ > 0) && externalInputs)
+  {
+    inputBuffer_.writePlanar(externalInputs, externalFrames);
   }
 
   // run vector-size process until we have externalFrames of output
   int startOffset{0};
-  while (outputBuffers_[0].getReadAvailable() < externalFrames)
+  while (outputBuffer_.getReadAvailable() < (size_t)externalFrames)
   {
-    // read one chunk from each input buffer
-    for (int c = 0; c < nInputs; c++)
-    {
-      // read one DSPVector from the input buffer.
-      context->inputs[c] = inputBuffers_[c].read();
-    }
+    // read one DSPVector for each input.
+    inputBuffer_.read(context->inputs);
 
     // process one vector of the context, generating event / controller signals
     context->processVector(startOffset);
@@ -70,23 +91,98 @@ void SignalProcessBuffer::process(const float** externalInputs, float** external
     // run the signal processing function
     processFn(context, state);
 
-    // write one vector to each output buffer
-    for (int c = 0; c < nOutputs; c++)
-    {
-      outputBuffers_[c].write(context->outputs[c]);
-    }
+    // write one vector for each output
+    outputBuffer_.write(context->outputs);
+  }
+
+  // read from the output buffer to external outputs
+  outputBuffer_.readPlanar(externalOutputs, externalFrames);
+
+  context->clearInputEvents();
+  context->loadMeter.endBlock(externalFrames);
+}
+
+void SignalProcessBuffer::setExternalFormat(SampleFormat format, bool interleaved, bool dither)
+{
+  format_ = format;
+  interleaved_ = interleaved;
+  dither_ = dither;
+  inputFrames_.assign(nInputs_ * maxFrames_, 0.f);
+  outputFrames_.assign(nOutputs_ * maxFrames_, 0.f);
+  interleaveScratch_.assign(interleaved ? std::max(nInputs_, nOutputs_) * maxFrames_ : 0, 0.f);
+  inputPtrs_.resize(nInputs_);
+  outputPtrs_.resize(nOutputs_);
+}
+
+void SignalProcessBuffer::process(const void* externalInputs, void* externalOutputs,
+                                  int externalFrames, AudioContext* context,
+                                  SignalProcessFn processFn, void* state)
+{
+  if (!externalOutputs) return;
+  if (externalFrames > (int)maxFrames_) return;
+  if (outputFrames_.size() < nOutputs_ * maxFrames_) return;
+
+  // the planar frames are packed, one channel right after another.
+  const size_t frames = externalFrames;
+  for (size_t c = 0; c < nInputs_; ++c)
+  {
+    inputPtrs_[c] = inputFrames_.data() + c * frames;
+  }
+  for (size_t c = 0; c < nOutputs_; ++c)
+  {
+    outputPtrs_[c] = outputFrames_.data() + c * frames;
+  }
+
+  const float** inputs{nullptr};
+  if (externalInputs && nInputs_)
+  {
+    convertToPlanarFloats(externalInputs, format_, interleaved_, inputPtrs_.data(), nInputs_,
+                          frames, interleaveScratch_.data());
+    inputs = const_cast<const float**>(inputPtrs_.data());
   }
 
-  // read from outputBuffers to external outputs
-  for (int c = 0; c < nOutputs; c++)
+  process(inputs, outputPtrs_.data(), externalFrames, context, processFn, state);
+
+  convertFromPlanarFloats(outputPtrs_.data(), format_, interleaved_, externalOutputs, nOutputs_,
+                          frames, interleaveScratch_.data(), dither_ ? &ditherNoise_ : nullptr);
+}
+
+bool SignalProcessBuffer::buffersAreEmpty() const
+{
+  return (inputBuffer_.getReadAvailable() == 0) && (outputBuffer_.getReadAvailable() == 0);
+}
+
+// Run the process function on the external buffers one DSPVector at a time,
+// copying each vector once between the external buffers and the context.
+void SignalProcessBuffer::processDirect(const float** externalInputs, float** externalOutputs,
+                                        int externalFrames, AudioContext* context,
+                                        SignalProcessFn processFn, void* state)
+{
+  for (int startOffset = 0; startOffset < externalFrames; startOffset += kFloatsPerDSPVector)
   {
-    if (externalOutputs[c])
+    for (int c = 0; c < nInputs_; c++)
     {
-      outputBuffers_[c].read(externalOutputs[c], externalFrames);
+      if (externalInputs && externalInputs[c])
+      {
+        load(context->inputs[c], externalInputs[c] + startOffset);
+      }
+      else
+      {
+        context->inputs[c] = DSPVector();
+      }
     }
-  }
 
-  context->clearInputEvents();
+    context->processVector(startOffset);
+    processFn(context, state);
+
+    for (int c = 0; c < nOutputs_; c++)
+    {
+      if (externalOutputs[c])
+      {
+        store(context->outputs[c], externalOutputs[c] + startOffset);
+      }
+    }
+  }
 }
 
 }  // namespace ml
@@ -4,9 +4,12 @@
 
 #pragma once
 
+#include <vector>
+
 #include "MLAudioContext.h"
 #include "MLDSPBuffer.h"
 #include "MLDSPOps.h"
+#include "MLDSPSampleFormats.h"
 
 using namespace ml;
 namespace ml
@@ -20,11 +23,29 @@ using SignalProcessFn = void (*)(AudioContext*, void*);
 class SignalProcessBuffer final
 {
   // buffers containing audio to / from outside world, in bigger chunks
-  std::vector<ml::DSPBuffer> inputBuffers_;
-  std::vector<ml::DSPBuffer> outputBuffers_;
+  ml::MultiChannelDSPBuffer inputBuffer_;
+  ml::MultiChannelDSPBuffer outputBuffer_;
 
   // max chunk size for outside I/O
   size_t maxFrames_;
+  size_t nInputs_;
+  size_t nOutputs_;
+  bool hasBuffered_{false};
+
+  // external format, and planar floats for the external frames in other formats.
+  SampleFormat format_{SampleFormat::kFloat32};
+  bool interleaved_{false};
+  bool dither_{false};
+  TPDFDither ditherNoise_;
+  std::vector<float> inputFrames_;
+  std::vector<float> outputFrames_;
+  std::vector<float> interleaveScratch_;
+  std::vector<float*> inputPtrs_;
+  std::vector<float*> outputPtrs_;
+
+  bool buffersAreEmpty() const;
+  void processDirect(const float** inputs, float** outputs, int nFrames, AudioContext* ctx,
+                     SignalProcessFn processFn, void* pState);
 
  public:
   SignalProcessBuffer(size_t inputs, size_t outputs, size_t maxFrames);
@@ -32,6 +53,28 @@ class SignalProcessBuffer final
 
   void process(const float** inputs, float** outputs, int nFrames, AudioContext* ctx,
                SignalProcessFn processFn, void* pState);
+
+  // set the format of the external frames for process() with untyped buffers: planar, each
+  // channel's frames after the last one's, or interleaved. Integer outputs are dithered if
+  // dither is set. This allocates the buffers for converting, so should be done at setup.
+  void setExternalFormat(SampleFormat format, bool interleaved, bool dither = true);
+
+  // process external frames in the format set by setExternalFormat(). The inputs are
+  // converted to planar floats and the outputs from them, with the SIMD kernels of
+  // MLDSPSampleFormats.h.
+  void process(const void* inputs, void* outputs, int nFrames, AudioContext* ctx,
+               SignalProcessFn processFn, void* pState);
+
+  size_t getMaxFrames() const { return maxFrames_; }
+
+  // Blocks that are a whole number of DSPVectors pass through without delay. Once a block of
+  // any other size has been buffered, outputs are delayed by up to one DSPVector, which is
+  // reported here as kFloatsPerDSPVector.
+  size_t getLatencyInSamples() const { return hasBuffered_ ? kFloatsPerDSPVector : 0; }
+
+  // lock the input and output buffers into memory and touch all their pages, for use from a
+  // real-time thread. Returns true if all the buffers were locked.
+  bool lockMemory();
 };
 
 }  // namespace ml
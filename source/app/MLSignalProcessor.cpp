@@ -4,16 +4,31 @@
 
 #include "MLSignalProcessor.h"
 
+#include <cmath>
+
 using namespace ml;
 
 // SignalProcessor::PublishedSignal
 
 SignalProcessor::PublishedSignal::PublishedSignal(int maxFrames, int maxVoices, int channels,
-                                                  int octavesDown)
-    : channels_(channels), maxFrames_(maxFrames), octavesDown_(octavesDown)
+                                                  int octavesDown, bool filtered)
+    : maxFrames_(maxFrames), maxVoices_(std::max(maxVoices, 1)), channels_(channels),
+      octavesDown_(octavesDown)
 {
+  if (filtered && octavesDown > 0)
+  {
+    downsamplers_.reserve(maxVoices_ * channels_);
+    for (size_t i = 0; i < maxVoices_ * channels_; ++i)
+    {
+      downsamplers_.emplace_back(octavesDown);
+    }
+
+    // filtered frames are written a whole DSPVector at a time.
+    maxFrames = std::max(maxFrames, int(kFloatsPerDSPVector));
+  }
+
   voiceRotateBuffer.resize(maxFrames * channels);
-  buffer_.resize(maxFrames * channels * maxVoices);
+  buffer_.resize(maxFrames * channels * maxVoices_);
 }
 
 size_t SignalProcessor::PublishedSignal::readLatest(float* pDest, size_t framesRequested)
@@ -36,3 +51,106 @@ size_t SignalProcessor::PublishedSignal::read(float* pDest, size_t framesRequest
 {
   return buffer_.read(pDest, framesRequested * channels_);
 }
+
+void SignalProcessor::PublishedSignal::setSnapshotMode(size_t frames)
+{
+  if (!channels_) return;
+  std::vector<float> window(std::max(frames, size_t(1)) * channels_);
+  snapshot_ = std::make_unique<TripleBuffer<std::vector<float>>>(window);
+  snapshotPosition_ = 0;
+}
+
+size_t SignalProcessor::PublishedSignal::getSnapshotFrames() const
+{
+  return (snapshot_ && channels_) ? snapshot_->getReadBuffer().size() / channels_ : 0;
+}
+
+size_t SignalProcessor::PublishedSignal::getMemoryBytes() const
+{
+  size_t bytes = voiceRotateBuffer.capacity() * sizeof(float) + buffer_.getMemoryBytes() +
+                 downsamplers_.capacity() * sizeof(Downsampler);
+  if (snapshot_)
+  {
+    bytes += sizeof(*snapshot_) + 3 * getSnapshotFrames() * channels_ * sizeof(float);
+  }
+  return bytes;
+}
+
+size_t SignalProcessor::PublishedSignal::getRequestedMemoryBytes() const
+{
+  // only the DSPBuffer is rounded up.
+  return getMemoryBytes() - buffer_.getMemoryBytes() + buffer_.getRequestedMemoryBytes();
+}
+
+bool SignalProcessor::PublishedSignal::readSnapshot(float* pDest)
+{
+  if (!snapshot_) return false;
+  bool isNew = snapshot_->update();
+  const std::vector<float>& window = snapshot_->getReadBuffer();
+  std::copy(window.begin(), window.end(), pDest);
+  return isNew;
+}
+
+// SignalProcessor
+
+size_t SignalProcessor::applyNormalizedParams(const float* normValues,
+                                              std::vector<size_t>* changedIDs)
+{
+  const size_t n = paramNamesByID_.size();
+  params_.convertNormalizedToRealFloatValues(normValues, batchRealValues_.data());
+  size_t changes{0};
+  for (size_t id = 0; id < n; ++id)
+  {
+    // a NaN in the input leaves the parameter as it is.
+    const float norm = normValues[id];
+    const float real = batchRealValues_[id];
+    if ((norm != norm) || (real != real) || (real == paramStore_.getStaged(id))) continue;
+    const CompiledParameter& c = params_.getCompiledParameter(id);
+    if (!c.exists) continue;
+
+    const Path& pname = paramNamesByID_[id];
+    params_.paramsNorm_[pname] = Value(norm);
+    params_.paramsReal_[pname] = c.integerValues ? Value(static_cast<int>(real)) : Value(real);
+    paramStore_.set(id, real);
+    if (changedIDs) changedIDs->push_back(id);
+    changes++;
+  }
+  publishParams();
+  return changes;
+}
+
+size_t SignalProcessor::applyNormalizedParams(const Tree<Value>& values,
+                                              std::vector<size_t>* changedIDs)
+{
+  const Tree<size_t>& ids = paramIDsByName_;
+  std::fill(batchNormValues_.begin(), batchNormValues_.end(), std::nanf(""));
+  for (auto it = values.begin(); it != values.end(); ++it)
+  {
+    const Path pname = it.getCurrentPath();
+    const Value& val = *it;
+    const size_t id = ids[pname];
+    const bool hasID = (id < paramNamesByID_.size()) && (paramNamesByID_[id] == pname);
+    if (hasID && (val.getType() == Value::kFloat))
+    {
+      batchNormValues_[id] = val.getFloatValue();
+    }
+    else
+    {
+      params_.setFromNormalizedValue(pname, val);
+    }
+  }
+  return applyNormalizedParams(batchNormValues_.data(), changedIDs);
+}
+
+void SignalProcessor::reportMemory(MemoryReport& r) const
+{
+  for (auto it = publishedSignals_.begin(); it != publishedSignals_.end(); ++it)
+  {
+    if (const PublishedSignal* signal = (*it).get())
+    {
+      r.add(Path("published", it.getCurrentPath()), signal->getMemoryBytes(),
+            signal->getRequestedMemoryBytes());
+    }
+  }
+  r.add("parameters", paramNamesByID_.capacity() * sizeof(Path) + paramIDsByName_.getMemoryBytes());
+}
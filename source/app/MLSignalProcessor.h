@@ -4,7 +4,13 @@
 
 #pragma once
 
+#include <atomic>
+
+#include "MLDSPProfiler.h"
 #include "MLDSPUtils.h"
+#include "MLMemoryReport.h"
+#include "MLParameterRamps.h"
+#include "MLParameterStore.h"
 #include "MLParameters.h"
 #include "MLPlatform.h"
 #include "madronalib.h"
@@ -30,12 +36,47 @@ class SignalProcessor
     std::vector<float> voiceRotateBuffer;
     DSPBuffer buffer_;
     size_t maxFrames_{0};
+    size_t maxVoices_{0};
     size_t channels_{0};
     int octavesDown_{0};
     int downsampleCtr_{0};
 
-    PublishedSignal(int frames, int maxVoices, int channels, int octavesDown);
-    ~PublishedSignal() = default;
+    // for filtered decimation, one Downsampler for each channel of each voice.
+    std::vector<Downsampler> downsamplers_;
+
+    // for snapshot mode, the window being filled and the newest whole one.
+    std::unique_ptr<TripleBuffer<std::vector<float>>> snapshot_;
+    size_t snapshotPosition_{0};
+
+    // the number of readers watching the signal, and the count of readers watching any signal of
+    // the processor, if it was made by publishSignal().
+    std::atomic<int> subscribers_{0};
+    std::atomic<int>* allSubscribers_{nullptr};
+
+    // if filtered is true, decimation is done with low-pass filters instead of by dropping frames.
+    PublishedSignal(int frames, int maxVoices, int channels, int octavesDown, bool filtered = false);
+    ~PublishedSignal()
+    {
+      if(allSubscribers_) allSubscribers_->fetch_sub(subscribers_.load(), std::memory_order_relaxed);
+    }
+
+    // readers like displays subscribe while they are watching the signal, and unsubscribe when
+    // they stop, so that processors can skip the signals no one watches. Call these from the
+    // reading thread: the first subscriber discards the frames left from before.
+    void subscribe()
+    {
+      if(allSubscribers_) allSubscribers_->fetch_add(1, std::memory_order_relaxed);
+      if(subscribers_.fetch_add(1, std::memory_order_relaxed) == 0)
+      {
+        buffer_.discard(buffer_.getReadAvailable());
+      }
+    }
+    void unsubscribe()
+    {
+      subscribers_.fetch_sub(1, std::memory_order_relaxed);
+      if(allSubscribers_) allSubscribers_->fetch_sub(1, std::memory_order_relaxed);
+    }
+    inline bool hasSubscribers() const { return subscribers_.load(std::memory_order_relaxed) > 0; }
 
     inline size_t getNumChannels() const { return (size_t)channels_; }
     inline int getAvailableFrames() const { return (int)(channels_ ? (buffer_.getReadAvailable() / channels_) : 0); }
@@ -53,11 +94,41 @@ class SignalProcessor
     // nothing here enforces the voice order- processors are responsible for calling
     // storePublishedSignal() for each voice in rotation.
     //
-    // the voice param is not used currently but we can transmit the voice number in the future if needed.
+    // the voice param is used only to pick the filters for filtered decimation. Filtered
+    // decimation needs whole DSPVectors: for other frame counts, frames are dropped instead.
     //
     template <size_t CHANNELS>
     inline void writeQuick(DSPVectorArray<CHANNELS> inputVector, size_t frames, size_t voice)
     {
+      if(octavesDown_ == 0)
+      {
+        // every frame is written, so transpose them all at once.
+        storeFrames(inputVector, voiceRotateBuffer.data(), frames);
+        writeFrames(voiceRotateBuffer.data(), frames*CHANNELS);
+        return;
+      }
+
+      if(!downsamplers_.empty() && (frames == kFloatsPerDSPVector) && (CHANNELS == channels_))
+      {
+        // filter each channel, writing a whole vector of frames each (1<<octavesDown_)th call.
+        Downsampler* pFilters = &downsamplers_[(voice % maxVoices_)*CHANNELS];
+        bool ready{false};
+        for(int j=0; j<CHANNELS; ++j)
+        {
+          ready = pFilters[j].write(inputVector.row(j));
+        }
+        if(ready)
+        {
+          for(int j=0; j<CHANNELS; ++j)
+          {
+            inputVector.row(j) = pFilters[j].read();
+          }
+          storeFrames(inputVector, voiceRotateBuffer.data(), kFloatsPerDSPVector);
+          writeFrames(voiceRotateBuffer.data(), kFloatsPerDSPVector*CHANNELS);
+        }
+        return;
+      }
+
       // on every (1<<octavesDown_)th frame, rotate and write to DSPBuffer
       int framesWritten = 0;
       for(int f=0; f<frames; ++f)
@@ -77,7 +148,7 @@ class SignalProcessor
       
       if(framesWritten)
       {
-        buffer_.write(voiceRotateBuffer.data(), framesWritten*CHANNELS);
+        writeFrames(voiceRotateBuffer.data(), framesWritten*CHANNELS);
       }
     }
     
@@ -89,7 +160,7 @@ class SignalProcessor
       downsampleCtr_++;
       if(downsampleCtr_ >= (1 << octavesDown_))
       {
-        buffer_.write(inputVector, channels);
+        writeFrames(inputVector, channels);
         downsampleCtr_ = 0;
       }
     }
@@ -101,6 +172,46 @@ class SignalProcessor
     size_t read(float* pDest, size_t framesRequested);
     
     void peekLatest(float* pDest, size_t framesRequested);
+
+    // switch to snapshot mode. Instead of streaming every frame, each window of the given
+    // number of frames is published whole, and readers get only the newest window. This should
+    // be called before processing starts.
+    void setSnapshotMode(size_t frames);
+    bool isSnapshotMode() const { return snapshot_ != nullptr; }
+    size_t getSnapshotFrames() const;
+
+    // copy the newest window in snapshot mode to pDest. Returns true if the window is new since
+    // the last call.
+    bool readSnapshot(float* pDest);
+
+    // the memory used by the buffers and filters, and the part of it that was asked for.
+    size_t getMemoryBytes() const;
+    size_t getRequestedMemoryBytes() const;
+
+    // write frames to the DSPBuffer, or to the snapshot window in snapshot mode.
+    inline void writeFrames(const float* pSrc, size_t floats)
+    {
+      if(!snapshot_)
+      {
+        buffer_.write(pSrc, floats);
+        return;
+      }
+
+      while(floats > 0)
+      {
+        std::vector<float>& window = snapshot_->getWriteBuffer();
+        size_t n = std::min(floats, window.size() - snapshotPosition_);
+        std::copy(pSrc, pSrc + n, window.data() + snapshotPosition_);
+        pSrc += n;
+        floats -= n;
+        snapshotPosition_ += n;
+        if(snapshotPosition_ == window.size())
+        {
+          snapshot_->publish();
+          snapshotPosition_ = 0;
+        }
+      }
+    }
   };
 
   // class used for assigning each instance of our SignalProcessor a unique ID
@@ -123,6 +234,20 @@ class SignalProcessor
   virtual void setSampleRate(double sr) { sampleRate_ = sr; }
   double getSampleRate() const { return sampleRate_; }
 
+  // Latency: the delay in samples from the processor's inputs to the corresponding outputs, as
+  // made by oversampling, lookahead or block transforms. Processors set it when it changes,
+  // from any thread. Adapters report it to the host and find out about changes with
+  // takeLatencyChange(), which returns true once after each change.
+  void setLatencyInSamples(size_t n)
+  {
+    if (latency_.exchange(n, std::memory_order_relaxed) != n)
+    {
+      latencyChanged_.store(true, std::memory_order_release);
+    }
+  }
+  size_t getLatencyInSamples() const { return latency_.load(std::memory_order_relaxed); }
+  bool takeLatencyChange() { return latencyChanged_.exchange(false, std::memory_order_acquire); }
+
   // Parameter tree access (needed for adapter initialization)
   ParameterTree& getParameterTree() { return params_; }
   const ParameterTree& getParameterTree() const { return params_; }
@@ -138,78 +263,266 @@ class SignalProcessor
     return publishedSignals_;
   }
   
+  // write all the published signals, whether or not they have subscribers.
   void setPublishedSignalsActive(bool b) { publishedSignalsAreActive_ = b; }
 
+  // true if the signal is written: all signals are while setPublishedSignalsActive(true),
+  // otherwise only those with subscribers. Processors can check this before computing the data
+  // for a signal, to skip the work for signals no one is watching.
+  inline bool isPublishedSignalActive(const PublishedSignal* publishedSignal) const
+  {
+    return publishedSignal && (publishedSignalsAreActive_ || publishedSignal->hasSubscribers());
+  }
+
+  // true if any published signal may be written.
+  inline bool anyPublishedSignalActive() const
+  {
+    return publishedSignalsAreActive_ ||
+           (publishedSignalSubscribers_.load(std::memory_order_relaxed) > 0);
+  }
+
+  // Profiling. createProfiler() makes a DSPProfiler for this processor if it has none, and is
+  // not real-time safe. After adding sections to it, processVector() can time them with
+  // ML_PROFILE_SCOPE(getProfiler(), id), and must call getProfiler()->endVector() before
+  // returning. Without a profiler the scopes do nothing.
+  virtual DSPProfiler* createProfiler()
+  {
+    if (!profiler_) profiler_ = std::make_unique<DSPProfiler>();
+    return profiler_.get();
+  }
+  DSPProfiler* getProfiler() { return profiler_.get(); }
+
+  // Memory. reportMemory() adds the memory owned by this processor to a report, each object
+  // under a Path that names it. Overrides should add their own delays, buffers and samples and
+  // call this version, which adds the published signals and the parameter names. Not
+  // real-time safe.
+  virtual void reportMemory(MemoryReport& r) const;
+
+  // build the parameter tree and compile it for access by ID. If no IDs have been assigned yet,
+  // the parameters are numbered in list order.
   inline void buildParams(const ParameterDescriptionList& paramList)
   {
     buildParameterTree(paramList, params_);
+    if (paramNamesByID_.empty())
+    {
+      for (const auto& paramDesc : paramList)
+      {
+        Path pname = runtimePath(paramDesc->getTextProperty("name"));
+        paramIDsByName_[pname] = paramNamesByID_.size();
+        paramNamesByID_.push_back(pname);
+      }
+    }
+    compileParams();
   };
+
+  // compile the parameters again after changing paramNamesByID_.
+  inline void compileParams()
+  {
+    params_.compileParameters(paramNamesByID_);
+    paramStore_.resize(paramNamesByID_.size());
+    batchNormValues_.resize(paramNamesByID_.size());
+    batchRealValues_.resize(paramNamesByID_.size());
+    paramRamps_.resize(params_);
+    stageAllParams();
+  }
   
   inline void setDefaultParams()
   {
     setDefaults(params_);
+    stageAllParams();
   };
 
+  // The setters are called from the UI or host thread. They update the parameter tree, and stage
+  // the real values of parameters that have IDs. Staged values are sent to the audio thread
+  // by publishParams().
+
   void setParamFromNormalizedValue(Path pname, float val)
   {
     params_.setFromNormalizedValue(pname, val);
+    stageParam(pname);
   }
 
   void setParamFromRealValue(Path pname, float val)
   {
     params_.setFromRealValue(pname, val);
+    stageParam(pname);
+  }
+
+  void setParamFromNormalizedValue(size_t id, float val)
+  {
+    params_.setFromNormalizedValue(paramNamesByID_[id], val);
+    paramStore_.set(id, params_.convertNormalizedToRealFloatValue(id, val));
+  }
+
+  void setParamFromRealValue(size_t id, float val)
+  {
+    params_.setFromRealValue(paramNamesByID_[id], val);
+    paramStore_.set(id, val);
+  }
+
+  // For adapters whose host delivers parameter changes on the audio thread, like CLAP. The real
+  // value is staged like the other setters, but the parameter tree is not changed. The adapter
+  // must then be the only caller of the setters, and call publishParams() itself.
+  void setParamFromAudioThread(size_t id, float realValue) { paramStore_.set(id, realValue); }
+
+  void publishParams() { paramStore_.publish(); }
+
+  // Apply many parameter values at once, as when loading a preset. normValues holds a
+  // normalized value for each parameter ID, or NaN to leave a parameter as it is. The values
+  // are converted together, compared with the staged real values, and only the parameters
+  // whose real values change are set in the parameter tree and staged. Their IDs are added to
+  // changedIDs if it is given. Then all the changes are published to the audio thread at once,
+  // so that the next vector sees the whole preset. Returns the number of parameters changed.
+  size_t applyNormalizedParams(const float* normValues, std::vector<size_t>* changedIDs = nullptr);
+
+  // the same from a tree of normalized values by name, as from a preset file. Values that are
+  // not numbers, or that belong to parameters without IDs, are set one at a time.
+  size_t applyNormalizedParams(const Tree<Value>& values,
+                               std::vector<size_t>* changedIDs = nullptr);
+
+  // Sample-accurate automation, for adapters that call setParamFromAudioThread(). Before each
+  // vector, the adapter adds the vector's parameter events with their sample offsets and
+  // normalized values, then calls updateParamRamps() after updateParamSnapshot(). Each ramp
+  // starts from the parameter's value in the current snapshot.
+  void addParamEvent(size_t id, int time, float normValue)
+  {
+    if (id >= paramRamps_.size()) return;
+    if (!paramRamps_.hasEvents(id))
+    {
+      paramRamps_.setNormalizedValue(
+          id, params_.convertRealToNormalizedFloatValue(id, paramStore_.get(id)));
+    }
+    paramRamps_.addEvent(id, time, normValue);
   }
 
-  inline float getRealFloatParam(Path pname)
+  void updateParamRamps() { paramRamps_.process(); }
+
+  // Called from the audio thread, typically at the start of processVector(), to get the latest
+  // published values. Until the next call, getRealFloatParam(id) reads the same snapshot and
+  // never touches the parameter tree.
+  bool updateParamSnapshot() { return paramStore_.update(); }
+
+  // the ID and Path getters are all const, so that an ID argument always picks the ID overload.
+  inline float getRealFloatParam(size_t id) const { return paramStore_.get(id); }
+
+  // the real values of a parameter over the current vector: its ramp if it has automation events
+  // in this vector, otherwise its value in the current snapshot.
+  inline DSPVector getRealParamRamp(size_t id)
+  {
+    return paramRamps_.isRamping(id) ? paramRamps_.getRamp(id) : DSPVector(paramStore_.get(id));
+  }
+
+  inline float getRealFloatParam(Path pname) const
   {
     return params_.getRealFloatValueAtPath(pname);
   }
 
-  inline float getNormalizedFloatParam(Path pname)
+  inline float getNormalizedFloatParam(Path pname) const
   {
     return params_.getNormalizedFloatValueAtPath(pname);
   }
+
+  inline float getNormalizedFloatParam(size_t id) const
+  {
+    return params_.getNormalizedFloatValueAtPath(paramNamesByID_[id]);
+  }
   
  protected:
 
   ParameterTree params_;
+  // subscribers to all the published signals, declared first so that it outlives them.
+  std::atomic<int> publishedSignalSubscribers_{0};
   Tree< std::unique_ptr<PublishedSignal> > publishedSignals_;
   SharedResourcePointer<ProcessorRegistry> registry_;
   float sampleRate_{0.f};
   bool publishedSignalsAreActive_{false};
+  std::atomic<size_t> latency_{0};
+  std::atomic<bool> latencyChanged_{false};
+  std::unique_ptr<DSPProfiler> profiler_;
   
   // used by clients currently, don't delete! And TODO move relevant client code into this class.
   size_t uniqueID_;
   std::vector< ml::Path > paramNamesByID_;
   Tree<size_t> paramIDsByName_;
+
+  // real values of the parameters by ID, for lock-free reads from the audio thread.
+  ParameterStore paramStore_;
+
+  // ramps of the automation events for the current vector, by ID.
+  ParameterRamps paramRamps_;
+
+  // scratch values by ID for applyNormalizedParams().
+  std::vector<float> batchNormValues_;
+  std::vector<float> batchRealValues_;
+
+  inline void stageParam(Path pname)
+  {
+    size_t id = paramIDsByName_[pname];
+    if ((id < paramNamesByID_.size()) && (paramNamesByID_[id] == pname))
+    {
+      paramStore_.set(id, params_.getRealFloatValueAtPath(pname));
+    }
+  }
+
+  inline void stageAllParams()
+  {
+    for (size_t id = 0; id < paramNamesByID_.size(); ++id)
+    {
+      paramStore_.set(id, params_.getRealFloatValueAtPath(paramNamesByID_[id]));
+    }
+  }
   
-  inline void publishSignal(Path signalName, int maxFrames, int maxVoices, int channels, int octavesDown)
+  // publish a signal, returning a pointer to it that stays valid until the signal is published
+  // again or the processor is destroyed. Storing to the pointer avoids looking up the name.
+  inline PublishedSignal* publishSignal(Path signalName, int maxFrames, int maxVoices, int channels,
+                                        int octavesDown, bool filtered = false)
   {
-    publishedSignals_[signalName] = std::make_unique<PublishedSignal>(maxFrames, maxVoices, channels, octavesDown);
+    publishedSignals_[signalName] =
+        std::make_unique<PublishedSignal>(maxFrames, maxVoices, channels, octavesDown, filtered);
+    PublishedSignal* publishedSignal = publishedSignals_[signalName].get();
+    publishedSignal->allSubscribers_ = &publishedSignalSubscribers_;
+    return publishedSignal;
+  }
+
+  // get the named signal, or nullptr if it has not been published. This never adds a node, so
+  // it can be called from the audio thread.
+  inline PublishedSignal* getPublishedSignal(Path signalName) const
+  {
+    auto pNode = publishedSignals_.getNode(signalName);
+    return pNode ? pNode->getValue().get() : nullptr;
   }
 
   // store a DSPVectorArray to the named signal buffer.
   // we need a buffer for each published signal here to move signals safely from the Processor
   // to the main thread.
+  // while no signal is active, these return before looking up the name.
   template <size_t CHANNELS>
   inline void storePublishedSignal(Path signalName, const DSPVectorArray<CHANNELS>& inputVec, int frames, int voice)
   {
-    if(!publishedSignalsAreActive_) return;
-    PublishedSignal* publishedSignal = publishedSignals_[signalName].get();
-    if(publishedSignal)
-    {
-      publishedSignal->writeQuick(inputVec, frames, voice);
-    }
+    if(!anyPublishedSignalActive()) return;
+    storePublishedSignal(getPublishedSignal(signalName), inputVec, frames, voice);
   }
-  
+
   inline void storePublishedSignalVert(Path signalName, const float* pInput, int channels, int voice)
   {
-    if(!publishedSignalsAreActive_) return;
-    PublishedSignal* publishedSignal = publishedSignals_[signalName].get();
-    if(publishedSignal)
-    {
-      publishedSignal->writeQuickVert(pInput, channels, voice);
-    }
+    if(!anyPublishedSignalActive()) return;
+    storePublishedSignalVert(getPublishedSignal(signalName), pInput, channels, voice);
+  }
+
+  // store to a signal returned by publishSignal(), with no lookup by name.
+  template <size_t CHANNELS>
+  inline void storePublishedSignal(PublishedSignal* publishedSignal,
+                                   const DSPVectorArray<CHANNELS>& inputVec, int frames, int voice)
+  {
+    if(!isPublishedSignalActive(publishedSignal)) return;
+    publishedSignal->writeQuick(inputVec, frames, voice);
+  }
+
+  inline void storePublishedSignalVert(PublishedSignal* publishedSignal, const float* pInput,
+                                       int channels, int voice)
+  {
+    if(!isPublishedSignalActive(publishedSignal)) return;
+    publishedSignal->writeQuickVert(pInput, channels, voice);
   }
 };
 
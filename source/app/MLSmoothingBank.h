@@ -0,0 +1,141 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// SmoothingBank: linear glides for many parameters at once.
+//
+// Instead of one LinearGlide object per parameter, the bank keeps the state of
+// all its glides in parallel arrays indexed by parameter ID, and process()
+// updates them all with SIMD once per DSPVector. The values at the end of each
+// vector are always available, and getRamp() makes a DSPVector of the
+// sample-accurate ramp for any parameter that needs one.
+//
+// When a target changes, its glide starts from the current value and reaches
+// the target after the glide time, rounded to whole DSPVectors.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "MLDSPGens.h"
+#include "MLParameterStore.h"
+
+namespace ml
+{
+class SmoothingBank final
+{
+ public:
+  SmoothingBank() = default;
+  explicit SmoothingBank(size_t n) { resize(n); }
+
+  // not realtime safe. Sets all the values to 0 and all glide times to one vector.
+  void resize(size_t n)
+  {
+    size_ = n;
+    size_t padded = (n + kFloatsPerSIMDVector - 1) / kFloatsPerSIMDVector * kFloatsPerSIMDVector;
+    for (auto* v : {&previous_, &current_, &target_, &glideTarget_, &step_, &remaining_})
+    {
+      v->assign(padded, 0.f);
+    }
+    vectorsPerGlide_.assign(padded, 1.f);
+    dyPerVector_.assign(padded, 1.f);
+  }
+
+  size_t size() const { return size_; }
+
+  void setGlideTimeInSamples(size_t id, float t)
+  {
+    float vectors = std::max(1.f, std::floor(t / kFloatsPerDSPVector));
+    vectorsPerGlide_[id] = vectors;
+    dyPerVector_[id] = 1.f / vectors;
+  }
+
+  void setGlideTimeInSamples(float t)
+  {
+    for (size_t i = 0; i < size_; ++i)
+    {
+      setGlideTimeInSamples(i, t);
+    }
+  }
+
+  // set the value to glide to. Glides start at the next process().
+  void setTarget(size_t id, float val) { target_[id] = val; }
+
+  // set the targets of all the parameters from an array of size() values.
+  void setTargets(const float* vals) { std::copy(vals, vals + size_, target_.begin()); }
+
+  // set the targets from the current snapshot of a ParameterStore with the same IDs.
+  void setTargets(const ParameterStore& store) { setTargets(store.getValues()); }
+
+  // set the value immediately, without gliding.
+  void setValue(size_t id, float val)
+  {
+    previous_[id] = current_[id] = target_[id] = glideTarget_[id] = val;
+    step_[id] = remaining_[id] = 0.f;
+  }
+
+  // advance all the glides by one DSPVector.
+  void process()
+  {
+    const SIMDVectorFloat zeros = vecZeros();
+    const SIMDVectorFloat ones = vecSet1(1.f);
+    for (size_t i = 0; i < previous_.size(); i += kFloatsPerSIMDVector)
+    {
+      SIMDVectorFloat current = vecLoadUnaligned(&current_[i]);
+      SIMDVectorFloat target = vecLoadUnaligned(&target_[i]);
+      SIMDVectorFloat step = vecLoadUnaligned(&step_[i]);
+      SIMDVectorFloat remaining = vecLoadUnaligned(&remaining_[i]);
+      vecStoreUnaligned(&previous_[i], current);
+
+      // start new glides where the target has changed.
+      SIMDVectorFloat changed = vecNotEqual(target, vecLoadUnaligned(&glideTarget_[i]));
+      SIMDVectorFloat dy = vecLoadUnaligned(&dyPerVector_[i]);
+      SIMDVectorFloat newStep = vecMul(vecSub(target, current), dy);
+      step = vecSelect(newStep, step, changed);
+      remaining = vecSelect(vecLoadUnaligned(&vectorsPerGlide_[i]), remaining, changed);
+
+      // step, and land exactly on the target at the end.
+      current = vecAdd(current, step);
+      remaining = vecMax(vecSub(remaining, ones), zeros);
+      SIMDVectorFloat done = vecLessThanOrEqual(remaining, zeros);
+      current = vecSelect(target, current, done);
+      step = vecSelect(zeros, step, done);
+
+      vecStoreUnaligned(&current_[i], current);
+      vecStoreUnaligned(&glideTarget_[i], target);
+      vecStoreUnaligned(&step_[i], step);
+      vecStoreUnaligned(&remaining_[i], remaining);
+    }
+  }
+
+  // the value at the end of the current vector.
+  float getValue(size_t id) const { return current_[id]; }
+  const float* getValues() const { return current_.data(); }
+
+  bool isGliding(size_t id) const { return remaining_[id] > 0.f; }
+
+  // the sample-accurate ramp over the current vector.
+  DSPVector getRamp(size_t id) const
+  {
+    float start = previous_[id];
+    return DSPVector(start) + kUnityRampVec * DSPVector(current_[id] - start);
+  }
+
+ private:
+  size_t size_{0};
+
+  // each array is padded to a whole number of SIMD vectors. The glide lengths
+  // are stored as floats so they can be used in the same SIMD code.
+  std::vector<float> previous_;
+  std::vector<float> current_;
+  std::vector<float> target_;
+  std::vector<float> glideTarget_;
+  std::vector<float> step_;
+  std::vector<float> remaining_;
+  std::vector<float> vectorsPerGlide_;
+  std::vector<float> dyPerVector_;
+};
+
+}  // namespace ml
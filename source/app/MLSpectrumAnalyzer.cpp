@@ -0,0 +1,169 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLSpectrumAnalyzer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace ml
+{
+
+namespace
+{
+size_t nextPowerOfTwo(size_t n)
+{
+  size_t p = 1;
+  while (p < n) p <<= 1;
+  return p;
+}
+}  // namespace
+
+SpectrumAnalyzer::SpectrumAnalyzer(SignalProcessor::PublishedSignal& signal, float sampleRate,
+                                   const SpectrumAnalyzerConfig& config)
+    : signal_(signal),
+      sampleRate_(sampleRate),
+      config_(config),
+      downsampler_(std::max(config.decimationOctaves, 0)),
+      spectra_(std::vector<float>(nextPowerOfTwo(std::max(config.fftSize, size_t(4))) / 2 + 1,
+                                  kMinDb))
+{
+  config_.fftSize = nextPowerOfTwo(std::max(config_.fftSize, size_t(4)));
+  config_.hopSize = std::max(config_.hopSize, size_t(1));
+  config_.decimationOctaves = std::max(config_.decimationOctaves, 0);
+  config_.averaging = std::clamp(config_.averaging, 0.f, 0.999f);
+  const size_t n = config_.fftSize;
+
+  fft_ = std::make_unique<ffft::FFTReal<float>>(long(n));
+  fftInput_.resize(n);
+  fftOutput_.resize(n);
+  history_.assign(n, 0.f);
+  power_.assign(getNumBins(), 0.f);
+  samplesToHop_ = config_.hopSize;
+
+  // a periodic Hann window, scaled so that a full-scale sine has a magnitude of 1.
+  window_.resize(n);
+  float sum{0.f};
+  for (size_t i = 0; i < n; ++i)
+  {
+    window_[i] = 0.5f - 0.5f * cosf(kTwoPi * float(i) / float(n));
+    sum += window_[i];
+  }
+  for (auto& w : window_)
+  {
+    w *= 2.f / sum;
+  }
+
+  const size_t channels = std::max(signal_.getNumChannels(), size_t(1));
+  readBuffer_.resize(kFloatsPerDSPVector * channels);
+}
+
+SpectrumAnalyzer::~SpectrumAnalyzer() { stop(); }
+
+void SpectrumAnalyzer::start(int intervalMs)
+{
+  if (thread_.joinable()) return;
+  stopRequested_ = false;
+  auto interval = std::chrono::milliseconds(std::max(intervalMs, 1));
+  thread_ = std::thread(
+      [this, interval]()
+      {
+        std::unique_lock<std::mutex> lock(threadMutex_);
+        while (!stopRequested_)
+        {
+          analyze();
+          threadCondition_.wait_for(lock, interval, [this]() { return stopRequested_; });
+        }
+      });
+}
+
+void SpectrumAnalyzer::stop()
+{
+  if (!thread_.joinable()) return;
+  {
+    std::lock_guard<std::mutex> lock(threadMutex_);
+    stopRequested_ = true;
+  }
+  threadCondition_.notify_one();
+  thread_.join();
+}
+
+size_t SpectrumAnalyzer::analyze()
+{
+  const size_t channels = signal_.getNumChannels();
+  if (config_.channel >= channels) return 0;
+
+  published_ = 0;
+  while (size_t frames = signal_.read(readBuffer_.data(), kFloatsPerDSPVector) / channels)
+  {
+    // gather the channel, and decimate it a whole DSPVector at a time.
+    float* pGathered = gathered_.getBuffer();
+    for (size_t i = 0; i < frames; ++i)
+    {
+      pGathered[gatheredSamples_++] = readBuffer_[i * channels + config_.channel];
+      if (gatheredSamples_ < kFloatsPerDSPVector) continue;
+      gatheredSamples_ = 0;
+      if (!config_.decimationOctaves)
+      {
+        addSamples(pGathered, kFloatsPerDSPVector);
+      }
+      else if (downsampler_.write(gathered_))
+      {
+        DSPVector decimated = downsampler_.read();
+        addSamples(decimated.getConstBuffer(), kFloatsPerDSPVector);
+      }
+    }
+  }
+  return published_;
+}
+
+float SpectrumAnalyzer::getBinFrequency(size_t bin) const
+{
+  const float rate = sampleRate_ / float(1 << config_.decimationOctaves);
+  return rate * float(bin) / float(config_.fftSize);
+}
+
+void SpectrumAnalyzer::addSamples(const float* pSrc, size_t n)
+{
+  const size_t size = config_.fftSize;
+  for (size_t i = 0; i < n; ++i)
+  {
+    history_[historyIndex_] = pSrc[i];
+    historyIndex_ = (historyIndex_ + 1) & (size - 1);
+    if (--samplesToHop_ == 0)
+    {
+      transform();
+      samplesToHop_ = config_.hopSize;
+    }
+  }
+}
+
+void SpectrumAnalyzer::transform()
+{
+  // window the history, oldest sample first.
+  const size_t size = config_.fftSize;
+  for (size_t i = 0; i < size; ++i)
+  {
+    fftInput_[i] = history_[(historyIndex_ + i) & (size - 1)] * window_[i];
+  }
+  fft_->do_fft(fftOutput_.data(), fftInput_.data());
+
+  // ffft stores real parts of bins [0, N/2] at [0, N/2] and imaginary parts of bins
+  // [1, N/2 - 1] at [N/2 + 1, N - 1].
+  const size_t half = size / 2;
+  const float a = config_.averaging;
+  std::vector<float>& spectrum = spectra_.getWriteBuffer();
+  for (size_t bin = 0; bin <= half; ++bin)
+  {
+    float re = fftOutput_[bin];
+    float im = ((bin > 0) && (bin < half)) ? fftOutput_[half + bin] : 0.f;
+    power_[bin] = a * power_[bin] + (1.f - a) * (re * re + im * im);
+    spectrum[bin] = std::max(10.f * log10f(power_[bin] + 1e-30f), kMinDb);
+  }
+  spectra_.publish();
+  published_++;
+}
+
+}  // namespace ml
@@ -0,0 +1,118 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// SpectrumAnalyzer: magnitude spectra of a PublishedSignal, made on a background thread.
+//
+// The analyzer reads one channel of the signal's frames, decimates them by octaves with a
+// Downsampler if asked, and takes a Hann-windowed FFT of the last fftSize frames every hopSize
+// frames. The power of each bin is averaged over time, converted to dB and published in a
+// TripleBuffer, from which displays take the newest spectrum. A full-scale sine at the center
+// of a bin reads 0 dB.
+//
+// The audio thread only writes the signal as usual. The analyzer must be the signal's only
+// reader, and the signal must stream with one voice, holding frames for a few intervals of
+// the analyzer thread.
+
+#pragma once
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "MLDSPFilters.h"
+#include "MLQueue.h"
+#include "MLSignalProcessor.h"
+#include "ffft/FFTReal.h"
+
+namespace ml
+{
+
+struct SpectrumAnalyzerConfig
+{
+  // frames per FFT, a power of two.
+  size_t fftSize{2048};
+
+  // frames between FFTs, after decimation. fftSize / 4 makes a 75% overlap.
+  size_t hopSize{512};
+
+  // decimate the signal by this many octaves before analysis, to see low frequencies in
+  // more detail.
+  int decimationOctaves{0};
+
+  // how much of the averaged power is kept at each FFT, from 0 for no averaging to below 1.
+  float averaging{0.5f};
+
+  // the channel of the signal to analyze.
+  size_t channel{0};
+};
+
+class SpectrumAnalyzer
+{
+ public:
+  // spectra are clamped at this level.
+  static constexpr float kMinDb{-140.f};
+
+  // the signal must outlive the analyzer. sampleRate is that of the frames in the signal.
+  SpectrumAnalyzer(SignalProcessor::PublishedSignal& signal, float sampleRate,
+                   const SpectrumAnalyzerConfig& config = SpectrumAnalyzerConfig());
+  ~SpectrumAnalyzer();
+
+  SpectrumAnalyzer(const SpectrumAnalyzer&) = delete;
+  SpectrumAnalyzer& operator=(const SpectrumAnalyzer&) = delete;
+
+  // start and stop the analyzer thread, which reads the signal every intervalMs milliseconds.
+  void start(int intervalMs = 10);
+  void stop();
+
+  // read all the frames available from the signal and analyze them. This is what the analyzer
+  // thread does, and can also be called from one other thread when it is not running. Returns
+  // the number of spectra published.
+  size_t analyze();
+
+  // for the display thread: take the newest spectrum if there is one, returning true if so.
+  // The spectrum holds getNumBins() levels in dB.
+  bool updateSpectrum() { return spectra_.update(); }
+  const std::vector<float>& getSpectrum() const { return spectra_.getReadBuffer(); }
+
+  const SpectrumAnalyzerConfig& getConfig() const { return config_; }
+  size_t getNumBins() const { return config_.fftSize / 2 + 1; }
+  float getBinFrequency(size_t bin) const;
+
+ private:
+  void addSamples(const float* pSrc, size_t n);
+  void transform();
+
+  SignalProcessor::PublishedSignal& signal_;
+  float sampleRate_;
+  SpectrumAnalyzerConfig config_;
+
+  std::unique_ptr<ffft::FFTReal<float>> fft_;
+  std::vector<float> window_;
+  std::vector<float> fftInput_;
+  std::vector<float> fftOutput_;
+  std::vector<float> power_;
+
+  // the last fftSize samples, as a ring.
+  std::vector<float> history_;
+  size_t historyIndex_{0};
+  size_t samplesToHop_{0};
+
+  // frames read from the signal, and one channel of them gathered for decimation.
+  std::vector<float> readBuffer_;
+  DSPVector gathered_;
+  size_t gatheredSamples_{0};
+  Downsampler downsampler_;
+
+  size_t published_{0};
+  TripleBuffer<std::vector<float>> spectra_;
+
+  std::thread thread_;
+  std::mutex threadMutex_;
+  std::condition_variable threadCondition_;
+  bool stopRequested_{false};
+};
+
+}  // namespace ml
@@ -4,58 +4,343 @@
 
 #include "MLSymbol.h"
 
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
 #include <mutex>
+#include <new>
 
 namespace ml
 {
 
 const TextFragment SymbolTable::kNullText{"?"};
 
-uint64_t SymbolTable::registerSymbol(const char* text, size_t len)
+// ----------------------------------------------------------------
+// Arena
+
+void* SymbolTable::Arena::allocate(size_t bytes, size_t alignment)
+{
+  // new char[] is aligned for any fundamental type.
+  assert(alignment <= alignof(std::max_align_t));
+
+  if (bytes + alignment > kMaxArenaBlockSize)
+  {
+    // an oversized request gets its own block, and the current block stays
+    // in use for smaller requests.
+    blocks.emplace_back(new char[bytes]);
+    bytesReserved += bytes;
+    bytesUsed += bytes;
+    return blocks.back().get();
+  }
+
+  size_t misalignment = reinterpret_cast<uintptr_t>(next) & (alignment - 1);
+  size_t pad = misalignment ? alignment - misalignment : 0;
+  if (pad + bytes > remaining)
+  {
+    blocks.emplace_back(new char[nextBlockSize]);
+    next = blocks.back().get();
+    remaining = nextBlockSize;
+    bytesReserved += nextBlockSize;
+    nextBlockSize = std::min(nextBlockSize * 2, kMaxArenaBlockSize);
+    pad = 0;
+  }
+
+  char* p = next + pad;
+  next = p + bytes;
+  remaining -= pad + bytes;
+  bytesUsed += pad + bytes;
+  return p;
+}
+
+void SymbolTable::Arena::clear()
+{
+  blocks.clear();
+  next = nullptr;
+  remaining = 0;
+  nextBlockSize = kFirstArenaBlockSize;
+  bytesUsed = 0;
+  bytesReserved = 0;
+}
+
+// ----------------------------------------------------------------
+// SymbolTable
+
+// probe for hash without locking. returns nullptr if not found.
+const TextFragment* SymbolTable::find(const Table* t, uint64_t hash)
 {
-  uint64_t hash = fnv1aRuntime(text, len);
+  if (!t) return nullptr;
+  for (size_t i = hash & t->mask;; i = (i + 1) & t->mask)
+  {
+    uint64_t h = t->entries[i].hash.load(std::memory_order_acquire);
+    if (h == hash) return t->entries[i].text.load(std::memory_order_acquire);
+    if (h == 0) return nullptr;
+  }
+}
 
-  std::lock_guard<std::mutex> lock(mutex_);
+// add an entry. Called with the shard locked.
+void SymbolTable::insert(Table* t, uint64_t hash, const TextFragment* text)
+{
+  size_t i = hash & t->mask;
+  while (t->entries[i].hash.load(std::memory_order_relaxed) != 0)
+  {
+    i = (i + 1) & t->mask;
+  }
+  t->entries[i].text.store(text, std::memory_order_release);
+  t->entries[i].hash.store(hash, std::memory_order_release);
+}
 
-  auto it = symbols_.find(hash);
-  if (it != symbols_.end())
+void SymbolTable::checkCollision(const TextFragment* existing, const char* text, size_t len)
+{
+  if (existing->lengthInBytes() != len ||
+      !compareSizedCharArrays(existing->getText(), existing->lengthInBytes(), text, len))
   {
-    // Hash exists - check for collision
-    const TextFragment& existing = it->second;
-    if (existing.lengthInBytes() != len ||
-        !compareSizedCharArrays(existing.getText(), existing.lengthInBytes(), text, len))
+    throw std::runtime_error("Symbol hash collision detected!");
+  }
+}
+
+// make room for newSymbols more entries. When the table would be more than
+// half full, grow it. The old table stays valid for readers.
+void SymbolTable::reserve(Shard& shard, size_t newSymbols)
+{
+  Table* t = shard.table.load(std::memory_order_relaxed);
+  size_t capacity = t ? t->mask + 1 : 0;
+  size_t newCapacity = capacity ? capacity : kInitialShardCapacity;
+  while ((shard.count + newSymbols) * 2 > newCapacity)
+  {
+    newCapacity *= 2;
+  }
+  if (newCapacity == capacity) return;
+
+  auto newTable = std::make_unique<Table>(newCapacity);
+  if (t)
+  {
+    for (size_t i = 0; i <= t->mask; ++i)
     {
-      throw std::runtime_error("Symbol hash collision detected!");
+      uint64_t h = t->entries[i].hash.load(std::memory_order_relaxed);
+      if (h) insert(newTable.get(), h, t->entries[i].text.load(std::memory_order_relaxed));
     }
-    // Same string, return existing hash
+  }
+  shard.table.store(newTable.get(), std::memory_order_release);
+  shard.tables.push_back(std::move(newTable));
+}
+
+// add a new symbol, after reserve(). Called with the shard locked.
+void SymbolTable::add(Shard& shard, uint64_t hash, const char* text, size_t len)
+{
+  // copy the text into the arena, with a fragment referring to it. Arena
+  // fragments are never destroyed: their memory goes with the arena.
+  char* chars = static_cast<char*>(shard.arena.allocate(len + 1, 1));
+  std::copy(text, text + len, chars);
+  chars[len] = 0;
+  void* fragMem = shard.arena.allocate(sizeof(TextFragment), alignof(TextFragment));
+  const TextFragment* frag = new (fragMem) TextFragment(TextFragment::ExternalText{}, chars, len);
+
+  insert(shard.table.load(std::memory_order_relaxed), hash, frag);
+  shard.count++;
+  shard.textBytes += len;
+  size_.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t SymbolTable::registerSymbol(const char* text, size_t len)
+{
+  uint64_t hash = textHashRuntime(text, len);
+  Shard& shard = shards_[shardIndex(hash)];
+
+  // fast path: the symbol exists.
+  if (const TextFragment* existing = find(shard.table.load(std::memory_order_acquire), hash))
+  {
+    checkCollision(existing, text, len);
+    return hash;
+  }
+
+  std::lock_guard<std::mutex> lock(shard.mutex);
+
+  // another thread may have added it since we looked.
+  if (const TextFragment* existing = find(shard.table.load(std::memory_order_relaxed), hash))
+  {
+    checkCollision(existing, text, len);
     return hash;
   }
 
   // New symbol - register it
-  symbols_.emplace(hash, TextFragment(text, static_cast<int>(len)));
+  reserve(shard, 1);
+  add(shard, hash, text, len);
   return hash;
 }
 
-void SymbolTable::clear() { symbols_.clear(); }
+void SymbolTable::registerSymbols(const std::vector<std::string_view>& texts)
+{
+  // sort by shard, so that each shard is locked and grown once.
+  std::vector<std::pair<uint64_t, std::string_view> > entries;
+  entries.reserve(texts.size());
+  for (const auto& text : texts)
+  {
+    entries.emplace_back(textHashRuntime(text.data(), text.size()), text);
+  }
+  std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) {
+    return shardIndex(a.first) < shardIndex(b.first);
+  });
+
+  size_t i = 0;
+  while (i < entries.size())
+  {
+    size_t shardIdx = shardIndex(entries[i].first);
+    size_t end = i;
+    while (end < entries.size() && shardIndex(entries[end].first) == shardIdx) end++;
+
+    Shard& shard = shards_[shardIdx];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    reserve(shard, end - i);
+    for (; i < end; ++i)
+    {
+      uint64_t hash = entries[i].first;
+      const std::string_view& text = entries[i].second;
+      if (const TextFragment* existing = find(shard.table.load(std::memory_order_relaxed), hash))
+      {
+        checkCollision(existing, text.data(), text.size());
+      }
+      else
+      {
+        add(shard, hash, text.data(), text.size());
+      }
+    }
+  }
+}
+
+void SymbolTable::registerStaticSymbols()
+{
+  // texts are added at the head of the list, so the new ones are the ones
+  // before the head we saw last time.
+  const StaticSymbolText* head = StaticSymbolText::getHead();
+  const StaticSymbolText* oldHead = staticSymbolsHead_.load(std::memory_order_acquire);
+
+  std::vector<std::string_view> texts;
+  for (const StaticSymbolText* p = head; p != oldHead; p = p->next_)
+  {
+    std::string_view text(p->text_, p->length_);
+    if (!p->separator_)
+    {
+      if (!text.empty()) texts.push_back(text);
+      continue;
+    }
+    size_t start = 0;
+    while (start < text.size())
+    {
+      size_t end = text.find(p->separator_, start);
+      if (end == std::string_view::npos) end = text.size();
+      if (end > start) texts.push_back(text.substr(start, end - start));
+      start = end + 1;
+    }
+  }
+  registerSymbols(texts);
+  staticSymbolsHead_.store(head, std::memory_order_release);
+}
+
+void SymbolTable::reloadStaticSymbols()
+{
+  staticSymbolsHead_.store(nullptr, std::memory_order_release);
+  registerStaticSymbols();
+}
+
+void SymbolTable::clear()
+{
+  for (auto& shard : shards_)
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.table.store(nullptr, std::memory_order_release);
+    shard.tables.clear();
+    shard.arena.clear();
+    shard.count = 0;
+    shard.textBytes = 0;
+  }
+  size_.store(0, std::memory_order_relaxed);
+  staticSymbolsHead_.store(StaticSymbolText::getHead(), std::memory_order_release);
+}
 
 const TextFragment& SymbolTable::getTextForHash(uint64_t hash) const
 {
-  auto it = symbols_.find(hash);
+  const TextFragment* text = findText(hash);
 
   // if not found, return null object
-  if (it == symbols_.end()) return SymbolTable::kNullText;
+  if (!text) return SymbolTable::kNullText;
 
-  return it->second;
+  return *text;
+}
+
+const TextFragment* SymbolTable::findText(uint64_t hash) const
+{
+  return find(shards_[shardIndex(hash)].table.load(std::memory_order_acquire), hash);
+}
+
+std::string_view SymbolTable::getTextViewForHash(uint64_t hash) const
+{
+  const TextFragment& text = getTextForHash(hash);
+  return std::string_view(text.getText(), text.lengthInBytes());
+}
+
+SymbolTable::MemoryStats SymbolTable::getMemoryStats()
+{
+  MemoryStats stats;
+  for (auto& shard : shards_)
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    stats.symbols += shard.count;
+    stats.textBytes += shard.textBytes;
+    stats.arenaBytesUsed += shard.arena.bytesUsed;
+    stats.arenaBytesReserved += shard.arena.bytesReserved;
+    stats.arenaBlocks += shard.arena.blocks.size();
+    for (const auto& t : shard.tables)
+    {
+      stats.tableBytes += sizeof(Table) + (t->mask + 1) * sizeof(Entry);
+    }
+  }
+  return stats;
 }
 
 void SymbolTable::dump()
 {
-  std::cout << symbols_.size() << " symbols:\n";
+  std::cout << getSize() << " symbols:\n";
 
-  for (const auto& [hash, text] : symbols_)
+  for (auto& shard : shards_)
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    const Table* t = shard.table.load(std::memory_order_relaxed);
+    if (!t) continue;
+    for (size_t i = 0; i <= t->mask; ++i)
+    {
+      uint64_t hash = t->entries[i].hash.load(std::memory_order_relaxed);
+      if (!hash) continue;
+      const TextFragment* text = t->entries[i].text.load(std::memory_order_relaxed);
+      std::cout << "0x" << std::hex << hash << std::dec << " = \"" << *text << "\"\n";
+    }
+  }
+}
+
+// ----------------------------------------------------------------
+// SymbolScope
+
+uint64_t SymbolScope::registerSymbol(const char* text, size_t len)
+{
+  SymbolTable& global = theSymbolTable();
+  const uint64_t hash = textHashRuntime(text, len);
+  if (global.findText(hash)) return global.registerSymbol(text, len);
+  for (SymbolScope* s = parent_; s; s = s->parent_)
+  {
+    if (s->table_.findText(hash)) return s->table_.registerSymbol(text, len);
+  }
+  return table_.registerSymbol(text, len);
+}
+
+const TextFragment& SymbolScope::getTextForHash(uint64_t hash)
+{
+  SymbolTable& global = theSymbolTable();
+  if (const TextFragment* text = global.findText(hash)) return *text;
+  for (SymbolScope* s = current_; s; s = s->parent_)
   {
-    std::cout << "0x" << std::hex << hash << std::dec << " = \"" << text << "\"\n";
+    if (const TextFragment* text = s->table_.findText(hash)) return *text;
   }
+  return global.getTextForHash(hash);
 }
 
 std::ostream& operator<<(std::ostream& out, const Symbol r)
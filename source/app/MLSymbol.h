@@ -24,17 +24,21 @@
 // code that sets up signal-keyed structures has already been parsed.
 //
 // Symbol stores only a 64-bit hash. All Symbol construction registers the text
-// in the SymbolTable. Path uses compile-time hashing for performance without
-// requiring Symbol registration.
+// in the SymbolTable, or in the current SymbolScope for temporary symbols. Path
+// uses compile-time hashing for performance without requiring Symbol registration.
 //
 // see also: TextFragment, Path, Tree
 
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <cstring>
 #include <iostream>
-#include <unordered_map>
+#include <memory>
 #include <mutex>
+#include <string_view>
+#include <vector>
 
 #include "MLHash.h"
 #include "MLText.h"
@@ -42,7 +46,59 @@
 namespace ml
 {
 
+// StaticSymbolText: the text of symbols that are hashed at compile time, such
+// as the segments of a HashPath, so that they can be printed. Declare these at
+// namespace scope or as static members. The constructor only adds the object
+// to a global list, without allocating or locking. The SymbolTable loads any
+// texts added since it last looked in one bulk insert, the next time
+// theSymbolTable() is called.
+//
+// If separator is nonzero, the text is split at each separator and each
+// segment is registered, as for a path. Otherwise the whole text is one symbol.
+
+class StaticSymbolText
+{
+ public:
+  template <size_t N>
+  StaticSymbolText(const char (&text)[N], char separator = '/') noexcept
+      : text_(text), length_(strnlen(text, N)), separator_(separator)
+  {
+    next_ = head_.load(std::memory_order_relaxed);
+    while (!head_.compare_exchange_weak(next_, this, std::memory_order_release,
+                                        std::memory_order_relaxed))
+    {
+    }
+  }
+
+  StaticSymbolText(const StaticSymbolText&) = delete;
+  StaticSymbolText& operator=(const StaticSymbolText&) = delete;
+
+  // the most recently added text. The list is never consumed.
+  static const StaticSymbolText* getHead() { return head_.load(std::memory_order_acquire); }
+
+ private:
+  friend class SymbolTable;
+
+  const char* text_;
+  size_t length_;
+  char separator_;
+  const StaticSymbolText* next_{nullptr};
+
+  static inline std::atomic<const StaticSymbolText*> head_{nullptr};
+};
+
 // SymbolTable: stores symbol texts by their hashes.
+//
+// The table is split into shards by the high bits of the hash. Each shard is
+// an open-addressing hash table that readers probe without locking, so
+// looking up or re-registering an existing symbol never takes a mutex. Only
+// inserting a new symbol locks its shard. When a shard grows, the old table is
+// kept until clear() so that readers still probing it remain safe.
+//
+// Symbol texts are stored in an append-only arena per shard, made of large
+// blocks that never move. Registering a symbol never makes its own heap
+// allocation, text pointers stay valid until clear(), and clear() frees each
+// block in one go.
 
 class SymbolTable
 {
@@ -50,29 +106,174 @@ class SymbolTable
   SymbolTable() = default;
   ~SymbolTable() = default;
 
+  SymbolTable(const SymbolTable&) = delete;
+  SymbolTable& operator=(const SymbolTable&) = delete;
+
   // modifiers
   uint64_t registerSymbol(const char* text, size_t len);
+
+  // register many symbols, locking and growing each shard only once.
+  void registerSymbols(const std::vector<std::string_view>& texts);
+
+  // register the texts of any StaticSymbolText objects added since the last
+  // call. theSymbolTable() calls this automatically.
+  void registerStaticSymbols();
+
+  // register the texts of all StaticSymbolText objects, for example after clear().
+  void reloadStaticSymbols();
+  bool hasUnregisteredStaticSymbols() const
+  {
+    return StaticSymbolText::getHead() != staticSymbolsHead_.load(std::memory_order_acquire);
+  }
+
+  // not thread-safe: no other thread may use the table during clear().
+  // The table is left empty, without the static symbols registered so far.
   void clear();
 
   // accessors
   const TextFragment& getTextForHash(uint64_t hash) const;
-  size_t getSize() const { return symbols_.size(); }
+
+  // the text of a registered symbol, or nullptr.
+  const TextFragment* findText(uint64_t hash) const;
+  std::string_view getTextViewForHash(uint64_t hash) const;
+  size_t getSize() const { return size_.load(std::memory_order_relaxed); }
+
+  struct MemoryStats
+  {
+    size_t symbols{0};
+    size_t textBytes{0};
+    size_t arenaBytesUsed{0};
+    size_t arenaBytesReserved{0};
+    size_t arenaBlocks{0};
+    size_t tableBytes{0};
+  };
+  MemoryStats getMemoryStats();
 
   // utilities
   void dump();
 
  private:
-  std::unordered_map<uint64_t, TextFragment> symbols_;
-  mutable std::mutex mutex_;
+  static constexpr int kShardBits{6};
+  static constexpr size_t kShards{1 << kShardBits};
+  static constexpr size_t kInitialShardCapacity{64};
+  static constexpr size_t kFirstArenaBlockSize{4096};
+  static constexpr size_t kMaxArenaBlockSize{65536};
+
+  // append-only storage in blocks that never move. Blocks start small so
+  // that lightly used shards stay small, and double up to kMaxArenaBlockSize.
+  // Anything bigger than that gets a block of its own.
+  struct Arena
+  {
+    std::vector<std::unique_ptr<char[]> > blocks;
+    char* next{nullptr};
+    size_t remaining{0};
+    size_t nextBlockSize{kFirstArenaBlockSize};
+    size_t bytesUsed{0};
+    size_t bytesReserved{0};
+
+    void* allocate(size_t bytes, size_t alignment);
+    void clear();
+  };
+
+  // a hash of 0 marks an empty entry. text is written before hash.
+  struct Entry
+  {
+    std::atomic<uint64_t> hash{0};
+    std::atomic<const TextFragment*> text{nullptr};
+  };
+
+  struct Table
+  {
+    explicit Table(size_t capacity) : mask(capacity - 1), entries(new Entry[capacity]) {}
+    size_t mask;
+    std::unique_ptr<Entry[]> entries;
+  };
+
+  struct Shard
+  {
+    std::atomic<Table*> table{nullptr};
+    std::mutex mutex;
+    size_t count{0};
+
+    // all tables ever used by this shard, and storage for the texts they
+    // point to.
+    std::vector<std::unique_ptr<Table> > tables;
+    Arena arena;
+    size_t textBytes{0};
+  };
+
+  static size_t shardIndex(uint64_t hash) { return hash >> (64 - kShardBits); }
+  static const TextFragment* find(const Table* t, uint64_t hash);
+  static void insert(Table* t, uint64_t hash, const TextFragment* text);
+  static void checkCollision(const TextFragment* existing, const char* text, size_t len);
+
+  // called with the shard locked.
+  static void reserve(Shard& shard, size_t newSymbols);
+  void add(Shard& shard, uint64_t hash, const char* text, size_t len);
+
+  std::array<Shard, kShards> shards_;
+  std::atomic<size_t> size_{0};
+  std::atomic<const StaticSymbolText*> staticSymbolsHead_{nullptr};
   static const TextFragment kNullText;
 };
 
 inline SymbolTable& theSymbolTable()
 {
   static std::unique_ptr<SymbolTable> t(new SymbolTable());
+  if (t->hasUnregisteredStaticSymbols())
+  {
+    t->registerStaticSymbols();
+  }
   return *t;
 }
 
+// SymbolScope: a child table for temporary symbols, freed as a whole.
+//
+// While a SymbolScope exists, it is the current scope of the thread that made it, and new
+// symbols made on that thread are registered in its own table instead of the global one.
+// Symbols that are already in the global table or an outer scope stay there. When the scope
+// is destroyed, its table and all the texts in it are freed, so that transient symbols from
+// user text, renamed presets and the like don't stay resident for the life of the process.
+//
+// The texts of a scope's symbols can be looked up only on its thread, while it exists. Any
+// Symbol made in a scope must not be used after it, except to compare hashes: its text is
+// then "?". Scopes must be destroyed in the reverse order of their construction.
+
+class SymbolScope
+{
+ public:
+  SymbolScope() : parent_(current_) { current_ = this; }
+  ~SymbolScope() { current_ = parent_; }
+
+  SymbolScope(const SymbolScope&) = delete;
+  SymbolScope& operator=(const SymbolScope&) = delete;
+
+  // the innermost scope on this thread, or nullptr.
+  static SymbolScope* current() { return current_; }
+
+  // register a symbol in the global table or outer scope that has it, or else in this scope.
+  uint64_t registerSymbol(const char* text, size_t len);
+
+  // the text of a symbol in the global table or the scopes on this thread, or "?".
+  static const TextFragment& getTextForHash(uint64_t hash);
+
+  // the symbols registered in this scope only.
+  size_t getSize() const { return table_.getSize(); }
+  SymbolTable::MemoryStats getMemoryStats() { return table_.getMemoryStats(); }
+
+ private:
+  SymbolTable table_;
+  SymbolScope* parent_;
+  static inline thread_local SymbolScope* current_{nullptr};
+};
+
+// register a symbol in the current scope if there is one, otherwise in the global table.
+inline uint64_t registerSymbolText(const char* text, size_t len)
+{
+  SymbolScope* scope = SymbolScope::current();
+  return scope ? scope->registerSymbol(text, len) : theSymbolTable().registerSymbol(text, len);
+}
+
 // Symbol - stores a 64-bit hash, text looked up in SymbolTable
 // All constructors aside from the default ensure the symbol is registered in the table
 
@@ -85,15 +286,12 @@ class Symbol
   // Default constructor - null symbol
   constexpr Symbol() : hash_(0) {}
 
-  Symbol(const char* pC) : hash_(theSymbolTable().registerSymbol(pC, strlen(pC))) {}
+  Symbol(const char* pC) : hash_(registerSymbolText(pC, strlen(pC))) {}
 
-  Symbol(const char* pC, size_t lengthBytes)
-      : hash_(theSymbolTable().registerSymbol(pC, lengthBytes))
-  {
-  }
+  Symbol(const char* pC, size_t lengthBytes) : hash_(registerSymbolText(pC, lengthBytes)) {}
 
   explicit Symbol(const TextFragment& frag)
-      : hash_(theSymbolTable().registerSymbol(frag.getText(), frag.lengthInBytes()))
+      : hash_(registerSymbolText(frag.getText(), frag.lengthInBytes()))
   {
   }
 
@@ -107,8 +305,13 @@ class Symbol
   uint64_t getHash() const { return hash_; }
 
   // Text access - returns "?" if symbol not registered
-  const TextFragment& getTextFragment() const { return theSymbolTable().getTextForHash(hash_); }
+  const TextFragment& getTextFragment() const { return SymbolScope::getTextForHash(hash_); }
   const char* getUTF8Ptr() const { return getTextFragment().getText(); }
+  std::string_view getTextView() const
+  {
+    const TextFragment& text = getTextFragment();
+    return std::string_view(text.getText(), text.lengthInBytes());
+  }
 
   // Text operations
   bool beginsWith(Symbol b) const { return getTextFragment().beginsWith(b.getTextFragment()); }
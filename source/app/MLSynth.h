@@ -7,8 +7,14 @@
 #include "MLSignalProcessor.h"
 #include "MLAudioContext.h"
 #include "MLEventsToSignals.h"
+#include "MLVoiceModulation.h"
+#include "MLSharedResource.h"
+#include "MLSharedWorkerService.h"
+#include "MLWorkerPool.h"
 #include "mldsp.h"
 
+#include <memory>
+
 namespace ml
 {
 
@@ -44,19 +50,162 @@ public:
       outputs[i] = DSPVector{0.f};
     }
 
+    if (voiceModulation_.getNumParams() > 0) {
+      voiceModulation_.update(params_, paramStore_.getValues());
+    }
+
+    DSPProfiler* profiler = getProfiler();
+    if ((workerPool_ || sharedWorkers_ || hostTaskPool_) && (serialVectorsRemaining_ == 0)) {
+      {
+        // voices on other threads can't be timed separately.
+        ML_PROFILE_SCOPE(profiler, voicesSection_);
+        processVoicesParallel(inputs, outputs, audioContext);
+      }
+      if (profiler) profiler->endVector();
+      return;
+    }
+    if (serialVectorsRemaining_ > 0) serialVectorsRemaining_--;
+
     // Process each voice and mix
     int activeCount = 0;
-    for (int v = 0; v < numVoices_; ++v) {
-      const auto& voice = audioContext->getInputVoice(v);
+    {
+      ML_PROFILE_SCOPE(profiler, voicesSection_);
+      for (int v = 0; v < numVoices_; ++v) {
+        const auto& voice = audioContext->getInputVoice(v);
 
-      // Check if voice is active (let subclass decide)
-      if (isVoiceActive(v, voice)) {
-        activeCount++;
-        processVoice(v, voice, inputs, outputs, audioContext);
+        // Check if voice is active (let subclass decide)
+        if (isVoiceActive(v, voice) && !checkVoiceCulled(v, voice)) {
+          activeCount++;
+          ML_PROFILE_SCOPE(profiler, getVoiceSection(v));
+          const uint64_t start = TickClock::now();
+          if (cullThreshold_ > 0.f) {
+            // measure the voice's own output from the difference it makes.
+            if (cullScratch_.size() != outputs.size()) {
+              cullScratch_.resize(outputs.size());
+            }
+            for (int i = 0; i < outputs.size(); ++i) {
+              cullScratch_[i] = outputs[i];
+            }
+            processVoice(v, voice, inputs, outputs, audioContext);
+            float peak = 0.f;
+            for (int i = 0; i < outputs.size(); ++i) {
+              peak = std::max(peak, max(abs(outputs[i] - cullScratch_[i])));
+            }
+            updateVoiceLevel(v, voice, peak, audioContext);
+          } else {
+            processVoice(v, voice, inputs, outputs, audioContext);
+          }
+          audioContext->loadMeter.recordVoice(v, TickClock::now() - start);
+        } else {
+          audioContext->loadMeter.recordVoice(v, 0);
+        }
       }
     }
 
     activeVoiceCount_ = activeCount;
+    if (profiler) profiler->endVector();
+  }
+
+  // the profiler has a section "voices" for all the voices, and "voices/voice<n>" for each
+  // voice when they are rendered serially. Sections added by processVoice() are nested in them.
+  DSPProfiler* createProfiler() override {
+    DSPProfiler* profiler = SignalProcessor::createProfiler();
+    voicesSection_ = profiler->addSection(runtimePath("voices"));
+    voiceSections_.resize(numVoices_);
+    for (int v = 0; v < numVoices_; ++v) {
+      const std::string name = "voices/voice" + std::to_string(v);
+      voiceSections_[v] = profiler->addSection(runtimePath(name.c_str()));
+    }
+    return profiler;
+  }
+
+  // Render voices in parallel on nThreads worker threads plus the audio
+  // thread. 0 renders all voices serially on the audio thread. Not real-time
+  // safe: call before processing starts.
+  // In parallel mode, processVoice() is called from several threads at once,
+  // so it must only modify state belonging to its own voice. Each voice is
+  // rendered into its own outputs, which are summed in voice order.
+  void setVoiceThreads(size_t nThreads) {
+    workerPool_.reset();
+    if (nThreads > 0) {
+      workerPool_ = std::make_unique<WorkerPool>(nThreads);
+    }
+    voiceActive_.resize(numVoices_);
+    voiceOutputs_.resize(numVoices_);
+    missedDeadlines_ = 0;
+    serialVectorsRemaining_ = 0;
+  }
+
+  size_t getVoiceThreads() const { return workerPool_ ? workerPool_->getNumWorkers() : 0; }
+
+  // Render voices in parallel on threads borrowed from the host, such as a
+  // CLAP host's thread pool. Voices go to the host pool when it accepts them,
+  // and otherwise to the pool from setVoiceThreads(), or are rendered on the
+  // audio thread if there is none. An empty HostTaskPool stops using the host.
+  // Not real-time safe: call before processing starts.
+  void setHostTaskPool(HostTaskPool pool) {
+    hostTaskPool_ = pool;
+    voiceActive_.resize(numVoices_);
+    voiceOutputs_.resize(numVoices_);
+    missedDeadlines_ = 0;
+    serialVectorsRemaining_ = 0;
+  }
+
+  bool hasHostTaskPool() const { return static_cast<bool>(hostTaskPool_); }
+
+  // Render voices in parallel on the SharedWorkerService that all instances in
+  // the process share, instead of on threads of our own. Each vector's voices
+  // are one job with a deadline, so the voices of instances that are running
+  // late go first. A host pool is still used first when set. Not real-time
+  // safe: call before processing starts.
+  void setSharedVoiceWorkers(bool b) {
+    sharedWorkers_.reset();
+    if (b) {
+      sharedWorkers_ = std::make_unique<SharedResourcePointer<SharedWorkerService>>();
+    }
+    voiceActive_.resize(numVoices_);
+    voiceOutputs_.resize(numVoices_);
+    missedDeadlines_ = 0;
+    serialVectorsRemaining_ = 0;
+  }
+
+  bool hasSharedVoiceWorkers() const { return sharedWorkers_ != nullptr; }
+
+  // True if parallel rendering has missed its deadline repeatedly and voices
+  // are being rendered serially for a while.
+  bool isInSerialFallback() const { return serialVectorsRemaining_ > 0; }
+
+  // Voice culling: a released voice whose output peak stays below threshold
+  // for holdSeconds is no longer rendered, and the context is told that it can
+  // be reused first. It is rendered again when it starts a new note. A
+  // threshold of 0 turns culling off. Not real-time safe.
+  void setVoiceCulling(float threshold, float holdSeconds) {
+    cullThreshold_ = threshold;
+    cullHoldSeconds_ = holdSeconds;
+    voiceLevels_.assign(numVoices_, VoiceLevel{});
+  }
+
+  bool isVoiceCulled(int v) const {
+    return (cullThreshold_ > 0.f) && (v < (int)voiceLevels_.size()) && voiceLevels_[v].culled;
+  }
+
+  // Keep per-voice offsets for each parameter, as for CLAP polyphonic
+  // modulation. Call after buildParams(). Not real-time safe.
+  void enableVoiceModulation() {
+    voiceModulation_.resize(params_.getNumCompiledParameters(), numVoices_);
+  }
+
+  VoiceModulation& getVoiceModulation() { return voiceModulation_; }
+
+  // The real value of a parameter for one voice, including its modulation.
+  // For processVoice(): reads only the current snapshot, so it is safe from
+  // several threads when voices are rendered in parallel.
+  float getVoiceParam(size_t id, int voiceIndex) const {
+    return voiceModulation_.getModulatedValue(id, voiceIndex, paramStore_.getValues());
+  }
+
+  DSPVector getVoiceParamVector(size_t id, int voiceIndex) const {
+    return DSPVector(getVoiceParam(id, voiceIndex));
   }
 
   // Subclasses implement voice processing
@@ -90,6 +239,152 @@ public:
 protected:
   int numVoices_;
   int activeVoiceCount_ = 0;
+
+private:
+  // the parallel render of one vector should finish within this fraction of
+  // the vector's duration.
+  static constexpr double kDeadlineFraction = 0.75;
+
+  // after this many deadlines are missed in a row, fall back to serial
+  // rendering for kSerialFallbackVectors before trying parallel again.
+  static constexpr int kMaxMissedDeadlines = 4;
+  static constexpr int kSerialFallbackVectors = 1024;
+
+  struct ParallelVoiceJob {
+    Synth* synth;
+    const DSPVectorDynamic* inputs;
+    AudioContext* audioContext;
+  };
+
+  static void renderVoiceTask(void* context, size_t v) {
+    auto* job = static_cast<ParallelVoiceJob*>(context);
+    Synth* s = job->synth;
+    if (!s->voiceActive_[v]) {
+      job->audioContext->loadMeter.recordVoice(v, 0);
+      return;
+    }
+    const uint64_t start = TickClock::now();
+
+    DSPVectorDynamic& voiceOut = s->voiceOutputs_[v];
+    for (int i = 0; i < voiceOut.size(); ++i) {
+      voiceOut[i] = DSPVector{0.f};
+    }
+    s->processVoice(static_cast<int>(v), job->audioContext->getInputVoice(static_cast<int>(v)),
+                    *job->inputs, voiceOut, job->audioContext);
+    job->audioContext->loadMeter.recordVoice(v, TickClock::now() - start);
+  }
+
+  void processVoicesParallel(const DSPVectorDynamic& inputs,
+                             DSPVectorDynamic& outputs,
+                             AudioContext* audioContext) {
+    auto deadline = WorkerPool::Clock::time_point::max();
+    const double sr = audioContext->getSampleRate();
+    if (sr > 0.) {
+      deadline = WorkerPool::Clock::now() + std::chrono::duration_cast<WorkerPool::Clock::duration>(
+          std::chrono::duration<double>(kFloatsPerDSPVector * kDeadlineFraction / sr));
+    }
+    if (voiceOutputs_.size() != numVoices_) {
+      voiceActive_.resize(numVoices_);
+      voiceOutputs_.resize(numVoices_);
+    }
+
+    // decide voice activity serially, since isVoiceActive() may not be thread-safe.
+    int activeCount = 0;
+    for (int v = 0; v < numVoices_; ++v) {
+      const auto& voice = audioContext->getInputVoice(v);
+      voiceActive_[v] = isVoiceActive(v, voice) && !checkVoiceCulled(v, voice);
+      activeCount += voiceActive_[v];
+
+      // this only allocates if the number of outputs changes.
+      if (voiceOutputs_[v].size() != outputs.size()) {
+        voiceOutputs_[v].resize(outputs.size());
+      }
+    }
+    activeVoiceCount_ = activeCount;
+
+    ParallelVoiceJob job{this, &inputs, audioContext};
+    bool onTime;
+    if (hostTaskPool_ && hostTaskPool_.run(hostTaskPool_.context, numVoices_, renderVoiceTask, &job)) {
+      onTime = WorkerPool::Clock::now() <= deadline;
+    } else if (sharedWorkers_) {
+      onTime = (*sharedWorkers_)->run(numVoices_, renderVoiceTask, &job, deadline);
+    } else if (workerPool_) {
+      onTime = workerPool_->run(numVoices_, renderVoiceTask, &job, deadline);
+    } else {
+      for (int v = 0; v < numVoices_; ++v) {
+        renderVoiceTask(&job, v);
+      }
+      onTime = true;
+    }
+
+    // deterministic mix, in voice order
+    for (int v = 0; v < numVoices_; ++v) {
+      if (!voiceActive_[v]) continue;
+      float peak = 0.f;
+      for (int i = 0; i < outputs.size(); ++i) {
+        outputs[i] += voiceOutputs_[v][i];
+        if (cullThreshold_ > 0.f) peak = std::max(peak, max(abs(voiceOutputs_[v][i])));
+      }
+      updateVoiceLevel(v, audioContext->getInputVoice(v), peak, audioContext);
+    }
+
+    if (onTime) {
+      missedDeadlines_ = 0;
+    } else if (++missedDeadlines_ >= kMaxMissedDeadlines) {
+      missedDeadlines_ = 0;
+      serialVectorsRemaining_ = kSerialFallbackVectors;
+    }
+  }
+
+  struct VoiceLevel {
+    size_t quietFrames = 0;
+    bool culled = false;
+  };
+
+  // true if the voice is culled. A culled voice with a new note is not.
+  bool checkVoiceCulled(int v, const EventsToSignals::Voice& voice) {
+    if ((cullThreshold_ <= 0.f) || (v >= (int)voiceLevels_.size())) return false;
+    VoiceLevel& level = voiceLevels_[v];
+    if (level.culled && (voice.creatorKeyIdx_ != 0)) {
+      level = VoiceLevel{};
+    }
+    return level.culled;
+  }
+
+  void updateVoiceLevel(int v, const EventsToSignals::Voice& voice, float peak,
+                        AudioContext* audioContext) {
+    if ((cullThreshold_ <= 0.f) || (v >= (int)voiceLevels_.size())) return;
+    VoiceLevel& level = voiceLevels_[v];
+    if ((voice.creatorKeyIdx_ != 0) || (peak >= cullThreshold_)) {
+      level.quietFrames = 0;
+      return;
+    }
+    level.quietFrames += kFloatsPerDSPVector;
+    if (level.quietFrames > cullHoldSeconds_ * audioContext->getSampleRate()) {
+      level.culled = true;
+      audioContext->setInputVoiceInaudible(v);
+    }
+  }
+
+  DSPProfiler::SectionID getVoiceSection(int v) const {
+    return (v < (int)voiceSections_.size()) ? voiceSections_[v] : DSPProfiler::kNoSection;
+  }
+
+  DSPProfiler::SectionID voicesSection_ = DSPProfiler::kNoSection;
+  std::vector<DSPProfiler::SectionID> voiceSections_;
+
+  std::unique_ptr<WorkerPool> workerPool_;
+  std::unique_ptr<SharedResourcePointer<SharedWorkerService>> sharedWorkers_;
+  HostTaskPool hostTaskPool_;
+  VoiceModulation voiceModulation_;
+  float cullThreshold_ = 0.f;
+  float cullHoldSeconds_ = 0.f;
+  std::vector<VoiceLevel> voiceLevels_;
+  DSPVectorDynamic cullScratch_;
+  std::vector<uint8_t> voiceActive_;
+  std::vector<DSPVectorDynamic> voiceOutputs_;
+  int missedDeadlines_ = 0;
+  int serialVectorsRemaining_ = 0;
 };
 
 } // namespace ml
@@ -6,62 +6,30 @@
 
 #include <cstring>
 #include <iostream>
+#include <new>
 #include <vector>
 
+#include "MLDSPMath.h"
 #include "MLMemoryUtils.h"
 #include "utf.hpp"
 
 namespace ml
 {
-// Iterator::Impl
+// ASCII scanning
 
-class TextFragment::Iterator::Impl
+size_t countASCIIPrefix(const char* text, size_t bytes)
 {
-  friend class TextFragment::Iterator;
-  friend bool operator!=(Iterator lhs, Iterator rhs);
-  friend bool operator==(Iterator lhs, Iterator rhs);
-
-  utf::codepoint_iterator<const char*> utf8Iter_;
-
- public:
-  Impl(const char* pos) : utf8Iter_(utf::codepoint_iterator<const char*>(pos)) {}
-  Impl(const utf::codepoint_iterator<const char*>& utf_iter) : utf8Iter_(utf_iter) {}
-};
-
-// Iterator
-
-TextFragment::Iterator::Iterator(const char* pos) { pImpl = std::unique_ptr<Impl>(new Impl(pos)); }
-
-TextFragment::Iterator::Iterator(const Iterator& it)  // = default;
-{
-  pImpl = std::unique_ptr<Impl>(new Impl(it.pImpl->utf8Iter_));
-}
-
-TextFragment::Iterator::~Iterator() = default;
-
-CodePoint TextFragment::Iterator::operator*() { return pImpl->utf8Iter_.operator*(); }
-
-TextFragment::Iterator& TextFragment::Iterator::operator++()
-{
-  pImpl->utf8Iter_.operator++();
-  return *this;
-}
-
-CodePoint TextFragment::Iterator::operator++(int i)
-{
-  CodePoint preIncrementValue = pImpl->utf8Iter_.operator*();
-  pImpl->utf8Iter_.operator++(i);
-  return preIncrementValue;
-}
-
-bool operator!=(TextFragment::Iterator lhs, TextFragment::Iterator rhs)
-{
-  return lhs.pImpl->utf8Iter_ != rhs.pImpl->utf8Iter_;
-}
-
-bool operator==(TextFragment::Iterator lhs, TextFragment::Iterator rhs)
-{
-  return !(lhs.pImpl->utf8Iter_ != rhs.pImpl->utf8Iter_);
+  size_t i = 0;
+  for (; i + 16 <= bytes; i += 16)
+  {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+    if (_mm_movemask_epi8(v)) break;
+  }
+  for (; i < bytes; ++i)
+  {
+    if (text[i] & 0x80) break;
+  }
+  return i;
 }
 
 // TextFragment
@@ -120,34 +88,68 @@ TextFragment::TextFragment(CodePoint c) noexcept
 
 size_t TextFragment::lengthInBytes() const { return size_; }
 
-size_t TextFragment::lengthInCodePoints() const
+static size_t countCodePoints(const char* text, size_t bytes)
 {
-  utf::stringview<const char*> sv(pText_, pText_ + size_);
-  return sv.codepoints();
+  // ASCII bytes are one code point each.
+  size_t i = countASCIIPrefix(text, bytes);
+  size_t n = i;
+
+  // after that, each byte that is not a continuation byte 10xxxxxx starts a code point. The
+  // counts are kept in bytes for up to 255 blocks, then summed.
+  const __m128i vMaxCont = _mm_set1_epi8(char(0xbf));
+  while (i + 16 <= bytes)
+  {
+    __m128i vCounts = _mm_setzero_si128();
+    for (int b = 0; (b < 255) && (i + 16 <= bytes); ++b, i += 16)
+    {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+      vCounts = _mm_sub_epi8(vCounts, _mm_cmpgt_epi8(v, vMaxCont));
+    }
+    __m128i vSums = _mm_sad_epu8(vCounts, _mm_setzero_si128());
+    n += size_t(_mm_cvtsi128_si32(vSums)) + size_t(_mm_extract_epi16(vSums, 4));
+  }
+  for (; i < bytes; ++i)
+  {
+    n += ((text[i] & 0xc0) != 0x80);
+  }
+  return n;
 }
 
+size_t TextFragment::lengthInCodePoints() const { return countCodePoints(pText_, size_); }
+
 TextFragment::Iterator TextFragment::begin() const { return TextFragment::Iterator(getText()); }
 
 TextFragment::Iterator TextFragment::end() const { return Iterator(getText() + lengthInBytes()); }
 
+TextFragment::TextFragment(TextView v) noexcept
+{
+  _construct(v.getText(), v.lengthInBytes());
+}
+
 TextFragment::TextFragment(const TextFragment& a) noexcept
 {
-  _construct(a.getText(), a.lengthInBytes());
+  if (a.isShared())
+  {
+    _share(a);
+  }
+  else
+  {
+    _construct(a.getText(), a.lengthInBytes());
+  }
 }
 
-// just copy the data. If we want to optimize and use reference-counted strings
-// at some point, look at fix_str for ideas.
 TextFragment& TextFragment::operator=(const TextFragment& b) noexcept
 {
-  if (this != &b)
+  if ((this != &b) && (pText_ != b.pText_))
   {
     _dispose();
-    _allocate(b.size_);
-    if (pText_)
+    if (b.isShared())
     {
-      const char* bText = b.pText_;
-      std::copy(bText, bText + size_, pText_);
-      _nullTerminate();
+      _share(b);
+    }
+    else
+    {
+      _construct(b.getText(), b.lengthInBytes());
     }
   }
   return *this;
@@ -157,8 +159,11 @@ TextFragment::TextFragment(TextFragment&& b) noexcept { _moveDataFromOther(b); }
 
 TextFragment& TextFragment::operator=(TextFragment&& b) noexcept
 {
-  _dispose();
-  _moveDataFromOther(b);
+  if (this != &b)
+  {
+    _dispose();
+    _moveDataFromOther(b);
+  }
   return *this;
 }
 
@@ -263,7 +268,16 @@ void TextFragment::_allocate(size_t size) noexcept
   const size_t nullTerminatedSize = size + 1;
   if (nullTerminatedSize > kShortFragmentSizeInChars)
   {
-    pText_ = static_cast<char*>(malloc(nullTerminatedSize));
+    // a failed alloc leaves a null pText_.
+    void* block = malloc(sizeof(SharedTextHeader) + nullTerminatedSize);
+    pText_ = nullptr;
+    if (block)
+    {
+      auto header = new (block) SharedTextHeader{};
+      header->refs.store(1, std::memory_order_relaxed);
+      pText_ = reinterpret_cast<char*>(header + 1);
+      localText_[0] = kSharedTextTag;
+    }
   }
   else
   {
@@ -271,6 +285,14 @@ void TextFragment::_allocate(size_t size) noexcept
   }
 }
 
+void TextFragment::_share(const TextFragment& b) noexcept
+{
+  b.getSharedHeader()->refs.fetch_add(1, std::memory_order_relaxed);
+  pText_ = b.pText_;
+  size_ = b.size_;
+  localText_[0] = kSharedTextTag;
+}
+
 void TextFragment::_nullTerminate() noexcept { pText_[size_] = 0; }
 
 void TextFragment::_dispose() noexcept
@@ -278,11 +300,16 @@ void TextFragment::_dispose() noexcept
   if (pText_)
   {
     assert(pText_[size_] == 0);
-    if (pText_ != localText_)
+
+    // text owned elsewhere, such as by the SymbolTable, is not freed here.
+    if (isShared())
     {
-      // free an external text. If the alloc has failed the ptr might be 0,
-      // which is OK
-      free(pText_);
+      SharedTextHeader* header = getSharedHeader();
+      if (header->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      {
+        header->~SharedTextHeader();
+        free(header);
+      }
     }
     pText_ = 0;
   }
@@ -291,17 +318,14 @@ void TextFragment::_dispose() noexcept
 void TextFragment::_moveDataFromOther(TextFragment& b)
 {
   size_ = b.size_;
-  if (size_ >= kShortFragmentSizeInChars)
+  if (b.pText_ != b.localText_)
   {
-    // move the data
+    // take the shared or external text.
     pText_ = b.pText_;
+    localText_[0] = b.localText_[0];
   }
   else
   {
-    /*
-     TODO use SmallStackBuffer! and test
-     */
-
     // point to local storage and copy data
     pText_ = localText_;
     std::copy(b.localText_, b.localText_ + size_, localText_);
@@ -314,6 +338,12 @@ void TextFragment::_moveDataFromOther(TextFragment& b)
   b._nullTerminate();
 }
 
+// TextView
+
+size_t TextView::lengthInCodePoints() const { return countCodePoints(text_, size_); }
+
+// utilities
+
 bool validateCodePoint(CodePoint c) { return utf::internal::validate_codepoint(c); }
 
 // return UTF-8 encoded vector of bytes without null terminator
@@ -6,6 +6,8 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstring>
 #include <memory>
 #include <vector>
 
@@ -20,32 +22,84 @@ using CodePoint = char32_t;
 
 // TextFragment: a string class designed to avoid using the heap. Guaranteed not to allocate
 // heap if the length in bytes is below kShortFragmentSize.
+//
+// Longer text is kept in one heap block with an atomic reference count before the text. As
+// the text never changes, copies share the block, so copying a long fragment only counts a
+// reference, and the block is freed with the last copy.
+
+class TextView;
 
 class TextFragment
 {
  public:
+  // Iterator: steps through the code points of UTF-8 text. It is only a
+  // pointer, so making and copying iterators is free. Bytes that can't start
+  // a code point are stepped over one at a time.
   class Iterator
   {
-    class Impl;
-    std::unique_ptr<Impl> pImpl;
+    const char* pos_;
 
    public:
-    Iterator(const char* pos);
+    Iterator(const char* pos) : pos_(pos) {}
+
+    CodePoint operator*() const { return decodeUTF8(pos_); }
 
-    ~Iterator();  // defined in the implementation file, where impl is a
-                  // complete type
+    Iterator& operator++()
+    {
+      pos_ += getUTF8Length(*pos_);
+      return *this;
+    }
 
-    Iterator(const Iterator&);
-    Iterator& operator=(const Iterator&) = delete;
+    CodePoint operator++(int)
+    {
+      CodePoint c = decodeUTF8(pos_);
+      pos_ += getUTF8Length(*pos_);
+      return c;
+    }
 
-    CodePoint operator*();
-    Iterator& operator++();
-    CodePoint operator++(int i);
+    // the first byte of the current code point.
+    const char* getPosition() const { return pos_; }
 
-    friend bool operator!=(Iterator lhs, Iterator rhs);
-    friend bool operator==(Iterator lhs, Iterator rhs);
+    friend bool operator!=(Iterator lhs, Iterator rhs) { return lhs.pos_ != rhs.pos_; }
+    friend bool operator==(Iterator lhs, Iterator rhs) { return lhs.pos_ == rhs.pos_; }
   };
 
+  // length in bytes of the UTF-8 sequence starting with c.
+  static size_t getUTF8Length(char c)
+  {
+    if ((c & 0x80) == 0x00) return 1;
+    if ((c & 0xe0) == 0xc0) return 2;
+    if ((c & 0xf0) == 0xe0) return 3;
+    if ((c & 0xf8) == 0xf0) return 4;
+    return 1;
+  }
+
+  static CodePoint decodeUTF8(const char* p)
+  {
+    size_t len = getUTF8Length(*p);
+    CodePoint r;
+    switch (len)
+    {
+      case 1:
+      default:
+        return static_cast<CodePoint>(*p);
+      case 2:
+        r = *p & 0x1f;
+        break;
+      case 3:
+        r = *p & 0x0f;
+        break;
+      case 4:
+        r = *p & 0x07;
+        break;
+    }
+    for (size_t i = 1; i < len; ++i)
+    {
+      r = (r << 6) | (p[i] & 0x3f);
+    }
+    return r;
+  }
+
   TextFragment() noexcept;
 
   /*
@@ -69,6 +123,9 @@ class TextFragment
   // single code point ctor
   TextFragment(CodePoint c) noexcept;
 
+  // copy the text of a view
+  explicit TextFragment(TextView v) noexcept;
+
   // copy ctor
   TextFragment(const TextFragment& a) noexcept;
 
@@ -141,6 +198,37 @@ class TextFragment
   }
 
  private:
+  friend class SymbolTable;
+
+  // refer to null-terminated text owned elsewhere. SymbolTable makes these in
+  // its arena and never destroys them, so the text is never freed here.
+  struct ExternalText
+  {
+  };
+  TextFragment(ExternalText, const char* pChars, size_t len) noexcept
+      : pText_(const_cast<char*>(pChars)), size_(len)
+  {
+    localText_[0] = 0;
+  }
+
+  // the header of a block of shared text. When pText_ points to shared text, localText_ is
+  // not used for text and its first byte is kSharedTextTag.
+  struct SharedTextHeader
+  {
+    std::atomic<size_t> refs;
+  };
+  static constexpr char kSharedTextTag{1};
+
+  bool isShared() const
+  {
+    return pText_ && (pText_ != localText_) && (localText_[0] == kSharedTextTag);
+  }
+  SharedTextHeader* getSharedHeader() const
+  {
+    return reinterpret_cast<SharedTextHeader*>(pText_) - 1;
+  }
+  void _share(const TextFragment& b) noexcept;
+
   void _allocate(size_t size) noexcept;
   void _construct(const char* s1, size_t len1, const char* s2 = nullptr, size_t len2 = 0,
                   const char* s3 = nullptr, size_t len3 = 0, const char* s4 = nullptr,
@@ -154,7 +242,6 @@ class TextFragment
   void _dispose() noexcept;
   void _moveDataFromOther(TextFragment& b);
 
-  // TODO these things could share space, as in SmallStackBuffer
   char localText_[kShortFragmentSizeInChars];
   char* pText_{localText_};
 
@@ -162,6 +249,39 @@ class TextFragment
   size_t size_{0};
 };
 
+// ----------------------------------------------------------------
+// TextView: a range of UTF-8 text owned by something else, such as part of a
+// TextFragment. Views are cheap to make and copy, and don't need to be null
+// terminated. The text must outlive the view.
+
+class TextView
+{
+  const char* text_{nullptr};
+  size_t size_{0};
+
+ public:
+  TextView() = default;
+  TextView(const char* text, size_t bytes) : text_(text), size_(bytes) {}
+  TextView(const char* text) : text_(text), size_(text ? strlen(text) : 0) {}
+  TextView(const TextFragment& frag) : text_(frag.getText()), size_(frag.lengthInBytes()) {}
+
+  explicit operator bool() const { return size_ > 0; }
+
+  const char* getText() const { return text_; }
+  size_t lengthInBytes() const { return size_; }
+  size_t lengthInCodePoints() const;
+
+  TextFragment::Iterator begin() const { return TextFragment::Iterator(text_); }
+  TextFragment::Iterator end() const { return TextFragment::Iterator(text_ + size_); }
+};
+
+inline bool operator==(TextView a, TextView b)
+{
+  return (a.lengthInBytes() == b.lengthInBytes()) &&
+         ((a.lengthInBytes() == 0) || !memcmp(a.getText(), b.getText(), a.lengthInBytes()));
+}
+inline bool operator!=(TextView a, TextView b) { return !(a == b); }
+
 // ----------------------------------------------------------------
 // Text - a placeholder for more features later like localization
 
@@ -202,6 +322,10 @@ inline std::ostream& operator<<(std::ostream& out, const TextFragment& r)
 
 bool validateCodePoint(CodePoint c);
 
+// the number of bytes at the start of the text that are ASCII, scanning 16
+// bytes at a time.
+size_t countASCIIPrefix(const char* text, size_t bytes);
+
 std::vector<uint8_t> textToByteVector(TextFragment frag);
 TextFragment byteVectorToText(const std::vector<uint8_t>& v);
 
@@ -216,7 +340,7 @@ inline bool operator!=(const char* a, const TextFragment& b) { return !(a == b);
 inline uint64_t hash(const TextFragment& a)
 {
   const char* c = a.getText();
-  return fnv1aSubstring(c, strlen(c));
+  return textHashRuntime(c, strlen(c));
 }
 
 }  // namespace ml
@@ -4,14 +4,29 @@
 
 #include "MLTextUtils.h"
 
-#include <cstring>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <clocale>
 #include <cmath>
+#include <cstring>
+#include <limits>
 
+#include "MLDSPDispatch.h"
 #include "MLDSPScalarMath.h"
 #include "MLMemoryUtils.h"
 #include "aes256.h"
 #include "utf.hpp"
 
+// std::to_chars and std::from_chars for floats, where the library has them.
+#if defined(__cpp_lib_to_chars) && (__cpp_lib_to_chars >= 201611L)
+#define ML_FLOAT_CHARCONV 1
+#else
+#define ML_FLOAT_CHARCONV 0
+#endif
+
 namespace ml
 {
 namespace textUtils
@@ -51,56 +66,178 @@ bool isCJK(CodePoint ch)
          || (ch >= 0x31C0 && ch <= 0x4DFF);  // Other extensions
 }
 
-size_t digitsToNaturalNumber(const char32_t* p, size_t n)
-{
-  constexpr int kMaxDigits = 16;
-  if (n >= kMaxDigits) return -1;
+// numbers in caller buffers
 
-  if (!p) return 0;
-  size_t v = 0;
-  size_t d;
-  char c;
+constexpr char kDigitPairs[]{
+    "0001020304050607080910111213141516171819202122232425262728293031323334353637383940414243444546"
+    "474849505152535455565758596061626364656667686970717273747576777879808182838485868788899091929394"
+    "9596979899"};
 
-  for (int i = 0; i < n; ++i)
+size_t naturalNumberToChars(size_t i, char* dest)
+{
+  // write two digits at a time, backwards from the end of buf.
+  char buf[kMaxNumberChars];
+  char* end = buf + kMaxNumberChars;
+  char* p = end;
+  while (i >= 100)
   {
-    c = p[i];
-    if (c >= '0' && c <= '9')
-      d = (c - '0');
-    else
-      break;
-    v = (v * 10) + d;
+    size_t pair = i % 100;
+    i /= 100;
+    p -= 2;
+    memcpy(p, kDigitPairs + pair * 2, 2);
   }
-  return v;
+  if (i >= 10)
+  {
+    p -= 2;
+    memcpy(p, kDigitPairs + i * 2, 2);
+  }
+  else
+  {
+    *--p = static_cast<char>('0' + i);
+  }
+  memcpy(dest, p, end - p);
+  return end - p;
 }
 
-size_t textToNaturalNumber(const TextFragment& frag)
+size_t charsToNaturalNumber(const char* text, size_t length, size_t& result)
 {
-  std::vector<CodePoint> vec = textToCodePoints(frag);
-  return digitsToNaturalNumber(vec.data(), vec.size());
+  constexpr size_t kMax = std::numeric_limits<size_t>::max();
+  size_t v = 0;
+  size_t n = 0;
+  for (; n < length; ++n)
+  {
+    unsigned d = static_cast<unsigned char>(text[n]) - '0';
+    if (d > 9) break;
+    v = (v > (kMax - d) / 10) ? kMax : v * 10 + d;
+  }
+  if (n) result = v;
+  return n;
 }
 
-TextFragment naturalNumberToText(size_t i)
+size_t floatNumberToChars(float f, char* dest)
 {
-  constexpr size_t kMaxDigits = 16;
+#if ML_FLOAT_CHARCONV
+  return std::to_chars(dest, dest + kMaxNumberChars, f).ptr - dest;
+#else
+  if (std::isnan(f) || std::isinf(f))
+  {
+    const char* t = std::isnan(f) ? "nan" : std::signbit(f) ? "-inf" : "inf";
+    size_t n = strlen(t);
+    memcpy(dest, t, n);
+    return n;
+  }
 
-  char buf[kMaxDigits]{};
-  char* p = buf + kMaxDigits - 1;
-  char* end = p;
+  // try more digits until the text reads back exactly. 9 is always enough.
+  char buf[kMaxNumberChars];
+  int n = 0;
+  for (int digits = 1; digits <= 9; ++digits)
+  {
+    n = snprintf(buf, sizeof(buf), "%.*g", digits, f);
+    for (int i = 0; i < n; ++i)
+    {
+      // snprintf uses the decimal point of the current locale.
+      if (buf[i] == ',') buf[i] = '.';
+    }
+    float g;
+    if (charsToFloatNumber(buf, n, g) && (g == f)) break;
+  }
+  memcpy(dest, buf, n);
+  return n;
+#endif
+}
 
-  // null-terminate the string
-  *end = 0;
+size_t charsToFloatNumber(const char* text, size_t length, float& result)
+{
+#if ML_FLOAT_CHARCONV
+  auto r = std::from_chars(text, text + length, result);
+  if (r.ec == std::errc::invalid_argument) return 0;
+  if (r.ec == std::errc::result_out_of_range)
+  {
+    // read as a double to get the infinity or the zero.
+    double d;
+    std::from_chars(text, text + length, d);
+    result = static_cast<float>(d);
+  }
+  return r.ptr - text;
+#else
+  // find the length of the number.
+  const char* end = text + length;
+  const char* p = text;
+  if ((p < end) && (*p == '-')) p++;
+  auto matchWord = [&](const char* w) {
+    size_t n = strlen(w);
+    if ((size_t)(end - p) < n) return false;
+    for (size_t i = 0; i < n; ++i)
+    {
+      if (tolower(static_cast<unsigned char>(p[i])) != w[i]) return false;
+    }
+    p += n;
+    return true;
+  };
+  auto digits = [&]() {
+    const char* start = p;
+    while ((p < end) && (*p >= '0') && (*p <= '9')) p++;
+    return p - start;
+  };
+  if (matchWord("inf"))
+  {
+    matchWord("inity");
+    result = (*text == '-') ? -std::numeric_limits<float>::infinity()
+                            : std::numeric_limits<float>::infinity();
+    return p - text;
+  }
+  if (matchWord("nan"))
+  {
+    result = std::numeric_limits<float>::quiet_NaN();
+    return p - text;
+  }
+  auto mantissaDigits = digits();
+  if ((p < end) && (*p == '.'))
+  {
+    p++;
+    mantissaDigits += digits();
+  }
+  if (!mantissaDigits) return 0;
+  if ((p < end) && ((*p == 'e') || (*p == 'E')))
+  {
+    const char* expStart = p++;
+    if ((p < end) && ((*p == '+') || (*p == '-'))) p++;
+    if (!digits()) p = expStart;
+  }
 
-  // work backwards
-  do
+  // strtod follows the locale, so give it the locale's decimal point.
+  constexpr size_t kMaxChars{128};
+  size_t n = std::min(static_cast<size_t>(p - text), kMaxChars - 1);
+  char buf[kMaxChars];
+  memcpy(buf, text, n);
+  buf[n] = 0;
+  char point = *localeconv()->decimal_point;
+  for (size_t i = 0; i < n; ++i)
   {
-    p--;
-    if (p < buf) return "overflow";
-    size_t iOver10 = i / 10;
-    char digit = '0' + (i - iOver10 * 10);
-    *p = digit;
-    i = iOver10;
-  } while (i != 0);
-  return (TextFragment(p, end - p));
+    if (buf[i] == '.') buf[i] = point;
+  }
+  result = static_cast<float>(strtod(buf, nullptr));
+  return p - text;
+#endif
+}
+
+size_t textToNaturalNumber(TextView text)
+{
+  // legacy limit: texts of 16 or more code points are not read.
+  constexpr size_t kMaxDigits = 16;
+  if (text.lengthInCodePoints() >= kMaxDigits) return -1;
+  size_t v = 0;
+  charsToNaturalNumber(text.getText(), text.lengthInBytes(), v);
+  return v;
+}
+
+TextFragment naturalNumberToText(size_t i)
+{
+  constexpr size_t kMaxDigits = 15;
+  char buf[kMaxNumberChars];
+  size_t n = naturalNumberToChars(i, buf);
+  if (n > kMaxDigits) return "overflow";
+  return TextFragment(buf, n);
 }
 
 // numeric
@@ -289,38 +426,13 @@ TextFragment floatNumberToText(float f, int precision)
   return TextFragment(buf, writePtr - buf);
 }
 
-float textToFloatNumber(const char* input)
-{
-  float sign{1}, intPart{0}, fracPart{0}, fracPlace{1}, expSign{1}, exp{0};
-  bool hasExp = false;
-  auto it = input;
-  constexpr char digits[]{"0123456789"};
-  std::vector<std::pair<const char*, std::function<void()> > > segments{
-      {"nan", [&]() { intPart = std::numeric_limits<float>::quiet_NaN(); }},
-      {"-", [&]() { sign = -sign; }},
-      {"inf", [&]() { intPart = std::numeric_limits<float>::infinity(); }},
-      {digits, [&]() { intPart = intPart * 10.f + (*it - '0'); }},
-      {".", [&]() {}},
-      {digits, [&]() { fracPart += (*it - '0') * (fracPlace *= 0.1f); }},
-      {"e+", [&]() { hasExp = true; }},
-      {"-", [&]() { expSign = -expSign; }},
-      {digits, [&]() { exp = exp * 10.f + (*it - '0'); }}};
-  for (auto segment : segments)
-  {
-    const char* cBegin = segment.first;
-    const char* cEnd = cBegin + strlen(cBegin);
-    while (std::find(cBegin, cEnd, *it) != cEnd)
-    {
-      segment.second();
-      ++it;
-    }
-  }
-  float base = sign * (intPart + fracPart);
-  return hasExp ? base * powf(10.f, exp * expSign) : base;
+float textToFloatNumber(TextView text)
+{
+  float f{0};
+  charsToFloatNumber(text.getText(), text.lengthInBytes(), f);
+  return f;
 }
 
-float textToFloatNumber(const TextFragment& frag) { return textToFloatNumber(frag.getText()); }
-
 TextFragment addFinalNumber(TextFragment t, int n)
 {
   return TextFragment(t, textUtils::naturalNumberToText(n));
@@ -398,9 +510,20 @@ int findFirst(const TextFragment& frag, const CodePoint b)
 {
   int r = npos;
   if (!frag) return r;
-  int i = 0;
-  for (const CodePoint c : frag)
+
+  // search any ASCII text at the start as bytes.
+  const char* text = frag.getText();
+  size_t prefix = countASCIIPrefix(text, frag.lengthInBytes());
+  if (b < 0x80)
+  {
+    const void* p = memchr(text, static_cast<int>(b), prefix);
+    if (p) return static_cast<const char*>(p) - text;
+  }
+
+  int i = static_cast<int>(prefix);
+  for (auto it = TextFragment::Iterator(text + prefix); it != frag.end(); ++it)
   {
+    const CodePoint c = *it;
     if (!validateCodePoint(c)) return r;
     if (c == b)
     {
@@ -416,16 +539,28 @@ int findLast(const TextFragment& frag, const CodePoint b)
 {
   int r = npos;
   if (!frag) return r;
-  int i = 0;
-  for (const CodePoint c : frag)
+
+  // search the text after any ASCII start first, then the start as bytes.
+  const char* text = frag.getText();
+  size_t prefix = countASCIIPrefix(text, frag.lengthInBytes());
+  int i = static_cast<int>(prefix);
+  for (auto it = TextFragment::Iterator(text + prefix); it != frag.end(); ++it)
   {
-    if (!validateCodePoint(c)) return r;
+    const CodePoint c = *it;
+    if (!validateCodePoint(c)) return npos;
     if (c == b)
     {
       r = i;
     }
     i++;
   }
+  if ((r == npos) && (b < 0x80))
+  {
+    for (size_t j = prefix; j > 0; --j)
+    {
+      if (static_cast<CodePoint>(text[j - 1]) == b) return static_cast<int>(j - 1);
+    }
+  }
   return r;
 }
 
@@ -466,37 +601,38 @@ int findLast(const TextFragment& frag, std::function<bool(CodePoint)> matchFn)
   return r;
 }
 
-TextFragment subText(const TextFragment& frag, size_t start, size_t end)
+TextView subTextView(TextView text, size_t start, size_t end)
 {
-  // this impl does an unneccesary copy, to keep TextFragment very simple for
-  // now.
-  if (!frag) return TextFragment();
-  if (start >= end) return TextFragment();
+  if (start >= end) return TextView();
 
-  // temp buffer big enough to hold whole input fragment if needed.
-  // we won't know the output fragment size in bytes until iterating the code
-  // points.
-  size_t len = frag.lengthInBytes();
-  SmallStackBuffer<char, kShortFragmentSizeInChars> temp(len);
-  char* buf = temp.data();
-  char* pb = buf;
+  // within ASCII text, code points are bytes.
+  const char* p = text.getText();
+  size_t len = text.lengthInBytes();
+  if ((end <= len) && (countASCIIPrefix(p, end) == end))
+  {
+    return TextView(p + start, end - start);
+  }
 
-  auto first = TextFragment::Iterator(frag.getText());
-  auto it = first;
-  for (int i = 0; i < start; ++i)
+  const char* textEnd = p + len;
+  auto it = text.begin();
+  for (size_t i = 0; (i < start) && (it.getPosition() < textEnd); ++i)
   {
     ++it;
   }
-
-  for (int i = 0; i < end - start; ++i)
+  const char* first = std::min(it.getPosition(), textEnd);
+  for (size_t i = start; (i < end) && (it.getPosition() < textEnd); ++i)
   {
-    // write the codepoint as UTF-8 to the buffer
-    if (!validateCodePoint(*it)) return TextFragment();
-    pb = utf::internal::utf_traits<utf::utf8>::encode(*it, pb);
+    if (!validateCodePoint(*it)) return TextView();
     ++it;
   }
+  const char* last = std::min(it.getPosition(), textEnd);
+  return TextView(first, last - first);
+}
 
-  return TextFragment(buf, pb - buf);
+TextFragment subText(const TextFragment& frag, size_t start, size_t end)
+{
+  if (!frag) return TextFragment();
+  return TextFragment(subTextView(frag, start, end));
 }
 
 TextFragment map(const TextFragment& frag, std::function<CodePoint(CodePoint)> f)
@@ -547,58 +683,108 @@ TextFragment replace(const TextFragment& frag, CodePoint toFind, CodePoint toRep
 std::vector<TextFragment> split(TextFragment frag, CodePoint delimiter)
 {
   std::vector<TextFragment> output;
-  int start = 0;
-  int end = 0;
-  int pieceLen = 0;
   for (const CodePoint c : frag)
   {
-    if (!validateCodePoint(c)) return std::vector<TextFragment>();
-    pieceLen++;
-    end++;
-    if (c == delimiter)
-    {
-      if (pieceLen > 1)
-      {
-        output.push_back(subText(frag, start, end - 1));
-      }
-      start = end;
-      pieceLen = 0;
-    }
+    if (!validateCodePoint(c)) return output;
   }
-  if (pieceLen > 0)
+  TextSplitter pieces(frag, delimiter);
+  output.reserve(pieces.countPieces());
+  for (TextView piece : pieces)
   {
-    output.push_back(subText(frag, start, end));
+    output.emplace_back(piece);
   }
   return output;
 }
 
+TextSplitter::TextSplitter(TextView text, CodePoint delimiter) : text_(text)
+{
+  char* end = utf::internal::utf_traits<utf::utf8>::encode(delimiter, delimiter_);
+  delimiterBytes_ = end - delimiter_;
+}
+
+TextView TextSplitter::nextPiece(const char* pos) const
+{
+  const char* end = textEnd();
+
+  // skip delimiters, leaving no empty pieces.
+  while ((pos + delimiterBytes_ <= end) && !memcmp(pos, delimiter_, delimiterBytes_))
+  {
+    pos += delimiterBytes_;
+  }
+  if (pos >= end) return TextView(end, 0);
+
+  // UTF-8 can't contain the encoding of one code point inside another, so
+  // the delimiter can be found bytewise.
+  const char* p = pos;
+  while (p < end)
+  {
+    p = static_cast<const char*>(memchr(p, delimiter_[0], end - p));
+    if (!p) return TextView(pos, end - pos);
+    if ((p + delimiterBytes_ <= end) && !memcmp(p, delimiter_, delimiterBytes_)) break;
+    p++;
+  }
+  return TextView(pos, p - pos);
+}
+
+size_t TextSplitter::countPieces() const
+{
+  size_t n = 0;
+  for (auto it = begin(); it != end(); ++it)
+  {
+    n++;
+  }
+  return n;
+}
+
+TextView TextSplitter::getPiece(size_t index) const
+{
+  for (TextView piece : *this)
+  {
+    if (index-- == 0) return piece;
+  }
+  return TextView();
+}
+
 TextFragment join(const std::vector<TextFragment>& vec)
 {
-  TextFragment sum;
-  size_t len = vec.size();
-  for (int i = 0; i < len; ++i)
+  size_t bytes = 0;
+  for (const auto& frag : vec)
+  {
+    bytes += frag.lengthInBytes();
+  }
+  SmallStackBuffer<char, kShortFragmentSizeInChars> temp(bytes);
+  char* p = temp.data();
+  for (const auto& frag : vec)
   {
-    TextFragment frag = vec[i];
-    sum = TextFragment(sum, vec[i]);
+    std::copy(frag.getText(), frag.getText() + frag.lengthInBytes(), p);
+    p += frag.lengthInBytes();
   }
-  return sum;
+  return TextFragment(temp.data(), bytes);
 }
 
 TextFragment join(const std::vector<TextFragment>& vec, CodePoint delimiter)
 {
+  if (vec.empty()) return TextFragment();
   TextFragment delimFrag(delimiter);
-  TextFragment sum;
-  size_t len = vec.size();
-  for (int i = 0; i < len; ++i)
+  size_t delimBytes = delimFrag.lengthInBytes();
+  size_t bytes = delimBytes * (vec.size() - 1);
+  for (const auto& frag : vec)
+  {
+    bytes += frag.lengthInBytes();
+  }
+  SmallStackBuffer<char, kShortFragmentSizeInChars> temp(bytes);
+  char* p = temp.data();
+  for (size_t i = 0; i < vec.size(); ++i)
   {
-    TextFragment frag = vec[i];
-    sum = TextFragment(sum, vec[i]);
-    if ((i >= 0) && (i < len - 1))
+    if (i > 0)
     {
-      sum = TextFragment(sum, delimFrag);
+      std::copy(delimFrag.getText(), delimFrag.getText() + delimBytes, p);
+      p += delimBytes;
     }
+    std::copy(vec[i].getText(), vec[i].getText() + vec[i].lengthInBytes(), p);
+    p += vec[i].lengthInBytes();
   }
-  return sum;
+  return TextFragment(temp.data(), bytes);
 }
 
 TextFragment stripExtension(const TextFragment& frag)
@@ -645,8 +831,11 @@ TextFragment getPath(const TextFragment& frag)
 // TODO extend to recognize Cyrillic and other scripts
 Symbol bestScriptForTextFragment(const TextFragment& frag)
 {
-  for (const CodePoint c : frag)
+  // ASCII is latin, so only the code points after it need decoding.
+  const size_t ascii = countASCIIPrefix(frag.getText(), frag.lengthInBytes());
+  for (auto it = TextFragment::Iterator(frag.getText() + ascii); it != frag.end(); ++it)
   {
+    const CodePoint c = *it;
     if (!validateCodePoint(c)) return "unknown";
     // if there are any CJK characters, return CJK
     if (isCJK(c))
@@ -664,57 +853,404 @@ Symbol bestScriptForTextFragment(const TextFragment& frag)
 static constexpr char base64table[]{
     "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/="};
 
-TextFragment base64Encode(const std::vector<uint8_t>& in)
+// reverse lookup, with -1 for chars outside the alphabet.
+struct Base64DecodeTable
+{
+  int8_t values[256]{};
+  constexpr Base64DecodeTable()
+  {
+    for (int i = 0; i < 256; i++) values[i] = -1;
+    for (int i = 0; i < 64; i++) values[static_cast<uint8_t>(base64table[i])] = i;
+  }
+};
+static constexpr Base64DecodeTable base64DecodeTable{};
+
+// SIMD base64 after Wojciech Muła and Daniel Lemire, "Faster Base64 Encoding and Decoding
+// Using AVX2 Instructions", 2018, using the 16-byte SSSE3 versions. On ARM the same code
+// is translated to NEON by sse2neon. UTF-8 validation below uses the same dispatch.
+
+#if ML_DISPATCH_X86
+#ifdef _MSC_VER
+#define ML_TARGET_SSSE3
+#else
+#define ML_TARGET_SSSE3 __attribute__((target("ssse3")))
+#endif
+#define ML_TEXT_SIMD 1
+
+static bool detectSSSE3()
+{
+  uint32_t r[4];
+  dispatch::cpuid(1, 0, r);
+  return r[2] & (1u << 9);
+}
+
+#elif defined(ML_SSE_TO_NEON)
+#define ML_TARGET_SSSE3
+#define ML_TEXT_SIMD 1
+
+static bool detectSSSE3() { return true; }
+#endif
+
+#if ML_TEXT_SIMD
+
+// encode 12 bytes from a 16-byte load into 16 chars.
+ML_TARGET_SSSE3 static inline __m128i base64EncodeBlock(__m128i in)
 {
-  std::vector<char> out;
+  // split three bytes into four 6-bit indices in each 32-bit word.
+  in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+  __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+  __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+  __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+  __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+  __m128i indices = _mm_or_si128(t1, t3);
+
+  // add the offset of each index's range in the alphabet.
+  __m128i range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+  __m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+  range = _mm_or_si128(range, _mm_and_si128(upper, _mm_set1_epi8(13)));
+  const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                        '+' - 62, '/' - 63, 'A', 0, 0);
+  return _mm_add_epi8(_mm_shuffle_epi8(offsets, range), indices);
+}
 
-  int val = 0, valb = -6;
-  for (uint8_t c : in)
+// decode 16 chars into 12 bytes at the start of out. Returns false if any char is not in
+// the alphabet.
+ML_TARGET_SSSE3 static inline bool base64DecodeBlock(__m128i in, __m128i& out)
+{
+  __m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(in, 4), _mm_set1_epi8(0x0f));
+  __m128i loNibbles = _mm_and_si128(in, _mm_set1_epi8(0x0f));
+  const __m128i loBits = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                       0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+  const __m128i hiBits = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10,
+                                       0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+  __m128i lo = _mm_shuffle_epi8(loBits, loNibbles);
+  __m128i hi = _mm_shuffle_epi8(hiBits, hiNibbles);
+  if (_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128()))) return false;
+
+  // chars to 6-bit values
+  const __m128i rolls = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  __m128i isSlash = _mm_cmpeq_epi8(in, _mm_set1_epi8('/'));
+  __m128i values = _mm_add_epi8(in, _mm_shuffle_epi8(rolls, _mm_add_epi8(isSlash, hiNibbles)));
+
+  // pack four 6-bit values into three bytes in each 32-bit word.
+  __m128i pairs = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+  __m128i words = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+  out = _mm_shuffle_epi8(words, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1,
+                                              -1));
+  return true;
+}
+
+// Returns the number of input bytes done, a multiple of 12.
+ML_TARGET_SSSE3 static size_t base64EncodeSIMD(const uint8_t* data, size_t size, char* dest)
+{
+  size_t i = 0;
+  for (; i + 16 <= size; i += 12)
   {
-    val = (val << 8) + c;
-    valb += 8;
-    while (valb >= 0)
-    {
-      out.push_back(base64table[(val >> valb) & 0x3F]);
-      valb -= 6;
-    }
+    __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), base64EncodeBlock(in));
+    dest += 16;
   }
-  if (valb > -6) out.push_back(base64table[((val << 8) >> (valb + 8)) & 0x3F]);
-  while (out.size() % 4) out.push_back('=');
-  out.push_back(0);
-  return TextFragment(out.data());
+  return i;
 }
 
-std::vector<uint8_t> base64Decode(const TextFragment& in)
+// Returns the number of chars done, a multiple of 16. Stops before a block with a char outside
+// the alphabet, leaving it for the scalar decoder.
+ML_TARGET_SSSE3 static size_t base64DecodeSIMD(const char* text, size_t length, uint8_t* dest)
+{
+  // each block stores 16 bytes, so stop while there is room for those past the 12 decoded.
+  size_t i = 0;
+  for (; i + 24 <= length; i += 16)
+  {
+    __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+    __m128i out;
+    if (!base64DecodeBlock(in, out)) break;
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), out);
+    dest += 12;
+  }
+  return i;
+}
+
+static bool useTextSIMD()
+{
+  static const bool b = detectSSSE3();
+  return b;
+}
+
+#endif  // ML_TEXT_SIMD
+
+size_t getBase64EncodedSize(size_t bytes) { return (bytes + 2) / 3 * 4; }
+
+size_t getBase64MaxDecodedSize(size_t chars) { return chars / 4 * 3 + (chars % 4) * 3 / 4; }
+
+size_t base64Encode(const uint8_t* data, size_t size, char* dest)
+{
+  size_t i = 0;
+  char* out = dest;
+#if ML_TEXT_SIMD
+  if (useTextSIMD())
+  {
+    i = base64EncodeSIMD(data, size, out);
+    out += i / 3 * 4;
+  }
+#endif
+
+  for (; i + 3 <= size; i += 3)
+  {
+    uint32_t val = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
+    *out++ = base64table[(val >> 18) & 0x3F];
+    *out++ = base64table[(val >> 12) & 0x3F];
+    *out++ = base64table[(val >> 6) & 0x3F];
+    *out++ = base64table[val & 0x3F];
+  }
+
+  // the last one or two bytes, padded with '='
+  size_t remaining = size - i;
+  if (remaining)
+  {
+    uint32_t val = (data[i] << 16) | ((remaining > 1) ? (data[i + 1] << 8) : 0);
+    *out++ = base64table[(val >> 18) & 0x3F];
+    *out++ = base64table[(val >> 12) & 0x3F];
+    *out++ = (remaining > 1) ? base64table[(val >> 6) & 0x3F] : '=';
+    *out++ = '=';
+  }
+  return out - dest;
+}
+
+size_t base64Decode(const char* text, size_t length, uint8_t* dest)
 {
-  // in every call we build a reverse lookup table.
-  // TODO this could probably be made once in a constexpr
-  std::vector<int> T(256, -1);
-  for (int i = 0; i < 64; i++) T[base64table[i]] = i;
+  size_t i = 0;
+  uint8_t* out = dest;
+#if ML_TEXT_SIMD
+  if (useTextSIMD())
+  {
+    i = base64DecodeSIMD(text, length, out);
+    out += i / 4 * 3;
+  }
+#endif
 
-  std::vector<uint8_t> out;
   int val = 0, valb = -8;
-  for (uint8_t c : in)
+  for (; i < length; ++i)
   {
-    if (T[c] == -1) break;
-    val = (val << 6) + T[c];
+    int c = base64DecodeTable.values[static_cast<uint8_t>(text[i])];
+    if (c == -1) break;
+    val = ((val << 6) + c) & 0xFFFFFF;
     valb += 6;
     if (valb >= 0)
     {
-      out.push_back(char((val >> valb) & 0xFF));
+      *out++ = static_cast<uint8_t>((val >> valb) & 0xFF);
       valb -= 8;
     }
   }
+  return out - dest;
+}
+
+// UTF-8 validation
+
+// SIMD UTF-8 validation after John Keiser and Daniel Lemire, "Validating UTF-8 In Less Than
+// One Instruction Per Byte", 2021. Each byte is checked with the two before it by looking up
+// the nibbles of the byte and the one before in three tables, each of which marks the errors
+// its nibble allows. A bit left on in all three is an error. Sequences too long or too short
+// for their lead bytes are found by comparing the bytes two and three back with the leads of
+// three and four byte sequences.
+
+#if ML_TEXT_SIMD
+
+namespace utf8Lookup
+{
+constexpr int8_t kTooShort{1 << 0};     // 11______ 0_______
+constexpr int8_t kTooLong{1 << 1};      // 0_______ 10______
+constexpr int8_t kOverlong3{1 << 2};    // 11100000 100_____
+constexpr int8_t kTooLarge{1 << 3};     // 11110100 1001____
+constexpr int8_t kSurrogate{1 << 4};    // 11101101 101_____
+constexpr int8_t kOverlong2{1 << 5};    // 1100000_ 10______
+constexpr int8_t kTooLarge1000{1 << 6}; // 11110101+ 1000____
+constexpr int8_t kOverlong4{1 << 6};    // 11110000 1000____
+constexpr int8_t kTwoConts{-128};       // 10______ 10______
+constexpr int8_t kCarry{kTooShort | kTooLong | kTwoConts};
+}  // namespace utf8Lookup
+
+ML_TARGET_SSSE3 static inline __m128i highNibbles(__m128i v)
+{
+  return _mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(0x0f));
+}
+
+// the errors in a block of 16 bytes, given the block before.
+ML_TARGET_SSSE3 static inline __m128i utf8BlockErrors(__m128i in, __m128i prev)
+{
+  using namespace utf8Lookup;
+  const __m128i prev1 = _mm_alignr_epi8(in, prev, 15);
+  const __m128i byte1High = _mm_shuffle_epi8(
+      _mm_setr_epi8(kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong,
+                    kTooLong, kTwoConts, kTwoConts, kTwoConts, kTwoConts,
+                    kTooShort | kOverlong2, kTooShort, kTooShort | kOverlong3 | kSurrogate,
+                    kTooShort | kTooLarge | kTooLarge1000 | kOverlong4),
+      highNibbles(prev1));
+  constexpr int8_t kLarge = kCarry | kTooLarge | kTooLarge1000;
+  const __m128i byte1Low = _mm_shuffle_epi8(
+      _mm_setr_epi8(kCarry | kOverlong3 | kOverlong2 | kOverlong4, kCarry | kOverlong2, kCarry,
+                    kCarry, kCarry | kTooLarge, kLarge, kLarge, kLarge, kLarge, kLarge, kLarge,
+                    kLarge, kLarge, kLarge | kSurrogate, kLarge, kLarge),
+      _mm_and_si128(prev1, _mm_set1_epi8(0x0f)));
+  constexpr int8_t kCont1000 = kTooLong | kOverlong2 | kTwoConts | kOverlong3 | kTooLarge1000 |
+                               kOverlong4;
+  constexpr int8_t kCont1001 = kTooLong | kOverlong2 | kTwoConts | kOverlong3 | kTooLarge;
+  constexpr int8_t kCont101 = kTooLong | kOverlong2 | kTwoConts | kSurrogate | kTooLarge;
+  const __m128i byte2High = _mm_shuffle_epi8(
+      _mm_setr_epi8(kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort,
+                    kTooShort, kCont1000, kCont1001, kCont101, kCont101, kTooShort, kTooShort,
+                    kTooShort, kTooShort),
+      highNibbles(in));
+  const __m128i special = _mm_and_si128(_mm_and_si128(byte1High, byte1Low), byte2High);
+
+  // bytes that must be the second or third continuation of a three or four byte sequence.
+  const __m128i prev2 = _mm_alignr_epi8(in, prev, 14);
+  const __m128i prev3 = _mm_alignr_epi8(in, prev, 13);
+  const __m128i third = _mm_subs_epu8(prev2, _mm_set1_epi8(char(0xe0 - 0x80)));
+  const __m128i fourth = _mm_subs_epu8(prev3, _mm_set1_epi8(char(0xf0 - 0x80)));
+  const __m128i must23 = _mm_and_si128(_mm_or_si128(third, fourth), _mm_set1_epi8(char(0x80)));
+  return _mm_xor_si128(must23, special);
+}
+
+// nonzero if the block ends inside a sequence.
+ML_TARGET_SSSE3 static inline __m128i utf8Incomplete(__m128i in)
+{
+  const __m128i maxValues = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                          char(0xf0 - 1), char(0xe0 - 1), char(0xc0 - 1));
+  return _mm_subs_epu8(in, maxValues);
+}
+
+// check a block of 16 bytes, accumulating errors.
+ML_TARGET_SSSE3 static inline void utf8CheckBlock(__m128i in, __m128i& errors, __m128i& prev,
+                                                  __m128i& prevIncomplete)
+{
+  if (!_mm_movemask_epi8(in))
+  {
+    // an ASCII block is only an error after an incomplete sequence.
+    errors = _mm_or_si128(errors, prevIncomplete);
+  }
+  else
+  {
+    errors = _mm_or_si128(errors, utf8BlockErrors(in, prev));
+    prevIncomplete = utf8Incomplete(in);
+  }
+  prev = in;
+}
+
+ML_TARGET_SSSE3 static bool validateUTF8SIMD(const char* text, size_t length)
+{
+  __m128i errors = _mm_setzero_si128();
+  __m128i prev = _mm_setzero_si128();
+  __m128i prevIncomplete = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 16 <= length; i += 16)
+  {
+    const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+    utf8CheckBlock(in, errors, prev, prevIncomplete);
+  }
+
+  // the last bytes, padded with zeros, which are errors after an incomplete sequence.
+  if (i < length)
+  {
+    alignas(16) char last[16]{};
+    std::copy(text + i, text + length, last);
+    const __m128i in = _mm_load_si128(reinterpret_cast<const __m128i*>(last));
+    utf8CheckBlock(in, errors, prev, prevIncomplete);
+  }
+  errors = _mm_or_si128(errors, prevIncomplete);
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(errors, _mm_setzero_si128())) == 0xffff;
+}
+
+#endif  // ML_TEXT_SIMD
+
+bool validateUTF8(const char* text, size_t length)
+{
+  size_t i = countASCIIPrefix(text, length);
+  if (i == length) return true;
+#if ML_TEXT_SIMD
+  if (useTextSIMD()) return validateUTF8SIMD(text + i, length - i);
+#endif
+
+  // the well-formed byte sequences of the Unicode standard, table 3-7.
+  const auto* p = reinterpret_cast<const uint8_t*>(text);
+  while (i < length)
+  {
+    const uint8_t c = p[i];
+    if (c < 0x80)
+    {
+      i += countASCIIPrefix(text + i, length - i);
+      continue;
+    }
+    size_t len;
+    uint8_t lo{0x80}, hi{0xbf};
+    if ((c >= 0xc2) && (c <= 0xdf))
+    {
+      len = 2;
+    }
+    else if ((c >= 0xe0) && (c <= 0xef))
+    {
+      len = 3;
+      if (c == 0xe0) lo = 0xa0;
+      if (c == 0xed) hi = 0x9f;
+    }
+    else if ((c >= 0xf0) && (c <= 0xf4))
+    {
+      len = 4;
+      if (c == 0xf0) lo = 0x90;
+      if (c == 0xf4) hi = 0x8f;
+    }
+    else
+    {
+      return false;
+    }
+    if (i + len > length) return false;
+    if ((p[i + 1] < lo) || (p[i + 1] > hi)) return false;
+    for (size_t k = 2; k < len; ++k)
+    {
+      if ((p[i + k] & 0xc0) != 0x80) return false;
+    }
+    i += len;
+  }
+  return true;
+}
+
+TextFragment base64Encode(const std::vector<uint8_t>& in)
+{
+  std::vector<char> out(getBase64EncodedSize(in.size()));
+  if (out.empty()) return TextFragment();
+  size_t n = base64Encode(in.data(), in.size(), out.data());
+  return TextFragment(out.data(), n);
+}
+
+std::vector<uint8_t> base64Decode(const TextFragment& in)
+{
+  std::vector<uint8_t> out(getBase64MaxDecodedSize(in.lengthInBytes()));
+  out.resize(base64Decode(in.getText(), in.lengthInBytes(), out.data()));
   return out;
 }
 
+TextView stripWhitespaceAtEndsView(TextView text)
+{
+  const char* first = nullptr;
+  const char* last = nullptr;
+  const char* end = text.getText() + text.lengthInBytes();
+  for (auto it = text.begin(); it.getPosition() < end; ++it)
+  {
+    CodePoint c = *it;
+    if (!validateCodePoint(c)) return TextView();
+    if (!isWhitespace(c))
+    {
+      if (!first) first = it.getPosition();
+      last = it.getPosition() + TextFragment::getUTF8Length(*it.getPosition());
+    }
+  }
+  if (!first) return TextView();
+  return TextView(first, std::min(last, end) - first);
+}
+
 TextFragment stripWhitespaceAtEnds(const TextFragment& frag)
 {
-  std::function<bool(CodePoint)> f([](CodePoint c) { return !isWhitespace(c); });
-  int first = findFirst(frag, f);
-  int last = findLast(frag, f);
-  if ((first == npos) || (last == npos)) return TextFragment();
-  return (subText(frag, first, last + 1));
+  return TextFragment(stripWhitespaceAtEndsView(frag));
 }
 
 TextFragment stripAllWhitespace(const TextFragment& frag)
@@ -723,58 +1259,319 @@ TextFragment stripAllWhitespace(const TextFragment& frag)
   return reduce(frag, f);
 }
 
-std::vector<uint8_t> AES256CBCEncode(const std::vector<uint8_t>& input,
-                                     const std::vector<uint8_t>& key,
-                                     const std::vector<uint8_t>& iv)
+// AES-256
+
+constexpr size_t kAESBlockSize{16};
+constexpr size_t kAESRounds{14};
+constexpr size_t kAESRoundKeyBytes{(kAESRounds + 1) * kAESBlockSize};
+
+#if ML_DISPATCH_X86
+#ifdef _MSC_VER
+#define ML_TARGET_AES
+#else
+#define ML_TARGET_AES __attribute__((target("aes,sse2")))
+#endif
+#define ML_AES_HARDWARE 1
+
+static bool detectAESHardware()
 {
-  if (!(input.size() > 0) || !(key.size() == 32) || !(iv.size() == 32))
-    return std::vector<uint8_t>();
+  uint32_t r[4];
+  dispatch::cpuid(1, 0, r);
+  return r[2] & (1u << 25);
+}
 
-  aes256_context ctx;
-  aes256_init(&ctx, key.data());
+#elif defined(ML_SSE_TO_NEON) && (defined(__ARM_FEATURE_AES) || defined(__ARM_FEATURE_CRYPTO))
+#define ML_AES_HARDWARE 1
 
-  const int blockSize = 16;
-  size_t inputSize = input.size();
-  size_t blocks = inputSize / blockSize + 1;
-  size_t paddedSize = blockSize * (blocks);
+static bool detectAESHardware() { return true; }
+#endif
 
-  // add PKCS padding
-  std::vector<uint8_t> plaintext = input;
-  plaintext.resize(paddedSize);
-  size_t padBytes = paddedSize - inputSize;
-  for (size_t i = inputSize; i < paddedSize; ++i)
+#if ML_AES_HARDWARE
+
+static std::atomic<bool> useAESHardware{detectAESHardware()};
+
+// the FIPS-197 key expansion, for the hardware paths.
+static void expandAES256Key(const uint8_t* key, uint8_t* roundKeys)
+{
+  static const auto sbox = []() {
+    std::array<uint8_t, 256> s{};
+    uint8_t p = 1, q = 1;
+    auto rotl = [](uint8_t x, int n) { return static_cast<uint8_t>((x << n) | (x >> (8 - n))); };
+    do
+    {
+      // p runs through the multiplicative group and q through its inverses.
+      p = p ^ static_cast<uint8_t>(p << 1) ^ ((p & 0x80) ? 0x1B : 0);
+      q ^= q << 1;
+      q ^= q << 2;
+      q ^= q << 4;
+      if (q & 0x80) q ^= 0x09;
+      s[p] = q ^ rotl(q, 1) ^ rotl(q, 2) ^ rotl(q, 3) ^ rotl(q, 4) ^ 0x63;
+    } while (p != 1);
+    s[0] = 0x63;
+    return s;
+  }();
+
+  memcpy(roundKeys, key, 32);
+  uint8_t rcon = 1;
+  for (size_t i = 8; i < (kAESRounds + 1) * 4; ++i)
+  {
+    uint8_t t[4];
+    memcpy(t, roundKeys + (i - 1) * 4, 4);
+    if (i % 8 == 0)
+    {
+      uint8_t t0 = t[0];
+      t[0] = sbox[t[1]] ^ rcon;
+      t[1] = sbox[t[2]];
+      t[2] = sbox[t[3]];
+      t[3] = sbox[t0];
+      rcon <<= 1;
+    }
+    else if (i % 8 == 4)
+    {
+      for (auto& b : t) b = sbox[b];
+    }
+    for (size_t j = 0; j < 4; ++j) roundKeys[i * 4 + j] = roundKeys[(i - 8) * 4 + j] ^ t[j];
+  }
+}
+
+#if ML_DISPATCH_X86
+
+// decryption keys for the equivalent inverse cipher.
+ML_TARGET_AES static void makeAESDecryptionKeys(const uint8_t* enc, uint8_t* dec)
+{
+  memcpy(dec, enc + kAESRounds * kAESBlockSize, kAESBlockSize);
+  for (size_t r = 1; r < kAESRounds; ++r)
+  {
+    __m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i*>(enc + (kAESRounds - r) * 16));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dec + r * 16), _mm_aesimc_si128(k));
+  }
+  memcpy(dec + kAESRounds * kAESBlockSize, enc, kAESBlockSize);
+}
+
+ML_TARGET_AES static void cbcEncryptHardware(const uint8_t* roundKeys, uint8_t* iv,
+                                             const uint8_t* in, uint8_t* out, size_t blocks)
+{
+  __m128i k[kAESRounds + 1];
+  for (size_t r = 0; r <= kAESRounds; ++r)
+  {
+    k[r] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(roundKeys + r * 16));
+  }
+  __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(iv));
+  for (size_t b = 0; b < blocks; ++b)
+  {
+    x = _mm_xor_si128(x, _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + b * 16)));
+    x = _mm_xor_si128(x, k[0]);
+    for (size_t r = 1; r < kAESRounds; ++r) x = _mm_aesenc_si128(x, k[r]);
+    x = _mm_aesenclast_si128(x, k[kAESRounds]);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + b * 16), x);
+  }
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(iv), x);
+}
+
+// CBC decryption has no chain between blocks, so four are done at once.
+ML_TARGET_AES static void cbcDecryptHardware(const uint8_t* roundKeys, uint8_t* iv,
+                                             const uint8_t* in, uint8_t* out, size_t blocks)
+{
+  __m128i k[kAESRounds + 1];
+  for (size_t r = 0; r <= kAESRounds; ++r)
+  {
+    k[r] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(roundKeys + r * 16));
+  }
+  __m128i prev = _mm_loadu_si128(reinterpret_cast<const __m128i*>(iv));
+  size_t b = 0;
+  for (; b + 4 <= blocks; b += 4)
+  {
+    __m128i c[4], x[4];
+    for (int i = 0; i < 4; ++i)
+    {
+      c[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + (b + i) * 16));
+      x[i] = _mm_xor_si128(c[i], k[0]);
+    }
+    for (size_t r = 1; r < kAESRounds; ++r)
+    {
+      for (int i = 0; i < 4; ++i) x[i] = _mm_aesdec_si128(x[i], k[r]);
+    }
+    for (int i = 0; i < 4; ++i)
+    {
+      x[i] = _mm_xor_si128(_mm_aesdeclast_si128(x[i], k[kAESRounds]), (i == 0) ? prev : c[i - 1]);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + (b + i) * 16), x[i]);
+    }
+    prev = c[3];
+  }
+  for (; b < blocks; ++b)
   {
-    plaintext[i] = padBytes;
+    __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + b * 16));
+    __m128i x = _mm_xor_si128(c, k[0]);
+    for (size_t r = 1; r < kAESRounds; ++r) x = _mm_aesdec_si128(x, k[r]);
+    x = _mm_xor_si128(_mm_aesdeclast_si128(x, k[kAESRounds]), prev);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + b * 16), x);
+    prev = c;
   }
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(iv), prev);
+}
+
+#else
 
-  std::vector<uint8_t> ciphertext(paddedSize);
-  uint8_t currentIV[blockSize];
-  uint8_t workVector[blockSize];
+// ARMv8 crypto extensions. AESE and AESD add the round key first, so the last
+// key is added separately.
 
-  for (size_t i = 0; i < blockSize; ++i)
+static void makeAESDecryptionKeys(const uint8_t* enc, uint8_t* dec)
+{
+  memcpy(dec, enc + kAESRounds * kAESBlockSize, kAESBlockSize);
+  for (size_t r = 1; r < kAESRounds; ++r)
+  {
+    vst1q_u8(dec + r * 16, vaesimcq_u8(vld1q_u8(enc + (kAESRounds - r) * 16)));
+  }
+  memcpy(dec + kAESRounds * kAESBlockSize, enc, kAESBlockSize);
+}
+
+static void cbcEncryptHardware(const uint8_t* roundKeys, uint8_t* iv, const uint8_t* in,
+                               uint8_t* out, size_t blocks)
+{
+  uint8x16_t k[kAESRounds + 1];
+  for (size_t r = 0; r <= kAESRounds; ++r) k[r] = vld1q_u8(roundKeys + r * 16);
+  uint8x16_t x = vld1q_u8(iv);
+  for (size_t b = 0; b < blocks; ++b)
   {
-    currentIV[i] = iv[i];
+    x = veorq_u8(x, vld1q_u8(in + b * 16));
+    for (size_t r = 0; r < kAESRounds - 1; ++r) x = vaesmcq_u8(vaeseq_u8(x, k[r]));
+    x = veorq_u8(vaeseq_u8(x, k[kAESRounds - 1]), k[kAESRounds]);
+    vst1q_u8(out + b * 16, x);
   }
+  vst1q_u8(iv, x);
+}
 
+static void cbcDecryptHardware(const uint8_t* roundKeys, uint8_t* iv, const uint8_t* in,
+                               uint8_t* out, size_t blocks)
+{
+  uint8x16_t k[kAESRounds + 1];
+  for (size_t r = 0; r <= kAESRounds; ++r) k[r] = vld1q_u8(roundKeys + r * 16);
+  uint8x16_t prev = vld1q_u8(iv);
   for (size_t b = 0; b < blocks; ++b)
   {
-    // get plaintext XOR IV
-    for (size_t i = 0; i < blockSize; ++i)
+    uint8x16_t c = vld1q_u8(in + b * 16);
+    uint8x16_t x = c;
+    for (size_t r = 0; r < kAESRounds - 1; ++r) x = vaesimcq_u8(vaesdq_u8(x, k[r]));
+    x = veorq_u8(vaesdq_u8(x, k[kAESRounds - 1]), k[kAESRounds]);
+    vst1q_u8(out + b * 16, veorq_u8(x, prev));
+    prev = c;
+  }
+  vst1q_u8(iv, prev);
+}
+
+#endif
+#endif  // ML_AES_HARDWARE
+
+bool isAESHardwareAvailable()
+{
+#if ML_AES_HARDWARE
+  return detectAESHardware();
+#else
+  return false;
+#endif
+}
+
+void setUseAESHardware(bool b)
+{
+#if ML_AES_HARDWARE
+  useAESHardware = b && detectAESHardware();
+#endif
+}
+
+namespace
+{
+// a key ready for either implementation, chosen when it is made.
+struct AES256Key
+{
+  bool hardware{false};
+  aes256_context software;
+  uint8_t encryptionKeys[kAESRoundKeyBytes];
+  uint8_t decryptionKeys[kAESRoundKeyBytes];
+
+  explicit AES256Key(const uint8_t* key)
+  {
+#if ML_AES_HARDWARE
+    hardware = useAESHardware;
+    if (hardware)
     {
-      workVector[i] = plaintext[b * blockSize + i] ^ currentIV[i];
+      expandAES256Key(key, encryptionKeys);
+      makeAESDecryptionKeys(encryptionKeys, decryptionKeys);
+      return;
     }
+#endif
+    aes256_init(&software, key);
+  }
+
+  ~AES256Key()
+  {
+    if (!hardware) aes256_done(&software);
+  }
 
-    aes256_encrypt_ecb(&ctx, workVector);
+  AES256Key(const AES256Key&) = delete;
+  AES256Key& operator=(const AES256Key&) = delete;
 
-    // write to ciphertext, get new IV
-    for (size_t i = 0; i < blockSize; ++i)
+  // encrypt whole blocks, updating iv to the last ciphertext block. in and out may be the same.
+  void cbcEncrypt(uint8_t* iv, const uint8_t* in, uint8_t* out, size_t blocks)
+  {
+#if ML_AES_HARDWARE
+    if (hardware) return cbcEncryptHardware(encryptionKeys, iv, in, out, blocks);
+#endif
+    for (size_t b = 0; b < blocks; ++b)
     {
-      ciphertext[b * blockSize + i] = workVector[i];
-      currentIV[i] = workVector[i];
+      uint8_t* block = out + b * kAESBlockSize;
+      for (size_t i = 0; i < kAESBlockSize; ++i) block[i] = in[b * kAESBlockSize + i] ^ iv[i];
+      aes256_encrypt_ecb(&software, block);
+      memcpy(iv, block, kAESBlockSize);
     }
   }
 
-  aes256_done(&ctx);
+  void cbcDecrypt(uint8_t* iv, const uint8_t* in, uint8_t* out, size_t blocks)
+  {
+#if ML_AES_HARDWARE
+    if (hardware) return cbcDecryptHardware(decryptionKeys, iv, in, out, blocks);
+#endif
+    uint8_t work[kAESBlockSize];
+    for (size_t b = 0; b < blocks; ++b)
+    {
+      memcpy(work, in + b * kAESBlockSize, kAESBlockSize);
+      uint8_t* block = out + b * kAESBlockSize;
+      memcpy(block, work, kAESBlockSize);
+      aes256_decrypt_ecb(&software, block);
+      for (size_t i = 0; i < kAESBlockSize; ++i) block[i] ^= iv[i];
+      memcpy(iv, work, kAESBlockSize);
+    }
+  }
+};
+
+// the size after removing PKCS padding from decrypted data. The padding is not checked
+// beyond its length.
+size_t removePKCSPadding(const uint8_t* data, size_t size)
+{
+  if ((size == 0) || (size % kAESBlockSize != 0)) return size;
+  size_t padBytes = data[size - 1];
+  return ((padBytes <= kAESBlockSize) && (padBytes < size)) ? size - padBytes : size;
+}
+}  // namespace
+
+std::vector<uint8_t> AES256CBCEncode(const std::vector<uint8_t>& input,
+                                     const std::vector<uint8_t>& key,
+                                     const std::vector<uint8_t>& iv)
+{
+  if (!(input.size() > 0) || !(key.size() == 32) || !(iv.size() == 32))
+    return std::vector<uint8_t>();
+
+  AES256Key k(key.data());
+  size_t inputSize = input.size();
+  size_t blocks = inputSize / kAESBlockSize + 1;
+  size_t paddedSize = kAESBlockSize * blocks;
+
+  // add PKCS padding
+  std::vector<uint8_t> ciphertext = input;
+  ciphertext.resize(paddedSize, static_cast<uint8_t>(paddedSize - inputSize));
+
+  uint8_t currentIV[kAESBlockSize];
+  memcpy(currentIV, iv.data(), kAESBlockSize);
+  k.cbcEncrypt(currentIV, ciphertext.data(), ciphertext.data(), blocks);
   return ciphertext;
 }
 
@@ -784,122 +1581,203 @@ std::vector<uint8_t> AES256CBCDecode(const std::vector<uint8_t>& cipher,
 {
   if (!(cipher.size() > 0) || (key.size() < 32) || (iv.size() < 32)) return std::vector<uint8_t>();
 
-  aes256_context ctx;
-  aes256_init(&ctx, key.data());
+  AES256Key k(key.data());
+  size_t blocks = cipher.size() / kAESBlockSize;
+  std::vector<uint8_t> plaintext(kAESBlockSize * blocks);
 
-  const int blockSize = 16;
-  size_t blocks = cipher.size() / blockSize;
+  uint8_t currentIV[kAESBlockSize];
+  memcpy(currentIV, iv.data(), kAESBlockSize);
+  k.cbcDecrypt(currentIV, cipher.data(), plaintext.data(), blocks);
 
-  std::vector<uint8_t> plaintext(blockSize * blocks);
+  // remove PKCS padding
+  plaintext.resize(removePKCSPadding(plaintext.data(), plaintext.size()));
+  return plaintext;
+}
 
-  uint8_t currentIV[blockSize];
-  uint8_t nextIV[blockSize];
-  uint8_t workVector[blockSize];
+// AES256CBCStream
 
-  for (int i = 0; i < blockSize; ++i)
+struct AES256CBCStream::Impl
+{
+  Mode mode;
+  AES256Key key;
+  uint8_t iv[kAESBlockSize];
+  uint8_t pending[kAESBlockSize];
+  size_t pendingBytes{0};
+  size_t totalBytes{0};
+
+  Impl(Mode m, const uint8_t* k, const uint8_t* v) : mode(m), key(k)
   {
-    currentIV[i] = iv[i];
+    memcpy(iv, v, kAESBlockSize);
   }
 
-  for (int b = 0; b < blocks; ++b)
+  void process(const uint8_t* in, uint8_t* out, size_t blocks)
   {
-    // get next cipher block and use ciphertext as next IV
-    for (int i = 0; i < blockSize; ++i)
+    if (mode == kEncode)
     {
-      workVector[i] = cipher[b * blockSize + i];
-      nextIV[i] = workVector[i];
+      key.cbcEncrypt(iv, in, out, blocks);
     }
-
-    aes256_decrypt_ecb(&ctx, workVector);
-
-    // write to plaintext, XOR work vector with IV
-    for (int i = 0; i < blockSize; ++i)
+    else
     {
-      workVector[i] ^= currentIV[i];
-      plaintext[b * blockSize + i] = workVector[i];
-      currentIV[i] = nextIV[i];
+      key.cbcDecrypt(iv, in, out, blocks);
     }
+    totalBytes += blocks * kAESBlockSize;
   }
+};
 
-  aes256_done(&ctx);
+AES256CBCStream::AES256CBCStream(Mode mode, const uint8_t* key, const uint8_t* iv)
+    : pImpl(std::make_unique<Impl>(mode, key, iv))
+{
+}
 
-  // remove PKCS padding
-  size_t paddedSize = plaintext.size();
-  if (paddedSize % blockSize == 0)
+AES256CBCStream::~AES256CBCStream() = default;
+
+size_t AES256CBCStream::update(const uint8_t* data, size_t size, uint8_t* out)
+{
+  Impl& s = *pImpl;
+  uint8_t* op = out;
+
+  // When decoding, the last block is held back until finish() so that its padding can be
+  // removed. So a full pending block is only processed once more data arrives.
+  const size_t heldBytes = (s.mode == kDecode) ? 1 : 0;
+
+  if (s.pendingBytes > 0)
+  {
+    size_t n = std::min(size, kAESBlockSize - s.pendingBytes);
+    memcpy(s.pending + s.pendingBytes, data, n);
+    s.pendingBytes += n;
+    data += n;
+    size -= n;
+    if ((s.pendingBytes < kAESBlockSize) || (size < heldBytes)) return 0;
+    s.process(s.pending, op, 1);
+    op += kAESBlockSize;
+    s.pendingBytes = 0;
+  }
+
+  size_t blocks = (size >= heldBytes) ? (size - heldBytes) / kAESBlockSize : 0;
+  s.process(data, op, blocks);
+  op += blocks * kAESBlockSize;
+  data += blocks * kAESBlockSize;
+  size -= blocks * kAESBlockSize;
+
+  memcpy(s.pending, data, size);
+  s.pendingBytes = size;
+  return op - out;
+}
+
+size_t AES256CBCStream::finish(uint8_t* out)
+{
+  Impl& s = *pImpl;
+  size_t n = 0;
+  if (s.mode == kEncode)
+  {
+    // add PKCS padding
+    memset(s.pending + s.pendingBytes, static_cast<int>(kAESBlockSize - s.pendingBytes),
+           kAESBlockSize - s.pendingBytes);
+    s.process(s.pending, out, 1);
+    n = kAESBlockSize;
+  }
+  else if (s.pendingBytes == kAESBlockSize)
   {
-    int padBytes = plaintext[paddedSize - 1];
-    if ((padBytes <= 16) && (padBytes < paddedSize))
+    s.process(s.pending, out, 1);
+
+    // remove PKCS padding, as removePKCSPadding() does for the whole data.
+    size_t padBytes = out[kAESBlockSize - 1];
+    bool hasPadding = (padBytes <= kAESBlockSize) && (padBytes < s.totalBytes);
+    n = hasPadding ? kAESBlockSize - padBytes : kAESBlockSize;
+  }
+  s.pendingBytes = 0;
+  return n;
+}
+
+namespace
+{
+// the order of the Latin-1 code points in collate(): by ASCII lower case,
+// then lower case before upper within a letter.
+constexpr std::array<uint8_t, 256> makeLatinCollationRanks()
+{
+  auto weight = [](int c) {
+    int lower = ((c >= 'A') && (c <= 'Z')) ? c + ('a' - 'A') : c;
+    return lower * 2 + (lower != c);
+  };
+  std::array<uint8_t, 256> ranks{};
+  for (int c = 0; c < 256; ++c)
+  {
+    int rank = 0;
+    for (int d = 0; d < 256; ++d)
     {
-      plaintext.resize(paddedSize - padBytes);
+      if (weight(d) < weight(c)) rank++;
     }
+    ranks[c] = static_cast<uint8_t>(rank);
   }
+  return ranks;
+}
 
-  return plaintext;
+constexpr std::array<uint8_t, 256> kLatinCollationRanks{makeLatinCollationRanks()};
+
+// Latin-1 code points come before all others.
+inline uint32_t getCollationWeight(CodePoint c)
+{
+  return isLatin(c) ? kLatinCollationRanks[c] : static_cast<uint32_t>(c);
 }
+}  // namespace
 
 bool collate(const TextFragment& a, const TextFragment& b)
 {
-  auto ia = a.begin();
-  auto ib = b.begin();
+  const char* pa = a.getText();
+  const char* pb = b.getText();
+  const char* endA = pa + a.lengthInBytes();
+  const char* endB = pb + b.lengthInBytes();
 
-  int iterEnds = 0;
-  while (!iterEnds)
+  while ((pa < endA) && (pb < endB))
   {
-    CodePoint ca = *ia;
-    CodePoint cb = *ib;
-
+    CodePoint ca = TextFragment::decodeUTF8(pa);
+    CodePoint cb = TextFragment::decodeUTF8(pb);
     if (!validateCodePoint(ca)) return false;
     if (!validateCodePoint(cb)) return false;
 
     if (ca != cb)
     {
-      // the code points differ.
-      // compare codepoints, produce a result and bail.
-      if (isLatin(ca) && isLatin(cb))
-      {
-        char la = tolower(ca);
-        char lb = tolower(cb);
+      // the code points differ: compare them and bail.
+      return getCollationWeight(ca) < getCollationWeight(cb);
+    }
+    pa += TextFragment::getUTF8Length(*pa);
+    pb += TextFragment::getUTF8Length(*pb);
+  }
 
-        if (la != lb)
-        {
-          // different letters
-          return la < lb;
-        }
-        else
-        {
-          // different cases but same letter. define lower case as less within
-          // letter.
-          return ca > cb;
-        }
-      }
-      else
-      {
-        // TODO collate other languages better using miniutf library.
-        return ca < cb;
-      }
+  // if a ended but not b, a < b.
+  return (pa >= endA) && (pb < endB);
+}
+
+size_t makeCollationKey(TextView text, uint8_t* dest)
+{
+  // two bytes for each Latin-1 code point and three for others, so that the
+  // keys compare in order byte by byte.
+  uint8_t* p = dest;
+  const char* end = text.getText() + text.lengthInBytes();
+  for (auto it = text.begin(); it.getPosition() < end; ++it)
+  {
+    CodePoint c = *it;
+    if (!validateCodePoint(c)) break;
+    if (isLatin(c))
+    {
+      *p++ = 0;
+      *p++ = kLatinCollationRanks[c];
     }
     else
     {
-      ++ia;
-      ++ib;
+      *p++ = static_cast<uint8_t>(1 + (c >> 16));
+      *p++ = static_cast<uint8_t>(c >> 8);
+      *p++ = static_cast<uint8_t>(c);
     }
-
-    int aEnd = (ia == a.end());
-    int bEnd = (ib == b.end());
-    iterEnds = (aEnd << 1) | bEnd;
   }
+  return p - dest;
+}
 
-  switch (iterEnds)
-  {
-    case 1:  // b ended but not a: a > b.
-      return false;
-    case 2:  // a ended but not b: a < b.
-      return true;
-    case 3:   // both ended, a == b.
-    default:  // impossible
-      return false;
-  }
-  return false;
+CollationKey makeCollationKey(TextView text)
+{
+  CollationKey key(getMaxCollationKeySize(text.lengthInBytes()));
+  key.resize(makeCollationKey(text, key.data()));
+  return key;
 }
 
 #pragma mark Symbol utilities
@@ -1071,16 +1949,68 @@ std::vector<Symbol> makeVectorOfNonsenseSymbols(int len)
   return words;
 }
 
-ml::Text formatNumber(const float number, const int digits, const int precision, const bool doSign,
-                      Symbol mode) throw()
+namespace
+{
+// writes to a fixed buffer, dropping what doesn't fit.
+struct CharWriter
 {
-  const std::vector<ml::Text> pitchNames{"A",  "A#", "B", "C",  "C#", "D",
-                                         "D#", "E",  "F", "F#", "G",  "G#"};
+  char* p;
+  char* end;
 
-  const int bufLength = 16;
-  char numBuf[bufLength] = {0};
-  char format[bufLength] = {0};
-  float tweakedNumber;
+  void put(char c)
+  {
+    if (p < end) *p++ = c;
+  }
+  void put(const char* t, size_t n)
+  {
+    n = std::min(n, static_cast<size_t>(end - p));
+    memcpy(p, t, n);
+    p += n;
+  }
+  void putInt(int i)
+  {
+    char buf[kMaxNumberChars];
+    if (i < 0) put('-');
+    put(buf, naturalNumberToChars(std::abs(i), buf));
+  }
+
+  // the same as printf("%-*.*f"), with a '+' flag if doSign: precision digits
+  // after the point, left justified in width chars.
+  void putFixed(float x, int width, int precision, bool doSign)
+  {
+    char* start = p;
+    if (doSign && !std::signbit(x)) put('+');
+
+    char buf[128];
+    size_t n{0};
+#if ML_FLOAT_CHARCONV
+    auto r = std::to_chars(buf, buf + sizeof(buf), x, std::chars_format::fixed, precision);
+    if (r.ec == std::errc()) n = r.ptr - buf;
+#endif
+    if (!n)
+    {
+      int written = snprintf(buf, sizeof(buf), "%.*f", precision, x);
+      n = std::min(static_cast<size_t>(std::max(written, 0)), sizeof(buf) - 1);
+      for (size_t i = 0; i < n; ++i)
+      {
+        // snprintf uses the decimal point of the current locale.
+        if (buf[i] == ',') buf[i] = '.';
+      }
+    }
+    put(buf, n);
+
+    while ((p - start < width) && (p < end)) put(' ');
+  }
+};
+}  // namespace
+
+size_t formatNumber(char* dest, size_t destSize, float number, int digits, int precision,
+                    bool doSign, Symbol mode)
+{
+  static const char* pitchNames[12]{"A",  "A#", "B", "C",  "C#", "D",
+                                    "D#", "E",  "F", "F#", "G",  "G#"};
+  if (!destSize) return 0;
+  CharWriter w{dest, dest + destSize - 1};
 
   // get digits to display
   int m = (precision > 0) ? std::max(digits, precision + 1) : digits;
@@ -1088,23 +2018,9 @@ ml::Text formatNumber(const float number, const int digits, const int precision,
   int p = (d + precision > m) ? m - d : precision;
   p = std::max(p, 0);
 
-  //  printf("---------number: %-+10.2f\n", number);
-  //  printf("---------number: %-+10.8f\n", number);
-  //  printf("max: %d, digits: %d, after decimal: %d\n", m, d, p);
-
-  tweakedNumber = number;
   if (mode == "default")
   {
-    if (doSign)
-    {
-      snprintf(format, bufLength, "X-+0%1d.%1df", m, p);
-    }
-    else
-    {
-      snprintf(format, bufLength, "X-0%1d.%1df", m, p);
-    }
-    format[0] = 37;  // '%'
-    snprintf(numBuf, bufLength, format, tweakedNumber);
+    w.putFixed(number, m, p, doSign);
   }
   else if (mode == "ratio")
   {
@@ -1115,23 +2031,16 @@ ml::Text formatNumber(const float number, const int digits, const int precision,
       {
         if (fabs(number - (float)a / (float)b) < 0.001)
         {
-          snprintf(numBuf, bufLength, "%d/%d", a, b);
+          w.putInt(a);
+          w.put('/');
+          w.putInt(b);
           done = true;
         }
       }
     }
     if (!done)
     {
-      if (doSign)
-      {
-        snprintf(format, bufLength, "X-+0%1d.%1df", m, p);
-      }
-      else
-      {
-        snprintf(format, bufLength, "X-0%1d.%1df", m, p);
-      }
-      format[0] = 37;  // '%'
-      snprintf(numBuf, bufLength, format, tweakedNumber);
+      w.putFixed(number, m, p, doSign);
     }
   }
   else if (mode == "pitch1")  // just show As
@@ -1139,50 +2048,45 @@ ml::Text formatNumber(const float number, const int digits, const int precision,
     int octave = log2(number / (27.5f - 0.01f));
     float quant = (pow(2.f, (float)octave) * 27.5f);
     float distFromOctave = fabs(number - quant);
+    w.putFixed(number, m, p, false);
     if (distFromOctave < 0.01)
     {
-      snprintf(format, bufLength, "X-0%1d.%1df\nA%d", m, p, octave);
+      w.put("\nA", 2);
+      w.putInt(octave);
     }
-    else
-    {
-      snprintf(format, bufLength, "X-0%1d.%1df", m, p);
-    }
-    format[0] = 37;  // '%'
-    snprintf(numBuf, bufLength, format, tweakedNumber);
   }
   else if (mode == "pitch2")  // show all notes
   {
     int note = log2f(number / (27.5f - 0.01f)) * 12.f;
     float quantizedNotePitch = (pow(2.f, (float)note / 12.f) * 27.5f);
     float distFromNote = fabs(number - quantizedNotePitch);
+    w.putFixed(number, m, p, false);
     if (distFromNote < 0.01)
     {
       const int octaveFromC = (note - 3) / 12;
-      snprintf(format, bufLength, "X-0%1d.%1df\n%s%d", m, p, pitchNames[note % 12].getText(),
-               octaveFromC);
+      const char* name = pitchNames[((note % 12) + 12) % 12];
+      w.put('\n');
+      w.put(name, strlen(name));
+      w.putInt(octaveFromC);
     }
-    else
-    {
-      snprintf(format, bufLength, "X-0%1d.%1df", m, p);
-    }
-    format[0] = 37;  // '%'
-    snprintf(numBuf, bufLength, format, tweakedNumber);
   }
   else if (mode == "db")
   {
-    if (doSign)
-    {
-      snprintf(format, bufLength, "X-+0%1d.%1dfdB", m, p);
-    }
-    else
-    {
-      snprintf(format, bufLength, "X-0%1d.%1dfdB", m, p);
-    }
-    format[0] = 37;  // '%'
-    snprintf(numBuf, bufLength, format, tweakedNumber);
+    w.putFixed(number, m, p, doSign);
+    w.put("dB", 2);
   }
 
-  return Text(numBuf);
+  *w.p = 0;
+  return w.p - dest;
+}
+
+ml::Text formatNumber(const float number, const int digits, const int precision, const bool doSign,
+                      Symbol mode) throw()
+{
+  const int bufLength = 16;
+  char numBuf[bufLength];
+  size_t n = formatNumber(numBuf, bufLength, number, digits, precision, doSign, mode);
+  return Text(numBuf, n);
 }
 
 std::string toHex(int value, int width)
@@ -6,6 +6,7 @@
 
 #include <functional>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -24,10 +25,29 @@ bool isCJK(CodePoint c);
 // TextFragment utilities
 
 TextFragment naturalNumberToText(size_t i);
-size_t textToNaturalNumber(const TextFragment& frag);
+size_t textToNaturalNumber(TextView text);
 
 TextFragment floatNumberToText(float f, int precision = 5);
-float textToFloatNumber(const TextFragment& frag);
+float textToFloatNumber(TextView text);
+
+// Numbers into and out of caller buffers, without allocating. The writers
+// put at most kMaxNumberChars chars in dest, with no terminator, and return
+// the number written. The readers read as much of the text as makes a number,
+// with no leading whitespace or '+', and return the number of chars read, or
+// 0 if the text doesn't start with a number.
+constexpr size_t kMaxNumberChars{32};
+
+size_t naturalNumberToChars(size_t i, char* dest);
+
+// the shortest text that reads back as exactly the same float, in the
+// notation that is shorter: for example "0.1", "12345", or "1e+38".
+size_t floatNumberToChars(float f, char* dest);
+
+// larger numbers saturate at the largest size_t.
+size_t charsToNaturalNumber(const char* text, size_t length, size_t& result);
+
+// rounds correctly, so text from floatNumberToChars reads back exactly.
+size_t charsToFloatNumber(const char* text, size_t length, float& result);
 
 TextFragment addFinalNumber(TextFragment t, int n);
 TextFragment stripFinalNumber(TextFragment t);
@@ -50,6 +70,10 @@ TextFragment join(const std::vector<TextFragment>& vec, CodePoint delimiter);
 // (end - 1) in the input frag.
 TextFragment subText(const TextFragment& frag, size_t start, size_t end);
 
+// the same as subText, returning a view into the input text instead of a copy.
+// An end past the end of the text is treated as the end.
+TextView subTextView(TextView text, size_t start, size_t end);
+
 // given a fragment and a mapping function on code points, return a new fragment
 // with the function applied to each code point.
 TextFragment map(const TextFragment& frag, std::function<CodePoint(CodePoint)> f);
@@ -66,6 +90,59 @@ TextFragment replace(const TextFragment& frag, CodePoint toFind, CodePoint toRep
 // found the original fragment is returned.
 std::vector<TextFragment> split(TextFragment frag, CodePoint delimiter = '\n');
 
+// TextSplitter: the pieces of a text between instances of a delimiter, as
+// views, found one at a time while iterating. As with split(), empty pieces
+// are skipped. Nothing is allocated, and the text is not validated.
+//
+//   for (TextView item : TextSplitter(listText, '/')) { ... }
+class TextSplitter
+{
+ public:
+  TextSplitter(TextView text, CodePoint delimiter = '\n');
+
+  class Iterator
+  {
+    const TextSplitter* splitter_;
+    TextView piece_;
+
+   public:
+    Iterator(const TextSplitter* s, TextView piece) : splitter_(s), piece_(piece) {}
+
+    TextView operator*() const { return piece_; }
+    const TextView* operator->() const { return &piece_; }
+
+    Iterator& operator++()
+    {
+      piece_ = splitter_->nextPiece(piece_.getText() + piece_.lengthInBytes());
+      return *this;
+    }
+
+    friend bool operator==(const Iterator& a, const Iterator& b)
+    {
+      return a.piece_.getText() == b.piece_.getText();
+    }
+    friend bool operator!=(const Iterator& a, const Iterator& b) { return !(a == b); }
+  };
+
+  Iterator begin() const { return Iterator(this, nextPiece(text_.getText())); }
+  Iterator end() const { return Iterator(this, TextView(textEnd(), 0)); }
+
+  size_t countPieces() const;
+
+  // the piece at the index, or an empty view if there are not that many.
+  TextView getPiece(size_t index) const;
+
+ private:
+  const char* textEnd() const { return text_.getText() + text_.lengthInBytes(); }
+
+  // the first piece at or after pos, or an empty view at the end.
+  TextView nextPiece(const char* pos) const;
+
+  TextView text_;
+  char delimiter_[4];
+  size_t delimiterBytes_;
+};
+
 // Return the prefix of the input frag as a new TextFragment, stripping the last
 // dot and any codepoints after it.
 TextFragment stripExtension(const TextFragment& frag);
@@ -83,11 +160,28 @@ TextFragment getPath(const TextFragment& frag);
 Symbol bestScriptForTextFragment(const TextFragment& frag);
 
 TextFragment stripWhitespaceAtEnds(const TextFragment& frag);
+TextView stripWhitespaceAtEndsView(TextView text);
 TextFragment stripAllWhitespace(const TextFragment& frag);
 
 TextFragment base64Encode(const std::vector<uint8_t>& b);
 std::vector<uint8_t> base64Decode(const TextFragment& b);
 
+// Base64 into and out of caller buffers, without allocating. Encoding writes
+// getBase64EncodedSize(size) chars with no terminator. Decoding stops at the
+// first char outside the base64 alphabet, such as '=', and needs room for
+// getBase64MaxDecodedSize(length) bytes. Both return the number written.
+// Where SSSE3 or NEON is available, 16 chars are done at a time.
+size_t getBase64EncodedSize(size_t bytes);
+size_t getBase64MaxDecodedSize(size_t chars);
+size_t base64Encode(const uint8_t* data, size_t size, char* dest);
+size_t base64Decode(const char* text, size_t length, uint8_t* dest);
+
+// true if the bytes are well-formed UTF-8: no overlong encodings, surrogates,
+// code points past 0x10FFFF or truncated sequences. TextFragments copy their
+// bytes without checking them, so text from outside should be checked here.
+// Where SSSE3 or NEON is available, 16 bytes are checked at a time.
+bool validateUTF8(const char* text, size_t length);
+
 std::vector<uint8_t> AES256CBCEncode(const std::vector<uint8_t>& plaintext,
                                      const std::vector<uint8_t>& key,
                                      const std::vector<uint8_t>& iv);
@@ -95,7 +189,42 @@ std::vector<uint8_t> AES256CBCDecode(const std::vector<uint8_t>& ciphertext,
                                      const std::vector<uint8_t>& key,
                                      const std::vector<uint8_t>& iv);
 
+// AES-256 runs on AES-NI or ARMv8 crypto instructions when the CPU has them,
+// and otherwise on the bundled software implementation. The software one can
+// be selected for testing.
+bool isAESHardwareAvailable();
+void setUseAESHardware(bool b);
+
+// AES256CBCStream: the same encryption as AES256CBCEncode / AES256CBCDecode,
+// a piece at a time, for large payloads. update() takes any amount of data
+// and writes the blocks that are done to out, which needs room for size + 16
+// bytes. finish() writes the end of the data, at most 16 bytes, and returns
+// the number written. When decoding, the padding is removed by finish(), and
+// any partial block at the end of the input is ignored.
+class AES256CBCStream
+{
+ public:
+  enum Mode
+  {
+    kEncode,
+    kDecode
+  };
+
+  // key is 32 bytes and iv is 16.
+  AES256CBCStream(Mode mode, const uint8_t* key, const uint8_t* iv);
+  ~AES256CBCStream();
+
+  size_t update(const uint8_t* data, size_t size, uint8_t* out);
+  size_t finish(uint8_t* out);
+
+ private:
+  struct Impl;
+  std::unique_ptr<Impl> pImpl;
+};
+
 // perform case-insensitive compare of fragments and return (a < b).
+// Latin-1 letters compare ignoring ASCII case, with lower case first within
+// a letter, and come before all other code points, which compare by value.
 // TODO collate other languages better using miniutf library.
 bool collate(const TextFragment& a, const TextFragment& b);
 
@@ -104,6 +233,20 @@ struct Collator
   bool operator()(const TextFragment& a, const TextFragment& b) const { return collate(a, b); }
 };
 
+// Collation keys: bytes made once from a text so that comparing the keys of
+// two texts, with memcmp and then by length, gives the same order as
+// collate(). std::vector compares the keys that way, so keys can be sorted
+// or searched with the usual algorithms. Keys end at the first invalid code
+// point.
+using CollationKey = std::vector<uint8_t>;
+
+// a key is never more than twice the length of its text in bytes.
+inline size_t getMaxCollationKeySize(size_t textBytes) { return textBytes * 2; }
+
+// write the key into dest and return its length.
+size_t makeCollationKey(TextView text, uint8_t* dest);
+CollationKey makeCollationKey(TextView text);
+
 // Symbol utilities
 
 Symbol addFinalNumber(Symbol sym, int n);
@@ -146,6 +289,12 @@ T getElementChecked(const std::vector<T> vec, int index) noexcept
 ml::Text formatNumber(const float number, const int digits, const int precision, const bool doSign,
                       Symbol mode = "default") throw();
 
+// the same text as formatNumber, written to dest followed by a null terminator
+// and truncated to fit in destSize bytes as snprintf would. Returns the
+// length written.
+size_t formatNumber(char* dest, size_t destSize, float number, int digits, int precision,
+                    bool doSign, Symbol mode = "default");
+
 // hex dumper
 
 void hexDump(uint8_t* blobData, size_t blobSize);
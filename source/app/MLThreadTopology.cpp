@@ -0,0 +1,375 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLThreadTopology.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <thread>
+#include <tuple>
+
+#include "MLPlatform.h"
+
+#if ML_WINDOWS
+#include <windows.h>
+#endif
+
+namespace ml
+{
+namespace threadTopology
+{
+bool readLine(const std::string& path, std::string& line)
+{
+  std::ifstream in(path);
+  return in && std::getline(in, line);
+}
+
+int readInt(const std::string& path, int defaultValue)
+{
+  std::string line;
+  return readLine(path, line) ? std::atoi(line.c_str()) : defaultValue;
+}
+
+// the first CPU in a list file, or defaultValue.
+int readFirstInList(const std::string& path, int defaultValue)
+{
+  std::string line;
+  if (!readLine(path, line)) return defaultValue;
+  std::vector<int> cpus = parseCPUList(line);
+  return cpus.empty() ? defaultValue : cpus.front();
+}
+
+// one CPU per core, with all CPUs sharing one cache.
+CPUTopology makeUniformTopology(int n)
+{
+  CPUTopology t;
+  for (int i = 0; i < n; ++i)
+  {
+    CPUCore c;
+    c.id = c.physicalCore = c.l2Domain = i;
+    t.cores.push_back(c);
+  }
+  return t;
+}
+
+#if ML_WINDOWS
+int lowestBit(KAFFINITY mask)
+{
+  for (int i = 0; i < int(sizeof(mask) * 8); ++i)
+  {
+    if (mask & (KAFFINITY(1) << i)) return i;
+  }
+  return 0;
+}
+
+// the processors in group 0, to match setCurrentThreadCore().
+CPUTopology readWindowsTopology()
+{
+  CPUTopology t;
+  DWORD bytes{0};
+  GetLogicalProcessorInformationEx(RelationAll, nullptr, &bytes);
+  if (!bytes) return t;
+  std::vector<char> buffer(bytes);
+  auto* pInfo = reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data());
+  if (!GetLogicalProcessorInformationEx(RelationAll, pInfo, &bytes)) return t;
+
+  constexpr int kMaxCPUs = int(sizeof(KAFFINITY) * 8);
+  std::vector<CPUCore> cores(kMaxCPUs);
+  std::vector<bool> present(kMaxCPUs, false);
+  std::vector<int> efficiencyClass(kMaxCPUs, 0);
+  int maxClass{0};
+  int package{0};
+  for (DWORD offset = 0; offset < bytes;)
+  {
+    auto* p = reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data() + offset);
+    KAFFINITY mask{0};
+    if ((p->Relationship == RelationProcessorCore) ||
+        (p->Relationship == RelationProcessorPackage))
+    {
+      if (p->Processor.GroupMask[0].Group == 0) mask = p->Processor.GroupMask[0].Mask;
+    }
+    else if (p->Relationship == RelationNumaNode)
+    {
+      if (p->NumaNode.GroupMask.Group == 0) mask = p->NumaNode.GroupMask.Mask;
+    }
+    else if (p->Relationship == RelationCache)
+    {
+      if ((p->Cache.Type != CacheInstruction) && (p->Cache.GroupMask.Group == 0))
+      {
+        mask = p->Cache.GroupMask.Mask;
+      }
+    }
+
+    const int first = lowestBit(mask);
+    for (int i = 0; mask && (i < kMaxCPUs); ++i)
+    {
+      if (!(mask & (KAFFINITY(1) << i))) continue;
+      CPUCore& c = cores[i];
+      switch (p->Relationship)
+      {
+        case RelationProcessorCore:
+          present[i] = true;
+          c.id = i;
+          c.physicalCore = first;
+          efficiencyClass[i] = p->Processor.EfficiencyClass;
+          maxClass = std::max(maxClass, int(p->Processor.EfficiencyClass));
+          break;
+        case RelationProcessorPackage:
+          c.package = package;
+          break;
+        case RelationNumaNode:
+          c.node = int(p->NumaNode.NodeNumber);
+          break;
+        case RelationCache:
+          if (p->Cache.Level == 2) c.l2Domain = first;
+          if (p->Cache.Level == 3) c.l3Domain = first;
+          break;
+        default:
+          break;
+      }
+    }
+    if (p->Relationship == RelationProcessorPackage) package++;
+    offset += p->Size;
+  }
+
+  for (int i = 0; i < kMaxCPUs; ++i)
+  {
+    if (!present[i]) continue;
+    cores[i].efficiency = efficiencyClass[i] < maxClass;
+    t.cores.push_back(cores[i]);
+  }
+  return t;
+}
+#endif
+}  // namespace threadTopology
+
+size_t CPUTopology::getNumPhysicalCores() const
+{
+  return size_t(std::count_if(cores.begin(), cores.end(),
+                              [](const CPUCore& c) { return c.id == c.physicalCore; }));
+}
+
+size_t CPUTopology::getNumPackages() const
+{
+  std::vector<int> packages;
+  for (const auto& c : cores)
+  {
+    if (std::find(packages.begin(), packages.end(), c.package) == packages.end())
+    {
+      packages.push_back(c.package);
+    }
+  }
+  return packages.size();
+}
+
+size_t CPUTopology::getNumNodes() const
+{
+  std::vector<int> nodes;
+  for (const auto& c : cores)
+  {
+    if (std::find(nodes.begin(), nodes.end(), c.node) == nodes.end())
+    {
+      nodes.push_back(c.node);
+    }
+  }
+  return nodes.size();
+}
+
+int CPUTopology::getNode(int id) const
+{
+  auto it = std::find_if(cores.begin(), cores.end(), [&](const CPUCore& c) { return c.id == id; });
+  return (it != cores.end()) ? it->node : -1;
+}
+
+bool CPUTopology::isHybrid() const
+{
+  bool efficiency{false}, performance{false};
+  for (const auto& c : cores)
+  {
+    (c.efficiency ? efficiency : performance) = true;
+  }
+  return efficiency && performance;
+}
+
+std::vector<int> parseCPUList(const std::string& list)
+{
+  std::vector<int> cpus;
+  size_t start = 0;
+  while (start < list.size())
+  {
+    size_t end = list.find(',', start);
+    if (end == std::string::npos) end = list.size();
+    const std::string item = list.substr(start, end - start);
+    const size_t dash = item.find('-');
+    if (!item.empty() && std::isdigit(static_cast<unsigned char>(item[0])))
+    {
+      const int first = std::atoi(item.c_str());
+      const int last = (dash != std::string::npos) ? std::atoi(item.c_str() + dash + 1) : first;
+      for (int i = first; i <= last; ++i)
+      {
+        cpus.push_back(i);
+      }
+    }
+    start = end + 1;
+  }
+  return cpus;
+}
+
+CPUTopology readSysfsCPUTopology(const std::string& cpuDir)
+{
+  using namespace threadTopology;
+  CPUTopology t;
+  std::string online, line;
+  if (!readLine(cpuDir + "/online", online)) return t;
+
+  // Intel hybrid CPUs list their efficiency cores as cpu_atom. On ARM, the cores with less than
+  // the largest capacity are efficiency cores.
+  std::vector<int> atoms;
+  if (readLine(cpuDir + "/../../cpu_atom/cpus", line)) atoms = parseCPUList(line);
+  std::vector<int> capacities;
+  int maxCapacity{0};
+
+  for (int id : parseCPUList(online))
+  {
+    const std::string dir = cpuDir + "/cpu" + std::to_string(id);
+    CPUCore c;
+    c.id = id;
+    c.package = readInt(dir + "/topology/physical_package_id", 0);
+    c.physicalCore = readFirstInList(dir + "/topology/core_cpus_list",
+                                     readFirstInList(dir + "/topology/thread_siblings_list", id));
+    c.l2Domain = c.physicalCore;
+    c.l3Domain = -1;
+    for (int i = 0;; ++i)
+    {
+      const std::string cache = dir + "/cache/index" + std::to_string(i);
+      const int level = readInt(cache + "/level", -1);
+      if (level < 0) break;
+      if (readLine(cache + "/type", line) && (line == "Instruction")) continue;
+      if (level == 2) c.l2Domain = readFirstInList(cache + "/shared_cpu_list", c.l2Domain);
+      if (level == 3) c.l3Domain = readFirstInList(cache + "/shared_cpu_list", id);
+    }
+    c.efficiency = std::find(atoms.begin(), atoms.end(), id) != atoms.end();
+    const int capacity = readInt(dir + "/cpu_capacity", 0);
+    capacities.push_back(capacity);
+    maxCapacity = std::max(maxCapacity, capacity);
+    t.cores.push_back(c);
+  }
+
+  // the NUMA nodes list their CPUs.
+  if (readLine(cpuDir + "/../node/online", line))
+  {
+    for (int node : parseCPUList(line))
+    {
+      std::string cpus;
+      if (!readLine(cpuDir + "/../node/node" + std::to_string(node) + "/cpulist", cpus)) continue;
+      for (int id : parseCPUList(cpus))
+      {
+        for (auto& c : t.cores)
+        {
+          if (c.id == id) c.node = node;
+        }
+      }
+    }
+  }
+
+  for (size_t i = 0; i < t.cores.size(); ++i)
+  {
+    CPUCore& c = t.cores[i];
+    if (capacities[i] < maxCapacity) c.efficiency = true;
+
+    // without an L3 cache, the package is the domain.
+    if (c.l3Domain < 0)
+    {
+      auto first = std::find_if(t.cores.begin(), t.cores.end(),
+                                [&](const CPUCore& d) { return d.package == c.package; });
+      c.l3Domain = first->id;
+    }
+  }
+  return t;
+}
+
+CPUTopology getCPUTopology()
+{
+  CPUTopology t;
+#if ML_LINUX
+  t = readSysfsCPUTopology("/sys/devices/system/cpu");
+#elif ML_WINDOWS
+  t = threadTopology::readWindowsTopology();
+#endif
+  if (t.cores.empty())
+  {
+    t = threadTopology::makeUniformTopology(int(std::max(std::thread::hardware_concurrency(), 1u)));
+  }
+  return t;
+}
+
+ThreadPlacement planThreadPlacement(const CPUTopology& topology, size_t nWorkers)
+{
+  ThreadPlacement p;
+  const auto& cores = topology.cores;
+  if (cores.empty()) return p;
+
+  // one CPU from each physical performance core, or from each core if all are efficiency cores.
+  const bool hybrid = topology.isHybrid();
+  std::vector<const CPUCore*> candidates;
+  for (const auto& c : cores)
+  {
+    if ((c.id == c.physicalCore) && !(hybrid && c.efficiency)) candidates.push_back(&c);
+  }
+
+  // rank the L3 domains by their number of candidates.
+  auto domainSize = [&](int domain) {
+    return std::count_if(candidates.begin(), candidates.end(),
+                         [&](const CPUCore* c) { return c->l3Domain == domain; });
+  };
+  const int firstCore = cores.front().physicalCore;
+  std::sort(candidates.begin(), candidates.end(),
+            [&](const CPUCore* a, const CPUCore* b) {
+              auto key = [&](const CPUCore* c) {
+                return std::make_tuple(c->physicalCore == firstCore, -domainSize(c->l3Domain),
+                                       c->l3Domain, c->l2Domain, c->id);
+              };
+              return key(a) < key(b);
+            });
+
+  const size_t n = std::min(nWorkers + 1, candidates.size());
+  std::vector<int> realtimeCores;
+  for (size_t i = 0; i < n; ++i)
+  {
+    realtimeCores.push_back(candidates[i]->id);
+  }
+  if (!realtimeCores.empty())
+  {
+    p.audioCore = realtimeCores.front();
+    p.workerCores.assign(realtimeCores.begin() + 1, realtimeCores.end());
+  }
+
+  // control threads stay off the real-time cores and their SMT siblings where possible.
+  auto isRealtime = [&](int id) {
+    return std::find(realtimeCores.begin(), realtimeCores.end(), id) != realtimeCores.end();
+  };
+  for (const auto& c : cores)
+  {
+    if (!isRealtime(c.physicalCore)) p.controlCores.push_back(c.id);
+  }
+  if (p.controlCores.empty())
+  {
+    for (const auto& c : cores)
+    {
+      if (!isRealtime(c.id)) p.controlCores.push_back(c.id);
+    }
+  }
+  if (p.controlCores.empty())
+  {
+    for (const auto& c : cores)
+    {
+      p.controlCores.push_back(c.id);
+    }
+  }
+  return p;
+}
+
+}  // namespace ml
@@ -0,0 +1,86 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// Thread placement by CPU topology: which cores to pin the audio thread, its workers and the
+// other threads of an application to.
+//
+// getCPUTopology() lists the logical CPUs with their packages, NUMA nodes, physical cores and
+// the CPUs they share L2 and L3 caches with, and marks the efficiency cores of hybrid CPUs. This is read
+// from sysfs on Linux and from GetLogicalProcessorInformationEx() on Windows. Elsewhere, and
+// where the system doesn't say, all CPUs are performance cores sharing one cache.
+//
+// planThreadPlacement() picks performance cores for the real-time threads, one per physical
+// core, from the L3 domain with the most of them and grouped by L2, so that the audio thread
+// and its workers share caches and never the execution units of an SMT sibling. The first
+// core of the system, which often handles interrupts, is used only if nothing else is left.
+// The other cores, including the efficiency cores, are left for control threads such as the
+// Timers thread. The cores can be passed to AudioTaskConfig::core,
+// AudioEngineConfig::workerCores and Timers::setThreadCores(). The node of a worker's core can
+// be given to a LargeBufferPolicy, to keep the buffers the worker processes in local memory.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace ml
+{
+struct CPUCore
+{
+  // the logical CPU number, as used by setCurrentThreadCore().
+  int id{0};
+  int package{0};
+
+  // the NUMA node whose memory is local to the CPU.
+  int node{0};
+
+  // the lowest id of the logical CPUs on the same physical core, and of those sharing its L2
+  // and L3 caches.
+  int physicalCore{0};
+  int l2Domain{0};
+  int l3Domain{0};
+
+  bool efficiency{false};
+};
+
+struct CPUTopology
+{
+  // in order of id.
+  std::vector<CPUCore> cores;
+
+  size_t getNumPhysicalCores() const;
+  size_t getNumPackages() const;
+  size_t getNumNodes() const;
+  bool isHybrid() const;
+
+  // the NUMA node of a CPU, or -1 if there is no CPU with the id.
+  int getNode(int id) const;
+};
+
+struct ThreadPlacement
+{
+  // the core for the audio callback thread, or -1 if there are no cores to spare.
+  int audioCore{-1};
+
+  // the cores for real-time workers, which may be fewer than asked for.
+  std::vector<int> workerCores;
+
+  // the cores for all other threads: those not given to real-time threads, or all the cores
+  // if none are left.
+  std::vector<int> controlCores;
+};
+
+// read the topology of this machine. Not real-time safe.
+CPUTopology getCPUTopology();
+
+// read the topology from a Linux sysfs cpu directory, normally /sys/devices/system/cpu.
+CPUTopology readSysfsCPUTopology(const std::string& cpuDir);
+
+// parse a Linux CPU list like "0-3,8,10-11".
+std::vector<int> parseCPUList(const std::string& list);
+
+// choose cores for the audio thread and nWorkers real-time workers.
+ThreadPlacement planThreadPlacement(const CPUTopology& topology, size_t nWorkers);
+
+}  // namespace ml
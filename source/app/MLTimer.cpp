@@ -7,7 +7,9 @@
 #include <chrono>
 #include <functional>
 
+#include "MLDSPDenormals.h"
 #include "MLPlatform.h"
+#include "MLRealtimeThread.h"
 using namespace std::chrono;
 
 // Timers
@@ -74,6 +76,8 @@ void ml::Timers::stop()
 
 void ml::Timers::run(void)
 {
+  if (kFlushDenormalsAutomatically) setCurrentThreadFlushDenormalsToZero();
+  if (!threadCores_.empty()) setCurrentThreadCores(threadCores_);
   while (running_)
   {
     std::this_thread::sleep_for(milliseconds(Timers::kMillisecondsResolution));
@@ -139,6 +143,8 @@ void ml::Timers::stop()
 
 void ml::Timers::run(void)
 {
+  if (kFlushDenormalsAutomatically) setCurrentThreadFlushDenormalsToZero();
+  if (!threadCores_.empty()) setCurrentThreadCores(threadCores_);
   while (running_)
   {
     std::this_thread::sleep_for(milliseconds(Timers::kMillisecondsResolution));
@@ -159,6 +165,8 @@ void ml::Timers::start(bool runInMainThread)
 
 void ml::Timers::run(void)
 {
+  if (kFlushDenormalsAutomatically) setCurrentThreadFlushDenormalsToZero();
+  if (!threadCores_.empty()) setCurrentThreadCores(threadCores_);
   while (running_)
   {
     std::this_thread::sleep_for(milliseconds(Timers::kMillisecondsResolution));
@@ -10,6 +10,7 @@
 #include <mutex>
 #include <set>
 #include <thread>
+#include <vector>
 
 #include "MLPlatform.h"
 #include "MLSharedResource.h"
@@ -46,6 +47,10 @@ class Timers
   void start(bool runInMainThread = false);
   void stop();
 
+  // run the timers thread only on the given cores, such as the controlCores of a
+  // ThreadPlacement. Takes effect at the next start(), and not in the main thread.
+  void setThreadCores(std::vector<int> cores) { threadCores_ = std::move(cores); }
+
   void insert(Timer* t) { timerPtrs_.insert(t); }
   void erase(Timer* t) { timerPtrs_.erase(t); }
 
@@ -63,6 +68,7 @@ class Timers
   bool inMainThread_{false};
   std::set<Timer*> timerPtrs_;
   std::thread runThread;
+  std::vector<int> threadCores_;
 
 #if ML_WINDOWS
   int mainTimerID_{0};
@@ -0,0 +1,261 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLTimerWheel.h"
+
+#include <algorithm>
+
+namespace ml
+{
+TimerWheel::TimerWheel(Clock::duration resolution, Clock::time_point startTime)
+    : resolution_(std::max(resolution, Clock::duration(1))),
+      startTime_(startTime),
+      chunks_(std::make_unique<std::unique_ptr<Node[]>[]>(kMaxChunks))
+{
+  for (auto& level : slots_)
+  {
+    level.fill(kNone);
+  }
+}
+
+TimerWheel::~TimerWheel() { stop(); }
+
+uint64_t TimerWheel::toTicks(Clock::duration d) const
+{
+  // round up, and wait at least one tick.
+  int64_t ticks = (d.count() + resolution_.count() - 1) / resolution_.count();
+  return std::min(static_cast<uint64_t>(std::max(ticks, int64_t(1))), kMaxDelayTicks);
+}
+
+uint32_t TimerWheel::allocNode()
+{
+  if (freeList_ == kNone)
+  {
+    if (numChunks_ == kMaxChunks) return kNone;
+
+    // add a chunk of nodes to the free list.
+    chunks_[numChunks_] = std::make_unique<Node[]>(kChunkSize);
+    uint32_t first = numChunks_ << kChunkBits;
+    numChunks_++;
+    for (uint32_t i = kChunkSize; i > 0; --i)
+    {
+      node(first + i - 1).next = freeList_;
+      freeList_ = first + i - 1;
+    }
+  }
+  uint32_t i = freeList_;
+  freeList_ = node(i).next;
+  return i;
+}
+
+void TimerWheel::freeNode(uint32_t i)
+{
+  Node& n = node(i);
+  n.func = nullptr;
+  n.state = State::kFree;
+  n.generation++;
+  n.next = freeList_;
+  freeList_ = i;
+  activeCount_--;
+}
+
+// put a scheduled node in the slot for its expiry time.
+void TimerWheel::insert(uint32_t i)
+{
+  Node& n = node(i);
+  if (n.expiry <= currentTick_) n.expiry = currentTick_ + 1;
+  uint64_t delta = n.expiry - currentTick_;
+
+  int level = 0;
+  while ((level < kLevels - 1) && (delta >= (uint64_t(1) << ((level + 1) * kSlotBits))))
+  {
+    level++;
+  }
+  uint32_t slot = (n.expiry >> (level * kSlotBits)) & kSlotMask;
+
+  n.level = static_cast<uint8_t>(level);
+  n.slot = static_cast<uint8_t>(slot);
+  n.prev = kNone;
+  n.next = slots_[level][slot];
+  if (n.next != kNone) node(n.next).prev = i;
+  slots_[level][slot] = i;
+}
+
+void TimerWheel::unlink(uint32_t i)
+{
+  Node& n = node(i);
+  if (n.prev != kNone)
+  {
+    node(n.prev).next = n.next;
+  }
+  else
+  {
+    slots_[n.level][n.slot] = n.next;
+  }
+  if (n.next != kNone) node(n.next).prev = n.prev;
+}
+
+TimerWheel::TimerID TimerWheel::schedule(Callback f, Clock::duration period, int count)
+{
+  if (count == 0) return TimerID{};
+  std::unique_lock<std::mutex> lock(mutex_);
+  uint32_t i = allocNode();
+  if (i == kNone) return TimerID{};
+
+  Node& n = node(i);
+  n.func = std::move(f);
+  n.period = toTicks(period);
+  n.expiry = currentTick_ + n.period;
+  n.counter = count;
+  n.state = State::kScheduled;
+  insert(i);
+  activeCount_++;
+  return TimerID{i, n.generation};
+}
+
+bool TimerWheel::cancel(TimerID id)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (id.index >= (numChunks_ << kChunkBits)) return false;
+  Node& n = node(id.index);
+  if (n.generation != id.generation) return false;
+
+  switch (n.state)
+  {
+    case State::kScheduled:
+      unlink(id.index);
+      freeNode(id.index);
+      return true;
+    case State::kFiring:
+      // the node is freed after its callback returns.
+      n.state = State::kCancelled;
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool TimerWheel::isActive(TimerID id)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (id.index >= (numChunks_ << kChunkBits)) return false;
+  Node& n = node(id.index);
+  return (n.generation == id.generation) &&
+         ((n.state == State::kScheduled) || (n.state == State::kFiring));
+}
+
+size_t TimerWheel::getActiveCount()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  return activeCount_;
+}
+
+// move the timers in a slot of a higher level down to the levels below.
+void TimerWheel::cascade(int level, uint32_t slot)
+{
+  uint32_t i = slots_[level][slot];
+  slots_[level][slot] = kNone;
+  while (i != kNone)
+  {
+    uint32_t next = node(i).next;
+    insert(i);
+    i = next;
+  }
+}
+
+// advance one tick and run the timers that expire. Called with mutex_ held.
+void TimerWheel::tick()
+{
+  currentTick_++;
+  for (int level = 1; level < kLevels; ++level)
+  {
+    // cascade each time the level below wraps around.
+    if ((currentTick_ & ((uint64_t(1) << (level * kSlotBits)) - 1)) != 0) break;
+    cascade(level, (currentTick_ >> (level * kSlotBits)) & kSlotMask);
+  }
+
+  // take the list of expired timers out of the wheel.
+  uint32_t slot = currentTick_ & kSlotMask;
+  uint32_t expired = slots_[0][slot];
+  if (expired == kNone) return;
+  slots_[0][slot] = kNone;
+  for (uint32_t i = expired; i != kNone; i = node(i).next)
+  {
+    node(i).state = State::kFiring;
+  }
+
+  // run the callbacks without the lock. Only this thread changes the links
+  // and functions of firing nodes. A callback can cancel a timer later in the
+  // batch, so the state is checked again under the lock before each one.
+  mutex_.unlock();
+  for (uint32_t i = expired; i != kNone; i = node(i).next)
+  {
+    mutex_.lock();
+    bool cancelled = (node(i).state == State::kCancelled);
+    mutex_.unlock();
+    if (!cancelled) node(i).func();
+  }
+  mutex_.lock();
+
+  // reschedule or free the nodes.
+  uint32_t i = expired;
+  while (i != kNone)
+  {
+    Node& n = node(i);
+    uint32_t next = n.next;
+    if (n.counter > 0) n.counter--;
+    if ((n.state == State::kCancelled) || (n.counter == 0))
+    {
+      freeNode(i);
+    }
+    else
+    {
+      n.state = State::kScheduled;
+      n.expiry += n.period;
+      insert(i);
+    }
+    i = next;
+  }
+}
+
+void TimerWheel::advanceTo(Clock::time_point now)
+{
+  if (now < startTime_) return;
+  uint64_t targetTick = static_cast<uint64_t>((now - startTime_) / resolution_);
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (currentTick_ < targetTick)
+  {
+    tick();
+  }
+}
+
+void TimerWheel::start()
+{
+  if (running_.exchange(true)) return;
+  runThread_ = std::thread{[this]() { run(); }};
+}
+
+void TimerWheel::stop()
+{
+  if (running_.exchange(false))
+  {
+    runThread_.join();
+  }
+}
+
+void TimerWheel::run()
+{
+  while (running_.load(std::memory_order_acquire))
+  {
+    uint64_t nextTick;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      nextTick = currentTick_ + 1;
+    }
+    std::this_thread::sleep_until(startTime_ + resolution_ * nextTick);
+    advanceTo(Clock::now());
+  }
+}
+
+}  // namespace ml
@@ -0,0 +1,149 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "MLPlatform.h"
+
+namespace ml
+{
+// TimerWheel: an alternative to Timers for large numbers of timers, or for
+// timers that need better than Timers::kMillisecondsResolution.
+//
+// Timers are kept in a hierarchical timing wheel: four levels of 256 slots,
+// each level counting 256 times as slowly as the one below. Scheduling,
+// cancelling, and expiring a timer are all O(1), and each tick only touches
+// the timers that are due. The resolution is set in the constructor and can be
+// well under a millisecond. Delays are limited to 2^32 ticks.
+//
+// Time comes from steady_clock. Either call advanceTo() from your own loop,
+// or call start() to advance the wheel from a private thread. Callbacks are
+// called with no lock held, so they may schedule or cancel timers. As with
+// Timers, long tasks should be handed off to another thread.
+
+class TimerWheel
+{
+ public:
+  using Clock = std::chrono::steady_clock;
+  using Callback = std::function<void(void)>;
+
+  // identifies a scheduled timer. IDs of expired or cancelled timers are
+  // never reused for new timers, so they are safe to cancel at any time.
+  // If too many timers are active, an invalid ID is returned.
+  struct TimerID
+  {
+    uint32_t index{~0u};
+    uint32_t generation{0};
+  };
+
+  explicit TimerWheel(Clock::duration resolution = std::chrono::milliseconds(1),
+                      Clock::time_point startTime = Clock::now());
+  ~TimerWheel();
+
+  TimerWheel(TimerWheel const&) = delete;
+  TimerWheel& operator=(TimerWheel const&) = delete;
+
+  // call the function once after the delay.
+  TimerID callOnce(Callback f, Clock::duration delay) { return schedule(std::move(f), delay, 1); }
+
+  // call the function n times, waiting the period before each.
+  TimerID callNTimes(Callback f, Clock::duration period, int n)
+  {
+    return schedule(std::move(f), period, n);
+  }
+
+  // call the function periodically until cancelled. the wait period happens
+  // before the first call.
+  TimerID callPeriodically(Callback f, Clock::duration period)
+  {
+    return schedule(std::move(f), period, -1);
+  }
+
+  // returns true if the timer was active.
+  bool cancel(TimerID id);
+  bool isActive(TimerID id);
+
+  size_t getActiveCount();
+  Clock::duration getResolution() const { return resolution_; }
+
+  // run all the timers that are due at or before the given time.
+  void advanceTo(Clock::time_point now);
+
+  // advance the wheel from a private thread, waking once per tick.
+  void start();
+  void stop();
+
+ private:
+  static constexpr int kLevels{4};
+  static constexpr int kSlotBits{8};
+  static constexpr uint32_t kSlots{1 << kSlotBits};
+  static constexpr uint32_t kSlotMask{kSlots - 1};
+  static constexpr uint64_t kMaxDelayTicks{(uint64_t(1) << (kLevels * kSlotBits)) - 1};
+  static constexpr uint32_t kNone{~0u};
+
+  // nodes are allocated in chunks that never move, so that callbacks can be
+  // called without the lock while other threads add timers.
+  static constexpr uint32_t kChunkBits{8};
+  static constexpr uint32_t kChunkSize{1 << kChunkBits};
+  static constexpr uint32_t kMaxChunks{4096};
+
+  enum class State : uint8_t
+  {
+    kFree,
+    kScheduled,
+    kFiring,
+    kCancelled
+  };
+
+  struct Node
+  {
+    Callback func;
+    uint64_t expiry{0};
+    uint64_t period{0};
+    int counter{0};
+    uint32_t prev{kNone};
+    uint32_t next{kNone};
+    uint32_t generation{0};
+    uint8_t level{0};
+    uint8_t slot{0};
+    State state{State::kFree};
+  };
+
+  Node& node(uint32_t i) { return chunks_[i >> kChunkBits][i & (kChunkSize - 1)]; }
+  TimerID schedule(Callback f, Clock::duration period, int n);
+  uint64_t toTicks(Clock::duration d) const;
+  uint32_t allocNode();
+  void freeNode(uint32_t i);
+  void insert(uint32_t i);
+  void unlink(uint32_t i);
+  void cascade(int level, uint32_t slot);
+  void tick();
+  void run();
+
+  const Clock::duration resolution_;
+  const Clock::time_point startTime_;
+
+  std::mutex mutex_;
+  std::unique_ptr<std::unique_ptr<Node[]>[]> chunks_;
+  uint32_t numChunks_{0};
+  uint32_t freeList_{kNone};
+  size_t activeCount_{0};
+  uint64_t currentTick_{0};
+  std::array<std::array<uint32_t, kSlots>, kLevels> slots_;
+
+  std::thread runThread_;
+  std::atomic<bool> running_{false};
+};
+
+}  // namespace ml
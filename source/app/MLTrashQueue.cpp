@@ -0,0 +1,59 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLTrashQueue.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace ml
+{
+
+TrashQueue::~TrashQueue()
+{
+  stop();
+  emptyTrash();
+}
+
+size_t TrashQueue::emptyTrash()
+{
+  size_t n{0};
+  Entry e;
+  while (queue_.pop(e))
+  {
+    e.reset();
+    n++;
+  }
+  return n;
+}
+
+void TrashQueue::start(int intervalMs)
+{
+  if (thread_.joinable()) return;
+  stopRequested_ = false;
+  auto interval = std::chrono::milliseconds(std::max(intervalMs, 1));
+  thread_ = std::thread(
+      [this, interval]()
+      {
+        std::unique_lock<std::mutex> lock(threadMutex_);
+        while (!stopRequested_)
+        {
+          emptyTrash();
+          threadCondition_.wait_for(lock, interval, [this]() { return stopRequested_; });
+        }
+      });
+}
+
+void TrashQueue::stop()
+{
+  if (!thread_.joinable()) return;
+  {
+    std::lock_guard<std::mutex> lock(threadMutex_);
+    stopRequested_ = true;
+  }
+  threadCondition_.notify_one();
+  thread_.join();
+}
+
+}  // namespace ml
@@ -0,0 +1,135 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// TrashQueue: destroy objects released on the audio thread somewhere else.
+//
+// When audio code drops the last reference to something that owns memory, like a Value with a
+// heap payload, a Sample, a SamplePool::SamplePtr or a unique_ptr, the memory is freed on the
+// audio thread. Instead, the object can be moved into a TrashQueue with dispose(), which does
+// not allocate or lock. A housekeeping thread, started with start(), or a Timer calling
+// emptyTrash(), destroys the objects later.
+//
+// Objects are moved into fixed-size cells of a lock-free MPMCQueue, so any number of threads
+// can dispose at once. Types up to kInlineBytes that can be moved without throwing fit in a
+// cell. Anything bigger can be disposed of as a unique_ptr. If the queue is full, dispose()
+// returns false and leaves the object with the caller, and the overflow is counted.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "MLQueue.h"
+
+namespace ml
+{
+class TrashQueue
+{
+ public:
+  static constexpr size_t kInlineBytes{64};
+  static constexpr size_t kDefaultCapacity{1024};
+
+  explicit TrashQueue(size_t capacity = kDefaultCapacity) : queue_(capacity) {}
+
+  // stops the thread and destroys everything still in the queue.
+  ~TrashQueue();
+
+  TrashQueue(const TrashQueue&) = delete;
+  TrashQueue& operator=(const TrashQueue&) = delete;
+
+  // take an object to destroy later. Real-time safe if moving the object doesn't allocate.
+  template <class T>
+  bool dispose(T&& object)
+  {
+    static_assert(!std::is_lvalue_reference<T>::value, "dispose() takes objects by moving them");
+    using U = std::decay_t<T>;
+    static_assert(sizeof(U) <= kInlineBytes, "too big to dispose of inline: use a unique_ptr");
+    static_assert(alignof(U) <= alignof(std::max_align_t), "too strictly aligned");
+    static_assert(std::is_nothrow_move_constructible<U>::value, "must be nothrow movable");
+
+    Entry e;
+    new (e.storage) U(std::move(object));
+    e.ops = &kOps<U>;
+    if (queue_.push(std::move(e))) return true;
+
+    // give it back rather than destroying it here.
+    object = std::move(*std::launder(reinterpret_cast<U*>(e.storage)));
+    overflows_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  // start and stop the housekeeping thread, which empties the trash every intervalMs
+  // milliseconds.
+  void start(int intervalMs = 20);
+  void stop();
+
+  // destroy everything in the queue. This is what the housekeeping thread does, and can also
+  // be called from any other thread that can free memory. Returns the number destroyed.
+  size_t emptyTrash();
+
+  size_t getOverflowCount() const { return overflows_.load(std::memory_order_relaxed); }
+
+ private:
+  struct Ops
+  {
+    void (*moveTo)(void* dest, void* src);
+    void (*destroy)(void* object);
+  };
+
+  template <class U>
+  static constexpr Ops kOps{
+      [](void* dest, void* src)
+      {
+        U* pSrc = std::launder(reinterpret_cast<U*>(src));
+        new (dest) U(std::move(*pSrc));
+        pSrc->~U();
+      },
+      [](void* object) { std::launder(reinterpret_cast<U*>(object))->~U(); }};
+
+  // one object of any type that fits, with the functions to move and destroy it.
+  struct Entry
+  {
+    alignas(std::max_align_t) unsigned char storage[kInlineBytes];
+    const Ops* ops{nullptr};
+
+    Entry() = default;
+    Entry(const Entry&) = delete;
+    Entry& operator=(const Entry&) = delete;
+    Entry(Entry&& b) noexcept { *this = std::move(b); }
+    Entry& operator=(Entry&& b) noexcept
+    {
+      if (this != &b)
+      {
+        reset();
+        if (b.ops) b.ops->moveTo(storage, b.storage);
+        ops = b.ops;
+        b.ops = nullptr;
+      }
+      return *this;
+    }
+    ~Entry() { reset(); }
+
+    void reset()
+    {
+      if (ops) ops->destroy(storage);
+      ops = nullptr;
+    }
+  };
+
+  MPMCQueue<Entry> queue_;
+  std::atomic<size_t> overflows_{0};
+
+  std::thread thread_;
+  std::mutex threadMutex_;
+  std::condition_variable threadCondition_;
+  bool stopRequested_{false};
+};
+
+}  // namespace ml
@@ -4,11 +4,18 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
 #include <functional>
 #include <map>
+#include <memory>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
+#include "MLFlatMap.h"
 #include "MLPath.h"
 #include "MLValue.h"
 
@@ -24,6 +31,7 @@
 // Types in use:
 //   Tree<V, Symbol>                            // (default) For compile-time structures
 //   TextTree<V> = Tree<V, TextFragment>    // For runtime structures
+//   Tree<V, Symbol, std::less<Symbol>, TreeFlatStorage>  // children in sorted vectors
 //
 // Static use case (Tree):
 // Synth parameters, DSP graph configurations, and other compile-time-known
@@ -66,38 +74,282 @@
 namespace ml
 {
 
+template <class V, class K, class C>
+class FrozenTree;
+
+// Storage policies for the children of a Tree node. TreeMapStorage (the
+// default) uses std::map. TreeFlatStorage uses a FlatMap, which keeps the
+// keys of each node's children packed in a sorted vector. It is faster to
+// search, iterate, build and destroy, but adding a node invalidates
+// references to the values of its siblings and their subtrees.
+
+struct TreeMapStorage
+{
+  template <class K, class T, class C>
+  using Map = std::map<K, T, C>;
+
+  // the memory of each child besides its key and value: a std::map node has three pointers
+  // and a color.
+  static constexpr size_t kNodeOverhead{4 * sizeof(void*)};
+};
+
+struct TreeFlatStorage
+{
+  template <class K, class T, class C>
+  using Map = FlatMap<K, T, C>;
+  static constexpr size_t kNodeOverhead{0};
+};
+
 // Tree - templated on Key type
 
-template <class V, class K = Symbol, class C = std::less<K>>
+template <class V, class K = Symbol, class C = std::less<K>, class S = TreeMapStorage>
 class Tree
 {
-  using mapT = std::map<K, Tree<V, K, C>, C>;
+  using mapT = typename S::template Map<K, Tree, C>;
   mapT children_{};
   V value_{};
 
+  friend class FrozenTree<V, K, C>;
+
+  // the optional index from whole-path hashes to nodes, for Symbol keys. An
+  // entry with no node marks two paths with the same hash, which are looked
+  // up by walking. A hash of 0 marks an empty entry.
+  struct HashIndex
+  {
+    struct Entry
+    {
+      uint64_t hash{0};
+      const Tree* node{nullptr};
+    };
+    std::vector<Entry> entries;
+    size_t count{0};
+  };
+  std::unique_ptr<HashIndex> hashIndex_;
+
+  static constexpr uint64_t kRootPathHash{textHashConsts::k2};
+
+  static uint64_t combinePathHash(uint64_t h, uint64_t elementHash)
+  {
+    h = detail::mix(h ^ textHashConsts::k0, elementHash ^ textHashConsts::k1);
+    return h ? h : 1;
+  }
+
+  static uint64_t getPathHash(const uint64_t* elements, size_t n)
+  {
+    uint64_t h = kRootPathHash;
+    for (size_t i = 0; i < n; ++i)
+    {
+      h = combinePathHash(h, elements[i]);
+    }
+    return h;
+  }
+
+  static void insertInIndex(HashIndex& index, uint64_t hash, const Tree* node)
+  {
+    if ((index.count + 1) * 2 > index.entries.size())
+    {
+      // grow and reinsert.
+      std::vector<typename HashIndex::Entry> old(std::max<size_t>(index.entries.size() * 2, 64));
+      old.swap(index.entries);
+      index.count = 0;
+      for (const auto& e : old)
+      {
+        if (e.hash) insertInIndex(index, e.hash, e.node);
+      }
+    }
+    size_t mask = index.entries.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask)
+    {
+      auto& e = index.entries[i];
+      if (!e.hash)
+      {
+        e.hash = hash;
+        e.node = node;
+        index.count++;
+        return;
+      }
+      if (e.hash == hash)
+      {
+        if (e.node != node) e.node = nullptr;
+        return;
+      }
+    }
+  }
+
+  const Tree* findInIndex(uint64_t hash) const
+  {
+    const auto& entries = hashIndex_->entries;
+    if (entries.empty()) return nullptr;
+    size_t mask = entries.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask)
+    {
+      if (entries[i].hash == hash) return entries[i].node;
+      if (!entries[i].hash) return nullptr;
+    }
+  }
+
+  void indexSubtree(HashIndex& index, const Tree* node, uint64_t hash) const
+  {
+    insertInIndex(index, hash, node);
+    for (const auto& c : node->children_)
+    {
+      indexSubtree(index, &c.second, combinePathHash(hash, c.first.getHash()));
+    }
+  }
+
+  void rebuildHashIndex()
+  {
+    if constexpr (std::is_same<K, Symbol>::value)
+    {
+      auto index = std::make_unique<HashIndex>();
+      indexSubtree(*index, this, kRootPathHash);
+      hashIndex_ = std::move(index);
+    }
+  }
+
+  // the hash of a child's path from the hash of its parent's, for the index.
+  static uint64_t getChildPathHash(uint64_t parentHash, const K& key)
+  {
+    if constexpr (std::is_same<K, Symbol>::value)
+    {
+      return combinePathHash(parentHash, key.getHash());
+    }
+    else
+    {
+      return 0;
+    }
+  }
+
+  // set the values of src's subtree in this one, walking the sorted children of both together
+  // and making only the nodes that are missing. New nodes are added to index if it is given,
+  // with hashes from this node's hash. Returns true if any nodes were made.
+  bool mergeFrom(const Tree& src, HashIndex* index, uint64_t hash)
+  {
+    C less{};
+    bool added{false};
+    auto d = children_.begin();
+    for (const auto& s : src.children_)
+    {
+      while ((d != children_.end()) && less(d->first, s.first)) ++d;
+      const uint64_t childHash = index ? getChildPathHash(hash, s.first) : 0;
+      if ((d != children_.end()) && !less(s.first, d->first))
+      {
+        if (s.second.hasValue()) d->second.value_ = s.second.value_;
+        added |= d->second.mergeFrom(s.second, index, childHash);
+      }
+      else
+      {
+        // as with add(), only nodes on the way to values are made.
+        Tree child(s.second.value_);
+        child.mergeFrom(s.second, nullptr, 0);
+        if (!child.hasValue() && child.isLeaf()) continue;
+        d = children_.emplace_hint(d, s.first, std::move(child));
+        if constexpr (std::is_same<K, Symbol>::value)
+        {
+          if (index) indexSubtree(*index, &d->second, childHash);
+        }
+        added = true;
+      }
+      ++d;
+    }
+    return added;
+  }
+
+  // the walks below keep one path, adding and removing an element at each level.
+  template <class F>
+  void visitValues(GenericPath<K>& path, F& f) const
+  {
+    for (const auto& c : children_)
+    {
+      path.addElement(c.first);
+      if (c.second.hasValue()) f(static_cast<const GenericPath<K>&>(path), c.second.value_);
+      c.second.visitValues(path, f);
+      path.removeLastElement();
+    }
+  }
+
+  template <class Enter, class Leave>
+  void walk(GenericPath<K>& path, Enter& enter, Leave& leave) const
+  {
+    for (const auto& c : children_)
+    {
+      path.addElement(c.first);
+      const GenericPath<K>& constPath = path;
+      enter(constPath, c.second);
+      c.second.walk(path, enter, leave);
+      leave(constPath, c.second);
+      path.removeLastElement();
+    }
+  }
+
  public:
-  Tree<V, K, C>() = default;
-  Tree<V, K, C>(V val) : value_(std::move(val)) {}
+  Tree() = default;
+  Tree(V val) : value_(std::move(val)) {}
+
+  // copies have a hash index if the source has one.
+  Tree(const Tree& b) : children_(b.children_), value_(b.value_)
+  {
+    if (b.hashIndex_) rebuildHashIndex();
+  }
+
+  Tree& operator=(const Tree& b)
+  {
+    if (this != &b)
+    {
+      children_ = b.children_;
+      value_ = b.value_;
+      hashIndex_.reset();
+      if (b.hashIndex_) rebuildHashIndex();
+    }
+    return *this;
+  }
+
+  // moving keeps the addresses of the nodes, so the index stays valid.
+  Tree(Tree&&) = default;
+  Tree& operator=(Tree&&) = default;
 
   void clear()
   {
     children_.clear();
     value_ = V();
+    if (hashIndex_) *hashIndex_ = HashIndex();
   }
 
-  void combine(const Tree<V, K, C>& b)
+  // HashPath index: a table from a hash of each whole path to its node, so
+  // that getValueFromHash() is usually one probe instead of a search at each
+  // level. Only for Symbol keys. The index is kept up to date by add(),
+  // operator[], combine() and clear() on this Tree. Nodes added through
+  // pointers to subtrees are still found, by walking. Clearing or assigning
+  // subtrees through pointers leaves the index stale: call enableHashIndex()
+  // again afterwards to rebuild it. With TreeFlatStorage, adding a node moves
+  // its siblings, so each add that makes a new node rebuilds the index: build
+  // such trees first and index them after.
+  void enableHashIndex()
   {
-    for (auto it = b.begin(); it != b.end(); ++it)
-    {
-      add(it.getCurrentPath(), *it);
-    }
+    static_assert(std::is_same<K, Symbol>::value, "hash index requires Symbol keys");
+    rebuildHashIndex();
+  }
+
+  void disableHashIndex() { hashIndex_.reset(); }
+  bool hasHashIndex() const { return hashIndex_ != nullptr; }
+
+  // set each value in b at the same path in this tree, adding nodes as needed. This is a merge
+  // of the two trees in one pass, linear in their sizes.
+  void combine(const Tree& b)
+  {
+    if (&b == this) return;
+
+    // with TreeFlatStorage, adding nodes moves their siblings, so the index is rebuilt.
+    constexpr bool kFlat = !std::is_same<S, TreeMapStorage>::value;
+    bool added = mergeFrom(b, kFlat ? nullptr : hashIndex_.get(), kRootPathHash);
+    if (added && kFlat && hashIndex_) rebuildHashIndex();
   }
 
   bool hasValue() const { return value_ != V(); }
   const V& getValue() const { return value_; }
   bool isLeaf() const { return children_.size() == 0; }
 
-  const Tree<V, K, C>* getNode(GenericPath<K> path) const
+  const Tree* getNode(GenericPath<K> path) const
   {
     auto pNode = this;
     for (K key : path)
@@ -116,7 +368,7 @@ class Tree
   }
 
 
-  Tree<V, K, C>* getMutableNode(GenericPath<K> path)
+  Tree* getMutableNode(GenericPath<K> path)
   {
     auto pNode = this;
     for (K key : path)
@@ -167,6 +419,14 @@ class Tree
   const V& getValueFromHash(HashPath path) const
   {
     static const V nullValue{};
+    if (hashIndex_)
+    {
+      if (const Tree* n = findInIndex(getPathHash(path.elements_.data(), path.size_)))
+      {
+        return n->value_;
+      }
+    }
+
     auto pNode = this;
     for(int i=0; i<path.size_; ++i)
     {
@@ -186,7 +446,25 @@ class Tree
     return pNode->value_;
   }
 
-  inline bool operator==(const Tree<V, K, C>& b) const
+  // call f(path, value) for each node with a value, in the order of iteration.
+  template <class F>
+  void visitValues(F&& f) const
+  {
+    GenericPath<K> path;
+    visitValues(path, f);
+  }
+
+  // walk the tree depth first, calling enter(path, node) on reaching each node below this one
+  // and leave(path, node) after its subtree, with or without values. The path is valid only
+  // during the call.
+  template <class Enter, class Leave>
+  void walk(Enter&& enter, Leave&& leave) const
+  {
+    GenericPath<K> path;
+    walk(path, enter, leave);
+  }
+
+  inline bool operator==(const Tree& b) const
   {
     auto itA = begin();
     auto itB = b.begin();
@@ -204,14 +482,18 @@ class Tree
     return (itA == end()) && (itB == b.end());
   }
 
-  inline bool operator!=(const Tree<V, K, C>& b) const { return !(operator==(b)); }
+  inline bool operator!=(const Tree& b) const { return !(operator==(b)); }
 
-  Tree<V, K, C>* add(GenericPath<K> path, V val)
+  Tree* add(GenericPath<K> path, V val)
   {
     auto pNode = this;
     int pathSize = path.getSize();
     if (!pathSize) return pNode;
 
+    // adding to a FlatMap moves the siblings of the new node.
+    bool rebuildIndex =
+        hashIndex_ && !std::is_same<S, TreeMapStorage>::value && !getMutableNode(path);
+
     for (int i = 0; i < pathSize - 1; ++i)
     {
       pNode = &(pNode->children_[path.getElement(i)]);
@@ -230,14 +512,43 @@ class Tree
       pNode = &(newIt->second);
     }
 
+    if (rebuildIndex)
+    {
+      rebuildHashIndex();
+    }
+    else if (hashIndex_)
+    {
+      if constexpr (std::is_same<K, Symbol>::value)
+      {
+        uint64_t h = kRootPathHash;
+        for (int i = 0; i < pathSize; ++i)
+        {
+          h = combinePathHash(h, path.getElement(i).getHash());
+        }
+        insertInIndex(*hashIndex_, h, pNode);
+      }
+    }
     return pNode;
   }
 
   friend class const_iterator;
   class const_iterator
   {
-    std::vector<const Tree<V, K, C>*> nodeStack_;
-    std::vector<typename mapT::const_iterator> iteratorStack_;
+    // a node and an iterator over its children for each level, with room for the deepest path
+    // a Tree can be given. Nodes below that are skipped.
+    static constexpr size_t kMaxLevels{kPathMaxSymbols + 1};
+    std::array<const Tree*, kMaxLevels> nodeStack_{};
+    std::array<typename mapT::const_iterator, kMaxLevels> iteratorStack_{};
+    size_t levels_{0};
+
+    // the name at each level, kept up to date as the iterator moves so that getting the
+    // current path doesn't build one.
+    GenericPath<K> currentPath_;
+
+    void updatePath()
+    {
+      currentPath_.setElement(levels_ - 1, getCurrentNodeNameAtDepth(levels_ - 1));
+    }
 
    public:
     using iterator_category = std::forward_iterator_tag;
@@ -248,67 +559,75 @@ class Tree
 
     const_iterator() {}
 
-    const_iterator(const Tree<V, K, C>* p, const typename mapT::const_iterator subIter)
+    const_iterator(const Tree* p, const typename mapT::const_iterator subIter)
     {
-      nodeStack_.push_back(p);
-      iteratorStack_.push_back(subIter);
+      nodeStack_[0] = p;
+      iteratorStack_[0] = subIter;
+      levels_ = 1;
+      updatePath();
     }
 
     ~const_iterator() {}
 
     bool operator==(const const_iterator& b) const
     {
-      if (nodeStack_.size() != b.nodeStack_.size()) return false;
-      if (nodeStack_.empty() && b.nodeStack_.empty()) return true;
-      if (nodeStack_.back() != b.nodeStack_.back()) return false;
-      return (iteratorStack_.back() == b.iteratorStack_.back());
+      if (levels_ != b.levels_) return false;
+      if (!levels_) return true;
+      if (nodeStack_[levels_ - 1] != b.nodeStack_[levels_ - 1]) return false;
+      return (iteratorStack_[levels_ - 1] == b.iteratorStack_[levels_ - 1]);
     }
 
     bool operator!=(const const_iterator& b) const { return !(*this == b); }
 
-    const V& operator*() const { return ((*iteratorStack_.back()).second).value_; }
+    const V& operator*() const { return ((*iteratorStack_[levels_ - 1]).second).value_; }
+
+    bool canPush() const { return levels_ < kMaxLevels; }
 
-    void push(const Tree<V, K, C>* childNodePtr)
+    void push(const Tree* childNodePtr)
     {
-      nodeStack_.push_back(childNodePtr);
-      iteratorStack_.push_back(childNodePtr->children_.begin());
+      nodeStack_[levels_] = childNodePtr;
+      iteratorStack_[levels_] = childNodePtr->children_.begin();
+      levels_++;
+      updatePath();
     }
 
     void pop()
     {
-      if (nodeStack_.size() > 1)
+      if (levels_ > 1)
       {
-        nodeStack_.pop_back();
-        iteratorStack_.pop_back();
+        levels_--;
+        currentPath_.removeLastElement();
       }
     }
 
     bool atEndOfMap() const
     {
-      return (iteratorStack_.back() == (nodeStack_.back())->children_.end());
+      return (iteratorStack_[levels_ - 1] == nodeStack_[levels_ - 1]->children_.end());
     }
 
     bool nextNode()
     {
-      auto& currentIterator = iteratorStack_.back();
+      auto& currentIterator = iteratorStack_[levels_ - 1];
       if (!atEndOfMap())
       {
         auto currentChildNodePtr = &((*currentIterator).second);
-        if (!currentChildNodePtr->isLeaf())
+        if (!currentChildNodePtr->isLeaf() && canPush())
         {
           push(currentChildNodePtr);
         }
         else
         {
           currentIterator++;
+          updatePath();
         }
       }
       else
       {
-        if (nodeStack_.size() > 1)
+        if (levels_ > 1)
         {
           pop();
-          iteratorStack_.back()++;
+          iteratorStack_[levels_ - 1]++;
+          updatePath();
         }
         else
         {
@@ -320,11 +639,11 @@ class Tree
 
     void firstChild()
     {
-      auto& currentIterator = iteratorStack_.back();
+      auto& currentIterator = iteratorStack_[levels_ - 1];
       if (!atEndOfMap())
       {
         auto currentChildNodePtr = &((*currentIterator).second);
-        if (!currentChildNodePtr->isLeaf())
+        if (!currentChildNodePtr->isLeaf() && canPush())
         {
           push(currentChildNodePtr);
         }
@@ -334,22 +653,28 @@ class Tree
           {
             currentIterator++;
           }
+          updatePath();
         }
       }
       else
       {
-        currentIterator = nodeStack_.back()->children_.begin();
+        currentIterator = nodeStack_[levels_ - 1]->children_.begin();
+        updatePath();
       }
     }
 
     bool hasMoreChildren() { return (!atEndOfMap()); }
 
-    void nextChild() { iteratorStack_.back()++; }
+    void nextChild()
+    {
+      iteratorStack_[levels_ - 1]++;
+      updatePath();
+    }
 
     bool currentNodeHasValue() const
     {
-      auto parentNode = nodeStack_.back();
-      auto& currentIterator = iteratorStack_.back();
+      auto parentNode = nodeStack_[levels_ - 1];
+      auto& currentIterator = iteratorStack_[levels_ - 1];
 
       if (currentIterator == parentNode->children_.end()) return false;
 
@@ -367,7 +692,7 @@ class Tree
       return *this;
     }
 
-    size_t getCurrentDepth() const { return nodeStack_.size() - 1; }
+    size_t getCurrentDepth() const { return levels_ - 1; }
 
     K getCurrentNodeNameAtDepth(size_t i) const
     {
@@ -382,40 +707,34 @@ class Tree
 
     K getCurrentNodeName() const
     {
-      const size_t stackSize = nodeStack_.size();
-      if (stackSize < 1) return K();
-      return getCurrentNodeNameAtDepth(stackSize - 1);
+      if (levels_ < 1) return K();
+      return getCurrentNodeNameAtDepth(levels_ - 1);
     }
 
-    GenericPath<K> getCurrentPath() const
-    {
-      GenericPath<K> p;
-      for (int i = 0; i < nodeStack_.size(); ++i)
-      {
-        K key = getCurrentNodeNameAtDepth(i);
-        p.setElement(i, key);
-      }
-      return p;
-    }
+    // the path to the current node. The reference is valid until the iterator moves.
+    const GenericPath<K>& getCurrentPath() const { return currentPath_; }
 
     void setCurrentPathToRoot()
     {
-      nodeStack_.resize(1);
-      iteratorStack_.clear();
-      iteratorStack_.push_back(nodeStack_[0]->children_.end());
+      levels_ = 1;
+      iteratorStack_[0] = nodeStack_[0]->children_.end();
+      currentPath_ = GenericPath<K>();
+      updatePath();
     }
 
     bool setCurrentPath(GenericPath<K> p)
     {
       setCurrentPathToRoot();
-      const Tree<V, K, C>* nextNode = nodeStack_[0];
+      const Tree* nextNode = nodeStack_[0];
       for (K key : p)
       {
         auto it = nextNode->children_.find(key);
         if (it != nextNode->children_.end())
         {
-          nodeStack_.push_back(nextNode);
-          iteratorStack_.push_back(it);
+          nodeStack_[levels_] = nextNode;
+          iteratorStack_[levels_] = it;
+          levels_++;
+          updatePath();
           nextNode = &(it->second);
         }
         else
@@ -474,23 +793,554 @@ class Tree
     }
   }
 
+  // call f(key, childNode) for each direct child of this node, in key order.
+  template <class F>
+  void forEachChildNode(F&& f) const
+  {
+    for (const auto& c : children_)
+    {
+      f(c.first, c.second);
+    }
+  }
+
   inline size_t size() const
   {
     size_t sum{hasValue()};
-    for (auto& c : children_)
+    for (const auto& c : children_)
     {
       sum += c.second.size();
     }
     return sum;
   }
+
+  // an estimate of the heap memory used by the nodes below this one and by the hash index.
+  // Memory owned by the values, like the contents of a std::vector, is not counted.
+  size_t getMemoryBytes() const
+  {
+    size_t sum{0};
+    if (hashIndex_)
+    {
+      sum += sizeof(HashIndex) + hashIndex_->entries.capacity() * sizeof(typename HashIndex::Entry);
+    }
+    for (const auto& c : children_)
+    {
+      sum += sizeof(K) + sizeof(Tree) + S::kNodeOverhead + c.second.getMemoryBytes();
+    }
+    return sum;
+  }
 };
 
-// Utility functions
+// FrozenTree: a read-only copy of a Tree, for fast lookups on the audio thread.
+//
+// All the nodes are stored in one array in breadth-first order, so the
+// children of each node are contiguous. The keys of each node's children are
+// packed in a parallel array in the Tree's sort order, and found by binary
+// search. A lookup is O(path length) and touches a few cache lines per level,
+// without chasing any map nodes. Nothing is allocated after construction.
+//
+// V must be copyable. Changes to the source Tree are not reflected: make a
+// new FrozenTree to see them.
+
+template <class V, class K = Symbol, class C = std::less<K>>
+class FrozenTree
+{
+ public:
+  static constexpr uint32_t kNoNode{~0u};
+
+  FrozenTree() = default;
+
+  template <class S>
+  explicit FrozenTree(const Tree<V, K, C, S>& tree)
+  {
+    // the root is node 0. Each node's children are appended as the node is
+    // visited, which keeps siblings together.
+    std::vector<const Tree<V, K, C, S>*> sources{&tree};
+    keys_.push_back(K());
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+      const Tree<V, K, C, S>* src = sources[i];
+      nodes_.push_back(Node{static_cast<uint32_t>(sources.size()),
+                            static_cast<uint32_t>(src->children_.size())});
+      values_.push_back(src->value_);
+      if (src->hasValue()) numValues_++;
+      for (const auto& child : src->children_)
+      {
+        keys_.push_back(child.first);
+        sources.push_back(&child.second);
+      }
+    }
+  }
+
+  // returns the index of the node at the path, or kNoNode.
+  uint32_t findNode(const GenericPath<K>& path) const
+  {
+    if (nodes_.empty()) return kNoNode;
+    uint32_t n = 0;
+    for (K key : path)
+    {
+      n = findChild(n, key);
+      if (n == kNoNode) break;
+    }
+    return n;
+  }
+
+  bool hasNode(const GenericPath<K>& path) const { return findNode(path) != kNoNode; }
+
+  const V& operator[](const GenericPath<K>& path) const { return getNodeValue(findNode(path)); }
+
+  const V& getValueFromHash(HashPath path) const
+  {
+    if (nodes_.empty()) return nullValue();
+    uint32_t n = 0;
+    for (size_t i = 0; i < path.size_ && n != kNoNode; ++i)
+    {
+      n = findChild(n, Symbol(path.elements_[i]));
+    }
+    return getNodeValue(n);
+  }
+
+  // values of nodes found with findNode(). Nodes without values have V().
+  const V& getNodeValue(uint32_t n) const { return (n < nodes_.size()) ? values_[n] : nullValue(); }
+
+  // the number of nodes with values, as in Tree::size().
+  size_t size() const { return numValues_; }
+  size_t getNumNodes() const { return nodes_.size(); }
+
+ private:
+  struct Node
+  {
+    uint32_t firstChild;
+    uint32_t numChildren;
+  };
+
+  static const V& nullValue()
+  {
+    static const V v{};
+    return v;
+  }
+
+  uint32_t findChild(uint32_t n, const K& key) const
+  {
+    auto first = keys_.begin() + nodes_[n].firstChild;
+    auto last = first + nodes_[n].numChildren;
+    auto it = std::lower_bound(first, last, key, comparator_);
+    if ((it == last) || comparator_(key, *it)) return kNoNode;
+    return static_cast<uint32_t>(it - keys_.begin());
+  }
+
+  // node i has key keys_[i] in its parent, and value values_[i].
+  std::vector<Node> nodes_;
+  std::vector<K> keys_;
+  std::vector<V> values_;
+  size_t numValues_{0};
+  C comparator_{};
+};
+
+// PersistentTree: an immutable Tree whose versions share their unchanged nodes.
+//
+// set() returns a new version, copying only the nodes on the path to the change. Each copied
+// node gets its own copy of its value and of its child pointers, and points to the same
+// children as before except for the one on the path. The other nodes, and their subtrees, are
+// shared with the earlier version. So a change costs O(depth) allocations, copying a version
+// costs one reference count, and an undo stack of versions holds mostly shared memory.
+//
+// Nodes are never changed once made, so any number of threads can read a version while
+// another makes new ones. A reader holding a copy of a version keeps its nodes alive. The
+// children of each node are kept in a sorted vector and found by binary search.
+//
+// V must be copyable. As with Tree, nodes can't be removed.
 
 template <class V, class K = Symbol, class C = std::less<K>>
-const Tree<V, K, C> filterByPathList(const Tree<V, K, C>& t, std::vector<GenericPath<K>> pList)
+class PersistentTree
+{
+ public:
+  struct Node;
+  using NodePtr = std::shared_ptr<const Node>;
+
+  struct Node
+  {
+    V value{};
+    std::vector<std::pair<K, NodePtr>> children;
+
+    const Node* findChild(const K& key) const
+    {
+      auto it = lowerBound(children, key);
+      return ((it == children.end()) || C()(key, it->first)) ? nullptr : it->second.get();
+    }
+  };
+
+  PersistentTree() = default;
+
+  template <class S>
+  explicit PersistentTree(const Tree<V, K, C, S>& tree) : root_(build(tree)), size_(tree.size())
+  {
+  }
+
+  // return a new version with the value at the path set, making any nodes needed.
+  PersistentTree set(const GenericPath<K>& path, V value) const
+  {
+    const bool had = hasValue((*this)[path]);
+    const bool has = hasValue(value);
+    return PersistentTree(setInNode(root_.get(), path, 0, std::move(value)),
+                          size_ - had + has);
+  }
+
+  const Node* getNode(const GenericPath<K>& path) const
+  {
+    const Node* n = root_.get();
+    for (int i = 0; n && (i < path.getSize()); ++i)
+    {
+      n = n->findChild(path.getElement(i));
+    }
+    return n;
+  }
+
+  bool hasNode(const GenericPath<K>& path) const { return getNode(path) != nullptr; }
+
+  const V& operator[](const GenericPath<K>& path) const
+  {
+    static const V nullValue{};
+    const Node* n = getNode(path);
+    return n ? n->value : nullValue;
+  }
+
+  // true if the two versions are the same one, or one is an unchanged copy of the other.
+  bool isSameVersion(const PersistentTree& b) const { return root_ == b.root_; }
+
+  // the number of nodes with values, as in Tree::size().
+  size_t size() const { return size_; }
+
+  // call f(path, value) for each node with a value, in key order.
+  template <class F>
+  void visitValues(F&& f) const
+  {
+    if (root_) visitValues(*root_, GenericPath<K>(), f);
+  }
+
+  // make a mutable Tree with the same values.
+  template <class S = TreeMapStorage>
+  Tree<V, K, C, S> toTree() const
+  {
+    Tree<V, K, C, S> tree;
+    visitValues([&](const GenericPath<K>& path, const V& value) { tree.add(path, value); });
+    return tree;
+  }
+
+  // versions are equal if they have the same nodes with the same values.
+  bool operator==(const PersistentTree& b) const
+  {
+    return nodesEqual(root_.get(), b.root_.get());
+  }
+  bool operator!=(const PersistentTree& b) const { return !operator==(b); }
+
+ private:
+  PersistentTree(NodePtr root, size_t size) : root_(std::move(root)), size_(size) {}
+
+  static bool hasValue(const V& v) { return v != V(); }
+
+  template <class Children>
+  static auto lowerBound(Children& children, const K& key)
+  {
+    return std::lower_bound(children.begin(), children.end(), key,
+                            [](const auto& child, const K& k) { return C()(child.first, k); });
+  }
+
+  template <class S>
+  static NodePtr build(const Tree<V, K, C, S>& src)
+  {
+    auto node = std::make_shared<Node>();
+    node->value = src.getValue();
+    src.forEachChildNode([&](const K& key, const Tree<V, K, C, S>& child)
+                         { node->children.emplace_back(key, build(child)); });
+    return node;
+  }
+
+  static NodePtr setInNode(const Node* node, const GenericPath<K>& path, int i, V&& value)
+  {
+    auto copy = node ? std::make_shared<Node>(*node) : std::make_shared<Node>();
+    if (i == path.getSize())
+    {
+      copy->value = std::move(value);
+      return copy;
+    }
+
+    const K key = path.getElement(i);
+    auto it = lowerBound(copy->children, key);
+    if ((it != copy->children.end()) && !C()(key, it->first))
+    {
+      it->second = setInNode(it->second.get(), path, i + 1, std::move(value));
+    }
+    else
+    {
+      copy->children.emplace(it, key, setInNode(nullptr, path, i + 1, std::move(value)));
+    }
+    return copy;
+  }
+
+  template <class F>
+  static void visitValues(const Node& node, const GenericPath<K>& path, F& f)
+  {
+    for (const auto& c : node.children)
+    {
+      GenericPath<K> childPath{path};
+      childPath.addElement(c.first);
+      if (hasValue(c.second->value)) f(childPath, c.second->value);
+      visitValues(*c.second, childPath, f);
+    }
+  }
+
+  // compare the values of two subtrees, skipping any shared nodes.
+  static bool nodesEqual(const Node* a, const Node* b)
+  {
+    if (a == b) return true;
+    static const Node emptyNode{};
+    if (!a) a = &emptyNode;
+    if (!b) b = &emptyNode;
+    if (a->value != b->value) return false;
+    if (a->children.size() != b->children.size()) return false;
+    for (size_t i = 0; i < a->children.size(); ++i)
+    {
+      const auto& ca = a->children[i];
+      const auto& cb = b->children[i];
+      if ((ca.first != cb.first) || !nodesEqual(ca.second.get(), cb.second.get())) return false;
+    }
+    return true;
+  }
+
+  NodePtr root_;
+  size_t size_{0};
+};
+
+// NumericTree: a compact Tree of floats and ints, for very large numeric states like
+// modulation matrices and step sequences.
+//
+// A Tree<Value> node has a whole Value, a map of children and the map's own node overhead, which
+// adds up to well over 100 bytes for each float. A NumericTree keeps its nodes in breadth-first
+// order as a FrozenTree does, but with only the index of each node's first child, its key, four
+// bytes of value and one byte of type: about 17 bytes per node for Symbol keys.
+//
+// The shape is fixed when the NumericTree is made from a Tree. Values can then be found by
+// path once, and read and written by index without lookups. Values of other types in the
+// source Tree are left out. toTree() makes a Tree<Value> again, for serialization.
+
+template <class K = Symbol, class C = std::less<K>>
+class NumericTree
+{
+ public:
+  static constexpr uint32_t kNoIndex{~0u};
+
+  NumericTree() = default;
+
+  // make from a Tree of Values, floats or ints.
+  template <class V, class S>
+  explicit NumericTree(const Tree<V, K, C, S>& tree)
+  {
+    std::vector<const Tree<V, K, C, S>*> sources{&tree};
+    keys_.push_back(K());
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+      const Tree<V, K, C, S>* src = sources[i];
+      firstChild_.push_back(static_cast<uint32_t>(sources.size()));
+      values_.push_back(0);
+      types_.push_back(kNone);
+      if (src->hasValue()) setFromSource(i, src->getValue());
+      src->forEachChildNode(
+          [&](const K& key, const Tree<V, K, C, S>& child)
+          {
+            keys_.push_back(key);
+            sources.push_back(&child);
+          });
+    }
+    firstChild_.push_back(static_cast<uint32_t>(sources.size()));
+  }
+
+  // returns the index of the node at the path, or kNoIndex.
+  uint32_t findIndex(const GenericPath<K>& path) const
+  {
+    if (keys_.empty()) return kNoIndex;
+    uint32_t n = 0;
+    for (K key : path)
+    {
+      n = findChild(n, key);
+      if (n == kNoIndex) break;
+    }
+    return n;
+  }
+
+  // access by index. Reading a node without a value returns 0.
+
+  bool hasValue(uint32_t i) const { return types_[i] != kNone; }
+  bool isInt(uint32_t i) const { return types_[i] == kInt; }
+
+  float getFloat(uint32_t i) const
+  {
+    return isInt(i) ? float(loadAs<int32_t>(i)) : loadAs<float>(i);
+  }
+
+  int getInt(uint32_t i) const { return isInt(i) ? loadAs<int32_t>(i) : int(loadAs<float>(i)); }
+
+  void setFloat(uint32_t i, float x)
+  {
+    std::memcpy(&values_[i], &x, sizeof(x));
+    types_[i] = kFloat;
+  }
+
+  void setInt(uint32_t i, int x)
+  {
+    int32_t v = x;
+    std::memcpy(&values_[i], &v, sizeof(v));
+    types_[i] = kInt;
+  }
+
+  Value getValue(uint32_t i) const
+  {
+    switch (types_[i])
+    {
+      case kFloat:
+        return Value(getFloat(i));
+      case kInt:
+        return Value(getInt(i));
+      default:
+        return Value();
+    }
+  }
+
+  // access by path. Setting a path that is not in the tree does nothing.
+
+  Value operator[](const GenericPath<K>& path) const
+  {
+    uint32_t i = findIndex(path);
+    return (i != kNoIndex) ? getValue(i) : Value();
+  }
+
+  bool setFloat(const GenericPath<K>& path, float x)
+  {
+    uint32_t i = findIndex(path);
+    if (i == kNoIndex) return false;
+    setFloat(i, x);
+    return true;
+  }
+
+  bool setInt(const GenericPath<K>& path, int x)
+  {
+    uint32_t i = findIndex(path);
+    if (i == kNoIndex) return false;
+    setInt(i, x);
+    return true;
+  }
+
+  // call f(path, value) for each node with a value, depth first in key order as in Tree.
+  template <class F>
+  void visitValues(F&& f) const
+  {
+    if (keys_.empty()) return;
+    GenericPath<K> path;
+    visitValues(0, path, f);
+  }
+
+  template <class S = TreeMapStorage>
+  Tree<Value, K, C, S> toTree() const
+  {
+    Tree<Value, K, C, S> t;
+    visitValues([&](const GenericPath<K>& p, const Value& v) { t.add(p, v); });
+    return t;
+  }
+
+  // the number of nodes with values, as in Tree::size().
+  size_t size() const
+  {
+    return size_t(std::count_if(types_.begin(), types_.end(), [](uint8_t t) { return t != kNone; }));
+  }
+  size_t getNumNodes() const { return keys_.size(); }
+
+  // the number of values in the source Tree that were not floats or ints.
+  size_t getNumSkipped() const { return skipped_; }
+
+  size_t getMemoryBytes() const
+  {
+    return firstChild_.capacity() * sizeof(uint32_t) + keys_.capacity() * sizeof(K) +
+           values_.capacity() * sizeof(uint32_t) + types_.capacity() * sizeof(uint8_t);
+  }
+
+  bool operator==(const NumericTree& b) const
+  {
+    return (firstChild_ == b.firstChild_) && (keys_ == b.keys_) && (values_ == b.values_) &&
+           (types_ == b.types_);
+  }
+  bool operator!=(const NumericTree& b) const { return !operator==(b); }
+
+ private:
+  enum : uint8_t
+  {
+    kNone,
+    kFloat,
+    kInt
+  };
+
+  template <class T>
+  T loadAs(uint32_t i) const
+  {
+    T x;
+    std::memcpy(&x, &values_[i], sizeof(x));
+    return x;
+  }
+
+  void setFromSource(size_t i, float x) { setFloat(uint32_t(i), x); }
+  void setFromSource(size_t i, int x) { setInt(uint32_t(i), x); }
+  void setFromSource(size_t i, const Value& v)
+  {
+    if (v.getType() == Value::kFloat)
+    {
+      setFloat(uint32_t(i), v.getFloatValue());
+    }
+    else if (v.getType() == Value::kInt)
+    {
+      setInt(uint32_t(i), v.getIntValue());
+    }
+    else
+    {
+      skipped_++;
+    }
+  }
+
+  uint32_t findChild(uint32_t n, const K& key) const
+  {
+    auto first = keys_.begin() + firstChild_[n];
+    auto last = keys_.begin() + firstChild_[n + 1];
+    auto it = std::lower_bound(first, last, key, comparator_);
+    if ((it == last) || comparator_(key, *it)) return kNoIndex;
+    return static_cast<uint32_t>(it - keys_.begin());
+  }
+
+  template <class F>
+  void visitValues(uint32_t n, GenericPath<K>& path, F& f) const
+  {
+    if (hasValue(n)) f(path, getValue(n));
+    for (uint32_t c = firstChild_[n]; c < firstChild_[n + 1]; ++c)
+    {
+      path.addElement(keys_[c]);
+      visitValues(c, path, f);
+      path.removeLastElement();
+    }
+  }
+
+  // node i has key keys_[i] in its parent, and its children are the nodes from firstChild_[i]
+  // up to firstChild_[i + 1]. There is one more entry in firstChild_ than there are nodes.
+  std::vector<uint32_t> firstChild_;
+  std::vector<K> keys_;
+  std::vector<uint32_t> values_;
+  std::vector<uint8_t> types_;
+  size_t skipped_{0};
+  C comparator_{};
+};
+
+// Utility functions
+
+template <class V, class K = Symbol, class C = std::less<K>, class S = TreeMapStorage>
+const Tree<V, K, C, S> filterByPathList(const Tree<V, K, C, S>& t,
+                                        std::vector<GenericPath<K>> pList)
 {
-  Tree<V, K, C> filteredTree;
+  Tree<V, K, C, S> filteredTree;
   for (auto it = t.begin(); it != t.end(); ++it)
   {
     auto p = it.getCurrentPath();
@@ -4,24 +4,74 @@
 
 #include "MLValue.h"
 
+#include <atomic>
+
 #include "MLTextUtils.h"
 
 namespace ml
 {
 
+// heap payloads
+
+namespace
+{
+// the header before the data of each heap payload. Its size keeps the data 16-byte aligned.
+struct alignas(16) PayloadHeader
+{
+  std::atomic<uint32_t> refs;
+};
+static_assert(sizeof(PayloadHeader) == 16, "PayloadHeader size changed");
+
+void* mallocPayload(size_t bytes) { return malloc(bytes); }
+void freePayload(void* p, size_t) { free(p); }
+Value::PayloadAllocator payloadAllocator{mallocPayload, freePayload};
+
+PayloadHeader* getPayloadHeader(uint8_t* data)
+{
+  return reinterpret_cast<PayloadHeader*>(data - sizeof(PayloadHeader));
+}
+}  // namespace
+
+void Value::setPayloadAllocator(PayloadAllocator a) { payloadAllocator = a; }
+
+uint8_t* Value::allocatePayload(size_t bytes)
+{
+  void* p = payloadAllocator.allocate(sizeof(PayloadHeader) + bytes);
+  if (!p) return nullptr;
+  new (p) PayloadHeader{{1}};
+  return static_cast<uint8_t*>(p) + sizeof(PayloadHeader);
+}
+
+void Value::releasePayload()
+{
+  if (isStoredLocally()) return;
+  PayloadHeader* h = getPayloadHeader(dataPtr_);
+  if (h->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+  {
+    h->~PayloadHeader();
+    payloadAllocator.deallocate(h, sizeof(PayloadHeader) + sizeInBytes_);
+  }
+  dataPtr_ = localData_;
+}
+
+bool Value::isShared() const
+{
+  return !isStoredLocally() && (getPayloadHeader(dataPtr_)->refs.load(std::memory_order_acquire) > 1);
+}
+
 // private utilities
 
 void Value::copyOrAllocate(Type newType, const uint8_t* pSrc, size_t bytes)
 {
   type_ = newType;
-  if (bytes == sizeInBytes_)
+  if ((bytes == sizeInBytes_) && !isShared())
   {
     // same as existing size, copy to wherever data is currently stored
     memcpy(dataPtr_, pSrc, bytes);
   }
   else
   {
-    if (dataPtr_ != localData_) free(dataPtr_);
+    releasePayload();
 
     if (bytes <= kLocalDataBytes)
     {
@@ -31,7 +81,7 @@ void Value::copyOrAllocate(Type newType, const uint8_t* pSrc, size_t bytes)
     }
     else
     {
-      dataPtr_ = (uint8_t*)malloc(bytes);
+      dataPtr_ = allocatePayload(bytes);
       if (dataPtr_)
       {
         sizeInBytes_ = static_cast<uint32_t>(bytes);
@@ -50,7 +100,7 @@ void Value::copyOrAllocate(Type newType, const uint8_t* pSrc, size_t bytes)
 void Value::copyOrMove(Type newType, uint8_t* pSrc, size_t bytes)
 {
   type_ = newType;
-  if (!isStoredLocally()) free(dataPtr_);
+  releasePayload();
   if (bytes <= kLocalDataBytes)
   {
     sizeInBytes_ = static_cast<uint32_t>(bytes);
@@ -64,17 +114,31 @@ void Value::copyOrMove(Type newType, uint8_t* pSrc, size_t bytes)
   }
 }
 
-// copy and assign constructors and destructor and movers (rule of five stuff)
-
-Value::Value(const Value& other)
+void Value::copyOrShare(const Value& other)
 {
-  copyOrAllocate(other.type_, other.dataPtr_, other.sizeInBytes_);
+  // Local data is copied. So is heap data if this Value has its own payload of the same size,
+  // which keeps assignment free of allocation.
+  if (other.isStoredLocally() || ((other.sizeInBytes_ == sizeInBytes_) && !isShared()))
+  {
+    copyOrAllocate(other.type_, other.dataPtr_, other.sizeInBytes_);
+    return;
+  }
+
+  getPayloadHeader(other.dataPtr_)->refs.fetch_add(1, std::memory_order_relaxed);
+  releasePayload();
+  type_ = other.type_;
+  dataPtr_ = other.dataPtr_;
+  sizeInBytes_ = other.sizeInBytes_;
 }
 
+// copy and assign constructors and destructor and movers (rule of five stuff)
+
+Value::Value(const Value& other) { copyOrShare(other); }
+
 Value& Value::operator=(const Value& other)
 {
   if (this == &other) return *this;
-  copyOrAllocate(other.type_, other.dataPtr_, other.sizeInBytes_);
+  copyOrShare(other);
   return *this;
 }
 
@@ -101,13 +165,7 @@ Value& Value::operator=(Value&& other) noexcept
   return *this;
 }
 
-Value::~Value()
-{
-  if (!isStoredLocally())
-  {
-    free(dataPtr_);
-  }
-}
+Value::~Value() { releasePayload(); }
 
 // Constructors with fixed-size data.
 
@@ -147,6 +205,12 @@ Value::Value(const std::vector<float>& values)
   copyOrAllocate(kFloatArray, pSrc, values.size() * sizeof(float));
 }
 
+Value::Value(const float* values, size_t n)
+{
+  auto pSrc = reinterpret_cast<const uint8_t*>(values);
+  copyOrAllocate(kFloatArray, pSrc, n * sizeof(float));
+}
+
 Value::Value(const ml::Text& t)
 {
   auto pSrc = reinterpret_cast<const uint8_t*>(t.getText());
@@ -220,9 +284,24 @@ bool Value::getBoolValue() const
 
 // variable-size getters
 
-float* Value::getFloatArrayPtr() const
+const float* Value::getFloatArrayPtr() const
 {
-  return (type_ == kFloatArray) ? reinterpret_cast<float*>(dataPtr_) : nullptr;
+  return (type_ == kFloatArray) ? reinterpret_cast<const float*>(dataPtr_) : nullptr;
+}
+
+float* Value::getFloatArrayPtr()
+{
+  if (type_ != kFloatArray) return nullptr;
+  if (isShared())
+  {
+    // copy on write
+    uint8_t* p = allocatePayload(sizeInBytes_);
+    if (!p) return nullptr;
+    memcpy(p, dataPtr_, sizeInBytes_);
+    releasePayload();
+    dataPtr_ = p;
+  }
+  return reinterpret_cast<float*>(dataPtr_);
 }
 
 size_t Value::getFloatArraySize() const
@@ -321,14 +400,14 @@ Value::Value(unsigned int type, unsigned int sizeInBytes, const uint8_t* dataPtr
   if (sizeInBytes_ <= kLocalDataBytes)
   {
     dataPtr_ = localData_;
-    memcpy(dataPtr_, dataPtr, sizeInBytes_);
+    if (dataPtr) memcpy(dataPtr_, dataPtr, sizeInBytes_);
   }
   else
   {
-    dataPtr_ = (uint8_t*)malloc(sizeInBytes_);
+    dataPtr_ = allocatePayload(sizeInBytes_);
     if (dataPtr_)
     {
-      memcpy(dataPtr_, dataPtr, sizeInBytes_);
+      if (dataPtr) memcpy(dataPtr_, dataPtr, sizeInBytes_);
     }
     else
     {
@@ -18,6 +18,10 @@
 // a certain size, no heap will be allocated. Whether on the stack or the heap, assigning a new
 // value to one of the same size must not reallocate. Together these guarantees make Value useful
 // for creating DSP applications that don't allocate memory when processing signals.
+//
+// Data too big to store locally goes in a heap payload with an atomic reference count. Copying a
+// Value shares its payload, so copies of big float arrays and blobs are O(1). The shared data is
+// immutable: the non-const getFloatArrayPtr() makes a private copy first if the payload is shared.
 
 namespace ml
 {
@@ -65,7 +69,7 @@ class Value
     else
     {
       // allocate heap
-      dataPtr_ = (uint8_t*)malloc(sizeInBytes_);
+      dataPtr_ = allocatePayload(sizeInBytes_);
       if (dataPtr_)
       {
         memcpy(dataPtr_, values.data(), sizeInBytes_);
@@ -82,6 +86,7 @@ class Value
   // Constructors with variable-size data.
   Value(std::initializer_list<float> values);
   Value(const std::vector<float>& values);
+  explicit Value(const float* values, size_t n);
   Value(const ml::Text& v);
   Value(const char* v);
   explicit Value(const uint8_t* data, size_t size);
@@ -106,8 +111,10 @@ class Value
     return r;
   }
 
-  // Getters for variable-size data.
-  float* getFloatArrayPtr() const;
+  // Getters for variable-size data. If the data is shared with other Values, the non-const
+  // getFloatArrayPtr() first makes a copy that the caller can modify.
+  const float* getFloatArrayPtr() const;
+  float* getFloatArrayPtr();
   size_t getFloatArraySize() const;
   std::vector<float> getFloatVector() const;
   ml::TextFragment getTextValue() const;
@@ -128,6 +135,18 @@ class Value
   static constexpr size_t kMaxDataBytes = 1 << (kMaxDataSizeBits - 1);
   static constexpr size_t getLocalDataMaxBytes() { return kLocalDataBytes; }
 
+  // true if the data is in a heap payload that other Values are using too.
+  bool isShared() const;
+
+  // Heap payloads are allocated with these functions, which default to malloc and free. To use a
+  // pool, set them once at startup, before any Values are made.
+  struct PayloadAllocator
+  {
+    void* (*allocate)(size_t bytes);
+    void (*deallocate)(void* p, size_t bytes);
+  };
+  static void setPayloadAllocator(PayloadAllocator a);
+
   // we set the size of the Value object here. Whatever bytes are not needed for the
   // pointer, type and size are used for local storage.
   static constexpr size_t kStructSizeInBytes{64};
@@ -146,6 +165,11 @@ class Value
   // private utilities
   void copyOrAllocate(Type type, const uint8_t* pSrc, size_t bytes);
   void copyOrMove(Type newType, uint8_t* pSrc, size_t bytes);
+  void copyOrShare(const Value& other);
+
+  // heap payloads: the data follows a header with the reference count.
+  static uint8_t* allocatePayload(size_t bytes);
+  void releasePayload();
 
   template <typename T>
   T toFixedSizeType() const
@@ -154,11 +178,14 @@ class Value
     return *scalarTypePtr;
   }
 
-  // private constructor for deserialization
+  // private constructor for deserialization. If dataPtr is null, the data is
+  // allocated but not initialized.
   Value(unsigned int type, unsigned int sizeInBytes, const uint8_t* dataPtr);
 
-  // friend in MLSerialization
+  // friends in MLSerialization
   friend Value readBinaryToValue(const uint8_t*& readPtr);
+  friend struct ValueStreamAccess;
+  friend struct CompactMessage;
 };
 
 static_assert(sizeof(Value) == Value::kStructSizeInBytes);
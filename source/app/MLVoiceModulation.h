@@ -0,0 +1,161 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// VoiceModulation: per-voice offsets on parameter values, as from CLAP
+// polyphonic modulation, for reading on the audio thread.
+//
+// Offsets are normalized, and stored with the real values they make in
+// [parameter × voice] arrays, so the values for one parameter are contiguous.
+// Only parameters with nonzero offsets are tracked. Setting an offset marks
+// its parameter, and update() converts the marked parameters with the
+// compiled projections of the ParameterTree, by ID. Parameters whose base
+// value has changed are converted again. The tree itself is never searched.
+//
+// Everything but resize() is real-time safe. All calls must come from one
+// thread, normally the audio thread.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "MLDSPOps.h"
+#include "MLParameters.h"
+
+namespace ml
+{
+class VoiceModulation final
+{
+ public:
+  VoiceModulation() = default;
+
+  // not real-time safe. Clears all offsets.
+  void resize(size_t nParams, size_t nVoices)
+  {
+    nParams_ = nParams;
+    nVoices_ = nVoices;
+    offsets_.assign(nParams * nVoices, 0.f);
+    realValues_.assign(nParams * nVoices, 0.f);
+    baseValues_.assign(nParams, 0.f);
+    state_.assign(nParams, kIdle);
+    modulated_.clear();
+    modulated_.reserve(nParams);
+  }
+
+  size_t getNumParams() const { return nParams_; }
+  size_t getNumVoices() const { return nVoices_; }
+
+  void setOffset(size_t id, size_t voice, float normalizedOffset)
+  {
+    if ((id >= nParams_) || (voice >= nVoices_)) return;
+    offsets_[id * nVoices_ + voice] = normalizedOffset;
+    markParam(id);
+  }
+
+  void setOffsetForAllVoices(size_t id, float normalizedOffset)
+  {
+    if (id >= nParams_) return;
+    std::fill_n(offsets_.begin() + id * nVoices_, nVoices_, normalizedOffset);
+    markParam(id);
+  }
+
+  float getOffset(size_t id, size_t voice) const { return offsets_[id * nVoices_ + voice]; }
+
+  // clear the offsets of one voice, as when it starts a new note.
+  void clearVoice(size_t voice)
+  {
+    if (voice >= nVoices_) return;
+    for (uint32_t id : modulated_)
+    {
+      offsets_[id * nVoices_ + voice] = 0.f;
+      state_[id] = kDirty;
+    }
+  }
+
+  // Recalculate the real values of the modulated parameters that are marked,
+  // or whose base values have changed. baseRealValues holds the real value of
+  // each parameter by ID, as from ParameterStore::getValues().
+  void update(const ParameterTree& params, const float* baseRealValues)
+  {
+    size_t n = 0;
+    for (uint32_t id : modulated_)
+    {
+      const float base = baseRealValues[id];
+      if ((state_[id] == kDirty) || (base != baseValues_[id]))
+      {
+        baseValues_[id] = base;
+        if (!updateParam(params, id))
+        {
+          // no voice has an offset, so the parameter is no longer tracked.
+          state_[id] = kIdle;
+          continue;
+        }
+        state_[id] = kModulated;
+      }
+      modulated_[n++] = id;
+    }
+    modulated_.resize(n);
+  }
+
+  bool isModulated(size_t id) const { return (id < nParams_) && (state_[id] != kIdle); }
+
+  // the modulated real value of a parameter for a voice, as of the last
+  // update(), or the base value if the parameter is not modulated.
+  float getModulatedValue(size_t id, size_t voice, const float* baseRealValues) const
+  {
+    return isModulated(id) ? realValues_[id * nVoices_ + voice] : baseRealValues[id];
+  }
+
+  // the real values of one parameter for all voices, valid when isModulated(id).
+  const float* getRealValues(size_t id) const { return realValues_.data() + id * nVoices_; }
+
+ private:
+  enum State : uint8_t
+  {
+    kIdle,
+    kModulated,
+    kDirty
+  };
+
+  void markParam(size_t id)
+  {
+    if (state_[id] == kIdle)
+    {
+      modulated_.push_back(static_cast<uint32_t>(id));
+    }
+    state_[id] = kDirty;
+  }
+
+  // convert one parameter for all voices. Returns false if no voice has an offset.
+  bool updateParam(const ParameterTree& params, size_t id)
+  {
+    const float baseNorm = params.convertRealToNormalizedFloatValue(id, baseValues_[id]);
+    const float* offsets = offsets_.data() + id * nVoices_;
+    float* reals = realValues_.data() + id * nVoices_;
+    bool anyOffset{false};
+    for (size_t v = 0; v < nVoices_; ++v)
+    {
+      float norm = clamp(baseNorm + offsets[v], 0.f, 1.f);
+      reals[v] = params.convertNormalizedToRealFloatValue(id, norm);
+      anyOffset |= (offsets[v] != 0.f);
+    }
+    return anyOffset;
+  }
+
+  size_t nParams_{0};
+  size_t nVoices_{0};
+  std::vector<float> offsets_;
+  std::vector<float> realValues_;
+
+  // base real values at the last update, by parameter.
+  std::vector<float> baseValues_;
+  std::vector<State> state_;
+
+  // IDs of the parameters that are not idle, in the order they were marked.
+  std::vector<uint32_t> modulated_;
+};
+
+}  // namespace ml
@@ -0,0 +1,102 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLWavFile.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace ml
+{
+namespace
+{
+uint32_t getLE(const uint8_t* p, int bytes)
+{
+  uint32_t x{0};
+  for (int i = bytes - 1; i >= 0; --i)
+  {
+    x = (x << 8) | p[i];
+  }
+  return x;
+}
+
+// read one sample of a WAV file's data.
+float getSample(const uint8_t* p, uint16_t format, int bits)
+{
+  if (format == WavFileInfo::kFormatFloat)
+  {
+    uint32_t x = getLE(p, 4);
+    float f;
+    memcpy(&f, &x, 4);
+    return f;
+  }
+
+  // sign extend PCM samples from their top bit.
+  uint32_t x = getLE(p, bits / 8) << (32 - bits);
+  return float(int32_t(x)) / 2147483648.f;
+}
+}  // namespace
+
+bool parseWavFile(const uint8_t* bytes, size_t size, WavFileInfo& info)
+{
+  constexpr size_t kRiffHeaderSize{12};
+  if (!bytes || (size < kRiffHeaderSize) || memcmp(bytes, "RIFF", 4) ||
+      memcmp(bytes + 8, "WAVE", 4))
+  {
+    return false;
+  }
+
+  // find the format and data chunks.
+  WavFileInfo r;
+  size_t dataBytes{0};
+  for (size_t pos = kRiffHeaderSize; pos + 8 <= size;)
+  {
+    const uint8_t* chunk = bytes + pos;
+    size_t chunkSize = std::min(size_t(getLE(chunk + 4, 4)), size - pos - 8);
+    if (!memcmp(chunk, "fmt ", 4) && (chunkSize >= 16))
+    {
+      r.format = uint16_t(getLE(chunk + 8, 2));
+      r.channels = int(getLE(chunk + 10, 2));
+      r.sampleRate = int(getLE(chunk + 12, 4));
+      r.bits = int(getLE(chunk + 22, 2));
+
+      // the sub format of an extensible file starts with the plain format code.
+      if ((r.format == WavFileInfo::kFormatExtensible) && (chunkSize >= 26))
+      {
+        r.format = uint16_t(getLE(chunk + 32, 2));
+      }
+    }
+    else if (!memcmp(chunk, "data", 4))
+    {
+      r.data = chunk + 8;
+      dataBytes = chunkSize;
+    }
+
+    // chunks are padded to an even size.
+    pos += 8 + chunkSize + (chunkSize & 1);
+  }
+
+  bool formatOK =
+      ((r.format == WavFileInfo::kFormatPCM) && ((r.bits == 16) || (r.bits == 24) ||
+                                                 (r.bits == 32))) ||
+      ((r.format == WavFileInfo::kFormatFloat) && (r.bits == 32));
+  if (!r.data || !formatOK || (r.channels < 1)) return false;
+
+  r.frames = dataBytes / r.getFrameBytes();
+  info = r;
+  return true;
+}
+
+void readWavFrames(const WavFileInfo& info, size_t start, size_t frames, float* pDest)
+{
+  const size_t sampleBytes = info.bits / 8;
+  const uint8_t* p = info.data + start * info.getFrameBytes();
+  const size_t n = frames * info.channels;
+  for (size_t i = 0; i < n; ++i)
+  {
+    pDest[i] = getSample(p + i * sampleBytes, info.format, info.bits);
+  }
+}
+
+}  // namespace ml
@@ -0,0 +1,40 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// Reading WAV files that are already in memory, whether loaded or mapped. PCM 16, 24 and 32
+// bit and float 32 bit files can be read.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ml
+{
+struct WavFileInfo
+{
+  static constexpr uint16_t kFormatPCM{1};
+  static constexpr uint16_t kFormatFloat{3};
+  static constexpr uint16_t kFormatExtensible{0xFFFE};
+
+  uint16_t format{0};
+  int channels{0};
+  int bits{0};
+  int sampleRate{0};
+
+  // the interleaved sample data within the file.
+  const uint8_t* data{nullptr};
+  size_t frames{0};
+
+  size_t getFrameBytes() const { return size_t(channels) * size_t(bits / 8); }
+};
+
+// find the format and sample data of the WAV file in bytes[0, size). Returns false if the file
+// is not one that can be read.
+bool parseWavFile(const uint8_t* bytes, size_t size, WavFileInfo& info);
+
+// convert frames [start, start + frames) of a parsed file to interleaved floats.
+void readWavFrames(const WavFileInfo& info, size_t start, size_t frames, float* pDest);
+
+}  // namespace ml
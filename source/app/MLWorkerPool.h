@@ -0,0 +1,218 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// WorkerPool: a fixed set of worker threads for running many small tasks in
+// parallel from the audio thread.
+//
+// run() publishes a job of nTasks tasks, then the calling thread and the
+// workers claim tasks from a shared counter until all are done. Nothing is
+// allocated or locked after construction. If the workers are slow to wake up,
+// the calling thread simply does more of the tasks itself.
+//
+// Idle workers spin for a short time, then yield, then sleep on a condition
+// variable with a short timeout, so that a pool that is not being used
+// doesn't keep a core busy.
+//
+// Workers flush denormals to zero, like the audio thread that runs them.
+//
+// HostTaskPool describes a pool of threads that someone else owns, such as a
+// plugin host. Users of WorkerPool can send their jobs to it instead, and use
+// their own WorkerPool, if any, when it is missing or refuses a job.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "MLDSPDenormals.h"
+#include "MLPlatform.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+
+namespace ml
+{
+// hint to the processor that we are in a spin loop.
+inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+  _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+class WorkerPool final
+{
+ public:
+  using TaskFn = void (*)(void* context, size_t task);
+  using Clock = std::chrono::steady_clock;
+
+  // called first on each worker thread with its index, to set its priority or affinity.
+  using ThreadSetupFn = void (*)(void* context, size_t worker);
+
+  explicit WorkerPool(size_t nWorkers, ThreadSetupFn setup = nullptr, void* setupContext = nullptr)
+  {
+    threads_.reserve(nWorkers);
+    for (size_t i = 0; i < nWorkers; ++i)
+    {
+      threads_.emplace_back([this, i, setup, setupContext]() {
+        if (kFlushDenormalsAutomatically) setCurrentThreadFlushDenormalsToZero();
+        if (setup) setup(setupContext, i);
+        workerLoop();
+      });
+    }
+  }
+
+  ~WorkerPool()
+  {
+    quit_.store(true, std::memory_order_release);
+    wakeCondition_.notify_all();
+    for (auto& t : threads_)
+    {
+      t.join();
+    }
+  }
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  size_t getNumWorkers() const { return threads_.size(); }
+
+  // Run fn(context, i) for each i in [0, nTasks) and return when all tasks are
+  // done. Returns false if the tasks finished after the deadline. Only one
+  // thread at a time may call run().
+  bool run(size_t nTasks, TaskFn fn, void* context,
+           Clock::time_point deadline = Clock::time_point::max())
+  {
+    if (nTasks == 0) return true;
+
+    fn_ = fn;
+    context_ = context;
+    nTasks_.store(nTasks, std::memory_order_relaxed);
+    completed_.store(0, std::memory_order_relaxed);
+
+    // publishing the new generation hands the job to the workers.
+    generation_ = (generation_ + 1) & 0xFFFFFFFF;
+    if (generation_ == 0) generation_ = 1;
+    uint64_t generation = generation_;
+    claim_.store(generation << 32, std::memory_order_release);
+    if (sleepers_.load(std::memory_order_relaxed) > 0)
+    {
+      wakeCondition_.notify_all();
+    }
+
+    doTasks(generation);
+
+    // wait for tasks the workers have claimed.
+    while (completed_.load(std::memory_order_acquire) < nTasks)
+    {
+      cpuRelax();
+    }
+    return Clock::now() <= deadline;
+  }
+
+ private:
+  static constexpr int kSpinsBeforeYield{2000};
+  static constexpr int kSpinsBeforeSleep{20000};
+  static constexpr std::chrono::milliseconds kSleepTimeout{1};
+
+  // claim and run tasks until there are none left in this generation.
+  void doTasks(uint64_t generation)
+  {
+    uint64_t c = claim_.load(std::memory_order_acquire);
+    for (;;)
+    {
+      if ((c >> 32) != generation) return;
+      uint64_t task = c & 0xFFFFFFFF;
+      if (task >= nTasks_.load(std::memory_order_relaxed)) return;
+      if (claim_.compare_exchange_weak(c, c + 1, std::memory_order_acq_rel))
+      {
+        fn_(context_, static_cast<size_t>(task));
+        completed_.fetch_add(1, std::memory_order_release);
+        c = claim_.load(std::memory_order_acquire);
+      }
+    }
+  }
+
+  void workerLoop()
+  {
+    uint64_t seen{0};
+    int idleSpins{0};
+    while (!quit_.load(std::memory_order_acquire))
+    {
+      uint64_t generation = claim_.load(std::memory_order_acquire) >> 32;
+      if (generation != seen)
+      {
+        seen = generation;
+        doTasks(generation);
+        idleSpins = 0;
+      }
+      else if (++idleSpins < kSpinsBeforeYield)
+      {
+        cpuRelax();
+      }
+      else if (idleSpins < kSpinsBeforeSleep)
+      {
+        std::this_thread::yield();
+      }
+      else
+      {
+        // the audio thread notifies without locking, so a wakeup may be missed
+        // and we rely on the timeout. The caller does the tasks in the meantime.
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        sleepers_.fetch_add(1, std::memory_order_relaxed);
+        wakeCondition_.wait_for(lock, kSleepTimeout, [&]() {
+          return quit_.load(std::memory_order_acquire) ||
+                 ((claim_.load(std::memory_order_acquire) >> 32) != seen);
+        });
+        sleepers_.fetch_sub(1, std::memory_order_relaxed);
+        idleSpins = 0;
+      }
+    }
+  }
+
+  std::vector<std::thread> threads_;
+
+  // current job. fn_ and context_ are only read by a thread that has claimed
+  // a task, during which run() can't return and change them.
+  TaskFn fn_{nullptr};
+  void* context_{nullptr};
+  std::atomic<size_t> nTasks_{0};
+  std::atomic<size_t> completed_{0};
+
+  // generation in the high 32 bits, next task to claim in the low 32 bits.
+  std::atomic<uint64_t> claim_{0};
+  uint64_t generation_{0};
+
+  std::atomic<bool> quit_{false};
+  std::atomic<int> sleepers_{0};
+  std::mutex sleepMutex_;
+  std::condition_variable wakeCondition_;
+};
+
+// A job runner borrowed from a host. run() calls fn(taskContext, i) for each i
+// in [0, nTasks) on the host's threads and returns when all are done. It
+// returns false if the host refused the job, in which case no tasks were run.
+struct HostTaskPool
+{
+  using RunFn = bool (*)(void* poolContext, size_t nTasks, WorkerPool::TaskFn fn,
+                         void* taskContext);
+
+  RunFn run{nullptr};
+  void* context{nullptr};
+
+  // the number of threads that may run tasks at once.
+  size_t numThreads{0};
+
+  explicit operator bool() const { return run != nullptr; }
+};
+
+}  // namespace ml
@@ -0,0 +1,527 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLAudioStream.h"
+
+#if !ML_WINDOWS
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace ml
+{
+namespace
+{
+constexpr uint8_t kMagic[4]{'m', 'l', 'a', 's'};
+
+// how long the receive thread waits for a packet before checking if it should stop.
+constexpr int kReceiveTimeoutMicroseconds{100000};
+
+// the gain at the end of each concealed vector, relative to the one before.
+constexpr float kConcealFade{0.5f};
+
+// how many vectors the receiver reads between checks for a buffer fuller than it needs to be.
+constexpr size_t kDepthCheckVectors{1024};
+
+void putInt32(uint8_t*& p, uint32_t x)
+{
+  *p++ = uint8_t(x >> 24);
+  *p++ = uint8_t(x >> 16);
+  *p++ = uint8_t(x >> 8);
+  *p++ = uint8_t(x);
+}
+
+uint32_t getInt32(const uint8_t* p)
+{
+  return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+// the current time on this machine's clock, for the send times in packet headers.
+Time getSendTime() { return doubleToTime(TickClock::ticksToSeconds(TickClock::now())); }
+
+// fill dest with src faded from gain to gain * kConcealFade, and return the end gain.
+float fadeVector(const float* src, float gain, float* dest)
+{
+  const float step = gain * (kConcealFade - 1.f) / kFloatsPerDSPVector;
+  for (size_t i = 0; i < kFloatsPerDSPVector; ++i)
+  {
+    dest[i] = src[i] * (gain + step * i);
+  }
+  return gain * kConcealFade;
+}
+}  // namespace
+
+size_t encodeAudioPacket(const AudioPacketHeader& h, const float* const* src, uint8_t* dest)
+{
+  uint8_t* p = dest;
+  memcpy(p, kMagic, 4);
+  p += 4;
+  putInt32(p, h.sequence);
+  putInt32(p, uint32_t(h.sendTime >> 32));
+  putInt32(p, uint32_t(h.sendTime));
+  *p++ = h.streamChannels;
+  *p++ = h.firstChannel;
+  *p++ = h.packetChannels;
+  *p++ = AudioPacketHeader::kVersion;
+
+  for (size_t c = 0; c < h.packetChannels; ++c)
+  {
+    for (size_t i = 0; i < kFloatsPerDSPVector; ++i)
+    {
+      uint32_t x;
+      memcpy(&x, &src[c][i], 4);
+      putInt32(p, x);
+    }
+  }
+  return p - dest;
+}
+
+bool decodeAudioPacketHeader(const uint8_t* packet, size_t bytes, AudioPacketHeader& h)
+{
+  if (bytes < AudioPacketHeader::kSize) return false;
+  if (memcmp(packet, kMagic, 4) != 0) return false;
+  if (packet[19] != AudioPacketHeader::kVersion) return false;
+
+  h.sequence = getInt32(packet + 4);
+  h.sendTime = (Time(getInt32(packet + 8)) << 32) | getInt32(packet + 12);
+  h.streamChannels = packet[16];
+  h.firstChannel = packet[17];
+  h.packetChannels = packet[18];
+  return bytes >= AudioPacketHeader::kSize + h.packetChannels * kFloatsPerDSPVector * 4;
+}
+
+void decodeAudioPacketChannel(const uint8_t* packet, size_t c, float* dest)
+{
+  const uint8_t* p = packet + AudioPacketHeader::kSize + c * kFloatsPerDSPVector * 4;
+  for (size_t i = 0; i < kFloatsPerDSPVector; ++i)
+  {
+    uint32_t x = getInt32(p + i * 4);
+    memcpy(&dest[i], &x, 4);
+  }
+}
+
+// AudioStreamSender
+
+AudioStreamSender::~AudioStreamSender() { stop(); }
+
+bool AudioStreamSender::start(const char* hostAddress, int port, size_t channels,
+                              size_t bufferVectors)
+{
+  stop();
+
+  // the header has one byte for each channel count.
+  if ((channels == 0) || (channels > 255)) return false;
+
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(port));
+  if (inet_pton(AF_INET, hostAddress, &addr.sin_addr) != 1) return false;
+
+  socket_ = ::socket(AF_INET, SOCK_DGRAM, 0);
+  if (socket_ < 0) return false;
+  if (::connect(socket_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0)
+  {
+    stop();
+    return false;
+  }
+
+  channels_ = channels;
+  buffer_.resize(channels, int(std::max(bufferVectors, size_t(2)) * kFloatsPerDSPVector));
+  frames_.resize(channels * kFloatsPerDSPVector);
+  channelPtrs_.resize(channels);
+  readPtrs_.resize(channels);
+  for (size_t c = 0; c < channels; ++c)
+  {
+    readPtrs_[c] = frames_.data() + c * kFloatsPerDSPVector;
+  }
+  packet_.resize(kAudioPacketMaxBytes);
+
+  getSendTime();  // calibrate the clock before the first packet.
+  running_ = true;
+  thread_ = std::thread([this]() { run(); });
+  return true;
+}
+
+void AudioStreamSender::stop()
+{
+  if (running_.exchange(false))
+  {
+    {
+      std::lock_guard<std::mutex> lock(wakeMutex_);
+      wakeCondition_.notify_one();
+    }
+    thread_.join();
+  }
+  if (socket_ >= 0)
+  {
+    ::close(socket_);
+    socket_ = -1;
+  }
+}
+
+void AudioStreamSender::write(const DSPVectorDynamic& vectors)
+{
+  if (!running_.load(std::memory_order_relaxed)) return;
+  if (buffer_.getWriteAvailable() < kFloatsPerDSPVector)
+  {
+    overruns_++;
+  }
+  buffer_.write(vectors);
+
+  // wake the network thread if it is sleeping. Either it sees the new vector before sleeping
+  // or we see that it is sleeping, because of the fences.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (sleeping_.load(std::memory_order_relaxed))
+  {
+    std::lock_guard<std::mutex> lock(wakeMutex_);
+    wakeCondition_.notify_one();
+  }
+}
+
+void AudioStreamSender::run()
+{
+  while (running_.load(std::memory_order_relaxed))
+  {
+    while (buffer_.getReadAvailable() >= kFloatsPerDSPVector)
+    {
+      sendVector();
+    }
+
+    std::unique_lock<std::mutex> lock(wakeMutex_);
+    sleeping_.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if ((buffer_.getReadAvailable() < kFloatsPerDSPVector) &&
+        running_.load(std::memory_order_relaxed))
+    {
+      wakeCondition_.wait(lock);
+    }
+    sleeping_.store(false, std::memory_order_relaxed);
+  }
+}
+
+void AudioStreamSender::sendVector()
+{
+  buffer_.readPlanar(readPtrs_.data(), kFloatsPerDSPVector);
+
+  AudioPacketHeader h;
+  h.sequence = sequence_++;
+  h.sendTime = getSendTime();
+  h.streamChannels = uint8_t(channels_);
+  for (size_t first = 0; first < channels_; first += kAudioPacketMaxChannels)
+  {
+    h.firstChannel = uint8_t(first);
+    h.packetChannels = uint8_t(std::min(channels_ - first, kAudioPacketMaxChannels));
+    for (size_t c = 0; c < h.packetChannels; ++c)
+    {
+      channelPtrs_[c] = readPtrs_[first + c];
+    }
+    size_t bytes = encodeAudioPacket(h, channelPtrs_.data(), packet_.data());
+    if (::send(socket_, packet_.data(), bytes, 0) >= 0)
+    {
+      packetsSent_++;
+    }
+  }
+}
+
+// AudioStreamReceiver
+
+AudioStreamReceiver::~AudioStreamReceiver() { stop(); }
+
+void AudioStreamReceiver::setTargetVectors(size_t minVectors, size_t maxVectors)
+{
+  minVectors_ = std::max(minVectors, size_t(1));
+  maxVectors_ = std::max(maxVectors, minVectors_);
+  targetVectors_ = minVectors_;
+}
+
+bool AudioStreamReceiver::start(int port, size_t channels)
+{
+  stop();
+  if ((channels == 0) || (channels > 255)) return false;
+
+  socket_ = ::socket(AF_INET, SOCK_DGRAM, 0);
+  if (socket_ < 0) return false;
+
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(port));
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  timeval timeout{0, kReceiveTimeoutMicroseconds};
+  if ((::bind(socket_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) ||
+      (::setsockopt(socket_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) != 0))
+  {
+    stop();
+    return false;
+  }
+
+  // the jitter buffer has room for the most vectors the target allows, the reorder window
+  // and some more while a dropped vector is waiting to be read.
+  channels_ = channels;
+  buffer_.resize(channels, int((maxVectors_ + reorderVectors_ + 2) * kFloatsPerDSPVector));
+
+  window_.resize(reorderVectors_);
+  for (auto& s : window_)
+  {
+    s.used = false;
+    s.hasChannel.assign(channels, false);
+    s.frames.assign(channels * kFloatsPerDSPVector, 0.f);
+  }
+  slotPtrs_.resize(channels);
+  lastFrames_.assign(channels * kFloatsPerDSPVector, 0.f);
+  concealFrames_.assign(channels * kFloatsPerDSPVector, 0.f);
+  concealGains_.assign(channels, 1.f);
+  started_ = false;
+  lastArrival_ = 0;
+
+  targetVectors_ = std::clamp(targetVectors_.load(), minVectors_, maxVectors_);
+  filling_ = true;
+  minBufferedSinceCheck_ = SIZE_MAX;
+  readsSinceCheck_ = 0;
+  lastOutput_ = DSPVectorDynamic(channels);
+  dropped_ = DSPVectorDynamic(channels);
+  outputConcealGain_ = 1.f;
+
+  getSendTime();  // calibrate the clock before the first packet.
+  running_ = true;
+  thread_ = std::thread([this]() { run(); });
+  return true;
+}
+
+void AudioStreamReceiver::stop()
+{
+  if (running_.exchange(false))
+  {
+    thread_.join();
+  }
+  if (socket_ >= 0)
+  {
+    ::close(socket_);
+    socket_ = -1;
+  }
+}
+
+void AudioStreamReceiver::run()
+{
+  std::vector<uint8_t> packet(kAudioPacketMaxBytes);
+  while (running_.load(std::memory_order_relaxed))
+  {
+    ssize_t bytes = ::recv(socket_, packet.data(), packet.size(), 0);
+    if (bytes > 0)
+    {
+      receivePacket(packet.data(), size_t(bytes));
+    }
+  }
+}
+
+void AudioStreamReceiver::receivePacket(const uint8_t* packet, size_t bytes)
+{
+  AudioPacketHeader h;
+  if (!decodeAudioPacketHeader(packet, bytes, h)) return;
+  packetsReceived_++;
+  updateJitter(h.sendTime);
+
+  // a packet too far from the expected sequence means the sender has restarted.
+  int32_t ahead = int32_t(h.sequence - nextSequence_);
+  if (!started_ || (ahead < -int32_t(maxVectors_ + reorderVectors_)) ||
+      (ahead >= int32_t(maxVectors_ + reorderVectors_)))
+  {
+    resync(h.sequence);
+    ahead = 0;
+  }
+  else if (ahead < 0)
+  {
+    latePackets_++;
+    return;
+  }
+  streamChannels_ = std::min(size_t(h.streamChannels), channels_);
+
+  // move the window up to the new packet, giving up on anything still missing behind it.
+  while (int32_t(h.sequence - nextSequence_) >= int32_t(reorderVectors_))
+  {
+    pushNextSequence();
+  }
+
+  Slot& s = window_[h.sequence % reorderVectors_];
+  if (!s.used || (s.sequence != h.sequence))
+  {
+    s.used = true;
+    s.sequence = h.sequence;
+    s.channelsReceived = 0;
+    std::fill(s.hasChannel.begin(), s.hasChannel.end(), false);
+  }
+  for (size_t c = 0; c < h.packetChannels; ++c)
+  {
+    size_t ch = h.firstChannel + c;
+    if ((ch < channels_) && !s.hasChannel[ch])
+    {
+      decodeAudioPacketChannel(packet, c, s.frames.data() + ch * kFloatsPerDSPVector);
+      s.hasChannel[ch] = true;
+      s.channelsReceived++;
+    }
+  }
+
+  // write every complete vector at the front of the window.
+  for (;;)
+  {
+    const Slot& next = window_[nextSequence_ % reorderVectors_];
+    if (!next.used || (next.sequence != nextSequence_) || (next.channelsReceived < streamChannels_))
+      break;
+    pushNextSequence();
+  }
+}
+
+void AudioStreamReceiver::updateJitter(Time sendTime)
+{
+  uint64_t arrival = TickClock::now();
+  if (lastArrival_)
+  {
+    double transitChange = TickClock::secondsBetween(lastArrival_, arrival) -
+                           (timeToDouble(sendTime) - timeToDouble(lastSendTime_));
+    double j = jitter_.load(std::memory_order_relaxed);
+    jitter_.store(j + (std::fabs(transitChange) - j) / 16., std::memory_order_relaxed);
+  }
+  lastArrival_ = arrival;
+  lastSendTime_ = sendTime;
+}
+
+void AudioStreamReceiver::resync(uint32_t sequence)
+{
+  for (auto& s : window_)
+  {
+    s.used = false;
+  }
+  nextSequence_ = sequence;
+  started_ = true;
+}
+
+void AudioStreamReceiver::pushNextSequence()
+{
+  Slot& s = window_[nextSequence_ % reorderVectors_];
+  const bool present = s.used && (s.sequence == nextSequence_);
+  if (!present)
+  {
+    lostVectors_++;
+  }
+
+  for (size_t c = 0; c < channels_; ++c)
+  {
+    const size_t offset = c * kFloatsPerDSPVector;
+    if (present && s.hasChannel[c])
+    {
+      std::copy(s.frames.data() + offset, s.frames.data() + offset + kFloatsPerDSPVector,
+                lastFrames_.data() + offset);
+      concealGains_[c] = 1.f;
+      slotPtrs_[c] = s.frames.data() + offset;
+    }
+    else
+    {
+      concealGains_[c] =
+          fadeVector(lastFrames_.data() + offset, concealGains_[c], concealFrames_.data() + offset);
+      slotPtrs_[c] = concealFrames_.data() + offset;
+    }
+  }
+  buffer_.writePlanar(slotPtrs_.data(), kFloatsPerDSPVector);
+
+  s.used = false;
+  nextSequence_++;
+}
+
+bool AudioStreamReceiver::read(DSPVectorDynamic& vectors)
+{
+  for (size_t c = channels_; c < vectors.size(); ++c)
+  {
+    vectors[c] = DSPVector();
+  }
+  if (!channels_)
+  {
+    return false;
+  }
+
+  const size_t available = getBufferedVectors();
+  const size_t target = targetVectors_.load(std::memory_order_relaxed);
+  if (filling_)
+  {
+    if (available < target)
+    {
+      concealOutput(vectors);
+      return false;
+    }
+    filling_ = false;
+  }
+  else if (available == 0)
+  {
+    // underrun: wait for a deeper buffer to fill.
+    underruns_++;
+    targetVectors_.store(std::min(target + 1, maxVectors_), std::memory_order_relaxed);
+    filling_ = true;
+    concealOutput(vectors);
+    return false;
+  }
+
+  // if the buffer has had a spare vector in it for a whole check interval, the latency can be
+  // lower.
+  minBufferedSinceCheck_ = std::min(minBufferedSinceCheck_, available);
+  if (++readsSinceCheck_ >= kDepthCheckVectors)
+  {
+    if ((minBufferedSinceCheck_ > 1) && (available > 1))
+    {
+      dropVector(vectors);
+      targetVectors_.store(std::max(target - 1, minVectors_), std::memory_order_relaxed);
+    }
+    else
+    {
+      buffer_.read(vectors);
+    }
+    minBufferedSinceCheck_ = SIZE_MAX;
+    readsSinceCheck_ = 0;
+  }
+  else
+  {
+    buffer_.read(vectors);
+  }
+
+  const size_t n = std::min(vectors.size(), channels_);
+  for (size_t c = 0; c < n; ++c)
+  {
+    lastOutput_[c] = vectors[c];
+  }
+  outputConcealGain_ = 1.f;
+  return true;
+}
+
+void AudioStreamReceiver::concealOutput(DSPVectorDynamic& vectors)
+{
+  const float gain = outputConcealGain_;
+  const DSPVector fade = rangeOpen(gain, gain * kConcealFade);
+  const size_t n = std::min(vectors.size(), channels_);
+  for (size_t c = 0; c < n; ++c)
+  {
+    vectors[c] = lastOutput_[c] * fade;
+  }
+  outputConcealGain_ = gain * kConcealFade;
+}
+
+void AudioStreamReceiver::dropVector(DSPVectorDynamic& vectors)
+{
+  // read the next two vectors and crossfade from the first to the second.
+  const DSPVector fadeIn = rangeOpen(0.f, 1.f);
+  buffer_.read(dropped_);
+  buffer_.read(vectors);
+  const size_t n = std::min(vectors.size(), channels_);
+  for (size_t c = 0; c < n; ++c)
+  {
+    vectors[c] = lerp(dropped_[c], vectors[c], fadeIn);
+  }
+}
+
+}  // namespace ml
+
+#endif  // !ML_WINDOWS
@@ -0,0 +1,278 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLOSCBundleSender.h"
+
+#if !ML_WINDOWS
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace ml
+{
+namespace
+{
+// writes big-endian OSC data into a fixed buffer, noting if it runs out of room.
+struct OSCWriter
+{
+  uint8_t* start;
+  uint8_t* p;
+  uint8_t* end;
+  bool ok{true};
+
+  size_t size() const { return p - start; }
+
+  void putBytes(const void* src, size_t n)
+  {
+    if (!ok || (n > size_t(end - p)))
+    {
+      ok = false;
+      return;
+    }
+    memcpy(p, src, n);
+    p += n;
+  }
+
+  void putChar(char c) { putBytes(&c, 1); }
+
+  void putInt32(uint32_t x)
+  {
+    uint8_t b[4]{uint8_t(x >> 24), uint8_t(x >> 16), uint8_t(x >> 8), uint8_t(x)};
+    putBytes(b, 4);
+  }
+
+  void putFloat(float f)
+  {
+    uint32_t x;
+    memcpy(&x, &f, 4);
+    putInt32(x);
+  }
+
+  // pad with zeros to a multiple of four bytes.
+  void pad()
+  {
+    static const uint8_t zeros[4]{};
+    putBytes(zeros, (4 - (size() & 3)) & 3);
+  }
+
+  // strings are terminated by at least one zero, then padded.
+  void endString()
+  {
+    putChar(0);
+    pad();
+  }
+};
+}  // namespace
+
+size_t encodeOSCMessage(const Message& m, uint8_t* dest, size_t capacity)
+{
+  OSCWriter w{dest, dest, dest + capacity};
+
+  // address
+  if (!m.address)
+  {
+    w.putChar('/');
+  }
+  for (Symbol elem : m.address)
+  {
+    const TextFragment& text = elem.getTextFragment();
+    w.putChar('/');
+    w.putBytes(text.getText(), text.lengthInBytes());
+  }
+  w.endString();
+
+  // type tags
+  const Value& v = m.value;
+  const size_t arraySize = (v.getType() == Value::kFloatArray) ? v.getFloatArraySize() : 0;
+  w.putChar(',');
+  switch (v.getType())
+  {
+    case Value::kFloat:
+      w.putChar('f');
+      break;
+    case Value::kInt:
+      w.putChar('i');
+      break;
+    case Value::kText:
+      w.putChar('s');
+      break;
+    case Value::kBlob:
+      w.putChar('b');
+      break;
+    case Value::kFloatArray:
+      for (size_t i = 0; i < arraySize; ++i)
+      {
+        w.putChar('f');
+      }
+      break;
+    default:
+      break;
+  }
+  w.endString();
+
+  // arguments
+  switch (v.getType())
+  {
+    case Value::kFloat:
+      w.putFloat(v.getFloatValue());
+      break;
+    case Value::kInt:
+      w.putInt32(static_cast<uint32_t>(v.getIntValue()));
+      break;
+    case Value::kText:
+      w.putBytes(v.data(), v.size());
+      w.endString();
+      break;
+    case Value::kBlob:
+      w.putInt32(v.size());
+      w.putBytes(v.data(), v.size());
+      w.pad();
+      break;
+    case Value::kFloatArray:
+    {
+      const float* pf = v.getFloatArrayPtr();
+      for (size_t i = 0; i < arraySize; ++i)
+      {
+        w.putFloat(pf[i]);
+      }
+      break;
+    }
+    default:
+      break;
+  }
+
+  return w.ok ? w.size() : 0;
+}
+
+// OSCBundleSender
+
+OSCBundleSender::OSCBundleSender(size_t packetSize, size_t numPackets)
+    : packetSize_(std::max(packetSize, kBundleHeaderSize + 4)),
+      buffers_(packetSize_ * std::max(numPackets, size_t(1))),
+      packetBytes_(std::max(numPackets, size_t(1)))
+{
+  startPacket(0);
+}
+
+OSCBundleSender::~OSCBundleSender() { close(); }
+
+bool OSCBundleSender::open(const char* hostAddress, int port)
+{
+  close();
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(port));
+  if (inet_pton(AF_INET, hostAddress, &addr.sin_addr) != 1) return false;
+
+  socket_ = ::socket(AF_INET, SOCK_DGRAM, 0);
+  if (socket_ < 0) return false;
+  if (::connect(socket_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0)
+  {
+    close();
+    return false;
+  }
+  return true;
+}
+
+void OSCBundleSender::close()
+{
+  if (socket_ >= 0)
+  {
+    ::close(socket_);
+    socket_ = -1;
+  }
+}
+
+// write the bundle header with the immediate time tag.
+void OSCBundleSender::startPacket(size_t i)
+{
+  uint8_t* p = packet(i);
+  memcpy(p, "#bundle\0", 8);
+  memset(p + 8, 0, 8);
+  p[15] = 1;
+  packetBytes_[i] = kBundleHeaderSize;
+}
+
+bool OSCBundleSender::add(const Message& m)
+{
+  for (int attempt = 0; attempt < 2; ++attempt)
+  {
+    size_t& bytes = packetBytes_[currentPacket_];
+    uint8_t* element = packet(currentPacket_) + bytes;
+    size_t room = packetSize_ - bytes;
+    size_t n = (room > 4) ? encodeOSCMessage(m, element + 4, room - 4) : 0;
+    if (n > 0)
+    {
+      OSCWriter w{element, element, element + 4};
+      w.putInt32(static_cast<uint32_t>(n));
+      bytes += n + 4;
+      return true;
+    }
+
+    // an empty bundle can't hold the message, so no bundle can.
+    if (bytes == kBundleHeaderSize) break;
+
+    // move on to the next packet, sending them all first if there are no more.
+    if (currentPacket_ + 1 < packetBytes_.size())
+    {
+      startPacket(++currentPacket_);
+    }
+    else
+    {
+      flush();
+    }
+  }
+  droppedMessages_++;
+  return false;
+}
+
+void OSCBundleSender::flush()
+{
+  size_t nPackets = currentPacket_ + (packetBytes_[currentPacket_] > kBundleHeaderSize);
+  if ((nPackets > 0) && (socket_ >= 0))
+  {
+#if defined(__linux__)
+    constexpr size_t kMaxBatch{64};
+    mmsghdr msgs[kMaxBatch];
+    iovec iovs[kMaxBatch];
+    for (size_t sent = 0; sent < nPackets;)
+    {
+      size_t batch = std::min(nPackets - sent, kMaxBatch);
+      for (size_t i = 0; i < batch; ++i)
+      {
+        iovs[i].iov_base = packet(sent + i);
+        iovs[i].iov_len = packetBytes_[sent + i];
+        msgs[i] = mmsghdr{};
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+      }
+      int r = sendmmsg(socket_, msgs, static_cast<unsigned>(batch), 0);
+      if (r <= 0) break;
+      sent += r;
+      packetsSent_ += r;
+    }
+#else
+    for (size_t i = 0; i < nPackets; ++i)
+    {
+      if (::send(socket_, packet(i), packetBytes_[i], 0) >= 0)
+      {
+        packetsSent_++;
+      }
+    }
+#endif
+  }
+
+  currentPacket_ = 0;
+  startPacket(0);
+}
+
+}  // namespace ml
+
+#endif  // !ML_WINDOWS
@@ -0,0 +1,80 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// OSCBundleSender: sends many Messages over UDP in as few datagrams as possible.
+//
+// Messages are encoded straight from their Paths and Values into OSC bundles
+// in a pool of packet buffers, each no bigger than one datagram. When a
+// bundle is full, the next message starts a new one. flush() sends all the
+// bundles at once, with a single sendmmsg() call where it is available. No
+// memory is allocated after the sender is made.
+
+#pragma once
+
+#include "MLPlatform.h"
+
+#if !ML_WINDOWS
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "MLMessage.h"
+
+namespace ml
+{
+// encode a Message as an OSC message into dest, returning the number of bytes
+// written, or 0 if it doesn't fit in capacity bytes. Float and int Values
+// become one argument, text becomes a string, a blob becomes a blob and a
+// float array becomes one float argument per element.
+size_t encodeOSCMessage(const Message& m, uint8_t* dest, size_t capacity);
+
+class OSCBundleSender final
+{
+ public:
+  // the largest UDP payload in one 1500 byte Ethernet frame over IPv4.
+  static constexpr size_t kDefaultPacketSize{1472};
+  static constexpr size_t kDefaultNumPackets{64};
+
+  explicit OSCBundleSender(size_t packetSize = kDefaultPacketSize,
+                           size_t numPackets = kDefaultNumPackets);
+  ~OSCBundleSender();
+
+  OSCBundleSender(OSCBundleSender const&) = delete;
+  OSCBundleSender& operator=(OSCBundleSender const&) = delete;
+
+  // open a socket sending to the given IPv4 host address and port. Returns true on success.
+  bool open(const char* hostAddress, int port);
+  bool open(int port) { return open("127.0.0.1", port); }
+  void close();
+
+  // add a message to the current bundle. If all the packets are full, they are sent first.
+  // Returns false if the message is too big for one packet and was dropped.
+  bool add(const Message& m);
+
+  // send all the bundles with messages in them.
+  void flush();
+
+  size_t getPacketsSent() const { return packetsSent_; }
+  size_t getDroppedMessageCount() const { return droppedMessages_; }
+
+ private:
+  static constexpr size_t kBundleHeaderSize{16};
+
+  uint8_t* packet(size_t i) { return buffers_.data() + i * packetSize_; }
+  void startPacket(size_t i);
+
+  size_t packetSize_;
+  std::vector<uint8_t> buffers_;
+  std::vector<size_t> packetBytes_;
+  size_t currentPacket_{0};
+
+  int socket_{-1};
+  size_t packetsSent_{0};
+  size_t droppedMessages_{0};
+};
+
+}  // namespace ml
+
+#endif  // !ML_WINDOWS
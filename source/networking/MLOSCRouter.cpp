@@ -0,0 +1,326 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLOSCRouter.h"
+
+#if !ML_WINDOWS
+
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+
+namespace ml
+{
+namespace
+{
+// reads big-endian OSC data, noting if it runs past the end.
+struct OSCReader
+{
+  const uint8_t* p;
+  const uint8_t* end;
+  bool ok{true};
+
+  bool has(size_t n) const { return ok && (n <= size_t(end - p)); }
+
+  uint32_t getInt32()
+  {
+    if (!has(4))
+    {
+      ok = false;
+      return 0;
+    }
+    uint32_t x = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+    p += 4;
+    return x;
+  }
+
+  float getFloat()
+  {
+    uint32_t x = getInt32();
+    float f;
+    memcpy(&f, &x, 4);
+    return f;
+  }
+
+  uint64_t getInt64()
+  {
+    uint64_t x = (uint64_t(getInt32()) << 32);
+    return x | getInt32();
+  }
+
+  double getDouble()
+  {
+    uint64_t x = getInt64();
+    double d;
+    memcpy(&d, &x, 8);
+    return d;
+  }
+
+  // a zero-terminated string, padded to four bytes. Returns nullptr if there is no terminator.
+  const char* getString()
+  {
+    if (!ok) return nullptr;
+    const uint8_t* z = static_cast<const uint8_t*>(memchr(p, 0, end - p));
+    if (!z)
+    {
+      ok = false;
+      return nullptr;
+    }
+    const char* s = reinterpret_cast<const char*>(p);
+    skip(((z - p) + 4) & ~size_t(3));
+    return s;
+  }
+
+  void skip(size_t n)
+  {
+    if (!has(n))
+    {
+      ok = false;
+      return;
+    }
+    p += n;
+  }
+};
+
+// the most numeric arguments kept in a float array.
+constexpr size_t kMaxFloatArguments{256};
+
+// the OSC time tag meaning immediately.
+constexpr uint64_t kOSCImmediately{1};
+
+// the seconds from 1900, where OSC time tags start, to 1970, where the Clock starts.
+constexpr uint64_t kOSCToClockEpochSeconds{2208988800ULL};
+
+using TimedMessageFn = std::function<void(const Message&, uint64_t)>;
+
+bool parseOSCMessage(const uint8_t* data, size_t size, uint64_t timeTag,
+                     const TimedMessageFn& fn)
+{
+  OSCReader r{data, data + size};
+  const char* address = r.getString();
+  if (!r.ok || (address[0] != '/')) return false;
+
+  // a missing type tag string means no arguments.
+  const char* tags = r.has(1) && (*r.p == ',') ? r.getString() + 1 : "";
+  if (!r.ok) return false;
+
+  float floats[kMaxFloatArguments];
+  size_t nFloats{0};
+  bool allNumbers{true};
+  Value first;
+  for (const char* t = tags; *t; ++t)
+  {
+    Value v;
+    switch (*t)
+    {
+      case 'f':
+        v = Value(r.getFloat());
+        break;
+      case 'i':
+        v = Value(static_cast<int>(r.getInt32()));
+        break;
+      case 'h':
+        v = Value(static_cast<int>(static_cast<int64_t>(r.getInt64())));
+        break;
+      case 'd':
+        v = Value(r.getDouble());
+        break;
+      case 'T':
+        v = Value(1);
+        break;
+      case 'F':
+        v = Value(0);
+        break;
+      case 's':
+      case 'S':
+      {
+        const char* s = r.getString();
+        if (s) v = Value(s);
+        allNumbers = false;
+        break;
+      }
+      case 'b':
+      {
+        size_t n = r.getInt32();
+        if (r.has(n)) v = Value(r.p, n);
+        r.skip((n + 3) & ~size_t(3));
+        allNumbers = false;
+        break;
+      }
+      case 'N':
+      case 'I':
+        continue;
+      default:
+        // unknown argument sizes can't be skipped.
+        return false;
+    }
+    if (!r.ok) return false;
+    if (!first) first = v;
+    if (allNumbers && (nFloats < kMaxFloatArguments))
+    {
+      floats[nFloats++] = v.getFloatValue();
+    }
+  }
+
+  Message m(runtimePath(address), (allNumbers && nFloats > 1) ? Value(floats, nFloats) : first,
+            kMsgFromController);
+  fn(m, timeTag);
+  return true;
+}
+
+bool parseOSCElement(const uint8_t* data, size_t size, uint64_t timeTag, const TimedMessageFn& fn)
+{
+  if ((size < 4) || (size & 3)) return false;
+  if (data[0] == '/') return parseOSCMessage(data, size, timeTag, fn);
+
+  // a bundle: "#bundle", a time tag, then elements, each with its size.
+  if ((size < 16) || memcmp(data, "#bundle", 8)) return false;
+  OSCReader r{data + 8, data + size};
+  timeTag = r.getInt64();
+  while (r.ok && (r.p < r.end))
+  {
+    size_t n = r.getInt32();
+    if (!r.has(n) || !parseOSCElement(r.p, n, timeTag, fn)) return false;
+    r.skip(n);
+  }
+  return r.ok;
+}
+}  // namespace
+
+bool parseOSCPacket(const uint8_t* data, size_t size,
+                    const std::function<void(const Message&)>& fn)
+{
+  return parseOSCElement(data, size, kOSCImmediately,
+                         [&fn](const Message& m, uint64_t) { fn(m); });
+}
+
+bool parseOSCPacket(const uint8_t* data, size_t size, const TimedMessageFn& fn)
+{
+  return parseOSCElement(data, size, kOSCImmediately, fn);
+}
+
+Time oscTimeTagToTime(uint64_t timeTag)
+{
+  if (timeTag == kOSCImmediately) return EventScheduler::kImmediately;
+  return timeTag - (kOSCToClockEpochSeconds << 32);
+}
+
+// OSCRouter
+
+OSCRouter::~OSCRouter() { close(); }
+
+void OSCRouter::addRoute(Path prefix, Actor* target)
+{
+  routes_.push_back({prefix, target, nullptr, nullptr});
+}
+
+void OSCRouter::addRoute(Path prefix, EventScheduler* scheduler, OSCEventFn toEvent)
+{
+  routes_.push_back({prefix, nullptr, scheduler, std::move(toEvent)});
+}
+
+bool OSCRouter::listen(int port, size_t nThreads)
+{
+  running_ = true;
+  for (size_t i = 0; i < std::max(nThreads, size_t(1)); ++i)
+  {
+    int s = ::socket(AF_INET, SOCK_DGRAM, 0);
+    if (s < 0) return false;
+
+    if (nThreads > 1)
+    {
+      int one = 1;
+      setsockopt(s, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    if (::bind(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0)
+    {
+      ::close(s);
+      return false;
+    }
+
+    sockets_.push_back(s);
+    threads_.emplace_back([this, s]() { receive(s); });
+  }
+  return true;
+}
+
+void OSCRouter::close()
+{
+  running_ = false;
+  for (auto& t : threads_)
+  {
+    t.join();
+  }
+  threads_.clear();
+  for (int s : sockets_)
+  {
+    ::close(s);
+  }
+  sockets_.clear();
+}
+
+// send the message to the Actor or EventScheduler with the longest matching prefix.
+void OSCRouter::route(const Message& m, uint64_t timeTag)
+{
+  const Route* best{nullptr};
+  for (const auto& r : routes_)
+  {
+    if (m.address.beginsWith(r.prefix) && (!best || r.prefix.getSize() > best->prefix.getSize()))
+    {
+      best = &r;
+    }
+  }
+
+  if (best && best->scheduler)
+  {
+    Event e = best->toEvent(m);
+    if (e)
+    {
+      best->scheduler->schedule(oscTimeTagToTime(timeTag), e);
+    }
+    messagesRouted_++;
+  }
+  else if (best)
+  {
+    best->target->enqueueMessage(m);
+    messagesRouted_++;
+  }
+  else
+  {
+    unroutedMessages_++;
+  }
+}
+
+void OSCRouter::receive(int socket)
+{
+  // the largest UDP payload.
+  constexpr size_t kBufferSize{65536};
+  constexpr int kPollMilliseconds{100};
+  std::vector<uint8_t> buffer(kBufferSize);
+  const TimedMessageFn routeFn = [this](const Message& m, uint64_t timeTag) { route(m, timeTag); };
+
+  pollfd pfd{socket, POLLIN, 0};
+  while (running_.load(std::memory_order_relaxed))
+  {
+    if (poll(&pfd, 1, kPollMilliseconds) <= 0) continue;
+    ssize_t n = ::recv(socket, buffer.data(), buffer.size(), 0);
+    if (n <= 0) continue;
+    if (!parseOSCPacket(buffer.data(), static_cast<size_t>(n), routeFn))
+    {
+      malformedPackets_++;
+    }
+  }
+}
+
+}  // namespace ml
+
+#endif  // !ML_WINDOWS
@@ -0,0 +1,110 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// OSCRouter: receives OSC over UDP and routes the messages to Actors.
+//
+// Each receive thread reads datagrams into its own buffer and parses them in
+// place into Messages, making each address into a Path directly from the
+// packet data. Each Message is then routed to the Actor with the longest
+// matching prefix, by pushing it onto the Actor's queue. Bundles are unpacked,
+// and for Actors their time tags are ignored.
+//
+// A route can go to an EventScheduler instead of an Actor. Its Messages are
+// made into Events by a function given with the route, and scheduled at the
+// time tags of their bundles, so that the audio thread plays them at the exact
+// sample. Messages that are not in a bundle play as soon as possible.
+//
+// A port can be read by several threads, each with its own socket bound with
+// SO_REUSEPORT, so that the system shares the incoming datagrams among them.
+// An Actor that can get messages from more than one receive thread must be
+// made with ActorQueueType::kMultipleProducers.
+
+#pragma once
+
+#include "MLPlatform.h"
+
+#if !ML_WINDOWS
+
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "MLActor.h"
+#include "MLEventScheduler.h"
+
+namespace ml
+{
+// parse an OSC packet, calling fn with each Message in it. The address becomes the Path and
+// the arguments become the Value: a single argument becomes a Value of its type, numeric
+// arguments become a float array, and otherwise only the first argument is kept. Returns
+// false if the packet is malformed.
+bool parseOSCPacket(const uint8_t* data, size_t size,
+                    const std::function<void(const Message&)>& fn);
+
+// parse an OSC packet as above, also passing fn the time tag of the innermost bundle holding
+// each Message, or 1, meaning immediately, for a Message not in a bundle.
+bool parseOSCPacket(const uint8_t* data, size_t size,
+                    const std::function<void(const Message&, uint64_t)>& fn);
+
+// convert an OSC time tag, in seconds since 1900, to a Time on the Clock's timeline, which
+// counts from 1970. The tag for immediately becomes EventScheduler::kImmediately.
+Time oscTimeTagToTime(uint64_t timeTag);
+
+// make an Event from a Message, or return a null Event to ignore the Message.
+using OSCEventFn = std::function<Event(const Message&)>;
+
+class OSCRouter final
+{
+ public:
+  OSCRouter() = default;
+  ~OSCRouter();
+
+  OSCRouter(OSCRouter const&) = delete;
+  OSCRouter& operator=(OSCRouter const&) = delete;
+
+  // send messages with addresses beginning with prefix to the Actor. Routes must be added
+  // before listening starts.
+  void addRoute(Path prefix, Actor* target);
+
+  // make messages with addresses beginning with prefix into Events with toEvent, and schedule
+  // them at their time tags.
+  void addRoute(Path prefix, EventScheduler* scheduler, OSCEventFn toEvent);
+
+  // start nThreads threads receiving on the port. Can be called for more than one port.
+  // Returns true if all the sockets were opened.
+  bool listen(int port, size_t nThreads = 1);
+
+  // stop all the receive threads and close their sockets.
+  void close();
+
+  size_t getMessagesRouted() const { return messagesRouted_; }
+  size_t getUnroutedMessageCount() const { return unroutedMessages_; }
+  size_t getMalformedPacketCount() const { return malformedPackets_; }
+
+ private:
+  struct Route
+  {
+    Path prefix;
+    Actor* target;
+    EventScheduler* scheduler;
+    OSCEventFn toEvent;
+  };
+
+  void route(const Message& m, uint64_t timeTag);
+  void receive(int socket);
+
+  std::vector<Route> routes_;
+  std::vector<int> sockets_;
+  std::vector<std::thread> threads_;
+  std::atomic<bool> running_{false};
+
+  std::atomic<size_t> messagesRouted_{0};
+  std::atomic<size_t> unroutedMessages_{0};
+  std::atomic<size_t> malformedPackets_{0};
+};
+
+}  // namespace ml
+
+#endif  // !ML_WINDOWS
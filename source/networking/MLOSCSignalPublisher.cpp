@@ -0,0 +1,199 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLOSCSignalPublisher.h"
+
+#if !ML_WINDOWS
+
+#include <chrono>
+
+namespace ml
+{
+namespace
+{
+// the most blob bytes in one message, leaving room in a packet for the address and header.
+constexpr size_t kMaxBlobBytes{1024};
+constexpr size_t kBlobHeaderSize{4};
+
+// in kDeltaInt8 encoding, marks a sample sent as an int16.
+constexpr int kDeltaEscape{-128};
+
+int16_t toInt16(float f)
+{
+  return static_cast<int16_t>(std::lround(clamp(f, -1.f, 1.f) * 32767.f));
+}
+
+void putInt16(uint8_t*& p, int16_t x)
+{
+  *p++ = uint8_t(uint16_t(x) >> 8);
+  *p++ = uint8_t(x);
+}
+
+void putFloat(uint8_t*& p, float f)
+{
+  uint32_t x;
+  memcpy(&x, &f, 4);
+  *p++ = uint8_t(x >> 24);
+  *p++ = uint8_t(x >> 16);
+  *p++ = uint8_t(x >> 8);
+  *p++ = uint8_t(x);
+}
+}  // namespace
+
+OSCSignalPublisher::~OSCSignalPublisher() { stop(); }
+
+void OSCSignalPublisher::addSignal(Path name, SignalProcessor::PublishedSignal* signal)
+{
+  // the blob header has one byte for the number of channels.
+  if (signal && (signal->getNumChannels() > 0) && (signal->getNumChannels() < 256))
+  {
+    signals_.push_back({name, signal, {}});
+  }
+}
+
+void OSCSignalPublisher::addSignals(const SignalProcessor& processor)
+{
+  const auto& tree = processor.getPublishedSignals();
+  for (auto it = tree.begin(); it != tree.end(); ++it)
+  {
+    addSignal(it.getCurrentPath(), (*it).get());
+  }
+}
+
+bool OSCSignalPublisher::start(const char* hostAddress, int port)
+{
+  stop();
+  if (!sender_.open(hostAddress, port)) return false;
+  blob_.resize(kMaxBlobBytes);
+  running_ = true;
+  thread_ = std::thread([this]() { run(); });
+  return true;
+}
+
+void OSCSignalPublisher::stop()
+{
+  if (running_.exchange(false))
+  {
+    thread_.join();
+  }
+  sender_.close();
+}
+
+void OSCSignalPublisher::run()
+{
+  using clock = std::chrono::steady_clock;
+  const auto interval = std::chrono::duration_cast<clock::duration>(
+      std::chrono::duration<double>(1.0 / framesPerSecond_));
+  auto nextTime = clock::now();
+  while (running_.load(std::memory_order_relaxed))
+  {
+    for (auto& s : signals_)
+    {
+      sendSignal(s);
+    }
+    sender_.flush();
+
+    nextTime += interval;
+    std::this_thread::sleep_until(nextTime);
+  }
+}
+
+void OSCSignalPublisher::sendSignal(Signal& s)
+{
+  const size_t channels = s.source->getNumChannels();
+  size_t nFrames = s.source->getAvailableFrames();
+  if (nFrames == 0) return;
+
+  // reading may allocate here, but never on the audio thread.
+  s.frames.resize(nFrames * channels);
+  nFrames = s.source->read(s.frames.data(), nFrames) / channels;
+
+  // average each group of downsample_ frames in place.
+  if (downsample_ > 1)
+  {
+    const size_t n = downsample_;
+    const float scale = 1.f / n;
+    size_t nOut = nFrames / n;
+    for (size_t i = 0; i < nOut; ++i)
+    {
+      for (size_t c = 0; c < channels; ++c)
+      {
+        float sum{0.f};
+        for (size_t j = 0; j < n; ++j)
+        {
+          sum += s.frames[(i * n + j) * channels + c];
+        }
+        s.frames[i * channels + c] = sum * scale;
+      }
+    }
+    nFrames = nOut;
+  }
+
+  // send as many frames as fit in each message.
+  Path address(prefix_, s.address);
+  for (size_t start = 0; start < nFrames;)
+  {
+    size_t bytes{0};
+    size_t n = encodeFrames(s.frames.data() + start * channels, nFrames - start, channels,
+                            blob_.data(), bytes);
+    if (n == 0) break;
+    sender_.add(Message(address, Value(blob_.data(), bytes)));
+    framesSent_ += n;
+    start += n;
+  }
+}
+
+size_t OSCSignalPublisher::encodeFrames(const float* frames, size_t nFrames, size_t channels,
+                                        uint8_t* dest, size_t& bytes)
+{
+  // the most bytes one frame can take.
+  const size_t frameBytes = channels * ((encoding_ == kFloat32) ? 4 : 3);
+  const uint8_t* end = dest + kMaxBlobBytes;
+  uint8_t* p = dest + kBlobHeaderSize;
+
+  size_t f = 0;
+  for (; (f < nFrames) && (p + frameBytes <= end); ++f)
+  {
+    const float* frame = frames + f * channels;
+    for (size_t c = 0; c < channels; ++c)
+    {
+      switch (encoding_)
+      {
+        case kFloat32:
+          putFloat(p, frame[c]);
+          break;
+        case kInt16:
+          putInt16(p, toInt16(frame[c]));
+          break;
+        case kDeltaInt8:
+        default:
+        {
+          int16_t x = toInt16(frame[c]);
+          int delta = (f > 0) ? x - toInt16(frame[c - channels]) : kDeltaEscape;
+          if ((delta > kDeltaEscape) && (delta <= 127))
+          {
+            *p++ = uint8_t(int8_t(delta));
+          }
+          else
+          {
+            *p++ = uint8_t(int8_t(kDeltaEscape));
+            putInt16(p, x);
+          }
+          break;
+        }
+      }
+    }
+  }
+
+  dest[0] = uint8_t(encoding_);
+  dest[1] = uint8_t(channels);
+  dest[2] = uint8_t(f >> 8);
+  dest[3] = uint8_t(f);
+  bytes = p - dest;
+  return f;
+}
+
+}  // namespace ml
+
+#endif  // !ML_WINDOWS
@@ -0,0 +1,107 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2025 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// OSCSignalPublisher: sends a SignalProcessor's published signals over OSC.
+//
+// A background thread drains the DSPBuffer of each PublishedSignal at a fixed
+// rate and sends the new frames as OSC blobs, so that remote displays can
+// show scopes and meters. The audio thread does no more than its usual
+// writeQuick(). Frames can be averaged down and quantized before sending.
+//
+// Each message has the address prefix/signalName and one blob argument:
+//
+// byte 0: encoding
+// byte 1: number of channels
+// bytes 2-3: number of frames, big-endian
+// then the frames, in frame major order like the DSPBuffer:
+//   kFloat32: big-endian floats.
+//   kInt16: big-endian int16 samples, scaled so that 32767 is 1.0.
+//   kDeltaInt8: for each sample, the int8 difference from the sample before
+//     in the same channel, in the int16 scale above. The first frame, and any
+//     difference outside [-127, 127], is sent as -128 then an int16 sample.
+//
+// The publisher must be the only reader of the signals it sends.
+
+#pragma once
+
+#include "MLPlatform.h"
+
+#if !ML_WINDOWS
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "MLOSCBundleSender.h"
+#include "MLSignalProcessor.h"
+
+namespace ml
+{
+class OSCSignalPublisher final
+{
+ public:
+  enum Encoding
+  {
+    kFloat32 = 0,
+    kInt16 = 1,
+    kDeltaInt8 = 2
+  };
+
+  static constexpr int kDefaultFramesPerSecond{30};
+
+  OSCSignalPublisher() = default;
+  ~OSCSignalPublisher();
+
+  OSCSignalPublisher(OSCSignalPublisher const&) = delete;
+  OSCSignalPublisher& operator=(OSCSignalPublisher const&) = delete;
+
+  // add one signal, sent with the address prefix/name. Signals must be added before start().
+  void addSignal(Path name, SignalProcessor::PublishedSignal* signal);
+
+  // add all the signals published by the processor.
+  void addSignals(const SignalProcessor& processor);
+
+  // settings, to be made before start().
+  void setAddressPrefix(Path p) { prefix_ = p; }
+  void setFramesPerSecond(int f) { framesPerSecond_ = std::max(f, 1); }
+  void setEncoding(Encoding e) { encoding_ = e; }
+
+  // average each group of n frames into one before sending.
+  void setDownsample(int n) { downsample_ = std::max(n, 1); }
+
+  // start sending to the given IPv4 host address and port. Returns true on success.
+  bool start(const char* hostAddress, int port);
+  void stop();
+
+  size_t getFramesSent() const { return framesSent_; }
+
+ private:
+  struct Signal
+  {
+    Path address;
+    SignalProcessor::PublishedSignal* source;
+    std::vector<float> frames;
+  };
+
+  void run();
+  void sendSignal(Signal& s);
+  size_t encodeFrames(const float* frames, size_t nFrames, size_t channels, uint8_t* dest,
+                      size_t& bytes);
+
+  Path prefix_{};
+  int framesPerSecond_{kDefaultFramesPerSecond};
+  Encoding encoding_{kInt16};
+  int downsample_{1};
+
+  std::vector<Signal> signals_;
+  std::vector<uint8_t> blob_;
+  OSCBundleSender sender_;
+  std::thread thread_;
+  std::atomic<bool> running_{false};
+  std::atomic<size_t> framesSent_{0};
+};
+
+}  // namespace ml
+
+#endif  // !ML_WINDOWS